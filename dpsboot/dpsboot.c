@@ -36,21 +36,23 @@
 #include <flash.h>
 #include "tick.h"
 #include "hw.h"
-#include "ringbuf.h"
 #include "past.h"
 #include "pastunits.h"
 #include "uframe.h"
 #include "protocol.h"
 #include "bootcom.h"
 #include "crc16.h"
+#include "unlz.h"
 #include "flashlock.h"
 
 #ifndef MIN
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 #endif
 
-#define RX_BUF_SIZE  (16)
 #define MAX_CHUNK_SIZE (2*1024)
+#define FLASH_PAGE_SIZE (1024) /** STM32F100 */
+/** How often raw upgrades record their progress in past */
+#define UPGRADE_PROGRESS_INTERVAL (8*1024)
 
 /** Our parameter storage */
 static past_t past;
@@ -63,10 +65,6 @@ extern uint32_t *_past_end;
 extern uint32_t *_bootcom_start;
 extern uint32_t *_bootcom_end;
 
-/** UART RX FIFO */
-static ringbuf_t rx_buf;
-static uint8_t buffer[2*RX_BUF_SIZE];
-
 /** UART frame buffer */
 static uint8_t frame_buffer[FRAME_OVERHEAD(MAX_CHUNK_SIZE)];
 static uint32_t rx_idx = 0;
@@ -76,28 +74,96 @@ static bool receiving_frame = false;
 static uint16_t chunk_size;
 static uint32_t cur_flash_address;
 static uint16_t fw_crc16;
+/** CRC of the image written so far, updated as each chunk is programmed */
+static uint16_t image_crc16;
+/** Result of writing the last chunk, reported in the response to the next one */
+static upgrade_status_t flash_status;
+/** Upgrade data bytes accepted, where the host resumes after an error */
+static uint32_t stream_offset;
+/** Offset last recorded as past_upgrade_progress */
+static uint32_t progress_offset;
+
+/** Stored as past_upgrade_progress */
+typedef struct {
+    uint32_t offset;       /** Bytes of the image written */
+    uint16_t fw_crc16;     /** CRC of the complete image */
+    uint16_t image_crc16;  /** CRC of the first offset bytes */
+} upgrade_progress_t;
+
+/** For decompressing LZ compressed upgrades, output is collected one flash
+  * page at a time and back references are read from page_buf or flash */
+static bool compressed;
+static unlz_t lz;
+static uint8_t page_buf[FLASH_PAGE_SIZE];
+static uint32_t page_fill;
+static upgrade_status_t lz_status;
 
 static upgrade_reason_t reason = reason_unknown;
 
 static void handle_frame(uint8_t *payload, uint32_t length);
 static void send_frame(const frame_t *frame);
 
+/**
+  * @brief Find where an interrupted upgrade of the image with fw_crc16 can be
+  *        resumed, after checking the flash written so far is intact
+  * @param progress recorded progress, valid if true is returned
+  * @retval true if the upgrade can be resumed
+  */
+static bool find_progress(upgrade_progress_t *progress)
+{
+    const void *data;
+    uint32_t length;
+    if (!past_read_unit(&past, past_upgrade_progress, &data, &length) || length != sizeof(*progress)) {
+        return false;
+    }
+    memcpy(progress, data, sizeof(*progress));
+    if (progress->fw_crc16 != fw_crc16 || progress->offset == 0 || progress->offset % FLASH_PAGE_SIZE ||
+        progress->offset >= (uint32_t) &_app_end - (uint32_t) &_app_start) {
+        return false;
+    }
+    uint16_t crc = 0;
+    const uint8_t *p = (const uint8_t*) &_app_start;
+    for (uint32_t i = 0; i < progress->offset; i++) {
+        crc = crc16_add(crc, p[i]);
+    }
+    return crc == progress->image_crc16;
+}
+
 /**
   * @brief Send ack to upgrade start and do some book keeping
+  * @param resume continue at the recorded progress if there is one
   * @retval none
   */
-static void send_start_response(void)
+static void send_start_response(bool resume)
 {
+    upgrade_progress_t progress;
+    if (!find_progress(&progress)) {
+        progress.offset = 0;
+        progress.image_crc16 = 0;
+    }
     frame_t frame;
     set_frame_header(&frame);
     pack8(&frame, cmd_response | cmd_upgrade_start);
     pack8(&frame, upgrade_continue);
     pack16(&frame, chunk_size);
     pack8(&frame, reason);
+    pack8(&frame, UPGRADE_CAP_LZ | UPGRADE_CAP_RESUME);
+    pack32(&frame, progress.offset);
+    pack16(&frame, progress.image_crc16);
     end_frame(&frame);
     uint32_t setting = 1;
     (void) past_write_unit(&past, past_upgrade_started, (void*) &setting, sizeof(setting));
-    cur_flash_address = (uint32_t) &_app_start;
+    if (!resume) {
+        /** The recorded progress is dropped once the new upgrade writes data */
+        progress.offset = 0;
+        progress.image_crc16 = 0;
+    }
+    cur_flash_address = (uint32_t) &_app_start + progress.offset;
+    image_crc16 = progress.image_crc16;
+    flash_status = upgrade_continue;
+    stream_offset = progress.offset;
+    progress_offset = progress.offset;
+    compressed = false;
     send_frame(&frame);
 }
 
@@ -109,12 +175,12 @@ static void handle_upgrade(void)
 {
     unlock_flash();
     if (fw_crc16) { /** dpsctl.py is expecting a response */
-        send_start_response();
+        send_start_response(false);
     }
 
     while(1) {
-        uint16_t b;
-        if (ringbuf_get(&rx_buf, &b)) {
+        uint8_t b;
+        if (hw_usart_getc(&b)) {
             if (b == _SOF) {
                 receiving_frame = true;
                 rx_idx = 0;
@@ -150,24 +216,6 @@ static bool start_app(void)
     return false;
 }
 
-/**
-  * @brief Write 32 bits to flash
-  * @param address word aligned address to write to
-  * @param data well, data
-  * @retval true if write was successful
-  */
-static inline bool flash_write32(uint32_t address, uint32_t data)
-{
-    bool success = false;
-    if (address % 4 == 0) {
-        uint32_t *p = (uint32_t*) address;
-        flash_program_word(address, data);
-        success = FLASH_SR_EOP & flash_get_status_flags();
-        success &= *p == data; // Verify write
-    }
-    return success;
-}
-
 /**
   * @brief Send a frame on the uart
   * @param frame the frame to send
@@ -180,6 +228,154 @@ static void send_frame(const frame_t *frame)
         usart_send_blocking(USART1, frame->buffer[i]);
 }
 
+/**
+  * @brief Send the response to an upgrade data frame
+  * @param status the upgrade status
+  * @retval None
+  */
+static void send_data_response(upgrade_status_t status)
+{
+    frame_t frame_resp;
+    set_frame_header(&frame_resp);
+    pack8(&frame_resp, cmd_response | cmd_upgrade_data);
+    pack8(&frame_resp, status);
+    /** Where the host shall resume after a retryable error */
+    pack32(&frame_resp, stream_offset);
+    end_frame(&frame_resp);
+    send_frame(&frame_resp);
+}
+
+/**
+  * @brief Erase and program one chunk at cur_flash_address
+  *        The chunk is added to the image CRC only if it was written fully,
+  *        a failed chunk leaves cur_flash_address and the CRC untouched so
+  *        the host can resend it.
+  * @param data the chunk
+  * @param length length of the chunk
+  * @retval upgrade_continue on success, else the error
+  */
+static upgrade_status_t write_chunk(const uint8_t *data, uint32_t length)
+{
+    if (length == 0) {
+        return upgrade_continue;
+    }
+    for (uint32_t page = 0; page < length; page += FLASH_PAGE_SIZE) {
+        flash_erase_page(cur_flash_address + page);
+        if (!(FLASH_SR_EOP & flash_get_status_flags())) {
+            return upgrade_erase_error;
+        }
+    }
+    /** @todo: Handle binaries not size aligned to 4 bytes */
+    if (!flash_program_block(cur_flash_address, data, (length + 1) & ~1u)) {
+        return upgrade_flash_error;
+    }
+    cur_flash_address += length;
+    image_crc16 = crc16_add_bytes(image_crc16, data, length);
+    return upgrade_continue;
+}
+
+/**
+  * @brief Write the decompressed data collected in page_buf
+  * @retval upgrade_continue on success, else the error
+  */
+static upgrade_status_t flush_page(void)
+{
+    upgrade_status_t status;
+    uint32_t length = page_fill;
+    page_fill = 0;
+    if (cur_flash_address + length > (uint32_t) &_app_end) {
+        return upgrade_overflow_error;
+    }
+    for (uint32_t i = length; i % 4; i++) {
+        page_buf[i] = 0xff; /** Pad the last word of the image */
+    }
+    status = write_chunk(page_buf, length);
+    return status;
+}
+
+/**
+  * @brief Decompressor output callback
+  */
+static bool lz_put(void *ctx, uint8_t byte)
+{
+    (void) ctx;
+    page_buf[page_fill++] = byte;
+    if (page_fill == sizeof(page_buf)) {
+        lz_status = flush_page();
+    }
+    return lz_status == upgrade_continue;
+}
+
+/**
+  * @brief Decompressor history callback
+  */
+static uint8_t lz_peek(void *ctx, uint16_t distance)
+{
+    (void) ctx;
+    if (distance <= page_fill) {
+        return page_buf[page_fill - distance];
+    }
+    return *(uint8_t*) (cur_flash_address - (distance - page_fill));
+}
+
+/**
+  * @brief Write one chunk of upgrade data, decompressing it if the upgrade
+  *        started with UPGRADE_LZ_MAGIC
+  * @param data the chunk
+  * @param length length of the chunk
+  * @param last true if this is the last chunk of the upgrade
+  * @retval upgrade_continue on success, else the error
+  */
+static upgrade_status_t write_data(uint8_t *data, uint32_t length, bool last)
+{
+    upgrade_status_t status;
+    if (stream_offset == 0) {
+        /** Starting over, what an interrupted upgrade left is about to go */
+        (void) past_erase_unit(&past, past_upgrade_progress);
+    }
+    if (stream_offset == 0 && length >= UPGRADE_LZ_MAGIC_LEN &&
+        memcmp(data, UPGRADE_LZ_MAGIC, UPGRADE_LZ_MAGIC_LEN) == 0) {
+        compressed = true;
+        page_fill = 0;
+        lz_status = upgrade_continue;
+        unlz_init(&lz, &lz_put, &lz_peek, 0);
+        data += UPGRADE_LZ_MAGIC_LEN;
+        length -= UPGRADE_LZ_MAGIC_LEN;
+        stream_offset += UPGRADE_LZ_MAGIC_LEN;
+    }
+    if (!compressed) {
+        status = write_chunk(data, length);
+        if (status == upgrade_continue) {
+            stream_offset += length;
+            if (stream_offset % FLASH_PAGE_SIZE == 0 && stream_offset - progress_offset >= UPGRADE_PROGRESS_INTERVAL) {
+                upgrade_progress_t progress = {
+                    .offset = stream_offset,
+                    .fw_crc16 = fw_crc16,
+                    .image_crc16 = image_crc16,
+                };
+                if (past_write_unit(&past, past_upgrade_progress, (void*) &progress, sizeof(progress))) {
+                    progress_offset = stream_offset;
+                }
+            }
+        }
+        return status;
+    }
+    /** No going back in a compressed stream, errors are final */
+    stream_offset += length;
+    if (!unlz_feed(&lz, data, length)) {
+        return lz_status != upgrade_continue ? lz_status : upgrade_crc_error;
+    }
+    if (last) {
+        if (!unlz_done(&lz)) {
+            return upgrade_crc_error;
+        }
+        if (page_fill) {
+            return flush_page();
+        }
+    }
+    return upgrade_continue;
+}
+
 /**
   * @brief Handle a received frame
   * @param frame the received frame
@@ -192,11 +388,20 @@ static void handle_frame(uint8_t *payload, uint32_t length)
     upgrade_status_t status;
     int32_t payload_len = uframe_extract_payload_inplace(payload, length);
 
-    if (payload_len > 0) {
+    if (payload_len < 0 && cur_flash_address && fw_crc16) {
+        /** A chunk got mangled on the way, have the host resend it unless
+          * writing the previous one failed which takes precedence */
+        status = flash_status != upgrade_continue ? flash_status : upgrade_chunk_error;
+        if (!compressed) {
+            flash_status = upgrade_continue;
+        }
+        send_data_response(status);
+    } else if (payload_len > 0) {
         cmd = payload[0];
         switch(cmd) {
             case cmd_upgrade_start:
             {
+                uint8_t flags = 0;
                 {
                     frame_t frame;
                     uframe_from_extracted_payload(&frame, payload, payload_len);
@@ -205,54 +410,51 @@ static void handle_frame(uint8_t *payload, uint32_t length)
                     unpack16(&frame, &chunk_size);
                     chunk_size = MIN(MAX_CHUNK_SIZE, chunk_size);
                     unpack16(&frame, &fw_crc16);
+                    if (payload_len > 5) {
+                        unpack8(&frame, &flags);
+                    }
                 }
-                send_start_response();
+                send_start_response(flags & UPGRADE_START_RESUME);
                 break;
             }
             case cmd_upgrade_data:
                 if (!cur_flash_address || !fw_crc16) {
                     status = upgrade_protocol_error;
-                } else if (payload_len < 0) {
-                    status = upgrade_crc_error;
+                } else if (flash_status != upgrade_continue) {
+                    /** Writing the previous chunk failed, drop this one and
+                      * let the host resume from stream_offset */
+                    status = flash_status;
+                    if (!compressed) {
+                        flash_status = upgrade_continue;
+                    }
                 } else if (cur_flash_address >= (uint32_t) &_app_end) {
                     status = upgrade_overflow_error;
                 } else {
-                    status = upgrade_continue; /** think positive thoughts */
                     uint32_t chunk_length = payload_len - 1; /** frame type of the payload occupies 1 byte, the rest is upgrade data */
-                    if (chunk_length > 0) {
-                        flash_erase_page(cur_flash_address);
-                        if (!(FLASH_SR_EOP & flash_get_status_flags())) {
-                            status = upgrade_erase_error;
-                        } else {
-                            uint32_t word;
-                            status = upgrade_continue; // Think positive
-                            /** Note, payload contains 1 frame type byte and N bytes data */
-                            for (uint32_t i = 0; i < (uint32_t) chunk_length; i+=4) {
-                                word = payload[i+4] << 24 | payload[i+3] << 16 | payload[i+2] << 8 | payload[i+1];
-                                /** @todo: Handle binaries not size aligned to 4 bytes */
-                                if (!flash_write32(cur_flash_address+i, word)) {
-                                    status = upgrade_flash_error;
-                                    break;
-                                }
-                            }
-                            cur_flash_address += chunk_length;
-                        }
+                    bool last = chunk_length < chunk_size; /** An empty chunk ends an even kb binary */
+                    if (!last) {
+                        /** Ack right away so the host sends the next chunk while
+                          * we write this one, its status comes with the next ack */
+                        send_data_response(upgrade_continue);
+                    }
+                    flash_status = write_data(&payload[1], chunk_length, last);
+                    if (!last) {
+                        break;
                     }
-                    if (chunk_length < chunk_size) { /** @todo verify code for even kb binaries */
-                        uint16_t calc_crc = crc16((uint8_t*) &_app_start, cur_flash_address - (uint32_t) &_app_start);
-                        status = fw_crc16 == calc_crc ? upgrade_success : upgrade_crc_error;
+                    status = flash_status;
+                    if (!compressed) {
+                        flash_status = upgrade_continue;
+                    }
+                    if (status == upgrade_continue) {
+                        status = fw_crc16 == image_crc16 ? upgrade_success : upgrade_crc_error;
                     }
                 }
                 {
-                    frame_t frame_resp;
-                    set_frame_header(&frame_resp);
-                    pack8(&frame_resp, cmd_response | cmd_upgrade_data);
-                    pack8(&frame_resp, status);
-                    end_frame(&frame_resp);
-                    send_frame(&frame_resp);
+                    send_data_response(status);
                     if (status == upgrade_success) {
                         usart_wait_send_ready(USART1); /** make sure FIFO is empty */
                         (void) past_erase_unit(&past, past_upgrade_started);
+                        (void) past_erase_unit(&past, past_upgrade_progress);
                         cur_flash_address = 0;
                         lock_flash();
                         if (!start_app()) {
@@ -279,8 +481,9 @@ int main(void)
     void *data;
     uint32_t length;
 
-    ringbuf_init(&rx_buf, (uint8_t*) buffer, sizeof(buffer));
-    hw_init(&rx_buf);
+    /** Only what deciding to start the app needs, the USART is set up once
+      * an upgrade is certain */
+    hw_init();
 
     do {
         if (hw_check_forced_upgrade()) {
@@ -291,8 +494,9 @@ int main(void)
             break;
         }
 
-        past.blocks[0] = past_start;
-        past.blocks[1] = past_start + 1024;
+        for (uint32_t i = 0; i < PAST_NUM_BLOCKS; i++) {
+            past.blocks[i] = past_start + i * PAST_BLOCK_SIZE;
+        }
         if (!past_init(&past)) {
             /** Not much we can do */
             enter_upgrade = true;
@@ -337,10 +541,14 @@ int main(void)
     } while(0);
 
     if (enter_upgrade) {
+        hw_usart_init();
         handle_upgrade();
     } else {
+        /** The app reports this with its own startup times */
+        bootcom_put(BOOTCOM_BOOT_TIME, (uint32_t) get_ticks());
         if (!start_app()) {
             reason = reason_app_start_failed;
+            hw_usart_init();
             handle_upgrade(); /** In case we somehow returned from the app */
         }
     }
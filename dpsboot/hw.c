@@ -28,29 +28,49 @@
 #include <timer.h>
 #include <rcc.h>
 #include <gpio.h>
-#include <nvic.h>
 #include <usart.h>
+#include <dma.h>
 #include <stdio.h>
 #include "tick.h"
 #include "hw.h"
-#include "ringbuf.h"
 
 static void clock_init(void);
 static void usart_init(void);
 static void gpio_init(void);
+#ifdef CONFIG_FLASH_RAMFUNC
+static void copy_ramfuncs(void);
 
-static ringbuf_t *rx_buf;
+/** Load and run addresses of the .ramfunc section, see stm32f100_boot.ld */
+extern uint32_t _ramfunc_loadaddr, _ramfunc_start, _ramfunc_end;
+#endif // CONFIG_FLASH_RAMFUNC
+
+/** USART RX ring filled by DMA1 channel 5. The CPU stalls while flash is
+  * erased or programmed but the DMA keeps moving received bytes, so the host
+  * may send the next chunk while the current one is being written. */
+static uint8_t rx_ring[USART_RX_RING_SIZE];
+static uint32_t rx_pos;
 
 /**
-  * @brief Initialize the hardware
+  * @brief Initialize what every boot needs, the USART is left for
+  *        hw_usart_init() as it only serves upgrades
   * @retval None
   */
-void hw_init(ringbuf_t *usart_rx_buf)
+void hw_init(void)
 {
-    rx_buf = usart_rx_buf;
+#ifdef CONFIG_FLASH_RAMFUNC
+    copy_ramfuncs(); /** Before the first flash_program_block() */
+#endif // CONFIG_FLASH_RAMFUNC
     clock_init();
     systick_init();
     gpio_init();
+}
+
+/**
+  * @brief Initialize the USART, only needed for an upgrade
+  * @retval None
+  */
+void hw_usart_init(void)
+{
     usart_init();
 }
 
@@ -60,34 +80,53 @@ void hw_init(ringbuf_t *usart_rx_buf)
   */
 bool hw_check_forced_upgrade(void)
 {
-    /** What the heck? Without this delay we will always read "button pressed"
-      * for the first milli seconds or so. Constantly printing GPIO_IDR(PORTA)
-      * reveals it changes after some time on cold boots. */
+    /** What the heck? We will always read "button pressed" for the first
+      * milli seconds or so. Constantly printing GPIO_IDR(PORTA) reveals it
+      * changes after some time on cold boots. A released button is read
+      * right, so only a press is waited out. */
     static bool first_call = false;
     if (!first_call) {
-        delay_ms(100);
+        uint64_t timeout = get_ticks() + FORCED_UPGRADE_SETTLE_MS;
+        while (gpio_get(BUTTON_SEL_PORT, BUTTON_SEL_PIN) != BUTTON_SEL_PIN && get_ticks() < timeout) ;
         first_call = true;
     }
     return gpio_get(BUTTON_SEL_PORT, BUTTON_SEL_PIN) != BUTTON_SEL_PIN;
 }
 
-void usart1_isr(void)
+/**
+  * @brief Get the next received byte
+  * @param ch receives the byte
+  * @retval true if a byte was available
+  * @note Bytes are lost if the ring is overrun, the frame CRC catches that
+  */
+bool hw_usart_getc(uint8_t *ch)
 {
-    if ((USART_CR1(USART1) & USART_CR1_RXNEIE) != 0 &&
-        (USART_SR(USART1) & USART_SR_RXNE) != 0) {
-        uint16_t ch = usart_recv(USART1);
-        if ((USART_SR(USART1) & USART_SR_ORE) == 0 &&
-            (USART_SR(USART1) & USART_SR_FE) == 0 &&
-            (USART_SR(USART1) & USART_SR_PE) == 0) {
-            if (!ringbuf_put(rx_buf, ch)) {
-                //printf("ASSERT:usart1_isr:%d\n", __LINE__);
-            }
-        } else {
-            //printf("ASSERT:usart1_isr:%d\n", __LINE__);
-        }
+    uint32_t write_pos = USART_RX_RING_SIZE - DMA_CNDTR(DMA1, DMA_CHANNEL5);
+    if (write_pos == USART_RX_RING_SIZE) {
+        write_pos = 0;
+    }
+    if (rx_pos == write_pos) {
+        return false;
     }
+    *ch = rx_ring[rx_pos];
+    rx_pos = (rx_pos + 1) % USART_RX_RING_SIZE;
+    return true;
 }
 
+#ifdef CONFIG_FLASH_RAMFUNC
+/**
+  * @brief Copy the functions of the .ramfunc section to the internal SRAM
+  * @retval None
+  */
+static void copy_ramfuncs(void)
+{
+    uint32_t *src = &_ramfunc_loadaddr;
+    for (uint32_t *dst = &_ramfunc_start; dst < &_ramfunc_end; ) {
+        *dst++ = *src++;
+    }
+}
+#endif // CONFIG_FLASH_RAMFUNC
+
 /**
   * @brief Enable clocks
   * @retval None
@@ -110,10 +149,23 @@ static void clock_init(void)
 static void usart_init(void)
 {
     rcc_periph_clock_enable(RCC_USART1);
+    rcc_periph_clock_enable(RCC_DMA1);
     gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO_USART1_TX);
     gpio_set_mode(GPIOA, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT, GPIO_USART1_RX);
 
-    nvic_enable_irq(NVIC_USART1_IRQ);
+    /** DMA1 channel 5 moves every received byte from USART1_DR into rx_ring */
+    dma_channel_reset(DMA1, DMA_CHANNEL5);
+    dma_set_peripheral_address(DMA1, DMA_CHANNEL5, (uint32_t) &USART1_DR);
+    dma_set_memory_address(DMA1, DMA_CHANNEL5, (uint32_t) rx_ring);
+    dma_set_number_of_data(DMA1, DMA_CHANNEL5, sizeof(rx_ring));
+    dma_set_read_from_peripheral(DMA1, DMA_CHANNEL5);
+    dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL5);
+    dma_set_peripheral_size(DMA1, DMA_CHANNEL5, DMA_CCR_PSIZE_8BIT);
+    dma_set_memory_size(DMA1, DMA_CHANNEL5, DMA_CCR_MSIZE_8BIT);
+    dma_enable_circular_mode(DMA1, DMA_CHANNEL5);
+    dma_set_priority(DMA1, DMA_CHANNEL5, DMA_CCR_PL_HIGH);
+    dma_enable_channel(DMA1, DMA_CHANNEL5);
+
     usart_set_baudrate(USART1, CONFIG_BAUDRATE); /** Baudrate set in makefile */
     usart_set_databits(USART1, 8);
     usart_set_stopbits(USART1, USART_STOPBITS_1);
@@ -121,9 +173,7 @@ static void usart_init(void)
     usart_set_parity(USART1, USART_PARITY_NONE);
     usart_set_flow_control(USART1, USART_FLOWCONTROL_NONE);
 
-    // Enable USART1 Receive interrupt.
-    USART_CR1(USART1) |= USART_CR1_RXNEIE;
-
+    usart_enable_rx_dma(USART1);
     usart_enable(USART1);
 }
 
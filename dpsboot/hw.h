@@ -25,18 +25,43 @@
 #ifndef __HW_H__
 #define __HW_H__
 
-#include "ringbuf.h"
+#include <stdint.h>
+#include <stdbool.h>
 
 #define BUTTON_SEL_PORT GPIOA
 #define BUTTON_SEL_PIN  GPIO2
 
 
+/** Size of the USART RX DMA ring, must hold what arrives while a chunk is
+  * erased and programmed (~90ms at 115200 baud) */
+#ifndef USART_RX_RING_SIZE
+ #define USART_RX_RING_SIZE  (1024)
+#endif
+
+/** Longest time the SEL button may read pressed after a cold boot without
+  * being pressed */
+#ifndef FORCED_UPGRADE_SETTLE_MS
+ #define FORCED_UPGRADE_SETTLE_MS  (100)
+#endif
+
 /**
-  * @brief Initialize the hardware
-  * @param usart_rx_buf pointer to the USART RX ringbuffer
+  * @brief Initialize what every boot needs, clocks, SysTick and the button
   * @retval None
   */
-void hw_init(ringbuf_t *usart_rx_buf);
+void hw_init(void);
+
+/**
+  * @brief Initialize the USART, only needed for an upgrade
+  * @retval None
+  */
+void hw_usart_init(void);
+
+/**
+  * @brief Get the next received byte
+  * @param ch receives the byte
+  * @retval true if a byte was available
+  */
+bool hw_usart_getc(uint8_t *ch);
 
 /**
   * @brief Check if we are to enter forced upgrade
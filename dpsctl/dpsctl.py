@@ -38,24 +38,41 @@ time, add it tht the environment variable DPSIF.
 
 import argparse
 import codecs
+import concurrent.futures
+import copy
+import io
 import json
 import os
+import select
+import shlex
 import socket
+import struct
 import sys
 import threading
 import time
+import urllib.error
+import urllib.request
 import math
 
 calibration_debug_plotting = False  # Change this to True to enable plotting of the calibration graphs during dpsctl -C
 if calibration_debug_plotting:
     import matplotlib.pyplot as plt
 
+import lz
 import protocol
 import uframe
 from protocol import (create_cmd, create_enable_output, create_lock, create_set_calibration,
-                      create_set_function, create_set_parameter, create_temperature, create_set_brightness,
+                      create_set_function, create_set_parameter, create_set_setpoint, create_save_preset, create_recall_preset, create_stage_parameters, create_switch_function, create_temperature, create_set_brightness,
                       create_upgrade_data, create_upgrade_start, create_change_screen,
-                      unpack_cal_report, unpack_query_response, unpack_version_response)
+                      create_set_baudrate, create_stream_start, create_tagged, create_addressed, create_batch, create_schedule, create_record_start,
+                      create_record_dump, create_config_export, create_config_import, create_trip_snapshot, create_wave_upload, create_seq_upload, create_cal_report, create_cal_noise, create_cal_sweep, create_set_cal_lut, create_perf_report, create_isr_hooks, create_ocp_bench, create_ripple, create_lockin, create_energy_stats, create_link_stats, create_sched_stats, create_headless, create_adc_profile, create_subscribe, unpack_batch_response, unpack_cal_report, unpack_cal_noise, unpack_cal_data,
+                      unpack_event_stats, unpack_link_stats, unpack_sched_stats, unpack_headless, unpack_adc_profile, unpack_parameters_bin, unpack_query_response, unpack_record_dump, unpack_config_export, unpack_config_import,
+                      unpack_perf_report, unpack_isr_hooks, unpack_ocp_bench, unpack_ripple, unpack_lockin, unpack_load_stats, unpack_energy_stats, unpack_window_stats, unpack_boot_times, unpack_ram_stats, unpack_clock_sync, unpack_schedule_status, unpack_capabilities, unpack_log, unpack_notify, unpack_stream_data, unpack_tagged, unpack_addressed, unpack_trip_snapshot, unpack_version_response)
+
+try:
+    import numpy
+except ImportError:
+    numpy = None  # Calibration fits fall back to plain Python
 
 try:
     import serial
@@ -115,8 +132,15 @@ class tty_interface(comm_interface):
         return True
 
     def close(self):
-        self._port_handle.port.close()
-        self._port_handle = None
+        if self._port_handle:
+            self._port_handle.close()
+            self._port_handle = None
+        return True
+
+    def set_baudrate(self, baudrate):
+        self._baudrate = baudrate
+        if self._port_handle:
+            self._port_handle.baudrate = baudrate
         return True
 
     def write(self, bytes_):
@@ -152,42 +176,54 @@ class tcp_interface(comm_interface):
         super(tcp_interface, self).__init__(if_name)
 
         self._if_name = if_name
+        self._rx = bytearray()
 
     def open(self):
+        if self._socket:
+            return True  # Keep the connection for the following commands
         try:
             self._socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
             self._socket.settimeout(1.0)
+            self._socket.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
             self._socket.connect((self._if_name, 5005))
         except socket.error:
             return False
         return True
 
     def close(self):
-        self._socket.close()
-        self._socket = None
+        if self._socket:
+            self._socket.close()
+            self._socket = None
         return True
 
     def write(self, bytes_):
         try:
-            self._socket.send(bytes_)
+            self._socket.sendall(bytes_)
         except socket.error as msg:
-            fail("{} ({:d})".format(str(msg[0]), msg[1]))
+            fail(str(msg))
         return True
 
     def read(self):
-        bytes_ = bytearray()
-        sof = False
+        """
+        Return the next frame, the proxy may send several in one segment so
+        whatever follows it is kept for the next call
+        """
         while True:
-            b = self._socket.recv(1)
-            b = ord(b)
-            if b == uframe._SOF:
-                bytes_ = bytearray()
-                sof = True
-            if sof:
-                bytes_.append(b)
-            if b == uframe._EOF:
-                break
-        return bytes_
+            eof = self._rx.find(uframe._EOF)
+            if eof >= 0:
+                frame = self._rx[:eof + 1]
+                del self._rx[:eof + 1]
+                sof = frame.rfind(uframe._SOF)
+                if sof >= 0:
+                    return frame[sof:]
+                continue
+            try:
+                d = self._socket.recv(1024)
+            except socket.timeout:
+                return bytearray()
+            if not d:
+                fail("connection closed by proxy")
+            self._rx += d
 
 
 class udp_interface(comm_interface):
@@ -201,8 +237,12 @@ class udp_interface(comm_interface):
         super(udp_interface, self).__init__(if_name)
 
         self._if_name = if_name
+        address, _, port = if_name.partition(':')
+        self._address = (address, int(port) if port else 5005)
 
     def open(self):
+        if self._socket:
+            return True  # Keep the socket for the following commands
         try:
             self._socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
             self._socket.settimeout(1.0)
@@ -211,13 +251,14 @@ class udp_interface(comm_interface):
         return True
 
     def close(self):
-        self._socket.close()
-        self._socket = None
+        if self._socket:
+            self._socket.close()
+            self._socket = None
         return True
 
     def write(self, bytes_):
         try:
-            self._socket.sendto(bytes_, (self._if_name, 5005))
+            self._socket.sendto(bytes_, self._address)
         except socket.error as msg:
             fail("{} ({:d})".format(str(msg[0]), msg[1]))
         return True
@@ -235,6 +276,115 @@ class udp_interface(comm_interface):
         return reply
 
 
+class bus_interface(comm_interface):
+    """
+    Talks to one unit on a serial line shared by several, see cmd_addressed.
+    Frames written are wrapped in its address and only its responses are
+    read, with the envelope removed.
+    """
+
+    def __init__(self, comms, address):
+        super(bus_interface, self).__init__(comms.name())
+        self._comms = comms
+        self._address = address
+
+    def __getattr__(self, name):
+        return getattr(self._comms, name)
+
+    def open(self):
+        return self._comms.open()
+
+    def close(self):
+        return self._comms.close()
+
+    def write(self, bytes_):
+        f = uframe.uFrame()
+        f.set_frame(bytearray(bytes_))
+        return self._comms.write(create_addressed(self._address, f).get_frame())
+
+    def read(self):
+        while True:
+            bytes_ = self._comms.read()
+            if len(bytes_) == 0:
+                return bytes_
+            f = uframe.uFrame()
+            if f.set_frame(bytes_) < 0:
+                continue
+            addressed = unpack_addressed(f)
+            if not addressed or addressed[0] != self._address:
+                continue  # Our own echo or some other unit's response
+            resp = uframe.uFrame()
+            resp.pack_bytes(addressed[1].get_frame())
+            resp.end()
+            return resp.get_frame()
+
+
+class capture_interface(comm_interface):
+    """
+    Records every frame written to and read from a device in the capture
+    format the emulator replays with dpsemu -r, see emu/replay.h:
+
+        <time us> > <hex bytes>     sent to the device
+        <time us> < <hex bytes>     received from the device
+    """
+
+    def __init__(self, comms, file_name):
+        super(capture_interface, self).__init__(comms.name())
+        self._comms = comms
+        try:
+            self._file = open(file_name, 'w')
+        except OSError as e:
+            fail("could not create {}: {}".format(file_name, e.strerror))
+        self._file.write("# OpenDPS capture of {}\n".format(comms.name()))
+        self._start = time.perf_counter()
+
+    def __getattr__(self, name):
+        return getattr(self._comms, name)
+
+    def _record(self, direction, bytes_):
+        t_us = int((time.perf_counter() - self._start) * 1000000)
+        self._file.write("{:d} {} {}\n".format(t_us, direction, bytes(bytes_).hex()))
+        self._file.flush()
+
+    def open(self):
+        return self._comms.open()
+
+    def close(self):
+        return self._comms.close()
+
+    def write(self, bytes_):
+        self._record('>', bytes_)
+        return self._comms.write(bytes_)
+
+    def read(self):
+        bytes_ = self._comms.read()
+        if len(bytes_) > 0:
+            self._record('<', bytes_)
+        return bytes_
+
+
+class session(object):
+    """
+    Keeps the transport to a device open for a series of commands, the serial
+    port or socket is opened once instead of per command:
+
+        with session(create_comms(args)) as comms:
+            communicate(comms, create_cmd(protocol.CMD_QUERY), args)
+    """
+
+    def __init__(self, comms):
+        self._comms = comms
+
+    def __enter__(self):
+        if not self._comms.open():
+            fail("could not open {}".format(self._comms.name()))
+        return self._comms
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self._comms.close()
+        return False
+
+
 def fail(message):
     """
     Print error message and exit with error
@@ -299,7 +449,7 @@ def handle_response(command, frame, args, quiet=False):
         success = frame.get_frame()[1]
         if resp_command != command:
             print("Warning: sent command {:02x}, response was {:02x}.".format(command, resp_command))
-        if resp_command != protocol.CMD_UPGRADE_START and resp_command != protocol.CMD_UPGRADE_DATA and not success:
+        if resp_command not in (protocol.CMD_UPGRADE_START, protocol.CMD_UPGRADE_DATA, protocol.CMD_CONFIG_IMPORT) and not success:
             fail("command failed according to device")
 
     if args.json:
@@ -337,10 +487,18 @@ def handle_response(command, frame, args, quiet=False):
         chunk_size = frame.unpack16()
         ret_dict["status"] = status
         ret_dict["chunk_size"] = chunk_size
+        if len(frame.get_frame()) >= 6:
+            reason = frame.unpack8()
+            ret_dict["caps"] = frame.unpack8()
+        if len(frame.get_frame()) >= 12:
+            ret_dict["resume_offset"] = frame.unpack32()
+            ret_dict["resume_crc"] = frame.unpack16()
     elif resp_command == protocol.CMD_UPGRADE_DATA:
         cmd = frame.unpack8()
         status = frame.unpack8()
         ret_dict["status"] = status
+        if len(frame.get_frame()) >= 6:
+            ret_dict["offset"] = frame.unpack32()
     elif resp_command == protocol.CMD_SET_FUNCTION:
         cmd = frame.unpack8()
         status = frame.unpack8()
@@ -428,13 +586,110 @@ def handle_response(command, frame, args, quiet=False):
         print("BootDPS GIT Hash: {}".format(data['boot_git_hash']))
         print("OpenDPS GIT Hash: {}".format(data['app_git_hash']))
     elif resp_command == protocol.CMD_CAL_REPORT:
-        ret_dict = unpack_cal_report(frame)
+        # An averaged report is only acknowledged, the readings follow in a CMD_CAL_DATA frame
+        if len(frame.get_frame()) == protocol.CAL_NOISE_LENGTH:
+            ret_dict = unpack_cal_noise(frame)
+        elif len(frame.get_frame()) > 2:
+            ret_dict = unpack_cal_report(frame)
+    elif resp_command == protocol.CMD_CAL_SWEEP or resp_command == protocol.CMD_SET_CAL_LUT:
+        pass
     elif resp_command == protocol.CMD_CLEAR_CALIBRATION:
         pass
     elif resp_command == protocol.CMD_CHANGE_SCREEN:
         pass
     elif resp_command == protocol.CMD_SET_BRIGHTNESS:
         pass
+    elif resp_command == protocol.CMD_STREAM_START:
+        pass
+    elif resp_command == protocol.CMD_STREAM_STOP:
+        pass
+    elif resp_command == protocol.CMD_SET_BAUDRATE:
+        pass
+    elif resp_command == protocol.CMD_BATCH:
+        ret_dict["status"] = unpack_batch_response(frame)
+    elif resp_command == protocol.CMD_SET_PARAMETERS_BIN:
+        cmd = frame.unpack8()
+        status = frame.unpack8()
+        ret_dict["status"] = list(frame.get_frame()[2:])
+    elif resp_command == protocol.CMD_GET_PARAMETERS_BIN:
+        ret_dict["values"] = unpack_parameters_bin(frame)
+    elif resp_command == protocol.CMD_RECORD_START:
+        pass
+    elif resp_command == protocol.CMD_RECORD_DUMP:
+        ret_dict = unpack_record_dump(frame)
+    elif resp_command == protocol.CMD_CONFIG_EXPORT:
+        ret_dict = unpack_config_export(frame)
+    elif resp_command == protocol.CMD_CONFIG_IMPORT:
+        ret_dict = unpack_config_import(frame)
+    elif resp_command == protocol.CMD_TRIP_SNAPSHOT:
+        ret_dict = unpack_trip_snapshot(frame)
+    elif resp_command == protocol.CMD_EVENT_STATS:
+        ret_dict = unpack_event_stats(frame)
+    elif resp_command == protocol.CMD_LINK_STATS:
+        ret_dict = unpack_link_stats(frame)
+    elif resp_command == protocol.CMD_SCHED_STATS:
+        ret_dict = unpack_sched_stats(frame)
+    elif resp_command == protocol.CMD_HEADLESS:
+        ret_dict = unpack_headless(frame)
+    elif resp_command == protocol.CMD_ADC_PROFILE:
+        ret_dict = unpack_adc_profile(frame)
+    elif resp_command == protocol.CMD_PERF_REPORT:
+        ret_dict = unpack_perf_report(frame)
+    elif resp_command == protocol.CMD_ISR_HOOKS:
+        ret_dict = unpack_isr_hooks(frame)
+    elif resp_command == protocol.CMD_OCP_BENCH:
+        ret_dict = unpack_ocp_bench(frame)
+    elif resp_command == protocol.CMD_RIPPLE:
+        ret_dict = unpack_ripple(frame)
+    elif resp_command == protocol.CMD_LOCKIN:
+        ret_dict = unpack_lockin(frame)
+    elif resp_command == protocol.CMD_LOAD_STATS:
+        ret_dict = unpack_load_stats(frame)
+    elif resp_command == protocol.CMD_ENERGY_STATS:
+        ret_dict = unpack_energy_stats(frame)
+    elif resp_command == protocol.CMD_WINDOW_STATS:
+        ret_dict = unpack_window_stats(frame)
+    elif resp_command == protocol.CMD_BOOT_TIMES:
+        ret_dict = unpack_boot_times(frame)
+    elif resp_command == protocol.CMD_RAM_STATS:
+        ret_dict = unpack_ram_stats(frame)
+    elif resp_command == protocol.CMD_CLOCK_SYNC:
+        ret_dict = unpack_clock_sync(frame)
+    elif resp_command == protocol.CMD_SCHEDULE:
+        cmd = frame.unpack8()
+        status = frame.unpack8()
+        ret_dict["slot"] = frame.unpack8()
+    elif resp_command == protocol.CMD_SCHEDULE_STATUS:
+        ret_dict = unpack_schedule_status(frame)
+    elif resp_command == protocol.CMD_SCHEDULE_CANCEL:
+        pass
+    elif resp_command == protocol.CMD_CAPABILITIES:
+        ret_dict = unpack_capabilities(frame)
+    elif resp_command == protocol.CMD_SUBSCRIBE:
+        cmd = frame.unpack8()
+        status = frame.unpack8()
+        ret_dict["mask"] = frame.unpack16()
+    elif resp_command == protocol.CMD_SAVE_PRESET:
+        if not quiet:
+            print("Preset saved")
+    elif resp_command == protocol.CMD_RECALL_PRESET:
+        cmd = frame.unpack8()
+        status = frame.unpack8()
+        ret_dict["status"] = frame.unpack8()
+    elif resp_command == protocol.CMD_STAGE_PARAMETERS:
+        cmd = frame.unpack8()
+        ret_dict["ok"] = frame.unpack8()
+        ret_dict["param_status"] = list(frame.get_frame()[2:])
+    elif resp_command == protocol.CMD_SWITCH_FUNCTION:
+        cmd = frame.unpack8()
+        ret_dict["ok"] = frame.unpack8()
+        ret_dict["status"] = frame.unpack8() if ret_dict["ok"] else None
+    elif resp_command == protocol.CMD_SET_SETPOINT:
+        cmd = frame.unpack8()
+        status = frame.unpack8()
+        ret_dict["status"] = frame.unpack8()
+    elif resp_command == protocol.CMD_WAVE_UPLOAD or resp_command == protocol.CMD_SEQ_UPLOAD:
+        pass
     else:
         print("Unknown response {:d} from device.".format(resp_command))
 
@@ -444,35 +699,300 @@ def handle_response(command, frame, args, quiet=False):
     return ret_dict
 
 
-def communicate(comms, frame, args, quiet=False):
+# Clock sync exchanges made to estimate the offset of a device clock
+CLOCK_SYNC_EXCHANGES = 8
+
+# Id of the next command sent as a message
+_next_msg_id = 0
+
+# Times a message fragment window is sent again before giving up
+MSG_RETRIES = 3
+
+
+def write_frame(comms, frame, args):
     """
-    Communicate with the DPS device according to the user's wishes
+    Send a frame to the device
     """
     bytes_ = frame.get_frame()
+    if args.verbose:
+        print("TX {:2d} bytes [{}]".format(len(bytes_), " ".join("{:02x}".format(b) for b in bytes_)))
+    if not comms.write(bytes_):
+        fail("write failed on {}".format(comms.name()))
+
+
+def exchange(comms, frame, args):
+    """
+    Send a frame and return the response, None on timeout
+    """
+    write_frame(comms, frame, args)
+    while True:
+        resp = comms.read()
+        if len(resp) == 0:
+            return None
+        if args.verbose:
+            print("RX {:2d} bytes [{}]\n".format(len(resp), " ".join("{:02x}".format(b) for b in resp)))
+        f = uframe.uFrame()
+        res = f.set_frame(resp)
+        if res < 0:
+            fail("protocol error ({:d})".format(res))
+        # Skip frames the device sent on its own, eg. debug log entries
+        if f.get_frame()[0] & protocol.CMD_RESPONSE:
+            return f
+
+
+def send_message(comms, frame, args):
+    """
+    Send a command too large for one frame as fragments and return the
+    response to the command, None on timeout
+    """
+    global _next_msg_id
+    payload = uframe.uFrame()
+    payload.set_frame(bytearray(frame.get_frame()))
+    if len(payload.get_frame()) > protocol.MSG_MAX_COMMAND:
+        fail("command of {:d} bytes is too large".format(len(payload.get_frame())))
+    msg = uframe.uMessage(_next_msg_id, payload.get_frame())
+    _next_msg_id = (_next_msg_id + 1) & 0xff
+    retries = 0
+    while True:
+        last = min(msg.next + protocol.MSG_WINDOW, msg.fragments())
+        for index in range(msg.next, last - 1):
+            write_frame(comms, protocol.create_fragment(msg, index), args)
+        resp = exchange(comms, protocol.create_fragment(msg, last - 1, uframe.FRAG_ACK), args)
+        if resp and resp.get_frame()[0] == protocol.CMD_RESPONSE | protocol.CMD_FRAGMENT_ACK:
+            msg_id, next_ = protocol.unpack_fragment_ack(resp)
+            if msg_id == msg.id and msg.ack(msg_id, next_) and next_ < msg.fragments():
+                retries = 0
+                continue
+        if resp:
+            return resp
+        retries += 1
+        if retries > MSG_RETRIES:
+            return None
+
+
+def receive_message(comms, first, args):
+    """
+    Collect a response sent as fragments, first is the first one received.
+    Return the response put back together, None on timeout
+    """
+    msg = uframe.uMessage()
+    f = first
+    retries = 0
+    while True:
+        if f and f.get_frame()[0] == protocol.CMD_RESPONSE | protocol.CMD_FRAGMENT:
+            f.unpack8()
+            status = msg.receive_fragment(f)
+            if status == uframe.MSG_COMPLETE:
+                resp = uframe.uFrame()
+                resp.set_payload(msg.payload)
+                return resp
+            if status < 0:
+                fail("malformed response fragment")
+            retries = 0
+            if status != uframe.MSG_ACK:
+                f = read_frame(comms)
+                continue
+        elif f:
+            f = read_frame(comms)  # Not ours, eg. stream data
+            continue
+        else:
+            retries += 1
+            if retries > MSG_RETRIES:
+                return None
+        f = exchange(comms, protocol.create_fragment_ack(msg.id, msg.next), args)
+
 
+def communicate(comms, frame, args, quiet=False):
+    """
+    Communicate with the DPS device according to the user's wishes
+    """
     if not comms:
         fail("no communication interface specified")
     if not comms.open():
         fail("could not open {}".format(comms.name()))
     if args.verbose:
         print("Communicating with {}".format(comms.name()))
-        print("TX {:2d} bytes [{}]".format(len(bytes_), " ".join("{:02x}".format(b) for b in bytes_)))
-    if not comms.write(bytes_):
-        fail("write failed on {}".format(comms.name()))
-    resp = comms.read()
-    if len(resp) == 0:
+    if len(frame.get_frame()) > uframe.MAX_FRAME_LENGTH:
+        f = send_message(comms, frame, args)
+    else:
+        f = exchange(comms, frame, args)
+    if f and f.get_frame()[0] == protocol.CMD_RESPONSE | protocol.CMD_FRAGMENT:
+        f = receive_message(comms, f, args)
+    if not f:
         fail("timeout talking to device {}".format(comms._if_name))
-    elif args.verbose:
-        print("RX {:2d} bytes [{}]\n".format(len(resp), " ".join("{:02x}".format(b) for b in resp)))
-    if not comms.close:
-        print("Warning: could not close {}".format(comms.name()))
 
-    f = uframe.uFrame()
-    res = f.set_frame(resp)
-    if res < 0:
-        fail("protocol error ({:d})".format(res))
+    return handle_response(frame.get_frame()[1], f, args, quiet)
+
+
+def communicate_tagged(comms, frames, args, quiet=False):
+    """
+    Send all frames before reading any response, each wrapped in a tagged
+    envelope so the responses can be matched in whatever order they arrive.
+    Return a list of handle_response() results in the order of frames.
+    """
+    if not comms:
+        fail("no communication interface specified")
+    if not comms.open():
+        fail("could not open {}".format(comms.name()))
+    for tag, frame in enumerate(frames):
+        bytes_ = create_tagged(tag, frame).get_frame()
+        if args.verbose:
+            print("TX {:2d} bytes [{}]".format(len(bytes_), " ".join("{:02x}".format(b) for b in bytes_)))
+        if not comms.write(bytes_):
+            fail("write failed on {}".format(comms.name()))
+    results = [None] * len(frames)
+    pending = set(range(len(frames)))
+    while pending:
+        f = read_frame(comms)
+        if not f:
+            fail("timeout talking to device {}".format(comms._if_name))
+        tagged = unpack_tagged(f)
+        if not tagged or tagged[0] not in pending:
+            continue  # Not a response to one of ours, eg. stream data
+        tag, resp = tagged
+        pending.remove(tag)
+        results[tag] = handle_response(frames[tag].get_frame()[1], resp, args, quiet)
+    return results
+
+
+class fleet_stdout(object):
+    """
+    Stand-in for sys.stdout while fleet workers run, writes from a worker
+    thread go to that worker's buffer and everything else to the real stdout
+    """
+    def __init__(self, stdout):
+        self._stdout = stdout
+        self._local = threading.local()
+        self._lock = threading.Lock()
+
+    def capture(self, buffer, prefix=None):
+        """
+        Send the writes of this thread to buffer, or to the real stdout a
+        line at a time with prefix at the start of each line
+        """
+        self._local.buffer = buffer
+        self._local.prefix = prefix
+        self._local.pending = ""
+        self._local.line_start = True
+
+    def _emit(self, text):
+        """
+        Write prefixed text to the real stdout, whole lines do not mix with
+        the output of other threads
+        """
+        out = ""
+        for line in text.splitlines(True):
+            if self._local.line_start:
+                out += self._local.prefix
+            out += line
+            self._local.line_start = line.endswith("\n")
+        with self._lock:
+            self._stdout.write(out)
+            self._stdout.flush()
+
+    def write(self, text):
+        buffer = getattr(self._local, 'buffer', None)
+        if getattr(self._local, 'prefix', None) and not buffer:
+            lines = self._local.pending + text
+            end = lines.rfind("\n") + 1
+            self._local.pending = lines[end:]
+            if end:
+                self._emit(lines[:end])
+            return len(text)
+        return (buffer or self._stdout).write(text)
+
+    def flush(self):
+        buffer = getattr(self._local, 'buffer', None)
+        if getattr(self._local, 'prefix', None) and not buffer:
+            if self._local.pending:
+                self._emit(self._local.pending)
+                self._local.pending = ""
+            return
+        (buffer or self._stdout).flush()
+
+
+def fleet_devices(args):
+    """
+    Return the devices given with --fleet, a comma separated list, @file with
+    one device per line or 'scan' for the devices found by uhej_scan()
+    """
+    if args.fleet == 'scan':
+        return uhej_scan(quiet=True, rescan=args.rescan)
+    if args.fleet.startswith('@'):
+        try:
+            with open(args.fleet[1:]) as f:
+                lines = [line.split('#')[0].strip() for line in f]
+        except IOError as e:
+            fail("could not read {}: {}".format(args.fleet[1:], e.strerror))
+        return [line for line in lines if line]
+    return [d.strip() for d in args.fleet.split(',') if d.strip()]
+
+
+def run_fleet_device(device, args, output):
+    """
+    Run the commands against one device of the fleet, return True on success
+    """
+    if args.calibrate:
+        # The operator answers the prompts as the devices get to them, show them live
+        sys.stdout.capture(None, "[{}] ".format(device))
     else:
-        return handle_response(frame.get_frame()[1], f, args, quiet)
+        sys.stdout.capture(output)
+    device_args = copy.copy(args)
+    device_args.device = device
+    device_args.fleet = None
+    try:
+        handle_commands(device_args)
+        return True
+    except SystemExit:
+        return False  # fail() was called, the reason is in the output
+    except Exception as e:
+        print("Error: {}.".format(e))
+        return False
+    finally:
+        sys.stdout.capture(None)
+
+
+def run_fleet(args):
+    """
+    Run the requested commands against all devices of the fleet concurrently
+    and print the aggregated results in the order the devices were given
+    """
+    if args.stream or args.notify or args.debug_log or args.heartbeat or args.serve:
+        fail("streaming, notifications, the heartbeat, serving and the debug log are not available in fleet mode")
+    if args.log and ("{device}" not in args.log or not args.log_duration):
+        fail("logging in fleet mode needs {device} in the file name and a --log-duration")
+    if args.config_export and "{device}" not in args.config_export:
+        fail("exporting settings in fleet mode needs {device} in the file name")
+    if args.capture and "{device}" not in args.capture:
+        fail("capturing in fleet mode needs {device} in the file name")
+    devices = fleet_devices(args)
+    if not devices:
+        fail("no devices in the fleet")
+    if args.at is not None:
+        # One host time for all devices, each converts it to its own clock
+        args.at_time = time.monotonic() + args.at
+    outputs = [io.StringIO() for _ in devices]
+    real_stdout = sys.stdout
+    sys.stdout = fleet_stdout(real_stdout)
+    try:
+        with concurrent.futures.ThreadPoolExecutor(max_workers=max(1, args.fleet_jobs)) as executor:
+            futures = [executor.submit(run_fleet_device, device, args, output) for device, output in zip(devices, outputs)]
+            results = [future.result() for future in futures]
+    finally:
+        sys.stdout = real_stdout
+
+    num_failed = results.count(False)
+    if args.json:
+        print(json.dumps({device: {'ok': ok, 'output': output.getvalue()} for device, ok, output in zip(devices, results, outputs)}))
+    else:
+        for device, ok, output in zip(devices, results, outputs):
+            print("=== {} ({}) ===".format(device, "ok" if ok else "FAILED"))
+            text = output.getvalue()
+            if text:
+                print(text.rstrip("\n"))
+        print("{:d} of {:d} devices ok".format(len(devices) - num_failed, len(devices)))
+    if num_failed:
+        sys.exit(1)
 
 
 def handle_commands(args):
@@ -480,10 +1000,35 @@ def handle_commands(args):
     Communicate with the DPS device according to the user's wishes
     """
     if args.scan:
-        uhej_scan()
+        uhej_scan(rescan=args.rescan)
+        return
+
+    if args.discovery_daemon:
+        run_discovery_daemon()
         return
 
-    comms = create_comms(args)
+    if args.fleet:
+        run_fleet(args)
+        return
+
+    if args.proxy_upgrade:
+        run_proxy_upgrade(args)
+        return
+
+    with session(create_comms(args)) as comms:
+        run_commands(comms, args)
+        if args.shell or args.script:
+            run_shell(comms, args)
+        if args.serve:
+            run_serve(comms, args)
+
+
+def run_commands(comms, args):
+    """
+    Run the commands given in args against the device on comms
+    """
+    if args.negotiate_baudrate:
+        negotiate_baudrate(comms, args)
 
     if args.ping:
         communicate(comms, create_cmd(protocol.CMD_PING), args)
@@ -505,97 +1050,1458 @@ def handle_commands(args):
     if args.function:
         communicate(comms, create_set_function(args.function), args)
 
-    if args.enable:
+    if args.at is not None:
+        run_scheduled(comms, args)
+
+    if args.enable and args.at is None:
         if args.enable == 'on' or args.enable == 'off':
             communicate(comms, create_enable_output(args.enable), args)
         else:
             fail("enable is 'on' or 'off'")
 
-    if args.parameter:
+    if args.parameter and args.at is None:
         payload = create_set_parameter(args.parameter)
         if payload:
             communicate(comms, payload, args)
         else:
             fail("malformed parameters")
 
-    if args.query:
-        communicate(comms, create_cmd(protocol.CMD_QUERY), args)
+    if args.setpoint and args.at is None:
+        run_setpoint(comms, args)
+
+    if args.save_preset is not None:
+        communicate(comms, create_save_preset(args.save_preset), args)
+
+    if args.recall_preset is not None:
+        data = communicate(comms, create_recall_preset(args.recall_preset), args, quiet=True)
+        if data['status'] != 0:
+            fail("preset recalled but a setting was rejected with error {:d}".format(data['status']))
+
+    if args.stage:
+        payload = create_stage_parameters(args.stage[0], args.stage[1:])
+        if not payload:
+            fail("malformed parameters")
+        data = communicate(comms, payload, args, quiet=True)
+        if not data['ok']:
+            fail("unknown function {} or device built without FUNC_STAGING=1".format(args.stage[0]))
+        for p, status in zip(args.stage[1:], data['param_status']):
+            if status != 0:
+                fail("{} has no parameter {}".format(args.stage[0], p.split("=")[0].strip()))
+
+    if args.switch_function is not None:
+        data = communicate(comms, create_switch_function(args.switch_function), args, quiet=True)
+        if not data['ok']:
+            fail("no function {:d}, output locked by temperature or device built without FUNC_STAGING=1".format(args.switch_function))
+        if data['status'] != 0:
+            fail("function selected but a staged setting was rejected with error {:d}".format(data['status']))
+
+    if args.clock_sync:
+        offset_us, rtt_us = clock_sync(comms, args)
+        if args.json:
+            print(json.dumps({'offset_us': offset_us, 'rtt_us': rtt_us}))
+        else:
+            print("Device clock is {:.0f} us ahead of the host clock, +/- {:.0f} us (round trip {:.0f} us)".format(offset_us, rtt_us / 2, rtt_us))
+
+    if args.schedule_status:
+        run_schedule_status(comms, args)
+
+    if args.schedule_cancel:
+        communicate(comms, create_cmd(protocol.CMD_SCHEDULE_CANCEL), args)
+
+    if args.query:
+        communicate(comms, create_cmd(protocol.CMD_QUERY), args)
+
+    if args.version:
+        communicate(comms, create_cmd(protocol.CMD_VERSION), args)
+
+    if args.calibration_report:
+        data = communicate(comms, create_cmd(protocol.CMD_CAL_REPORT), args)
+        print("Calibration Report:")
+        print("\tA_ADC_K = {}".format(data['cal']['A_ADC_K']))
+        print("\tA_ADC_C = {}".format(data['cal']['A_ADC_C']))
+        print("\tA_DAC_K = {}".format(data['cal']['A_DAC_K']))
+        print("\tA_DAC_C = {}".format(data['cal']['A_DAC_C']))
+        print("\tV_ADC_K = {}".format(data['cal']['V_ADC_K']))
+        print("\tV_ADC_C = {}".format(data['cal']['V_ADC_C']))
+        print("\tV_DAC_K = {}".format(data['cal']['V_DAC_K']))
+        print("\tV_DAC_C = {}".format(data['cal']['V_DAC_C']))
+        print("\tVIN_ADC_K = {}".format(data['cal']['VIN_ADC_K']))
+        print("\tVIN_ADC_C = {}".format(data['cal']['VIN_ADC_C']))
+        print("\tVIN_ADC = {}".format(data['vin_adc']))
+        print("\tVOUT_ADC = {}".format(data['vout_adc']))
+        print("\tIOUT_ADC = {}".format(data['iout_adc']))
+        print("\tIOUT_DAC = {}".format(data['iout_dac']))
+        print("\tVOUT_DAC = {}".format(data['vout_dac']))
+
+    if args.calibration_set:
+        payload = create_set_calibration(args.calibration_set)
+        if payload:
+            communicate(comms, payload, args)
+        else:
+            fail("malformed parameters")
+
+    if hasattr(args, 'temperature') and args.temperature:
+        communicate(comms, create_temperature(float(args.temperature)), args)
+
+    if args.calibration_reset:
+        communicate(comms, create_cmd(protocol.CMD_CLEAR_CALIBRATION), args)
+
+    if args.switch_screen:
+        if (args.switch_screen.lower() == "main"):
+            communicate(comms, create_change_screen(protocol.CHANGE_SCREEN_MAIN), args)
+        elif (args.switch_screen.lower() == "settings"):
+            communicate(comms, create_change_screen(protocol.CHANGE_SCREEN_SETTINGS), args)
+        else:
+            fail("please specify either 'settings' or 'main' as parameters")
+
+    if args.calibrate:
+        do_calibration(comms, args)
+
+    if args.brightness:
+        if args.brightness >=0 and args.brightness <=100:
+            communicate(comms, create_set_brightness(args.brightness), args)
+        else:
+            fail("brightness must be between 0 and 100")
+
+    if args.headless:
+        flags = None
+        if args.headless != 'status':
+            flags = protocol.HEADLESS_ENABLE if args.headless == 'on' else 0
+            if args.headless_store:
+                flags |= protocol.HEADLESS_STORE
+        data = communicate(comms, create_headless(flags), args, quiet=True)
+        if not data or not data['status']:
+            fail("headless mode is not supported, build with HEADLESS=1")
+        if args.json:
+            print(json.dumps({'headless': data['headless']}))
+        else:
+            print("Headless mode is {}".format("on" if data['headless'] else "off"))
+
+    if args.adc_profile:
+        profile = None
+        if args.adc_profile != 'status':
+            profile = protocol.ADC_PROFILES.index(args.adc_profile)
+        data = communicate(comms, create_adc_profile(profile, args.adc_profile_store), args, quiet=True)
+        if not data or not data['status']:
+            fail("ADC profiles are not supported, build with ADC_PROFILES=1")
+        if args.json:
+            print(json.dumps({'profile': data['profile'], 'rate_hz': data['rate_hz'], 'decimation': data['decimation']}))
+        else:
+            print("ADC profile {}: {} sample sets/s, {} per measurement".format(data['profile'], data['rate_hz'], data['decimation']))
+
+    if args.record:
+        triggers = 0
+        for t in args.record.split(","):
+            if t not in protocol.RECORDER_TRIGGERS:
+                fail("record triggers are {}".format(", ".join(protocol.RECORDER_TRIGGERS)))
+            triggers |= protocol.RECORDER_TRIGGERS[t]
+        communicate(comms, create_record_start(7, args.record_decimation, args.record_post, triggers), args)
+
+    if args.record_dump:
+        run_record_dump(comms, args)
+
+    if args.trip_snapshot:
+        run_trip_snapshot(comms, args)
+
+    if args.event_stats:
+        data = communicate(comms, create_cmd(protocol.CMD_EVENT_STATS), args, quiet=True)
+        if args.json:
+            print(json.dumps(data['sources']))
+        else:
+            print("Event queues:")
+            for name, stats in data['sources'].items():
+                print("\t{:8s} {:d} dropped, peak {:d}/{:d}".format(name, stats['drops'], stats['peak'], stats['size']))
+
+    if args.link_stats or args.link_stats_reset:
+        data = communicate(comms, create_link_stats(args.link_stats_reset), args, quiet=True)
+        if not args.link_stats:
+            pass  # Only clearing
+        elif args.json:
+            print(json.dumps({name: data[name] for name in protocol.LINK_COUNTERS}))
+        else:
+            print("Serial link:")
+            print("\tframes    {:d} received, {:d} CRC errors, {:d} bad length, {:d} cut off".format(
+                data['frames'], data['crc'], data['length'], data['aborted']))
+            print("\tcommands  {:d} rejected, {:d} responses dropped".format(data['rejected'], data['tx_dropped']))
+            print("\tUSART     {:d} overruns, {:d} noise or framing errors, {:d} bytes dropped".format(
+                data['overrun'], data['noise'], data['rx_dropped']))
+            print("\ttimeouts  {:d} baud rate fallbacks".format(data['timeouts']))
+            print("\tevents    {:d} dropped".format(data['events']))
+
+    if args.sched_stats or args.sched_stats_reset:
+        data = communicate(comms, create_sched_stats(args.sched_stats_reset), args, quiet=True)
+        if not args.sched_stats:
+            pass  # Only clearing
+        elif args.json:
+            print(json.dumps(data['jobs']))
+        else:
+            print("Scheduled jobs:")
+            for name, job in data['jobs'].items():
+                print("\t{:8s} {:d} runs, {:d} missed {:d} ms, worst {:.1f} ms late, ran {:.1f} ms{}".format(
+                    name, job['runs'], job['misses'], job['deadline_ms'], job['late_max_us'] / 1000,
+                    job['run_max_us'] / 1000, " (critical)" if job['critical'] else ""))
+
+    if args.perf or args.perf_reset:
+        run_perf_report(comms, args)
+
+    if args.isr_hooks or args.isr_hooks_reset:
+        run_isr_hooks(comms, args)
+
+    if args.cal_noise:
+        run_cal_noise(comms, args)
+
+    if args.ocp_bench:
+        run_ocp_bench(comms, args)
+
+    if args.ripple:
+        run_ripple(comms, args)
+
+    if args.impedance:
+        run_impedance(comms, args)
+
+    if args.load_stats:
+        data = communicate(comms, create_cmd(protocol.CMD_LOAD_STATS), args, quiet=True)
+        if not data['status']:
+            fail("device does not support load metering (built without LOAD_METER=1)")
+        if args.json:
+            print(json.dumps({k: v for k, v in data.items() if k not in ('command', 'status')}))
+        else:
+            print("CPU load over {:d} ms:".format(data['window_ms']))
+            print("\tidle      {:.1f}%".format(data['idle']))
+            print("\tADC ISR   {:.1f}%, longest {:d} us".format(data['isr'], data['isr_max_us']))
+            print("\tISR runs  {:d}, {:d} overruns".format(data['isr_calls'], data['overruns']))
+
+    if args.energy or args.energy_reset:
+        data = communicate(comms, create_energy_stats(args.energy_reset), args, quiet=True)
+        if not data['status']:
+            fail("device does not support energy metering (built without ENERGY_METER=1)")
+        if not args.energy:
+            pass  # Only clearing
+        elif args.json:
+            print(json.dumps({k: v for k, v in data.items() if k not in ('command', 'status')}))
+        else:
+            print("Delivered in {:.1f} s with the output on:".format(data['runtime']))
+            print("\tcharge    {:.6f} Ah".format(data['charge']))
+            print("\tenergy    {:.6f} Wh".format(data['energy']))
+
+    if args.window_stats:
+        data = communicate(comms, create_cmd(protocol.CMD_WINDOW_STATS), args, quiet=True)
+        if not data['status']:
+            fail("device does not support window statistics (built without WINDOW_STATS=1)")
+        if args.json:
+            print(json.dumps({k: v for k, v in data.items() if k not in ('command', 'status')}))
+        else:
+            print("{:d} samples over {:d} ms:".format(data['samples'], data['window_ms']))
+            for name, unit in (('i_out', 'mA'), ('v_out', 'mV')):
+                s = data[name]
+                print("\t{:5s}  min {:5d}  max {:5d}  mean {:5d}  rms {:7.1f} {}".format(name, s['min'], s['max'], s['mean'], s['rms'], unit))
+
+    if args.boot_times:
+        data = communicate(comms, create_cmd(protocol.CMD_BOOT_TIMES), args, quiet=True)
+        if not data['status']:
+            fail("device does not support boot times")
+        if args.json:
+            print(json.dumps(data['phases']))
+        else:
+            boot_ms = data['phases'].pop('bootloader', 0)
+            print("Startup phases (ms since the app started):")
+            for name, ms in data['phases'].items():
+                print("\t{:10s} {:5d}".format(name, ms))
+            if boot_ms:
+                print("Bootloader ran {:d} ms before the app".format(boot_ms))
+
+    if args.capabilities:
+        data = device_capabilities(comms, args)
+        if not data:
+            fail("device does not report capabilities, its firmware predates them")
+        if args.json:
+            print(json.dumps({k: v for k, v in data.items() if k not in ('command', 'status')}))
+        else:
+            print("Features:          {}".format(", ".join(data['features']) if data['features'] else "none"))
+            print("Frame size:        {:d} bytes, responses up to {:d} bytes as messages, {:d} fragments per window".format(data['max_frame'], data['max_msg'], data['msg_window']))
+            print("Pipeline depth:    {:d} requests".format(data['pipeline']))
+            print("Batch size:        {:d} commands".format(data['batch']))
+            print("Schedule slots:    {:d}".format(data['schedule']))
+            print("Streaming:         up to {:d} samples per frame, every {:d} ms at the fastest".format(data['stream_samples'], data['stream_min_ms']))
+            print("Baud rates:        {} (running at {:d})".format(", ".join(str(b) for b in data['baudrates']), data['baudrate']))
+
+    if args.ram_stats:
+        data = communicate(comms, create_cmd(protocol.CMD_RAM_STATS), args, quiet=True)
+        if not data['status']:
+            fail("device does not support RAM statistics (built without STACK_MONITOR=1)")
+        if args.json:
+            print(json.dumps({k: v for k, v in data.items() if k not in ('command', 'status')}))
+        else:
+            print("RAM usage:")
+            print("\t.data     {:5d} bytes".format(data['data']))
+            print("\t.bss      {:5d} bytes".format(data['bss']))
+            print("\t.ramfunc  {:5d} bytes".format(data['ramfunc']))
+            print("\tstack     {:5d} of {:d} bytes used at most, {:d} free".format(data['stack_peak'], data['stack'], data['stack'] - data['stack_peak']))
+
+    if args.wave:
+        run_wave_upload(comms, args)
+
+    if args.seq:
+        run_seq_upload(comms, args)
+
+    if args.config_export:
+        run_config_export(comms, args)
+
+    if args.config_import:
+        run_config_import(comms, args)
+
+    if args.stream:
+        run_stream(comms, args)
+
+    if args.heartbeat:
+        run_heartbeat(comms, args)
+
+    if args.bench:
+        run_bench(comms, args)
+
+    if args.notify:
+        run_notify(comms, args)
+
+    if args.log:
+        run_log(comms, args)
+
+    if args.debug_log:
+        run_debug_log(comms, args)
+
+
+def shell_lines():
+    """
+    Yield the lines typed at the --shell prompt until end of file
+    """
+    while True:
+        try:
+            yield input("dps> ")
+        except EOFError:
+            print("")
+            return
+
+
+def run_shell(comms, args):
+    """
+    Run dpsctl command lines, read from --script or typed at the --shell
+    prompt, against the device on comms. The transport stays open between
+    them, as does a negotiated baud rate.
+    """
+    parser = create_parser(hasattr(args, 'temperature'))
+    interactive = not args.script
+    if interactive:
+        try:
+            import readline  # noqa: F401, line editing and history for input()
+        except ImportError:
+            pass
+        print("Connected to {}, enter dpsctl options (eg. -q), help or quit".format(comms.name()))
+        lines = shell_lines()
+    elif args.script == '-':
+        lines = sys.stdin
+    else:
+        try:
+            lines = open(args.script)
+        except IOError as e:
+            fail("could not read {}: {}".format(args.script, e.strerror))
+    for number, line in enumerate(lines, 1):
+        line = line.split('#')[0].strip()
+        if not line:
+            continue
+        if line in ('quit', 'exit'):
+            break
+        if line == 'help':
+            parser.print_help()
+            continue
+        try:
+            line_args, unknown = parser.parse_known_args(shlex.split(line))
+            if unknown:
+                fail("unknown options {}".format(" ".join(unknown)))
+            if line_args.scan or line_args.discovery_daemon or line_args.fleet or line_args.proxy_upgrade or line_args.shell or line_args.script:
+                fail("not available in a session")
+            line_args.device = comms.name()
+            run_commands(comms, line_args)
+        except SystemExit as e:
+            if not interactive and e.code:
+                print("{}:{:d}: failed".format(args.script, number))
+                raise
+        except KeyboardInterrupt:
+            if not interactive:
+                raise
+            print("")
+
+
+# Flash address the application image is linked at, see stm32f100_app.ld
+APP_FLASH_BASE = 0x08000000 + 5 * 1024
+
+
+def image_cstr(image, addr):
+    """
+    Return the string at flash address addr of the application image, None
+    if addr is outside the image
+    """
+    offset = addr - APP_FLASH_BASE
+    if offset < 0 or offset >= len(image):
+        return None
+    end = image.find(b'\0', offset)
+    if end < 0:
+        end = len(image)
+    return image[offset:end].decode('latin-1')
+
+
+def format_log_entry(image, addr, args):
+    """
+    Format a CMD_LOG entry the way mini-printf on the device would have
+    """
+    fmt = image_cstr(image, addr)
+    if fmt is None:
+        return "<unknown format 0x{:08x}>{}\n".format(addr, "".join(" 0x{:08x}".format(a) for a in args))
+    out = ""
+    args = list(args)
+    i = 0
+    while i < len(fmt):
+        ch = fmt[i]
+        i += 1
+        if ch != '%':
+            out += ch
+            continue
+        pad = 0
+        if fmt[i:i + 1] == '0':
+            if fmt[i + 1:i + 2].isdigit():
+                pad = int(fmt[i + 1])
+            i += 2
+        spec = fmt[i:i + 1]
+        i += 1
+        if spec in ('d', 'u', 'x', 'X', 'c', 's'):
+            value = args.pop(0) if args else 0
+            if spec == 'd':
+                out += "{:0{}d}".format(value - (1 << 32) if value & 0x80000000 else value, pad)
+            elif spec == 'u':
+                out += "{:0{}d}".format(value, pad)
+            elif spec in ('x', 'X'):
+                out += "{:0{}{}}".format(value, pad, spec)
+            elif spec == 'c':
+                out += chr(value & 0xff)
+            else:
+                string = image_cstr(image, value)
+                out += string if string is not None else "<0x{:08x}>".format(value)
+        else:
+            out += spec
+    return out
+
+
+def run_debug_log(comms, args):
+    """
+    Print the deferred debug log of the device until interrupted, the format
+    strings are read from the application image the device runs
+    """
+    try:
+        with open(args.debug_log, 'rb') as f:
+            image = f.read()
+    except IOError as e:
+        fail("could not read {}: {}".format(args.debug_log, e))
+    if not comms.open():
+        fail("could not open {}".format(comms.name()))
+    try:
+        while True:
+            f = read_frame(comms)
+            if not f or f.get_frame()[0] != protocol.CMD_LOG:
+                continue
+            data = unpack_log(f)
+            if data['dropped']:
+                print("[{:d} log entries dropped]".format(data['dropped']))
+            for addr, entry_args in data['entries']:
+                sys.stdout.write(format_log_entry(image, addr, entry_args))
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+
+
+def device_capabilities(comms, args):
+    """
+    Return the unpack_capabilities() dictionary of the device, None if its
+    firmware predates CMD_CAPABILITIES. Asked once per connection.
+    """
+    if not hasattr(comms, '_capabilities'):
+        if not comms.open():
+            fail("could not open {}".format(comms.name()))
+        f = exchange(comms, create_cmd(protocol.CMD_CAPABILITIES), args)
+        if not f:
+            fail("timeout talking to device {}".format(comms._if_name))
+        frame = f.get_frame()
+        supported = frame[0] == protocol.CMD_RESPONSE | protocol.CMD_CAPABILITIES and len(frame) > 2 and frame[1]
+        comms._capabilities = unpack_capabilities(f) if supported else None
+    return comms._capabilities
+
+
+def negotiate_baudrate(comms, args):
+    """
+    Switch the serial link to a higher baud rate for the remaining commands,
+    'max' picks the fastest one the device reports. The device falls back to
+    its default rate after a few seconds without traffic, so this only lasts
+    for the current invocation.
+    """
+    if not isinstance(comms, tty_interface):
+        fail("baud rate negotiation is only possible on a serial port of its own")
+    if args.firmware:
+        print("Warning: the bootloader runs at the default baud rate, not negotiating")
+        return
+    supported = protocol.SUPPORTED_BAUDRATES
+    caps = device_capabilities(comms, args)
+    if caps:
+        supported = caps['baudrates']
+    if args.negotiate_baudrate == 'max':
+        baudrate = max(supported)
+    elif args.negotiate_baudrate.isdigit() and int(args.negotiate_baudrate) in supported:
+        baudrate = int(args.negotiate_baudrate)
+    else:
+        fail("baud rate must be 'max' or one of {}".format(", ".join(str(b) for b in supported)))
+    if caps and caps['baudrate'] == baudrate:
+        return
+    communicate(comms, create_set_baudrate(baudrate), args, quiet=True)
+    comms.set_baudrate(baudrate)
+    # Confirm the new rate, the device reverts on its own if this fails
+    time.sleep(0.05)
+    communicate(comms, create_set_baudrate(baudrate), args, quiet=True)
+    if caps:
+        caps['baudrate'] = baudrate
+
+
+def read_frame(comms):
+    """
+    Read one frame from the device, returns None on timeout or protocol error
+    """
+    try:
+        resp = comms.read()
+    except socket.timeout:
+        return None
+    if len(resp) == 0:
+        return None
+    f = uframe.uFrame()
+    if f.set_frame(resp) < 0:
+        return None
+    return f
+
+
+# Command mixes of --bench: one request at a time, pings kept in flight up to
+# the device's pipeline depth in tagged envelopes, and streamed samples
+BENCH_MIXES = ('ping', 'query', 'set', 'pipelined', 'stream')
+
+
+def percentile(values, p):
+    """
+    Nearest rank percentile p (0-100) of a list of values, None if it is empty
+    """
+    if not values:
+        return None
+    values = sorted(values)
+    return values[max(0, int(math.ceil(p / 100.0 * len(values))) - 1)]
+
+
+def bench_result(name, latencies, errors, elapsed, **extra):
+    """
+    Summarize one mix of --bench, latencies in seconds
+    """
+    count = len(latencies) + errors
+    result = {'mix': name, 'requests': count, 'errors': errors,
+              'error_rate': errors / count if count else 0.0,
+              'throughput': len(latencies) / elapsed if elapsed > 0 else 0.0}
+    for key, p in (('p50_ms', 50), ('p99_ms', 99), ('max_ms', 100)):
+        value = percentile(latencies, p)
+        result[key] = round(value * 1000, 3) if value is not None else None
+    result.update(extra)
+    return result
+
+
+def bench_sequential(comms, args, name, frame):
+    """
+    Send frame args.bench_count times, each after the previous response
+    """
+    cmd = frame.get_frame()[0]
+    latencies = []
+    errors = 0
+    start = time.perf_counter()
+    for i in range(args.bench_count):
+        t = time.perf_counter()
+        f = exchange(comms, frame, args)
+        resp = f.get_frame() if f else None
+        if not resp or resp[0] != protocol.CMD_RESPONSE | cmd or (cmd != protocol.CMD_PING and not resp[1]) or \
+           (cmd == protocol.CMD_SET_PARAMETERS and (len(resp) < 3 or resp[2])):
+            errors += 1
+            continue
+        latencies.append(time.perf_counter() - t)
+    return bench_result(name, latencies, errors, time.perf_counter() - start)
+
+
+def bench_pipelined(comms, args):
+    """
+    Keep as many tagged pings in flight as the device can take, args.bench_count
+    in all
+    """
+    caps = device_capabilities(comms, args)
+    if not caps or not caps['status']:
+        return None
+    depth = max(1, caps['pipeline'])
+    sent = {}
+    latencies = []
+    errors = 0
+    next_tag = 0
+    start = time.perf_counter()
+    while next_tag < args.bench_count or sent:
+        while next_tag < args.bench_count and len(sent) < depth:
+            sent[next_tag & 0xff] = time.perf_counter()
+            write_frame(comms, create_tagged(next_tag & 0xff, create_cmd(protocol.CMD_PING)), args)
+            next_tag += 1
+        f = read_frame(comms)
+        if not f:
+            # Timed out, whatever is in flight is lost
+            errors += len(sent)
+            sent.clear()
+            continue
+        tagged = unpack_tagged(f)
+        if not tagged or tagged[0] not in sent:
+            continue
+        latencies.append(time.perf_counter() - sent.pop(tagged[0]))
+    return bench_result('pipelined', latencies, errors, time.perf_counter() - start, depth=depth)
+
+
+def bench_stream(comms, args):
+    """
+    Stream at the fastest rate and largest batch the device takes for
+    args.bench_duration seconds, the latency is the spread between frames
+    """
+    caps = device_capabilities(comms, args)
+    if not caps or not caps['status'] or caps['stream_samples'] < 1:
+        return None
+    interval_ms = max(1, caps['stream_min_ms'])
+    communicate(comms, create_stream_start(interval_ms, caps['stream_samples']), args, quiet=True)
+    gaps = []
+    samples = 0
+    lost = 0
+    expected_seq = None
+    last = None
+    start = time.perf_counter()
+    while time.perf_counter() - start < args.bench_duration:
+        f = read_frame(comms)
+        if not f or f.get_frame()[0] != protocol.CMD_STREAM_DATA:
+            continue
+        now = time.perf_counter()
+        data = unpack_stream_data(f)
+        if expected_seq is not None and data['seq'] != expected_seq:
+            lost += (data['seq'] - expected_seq) & 0xffff
+        expected_seq = (data['seq'] + 1) & 0xffff
+        if last is not None:
+            gaps.append(now - last)
+        last = now
+        samples += len(data['samples'])
+    elapsed = time.perf_counter() - start
+    comms.write(create_cmd(protocol.CMD_STREAM_STOP).get_frame())
+    for i in range(10):
+        f = read_frame(comms)
+        if not f or f.get_frame()[0] == protocol.CMD_RESPONSE | protocol.CMD_STREAM_STOP:
+            break
+    return bench_result('stream', gaps, lost, elapsed, samples_per_s=samples / elapsed if elapsed > 0 else 0.0,
+                        interval_ms=interval_ms, batch=caps['stream_samples'])
+
+
+def run_bench(comms, args):
+    """
+    Time the comma separated BENCH_MIXES in args.bench, or all of them, over
+    the link and print the round trip latencies, throughput and error rate
+    of each
+    """
+    names = BENCH_MIXES if args.bench == 'all' else args.bench.split(',')
+    for name in names:
+        if name not in BENCH_MIXES:
+            fail("unknown mix '{}', valid mixes are {}".format(name, ", ".join(BENCH_MIXES)))
+    if args.bench_count < 1:
+        fail("bench count must be at least 1")
+    if not comms.open():
+        fail("could not open {}".format(comms.name()))
+    results = []
+    for name in names:
+        if name == 'ping':
+            result = bench_sequential(comms, args, name, create_cmd(protocol.CMD_PING))
+        elif name == 'query':
+            result = bench_sequential(comms, args, name, create_cmd(protocol.CMD_QUERY))
+        elif name == 'set':
+            # Write back the current value of the first parameter, nothing changes
+            f = exchange(comms, create_cmd(protocol.CMD_QUERY), args)
+            if not f or f.get_frame()[0] != protocol.CMD_RESPONSE | protocol.CMD_QUERY:
+                fail("timeout talking to device {}".format(comms._if_name))
+            params = unpack_query_response(f)['params']
+            if not params:
+                result = None
+            else:
+                param = next(iter(params.items()))
+                result = bench_sequential(comms, args, name, create_set_parameter(["{}={}".format(*param)]))
+        elif name == 'pipelined':
+            result = bench_pipelined(comms, args)
+        else:
+            result = bench_stream(comms, args)
+        if result is None:
+            result = {'mix': name, 'skipped': "not supported by the device"}
+        results.append(result)
+
+    if args.json:
+        print(json.dumps({'transport': comms.name(), 'results': results}))
+        return
+    print("Benchmark of {}:".format(comms.name()))
+    print("\t{:10s} {:>8s} {:>7s} {:>9s} {:>9s} {:>9s} {:>10s}".format("mix", "requests", "errors", "p50 ms", "p99 ms", "max ms", "per second"))
+    for r in results:
+        if 'skipped' in r:
+            print("\t{:10s} {}".format(r['mix'], r['skipped']))
+            continue
+        ms = ["{:9.2f}".format(r[k]) if r[k] is not None else "{:>9s}".format("-") for k in ('p50_ms', 'p99_ms', 'max_ms')]
+        print("\t{:10s} {:8d} {:6.1f}% {} {:10.1f}".format(r['mix'], r['requests'], 100 * r['error_rate'], " ".join(ms), r['throughput']))
+        if r['mix'] == 'stream':
+            print("\t{:10s} {:.0f} samples/s in batches of {:d} every {:d} ms, latencies are frame spacing, errors lost frames".format(
+                "", r['samples_per_s'], r['batch'], r['interval_ms'] * r['batch']))
+
+
+def run_heartbeat(comms, args):
+    """
+    Ping the device every args.heartbeat seconds and print its status and
+    measurements from the piggybacked changes until interrupted
+    """
+    if args.heartbeat <= 0:
+        fail("heartbeat interval must be above 0 s")
+    if not 0 <= args.heartbeat_session < protocol.QUERY_COMPACT_SESSIONS:
+        fail("heartbeat session must be between 0 and {:d}".format(protocol.QUERY_COMPACT_SESSIONS - 1))
+    if not comms.open():
+        fail("could not open {}".format(comms.name()))
+    fields = [0] * protocol.QUERY_MAX_FIELDS
+    last_seq = None
+    try:
+        while True:
+            f = exchange(comms, protocol.create_ping(args.heartbeat_session, last_seq is None), args)
+            if not f:
+                print("Warning: no response from device")
+            else:
+                data = protocol.unpack_ping(f, fields)
+                if 'version' not in data:
+                    fail("device does not support the heartbeat ping")
+                values = dict(zip(protocol.QUERY_FIELDS, fields))
+                missed = last_seq is not None and (data['seq'] - last_seq) & 0xffff > 0
+                last_seq = data['seq']
+                if args.json:
+                    print(json.dumps({"t": time.time(), "seq": data['seq'], "flags": data['flags'],
+                                      "function": data['function'], "v_in": values['v_in'],
+                                      "v_out": values['v_out'], "i_out": values['i_out']}))
+                else:
+                    print("seq {:5d}{} {:6.2f} V {:6.3f} A (V_in {:.2f} V) function {:d} {}".format(
+                        data['seq'], "*" if missed else " ", values['v_out'] / 1000, values['i_out'] / 1000,
+                        values['v_in'] / 1000, data['function'], " ".join(data['flags'])))
+            time.sleep(args.heartbeat)
+    except KeyboardInterrupt:
+        pass
+
+
+def run_stream(comms, args):
+    """
+    Have the device push sample frames and print them until interrupted
+    """
+    if args.stream <= 0 or args.stream > 0xffff:
+        fail("stream interval must be between 1 and 65535 ms")
+    if args.stream_batch < 1 or args.stream_batch > protocol.STREAM_MAX_SAMPLES:
+        fail("stream batch must be between 1 and {:d}".format(protocol.STREAM_MAX_SAMPLES))
+    communicate(comms, create_stream_start(args.stream, args.stream_batch), args)
+    expected_seq = None
+    lost = 0
+    t = 0
+    try:
+        while True:
+            f = read_frame(comms)
+            if not f or f.get_frame()[0] != protocol.CMD_STREAM_DATA:
+                continue
+            data = unpack_stream_data(f)
+            if expected_seq is not None and data['seq'] != expected_seq:
+                lost += (data['seq'] - expected_seq) & 0xffff
+            expected_seq = (data['seq'] + 1) & 0xffff
+            for v_out, i_out in data['samples']:
+                if args.json:
+                    print(json.dumps({"t_ms": t, "v_in": data['v_in'], "v_out": v_out, "i_out": i_out}))
+                else:
+                    print("{:10d} {:6.2f} V {:6.3f} A (V_in {:.2f} V)".format(t, v_out / 1000, i_out / 1000, data['v_in'] / 1000))
+                t += data['interval_ms']
+    except KeyboardInterrupt:
+        pass
+    comms.write(create_cmd(protocol.CMD_STREAM_STOP).get_frame())
+    # Drain any sample frames sent before the device saw the stop command
+    for i in range(10):
+        f = read_frame(comms)
+        if not f or f.get_frame()[0] == protocol.CMD_RESPONSE | protocol.CMD_STREAM_STOP:
+            break
+    if lost:
+        print("Warning: {:d} stream frames lost".format(lost))
+
+
+
+def run_notify(comms, args):
+    """
+    Subscribe to the comma separated NOTIFY_EVENTS names in args.notify, or
+    all of them, and print the notifications until interrupted
+    """
+    names = protocol.NOTIFY_EVENTS if args.notify == 'all' else args.notify.split(',')
+    mask = 0
+    for name in names:
+        if name not in protocol.NOTIFY_EVENTS:
+            fail("unknown event '{}', valid events are {}".format(name, ", ".join(protocol.NOTIFY_EVENTS)))
+        mask |= 1 << protocol.NOTIFY_EVENTS.index(name)
+    caps = device_capabilities(comms, args)
+    if not caps or 'notify' not in caps['features']:
+        fail("device firmware does not send notifications")
+    communicate(comms, create_subscribe(mask), args)
+    expected_seq = None
+    lost = 0
+    try:
+        while True:
+            f = read_frame(comms)
+            if not f or f.get_frame()[0] != protocol.CMD_NOTIFY:
+                continue
+            data = unpack_notify(f)
+            if expected_seq is not None and data['seq'] != expected_seq:
+                lost += (data['seq'] - expected_seq) & 0xff
+            expected_seq = (data['seq'] + 1) & 0xff
+            if args.json:
+                print(json.dumps({"t": time.time(), "event": data['event'], "index": data['index'], "value": data['value']}))
+            else:
+                print("{} {:<10} {:3d} {:d}".format(time.strftime("%H:%M:%S"), data['event'], data['index'], data['value']))
+    except KeyboardInterrupt:
+        pass
+    comms.write(create_subscribe(0).get_frame())
+    # Drain any notifications sent before the device saw the unsubscribe
+    for i in range(10):
+        f = read_frame(comms)
+        if not f or f.get_frame()[0] == protocol.CMD_RESPONSE | protocol.CMD_SUBSCRIBE:
+            break
+    if lost:
+        print("Warning: {:d} notifications lost".format(lost))
+
+
+# Binary log files are a header followed by chunks of LOG_CHUNK_SAMPLES samples
+# or less, each chunk stores its samples column by column, little endian:
+#   header: b"DPSLOG1\0" <start time:float64, unix epoch> <interval ms:uint32>
+#   chunk:  <count:uint32> <t_ms:uint32 * count> <v_in:uint16 * count>
+#           <v_out:uint16 * count> <i_out:uint16 * count>
+# t_ms is device time since the start of the log, voltages are mV, current mA.
+LOG_MAGIC = b"DPSLOG1\0"
+LOG_CHUNK_SAMPLES = 1024
+
+
+class log_writer(object):
+    """
+    Buffers logged samples and writes them as binary chunks or CSV lines
+    """
+    def __init__(self, file_name, csv, start, interval_ms):
+        self._csv = csv
+        self._file = open(file_name, "w" if csv else "wb", buffering=1 << 16)
+        self._start = start
+        self._columns = ([], [], [], [])
+        if csv:
+            self._file.write("time,t_ms,v_in,v_out,i_out\n")
+        else:
+            self._file.write(LOG_MAGIC + struct.pack("<dI", start, interval_ms))
+
+    def add(self, t_ms, v_in, v_out, i_out):
+        for column, value in zip(self._columns, (t_ms, v_in, v_out, i_out)):
+            column.append(value)
+        if len(self._columns[0]) >= LOG_CHUNK_SAMPLES:
+            self.flush()
+
+    def flush(self):
+        count = len(self._columns[0])
+        if not count:
+            return
+        if self._csv:
+            for t_ms, v_in, v_out, i_out in zip(*self._columns):
+                self._file.write("{:.3f},{:d},{:d},{:d},{:d}\n".format(self._start + t_ms / 1000, t_ms, v_in, v_out, i_out))
+        else:
+            self._file.write(struct.pack("<I{0:d}I{0:d}H{0:d}H{0:d}H".format(count), count, *(value for column in self._columns for value in column)))
+        for column in self._columns:
+            del column[:]
+        self._file.flush()
+
+    def close(self):
+        self.flush()
+        self._file.close()
+
+
+def read_log(file_name):
+    """
+    Read a binary log written by --log, return the start time and a list of
+    (t_ms, v_in, v_out, i_out) tuples
+    """
+    with open(file_name, "rb") as f:
+        data = f.read()
+    if data[:len(LOG_MAGIC)] != LOG_MAGIC:
+        fail("{} is not a dpsctl log".format(file_name))
+    pos = len(LOG_MAGIC)
+    start, interval_ms = struct.unpack_from("<dI", data, pos)
+    pos += 12
+    samples = []
+    while pos + 4 <= len(data):
+        count = struct.unpack_from("<I", data, pos)[0]
+        pos += 4
+        if pos + 10 * count > len(data):
+            break  # Truncated by a crash, keep what was complete
+        columns = []
+        for fmt, size in (("I", 4), ("H", 2), ("H", 2), ("H", 2)):
+            columns.append(struct.unpack_from("<{:d}{}".format(count, fmt), data, pos))
+            pos += size * count
+        samples.extend(zip(*columns))
+    return start, samples
+
+
+def start_log_stream(comms, args, interval_ms):
+    """
+    Ask the device to stream samples, return False if it does not support it
+    """
+    if isinstance(comms, bus_interface):
+        return False  # Units on a bus never send on their own
+    if not comms.open():
+        fail("could not open {}".format(comms.name()))
+    comms.write(create_stream_start(interval_ms, args.stream_batch).get_frame())
+    for i in range(3):
+        f = read_frame(comms)
+        if not f:
+            break
+        frame = f.get_frame()
+        if frame[0] == protocol.CMD_RESPONSE | protocol.CMD_STREAM_START:
+            return len(frame) > 1 and frame[1] != 0
+    return False
+
+
+def run_log(comms, args):
+    """
+    Log samples to a file over one persistent connection, from the stream
+    frames if the device supports them and by polling otherwise, until
+    interrupted or --log-duration seconds have passed
+    """
+    interval_ms = args.log_interval
+    if interval_ms <= 0 or interval_ms > 0xffff:
+        fail("log interval must be between 1 and 65535 ms")
+    if args.stream_batch < 1 or args.stream_batch > protocol.STREAM_MAX_SAMPLES:
+        fail("stream batch must be between 1 and {:d}".format(protocol.STREAM_MAX_SAMPLES))
+    file_name = args.log.replace("{device}", args.device.replace("/", "_").replace(":", "_"))
+    csv = file_name.endswith(".csv")
+    streaming = start_log_stream(comms, args, interval_ms)
+    if isinstance(comms, udp_interface):
+        # Give the kernel room to hold bursts while the file is written
+        comms._socket.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+    start = time.time()
+    writer = log_writer(file_name, csv, start, interval_ms)
+    end = start + args.log_duration if args.log_duration else None
+    count = 0
+    lost = 0
+    print("Logging to {} every {:d} ms{}".format(file_name, interval_ms, "" if streaming else " by polling, the device does not stream"))
+    try:
+        if streaming:
+            frame_index = 0
+            expected_seq = None
+            while not end or time.time() < end:
+                f = read_frame(comms)
+                if not f or f.get_frame()[0] != protocol.CMD_STREAM_DATA:
+                    continue
+                data = unpack_stream_data(f)
+                if expected_seq is not None:
+                    skipped = (data['seq'] - expected_seq) & 0xffff
+                    lost += skipped
+                    frame_index += 1 + skipped
+                expected_seq = (data['seq'] + 1) & 0xffff
+                # Time from the frame count so lost frames leave a gap
+                t_ms = frame_index * args.stream_batch * data['interval_ms']
+                for v_out, i_out in data['samples']:
+                    writer.add(t_ms, data['v_in'], v_out, i_out)
+                    t_ms += data['interval_ms']
+                    count += 1
+        else:
+            query = create_cmd(protocol.CMD_QUERY).get_frame()
+            next_time = start
+            while not end or time.time() < end:
+                comms.write(query)
+                f = read_frame(comms)
+                if f and f.get_frame()[0] == protocol.CMD_RESPONSE | protocol.CMD_QUERY:
+                    data = unpack_query_response(f)
+                    writer.add(int((time.time() - start) * 1000), data['v_in'], data['v_out'], data['i_out'])
+                    count += 1
+                else:
+                    lost += 1
+                # Keep a fixed rate instead of drifting by the round trip time
+                next_time += interval_ms / 1000
+                delay = next_time - time.time()
+                if delay > 0:
+                    time.sleep(delay)
+                else:
+                    next_time = time.time()
+    except KeyboardInterrupt:
+        pass
+    writer.close()
+    if streaming:
+        comms.write(create_cmd(protocol.CMD_STREAM_STOP).get_frame())
+    print("Logged {:d} samples to {}".format(count, file_name))
+    if lost:
+        print("Warning: {:d} {} lost".format(lost, "stream frames" if streaming else "queries"))
+
+
+def run_record_dump(comms, args):
+    """
+    Wait for the ADC recording to complete and print it, one sample set per line
+    """
+    try:
+        data = communicate(comms, create_record_dump(0), args, quiet=True)
+        while data['state'] != protocol.RECORDER_DONE:
+            time.sleep(0.5)
+            data = communicate(comms, create_record_dump(0), args, quiet=True)
+    except KeyboardInterrupt:
+        return
+    samples = data['samples']
+    while len(samples) < data['total']:
+        samples += communicate(comms, create_record_dump(len(samples)), args, quiet=True)['samples']
+    names = [name for name, bit in protocol.RECORDER_CHANNELS if data['channels'] & bit]
+    if not args.json:
+        print("# set relative to trigger, decimation {:d}, raw {}".format(data['decimation'], " ".join(names)))
+    for n in range(len(samples) // len(names)):
+        values = samples[n * len(names):(n + 1) * len(names)]
+        if args.json:
+            row = dict(zip(names, values))
+            row['set'] = n - data['pre_count']
+            print(json.dumps(row))
+        else:
+            print("{:6d} {}".format(n - data['pre_count'], " ".join("{:5d}".format(v) for v in values)))
+
+
+def run_trip_snapshot(comms, args):
+    """
+    Print the samples frozen at the last OCP/OVP trip and re-arm the capture
+    """
+    data = communicate(comms, create_trip_snapshot(0), args, quiet=True)
+    samples = data['samples']
+    while data['trip'] and len(samples) < data['total']:
+        data = communicate(comms, create_trip_snapshot(len(samples)), args, quiet=True)
+        samples += data['samples']
+    if data['trip']:
+        communicate(comms, create_trip_snapshot(data['total'], clear=True), args, quiet=True)
+    cause = protocol.TRIP_CAUSES[data['trip']] if data['trip'] < len(protocol.TRIP_CAUSES) else str(data['trip'])
+    if args.json:
+        print(json.dumps({'trip': cause, 'time_us': data['time_us'], 'v_dac': data['v_dac'],
+                          'i_dac': data['i_dac'], 'samples': samples}))
+        return
+    if not data['trip']:
+        print("No trip captured")
+        return
+    print("{} at {:d} us, V_DAC {:d} I_DAC {:d}".format(cause.upper(), data['time_us'], data['v_dac'], data['i_dac']))
+    print("# set relative to trip, raw i_out v_in v_out")
+    for n, (i_out, v_in, v_out) in enumerate(samples):
+        print("{:6d} {:5d} {:5d} {:5d}".format(n - len(samples) + 1, i_out, v_in, v_out))
+
+
+def parse_setpoint(setpoint):
+    """
+    Return the mV and mA of a setpoint given as 'V,I' in volts and amps, None
+    for an empty field
+    """
+    parts = setpoint.split(",")
+    if len(parts) != 2 or not (parts[0].strip() or parts[1].strip()):
+        fail("malformed setpoint, expected V,I")
+    try:
+        mv = round(float(parts[0]) * 1000) if parts[0].strip() else None
+        ma = round(float(parts[1]) * 1000) if parts[1].strip() else None
+    except ValueError:
+        fail("malformed setpoint, expected V,I")
+    return mv, ma
+
+
+def run_setpoint(comms, args):
+    """
+    Set the voltage and/or current of the active function given as 'V,I' in
+    volts and amps, an empty field is left unchanged
+    """
+    mv, ma = parse_setpoint(args.setpoint)
+    data = communicate(comms, create_set_setpoint(mv, ma), args, quiet=True)
+    status = data['status']
+    if status != 0:
+        fail("setpoint {}".format("out of range" if status == 2 else "not supported by the active function" if status == 3 else "failed with error {:d}".format(status)))
+
+
+def clock_sync(comms, args):
+    """
+    Estimate the offset of the device clock to time.monotonic() in us from a
+    few clock sync exchanges, return the offset and the round trip time of the
+    exchange it came from. The device read its clock within half a round
+    trip of the midpoint, so the shortest round trip gives the best estimate.
+    """
+    best = None
+    for _ in range(CLOCK_SYNC_EXCHANGES):
+        t0 = time.monotonic()
+        data = communicate(comms, create_cmd(protocol.CMD_CLOCK_SYNC), args, quiet=True)
+        t1 = time.monotonic()
+        rtt_us = (t1 - t0) * 1e6
+        if not best or rtt_us < best[1]:
+            best = (data['now_us'] - (t0 + t1) / 2 * 1e6, rtt_us)
+    return best
+
+
+def run_scheduled(comms, args):
+    """
+    Have the device run the parameter, setpoint and output changes at the
+    host time args.at_time, set by run_fleet() so all devices share it, or
+    args.at seconds from now
+    """
+    frames = []
+    if args.parameter:
+        payload = create_set_parameter(args.parameter)
+        if not payload:
+            fail("malformed parameters")
+        frames.append(payload)
+    if args.setpoint:
+        frames.append(create_set_setpoint(*parse_setpoint(args.setpoint)))
+    if args.enable:
+        if args.enable != 'on' and args.enable != 'off':
+            fail("enable is 'on' or 'off'")
+        frames.append(create_enable_output(args.enable))
+    if not frames:
+        fail("--at needs --enable, --parameter or --setpoint")
+    frame = frames[0] if len(frames) == 1 else create_batch(frames)
+    inner = uframe.uFrame()
+    inner.set_frame(bytearray(frame.get_frame()))
+    if len(inner.get_frame()) > protocol.SCHEDULE_MAX_LENGTH:
+        fail("the scheduled commands take {:d} bytes, the device holds {:d}".format(len(inner.get_frame()), protocol.SCHEDULE_MAX_LENGTH))
+
+    at_time = getattr(args, 'at_time', None) or time.monotonic() + args.at
+    offset_us, rtt_us = clock_sync(comms, args)
+    if at_time - time.monotonic() < rtt_us / 1e6:
+        fail("too late to schedule, use a larger --at")
+    at_us = int(round(at_time * 1e6 + offset_us))
+    data = communicate(comms, create_schedule(at_us, frame), args, quiet=True)
+    if args.json:
+        print(json.dumps({'slot': data['slot'], 'at_us': at_us, 'uncertainty_us': rtt_us / 2}))
+    else:
+        print("Scheduled in slot {:d} at device time {:d} us, +/- {:.0f} us".format(data['slot'], at_us, rtt_us / 2))
+
+
+def run_schedule_status(comms, args):
+    """
+    Print the scheduled commands of the device and how late those run were
+    """
+    data = communicate(comms, create_cmd(protocol.CMD_SCHEDULE_STATUS), args, quiet=True)
+    if args.json:
+        print(json.dumps({'now_us': data['now_us'], 'slots': data['slots']}))
+        return
+    print("Device time {:d} us".format(data['now_us']))
+    if not data['slots']:
+        print("\tNo scheduled commands")
+    for slot in data['slots']:
+        if slot['state'] == 'pending':
+            print("\t{:d}: command {:d} pending, due in {:.3f} s".format(slot['slot'], slot['cmd'], (slot['at_us'] - data['now_us']) / 1e6))
+        else:
+            print("\t{:d}: command {:d} {}, ran {:d} us late".format(slot['slot'], slot['cmd'], slot['state'], slot['late_us']))
+
+
+def run_perf_report(comms, args):
+    """
+    Print the cycle counting probes, clearing them if asked to
+    """
+    data = communicate(comms, create_perf_report(0), args, quiet=True)
+    if not data['status']:
+        fail("device does not support performance probes (built without PERF=1)")
+    probes = data['probes']
+    while len(probes) < data['total']:
+        data = communicate(comms, create_perf_report(len(probes)), args, quiet=True)
+        probes.update(data['probes'])
+    if args.perf_reset:
+        communicate(comms, create_perf_report(data['total'], reset=True), args, quiet=True)
+    if not args.perf:
+        return
+    if args.json:
+        print(json.dumps({'clock_hz': data['clock_hz'], 'probes': probes}))
+        return
+    us = 1e6 / data['clock_hz']
+    print("{:14s} {:>10s} {:>10s} {:>10s} {:>10s}".format("probe", "calls", "min us", "mean us", "max us"))
+    for name, p in probes.items():
+        if p['calls']:
+            print("{:14s} {:10d} {:10.1f} {:10.1f} {:10.1f}".format(name, p['calls'], p['min'] * us, p['mean'] * us, p['max'] * us))
+        else:
+            print("{:14s} {:10d} {:>10s} {:>10s} {:>10s}".format(name, 0, "-", "-", "-"))
+
+
+def run_isr_hooks(comms, args):
+    """
+    Print the accounting of the ADC ISR hooks, clearing it if asked to
+    """
+    data = communicate(comms, create_isr_hooks(0), args, quiet=True)
+    if not data['status']:
+        fail("device does not support ISR hook accounting")
+    hooks = data['hooks']
+    while len(hooks) < data['total']:
+        data = communicate(comms, create_isr_hooks(len(hooks)), args, quiet=True)
+        hooks.update(data['hooks'])
+    if args.isr_hooks_reset:
+        communicate(comms, create_isr_hooks(data['total'], reset=True), args, quiet=True)
+    if not args.isr_hooks:
+        return
+    if args.json:
+        print(json.dumps(hooks))
+        return
+    print("{:10s} {:>8s} {:>8s} {:>10s} {:>10s} {:>10s}".format("hook", "enabled", "budget", "runs", "overruns", "max"))
+    for name, h in hooks.items():
+        print("{:10s} {:>8s} {:8d} {:10d} {:10d} {:10d}".format(name, "yes" if h['enabled'] else "no", h['budget'],
+                                                               h['runs'], h['overruns'], h['max']))
+
 
-    if args.version:
-        communicate(comms, create_cmd(protocol.CMD_VERSION), args)
+def run_cal_noise(comms, args):
+    """
+    Print the noise and histogram of the raw ADC codes of each channel over
+    one window, waiting for the first window to fill
+    """
+    channels = protocol.CAL_DATA_CHANNELS
+    noise = {}
+    deadline = time.time() + 2
+    while len(noise) < len(channels):
+        i = len(noise)
+        data = communicate(comms, create_cal_noise(i, stop=(i == len(channels) - 1)), args, quiet=True)
+        if not data or 'windows' not in data:
+            fail("device does not support ADC noise windows, it needs to be built with ADC_NOISE=1")
+        if data['windows'] == 0:
+            if time.time() > deadline:
+                fail("no ADC noise window completed")
+            time.sleep(0.1)
+            continue
+        noise[channels[i]] = {k: data[k] for k in ('samples', 'center', 'min', 'max', 'mean', 'stddev', 'hist')}
+    if args.json:
+        print(json.dumps(noise))
+        return
+    for name, n in noise.items():
+        print("{:9s} {:d} samples, mean {:.2f}, stddev {:.2f}, min {:d}, max {:d}".format(
+            name, n['samples'], n['mean'], n['stddev'], n['min'], n['max']))
+        peak = max(n['hist']) or 1
+        for i, count in enumerate(n['hist']):
+            code = n['center'] - protocol.CAL_NOISE_BINS // 2 + i
+            edge = "<=" if i == 0 else ">=" if i == protocol.CAL_NOISE_BINS - 1 else "  "
+            print("  {}{:5d} {:5d} {}".format(edge, code, count, "#" * ((count * 40 + peak - 1) // peak)))
 
-    if args.calibration_report:
-        data = communicate(comms, create_cmd(protocol.CMD_CAL_REPORT), args)
-        print("Calibration Report:")
-        print("\tA_ADC_K = {}".format(data['cal']['A_ADC_K']))
-        print("\tA_ADC_C = {}".format(data['cal']['A_ADC_C']))
-        print("\tA_DAC_K = {}".format(data['cal']['A_DAC_K']))
-        print("\tA_DAC_C = {}".format(data['cal']['A_DAC_C']))
-        print("\tV_ADC_K = {}".format(data['cal']['V_ADC_K']))
-        print("\tV_ADC_C = {}".format(data['cal']['V_ADC_C']))
-        print("\tV_DAC_K = {}".format(data['cal']['V_DAC_K']))
-        print("\tV_DAC_C = {}".format(data['cal']['V_DAC_C']))
-        print("\tVIN_ADC_K = {}".format(data['cal']['VIN_ADC_K']))
-        print("\tVIN_ADC_C = {}".format(data['cal']['VIN_ADC_C']))
-        print("\tVIN_ADC = {}".format(data['vin_adc']))
-        print("\tVOUT_ADC = {}".format(data['vout_adc']))
-        print("\tIOUT_ADC = {}".format(data['iout_adc']))
-        print("\tIOUT_DAC = {}".format(data['iout_dac']))
-        print("\tVOUT_DAC = {}".format(data['vout_dac']))
 
-    if args.calibration_set:
-        payload = create_set_calibration(args.calibration_set)
-        if payload:
-            communicate(comms, payload, args)
-        else:
-            fail("malformed parameters")
+def run_ocp_bench(comms, args):
+    """
+    Trip the OCP args.ocp_bench times and print the latency
+    """
+    data = communicate(comms, create_ocp_bench(args.ocp_bench), args, quiet=True)
+    if not data['status']:
+        fail("OCP bench failed, it needs the output enabled, 1 to 32 runs and a device built with OCP_BENCH=1")
+    if args.json:
+        print(json.dumps({k: data[k] for k in ('clock_hz', 'count', 'min', 'max', 'mean')}))
+        return
+    us = 1e6 / data['clock_hz']
+    print("{:d}/{:d} trips, latency min {:.1f} us, mean {:.1f} us, max {:.1f} us".format(
+        data['count'], args.ocp_bench, data['min'] * us, data['mean'] * us, data['max'] * us))
 
-    if hasattr(args, 'temperature') and args.temperature:
-        communicate(comms, create_temperature(float(args.temperature)), args)
 
-    if args.calibration_reset:
-        communicate(comms, create_cmd(protocol.CMD_CLEAR_CALIBRATION), args)
+def run_ripple(comms, args):
+    """
+    Analyse the ripple of a channel of the finished ADC recording at the
+    frequencies in args.ripple and print it in mV or mA
+    """
+    channels = dict(protocol.RECORDER_CHANNELS)
+    if args.ripple_channel not in channels:
+        fail("ripple channels are {}".format(", ".join(channels)))
+    try:
+        freqs = [int(f) for f in args.ripple.split(",")]
+    except ValueError:
+        fail("ripple frequencies are comma separated Hz")
+    if len(freqs) > 8 or not all(0 < f < 0x10000 for f in freqs):
+        fail("up to 8 ripple frequencies of 1 to 65535 Hz")
+    data = communicate(comms, create_ripple(channels[args.ripple_channel], args.ripple_rate, freqs), args, quiet=True)
+    if not data['status']:
+        fail("ripple analysis failed, it needs a finished recording of the channel, frequencies below half its rate and a device built with RIPPLE=1")
+    cal = communicate(comms, create_cmd(protocol.CMD_CAL_REPORT), args, quiet=True)['cal']
+    k = {'i_out': cal['A_ADC_K'], 'v_in': cal['VIN_ADC_K'], 'v_out': cal['V_ADC_K']}[args.ripple_channel]
+    unit = "mA" if args.ripple_channel == 'i_out' else "mV"
+    if args.json:
+        print(json.dumps({'samples': data['samples'], 'unit': unit, 'peak_to_peak': (data['max'] - data['min']) * k,
+                          'rms': data['rms'] * k, 'dominant': freqs[data['dominant']],
+                          'amplitude': dict(zip(freqs, (a * k for a in data['amplitude'])))}))
+        return
+    print("{:d} samples, {:.2f} {} peak to peak, {:.2f} {} RMS".format(
+        data['samples'], (data['max'] - data['min']) * k, unit, data['rms'] * k, unit))
+    for i, (freq, amplitude) in enumerate(zip(freqs, data['amplitude'])):
+        print("{:7d} Hz {:8.2f} {}{}".format(freq, amplitude * k, unit, " *" if i == data['dominant'] else ""))
 
-    if args.switch_screen:
-        if (args.switch_screen.lower() == "main"):
-            communicate(comms, create_change_screen(protocol.CHANGE_SCREEN_MAIN), args)
-        elif (args.switch_screen.lower() == "settings"):
-            communicate(comms, create_change_screen(protocol.CHANGE_SCREEN_SETTINGS), args)
-        else:
-            fail("please specify either 'settings' or 'main' as parameters")
 
-    if args.calibrate:
-        do_calibration(comms, args)
+def impedance_freqs(spec):
+    """
+    Parse comma separated frequencies in Hz or a logarithmic sweep given as
+    start:stop:points
+    """
+    try:
+        if ":" in spec:
+            start, stop, points = spec.split(":")
+            start, stop, points = float(start), float(stop), int(points)
+            if points < 2 or start <= 0 or stop <= 0:
+                raise ValueError
+            return [start * (stop / start) ** (i / (points - 1)) for i in range(points)]
+        return [float(f) for f in spec.split(",")]
+    except ValueError:
+        fail("impedance frequencies are comma separated Hz or start:stop:points")
+
+
+def run_impedance(comms, args):
+    """
+    Measure the load impedance at each frequency of args.impedance with the
+    lock-in of the device. The function generator must be running a sine, its
+    frequency is stepped from here and the output is left at the last one.
+    """
+    freqs = impedance_freqs(args.impedance)
+    if not 0 <= args.impedance_settle < 0x100 or not 0 < args.impedance_periods < 0x10000:
+        fail("lock-in settles 0 to 255 periods and measures 1 to 65535")
+    cal = communicate(comms, create_cmd(protocol.CMD_CAL_REPORT), args, quiet=True)['cal']
+    results = []
+    for freq in freqs:
+        dhz = int(round(freq * 10))
+        if not 0 < dhz < 0x10000:
+            fail("impedance frequencies are 0.1 to 6553.5 Hz")
+        args.parameter = ["freq={:d}".format(dhz)]
+        communicate(comms, create_set_parameter(args.parameter), args, quiet=True)
+        data = communicate(comms, create_lockin(args.impedance_settle, args.impedance_periods), args, quiet=True)
+        if not data['status']:
+            fail("lock-in failed to start, it needs funcgen enabled with a sine, a frequency in its range and a device built with LOCKIN=1")
+        timeout = time.time() + 2 + (args.impedance_settle + args.impedance_periods) * 10 / dhz
+        while True:
+            data = communicate(comms, create_lockin(), args, quiet=True)
+            if data['status'] and data['state'] == 3:
+                break
+            if time.time() > timeout:
+                fail("lock-in measurement at {:.1f} Hz timed out".format(dhz / 10.0))
+            time.sleep(0.05)
+        i = data['i'] * cal['A_ADC_K']
+        v = data['v'] * cal['V_ADC_K']
+        z = v / i if abs(i) > 0 else complex(float('inf'), 0)
+        results.append({'freq': data['freq'], 'samples': data['samples'], 'v': abs(v), 'i': abs(i),
+                        'z': abs(z), 'phase': math.degrees(math.atan2(z.imag, z.real))})
+    if args.json:
+        print(json.dumps(results))
+        return
+    print("{:>9s} {:>10s} {:>10s} {:>12s} {:>8s}".format("Hz", "V (mV)", "I (mA)", "|Z| (ohm)", "deg"))
+    for r in results:
+        print("{:9.1f} {:10.2f} {:10.2f} {:12.3f} {:8.1f}".format(r['freq'], r['v'], r['i'], r['z'], r['phase']))
+
+
+def run_wave_upload(comms, args):
+    """
+    Upload one period of an arbitrary waveform to the function generator.
+    The file holds levels from 0.0 to 1.0 of the set voltage separated by
+    commas or whitespace.
+    """
+    try:
+        with open(args.wave) as f:
+            levels = [float(v) for v in f.read().replace(",", " ").split()]
+    except (IOError, ValueError) as e:
+        fail("could not read waveform: {}".format(e))
+    if not levels or len(levels) > protocol.WAVE_MAX_POINTS:
+        fail("waveform must have 1 to {:d} samples".format(protocol.WAVE_MAX_POINTS))
+    if min(levels) < 0 or max(levels) > 1:
+        fail("waveform levels must be between 0.0 and 1.0")
+    samples = [int(round(v * 0xffff)) for v in levels]
+    for offset in range(0, len(samples), protocol.WAVE_UPLOAD_CHUNK):
+        chunk = samples[offset:offset + protocol.WAVE_UPLOAD_CHUNK]
+        last = offset + len(chunk) == len(samples)
+        communicate(comms, create_wave_upload(offset, chunk, commit=last), args, quiet=True)
+
+
+def run_config_export(comms, args):
+    """
+    Save the settings snapshot of the device to a file, {device} in the name
+    is replaced by the device
+    """
+    data = communicate(comms, create_config_export(0), args, quiet=True)
+    blob = data['data']
+    while len(blob) < data['total']:
+        chunk = communicate(comms, create_config_export(len(blob)), args, quiet=True)
+        if chunk['total'] != data['total'] or not chunk['data']:
+            fail("the settings changed during the export, try again")
+        blob += chunk['data']
+    if uframe.crc16_ccitt_bytes(blob[:-2]) != struct.unpack(">H", blob[-2:])[0]:
+        fail("the settings changed during the export, try again")
+    file_name = args.config_export.replace("{device}", args.device.replace("/", "_").replace(":", "_"))
+    try:
+        with open(file_name, "wb") as f:
+            f.write(blob)
+    except IOError as e:
+        fail("could not write {}: {}".format(file_name, e.strerror))
+    print("Saved {:d} settings to {}".format(blob[1], file_name))
 
-    if args.brightness:
-        if args.brightness >=0 and args.brightness <=100:
-            communicate(comms, create_set_brightness(args.brightness), args)
-        else:
-            fail("brightness must be between 0 and 100")
 
+def run_config_import(comms, args):
+    """
+    Write a settings snapshot from --config-export to the device, it restarts
+    with the new settings once the last chunk is in
+    """
+    try:
+        with open(args.config_import, "rb") as f:
+            blob = f.read()
+    except IOError as e:
+        fail("could not read {}: {}".format(args.config_import, e.strerror))
+    if len(blob) < 4 or len(blob) > 0xffff or uframe.crc16_ccitt_bytes(blob[:-2]) != struct.unpack(">H", blob[-2:])[0]:
+        fail("{} is not a settings snapshot".format(args.config_import))
+    for offset in range(0, len(blob), protocol.CONFIG_IMPORT_CHUNK):
+        chunk = blob[offset:offset + protocol.CONFIG_IMPORT_CHUNK]
+        last = offset + len(chunk) == len(blob)
+        result = communicate(comms, create_config_import(offset, chunk, commit=last), args, quiet=True)['result']
+        if result:
+            reason = protocol.CONFIG_IMPORT_RESULTS[result] if result < len(protocol.CONFIG_IMPORT_RESULTS) else str(result)
+            fail("import failed, {}, the settings were not changed".format(reason))
+    print("Imported {:d} settings, the device is restarting".format(blob[1]))
+
+
+def run_seq_upload(comms, args):
+    """
+    Upload a program to the sequencer. Each line of the file holds a step as
+    volts, amps and seconds separated by commas or whitespace, a duration of
+    0 waits for a trigger. Lines starting with # are ignored.
+    """
+    steps = []
+    try:
+        with open(args.seq) as f:
+            for line in f:
+                line = line.split("#")[0].replace(",", " ").split()
+                if not line:
+                    continue
+                if len(line) != 3:
+                    fail("sequencer steps are: volts amps seconds")
+                (v, i, t) = [float(x) for x in line]
+                steps.append((int(round(v * 1000)), int(round(i * 1000)), int(round(t * 1000000))))
+    except (IOError, ValueError) as e:
+        fail("could not read program: {}".format(e))
+    if not steps or len(steps) > protocol.SEQ_MAX_STEPS:
+        fail("program must have 1 to {:d} steps".format(protocol.SEQ_MAX_STEPS))
+    for (mv, ma, duration_us) in steps:
+        if not (0 <= mv <= 0xffff and 0 <= ma <= 0xffff and 0 <= duration_us <= 0xffffffff):
+            fail("step {:.3f}V {:.3f}A {:.6f}s is out of range".format(mv / 1000, ma / 1000, duration_us / 1000000))
+    for index in range(0, len(steps), protocol.SEQ_UPLOAD_CHUNK):
+        chunk = steps[index:index + protocol.SEQ_UPLOAD_CHUNK]
+        last = index + len(chunk) == len(steps)
+        communicate(comms, create_seq_upload(index, chunk, commit=last), args, quiet=True)
 
 
 def is_ip_address(if_name):
     """
-    Return True if the parameter if_name is an IP address.
+    Return True if the parameter if_name is an IP address, optionally
+    followed by :port
     """
+    address, _, port = if_name.partition(':')
+    if port and not port.isdigit():
+        return False
     try:
-        socket.inet_aton(if_name)
+        socket.inet_aton(address)
         return True
     except socket.error:
         return False
 
 
-def chunk_from_file(filename, chunk_size):
-    # Darn beautiful, from SO: https://stackoverflow.com/a/1035456
-
-    with open(filename, "rb") as f:
-        while True:
-            chunk = f.read(chunk_size)
-            if chunk:
-                yield bytearray(chunk)
-            else:
-                break
+def chunk_from_data(data, chunk_size):
+    for pos in range(0, len(data), chunk_size):
+        yield bytearray(data[pos:pos + chunk_size])
+    # The bootloader finishes on the first short chunk
+    if len(data) % chunk_size == 0:
+        yield bytearray()
 
 def crc16xmodem(data: bytes):
     crc = 0
@@ -620,17 +2526,50 @@ def run_upgrade(comms, fw_file_name, args):
         if chunk_size != ret_dict["chunk_size"]:
             print("Device selected chunk size {:d}".format(ret_dict["chunk_size"]))
             chunk_size = ret_dict["chunk_size"]
-        counter = 0
-        for chunk in chunk_from_file(fw_file_name, chunk_size):
-            counter += len(chunk)
-            sys.stdout.write("\rDownload progress: {:d}% ".format(int(counter / len(content) * 100)))
+        base = 0
+        resume_offset = ret_dict.get("resume_offset", 0)
+        if ret_dict.get("caps", 0) & protocol.UPGRADE_CAP_RESUME and 0 < resume_offset < len(content) and \
+                resume_offset % chunk_size == 0 and crc16xmodem(content[:resume_offset]) == ret_dict["resume_crc"]:
+            ret_dict = communicate(comms, create_upgrade_start(chunk_size, crc, protocol.UPGRADE_START_RESUME), args)
+            if ret_dict["status"] != protocol.UPGRADE_CONTINUE or ret_dict.get("resume_offset") != resume_offset:
+                fail("Device refused to resume the upgrade")
+            print("Resuming interrupted upgrade at {:d} bytes".format(resume_offset))
+            base = resume_offset
+        payload = content[base:]
+        compressed = False
+        if base == 0 and ret_dict.get("caps", 0) & protocol.UPGRADE_CAP_LZ and not args.no_compress:
+            packed = protocol.UPGRADE_LZ_MAGIC + lz.compress(content)
+            if len(packed) < len(content):
+                print("Sending compressed image, {:d} of {:d} bytes".format(len(packed), len(content)))
+                payload = packed
+                compressed = True
+        chunks = list(chunk_from_data(payload, chunk_size))
+        idx = 0
+        retries = 10  # For the whole upgrade, a chunk that keeps failing must not loop forever
+        # The bootloader acks a chunk on receipt and writes it while we send
+        # the next one, so erase and flash errors refer to the previous chunk
+        while idx < len(chunks):
+            chunk = chunks[idx]
+            counter = idx * chunk_size + len(chunk)
+            sys.stdout.write("\rDownload progress: {:d}% ".format(int(counter / max(len(payload), 1) * 100)))
             sys.stdout.flush()
             # print(" {:d} bytes".format(counter))
 
             ret_dict = communicate(comms, create_upgrade_data(chunk), args)
             status = ret_dict["status"]
+            retryable = status == protocol.UPGRADE_CHUNK_ERROR or \
+                (not compressed and status in (protocol.UPGRADE_ERASE_ERROR, protocol.UPGRADE_FLASH_ERROR))
+            if retryable and "offset" in ret_dict and retries > 0:
+                # Resume after the last chunk the device got written
+                retries -= 1
+                idx = (ret_dict["offset"] - base) // chunk_size
+                continue
+            idx += 1
             if status == protocol.UPGRADE_CONTINUE:
                 pass
+            elif status == protocol.UPGRADE_CHUNK_ERROR:
+                print("")
+                fail("device reported corrupted upgrade data")
             elif status == protocol.UPGRADE_CRC_ERROR:
                 print("")
                 fail("device reported CRC error")
@@ -652,10 +2591,70 @@ def run_upgrade(comms, fw_file_name, args):
         fail("Device rejected firmware upgrade")
 
 
-def best_fit(X, Y):
+# HTTP port of the WiFi proxy, HTTP_PORT in esp8266-proxy/webserver.h
+PROXY_HTTP_PORT = 80
+
+# The bootloader runs at 9600 baud, a 64kB image takes a few minutes
+PROXY_UPGRADE_TIMEOUT_S = 300
+
+
+def run_proxy_upgrade(args):
+    """
+    Upload the firmware to the WiFi proxy of the device, which stores it and
+    upgrades the DPS on its own, and follow the progress
+    """
+    if_name = args.device or os.environ.get('DPSIF', '')
+    if not is_ip_address(if_name):
+        fail("--proxy-upgrade needs the IP address of a WiFi proxy")
+    with open(args.proxy_upgrade, mode='rb') as file:
+        content = file.read()
+    if codecs.encode(content, 'hex')[6:8] != b'20':
+        fail("The firmware file does not seem valid")
+    url = "http://{}:{:d}/api/upgrade".format(if_name.partition(':')[0], PROXY_HTTP_PORT)
+    try:
+        request = urllib.request.Request(url, data=content, headers={'Content-Type': 'application/octet-stream'})
+        with urllib.request.urlopen(request, timeout=30) as response:
+            result = json.loads(response.read().decode())
+    except (urllib.error.URLError, socket.timeout, ValueError) as e:
+        fail("firmware upload failed ({})".format(e))
+    if not result.get('success'):
+        fail("the proxy rejected the firmware")
+    if result['upgrade']['crc'] != crc16xmodem(content):
+        fail("the proxy stored a corrupted image")
+    print("Uploaded {:d} bytes, the proxy is upgrading the DPS".format(len(content)))
+    deadline = time.time() + PROXY_UPGRADE_TIMEOUT_S
+    while time.time() < deadline:
+        time.sleep(0.5)
+        try:
+            with urllib.request.urlopen(url, timeout=5) as response:
+                status = json.loads(response.read().decode())
+        except (urllib.error.URLError, socket.timeout, ValueError):
+            continue  # The proxy is busy talking to the bootloader
+        if status['state'] in ('pending', 'upgrading'):
+            sys.stdout.write("\rUpgrade progress: {:d}% ".format(int(status['offset'] / max(status['length'], 1) * 100)))
+            sys.stdout.flush()
+        elif status['state'] == 'done':
+            print("")
+            return
+        else:
+            print("")
+            fail("the upgrade failed (status {:d})".format(status['status']))
+    print("")
+    fail("timeout waiting for the upgrade to finish")
+
+
+def least_squares(X, Y):
     """
     Calculate linear line of best fit coefficients (y = kx + c)
     """
+    if numpy is not None:
+        x = numpy.asarray(X, dtype=float)
+        y = numpy.asarray(Y, dtype=float)
+        if numpy.ptp(x) == 0:
+            return float('Inf'), float('NaN')
+        k, c = numpy.polyfit(x, y, 1)
+        return float(k), float(c)
+
     xbar = sum(X)/len(X)
     ybar = sum(Y)/len(Y)
     n = len(X)  # or len(Y)
@@ -672,16 +2671,131 @@ def best_fit(X, Y):
     return k, c
 
 
-def get_average_calibration_result(comms, variable, num_samples=20):
+def best_fit(X, Y, reject=None):
+    """
+    Calculate linear line of best fit coefficients (y = kx + c). With reject,
+    points further off the line than reject standard deviations of the
+    residuals are dropped and the line fitted again until none are, keeping
+    at least three points. The deviation is estimated from the median of the
+    residuals so a single bad point cannot hide itself.
+    """
+    points = list(zip(X, Y))
+    k, c = least_squares(X, Y)
+    while reject and len(points) > 3 and not math.isinf(k):
+        residuals = [y - (k * x + c) for x, y in points]
+        deviations = sorted(abs(r) for r in residuals)
+        sigma = 1.4826 * deviations[len(deviations) // 2]
+        if sigma == 0:
+            sigma = math.sqrt(sum(r ** 2 for r in residuals) / len(residuals))
+        kept = [p for p, r in zip(points, residuals) if abs(r) <= reject * sigma]
+        if sigma == 0 or len(kept) == len(points) or len(kept) < 3:
+            break
+        points = kept
+        k, c = least_squares([x for x, _ in points], [y for _, y in points])
+    return k, c
+
+
+def read_cal_data(comms):
+    """
+    Wait for the next CMD_CAL_DATA frame and return its contents
+    """
+    for _ in range(10):
+        f = read_frame(comms)
+        if f and f.get_frame()[0] == protocol.CMD_CAL_DATA:
+            return unpack_cal_data(f)
+    fail("timeout waiting for calibration data")
+
+
+def fit_cal_lut(X, Y, max_points=protocol.CAL_LUT_MAX_POINTS):
+    """
+    Reduce the measured points (X, Y) to a calibration table of at most
+    max_points points, returns None if no valid table can be made
+    """
+    pts = sorted(zip(X, Y))
+    n = len(pts)
+    if n > max_points:
+        pts = [pts[i] for i in sorted(set(round(i * (n - 1) / (max_points - 1)) for i in range(max_points)))]
+    lut = []
+    for x, y in pts:
+        x, y = int(round(x)), int(round(y))
+        if not (0 <= x <= 0xffff and 0 <= y <= 0xffff):
+            continue
+        # The device requires both columns to be strictly increasing
+        if lut and (x <= lut[-1][0] or y <= lut[-1][1]):
+            continue
+        lut.append((x, y))
+    return lut if len(lut) >= 2 else None
+
+
+def lut_apply(lut, x):
+    """
+    Evaluate a calibration table like the device does
+    """
+    i = 0
+    while i < len(lut) - 2 and lut[i + 1][0] <= x:
+        i += 1
+    (x0, y0), (x1, y1) = lut[i], lut[i + 1]
+    return y0 + (x - x0) * (y1 - y0) / (x1 - x0)
+
+
+def set_calibration_lut(comms, channel, lut):
+    """
+    Upload a calibration table, returns False if the device does not
+    support tables or rejected this one
+    """
+    comms.write(create_set_cal_lut(channel, lut).get_frame())
+    f = read_frame(comms)
+    return f is not None and f.get_frame()[0] == protocol.CMD_RESPONSE | protocol.CMD_SET_CAL_LUT and f.get_frame()[1] == 1
+
+
+def get_average_calibration_result(comms, variable, num_samples=20, adc_samples=1024):
     """
-    Get an averaged reading of 'variable' from a calibration report
+    Get an averaged reading of 'variable' from a calibration report. The device
+    averages adc_samples readings itself, firmware that returns a full report
+    instead is polled num_samples times.
     """
-    data = []
-    for _ in range(num_samples):
+    data = communicate(comms, create_cal_report(adc_samples), args, quiet=True)
+    if 'cal' not in data:
+        return read_cal_data(comms)[variable]
+    data = [data]
+    for _ in range(num_samples - 1):
         data.append(communicate(comms, create_cmd(protocol.CMD_CAL_REPORT), args, quiet=True))
     return sum(d[variable] for d in data) / num_samples
 
 
+# Settling time and ADC samples averaged at each point of the sweeps with a load
+CAL_LOAD_SETTLE_MS = 500
+CAL_LOAD_SAMPLES = 1024
+
+# Serialises the operator prompts of the devices calibrated in fleet mode
+cal_input_lock = threading.Lock()
+
+
+def cal_input(prompt):
+    """
+    Ask the calibration operator, one device at a time in fleet mode
+    """
+    with cal_input_lock:
+        return input(prompt)
+
+
+def cal_sweep(comms, channel, start, step, points, variable, settle_ms=10, adc_samples=16):
+    """
+    Have the device step a DAC through points values and return the averaged
+    reading of 'variable' at each of them, or all cal data if variable is None
+    """
+    communicate(comms, create_cal_sweep(channel, start, step, points, settle_ms, adc_samples), args, quiet=True)
+    readings = []
+    for x in range(points):
+        data = read_cal_data(comms)
+        if not data['status']:
+            fail("calibration sweep aborted by device")
+        readings.append(data[variable] if variable else data)
+        if not x % 4:
+            print(".", end='', flush=True)
+    return readings
+
+
 def create_comms(args):
     """
     Create and return a communications interface object or None if no comms if
@@ -703,6 +2817,12 @@ def create_comms(args):
             comms = tty_interface(if_name, args.baudrate)
     else:
         fail("no comms interface specified")
+    if args.address is not None:
+        if not 1 <= args.address < protocol.BUS_ADDRESS_BROADCAST:
+            fail("bus address must be between 1 and {:d}".format(protocol.BUS_ADDRESS_BROADCAST - 1))
+        comms = bus_interface(comms, args.address)
+    if args.capture:
+        comms = capture_interface(comms, args.capture.replace("{device}", if_name.replace("/", "_").replace(":", "_")))
     return comms
 
 
@@ -717,7 +2837,7 @@ def do_calibration(comms, args):
     print("\t2 stable input voltages\r\n")
     print("Please ensure nothing is connected to the output of the DPS before starting calibration!\r\n")
 
-    t = input("Would you like to proceed? (y/n): ")
+    t = cal_input("Would you like to proceed? (y/n): ")
     if t.lower() != 'y':
         return
 
@@ -730,13 +2850,13 @@ def do_calibration(comms, args):
 
     print("Please hook up the first lower supply voltage to the DPS now")
     print("ensuring that the serial connection is connected after boot")
-    calibration_input_voltage.append(float(input("Type input voltage in mV: ")))
+    calibration_input_voltage.append(float(cal_input("Type input voltage in mV: ")))
     calibration_vin_adc.append(get_average_calibration_result(comms, 'vin_adc'))
 
     # Do second Voltage Hookup
     print("\r\nPlease hook up the second higher supply voltage to the DPS now")
     print("ensuring that the serial connection is connected after boot")
-    calibration_input_voltage.append(float(input("Type input voltage in mV: ")))
+    calibration_input_voltage.append(float(cal_input("Type input voltage in mV: ")))
     
     # Ensure that we are still on the settings screen
     communicate(comms, create_change_screen(protocol.CHANGE_SCREEN_SETTINGS), args, quiet=True)
@@ -746,7 +2866,7 @@ def do_calibration(comms, args):
     calibration_vin_adc.append(get_average_calibration_result(comms, 'vin_adc'))
 
     # Calculate and set the Vin_ADC coeffecients
-    vin_adc_k, vin_adc_c = best_fit(calibration_vin_adc, calibration_input_voltage)
+    vin_adc_k, vin_adc_c = best_fit(calibration_vin_adc, calibration_input_voltage, args.cal_reject)
     args.calibration_set = ['VIN_ADC_K={}'.format(vin_adc_k), 'VIN_ADC_C={}'.format(vin_adc_c)]
     payload = create_set_calibration(args.calibration_set)
     communicate(comms, payload, args, quiet=True)
@@ -780,19 +2900,10 @@ def do_calibration(comms, args):
 
     # To find the maximum output V_DAC value we sweep through a range of output DAC values and read back the ADC values
     num_steps = 100
-    output_adc = []
-    output_dac = []
+    dac_step = 4095 // num_steps
+    output_dac = [x * dac_step for x in range(num_steps + 1)]
     output_gradient = []
-    for x in range(num_steps + 1):
-        output_dac.append(x*(4095/num_steps))
-        args.parameter = ["V_DAC={}".format(output_dac[-1])]
-        payload = create_set_parameter(args.parameter)
-        communicate(comms, payload, args, quiet=True)
-        time.sleep(0.01)
-        data = communicate(comms, create_cmd(protocol.CMD_CAL_REPORT), args, quiet=True)
-        output_adc.append(data['vout_adc'])
-        if not x % 4:
-            print(".", end='')
+    output_adc = cal_sweep(comms, protocol.CAL_SWEEP_V_DAC, 0, dac_step, num_steps + 1, 'vout_adc')
     print(" Done")
 
     # Once this is complete we calculate the gradient between every other point
@@ -833,7 +2944,7 @@ def do_calibration(comms, args):
     payload = create_set_parameter(args.parameter)
     communicate(comms, payload, args, quiet=True)
     communicate(comms, create_enable_output("on"), args, quiet=True)  # Turn the output on
-    calibration_real_voltage.append(float(input("Type measured voltage on output in mV: ")))
+    calibration_real_voltage.append(float(cal_input("Type measured voltage on output in mV: ")))
     calibration_v_adc.append(get_average_calibration_result(comms, 'vout_adc'))
     calibration_v_dac.append(output_dac)
 
@@ -842,18 +2953,18 @@ def do_calibration(comms, args):
     args.parameter = ["V_DAC={}".format(output_dac)]
     payload = create_set_parameter(args.parameter)
     communicate(comms, payload, args, quiet=True)
-    calibration_real_voltage.append(float(input("Type measured voltage on output in mV: ")))
+    calibration_real_voltage.append(float(cal_input("Type measured voltage on output in mV: ")))
     calibration_v_adc.append(get_average_calibration_result(comms, 'vout_adc'))
     calibration_v_dac.append(output_dac)
 
     # Calculate and set the V_DAC coeffecients
-    v_dac_k, v_dac_c = best_fit(calibration_real_voltage, calibration_v_dac)
+    v_dac_k, v_dac_c = best_fit(calibration_real_voltage, calibration_v_dac, args.cal_reject)
     args.calibration_set = ['V_DAC_K={}'.format(v_dac_k), 'V_DAC_C={}'.format(v_dac_c)]
     payload = create_set_calibration(args.calibration_set)
     communicate(comms, payload, args, quiet=True)
 
     # Calculate and set the V_ADC coeffecients
-    v_adc_k, v_adc_c = best_fit(calibration_v_adc, calibration_real_voltage)
+    v_adc_k, v_adc_c = best_fit(calibration_v_adc, calibration_real_voltage, args.cal_reject)
     args.calibration_set = ['V_ADC_K={}'.format(v_adc_k), 'V_ADC_C={}'.format(v_adc_c)]
     payload = create_set_calibration(args.calibration_set)
     communicate(comms, payload, args, quiet=True)
@@ -897,9 +3008,9 @@ def do_calibration(comms, args):
         plt.show()
 
     print("\r\nOutput Current Calibration:")
-    max_dps_current = float(input("Max output current of your DPS (e.g 5 for the DPS5005) in amps: "))
-    load_resistance = float(input("Load resistance in ohms: "))
-    load_max_wattage = float(input("Load wattage rating in watts: "))
+    max_dps_current = float(cal_input("Max output current of your DPS (e.g 5 for the DPS5005) in amps: "))
+    load_resistance = float(cal_input("Load resistance in ohms: "))
+    load_max_wattage = float(cal_input("Load wattage rating in watts: "))
 
     # There are three potential limiting factors for the output voltage, these are:
     output_voltage_based_on_input_voltage_mv = calibration_input_voltage[1] * 0.9  # 90% of input voltage
@@ -910,39 +3021,38 @@ def do_calibration(comms, args):
 
     # The more max_output_voltage_mv is maximised the more accurate the results of the current calibration will be
 
-    input("Please connect the load to the output of the DPS, then press enter")
+    cal_input("Please connect the load to the output of the DPS, then press enter")
 
-    # Take multiple current readings at different voltages and construct an Iout vs Iadc array
+    # Take multiple current readings at different voltages and construct an Iout vs Iadc array,
+    # the device steps the V_DAC and averages V_out and I_out at each point on its own
     print("Calibrating output current ADC", end='')
     num_steps = 15
-    calibration_i_out = []
-    calibration_a_adc = []
-    for x in range(num_steps):
-        # Calculate our output voltage DAC value
-        output_voltage = max_output_voltage_mv * (x / num_steps)
-        output_dac = int(round(v_dac_k * output_voltage + v_dac_c))
-
-        # Set the output voltage
-        args.parameter = ["V_DAC={}".format(output_dac)]
-        payload = create_set_parameter(args.parameter)
-        communicate(comms, payload, args, quiet=True)
-        communicate(comms, create_enable_output("on"), args, quiet=True)
-        time.sleep(1)  # Wait for the DPS output to settle
-
-        # Add these readings to our array
-        calibration_i_out.append((get_average_calibration_result(comms, 'vout_adc') * v_adc_k + v_dac_c) / load_resistance)
-        calibration_a_adc.append(get_average_calibration_result(comms, 'iout_adc'))
-        print(".", end='')
+    start_dac = max(0, int(round(v_dac_c)))
+    dac_step = max(1, min(int(v_dac_k * max_output_voltage_mv / num_steps), (4095 - start_dac) // (num_steps - 1)))
+    args.parameter = ["V_DAC={}".format(start_dac)]
+    payload = create_set_parameter(args.parameter)
+    communicate(comms, payload, args, quiet=True)
+    communicate(comms, create_enable_output("on"), args, quiet=True)
+    readings = cal_sweep(comms, protocol.CAL_SWEEP_V_DAC, start_dac, dac_step, num_steps, None, CAL_LOAD_SETTLE_MS, CAL_LOAD_SAMPLES)
+    calibration_i_out = [(data['vout_adc'] * v_adc_k + v_adc_c) / load_resistance for data in readings]
+    calibration_a_adc = [data['iout_adc'] for data in readings]
     print(" Done")
 
     communicate(comms, create_enable_output("off"), args, quiet=True)  # Turn the output off
 
     # Calculate and set the A_ADC coeffecients
-    a_adc_k, a_adc_c = best_fit(calibration_a_adc, calibration_i_out)
+    a_adc_k, a_adc_c = best_fit(calibration_a_adc, calibration_i_out, args.cal_reject)
     args.calibration_set = ['A_ADC_K={}'.format(a_adc_k), 'A_ADC_C={}'.format(a_adc_c)]
     payload = create_set_calibration(args.calibration_set)
     communicate(comms, payload, args, quiet=True)
 
+    # Also fit a table to correct the nonlinearity at low currents, if the device supports tables
+    a_adc_lut = fit_cal_lut(calibration_a_adc, calibration_i_out)
+    if a_adc_lut and set_calibration_lut(comms, 'A_ADC', a_adc_lut):
+        print("A_ADC calibration table of {:d} points set".format(len(a_adc_lut)))
+    else:
+        a_adc_lut = None
+
     # Draw data in graph
     if calibration_debug_plotting:
         plt.title("Output Current Calibration (A_ADC)")
@@ -962,7 +3072,7 @@ def do_calibration(comms, args):
         plt.show()
 
     print("\r\nConstant Current Calibration:")
-    input("Please short the output of the DPS with a thick wire capable of carrying {}A, then press enter".format(max_dps_current))
+    cal_input("Please short the output of the DPS with a thick wire capable of carrying {}A, then press enter".format(max_dps_current))
 
     # Set the V_DAC output to the maximum
     args.parameter = ["V_DAC={}".format(4095)]
@@ -972,21 +3082,11 @@ def do_calibration(comms, args):
     # Sweep the full range of the A_DAC so we can find out what its workable region is
     print("\r\nFinding maximum output A_DAC value", end='')
     num_steps = 100
-    calibration_a_adc = []
-    calibration_a_dac = []
+    dac_step = 4095 // num_steps
+    calibration_a_dac = [x * dac_step for x in range(num_steps + 1)]
     output_gradient = []
-    for x in range(num_steps + 1):
-        calibration_a_dac.append(int(x*(4095/num_steps)))
-        args.parameter = ["A_DAC={}".format(calibration_a_dac[-1])]
-        payload = create_set_parameter(args.parameter)
-        communicate(comms, payload, args, quiet=True)
-        communicate(comms, create_enable_output("on"), args, quiet=True)
-        time.sleep(0.01)
-
-        data = communicate(comms, create_cmd(protocol.CMD_CAL_REPORT), args, quiet=True)
-        calibration_a_adc.append(data['iout_adc'])
-        if not x % 4:
-            print(".", end='')
+    communicate(comms, create_enable_output("on"), args, quiet=True)
+    calibration_a_adc = cal_sweep(comms, protocol.CAL_SWEEP_A_DAC, 0, dac_step, num_steps + 1, 'iout_adc')
     print(" Done")
 
     communicate(comms, create_enable_output("off"), args, quiet=True)  # Turn the output off
@@ -1027,36 +3127,32 @@ def do_calibration(comms, args):
         plt.axis(xmin=0, ymin=0)
         plt.show()
 
-    # Take multiple current readings in this range
+    # Take multiple current readings in this range, swept and averaged by the device
     print("Calibrating output current DAC", end='')
     num_steps = 15
-    calibration_i_out = []
-    calibration_a_dac = []
-    for x in range(num_steps):
-        # Calculate our output current DAC value
-        output_dac = int(a_dac_lower_range + ((a_dac_upper_range - a_dac_lower_range) * (x / num_steps)))
-
-        # Set the output current
-        args.parameter = ["A_DAC={}".format(output_dac)]
-        payload = create_set_parameter(args.parameter)
-        communicate(comms, payload, args, quiet=True)
-        communicate(comms, create_enable_output("on"), args, quiet=True)
-        time.sleep(1)  # Wait for the DPS output to settle
-
-        # Add these readings to our array
-        calibration_i_out.append((get_average_calibration_result(comms, 'iout_adc') * a_adc_k + a_adc_c))
-        calibration_a_dac.append(output_dac)
-        print(".", end='')
+    start_dac = int(a_dac_lower_range)
+    dac_step = max(1, int((a_dac_upper_range - a_dac_lower_range) / num_steps))
+    args.parameter = ["A_DAC={}".format(start_dac)]
+    payload = create_set_parameter(args.parameter)
+    communicate(comms, payload, args, quiet=True)
+    communicate(comms, create_enable_output("on"), args, quiet=True)
+    readings = cal_sweep(comms, protocol.CAL_SWEEP_A_DAC, start_dac, dac_step, num_steps, 'iout_adc', CAL_LOAD_SETTLE_MS, CAL_LOAD_SAMPLES)
+    calibration_i_out = [lut_apply(a_adc_lut, i_adc) if a_adc_lut else i_adc * a_adc_k + a_adc_c for i_adc in readings]
+    calibration_a_dac = [start_dac + x * dac_step for x in range(num_steps)]
     print(" Done")
 
     communicate(comms, create_enable_output("off"), args, quiet=True)  # Turn the output off
 
     # Calculate and set the A_DAC coeffecients
-    a_dac_k, a_dac_c = best_fit(calibration_i_out, calibration_a_dac)
+    a_dac_k, a_dac_c = best_fit(calibration_i_out, calibration_a_dac, args.cal_reject)
     args.calibration_set = ['A_DAC_K={}'.format(a_dac_k), 'A_DAC_C={}'.format(a_dac_c)]
     payload = create_set_calibration(args.calibration_set)
     communicate(comms, payload, args, quiet=True)
 
+    a_dac_lut = fit_cal_lut(calibration_i_out, calibration_a_dac)
+    if a_adc_lut and a_dac_lut and set_calibration_lut(comms, 'A_DAC', a_dac_lut):
+        print("A_DAC calibration table of {:d} points set".format(len(a_dac_lut)))
+
     # Draw data in graph
     if calibration_debug_plotting:
         plt.title("Output Current Calibration (A_DAC)")
@@ -1082,7 +3178,7 @@ def do_calibration(comms, args):
     print("To restore the device to the OpenDPS defaults use dpsctl.py --calibration_reset")
 
 
-def uhej_worker_thread():
+def uhej_worker_thread(quiet=False):
     """
     The worker thread used by uHej for service discovery
     """
@@ -1105,8 +3201,9 @@ def uhej_worker_thread():
                         key = "{}:{}:{}".format(f["source"], s["port"], s["type"])
                         if key not in discovery_list:
                             if s["service_name"] == "opendps":
-                                discovery_list[key] = True  # Keep track of which hosts we have seen
-                                print("{}".format(f["source"]))
+                                discovery_list[key] = f["source"]  # Keep track of which hosts we have seen
+                                if not quiet:
+                                    print("{}".format(f["source"]))
                                 # print("{:>16}:{:<5d}  {:<8} {}".format(f["source"], s["port"], types[s["type"]], s["service_name"]))
             except uhej.IllegalFrameException as e:
                 pass
@@ -1114,30 +3211,159 @@ def uhej_worker_thread():
             print('Exception', e)
 
 
-def uhej_scan():
+# Unsolicited announcements of the WiFi proxies, ANNOUNCE_GROUP and
+# ANNOUNCE_PORT in esp8266-proxy/dpsproxy.c
+DISCOVERY_GROUP = "239.255.79.68"
+DISCOVERY_PORT = 5006
+
+# Devices found are kept here, scans answer from it while it is fresh
+DISCOVERY_CACHE = os.path.join(os.path.expanduser("~"), ".cache", "opendps", "devices.json")
+
+# The proxies announce every 30s, a device silent for longer is forgotten
+DISCOVERY_CACHE_TTL_S = 120
+
+
+def read_discovery_cache():
     """
-    Scan for OpenDPS devices on the local network
+    Return the cached devices as a dictionary of address to the time last
+    seen, leaving out the ones not heard from within DISCOVERY_CACHE_TTL_S
+    """
+    try:
+        with open(DISCOVERY_CACHE) as f:
+            devices = json.load(f)
+    except (IOError, ValueError):
+        return {}
+    if not isinstance(devices, dict):
+        return {}
+    now = time.time()
+    return {addr: seen for addr, seen in devices.items()
+            if isinstance(seen, (int, float)) and now - seen < DISCOVERY_CACHE_TTL_S}
+
+
+def write_discovery_cache(found):
+    """
+    Add found, a dictionary of address to the time seen, to the discovery
+    cache
+    """
+    devices = read_discovery_cache()
+    for addr, seen in found.items():
+        devices[addr] = max(seen, devices.get(addr, 0))
+    try:
+        os.makedirs(os.path.dirname(DISCOVERY_CACHE), exist_ok=True)
+        temp_name = "{}.{:d}".format(DISCOVERY_CACHE, os.getpid())
+        with open(temp_name, "w") as f:
+            json.dump(devices, f, indent=1, sort_keys=True)
+        os.replace(temp_name, DISCOVERY_CACHE)
+    except (IOError, OSError):
+        pass  # Scans still work, only slower
+
+
+def announcement_socket():
+    """
+    Return a socket receiving the announcements of the WiFi proxies, several
+    may be open at once
+    """
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    if hasattr(socket, "SO_REUSEPORT"):
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+    sock.bind(("", DISCOVERY_PORT))
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, socket.inet_aton(DISCOVERY_GROUP) + socket.inet_aton("0.0.0.0"))
+    return sock
+
+
+def is_announcement(data):
+    """
+    Check if a datagram is the announcement of an OpenDPS proxy, a JSON
+    object like {"service":"opendps","id":"00a1b2c3","udp":5005,"tcp":5005,"http":80}
+    """
+    try:
+        message = json.loads(data.decode())
+    except (ValueError, UnicodeDecodeError):
+        return False
+    return isinstance(message, dict) and message.get("service") == "opendps"
+
+
+def announcement_worker_thread(announce_sock, quiet=False):
+    """
+    Add the proxies announcing themselves during a scan to discovery_list
+    """
+    global discovery_list
+    while 1:
+        try:
+            data, addr = announce_sock.recvfrom(1024)
+        except socket.error:
+            return
+        key = "{}:announce".format(addr[0])
+        if is_announcement(data) and key not in discovery_list:
+            discovery_list[key] = addr[0]
+            if not quiet:
+                print("{}".format(addr[0]))
+
+
+def report_scan(num_found, quiet):
+    """
+    Print the number of devices a scan found
+    """
+    if quiet:
+        pass
+    elif num_found == 0:
+        print("No OpenDPS devices found")
+    elif num_found == 1:
+        print("1 OpenDPS device found")
+    else:
+        print("{:d} OpenDPS devices found".format(num_found))
+
+
+def uhej_scan(quiet=False, rescan=False):
+    """
+    Scan for OpenDPS devices on the local network, return their addresses.
+    Devices seen within DISCOVERY_CACHE_TTL_S, by an earlier scan or by
+    --discovery-daemon, are returned at once unless rescan is set.
     """
-    from uhej import uhej
     global discovery_list
     global sock
     discovery_list = {}
 
-    ANY = "0.0.0.0"
-    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    if not rescan:
+        cached = sorted(read_discovery_cache())
+        if cached:
+            if not quiet:
+                for addr in cached:
+                    print("{}".format(addr))
+            report_scan(len(cached), quiet)
+            return cached
+
     try:
-        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
-    except AttributeError:
-        pass
-    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 32)
-    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_LOOP, 1)
-    sock.bind((ANY, uhej.MCAST_PORT))
+        announce_sock = announcement_socket()
+    except socket.error:
+        announce_sock = None  # Port taken without SO_REUSEPORT, rely on uhej
+    else:
+        thread = threading.Thread(target=announcement_worker_thread, args=(announce_sock, quiet))
+        thread.daemon = True
+        thread.start()
+
+    try:
+        from uhej import uhej
+    except ImportError:
+        uhej = None  # Only proxies announcing themselves are found
+
+    ANY = "0.0.0.0"
+    if uhej:
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+        try:
+            sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        except AttributeError:
+            pass
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 32)
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_LOOP, 1)
+        sock.bind((ANY, uhej.MCAST_PORT))
 
-    thread = threading.Thread(target=uhej_worker_thread)
-    thread.daemon = True
-    thread.start()
+        thread = threading.Thread(target=uhej_worker_thread, args=(quiet,))
+        thread.daemon = True
+        thread.start()
 
-    sock.setsockopt(socket.SOL_IP, socket.IP_ADD_MEMBERSHIP, socket.inet_aton(uhej.MCAST_GRP) + socket.inet_aton(ANY))
+        sock.setsockopt(socket.SOL_IP, socket.IP_ADD_MEMBERSHIP, socket.inet_aton(uhej.MCAST_GRP) + socket.inet_aton(ANY))
 
     run_time_s = 6  # Run query for this many seconds
     query_interval_s = 2  # Send query this often
@@ -1145,38 +3371,296 @@ def uhej_scan():
     start_time = time.time()
 
     while time.time() - start_time < run_time_s:
-        if time.time() - last_query > query_interval_s:
+        if uhej and time.time() - last_query > query_interval_s:
             f = uhej.query(uhej.UDP, "*")
             sock.sendto(f, (uhej.MCAST_GRP, uhej.MCAST_PORT))
             last_query = time.time()
         time.sleep(1)
 
-    num_found = len(discovery_list)
-    if num_found == 0:
-        print("No OpenDPS devices found")
-    elif num_found == 1:
-        print("1 OpenDPS device found")
-    else:
-        print("{:d} OpenDPS devices found".format(num_found))
+    if announce_sock:
+        announce_sock.close()
+    found = sorted(set(discovery_list.values()))
+    write_discovery_cache({addr: time.time() for addr in found})
+    report_scan(len(found), quiet)
+    return found
 
 
-def main():
+# Port of the proxy protocol, UDP and TCP, served by --serve
+SERVE_PORT = 5005
+# Requests not answered within this many seconds are dropped
+SERVE_TIMEOUT_S = 2
+# UDP clients that have been quiet this long stop getting unsolicited frames
+SERVE_UDP_CLIENT_TTL_S = 60
+# Commands whose responses never change while the device runs
+SERVE_CACHED = (protocol.CMD_VERSION, protocol.CMD_CAPABILITIES, protocol.CMD_LIST_FUNCTIONS)
+
+
+class serve_client(object):
     """
-    Ye olde main
+    A client of the --serve daemon, a TCP connection or a UDP address
+    """
+
+    def __init__(self, sock, addr=None):
+        self.sock = sock
+        self.addr = addr
+        self.rx = bytearray()
+        self.seen = time.time()
+
+    def send(self, bytes_):
+        try:
+            if self.addr:
+                self.sock.sendto(bytes_, self.addr)
+            else:
+                self.sock.sendall(bytes_)
+        except socket.error:
+            pass  # Gone, a TCP client is cleaned up when its socket reads EOF
+
+
+class serve_daemon(object):
+    """
+    Owns the connection to one device and multiplexes the requests of any
+    number of local clients over it. Every request goes to the device in a
+    tagged envelope with a tag of the daemon's so the responses find their
+    way back whatever the order, up to the device's pipeline depth are in
+    flight. Frames the device sends on its own go to every client.
+    """
+
+    def __init__(self, comms, args):
+        self._comms = comms
+        self._args = args
+        self._lock = threading.Lock()
+        self._pending = {}    # tag -> (client, client tag or None, request, time sent)
+        self._queue = []      # (client, client tag or None, request) waiting for a free slot
+        self._cache = {}      # request -> response payload
+        self._clients = {}    # socket or UDP address -> serve_client
+        self._next_tag = 0
+        self._last_tx = 0
+        caps = device_capabilities(comms, args)
+        self._depth = max(1, caps['pipeline']) if caps and caps.get('status') else 1
+
+    def _reply(self, client, client_tag, payload):
+        f = uframe.uFrame()
+        if client_tag is not None:
+            f.pack8(protocol.CMD_RESPONSE | protocol.CMD_TAGGED)
+            f.pack8(client_tag)
+        f.pack_bytes(payload)
+        f.end()
+        client.send(f.get_frame())
+
+    def _send_queued(self):
+        """
+        Send queued requests while the pipeline has room, call with the lock held
+        """
+        while self._queue and len(self._pending) < self._depth:
+            client, client_tag, request = self._queue.pop(0)
+            while self._next_tag in self._pending:
+                self._next_tag = (self._next_tag + 1) & 0xff
+            tag = self._next_tag
+            self._next_tag = (tag + 1) & 0xff
+            f = uframe.uFrame()
+            f.pack8(protocol.CMD_TAGGED)
+            f.pack8(tag)
+            f.pack_bytes(request)
+            f.end()
+            self._pending[tag] = (client, client_tag, request, time.time())
+            self._last_tx = time.time()
+            self._comms.write(f.get_frame())
+
+    def request(self, client, bytes_):
+        """
+        Handle one frame from a client
+        """
+        f = uframe.uFrame()
+        if f.set_frame(bytearray(bytes_)) < 0:
+            return
+        payload = bytes(f.get_frame())
+        client_tag = None
+        if len(payload) > 2 and payload[0] == protocol.CMD_TAGGED:
+            client_tag = payload[1]
+            payload = payload[2:]
+        if not payload:
+            return
+        with self._lock:
+            if payload in self._cache:
+                self._reply(client, client_tag, self._cache[payload])
+                return
+            self._queue.append((client, client_tag, payload))
+            self._send_queued()
+
+    def expire(self):
+        """
+        Drop requests the device never answered, keep a negotiated baud rate
+        alive while the clients are idle
+        """
+        now = time.time()
+        with self._lock:
+            for tag in [t for t, p in self._pending.items() if now - p[3] > SERVE_TIMEOUT_S]:
+                del self._pending[tag]
+            if self._args.negotiate_baudrate and not self._pending and not self._queue and \
+               now - self._last_tx > protocol.SERIAL_BAUD_TIMEOUT_MS / 3000.0:
+                self._queue.append((None, None, bytes([protocol.CMD_PING])))
+            self._send_queued()
+
+    def device_thread(self):
+        """
+        Route the frames from the device to the clients
+        """
+        while True:
+            f = read_frame(self._comms)
+            if not f:
+                continue
+            tagged = unpack_tagged(f)
+            with self._lock:
+                if not tagged:
+                    # Sent on its own, eg. stream data or notifications
+                    now = time.time()
+                    for client in list(self._clients.values()):
+                        if not client.addr or now - client.seen < SERVE_UDP_CLIENT_TTL_S:
+                            self._reply(client, None, f.get_frame())
+                    continue
+                tag, resp = tagged
+                if tag not in self._pending:
+                    continue  # Timed out
+                client, client_tag, request, _ = self._pending.pop(tag)
+                payload = bytes(resp.get_frame())
+                if request[0] in SERVE_CACHED and len(request) == 1 and len(payload) > 1 and payload[1]:
+                    self._cache[request] = payload
+                if client:
+                    self._reply(client, client_tag, payload)
+                self._send_queued()
+
+    def run(self, host, port):
+        udp = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        udp.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        tcp = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        tcp.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        try:
+            udp.bind((host, port))
+            tcp.bind((host, port))
+            tcp.listen(8)
+        except socket.error as e:
+            fail("could not listen on {}:{:d} ({})".format(host, port, e))
+        print("Serving {} on UDP and TCP {}:{:d}".format(self._comms.name(), host, port))
+        th = threading.Thread(target=self.device_thread)
+        th.daemon = True
+        th.start()
+        while True:
+            readable, _, _ = select.select([udp, tcp] + [c for c in self._clients if isinstance(c, socket.socket)], [], [], 0.5)
+            for sock in readable:
+                if sock is tcp:
+                    conn, _ = tcp.accept()
+                    conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+                    with self._lock:
+                        self._clients[conn] = serve_client(conn)
+                elif sock is udp:
+                    data, addr = udp.recvfrom(1024)
+                    with self._lock:
+                        client = self._clients.setdefault(addr, serve_client(udp, addr))
+                        client.seen = time.time()
+                    self.request(client, data)
+                else:
+                    data = sock.recv(1024)
+                    client = self._clients[sock]
+                    if not data:
+                        with self._lock:
+                            del self._clients[sock]
+                        sock.close()
+                        continue
+                    client.rx += data
+                    # The frames of the stream end at EOF, like tcp_interface.read()
+                    while True:
+                        eof = client.rx.find(uframe._EOF)
+                        if eof < 0:
+                            break
+                        frame = client.rx[:eof + 1]
+                        del client.rx[:eof + 1]
+                        sof = frame.rfind(uframe._SOF)
+                        if sof >= 0:
+                            self.request(client, frame[sof:])
+            self.expire()
+
+
+def run_serve(comms, args):
+    """
+    Own the connection to the device and serve it to local clients over the
+    UDP and TCP protocol of the WiFi proxy until interrupted, so a logger and
+    dpsctl -d 127.0.0.1 can share a serial port
+    """
+    host, sep, port = args.serve.rpartition(':')
+    if not sep:
+        host, port = ('', args.serve) if args.serve.isdigit() else (args.serve, '')
+    if port and not port.isdigit():
+        fail("malformed serve address '{}'".format(args.serve))
+    if not comms.open():
+        fail("could not open {}".format(comms.name()))
+    serve_daemon(comms, args).run(host or '127.0.0.1', int(port) if port else SERVE_PORT)
+
+
+def run_discovery_daemon():
+    """
+    Keep the discovery cache up to date from the announcements of the WiFi
+    proxies until interrupted, so every scan answers at once
+    """
+    try:
+        announce_sock = announcement_socket()
+    except socket.error as e:
+        fail("could not listen for announcements ({})".format(e))
+    announce_sock.settimeout(1)
+    print("Listening for OpenDPS devices on {}:{:d}".format(DISCOVERY_GROUP, DISCOVERY_PORT))
+    known = set(read_discovery_cache())
+    pending = {}
+    while True:
+        try:
+            data, addr = announce_sock.recvfrom(1024)
+            if is_announcement(data):
+                pending[addr[0]] = time.time()
+                if addr[0] not in known:
+                    known.add(addr[0])
+                    print("{}".format(addr[0]))
+                continue
+        except socket.timeout:
+            pass
+        # Written at most once a second however many devices announce
+        if pending:
+            write_discovery_cache(pending)
+            pending = {}
+
+
+def create_parser(testing=False):
+    """
+    Return the command line parser, also used for the lines of --shell and
+    --script
     """
-    global args
-    testing = '--testing' in sys.argv
     parser = argparse.ArgumentParser(description='Instrument an OpenDPS device')
 
     parser.add_argument('-d', '--device', help="OpenDPS device to connect to. Can be a /dev/tty device, IP address for UDP protocol or tcp:IP for TCP protocol. If omitted, dpsctl.py will try the environment variable DPSIF", default='')
     parser.add_argument('-b', '--baudrate', type=int, dest="baudrate", help="Set baudrate used for serial communications", default=9600)
+    parser.add_argument('-A', '--address', type=int, help="Bus address (1..254) of the device on a serial line shared by several, see BUS_ADDRESS")
+    parser.add_argument('--negotiate-baudrate', type=str, metavar='BAUD', help="Switch the serial link to BAUD for the remaining commands, 'max' for the fastest rate the device supports")
     parser.add_argument('-B', '--brightness', type=int, help="Set display brightness (0..100)")
-    parser.add_argument('-S', '--scan', action="store_true", help="Scan for OpenDPS wifi devices")
+    parser.add_argument('--headless', choices=['on', 'off', 'status'], help="Turn the display off and stop drawing, or back on")
+    parser.add_argument('--headless-store', action='store_true', help="Also start in the --headless mode at power up")
+    parser.add_argument('--adc-profile', choices=list(protocol.ADC_PROFILES) + ['status'], help="Select the ADC acquisition profile, trading noise against bandwidth")
+    parser.add_argument('--adc-profile-store', action='store_true', help="Also select the --adc-profile at power up")
+    parser.add_argument('-S', '--scan', action="store_true", help="Scan for OpenDPS wifi devices, answered from the discovery cache while it is fresh")
+    parser.add_argument('--rescan', action="store_true", help="Scan the network even if the discovery cache is fresh")
+    parser.add_argument('--shell', action="store_true", help="Read dpsctl options from a prompt after running the other commands, keeping the connection open")
+    parser.add_argument('--script', type=str, metavar='FILE', help="Run the dpsctl options on each line of FILE ('-' for stdin) over one connection, stopping at the first failure")
+    parser.add_argument('--serve', type=str, nargs='?', const='127.0.0.1', metavar='[HOST][:PORT]', help="Own the device connection and serve it to other dpsctl instances and loggers over UDP and TCP (default 127.0.0.1:5005) until interrupted")
+    parser.add_argument('--discovery-daemon', action="store_true", help="Keep the discovery cache up to date from the announcements of the wifi devices until interrupted")
+    parser.add_argument('--fleet', type=str, metavar='DEVICES', help="Run the commands against several devices concurrently: a comma separated list, @FILE with one device per line or 'scan'")
+    parser.add_argument('--fleet-jobs', type=int, default=16, help="Number of devices talked to at the same time in fleet mode (default 16)")
     parser.add_argument('-f', '--function', nargs='?', help="Set active function")
     parser.add_argument('-F', '--list-functions', action='store_true', help="List available functions")
     parser.add_argument('-p', '--parameter', nargs='+', help="Set function parameter <name>=<value>")
+    parser.add_argument('--setpoint', type=str, metavar='V,I', help="Set voltage and/or current of the active function in volts and amps, either may be left empty (eg. '5,' or ',0.5')")
+    parser.add_argument('--at', type=float, metavar='SECONDS', help="Have the device(s) run the --enable, --parameter and --setpoint changes SECONDS from now instead, at the same moment on all devices with --fleet")
+    parser.add_argument('--clock-sync', action='store_true', help="Print the offset of the device clock to the host clock")
+    parser.add_argument('--schedule-status', action='store_true', help="Print the scheduled commands and how late those that ran were")
+    parser.add_argument('--schedule-cancel', action='store_true', help="Drop the scheduled commands")
     parser.add_argument('-P', '--list-parameters', action='store_true', help="List function parameters of active function")
     parser.add_argument('-C', '--calibrate', action="store_true", help="Starts System Calibration Routine")
+    parser.add_argument('--cal-reject', type=float, metavar='SIGMA', help="Drop calibration points further than SIGMA standard deviations off the fitted line (eg. 3)")
     parser.add_argument('-c', '--calibration_set', nargs='+', help="Set the specified calibration coefficient <name>=<value>")
     parser.add_argument('-cr', '--calibration_report', action="store_true", help="Prints Calibration report")
     parser.add_argument('--calibration_reset', action='store_true', help="Resets the calibration to the default values")
@@ -1191,9 +3675,69 @@ def main():
     parser.add_argument('-U', '--upgrade', type=str, dest="firmware", help="Perform upgrade of OpenDPS firmware")
     parser.add_argument('--screen', type=str, dest="switch_screen", help="Switch to 'settings' or 'main' screen")
     parser.add_argument('--force', action='store_true', help="Force upgrade even if dpsctl complains about the firmware")
+    parser.add_argument('--proxy-upgrade', type=str, metavar='FIRMWARE', help="Upload FIRMWARE to the WiFi proxy at the given IP address, which upgrades the DPS from its own flash")
+    parser.add_argument('--no-compress', action='store_true', help="Send the firmware uncompressed even if the bootloader supports compression")
+    parser.add_argument('--heartbeat', type=float, metavar='SECONDS', help="Ping every SECONDS and print the status and measurements each ping carries until interrupted, a * marks state changes")
+    parser.add_argument('--bench', type=str, nargs='?', const='all', metavar='MIXES', help="Time the link with the comma separated command mixes {} (default all) and print the latency, throughput and error rate of each".format(", ".join(BENCH_MIXES)))
+    parser.add_argument('--bench-count', type=int, default=200, metavar='N', help="Requests per mix of --bench (default 200)")
+    parser.add_argument('--bench-duration', type=float, default=5, metavar='SECONDS', help="Time the stream mix of --bench runs (default 5 s)")
+    parser.add_argument('--heartbeat-session', type=int, default=0, help="Compact query session the heartbeat uses (default 0)")
+    parser.add_argument('--stream', type=int, metavar='INTERVAL_MS', help="Stream V_out/I_out samples taken every INTERVAL_MS until interrupted")
+    parser.add_argument('--save-preset', type=int, metavar='SLOT', help="Store the active function and its settings in preset SLOT (M1/M2 are slots 0/1)")
+    parser.add_argument('--recall-preset', type=int, metavar='SLOT', help="Switch to the function and settings of preset SLOT")
+    parser.add_argument('--stage', nargs='+', metavar=('FUNCTION', 'NAME=VALUE'), help="Stage parameters of FUNCTION, active or not, for --switch-function. Without parameters the staged ones are dropped")
+    parser.add_argument('--switch-function', type=int, metavar='INDEX', help="Select function INDEX (as listed by -F) with its staged parameters applied in one step")
+    parser.add_argument('--notify', type=str, metavar='EVENTS', help="Print the comma separated events ({}) or 'all' as the device reports them until interrupted".format(", ".join(protocol.NOTIFY_EVENTS)))
+    parser.add_argument('--stream-batch', type=int, default=10, help="Number of samples per stream frame (default 10)")
+    parser.add_argument('--capture', type=str, metavar='FILE', help="Record the frames sent to and received from the device with timestamps to FILE for replay in the emulator (dpsemu -r). {device} in FILE is replaced by the device name")
+    parser.add_argument('--log', type=str, metavar='FILE', help="Log V_in/V_out/I_out to FILE until interrupted, binary columns or CSV if FILE ends with .csv. {device} in FILE is replaced by the device name")
+    parser.add_argument('--log-interval', type=int, default=10, metavar='MS', help="Sample interval when logging (default 10 ms)")
+    parser.add_argument('--log-duration', type=float, default=0, metavar='SECONDS', help="Stop logging after SECONDS")
+    parser.add_argument('--debug-log', type=str, metavar='FIRMWARE', help="Print the deferred debug log of a device built with DEFERRED_LOG=1 until interrupted, FIRMWARE is the opendps.bin it runs")
+    parser.add_argument('--record', type=str, metavar='TRIGGERS', help="Arm the ADC recorder with triggers now, ocp and/or ovp (comma separated)")
+    parser.add_argument('--record-decimation', type=int, default=1, help="Record every Nth ADC sample (default 1)")
+    parser.add_argument('--record-post', type=int, default=64, help="Number of samples to record after the trigger (default 64)")
+    parser.add_argument('--record-dump', action='store_true', help="Wait for the ADC recording to complete and print it")
+    parser.add_argument('--event-stats', action='store_true', help="Print the event queue drop counters")
+    parser.add_argument('--link-stats', action='store_true', help="Print the serial link error counters")
+    parser.add_argument('--link-stats-reset', action='store_true', help="Clear the serial link and event queue counters (after printing them with --link-stats)")
+    parser.add_argument('--sched-stats', action='store_true', help="Print the deadline misses and worst timing of the scheduled jobs")
+    parser.add_argument('--sched-stats-reset', action='store_true', help="Clear the scheduler statistics (after printing them with --sched-stats)")
+    parser.add_argument('--perf', action='store_true', help="Print the CPU cycles spent at each performance probe")
+    parser.add_argument('--perf-reset', action='store_true', help="Clear the performance probes (after printing them with --perf)")
+    parser.add_argument('--isr-hooks', action='store_true', help="Print the cycle budget, runs, overruns and longest run of each ADC ISR hook")
+    parser.add_argument('--isr-hooks-reset', action='store_true', help="Clear the ADC ISR hook accounting (after printing it with --isr-hooks)")
+    parser.add_argument('--cal-noise', action='store_true', help="Print the standard deviation and histogram of the raw V_out, V_in and I_out ADC codes over 4096 samples")
+    parser.add_argument('--ripple', type=str, metavar='FREQS', help="Print the ripple amplitude of the finished ADC recording at up to 8 frequencies in Hz (comma separated)")
+    parser.add_argument('--ripple-channel', type=str, default='v_out', help="Recorded channel to analyse, i_out, v_in or v_out (default v_out)")
+    parser.add_argument('--ripple-rate', type=int, default=0, help="ADC sample rate in Hz if known better than the device's nominal rate")
+    parser.add_argument('--impedance', type=str, metavar='FREQS', help="Measure the load impedance with the lock-in at frequencies in Hz (comma separated) or a log sweep start:stop:points, funcgen must be enabled with a sine")
+    parser.add_argument('--impedance-settle', type=int, default=2, help="Generator periods to settle at each frequency (default 2)")
+    parser.add_argument('--impedance-periods', type=int, default=10, help="Generator periods to measure at each frequency (default 10)")
+    parser.add_argument('--ocp-bench', type=int, metavar='RUNS', help="Trip the OCP RUNS times with the output enabled and print the response time (unloaded output at a safe setting)")
+    parser.add_argument('--load-stats', action='store_true', help="Print the CPU load and ADC ISR headroom")
+    parser.add_argument('--energy', action='store_true', help="Print the charge and energy delivered on the output")
+    parser.add_argument('--energy-reset', action='store_true', help="Clear the charge and energy totals (after printing them with --energy)")
+    parser.add_argument('--window-stats', action='store_true', help="Print the I_out and V_out min, max, mean and rms since the previous --window-stats")
+    parser.add_argument('--boot-times', action='store_true', help="Print when each startup phase completed")
+    parser.add_argument('--capabilities', action='store_true', help="Print the optional features and protocol limits of the device firmware")
+    parser.add_argument('--ram-stats', action='store_true', help="Print the RAM used by .data and .bss and the stack high water mark")
+    parser.add_argument('--wave', type=str, metavar='FILE', help="Upload an arbitrary waveform for function 3 of funcgen, levels 0.0-1.0 of the set voltage")
+    parser.add_argument('--seq', type=str, metavar='FILE', help="Upload a program for the seq function, one 'volts amps seconds' step per line")
+    parser.add_argument('--config-export', type=str, metavar='FILE', help="Save the settings and presets (not the calibration) to FILE, {device} is replaced by the device")
+    parser.add_argument('--config-import', type=str, metavar='FILE', help="Write settings saved with --config-export to the device, which then restarts")
+    parser.add_argument('--trip-snapshot', action='store_true', help="Print the samples frozen at the last OCP/OVP trip and re-arm")
     if testing:
         parser.add_argument('-t', '--temperature', type=str, dest="temperature", help="Send temperature report (for testing)")
+    return parser
 
+
+def main():
+    """
+    Ye olde main
+    """
+    global args
+    parser = create_parser('--testing' in sys.argv)
     args, unknown = parser.parse_known_args()
 
     try:
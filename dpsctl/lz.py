@@ -0,0 +1,107 @@
+"""
+The MIT License (MIT)
+
+Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+LZ compressor for the format decoded by opendps/unlz.c, used to shrink
+firmware images sent to the bootloader.
+"""
+
+MIN_MATCH = 3
+MAX_MATCH = 0x7f + MIN_MATCH
+MAX_LITERALS = 0x80
+MAX_DISTANCE = 0xffff
+MAX_CHAIN = 32  # Match candidates tried per position
+
+
+def compress(data):
+    """
+    Compress data, greedily taking the longest match at every position
+    """
+    out = bytearray()
+    literals = bytearray()
+    chains = {}
+
+    def flush_literals():
+        while literals:
+            run = literals[:MAX_LITERALS]
+            del literals[:MAX_LITERALS]
+            out.append(len(run) - 1)
+            out.extend(run)
+
+    def insert(pos):
+        if pos + MIN_MATCH <= len(data):
+            chains.setdefault(bytes(data[pos:pos + MIN_MATCH]), []).append(pos)
+
+    pos = 0
+    while pos < len(data):
+        best_len = 0
+        best_dist = 0
+        candidates = chains.get(bytes(data[pos:pos + MIN_MATCH]), [])
+        for cand in reversed(candidates[-MAX_CHAIN:]):
+            if pos - cand > MAX_DISTANCE:
+                break
+            length = 0
+            limit = min(MAX_MATCH, len(data) - pos)
+            while length < limit and data[cand + length] == data[pos + length]:
+                length += 1
+            if length > best_len:
+                best_len = length
+                best_dist = pos - cand
+                if length == limit:
+                    break
+        if best_len >= MIN_MATCH:
+            flush_literals()
+            out.append(0x80 | (best_len - MIN_MATCH))
+            out.append(best_dist >> 8)
+            out.append(best_dist & 0xff)
+            for i in range(best_len):
+                insert(pos + i)
+            pos += best_len
+        else:
+            literals.append(data[pos])
+            insert(pos)
+            pos += 1
+    flush_literals()
+    return out
+
+
+def decompress(data):
+    """
+    Reference decoder, mirrors unlz.c
+    """
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        ctrl = data[i]
+        i += 1
+        if ctrl & 0x80:
+            length = (ctrl & 0x7f) + MIN_MATCH
+            dist = data[i] << 8 | data[i + 1]
+            i += 2
+            if dist == 0 or dist > len(out):
+                raise ValueError("invalid distance")
+            for _ in range(length):
+                out.append(out[-dist])
+        else:
+            out.extend(data[i:i + ctrl + 1])
+            i += ctrl + 1
+    return out
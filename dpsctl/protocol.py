@@ -22,6 +22,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 """
 
+import math
 import struct
 
 from uframe import uFrame
@@ -49,8 +50,193 @@ CMD_SET_CALIBRATION = 19
 CMD_CLEAR_CALIBRATION = 20
 CMD_CHANGE_SCREEN = 21
 CMD_SET_BRIGHTNESS = 22
+CMD_STREAM_START = 23
+CMD_STREAM_STOP = 24
+CMD_STREAM_DATA = 25
+CMD_SET_BAUDRATE = 26
+CMD_TAGGED = 27
+CMD_BATCH = 28
+CMD_SET_PARAMETERS_BIN = 29
+CMD_GET_PARAMETERS_BIN = 30
+CMD_QUERY_COMPACT = 31
+CMD_RECORD_START = 32
+CMD_RECORD_DUMP = 33
+CMD_TRIP_SNAPSHOT = 34
+CMD_EVENT_STATS = 35
+CMD_WAVE_UPLOAD = 36
+CMD_SEQ_UPLOAD = 37
+CMD_CAL_SWEEP = 38
+CMD_CAL_DATA = 39
+CMD_SET_CAL_LUT = 40
+CMD_PERF_REPORT = 41
+CMD_LOAD_STATS = 42
+CMD_SET_SETPOINT = 43
+CMD_ENERGY_STATS = 44
+CMD_WINDOW_STATS = 45
+CMD_BOOT_TIMES = 46
+CMD_FRAGMENT = 47
+CMD_FRAGMENT_ACK = 48
+CMD_LOG = 49
+CMD_RAM_STATS = 50
+CMD_CLOCK_SYNC = 51
+CMD_SCHEDULE = 52
+CMD_SCHEDULE_STATUS = 53
+CMD_SCHEDULE_CANCEL = 54
+CMD_CAPABILITIES = 55
+CMD_SUBSCRIBE = 56
+CMD_NOTIFY = 57
+CMD_SAVE_PRESET = 58
+CMD_RECALL_PRESET = 59
+CMD_OCP_BENCH = 60
+CMD_RIPPLE = 61
+CMD_LOCKIN = 62
+CMD_ADDRESSED = 63
+CMD_CONFIG_EXPORT = 64
+CMD_CONFIG_IMPORT = 65
+CMD_LINK_STATS = 66
+CMD_SCHED_STATS = 67
+CMD_HEADLESS = 68
+CMD_ADC_PROFILE = 69
+CMD_ISR_HOOKS = 70
+CMD_STAGE_PARAMETERS = 71
+CMD_SWITCH_FUNCTION = 72
 CMD_RESPONSE = 0x80
 
+# Mask bits of CMD_SET_SETPOINT
+SETPOINT_VOLTAGE = 1 << 0
+SETPOINT_CURRENT = 1 << 1
+
+# Maximum number of samples in one CMD_STREAM_DATA frame
+STREAM_MAX_SAMPLES = 12
+
+# Maximum number of log words in one CMD_LOG frame
+LOG_MAX_WORDS = 14
+
+# Fields of a CMD_LOG entry header word
+LOG_ADDR_MASK = 0x0fffffff
+LOG_NARGS_SHIFT = 28
+
+# Maximum number of sub-commands in one CMD_BATCH frame
+BATCH_MAX_COMMANDS = 16
+
+# Longest command CMD_SCHEDULE accepts and the slot states of CMD_SCHEDULE_STATUS
+SCHEDULE_MAX_LENGTH = 32
+SCHEDULE_STATES = {1: 'pending', 2: 'done', 3: 'failed'}
+
+# CMD_PING heartbeat version and status word bits, the function index is in the high byte
+PING_VERSION = 1
+PING_STATUS_FLAGS = (('output', 1 << 0), ('cc', 1 << 1), ('ocp', 1 << 2), ('ovp', 1 << 3),
+                     ('thermal', 1 << 4), ('locked', 1 << 5))
+PING_STATUS_FUNC_SHIFT = 8
+
+# CMD_QUERY_COMPACT sessions, flags and fields in order of the changed mask
+QUERY_COMPACT_SESSIONS = 4
+QUERY_COMPACT_FULL = 1
+QUERY_COMPACT_RESET = 1
+QUERY_FIELDS = ('v_in', 'v_out', 'i_out', 'output_enabled', 'temp1', 'temp2', 'temp_shutdown')
+QUERY_MAX_FIELDS = 16
+
+# CMD_RECORD_START channel and trigger bits, recorder state when done
+RECORDER_CHANNELS = (('i_out', 1), ('v_in', 2), ('v_out', 4))
+RECORDER_TRIGGERS = {'now': 1, 'ocp': 2, 'ovp': 4}
+RECORDER_DONE = 3
+
+# CMD_TRIP_SNAPSHOT flags and trip causes
+TRIP_SNAPSHOT_CLEAR = 1
+TRIP_CAUSES = ('none', 'ocp', 'ovp')
+
+# CMD_EVENT_STATS sources in response order
+EVENT_SOURCES = ('buttons', 'uart', 'adc', 'main', 'timer')
+
+# CMD_WAVE_UPLOAD chunk size, flags and table size of the function generator
+WAVE_UPLOAD_CHUNK = 26
+WAVE_UPLOAD_COMMIT = 1
+WAVE_MAX_POINTS = 128
+
+# CMD_SEQ_UPLOAD chunk size, flags and program size of the sequencer
+SEQ_UPLOAD_CHUNK = 6
+SEQ_UPLOAD_COMMIT = 1
+SEQ_MAX_STEPS = 32
+
+# CMD_CONFIG_EXPORT and CMD_CONFIG_IMPORT chunk sizes and flags, the
+# CMD_CONFIG_IMPORT results, clone_status_t in clone.h
+CONFIG_EXPORT_CHUNK = 48
+CONFIG_IMPORT_CHUNK = 48
+CONFIG_IMPORT_COMMIT = 1
+CONFIG_IMPORT_RESULTS = ('ok', 'chunk out of order', 'unknown snapshot version', 'setting not part of a snapshot',
+                         'CRC mismatch', 'flash full')
+
+# CMD_CAL_SWEEP channels, CMD_CAL_DATA channels in frame order
+CAL_SWEEP_V_DAC = 0
+CAL_SWEEP_A_DAC = 1
+CAL_DATA_CHANNELS = ('vout_adc', 'vin_adc', 'iout_adc')
+
+# CMD_CAL_REPORT noise flag, the length of a noise response and its
+# histogram bins, adcnoise.h
+CAL_NOISE_STOP = 0x80
+CAL_NOISE_LENGTH = 55
+CAL_NOISE_BINS = 16
+
+# CMD_SET_CAL_LUT channels and table size
+CAL_LUT_CHANNELS = ('A_ADC', 'A_DAC', 'V_ADC', 'V_DAC', 'VIN_ADC')
+CAL_LUT_MAX_POINTS = 12
+
+# CMD_PERF_REPORT flags and probes in response order
+PERF_REPORT_RESET = 1
+PERF_PROBES = ('adc_isr', 'func_gen', 'handle_frame', 'uui_refresh', 'spi_dma', 'past_write')
+
+# CMD_ENERGY_STATS flags
+ENERGY_RESET = 1
+
+# CMD_LINK_STATS flags and counters in response order
+LINK_STATS_RESET = 1
+LINK_COUNTERS = ('frames', 'crc', 'length', 'aborted', 'rejected', 'tx_dropped', 'timeouts', 'overrun', 'noise',
+                 'rx_dropped', 'events')
+
+# CMD_SCHED_STATS flags and job flags
+SCHED_STATS_RESET = 1
+SCHED_JOB_CRITICAL = 1
+
+# CMD_HEADLESS flags
+HEADLESS_ENABLE = 1
+HEADLESS_STORE = 2
+
+# CMD_ADC_PROFILE profiles in adc_profile_t order and flags
+ADC_PROFILES = ('default', 'low-noise', 'high-speed')
+ADC_PROFILE_STORE = 1
+
+# CMD_ISR_HOOKS flags and hook slots in run order
+ISR_HOOKS_RESET = 1
+ISR_HOOKS = ('limit', 'vout_loop', 'energy', 'winstats', 'recorder', 'func_gen', 'lockin', 'adc_noise')
+
+# Fragments sent between acknowledgements and the largest command the
+# device takes as a message, see "Messages" in protocol.h
+MSG_WINDOW = 4
+MSG_MAX_COMMAND = 128
+
+# Baud rates the device accepts with CMD_SET_BAUDRATE
+# Startup phases of CMD_BOOT_TIMES in response order, boot_phase_t in opendps.h
+# The last is the time the bootloader ran rather than a timestamp
+BOOT_PHASES = ('hw_init', 'tft_init', 'past_init', 'settings', 'adc_ready', 'ui_init', 'ready', 'bootloader')
+
+SUPPORTED_BAUDRATES = (9600, 19200, 38400, 57600, 115200)
+
+# The device falls back to its default baud rate after this long without a frame
+SERIAL_BAUD_TIMEOUT_MS = 3000
+
+# CMD_CAPABILITIES feature bits, CAP_* in protocol.h
+CAPABILITIES = ('funcgen', 'sequencer', 'thermal_lockout', 'cal_lut', 'adc_recorder', 'trip_snapshot', 'perf',
+                'load_meter', 'stack_monitor', 'energy_meter', 'window_stats', 'deferred_log', 'schedule', 'notify',
+                'presets', 'ocp_bench', 'ripple', 'lockin', 'bus', 'config', 'headless', 'adc_profile',
+                'func_staging', 'adc_noise')
+
+# CMD_ADDRESSED address handled by every unit on the bus
+BUS_ADDRESS_BROADCAST = 0xff
+
+# CMD_NOTIFY events, notify_event_t in protocol.h, bit n of the CMD_SUBSCRIBE
+# mask subscribes to event n. The index of a trip is 1 for OCP, 2 for OVP
+NOTIFY_EVENTS = ('output', 'function', 'screen', 'parameter', 'limit_mode', 'thermal', 'trip', 'lock', 'regime')
+
 # wifi_status_t
 WIFI_OFF = 0
 WIFI_CONNECTING = 1
@@ -65,6 +251,14 @@ UPGRADE_CRC_ERROR = 2
 UPGRADE_ERASE_ERROR = 3
 UPGRADE_FLASH_ERROR = 4
 UPGRADE_OVERFLOW_ERROR = 5
+UPGRADE_PROTOCOL_ERROR = 6
+UPGRADE_CHUNK_ERROR = 7
+
+# Upgrade capabilities reported by the bootloader
+UPGRADE_CAP_LZ = 1 << 0
+UPGRADE_CAP_RESUME = 1 << 1
+UPGRADE_START_RESUME = 1 << 0
+UPGRADE_LZ_MAGIC = b"DPZ1"
 UPGRADE_SUCCESS = 16
 
 # options for cmd_change_screen
@@ -121,6 +315,38 @@ def create_set_parameter(parameter_list):
     return f
 
 
+def create_set_parameters_bin(values):
+    """
+    Values is a list of (index, value) tuples, index as given by CMD_LIST_PARAMETERS
+    """
+    f = uFrame()
+    f.pack8(CMD_SET_PARAMETERS_BIN)
+    for index, value in values:
+        f.pack8(index)
+        f.pack32(value)
+    f.end()
+    return f
+
+
+def create_set_setpoint(mv=None, ma=None):
+    """
+    Set the voltage and/or current setting of the current function, a value
+    left as None is not changed
+    """
+    mask = 0
+    if mv is not None:
+        mask |= SETPOINT_VOLTAGE
+    if ma is not None:
+        mask |= SETPOINT_CURRENT
+    f = uFrame()
+    f.pack8(CMD_SET_SETPOINT)
+    f.pack8(mask)
+    f.pack32(int(mv or 0) & 0xffffffff)
+    f.pack32(int(ma or 0) & 0xffffffff)
+    f.end()
+    return f
+
+
 def create_set_calibration(parameter_list):
     f = uFrame()
     f.pack8(CMD_SET_CALIBRATION)
@@ -130,8 +356,7 @@ def create_set_calibration(parameter_list):
             return None
         else:
             f.pack_cstr(parts[0].lstrip().rstrip())
-            for t in bytearray(struct.pack("f", float(parts[1].lstrip().rstrip()))):
-                f.pack8(t)
+            f.pack_bytes(struct.pack("f", float(parts[1].lstrip().rstrip())))
     f.pack8(0)
     f.end()
     return f
@@ -174,11 +399,13 @@ def create_ocp(i_cut):
     return f
 
 
-def create_upgrade_start(window_size, crc):
+def create_upgrade_start(window_size, crc, flags=None):
     f = uFrame()
     f.pack8(CMD_UPGRADE_START)
     f.pack16(window_size)
     f.pack16(crc)
+    if flags is not None:
+        f.pack8(flags)  # Only understood by the bootloader
     f.end()
     return f
 
@@ -186,8 +413,7 @@ def create_upgrade_start(window_size, crc):
 def create_upgrade_data(data):
     f = uFrame()
     f.pack8(CMD_UPGRADE_DATA)
-    for d in data:
-        f.pack8(d)
+    f.pack_bytes(data)
     f.end()
     return f
 
@@ -219,6 +445,404 @@ def create_set_brightness(brightness):
     return f
 
 
+def create_set_baudrate(baudrate):
+    f = uFrame()
+    f.pack8(CMD_SET_BAUDRATE)
+    f.pack32(baudrate)
+    f.end()
+    return f
+
+
+def create_stream_start(interval_ms, batch):
+    f = uFrame()
+    f.pack8(CMD_STREAM_START)
+    f.pack16(interval_ms)
+    f.pack8(batch)
+    f.end()
+    return f
+
+
+def create_subscribe(mask):
+    f = uFrame()
+    f.pack8(CMD_SUBSCRIBE)
+    f.pack16(mask)
+    f.end()
+    return f
+
+
+def create_save_preset(slot):
+    f = uFrame()
+    f.pack8(CMD_SAVE_PRESET)
+    f.pack8(slot)
+    f.end()
+    return f
+
+
+def create_recall_preset(slot):
+    f = uFrame()
+    f.pack8(CMD_RECALL_PRESET)
+    f.pack8(slot)
+    f.end()
+    return f
+
+
+def create_stage_parameters(function, parameter_list):
+    """
+    Stage <name>=<value> parameters for a function that need not be the
+    active one, an empty list drops the values staged for it
+    """
+    f = uFrame()
+    f.pack8(CMD_STAGE_PARAMETERS)
+    f.pack_cstr(function)
+    for p in parameter_list:
+        parts = p.split("=")
+        if len(parts) != 2:
+            return None
+        f.pack_cstr(parts[0].strip())
+        f.pack_cstr(parts[1].strip())
+    f.end()
+    return f
+
+
+def create_switch_function(index):
+    f = uFrame()
+    f.pack8(CMD_SWITCH_FUNCTION)
+    f.pack8(index)
+    f.end()
+    return f
+
+
+def create_ocp_bench(runs):
+    f = uFrame()
+    f.pack8(CMD_OCP_BENCH)
+    f.pack8(runs)
+    f.end()
+    return f
+
+
+def create_ripple(channel, rate, freqs):
+    """
+    Analyse the ripple of a recorded channel (RECORDER_CHANNELS bit) at up to
+    8 frequencies in Hz, rate 0 is the nominal ADC rate of the device
+    """
+    f = uFrame()
+    f.pack8(CMD_RIPPLE)
+    f.pack8(channel)
+    f.pack32(rate)
+    f.pack8(len(freqs))
+    for freq in freqs:
+        f.pack16(freq)
+    f.end()
+    return f
+
+
+def create_lockin(settle=0, periods=0):
+    """
+    Start a lock-in measurement against the function generator, skipping
+    settle periods and accumulating periods, or read it with periods 0
+    """
+    f = uFrame()
+    f.pack8(CMD_LOCKIN)
+    f.pack8(settle)
+    f.pack16(periods)
+    f.end()
+    return f
+
+
+def create_ping(session, full=False):
+    """
+    Heartbeat ping, answered with the status word and the changes since the
+    last ping or compact query of the session
+    """
+    f = uFrame()
+    f.pack8(CMD_PING)
+    f.pack8(PING_VERSION)
+    f.pack8(session)
+    f.pack8(QUERY_COMPACT_FULL if full else 0)
+    f.end()
+    return f
+
+
+def create_query_compact(session, full=False):
+    f = uFrame()
+    f.pack8(CMD_QUERY_COMPACT)
+    f.pack8(session)
+    f.pack8(QUERY_COMPACT_FULL if full else 0)
+    f.end()
+    return f
+
+
+def create_record_start(channels, decimation, post_count, triggers):
+    f = uFrame()
+    f.pack8(CMD_RECORD_START)
+    f.pack8(channels)
+    f.pack16(decimation)
+    f.pack16(post_count)
+    f.pack8(triggers)
+    f.end()
+    return f
+
+
+def create_record_dump(offset):
+    f = uFrame()
+    f.pack8(CMD_RECORD_DUMP)
+    f.pack16(offset)
+    f.end()
+    return f
+
+
+def create_config_export(offset):
+    f = uFrame()
+    f.pack8(CMD_CONFIG_EXPORT)
+    f.pack16(offset)
+    f.end()
+    return f
+
+
+def create_config_import(offset, data, commit=False):
+    """
+    Write data, a chunk of a settings snapshot, at offset
+    """
+    f = uFrame()
+    f.pack8(CMD_CONFIG_IMPORT)
+    f.pack8(CONFIG_IMPORT_COMMIT if commit else 0)
+    f.pack16(offset)
+    f.pack8(len(data))
+    f.pack_bytes(bytes(data))
+    f.end()
+    return f
+
+
+def create_trip_snapshot(offset, clear=False):
+    f = uFrame()
+    f.pack8(CMD_TRIP_SNAPSHOT)
+    f.pack8(offset)
+    f.pack8(TRIP_SNAPSHOT_CLEAR if clear else 0)
+    f.end()
+    return f
+
+
+def create_wave_upload(offset, samples, commit=False):
+    f = uFrame()
+    f.pack8(CMD_WAVE_UPLOAD)
+    f.pack8(WAVE_UPLOAD_COMMIT if commit else 0)
+    f.pack8(offset)
+    f.pack8(len(samples))
+    f.pack_bytes(struct.pack(">{:d}H".format(len(samples)), *samples))
+    f.end()
+    return f
+
+
+def create_seq_upload(index, steps, commit=False):
+    """
+    steps is a list of (mv, ma, duration_us) tuples
+    """
+    f = uFrame()
+    f.pack8(CMD_SEQ_UPLOAD)
+    f.pack8(SEQ_UPLOAD_COMMIT if commit else 0)
+    f.pack8(index)
+    f.pack8(len(steps))
+    for step in steps:
+        f.pack_bytes(struct.pack(">HHI", *step))
+    f.end()
+    return f
+
+
+def create_cal_report(samples):
+    """
+    Ask for an average of samples ADC readings, pushed as a CMD_CAL_DATA frame
+    """
+    f = uFrame()
+    f.pack8(CMD_CAL_REPORT)
+    f.pack16(samples)
+    f.end()
+    return f
+
+
+def create_cal_noise(channel, stop=False):
+    """
+    Ask for the noise of a channel, an index into CAL_DATA_CHANNELS, over the
+    last full window
+    """
+    f = uFrame()
+    f.pack8(CMD_CAL_REPORT)
+    f.pack8(channel | (CAL_NOISE_STOP if stop else 0))
+    f.end()
+    return f
+
+
+def create_cal_sweep(channel, start, step, points, settle_ms, samples):
+    f = uFrame()
+    f.pack8(CMD_CAL_SWEEP)
+    f.pack8(channel)
+    f.pack16(start)
+    f.pack16(step)
+    f.pack8(points)
+    f.pack16(settle_ms)
+    f.pack16(samples)
+    f.end()
+    return f
+
+
+def create_set_cal_lut(channel, points):
+    """
+    points is a list of (x, y) tuples with both x and y strictly increasing,
+    an empty list removes the table of the channel
+    """
+    f = uFrame()
+    f.pack8(CMD_SET_CAL_LUT)
+    f.pack8(CAL_LUT_CHANNELS.index(channel))
+    f.pack8(len(points))
+    for point in points:
+        f.pack_bytes(struct.pack(">HH", *point))
+    f.end()
+    return f
+
+
+def create_perf_report(offset, reset=False):
+    f = uFrame()
+    f.pack8(CMD_PERF_REPORT)
+    f.pack8(offset)
+    f.pack8(PERF_REPORT_RESET if reset else 0)
+    f.end()
+    return f
+
+
+def create_isr_hooks(offset, reset=False):
+    f = uFrame()
+    f.pack8(CMD_ISR_HOOKS)
+    f.pack8(offset)
+    f.pack8(ISR_HOOKS_RESET if reset else 0)
+    f.end()
+    return f
+
+
+def create_energy_stats(reset=False):
+    f = uFrame()
+    f.pack8(CMD_ENERGY_STATS)
+    f.pack8(ENERGY_RESET if reset else 0)
+    f.end()
+    return f
+
+
+def create_link_stats(reset=False):
+    f = uFrame()
+    f.pack8(CMD_LINK_STATS)
+    f.pack8(LINK_STATS_RESET if reset else 0)
+    f.end()
+    return f
+
+
+def create_sched_stats(reset=False):
+    f = uFrame()
+    f.pack8(CMD_SCHED_STATS)
+    f.pack8(SCHED_STATS_RESET if reset else 0)
+    f.end()
+    return f
+
+
+def create_headless(flags=None):
+    f = uFrame()
+    f.pack8(CMD_HEADLESS)
+    if flags is not None:
+        f.pack8(flags)
+    f.end()
+    return f
+
+
+def create_adc_profile(profile=None, store=False):
+    f = uFrame()
+    f.pack8(CMD_ADC_PROFILE)
+    if profile is not None:
+        f.pack8(profile)
+        f.pack8(ADC_PROFILE_STORE if store else 0)
+    f.end()
+    return f
+
+
+def create_fragment(msg, index, flags=0):
+    """
+    Fragment index of a uMessage holding a command
+    """
+    f = uFrame()
+    f.pack8(CMD_FRAGMENT)
+    msg.pack_fragment(f, index, flags)
+    f.end()
+    return f
+
+
+def create_fragment_ack(msg_id, next_):
+    """
+    Acknowledge the fragments of a response message up to next
+    """
+    f = uFrame()
+    f.pack8(CMD_FRAGMENT_ACK)
+    f.pack8(msg_id)
+    f.pack8(next_)
+    f.end()
+    return f
+
+
+def create_tagged(tag, frame):
+    """
+    Wrap a frame created by one of the helpers above in a CMD_TAGGED envelope
+    """
+    inner = uFrame()
+    inner.set_frame(bytearray(frame.get_frame()))
+    f = uFrame()
+    f.pack8(CMD_TAGGED)
+    f.pack8(tag)
+    f.pack_bytes(inner.get_frame())
+    f.end()
+    return f
+
+
+def create_addressed(address, frame):
+    """
+    Wrap a frame created by one of the helpers above, or by create_tagged(),
+    in a CMD_ADDRESSED envelope for the unit at address on a shared bus
+    """
+    inner = uFrame()
+    inner.set_frame(bytearray(frame.get_frame()))
+    f = uFrame()
+    f.pack8(CMD_ADDRESSED)
+    f.pack8(address)
+    f.pack_bytes(inner.get_frame())
+    f.end()
+    return f
+
+
+def create_batch(frames):
+    """
+    Pack frames created by the helpers above into one CMD_BATCH frame
+    """
+    f = uFrame()
+    f.pack8(CMD_BATCH)
+    f.pack8(len(frames))
+    for frame in frames:
+        inner = uFrame()
+        inner.set_frame(bytearray(frame.get_frame()))
+        f.pack8(len(inner.get_frame()))
+        f.pack_bytes(inner.get_frame())
+    f.end()
+    return f
+
+
+def create_schedule(at_us, frame):
+    """
+    Wrap a frame created by one of the helpers above, or by create_batch(), in
+    a CMD_SCHEDULE frame running it when the device clock reaches at_us
+    """
+    inner = uFrame()
+    inner.set_frame(bytearray(frame.get_frame()))
+    f = uFrame()
+    f.pack8(CMD_SCHEDULE)
+    f.pack64(at_us)
+    f.pack_bytes(inner.get_frame())
+    f.end()
+    return f
+
+
 # ########################################################################## #
 # Helpers for unpacking frames.
 #
@@ -235,6 +859,40 @@ def unpack_response(uframe):
     return uframe.unpack8()
 
 
+def unpack_batch_response(uframe):
+    """
+    Returns a list with the status of each sub-command run by the device
+    """
+    uframe.unpack8()  # command
+    uframe.unpack8()  # status
+    return [uframe.unpack8() for _ in range(uframe.unpack8())]
+
+
+def unpack_tagged(uframe):
+    """
+    Returns (tag, response) for a tagged response, None if it is not tagged
+    """
+    payload = uframe.get_frame()
+    if len(payload) < 2 or payload[0] != CMD_RESPONSE | CMD_TAGGED:
+        return None
+    f = uFrame()
+    f.set_payload(payload[2:])
+    return (payload[1], f)
+
+
+def unpack_addressed(uframe):
+    """
+    Returns (address, response) for an addressed response, None if it is not
+    addressed
+    """
+    payload = uframe.get_frame()
+    if len(payload) < 2 or payload[0] != CMD_RESPONSE | CMD_ADDRESSED:
+        return None
+    f = uFrame()
+    f.set_payload(payload[2:])
+    return (payload[1], f)
+
+
 def unpack_power_enable(uframe):
     """
     Returns enable
@@ -313,6 +971,28 @@ def unpack_cal_report(uframe):
     return data
 
 
+def unpack_cal_noise(uframe):
+    """
+    Returns the noise of a channel over a window in raw ADC codes, windows is
+    0 until the first window is full. hist counts the samples of the codes
+    center - CAL_NOISE_BINS / 2 and up, the first and last bins also those
+    beyond
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    data['channel'] = CAL_DATA_CHANNELS[uframe.unpack8()]
+    data['windows'] = uframe.unpack32()
+    data['samples'] = uframe.unpack16()
+    data['center'] = uframe.unpack16()
+    data['min'] = uframe.unpack16()
+    data['max'] = uframe.unpack16()
+    data['mean'] = uframe.unpack32() / 65536.0
+    data['stddev'] = uframe.unpack32() / 256.0
+    data['hist'] = [uframe.unpack16() for _ in range(CAL_NOISE_BINS)]
+    return data
+
+
 def unpack_wifi_status(uframe):
     """
     Returns wifi_status
@@ -364,3 +1044,533 @@ def unpack_version_response(uframe):
     data['boot_git_hash'] = uframe.unpack_cstr()
     data['app_git_hash'] = uframe.unpack_cstr()
     return data
+
+
+def unpack_parameters_bin(uframe):
+    """
+    Returns a list of the parameter values in index order
+    """
+    uframe.unpack8()  # command
+    uframe.unpack8()  # status
+    return [uframe.unpacks32() for _ in range(uframe.unpack8())]
+
+
+def unpack_query_compact(uframe, fields):
+    """
+    Apply the deltas to fields, the session's list of QUERY_MAX_FIELDS values,
+    where parameters of the current function follow QUERY_FIELDS.
+    Returns the indices of the fields that changed.
+    """
+    uframe.unpack8()  # command
+    uframe.unpack8()  # status
+    uframe.unpack8()  # session
+    if uframe.unpack8() & QUERY_COMPACT_RESET:
+        fields[:] = [0] * QUERY_MAX_FIELDS
+    changed = uframe.unpack16()
+    indices = [i for i in range(QUERY_MAX_FIELDS) if changed & (1 << i)]
+    for i in indices:
+        zz = 0
+        shift = 0
+        while True:
+            b = uframe.unpack8()
+            zz |= (b & 0x7f) << shift
+            shift += 7
+            if not b & 0x80:
+                break
+        fields[i] += (zz >> 1) ^ -(zz & 1)
+    return indices
+
+
+def unpack_ping(uframe, fields):
+    """
+    Returns a dictionary of the heartbeat status and applies its deltas to
+    fields as unpack_query_compact() does. A device without the heartbeat
+    only returns the status.
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if uframe.eof():
+        return data
+    data['version'] = uframe.unpack8()
+    status = uframe.unpack16()
+    data['flags'] = [name for name, bit in PING_STATUS_FLAGS if status & bit]
+    data['function'] = status >> PING_STATUS_FUNC_SHIFT
+    data['seq'] = uframe.unpack16()
+    uframe.unpack8()  # session
+    if uframe.unpack8() & QUERY_COMPACT_RESET:
+        fields[:] = [0] * QUERY_MAX_FIELDS
+    changed = uframe.unpack16()
+    data['changed'] = [i for i in range(QUERY_MAX_FIELDS) if changed & (1 << i)]
+    for i in data['changed']:
+        zz = 0
+        shift = 0
+        while True:
+            b = uframe.unpack8()
+            zz |= (b & 0x7f) << shift
+            shift += 7
+            if not b & 0x80:
+                break
+        fields[i] += (zz >> 1) ^ -(zz & 1)
+    return data
+
+
+def unpack_record_dump(uframe):
+    """
+    Returns a dictionary of the recording details and the samples in this chunk
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    data['state'] = uframe.unpack8()
+    data['channels'] = uframe.unpack8()
+    data['decimation'] = uframe.unpack16()
+    data['trigger'] = uframe.unpack8()
+    data['trigger_us'] = uframe.unpack64()
+    data['pre_count'] = uframe.unpack16()
+    data['total'] = uframe.unpack16()
+    data['offset'] = uframe.unpack16()
+    data['samples'] = list(uframe.unpack_struct("{:d}H".format(uframe.unpack8())))
+    return data
+
+
+def unpack_config_export(uframe):
+    """
+    Returns a dictionary of the snapshot length and the bytes in this chunk
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    data['total'] = uframe.unpack16()
+    data['offset'] = uframe.unpack16()
+    data['data'] = bytes(uframe.unpack_struct("{:d}B".format(uframe.unpack8())))
+    return data
+
+
+def unpack_config_import(uframe):
+    """
+    Returns a dictionary with the result, an index in CONFIG_IMPORT_RESULTS
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    data['result'] = uframe.unpack8()
+    return data
+
+
+def unpack_event_stats(uframe):
+    """
+    Returns a dictionary with the drops, peak and size of each event source
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    data['sources'] = {}
+    for i in range(uframe.unpack8()):
+        name = EVENT_SOURCES[i] if i < len(EVENT_SOURCES) else str(i)
+        data['sources'][name] = {'drops': uframe.unpack32(), 'peak': uframe.unpack16(), 'size': uframe.unpack16()}
+    return data
+
+
+def unpack_link_stats(uframe):
+    """
+    Returns a dictionary with the LINK_COUNTERS of the serial link
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if not data['status']:
+        return data
+    for name in LINK_COUNTERS:
+        data[name] = uframe.unpack32()
+    return data
+
+
+def unpack_sched_stats(uframe):
+    """
+    Returns a dictionary with the deadline statistics of each watched job
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    data['jobs'] = {}
+    if not data['status']:
+        return data
+    for i in range(uframe.unpack8()):
+        name = uframe.unpack_cstr()
+        flags = uframe.unpack8()
+        data['jobs'][name] = {'critical': bool(flags & SCHED_JOB_CRITICAL), 'deadline_ms': uframe.unpack16(),
+                              'runs': uframe.unpack32(), 'misses': uframe.unpack16(),
+                              'late_max_us': uframe.unpack32(), 'run_max_us': uframe.unpack32()}
+    return data
+
+
+def unpack_headless(uframe):
+    """
+    Returns a dictionary telling if the unit is headless
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if data['status']:
+        data['headless'] = bool(uframe.unpack8())
+    return data
+
+
+def unpack_adc_profile(uframe):
+    """
+    Returns a dictionary of the ADC profile, its sample set rate and decimation
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if data['status']:
+        profile = uframe.unpack8()
+        data['profile'] = ADC_PROFILES[profile] if profile < len(ADC_PROFILES) else profile
+        data['rate_hz'] = uframe.unpack32()
+        data['decimation'] = uframe.unpack16()
+    return data
+
+
+def unpack_trip_snapshot(uframe):
+    """
+    Returns a dictionary of the trip details, samples is a list of
+    (i_out, v_in, v_out) raw tuples in this chunk
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    data['trip'] = uframe.unpack8()
+    data['time_us'] = uframe.unpack32()
+    data['v_dac'] = uframe.unpack16()
+    data['i_dac'] = uframe.unpack16()
+    data['total'] = uframe.unpack8()
+    data['offset'] = uframe.unpack8()
+    count = uframe.unpack8()
+    fields = uframe.unpack_struct("{:d}H".format(3 * count))
+    data['samples'] = list(zip(fields[0::3], fields[1::3], fields[2::3]))
+    return data
+
+
+def unpack_perf_report(uframe):
+    """
+    Returns a dictionary of the frame contents, probes is a dictionary of the
+    calls, min, max and mean CPU cycles of each probe in this chunk
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    data['probes'] = {}
+    if not data['status']:
+        return data
+    data['clock_hz'] = uframe.unpack32()
+    data['total'] = uframe.unpack8()
+    data['offset'] = uframe.unpack8()
+    for i in range(data['offset'], data['offset'] + uframe.unpack8()):
+        name = PERF_PROBES[i] if i < len(PERF_PROBES) else str(i)
+        data['probes'][name] = {'calls': uframe.unpack32(), 'min': uframe.unpack32(),
+                                'max': uframe.unpack32(), 'mean': uframe.unpack32()}
+    return data
+
+
+def unpack_isr_hooks(uframe):
+    """
+    Returns a dictionary of the frame contents, hooks is a dictionary of the
+    budget, runs, overruns and longest run in CPU cycles of each hook slot
+    in this chunk
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    data['hooks'] = {}
+    if not data['status']:
+        return data
+    data['total'] = uframe.unpack8()
+    data['offset'] = uframe.unpack8()
+    for i in range(data['offset'], data['offset'] + uframe.unpack8()):
+        name = ISR_HOOKS[i] if i < len(ISR_HOOKS) else str(i)
+        data['hooks'][name] = {'enabled': bool(uframe.unpack8()), 'budget': uframe.unpack16(),
+                               'runs': uframe.unpack32(), 'overruns': uframe.unpack32(),
+                               'max': uframe.unpack32()}
+    return data
+
+
+def unpack_ocp_bench(uframe):
+    """
+    Returns a dictionary of the frame contents, the number of runs that
+    tripped and the min, max and mean OCP latency in CPU cycles
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if not data['status']:
+        return data
+    data['clock_hz'] = uframe.unpack32()
+    data['count'] = uframe.unpack8()
+    data['min'] = uframe.unpack32()
+    data['max'] = uframe.unpack32()
+    data['mean'] = uframe.unpack32()
+    return data
+
+
+def unpack_ripple(uframe):
+    """
+    Returns a dictionary of the frame contents, mean, rms and amplitudes are
+    in raw ADC counts
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if not data['status']:
+        return data
+    data['samples'] = uframe.unpack16()
+    data['min'] = uframe.unpack16()
+    data['max'] = uframe.unpack16()
+    data['mean'] = uframe.unpack32() / 256.0
+    data['rms'] = uframe.unpack32() / 256.0
+    data['dominant'] = uframe.unpack8()
+    count = uframe.unpack8()
+    data['amplitude'] = [uframe.unpack32() / 256.0 for _ in range(count)]
+    return data
+
+
+def unpack_lockin(uframe):
+    """
+    Returns a dictionary of the frame contents, the DC levels and phasors are
+    in raw ADC counts and freq in Hz. The start response holds just the status.
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if not data['status'] or uframe.eof():
+        return data
+    data['state'] = uframe.unpack8()
+    data['freq'] = uframe.unpack16() / 10.0
+    data['samples'] = uframe.unpack32()
+    data['i_dc'] = uframe.unpack32() / 256.0
+    data['v_dc'] = uframe.unpack32() / 256.0
+    data['i'] = complex(uframe.unpacks32() / 256.0, uframe.unpacks32() / 256.0)
+    data['v'] = complex(uframe.unpacks32() / 256.0, uframe.unpacks32() / 256.0)
+    return data
+
+
+def unpack_load_stats(uframe):
+    """
+    Returns a dictionary of the frame contents, idle and isr are in percent of
+    the last window
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if not data['status']:
+        return data
+    data['window_ms'] = uframe.unpack16()
+    data['idle'] = uframe.unpack16() / 10.0
+    data['isr'] = uframe.unpack16() / 10.0
+    data['isr_max_us'] = uframe.unpack16()
+    data['isr_calls'] = uframe.unpack32()
+    data['overruns'] = uframe.unpack32()
+    return data
+
+
+def unpack_energy_stats(uframe):
+    """
+    Returns a dictionary of the frame contents, charge in Ah, energy in Wh and
+    runtime in seconds
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if not data['status']:
+        return data
+    data['charge'] = uframe.unpack32() / 1e6
+    data['energy'] = uframe.unpack32() / 1e6
+    data['runtime'] = uframe.unpack32() / 1000.0
+    return data
+
+
+def unpack_window_stats(uframe):
+    """
+    Returns a dictionary of the frame contents, the min, max, mean and rms of
+    I_out in mA as 'i_out' and of V_out in mV as 'v_out'
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if not data['status']:
+        return data
+    data['samples'] = uframe.unpack32()
+    data['window_ms'] = uframe.unpack32()
+    for name in ('i_out', 'v_out'):
+        data[name] = {'min': uframe.unpack16(), 'max': uframe.unpack16(), 'mean': uframe.unpack16(),
+                      'rms': math.sqrt(uframe.unpack32())}
+    return data
+
+
+def unpack_ram_stats(uframe):
+    """
+    Returns a dictionary of the frame contents, all sizes in bytes
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if not data['status']:
+        return data
+    data['data'] = uframe.unpack16()
+    data['bss'] = uframe.unpack16()
+    data['ramfunc'] = uframe.unpack16()
+    data['stack'] = uframe.unpack16()
+    data['stack_peak'] = uframe.unpack16()
+    return data
+
+
+def unpack_boot_times(uframe):
+    """
+    Returns a dictionary of the frame contents, 'phases' maps the names in
+    BOOT_PHASES to ms since power up, phases unknown to us are named by index
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if not data['status']:
+        return data
+    count = uframe.unpack8()
+    data['phases'] = {}
+    for i in range(count):
+        name = BOOT_PHASES[i] if i < len(BOOT_PHASES) else str(i)
+        data['phases'][name] = uframe.unpack32()
+    return data
+
+
+def unpack_log(uframe):
+    """
+    Returns a dictionary of the frame contents, entries is a list of
+    (format address, [args]) tuples
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['dropped'] = uframe.unpack16()
+    data['entries'] = []
+    words = list(uframe.unpack_struct("{:d}I".format((len(uframe.get_frame()) - uframe._unpack_pos) // 4)))
+    i = 0
+    while i < len(words):
+        nargs = words[i] >> LOG_NARGS_SHIFT
+        data['entries'].append((words[i] & LOG_ADDR_MASK, words[i + 1:i + 1 + nargs]))
+        i += 1 + nargs
+    return data
+
+
+def unpack_fragment_ack(uframe):
+    """
+    Returns (msg_id, next) of a CMD_FRAGMENT_ACK response
+    """
+    uframe.unpack8()
+    msg_id = uframe.unpack8()
+    next_ = uframe.unpack8()
+    return (msg_id, next_)
+
+
+def unpack_cal_data(uframe):
+    """
+    Returns a dictionary of the frame contents, the mean and variance of each
+    channel in CAL_DATA_CHANNELS are in raw ADC units as <name> and <name>_var
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    data['index'] = uframe.unpack8()
+    data['vout_dac'] = uframe.unpack16()
+    data['iout_dac'] = uframe.unpack16()
+    data['samples'] = uframe.unpack16()
+    if data['status'] and data['samples']:
+        for name in CAL_DATA_CHANNELS:
+            data[name] = uframe.unpack32() / 65536
+            data[name + '_var'] = uframe.unpack32() / 256
+    return data
+
+
+def unpack_stream_data(uframe):
+    """
+    Returns a dictionary of the frame contents, samples is a list of
+    (v_out, i_out) tuples
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['seq'] = uframe.unpack16()
+    data['interval_ms'] = uframe.unpack16()
+    data['v_in'] = uframe.unpack16()
+    fields = uframe.unpack_struct("{:d}H".format(2 * uframe.unpack8()))
+    data['samples'] = list(zip(fields[0::2], fields[1::2]))
+    return data
+
+
+def unpack_notify(uframe):
+    """
+    Returns a dictionary of the frame contents, event is the name in
+    NOTIFY_EVENTS or the number of an event this version does not know
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['seq'] = uframe.unpack8()
+    event = uframe.unpack8()
+    data['event'] = NOTIFY_EVENTS[event] if event < len(NOTIFY_EVENTS) else event
+    data['index'] = uframe.unpack8()
+    data['value'] = uframe.unpacks32()
+    if data['event'] == 'regime':
+        # The device's cur_time_us() of the transition, unsigned
+        data['value'] &= 0xffffffff
+    return data
+
+
+def unpack_clock_sync(uframe):
+    """
+    Returns a dictionary of the frame contents, now_us is the device time
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if not data['status']:
+        return data
+    data['now_us'] = uframe.unpack64()
+    return data
+
+
+def unpack_capabilities(uframe):
+    """
+    Returns a dictionary of the frame contents, features is a list of the
+    names in CAPABILITIES the device has and baudrates the rates it accepts
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if not data['status']:
+        return data
+    features = uframe.unpack32()
+    data['features'] = [name for bit, name in enumerate(CAPABILITIES) if features & (1 << bit)]
+    (data['max_frame'], data['max_msg'], data['msg_window'], data['batch'], data['schedule'], data['pipeline'],
+     data['stream_samples'], data['stream_min_ms'], data['baudrate']) = uframe.unpack_struct("HHBBBBBHI")
+    data['baudrates'] = list(uframe.unpack_struct("{:d}I".format(uframe.unpack8())))
+    return data
+
+
+def unpack_schedule_status(uframe):
+    """
+    Returns a dictionary of the frame contents with a list of the used slots
+    """
+    data = {}
+    data['command'] = uframe.unpack8()
+    data['status'] = uframe.unpack8()
+    if not data['status']:
+        return data
+    data['now_us'] = uframe.unpack64()
+    data['slots'] = []
+    while len(uframe.get_frame()) - uframe._unpack_pos >= 15:
+        slot = {}
+        slot['slot'] = uframe.unpack8()
+        state = uframe.unpack8()
+        slot['state'] = SCHEDULE_STATES.get(state, state)
+        slot['cmd'] = uframe.unpack8()
+        slot['at_us'] = uframe.unpack64()
+        slot['late_us'] = uframe.unpack32()
+        data['slots'].append(slot)
+    return data
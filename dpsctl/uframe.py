@@ -22,6 +22,9 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 """
 
+import binascii
+import struct
+
 _SOF = 0x7e
 _DLE = 0x7d
 _XOR = 0x20
@@ -32,8 +35,17 @@ E_LEN = 1  # Received frame is too short to be a uframe
 E_FRM = 2  # Received data has no framing
 E_CRC = 3  # CRC mismatch
 
+# Frame buffer size of the device, MAX_FRAME_LENGTH in uframe.h
+MAX_FRAME_LENGTH = 128
 
-def crc16_ccitt(crc, data):
+# Messages larger than a frame, see "Messages" in uframe.h
+FRAGMENT_DATA = 48  # Message bytes per fragment
+FRAG_ACK = 1 << 0   # Fragment flag, the receiver is to acknowledge it
+MSG_ACK = 1         # uMessage.receive_fragment(), acknowledge with next
+MSG_COMPLETE = 2    # uMessage.receive_fragment(), the message is complete
+
+
+def _crc16_ccitt_bytewise(crc, data):
     """
      https://stackoverflow.com/a/30357446
     """
@@ -46,9 +58,68 @@ def crc16_ccitt(crc, data):
     return (msb << 8) + lsb
 
 
+# CRC of every byte value, same table as crc16.c with CONFIG_CRC16_TABLE=8
+_crc_table = [_crc16_ccitt_bytewise(i << 8, 0) for i in range(256)]
+
+
+def crc16_ccitt(crc, data):
+    """
+    Add one byte to the CRC-CCITT crc
+    """
+    return ((crc << 8) & 0xffff) ^ _crc_table[(crc >> 8) ^ data]
+
+
+def crc16_ccitt_bytes(data, crc=0):
+    """
+    Add a buffer to the CRC-CCITT crc, binascii has the same CRC in C
+    """
+    return binascii.crc_hqx(data, crc)
+
+
+def escape(data):
+    """
+    Escape the framing characters of data, DLE first as it is what the others
+    are escaped with
+    """
+    return bytes(data).replace(_DLE_BYTE, _DLE_ESCAPED).replace(_SOF_BYTE, _SOF_ESCAPED).replace(_EOF_BYTE, _EOF_ESCAPED)
+
+
+def unescape(data):
+    """
+    Undo escape(), a DLE at the end of data is dropped
+    """
+    data = bytes(data)
+    if _DLE_BYTE not in data:
+        return bytearray(data)
+    parts = data.split(_DLE_BYTE)
+    out = bytearray(parts[0])
+    for part in parts[1:]:
+        if part:  # Empty between repeated DLEs, the last one escapes
+            out.append(part[0] ^ _XOR)
+            out += part[1:]
+    return out
+
+
+_SOF_BYTE = bytes([_SOF])
+_DLE_BYTE = bytes([_DLE])
+_EOF_BYTE = bytes([_EOF])
+_SOF_ESCAPED = bytes([_DLE, _SOF ^ _XOR])
+_DLE_ESCAPED = bytes([_DLE, _DLE ^ _XOR])
+_EOF_ESCAPED = bytes([_DLE, _EOF ^ _XOR])
+
+_U16 = struct.Struct(">H")
+_U32 = struct.Struct(">I")
+_S32 = struct.Struct(">i")
+_U64 = struct.Struct(">Q")
+
+
 class uFrame(object):
     """
     Describes a class for simple serial protocols
+
+    The payload is packed unescaped, end() adds the CRC and escapes the whole
+    frame in one go. set_frame() does the reverse, leaving the payload for
+    unpacking.
     """
     _valid = False
     _crc = 0
@@ -57,50 +128,39 @@ class uFrame(object):
 
     def __init__(self):
         self._frame = bytearray()
-        self._frame.append(_SOF)
         self._crc = 0
 
-    def pack8(self, byte, update_crc=True):
+    def pack8(self, byte):
         """
-        Pack a byte into the frame, update CRC
+        Pack a byte into the frame
         """
-        byte &= 0xff
-        if update_crc:
-            self._crc = crc16_ccitt(self._crc, byte)
-        if byte in [_SOF, _DLE, _EOF]:
-            self._frame.append(_DLE)
-            self._frame.append(byte ^ _XOR)
-        else:
-            self._frame.append(byte)
+        self._frame.append(byte & 0xff)
+
+    def pack_bytes(self, data):
+        """
+        Pack a buffer into the frame
+        """
+        self._frame += data
 
     def pack_cstr(self, str):
-        for ch in str:
-            self.pack8(ord(ch))
-        self.pack8(0)
+        self._frame += bytes(ord(ch) & 0xff for ch in str)
+        self._frame.append(0)
 
     def pack16(self, halfword):
-        halfword &= 0xffff
-        h1 = (halfword >> 8) & 0xff
-        h2 = halfword & 0xff
-        self.pack8(h1)
-        self.pack8(h2)
+        self._frame += _U16.pack(halfword & 0xffff)
 
     def pack32(self, word):
-        word &= 0xffffffff
-        self.pack8((word >> 24) & 0xff)
-        self.pack8((word >> 16) & 0xff)
-        self.pack8((word >> 8) & 0xff)
-        self.pack8((word >> 0) & 0xff)
+        self._frame += _U32.pack(word & 0xffffffff)
+
+    def pack64(self, word):
+        self._frame += _U64.pack(word & 0xffffffffffffffff)
 
     def end(self):
         """
         End packing
         """
-        crc1 = (self._crc >> 8) & 0xff
-        crc2 = self._crc & 0xff
-        self.pack8(crc1, False)
-        self.pack8(crc2, False)
-        self._frame.append(_EOF)
+        self._crc = crc16_ccitt_bytes(self._frame)
+        self._frame = bytearray(_SOF_BYTE + escape(self._frame + _U16.pack(self._crc)) + _EOF_BYTE)
         self._valid = True
 
     def get_frame(self):
@@ -109,12 +169,22 @@ class uFrame(object):
         """
         return self._frame
 
+    def set_payload(self, payload):
+        """
+        Set frame to an unescaped payload without CRC, eg. a reassembled
+        message, ready for unpacking
+        """
+        self._frame = bytearray(payload)
+        self._unpack_pos = 0
+        self._valid = True
+
     def set_frame(self, escaped_frame):
         """
         Set frame to given (escaped) frame, unescape, check crc and extract payload
         Return -E_* if error or 0 if frame is valid.
         """
         self._frame = escaped_frame
+        self._unpack_pos = 0
         res = self._unescape()
         if res == 0:
             res = self._calc_crc()
@@ -136,33 +206,22 @@ class uFrame(object):
             return -E_LEN
         if self._frame[0] != _SOF or self._frame[length - 1] != _EOF:
             return -E_FRM
-        f = bytearray()
-        seen_dle = False
-        for b in self._frame:
-            if b == _DLE:
-                seen_dle = True
-            elif seen_dle:
-                f.append(b ^ _XOR)
-                seen_dle = False
-            else:
-                f.append(b)
-        self._frame = f[1:-1]
+        self._frame = unescape(self._frame[1:-1])
         return 0
 
     def _calc_crc(self):
         """
         Check crc of frame data and chop crc off payload if valid (internal function)
         """
-        self._crc = 0
-        for b in self._frame[:-2]:
-            self._crc = crc16_ccitt(self._crc, b)
-        self._crc &= 0xffff
+        if len(self._frame) < 2:
+            return -E_LEN
+        self._crc = crc16_ccitt_bytes(self._frame[:-2])
         crc = (self._frame[-2] << 8) | self._frame[-1]
         self._valid = crc == self._crc
         if not self._valid:
             return -E_CRC
         else:
-            self._frame = self._frame[:-2]  # Chop of crc
+            del self._frame[-2:]  # Chop of crc
             return 0
 
     def unpack8(self):
@@ -174,30 +233,132 @@ class uFrame(object):
         """
         Unpack signed 8 bit
         """
-        b = self._frame[self._unpack_pos]
-        self._unpack_pos += 1
-        if b == 0:
-            return 0
-        return b - 256
+        b = self.unpack8()
+        return b - 256 if b & 0x80 else b
 
     def unpack16(self):
-        h = self.unpack8() << 8 | self.unpack8()
+        h, = _U16.unpack_from(self._frame, self._unpack_pos)
+        self._unpack_pos += 2
         return h
 
     def unpack32(self):
-        h = self.unpack8() << 24 | self.unpack8() << 16 | self.unpack8() << 8 | self.unpack8()
-        return h
+        w, = _U32.unpack_from(self._frame, self._unpack_pos)
+        self._unpack_pos += 4
+        return w
+
+    def unpacks32(self):
+        """
+        Unpack signed 32 bit
+        """
+        w, = _S32.unpack_from(self._frame, self._unpack_pos)
+        self._unpack_pos += 4
+        return w
+
+    def unpack64(self):
+        w, = _U64.unpack_from(self._frame, self._unpack_pos)
+        self._unpack_pos += 8
+        return w
+
+    def unpack_struct(self, fmt):
+        """
+        Unpack several big endian fields described by a struct format, eg.
+        'HH' for two unsigned 16 bit values, and return them as a tuple
+        """
+        fields = struct.unpack_from(">" + fmt, self._frame, self._unpack_pos)
+        self._unpack_pos += struct.calcsize(">" + fmt)
+        return fields
 
     def unpack_cstr(self):
         string = ""
         if self._unpack_pos < len(self._frame):
-            b = self._frame[self._unpack_pos]
-            self._unpack_pos += 1
-            while self._unpack_pos < len(self._frame) and b != 0:
-                string += '{:c}'.format(b)
-                b = self._frame[self._unpack_pos]
-                self._unpack_pos += 1
+            end = self._frame.find(0, self._unpack_pos)
+            if end < 0:
+                # Unterminated, the last byte is not part of the string
+                string = self._frame[self._unpack_pos:-1].decode('latin-1')
+                self._unpack_pos = len(self._frame)
+            else:
+                string = self._frame[self._unpack_pos:end].decode('latin-1')
+                self._unpack_pos = end + 1
         return string
 
     def eof(self):
         return self._unpack_pos >= len(self._frame)
+
+
+class uMessage(object):
+    """
+    A message too large for one frame, split into fragments for sending or
+    put back together from received fragments, see umsg_t in uframe.h
+    """
+
+    def __init__(self, msg_id=0, payload=None, max_length=0xffff):
+        self.id = msg_id
+        self.payload = bytearray(payload) if payload is not None else bytearray()
+        self.length = len(self.payload)
+        self.next = 0
+        self.active = payload is not None
+        self._max_length = max_length
+
+    def fragments(self):
+        """
+        Number of fragments the message is sent in
+        """
+        return max(1, (self.length + FRAGMENT_DATA - 1) // FRAGMENT_DATA)
+
+    def pack_fragment(self, frame, index, flags=0):
+        """
+        Pack fragment index into a frame started with its command byte
+        """
+        offset = index * FRAGMENT_DATA
+        frame.pack8(self.id)
+        frame.pack8(index)
+        frame.pack8(flags)
+        frame.pack16(self.length)
+        frame.pack_bytes(self.payload[offset:offset + FRAGMENT_DATA])
+
+    def ack(self, msg_id, next_):
+        """
+        Apply an acknowledgement, next is then the fragment to send next.
+        Return False if it is not for this message
+        """
+        if not self.active or msg_id != self.id or next_ > self.fragments():
+            return False
+        self.next = next_
+        return True
+
+    def receive_fragment(self, frame):
+        """
+        Add a received fragment, unpacked up to the fragment header. Return
+        0, MSG_ACK if the sender waits for next, MSG_COMPLETE or -E_LEN
+        """
+        if len(frame.get_frame()) - frame._unpack_pos < 5:
+            return -E_LEN
+        msg_id = frame.unpack8()
+        index = frame.unpack8()
+        flags = frame.unpack8()
+        total = frame.unpack16()
+        receiving = self.active and msg_id == self.id and 0 < self.next < self.fragments()
+        if index == 0 and not receiving:
+            if total > self._max_length:
+                self.active = False
+                return -E_LEN
+            self.id = msg_id
+            self.length = total
+            self.payload = bytearray(total)
+            self.next = 0
+            self.active = True
+        if not self.active or msg_id != self.id:
+            return -E_LEN
+
+        if index == self.next and index < self.fragments():
+            offset = index * FRAGMENT_DATA
+            data = frame.get_frame()[frame._unpack_pos:]
+            if len(data) != min(FRAGMENT_DATA, self.length - offset) or total != self.length:
+                return -E_LEN
+            self.payload[offset:offset + len(data)] = data
+            frame._unpack_pos += len(data)
+            self.next += 1
+            if self.next >= self.fragments():
+                return MSG_COMPLETE
+        # Duplicates and fragments after a lost one only trigger an ack
+        return MSG_ACK if flags & FRAG_ACK else 0
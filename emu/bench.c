@@ -0,0 +1,360 @@
+/* 
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Benchmark mode of the emulator, dpsemu -b <script>. The script is replayed
+ * through the real protocol handler and UI code as fast as possible and the
+ * cost of each line is reported: host time per run, bytes sent back to the
+ * host, bytes that would have been sent to the TFT and flash words programmed
+ * and pages erased by past.
+ *
+ * One step per line, # starts a comment:
+ *
+ *   frame <byte> ...       Frame the payload and feed it to the protocol
+ *                          handler one character at a time. A byte is a hex
+ *                          number, "text" is packed as a nul terminated string
+ *   event <name> [data]    Pass an event to ui_handle_event(), name is one of
+ *                          m1 m2 sel enable left right left_set right_set press
+ *   tick                   Run the UI tick, redrawing the current screen
+ *   past_write <id> <len>  Write a <len> byte unit to past directly
+ *   past_read <id>         Read a unit from past directly
+ *
+ * Any step may be prefixed with a run count, "100 frame 01" pings 100 times.
+ * Times and bytes are reported per run, flash words and pages as totals over
+ * all runs as past only erases a page now and then.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "bench.h"
+#include "flash.h"
+#include "tft.h"
+#include "uframe.h"
+#include "serialhandler.h"
+
+#define MAX_STEPS       (128)
+#define MAX_LINE        (256)
+#define LABEL_LENGTH    (40)
+
+typedef enum {
+    step_frame,
+    step_event,
+    step_tick,
+    step_past_write,
+    step_past_read,
+} step_type_t;
+
+typedef struct {
+    step_type_t type;
+    uint32_t runs;
+    char label[LABEL_LENGTH];
+    frame_t frame;
+    event_t event;
+    uint8_t data;
+    past_id_t id;
+    uint32_t length;
+    /** Results */
+    uint64_t total_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t tx_bytes;
+    uint64_t tft_bytes;
+    uint64_t flash_programs;
+    uint64_t flash_erases;
+} step_t;
+
+static const struct {
+    const char *name;
+    event_t event;
+} event_names[] = {
+    { "m1", event_button_m1 },
+    { "m2", event_button_m2 },
+    { "sel", event_button_sel },
+    { "enable", event_button_enable },
+    { "left", event_rot_left },
+    { "right", event_rot_right },
+    { "left_set", event_rot_left_set },
+    { "right_set", event_rot_right_set },
+    { "press", event_rot_press },
+};
+
+static step_t steps[MAX_STEPS];
+static uint32_t num_steps;
+/** Bytes sent by the firmware during the current run */
+static uint32_t tx_bytes;
+
+void bench_count_tx(uint32_t length)
+{
+    tx_bytes += length;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief      Parse the payload of a frame step
+ *
+ * @param      step  The step
+ * @param      args  The rest of the line
+ *
+ * @return     true if the payload fits in a frame
+ */
+static bool parse_frame(step_t *step, char *args)
+{
+    uint32_t length = 0;
+    set_frame_header(&step->frame);
+    while (*args) {
+        while (*args == ' ' || *args == '\t') {
+            args++;
+        }
+        if (!*args) {
+            break;
+        }
+        if (*args == '"') {
+            char *end = strchr(++args, '"');
+            if (!end) {
+                return false;
+            }
+            *end = 0;
+            pack_cstr(&step->frame, args);
+            length += strlen(args) + 1;
+            args = end + 1;
+        } else {
+            char *end;
+            unsigned long b = strtoul(args, &end, 16);
+            if (end == args || b > 0xff) {
+                return false;
+            }
+            pack8(&step->frame, (uint8_t) b);
+            length++;
+            args = end;
+        }
+    }
+    end_frame(&step->frame);
+    /** A full frame_t has silently dropped bytes */
+    return length > 0 && step->frame.length < MAX_FRAME_LENGTH;
+}
+
+/**
+ * @brief      Parse one script line into a step
+ *
+ * @param      step  The step
+ * @param      line  The line, modified
+ *
+ * @return     true if the line is a valid step
+ */
+static bool parse_step(step_t *step, char *line)
+{
+    char *p = line;
+    char *end;
+    memset(step, 0, sizeof(*step));
+    step->runs = strtoul(p, &end, 10);
+    if (end == p) {
+        step->runs = 1;
+    }
+    p = end;
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    strncpy(step->label, p, LABEL_LENGTH - 1);
+    char *cmd = strsep(&p, " \t");
+    if (step->runs == 0) {
+        return false;
+    }
+    if (strcmp(cmd, "frame") == 0) {
+        step->type = step_frame;
+        return p && parse_frame(step, p);
+    } else if (strcmp(cmd, "event") == 0) {
+        char *name = strsep(&p, " \t");
+        step->type = step_event;
+        step->data = p ? strtoul(p, NULL, 0) : 0;
+        for (uint32_t i = 0; name && i < sizeof(event_names) / sizeof(event_names[0]); i++) {
+            if (strcmp(name, event_names[i].name) == 0) {
+                step->event = event_names[i].event;
+                return true;
+            }
+        }
+        return false;
+    } else if (strcmp(cmd, "tick") == 0) {
+        step->type = step_tick;
+        return true;
+    } else if (strcmp(cmd, "past_write") == 0) {
+        step->type = step_past_write;
+        return p && sscanf(p, "%u %u", &step->id, &step->length) == 2 && step->length <= MAX_LINE;
+    } else if (strcmp(cmd, "past_read") == 0) {
+        step->type = step_past_read;
+        return p && sscanf(p, "%u", &step->id) == 1;
+    }
+    return false;
+}
+
+/**
+ * @brief      Read the script
+ *
+ * @param[in]  file_name  The script file
+ *
+ * @return     true if every line parsed
+ */
+static bool load_script(const char *file_name)
+{
+    char line[MAX_LINE];
+    uint32_t line_no = 0;
+    FILE *f = fopen(file_name, "r");
+    if (!f) {
+        fprintf(stderr, "Error: could not open %s\n", file_name);
+        return false;
+    }
+    num_steps = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        line[strcspn(line, "#\r\n")] = 0;
+        for (uint32_t len = strlen(line); len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t'); len--) {
+            line[len - 1] = 0;
+        }
+        char *p = line;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (!*p) {
+            continue;
+        }
+        if (num_steps == MAX_STEPS || !parse_step(&steps[num_steps], p)) {
+            fprintf(stderr, "Error: %s:%u: bad step '%s'\n", file_name, line_no, p);
+            fclose(f);
+            return false;
+        }
+        num_steps++;
+    }
+    fclose(f);
+    return num_steps > 0;
+}
+
+/**
+ * @brief      Run a step once
+ *
+ * @param      step   The step
+ * @param      hooks  The firmware entry points
+ */
+static void run_step(step_t *step, bench_hooks_t *hooks)
+{
+    static uint8_t unit[MAX_LINE];
+    const void *data;
+    uint32_t length;
+    switch (step->type) {
+        case step_frame:
+            for (uint32_t i = 0; i < step->frame.length; i++) {
+                serial_handle_rx_char(step->frame.buffer[i]);
+            }
+            break;
+        case step_event:
+            hooks->handle_event(step->event, step->data);
+            break;
+        case step_tick:
+            hooks->tick();
+            break;
+        case step_past_write:
+            /** Vary the content so past cannot skip an unchanged unit */
+            unit[0]++;
+            (void) past_write_unit(hooks->past, step->id, unit, step->length);
+            break;
+        case step_past_read:
+            (void) past_read_unit(hooks->past, step->id, &data, &length);
+            break;
+    }
+}
+
+/**
+ * @brief      Print the results
+ *
+ * @param      f     Where to
+ */
+static void report(FILE *f)
+{
+    fprintf(f, "%-*s %8s %10s %10s %10s %8s %10s %8s %6s\n", LABEL_LENGTH, "step",
+            "runs", "mean ns", "min ns", "max ns", "tx B", "tft B", "words", "pages");
+    for (uint32_t i = 0; i < num_steps; i++) {
+        step_t *s = &steps[i];
+        fprintf(f, "%-*s %8u %10llu %10llu %10llu %8llu %10llu %8llu %6llu\n", LABEL_LENGTH, s->label, s->runs,
+                (unsigned long long) (s->total_ns / s->runs), (unsigned long long) s->min_ns,
+                (unsigned long long) s->max_ns, (unsigned long long) (s->tx_bytes / s->runs),
+                (unsigned long long) (s->tft_bytes / s->runs), (unsigned long long) s->flash_programs,
+                (unsigned long long) s->flash_erases);
+    }
+}
+
+bool bench_run(const char *file_name, bench_hooks_t *hooks)
+{
+    if (!load_script(file_name)) {
+        return false;
+    }
+
+    /** The firmware prints a lot from emu_printf, keep it out of the timing */
+    fflush(stdout);
+    int out = dup(STDOUT_FILENO);
+    if (out < 0 || !freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "Error: could not silence stdout\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < num_steps; i++) {
+        step_t *s = &steps[i];
+        s->min_ns = UINT64_MAX;
+        for (uint32_t run = 0; run < s->runs; run++) {
+            uint32_t programs, erases;
+            flash_emul_stats(&programs, &erases);
+            uint32_t tft = emul_tft_bytes();
+            tx_bytes = 0;
+            uint64_t start = now_ns();
+            run_step(s, hooks);
+            uint64_t ns = now_ns() - start;
+            uint32_t programs_after, erases_after;
+            flash_emul_stats(&programs_after, &erases_after);
+            s->total_ns += ns;
+            s->min_ns = ns < s->min_ns ? ns : s->min_ns;
+            s->max_ns = ns > s->max_ns ? ns : s->max_ns;
+            s->tx_bytes += tx_bytes;
+            s->tft_bytes += emul_tft_bytes() - tft;
+            s->flash_programs += programs_after - programs;
+            s->flash_erases += erases_after - erases;
+        }
+    }
+
+    fflush(stdout);
+    FILE *f = fdopen(out, "w");
+    if (!f) {
+        return false;
+    }
+    report(f);
+    fclose(f);
+    return true;
+}
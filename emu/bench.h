@@ -0,0 +1,61 @@
+/* 
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "past.h"
+#include "event.h"
+
+/**
+ * @brief      Firmware entry points driven by the benchmark
+ */
+typedef struct {
+    past_t *past;
+    /** ui_handle_event() of opendps.c */
+    void (*handle_event)(event_t event, uint8_t data);
+    /** ui_tick() of opendps.c, redraws the current screen */
+    void (*tick)(void);
+} bench_hooks_t;
+
+/**
+ * @brief      Replay a benchmark script at full speed and print a report
+ *
+ * @param[in]  file_name  The script
+ * @param      hooks      The firmware entry points
+ *
+ * @return     true if the script ran to completion
+ */
+bool bench_run(const char *file_name, bench_hooks_t *hooks);
+
+/**
+ * @brief      Account a frame sent by the firmware to the current step
+ *
+ * @param[in]  length  The length of the frame
+ */
+void bench_count_tx(uint32_t length);
+
+#endif // __BENCH_H__
@@ -1,3 +1,4 @@
 #include <stdint.h>
 uint32_t DAC_DHR12R1;
 uint32_t DAC_DHR12R2;
+uint32_t DAC_DHR12RD;
@@ -1,2 +1,3 @@
 extern uint32_t DAC_DHR12R1;
 extern uint32_t DAC_DHR12R2;
+extern uint32_t DAC_DHR12RD;
@@ -30,7 +30,10 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <semaphore.h>
+#include <signal.h>
 #include <sys/socket.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
 #include <arpa/inet.h>
 #include "dpsemul.h"
 #include "flash.h"
@@ -38,10 +41,20 @@
 #include "tft.h"
 #include "dbg_printf.h"
 #include "uframe.h"
+#include "hw.h"
+#include "powerstage.h"
+#include "tick.h"
+#include "vtime.h"
+#include "replay.h"
 
 #define UDP_RX_BUF_LEN       (512)
 #define DPS_PORT            (5005)
 #define EVENT_PORT          (5006)
+#define MAX_INSTANCES       (1000)
+
+/** Ports of this instance, instance n uses DPS_PORT + 2n and EVENT_PORT + 2n */
+static uint16_t dps_port = DPS_PORT;
+static uint16_t event_port = EVENT_PORT;
 
 /** Handles to the comms thread and event thread */
 pthread_t udp_th, event_th;
@@ -52,6 +65,17 @@ int comm_sock;
 /** Current connected client, one at a time please */
 struct sockaddr_in comm_client_sock;
 
+/** Benchmark script given with -b, no networking when set */
+static char *bench_name;
+
+/** Capture given with -r and -m for replaying it at maximum speed, no
+ *  networking when set */
+static char *replay_name;
+static bool replay_max_speed;
+
+/** Set with -q, no logging of the frames received and transmitted */
+static bool quiet;
+
 /**
  * @brief      Send a frame on the emulator 'USART' which is the UDP port.
  *             Called from protocol_handler.c
@@ -63,9 +87,21 @@ void dps_emul_send_frame(frame_t *frame)
 {
     int slen = sizeof(comm_client_sock);
 
-    printf("[Com] Transmitted %u bytes\n", frame->length);
-    for (uint32_t i = 0; i < frame->length; ++i)
-         printf(" 0x%02X\n", frame->buffer[i]);
+    if (bench_name) {
+        bench_count_tx(frame->length);
+        return;
+    }
+
+    if (replay_name) {
+        replay_count_tx(frame);
+        return;
+    }
+
+    if (!quiet) {
+        printf("[Com] Transmitted %u bytes\n", frame->length);
+        for (uint32_t i = 0; i < frame->length; ++i)
+             printf(" 0x%02X\n", frame->buffer[i]);
+    }
 
     if (sendto(comm_sock, frame->buffer, frame->length, 0, (struct sockaddr*) &comm_client_sock, slen) == -1) {
         printf("Error: sendto()\n");
@@ -79,7 +115,7 @@ void dps_emul_send_frame(frame_t *frame)
  */
 void* comm_thread(void *arg)
 {
-    printf("Comms thread listening on UDP port %d\n", DPS_PORT);
+    printf("Comms thread listening on UDP port %d\n", dps_port);
     struct sockaddr_in si_me;
     size_t recv_len;
     char buf[UDP_RX_BUF_LEN];
@@ -92,22 +128,26 @@ void* comm_thread(void *arg)
     
     memset((char *) &si_me, 0, sizeof(si_me));
     si_me.sin_family = AF_INET;
-    si_me.sin_port = htons(DPS_PORT);
+    si_me.sin_port = htons(dps_port);
     si_me.sin_addr.s_addr = htonl(INADDR_ANY);
     
     if(bind(comm_sock, (struct sockaddr*)&si_me, sizeof(si_me) ) == -1) {
-        printf("Error: could not bind to port %d\n", DPS_PORT);
+        printf("Error: could not bind to port %d\n", dps_port);
     }
     
     while(1) {
         if ((recv_len = recvfrom(comm_sock, buf, UDP_RX_BUF_LEN, 0, (struct sockaddr *) &comm_client_sock, &slen)) == -1) {
             printf("Error: recvfrom()\n");
+            continue;
         }
-        printf("[Com] Received %lu bytes\n", recv_len);
-        for (int i = 0; i < recv_len; i++) {
-            if (!event_put(event_uart_rx, buf[i])) {
-                dbg_printf("Error: event queue overflowed\n");
-            }
+        if (!quiet) {
+            printf("[Com] Received %lu bytes\n", recv_len);
+        }
+        /** Hand over the whole datagram with a single event, like the USART
+            idle line interrupt does. Wait for the main loop to make room
+            rather than dropping bytes. */
+        while (!hw_emul_usart_rx((uint8_t*) buf, recv_len)) {
+            usleep(100);
         }
     }
     
@@ -122,7 +162,7 @@ void* comm_thread(void *arg)
  */
 void* event_thread(void *arg)
 {
-    printf("Event thread listening on UDP port %d\n", EVENT_PORT);
+    printf("Event thread listening on UDP port %d\n", event_port);
     struct sockaddr_in si_me;
     size_t recv_len;
     char buf[UDP_RX_BUF_LEN];
@@ -137,17 +177,20 @@ void* event_thread(void *arg)
     
     memset((char *) &si_me, 0, sizeof(si_me));
     si_me.sin_family = AF_INET;
-    si_me.sin_port = htons(EVENT_PORT);
+    si_me.sin_port = htons(event_port);
     si_me.sin_addr.s_addr = htonl(INADDR_ANY);
     
     if(bind(sock, (struct sockaddr*)&si_me, sizeof(si_me) ) == -1) {
-        printf("Error: could not bind to port %d\n", DPS_PORT);
+        printf("Error: could not bind to port %d\n", event_port);
     }
     
     while(1) {
-        if ((recv_len = recvfrom(sock, buf, UDP_RX_BUF_LEN, 0, (struct sockaddr *) &client_sock, &slen)) == -1) {
+        if ((recv_len = recvfrom(sock, buf, UDP_RX_BUF_LEN - 1, 0, (struct sockaddr *) &client_sock, &slen)) == -1) {
             printf("Error: recvfrom()\n");
+            continue;
         }
+        /** A shorter command must not pick up the tail of the one before */
+        buf[recv_len] = 0;
         if (buf[recv_len-1] == '\n') {
             buf[recv_len-1] = 0;
             recv_len--;
@@ -157,6 +200,22 @@ void* event_thread(void *arg)
             printf("Drawing UI\n");
             emul_tft_draw();
             printf("---\n");
+        } else if (strcmp("fb raw", buf) == 0) {
+            /** Reply with the display contents */
+            static uint8_t fb_dump[2 * 128 * 128];
+            uint32_t length = emul_tft_raw(fb_dump, sizeof(fb_dump));
+            if (sendto(sock, fb_dump, length, 0, (struct sockaddr*) &client_sock, slen) == -1) {
+                printf("Error: sendto()\n");
+            }
+        } else if (vtime_command(buf)) {
+            /** Reply with the time, telling a runner that "run" is done */
+            char reply[24];
+            int length = snprintf(reply, sizeof(reply), "%llu\n", (unsigned long long) get_time_us());
+            if (sendto(sock, reply, length, 0, (struct sockaddr*) &client_sock, slen) == -1) {
+                printf("Error: sendto()\n");
+            }
+        } else if (!powerstage_command(buf) && !emul_tft_command(buf)) {
+            printf("Unknown command\n");
         }
     }
     
@@ -164,6 +223,53 @@ void* event_thread(void *arg)
     return NULL;
 }
 
+/**
+ * @brief      Fork the instances of an emulator farm. The firmware state is
+ *             all globals so each device is a copy on write fork of this
+ *             process sharing the code and the already initialized memory.
+ *             Instance n listens on DPS_PORT + 2n and EVENT_PORT + 2n and
+ *             uses <past file>.n if a past file was given.
+ *
+ * @param[in]  count      Number of instances
+ * @param      file_name  The past file name, updated for the forked instance
+ *
+ * @return     The instance number of the calling process
+ */
+static uint32_t fork_instances(uint32_t count, char **file_name)
+{
+    uint32_t instance;
+    for (instance = 1; instance < count; instance++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            fprintf(stderr, "Error: fork failed for instance %u\n", instance);
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0) {
+            /** Take down the farm with the first instance */
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            break;
+        }
+    }
+    if (instance == count) {
+        instance = 0;
+        /** Reap instances that exited so they do not linger as zombies */
+        signal(SIGCHLD, SIG_IGN);
+        printf("Started %u instances on UDP ports %d..%d\n", count, DPS_PORT, DPS_PORT + 2 * (count - 1));
+    }
+    dps_port = DPS_PORT + 2 * instance;
+    event_port = EVENT_PORT + 2 * instance;
+    if (instance && *file_name) {
+        size_t len = strlen(*file_name) + 6;
+        char *name = malloc(len);
+        if (!name) {
+            exit(EXIT_FAILURE);
+        }
+        snprintf(name, len, "%s.%u", *file_name, instance);
+        *file_name = name;
+    }
+    return instance;
+}
+
 /**
  * @brief      Emulator init
  *
@@ -174,12 +280,11 @@ void dps_emul_init(past_t *past, int argc, char const *argv[])
 {
 	printf("OpenDPS Emulator\n");
 
-    pthread_create(&udp_th, NULL, comm_thread, "UDP comms thread");
-    pthread_create(&event_th, NULL, event_thread, "UDP event thread");
-
     size_t optind;
     char *file_name = 0;
     bool write_past = false;
+    uint32_t instances = 1;
+    uint32_t power_fail_ops = 0;
     for (optind = 1; optind < argc; optind++) {
         switch (argv[optind][1]) {
 	        case 'p':
@@ -189,11 +294,79 @@ void dps_emul_init(past_t *past, int argc, char const *argv[])
 	        case 'w':
 			    write_past = true;
 	        	break;
+	        case 'b':
+	        	bench_name = (char*) argv[optind+1];
+	        	optind++;
+	        	break;
+	        case 'q':
+	        	quiet = true;
+	        	break;
+	        case 'r':
+	        	if (optind + 1 >= argc) {
+	        	    fprintf(stderr, "Error: -r needs a capture file\n");
+	        	    exit(EXIT_FAILURE);
+	        	}
+	        	replay_name = (char*) argv[optind+1];
+	        	optind++;
+	        	break;
+	        case 'm':
+	        	replay_max_speed = true;
+	        	break;
+	        case 'n':
+	        	instances = optind + 1 < argc ? atoi(argv[optind+1]) : 0;
+	        	if (instances < 1 || instances > MAX_INSTANCES) {
+	        	    fprintf(stderr, "Error: instance count must be 1..%d\n", MAX_INSTANCES);
+	        	    exit(EXIT_FAILURE);
+	        	}
+	        	optind++;
+	        	break;
+	        case 'f':
+	        	if (optind + 1 >= argc || atoi(argv[optind+1]) < 1) {
+	        	    fprintf(stderr, "Error: -f needs the number of flash operations to fail power in\n");
+	        	    exit(EXIT_FAILURE);
+	        	}
+	        	power_fail_ops = atoi(argv[optind+1]);
+	        	optind++;
+	        	break;
+	        case 't':
+	        	if (optind + 1 >= argc) {
+	        	    fprintf(stderr, "Error: -t needs a speed, 0 to advance with run <ms>\n");
+	        	    exit(EXIT_FAILURE);
+	        	}
+	        	vtime_enable(atoi(argv[optind+1]));
+	        	optind++;
+	        	break;
 	        default:
-	            fprintf(stderr, "Usage: %s [-p past.bin] [-w]\n", argv[0]);
+	            fprintf(stderr, "Usage: %s [-p past.bin] [-w] [-q] [-n instances] [-t speed] [-f flash ops] [-b script] [-r capture [-m]]\n", argv[0]);
 	            exit(EXIT_FAILURE);
         }   
     }   
 
+    if (!bench_name && !replay_name && instances > 1) {
+        (void) fork_instances(instances, &file_name);
+    }
+
+    if (!bench_name && !replay_name) {
+        pthread_create(&udp_th, NULL, comm_thread, "UDP comms thread");
+        pthread_create(&event_th, NULL, event_thread, "UDP event thread");
+    }
+    if (!bench_name) {
+        hw_emul_start_adc();
+    }
+
 	flash_emul_init(past, file_name, write_past);
+    if (power_fail_ops) {
+        flash_emul_power_fail(power_fail_ops, NULL);
+    }
+}
+
+void dps_emul_bench(bench_hooks_t *hooks)
+{
+    if (bench_name) {
+        exit(bench_run(bench_name, hooks) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    /** Only now the firmware is ready to answer */
+    if (replay_name && !replay_start(replay_name, replay_max_speed)) {
+        exit(EXIT_FAILURE);
+    }
 }
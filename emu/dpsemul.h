@@ -25,7 +25,17 @@
 #ifndef __DPSEMUL_H__
 #define __DPSEMUL_H__
 #include "past.h"
+#include "bench.h"
 
 void dps_emul_init(past_t *past, int argc, char const *argv[]);
 
+/**
+ * @brief      Run the benchmark script given with -b and exit, or start
+ *             replaying the capture given with -r. Called once the firmware
+ *             is initialized.
+ *
+ * @param      hooks  The firmware entry points
+ */
+void dps_emul_bench(bench_hooks_t *hooks);
+
 #endif // __DPSEMUL_H__
@@ -3,26 +3,83 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "flash.h"
 #include "past.h"
 
-#define FLASH_SIZE  (2048)
+#define FLASH_SIZE  (PAST_NUM_BLOCKS * PAST_BLOCK_SIZE)
 
-static uint8_t flash[FLASH_SIZE];
+/** The flash image, the past file mapped shared when writes persist so a
+    program or erase is a few stores and the kernel writes the file back */
+static uint8_t *flash;
+static uint8_t ram_flash[FLASH_SIZE];
 static char *past_name;
 bool persistent;
+/** Counted for the benchmark mode */
+static uint32_t num_programs, num_erases;
+/** Program and erase operations left until the injected power fail, 0 for none */
+static uint32_t power_fail_ops;
+static void (*power_fail_cb)(void);
+
+void flash_emul_sync(void)
+{
+    if (flash != ram_flash && msync(flash, FLASH_SIZE, MS_SYNC) != 0) {
+        fprintf(stderr, "Error: failed to sync %s\n", past_name);
+    }
+}
+
+/**
+ * @brief      Map the past file, creating or growing it to FLASH_SIZE
+ *
+ * @return     true if flash is the mapping
+ */
+static bool map_past(void)
+{
+    int fd = open(past_name, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        return false;
+    }
+    if (st.st_size < FLASH_SIZE) {
+        /** Pages not in the file yet read as erased */
+        memset(&ram_flash[st.st_size], 0xff, FLASH_SIZE - st.st_size);
+        if (pwrite(fd, &ram_flash[st.st_size], FLASH_SIZE - st.st_size, st.st_size) != FLASH_SIZE - st.st_size) {
+            close(fd);
+            return false;
+        }
+    }
+    void *map = mmap(NULL, FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    flash = map;
+    atexit(flash_emul_sync);
+    return true;
+}
 
 void flash_emul_init(past_t *past, char *_past_name, bool _persistent)
 {
     past_name = _past_name;
     persistent = _persistent;
-    past->blocks[0] = 0;
-    past->blocks[1] = 1024;
+    for (uint32_t i = 0; i < PAST_NUM_BLOCKS; i++) {
+        past->blocks[i] = i * PAST_BLOCK_SIZE;
+    }
+    flash = ram_flash;
     memset(flash, 0xff, FLASH_SIZE);
-    if (past_name) {
+    if (past_name && persistent) {
+        printf("Mapping past from %s (with persistence)\n", past_name);
+        if (!map_past()) {
+            fprintf(stderr, "Error: failed to map %s\n", past_name);
+            exit(EXIT_FAILURE);
+        }
+    } else if (past_name) {
         FILE *f = fopen(past_name, "rb");
         if (f) {
-            printf("Reading past from %s (with%s persistence)\n", past_name, _persistent ? "" : "out");
+            printf("Reading past from %s (without persistence)\n", past_name);
             fread((void*) flash, FLASH_SIZE, 1, f);
             fclose(f);
         } else {
@@ -31,18 +88,40 @@ void flash_emul_init(past_t *past, char *_past_name, bool _persistent)
     }
 }
 
-static void save_past(void)
+/**
+ * @brief      Default power fail, the image is left as torn and the emulator
+ *             dies like the device would
+ */
+static void power_fail_exit(void)
 {
-    if (persistent && past_name) {
-        printf("Saving past to %s\n", past_name);
-        FILE *f = fopen(past_name, "wb+");
-        if (!f) {
-            fprintf(stderr, "Error: failed to save %s\n", past_name);
-            exit(EXIT_FAILURE);
-        }
-        fwrite((void*) flash, 1, FLASH_SIZE, f);
-        fclose(f);
-    }
+    fflush(stdout);
+    flash_emul_sync();
+    _exit(EXIT_FAILURE);
+}
+
+void flash_emul_power_fail(uint32_t ops, void (*cb)(void))
+{
+    power_fail_ops = ops;
+    power_fail_cb = cb ? cb : power_fail_exit;
+}
+
+/**
+ * @brief      Count a program or erase operation towards the injected power fail
+ *
+ * @return     true if power fails during this operation, which is then to be torn
+ */
+static bool power_fails(void)
+{
+    return power_fail_ops && --power_fail_ops == 0;
+}
+
+/**
+ * @brief      Report a torn operation and call the power fail callback
+ */
+static void power_fail(void)
+{
+    printf("Power fail injected after %u programs and %u erases\n", num_programs, num_erases);
+    power_fail_cb();
 }
 
 void lock_flash(void) {}
@@ -54,8 +133,14 @@ void flash_erase_page(uint32_t address)
         printf("Flash out of bound erase access at 0x%08x\n", address);
         exit(EXIT_FAILURE);
     }
-    memset(&flash[address], 0xff, 1024);
-    save_past();
+    num_erases++;
+    if (power_fails()) {
+        /** Half way through the page */
+        memset(&flash[address], 0xff, PAST_BLOCK_SIZE / 2);
+        power_fail();
+        return;
+    }
+    memset(&flash[address], 0xff, PAST_BLOCK_SIZE);
 }
 
 void flash_program_word(uint32_t address, uint32_t data)
@@ -64,9 +149,56 @@ void flash_program_word(uint32_t address, uint32_t data)
         printf("Flash out of bound write access at 0x%08x\n", address);
         exit(EXIT_FAILURE);
     }
+    num_programs++;
+    if (power_fails()) {
+        /** The hardware programs half words, the second one is lost */
+        *(uint16_t*) &flash[address] = (uint16_t) data;
+        power_fail();
+        return;
+    }
     uint32_t *temp = (uint32_t*) &flash[address];
     *temp = data;
-    save_past();
+}
+
+void flash_program_half_word(uint32_t address, uint16_t data)
+{
+    if (address > FLASH_SIZE) {
+        printf("Flash out of bound write access at 0x%08x\n", address);
+        exit(EXIT_FAILURE);
+    }
+    num_programs++;
+    if (power_fails()) {
+        power_fail();
+        return;
+    }
+    uint16_t *temp = (uint16_t*) &flash[address];
+    *temp = data;
+}
+
+bool flash_program_block(uint32_t address, const void *data, uint32_t length)
+{
+    if (address + length > FLASH_SIZE) {
+        printf("Flash out of bound write access at 0x%08x\n", address);
+        exit(EXIT_FAILURE);
+    }
+    num_programs += length / 4;
+    if (power_fails()) {
+        /** Half way through the block, on a half word */
+        memmove(&flash[address], data, (length / 2) & ~1);
+        power_fail();
+        return false;
+    }
+    memmove(&flash[address], data, length);
+    return true;
+}
+
+const void *flash_emul_data(uint32_t address)
+{
+    if (address > FLASH_SIZE) {
+        printf("Flash out of bound read access at 0x%08x\n", address);
+        exit(EXIT_FAILURE);
+    }
+    return &flash[address];
 }
 
 uint32_t flash_read_word(uint32_t address)
@@ -79,6 +211,12 @@ uint32_t flash_read_word(uint32_t address)
     return *temp;
 }
 
+void flash_emul_stats(uint32_t *programs, uint32_t *erases)
+{
+    *programs = num_programs;
+    *erases = num_erases;
+}
+
 uint32_t flash_get_status_flags(void)
 {
     return FLASH_SR_EOP;
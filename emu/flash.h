@@ -9,12 +9,17 @@
 uint32_t _flash_read32(uint32_t address);
 void flash_erase_page(uint32_t address);
 void flash_program_word(uint32_t address, uint32_t data);
+void flash_program_half_word(uint32_t address, uint16_t data);
 uint32_t flash_get_status_flags(void);
 void hexdump(char *desc, void *addr, int len);
 
 #ifdef DPS_EMULATOR
 void flash_emul_init(past_t *past, char *file_name, bool save_past);
 uint32_t flash_read_word(uint32_t address);
+const void *flash_emul_data(uint32_t address);
+void flash_emul_stats(uint32_t *programs, uint32_t *erases);
+void flash_emul_sync(void);
+void flash_emul_power_fail(uint32_t ops, void (*cb)(void));
 #endif // DPS_EMULATOR
 
 #endif // __FLASH_H__
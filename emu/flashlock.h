@@ -1,7 +1,11 @@
 #ifndef __FLASHLOCK_H__
 #define __FLASHLOCK_H__
 
+#include <stdint.h>
+#include <stdbool.h>
+
 void lock_flash(void);
 void unlock_flash(void);
+bool flash_program_block(uint32_t address, const void *data, uint32_t length);
 
 #endif // __FLASHLOCK_H__
@@ -25,6 +25,142 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <unistd.h>
+#include "hw.h"
+#include "isrhook.h"
+#include "pwrctl.h"
+#include "event.h"
+#include "powerstage.h"
+#include "ringbuf.h"
+#include "tft.h"
+#include "tick.h"
+#include "vtime.h"
+
+/** Skip the first samples like the firmware does while the ADC settles */
+#define STARTUP_SKIP_COUNT   (40)
+
+/** Latest samples of the simulated ADC */
+static volatile uint16_t i_out_adc;
+static volatile uint16_t v_in_adc;
+static volatile uint16_t v_out_adc;
+static volatile uint16_t i_out_trig_adc;
+static volatile uint16_t v_out_trig_adc;
+static volatile uint32_t adc_counter;
+
+/** Receive ring filled by the comms thread, drained by the main loop */
+#define EMUL_RX_RING_SIZE  (4096)
+static uint8_t rx_buffer[EMUL_RX_RING_SIZE];
+static ringbuf_t rx_ring;
+
+/** DAC settings feeding the power stage model */
+static volatile uint16_t v_dac_value;
+static volatile uint16_t i_dac_value;
+
+/** Accumulated statistics of hw_adc_stats_start() */
+static adc_stats_t adc_stats;
+static volatile uint16_t adc_stats_left;
+
+/**
+  * @brief Get the emulator time in microseconds, truncated to 32 bits
+  * @retval current time
+  */
+uint32_t cur_time_us(void)
+{
+    return (uint32_t) get_time_us();
+}
+
+/**
+  * @brief The emulator has no cycle counter, the hooks never overrun
+  * @retval 0
+  */
+uint32_t isrhook_clock(void)
+{
+    return 0;
+}
+
+/**
+  * @brief Add some filtering to OCPs
+  * @retval None
+  */
+static void handle_ocp(uint16_t raw, const pwrctl_params_t *ctrl)
+{
+    static uint32_t ocp_count = 0;
+    static uint32_t last_tick_counter = 0;
+    if (last_tick_counter+1 == adc_counter) {
+        ocp_count++;
+        last_tick_counter++;
+        if (ocp_count == ctrl->ocp_samples) {
+            i_out_trig_adc = raw;
+            pwrctl_enable_vout(false);
+            event_put(event_ocp, 0);
+        }
+    } else {
+        ocp_count = 0;
+        last_tick_counter = adc_counter;
+    }
+}
+
+/**
+  * @brief Add some filtering to OVPs
+  * @retval None
+  */
+static void handle_ovp(uint16_t raw, const pwrctl_params_t *ctrl)
+{
+    static uint32_t ovp_count = 0;
+    static uint32_t last_tick_counter = 0;
+    if (last_tick_counter+1 == adc_counter) {
+        ovp_count++;
+        last_tick_counter++;
+        if (ovp_count == ctrl->ovp_samples) {
+            v_out_trig_adc = raw;
+            pwrctl_enable_vout(false);
+            event_put(event_ovp, 0);
+        }
+    } else {
+        ovp_count = 0;
+        last_tick_counter = adc_counter;
+    }
+}
+
+/**
+  * @brief The simulated ADC ISR, called from the power stage model thread at
+  *        the sample rate of the real hardware
+  * @retval None
+  */
+static void adc1_2_isr(void)
+{
+    uint16_t i, v_in, v_out;
+    powerstage_sample(v_dac_value, i_dac_value, pwrctl_vout_enabled(), &i, &v_in, &v_out);
+    adc_counter++;
+
+    const pwrctl_params_t *ctrl = pwrctl_params();
+    if (ctrl->i_limit_raw && adc_counter >= STARTUP_SKIP_COUNT) {
+        if (i > ctrl->i_limit_raw && pwrctl_vout_enabled()) { /** OCP! */
+            handle_ocp(i, ctrl);
+        }
+    }
+    i_out_adc = i;
+    v_in_adc = v_in;
+    v_out_adc = v_out;
+
+    if (adc_stats_left) {
+        adc_stats.sum[0] += i;
+        adc_stats.sum[1] += v_in;
+        adc_stats.sum[2] += v_out;
+        adc_stats.sum_sq[0] += (uint32_t) i * i;
+        adc_stats.sum_sq[1] += (uint32_t) v_in * v_in;
+        adc_stats.sum_sq[2] += (uint32_t) v_out * v_out;
+        adc_stats_left--;
+    }
+
+    if (ctrl->v_limit_raw) {
+        if (v_out > ctrl->v_limit_raw && pwrctl_vout_enabled()) { /** OVP! */
+            handle_ovp(v_out, ctrl);
+        }
+    }
+
+    isrhook_run(i, v_in, v_out);
+}
 
 /**
   * @brief Initialize the hardware
@@ -32,6 +168,100 @@
   */
 void hw_init(void)
 {
+    ringbuf_init8(&rx_ring, rx_buffer, sizeof(rx_buffer));
+}
+
+/**
+  * @brief The emulated ADC is started by hw_emul_start_adc()
+  * @retval None
+  */
+void hw_adc_start(void)
+{
+}
+
+#ifdef CONFIG_ADC_PROFILES
+static adc_profile_t adc_profile = adc_profile_default;
+
+/**
+  * @brief Select an acquisition profile, the power stage model keeps its
+  *        rate whatever the profile
+  * @param profile the profile
+  * @retval false if there is no such profile
+  */
+bool hw_adc_set_profile(adc_profile_t profile)
+{
+    if (profile >= adc_profile_count) {
+        return false;
+    }
+    adc_profile = profile;
+    return true;
+}
+
+/**
+  * @brief Get the acquisition profile
+  * @param rate_hz receives the rate of the power stage model, may be NULL
+  * @param decimation receives 1, the emulator does not oversample, may be NULL
+  * @retval the profile
+  */
+adc_profile_t hw_adc_get_profile(uint32_t *rate_hz, uint32_t *decimation)
+{
+    if (rate_hz) {
+        *rate_hz = POWERSTAGE_SAMPLE_RATE;
+    }
+    if (decimation) {
+        *decimation = 1;
+    }
+    return adc_profile;
+}
+#endif // CONFIG_ADC_PROFILES
+
+/**
+  * @brief Receive data on the emulated USART
+  * @param data received data
+  * @param length number of bytes
+  * @retval false if there was no room for all of the data, nothing was queued
+  */
+bool hw_emul_usart_rx(const uint8_t *data, uint32_t length)
+{
+    if (ringbuf_free(&rx_ring) < length) {
+        return false;
+    }
+    (void) ringbuf_put_n(&rx_ring, data, length);
+    event_put(event_uart_rx_block, 0);
+    return true;
+}
+
+/**
+  * @brief The emulated USART has no line errors and the comms thread waits
+  *        for room in the RX ring instead of dropping data
+  * @param errors filled in with zeros
+  * @param reset unused
+  * @retval None
+  */
+void hw_usart_get_errors(hw_usart_errors_t *errors, bool reset)
+{
+    (void) reset;
+    *errors = (hw_usart_errors_t) { 0 };
+}
+
+/**
+  * @brief Copy received data out of the RX ring
+  * @param data buffer to copy to
+  * @param size size of buffer
+  * @retval number of bytes copied, 0 when all received data has been read
+  */
+uint32_t hw_usart_rx_read(uint8_t *data, uint32_t size)
+{
+    return ringbuf_get_n(&rx_ring, data, size);
+}
+
+/**
+  * @brief Start the simulated ADC
+  * @retval None
+  */
+void hw_emul_start_adc(void)
+{
+    powerstage_start(&adc1_2_isr);
 }
 
 /**
@@ -43,26 +273,64 @@ void hw_init(void)
   */
 void hw_get_adc_values(uint16_t *i_out_raw, uint16_t *v_in_raw, uint16_t *v_out_raw)
 {
-    *i_out_raw = 0;
-    *v_in_raw = 0;
-    *v_out_raw = 0;
+    *i_out_raw = i_out_adc;
+    *v_in_raw = v_in_adc;
+    *v_out_raw = v_out_adc;
+}
+
+/**
+  * @brief Start accumulating ADC samples
+  * @param count number of sample sets, 0 stops
+  * @retval none
+  */
+void hw_adc_stats_start(uint16_t count)
+{
+    adc_stats_left = 0;
+    memset(&adc_stats, 0, sizeof(adc_stats));
+    adc_stats.count = count;
+    adc_stats_left = count;
+}
+
+/**
+  * @brief Get the accumulated ADC samples
+  * @param stats receives the statistics
+  * @retval true if the started count of samples has been accumulated
+  */
+bool hw_adc_stats_get(adc_stats_t *stats)
+{
+    if (!adc_stats.count || adc_stats_left) {
+        return false;
+    }
+    *stats = adc_stats;
+    return true;
 }
 
 /**
   * @brief Initialize TIM4 that drives the backlight of the TFT
+  * @param brightness initial brightness in percent
   * @retval None
   */
-void hw_enable_backlight(void)
+void hw_enable_backlight(uint8_t brightness)
 {
+    (void) brightness;
 }
 
 /**
   * @brief Get the ADC valut that triggered the OCP
-  * @retval Trivver value in mA
+  * @retval Trigger value in mA
   */
 uint16_t hw_get_itrig_ma(void)
 {
-    return 0;
+    return i_out_trig_adc;
+}
+
+/**
+  * @brief Get the ADC value that triggered the OVP
+  * @retval Trigger value in mV
+  */
+uint16_t hw_get_vtrig_mv(void)
+{
+    return v_out_trig_adc;
 }
 
 /**
@@ -82,6 +350,22 @@ bool hw_sel_button_pressed(void)
     return false;
 }
 
+/**
+  * @brief Sleep until the next interrupt, approximated with a 1ms sleep or
+  *        1ms of virtual time
+  * @retval None
+  */
+void hw_wait_for_interrupt(void)
+{
+    /** Drawing is done until the next event */
+    emul_tft_end_frame();
+    if (vtime_enabled()) {
+        vtime_idle();
+    } else {
+        usleep(1000);
+    }
+}
+
 /**
   * @brief Set TFT backlight value
   * @retval None
@@ -107,7 +391,7 @@ uint8_t hw_get_backlight(void)
   */
 void hw_set_voltage_dac(uint16_t v_dac)
 {
-    (void) v_dac;
+    v_dac_value = v_dac;
 }
 
 /**
@@ -117,5 +401,17 @@ void hw_set_voltage_dac(uint16_t v_dac)
   */
 void hw_set_current_dac(uint16_t i_dac)
 {
-    (void) i_dac;
+    i_dac_value = i_dac;
+}
+
+/**
+  * @brief Set both DAC values
+  * @param v_dac the output voltage DAC value
+  * @param i_dac the output current DAC value
+  * @retval none
+  */
+void hw_set_dacs(uint16_t v_dac, uint16_t i_dac)
+{
+    v_dac_value = v_dac;
+    i_dac_value = i_dac;
 }
\ No newline at end of file
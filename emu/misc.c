@@ -10,11 +10,6 @@ void scb_reset_system(void)
 	printf("scb_reset_system!\n");
 }
 
-uint32_t get_ticks(void)
-{
-	return 0;
-}
-
 void delay_ms(uint32_t t)
 {
 	(void) t;
@@ -0,0 +1,210 @@
+/* 
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * A simple model of the DPS power stage for the emulator. The buck converter
+ * is an ideal voltage source with a small output resistance, regulating to
+ * the voltage DAC setting (limited by V_in) while the current limit DAC caps
+ * its output current like the hardware CC loop does. It charges the output
+ * capacitor which is discharged by a resistive load. Each sample period is
+ * solved exactly so the model is stable for any capacitance.
+ *
+ * The model is changed at runtime with text commands on the event port:
+ *
+ *   load <ohm>    Load resistance, "load open" disconnects it
+ *   cap <uF>      Output capacitance
+ *   vin <V>       Input voltage
+ *   noise <lsb>   Peak uniform noise added to each ADC sample
+ *   sim           Print the model state
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "powerstage.h"
+#include "vtime.h"
+#include "pwrctl.h"
+
+/** Output resistance of the regulator */
+#define SOURCE_OHM  (0.05)
+
+static pthread_mutex_t model_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t adc_th;
+static void (*adc_isr)(void);
+
+/** Model parameters, 0 load_ohm is an open output */
+static double load_ohm = 10.0;
+static double cap_f = 220e-6;
+static double v_in = 24.0;
+static uint32_t noise_lsb;
+
+/** Model state */
+static double v_out;
+static double i_out;
+
+/**
+ * @brief      Convert a value to a raw ADC sample, V_mV = K * raw + C
+ */
+static uint16_t to_raw(double value, float k, float c, bool add_noise)
+{
+    double raw = (value - c) / k;
+    if (add_noise && noise_lsb) {
+        raw += (double) (rand() % (2 * noise_lsb + 1)) - noise_lsb;
+    }
+    if (raw < 0) {
+        return 0;
+    }
+    return raw > 4095 ? 4095 : (uint16_t) (raw + 0.5);
+}
+
+void powerstage_sample(uint16_t v_dac, uint16_t i_dac, bool enabled, uint16_t *i_out_raw, uint16_t *v_in_raw, uint16_t *v_out_raw)
+{
+    const double dt = 1.0 / POWERSTAGE_SAMPLE_RATE;
+    pthread_mutex_lock(&model_mutex);
+    /** DAC = K * mV + C */
+    double v_set = (v_dac - v_dac_c_coef) / v_dac_k_coef / 1000;
+    double i_limit = (i_dac - a_dac_c_coef) / a_dac_k_coef / 1000;
+    double target = v_set < v_in ? v_set : v_in;
+    double r_load = load_ohm > 0 ? load_ohm : INFINITY;
+    if (target < 0) {
+        target = 0;
+    }
+    if (i_limit < 0) {
+        i_limit = 0;
+    }
+
+    if (!enabled) {
+        /** Only the load discharges the capacitor */
+        v_out = isinf(r_load) ? v_out : v_out * exp(-dt / (r_load * cap_f));
+    } else {
+        /** Voltage regulation, the source and load resistance in parallel
+            charge the capacitor towards the divided target */
+        double r_par = isinf(r_load) ? SOURCE_OHM : SOURCE_OHM * r_load / (SOURCE_OHM + r_load);
+        double v_eq = isinf(r_load) ? target : target * r_load / (SOURCE_OHM + r_load);
+        double v_next = v_eq + (v_out - v_eq) * exp(-dt / (r_par * cap_f));
+        if ((target - v_next) / SOURCE_OHM > i_limit) {
+            /** Current limited, a constant current into the capacitor and load */
+            if (isinf(r_load)) {
+                v_next = v_out + i_limit * dt / cap_f;
+                v_next = v_next > target ? target : v_next;
+            } else {
+                double v_cc = i_limit * r_load;
+                v_next = v_cc + (v_out - v_cc) * exp(-dt / (r_load * cap_f));
+            }
+        }
+        v_out = v_next;
+    }
+    i_out = isinf(r_load) ? 0 : v_out / r_load;
+
+    *i_out_raw = to_raw(i_out * 1000, a_adc_k_coef, a_adc_c_coef, true);
+    *v_in_raw = to_raw(v_in * 1000, vin_adc_k_coef, vin_adc_c_coef, true);
+    *v_out_raw = to_raw(v_out * 1000, v_adc_k_coef, v_adc_c_coef, true);
+    pthread_mutex_unlock(&model_mutex);
+}
+
+/**
+ * @brief      The ADC thread, runs the ISR in bursts every millisecond to keep
+ *             up the average sample rate
+ *
+ * @param[in]  arg   unused
+ */
+static void* adc_thread(void *arg)
+{
+    (void) arg;
+    struct timespec next;
+    uint64_t samples = 0;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    uint64_t start_ns = (uint64_t) next.tv_sec * 1000000000 + next.tv_nsec;
+    while (1) {
+        next.tv_nsec += 1000000;
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        uint64_t now_ns = (uint64_t) next.tv_sec * 1000000000 + next.tv_nsec;
+        uint64_t due = (now_ns - start_ns) * POWERSTAGE_SAMPLE_RATE / 1000000000;
+        while (samples < due) {
+            (*adc_isr)();
+            samples++;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief      Run the ISR for one ms of virtual time
+ */
+static void adc_tick(void)
+{
+    for (uint32_t i = 0; i < POWERSTAGE_SAMPLE_RATE / 1000; i++) {
+        (*adc_isr)();
+    }
+}
+
+void powerstage_start(void (*isr)(void))
+{
+    adc_isr = isr;
+    if (vtime_enabled()) {
+        vtime_set_tick(adc_tick);
+        return;
+    }
+    pthread_create(&adc_th, NULL, adc_thread, "ADC thread");
+}
+
+bool powerstage_command(const char *cmd)
+{
+    double value;
+    bool handled = true;
+    pthread_mutex_lock(&model_mutex);
+    if (strcmp(cmd, "load open") == 0) {
+        load_ohm = 0;
+    } else if (sscanf(cmd, "load %lf", &value) == 1 && value > 0) {
+        load_ohm = value;
+    } else if (sscanf(cmd, "cap %lf", &value) == 1 && value > 0) {
+        cap_f = value * 1e-6;
+    } else if (sscanf(cmd, "vin %lf", &value) == 1 && value >= 0) {
+        v_in = value;
+    } else if (sscanf(cmd, "noise %lf", &value) == 1 && value >= 0) {
+        noise_lsb = (uint32_t) value;
+    } else if (strcmp(cmd, "sim") != 0) {
+        handled = false;
+    }
+    if (handled) {
+        if (load_ohm > 0) {
+            printf("[Sim] V_in %.2fV, load %.2f ohm, C %.0fuF, noise %u LSB: V_out %.3fV I_out %.3fA\n",
+                   v_in, load_ohm, cap_f * 1e6, noise_lsb, v_out, i_out);
+        } else {
+            printf("[Sim] V_in %.2fV, no load, C %.0fuF, noise %u LSB: V_out %.3fV\n",
+                   v_in, cap_f * 1e6, noise_lsb, v_out);
+        }
+    }
+    pthread_mutex_unlock(&model_mutex);
+    return handled;
+}
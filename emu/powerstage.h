@@ -0,0 +1,63 @@
+/* 
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __POWERSTAGE_H__
+#define __POWERSTAGE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** The ADC sample rate of the real hardware */
+#define POWERSTAGE_SAMPLE_RATE  (21000)
+
+/**
+ * @brief      Start calling the simulated ADC ISR at POWERSTAGE_SAMPLE_RATE
+ *
+ * @param[in]  isr   The ISR, it fetches its samples with powerstage_sample()
+ */
+void powerstage_start(void (*isr)(void));
+
+/**
+ * @brief      Advance the model by one sample period and convert the result
+ *             to raw ADC values with the current calibration
+ *
+ * @param[in]  v_dac      The voltage DAC setting
+ * @param[in]  i_dac      The current limit DAC setting
+ * @param[in]  enabled    True if power out is enabled
+ * @param[out] i_out_raw  Raw I_out sample
+ * @param[out] v_in_raw   Raw V_in sample
+ * @param[out] v_out_raw  Raw V_out sample
+ */
+void powerstage_sample(uint16_t v_dac, uint16_t i_dac, bool enabled, uint16_t *i_out_raw, uint16_t *v_in_raw, uint16_t *v_out_raw);
+
+/**
+ * @brief      Handle a model command received on the event port
+ *
+ * @param[in]  cmd   The command, eg. "load 4.7"
+ *
+ * @return     true if the command was a model command
+ */
+bool powerstage_command(const char *cmd);
+
+#endif // __POWERSTAGE_H__
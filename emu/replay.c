@@ -0,0 +1,325 @@
+/* 
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "replay.h"
+#include "protocol.h"
+#include "hw.h"
+
+#define MAX_LINE        (1024)
+
+/** Requests waiting for their response, oldest first. More are counted as
+ *  lost */
+#define MAX_PENDING     (64)
+
+typedef struct {
+    uint64_t t_us;
+    uint32_t length;
+    uint8_t *data;
+} record_t;
+
+static record_t *records;
+static uint32_t num_records;
+static uint32_t captured_responses;
+static bool replay_max_speed;
+static pthread_t replay_th;
+
+/** Shared with replay_count_tx(), called from the main loop */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t answered = PTHREAD_COND_INITIALIZER;
+static struct {
+    uint64_t t_us;
+    uint8_t cmd;
+} pending[MAX_PENDING];
+static uint32_t pending_count;
+static uint32_t *latencies;
+static uint32_t num_latencies;
+static uint32_t lost;
+static uint32_t unsolicited;
+static uint64_t tx_bytes;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief      Parse the hex bytes of a capture line
+ *
+ * @param      record  The record to fill in
+ * @param[in]  hex     The bytes
+ *
+ * @return     true if there was a whole number of bytes
+ */
+static bool parse_bytes(record_t *record, const char *hex)
+{
+    uint32_t length = strlen(hex);
+    if (length == 0 || length % 2) {
+        return false;
+    }
+    record->length = length / 2;
+    record->data = malloc(record->length);
+    if (!record->data) {
+        return false;
+    }
+    for (uint32_t i = 0; i < record->length; i++) {
+        unsigned int b;
+        if (sscanf(&hex[2 * i], "%2x", &b) != 1) {
+            free(record->data);
+            return false;
+        }
+        record->data[i] = b;
+    }
+    return true;
+}
+
+/**
+ * @brief      Read the frames sent to the DPS from a capture
+ *
+ * @param[in]  file_name  The capture
+ *
+ * @return     true if every line parsed and there was something to send
+ */
+static bool load_capture(const char *file_name)
+{
+    char line[MAX_LINE];
+    uint32_t line_no = 0;
+    uint32_t size = 0;
+    FILE *f = fopen(file_name, "r");
+    if (!f) {
+        fprintf(stderr, "Error: could not open %s\n", file_name);
+        return false;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long t_us;
+        char direction;
+        char hex[MAX_LINE];
+        line_no++;
+        line[strcspn(line, "#\r\n")] = 0;
+        if (strspn(line, " \t") == strlen(line)) {
+            continue;
+        }
+        if (sscanf(line, "%llu %c %1023s", &t_us, &direction, hex) != 3 || (direction != '>' && direction != '<')) {
+            fprintf(stderr, "Error: %s:%u: bad line\n", file_name, line_no);
+            fclose(f);
+            return false;
+        }
+        if (direction == '<') {
+            captured_responses++;
+            continue;
+        }
+        if (num_records == size) {
+            size = size ? 2 * size : 256;
+            records = realloc(records, size * sizeof(*records));
+            if (!records) {
+                fclose(f);
+                return false;
+            }
+        }
+        records[num_records].t_us = t_us;
+        if (!parse_bytes(&records[num_records], hex)) {
+            fprintf(stderr, "Error: %s:%u: bad frame\n", file_name, line_no);
+            fclose(f);
+            return false;
+        }
+        num_records++;
+    }
+    fclose(f);
+    latencies = malloc((num_records ? num_records : 1) * sizeof(*latencies));
+    return num_records > 0 && latencies;
+}
+
+/**
+ * @brief      Forget a pending request, call with the lock held
+ *
+ * @param[in]  index  Its index in pending
+ */
+static void pending_remove(uint32_t index)
+{
+    pending_count--;
+    memmove(&pending[index], &pending[index + 1], (pending_count - index) * sizeof(pending[0]));
+}
+
+void replay_count_tx(const frame_t *frame)
+{
+    /** Commands and responses are never escaped, _SOF .. _EOF are below 0x80 */
+    bool response = frame->length > 1 && (frame->buffer[1] & cmd_response);
+    pthread_mutex_lock(&lock);
+    tx_bytes += frame->length;
+    if (!response) {
+        unsolicited++;
+    } else {
+        /** The oldest request of the command, requests the firmware did
+         *  not answer are left to time out */
+        uint8_t cmd = frame->buffer[1] & ~cmd_response;
+        for (uint32_t i = 0; i < pending_count; i++) {
+            if (pending[i].cmd == cmd) {
+                latencies[num_latencies++] = now_us() - pending[i].t_us;
+                pending_remove(i);
+                pthread_cond_signal(&answered);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief      Count the requests older than REPLAY_TIMEOUT_MS as lost, call
+ *             with the lock held
+ *
+ * @param[in]  now  The current time
+ */
+static void expire_pending(uint64_t now)
+{
+    while (pending_count && now - pending[0].t_us >= REPLAY_TIMEOUT_MS * 1000) {
+        pending_remove(0);
+        lost++;
+    }
+}
+
+/**
+ * @brief      Wait until all requests were answered or timed out
+ */
+static void wait_answered(void)
+{
+    pthread_mutex_lock(&lock);
+    while (pending_count) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        (void) pthread_cond_timedwait(&answered, &lock, &ts);
+        expire_pending(now_us());
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief      Nearest rank percentile of the sorted latencies
+ *
+ * @param[in]  p     Percentile, 1..100
+ */
+static uint32_t percentile(uint32_t p)
+{
+    uint32_t rank = (num_latencies * p + 99) / 100;
+    return latencies[rank ? rank - 1 : 0];
+}
+
+/**
+ * @brief      Print the results
+ *
+ * @param      f            Where to
+ * @param[in]  duration_us  Time the replay took
+ */
+static void report(FILE *f, uint64_t duration_us)
+{
+    uint64_t sum = 0;
+    qsort(latencies, num_latencies, sizeof(*latencies), compare_u32);
+    for (uint32_t i = 0; i < num_latencies; i++) {
+        sum += latencies[i];
+    }
+    fprintf(f, "Replayed %u frames in %.3f s at %s, %.1f frames/s\n", num_records, duration_us / 1e6,
+            replay_max_speed ? "maximum speed" : "the captured pace", num_records * 1e6 / (duration_us ? duration_us : 1));
+    fprintf(f, "  responses   %u (%u captured), %u lost, %u unsolicited frames, %llu bytes sent\n",
+            num_latencies, captured_responses, lost, unsolicited, (unsigned long long) tx_bytes);
+    if (num_latencies) {
+        fprintf(f, "  latency us  min %u, mean %llu, p50 %u, p99 %u, max %u\n", latencies[0],
+                (unsigned long long) (sum / num_latencies), percentile(50), percentile(99),
+                latencies[num_latencies - 1]);
+    }
+}
+
+/**
+ * @brief      The replay thread
+ *
+ * @param      arg   unused
+ */
+static void* replay_thread(void *arg)
+{
+    (void) arg;
+    uint64_t start = now_us();
+    for (uint32_t i = 0; i < num_records; i++) {
+        record_t *r = &records[i];
+        if (!replay_max_speed) {
+            uint64_t due = start + r->t_us - records[0].t_us;
+            uint64_t now = now_us();
+            if (due > now) {
+                usleep(due - now);
+            }
+        }
+        pthread_mutex_lock(&lock);
+        expire_pending(now_us());
+        if (pending_count == MAX_PENDING) {
+            /** Never going to be matched, the oldest is as good as lost */
+            pending_remove(0);
+            lost++;
+        }
+        /** A frame too short to hold a command is still fed, it is not
+         *  expected to be answered */
+        if (r->length > 2) {
+            pending[pending_count].t_us = now_us();
+            pending[pending_count++].cmd = r->data[1];
+        }
+        pthread_mutex_unlock(&lock);
+        /** Wait for the main loop to make room like the comms thread */
+        while (!hw_emul_usart_rx(r->data, r->length)) {
+            usleep(100);
+        }
+        if (replay_max_speed) {
+            wait_answered();
+        }
+    }
+    wait_answered();
+    report(stderr, now_us() - start);
+    exit(EXIT_SUCCESS);
+    return NULL;
+}
+
+bool replay_start(const char *file_name, bool max_speed)
+{
+    if (!load_capture(file_name)) {
+        return false;
+    }
+    replay_max_speed = max_speed;
+    return pthread_create(&replay_th, NULL, replay_thread, NULL) == 0;
+}
@@ -0,0 +1,74 @@
+/* 
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "uframe.h"
+
+/*
+ * Replay mode of the emulator, dpsemu -r <capture> [-m]. The frames a host
+ * sent in a capture are fed to the firmware through the same receive ring
+ * as the frames of the UDP comms thread, with the original spacing or with
+ * -m each as soon as the previous one was answered. The time from feeding a
+ * frame to the firmware sending its response is recorded and reported once
+ * the capture has run out, then the emulator exits.
+ *
+ * Captures are written by dpsctl --capture and by the proxy's
+ * /api/capture, one frame per line, # starts a comment:
+ *
+ *   <time us> > <hex bytes>    A frame sent to the DPS, SOF to EOF
+ *   <time us> < <hex bytes>    A frame received from the DPS
+ *
+ * Received frames are only counted, the firmware under test makes its own.
+ * A response is matched to the oldest request of its command, frames without
+ * cmd_response set (streamed samples, notifications) are counted on their
+ * own. The main loop of the emulator idles in 1 ms sleeps, which bounds the
+ * resolution.
+ */
+
+/** A request not answered in this time is counted as lost */
+#define REPLAY_TIMEOUT_MS  (1000)
+
+/**
+ * @brief      Load a capture and start replaying it in a thread of its own
+ *
+ * @param[in]  file_name  The capture
+ * @param[in]  max_speed  Send each frame once the previous one was answered
+ *                        instead of at its captured time
+ *
+ * @return     false if the capture could not be read
+ */
+bool replay_start(const char *file_name, bool max_speed);
+
+/**
+ * @brief      Account a frame sent by the firmware
+ *
+ * @param[in]  frame  The frame, escaped
+ */
+void replay_count_tx(const frame_t *frame);
+
+#endif // __REPLAY_H__
@@ -26,11 +26,144 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include "tft.h"
+#include "ili9163c.h"
+#include "gfx_lookup.h"
+#include "font-full_small.h"
+#include "font-meter_small.h"
+#include "font-meter_medium.h"
+#include "font-meter_large.h"
 
 #define TFT_WIDTH   128
 #define TFT_HEIGHT  128
 uint8_t tft[TFT_WIDTH][TFT_HEIGHT];
+static uint32_t clear_count;
+static bool is_inverted;
+/** Drawing is skipped while set, see tft_suspend() */
+static bool is_suspended;
+/** Bytes the ILI9163C driver would have sent, two per pixel */
+static uint32_t tft_bytes;
+
+/**
+ * The frame buffer holds the RGB565 pixels as the ILI9163C receives them.
+ * Drawing goes through a window the way the display controller does it,
+ * so what is recorded is exactly what the firmware pushes. A frame is
+ * everything drawn between two emul_tft_end_frame() calls.
+ */
+static uint16_t fb[TFT_HEIGHT][TFT_WIDTH];
+static pthread_mutex_t fb_mutex = PTHREAD_MUTEX_INITIALIZER;
+/** Columns the panel is scrolled left by, see tft_set_scroll() */
+static uint32_t scroll;
+
+/** Current drawing window and position */
+static uint32_t win_x1, win_y1, win_x2, win_y2;
+static uint32_t win_x, win_y;
+
+typedef struct {
+    uint32_t ops;       /**< Drawing operations */
+    uint32_t bytes;     /**< Bytes sent to the display */
+    uint32_t changed;   /**< Pixels that got a new value */
+    uint32_t x1, y1;    /**< Dirty region of the changed pixels */
+    uint32_t x2, y2;
+} tft_frame_t;
+
+static tft_frame_t cur_frame, last_frame;
+static uint32_t frame_count;
+static uint64_t total_bytes, total_changed;
+
+/**
+ * @brief Start a drawing operation
+ * @param bytes number of bytes the operation sends to the display
+ * @retval none
+ */
+static void fb_begin(uint32_t bytes)
+{
+    pthread_mutex_lock(&fb_mutex);
+    tft_bytes += bytes;
+    cur_frame.ops++;
+    cur_frame.bytes += bytes;
+}
+
+/**
+ * @brief End a drawing operation
+ * @retval none
+ */
+static void fb_end(void)
+{
+    pthread_mutex_unlock(&fb_mutex);
+}
+
+/**
+ * @brief Set the window the following pixels are written to
+ * @param x y top left corner
+ * @param w h width and height
+ * @retval none
+ */
+static void fb_window(uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+    win_x1 = win_x = x;
+    win_y1 = win_y = y;
+    win_x2 = x + w - 1;
+    win_y2 = y + h - 1;
+}
+
+/**
+ * @brief Write the next pixel of the window, pixels outside of the display
+ *        are dropped
+ * @param pixel the pixel
+ * @retval none
+ */
+static void fb_push(uint16_t pixel)
+{
+    if (win_x < TFT_WIDTH && win_y < TFT_HEIGHT && fb[win_y][win_x] != pixel) {
+        fb[win_y][win_x] = pixel;
+        if (!cur_frame.changed || win_x < cur_frame.x1) {
+            cur_frame.x1 = win_x;
+        }
+        if (!cur_frame.changed || win_y < cur_frame.y1) {
+            cur_frame.y1 = win_y;
+        }
+        if (!cur_frame.changed || win_x > cur_frame.x2) {
+            cur_frame.x2 = win_x;
+        }
+        if (!cur_frame.changed || win_y > cur_frame.y2) {
+            cur_frame.y2 = win_y;
+        }
+        cur_frame.changed++;
+    }
+    if (++win_x > win_x2) {
+        win_x = win_x1;
+        if (++win_y > win_y2) {
+            win_y = win_y1;
+        }
+    }
+}
+
+/**
+ * @brief Fill a window with one color
+ * @param x y top left corner
+ * @param w h width and height
+ * @param color the color
+ * @retval none
+ */
+static void fb_fill(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint16_t color)
+{
+    fb_window(x, y, w, h);
+    for (uint32_t i = 0; i < w * h; i++) {
+        fb_push(color);
+    }
+}
+
+/**
+ * @brief Byte swap a pixel sent from memory as a byte stream
+ * @param word the pixel in memory
+ * @retval the pixel the display receives
+ */
+static uint16_t swap16(uint16_t word)
+{
+    return (word << 8) | (word >> 8);
+}
 
 /**
  * @brief Draw the tft on stdout
@@ -60,6 +193,189 @@ void emul_tft_draw(void)
     }
 }
 
+/**
+  * @brief End the current frame, called when the main loop goes idle
+  * @retval none
+  */
+void emul_tft_end_frame(void)
+{
+    pthread_mutex_lock(&fb_mutex);
+    if (cur_frame.ops) {
+        last_frame = cur_frame;
+        frame_count++;
+        total_bytes += cur_frame.bytes;
+        total_changed += cur_frame.changed;
+        memset(&cur_frame, 0, sizeof(cur_frame));
+    }
+    pthread_mutex_unlock(&fb_mutex);
+}
+
+/**
+  * @brief Get the pixel shown on the display, the panel does the inversion
+  *        and the scrolling
+  * @param x y position
+  * @retval RGB565 pixel
+  */
+static uint16_t shown_pixel(uint32_t x, uint32_t y)
+{
+    uint16_t pixel = fb[y][(x + scroll) % TFT_WIDTH];
+    return is_inverted ? ~pixel : pixel;
+}
+
+uint32_t emul_tft_raw(uint8_t *buffer, uint32_t size)
+{
+    uint32_t count = 0;
+    pthread_mutex_lock(&fb_mutex);
+    for (uint32_t y = 0; y < TFT_HEIGHT; y++) {
+        for (uint32_t x = 0; x < TFT_WIDTH && count + 2 <= size; x++) {
+            uint16_t pixel = shown_pixel(x, y);
+            buffer[count++] = pixel >> 8;
+            buffer[count++] = pixel & 0xff;
+        }
+    }
+    pthread_mutex_unlock(&fb_mutex);
+    return count;
+}
+
+/**
+  * @brief Update a PNG CRC
+  * @param crc the crc so far, start with 0
+  * @param data data
+  * @param length length of data
+  * @retval the updated crc
+  */
+static uint32_t png_crc(uint32_t crc, const uint8_t *data, uint32_t length)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint32_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+/**
+  * @brief Write a 32 bit big endian value
+  * @retval none
+  */
+static void put_be32(uint8_t *p, uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+/**
+  * @brief Write a PNG chunk
+  * @param f file
+  * @param type chunk type
+  * @param data chunk data
+  * @param length length of data
+  * @retval none
+  */
+static void png_chunk(FILE *f, const char *type, const uint8_t *data, uint32_t length)
+{
+    uint8_t word[4];
+    put_be32(word, length);
+    fwrite(word, 1, 4, f);
+    fwrite(type, 1, 4, f);
+    fwrite(data, 1, length, f);
+    put_be32(word, png_crc(png_crc(0, (const uint8_t*) type, 4), data, length));
+    fwrite(word, 1, 4, f);
+}
+
+/**
+  * @brief Save the display as an 8 bit RGB PNG. The image data is stored
+  *        uncompressed, it is small enough.
+  * @param file_name name of the file
+  * @retval true if the file was written
+  */
+static bool save_png(const char *file_name)
+{
+    /** Filter byte and RGB triplets for each line */
+    #define PNG_LINE      (1 + 3 * TFT_WIDTH)
+    #define PNG_RAW_SIZE  (PNG_LINE * TFT_HEIGHT)
+    static uint8_t raw[PNG_RAW_SIZE];
+    /** zlib header, one stored deflate block and the adler32 */
+    static uint8_t idat[2 + 5 + PNG_RAW_SIZE + 4];
+    uint8_t ihdr[13] = {0, 0, 0, TFT_WIDTH, 0, 0, 0, TFT_HEIGHT, 8, 2, 0, 0, 0};
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+    pthread_mutex_lock(&fb_mutex);
+    uint8_t *p = raw;
+    for (uint32_t y = 0; y < TFT_HEIGHT; y++) {
+        *p++ = 0;
+        for (uint32_t x = 0; x < TFT_WIDTH; x++) {
+            uint16_t pixel = shown_pixel(x, y);
+            *p++ = ((pixel >> 11) & 0x1f) * 255 / 31;
+            *p++ = ((pixel >> 5) & 0x3f) * 255 / 63;
+            *p++ = (pixel & 0x1f) * 255 / 31;
+        }
+    }
+    pthread_mutex_unlock(&fb_mutex);
+
+    uint32_t a = 1, b = 0;
+    for (uint32_t i = 0; i < PNG_RAW_SIZE; i++) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    idat[0] = 0x78;
+    idat[1] = 0x01;
+    idat[2] = 1; /** Final stored block */
+    idat[3] = PNG_RAW_SIZE & 0xff;
+    idat[4] = PNG_RAW_SIZE >> 8;
+    idat[5] = ~PNG_RAW_SIZE & 0xff;
+    idat[6] = (~PNG_RAW_SIZE >> 8) & 0xff;
+    memcpy(&idat[7], raw, PNG_RAW_SIZE);
+    put_be32(&idat[7 + PNG_RAW_SIZE], (b << 16) | a);
+
+    FILE *f = fopen(file_name, "wb");
+    if (!f) {
+        return false;
+    }
+    fwrite(signature, 1, sizeof(signature), f);
+    png_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+    png_chunk(f, "IDAT", idat, sizeof(idat));
+    png_chunk(f, "IEND", NULL, 0);
+    fclose(f);
+    return true;
+}
+
+bool emul_tft_command(const char *cmd)
+{
+    char file_name[128];
+    if (strcmp(cmd, "fb stats") == 0) {
+        pthread_mutex_lock(&fb_mutex);
+        printf("[TFT] %u frames, %llu bytes sent, %llu pixels changed\n",
+               frame_count, (unsigned long long) total_bytes, (unsigned long long) total_changed);
+        if (last_frame.changed) {
+            printf("[TFT] Last frame: %u ops, %u bytes, %u pixels changed in (%u,%u)-(%u,%u)\n",
+                   last_frame.ops, last_frame.bytes, last_frame.changed,
+                   last_frame.x1, last_frame.y1, last_frame.x2, last_frame.y2);
+        } else {
+            printf("[TFT] Last frame: %u ops, %u bytes, no pixels changed\n", last_frame.ops, last_frame.bytes);
+        }
+        pthread_mutex_unlock(&fb_mutex);
+    } else if (sscanf(cmd, "fb png %127s", file_name) == 1) {
+        printf("[TFT] %s %s\n", save_png(file_name) ? "Saved" : "Failed to save", file_name);
+    } else if (sscanf(cmd, "fb raw %127s", file_name) == 1) {
+        static uint8_t buffer[2 * TFT_WIDTH * TFT_HEIGHT];
+        uint32_t length = emul_tft_raw(buffer, sizeof(buffer));
+        FILE *f = fopen(file_name, "wb");
+        if (f) {
+            fwrite(buffer, 1, length, f);
+            fclose(f);
+        }
+        printf("[TFT] %s %s\n", f ? "Saved" : "Failed to save", file_name);
+    } else {
+        return false;
+    }
+    return true;
+}
+
 /**
   * @brief Initialize the TFT module
   * @retval none
@@ -75,7 +391,32 @@ void tft_init(void)
   */
 void tft_clear(void)
 {
+    if (is_suspended) {
+        return;
+    }
+    fb_begin(2 * TFT_WIDTH * TFT_HEIGHT);
+    fb_fill(0, 0, TFT_WIDTH, TFT_HEIGHT, BLACK);
+    fb_end();
     memset(tft, 0, sizeof(tft));
+    clear_count++;
+}
+
+/**
+  * @brief Get the number of times the display has been cleared
+  * @retval clear count
+  */
+uint32_t tft_clear_count(void)
+{
+    return clear_count;
+}
+
+/**
+  * @brief Get the number of bytes that would have been sent to the TFT
+  * @retval byte count
+  */
+uint32_t emul_tft_bytes(void)
+{
+    return tft_bytes;
 }
 
 /**
@@ -89,11 +430,191 @@ void tft_clear(void)
   */
 void tft_blit(uint16_t *bits, uint32_t width, uint32_t height, uint32_t x, uint32_t y)
 {
-    (void) bits;
-    (void) width;
-    (void) height;
-    (void) x;
-    (void) y;
+    if (is_suspended) {
+        return;
+    }
+    fb_begin(2 * width * height);
+    fb_window(x, y, width, height);
+    for (uint32_t i = 0; i < width * height; i++) {
+        fb_push(swap16(bits[i]));
+    }
+    fb_end();
+}
+
+/**
+  * @brief Blit RLE compressed graphics on TFT
+  * @param data compressed graphics
+  * @param width width of data
+  * @param height of data
+  * @param x x position
+  * @param y y position
+  * @retval none
+  */
+void tft_blit_compressed(const uint8_t *data, uint32_t width, uint32_t height, uint32_t x, uint32_t y)
+{
+    uint32_t count = 0; /** Pixels left in the current packet */
+    bool is_run = false;
+    const uint8_t *pixel = data;
+
+    if (is_suspended) {
+        return;
+    }
+    fb_begin(2 * width * height);
+    fb_window(x, y, width, height);
+    for (uint32_t i = 0; i < width * height; i++) {
+        if (!count) {
+            uint8_t ctrl = *data++;
+            count = (ctrl & 0x7f) + 1;
+            is_run = ctrl & 0x80;
+            pixel = data;
+            if (is_run) {
+                data += 2;
+            }
+        }
+        fb_push((pixel[0] << 8) | pixel[1]);
+        if (!is_run) {
+            pixel += 2;
+            data += 2;
+        }
+        count--;
+    }
+    fb_end();
+}
+
+/**
+  * @brief Determine glyph spacing given the font size
+  * @param size font size
+  * @retval the spacing
+  */
+uint8_t tft_get_glyph_spacing(tft_font_size_t size)
+{
+    switch(size) {
+        case FONT_FULL_SMALL:
+            return FONT_FULL_SMALL_SPACING;
+        case FONT_METER_SMALL:
+            return FONT_METER_SMALL_SPACING;
+        case FONT_METER_MEDIUM:
+            return FONT_METER_MEDIUM_SPACING;
+        case FONT_METER_LARGE:
+            return FONT_METER_LARGE_SPACING;
+        default:
+            return 0;
+    }
+}
+
+/**
+  * @brief Determine glyph metrics given the supplied character and font size
+  * @param size font size
+  * @param ch the character (must be a supported character)
+  * @param glyph_width (out) the width in pixels of the character
+  * @param glyph_height (out) the height in pixels of the character
+  * @retval none
+  */
+void tft_get_glyph_metrics(tft_font_size_t size, char ch, uint32_t *glyph_width, uint32_t *glyph_height)
+{
+    size_t idx = ch - 0x20;
+    *glyph_width = *glyph_height = 0;
+    if (idx >= 96) {
+        return;
+    }
+    switch(size) {
+        case FONT_FULL_SMALL:
+            *glyph_width = font_full_small_widths[idx];
+            *glyph_height = font_full_small_height;
+            break;
+        case FONT_METER_SMALL:
+            *glyph_width = font_meter_small_widths[idx];
+            *glyph_height = font_meter_small_height;
+            break;
+        case FONT_METER_MEDIUM:
+            *glyph_width = font_meter_medium_widths[idx];
+            *glyph_height = font_meter_medium_height;
+            break;
+        case FONT_METER_LARGE:
+            *glyph_width = font_meter_large_widths[idx];
+            *glyph_height = font_meter_large_height;
+            break;
+        default:
+            printf("Cannot print at size %d\n", (int) size);
+            return;
+    }
+}
+
+/**
+  * @brief Determine glyph pixel data given the supplied character and font size
+  * @param size font size
+  * @param ch the character (must be a supported character)
+  * @param glyph_pixdata (out) the pointer to the pixel data for the glyph
+  * @param glyph_size (out) the number of bytes taken up in pixdata for this glyph
+  * @retval none
+  */
+void tft_get_glyph_pixdata(tft_font_size_t size, char ch, const uint8_t **glyph_pixdata, uint32_t *glyph_size)
+{
+    size_t idx = ch - 0x20;
+    switch(size) {
+        case FONT_FULL_SMALL:
+            *glyph_pixdata = &font_full_small_pixdata[font_full_small_offsets[idx]];
+            *glyph_size = font_full_small_sizes[idx];
+            break;
+        case FONT_METER_SMALL:
+            *glyph_pixdata = &font_meter_small_pixdata[font_meter_small_offsets[idx]];
+            *glyph_size = font_meter_small_sizes[idx];
+            break;
+        case FONT_METER_MEDIUM:
+            *glyph_pixdata = &font_meter_medium_pixdata[font_meter_medium_offsets[idx]];
+            *glyph_size = font_meter_medium_sizes[idx];
+            break;
+        case FONT_METER_LARGE:
+            *glyph_pixdata = &font_meter_large_pixdata[font_meter_large_offsets[idx]];
+            *glyph_size = font_meter_large_sizes[idx];
+            break;
+        default:
+            *glyph_size = 0;
+            return;
+    }
+}
+
+/**
+  * @brief Draw a glyph, decoded like the firmware does it
+  * @param size font size
+  * @param ch the character
+  * @param x y top left corner
+  * @param width height glyph size
+  * @param color color of the glyph
+  * @param invert whether to invert the glyph
+  * @retval none
+  */
+static void draw_glyph(tft_font_size_t size, char ch, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint16_t color, bool invert)
+{
+    const uint8_t *pixdata;
+    uint32_t nbytes;
+    uint32_t num_pixels = width * height;
+    uint32_t color_mask = 0xffffffff;
+    tft_get_glyph_pixdata(size, ch, &pixdata, &nbytes);
+    if (!invert && color != WHITE) {
+        color_mask = ((uint32_t) swap16(color) << 16) | swap16(color);
+        if (is_inverted) {
+            color_mask = ~color_mask;
+        }
+    }
+    fb_window(x, y, width, height);
+    for (uint32_t i = 0; i < num_pixels; i += 2) {
+        uint32_t pair;
+        if (!nbytes) {
+            /** A space */
+            pair = invert ? 0xffffffff : 0;
+        } else if (i / 4 >= nbytes) {
+            pair = 0;
+        } else {
+            uint8_t nibble = (pixdata[i / 4] >> (i & 2 ? 4 : 0)) & 0xf;
+            pair = invert ? ~mono2bpp_lookup[nibble] : mono2bpp_lookup[nibble] & color_mask;
+        }
+        /** The decoded pixels are sent from memory as a byte stream */
+        fb_push(swap16(pair & 0xffff));
+        if (i + 1 < num_pixels) {
+            fb_push(swap16(pair >> 16));
+        }
+    }
 }
 
 /**
@@ -105,19 +626,38 @@ void tft_blit(uint16_t *bits, uint32_t width, uint32_t height, uint32_t x, uint3
   * @param w width of bounding box
   * @param h height of bounding box
   * @param highlight if true, the character will be inverted
-  * @retval none
+  * @retval the width of the character drawn
   */
 uint8_t tft_putch(tft_font_size_t size, char ch, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint16_t color, bool invert)
 {
+    uint32_t glyph_width, glyph_height;
+    if (is_suspended) {
+        return 0;
+    }
     if (x >= TFT_WIDTH || y >= TFT_HEIGHT) {
         printf("Error: character '%c' put outside of screen (%d, %d)\n", ch, x, y);
+        return 0;
     }
     tft[x][y] = ch;
-    (void) size;
-    (void) w;
-    (void) h;
-    (void) color;
-    (void) invert;
+
+    tft_get_glyph_metrics(size, ch, &glyph_width, &glyph_height);
+    if (glyph_width == 0 || glyph_height == 0) {
+        return 0;
+    }
+    uint32_t xpos = x + (w - glyph_width) / 2;
+    uint32_t ypos = y + (h - glyph_height) / 2;
+    fb_begin(2 * glyph_width * glyph_height);
+    draw_glyph(size, ch, xpos, ypos, glyph_width, glyph_height, color, invert);
+    fb_end();
+
+    uint16_t fill_color = invert ? WHITE : BLACK;
+    if (x < xpos) {
+        tft_fill(x, y, xpos-x, h, fill_color);
+    }
+    if (xpos+glyph_width < x+w) {
+        tft_fill(xpos+glyph_width, y, (w-glyph_width+1)/2, h, fill_color);
+    }
+    return glyph_width;
 }
 
 /**
@@ -134,14 +674,52 @@ uint8_t tft_putch(tft_font_size_t size, char ch, uint32_t x, uint32_t y, uint32_
   */
 uint16_t tft_puts(tft_font_size_t size, const char *str, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint16_t color, bool invert)
 {
-    (void) size;
-    (void) str;
-    (void) x;
-    (void) y;
-    (void) w;
-    (void) h;
-    (void) color;
-    (void) invert;
+    uint32_t space_width, font_height;
+    uint8_t spacing = tft_get_glyph_spacing(size);
+    bool first = true;
+
+    if (is_suspended) {
+        return 0;
+    }
+    tft_get_glyph_metrics(size, ' ', &space_width, &font_height);
+    uint32_t xpos = x;
+    uint32_t ypos = y - font_height;
+
+    while (str && *str) {
+        uint32_t glyph_width, glyph_height;
+        tft_get_glyph_metrics(size, *str, &glyph_width, &glyph_height);
+        if (glyph_width == 0 || glyph_height == 0) {
+            ++str;
+            continue;
+        }
+
+        /** Blank the rest of the box if this character would not fit */
+        uint32_t next_xpos = first ? xpos : xpos + spacing;
+        uint32_t width_remainder = w - (next_xpos - x);
+        uint32_t screen_remainder = TFT_WIDTH - (next_xpos - x);
+        uint32_t draw_remainder = width_remainder < screen_remainder ? width_remainder : screen_remainder;
+        if (glyph_width > draw_remainder) {
+            if (!first) {
+                tft_fill(xpos, ypos, spacing, h, invert ? WHITE : BLACK);
+                xpos += spacing;
+            }
+            tft_fill(xpos, ypos, draw_remainder, glyph_height, invert ? WHITE : BLACK);
+            xpos += draw_remainder;
+            return xpos - x;
+        }
+
+        if (!first) {
+            tft_fill(xpos, ypos, spacing, h, invert ? WHITE : BLACK);
+            xpos += spacing;
+        }
+        fb_begin(2 * glyph_width * glyph_height);
+        draw_glyph(size, *str, xpos, ypos, glyph_width, glyph_height, color, invert);
+        fb_end();
+        xpos += glyph_width;
+        first = false;
+        ++str;
+    }
+    return xpos - x;
 }
 
 /**
@@ -154,12 +732,20 @@ uint16_t tft_puts(tft_font_size_t size, const char *str, uint32_t x, uint32_t y,
   */
 void tft_fill_pattern(uint32_t x1, uint32_t y1, uint32_t x2, uint32_t y2, uint8_t *fill, uint32_t fill_size)
 {
-    (void) x1;
-    (void) y1;
-    (void) x2;
-    (void) y2;
-    (void) fill;
-    (void) fill_size;
+    uint32_t num_pixels = (x2 - x1 + 1) * (y2 - y1 + 1);
+    if (is_suspended) {
+        return;
+    }
+    fb_begin(2 * num_pixels);
+    fb_window(x1, y1, x2 - x1 + 1, y2 - y1 + 1);
+    for (uint32_t i = 0, pos = 0; i < num_pixels && fill_size >= 2; i++) {
+        fb_push((fill[pos] << 8) | fill[pos + 1]);
+        pos += 2;
+        if (pos + 1 >= fill_size) {
+            pos = 0;
+        }
+    }
+    fb_end();
 }
 
 /**
@@ -173,11 +759,27 @@ void tft_fill_pattern(uint32_t x1, uint32_t y1, uint32_t x2, uint32_t y2, uint8_
   */
 void tft_rect(uint32_t xpos, uint32_t ypos, uint32_t width, uint32_t height, uint16_t color)
 {
-    (void) xpos;
-    (void) ypos;
-    (void) width;
-    (void) height;
-    (void) color;
+    if (is_suspended) {
+        return;
+    }
+    fb_begin(2 * 2 * (width + height));
+    fb_fill(xpos, ypos, width, 1, color);
+    fb_fill(xpos, ypos + height, width, 1, color);
+    fb_fill(xpos, ypos, 1, height, color);
+    fb_fill(xpos + width, ypos, 1, height, color);
+    fb_end();
+}
+
+/**
+  * @brief Scroll the display horizontally
+  * @param offset columns to scroll left
+  * @retval none
+  */
+void tft_set_scroll(uint32_t offset)
+{
+    fb_begin(3); /** CMD_VSSTADRS and its two parameter bytes */
+    scroll = offset % TFT_WIDTH;
+    fb_end();
 }
 
 /**
@@ -190,11 +792,12 @@ void tft_rect(uint32_t xpos, uint32_t ypos, uint32_t width, uint32_t height, uin
   */
 void tft_fill(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint16_t color)
 {
-    (void) x;
-    (void) y;
-    (void) w;
-    (void) h;
-    (void) color;
+    if (is_suspended || !w || !h) {
+        return;
+    }
+    fb_begin(2 * w * h);
+    fb_fill(x, y, w, h, color);
+    fb_end();
 }
 
 /**
@@ -204,7 +807,7 @@ void tft_fill(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint16_t color)
   */
 void tft_invert(bool invert)
 {
-    (void) invert;
+    is_inverted = invert;
 }
 
 /**
@@ -213,5 +816,24 @@ void tft_invert(bool invert)
   */
 bool tft_is_inverted(void)
 {
-    return false;
+    return is_inverted;
+}
+
+/**
+  * @brief Suspend or resume all drawing, the display shows black while it
+  *        is switched off
+  * @param suspend true to suspend, false to resume
+  * @retval none
+  */
+void tft_suspend(bool suspend)
+{
+    if (suspend == is_suspended) {
+        return;
+    }
+    is_suspended = suspend;
+    fb_begin(1); /** CMD_DISPOFF or CMD_DISPON */
+    if (suspend) {
+        fb_fill(0, 0, TFT_WIDTH, TFT_HEIGHT, BLACK);
+    }
+    fb_end();
 }
@@ -0,0 +1,162 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * The emulator clock. By default it is the time since the emulator started.
+ * With dpsemu -t <speed> time is virtual: it only moves when the main loop
+ * idles, one ms at a time, and the simulated ADC runs in step with it rather
+ * than from its own thread. A scenario then takes the same course on every
+ * run and hours of device time pass in seconds.
+ *
+ * Speed is the number of virtual ms per real ms. With speed 0 time stands
+ * still, frames are still handled, until told to move on the event port:
+ *
+ *   run <ms>      Advance <ms> as fast as possible, replies when done
+ *   pause         Stop advancing
+ *   resume        Advance at the speed given with -t again
+ *   time          Print the time
+ *
+ * Each of them replies with the time in us on the event port.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "tick.h"
+#include "vtime.h"
+
+static pthread_mutex_t vtime_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t vtime_done = PTHREAD_COND_INITIALIZER;
+
+static bool virtual;
+static uint32_t speed;
+static bool paused;
+/** ms left of a "run" command */
+static uint64_t run_ms;
+static uint64_t now_us;
+static void (*tick)(void);
+
+/**
+ * @brief      Time since the emulator started
+ */
+static uint64_t real_time_us(void)
+{
+    static uint64_t start_us;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t us = (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if (!start_us) {
+        start_us = us;
+    }
+    return us - start_us;
+}
+
+uint64_t get_time_us(void)
+{
+    return virtual ? __atomic_load_n(&now_us, __ATOMIC_RELAXED) : real_time_us();
+}
+
+uint64_t get_ticks(void)
+{
+    return get_time_us() / 1000;
+}
+
+void vtime_enable(uint32_t virtual_speed)
+{
+    speed = virtual_speed;
+    paused = speed == 0;
+    virtual = true;
+    printf("Virtual time, %s\n", paused ? "advanced with run <ms> on the event port" : "running");
+}
+
+bool vtime_enabled(void)
+{
+    return virtual;
+}
+
+void vtime_set_tick(void (*func)(void))
+{
+    tick = func;
+}
+
+void vtime_idle(void)
+{
+    pthread_mutex_lock(&vtime_mutex);
+    bool running = run_ms > 0;
+    bool advance = running || !paused;
+    pthread_mutex_unlock(&vtime_mutex);
+    if (!advance) {
+        /** Keep handling frames while time stands still */
+        usleep(1000);
+        return;
+    }
+
+    __atomic_add_fetch(&now_us, 1000, __ATOMIC_RELAXED);
+    if (tick) {
+        (*tick)();
+    }
+
+    if (running) {
+        pthread_mutex_lock(&vtime_mutex);
+        if (--run_ms == 0) {
+            pthread_cond_broadcast(&vtime_done);
+        }
+        pthread_mutex_unlock(&vtime_mutex);
+    } else if (speed < 1000) {
+        usleep(1000 / speed);
+    }
+}
+
+bool vtime_command(const char *cmd)
+{
+    unsigned long long ms;
+    bool handled = true;
+    if (!virtual) {
+        return false;
+    }
+    pthread_mutex_lock(&vtime_mutex);
+    if (sscanf(cmd, "run %llu", &ms) == 1) {
+        paused = true;
+        run_ms = ms;
+        while (run_ms) {
+            pthread_cond_wait(&vtime_done, &vtime_mutex);
+        }
+    } else if (strcmp(cmd, "pause") == 0) {
+        paused = true;
+    } else if (strcmp(cmd, "resume") == 0) {
+        paused = speed == 0;
+    } else if (strcmp(cmd, "time") != 0) {
+        handled = false;
+    }
+    pthread_mutex_unlock(&vtime_mutex);
+    if (handled) {
+        printf("[Time] %llu.%06llu s%s\n", (unsigned long long) (now_us / 1000000),
+               (unsigned long long) (now_us % 1000000), paused ? ", paused" : "");
+    }
+    return handled;
+}
@@ -0,0 +1,73 @@
+/* 
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef __VTIME_H__
+#define __VTIME_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief      Switch the emulator clock to virtual time, starting at 0.
+ *             get_ticks() and get_time_us() then only advance as the main
+ *             loop idles, 1ms per hw_wait_for_interrupt(), with the ADC
+ *             samples of that ms run in step.
+ *
+ * @param[in]  speed  Virtual ms per real ms, 0 to only advance on "run"
+ */
+void vtime_enable(uint32_t speed);
+
+/**
+ * @brief      Check if the clock is virtual
+ *
+ * @return     true after vtime_enable()
+ */
+bool vtime_enabled(void);
+
+/**
+ * @brief      Set the function run at every virtual ms, the ADC thread of
+ *             real time mode
+ *
+ * @param[in]  tick  The function
+ */
+void vtime_set_tick(void (*tick)(void));
+
+/**
+ * @brief      Idle the main loop, advancing virtual time by 1ms unless it
+ *             is paused
+ */
+void vtime_idle(void);
+
+/**
+ * @brief      Handle a clock command received on the event port. "run <ms>"
+ *             blocks until the main loop has run that long.
+ *
+ * @param[in]  cmd   The command, eg. "run 1000"
+ *
+ * @return     true if the command was a clock command
+ */
+bool vtime_command(const char *cmd);
+
+#endif // __VTIME_H__
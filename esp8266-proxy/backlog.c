@@ -0,0 +1,288 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifdef CONFIG_BACKLOG
+
+#include <esp8266.h>
+#include <espressif/spi_flash.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "crc16.h"
+#include "backlog.h"
+
+#define SECTOR_SIZE  (4096)
+
+/** [seq:32] [boot:32] */
+#define HEADER_SIZE  (8)
+
+/** [t_ms:32] [v_out:16] [i_out:16] [v_in:16] [check:16], check is 0 once published */
+#define RECORD_SIZE  (12)
+#define RECORDS_PER_SECTOR  ((SECTOR_SIZE - HEADER_SIZE) / RECORD_SIZE)
+
+#define ERASED  (0xffffffff)
+
+typedef enum {
+    record_empty = 0,
+    record_pending,
+    record_published,  /** Or torn by a reset or failed write */
+} record_state_t;
+
+/** Sequence number and boot of each sector, ERASED if unused */
+static uint32_t sector_seq[CONFIG_BACKLOG_SECTORS];
+static uint32_t sector_boot[CONFIG_BACKLOG_SECTORS];
+/** Samples waiting to be published in each sector */
+static uint16_t sector_pending[CONFIG_BACKLOG_SECTORS];
+
+static uint32_t boot;
+static uint32_t next_seq;
+static uint32_t write_sector, write_record;
+/** Oldest record that may be pending */
+static uint32_t read_sector, read_record;
+/** End of the last backlog_peek(), invalid once its sector is erased */
+static uint32_t peek_sector, peek_record;
+static bool peek_valid;
+static uint32_t num_pending, num_dropped;
+
+/**
+  * @brief Get the flash address of a record
+  * @param sector the sector
+  * @param record the record in the sector
+  * @retval the address
+  */
+static uint32_t record_addr(uint32_t sector, uint32_t record)
+{
+    return CONFIG_BACKLOG_ADDR + sector * SECTOR_SIZE + HEADER_SIZE + record * RECORD_SIZE;
+}
+
+/**
+  * @brief Check value of a record, never 0 or that of an erased record
+  * @param words the record
+  * @retval the check value
+  */
+static uint16_t record_check(const uint32_t *words)
+{
+    uint16_t crc = crc16_add_bytes(0, (const uint8_t*) words, RECORD_SIZE - 2);
+    return crc == 0xffff ? 0x7fff : crc | 1;
+}
+
+/**
+  * @brief Read a record
+  * @param sector the sector
+  * @param record the record in the sector
+  * @param sample filled in if the record is pending, may be NULL
+  * @retval the state of the record
+  */
+static record_state_t record_read(uint32_t sector, uint32_t record, backlog_sample_t *sample)
+{
+    uint32_t words[RECORD_SIZE / 4];
+    if (sdk_spi_flash_read(record_addr(sector, record), words, RECORD_SIZE) != SPI_FLASH_RESULT_OK) {
+        return record_published;
+    }
+    if (words[0] == ERASED && words[1] == ERASED && words[2] == ERASED) {
+        return record_empty;
+    }
+    if (words[2] >> 16 != record_check(words)) {
+        return record_published;
+    }
+    if (sample) {
+        sample->t_ms = words[0];
+        sample->v_out = words[1] & 0xffff;
+        sample->i_out = words[1] >> 16;
+        sample->v_in = words[2] & 0xffff;
+    }
+    return record_pending;
+}
+
+/**
+  * @brief Erase the sector after the one written and start writing it
+  * @param first true for the first sector of this boot
+  * @retval true on success
+  */
+static bool sector_start(bool first)
+{
+    uint32_t s = first ? write_sector : (write_sector + 1) % CONFIG_BACKLOG_SECTORS;
+    if (sector_seq[s] != ERASED) {
+        /** The ring is full, the oldest sector goes */
+        num_dropped += sector_pending[s];
+        num_pending -= sector_pending[s];
+        sector_pending[s] = 0;
+        if (read_sector == s) {
+            read_sector = (s + 1) % CONFIG_BACKLOG_SECTORS;
+            read_record = 0;
+            peek_valid = false;
+        }
+    }
+    write_sector = s;
+    write_record = RECORDS_PER_SECTOR; /** Full until the header is written */
+    sector_seq[s] = ERASED;
+    if (sdk_spi_flash_erase_sector((CONFIG_BACKLOG_ADDR + s * SECTOR_SIZE) / SECTOR_SIZE) != SPI_FLASH_RESULT_OK) {
+        return false;
+    }
+    uint32_t header[2] = { next_seq, first ? next_seq : boot };
+    if (sdk_spi_flash_write(CONFIG_BACKLOG_ADDR + s * SECTOR_SIZE, header, sizeof(header)) != SPI_FLASH_RESULT_OK) {
+        return false;
+    }
+    sector_seq[s] = header[0];
+    sector_boot[s] = header[1];
+    boot = header[1];
+    next_seq++;
+    write_record = 0;
+    return true;
+}
+
+void backlog_init(void)
+{
+    uint32_t oldest = ERASED, newest = 0;
+    bool any = false;
+    num_pending = num_dropped = 0;
+    for (uint32_t s = 0; s < CONFIG_BACKLOG_SECTORS; s++) {
+        uint32_t header[2];
+        sector_pending[s] = 0;
+        if (sdk_spi_flash_read(CONFIG_BACKLOG_ADDR + s * SECTOR_SIZE, header, sizeof(header)) != SPI_FLASH_RESULT_OK) {
+            header[0] = ERASED;
+        }
+        sector_seq[s] = header[0];
+        sector_boot[s] = header[1];
+        if (header[0] == ERASED) {
+            continue;
+        }
+        /** A failed write leaves a gap, so look at every record */
+        for (uint32_t r = 0; r < RECORDS_PER_SECTOR; r++) {
+            sector_pending[s] += record_read(s, r, NULL) == record_pending;
+        }
+        num_pending += sector_pending[s];
+        if (!any || header[0] < sector_seq[oldest]) {
+            oldest = s;
+        }
+        if (!any || header[0] > sector_seq[newest]) {
+            newest = s;
+        }
+        any = true;
+    }
+    /** Sectors are used in ring order, so reading goes from the oldest on */
+    read_sector = any ? oldest : 0;
+    read_record = 0;
+    peek_valid = false;
+    next_seq = any ? sector_seq[newest] + 1 : 1;
+    write_sector = any ? (newest + 1) % CONFIG_BACKLOG_SECTORS : 0;
+    (void) sector_start(true);
+}
+
+bool backlog_append(const backlog_sample_t *sample)
+{
+    if (write_record == RECORDS_PER_SECTOR && !sector_start(false)) {
+        return false;
+    }
+    uint32_t words[RECORD_SIZE / 4] = {
+        sample->t_ms,
+        sample->v_out | (uint32_t) sample->i_out << 16,
+        sample->v_in,
+    };
+    words[2] |= (uint32_t) record_check(words) << 16;
+    bool ok = sdk_spi_flash_write(record_addr(write_sector, write_record), words, RECORD_SIZE) == SPI_FLASH_RESULT_OK;
+    /** A failed write is skipped like a torn one */
+    write_record++;
+    if (ok) {
+        sector_pending[write_sector]++;
+        num_pending++;
+    }
+    return ok;
+}
+
+uint32_t backlog_peek(backlog_sample_t *samples, uint32_t max, uint32_t *sample_boot)
+{
+    uint32_t s = read_sector, r = read_record, n = 0;
+    while (n < max && !(s == write_sector && r >= write_record)) {
+        if (r == RECORDS_PER_SECTOR || sector_seq[s] == ERASED || sector_pending[s] == 0) {
+            /** Nothing more to publish in this one */
+            if (s == write_sector) {
+                break;
+            }
+            s = (s + 1) % CONFIG_BACKLOG_SECTORS;
+            r = 0;
+            continue;
+        }
+        if (n > 0 && sector_boot[s] != *sample_boot) {
+            break;
+        }
+        if (record_read(s, r, &samples[n]) == record_pending) {
+            *sample_boot = sector_boot[s];
+            n++;
+        }
+        r++;
+    }
+    peek_sector = s;
+    peek_record = r;
+    peek_valid = true;
+    return n;
+}
+
+void backlog_consume(void)
+{
+    if (!peek_valid) {
+        return;
+    }
+    peek_valid = false;
+    uint32_t s = read_sector, r = read_record;
+    while (!(s == peek_sector && r == peek_record)) {
+        if (r >= RECORDS_PER_SECTOR) {
+            s = (s + 1) % CONFIG_BACKLOG_SECTORS;
+            r = 0;
+            continue;
+        }
+        if (sector_pending[s] == 0 && s != peek_sector) {
+            r = RECORDS_PER_SECTOR;
+            continue;
+        }
+        backlog_sample_t sample;
+        if (record_read(s, r, &sample) == record_pending) {
+            /** Clearing bits needs no erase */
+            uint32_t word = sample.v_in;
+            (void) sdk_spi_flash_write(record_addr(s, r) + 8, &word, 4);
+            sector_pending[s]--;
+            num_pending--;
+        }
+        r++;
+    }
+    read_sector = s;
+    read_record = r;
+}
+
+uint32_t backlog_boot(void)
+{
+    return boot;
+}
+
+uint32_t backlog_pending(void)
+{
+    return num_pending;
+}
+
+uint32_t backlog_dropped(void)
+{
+    return num_dropped;
+}
+
+#endif // CONFIG_BACKLOG
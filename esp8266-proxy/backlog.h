@@ -0,0 +1,110 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __BACKLOG_H__
+#define __BACKLOG_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Telemetry backlog, enabled with BACKLOG=1 in the Makefile. While the MQTT
+ * broker cannot be reached the MQTT task keeps sampling the DPS and appends
+ * the samples to a ring of flash sectors instead of dropping them. Once the
+ * broker is back the backlog is published oldest first, and new samples
+ * queue behind it until it has drained so nothing is lost or reordered.
+ *
+ * The ring is CONFIG_BACKLOG_SECTORS sectors at CONFIG_BACKLOG_ADDR, by
+ * default the 64kB after the fwstore.h area, some 5000 samples. Each sector
+ * starts with its sequence number and the boot it was written in. Every boot
+ * starts a new sector as the sample times are the uptime of the proxy.
+ * Published samples are marked in flash, so they are not sent again after a
+ * reboot. When the ring is full the oldest sector is erased and its samples
+ * are counted as dropped.
+ */
+
+#ifndef CONFIG_BACKLOG_ADDR
+#define CONFIG_BACKLOG_ADDR  (0x310000)
+#endif
+
+#ifndef CONFIG_BACKLOG_SECTORS
+#define CONFIG_BACKLOG_SECTORS  (16)
+#endif
+
+#if CONFIG_BACKLOG_SECTORS < 2
+ #error "CONFIG_BACKLOG_SECTORS must be at least 2"
+#endif
+
+typedef struct {
+    uint32_t t_ms;   /** Uptime of the proxy when sampled */
+    uint16_t v_in;   /** mV */
+    uint16_t v_out;  /** mV */
+    uint16_t i_out;  /** mA */
+} backlog_sample_t;
+
+/**
+ * @brief Find the backlog left by earlier boots and start a sector for this one
+ */
+void backlog_init(void);
+
+/**
+ * @brief Add a sample, erasing the oldest sector if the ring is full
+ * @param sample the sample
+ * @retval true if written
+ */
+bool backlog_append(const backlog_sample_t *sample);
+
+/**
+ * @brief Get the oldest samples not yet published, all from the same boot
+ * @param samples where to put them
+ * @param max room in samples
+ * @param boot set to the boot the samples were taken in
+ * @retval number of samples, 0 if the backlog is empty
+ */
+uint32_t backlog_peek(backlog_sample_t *samples, uint32_t max, uint32_t *boot);
+
+/**
+ * @brief Mark the samples of the last backlog_peek() as published
+ */
+void backlog_consume(void);
+
+/**
+ * @brief Get the current boot, as reported by backlog_peek()
+ * @retval the boot
+ */
+uint32_t backlog_boot(void);
+
+/**
+ * @brief Get the number of samples waiting to be published
+ * @retval number of samples
+ */
+uint32_t backlog_pending(void);
+
+/**
+ * @brief Get the number of samples lost to a full ring since boot
+ * @retval number of samples
+ */
+uint32_t backlog_dropped(void);
+
+#endif // __BACKLOG_H__
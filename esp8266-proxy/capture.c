@@ -0,0 +1,138 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <esp8266.h>
+#include <espressif/esp_common.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <semphr.h>
+#include "capture.h"
+
+/** Ring entries are [delta us:32][length:15 | to_dps:1][data], the delta
+ *  is the time since the frame before, 71 minutes at most */
+#define HEADER_SIZE  (6)
+#define TO_DPS_BIT   (0x8000)
+
+static uint8_t ring[CAPTURE_SIZE];
+static uint32_t head, used;
+static uint32_t dropped;
+static volatile bool running;
+static SemaphoreHandle_t lock;
+
+/** sdk_system_get_time() of the last frame put in the ring, and the
+ *  capture time of the last one taken out */
+static uint32_t last_time;
+static uint64_t read_t_us;
+
+static void ring_put(const uint8_t *data, uint32_t length)
+{
+    for (uint32_t i = 0; i < length; i++) {
+        ring[(head + used++) % CAPTURE_SIZE] = data[i];
+    }
+}
+
+static void ring_get(uint8_t *data, uint32_t length)
+{
+    for (uint32_t i = 0; i < length; i++) {
+        data[i] = ring[head];
+        head = (head + 1) % CAPTURE_SIZE;
+        used--;
+    }
+}
+
+void capture_init(void)
+{
+    lock = xSemaphoreCreateMutex();
+}
+
+void capture_start(void)
+{
+    xSemaphoreTake(lock, portMAX_DELAY);
+    head = used = dropped = 0;
+    last_time = sdk_system_get_time();
+    read_t_us = 0;
+    running = true;
+    xSemaphoreGive(lock);
+}
+
+void capture_stop(void)
+{
+    running = false;
+}
+
+bool capture_running(void)
+{
+    return running;
+}
+
+void capture_frame(bool to_dps, const uint8_t *data, uint32_t length)
+{
+    if (!running || length > MAX_FRAME_LENGTH) {
+        return;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (used + HEADER_SIZE + length > CAPTURE_SIZE) {
+        dropped++;
+    } else {
+        uint32_t now = sdk_system_get_time();
+        /** Unsigned arithmetic takes one wrap of the 32 bit clock */
+        uint32_t delta = now - last_time;
+        uint16_t flags = length | (to_dps ? TO_DPS_BIT : 0);
+        last_time = now;
+        ring_put((const uint8_t*) &delta, sizeof(delta));
+        ring_put((const uint8_t*) &flags, sizeof(flags));
+        ring_put(data, length);
+    }
+    xSemaphoreGive(lock);
+}
+
+bool capture_next(capture_record_t *record)
+{
+    uint32_t delta;
+    uint16_t flags;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool have = used > 0;
+    if (have) {
+        ring_get((uint8_t*) &delta, sizeof(delta));
+        ring_get((uint8_t*) &flags, sizeof(flags));
+        read_t_us += delta;
+        record->t_us = read_t_us;
+        record->to_dps = flags & TO_DPS_BIT;
+        record->length = flags & ~TO_DPS_BIT;
+        ring_get(record->data, record->length);
+    }
+    xSemaphoreGive(lock);
+    return have;
+}
+
+uint32_t capture_dropped(void)
+{
+    xSemaphoreTake(lock, portMAX_DELAY);
+    uint32_t count = dropped;
+    dropped = 0;
+    xSemaphoreGive(lock);
+    return count;
+}
@@ -0,0 +1,93 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "uframe.h"
+
+/**
+ * Capture of the frames exchanged with the DPS, for replay in the emulator
+ * (dpsemu -r, see emu/replay.h). Frames are kept with their time in a RAM
+ * ring of CAPTURE_SIZE bytes while a capture runs and are drained by
+ * /api/capture, which a client polls to collect a capture of any length.
+ * Frames that find the ring full are counted as dropped. The firmware sent
+ * in an upgrade is not captured.
+ */
+
+/** Bytes of the capture ring, a frame takes its length and 6 more */
+#define CAPTURE_SIZE  (4096)
+
+typedef struct {
+    uint64_t t_us;      /** Since the capture started */
+    bool to_dps;        /** Sent to the DPS rather than received */
+    uint32_t length;
+    uint8_t data[MAX_FRAME_LENGTH];
+} capture_record_t;
+
+/**
+ * @brief Create the ring lock, call once before the scheduler starts
+ */
+void capture_init(void);
+
+/**
+ * @brief Start a new capture, dropping what was not read of the last one
+ */
+void capture_start(void);
+
+/**
+ * @brief Stop capturing, what was captured can still be read
+ */
+void capture_stop(void);
+
+/**
+ * @brief Check if a capture is running
+ * @retval true if frames are being captured
+ */
+bool capture_running(void);
+
+/**
+ * @brief Add a frame, does nothing unless a capture is running
+ * @param to_dps the frame was sent to the DPS
+ * @param data the frame, SOF to EOF
+ * @param length length of the frame
+ */
+void capture_frame(bool to_dps, const uint8_t *data, uint32_t length);
+
+/**
+ * @brief Take the oldest frame out of the ring
+ * @param record filled in
+ * @retval false if the ring is empty
+ */
+bool capture_next(capture_record_t *record);
+
+/**
+ * @brief Get and clear the number of frames dropped since the last call
+ * @retval number of frames dropped by a full ring
+ */
+uint32_t capture_dropped(void);
+
+#endif // __CAPTURE_H__
@@ -48,13 +48,20 @@
 #include <lwip/igmp.h>
 #include <ssid_config.h>
 #include <espressif/esp_wifi.h>
-#include <stdin_uart_interrupt.h>
 #include "lwipopts.h"
 #include "uhej.h"
 #include "protocol.h"
 #include "uframe.h"
 #include "hexdump.h"
 #include "webserver.h"
+#include "uartrx.h"
+#include "linkstats.h"
+#include "capture.h"
+#include "fwstore.h"
+#include "crc16.h"
+#ifdef CONFIG_MQTT
+#include "mqtt.h"
+#endif // CONFIG_MQTT
 
 /** User friendly FreeRTOS delay macro */
 #define delay_ms(ms) vTaskDelay(ms / portTICK_PERIOD_MS)
@@ -63,8 +70,11 @@
 /** Semaphore to signal wifi availability */
 static SemaphoreHandle_t wifi_alive_sem;
 
-/** Mutex for UART access */
-static SemaphoreHandle_t uart_mutex;
+/** Serializes uart_comm_sync() callers, they share sync_done */
+static SemaphoreHandle_t sync_mutex;
+
+/** Given by uart_comm_task when a uart_comm_sync() request completes */
+static SemaphoreHandle_t sync_done;
 
 /** A queue to synchronize UART comms */
 static QueueHandle_t tx_queue;
@@ -73,16 +83,163 @@ static QueueHandle_t tx_queue;
 
 #define UART_RX_TIMEOUT_MS  (250)
 
-/** A structure used in the tx_queue */
+/** Requests kept in flight on the UART once the DPS is known to handle
+  * cmd_tagged, fewer if cmd_capabilities reports a smaller pipeline.
+  * Without tagging requests are sent one at a time */
+#define MAX_IN_FLIGHT  (4)
+
+/** Clients receiving the frames the DPS sends on its own (OCP events,
+  * telemetry streams) */
+#define MAX_SUBSCRIBERS  (4)
+
+/** A client not heard from for this long stops receiving unsolicited
+  * frames, unless it started a stream */
+#define SUBSCRIBER_TIMEOUT_MS  (60000)
+
+/** How often to check for cmd_tagged support while it is missing */
+#define TAG_PROBE_INTERVAL_MS  (10000)
+
+/** Read only commands without arguments whose response is cached for ttl_ms,
+  * any other command passing through or an OCP event clears the cache */
+static const struct {
+    uint8_t cmd;
+    uint16_t ttl_ms;
+} cacheable[] = {
+    { .cmd = cmd_query, .ttl_ms = 250 },
+    { .cmd = cmd_version, .ttl_ms = 10000 },
+    { .cmd = cmd_list_functions, .ttl_ms = 10000 },
+    { .cmd = cmd_list_parameters, .ttl_ms = 10000 },
+};
+
+#define NUM_CACHEABLE  (sizeof(cacheable) / sizeof(cacheable[0]))
+
+/** Multicast group and port the proxy announces itself on, unsolicited,
+  * letting hosts discover it without a uhej query. dpsctl --discovery-daemon
+  * listens there */
+#define ANNOUNCE_GROUP  "239.255.79.68"
+#define ANNOUNCE_PORT  (5006)
+
+/** Time between announcements, the first one is delayed up to
+  * ANNOUNCE_JITTER_MS so proxies powered up together spread out */
+#define ANNOUNCE_INTERVAL_MS  (30000)
+#define ANNOUNCE_JITTER_MS  (5000)
+
+/** TCP port carrying a stream of uframes both ways, same as the UDP port */
+#define TCP_PORT  (5005)
+
+/** Simultaneous TCP clients */
+#define MAX_TCP_CLIENTS  (2)
+
+/** Frames to a TCP client are collected here and written in one go when the
+  * UART is idle or the buffer is full */
+#define TCP_TX_BUFFER_SIZE  (4 * MAX_FRAME_LENGTH)
+
+/** Frame buffers for datagrams to UDP clients. They are passed to
+  * udp_sendto() by reference, the heap is only used when all are busy */
+#define FRAME_POOL_SIZE  (6)
+
+/** Idle time before the negotiated baud rate is refreshed, must be well
+  * below SERIAL_BAUD_TIMEOUT_MS or the DPS falls back to CONFIG_BAUDRATE */
+#define BAUD_KEEPALIVE_MS  (1000)
+
+/** Chunk size asked for when upgrading from the firmware store, the
+  * bootloader may pick a smaller one */
+#define UPGRADE_CHUNK_SIZE  (1024)
+
+/** Time for the DPS to reboot into the bootloader and answer */
+#define UPGRADE_START_TIMEOUT_MS  (3000)
+
+/** Time for the bootloader to ack a chunk once sent */
+#define UPGRADE_ACK_TIMEOUT_MS  (2000)
+
+/** Chunks resent after errors the bootloader can resume from, in total */
+#define UPGRADE_RETRIES  (10)
+
+/** Current UART rate, dps_fast_baudrate once negotiated with the DPS */
+static uint32_t cur_baudrate = CONFIG_BAUDRATE;
+
+/** Where the response of a request goes */
 typedef struct {
     /** if client_port != 0, send the respnse frame to client_addr:client_port
         otherwise, deal with it locally */
     struct udp_pcb *upcb;
     ip_addr_t client_addr;
     uint16_t client_port;
+    /** if set, the response payload is stored here and done is given, see
+        uart_comm_sync(). Length is 0 if the request failed */
+    frame_t *response;
+    SemaphoreHandle_t done;
+    /** if set, the response frame is written to this TCP connection */
+    struct netconn *conn;
+} client_t;
+
+/** A structure used in the tx_queue */
+typedef struct {
+    client_t client;
     frame_t frame;
 } tx_item_t;
 
+/** A request sent to the DPS waiting for its response */
+typedef struct {
+    bool used;
+    bool tagged;      /** Sent in a cmd_tagged envelope with this tag */
+    uint8_t tag;
+    uint8_t cmd;      /** Command of the request, its response completes it */
+    bool cacheable;   /** The response goes in the cache */
+    uint32_t sent_ms;
+    client_t client;
+} in_flight_t;
+
+/** A client receiving unsolicited frames */
+typedef struct {
+    struct udp_pcb *upcb;
+    ip_addr_t addr;
+    uint16_t port;    /** 0 if the slot is free */
+    bool streaming;   /** Started a stream or subscribed, does not time out */
+    uint32_t last_ms;
+} subscriber_t;
+
+/** A TCP client, receives responses and all unsolicited frames */
+typedef struct {
+    struct netconn *conn;  /** NULL if the slot is free */
+    uint32_t pending;      /** Bytes in buffer not yet written */
+    uint8_t buffer[TCP_TX_BUFFER_SIZE];
+} tcp_client_t;
+
+/** A frame buffer from the pool */
+typedef struct {
+    /** PBUF_REF pointing at buffer. Our reference is the only one when the
+      * stack is done with it */
+    struct pbuf *p;
+    bool claimed;     /** Being filled by uart_comm_task */
+    uint8_t buffer[MAX_FRAME_LENGTH];
+} pool_frame_t;
+
+/** A cached response frame, in cacheable[] order */
+typedef struct {
+    uint32_t length;  /** 0 if nothing is cached */
+    uint32_t stored_ms;
+    uint8_t buffer[MAX_FRAME_LENGTH];
+} cache_entry_t;
+
+/** Owned by uart_comm_task */
+static cache_entry_t cache[NUM_CACHEABLE];
+static in_flight_t in_flight[MAX_IN_FLIGHT];
+static subscriber_t subscribers[MAX_SUBSCRIBERS];
+static bool dps_tagging;
+static uint8_t next_tag;
+/** Requests the DPS takes in flight and the rate negotiated with it, from
+  * its cmd_capabilities response when it has one */
+static uint32_t dps_in_flight = MAX_IN_FLIGHT;
+static uint32_t dps_fast_baudrate = CONFIG_FAST_BAUDRATE;
+
+/** Owned by uart_comm_task */
+static pool_frame_t frame_pool[FRAME_POOL_SIZE];
+
+/** Written by uart_comm_task, slots taken and freed by the TCP tasks */
+static tcp_client_t tcp_clients[MAX_TCP_CLIENTS];
+static SemaphoreHandle_t tcp_mutex;
+
 
 /**
   * @brief This function is called when an UDP datagrm has been received on the port UDP_PORT.
@@ -98,9 +255,10 @@ static void udp_receive_callback(void *arg, struct udp_pcb *upcb, struct pbuf *p
 {
     if (p) {
         tx_item_t item;
-        memcpy((void*) &item.client_addr, (void*) addr, sizeof(ip_addr_t));
-        item.upcb = upcb;
-        item.client_port = port;
+        memset((void*) &item.client, 0, sizeof(item.client));
+        memcpy((void*) &item.client.client_addr, (void*) addr, sizeof(ip_addr_t));
+        item.client.upcb = upcb;
+        item.client.client_port = port;
         memcpy((void*) item.frame.buffer, (void*) p->payload, p->len);
         item.frame.length = p->len;
         if (pdPASS != xQueueSend(tx_queue, (void*) &item, 1000/portTICK_PERIOD_MS)) {
@@ -119,6 +277,7 @@ static void udp_receive_callback(void *arg, struct udp_pcb *upcb, struct pbuf *p
   */
 static void uart_tx(uint8_t *buffer, uint32_t length)
 {
+    capture_frame(true, buffer, length);
     do {
         uart_putc(0, *buffer);
         buffer++;
@@ -129,39 +288,398 @@ static void uart_tx(uint8_t *buffer, uint32_t length)
   * @brief Receive a frame (SOF..EOF) on UART 0
   * @param buffer buffer to store frame
   * @param length length of buffer
-  * @retval length of frame received
+  * @retval length of frame received, 0 on timeout or error
   */
 static uint32_t uart_rx_frame(uint8_t *buffer, uint32_t buffer_size)
 {
-    uint32_t size = 0;
-    uint8_t ch;
-    bool sof = false;
-    bool timeout = false;
-    uint32_t start_time = systime_ms();
-    while(size < buffer_size && !timeout) {
-        if (uart0_num_char() > 0) {
-            if (read(0, (void*) &ch, 1)) { // 0 is stdin
-                if (ch == _SOF) {
-                    size = 0;
-                    sof = true;
-                }
-                if (sof) {
-                    buffer[size++] = ch;
-                }
-                if (ch == _EOF) {
-                    sof = false;
-                    break;
-                }
+    int32_t size = uart_rx_get(buffer, buffer_size, UART_RX_TIMEOUT_MS);
+    if (size > 0) {
+        capture_frame(false, buffer, size);
+    }
+    return size > 0 ? size : 0;
+}
+
+/**
+  * @brief Ask the DPS to run the link at the given rate
+  * @param baudrate the requested rate
+  * @retval true if the DPS acknowledged and has switched
+  * @note Only called from uart_comm_task with no requests in flight
+  */
+static bool uart_set_dps_baudrate(uint32_t baudrate)
+{
+    frame_t frame;
+    uint8_t buffer[MAX_FRAME_LENGTH];
+    uint32_t size;
+    command_t cmd = 0;
+    uint8_t status = 0;
+    protocol_create_set_baudrate(&frame, baudrate);
+    uart_tx((uint8_t*) frame.buffer, frame.length);
+    size = uart_rx_frame(buffer, sizeof(buffer));
+    return size > 0 &&
+           uframe_extract_payload(&frame, buffer, size) > 0 &&
+           protocol_unpack_response(&frame, &cmd, &status) &&
+           cmd == (cmd_response | cmd_set_baudrate) && status;
+}
+
+/**
+  * @brief Switch to CONFIG_FAST_BAUDRATE, or the fastest rate below it the
+  *        DPS reports, or keep the negotiated rate alive
+  * @retval None
+  * @note Only called from uart_comm_task with no requests in flight.
+  *       Firmware without cmd_set_baudrate rejects the command and the link
+  *       stays at CONFIG_BAUDRATE.
+  */
+static void uart_negotiate_baudrate(void)
+{
+    if (dps_fast_baudrate <= CONFIG_BAUDRATE) {
+        return;
+    }
+    if (cur_baudrate == CONFIG_BAUDRATE) {
+        if (uart_set_dps_baudrate(dps_fast_baudrate)) {
+            uart_set_baud(0, dps_fast_baudrate);
+            uart_rx_flush();
+            cur_baudrate = dps_fast_baudrate;
+        }
+    } else if (!uart_set_dps_baudrate(cur_baudrate)) {
+        /** The DPS has most likely timed out and reverted, follow it */
+        uart_set_baud(0, CONFIG_BAUDRATE);
+        uart_rx_flush();
+        cur_baudrate = CONFIG_BAUDRATE;
+    }
+}
+
+/**
+  * @brief Check if the DPS handles cmd_tagged by sending it a tagged
+  *        capabilities query, older firmware answers with a plain failure.
+  *        Firmware with tagging but without cmd_capabilities answers with a
+  *        tagged failure and gets the defaults.
+  * @retval true if the response came back tagged
+  * @note Only called from uart_comm_task with no requests in flight
+  */
+static bool uart_probe_tagging(void)
+{
+    frame_t frame;
+    uint8_t buffer[MAX_FRAME_LENGTH];
+    int32_t length;
+    capabilities_t caps;
+    set_frame_header(&frame);
+    pack8(&frame, cmd_tagged);
+    pack8(&frame, next_tag);
+    pack8(&frame, cmd_capabilities);
+    end_frame(&frame);
+    uart_tx((uint8_t*) frame.buffer, frame.length);
+    length = uart_rx_frame(buffer, sizeof(buffer));
+    if (length <= 0 ||
+        (length = uframe_extract_payload(&frame, buffer, length)) < 3 ||
+        frame.buffer[0] != (cmd_response | cmd_tagged) ||
+        frame.buffer[1] != next_tag++) {
+        return false;
+    }
+    /** Strip the envelope */
+    memmove(frame.buffer, &frame.buffer[2], length - 2);
+    frame.length = length - 2;
+    dps_in_flight = MAX_IN_FLIGHT;
+    dps_fast_baudrate = CONFIG_FAST_BAUDRATE;
+    if (protocol_unpack_capabilities(&frame, &caps)) {
+        if (caps.pipeline < dps_in_flight) {
+            dps_in_flight = caps.pipeline;
+        }
+        if (caps.max_baudrate < dps_fast_baudrate) {
+            dps_fast_baudrate = caps.max_baudrate;
+        }
+        printf("DPS features 0x%08x, %u in flight, %u baud\n", (unsigned) caps.features, (unsigned) dps_in_flight, (unsigned) dps_fast_baudrate);
+    }
+    return true;
+}
+
+/**
+  * @brief Write what is pending for a TCP client without blocking, what the
+  *        connection cannot take now stays in the buffer
+  * @param c the client
+  * @retval None
+  * @note Caller must hold tcp_mutex
+  */
+static void tcp_client_flush(tcp_client_t *c)
+{
+    size_t written = 0;
+    if (c->conn && c->pending) {
+        err_t err = netconn_write_partly(c->conn, c->buffer, c->pending, NETCONN_COPY | NETCONN_DONTBLOCK, &written);
+        if (err == ERR_OK && written > 0) {
+            memmove(c->buffer, &c->buffer[written], c->pending - written);
+            c->pending -= written;
+        } else if (err != ERR_OK && err != ERR_WOULDBLOCK) {
+            c->pending = 0; /** Connection is going away, its task cleans up */
+        }
+    }
+}
+
+/**
+  * @brief Write the frames collected for all TCP clients
+  * @retval None
+  */
+static void tcp_flush(void)
+{
+    xSemaphoreTake(tcp_mutex, portMAX_DELAY);
+    for (uint32_t i = 0; i < MAX_TCP_CLIENTS; i++) {
+        tcp_client_flush(&tcp_clients[i]);
+    }
+    xSemaphoreGive(tcp_mutex);
+}
+
+/**
+  * @brief Queue a frame for a TCP client, flushed by tcp_flush()
+  * @param conn the connection, ignored if it has been closed
+  * @param buffer the frame
+  * @param size length of frame
+  * @retval None
+  */
+static void tcp_send(struct netconn *conn, uint8_t *buffer, uint32_t size)
+{
+    xSemaphoreTake(tcp_mutex, portMAX_DELAY);
+    for (uint32_t i = 0; i < MAX_TCP_CLIENTS; i++) {
+        tcp_client_t *c = &tcp_clients[i];
+        if (c->conn && (!conn || c->conn == conn)) {
+            if (c->pending + size > sizeof(c->buffer)) {
+                tcp_client_flush(c);
+            }
+            /** Whole frames only, a client that does not read loses frames */
+            if (c->pending + size <= sizeof(c->buffer)) {
+                memcpy(&c->buffer[c->pending], buffer, size);
+                c->pending += size;
             }
+        }
+    }
+    xSemaphoreGive(tcp_mutex);
+}
+
+/**
+  * @brief Allocate the pbufs of the frame pool
+  * @retval None
+  */
+static void frame_pool_init(void)
+{
+    for (uint32_t i = 0; i < FRAME_POOL_SIZE; i++) {
+        pool_frame_t *f = &frame_pool[i];
+        f->p = pbuf_alloc(PBUF_TRANSPORT, MAX_FRAME_LENGTH, PBUF_REF);
+        if (f->p) {
+            f->p->payload = f->buffer;
+        }
+        f->claimed = false;
+    }
+}
+
+/**
+  * @brief Take a pool frame not referenced by the stack
+  * @retval the frame, NULL if all are busy
+  */
+static pool_frame_t *frame_pool_get(void)
+{
+    for (uint32_t i = 0; i < FRAME_POOL_SIZE; i++) {
+        pool_frame_t *f = &frame_pool[i];
+        if (f->p && !f->claimed && f->p->ref == 1) {
+            return f;
+        }
+    }
+    return NULL;
+}
+
+/**
+  * @brief Find the pool frame a buffer belongs to
+  * @param buffer the buffer
+  * @retval the frame, NULL if buffer is not from the pool
+  */
+static pool_frame_t *frame_pool_find(const uint8_t *buffer)
+{
+    for (uint32_t i = 0; i < FRAME_POOL_SIZE; i++) {
+        if (frame_pool[i].p && buffer == frame_pool[i].buffer) {
+            return &frame_pool[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+  * @brief Send a response frame to the client of a request
+  * @param client the client
+  * @param buffer the frame
+  * @param size length of frame
+  * @retval None
+  */
+static void client_send(client_t *client, uint8_t *buffer, uint32_t size)
+{
+    if (client->response) {
+        if (uframe_extract_payload(client->response, buffer, size) <= 0) {
+            client->response->length = 0;
+        }
+    } else if (client->client_port > 0) {
+        pool_frame_t *f = frame_pool_find(buffer);
+        if (!f && size <= MAX_FRAME_LENGTH && (f = frame_pool_get()) != NULL) {
+            memcpy(f->buffer, buffer, size);
+        }
+        struct pbuf *p;
+        if (f) {
+            /** The stack chains its headers in front and holds a reference
+              * for as long as it needs the data */
+            p = f->p;
+            p->len = p->tot_len = size;
+            pbuf_ref(p);
+        } else if ((p = pbuf_alloc(PBUF_TRANSPORT, size, PBUF_RAM)) != NULL) {
+            memcpy(p->payload, buffer, size);
+        }
+        if (!p) {
+            printf("Failed to allocate transport buffer\n");
         } else {
-            delay_ms(5);
+            err_t err = udp_sendto(client->upcb, p, &client->client_addr, client->client_port);
+            if (err < 0) {
+                printf("Error sending message: %s (%d)\n", lwip_strerr(err), err);
+            }
+            pbuf_free(p);
         }
-        timeout = systime_ms() - start_time >= UART_RX_TIMEOUT_MS;
+    } else if (client->conn) {
+        tcp_send(client->conn, buffer, size);
     }
-    if (timeout) {
-        size = 0;
+}
+
+/**
+  * @brief Mark a request done, uart_comm_sync() callers are released
+  * @param req the request
+  * @param success false if the request timed out
+  * @retval None
+  */
+static void request_done(in_flight_t *req, bool success)
+{
+    if (req->client.response) {
+        if (!success) {
+            req->client.response->length = 0;
+        }
+        xSemaphoreGive(req->client.done);
+    }
+    req->used = false;
+}
+
+/**
+  * @brief Remember a UDP client for unsolicited frames
+  * @param client the client
+  * @param cmd the command it sent
+  * @retval None
+  */
+static void subscriber_update(client_t *client, uint8_t cmd)
+{
+    subscriber_t *sub = 0;
+    uint32_t now = systime_ms();
+    for (uint32_t i = 0; i < MAX_SUBSCRIBERS && !sub; i++) {
+        subscriber_t *s = &subscribers[i];
+        if (s->port == client->client_port && ip_addr_cmp(&s->addr, &client->client_addr)) {
+            sub = s;
+        }
+    }
+    if (!sub) {
+        /** Take a free or expired slot, else the one heard from least recently */
+        for (uint32_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+            subscriber_t *s = &subscribers[i];
+            if (!s->port || (!s->streaming && now - s->last_ms >= SUBSCRIBER_TIMEOUT_MS)) {
+                sub = s;
+                break;
+            }
+            if (!sub || s->last_ms < sub->last_ms) {
+                sub = s;
+            }
+        }
+        memcpy((void*) &sub->addr, (void*) &client->client_addr, sizeof(ip_addr_t));
+        sub->port = client->client_port;
+        sub->streaming = false;
+    }
+    sub->upcb = client->upcb;
+    sub->last_ms = now;
+    if (cmd == cmd_stream_start || cmd == cmd_subscribe) {
+        /** An unsubscribe too, the slot is taken back when the proxy runs out */
+        sub->streaming = true;
+    } else if (cmd == cmd_stream_stop) {
+        sub->streaming = false;
+    }
+}
+
+/**
+  * @brief Send a frame the DPS sent on its own to all subscribers
+  * @param buffer the frame
+  * @param size length of frame
+  * @retval None
+  */
+static void subscribers_send(uint8_t *buffer, uint32_t size)
+{
+    uint32_t now = systime_ms();
+    for (uint32_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+        subscriber_t *sub = &subscribers[i];
+        if (sub->port && (sub->streaming || now - sub->last_ms < SUBSCRIBER_TIMEOUT_MS)) {
+            client_t client = {
+                .upcb = sub->upcb,
+                .client_port = sub->port,
+            };
+            memcpy((void*) &client.client_addr, (void*) &sub->addr, sizeof(ip_addr_t));
+            client_send(&client, buffer, size);
+        }
+    }
+    tcp_send(NULL, buffer, size); /** TCP clients get everything */
+}
+
+/**
+  * @brief Find the cache entry of a request
+  * @param payload the unescaped request
+  * @retval index in cacheable[] or -1 if the request is not cacheable
+  */
+static int32_t cache_index(frame_t *payload)
+{
+    if (payload->length == 1) {
+        for (uint32_t i = 0; i < NUM_CACHEABLE; i++) {
+            if (cacheable[i].cmd == payload->buffer[0]) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+/**
+  * @brief Get a cached response that is still fresh
+  * @param index index in cacheable[]
+  * @retval the entry or NULL
+  */
+static cache_entry_t *cache_get(int32_t index)
+{
+    cache_entry_t *entry = &cache[index];
+    if (entry->length && systime_ms() - entry->stored_ms < cacheable[index].ttl_ms) {
+        return entry;
+    }
+    return 0;
+}
+
+/**
+  * @brief Store the response to a cacheable request
+  * @param cmd the command of the request
+  * @param buffer the response frame, untagged
+  * @param size length of frame
+  * @retval None
+  */
+static void cache_put(uint8_t cmd, uint8_t *buffer, uint32_t size)
+{
+    for (uint32_t i = 0; i < NUM_CACHEABLE; i++) {
+        if (cacheable[i].cmd == cmd && size <= sizeof(cache[i].buffer)) {
+            memcpy(cache[i].buffer, buffer, size);
+            cache[i].length = size;
+            cache[i].stored_ms = systime_ms();
+        }
+    }
+}
+
+/**
+  * @brief Drop all cached responses, the DPS state may have changed
+  * @retval None
+  */
+static void cache_clear(void)
+{
+    for (uint32_t i = 0; i < NUM_CACHEABLE; i++) {
+        cache[i].length = 0;
     }
-    return size;
 }
 
 /**
@@ -173,24 +691,20 @@ static uint32_t uart_rx_frame(uint8_t *buffer, uint32_t buffer_size)
 static bool uart_comm_sync(frame_t *frame)
 {
     bool success = false;
-    uint8_t rx_buffer[MAX_FRAME_LENGTH];
-    uint32_t rx_size;
-
-    if (xSemaphoreTake(uart_mutex, 1000/portTICK_PERIOD_MS) == pdTRUE) {
-        // Send frame
-        uart_tx((uint8_t*)frame->buffer, frame->length);
-
-        // Receive response
-        rx_size = uart_rx_frame(rx_buffer, sizeof(rx_buffer));
-        if (rx_size > 0) {
-            // Extract payload from response
-            int32_t payload_len = uframe_extract_payload(frame, rx_buffer, rx_size);
-            if (payload_len > 0) {
-                success = true;
-            }
-        }
+    tx_item_t item;
 
-        xSemaphoreGive(uart_mutex);
+    if (xSemaphoreTake(sync_mutex, 1000/portTICK_PERIOD_MS) == pdTRUE) {
+        memset((void*) &item.client, 0, sizeof(item.client));
+        item.client.response = frame;
+        item.client.done = sync_done;
+        memcpy((void*) &item.frame, (void*) frame, sizeof(item.frame));
+        if (pdPASS == xQueueSend(tx_queue, (void*) &item, 1000/portTICK_PERIOD_MS)) {
+            /** uart_comm_task always completes the request, frame must stay
+              * valid until it has */
+            xSemaphoreTake(sync_done, portMAX_DELAY);
+            success = frame->length > 0;
+        }
+        xSemaphoreGive(sync_mutex);
     }
 
     return success;
@@ -204,7 +718,7 @@ static bool uart_comm_sync(frame_t *frame)
 void set_dps_wifi_status(wifi_status_t status)
 {
     tx_item_t item;
-    item.client_port = 0; // Don't transmit to any client
+    memset((void*) &item.client, 0, sizeof(item.client)); // Don't transmit to any client
     protocol_create_wifi_status(&item.frame, status);
     if (pdPASS != xQueueSend(tx_queue, (void*) &item, 1000/portTICK_PERIOD_MS)) {
         printf("failed to enqueue %d\n", status);
@@ -212,6 +726,31 @@ void set_dps_wifi_status(wifi_status_t status)
     }
 }
 
+/**
+  * @brief Announce the proxy on ANNOUNCE_GROUP
+  * @param upcb the UDP context of the DPS server
+  * @retval None
+  */
+static void announce(struct udp_pcb *upcb)
+{
+    char msg[96];
+    ip_addr_t group;
+    int len = snprintf(msg, sizeof(msg), "{\"service\":\"opendps\",\"id\":\"%08x\",\"udp\":%d,\"tcp\":%d,\"http\":%d}",
+        sdk_system_get_chip_id(), 5005, TCP_PORT, HTTP_PORT);
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    if (!p || !ipaddr_aton(ANNOUNCE_GROUP, &group)) {
+        if (p) {
+            pbuf_free(p);
+        }
+        return;
+    }
+    memcpy(p->payload, msg, len);
+    sys_lock_tcpip_core();
+    (void) udp_sendto(upcb, p, &group, ANNOUNCE_PORT);
+    sys_unlock_tcpip_core();
+    pbuf_free(p);
+}
+
 /**
   * @brief This is the DPS server task
   * @param arg user supplied argument from xTaskCreate
@@ -249,13 +788,405 @@ static void uhej_task(void *arg)
 
     if (!success) {
         /** @todo: handle failure */
+        while(1) {
+            delay_ms(10000);
+        }
     }
 
+    delay_ms(sdk_system_get_chip_id() % ANNOUNCE_JITTER_MS);
     while(1) {
-        delay_ms(10000);
+        announce(upcb);
+        delay_ms(ANNOUNCE_INTERVAL_MS);
+    }
+}
+
+/**
+  * @brief Serve one TCP client, frames it sends are queued for the DPS
+  * @param arg the accepted connection, a tcp_clients[] slot is reserved for it
+  * @retval None
+  */
+static void tcp_client_task(void *arg)
+{
+    struct netconn *conn = (struct netconn*) arg;
+    struct netbuf *nb;
+    tx_item_t item;
+    bool sof = false;
+
+    memset((void*) &item.client, 0, sizeof(item.client));
+    item.client.conn = conn;
+    item.frame.length = 0;
+
+    /** Requests are small and latency matters more than segment count,
+      * responses are batched in tcp_send() instead */
+    sys_lock_tcpip_core();
+    tcp_nagle_disable(conn->pcb.tcp);
+    sys_unlock_tcpip_core();
+
+    while (netconn_recv(conn, &nb) == ERR_OK) {
+        do {
+            uint8_t *data;
+            u16_t len;
+            netbuf_data(nb, (void**) &data, &len);
+            for (u16_t i = 0; i < len; i++) {
+                uint8_t ch = data[i];
+                if (ch == _SOF) {
+                    item.frame.length = 0;
+                    sof = true;
+                }
+                if (!sof) {
+                    continue;
+                }
+                if (item.frame.length < sizeof(item.frame.buffer)) {
+                    item.frame.buffer[item.frame.length++] = ch;
+                } else {
+                    sof = false; /** Too long, wait for the next frame */
+                }
+                if (sof && ch == _EOF) {
+                    sof = false;
+                    if (pdPASS != xQueueSend(tx_queue, (void*) &item, 1000/portTICK_PERIOD_MS)) {
+                        printf("Failed to enqueue\n");
+                    }
+                }
+            }
+        } while (netbuf_next(nb) >= 0);
+        netbuf_delete(nb);
+    }
+
+    xSemaphoreTake(tcp_mutex, portMAX_DELAY);
+    for (uint32_t i = 0; i < MAX_TCP_CLIENTS; i++) {
+        if (tcp_clients[i].conn == conn) {
+            tcp_clients[i].conn = NULL;
+            tcp_clients[i].pending = 0;
+        }
+    }
+    xSemaphoreGive(tcp_mutex);
+    netconn_close(conn);
+    netconn_delete(conn);
+    vTaskDelete(NULL);
+}
+
+/**
+  * @brief Accept TCP clients on TCP_PORT
+  * @param arg user supplied argument from xTaskCreate
+  * @retval None
+  */
+static void tcp_server_task(void *arg)
+{
+    struct netconn *listener, *conn;
+    (void) arg;
+
+    xSemaphoreTake(wifi_alive_sem, portMAX_DELAY);
+    xSemaphoreGive(wifi_alive_sem);
+
+    listener = netconn_new(NETCONN_TCP);
+    if (!listener || netconn_bind(listener, NULL, TCP_PORT) != ERR_OK) {
+        printf("Failed to bind to TCP port %d\n", TCP_PORT);
+        vTaskDelete(NULL);
+        return;
+    }
+    netconn_listen(listener);
+
+    while (1) {
+        if (netconn_accept(listener, &conn) != ERR_OK) {
+            continue;
+        }
+        tcp_client_t *slot = 0;
+        xSemaphoreTake(tcp_mutex, portMAX_DELAY);
+        for (uint32_t i = 0; i < MAX_TCP_CLIENTS && !slot; i++) {
+            if (!tcp_clients[i].conn) {
+                slot = &tcp_clients[i];
+                slot->conn = conn;
+                slot->pending = 0;
+            }
+        }
+        xSemaphoreGive(tcp_mutex);
+        if (!slot || pdPASS != xTaskCreate(&tcp_client_task, "tcp_client_task", 512, conn, 3, NULL)) {
+            if (slot) {
+                xSemaphoreTake(tcp_mutex, portMAX_DELAY);
+                slot->conn = NULL;
+                xSemaphoreGive(tcp_mutex);
+            }
+            netconn_close(conn);
+            netconn_delete(conn);
+        }
+    }
+}
+
+/**
+  * @brief Send a request to the DPS, tagged if the DPS supports it so several
+  *        can be in flight
+  * @param item the request
+  * @param payload its unescaped payload
+  * @param tagged wrap it in a cmd_tagged envelope
+  * @retval None
+  */
+static void send_request(tx_item_t *item, frame_t *payload, bool tagged)
+{
+    in_flight_t *req = 0;
+    for (uint32_t i = 0; i < MAX_IN_FLIGHT && !req; i++) {
+        if (!in_flight[i].used) {
+            req = &in_flight[i];
+        }
+    }
+    req->used = true;
+    req->tagged = tagged;
+    req->cmd = payload->buffer[0];
+    req->cacheable = cache_index(payload) >= 0;
+    req->client = item->client;
+    if (tagged) {
+        frame_t frame;
+        req->tag = next_tag++;
+        set_frame_header(&frame);
+        pack8(&frame, cmd_tagged);
+        pack8(&frame, req->tag);
+        pack_bytes(&frame, payload->buffer, payload->length);
+        end_frame(&frame);
+        uart_tx((uint8_t*) frame.buffer, frame.length);
+    } else {
+        uart_tx((uint8_t*) item->frame.buffer, item->frame.length);
+    }
+    req->sent_ms = systime_ms();
+    link_count(link_requests);
+    if (item->client.client_port > 0) {
+        subscriber_update(&item->client, req->cmd);
+    }
+}
+
+/**
+  * @brief Check if a response completes its request. A response sent as a
+  *        message completes it with the last fragment of a window, the host
+  *        asks for the next window in a request of its own
+  * @param req the request
+  * @param payload the unescaped response, untagged
+  * @param length length of payload
+  * @retval true if the request is done
+  */
+static bool response_completes(in_flight_t *req, const uint8_t *payload, int32_t length)
+{
+    if (payload[0] == (cmd_response | cmd_fragment)) {
+        return length >= 4 && (payload[3] & UFRAME_FRAG_ACK);
+    }
+    if (req->cmd == cmd_fragment || req->cmd == cmd_fragment_ack) {
+        /** An ack, or the response of a command sent as a message */
+        return true;
+    }
+    return payload[0] == (cmd_response | req->cmd);
+}
+
+/**
+  * @brief Route a frame received from the DPS
+  * @param buffer the frame
+  * @param size length of frame
+  * @retval None
+  */
+static void handle_rx_frame(uint8_t *buffer, uint32_t size)
+{
+    frame_t frame;
+    uint8_t scratch[MAX_FRAME_LENGTH];
+    if (size > sizeof(scratch)) {
+        return;
+    }
+    /** Extraction unescapes in place, buffer is forwarded to clients as is */
+    memcpy(scratch, buffer, size);
+    int32_t length = uframe_extract_payload(&frame, scratch, size);
+    if (length <= 0) {
+        return;
+    }
+    uint8_t cmd = frame.buffer[0];
+    for (uint32_t i = 0; i < MAX_IN_FLIGHT; i++) {
+        in_flight_t *req = &in_flight[i];
+        if (!req->used) {
+            continue;
+        }
+        if (req->tagged && cmd == (cmd_response | cmd_tagged) && length >= 3 && frame.buffer[1] == req->tag) {
+            /** Strip the envelope, the client sent the request untagged */
+            frame_t inner;
+            set_frame_header(&inner);
+            pack_bytes(&inner, &frame.buffer[2], length - 2);
+            end_frame(&inner);
+            client_send(&req->client, inner.buffer, inner.length);
+            /** A batch answers with the responses of its sub-commands first */
+            if (response_completes(req, &frame.buffer[2], length - 2)) {
+                if (req->cacheable && frame.buffer[2] == (cmd_response | req->cmd)) {
+                    cache_put(req->cmd, inner.buffer, inner.length);
+                } else if (!req->cacheable) {
+                    cache_clear(); /** Reads answered before this write are stale */
+                }
+                request_done(req, true);
+            }
+            return;
+        } else if (!req->tagged && (cmd & cmd_response)) {
+            client_send(&req->client, buffer, size);
+            if (cmd == (cmd_response | cmd_fragment) && !response_completes(req, frame.buffer, length)) {
+                return;
+            }
+            if (req->cacheable && cmd == (cmd_response | req->cmd)) {
+                cache_put(req->cmd, buffer, size);
+            } else if (!req->cacheable) {
+                cache_clear();
+            }
+            request_done(req, true);
+            return;
+        }
+    }
+    if (!(cmd & cmd_response)) {
+        if (cmd == cmd_ocp_event || cmd == cmd_notify) {
+            /** Cached responses may no longer tell the device state */
+            cache_clear();
+        }
+        webserver_push(&frame);
+#ifdef CONFIG_MQTT
+        mqtt_push(&frame);
+#endif // CONFIG_MQTT
+        subscribers_send(buffer, size);
     }
 }
 
+/**
+  * @brief Send a byte on UART 0, escaped as in a frame
+  * @param b the byte
+  * @retval None
+  */
+static void uart_tx_escaped(uint8_t b)
+{
+    if (b == _SOF || b == _DLE || b == _EOF) {
+        uart_putc(0, _DLE);
+        b ^= _XOR;
+    }
+    uart_putc(0, b);
+}
+
+/**
+  * @brief Send a frame with a payload too large for a frame_t, escaping on
+  *        the fly
+  * @param cmd the command
+  * @param data the rest of the payload
+  * @param length length of data
+  * @retval None
+  */
+static void uart_tx_large(uint8_t cmd, const uint8_t *data, uint32_t length)
+{
+    uint16_t crc = crc16_add_bytes(crc16_add(0, cmd), data, length);
+    uart_putc(0, _SOF);
+    uart_tx_escaped(cmd);
+    for (uint32_t i = 0; i < length; i++) {
+        uart_tx_escaped(data[i]);
+    }
+    uart_tx_escaped(crc >> 8);
+    uart_tx_escaped(crc & 0xff);
+    uart_putc(0, _EOF);
+}
+
+/**
+  * @brief Wait for the bootloader's response to an upgrade command, frames
+  *        from the app still on their way are skipped
+  * @param cmd the command
+  * @param frame receives the payload, unpacking starts after the command
+  * @param timeout_ms how long to wait
+  * @retval true if the response came
+  */
+static bool uart_rx_upgrade_response(uint8_t cmd, frame_t *frame, uint32_t timeout_ms)
+{
+    uint8_t buffer[MAX_FRAME_LENGTH];
+    uint32_t start = systime_ms();
+    uint32_t elapsed;
+    while ((elapsed = systime_ms() - start) < timeout_ms) {
+        int32_t size = uart_rx_get(buffer, sizeof(buffer), timeout_ms - elapsed);
+        if (size > 0 && uframe_extract_payload(frame, buffer, size) >= 2 && frame->buffer[0] == (cmd_response | cmd)) {
+            uint8_t dummy;
+            start_frame_unpacking(frame);
+            unpack8(frame, &dummy);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+  * @brief Upgrade the DPS with the image in the firmware store
+  * @param image the stored image
+  * @retval None
+  * @note Only called from uart_comm_task with no requests in flight. Works
+  *       like dpsctl.py --upgrade, always sending the raw image from the
+  *       start. The bootloader talks at CONFIG_BAUDRATE.
+  */
+static void uart_upgrade(const fwstore_info_t *image)
+{
+    static uint8_t chunk[UPGRADE_CHUNK_SIZE];
+    frame_t frame;
+    uint8_t status = upgrade_protocol_error;
+    uint16_t chunk_size = 0;
+    printf("Upgrading the DPS, %u bytes\n", (unsigned) image->length);
+    cache_clear();
+    /** The app reboots into the bootloader, a DPS already stuck in the
+      * bootloader only answers at CONFIG_BAUDRATE */
+    for (uint32_t attempt = 0; attempt < 2 && !chunk_size; attempt++) {
+        set_frame_header(&frame);
+        pack8(&frame, cmd_upgrade_start);
+        pack16(&frame, UPGRADE_CHUNK_SIZE);
+        pack16(&frame, image->crc);
+        end_frame(&frame);
+        uart_tx((uint8_t*) frame.buffer, frame.length);
+        if (cur_baudrate != CONFIG_BAUDRATE) {
+            uart_set_baud(0, CONFIG_BAUDRATE);
+            cur_baudrate = CONFIG_BAUDRATE;
+        }
+        uart_rx_flush();
+        if (uart_rx_upgrade_response(cmd_upgrade_start, &frame, UPGRADE_START_TIMEOUT_MS)) {
+            unpack8(&frame, &status);
+            if (status == upgrade_continue) {
+                unpack16(&frame, &chunk_size);
+            }
+        }
+    }
+
+    uint32_t offset = 0;
+    uint32_t retries = UPGRADE_RETRIES;
+    while (chunk_size > 0 && chunk_size <= UPGRADE_CHUNK_SIZE) {
+        /** The last chunk is the first short one, empty if need be */
+        uint32_t length = image->length - offset < chunk_size ? image->length - offset : chunk_size;
+        if (!fwstore_read(offset, chunk, length)) {
+            status = upgrade_protocol_error;
+            break;
+        }
+        uart_tx_large(cmd_upgrade_data, chunk, length);
+        uint32_t acked = 0;
+        if (!uart_rx_upgrade_response(cmd_upgrade_data, &frame, UPGRADE_ACK_TIMEOUT_MS)) {
+            status = upgrade_protocol_error;
+            break;
+        }
+        unpack8(&frame, &status);
+        unpack32(&frame, &acked);
+        if ((status == upgrade_chunk_error || status == upgrade_erase_error || status == upgrade_flash_error) &&
+            retries > 0 && acked <= image->length && acked % chunk_size == 0) {
+            /** Resend from what the bootloader got written */
+            retries--;
+            link_count(link_retries);
+            offset = acked;
+            continue;
+        }
+        if (status == upgrade_success) {
+            offset += length;
+            break;
+        }
+        if (status != upgrade_continue) {
+            break;
+        }
+        offset += length;
+        fwstore_progress(fwstore_upgrading, offset, status);
+        if (length < chunk_size) {
+            /** The last chunk is answered with upgrade_success or an error */
+            status = upgrade_protocol_error;
+            break;
+        }
+    }
+    printf("Upgrade %s (%u)\n", status == upgrade_success ? "done" : "failed", status);
+    fwstore_progress(status == upgrade_success ? fwstore_done : fwstore_failed, offset, status);
+    /** Start over with the new app */
+    uart_rx_flush();
+    dps_tagging = false;
+}
+
 /**
   * @brief This is the task that communicates with the DPS
   * @param arg user supplied argument from xTaskCreate
@@ -263,39 +1194,150 @@ static void uhej_task(void *arg)
   */
 static void uart_comm_task(void *arg)
 {
+    /** Used when the pool is exhausted */
+    static uint8_t rx_spare[MAX_FRAME_LENGTH];
+    pool_frame_t *rx_frame = NULL;
+    uint8_t *rx_buffer = NULL;
     tx_item_t item;
+    frame_t payload;
+    bool have_item = false;
+    uint32_t last_probe = 0;
+    frame_pool_init();
     while(1) {
-        if (pdPASS != xQueueReceive(tx_queue, (void*) &item, portMAX_DELAY)) {
-            printf("xQueueReceive failed\n");
-            delay_ms(1000);
-        } else {
-            if (xSemaphoreTake(uart_mutex, 1000/portTICK_PERIOD_MS) == pdTRUE) {
-                uint8_t buffer[MAX_FRAME_LENGTH];
-                uint32_t size;
-                uart_tx((uint8_t*) &item.frame, item.frame.length);
-
-                size = uart_rx_frame((uint8_t*) &buffer, sizeof(buffer));
-                if (size > 0) {
-                    if (item.client_port > 0) {
-                        struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, size, PBUF_RAM);
-                        if (!p) {
-                            printf("Failed to allocate transport buffer\n");
-                        } else {
-                            memcpy(p->payload, buffer, size);
-                            err_t err = udp_sendto(item.upcb, p, &item.client_addr, item.client_port);
-                            if (err < 0) {
-                                printf("Error sending message: %s (%d)\n", lwip_strerr(err), err);
-                            }
-                            pbuf_free(p);
-                        }
+        uint32_t num_in_flight = 0;
+        bool untagged_in_flight = false;
+        for (uint32_t i = 0; i < MAX_IN_FLIGHT; i++) {
+            num_in_flight += in_flight[i].used;
+            untagged_in_flight |= in_flight[i].used && !in_flight[i].tagged;
+        }
+
+        fwstore_info_t image;
+        if (!num_in_flight && !have_item && fwstore_claim(&image)) {
+            uart_upgrade(&image);
+            last_probe = 0;
+            continue;
+        }
+
+        if (!have_item) {
+            /** Block for new requests only when there are no responses to wait for */
+            TickType_t wait = num_in_flight ? 0 : BAUD_KEEPALIVE_MS/portTICK_PERIOD_MS;
+            if (wait) {
+                tcp_flush();
+            }
+            if (pdPASS == xQueueReceive(tx_queue, (void*) &item, wait)) {
+                have_item = uframe_extract_payload(&payload, item.frame.buffer, item.frame.length) > 0;
+                if (!have_item && item.client.response) {
+                    item.client.response->length = 0;
+                    xSemaphoreGive(item.client.done);
+                }
+            } else if (!num_in_flight) {
+                /** Link is idle, negotiate or refresh the baud rate */
+                uart_negotiate_baudrate();
+                if (!dps_tagging && systime_ms() - last_probe >= TAG_PROBE_INTERVAL_MS) {
+                    dps_tagging = uart_probe_tagging();
+                    last_probe = systime_ms();
+                }
+                continue;
+            }
+        }
+
+        if (have_item) {
+            uint8_t cmd = payload.buffer[0];
+            if (cmd == cmd_fragment && payload.length >= 4 && !(payload.buffer[3] & UFRAME_FRAG_ACK)) {
+                /** Fragments inside a window are not answered, the DPS takes
+                  * frames in order so they need not wait for anything */
+                uart_tx((uint8_t*) item.frame.buffer, item.frame.length);
+                if (item.client.client_port > 0) {
+                    subscriber_update(&item.client, cmd);
+                }
+                have_item = false;
+                continue;
+            }
+            int32_t index = cache_index(&payload);
+            bool coalesce = false;
+            if (index < 0) {
+                cache_clear(); /** Anything but a read may change what we have cached */
+            } else {
+                cache_entry_t *entry = cache_get(index);
+                if (entry) {
+                    client_send(&item.client, entry->buffer, entry->length);
+                    if (item.client.response) {
+                        xSemaphoreGive(item.client.done);
                     }
-                } else {
-                    printf("Timeout from DPS\n");
-                    /** @todo: handle timeout */
+                    if (item.client.client_port > 0) {
+                        subscriber_update(&item.client, cmd);
+                    }
+                    have_item = false;
+                    continue;
+                }
+                /** Same request on its way, wait for its response to be cached */
+                for (uint32_t i = 0; i < MAX_IN_FLIGHT; i++) {
+                    coalesce |= in_flight[i].used && in_flight[i].cacheable && in_flight[i].cmd == cmd;
+                }
+            }
+            /** The bootloader knows nothing about tags and the envelope must
+              * still fit in a frame once escaped */
+            bool tagged = dps_tagging && cmd != cmd_upgrade_start && cmd != cmd_upgrade_data &&
+                          cmd != cmd_set_baudrate && 2 * (payload.length + 4) + 2 <= MAX_FRAME_LENGTH;
+            if (!coalesce && (tagged ? (num_in_flight < dps_in_flight && !untagged_in_flight) : !num_in_flight)) {
+                send_request(&item, &payload, tagged);
+                have_item = false;
+                continue;
+            }
+        }
+
+        if (!rx_buffer) {
+            /** Receive straight into a pool frame so it can be sent as is */
+            rx_frame = frame_pool_get();
+            if (rx_frame) {
+                rx_frame->claimed = true;
+            }
+            rx_buffer = rx_frame ? rx_frame->buffer : rx_spare;
+        }
+        int32_t size = uart_rx_get(rx_buffer, MAX_FRAME_LENGTH, 0);
+        if (size > 0) {
+            capture_frame(false, rx_buffer, size);
+            handle_rx_frame(rx_buffer, size);
+            if (rx_frame) {
+                rx_frame->claimed = false;
+            }
+            rx_buffer = NULL;
+            continue;
+        }
+        if (size < 0 && num_in_flight == 1) {
+            /** The response was garbled, fail the request now rather than
+              * at its timeout. With several in flight it is unknown which. */
+            for (uint32_t i = 0; i < MAX_IN_FLIGHT; i++) {
+                if (in_flight[i].used) {
+                    printf("UART error %d\n", (int) size);
+                    link_count(link_garbled);
+                    request_done(&in_flight[i], false);
+                }
+            }
+            continue;
+        }
+        tcp_flush(); /** UART is idle, send what was collected */
+
+        for (uint32_t i = 0; i < MAX_IN_FLIGHT; i++) {
+            if (in_flight[i].used && systime_ms() - in_flight[i].sent_ms >= UART_RX_TIMEOUT_MS) {
+                printf("Timeout from DPS\n");
+                link_count(link_timeouts);
+                request_done(&in_flight[i], false);
+                cache_clear();
+                /** Start over from a known state, it may have rebooted */
+                dps_tagging = false;
+                last_probe = 0;
+                if (cur_baudrate != CONFIG_BAUDRATE) {
+                    /** Renegotiated from the default rate when idle */
+                    uart_set_baud(0, CONFIG_BAUDRATE);
+                    uart_rx_flush();
+                    cur_baudrate = CONFIG_BAUDRATE;
                 }
-                xSemaphoreGive(uart_mutex);
             }
         }
+        /** Woken by the RX interrupt as soon as a frame is complete, the
+          * tick is how long a new request may wait meanwhile */
+        uart_rx_wait(portTICK_PERIOD_MS);
     }
 }
 
@@ -367,13 +1409,25 @@ void user_init(void)
 {
     uart_set_baud(0, CONFIG_BAUDRATE);  /** Baudrate set in makefile */
     uart_clear_txfifo(0);
+    uart_rx_init();
+    capture_init();
     vSemaphoreCreateBinary(wifi_alive_sem);
-    uart_mutex = xSemaphoreCreateMutex();
+    sync_mutex = xSemaphoreCreateMutex();
+    sync_done = xSemaphoreCreateBinary();
+    tcp_mutex = xSemaphoreCreateMutex();
     tx_queue = xQueueCreate(TX_QUEUE_DEPTH, sizeof(tx_item_t));
     ota_tftp_init_server(TFTP_PORT);
     webserver_init(uart_comm_sync);
+#ifdef CONFIG_MQTT
+    mqtt_init(uart_comm_sync);
+#endif // CONFIG_MQTT
     xTaskCreate(&uart_comm_task, "uart_comm_task", 2048, NULL, 4, NULL);
     xTaskCreate(&wifi_task, "wifi_task",  256, NULL, 2, NULL);
     xTaskCreate(&uhej_task, "uhej_task",  256, NULL, 3, NULL);
+    xTaskCreate(&tcp_server_task, "tcp_server_task",  256, NULL, 3, NULL);
     xTaskCreate(&webserver_task, "webserver_task", 2048, NULL, 3, NULL);
+    xTaskCreate(&webserver_event_task, "webserver_event_task", 1024, NULL, 3, NULL);
+#ifdef CONFIG_MQTT
+    xTaskCreate(&mqtt_task, "mqtt_task", 1024, NULL, 3, NULL);
+#endif // CONFIG_MQTT
 }
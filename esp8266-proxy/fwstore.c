@@ -0,0 +1,193 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <esp8266.h>
+#include <espressif/spi_flash.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include "crc16.h"
+#include "fwstore.h"
+
+#define SECTOR_SIZE  (4096)
+
+/** Flash is written and read in words, through this buffer */
+#define STAGE_SIZE  (256)
+
+static fwstore_info_t info;
+
+/** Upload data not yet written, only used by the webserver task */
+static uint32_t stage[STAGE_SIZE / 4];
+static uint32_t staged;
+static uint32_t written;
+
+/**
+  * @brief Write the staged data, padded to whole words
+  * @retval true on success
+  */
+static bool stage_flush(void)
+{
+    if (staged == 0) {
+        return true;
+    }
+    uint32_t length = (staged + 3) & ~3;
+    memset((uint8_t*) stage + staged, 0xff, length - staged);
+    bool ok = sdk_spi_flash_write(CONFIG_FWSTORE_ADDR + written, stage, length) == SPI_FLASH_RESULT_OK;
+    written += staged;
+    staged = 0;
+    return ok;
+}
+
+/**
+  * @brief Fail the upload
+  * @retval false
+  */
+static bool upload_failed(void)
+{
+    taskENTER_CRITICAL();
+    info.state = fwstore_failed;
+    taskEXIT_CRITICAL();
+    return false;
+}
+
+bool fwstore_begin(uint32_t length)
+{
+    bool ok = false;
+    taskENTER_CRITICAL();
+    if (length > 0 && length <= FWSTORE_SIZE && info.state != fwstore_upgrading) {
+        info = (fwstore_info_t) { .state = fwstore_receiving, .length = length };
+        ok = true;
+    }
+    taskEXIT_CRITICAL();
+    if (!ok) {
+        return false;
+    }
+    staged = written = 0;
+    for (uint32_t addr = 0; addr < length; addr += SECTOR_SIZE) {
+        if (sdk_spi_flash_erase_sector((CONFIG_FWSTORE_ADDR + addr) / SECTOR_SIZE) != SPI_FLASH_RESULT_OK) {
+            return upload_failed();
+        }
+    }
+    return true;
+}
+
+bool fwstore_append(const uint8_t *data, uint32_t length)
+{
+    if (info.state != fwstore_receiving || written + staged + length > info.length) {
+        return upload_failed();
+    }
+    while (length > 0) {
+        uint32_t n = STAGE_SIZE - staged;
+        n = n < length ? n : length;
+        memcpy((uint8_t*) stage + staged, data, n);
+        staged += n;
+        data += n;
+        length -= n;
+        if (staged == STAGE_SIZE && !stage_flush()) {
+            return upload_failed();
+        }
+    }
+    info.offset = written + staged;
+    return true;
+}
+
+bool fwstore_end(void)
+{
+    if (info.state != fwstore_receiving || !stage_flush() || written != info.length) {
+        return upload_failed();
+    }
+    uint16_t crc = 0;
+    uint8_t buffer[STAGE_SIZE];
+    for (uint32_t offset = 0; offset < info.length; offset += STAGE_SIZE) {
+        uint32_t n = info.length - offset < STAGE_SIZE ? info.length - offset : STAGE_SIZE;
+        if (!fwstore_read(offset, buffer, n)) {
+            return upload_failed();
+        }
+        /** The vector table starts with the initial stack pointer, in SRAM */
+        if (offset == 0 && (n < 8 || buffer[3] != 0x20)) {
+            return upload_failed();
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            crc = crc16_add(crc, buffer[i]);
+        }
+    }
+    taskENTER_CRITICAL();
+    info.crc = crc;
+    info.offset = 0;
+    info.state = fwstore_pending;
+    taskEXIT_CRITICAL();
+    return true;
+}
+
+bool fwstore_read(uint32_t offset, uint8_t *data, uint32_t length)
+{
+    static uint32_t words[STAGE_SIZE / 4];
+    if (offset + length > FWSTORE_SIZE) {
+        return false;
+    }
+    while (length > 0) {
+        /** Reads must start on a word */
+        uint32_t skip = offset & 3;
+        uint32_t n = STAGE_SIZE - skip < length ? STAGE_SIZE - skip : length;
+        if (sdk_spi_flash_read(CONFIG_FWSTORE_ADDR + offset - skip, words, (skip + n + 3) & ~3) != SPI_FLASH_RESULT_OK) {
+            return false;
+        }
+        memcpy(data, (uint8_t*) words + skip, n);
+        data += n;
+        offset += n;
+        length -= n;
+    }
+    return true;
+}
+
+void fwstore_get(fwstore_info_t *i)
+{
+    taskENTER_CRITICAL();
+    *i = info;
+    taskEXIT_CRITICAL();
+}
+
+bool fwstore_claim(fwstore_info_t *i)
+{
+    bool claimed = false;
+    taskENTER_CRITICAL();
+    if (info.state == fwstore_pending) {
+        info.state = fwstore_upgrading;
+        *i = info;
+        claimed = true;
+    }
+    taskEXIT_CRITICAL();
+    return claimed;
+}
+
+void fwstore_progress(fwstore_state_t state, uint32_t offset, uint8_t status)
+{
+    taskENTER_CRITICAL();
+    info.state = state;
+    info.offset = offset;
+    info.status = status;
+    taskEXIT_CRITICAL();
+}
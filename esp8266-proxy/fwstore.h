@@ -0,0 +1,118 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __FWSTORE_H__
+#define __FWSTORE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Store-and-forward firmware upgrades. An opendps.bin POSTed to /api/upgrade
+ * is written to a spare area of the ESP flash and checked. uart_comm_task
+ * then runs the dpsboot upgrade protocol from the stored copy when the link
+ * is idle, so no chunk waits for a network round trip. The progress is read
+ * back with GET /api/upgrade.
+ *
+ * The area starts at CONFIG_FWSTORE_ADDR, by default 3MB into a 4MB flash,
+ * clear of both rboot slots and the SDK parameters at the end.
+ */
+
+#ifndef CONFIG_FWSTORE_ADDR
+#define CONFIG_FWSTORE_ADDR  (0x300000)
+#endif
+
+/** Largest image stored, the flash of the STM32F100 */
+#define FWSTORE_SIZE  (64 * 1024)
+
+typedef enum {
+    fwstore_empty = 0,   /** Nothing stored */
+    fwstore_receiving,   /** Being uploaded */
+    fwstore_pending,     /** Stored and checked, waiting for uart_comm_task */
+    fwstore_upgrading,   /** Being sent to the DPS */
+    fwstore_done,        /** The DPS reported upgrade_success */
+    fwstore_failed,      /** The upload or the upgrade failed */
+} fwstore_state_t;
+
+typedef struct {
+    fwstore_state_t state;
+    uint32_t length;  /** Image length */
+    uint32_t offset;  /** Bytes received while uploading, acked by the DPS while upgrading */
+    uint16_t crc;     /** CRC16 of the image, once stored */
+    uint8_t status;   /** upgrade_status_t of the last response from the DPS */
+} fwstore_info_t;
+
+/**
+ * @brief Erase room for a new image, refused while an upgrade is running
+ * @param length length of the image
+ * @retval true if the upload may start
+ */
+bool fwstore_begin(uint32_t length);
+
+/**
+ * @brief Add the next part of the image being uploaded
+ * @param data the data
+ * @param length length of data
+ * @retval true if written
+ */
+bool fwstore_append(const uint8_t *data, uint32_t length);
+
+/**
+ * @brief Finish the upload, check the stored image and queue it for the DPS
+ * @retval true if the image is complete and looks like an OpenDPS app
+ */
+bool fwstore_end(void);
+
+/**
+ * @brief Read part of the stored image
+ * @param offset where to start
+ * @param data where to put it
+ * @param length number of bytes
+ * @retval true on success
+ */
+bool fwstore_read(uint32_t offset, uint8_t *data, uint32_t length);
+
+/**
+ * @brief Get the state of the store and of the upgrade
+ * @param info filled in
+ */
+void fwstore_get(fwstore_info_t *info);
+
+/**
+ * @brief Take a pending image for upgrading, it cannot be replaced until
+ *        the upgrade is over
+ * @param info filled in if an image was pending
+ * @retval true if the caller should upgrade the DPS
+ */
+bool fwstore_claim(fwstore_info_t *info);
+
+/**
+ * @brief Report upgrade progress, called by uart_comm_task
+ * @param state fwstore_upgrading, fwstore_done or fwstore_failed
+ * @param offset bytes acked by the DPS
+ * @param status upgrade_status_t of the last response
+ */
+void fwstore_progress(fwstore_state_t state, uint32_t offset, uint8_t status);
+
+#endif // __FWSTORE_H__
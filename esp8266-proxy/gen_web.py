@@ -0,0 +1,52 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+Generate index_html.h, the web UI in web/index.html gzipped into a byte array
+served by webserver.c with Content-Encoding: gzip
+
+The archive carries no timestamp or file name, regenerating an unchanged page
+gives an identical header.
+"""
+
+import argparse
+import gzip
+import io
+
+def compress(data):
+    """
+    Gzip data at the highest level without a timestamp or file name
+    """
+    out = io.BytesIO()
+    with gzip.GzipFile(filename="", mode="wb", compresslevel=9, fileobj=out, mtime=0) as f:
+        f.write(data)
+    return out.getvalue()
+
+def generate(data, gz, output_filename):
+    out = open(output_filename, "w")
+    out.write("/**\n")
+    out.write("  * This file was auto-generated by gen_web.py from web/index.html!\n")
+    out.write("  *\n")
+    out.write("  * The web UI, gzipped from %d to %d bytes. Run make web after changing\n" % (len(data), len(gz)))
+    out.write("  * web/index.html.\n")
+    out.write("  */\n\n")
+    out.write("#ifndef __INDEX_HTML_H__\n")
+    out.write("#define __INDEX_HTML_H__\n\n")
+    out.write("static const uint8_t index_html_gz[] = {\n")
+    for i in range(0, len(gz), 16):
+        out.write("    %s,\n" % ", ".join("0x%02x" % b for b in bytearray(gz[i:i + 16])))
+    out.write("};\n\n")
+    out.write("#endif // __INDEX_HTML_H__\n")
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate the gzipped web UI")
+    parser.add_argument("-i", "--input", default="web/index.html", help="Web page")
+    parser.add_argument("-o", "--output", default="index_html.h", help="Generated header")
+    args = parser.parse_args()
+    data = open(args.input, "rb").read()
+    gz = compress(data)
+    generate(data, gz, args.output)
+    print("Generated %s, %d bytes gzipped to %d" % (args.output, len(data), len(gz)))
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,124 @@
+/**
+  * This file was auto-generated by gen_web.py from web/index.html!
+  *
+  * The web UI, gzipped from 5797 to 1747 bytes. Run make web after changing
+  * web/index.html.
+  */
+
+#ifndef __INDEX_HTML_H__
+#define __INDEX_HTML_H__
+
+static const uint8_t index_html_gz[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xff, 0xc5, 0x58, 0x6d, 0x6f, 0xdb, 0x36,
+    0x10, 0xfe, 0xee, 0x5f, 0xa1, 0xa9, 0x18, 0x24, 0x75, 0x96, 0x2d, 0xa7, 0x2f, 0x08, 0x24, 0xcb,
+    0x43, 0xd7, 0x26, 0x40, 0x86, 0x22, 0x09, 0x90, 0xb4, 0xc3, 0x30, 0x0c, 0x05, 0x2d, 0x51, 0x36,
+    0x57, 0x99, 0x14, 0x24, 0xca, 0x4e, 0x26, 0xf8, 0xbf, 0xef, 0xf8, 0x22, 0x59, 0xb2, 0x65, 0x37,
+    0x5d, 0xb1, 0xee, 0x43, 0x22, 0x9b, 0x3c, 0xde, 0x3d, 0xf7, 0x3c, 0xc7, 0x23, 0xe5, 0xe9, 0x0f,
+    0xef, 0x6e, 0xde, 0xde, 0xff, 0x7e, 0x7b, 0x61, 0x2c, 0xf9, 0x2a, 0x9d, 0x0d, 0xa6, 0xf5, 0x03,
+    0xa3, 0x18, 0x1e, 0x2b, 0xcc, 0x91, 0x11, 0x2d, 0x51, 0x5e, 0x60, 0x1e, 0x9a, 0x1f, 0xee, 0x2f,
+    0xdd, 0x73, 0xb3, 0x1e, 0xa6, 0x68, 0x85, 0x43, 0x73, 0x4d, 0xf0, 0x26, 0x63, 0x39, 0x37, 0x8d,
+    0x88, 0x51, 0x8e, 0x29, 0x98, 0x6d, 0x48, 0xcc, 0x97, 0x61, 0x8c, 0xd7, 0x24, 0xc2, 0xae, 0xfc,
+    0x32, 0x24, 0x94, 0x70, 0x82, 0x52, 0xb7, 0x88, 0x50, 0x8a, 0xc3, 0x89, 0xf0, 0xc1, 0x09, 0x4f,
+    0xf1, 0xec, 0x26, 0xc3, 0xf4, 0xdd, 0xed, 0xdd, 0x74, 0xac, 0xbe, 0x0e, 0xa6, 0x05, 0x7f, 0x14,
+    0xcf, 0xe7, 0xd5, 0x9c, 0x3d, 0xb8, 0x05, 0xf9, 0x9b, 0xd0, 0x85, 0x3f, 0x67, 0x79, 0x8c, 0x73,
+    0x17, 0x46, 0x82, 0x15, 0xca, 0x17, 0x84, 0xfa, 0x5e, 0x90, 0xa1, 0x38, 0x16, 0x73, 0xde, 0x76,
+    0x30, 0x67, 0xf1, 0x63, 0x95, 0x40, 0x74, 0x37, 0x41, 0x2b, 0x92, 0x3e, 0xfa, 0x6f, 0x72, 0x88,
+    0x35, 0x2c, 0x10, 0x2d, 0xdc, 0x02, 0xe7, 0x24, 0x09, 0xe6, 0x28, 0xfa, 0xbc, 0xc8, 0x59, 0x49,
+    0x63, 0xff, 0xd9, 0x04, 0x4d, 0xd0, 0x19, 0x0e, 0x22, 0x96, 0xb2, 0xdc, 0x7f, 0x86, 0x31, 0x0e,
+    0x56, 0x84, 0xba, 0x4b, 0x4c, 0x16, 0x4b, 0xee, 0x4f, 0x3c, 0x6f, 0xbd, 0x6c, 0x7c, 0x9f, 0x79,
+    0xd9, 0xc3, 0x76, 0x30, 0x12, 0x89, 0x21, 0x42, 0x71, 0x5e, 0xad, 0xd0, 0x83, 0x4a, 0xc8, 0x7f,
+    0xe9, 0xc1, 0x5c, 0x83, 0xc6, 0x40, 0x25, 0x67, 0xdb, 0xc1, 0x72, 0x52, 0x71, 0xfc, 0xc0, 0x5d,
+    0x94, 0x92, 0x05, 0xf5, 0x23, 0x20, 0x03, 0xe7, 0x75, 0x20, 0x2f, 0xf1, 0xb4, 0x39, 0xe4, 0xc1,
+    0x39, 0x5b, 0x49, 0xef, 0x81, 0x84, 0x0d, 0x69, 0x62, 0xff, 0xec, 0xa5, 0x0a, 0x86, 0xf2, 0xb8,
+    0xea, 0xe0, 0x7d, 0x7d, 0x36, 0x79, 0x81, 0x03, 0xcd, 0x41, 0x8e, 0x62, 0x52, 0x16, 0x80, 0x13,
+    0xd6, 0xb6, 0x61, 0xee, 0xf9, 0x9e, 0xbc, 0x92, 0xce, 0x0a, 0x8e, 0x78, 0x59, 0x54, 0x31, 0x29,
+    0xb2, 0x14, 0x3d, 0xfa, 0x8b, 0x9c, 0xc4, 0x81, 0xf8, 0xe7, 0x72, 0xbc, 0x82, 0x11, 0x8e, 0x5d,
+    0x40, 0x57, 0xae, 0x28, 0x38, 0x4c, 0x72, 0x03, 0xfe, 0x82, 0x05, 0xca, 0xa4, 0x73, 0xbd, 0xb8,
+    0x27, 0x9f, 0x3a, 0xaa, 0x08, 0xd1, 0x21, 0xd6, 0x4b, 0x5e, 0xbc, 0x7c, 0xed, 0xed, 0x01, 0x3d,
+    0x6f, 0x5c, 0xb9, 0x29, 0x9a, 0xe3, 0xb4, 0xda, 0x25, 0x3c, 0x39, 0x03, 0x07, 0x9a, 0x9d, 0xf3,
+    0xf3, 0xf3, 0xbd, 0x0c, 0x76, 0x09, 0xb8, 0x6b, 0x94, 0x96, 0xb8, 0xea, 0x32, 0xa5, 0x88, 0xdb,
+    0x28, 0xd5, 0xe6, 0x2c, 0x8d, 0x3b, 0xc6, 0xa3, 0x35, 0x4b, 0x39, 0x5a, 0xe0, 0x6a, 0x47, 0x7e,
+    0x77, 0x3e, 0x2a, 0xf3, 0x1c, 0xd2, 0xa9, 0xe7, 0x93, 0xfd, 0xf9, 0x8c, 0x6d, 0x40, 0xee, 0x7a,
+    0xd6, 0x4b, 0xba, 0xb3, 0x84, 0x66, 0x25, 0xdf, 0xf9, 0x4e, 0x74, 0x8d, 0xe4, 0x2c, 0x2d, 0x2a,
+    0x9d, 0x05, 0x67, 0x59, 0x2d, 0x82, 0x9e, 0x72, 0x05, 0x4f, 0x59, 0xd5, 0xab, 0x53, 0xc7, 0xc4,
+    0x50, 0x44, 0xd5, 0xa2, 0xcd, 0x53, 0x16, 0x7d, 0x3e, 0x24, 0xa7, 0xcd, 0x5c, 0x8b, 0xd3, 0x97,
+    0x1d, 0x7f, 0x39, 0xdb, 0x34, 0x7e, 0x92, 0x14, 0x3f, 0xb4, 0xe5, 0x6d, 0xd9, 0x18, 0x2a, 0x21,
+    0x61, 0xe1, 0x4f, 0x76, 0x02, 0x8b, 0xb2, 0x52, 0x6a, 0xfa, 0x94, 0xd1, 0xfd, 0x12, 0x3c, 0x22,
+    0x7f, 0xc3, 0x68, 0xd2, 0x86, 0xf5, 0xfa, 0x20, 0xe4, 0xbc, 0x84, 0x4c, 0x68, 0xd5, 0x0e, 0x66,
+    0x9c, 0x7d, 0x39, 0x22, 0x08, 0x57, 0x80, 0xff, 0x8c, 0x11, 0x59, 0x8c, 0xdd, 0xcc, 0xfb, 0x8a,
+    0x62, 0xce, 0x29, 0x34, 0x01, 0x5e, 0x75, 0xa1, 0x36, 0x38, 0x3d, 0xcf, 0xd3, 0x46, 0x00, 0xe6,
+    0xb8, 0x4d, 0xa0, 0x76, 0x3d, 0xb4, 0x87, 0x1f, 0xbb, 0x1b, 0xa0, 0x05, 0x40, 0x95, 0xba, 0x74,
+    0x95, 0x24, 0x1d, 0x5f, 0x89, 0xd7, 0xe1, 0xe5, 0xab, 0x7c, 0x01, 0x76, 0x7f, 0xc9, 0xd6, 0x50,
+    0x8d, 0x1d, 0x74, 0xd1, 0x0e, 0xf6, 0xe9, 0xe9, 0x24, 0xe9, 0x99, 0x8f, 0x64, 0xd6, 0xac, 0xe4,
+    0x20, 0xbb, 0xab, 0x9b, 0xc4, 0x89, 0x9d, 0xbe, 0x93, 0xa5, 0x2d, 0xc5, 0x5e, 0x25, 0x7b, 0xfd,
+    0xfc, 0xeb, 0x20, 0x87, 0xec, 0xbe, 0xa8, 0x95, 0x86, 0x36, 0x60, 0x14, 0x2c, 0x25, 0xb1, 0xd1,
+    0x21, 0x3d, 0x69, 0x41, 0xec, 0x21, 0xb4, 0x6f, 0x79, 0x9b, 0x67, 0x99, 0x21, 0xce, 0x73, 0xd6,
+    0xda, 0xc6, 0x5e, 0x70, 0x3a, 0xc9, 0xed, 0x60, 0x3a, 0xd6, 0xe7, 0xcf, 0x74, 0xac, 0x4f, 0x40,
+    0x71, 0xb8, 0xc0, 0x23, 0x26, 0x6b, 0x23, 0x4a, 0x51, 0x51, 0x84, 0x66, 0x73, 0x1c, 0x88, 0x53,
+    0x6c, 0x39, 0xa9, 0x8f, 0x30, 0xe3, 0xad, 0xaa, 0x6e, 0x58, 0x39, 0xd9, 0x5b, 0x00, 0x2d, 0xdd,
+    0xec, 0x0e, 0x29, 0xce, 0x7b, 0x06, 0xcd, 0xd9, 0xfe, 0x88, 0xea, 0x9b, 0xe6, 0xec, 0x46, 0x52,
+    0x61, 0x7c, 0x54, 0x9d, 0x6d, 0x3a, 0x06, 0xb3, 0x43, 0x5b, 0xd9, 0x9f, 0x0c, 0xdd, 0xfd, 0x4c,
+    0x83, 0xc4, 0x70, 0x40, 0x03, 0x87, 0xe6, 0xcc, 0x75, 0xf5, 0x0a, 0xf9, 0xff, 0xeb, 0xc3, 0xbe,
+    0x55, 0x0d, 0xf3, 0x64, 0x58, 0xdd, 0x54, 0x55, 0x58, 0xf2, 0x6d, 0x61, 0xaf, 0xe8, 0x53, 0x93,
+    0x95, 0xbd, 0x4b, 0xa7, 0x4a, 0xe8, 0x37, 0x84, 0xbc, 0x15, 0x3d, 0xff, 0x64, 0x28, 0x79, 0x2a,
+    0xa8, 0x50, 0x59, 0x6f, 0x7a, 0xdd, 0xc7, 0x91, 0x12, 0x10, 0xcb, 0x3b, 0x5b, 0xcf, 0xac, 0xad,
+    0x3a, 0xa3, 0xc6, 0xae, 0xf6, 0x41, 0x85, 0x0f, 0xf7, 0xb7, 0x1f, 0xee, 0x8d, 0x9b, 0xcb, 0xcb,
+    0xda, 0xb9, 0xea, 0x9f, 0x6d, 0x67, 0xb0, 0xdd, 0x1b, 0x4f, 0xaa, 0x33, 0x98, 0x06, 0xa3, 0x51,
+    0x4a, 0xa2, 0xcf, 0xa1, 0xc9, 0xd9, 0x62, 0x91, 0x62, 0x25, 0xa6, 0xed, 0x98, 0xb3, 0x8b, 0xeb,
+    0x37, 0xbf, 0xbc, 0xbf, 0x30, 0x94, 0xdf, 0xe9, 0x58, 0x79, 0x3b, 0x0a, 0xdd, 0xa8, 0x8f, 0x37,
+    0xf3, 0x70, 0x2b, 0x34, 0xe7, 0x96, 0x98, 0x93, 0x54, 0xce, 0xb4, 0x6c, 0xc6, 0x1d, 0xe6, 0xb2,
+    0x51, 0x1b, 0xf6, 0x47, 0x67, 0x3a, 0x56, 0x73, 0xbd, 0xeb, 0xe1, 0x40, 0x10, 0xab, 0xa5, 0x94,
+    0x06, 0x7f, 0xcc, 0xe0, 0x5e, 0x49, 0xcb, 0xd5, 0xbc, 0x26, 0xbb, 0xa9, 0xe7, 0x82, 0xe3, 0x2c,
+    0x34, 0xbd, 0x91, 0x37, 0x31, 0x0d, 0xb8, 0xb5, 0xc1, 0x47, 0x78, 0xa2, 0x87, 0xd0, 0x7c, 0x05,
+    0x1f, 0xe0, 0x94, 0x8b, 0xf0, 0x12, 0xba, 0x0e, 0xce, 0x61, 0x60, 0xe4, 0x79, 0xe6, 0x8e, 0xa6,
+    0x16, 0x2d, 0xd0, 0x50, 0x5b, 0xbc, 0xc0, 0x37, 0x8d, 0x56, 0xb0, 0x72, 0x77, 0xd1, 0xc3, 0x45,
+    0x0f, 0x25, 0xfd, 0x69, 0xeb, 0x3d, 0x62, 0xbc, 0x27, 0x2b, 0x02, 0x39, 0xbf, 0xf9, 0xa6, 0x9c,
+    0x9b, 0xcd, 0xd4, 0xe4, 0x7c, 0x98, 0xf4, 0x5e, 0xce, 0x13, 0xb0, 0x79, 0x6a, 0xd2, 0x1a, 0xeb,
+    0x97, 0x92, 0x6e, 0xe5, 0x2e, 0x40, 0xc9, 0x7e, 0xda, 0x14, 0x99, 0xfa, 0xb6, 0x5f, 0xfc, 0x45,
+    0x94, 0x93, 0x8c, 0xcf, 0x06, 0x6b, 0x94, 0xeb, 0x12, 0xbe, 0xa0, 0x68, 0x9e, 0xe2, 0x38, 0x4c,
+    0x50, 0x5a, 0xe0, 0x60, 0x90, 0x94, 0x34, 0xe2, 0x04, 0xf0, 0x15, 0x4b, 0xb6, 0xf9, 0x28, 0x36,
+    0x56, 0x61, 0xc7, 0x4e, 0x35, 0x88, 0x59, 0x54, 0xae, 0x00, 0xd3, 0x68, 0x81, 0xf9, 0x45, 0x8a,
+    0xc5, 0xc7, 0x5f, 0x1e, 0xaf, 0x62, 0xdb, 0x12, 0x1d, 0xcc, 0x72, 0x46, 0xa2, 0x77, 0xbf, 0xd5,
+    0xef, 0x18, 0xf1, 0x68, 0xfd, 0x09, 0x46, 0x47, 0x9c, 0x5d, 0x92, 0x07, 0x1c, 0xdb, 0x67, 0xce,
+    0x4f, 0xd6, 0x47, 0x2b, 0x38, 0xee, 0x83, 0xf4, 0xf9, 0x20, 0x1d, 0x1f, 0x2f, 0xc0, 0xc7, 0x9b,
+    0x53, 0x3e, 0xa0, 0xbd, 0xf4, 0xc0, 0x20, 0xf4, 0xe9, 0x28, 0xb2, 0x43, 0x14, 0xb6, 0x4e, 0xe5,
+    0xb9, 0x86, 0xe3, 0x74, 0xbc, 0xfd, 0x76, 0xca, 0x9b, 0xe4, 0x7f, 0xcf, 0x9d, 0x05, 0x0b, 0xb6,
+    0x5d, 0x8a, 0xef, 0x64, 0x3b, 0x91, 0x14, 0x77, 0x18, 0x0f, 0x06, 0x5d, 0x79, 0x62, 0x7d, 0xda,
+    0x7e, 0xc2, 0x6a, 0x20, 0x90, 0x12, 0x42, 0xf5, 0x84, 0x47, 0x11, 0xec, 0x3a, 0x8f, 0xe5, 0x28,
+    0xf3, 0x82, 0x7f, 0xd1, 0x5a, 0xb5, 0x37, 0xb1, 0x80, 0x24, 0x76, 0x07, 0x02, 0x20, 0x04, 0x57,
+    0x23, 0x59, 0x5e, 0xd7, 0xe2, 0xed, 0xd2, 0xd2, 0x57, 0x18, 0x2b, 0x10, 0xe3, 0x9d, 0x3c, 0xdf,
+    0x5d, 0xdd, 0xb5, 0x3a, 0x18, 0x64, 0x5d, 0xf0, 0xf6, 0xc2, 0xfe, 0x56, 0x4a, 0xad, 0x00, 0xcc,
+    0x3a, 0x7e, 0xea, 0xce, 0x7a, 0x2d, 0x88, 0xc3, 0x50, 0xa0, 0xfd, 0x18, 0x68, 0x0f, 0x84, 0x4e,
+    0x0f, 0x7d, 0x22, 0x02, 0x91, 0xcb, 0x31, 0x08, 0x97, 0x97, 0x52, 0xbc, 0x96, 0x7c, 0x65, 0x16,
+    0xc3, 0x4b, 0x9a, 0x16, 0x10, 0xd8, 0x49, 0x30, 0x8f, 0x96, 0xb6, 0x35, 0x46, 0x19, 0x19, 0xd7,
+    0x34, 0x8e, 0xf8, 0x12, 0x53, 0x3b, 0x0f, 0x67, 0xf9, 0xe8, 0xaf, 0x82, 0x51, 0xdb, 0xd1, 0x23,
+    0x3b, 0xe9, 0x1d, 0xf1, 0x56, 0x29, 0x16, 0xe2, 0x70, 0x56, 0x7d, 0x5d, 0x35, 0xc1, 0x07, 0x8a,
+    0x15, 0x16, 0x35, 0x1f, 0x6c, 0x9d, 0x6e, 0x81, 0xb5, 0xfa, 0x67, 0x25, 0x2b, 0x60, 0x1d, 0x66,
+    0xe2, 0xe7, 0x82, 0xcb, 0x94, 0x21, 0x6e, 0x9f, 0xd8, 0xd3, 0x72, 0x11, 0xc4, 0x93, 0x47, 0xab,
+    0x2a, 0x06, 0x02, 0xd4, 0x5d, 0xdb, 0x6b, 0xc7, 0xa9, 0x50, 0x8a, 0x73, 0x6e, 0x5b, 0x57, 0x14,
+    0x66, 0xe1, 0x66, 0xd7, 0x58, 0x07, 0x39, 0xe6, 0x65, 0x4e, 0x83, 0x6d, 0x87, 0x8a, 0x7a, 0x7a,
+    0x58, 0xad, 0x30, 0x5f, 0xb2, 0xd8, 0xb7, 0x6e, 0x6f, 0xee, 0xee, 0xad, 0xa1, 0xb8, 0xbb, 0xf9,
+    0xeb, 0xd6, 0x86, 0xda, 0x1e, 0x65, 0x2b, 0x06, 0x6a, 0x04, 0x84, 0x1f, 0xe2, 0x51, 0x51, 0x46,
+    0x11, 0x2e, 0x0a, 0xe7, 0xeb, 0x98, 0xba, 0x44, 0x04, 0x2a, 0xd8, 0xe0, 0x4c, 0x50, 0xd2, 0x00,
+    0x0e, 0x06, 0xa2, 0xa4, 0xf6, 0x74, 0x04, 0x02, 0x9d, 0xff, 0x54, 0x91, 0xa6, 0xb9, 0x2b, 0x45,
+    0xc8, 0x93, 0x14, 0xd1, 0x07, 0x4e, 0x9f, 0x22, 0xe4, 0x50, 0x91, 0xc6, 0xba, 0x5f, 0x91, 0x7a,
+    0xba, 0x57, 0x11, 0xd2, 0x6a, 0xb9, 0xdf, 0x4d, 0x91, 0x1a, 0xd1, 0xff, 0xa0, 0x48, 0xf7, 0xee,
+    0xd5, 0xdd, 0xc5, 0xaa, 0x2f, 0xf4, 0xf3, 0xd4, 0xe9, 0x8d, 0x3f, 0x5b, 0x9e, 0xe5, 0x5b, 0x13,
+    0xeb, 0xbb, 0x10, 0xa6, 0x10, 0xeb, 0xa6, 0xf5, 0x1d, 0x29, 0xdb, 0x0f, 0x21, 0xaa, 0x37, 0x63,
+    0x69, 0x1a, 0x82, 0x82, 0x57, 0xe2, 0x75, 0x0d, 0x8a, 0xcf, 0x6e, 0x1b, 0x0d, 0xe1, 0x2d, 0xda,
+    0x53, 0xa5, 0xba, 0x21, 0x34, 0x66, 0x9b, 0xd1, 0xc5, 0x1a, 0x22, 0xdc, 0xb1, 0x32, 0x8f, 0xb0,
+    0x2e, 0x7f, 0x5c, 0x84, 0x14, 0x6f, 0x8c, 0xd6, 0x84, 0xe6, 0x1e, 0x8b, 0x11, 0x79, 0x10, 0xe1,
+    0x62, 0xc4, 0x28, 0x83, 0xf7, 0xb8, 0xd0, 0x76, 0x20, 0x99, 0x28, 0xc5, 0x28, 0x6f, 0xe2, 0x09,
+    0x00, 0x4e, 0x70, 0x1a, 0xc6, 0x2b, 0x09, 0x63, 0xab, 0x3d, 0xc9, 0x9c, 0x94, 0x2b, 0x00, 0x06,
+    0x43, 0x39, 0xbc, 0x4b, 0x3e, 0x0a, 0x53, 0x1c, 0x86, 0x67, 0xce, 0xbf, 0xf0, 0xaf, 0xd2, 0xdc,
+    0xaa, 0x00, 0xf0, 0xc6, 0x2a, 0x93, 0x79, 0x4f, 0xe0, 0x6e, 0x08, 0xc1, 0x6c, 0x4b, 0x9f, 0x05,
+    0x43, 0x50, 0xa2, 0x75, 0xe2, 0xff, 0x7a, 0x77, 0x73, 0x3d, 0x92, 0x5b, 0xdf, 0xc6, 0x23, 0x70,
+    0x86, 0x1c, 0xc7, 0x39, 0xe6, 0x00, 0xad, 0xb2, 0x14, 0x2b, 0x0f, 0x95, 0x20, 0x2d, 0x0e, 0x0f,
+    0x57, 0x0f, 0x69, 0x73, 0xef, 0x4a, 0x31, 0x5d, 0xf0, 0xa5, 0x3b, 0x91, 0xcc, 0xd3, 0x59, 0xe8,
+    0x39, 0xad, 0xab, 0x45, 0x25, 0x2e, 0x45, 0xbe, 0xba, 0x1b, 0x0d, 0xa5, 0xbd, 0xaf, 0xd7, 0xfd,
+    0x41, 0xff, 0x1c, 0x12, 0x3d, 0x40, 0xf4, 0x00, 0x28, 0xaf, 0xc4, 0x87, 0x77, 0x6f, 0x7d, 0x75,
+    0x84, 0xeb, 0xa8, 0x7a, 0xeb, 0x1e, 0xab, 0x5f, 0xa3, 0xff, 0x01, 0x7d, 0xeb, 0x14, 0x77, 0xa5,
+    0x16, 0x00, 0x00,
+};
+
+#endif // __INDEX_HTML_H__
@@ -0,0 +1,63 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "uartrx.h"
+#include "linkstats.h"
+
+/** Written by uart_comm_task only */
+static volatile uint32_t counters[link_counter_count];
+
+/** The counts at the last reset, they are never cleared so /metrics keeps
+ *  its totals from boot */
+static link_stats_t base;
+
+void link_count(link_counter_t counter)
+{
+    counters[counter]++;
+}
+
+void link_stats_get(link_stats_t *stats, bool since_reset)
+{
+    /** Word reads are atomic, a count may be one behind the others */
+    for (uint32_t i = 0; i < link_counter_count; i++) {
+        stats->counters[i] = counters[i];
+    }
+    uart_rx_stats(&stats->rx);
+    if (since_reset) {
+        for (uint32_t i = 0; i < link_counter_count; i++) {
+            stats->counters[i] -= base.counters[i];
+        }
+        stats->rx.frames -= base.rx.frames;
+        stats->rx.err_length -= base.rx.err_length;
+        stats->rx.err_overflow -= base.rx.err_overflow;
+        stats->rx.err_framing -= base.rx.err_framing;
+    }
+}
+
+void link_stats_reset(void)
+{
+    link_stats_get(&base, false);
+}
@@ -0,0 +1,72 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __LINKSTATS_H__
+#define __LINKSTATS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "uartrx.h"
+
+/**
+ * Counters of what went wrong between the proxy and the DPS, on top of the
+ * receive errors of uartrx.h. They run from boot for /metrics, and from the
+ * last link_stats_reset() for /api/link so the error cost of a change, like
+ * a higher FAST_BAUDRATE, can be read off directly.
+ */
+
+/** Events counted by uart_comm_task and the upgrade */
+typedef enum {
+    link_requests = 0,  /** Requests sent to the DPS */
+    link_timeouts,      /** Requests the DPS did not answer in time */
+    link_garbled,       /** Requests failed by a broken response */
+    link_retries,       /** Upgrade chunks sent again after an error */
+    link_counter_count
+} link_counter_t;
+
+typedef struct {
+    uint32_t counters[link_counter_count];
+    uart_rx_stats_t rx;
+} link_stats_t;
+
+/**
+ * @brief Count an event, only called from uart_comm_task
+ * @param counter what happened
+ */
+void link_count(link_counter_t counter);
+
+/**
+ * @brief Get the counters
+ * @param stats filled in
+ * @param since_reset count from the last link_stats_reset() rather than
+ *        from boot
+ */
+void link_stats_get(link_stats_t *stats, bool since_reset);
+
+/**
+ * @brief Start the counters read with since_reset over from zero
+ */
+void link_stats_reset(void);
+
+#endif // __LINKSTATS_H__
@@ -0,0 +1,596 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifdef CONFIG_MQTT
+
+#include <esp8266.h>
+#include <espressif/esp_common.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include <paho_mqtt_c/MQTTESP8266.h>
+#include <paho_mqtt_c/MQTTClient.h>
+#include "mqtt.h"
+#include "protocol.h"
+#include "uframe.h"
+#ifdef CONFIG_BACKLOG
+#include "backlog.h"
+#endif // CONFIG_BACKLOG
+
+#define delay_ms(ms) vTaskDelay(ms / portTICK_PERIOD_MS)
+#define systime_ms() (xTaskGetTickCount() * portTICK_PERIOD_MS)
+
+/** Size of the MQTT send and receive buffers, a full batch must fit */
+#define MQTT_BUF_SIZE  (512)
+#define MQTT_READBUF_SIZE  (128)
+
+/** Timeout of broker round trips */
+#define MQTT_COMMAND_TIMEOUT_MS  (5000)
+
+/** Seconds between pings while idle */
+#define MQTT_KEEPALIVE_S  (30)
+
+/** Delay before reconnecting to the broker */
+#define MQTT_RETRY_MS  (5000)
+
+/** How long to wait for a stream frame before serving the broker */
+#define MQTT_POLL_MS  (100)
+
+/** A stream this quiet is started again, as in webserver.c */
+#define MQTT_STREAM_TIMEOUT_MS  (2 * CONFIG_MQTT_INTERVAL_MS + 1000)
+
+/** Stream frames waiting for the MQTT task */
+#define MQTT_QUEUE_DEPTH  (4)
+
+/** Samples per cmd_stream_data frame asked for */
+#define MQTT_STREAM_BATCH  (CONFIG_MQTT_BATCH < STREAM_MAX_SAMPLES ? CONFIG_MQTT_BATCH : STREAM_MAX_SAMPLES)
+
+#ifdef CONFIG_BACKLOG
+/** Samples per backlog message, the longest message must fit in json */
+#define BACKLOG_BATCH  (8)
+#endif // CONFIG_BACKLOG
+
+static uart_comm_func_t g_uart_comm = NULL;
+static QueueHandle_t mqtt_queue;
+
+/** Stream frames are only queued while someone will publish them, or
+  * store them in the backlog */
+static volatile bool connected;
+static volatile bool sampling;
+
+/** CONFIG_MQTT_TOPIC/<chip id> */
+static char base_topic[32];
+
+static uint8_t mqtt_buf[MQTT_BUF_SIZE];
+static uint8_t mqtt_readbuf[MQTT_READBUF_SIZE];
+static char json[MQTT_BUF_SIZE - 64];
+
+/** Samples collected for the next telemetry message */
+static struct {
+    uint16_t v_out[CONFIG_MQTT_BATCH];
+    uint16_t i_out[CONFIG_MQTT_BATCH];
+#ifdef CONFIG_BACKLOG
+    uint32_t t_ms[CONFIG_MQTT_BATCH];  /** To move them to the backlog if publishing fails */
+#endif // CONFIG_BACKLOG
+    uint32_t count;
+    uint16_t v_in;
+    uint16_t interval_ms;
+    bool have_seq;  /** Streamed, seq is that of the first frame */
+    uint16_t seq;
+    uint16_t next_seq;  /** Expected seq of the next stream frame */
+} batch;
+
+/** How the DPS is sampled, kept while the broker comes and goes */
+static struct {
+    bool streaming;
+    bool can_stream;
+    uint32_t last_sample;
+} sampler = { .can_stream = true };
+
+/** Command received by topic_received(), run by the MQTT task after
+  * mqtt_yield() returns as the client cannot publish from the callback */
+static struct {
+    bool pending;
+    char set[8];
+    char value[12];
+} command;
+
+/**
+ * @brief Publish a message on <base_topic>/<suffix>
+ * @param client the client
+ * @param suffix topic below base_topic
+ * @param payload NUL terminated payload
+ * @return true on success
+ */
+static bool publish(mqtt_client_t *client, const char *suffix, const char *payload)
+{
+    char topic[sizeof(base_topic) + 16];
+    mqtt_message_t message;
+    snprintf(topic, sizeof(topic), "%s/%s", base_topic, suffix);
+    message.payload = (void*) payload;
+    message.payloadlen = strlen(payload);
+    message.dup = 0;
+    message.qos = CONFIG_MQTT_QOS;
+    message.retained = 0;
+    return mqtt_publish(client, topic, &message) == MQTT_SUCCESS;
+}
+
+#ifdef CONFIG_BACKLOG
+/**
+ * @brief Move the collected samples to the backlog, they could not be published
+ */
+static void batch_to_backlog(void)
+{
+    for (uint32_t i = 0; i < batch.count; i++) {
+        backlog_sample_t sample = { batch.t_ms[i], batch.v_in, batch.v_out[i], batch.i_out[i] };
+        (void) backlog_append(&sample);
+    }
+    batch.count = 0;
+}
+#endif // CONFIG_BACKLOG
+
+/**
+ * @brief Publish the collected samples as one telemetry message
+ * @param client the client
+ * @return false if the broker could not be reached
+ */
+static bool publish_batch(mqtt_client_t *client)
+{
+    if (batch.count == 0) {
+        return true;
+    }
+    int len = 0;
+    if (batch.have_seq) {
+        len = snprintf(json, sizeof(json), "{\"seq\":%u,", batch.seq);
+    } else {
+        len = snprintf(json, sizeof(json), "{");
+    }
+    len += snprintf(&json[len], sizeof(json) - len,
+        "\"interval_ms\":%u,\"v_in\":%.2f,\"v_out\":[",
+        batch.interval_ms, batch.v_in / 1000.0f);
+    for (uint32_t i = 0; i < batch.count && len < (int) sizeof(json); i++) {
+        len += snprintf(&json[len], sizeof(json) - len, "%s%.2f", i ? "," : "", batch.v_out[i] / 1000.0f);
+    }
+    if (len < (int) sizeof(json)) {
+        len += snprintf(&json[len], sizeof(json) - len, "],\"i_out\":[");
+    }
+    for (uint32_t i = 0; i < batch.count && len < (int) sizeof(json); i++) {
+        len += snprintf(&json[len], sizeof(json) - len, "%s%.3f", i ? "," : "", batch.i_out[i] / 1000.0f);
+    }
+    if (len < (int) sizeof(json)) {
+        len += snprintf(&json[len], sizeof(json) - len, "]}");
+    }
+    /** Cannot happen with MQTT_MAX_BATCH samples, drop rather than cut */
+    if (len >= (int) sizeof(json) || publish(client, "telemetry", json)) {
+        batch.count = 0;
+        return true;
+    }
+#ifdef CONFIG_BACKLOG
+    batch_to_backlog();
+#endif // CONFIG_BACKLOG
+    batch.count = 0;
+    return false;
+}
+
+#ifdef CONFIG_BACKLOG
+/**
+ * @brief Publish the oldest samples of the backlog on <base_topic>/backlog
+ * @param client the client
+ * @return false if the broker could not be reached
+ */
+static bool publish_backlog(mqtt_client_t *client)
+{
+    backlog_sample_t samples[BACKLOG_BATCH];
+    uint32_t boot;
+    uint32_t count = backlog_peek(samples, BACKLOG_BATCH, &boot);
+    if (count == 0) {
+        return true;
+    }
+    int len = snprintf(json, sizeof(json), "{\"boot\":%u,\"now_boot\":%u,\"now_ms\":%u,\"dropped\":%u,\"t_ms\":[",
+        boot, backlog_boot(), systime_ms(), backlog_dropped());
+    for (uint32_t i = 0; i < count && len < (int) sizeof(json); i++) {
+        len += snprintf(&json[len], sizeof(json) - len, "%s%u", i ? "," : "", samples[i].t_ms);
+    }
+    if (len < (int) sizeof(json)) {
+        len += snprintf(&json[len], sizeof(json) - len, "],\"v_in\":[");
+    }
+    for (uint32_t i = 0; i < count && len < (int) sizeof(json); i++) {
+        len += snprintf(&json[len], sizeof(json) - len, "%s%.2f", i ? "," : "", samples[i].v_in / 1000.0f);
+    }
+    if (len < (int) sizeof(json)) {
+        len += snprintf(&json[len], sizeof(json) - len, "],\"v_out\":[");
+    }
+    for (uint32_t i = 0; i < count && len < (int) sizeof(json); i++) {
+        len += snprintf(&json[len], sizeof(json) - len, "%s%.2f", i ? "," : "", samples[i].v_out / 1000.0f);
+    }
+    if (len < (int) sizeof(json)) {
+        len += snprintf(&json[len], sizeof(json) - len, "],\"i_out\":[");
+    }
+    for (uint32_t i = 0; i < count && len < (int) sizeof(json); i++) {
+        len += snprintf(&json[len], sizeof(json) - len, "%s%.3f", i ? "," : "", samples[i].i_out / 1000.0f);
+    }
+    if (len < (int) sizeof(json)) {
+        len += snprintf(&json[len], sizeof(json) - len, "]}");
+    }
+    /** Cannot happen with BACKLOG_BATCH samples, keep them rather than cut */
+    if (len >= (int) sizeof(json) || !publish(client, "backlog", json)) {
+        return false;
+    }
+    backlog_consume();
+    return true;
+}
+#endif // CONFIG_BACKLOG
+
+/**
+ * @brief Add a sample, publishing the batch once full. With the broker gone,
+ *        or samples from that time still to be published, it goes to the
+ *        backlog instead
+ * @param client the client, NULL while not connected
+ * @param t_ms uptime when the sample was taken
+ * @param v_out output voltage in mV
+ * @param i_out output current in mA
+ * @return false if the broker could not be reached
+ */
+static bool add_sample(mqtt_client_t *client, uint32_t t_ms, uint16_t v_out, uint16_t i_out)
+{
+#ifdef CONFIG_BACKLOG
+    if (!client || backlog_pending()) {
+        backlog_sample_t sample = { t_ms, batch.v_in, v_out, i_out };
+        (void) backlog_append(&sample);
+        return true;
+    }
+    batch.t_ms[batch.count] = t_ms;
+#else // CONFIG_BACKLOG
+    (void) t_ms;
+#endif // CONFIG_BACKLOG
+    batch.v_out[batch.count] = v_out;
+    batch.i_out[batch.count] = i_out;
+    if (++batch.count == CONFIG_MQTT_BATCH) {
+        return publish_batch(client);
+    }
+    return true;
+}
+
+/**
+ * @brief Add the samples of a cmd_stream_data frame. A lost frame or a new
+ *        interval, set by /api/events, ends the batch early
+ * @param client the client
+ * @param frame the frame
+ * @return false if the broker could not be reached
+ */
+static bool add_stream_data(mqtt_client_t *client, frame_t *frame)
+{
+    uint8_t cmd, count;
+    uint16_t seq, interval_ms, v_in, v_out, i_out;
+    bool ok = true;
+
+    start_frame_unpacking(frame);
+    UNPACK8(frame, &cmd);
+    UNPACK16(frame, &seq);
+    UNPACK16(frame, &interval_ms);
+    UNPACK16(frame, &v_in);
+    UNPACK8(frame, &count);
+    if (cmd != cmd_stream_data || count > STREAM_MAX_SAMPLES) {
+        return true;
+    }
+    if (batch.count > 0 && (!batch.have_seq || seq != batch.next_seq || interval_ms != batch.interval_ms)) {
+        ok = publish_batch(client);
+    }
+    /** The last sample of the frame was taken about now */
+    uint32_t t_ms = systime_ms() - (count ? count - 1 : 0) * interval_ms;
+    for (uint32_t i = 0; i < count && ok; i++) {
+        if (batch.count == 0) {
+            batch.have_seq = true;
+            batch.seq = seq;
+            batch.interval_ms = interval_ms;
+        }
+        batch.v_in = v_in;
+        UNPACK16(frame, &v_out);
+        UNPACK16(frame, &i_out);
+        ok = add_sample(client, t_ms + i * interval_ms, v_out, i_out);
+    }
+    batch.next_seq = seq + 1;
+    return ok;
+}
+
+/**
+ * @brief Take a sample with cmd_query, for firmware that cannot stream
+ * @param client the client
+ * @return false if the broker could not be reached
+ */
+static bool add_query(mqtt_client_t *client)
+{
+    frame_t frame;
+    uint8_t cmd, status;
+    uint16_t v_in, v_out, i_out;
+
+    set_frame_header(&frame);
+    pack8(&frame, cmd_query);
+    end_frame(&frame);
+    if (!g_uart_comm(&frame)) {
+        return true;
+    }
+    start_frame_unpacking(&frame);
+    UNPACK8(&frame, &cmd);
+    UNPACK8(&frame, &status);
+    UNPACK16(&frame, &v_in);
+    UNPACK16(&frame, &v_out);
+    UNPACK16(&frame, &i_out);
+    if (cmd != (cmd_response | cmd_query) || !status) {
+        return true;
+    }
+    if (batch.count > 0 && batch.have_seq) {
+        if (!publish_batch(client)) {
+            return false;
+        }
+    }
+    batch.have_seq = false;
+    batch.interval_ms = CONFIG_MQTT_INTERVAL_MS;
+    batch.v_in = v_in;
+    return add_sample(client, systime_ms(), v_out, i_out);
+}
+
+/**
+ * @brief Start or stop the stream of the DPS
+ * @param start true to start
+ * @param refused set if the DPS answered but refused
+ * @return true if the DPS accepted
+ */
+static bool stream_control(bool start, bool *refused)
+{
+    frame_t frame;
+    uint8_t cmd, status = 0;
+    set_frame_header(&frame);
+    if (start) {
+        pack8(&frame, cmd_stream_start);
+        pack16(&frame, CONFIG_MQTT_INTERVAL_MS);
+        pack8(&frame, MQTT_STREAM_BATCH);
+    } else {
+        pack8(&frame, cmd_stream_stop);
+    }
+    end_frame(&frame);
+    bool answered = g_uart_comm(&frame);
+    if (answered) {
+        start_frame_unpacking(&frame);
+        UNPACK8(&frame, &cmd);
+        UNPACK8(&frame, &status);
+    }
+    if (refused) {
+        *refused = answered && !status;
+    }
+    return answered && status;
+}
+
+/**
+ * @brief Run the pending command and acknowledge it on <base_topic>/ack
+ * @param client the client
+ * @return false if the broker could not be reached
+ */
+static bool run_command(mqtt_client_t *client)
+{
+    frame_t frame;
+    uint8_t cmd = 0, status = 0, param_status = 0;
+    char ack[40];
+
+    command.pending = false;
+    set_frame_header(&frame);
+    if (strcmp(command.set, "output") == 0) {
+        pack8(&frame, cmd_enable_output);
+        pack8(&frame, atoi(command.value) ? 1 : 0);
+    } else {
+        pack8(&frame, cmd_set_parameters);
+        pack_cstr(&frame, command.set);
+        pack_cstr(&frame, command.value);
+    }
+    end_frame(&frame);
+    if (g_uart_comm(&frame)) {
+        start_frame_unpacking(&frame);
+        UNPACK8(&frame, &cmd);
+        UNPACK8(&frame, &status);
+        if (cmd == (cmd_response | cmd_set_parameters)) {
+            /** The set_param_status_t of the parameter, ps_ok is 0 */
+            UNPACK8(&frame, &param_status);
+        }
+    }
+    bool ok = (cmd & cmd_response) && status == 1 && param_status == 0;
+    snprintf(ack, sizeof(ack), "{\"set\":\"%s\",\"ok\":%s}", command.set, ok ? "true" : "false");
+    return publish(client, "ack", ack);
+}
+
+/**
+ * @brief Called by the client for messages on <base_topic>/set/+
+ * @param md the message
+ */
+static void topic_received(mqtt_message_data_t *md)
+{
+    const char *topic = md->topic->lenstring.data;
+    int topic_len = md->topic->lenstring.len;
+    uint32_t prefix_len = strlen(base_topic) + 5; /** "/set/" */
+    mqtt_message_t *message = md->message;
+
+    if (topic_len <= (int) prefix_len || topic_len - prefix_len >= sizeof(command.set) ||
+        message->payloadlen >= sizeof(command.value)) {
+        return;
+    }
+    memcpy(command.set, &topic[prefix_len], topic_len - prefix_len);
+    command.set[topic_len - prefix_len] = 0;
+    memcpy(command.value, message->payload, message->payloadlen);
+    command.value[message->payloadlen] = 0;
+    command.pending = strcmp(command.set, "voltage") == 0 ||
+                      strcmp(command.set, "current") == 0 ||
+                      strcmp(command.set, "output") == 0;
+}
+
+void mqtt_init(uart_comm_func_t comm_func)
+{
+    g_uart_comm = comm_func;
+    mqtt_queue = xQueueCreate(MQTT_QUEUE_DEPTH, sizeof(frame_t));
+    snprintf(base_topic, sizeof(base_topic), "%s/%08x", CONFIG_MQTT_TOPIC, sdk_system_get_chip_id());
+}
+
+void mqtt_push(frame_t *frame)
+{
+    /** Drop the frame rather than stall the UART task */
+    if ((connected || sampling) && frame->length > 0 && frame->buffer[0] == cmd_stream_data) {
+        (void) xQueueSend(mqtt_queue, (void*) frame, 0);
+    }
+}
+
+/**
+ * @brief Take the next sample, from the stream of the DPS or by polling
+ * @param client the client, NULL while the broker cannot be reached
+ * @param frame buffer for a stream frame
+ * @param wait_ms how long to wait for a stream frame
+ * @return false if the broker could not be reached
+ */
+static bool sample(mqtt_client_t *client, frame_t *frame, uint32_t wait_ms)
+{
+    bool ok = true;
+    bool got_frame = xQueueReceive(mqtt_queue, (void*) frame, wait_ms / portTICK_PERIOD_MS) == pdTRUE;
+    uint32_t now = systime_ms();
+
+    if (got_frame) {
+        ok = add_stream_data(client, frame);
+        sampler.last_sample = now;
+    } else if (sampler.can_stream && (!sampler.streaming || now - sampler.last_sample >= MQTT_STREAM_TIMEOUT_MS)) {
+        /** Not started, stopped by /api/events or the DPS rebooted */
+        bool refused;
+        sampler.streaming = stream_control(true, &refused);
+        if (refused) {
+            /** Older firmware, poll instead */
+            sampler.can_stream = false;
+        }
+        sampler.last_sample = now;
+    } else if (!sampler.can_stream && now - sampler.last_sample >= CONFIG_MQTT_INTERVAL_MS) {
+        ok = add_query(client);
+        sampler.last_sample = now;
+    }
+    return ok;
+}
+
+/**
+ * @brief Wait before reconnecting to the broker, sampling into the backlog
+ * @param frame buffer for a stream frame
+ */
+static void retry_wait(frame_t *frame)
+{
+#ifdef CONFIG_BACKLOG
+    uint32_t start = systime_ms();
+    while (systime_ms() - start < MQTT_RETRY_MS) {
+        (void) sample(NULL, frame, MQTT_POLL_MS);
+    }
+#else // CONFIG_BACKLOG
+    (void) frame;
+    delay_ms(MQTT_RETRY_MS);
+#endif // CONFIG_BACKLOG
+}
+
+void mqtt_task(void *pvParameters)
+{
+    struct mqtt_network network;
+    mqtt_client_t client = mqtt_client_default;
+    mqtt_packet_connect_data_t data = mqtt_packet_connect_data_initializer;
+    char client_id[24];
+    char subscription[sizeof(base_topic) + 8];
+    frame_t frame;
+    (void)pvParameters;
+
+    snprintf(client_id, sizeof(client_id), "dpsproxy-%08x", sdk_system_get_chip_id());
+    snprintf(subscription, sizeof(subscription), "%s/set/+", base_topic);
+    mqtt_network_new(&network);
+#ifdef CONFIG_BACKLOG
+    backlog_init();
+    printf("MQTT: %u samples in the backlog\n", backlog_pending());
+    sampling = true;
+#endif // CONFIG_BACKLOG
+
+    while (1) {
+        if (mqtt_network_connect(&network, CONFIG_MQTT_BROKER, CONFIG_MQTT_PORT)) {
+            retry_wait(&frame);
+            continue;
+        }
+        mqtt_client_new(&client, &network, MQTT_COMMAND_TIMEOUT_MS, mqtt_buf, sizeof(mqtt_buf), mqtt_readbuf, sizeof(mqtt_readbuf));
+        data.willFlag = 0;
+        data.MQTTVersion = 3;
+        data.clientID.cstring = client_id;
+        data.keepAliveInterval = MQTT_KEEPALIVE_S;
+        data.cleansession = 1;
+        if (mqtt_connect(&client, &data) != MQTT_SUCCESS ||
+            mqtt_subscribe(&client, subscription, CONFIG_MQTT_QOS, topic_received) != MQTT_SUCCESS) {
+            mqtt_network_disconnect(&network);
+            retry_wait(&frame);
+            continue;
+        }
+        printf("MQTT: publishing on %s\n", base_topic);
+
+        bool ok = true;
+#ifndef CONFIG_BACKLOG
+        /** Without a backlog sampling starts over on every connection */
+        sampler.streaming = false;
+        sampler.can_stream = true;
+        sampler.last_sample = 0;
+        batch.count = 0;
+        xQueueReset(mqtt_queue);
+#endif // CONFIG_BACKLOG
+        connected = true;
+
+        while (ok) {
+#ifdef CONFIG_BACKLOG
+            /** Drain the backlog as fast as the broker takes it */
+            ok = sample(&client, &frame, backlog_pending() ? 0 : MQTT_POLL_MS);
+            if (ok && backlog_pending()) {
+                ok = publish_backlog(&client);
+            }
+#else // CONFIG_BACKLOG
+            ok = sample(&client, &frame, MQTT_POLL_MS);
+#endif // CONFIG_BACKLOG
+            if (ok && command.pending) {
+                ok = run_command(&client);
+            }
+            if (ok) {
+                ok = mqtt_yield(&client, 1) != MQTT_DISCONNECTED;
+            }
+        }
+
+        connected = false;
+#ifdef CONFIG_BACKLOG
+        /** Keep the stream going for the backlog */
+        batch_to_backlog();
+#else // CONFIG_BACKLOG
+        if (sampler.streaming) {
+            (void) stream_control(false, NULL);
+        }
+#endif // CONFIG_BACKLOG
+        printf("MQTT: disconnected\n");
+        mqtt_network_disconnect(&network);
+        retry_wait(&frame);
+    }
+}
+
+#endif // CONFIG_MQTT
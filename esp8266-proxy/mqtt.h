@@ -0,0 +1,119 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __MQTT_H__
+#define __MQTT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "uframe.h"
+#include "webserver.h"
+
+/**
+ * MQTT telemetry, enabled with MQTT=1 in the Makefile. The proxy connects to
+ * CONFIG_MQTT_BROKER and publishes CONFIG_MQTT_BATCH samples at a time as one
+ * JSON message on <topic>/telemetry, where <topic> is CONFIG_MQTT_TOPIC
+ * followed by the chip id of the ESP:
+ *
+ *  {"seq":12,"interval_ms":1000,"v_in":20.10,"v_out":[5.00,...],"i_out":[0.120,...]}
+ *
+ * Samples come from the stream of the DPS (cmd_stream_start). Firmware
+ * refusing to stream is polled with cmd_query instead, answered from the
+ * response cache of the proxy when another client just asked, and <seq> is
+ * then left out. The stream is shared with /api/events, whichever started
+ * it last picks the interval and the other one restarts it if stopped.
+ *
+ * Commands are taken on <topic>/set/voltage and <topic>/set/current in mV
+ * and mA, and on <topic>/set/output as 0 or 1. Each is answered on
+ * <topic>/ack as {"set":"voltage","ok":true}. Messages are published with
+ * CONFIG_MQTT_QOS and the command topics are subscribed with the same QoS.
+ *
+ * With CONFIG_BACKLOG the DPS is sampled while the broker cannot be reached
+ * and the samples are kept in flash, see backlog.h. Once connected they are
+ * published oldest first on <topic>/backlog, BACKLOG_BATCH at a time, each
+ * with the uptime of the proxy in ms when it was taken:
+ *
+ *  {"boot":7,"now_boot":8,"now_ms":5000,"dropped":0,"t_ms":[...],"v_in":[...],"v_out":[...],"i_out":[...]}
+ *
+ * <boot> numbers the boot the samples were taken in, when it equals
+ * <now_boot> a sample was taken <now_ms> - t_ms ms before the message.
+ * <dropped> counts samples lost to a full ring since boot. Live telemetry
+ * resumes once the backlog has been published.
+ */
+
+#ifndef CONFIG_MQTT_BROKER
+#define CONFIG_MQTT_BROKER "mqtt.local"
+#endif
+
+#ifndef CONFIG_MQTT_PORT
+#define CONFIG_MQTT_PORT  (1883)
+#endif
+
+#ifndef CONFIG_MQTT_TOPIC
+#define CONFIG_MQTT_TOPIC "opendps"
+#endif
+
+/** Samples per telemetry message */
+#ifndef CONFIG_MQTT_BATCH
+#define CONFIG_MQTT_BATCH  (10)
+#endif
+
+/** Sample interval asked for */
+#ifndef CONFIG_MQTT_INTERVAL_MS
+#define CONFIG_MQTT_INTERVAL_MS  (1000)
+#endif
+
+/** 0, 1 or 2 */
+#ifndef CONFIG_MQTT_QOS
+#define CONFIG_MQTT_QOS  (0)
+#endif
+
+/** Largest batch, bounded by the MQTT send buffer */
+#define MQTT_MAX_BATCH  (24)
+
+#if CONFIG_MQTT_BATCH < 1 || CONFIG_MQTT_BATCH > MQTT_MAX_BATCH
+ #error "CONFIG_MQTT_BATCH must be 1..MQTT_MAX_BATCH"
+#endif
+
+/**
+ * @brief Initialize the MQTT client
+ * @param comm_func Function to use for UART communication with DPS
+ */
+void mqtt_init(uart_comm_func_t comm_func);
+
+/**
+ * @brief Hand a frame the DPS sent on its own to the MQTT task
+ * Called from the UART task, the frame is copied and never blocks
+ * @param frame unescaped payload of the frame
+ */
+void mqtt_push(frame_t *frame);
+
+/**
+ * @brief MQTT task - call this from FreeRTOS, it keeps reconnecting to
+ *        the broker until wifi is up
+ * @param pvParameters unused
+ */
+void mqtt_task(void *pvParameters);
+
+#endif // __MQTT_H__
@@ -0,0 +1,224 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <esp8266.h>
+#include <esp/uart.h>
+#include <esp/interrupts.h>
+#include <common_macros.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <queue.h>
+#include "uframe.h"
+#include "uartrx.h"
+
+/** RX FIFO level that raises the interrupt, of 128 bytes */
+#define RX_FIFO_THRESHOLD  (64)
+
+/** Idle byte times before the rest of the FIFO is handed over */
+#define RX_TIMEOUT_THRESHOLD  (2)
+
+/** A frame or an error passed from the ISR to uart_rx_get() */
+typedef struct {
+    int8_t slot;     /** -1 for errors */
+    int16_t length;  /** Length of the frame or a negative uart_rx_status_t */
+} rx_item_t;
+
+static uint8_t slots[UART_RX_SLOTS][MAX_FRAME_LENGTH];
+
+/** Slot indices free for the ISR */
+static QueueHandle_t free_slots;
+/** Frames and errors for uart_rx_get(), room for one error past the slots */
+static QueueHandle_t ready;
+
+/** Owned by the ISR */
+static int8_t cur_slot = -1;
+static uint32_t cur_size;
+static bool in_frame;
+
+/** Written by the ISR only */
+static volatile uart_rx_stats_t stats;
+
+/**
+  * @brief Queue an error and drop the frame being assembled, its slot is
+  *        reused for the next one
+  * @param status the error
+  * @param woken set if a task waiting for the error should run
+  * @retval None
+  */
+static IRAM void rx_error(uart_rx_status_t status, BaseType_t *woken)
+{
+    rx_item_t item = { .slot = -1, .length = status };
+    in_frame = false;
+    if (status == uart_rx_err_length) {
+        stats.err_length++;
+    } else if (status == uart_rx_err_overflow) {
+        stats.err_overflow++;
+    } else {
+        stats.err_framing++;
+    }
+    (void) xQueueSendFromISR(ready, &item, woken);
+}
+
+/**
+  * @brief Add a byte to the frame being assembled
+  * @param ch the byte
+  * @param woken set if a task waiting for the frame should run
+  * @retval None
+  */
+static IRAM void rx_byte(uint8_t ch, BaseType_t *woken)
+{
+    if (ch == _SOF) {
+        uint8_t slot;
+        if (cur_slot < 0) {
+            if (pdPASS != xQueueReceiveFromISR(free_slots, &slot, NULL)) {
+                rx_error(uart_rx_err_overflow, woken);
+                return;
+            }
+            cur_slot = slot;
+        }
+        cur_size = 0;
+        in_frame = true;
+    }
+    if (!in_frame) {
+        return;
+    }
+    if (cur_size == MAX_FRAME_LENGTH) {
+        rx_error(uart_rx_err_length, woken);
+        return;
+    }
+    slots[cur_slot][cur_size++] = ch;
+    if (ch == _EOF) {
+        rx_item_t item = { .slot = cur_slot, .length = cur_size };
+        in_frame = false;
+        stats.frames++;
+        if (pdPASS == xQueueSendFromISR(ready, &item, woken)) {
+            cur_slot = -1;
+        } /** else the queue is full of errors, the slot is reused */
+    }
+}
+
+/**
+  * @brief UART 0 interrupt, drains the RX FIFO into the frame slots
+  * @param arg unused
+  * @retval None
+  */
+static IRAM void uart_rx_isr(void *arg)
+{
+    (void) arg;
+    BaseType_t woken = pdFALSE;
+    uint32_t status = UART(0).INT_STATUS;
+    if (status & UART_INT_STATUS_RXFIFO_OVERFLOW) {
+        rx_error(uart_rx_err_overflow, &woken);
+    } else if (status & UART_INT_STATUS_FRAMING_ERR) {
+        rx_error(uart_rx_err_framing, &woken);
+    }
+    while (FIELD2VAL(UART_STATUS_RXFIFO_COUNT, UART(0).STATUS)) {
+        rx_byte(UART(0).FIFO & 0xff, &woken);
+    }
+    UART(0).INT_CLEAR = status;
+    if (woken) {
+        portYIELD();
+    }
+}
+
+/**
+  * @brief Convert a timeout to ticks, rounding up so short waits still block
+  * @param ms the timeout
+  * @retval number of ticks
+  */
+static TickType_t ms_to_ticks(uint32_t ms)
+{
+    return (ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+}
+
+void uart_rx_init(void)
+{
+    free_slots = xQueueCreate(UART_RX_SLOTS, sizeof(uint8_t));
+    ready = xQueueCreate(UART_RX_SLOTS + 1, sizeof(rx_item_t));
+    for (uint8_t i = 0; i < UART_RX_SLOTS; i++) {
+        (void) xQueueSend(free_slots, &i, 0);
+    }
+    uart_clear_rxfifo(0);
+    UART(0).CONF1 = SET_FIELD(UART(0).CONF1, UART_CONF1_RXFIFO_FULL_THRESHOLD, RX_FIFO_THRESHOLD);
+    UART(0).CONF1 = SET_FIELD(UART(0).CONF1, UART_CONF1_RX_TIMEOUT_THRESHOLD, RX_TIMEOUT_THRESHOLD) |
+                    UART_CONF1_RX_TIMEOUT_ENABLE;
+    UART(0).INT_CLEAR = 0x1ff;
+    UART(0).INT_ENABLE = UART_INT_ENABLE_RXFIFO_FULL | UART_INT_ENABLE_RXFIFO_TIMEOUT |
+                         UART_INT_ENABLE_RXFIFO_OVERFLOW | UART_INT_ENABLE_FRAMING_ERR;
+    _xt_isr_attach(INUM_UART, uart_rx_isr, NULL);
+    _xt_isr_unmask(BIT(INUM_UART));
+}
+
+int32_t uart_rx_get(uint8_t *buffer, uint32_t buffer_size, uint32_t timeout_ms)
+{
+    rx_item_t item;
+    if (pdPASS != xQueueReceive(ready, &item, ms_to_ticks(timeout_ms))) {
+        return uart_rx_timeout;
+    }
+    if (item.slot < 0) {
+        return item.length;
+    }
+    int32_t length = item.length;
+    if ((uint32_t) length <= buffer_size) {
+        memcpy(buffer, slots[item.slot], length);
+    } else {
+        length = uart_rx_err_length;
+    }
+    uint8_t slot = item.slot;
+    (void) xQueueSend(free_slots, &slot, 0);
+    return length;
+}
+
+bool uart_rx_wait(uint32_t timeout_ms)
+{
+    rx_item_t item;
+    return pdPASS == xQueuePeek(ready, &item, ms_to_ticks(timeout_ms));
+}
+
+void uart_rx_flush(void)
+{
+    rx_item_t item;
+    _xt_isr_mask(BIT(INUM_UART));
+    in_frame = false;
+    uart_clear_rxfifo(0);
+    UART(0).INT_CLEAR = 0x1ff;
+    while (pdPASS == xQueueReceive(ready, &item, 0)) {
+        if (item.slot >= 0) {
+            uint8_t slot = item.slot;
+            (void) xQueueSend(free_slots, &slot, 0);
+        }
+    }
+    _xt_isr_unmask(BIT(INUM_UART));
+}
+
+void uart_rx_stats(uart_rx_stats_t *out)
+{
+    /** Word reads are atomic, a count may be one behind the others */
+    out->frames = stats.frames;
+    out->err_length = stats.err_length;
+    out->err_overflow = stats.err_overflow;
+    out->err_framing = stats.err_framing;
+}
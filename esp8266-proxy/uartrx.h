@@ -0,0 +1,93 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __UARTRX_H__
+#define __UARTRX_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Frames from the DPS are assembled in the UART 0 RX interrupt, from _SOF to
+ * _EOF, into one of UART_RX_SLOTS buffers and handed to uart_comm_task
+ * through a queue as soon as the _EOF arrives. Bytes outside a frame, like
+ * boot messages, are dropped. A frame too long for a buffer, an RX FIFO
+ * overflow or a framing error is queued as an error right away so the
+ * waiting request fails without running into its timeout.
+ */
+
+/** Frames received but not yet picked up by uart_rx_get() */
+#define UART_RX_SLOTS  (4)
+
+/** Errors returned by uart_rx_get() */
+typedef enum {
+    uart_rx_timeout = 0,
+    uart_rx_err_length = -1,    /** The frame did not fit in a buffer */
+    uart_rx_err_overflow = -2,  /** The RX FIFO or all slots were full */
+    uart_rx_err_framing = -3,   /** Bad stop bit, wrong baud rate or noise */
+} uart_rx_status_t;
+
+/** Frames and errors seen by the RX interrupt since boot */
+typedef struct {
+    uint32_t frames;
+    uint32_t err_length;
+    uint32_t err_overflow;
+    uint32_t err_framing;
+} uart_rx_stats_t;
+
+/**
+ * @brief Take over the UART 0 RX interrupt, call once before the scheduler
+ *        starts
+ */
+void uart_rx_init(void);
+
+/**
+ * @brief Wait for the next frame from the DPS
+ * @param buffer where the frame (SOF..EOF) is copied
+ * @param buffer_size size of buffer, at least MAX_FRAME_LENGTH
+ * @param timeout_ms how long to wait, 0 to only check
+ * @retval length of the frame, uart_rx_timeout or a negative uart_rx_status_t
+ */
+int32_t uart_rx_get(uint8_t *buffer, uint32_t buffer_size, uint32_t timeout_ms);
+
+/**
+ * @brief Wait until a frame or error is ready for uart_rx_get()
+ * @param timeout_ms how long to wait at most
+ * @retval true if uart_rx_get() will not block
+ */
+bool uart_rx_wait(uint32_t timeout_ms);
+
+/**
+ * @brief Discard the frame being assembled and everything queued, eg. after
+ *        a baud rate change
+ */
+void uart_rx_flush(void);
+
+/**
+ * @brief Get the frame and error counters of the RX interrupt
+ * @param stats filled in
+ */
+void uart_rx_stats(uart_rx_stats_t *stats);
+
+#endif // __UARTRX_H__
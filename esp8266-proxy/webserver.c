@@ -27,15 +27,24 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <strings.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <FreeRTOS.h>
 #include <task.h>
+#include <queue.h>
+#include <semphr.h>
 #include <lwip/api.h>
 #include <lwip/tcp.h>
 #include "webserver.h"
 #include "protocol.h"
 #include "uframe.h"
+#include "fwstore.h"
+#include "uartrx.h"
+#include "linkstats.h"
+#include "capture.h"
+#include "index_html.h"
 
 /** User friendly FreeRTOS delay macro */
 #define delay_ms(ms) vTaskDelay(ms / portTICK_PERIOD_MS)
@@ -46,136 +55,150 @@ static uart_comm_func_t g_uart_comm = NULL;
 /** Maximum request size */
 #define MAX_REQUEST_SIZE 512
 
-/** Maximum response size */
-#define MAX_RESPONSE_SIZE 2048
-
-/** Embedded web page HTML */
-static const char index_html[] =
-"<!DOCTYPE html>"
-"<html>"
-"<head>"
-"<meta charset=\"UTF-8\">"
-"<meta name=\"viewport\" content=\"width=device-width,initial-scale=1\">"
-"<title>OpenDPS</title>"
-"<style>"
-"*{box-sizing:border-box;margin:0;padding:0}"
-"body{font-family:Arial,sans-serif;background:#1a1a2e;color:#eee;min-height:100vh;padding:20px}"
-".container{max-width:400px;margin:0 auto}"
-"h1{text-align:center;color:#0f0;margin-bottom:20px;font-size:24px}"
-".card{background:#16213e;border-radius:10px;padding:20px;margin-bottom:15px}"
-".status{display:grid;grid-template-columns:1fr 1fr;gap:10px}"
-".stat{text-align:center;padding:15px;background:#0f3460;border-radius:8px}"
-".stat-label{font-size:12px;color:#888;margin-bottom:5px}"
-".stat-value{font-size:24px;font-weight:bold}"
-".stat-value.voltage{color:#0f0}"
-".stat-value.current{color:#ff0}"
-".stat-value.power{color:#f0f}"
-".stat-value.input{color:#0ff}"
-".controls{margin-top:15px}"
-".control-group{margin-bottom:15px}"
-".control-group label{display:block;margin-bottom:5px;color:#888;font-size:14px}"
-".control-row{display:flex;gap:10px}"
-".control-row input{flex:1;padding:10px;border:none;border-radius:5px;background:#0f3460;color:#fff;font-size:16px}"
-".control-row button{padding:10px 20px;border:none;border-radius:5px;cursor:pointer;font-size:14px;font-weight:bold}"
-".btn-set{background:#0f0;color:#000}"
-".btn-on{background:#0f0;color:#000;width:100%;padding:15px;font-size:18px}"
-".btn-off{background:#f00;color:#fff;width:100%;padding:15px;font-size:18px}"
-".btn-set:hover{background:#0c0}"
-".btn-on:hover{background:#0c0}"
-".btn-off:hover{background:#c00}"
-".output-status{text-align:center;padding:10px;border-radius:5px;margin-bottom:10px;font-weight:bold}"
-".output-on{background:#0f03;border:2px solid #0f0;color:#0f0}"
-".output-off{background:#f003;border:2px solid #f00;color:#f00}"
-".error{color:#f00;text-align:center;padding:10px}"
-"</style>"
-"</head>"
-"<body>"
-"<div class=\"container\">"
-"<h1>OpenDPS Control</h1>"
-"<div class=\"card\">"
-"<div class=\"status\">"
-"<div class=\"stat\"><div class=\"stat-label\">Output Voltage</div><div class=\"stat-value voltage\" id=\"vout\">--</div></div>"
-"<div class=\"stat\"><div class=\"stat-label\">Output Current</div><div class=\"stat-value current\" id=\"iout\">--</div></div>"
-"<div class=\"stat\"><div class=\"stat-label\">Input Voltage</div><div class=\"stat-value input\" id=\"vin\">--</div></div>"
-"<div class=\"stat\"><div class=\"stat-label\">Power</div><div class=\"stat-value power\" id=\"pout\">--</div></div>"
-"</div>"
-"</div>"
-"<div class=\"card\">"
-"<div id=\"output-status\" class=\"output-status output-off\">OUTPUT OFF</div>"
-"<button id=\"output-btn\" class=\"btn-on\" onclick=\"toggleOutput()\">ENABLE OUTPUT</button>"
-"</div>"
-"<div class=\"card controls\">"
-"<div class=\"control-group\">"
-"<label>Voltage Setpoint (V)</label>"
-"<div class=\"control-row\">"
-"<input type=\"number\" id=\"voltage\" step=\"0.01\" min=\"0\" max=\"50\" placeholder=\"5.00\">"
-"<button class=\"btn-set\" onclick=\"setVoltage()\">SET</button>"
-"</div>"
-"</div>"
-"<div class=\"control-group\">"
-"<label>Current Limit (A)</label>"
-"<div class=\"control-row\">"
-"<input type=\"number\" id=\"current\" step=\"0.001\" min=\"0\" max=\"5\" placeholder=\"1.000\">"
-"<button class=\"btn-set\" onclick=\"setCurrent()\">SET</button>"
-"</div>"
-"</div>"
-"</div>"
-"<div id=\"error\" class=\"error\"></div>"
-"</div>"
-"<script>"
-"var outputEnabled=false;"
-"function updateStatus(){"
-"fetch('/api/status').then(r=>r.json()).then(d=>{"
-"document.getElementById('vout').textContent=d.v_out.toFixed(2)+'V';"
-"document.getElementById('iout').textContent=d.i_out.toFixed(3)+'A';"
-"document.getElementById('vin').textContent=d.v_in.toFixed(2)+'V';"
-"document.getElementById('pout').textContent=(d.v_out*d.i_out).toFixed(2)+'W';"
-"outputEnabled=d.output_enabled;"
-"var btn=document.getElementById('output-btn');"
-"var st=document.getElementById('output-status');"
-"if(outputEnabled){"
-"btn.className='btn-off';btn.textContent='DISABLE OUTPUT';"
-"st.className='output-status output-on';st.textContent='OUTPUT ON';"
-"}else{"
-"btn.className='btn-on';btn.textContent='ENABLE OUTPUT';"
-"st.className='output-status output-off';st.textContent='OUTPUT OFF';"
-"}"
-"document.getElementById('error').textContent='';"
-"}).catch(e=>{document.getElementById('error').textContent='Connection error';});"
-"}"
-"function setVoltage(){"
-"var v=parseFloat(document.getElementById('voltage').value);"
-"if(isNaN(v)){alert('Invalid voltage');return;}"
-"fetch('/api/voltage',{method:'POST',body:v.toFixed(2)}).then(r=>r.json()).then(d=>{"
-"if(!d.success)document.getElementById('error').textContent='Failed to set voltage';"
-"else updateStatus();"
-"}).catch(e=>{document.getElementById('error').textContent='Connection error';});"
-"}"
-"function setCurrent(){"
-"var i=parseFloat(document.getElementById('current').value);"
-"if(isNaN(i)){alert('Invalid current');return;}"
-"fetch('/api/current',{method:'POST',body:i.toFixed(3)}).then(r=>r.json()).then(d=>{"
-"if(!d.success)document.getElementById('error').textContent='Failed to set current';"
-"else updateStatus();"
-"}).catch(e=>{document.getElementById('error').textContent='Connection error';});"
-"}"
-"function toggleOutput(){"
-"fetch('/api/output',{method:'POST',body:outputEnabled?'0':'1'}).then(r=>r.json()).then(d=>{"
-"if(!d.success)document.getElementById('error').textContent='Failed to toggle output';"
-"else updateStatus();"
-"}).catch(e=>{document.getElementById('error').textContent='Connection error';});"
-"}"
-"updateStatus();"
-"setInterval(updateStatus,1000);"
-"</script>"
-"</body>"
-"</html>";
-
-/** HTTP response headers */
-static const char http_html_header[] = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nConnection: close\r\n\r\n";
-static const char http_json_header[] = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nAccess-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n";
-static const char http_404[] = "HTTP/1.1 404 Not Found\r\nConnection: close\r\n\r\nNot Found";
-static const char http_options[] = "HTTP/1.1 200 OK\r\nAccess-Control-Allow-Origin: *\r\nAccess-Control-Allow-Methods: GET, POST, OPTIONS\r\nAccess-Control-Allow-Headers: Content-Type\r\nConnection: close\r\n\r\n";
+/** Responses are written in chunks of this size as they are produced, about
+ *  one TCP segment */
+#define OUT_CHUNK_SIZE 512
+
+/** Maximum number of browsers connected to /api/events */
+#define MAX_EVENT_CLIENTS 2
+
+/** Sample interval and batch size requested from the DPS for /api/events */
+#define EVENT_INTERVAL_MS 100
+#define EVENT_BATCH 5
+
+/** Restart streaming if no samples arrived for this long, another client
+  * may have stopped it or the DPS rebooted */
+#define EVENT_STREAM_TIMEOUT_MS 2000
+
+/** Poll interval when the DPS does not support streaming */
+#define EVENT_POLL_MS 1000
+
+/** Idle connections get a comment this often, finds browsers that left */
+#define EVENT_KEEPALIVE_MS 15000
+
+/** An upload stalling this long is abandoned */
+#define UPLOAD_TIMEOUT_MS 5000
+
+/** Number of frames buffered between the UART task and the event task */
+#define EVENT_QUEUE_DEPTH 4
+
+/** Browsers listening on /api/events, protected by event_mutex */
+static struct netconn *event_clients[MAX_EVENT_CLIENTS];
+static volatile uint32_t num_event_clients;
+static SemaphoreHandle_t event_mutex;
+
+/** Frames from webserver_push() */
+static QueueHandle_t event_queue;
+
+/** Connections kept open between requests, polled by webserver_task() */
+#define MAX_KEEPALIVE_CLIENTS 3
+
+/** A kept connection idle for this long is closed */
+#define KEEPALIVE_TIMEOUT_MS 10000
+
+/** Requests served on one connection before it is closed */
+#define KEEPALIVE_MAX_REQUESTS 100
+
+/** Accept timeout while connections are kept, the poll interval of idle
+ *  ones */
+#define KEEPALIVE_POLL_MS 10
+
+/** Time allowed for a request to arrive on a new connection */
+#define REQUEST_TIMEOUT_MS 2000
+
+/** What to do with a connection once a request has been served */
+typedef enum {
+    conn_close,        /** Close it */
+    conn_keep_alive,   /** Wait for the next request */
+    conn_handed_over,  /** Owned by the event task */
+} conn_next_t;
+
+/** A connection waiting for its next request, only used by the webserver
+ *  task */
+typedef struct {
+    struct netconn *conn;
+    uint32_t requests;  /** Requests served */
+    uint32_t last_ms;   /** When the last one was */
+} keepalive_t;
+
+static keepalive_t keepalive_clients[MAX_KEEPALIVE_CLIENTS];
+
+/** How often the metrics are refreshed from the DPS */
+#define METRICS_REFRESH_MS 2000
+
+/** Refreshing stops when /metrics has not been scraped for this long */
+#define METRICS_IDLE_MS 60000
+
+/** Event queues and probes kept, as reported by cmd_event_stats and
+ *  cmd_perf_report */
+#define METRICS_MAX_QUEUES 4
+#define METRICS_MAX_PROBES 6
+
+/** Counters of the cmd_link_stats response, in its order */
+#define LINK_COUNTERS 11
+static const char *dps_link_names[LINK_COUNTERS] = {
+    "frames", "crc", "length", "aborted", "rejected", "tx_dropped", "timeouts", "overrun", "noise", "rx_dropped", "events"
+};
+
+/** Counters of linkstats.h, in link_counter_t order */
+static const char *proxy_link_names[link_counter_count] = { "requests", "timeouts", "garbled", "retries" };
+
+/** The latest answers of the DPS served on /metrics, so scrapes never wait
+ *  for the UART. Written by the event task, protected by metrics_mutex */
+typedef struct {
+    uint32_t updated_ms;    /** When the DPS last answered cmd_query */
+    uint32_t failures;      /** Refreshes the DPS did not answer */
+    bool have_query;
+    uint16_t v_in, v_out, i_out;
+    uint8_t output_enabled, temp_shutdown;
+    int16_t temp[2];        /** In 1/10 degree, INVALID_TEMPERATURE if missing */
+    bool have_energy;
+    uint32_t charge_uah, energy_uwh, runtime_ms;
+    bool have_load;
+    uint16_t idle_permille, isr_permille, isr_max_us;
+    uint32_t isr_calls, isr_overruns;
+    uint8_t num_queues;
+    struct {
+        uint32_t drops;
+        uint16_t peak, size;
+    } queues[METRICS_MAX_QUEUES];
+    uint32_t clock_hz;
+    uint8_t num_probes;
+    struct {
+        uint32_t calls, min, max, mean;
+    } probes[METRICS_MAX_PROBES];
+    bool have_link;
+    uint32_t link[LINK_COUNTERS];
+} metrics_t;
+static metrics_t metrics;
+static SemaphoreHandle_t metrics_mutex;
+
+/** When /metrics was last scraped, 0 if never */
+static volatile uint32_t metrics_scraped_ms;
+
+/** Status lines and headers of the responses, send_response() and
+ *  out_begin() add the rest. The page is only served gzipped, every browser accepts it */
+static const char http_html[] = "200 OK\r\nContent-Type: text/html\r\nContent-Encoding: gzip";
+static const char http_json[] = "200 OK\r\nContent-Type: application/json\r\nAccess-Control-Allow-Origin: *";
+static const char http_404[] = "404 Not Found";
+static const char http_503[] = "503 Service Unavailable";
+static const char http_options[] = "200 OK\r\nAccess-Control-Allow-Origin: *\r\nAccess-Control-Allow-Methods: GET, POST, OPTIONS\r\nAccess-Control-Allow-Headers: Content-Type";
+static const char http_metrics[] = "200 OK\r\nContent-Type: text/plain; version=0.0.4";
+static const char http_text[] = "200 OK\r\nContent-Type: text/plain\r\nAccess-Control-Allow-Origin: *";
+
+/** Complete headers of the responses streamed until the connection closes */
+static const char http_sse_header[] = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nAccess-Control-Allow-Origin: *\r\n\r\nretry: 2000\n\n";
+
+/** A response body written to the connection in chunks while it is being
+ *  produced, see out_begin(). Kept connections get Transfer-Encoding:
+ *  chunked, others end the body by closing */
+typedef struct {
+    struct netconn *conn;
+    bool chunked;
+    bool failed;    /** A write failed, the rest is dropped */
+    size_t len;
+    char buf[OUT_CHUNK_SIZE];
+} http_out_t;
 
 /**
  * @brief Create a query frame to get DPS status
@@ -215,6 +238,32 @@ static void create_enable_output_frame(frame_t *frame, uint8_t enable)
     end_frame(frame);
 }
 
+/**
+ * @brief Create a stream start frame
+ * @param frame Output frame
+ * @param interval_ms Sample interval
+ * @param batch Samples per cmd_stream_data frame
+ */
+static void create_stream_start_frame(frame_t *frame, uint16_t interval_ms, uint8_t batch)
+{
+    set_frame_header(frame);
+    pack8(frame, cmd_stream_start);
+    pack16(frame, interval_ms);
+    pack8(frame, batch);
+    end_frame(frame);
+}
+
+/**
+ * @brief Create a stream stop frame
+ * @param frame Output frame
+ */
+static void create_stream_stop_frame(frame_t *frame)
+{
+    set_frame_header(frame);
+    pack8(frame, cmd_stream_stop);
+    end_frame(frame);
+}
+
 /**
  * @brief Parse query response and format as JSON
  * @param frame Response frame from DPS
@@ -257,6 +306,50 @@ static bool parse_query_response(frame_t *frame, char *json_buf, size_t buf_size
     return true;
 }
 
+/**
+ * @brief Format a cmd_stream_data frame as JSON
+ * @param frame Frame from the DPS
+ * @param json_buf Output buffer for JSON
+ * @param buf_size Size of output buffer
+ * @return true on success
+ */
+static bool parse_stream_data(frame_t *frame, char *json_buf, size_t buf_size)
+{
+    uint8_t cmd, count;
+    uint16_t seq, interval_ms, v_in, v_out[STREAM_MAX_SAMPLES], i_out[STREAM_MAX_SAMPLES];
+
+    start_frame_unpacking(frame);
+    UNPACK8(frame, &cmd);
+    UNPACK16(frame, &seq);
+    UNPACK16(frame, &interval_ms);
+    UNPACK16(frame, &v_in);
+    UNPACK8(frame, &count);
+    if (cmd != cmd_stream_data || count > STREAM_MAX_SAMPLES) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        UNPACK16(frame, &v_out[i]);
+        UNPACK16(frame, &i_out[i]);
+    }
+
+    int len = snprintf(json_buf, buf_size,
+        "{\"seq\":%u,\"interval_ms\":%u,\"v_in\":%.2f,\"v_out\":[",
+        seq, interval_ms, v_in / 1000.0f);
+    for (uint32_t i = 0; i < count && len < (int) buf_size; i++) {
+        len += snprintf(&json_buf[len], buf_size - len, "%s%.2f", i ? "," : "", v_out[i] / 1000.0f);
+    }
+    if (len < (int) buf_size) {
+        len += snprintf(&json_buf[len], buf_size - len, "],\"i_out\":[");
+    }
+    for (uint32_t i = 0; i < count && len < (int) buf_size; i++) {
+        len += snprintf(&json_buf[len], buf_size - len, "%s%.3f", i ? "," : "", i_out[i] / 1000.0f);
+    }
+    if (len < (int) buf_size) {
+        len += snprintf(&json_buf[len], buf_size - len, "]}");
+    }
+    return len < (int) buf_size;
+}
+
 /**
  * @brief Parse simple response (for set commands)
  * @param frame Response frame from DPS
@@ -284,23 +377,622 @@ static char* find_body(char *request)
 }
 
 /**
- * @brief Handle incoming HTTP request
+ * @brief Get the Content-Length of a request
+ * @param request the request, headers NUL terminated
+ * @return the length or -1 if missing
  */
-static void handle_request(struct netconn *conn)
+static int32_t content_length(const char *request)
+{
+    for (const char *line = strstr(request, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+            return atoi(line + 17);
+        }
+        if (line[2] == '\r') {
+            break; /** End of headers */
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Receive the firmware image POSTed to /api/upgrade into the
+ * firmware store, uart_comm_task takes it from there
+ * @param conn the connection
+ * @param inbuf the first part of the request, headers included
+ * @return true if the image was stored and checked
+ */
+static bool receive_upgrade(struct netconn *conn, struct netbuf *inbuf)
 {
-    struct netbuf *inbuf;
     char *buf;
     u16_t buflen;
-    err_t err;
-    char response[MAX_RESPONSE_SIZE];
+    char headers[MAX_REQUEST_SIZE];
+    netbuf_data(inbuf, (void**)&buf, &buflen);
+    /** The headers must come in the first segment, the body is binary */
+    uint32_t n = buflen < sizeof(headers) - 1 ? buflen : sizeof(headers) - 1;
+    memcpy(headers, buf, n);
+    headers[n] = '\0';
+    char *body = find_body(headers);
+    int32_t length = content_length(headers);
+    if (!body || length <= 0 || !fwstore_begin(length)) {
+        return false;
+    }
+    uint32_t received = 0;
+    uint32_t skip = body - headers;
+    bool ok = true;
+    struct netbuf *nb = inbuf;
+    netconn_set_recvtimeout(conn, UPLOAD_TIMEOUT_MS);
+    while (1) {
+        do {
+            netbuf_data(nb, (void**)&buf, &buflen);
+            if (skip < buflen) {
+                ok = fwstore_append((uint8_t*) buf + skip, buflen - skip);
+                received += buflen - skip;
+                skip = 0;
+            } else {
+                skip -= buflen;
+            }
+        } while (ok && netbuf_next(nb) >= 0);
+        if (nb != inbuf) {
+            netbuf_delete(nb);
+        }
+        if (!ok || received >= (uint32_t) length || netconn_recv(conn, &nb) != ERR_OK) {
+            break;
+        }
+    }
+    /** Fails a short upload too */
+    return ok && fwstore_end();
+}
 
-    err = netconn_recv(conn, &inbuf);
-    if (err != ERR_OK) {
+/**
+ * @brief Send the buffered part of the response body, as one chunk if the
+ *        response is chunked
+ * @param out the response
+ */
+static void out_flush(http_out_t *out)
+{
+    if (out->len && !out->failed) {
+        err_t err;
+        if (out->chunked) {
+            char size[12];
+            snprintf(size, sizeof(size), "%x\r\n", (unsigned) out->len);
+            /** NETCONN_MORE lets lwIP put the chunk in one segment */
+            err = netconn_write_partly(out->conn, size, strlen(size), NETCONN_COPY | NETCONN_MORE, NULL);
+            if (err == ERR_OK) {
+                err = netconn_write_partly(out->conn, out->buf, out->len, NETCONN_COPY | NETCONN_MORE, NULL);
+            }
+            if (err == ERR_OK) {
+                err = netconn_write(out->conn, "\r\n", 2, NETCONN_NOCOPY);
+            }
+        } else {
+            err = netconn_write(out->conn, out->buf, out->len, NETCONN_COPY);
+        }
+        out->failed = err != ERR_OK;
+    }
+    out->len = 0;
+}
+
+/**
+ * @brief Start a response, the headers are sent at once
+ * @param out the response
+ * @param conn the connection
+ * @param status Status line and headers without the protocol, eg. http_json
+ * @param keep_alive true if the connection stays open, the body is then
+ *        sent chunked as its length is not known up front
+ */
+static void out_begin(http_out_t *out, struct netconn *conn, const char *status, bool keep_alive)
+{
+    out->conn = conn;
+    out->chunked = keep_alive;
+    out->len = 0;
+    snprintf(out->buf, sizeof(out->buf), "HTTP/1.1 %s\r\n%sConnection: %s\r\n\r\n",
+        status, keep_alive ? "Transfer-Encoding: chunked\r\n" : "", keep_alive ? "keep-alive" : "close");
+    out->failed = netconn_write(conn, out->buf, strlen(out->buf), NETCONN_COPY) != ERR_OK;
+}
+
+/**
+ * @brief Append to the response body, sending a chunk whenever the buffer
+ *        fills up
+ * @param out the response
+ * @param fmt printf format, one call produces at most OUT_CHUNK_SIZE - 1
+ *        characters
+ */
+static void out_printf(http_out_t *out, const char *fmt, ...)
+{
+    va_list ap;
+    for (uint32_t attempt = 0; attempt < 2; attempt++) {
+        va_start(ap, fmt);
+        int len = vsnprintf(&out->buf[out->len], sizeof(out->buf) - out->len, fmt, ap);
+        va_end(ap);
+        if (len >= 0 && out->len + len < sizeof(out->buf)) {
+            out->len += len;
+            return;
+        }
+        out_flush(out);
+    }
+}
+
+/**
+ * @brief End the response body
+ * @param out the response
+ */
+static void out_end(http_out_t *out)
+{
+    out_flush(out);
+    if (out->chunked && !out->failed) {
+        (void) netconn_write(out->conn, "0\r\n\r\n", 5, NETCONN_NOCOPY);
+    }
+}
+
+/**
+ * @brief Describe the firmware store and the upgrade as JSON
+ * @param out the response
+ */
+static void upgrade_status_json(http_out_t *out)
+{
+    static const char *states[] = { "empty", "receiving", "pending", "upgrading", "done", "failed" };
+    fwstore_info_t info;
+    fwstore_get(&info);
+    out_printf(out, "{\"state\":\"%s\",\"length\":%u,\"offset\":%u,\"crc\":%u,\"status\":%u}",
+        states[info.state], (unsigned) info.length, (unsigned) info.offset, info.crc, info.status);
+}
+
+/**
+ * @brief Hand a connection to the event task
+ * Only called from the webserver task, a slot is free if
+ * num_event_clients < MAX_EVENT_CLIENTS
+ * @param conn The connection, the event stream header has been sent
+ */
+static void add_event_client(struct netconn *conn)
+{
+    xSemaphoreTake(event_mutex, portMAX_DELAY);
+    for (uint32_t i = 0; i < MAX_EVENT_CLIENTS; i++) {
+        if (!event_clients[i]) {
+            event_clients[i] = conn;
+            num_event_clients++;
+            break;
+        }
+    }
+    xSemaphoreGive(event_mutex);
+}
+
+/**
+ * @brief Send an event to all browsers on /api/events, closing the
+ *        connections that fail
+ * @param event Event name, NULL for a keepalive comment
+ * @param data Event data
+ */
+static void send_event(const char *event, const char *data)
+{
+    char buf[MAX_REQUEST_SIZE];
+    if (event) {
+        snprintf(buf, sizeof(buf), "event: %s\ndata: %s\n\n", event, data);
+    } else {
+        snprintf(buf, sizeof(buf), ": %s\n\n", data);
+    }
+    xSemaphoreTake(event_mutex, portMAX_DELAY);
+    for (uint32_t i = 0; i < MAX_EVENT_CLIENTS; i++) {
+        struct netconn *conn = event_clients[i];
+        if (conn && netconn_write(conn, buf, strlen(buf), NETCONN_COPY) != ERR_OK) {
+            netconn_close(conn);
+            netconn_delete(conn);
+            event_clients[i] = NULL;
+            num_event_clients--;
+        }
+    }
+    xSemaphoreGive(event_mutex);
+}
+
+/**
+ * @brief Send a request for the metrics and check the response
+ * @param frame In: the request, Out: the response, unpacked past the status
+ * @param cmd the command
+ * @return true if the DPS answered with success, firmware built without
+ *         the command answers with a failure
+ */
+static bool metrics_request(frame_t *frame, uint8_t cmd)
+{
+    uint8_t resp_cmd, status;
+    if (!g_uart_comm(frame)) {
+        return false;
+    }
+    start_frame_unpacking(frame);
+    UNPACK8(frame, &resp_cmd);
+    UNPACK8(frame, &status);
+    return resp_cmd == (cmd_response | cmd) && status == 1;
+}
+
+/**
+ * @brief Refresh the metrics served on /metrics, called by the event task
+ * @param now current time in ms
+ */
+static void metrics_refresh(uint32_t now)
+{
+    frame_t frame;
+    /** Only used by the event task, the mutex is not held over the UART
+     *  round trips */
+    static metrics_t m;
+    uint8_t count, total, offset;
+
+    xSemaphoreTake(metrics_mutex, portMAX_DELAY);
+    m = metrics;
+    xSemaphoreGive(metrics_mutex);
+
+    create_query_frame(&frame);
+    m.have_query = metrics_request(&frame, cmd_query);
+    if (m.have_query) {
+        UNPACK16(&frame, &m.v_in);
+        UNPACK16(&frame, &m.v_out);
+        UNPACK16(&frame, &m.i_out);
+        UNPACK8(&frame, &m.output_enabled);
+        UNPACK16(&frame, &m.temp[0]);
+        UNPACK16(&frame, &m.temp[1]);
+        UNPACK8(&frame, &m.temp_shutdown);
+        m.updated_ms = now;
+
+        set_frame_header(&frame);
+        pack8(&frame, cmd_energy_stats);
+        pack8(&frame, 0);
+        end_frame(&frame);
+        m.have_energy = metrics_request(&frame, cmd_energy_stats);
+        if (m.have_energy) {
+            UNPACK32(&frame, &m.charge_uah);
+            UNPACK32(&frame, &m.energy_uwh);
+            UNPACK32(&frame, &m.runtime_ms);
+        }
+
+        set_frame_header(&frame);
+        pack8(&frame, cmd_load_stats);
+        end_frame(&frame);
+        m.have_load = metrics_request(&frame, cmd_load_stats);
+        if (m.have_load) {
+            uint16_t window_ms;
+            UNPACK16(&frame, &window_ms);
+            UNPACK16(&frame, &m.idle_permille);
+            UNPACK16(&frame, &m.isr_permille);
+            UNPACK16(&frame, &m.isr_max_us);
+            UNPACK32(&frame, &m.isr_calls);
+            UNPACK32(&frame, &m.isr_overruns);
+        }
+
+        set_frame_header(&frame);
+        pack8(&frame, cmd_event_stats);
+        end_frame(&frame);
+        m.num_queues = 0;
+        if (metrics_request(&frame, cmd_event_stats)) {
+            UNPACK8(&frame, &count);
+            while (m.num_queues < count && m.num_queues < METRICS_MAX_QUEUES) {
+                UNPACK32(&frame, &m.queues[m.num_queues].drops);
+                UNPACK16(&frame, &m.queues[m.num_queues].peak);
+                UNPACK16(&frame, &m.queues[m.num_queues].size);
+                m.num_queues++;
+            }
+        }
+
+        set_frame_header(&frame);
+        pack8(&frame, cmd_link_stats);
+        pack8(&frame, 0);
+        end_frame(&frame);
+        m.have_link = metrics_request(&frame, cmd_link_stats);
+        for (uint32_t i = 0; i < LINK_COUNTERS && m.have_link; i++) {
+            UNPACK32(&frame, &m.link[i]);
+        }
+
+        /** PERF_REPORT_CHUNK probes per round trip */
+        m.num_probes = 0;
+        do {
+            set_frame_header(&frame);
+            pack8(&frame, cmd_perf_report);
+            pack8(&frame, m.num_probes);
+            pack8(&frame, 0);
+            end_frame(&frame);
+            if (!metrics_request(&frame, cmd_perf_report)) {
+                break;
+            }
+            UNPACK32(&frame, &m.clock_hz);
+            UNPACK8(&frame, &total);
+            UNPACK8(&frame, &offset);
+            UNPACK8(&frame, &count);
+            for (uint32_t i = 0; i < count && m.num_probes < METRICS_MAX_PROBES; i++) {
+                UNPACK32(&frame, &m.probes[m.num_probes].calls);
+                UNPACK32(&frame, &m.probes[m.num_probes].min);
+                UNPACK32(&frame, &m.probes[m.num_probes].max);
+                UNPACK32(&frame, &m.probes[m.num_probes].mean);
+                m.num_probes++;
+            }
+        } while (count > 0 && m.num_probes < total && m.num_probes < METRICS_MAX_PROBES);
+    } else {
+        m.failures++;
+    }
+
+    xSemaphoreTake(metrics_mutex, portMAX_DELAY);
+    metrics = m;
+    xSemaphoreGive(metrics_mutex);
+}
+
+/**
+ * @brief Start a metric family
+ * @param out the text
+ * @param name metric name
+ * @param type gauge or counter
+ * @param help description
+ */
+static void metrics_family(http_out_t *out, const char *name, const char *type, const char *help)
+{
+    out_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/**
+ * @brief Write the cached metrics in the Prometheus text format, the UART
+ *        is never used
+ * @param out the response, started with out_begin()
+ */
+static void metrics_write(http_out_t *out)
+{
+    /** In the order of the cmd_event_stats and cmd_perf_report responses */
+    static const char *queue_names[METRICS_MAX_QUEUES] = { "buttons", "uart", "adc", "main" };
+    static const char *probe_names[METRICS_MAX_PROBES] = { "adc_isr", "func_gen", "handle_frame", "uui_refresh", "spi_dma", "past_write" };
+    static const char *probe_stats[] = { "min", "max", "mean" };
+    /** Only used by the webserver task */
+    static metrics_t m;
+    uart_rx_stats_t rx;
+    link_stats_t link;
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    /** Keeps the event task refreshing */
+    metrics_scraped_ms = now ? now : 1;
+    xSemaphoreTake(metrics_mutex, portMAX_DELAY);
+    m = metrics;
+    xSemaphoreGive(metrics_mutex);
+    uart_rx_stats(&rx);
+    link_stats_get(&link, false);
+
+    metrics_family(out, "dps_up", "gauge", "Whether the DPS answered the last refresh");
+    out_printf(out, "dps_up %d\n", m.have_query ? 1 : 0);
+    metrics_family(out, "dps_refresh_failures_total", "counter", "Refreshes the DPS did not answer");
+    out_printf(out, "dps_refresh_failures_total %u\n", (unsigned) m.failures);
+    metrics_family(out, "dps_uart_frames_total", "counter", "Frames received from the DPS");
+    out_printf(out, "dps_uart_frames_total %u\n", (unsigned) rx.frames);
+    metrics_family(out, "dps_uart_errors_total", "counter", "UART receive errors");
+    out_printf(out, "dps_uart_errors_total{type=\"length\"} %u\n", (unsigned) rx.err_length);
+    out_printf(out, "dps_uart_errors_total{type=\"overflow\"} %u\n", (unsigned) rx.err_overflow);
+    out_printf(out, "dps_uart_errors_total{type=\"framing\"} %u\n", (unsigned) rx.err_framing);
+    metrics_family(out, "dps_proxy_requests_total", "counter", "Requests sent to the DPS");
+    out_printf(out, "dps_proxy_requests_total %u\n", (unsigned) link.counters[link_requests]);
+    metrics_family(out, "dps_proxy_request_failures_total", "counter", "Requests failed by a timeout or a broken response");
+    out_printf(out, "dps_proxy_request_failures_total{type=\"timeout\"} %u\n", (unsigned) link.counters[link_timeouts]);
+    out_printf(out, "dps_proxy_request_failures_total{type=\"garbled\"} %u\n", (unsigned) link.counters[link_garbled]);
+    metrics_family(out, "dps_proxy_upgrade_retries_total", "counter", "Upgrade chunks sent again");
+    out_printf(out, "dps_proxy_upgrade_retries_total %u\n", (unsigned) link.counters[link_retries]);
+
+    if (m.updated_ms) {
+        metrics_family(out, "dps_metrics_age_seconds", "gauge", "Time since the DPS last answered a refresh");
+        out_printf(out, "dps_metrics_age_seconds %.1f\n", (now - m.updated_ms) / 1000.0f);
+    }
+
+    if (m.have_query) {
+        metrics_family(out, "dps_input_voltage_volts", "gauge", "Input voltage");
+        out_printf(out, "dps_input_voltage_volts %.3f\n", m.v_in / 1000.0f);
+        metrics_family(out, "dps_output_voltage_volts", "gauge", "Output voltage");
+        out_printf(out, "dps_output_voltage_volts %.3f\n", m.v_out / 1000.0f);
+        metrics_family(out, "dps_output_current_amperes", "gauge", "Output current");
+        out_printf(out, "dps_output_current_amperes %.3f\n", m.i_out / 1000.0f);
+        metrics_family(out, "dps_output_enabled", "gauge", "Whether the output is on");
+        out_printf(out, "dps_output_enabled %u\n", m.output_enabled);
+        metrics_family(out, "dps_temperature_celsius", "gauge", "Temperature reported to the DPS");
+        for (uint32_t i = 0; i < 2; i++) {
+            if ((uint16_t) m.temp[i] != INVALID_TEMPERATURE) {
+                out_printf(out, "dps_temperature_celsius{sensor=\"%u\"} %.1f\n", (unsigned) i + 1, m.temp[i] / 10.0f);
+            }
+        }
+        metrics_family(out, "dps_temperature_shutdown", "gauge", "Whether the output was shut down by temperature");
+        out_printf(out, "dps_temperature_shutdown %u\n", m.temp_shutdown);
+    }
+
+    if (m.have_energy) {
+        metrics_family(out, "dps_output_charge_ampere_hours_total", "counter", "Charge delivered on the output");
+        out_printf(out, "dps_output_charge_ampere_hours_total %.6f\n", m.charge_uah / 1000000.0);
+        metrics_family(out, "dps_output_energy_joules_total", "counter", "Energy delivered on the output");
+        out_printf(out, "dps_output_energy_joules_total %.3f\n", m.energy_uwh * 0.0036);
+        metrics_family(out, "dps_output_on_seconds_total", "counter", "Time the output was on");
+        out_printf(out, "dps_output_on_seconds_total %.3f\n", m.runtime_ms / 1000.0);
+    }
+
+    if (m.have_load) {
+        metrics_family(out, "dps_cpu_idle_ratio", "gauge", "Share of the last window the main loop slept");
+        out_printf(out, "dps_cpu_idle_ratio %.3f\n", m.idle_permille / 1000.0f);
+        metrics_family(out, "dps_adc_isr_load_ratio", "gauge", "Share of the last window spent in the ADC ISR");
+        out_printf(out, "dps_adc_isr_load_ratio %.3f\n", m.isr_permille / 1000.0f);
+        metrics_family(out, "dps_adc_isr_max_seconds", "gauge", "Longest ADC ISR run of the last window");
+        out_printf(out, "dps_adc_isr_max_seconds %.6f\n", m.isr_max_us / 1000000.0f);
+        metrics_family(out, "dps_adc_isr_calls_total", "counter", "ADC ISR runs");
+        out_printf(out, "dps_adc_isr_calls_total %u\n", (unsigned) m.isr_calls);
+        metrics_family(out, "dps_adc_isr_overruns_total", "counter", "ADC ISR runs not done before the next conversion");
+        out_printf(out, "dps_adc_isr_overruns_total %u\n", (unsigned) m.isr_overruns);
+    }
+
+    if (m.have_link) {
+        /** The events are dps_event_drops_total, the counters restart with
+         *  a reset through /api/link/reset */
+        metrics_family(out, "dps_link_frames_total", "counter", "Frames the DPS received intact");
+        out_printf(out, "dps_link_frames_total %u\n", (unsigned) m.link[0]);
+        metrics_family(out, "dps_link_errors_total", "counter", "Serial link errors seen by the DPS");
+        for (uint32_t i = 1; i < LINK_COUNTERS - 1; i++) {
+            out_printf(out, "dps_link_errors_total{type=\"%s\"} %u\n", dps_link_names[i], (unsigned) m.link[i]);
+        }
+    }
+
+    if (m.num_queues) {
+        metrics_family(out, "dps_event_drops_total", "counter", "Events dropped by a full queue");
+        for (uint32_t i = 0; i < m.num_queues; i++) {
+            out_printf(out, "dps_event_drops_total{queue=\"%s\"} %u\n", queue_names[i], (unsigned) m.queues[i].drops);
+        }
+        metrics_family(out, "dps_event_queue_peak", "gauge", "Highest event queue fill level");
+        for (uint32_t i = 0; i < m.num_queues; i++) {
+            out_printf(out, "dps_event_queue_peak{queue=\"%s\"} %u\n", queue_names[i], m.queues[i].peak);
+        }
+    }
+
+    if (m.num_probes) {
+        metrics_family(out, "dps_cpu_clock_hertz", "gauge", "CPU clock the probe cycles count");
+        out_printf(out, "dps_cpu_clock_hertz %u\n", (unsigned) m.clock_hz);
+        metrics_family(out, "dps_perf_calls_total", "counter", "Runs of the code under a performance probe");
+        for (uint32_t i = 0; i < m.num_probes; i++) {
+            out_printf(out, "dps_perf_calls_total{probe=\"%s\"} %u\n", probe_names[i], (unsigned) m.probes[i].calls);
+        }
+        metrics_family(out, "dps_perf_cycles", "gauge", "CPU cycles per run of the code under a performance probe");
+        for (uint32_t i = 0; i < m.num_probes; i++) {
+            uint32_t values[] = { m.probes[i].min, m.probes[i].max, m.probes[i].mean };
+            /** min is 0xffffffff for a probe that never ran */
+            for (uint32_t j = 0; j < 3 && m.probes[i].calls; j++) {
+                out_printf(out, "dps_perf_cycles{probe=\"%s\",stat=\"%s\"} %u\n", probe_names[i], probe_stats[j], (unsigned) values[j]);
+            }
+        }
+    }
+
+}
+
+/**
+ * @brief Write the link counters of the proxy and the DPS since the last
+ *        reset as JSON, the DPS ones take a UART round trip
+ * @param out the response, started with out_begin()
+ */
+static void link_stats_json(http_out_t *out)
+{
+    link_stats_t link;
+    frame_t frame;
+
+    link_stats_get(&link, true);
+    out_printf(out, "{\"proxy\":{");
+    for (uint32_t i = 0; i < link_counter_count; i++) {
+        out_printf(out, "\"%s\":%u,", proxy_link_names[i], (unsigned) link.counters[i]);
+    }
+    out_printf(out, "\"frames\":%u,\"err_length\":%u,\"err_overflow\":%u,\"err_framing\":%u},\"dps\":",
+               (unsigned) link.rx.frames, (unsigned) link.rx.err_length, (unsigned) link.rx.err_overflow,
+               (unsigned) link.rx.err_framing);
+
+    set_frame_header(&frame);
+    pack8(&frame, cmd_link_stats);
+    pack8(&frame, 0);
+    end_frame(&frame);
+    if (!g_uart_comm || !metrics_request(&frame, cmd_link_stats)) {
+        /** Not answered or built before cmd_link_stats */
+        out_printf(out, "null}");
         return;
     }
+    for (uint32_t i = 0; i < LINK_COUNTERS; i++) {
+        uint32_t value;
+        UNPACK32(&frame, &value);
+        out_printf(out, "%s\"%s\":%u", i ? "," : "{", dps_link_names[i], (unsigned) value);
+    }
+    out_printf(out, "}}");
+}
+
+/**
+ * @brief Drain the capture ring in the text format of emu/replay.h
+ * @param out the response, started with out_begin()
+ */
+static void capture_write(http_out_t *out)
+{
+    /** Only used by the webserver task, too large for its stack */
+    static capture_record_t r;
+    uint32_t dropped = capture_dropped();
+    if (dropped) {
+        out_printf(out, "# %u frames dropped by a full ring\n", (unsigned) dropped);
+    }
+    while (capture_next(&r)) {
+        out_printf(out, "%llu %c ", (unsigned long long) r.t_us, r.to_dps ? '>' : '<');
+        for (uint32_t i = 0; i < r.length; i++) {
+            out_printf(out, "%02x", r.data[i]);
+        }
+        out_printf(out, "\n");
+    }
+}
+
+/**
+ * @brief Check if the client lets the connection stay open after the
+ *        response, HTTP/1.1 without Connection: close
+ * @param request NUL terminated request
+ * @return true if the connection may be kept
+ */
+static bool keep_alive_requested(const char *request)
+{
+    const char *eol = strstr(request, "\r\n");
+    if (!eol || eol - request < 8 || strncmp(eol - 8, "HTTP/1.1", 8) != 0) {
+        return false;
+    }
+    const char *line = eol + 2;
+    while ((eol = strstr(line, "\r\n")) != NULL && eol != line) {
+        if (strncasecmp(line, "Connection:", 11) == 0) {
+            line += 11;
+            while (*line == ' ') {
+                line++;
+            }
+            return strncasecmp(line, "close", 5) != 0;
+        }
+        line = eol + 2;
+    }
+    return true;
+}
+
+/**
+ * @brief Send the status line and headers of a response
+ * @param conn The connection
+ * @param status Status line and headers without the protocol, eg. http_json
+ * @param length Length of the body
+ * @param keep_alive true if the connection stays open
+ */
+static void send_header(struct netconn *conn, const char *status, size_t length, bool keep_alive)
+{
+    char header[256];
+    snprintf(header, sizeof(header), "HTTP/1.1 %s\r\nContent-Length: %u\r\nConnection: %s\r\n\r\n",
+        status, (unsigned) length, keep_alive ? "keep-alive" : "close");
+    netconn_write(conn, header, strlen(header), NETCONN_COPY);
+}
+
+/**
+ * @brief Send a response with a constant body, it is not copied
+ * @param conn The connection
+ * @param status Status line and headers without the protocol, eg. http_html
+ * @param body The body
+ * @param length Length of body
+ * @param keep_alive true if the connection stays open
+ */
+static void send_response(struct netconn *conn, const char *status, const void *body, size_t length, bool keep_alive)
+{
+    send_header(conn, status, length, keep_alive);
+    if (length > 0) {
+        netconn_write(conn, body, length, NETCONN_NOCOPY);
+    }
+}
+
+/**
+ * @brief Handle a request
+ * @param conn The connection
+ * @param inbuf The first part of the request, deleted here
+ * @param can_keep true if the connection may be kept open
+ * @return what to do with the connection
+ */
+static conn_next_t handle_request(struct netconn *conn, struct netbuf *inbuf, bool can_keep)
+{
+    conn_next_t next = conn_close;
+    char *buf;
+    u16_t buflen;
+    /** Only used by the webserver task, kept off its stack */
+    static http_out_t out;
 
     netbuf_data(inbuf, (void**)&buf, &buflen);
 
+    // POST /api/upgrade, before the body is cut short below
+    if (buflen > 17 && strncmp(buf, "POST /api/upgrade", 17) == 0) {
+        bool success = receive_upgrade(conn, inbuf);
+        out_begin(&out, conn, http_json, false);
+        out_printf(&out, "{\"success\":%s,\"upgrade\":", success ? "true" : "false");
+        upgrade_status_json(&out);
+        out_printf(&out, "}");
+        out_end(&out);
+        buflen = 0;
+    }
+
     if (buflen > 0) {
         // Null terminate for string operations
         if (buflen < MAX_REQUEST_SIZE - 1) {
@@ -308,29 +1000,94 @@ static void handle_request(struct netconn *conn)
         } else {
             buf[MAX_REQUEST_SIZE - 1] = '\0';
         }
+        bool keep = can_keep && keep_alive_requested(buf);
+        next = keep ? conn_keep_alive : conn_close;
 
         // Handle OPTIONS (CORS preflight)
         if (strncmp(buf, "OPTIONS", 7) == 0) {
-            netconn_write(conn, http_options, strlen(http_options), NETCONN_NOCOPY);
+            send_response(conn, http_options, NULL, 0, keep);
         }
         // GET /
         else if (strncmp(buf, "GET / ", 6) == 0 || strncmp(buf, "GET /index", 10) == 0) {
-            netconn_write(conn, http_html_header, strlen(http_html_header), NETCONN_NOCOPY);
-            netconn_write(conn, index_html, strlen(index_html), NETCONN_NOCOPY);
+            send_response(conn, http_html, index_html_gz, sizeof(index_html_gz), keep);
         }
         // GET /api/status
         else if (strncmp(buf, "GET /api/status", 15) == 0) {
             frame_t frame;
+            char json[128];
             create_query_frame(&frame);
 
+            /** The headers leave before the UART round trip */
+            out_begin(&out, conn, http_json, keep);
             if (g_uart_comm && g_uart_comm(&frame)) {
-                char json[256];
                 parse_query_response(&frame, json, sizeof(json));
-                snprintf(response, sizeof(response), "%s%s", http_json_header, json);
+                out_printf(&out, "%s", json);
+            } else {
+                out_printf(&out, "{\"error\":\"communication timeout\"}");
+            }
+            out_end(&out);
+        }
+        // GET /api/upgrade
+        else if (strncmp(buf, "GET /api/upgrade", 16) == 0) {
+            out_begin(&out, conn, http_json, keep);
+            upgrade_status_json(&out);
+            out_end(&out);
+        }
+        // GET /api/link
+        else if (strncmp(buf, "GET /api/link", 13) == 0) {
+            out_begin(&out, conn, http_json, keep);
+            link_stats_json(&out);
+            out_end(&out);
+        }
+        // POST /api/link/reset
+        else if (strncmp(buf, "POST /api/link/reset", 20) == 0) {
+            frame_t frame;
+            link_stats_reset();
+            set_frame_header(&frame);
+            pack8(&frame, cmd_link_stats);
+            pack8(&frame, LINK_STATS_RESET);
+            end_frame(&frame);
+            bool success = g_uart_comm && metrics_request(&frame, cmd_link_stats);
+            out_begin(&out, conn, http_json, keep);
+            out_printf(&out, "{\"success\":%s}", success ? "true" : "false");
+            out_end(&out);
+        }
+        // GET /api/capture
+        else if (strncmp(buf, "GET /api/capture", 16) == 0) {
+            out_begin(&out, conn, http_text, keep);
+            capture_write(&out);
+            out_end(&out);
+        }
+        // POST /api/capture, 1 starts a new capture and 0 stops it
+        else if (strncmp(buf, "POST /api/capture", 17) == 0) {
+            char *body = find_body(buf);
+            if (body && body[0] == '1') {
+                capture_start();
+            } else if (body && body[0] == '0') {
+                capture_stop();
+            }
+            out_begin(&out, conn, http_json, keep);
+            out_printf(&out, "{\"success\":%s,\"running\":%s}", body ? "true" : "false",
+                       capture_running() ? "true" : "false");
+            out_end(&out);
+        }
+        // GET /metrics
+        else if (strncmp(buf, "GET /metrics", 12) == 0) {
+            out_begin(&out, conn, http_metrics, keep);
+            metrics_write(&out);
+            out_end(&out);
+        }
+        // GET /api/events
+        else if (strncmp(buf, "GET /api/events", 15) == 0) {
+            if (num_event_clients < MAX_EVENT_CLIENTS &&
+                netconn_write(conn, http_sse_header, strlen(http_sse_header), NETCONN_NOCOPY) == ERR_OK) {
+                add_event_client(conn);
+                next = conn_handed_over;
             } else {
-                snprintf(response, sizeof(response), "%s{\"error\":\"communication timeout\"}", http_json_header);
+                static const char busy[] = "Too many listeners";
+                send_response(conn, http_503, busy, strlen(busy), false);
+                next = conn_close;
             }
-            netconn_write(conn, response, strlen(response), NETCONN_COPY);
         }
         // POST /api/voltage
         else if (strncmp(buf, "POST /api/voltage", 17) == 0) {
@@ -340,12 +1097,13 @@ static void handle_request(struct netconn *conn)
                 create_set_param_frame(&frame, "voltage", body);
 
                 bool success = g_uart_comm(&frame) && parse_simple_response(&frame);
-                snprintf(response, sizeof(response), "%s{\"success\":%s}",
-                    http_json_header, success ? "true" : "false");
+                out_begin(&out, conn, http_json, keep);
+                out_printf(&out, "{\"success\":%s}", success ? "true" : "false");
             } else {
-                snprintf(response, sizeof(response), "%s{\"success\":false,\"error\":\"no body\"}", http_json_header);
+                out_begin(&out, conn, http_json, keep);
+                out_printf(&out, "{\"success\":false,\"error\":\"no body\"}");
             }
-            netconn_write(conn, response, strlen(response), NETCONN_COPY);
+            out_end(&out);
         }
         // POST /api/current
         else if (strncmp(buf, "POST /api/current", 17) == 0) {
@@ -355,12 +1113,13 @@ static void handle_request(struct netconn *conn)
                 create_set_param_frame(&frame, "current", body);
 
                 bool success = g_uart_comm(&frame) && parse_simple_response(&frame);
-                snprintf(response, sizeof(response), "%s{\"success\":%s}",
-                    http_json_header, success ? "true" : "false");
+                out_begin(&out, conn, http_json, keep);
+                out_printf(&out, "{\"success\":%s}", success ? "true" : "false");
             } else {
-                snprintf(response, sizeof(response), "%s{\"success\":false,\"error\":\"no body\"}", http_json_header);
+                out_begin(&out, conn, http_json, keep);
+                out_printf(&out, "{\"success\":false,\"error\":\"no body\"}");
             }
-            netconn_write(conn, response, strlen(response), NETCONN_COPY);
+            out_end(&out);
         }
         // POST /api/output
         else if (strncmp(buf, "POST /api/output", 16) == 0) {
@@ -371,31 +1130,84 @@ static void handle_request(struct netconn *conn)
                 create_enable_output_frame(&frame, enable);
 
                 bool success = g_uart_comm(&frame) && parse_simple_response(&frame);
-                snprintf(response, sizeof(response), "%s{\"success\":%s}",
-                    http_json_header, success ? "true" : "false");
+                out_begin(&out, conn, http_json, keep);
+                out_printf(&out, "{\"success\":%s}", success ? "true" : "false");
             } else {
-                snprintf(response, sizeof(response), "%s{\"success\":false,\"error\":\"no body\"}", http_json_header);
+                out_begin(&out, conn, http_json, keep);
+                out_printf(&out, "{\"success\":false,\"error\":\"no body\"}");
             }
-            netconn_write(conn, response, strlen(response), NETCONN_COPY);
+            out_end(&out);
         }
         // 404 for everything else
         else {
-            netconn_write(conn, http_404, strlen(http_404), NETCONN_NOCOPY);
+            static const char not_found[] = "Not Found";
+            send_response(conn, http_404, not_found, strlen(not_found), keep);
         }
     }
 
-    netconn_close(conn);
     netbuf_delete(inbuf);
+    return next;
+}
+
+/**
+ * @brief Close a connection
+ * @param conn The connection
+ */
+static void close_connection(struct netconn *conn)
+{
+    netconn_close(conn);
+    netconn_delete(conn);
+}
+
+/**
+ * @brief Serve a request and keep the connection if both ends want to
+ * @param conn The connection
+ * @param inbuf The first part of the request
+ * @param requests Requests served on the connection, this one included
+ */
+static void serve_connection(struct netconn *conn, struct netbuf *inbuf, uint32_t requests)
+{
+    int32_t slot = -1;
+    for (uint32_t i = 0; i < MAX_KEEPALIVE_CLIENTS && slot < 0; i++) {
+        if (!keepalive_clients[i].conn) {
+            slot = i;
+        }
+    }
+    bool can_keep = slot >= 0 && requests < KEEPALIVE_MAX_REQUESTS;
+    switch (handle_request(conn, inbuf, can_keep)) {
+        case conn_keep_alive:
+            keepalive_clients[slot].conn = conn;
+            keepalive_clients[slot].requests = requests;
+            keepalive_clients[slot].last_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+            break;
+        case conn_close:
+            close_connection(conn);
+            break;
+        case conn_handed_over:
+            break;
+    }
 }
 
 void webserver_init(uart_comm_func_t comm_func)
 {
     g_uart_comm = comm_func;
+    event_mutex = xSemaphoreCreateMutex();
+    event_queue = xQueueCreate(EVENT_QUEUE_DEPTH, sizeof(frame_t));
+    metrics_mutex = xSemaphoreCreateMutex();
+}
+
+void webserver_push(frame_t *frame)
+{
+    /** Drop the frame rather than stall the UART task */
+    if (num_event_clients > 0 && frame->length > 0 && frame->buffer[0] == cmd_stream_data) {
+        (void) xQueueSend(event_queue, (void*) frame, 0);
+    }
 }
 
 void webserver_task(void *pvParameters)
 {
     struct netconn *conn, *newconn;
+    struct netbuf *inbuf;
     err_t err;
     (void)pvParameters;
 
@@ -418,10 +1230,103 @@ void webserver_task(void *pvParameters)
     printf("Web server listening on port %d\n", HTTP_PORT);
 
     while (1) {
+        bool kept = false;
+        for (uint32_t i = 0; i < MAX_KEEPALIVE_CLIENTS; i++) {
+            kept |= keepalive_clients[i].conn != NULL;
+        }
+        /** Block on accept unless kept connections need polling */
+        netconn_set_recvtimeout(conn, kept ? KEEPALIVE_POLL_MS : 0);
         err = netconn_accept(conn, &newconn);
         if (err == ERR_OK) {
-            handle_request(newconn);
-            netconn_delete(newconn);
+            netconn_set_recvtimeout(newconn, REQUEST_TIMEOUT_MS);
+            if (netconn_recv(newconn, &inbuf) == ERR_OK) {
+                serve_connection(newconn, inbuf, 1);
+            } else {
+                close_connection(newconn);
+            }
+        }
+
+        for (uint32_t i = 0; i < MAX_KEEPALIVE_CLIENTS; i++) {
+            keepalive_t *client = &keepalive_clients[i];
+            if (!client->conn) {
+                continue;
+            }
+            /** Rounds down to no wait */
+            netconn_set_recvtimeout(client->conn, 1);
+            err = netconn_recv(client->conn, &inbuf);
+            uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+            if (err == ERR_OK) {
+                struct netconn *client_conn = client->conn;
+                uint32_t requests = client->requests + 1;
+                client->conn = NULL;
+                netconn_set_recvtimeout(client_conn, REQUEST_TIMEOUT_MS);
+                serve_connection(client_conn, inbuf, requests);
+            } else if (err != ERR_TIMEOUT || now - client->last_ms >= KEEPALIVE_TIMEOUT_MS) {
+                /** Closed by the browser or idle */
+                close_connection(client->conn);
+                client->conn = NULL;
+            }
+        }
+    }
+}
+
+void webserver_event_task(void *pvParameters)
+{
+    frame_t frame;
+    char json[MAX_REQUEST_SIZE - 32];
+    bool streaming = false;
+    bool can_stream = true;
+    uint32_t last_event = 0;
+    uint32_t last_refresh = 0;
+    (void)pvParameters;
+
+    while (1) {
+        bool got_frame = xQueueReceive(event_queue, (void*) &frame, EVENT_POLL_MS / portTICK_PERIOD_MS) == pdTRUE;
+        uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+        /** Only while someone scrapes /metrics */
+        if (metrics_scraped_ms && now - metrics_scraped_ms < METRICS_IDLE_MS &&
+            (!last_refresh || now - last_refresh >= METRICS_REFRESH_MS)) {
+            metrics_refresh(now);
+            last_refresh = now;
+        }
+
+        if (num_event_clients == 0) {
+            if (streaming) {
+                create_stream_stop_frame(&frame);
+                (void) g_uart_comm(&frame);
+                streaming = false;
+            }
+            /** Give the next DPS a chance, it may have been upgraded */
+            can_stream = true;
+            continue;
+        }
+
+        if (got_frame) {
+            if (parse_stream_data(&frame, json, sizeof(json))) {
+                send_event("samples", json);
+                last_event = now;
+            }
+        } else if (can_stream && (!streaming || now - last_event >= EVENT_STREAM_TIMEOUT_MS)) {
+            /** Not started, stopped by another client or the DPS rebooted */
+            create_stream_start_frame(&frame, EVENT_INTERVAL_MS, EVENT_BATCH);
+            streaming = g_uart_comm(&frame) && parse_simple_response(&frame);
+            if (!streaming && frame.length > 0) {
+                /** Answered but refused, older firmware. Poll instead */
+                can_stream = false;
+            }
+            last_event = now;
+        } else if (!can_stream) {
+            create_query_frame(&frame);
+            if (g_uart_comm(&frame) && parse_query_response(&frame, json, sizeof(json))) {
+                send_event("status", json);
+                last_event = now;
+            }
+        }
+
+        if (now - last_event >= EVENT_KEEPALIVE_MS) {
+            send_event(NULL, "keepalive");
+            last_event = now;
         }
     }
 }
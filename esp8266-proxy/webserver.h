@@ -44,10 +44,23 @@ typedef bool (*uart_comm_func_t)(frame_t *frame);
  */
 void webserver_init(uart_comm_func_t comm_func);
 
+/**
+ * @brief Hand a frame the DPS sent on its own to the browsers on /api/events
+ * Called from the UART task, the frame is copied and never blocks
+ * @param frame unescaped payload of the frame
+ */
+void webserver_push(frame_t *frame);
+
 /**
  * @brief Web server task - call this from FreeRTOS
  * @param pvParameters unused
  */
 void webserver_task(void *pvParameters);
 
+/**
+ * @brief Event task feeding /api/events - call this from FreeRTOS
+ * @param pvParameters unused
+ */
+void webserver_event_task(void *pvParameters);
+
 #endif // __WEBSERVER_H__
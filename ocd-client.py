@@ -8,8 +8,13 @@
 # No rights reserved
 #
 
+import json
+import os
 import socket
+import struct
 import sys
+import tempfile
+import time
 
 prompt = "> " # OpenOCD prompt
 
@@ -759,6 +764,283 @@ def read_mem():
             address += 4
             length -= 1
 
+# SWO trace of a firmware built with TRACE=1, see opendps/trace.h
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "dpsctl"))
+try:
+    import protocol
+    cmd_names = {getattr(protocol, n): n[4:].lower() for n in dir(protocol) if n.startswith("CMD_")}
+except ImportError:
+    cmd_names = {}
+
+# Core clock the ITM timestamps count, and the SWO bit rate (TRACE_SWO_BAUD)
+swo_core_hz = 48000000
+swo_baud = 2000000
+
+# ITM stimulus ports, trace_port_t
+SWO_PORT_TEXT = 0
+SWO_PORT_EVENT = 1
+SWO_PORT_CMD = 2
+
+# event_t of opendps/event.h
+event_names = ["none", "button_m1", "button_m2", "buttom_m1_and_m2", "button_sel",
+               "button_enable", "rot_left", "rot_right", "rot_left_set", "rot_right_set",
+               "rot_press", "uart_rx", "uart_rx_block", "ocp", "ovp", "limit_mode", "vout_ramped"]
+
+# trace_event_kind_t
+event_kinds = ["put", "DROP", "get"]
+
+# STM32F100 exception numbers, IRQn + 16
+exception_names = {
+    2: "NMI", 3: "HardFault", 11: "SVCall", 14: "PendSV", 15: "SysTick",
+    22: "EXTI0", 23: "EXTI1", 24: "EXTI2", 25: "EXTI3", 26: "EXTI4",
+    27: "DMA1_CH1", 30: "DMA1_CH4", 31: "DMA1_CH5", 34: "ADC1", 39: "EXTI9_5",
+    45: "TIM3", 53: "USART1", 56: "EXTI15_10", 70: "TIM6_DAC",
+}
+
+def swo_packets(data):
+    """
+    Split an ITM stream into packets, yields ("ts", delta), ("sw", port, size, value),
+    ("hw", id, size, value) and ("overflow",) tuples
+    """
+    i = 0
+    while i < len(data):
+        h = data[i]
+        i += 1
+        if h == 0x00:
+            # Synchronization, zeros ended by 0x80
+            while i < len(data) and data[i] == 0x00:
+                i += 1
+            if i < len(data) and data[i] == 0x80:
+                i += 1
+            continue
+        if h == 0x70:
+            yield ("overflow",)
+        elif h & 0x0f == 0:
+            # Local timestamp, with continuation bytes or a 3 bit delta in the header
+            if h & 0xc0 == 0xc0:
+                ts = shift = 0
+                while i < len(data):
+                    b = data[i]
+                    i += 1
+                    ts |= (b & 0x7f) << shift
+                    shift += 7
+                    if not b & 0x80:
+                        break
+            else:
+                ts = (h >> 4) & 7
+            yield ("ts", ts)
+        elif h & 0x0b == 0x08 or h & 0x03 == 0:
+            # Extension and global timestamp packets are skipped
+            more = h & 0x80 if h & 0x0b == 0x08 else True
+            while more and i < len(data):
+                more = data[i] & 0x80
+                i += 1
+        else:
+            size = [0, 1, 2, 4][h & 3]
+            if i + size > len(data):
+                break
+            value = 0
+            for n in range(size):
+                value |= data[i + n] << (8 * n)
+            i += size
+            yield ("hw" if h & 0x04 else "sw", h >> 3, size, value)
+
+def swo_describe(packet):
+    """
+    Describe a stimulus or exception trace packet, None to leave it out
+    """
+    kind, port, size, value = packet[0], packet[1], packet[2], packet[3]
+    if kind == "hw":
+        if port != 1:
+            return None  # Only the exception trace is enabled
+        exc = value & 0x1ff
+        fn = (value >> 12) & 3
+        name = exception_names.get(exc, "exception %d" % exc)
+        return ["", "enter %s" % name, "exit %s" % name, "return to %s" % name if exc else "return"][fn]
+    if port == SWO_PORT_EVENT:
+        ev = (value >> 8) & 0xff
+        name = event_names[ev] if ev < len(event_names) else str(ev)
+        k = value >> 24
+        return "event %-4s %s (%d)" % (event_kinds[k] if k < len(event_kinds) else k, name, value & 0xff)
+    if port == SWO_PORT_CMD:
+        cmd = value & 0xff
+        name = cmd_names.get(cmd, "0x%02x" % cmd)
+        if size == 1:
+            return "cmd   %s" % name
+        return "cmd   %s done, status %d" % (name, value >> 8)
+    if port == SWO_PORT_TEXT:
+        return "text  %r" % "".join(chr((value >> (8 * n)) & 0xff) for n in range(size))
+    return "port %d: 0x%0*x" % (port, 2 * size, value)
+
+def swo_timeline(data):
+    """
+    Print the trace as a timeline in microseconds, with the time spent in each ISR
+    """
+    now = 0
+    pending = []
+    entered = {}
+    for p in swo_packets(data):
+        if p[0] == "overflow":
+            print("%12s  <ITM overflow, packets lost>" % "")
+        elif p[0] == "ts":
+            now += p[1]
+            for q in pending:
+                us = now * 1e6 / swo_core_hz
+                text = swo_describe(q)
+                if text is None:
+                    continue
+                if q[0] == "hw" and (q[3] >> 12) & 3 == 1:
+                    entered[q[3] & 0x1ff] = now
+                elif q[0] == "hw" and (q[3] >> 12) & 3 == 2 and (q[3] & 0x1ff) in entered:
+                    text += " after %.2f us" % ((now - entered.pop(q[3] & 0x1ff)) * 1e6 / swo_core_hz)
+                print("%12.2f  %s" % (us, text))
+            pending = []
+        else:
+            pending.append(p)
+
+def swo_trace():
+    """
+    Have OpenOCD capture the SWO stream to a file for a while and print it
+    as a timeline
+    """
+    if len(sys.argv) < 3:
+        print("%s swo <capture file> [<seconds>] [<core hz>]" % (sys.argv[0]))
+        return
+    global swo_core_hz
+    path = os.path.abspath(sys.argv[2])
+    seconds = float(sys.argv[3]) if len(sys.argv) > 3 else 5
+    if len(sys.argv) > 4:
+        swo_core_hz = int(sys.argv[4])
+    response = ocd_exchange("tpiu config internal %s uart off %d %d\n" % (path, swo_core_hz, swo_baud))
+    if "invalid" in response:
+        # OpenOCD 0.11 and later
+        ocd_exchange("stm32f1x.tpiu configure -protocol uart -output %s -traceclk %d -pin-freq %d\n" % (path, swo_core_hz, swo_baud))
+        ocd_exchange("stm32f1x.tpiu enable\n")
+    ocd_exchange("itm ports on\n")
+    time.sleep(seconds)
+    ocd_exchange("tpiu config disable\n" if "invalid" not in response else "stm32f1x.tpiu disable\n")
+    with open(path, "rb") as f:
+        swo_timeline(bytearray(f.read()))
+
+# RAM descriptor of a firmware built with SWD_READOUT=1, see opendps/memdesc.h
+MEMDESC_MAGIC = 0x4353444d
+MEMDESC_ENTRIES = 4
+MEMDESC_ADDRESS = 0x20001ff0 - (8 + 16 * MEMDESC_ENTRIES)
+
+# RECORDER_CHA_* bits and the order of the channels in a sample set
+recorder_channels = ["i_out", "v_in", "v_out"]
+
+def ocd_read_words(address, count):
+    """
+    Read count words starting at address, False on error
+    """
+    response = ocd_exchange("mdw 0x%08x %d\n" % (address, count))
+    words = []
+    for line in response.split("\n"):
+        parts = line.split(":")
+        if len(parts) == 2:
+            words += [int(w, 16) for w in parts[1].split()]
+    if len(words) < count:
+        print("Parsing error: %s" % response)
+        return False
+    return words[:count]
+
+def ocd_dump(address, length):
+    """
+    Read length bytes starting at address at debug probe speed
+    """
+    fd, path = tempfile.mkstemp(suffix=".bin")
+    os.close(fd)
+    try:
+        ocd_exchange("dump_image %s 0x%08x %d\n" % (path, address, length))
+        with open(path, "rb") as f:
+            return f.read()
+    finally:
+        os.remove(path)
+
+def memdesc_entries():
+    """
+    Read the RAM descriptor, returns {id: (address, length, seq address)}
+    """
+    words = ocd_read_words(MEMDESC_ADDRESS, 2 + 4 * MEMDESC_ENTRIES)
+    if not words or words[0] != MEMDESC_MAGIC:
+        return None
+    entries = {}
+    for i in range(min(words[1] >> 16, MEMDESC_ENTRIES)):
+        id_, address, length, seq = words[2 + 4 * i:6 + 4 * i]
+        name = struct.pack("<I", id_).decode("ascii", "replace")
+        entries[name] = (address, length, MEMDESC_ADDRESS + 8 + 16 * i + 12)
+    return entries
+
+def memdesc_dump(entry, tries = 10):
+    """
+    Read the buffer of an entry while its sequence number stays even and
+    unchanged, or until two reads agree for a live buffer. Returns
+    (seq, data), data is None if no consistent read was made.
+    """
+    address, length, seq_address = entry
+    previous = None
+    for i in range(tries):
+        seq = ocd_read(seq_address)
+        if seq is not False and seq & 1:
+            time.sleep(0.1)  # Being changed, eg. a recording in progress
+            continue
+        data = ocd_dump(address, length)
+        if seq != 0 and ocd_read(seq_address) == seq:
+            return seq, data
+        if seq == 0 and data == previous:
+            return seq, data
+        previous = data
+    return None, None
+
+def readout():
+    """
+    Read the recorder and energy meter buffers over SWD into files
+    """
+    out_dir = sys.argv[2] if len(sys.argv) > 2 else "."
+    entries = memdesc_entries()
+    if entries is None:
+        print("No RAM descriptor at 0x%08x, was the firmware built with SWD_READOUT=1?" % MEMDESC_ADDRESS)
+        return
+    start = time.time()
+    total = 0
+    if "RECL" in entries and "RECS" in entries:
+        seq, layout = memdesc_dump(entries["RECL"])
+        ring_seq, ring = memdesc_dump(entries["RECS"])
+        if layout is None or ring is None or seq != ring_seq:
+            print("Recorder busy, no consistent read")
+        elif seq == 0:
+            print("Recorder: nothing recorded")
+        else:
+            oldest, ring_samples, num_samples, pre_count, trigger_us, decimation, channels, trigger = \
+                struct.unpack("<IIIIQHBB", layout[:28])
+            ring = struct.unpack("<%dH" % (len(ring) // 2), ring)
+            samples = [ring[(oldest + k) % ring_samples] for k in range(num_samples)]
+            names = [n for b, n in enumerate(recorder_channels) if channels & (1 << b)]
+            path = os.path.join(out_dir, "recorder.csv")
+            with open(path, "w") as f:
+                f.write(",".join(names) + "\n")
+                for k in range(0, num_samples, len(names)):
+                    f.write(",".join(str(v) for v in samples[k:k + len(names)]) + "\n")
+            print("Recorder: %d sets (%d before trigger %d at %d us, decimation %d) -> %s" %
+                  (num_samples // len(names), pre_count, trigger, trigger_us, decimation, path))
+            total += len(layout) + len(ring) * 2
+    if "ENRG" in entries:
+        seq, data = memdesc_dump(entries["ENRG"])
+        if data is None:
+            print("Energy: no consistent read")
+        else:
+            n, i_sum, v_sum, vi_sum = struct.unpack("<QQQQ", data[:32])
+            path = os.path.join(out_dir, "energy.json")
+            with open(path, "w") as f:
+                json.dump({"n": n, "i_sum": i_sum, "v_sum": v_sum, "vi_sum": vi_sum}, f)
+            print("Energy: %d samples, raw means I_out %.2f V_out %.2f -> %s" %
+                  (n, i_sum / float(n or 1), v_sum / float(n or 1), path))
+            total += len(data)
+    elapsed = time.time() - start
+    print("Read %d bytes in %.2f s" % (total, elapsed))
+
 def print_help():
     global commands
     print("Available commands:")
@@ -767,7 +1049,7 @@ def print_help():
 
 def dump_all():
     global commands
-    blocklist = ["reg", "all", "r", "w", "help"]
+    blocklist = ["reg", "all", "r", "w", "swo", "readout", "help"]
     for cmd in commands:
         if cmd not in blocklist:
             print(">>>> %s" % cmd)
@@ -810,11 +1092,13 @@ commands = {
     "gpiob" : dump_gpiob_settings,
     "gpioc" : dump_gpioc_settings,
     "gpiod" : dump_gpiod_settings,
+    "readout" : readout,
     "reg"   : dump_register_map,
     "rcc"   : dump_rcc_settings,
     "spi1"  : dump_spi1_settings,
     "spi2"  : dump_spi2_settings,
     "tim4"  : dump_tim4_settings,
+    "swo"   : swo_trace,
     "w"     : write_mem,
     "r"     : read_mem,
     "help"  : print_help,
@@ -0,0 +1,178 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <cortex.h>
+#include "adcnoise.h"
+#include "isrhook.h"
+#include "ramfunc.h"
+
+/** Raw samples of one window, written by the ADC ISR only */
+typedef struct {
+    uint32_t n;                                         /** Sample sets */
+    uint16_t center[adcnoise_channels];                 /** Code the deviations are taken from */
+    uint16_t min[adcnoise_channels];                    /** Smallest code */
+    uint16_t max[adcnoise_channels];                    /** Largest code */
+    int32_t sum[adcnoise_channels];                     /** Sum of the deviations */
+    uint64_t sum_sq[adcnoise_channels];                 /** Sum of the squared deviations */
+    uint16_t hist[adcnoise_channels][ADCNOISE_BINS];    /** Deviations per bin */
+} window_t;
+
+/** The window the ISR fills and the last full one */
+static window_t windows[2];
+static uint32_t filling;
+static bool centered;
+static volatile uint32_t completed;
+static uint8_t users;
+
+/**
+  * @brief Start an empty window
+  * @param w the window
+  * @retval none
+  */
+static void open_window(window_t *w)
+{
+    memset(w, 0, sizeof(*w));
+    for (uint32_t ch = 0; ch < adcnoise_channels; ch++) {
+        w->min[ch] = UINT16_MAX;
+    }
+}
+
+/**
+  * @brief Integer square root
+  * @param value the value
+  * @retval floor(sqrt(value))
+  */
+static uint32_t isqrt64(uint64_t value)
+{
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t) root;
+}
+
+void adcnoise_enable(uint8_t user, bool enable)
+{
+    uint8_t was = users;
+    users = enable ? (was | user) : (was & ~user);
+    if (!was && users) {
+        /** The hook is not set, nothing else touches the windows */
+        open_window(&windows[0]);
+        filling = 0;
+        centered = false;
+        completed = 0;
+        isrhook_set(isrhook_adcnoise, &adcnoise_sample, ISRHOOK_BUDGET_ADCNOISE);
+    } else if (was && !users) {
+        isrhook_set(isrhook_adcnoise, NULL, 0);
+    }
+}
+
+bool adcnoise_enabled(void)
+{
+    return users != 0;
+}
+
+RAMFUNC_HOOK void adcnoise_sample(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw)
+{
+    window_t *w = &windows[filling];
+    uint16_t raw[adcnoise_channels] = { v_out_raw, v_in_raw, (uint16_t) i_raw };
+    for (uint32_t ch = 0; ch < adcnoise_channels; ch++) {
+        if (!centered) {
+            w->center[ch] = raw[ch];
+        }
+        if (raw[ch] < w->min[ch]) {
+            w->min[ch] = raw[ch];
+        }
+        if (raw[ch] > w->max[ch]) {
+            w->max[ch] = raw[ch];
+        }
+        int32_t d = (int32_t) raw[ch] - w->center[ch];
+        w->sum[ch] += d;
+        w->sum_sq[ch] += (uint32_t) (d * d);
+        int32_t bin = d + ADCNOISE_BINS / 2;
+        if (bin < 0) {
+            bin = 0;
+        } else if (bin >= ADCNOISE_BINS) {
+            bin = ADCNOISE_BINS - 1;
+        }
+        w->hist[ch][bin]++;
+    }
+    centered = true;
+
+    if (++w->n == ADCNOISE_WINDOW) {
+        filling ^= 1;
+        window_t *next = &windows[filling];
+        open_window(next);
+        for (uint32_t ch = 0; ch < adcnoise_channels; ch++) {
+            /** The deviations of a window are mostly small, the sum is too */
+            int32_t mean = (w->sum[ch] + ADCNOISE_WINDOW / 2) >> ADCNOISE_WINDOW_SHIFT;
+            next->center[ch] = (uint16_t) (w->center[ch] + mean);
+        }
+        completed++;
+    }
+}
+
+bool adcnoise_get(adcnoise_t *noise)
+{
+    window_t w;
+    /** The ADC ISR may preempt us, but not the other way round */
+    bool masked = cm_mask_interrupts(true);
+    uint32_t count = completed;
+    w = windows[filling ^ 1];
+    (void) cm_mask_interrupts(masked);
+
+    memset(noise, 0, sizeof(*noise));
+    if (!count || !w.n) {
+        return false;
+    }
+    noise->windows = count;
+    noise->samples = w.n;
+    for (uint32_t ch = 0; ch < adcnoise_channels; ch++) {
+        adcnoise_stats_t *s = &noise->ch[ch];
+        int64_t sum = w.sum[ch];
+        s->center = w.center[ch];
+        s->min = w.min[ch];
+        s->max = w.max[ch];
+        s->mean = (uint32_t) (((int64_t) w.center[ch] << 16) + sum * (1 << 16) / (int64_t) w.n);
+        /** n * var = sum_sq - sum^2 / n, twice the fractional bits before the root */
+        uint64_t spread = w.sum_sq[ch] - (uint64_t) (sum * sum) / w.n;
+        s->stddev = isqrt64((spread << (2 * ADCNOISE_FRAC_BITS)) / w.n);
+        memcpy(s->hist, w.hist[ch], sizeof(s->hist));
+    }
+    return true;
+}
@@ -0,0 +1,128 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+/**
+ * @file adcnoise.h
+ * @brief Noise of the raw V_out, V_in and I_out ADC codes
+ *
+ * Available with CONFIG_ADC_NOISE. While enabled, the ADC ISR folds every
+ * sample set into a window of ADCNOISE_WINDOW sets through adcnoise_sample().
+ * Per channel the window holds the smallest and largest code, the sums of
+ * the deviations from a center code and a histogram of those deviations,
+ * one code per bin with the outermost bins catching the tails. The center
+ * of a window is the rounded mean of the one before, the first window after
+ * enabling is centered on its first sample.
+ *
+ * A full window is swapped with the one last read and the next is opened,
+ * the ISR never waits for a reader. The closing call clears the new window
+ * and costs a few hundred cycles once per window, it shows as an overrun in
+ * the hook accounting. adcnoise_get() returns the last full window, the
+ * calibration screen and cmd_cal_report read it independently.
+ */
+
+#ifndef __ADCNOISE_H__
+#define __ADCNOISE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** @brief Sample sets of a window as a power of two, 4096 take ~0.2s */
+#define ADCNOISE_WINDOW_SHIFT  (12)
+#define ADCNOISE_WINDOW        (1 << ADCNOISE_WINDOW_SHIFT)
+
+/** @brief Histogram bins, bin ADCNOISE_BINS / 2 holds the center code */
+#define ADCNOISE_BINS  (16)
+
+/** @brief Fractional bits of the standard deviation */
+#define ADCNOISE_FRAC_BITS  (8)
+
+/** @brief Users of the noise windows, the hook runs while any is set */
+#define ADCNOISE_USER_SCREEN  (1 << 0)
+#define ADCNOISE_USER_HOST    (1 << 1)
+
+/** @brief Channels, in the order of cmd_cal_data */
+typedef enum {
+    adcnoise_v_out = 0,
+    adcnoise_v_in,
+    adcnoise_i_out,
+    adcnoise_channels
+} adcnoise_channel_t;
+
+/**
+ * @brief One channel of a full window in raw ADC codes
+ */
+typedef struct {
+    uint16_t center;                /** Code of the center bin */
+    uint16_t min;                   /** Smallest code */
+    uint16_t max;                   /** Largest code */
+    uint32_t mean;                  /** Mean code in Q16.16 */
+    uint32_t stddev;                /** Standard deviation with ADCNOISE_FRAC_BITS */
+    uint16_t hist[ADCNOISE_BINS];   /** Samples per code, center - ADCNOISE_BINS / 2 first */
+} adcnoise_stats_t;
+
+/**
+ * @brief The last full window
+ */
+typedef struct {
+    uint32_t windows;               /** Windows completed since enabled */
+    uint32_t samples;               /** Sample sets in the window */
+    adcnoise_stats_t ch[adcnoise_channels];
+} adcnoise_t;
+
+/**
+ * @brief Start or stop collecting for a user
+ *
+ * @param[in] user ADCNOISE_USER_*
+ * @param[in] enable true to start, false to stop
+ * @note Windows are collected from the first user starting until the last
+ *       one stops, starting again drops the windows collected before
+ */
+void adcnoise_enable(uint8_t user, bool enable);
+
+/**
+ * @brief Check if any user collects
+ *
+ * @return true if the hook is set
+ */
+bool adcnoise_enabled(void);
+
+/**
+ * @brief Add one sample set, the hook of the isrhook_adcnoise slot
+ *
+ * @param[in] i_raw Raw I_out, offset corrected
+ * @param[in] v_in_raw Raw V_in
+ * @param[in] v_out_raw Raw V_out
+ */
+void adcnoise_sample(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw);
+
+/**
+ * @brief Get the last full window
+ *
+ * @param[out] noise The window, all 0 when none has completed
+ * @return false if no window has completed since enabling
+ */
+bool adcnoise_get(adcnoise_t *noise);
+
+#endif // __ADCNOISE_H__
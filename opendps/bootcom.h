@@ -72,6 +72,12 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/**
+ * @brief bootcom_put() w1 of DPSBoot starting the app, w2 is the time in ms
+ *        the bootloader ran
+ */
+#define BOOTCOM_BOOT_TIME  (0xb0071e5d)
+
 /**
  * @brief Write data to the bootcom buffer
  *
@@ -0,0 +1,94 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "cal_lut.h"
+
+/**
+ * @brief      Interpolate between the two points around x
+ *
+ * @param[in]  xs     Input column, strictly increasing
+ * @param[in]  ys     Output column
+ * @param[in]  count  Number of points, at least 2
+ * @param[in]  x      Input value with shift fractional bits
+ * @param[in]  shift  Number of fractional bits in x
+ *
+ * @return     Output value rounded to the nearest integer
+ */
+static int32_t interpolate(const uint16_t *xs, const uint16_t *ys, uint32_t count, uint32_t x, uint32_t shift)
+{
+    /** Find the segment [lo, hi] holding x, the end segments extend outwards */
+    uint32_t lo = 0, hi = count - 1;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if ((uint32_t) xs[mid] << shift <= x) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    int32_t dx = (int32_t) (xs[hi] - xs[lo]) << shift;
+    int32_t dy = (int32_t) ys[hi] - ys[lo];
+    int64_t num = ((int64_t) x - ((int64_t) xs[lo] << shift)) * dy;
+    num += num < 0 ? -dx / 2 : dx / 2;
+    /** Keep off the 64 bit division library call when we can */
+    if (num >= INT32_MIN && num <= INT32_MAX) {
+        return ys[lo] + (int32_t) num / dx;
+    }
+    return ys[lo] + num / dx;
+}
+
+bool cal_lut_load(cal_lut_t *lut, const void *data, uint32_t length)
+{
+    uint32_t count = length / CAL_LUT_POINT_SIZE;
+    const uint8_t *p = data;
+    lut->count = 0;
+    if (length % CAL_LUT_POINT_SIZE || count < 2 || count > CAL_LUT_MAX_POINTS) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t point[2];
+        memcpy(point, &p[i * CAL_LUT_POINT_SIZE], sizeof(point));
+        if (i > 0 && (point[0] <= lut->x[i - 1] || point[1] <= lut->y[i - 1])) {
+            return false;
+        }
+        lut->x[i] = point[0];
+        lut->y[i] = point[1];
+    }
+    /** Set last, a reader sees either no table or a complete one */
+    lut->count = count;
+    return true;
+}
+
+int32_t cal_lut_apply(const cal_lut_t *lut, uint32_t x, uint32_t shift)
+{
+    return interpolate(lut->x, lut->y, lut->count, x, shift);
+}
+
+int32_t cal_lut_invert(const cal_lut_t *lut, uint32_t y)
+{
+    return interpolate(lut->y, lut->x, lut->count, y, 0);
+}
@@ -0,0 +1,94 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file cal_lut.h
+ * @brief Piecewise Linear Calibration Tables
+ *
+ * A table of up to CAL_LUT_MAX_POINTS (x, y) points replacing the single
+ * k * x + c model of a calibration channel where the hardware is not linear
+ * enough, typically I_out at low currents. Values between two points are
+ * interpolated, values outside the table are extrapolated from the first or
+ * last segment.
+ *
+ * Both x and y must be strictly increasing so the table can be evaluated in
+ * either direction, y from x with cal_lut_apply() and x from y with
+ * cal_lut_invert(). Evaluation uses integers only and is safe to call from
+ * interrupt context.
+ *
+ * Tables are stored in past as CAL_LUT_POINT_SIZE bytes per point, x then y,
+ * both 16 bit in native byte order.
+ */
+
+#ifndef __CAL_LUT_H__
+#define __CAL_LUT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** @brief Maximum number of points in a table */
+#define CAL_LUT_MAX_POINTS  (12)
+
+/** @brief Size in bytes of one stored point */
+#define CAL_LUT_POINT_SIZE  (4)
+
+/**
+ * @brief A calibration table, unused when count is 0
+ */
+typedef struct {
+    uint8_t count;                    /**< Number of points, 0 or 2..CAL_LUT_MAX_POINTS */
+    uint16_t x[CAL_LUT_MAX_POINTS];   /**< Input values, strictly increasing */
+    uint16_t y[CAL_LUT_MAX_POINTS];   /**< Output values, strictly increasing */
+} cal_lut_t;
+
+/**
+ * @brief Load a table from its stored form
+ *
+ * @param lut    The table, cleared if the data is not a valid table
+ * @param data   Stored points, [x:16] [y:16] per point
+ * @param length Length of data in bytes
+ * @return true if the data was a valid table
+ */
+bool cal_lut_load(cal_lut_t *lut, const void *data, uint32_t length);
+
+/**
+ * @brief Get y for x
+ *
+ * @param lut   The table, must have points
+ * @param x     Input value with shift fractional bits
+ * @param shift Number of fractional bits in x
+ * @return y rounded to the nearest integer, may be negative when extrapolated
+ */
+int32_t cal_lut_apply(const cal_lut_t *lut, uint32_t x, uint32_t shift);
+
+/**
+ * @brief Get x for y
+ *
+ * @param lut The table, must have points
+ * @param y   Output value
+ * @return x rounded to the nearest integer, may be negative when extrapolated
+ */
+int32_t cal_lut_invert(const cal_lut_t *lut, uint32_t y);
+
+#endif // __CAL_LUT_H__
@@ -0,0 +1,277 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "clone.h"
+#include "crc16.h"
+#include "pastunits.h"
+
+/** Bytes before the units and of a unit header */
+#define BLOB_HEADER_SIZE  (2)
+#define UNIT_HEADER_SIZE  (6)
+
+/** Units that fit in the count byte of the blob */
+#define MAX_UNITS  (255)
+
+/** Writes the blob, keeping the bytes that fall in the requested window */
+typedef struct {
+    uint32_t pos;       /** Offset of the next byte in the blob */
+    uint32_t offset;    /** Start of the window */
+    uint32_t size;      /** Size of the window */
+    uint32_t copied;    /** Bytes copied to buf */
+    uint8_t *buf;
+    uint16_t crc;
+} emitter_t;
+
+/** Parts of the blob, in the order they are received */
+typedef enum {
+    part_header = 0,
+    part_unit_header,
+    part_unit_data,
+    part_crc,
+    part_done,
+} part_t;
+
+/** State of the import, kept between chunks */
+static struct {
+    uint32_t offset;    /** Expected offset of the next chunk */
+    part_t part;
+    uint32_t have;      /** Bytes of the current part received */
+    uint32_t units_left;
+    uint16_t crc;       /** Of everything before the CRC */
+    uint8_t head[UNIT_HEADER_SIZE];
+    past_id_t id;
+    uint32_t length;
+    uint32_t data[PAST_STAGE_DATA_SIZE / 4];
+} import;
+
+bool clone_unit_in_scope(past_id_t id)
+{
+    if (id == past_power || id == past_tft_inversion || id == past_tft_brightness ||
+        id == past_headless || id == past_adc_profile) {
+        return true;
+    }
+    if (id >= past_preset_0 && id < past_preset_0 + 16) {
+        return true;
+    }
+    /** (SCREEN_ID << 24) | unit, staged copies have bits in the middle */
+    return (id >> 24) != 0 && (id & 0x00ffff00) == 0;
+}
+
+/**
+  * @brief Check if a stored unit goes into the snapshot
+  * @param id the unit id
+  * @param length length of the unit
+  * @retval true if it is exported and can be imported
+  */
+static bool exported(past_id_t id, uint32_t length)
+{
+    return clone_unit_in_scope(id) && length > 0 && length <= PAST_STAGE_DATA_SIZE;
+}
+
+/**
+  * @brief Add bytes to the blob
+  * @param e the emitter
+  * @param data the bytes
+  * @param length number of bytes
+  * @retval None
+  */
+static void emit(emitter_t *e, const uint8_t *data, uint32_t length)
+{
+    e->crc = crc16_add_bytes(e->crc, data, length);
+    for (uint32_t i = 0; i < length; i++, e->pos++) {
+        if (e->pos >= e->offset && e->pos - e->offset < e->size) {
+            e->buf[e->copied++] = data[i];
+        }
+    }
+}
+
+uint32_t clone_export(past_t *past, uint32_t offset, uint8_t *buf, uint32_t size, uint32_t *total)
+{
+    emitter_t e = { .offset = offset, .size = size, .buf = buf };
+    past_iter_t iter;
+    past_id_t id;
+    const void *data;
+    uint32_t length;
+    uint32_t count = 0;
+
+    past_iter_init(past, &iter);
+    while (past_iter_next(past, &iter, &id, &data, &length)) {
+        if (exported(id, length) && count < MAX_UNITS) {
+            count++;
+        }
+    }
+    uint8_t head[UNIT_HEADER_SIZE] = { CLONE_VERSION, count };
+    emit(&e, head, BLOB_HEADER_SIZE);
+
+    past_iter_init(past, &iter);
+    while (count && past_iter_next(past, &iter, &id, &data, &length)) {
+        if (!exported(id, length)) {
+            continue;
+        }
+        head[0] = id >> 24;
+        head[1] = id >> 16;
+        head[2] = id >> 8;
+        head[3] = id;
+        head[4] = length >> 8;
+        head[5] = length;
+        emit(&e, head, UNIT_HEADER_SIZE);
+        emit(&e, (const uint8_t*) data, length);
+        count--;
+    }
+    uint16_t crc = e.crc;
+    head[0] = crc >> 8;
+    head[1] = crc;
+    emit(&e, head, 2);
+    *total = e.pos;
+    return e.copied;
+}
+
+/**
+  * @brief Stage an erase of every unit of the scope the snapshot did not have
+  * @param past the past
+  * @retval false if staging failed
+  */
+static bool stage_erase_missing(past_t *past)
+{
+    past_iter_t iter;
+    past_id_t id;
+    const void *data;
+    uint32_t length;
+    bool restart;
+    do {
+        /** Staging adds units, start the walk over after each one */
+        restart = false;
+        past_iter_init(past, &iter);
+        while (past_iter_next(past, &iter, &id, &data, &length)) {
+            if (clone_unit_in_scope(id) &&
+                !past_read_unit(past, id | PAST_STAGED_BIT, &data, &length) &&
+                !past_read_unit(past, id | PAST_STAGED_BIT | PAST_STAGED_ERASE_BIT, &data, &length)) {
+                if (!past_stage_unit(past, id, NULL, 0)) {
+                    return false;
+                }
+                restart = true;
+                break;
+            }
+        }
+    } while (restart);
+    return true;
+}
+
+/**
+  * @brief Feed one byte of the blob to the import
+  * @param past the past
+  * @param byte the byte
+  * @retval clone_ok or the reason the import failed
+  */
+static clone_status_t import_byte(past_t *past, uint8_t byte)
+{
+    uint8_t *data = (uint8_t*) import.data;
+    if (import.part != part_crc && import.part != part_done) {
+        import.crc = crc16_add(import.crc, byte);
+    }
+    switch (import.part) {
+        case part_header:
+            import.head[import.have++] = byte;
+            if (import.have == BLOB_HEADER_SIZE) {
+                if (import.head[0] != CLONE_VERSION) {
+                    return clone_err_format;
+                }
+                import.units_left = import.head[1];
+                import.part = import.units_left ? part_unit_header : part_crc;
+                import.have = 0;
+            }
+            break;
+        case part_unit_header:
+            import.head[import.have++] = byte;
+            if (import.have == UNIT_HEADER_SIZE) {
+                import.id = (uint32_t) import.head[0] << 24 | (uint32_t) import.head[1] << 16 |
+                            (uint32_t) import.head[2] << 8 | import.head[3];
+                import.length = (uint32_t) import.head[4] << 8 | import.head[5];
+                if (!exported(import.id, import.length)) {
+                    return clone_err_unit;
+                }
+                import.part = part_unit_data;
+                import.have = 0;
+            }
+            break;
+        case part_unit_data:
+            data[import.have++] = byte;
+            if (import.have == import.length) {
+                if (!past_stage_unit(past, import.id, import.data, import.length)) {
+                    return clone_err_flash;
+                }
+                import.part = --import.units_left ? part_unit_header : part_crc;
+                import.have = 0;
+            }
+            break;
+        case part_crc:
+            import.head[import.have++] = byte;
+            if (import.have == 2) {
+                if (((uint16_t) import.head[0] << 8 | import.head[1]) != import.crc) {
+                    return clone_err_crc;
+                }
+                import.part = part_done;
+            }
+            break;
+        case part_done:
+            return clone_err_format;
+    }
+    return clone_ok;
+}
+
+clone_status_t clone_import(past_t *past, uint32_t offset, const uint8_t *data, uint32_t count, bool commit)
+{
+    clone_status_t status = clone_ok;
+    if (offset == 0) {
+        memset(&import, 0, sizeof(import));
+        if (!past_abort(past)) {
+            return clone_err_flash;
+        }
+    } else if (offset != import.offset) {
+        /** A repeated or lost chunk, the import still expects import.offset */
+        return clone_err_offset;
+    }
+    for (uint32_t i = 0; status == clone_ok && i < count; i++) {
+        status = import_byte(past, data[i]);
+    }
+    import.offset = offset + count;
+    if (status == clone_ok && commit) {
+        if (import.part != part_done) {
+            status = clone_err_crc;
+        } else if (!stage_erase_missing(past) || !past_commit(past)) {
+            status = clone_err_flash;
+        } else {
+            import.offset = 0;
+        }
+    }
+    if (status != clone_ok) {
+        /** Nothing more is accepted until a chunk at offset 0 */
+        import.offset = 0xffffffff;
+        (void) past_abort(past);
+    }
+    return status;
+}
@@ -0,0 +1,120 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+/**
+ * @file clone.h
+ * @brief Binary snapshot of the settings for cloning units
+ *
+ * Serializes the user settings kept in past - the power setting, TFT
+ * inversion, brightness, headless mode and ADC profile, the presets and the
+ * settings of every function screen - into one blob that is written to
+ * other units as a whole.
+ * Calibration, git hashes and upgrade state belong to the unit and are
+ * neither exported nor touched by an import.
+ *
+ * ## Format
+ *
+ * Big endian, the CRC covers all bytes before it:
+ * ```
+ * [version:8] [count:8] ([id:32] [length:16] [data]) * count [crc16:16]
+ * ```
+ *
+ * ## Import
+ *
+ * Chunks are written in order from offset 0, each unit is staged in past
+ * as soon as it is complete (see past_stage_unit()). Once the last chunk is
+ * in and the CRC matches, units of the scope that are not in the blob are
+ * staged for erasing and past_commit() makes the whole snapshot take effect
+ * at once. A reset or an error before the commit leaves the settings as
+ * they were. The running functions do not reread past, the device is reset
+ * after a successful import.
+ *
+ * @note Enabled by CONFIG_CLONE, costs PAST_STAGE_DATA_SIZE bytes of RAM
+ */
+
+#ifndef __CLONE_H__
+#define __CLONE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "past.h"
+
+/** @brief Version of the blob format */
+#define CLONE_VERSION  (1)
+
+/**
+ * @brief Outcome of clone_import()
+ */
+typedef enum {
+    clone_ok = 0,       /**< Chunk accepted, or snapshot committed */
+    clone_err_offset,   /**< Chunk not at the end of the previous one */
+    clone_err_format,   /**< Wrong version or data beyond the CRC */
+    clone_err_unit,     /**< A unit outside of the scope or too long */
+    clone_err_crc,      /**< CRC mismatch or the blob is incomplete */
+    clone_err_flash,    /**< Staging or committing failed, past is full */
+} clone_status_t;
+
+/**
+ * @brief Check if a unit is part of a snapshot
+ *
+ * @param id  The unit id
+ * @return true for the power and display settings, presets and screen units
+ */
+bool clone_unit_in_scope(past_id_t id);
+
+/**
+ * @brief Read a window of the snapshot of the current settings
+ *
+ * The blob is serialized again by each call, no RAM buffer is needed. A
+ * setting changed between two calls gives the host a blob with a bad CRC.
+ *
+ * @param[in]  past    Initialized PAST structure
+ * @param[in]  offset  Offset of the window in the blob
+ * @param[out] buf     Receives the bytes of the window
+ * @param[in]  size    Size of the window
+ * @param[out] total   Receives the length of the whole blob
+ * @return number of bytes copied to buf, 0 past the end
+ */
+uint32_t clone_export(past_t *past, uint32_t offset, uint8_t *buf, uint32_t size, uint32_t *total);
+
+/**
+ * @brief Write a chunk of a snapshot
+ *
+ * A chunk at offset 0 starts a new import, dropping anything staged by an
+ * unfinished one. A chunk at another offset than the end of the previous
+ * one is ignored, any other error drops the staged units and the import
+ * has to start over.
+ *
+ * @param[in] past    Initialized PAST structure
+ * @param[in] offset  Offset of the chunk in the blob
+ * @param[in] data    The chunk
+ * @param[in] count   Number of bytes in the chunk
+ * @param[in] commit  This is the last chunk, check the CRC and commit
+ * @return clone_ok or the reason the import failed
+ */
+clone_status_t clone_import(past_t *past, uint32_t offset, const uint8_t *data, uint32_t count, bool commit);
+
+#endif // __CLONE_H__
@@ -32,6 +32,9 @@
 #include "hw.h"
 #include "pwrctl.h"
 #include "serialhandler.h"
+#ifdef CONFIG_STACK_MONITOR
+#include "stackmon.h"
+#endif // CONFIG_STACK_MONITOR
 
 extern void opendps_update_power_status(bool enabled); // opendps.c
 
@@ -39,6 +42,9 @@ static void stat_cmd(uint32_t argc, char *argv[]);
 static void on_cmd(uint32_t argc, char *argv[]);
 static void off_cmd(uint32_t argc, char *argv[]);
 static void v_cmd(uint32_t argc, char *argv[]);
+#ifdef CONFIG_STACK_MONITOR
+static void ram_cmd(uint32_t argc, char *argv[]);
+#endif // CONFIG_STACK_MONITOR
 
 
 static const cli_command_t commands[] = {
@@ -70,6 +76,15 @@ static const cli_command_t commands[] = {
         .help = "Set output <voltage> mV",
         .usage = "<millivolt>",
     },
+#ifdef CONFIG_STACK_MONITOR
+    {
+        .cmd = "ram",
+        .handler = &ram_cmd,
+        .min_arg = 0, .max_arg = 0,
+        .help = "Print RAM usage and the stack high water mark",
+        .usage = "",
+    },
+#endif // CONFIG_STACK_MONITOR
   };
 
 
@@ -143,3 +158,17 @@ static void v_cmd(uint32_t argc, char *argv[])
     dbg_printf("Setting V_out to %umv\n", v_out);
     pwrctl_set_vout(v_out);
 }
+
+#ifdef CONFIG_STACK_MONITOR
+static void ram_cmd(uint32_t argc, char *argv[])
+{
+    (void) argc;
+    (void) argv;
+    ram_stats_t stats;
+    stackmon_get(&stats);
+    dbg_printf(" .data    : %u bytes\n", stats.data_bytes);
+    dbg_printf(" .bss     : %u bytes\n", stats.bss_bytes);
+    dbg_printf(" .ramfunc : %u bytes\n", stats.ramfunc_bytes);
+    dbg_printf(" stack    : %u of %u bytes used, %u free\n", stats.stack_peak, stats.stack_bytes, stats.stack_bytes - stats.stack_peak);
+}
+#endif // CONFIG_STACK_MONITOR
@@ -38,6 +38,16 @@
  * - Output reflection: No
  * - Final XOR: 0x0000
  *
+ * ## Implementation
+ *
+ * CONFIG_CRC16_TABLE selects how each byte is folded into the CRC:
+ * - 0: computed with shifts and XORs, no table (default)
+ * - 4: two lookups in a 16 entry nibble table (32 bytes of flash)
+ * - 8: one lookup in a 256 entry byte table (512 bytes of flash)
+ *
+ * All variants produce the same CRC, tests/crc16_test.c checks them against
+ * each other and reports their speed.
+ *
  * ## Usage
  *
  * ### Block CRC (all data available)
@@ -93,6 +103,18 @@
  */
 uint16_t crc16_add(uint16_t crc, uint8_t byte);
 
+/**
+ * @brief Add a block of bytes to a running CRC-16
+ *
+ * Same as calling crc16_add() for each byte, without the call per byte.
+ *
+ * @param[in] crc    CRC calculated so far (0 to start)
+ * @param[in] data   Pointer to the data
+ * @param[in] length Number of bytes
+ * @return CRC after adding the bytes
+ */
+uint16_t crc16_add_bytes(uint16_t crc, const uint8_t *data, uint32_t length);
+
 /**
  * @brief Calculate CRC-16 checksum of a data buffer
  *
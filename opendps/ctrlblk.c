@@ -0,0 +1,70 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+#ifndef DPS_EMULATOR
+ #include <cortex.h>
+#endif // DPS_EMULATOR
+#include "ctrlblk.h"
+
+void ctrlblk_init(ctrlblk_t *cb, void *first, void *other, uint32_t size)
+{
+    memcpy(other, first, size);
+    cb->front = first;
+    cb->back = other;
+    cb->size = size;
+    cb->version = 0;
+    cb->irq_masked = false;
+#ifdef DPS_EMULATOR
+    pthread_mutex_init(&cb->mutex, NULL);
+#endif // DPS_EMULATOR
+}
+
+void *ctrlblk_begin(ctrlblk_t *cb)
+{
+#ifdef DPS_EMULATOR
+    pthread_mutex_lock(&cb->mutex);
+#else // DPS_EMULATOR
+    /** A writer in an ISR may preempt us, but not the other way round */
+    bool masked = cm_mask_interrupts(true);
+    cb->irq_masked = masked;
+#endif // DPS_EMULATOR
+    memcpy(cb->back, cb->front, cb->size);
+    return cb->back;
+}
+
+void ctrlblk_publish(ctrlblk_t *cb)
+{
+    void *front = cb->back;
+    cb->back = cb->front;
+    /** The fields must be in memory before readers can find them */
+    __sync_synchronize();
+    cb->front = front;
+    cb->version++;
+#ifdef DPS_EMULATOR
+    pthread_mutex_unlock(&cb->mutex);
+#else // DPS_EMULATOR
+    (void) cm_mask_interrupts(cb->irq_masked);
+#endif // DPS_EMULATOR
+}
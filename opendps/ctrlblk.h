@@ -0,0 +1,149 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file ctrlblk.h
+ * @brief Double buffered control block shared with ISRs
+ *
+ * A control block is a struct of parameters that the main loop (or an ISR)
+ * writes and ISRs read. It is kept twice: readers use the front copy while a
+ * writer fills the back copy, which is then published with one pointer
+ * store. A reader that fetches the front pointer once sees a consistent set
+ * of fields, without disabling interrupts, however many fields the writer
+ * changed.
+ *
+ * ```c
+ * typedef struct { uint32_t limit; uint32_t setpoint; } params_t;
+ * static params_t params[2];
+ * ctrlblk_t ctrl = CTRLBLK_INIT(&params[0], &params[1]);
+ *
+ * // Writer:
+ * params_t *p = ctrlblk_begin(&ctrl);
+ * p->limit = 100;
+ * p->setpoint = 50;
+ * ctrlblk_publish(&ctrl);
+ *
+ * // Reader, in an ISR:
+ * const params_t *p = ctrlblk_read(&ctrl);
+ * ```
+ *
+ * Writers are serialised by masking interrupts from ctrlblk_begin() to
+ * ctrlblk_publish(), which is the time to copy the block and store the new
+ * fields. Do the calculations before ctrlblk_begin(). A reader must not hold
+ * on to the front pointer once it returns to a context a writer may run in.
+ */
+
+#ifndef __CTRLBLK_H__
+#define __CTRLBLK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef DPS_EMULATOR
+ #include <pthread.h>
+#endif // DPS_EMULATOR
+
+/**
+ * @brief Control block structure
+ *
+ * The two copies are allocated by the caller.
+ */
+typedef struct {
+    void * volatile front;      /**< Copy the readers use */
+    void *back;                 /**< Copy the writer fills */
+    uint32_t size;              /**< Size of one copy in bytes */
+    volatile uint32_t version;  /**< Incremented by every publish */
+    bool irq_masked;            /**< Interrupt mask state before ctrlblk_begin() */
+#ifdef DPS_EMULATOR
+    pthread_mutex_t mutex;      /**< Serialises writers in the emulator */
+#endif // DPS_EMULATOR
+} ctrlblk_t;
+
+/**
+ * @brief Static initializer, for blocks ISRs read before any code has run
+ *
+ * @param first Copy holding the initial values, becomes the front copy
+ * @param other The second copy, must hold the same values
+ */
+#ifdef DPS_EMULATOR
+ #define CTRLBLK_INIT(first, other) \
+    { .front = (first), .back = (other), .size = sizeof(*(first)), .mutex = PTHREAD_MUTEX_INITIALIZER }
+#else // DPS_EMULATOR
+ #define CTRLBLK_INIT(first, other) \
+    { .front = (first), .back = (other), .size = sizeof(*(first)) }
+#endif // DPS_EMULATOR
+
+/**
+ * @brief Initialize a control block
+ *
+ * @param cb    The control block
+ * @param first Copy holding the initial values, becomes the front copy
+ * @param other The second copy
+ * @param size  Size of one copy in bytes
+ */
+void ctrlblk_init(ctrlblk_t *cb, void *first, void *other, uint32_t size);
+
+/**
+ * @brief Start changing the control block
+ *
+ * Masks interrupts and returns the back copy, filled with the current
+ * values. Must be followed by ctrlblk_publish().
+ *
+ * @param cb The control block
+ * @return The copy to write the new values to
+ */
+void *ctrlblk_begin(ctrlblk_t *cb);
+
+/**
+ * @brief Make the changes since ctrlblk_begin() visible to readers
+ *
+ * @param cb The control block
+ */
+void ctrlblk_publish(ctrlblk_t *cb);
+
+/**
+ * @brief Get the current values
+ *
+ * @param cb The control block
+ * @return The front copy, valid until the reader can be preempted by a writer
+ */
+static inline const void *ctrlblk_read(const ctrlblk_t *cb)
+{
+    return cb->front;
+}
+
+/**
+ * @brief Get the number of publishes so far
+ *
+ * Lets a reader tell if anything changed since it last looked.
+ *
+ * @param cb The control block
+ * @return The version
+ */
+static inline uint32_t ctrlblk_version(const ctrlblk_t *cb)
+{
+    return cb->version;
+}
+
+#endif // __CTRLBLK_H__
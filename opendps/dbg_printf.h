@@ -35,6 +35,7 @@
  * | Define | dbg_printf | emu_printf |
  * |--------|------------|------------|
  * | DPS_EMULATOR | printf | printf |
+ * | CONFIG_DEFERRED_LOG | RAM ring, see dbglog.h | no-op |
  * | CONFIG_DEBUG | UART output | no-op |
  * | (none) | no-op | no-op |
  *
@@ -48,6 +49,7 @@
  * ## Output Destination
  *
  * - **Emulator**: Standard output (console)
+ * - **Hardware with CONFIG_DEFERRED_LOG**: cmd_log frames, decoded by dpsctl --log
  * - **Hardware with CONFIG_DEBUG**: UART serial port
  * - **Release build**: No output (macros expand to nothing)
  *
@@ -76,7 +78,18 @@
   */
  #define emu_printf printf
 #else // DPS_EMULATOR
- #ifdef CONFIG_DEBUG
+ #if defined(CONFIG_DEFERRED_LOG)
+  #include "dbglog.h"
+  /**
+   * @brief Debug printf - records the format string and arguments
+   *
+   * Nothing is formatted on the DPS, the format must be a string literal
+   * and the arguments at most 32 bits each.
+   */
+  #define dbg_printf(fmt, ...) dbglog_write(fmt, DBGLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__)
+  /** @brief No-op in non-emulator builds */
+  #define emu_printf(...)
+ #elif defined(CONFIG_DEBUG)
   /**
    * @brief Debug printf function
    *
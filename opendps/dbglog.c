@@ -0,0 +1,88 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <cortex.h>
+#include "dbglog.h"
+
+#if CONFIG_DBGLOG_WORDS & (CONFIG_DBGLOG_WORDS - 1)
+ #error "CONFIG_DBGLOG_WORDS must be a power of two"
+#endif
+
+#define RING_MASK (CONFIG_DBGLOG_WORDS - 1)
+
+static uint32_t ring[CONFIG_DBGLOG_WORDS];
+/** Free running indices, the ring holds head - tail words */
+static uint32_t head, tail;
+static uint32_t dropped;
+
+void dbglog_write(const char *fmt, uint32_t nargs, ...)
+{
+    va_list va;
+    if (nargs > DBGLOG_MAX_ARGS) {
+        nargs = DBGLOG_MAX_ARGS;
+    }
+    /** May be called from an ISR, keep the entry in one piece */
+    bool masked = cm_mask_interrupts(true);
+    if (CONFIG_DBGLOG_WORDS - (head - tail) < 1 + nargs) {
+        dropped++;
+    } else {
+        ring[head++ & RING_MASK] = ((uint32_t) (uintptr_t) fmt & DBGLOG_ADDR_MASK) |
+                                   (nargs << DBGLOG_NARGS_SHIFT);
+        va_start(va, nargs);
+        for (uint32_t i = 0; i < nargs; i++) {
+            ring[head++ & RING_MASK] = va_arg(va, uint32_t);
+        }
+        va_end(va);
+    }
+    (void) cm_mask_interrupts(masked);
+}
+
+uint32_t dbglog_read(uint32_t *words, uint32_t max)
+{
+    uint32_t count = 0;
+    bool masked = cm_mask_interrupts(true);
+    while (head != tail) {
+        uint32_t size = 1 + (ring[tail & RING_MASK] >> DBGLOG_NARGS_SHIFT);
+        if (count + size > max) {
+            break;
+        }
+        for (uint32_t i = 0; i < size; i++) {
+            words[count++] = ring[tail++ & RING_MASK];
+        }
+    }
+    (void) cm_mask_interrupts(masked);
+    return count;
+}
+
+uint32_t dbglog_take_dropped(void)
+{
+    bool masked = cm_mask_interrupts(true);
+    uint32_t count = dropped;
+    dropped = 0;
+    (void) cm_mask_interrupts(masked);
+    return count;
+}
@@ -0,0 +1,89 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file dbglog.h
+ * @brief Deferred, binary debug log
+ *
+ * dbg_printf() used to format the message with mini_vsnprintf and push it
+ * out of USART1 one blocking byte at a time, which both stalls the caller
+ * for several milliseconds and mangles any protocol frame in flight. With
+ * CONFIG_DEFERRED_LOG, dbg_printf() instead records the address of its
+ * format string and its raw arguments in a RAM ring, which takes a few
+ * microseconds and may be done from an ISR. The protocol handler drains the
+ * ring from the main loop as cmd_log frames and dpsctl --log formats the
+ * messages on the host using the format strings in the firmware image.
+ *
+ * An entry is a header word followed by one word per argument. The header
+ * holds the format string address in bits 0..27 and the argument count in
+ * bits 28..31, flash and RAM both being below 0x10000000. Arguments are
+ * stored as 32 bit words, so %s must point to a string in flash to be
+ * decoded. An entry that does not fit is dropped whole and counted.
+ */
+
+#ifndef __DBGLOG_H__
+#define __DBGLOG_H__
+
+#include <stdint.h>
+
+/** Size of the ring in 32 bit words, a power of two */
+#ifndef CONFIG_DBGLOG_WORDS
+ #define CONFIG_DBGLOG_WORDS (64)
+#endif // CONFIG_DBGLOG_WORDS
+
+/** Most arguments an entry can hold */
+#define DBGLOG_MAX_ARGS (7)
+
+/** Fields of the entry header word */
+#define DBGLOG_ADDR_MASK   (0x0fffffff)
+#define DBGLOG_NARGS_SHIFT (28)
+
+/** Count the arguments of a call at compile time, 0..DBGLOG_MAX_ARGS */
+#define DBGLOG_NARGS(...) DBGLOG_NARGS_(0, ##__VA_ARGS__, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DBGLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, n, ...) n
+
+/**
+  * @brief Record a log entry
+  * @param fmt format string, a literal in flash
+  * @param nargs number of arguments that follow
+  * @param ... the arguments, each at most 32 bits
+  * @retval none
+  */
+void dbglog_write(const char *fmt, uint32_t nargs, ...);
+
+/**
+  * @brief Take whole entries from the ring
+  * @param words where to store the entries
+  * @param max room in words, at least 1 + DBGLOG_MAX_ARGS to make progress
+  * @retval uint32_t number of words stored
+  */
+uint32_t dbglog_read(uint32_t *words, uint32_t max);
+
+/**
+  * @brief Number of entries dropped since the last call
+  * @retval uint32_t dropped entries, the count is cleared
+  */
+uint32_t dbglog_take_dropped(void);
+
+#endif // __DBGLOG_H__
@@ -0,0 +1,94 @@
+/**
+  * This file was auto-generated by gen_model.py from dps-model.h!
+  *
+  * Default calibration coefficients of each model in Q16.16 fixed point,
+  * letting pwrctl.c fold the conversions of uncalibrated channels at
+  * compile time. Run make model after changing dps-model.h.
+  */
+
+#ifndef __DPS_MODEL_FIX_H__
+#define __DPS_MODEL_FIX_H__
+
+#if defined(DPS5020)
+ #define A_ADC_K_FIX (442662)
+ #define A_ADC_C_FIX (-23509730)
+ #define A_DAC_K_FIX (10870)
+ #define A_DAC_C_FIX (15977218)
+ #define V_ADC_K_FIX (871170)
+ #define V_ADC_C_FIX (-11790582)
+ #define V_DAC_K_FIX (4934)
+ #define V_DAC_C_FIX (438402)
+ #define VIN_ADC_K_FIX (1111228)
+ #define VIN_ADC_C_FIX (438403)
+ #define A_ADC_K_INV_FIX (9703)
+ #define V_ADC_K_INV_FIX (4930)
+#elif defined(DPS5015)
+ #define A_ADC_K_FIX (448286)
+ #define A_ADC_C_FIX (-25825116)
+ #define A_DAC_K_FIX (10923)
+ #define A_DAC_C_FIX (17148582)
+ #define V_ADC_K_FIX (852754)
+ #define V_ADC_C_FIX (-8239973)
+ #define V_DAC_K_FIX (4736)
+ #define V_DAC_C_FIX (291293)
+ #define VIN_ADC_K_FIX (1097466)
+ #define VIN_ADC_C_FIX (4201644)
+ #define A_ADC_K_INV_FIX (9581)
+ #define V_ADC_K_INV_FIX (5037)
+#elif defined(DPS5005)
+ #define A_ADC_K_FIX (112263)
+ #define A_ADC_C_FIX (-7766672)
+ #define A_DAC_K_FIX (42729)
+ #define A_DAC_C_FIX (18914410)
+ #define V_ADC_K_FIX (862716)
+ #define V_ADC_C_FIX (-6602818)
+ #define V_DAC_K_FIX (4719)
+ #define V_DAC_C_FIX (121242)
+ #define VIN_ADC_K_FIX (1097466)
+ #define VIN_ADC_C_FIX (4201644)
+ #define A_ADC_K_INV_FIX (38258)
+ #define V_ADC_K_INV_FIX (4978)
+#elif defined(DP50V5A)
+ #define A_ADC_K_FIX (114096)
+ #define A_ADC_C_FIX (-7955702)
+ #define A_DAC_K_FIX (41956)
+ #define A_DAC_C_FIX (19631426)
+ #define V_ADC_K_FIX (868549)
+ #define V_ADC_C_FIX (-6757090)
+ #define V_DAC_K_FIX (4944)
+ #define V_DAC_C_FIX (141315)
+ #define VIN_ADC_K_FIX (1097466)
+ #define VIN_ADC_C_FIX (4201644)
+ #define A_ADC_K_INV_FIX (37644)
+ #define V_ADC_K_INV_FIX (4945)
+#elif defined(DPS3005)
+ #define A_ADC_K_FIX (114754)
+ #define A_ADC_C_FIX (-72155)
+ #define A_DAC_K_FIX (42795)
+ #define A_DAC_C_FIX (17203200)
+ #define V_ADC_K_FIX (860553)
+ #define V_ADC_C_FIX (-7333479)
+ #define V_DAC_K_FIX (4987)
+ #define V_DAC_C_FIX (149796)
+ #define VIN_ADC_K_FIX (1097466)
+ #define VIN_ADC_C_FIX (4201644)
+ #define A_ADC_K_INV_FIX (37428)
+ #define V_ADC_K_INV_FIX (4991)
+#elif defined(DPS3003)
+ #define A_ADC_K_FIX (65324)
+ #define A_ADC_C_FIX (-2904267)
+ #define A_DAC_K_FIX (73733)
+ #define A_DAC_C_FIX (16797008)
+ #define V_ADC_K_FIX (535322)
+ #define V_ADC_C_FIX (-7574782)
+ #define V_DAC_K_FIX (8020)
+ #define V_DAC_C_FIX (667956)
+ #define VIN_ADC_K_FIX (1100330)
+ #define VIN_ADC_C_FIX (1090834)
+ #define A_ADC_K_INV_FIX (65749)
+ #define V_ADC_K_INV_FIX (8023)
+#else
+ #error "Please set MODEL to the device you want to build for"
+#endif // MODEL
+
+#endif // __DPS_MODEL_FIX_H__
@@ -26,7 +26,9 @@
  * - **V_DAC_K, V_DAC_C**: Voltage DAC (DAC = K * V_mV + C)
  * - **VIN_ADC_K, VIN_ADC_C**: Input voltage ADC
  *
- * These defaults can be overridden by calibration stored in PAST.
+ * These defaults can be overridden by calibration stored in PAST. Their Q16.16
+ * fixed point versions are generated into dps-model-fix.h by gen_model.py
+ * (make model) and used by pwrctl.c for channels that are not calibrated.
  *
  * ## Calibration Procedure
  *
@@ -0,0 +1,102 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <cortex.h>
+#include "energy.h"
+#include "pwrctl.h"
+#include "tick.h"
+
+volatile energy_acc_t energy_acc;
+
+/** Output on time of the runs that ended since the last reset */
+static uint64_t run_ms;
+/** When the current run started */
+static uint64_t run_start;
+static bool is_running;
+
+/**
+  * @brief Saturate a value to 32 bits
+  * @param value the value
+  * @retval value clamped to 0..UINT32_MAX
+  */
+static uint32_t saturate(float value)
+{
+    if (value <= 0) {
+        return 0;
+    } else if (value >= (float) UINT32_MAX) {
+        return UINT32_MAX;
+    }
+    return (uint32_t) value;
+}
+
+void energy_run(bool running)
+{
+    uint64_t now = get_ticks();
+    if (running && !is_running) {
+        run_start = now;
+    } else if (!running && is_running) {
+        run_ms += now - run_start;
+    }
+    is_running = running;
+}
+
+void energy_reset(void)
+{
+    /** The ADC ISR may preempt us, but not the other way round */
+    bool masked = cm_mask_interrupts(true);
+    memset((void*) &energy_acc, 0, sizeof(energy_acc));
+    run_ms = 0;
+    run_start = get_ticks();
+    (void) cm_mask_interrupts(masked);
+}
+
+void energy_get(energy_stats_t *stats)
+{
+    energy_acc_t acc;
+    bool masked = cm_mask_interrupts(true);
+    acc = energy_acc;
+    uint64_t ms = run_ms + (is_running ? get_ticks() - run_start : 0);
+    (void) cm_mask_interrupts(masked);
+
+    stats->runtime_ms = ms > UINT32_MAX ? UINT32_MAX : (uint32_t) ms;
+    if (!acc.n) {
+        stats->charge_uah = 0;
+        stats->energy_uwh = 0;
+        return;
+    }
+    float n = (float) acc.n;
+    float i_mean = (float) acc.i_sum / n;
+    float v_mean = (float) acc.v_sum / n;
+    float vi_mean = (float) acc.vi_sum / n;
+    /** mA and mV * mA = uW, see energy.h */
+    float ma = a_adc_k_coef * i_mean + a_adc_c_coef;
+    float uw = v_adc_k_coef * a_adc_k_coef * vi_mean + v_adc_k_coef * a_adc_c_coef * v_mean
+             + v_adc_c_coef * a_adc_k_coef * i_mean + v_adc_c_coef * a_adc_c_coef;
+    /** mA * ms / 3600 = uAh and uW * ms / 3600000 = uWh */
+    stats->charge_uah = saturate(ma * (float) ms / 3600.0f);
+    stats->energy_uwh = saturate(uw * (float) ms / 3600000.0f);
+}
@@ -0,0 +1,107 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file energy.h
+ * @brief Charge and energy delivered on the output
+ *
+ * Available with CONFIG_ENERGY_METER. The ADC ISR adds every raw I_out and
+ * V_out sample taken while the output is on to 64 bit sums through
+ * energy_sample(), so the integration runs at the full ADC rate. The
+ * calibration is linear (raw * k + c) which lets the sums be converted to
+ * mean current and power only when they are read:
+ *
+ *   mean(I)     = k_i * sum(i) / n + c_i
+ *   mean(V * I) = k_v * k_i * sum(v * i) / n + k_v * c_i * sum(v) / n
+ *               + c_v * k_i * sum(i) / n + c_v * c_i
+ *
+ * The charge and energy are the means times the time the output was on,
+ * which pwrctl reports through energy_run(). Read with energy_get(), over
+ * cmd_energy_stats or on the energy screen of the settings UI.
+ */
+
+#ifndef __ENERGY_H__
+#define __ENERGY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Sums of the raw samples, written by the ADC ISR only
+ */
+typedef struct {
+    uint64_t n;         /** Samples */
+    uint64_t i_sum;     /** Sum of raw I_out */
+    uint64_t v_sum;     /** Sum of raw V_out */
+    uint64_t vi_sum;    /** Sum of raw V_out * I_out */
+} energy_acc_t;
+
+/**
+ * @brief Delivered charge and energy since the last reset
+ */
+/** @brief cmd_energy_stats flag, clear the totals after reading */
+#define ENERGY_RESET (1 << 0)
+
+typedef struct {
+    uint32_t charge_uah;    /** Charge in microampere hours */
+    uint32_t energy_uwh;    /** Energy in microwatt hours */
+    uint32_t runtime_ms;    /** Time the output was on */
+} energy_stats_t;
+
+extern volatile energy_acc_t energy_acc;
+
+/**
+ * @brief Add one sample set, called from the ADC ISR while the output is on
+ *
+ * @param[in] i_raw Raw I_out, offset corrected
+ * @param[in] v_raw Raw V_out
+ */
+static inline void energy_sample(uint32_t i_raw, uint16_t v_raw)
+{
+    energy_acc.n++;
+    energy_acc.i_sum += i_raw;
+    energy_acc.v_sum += v_raw;
+    energy_acc.vi_sum += (uint64_t) i_raw * v_raw;
+}
+
+/**
+ * @brief Track the time the output is on, called when it is switched
+ *
+ * @param[in] running true when the output was turned on
+ */
+void energy_run(bool running);
+
+/**
+ * @brief Clear the sums and the runtime
+ */
+void energy_reset(void);
+
+/**
+ * @brief Get the charge and energy delivered since the last reset
+ *
+ * @param[out] stats Filled in with the totals, saturated at UINT32_MAX
+ */
+void energy_get(energy_stats_t *stats);
+
+#endif // __ENERGY_H__
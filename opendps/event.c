@@ -26,14 +26,113 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
-#include "ringbuf.h"
 #include "event.h"
+#include "trace.h"
 
-#define MAX_EVENTS	(64)
+/** Queue sizes, powers of two. UART carries one event per byte without CONFIG_USART_RX_RING */
+#ifndef EVENT_QUEUE_SIZE_BUTTONS
+ #define EVENT_QUEUE_SIZE_BUTTONS	(16)
+#endif
+#ifndef EVENT_QUEUE_SIZE_UART
+ #define EVENT_QUEUE_SIZE_UART		(64)
+#endif
+#ifndef EVENT_QUEUE_SIZE_ADC
+ #define EVENT_QUEUE_SIZE_ADC		(8)
+#endif
+#ifndef EVENT_QUEUE_SIZE_MAIN
+ #define EVENT_QUEUE_SIZE_MAIN		(8)
+#endif
+#ifndef EVENT_QUEUE_SIZE_TIMER
+ #define EVENT_QUEUE_SIZE_TIMER		(4)
+#endif
 
-static ringbuf_t events;
-static uint8_t buffer[2*MAX_EVENTS];
+/** Orders the slot accesses against the index store the other side polls */
+#define event_barrier() __sync_synchronize()
 
+/**
+ * Single producer, single consumer queue. The indices run freely and are
+ * masked on access so all slots can be used. Only the producer writes
+ * 'write' and 'drops', only the consumer writes 'read'. A reset of the
+ * counters remembers 'drops' in 'drops_base' rather than clearing it.
+ */
+typedef struct {
+	volatile uint16_t *buf;
+	uint16_t mask;
+	volatile uint16_t write;
+	volatile uint16_t read;
+	volatile uint16_t peak;
+	volatile uint32_t drops;
+	uint32_t drops_base;
+} event_queue_t;
+
+static uint16_t buttons_buf[EVENT_QUEUE_SIZE_BUTTONS];
+static uint16_t uart_buf[EVENT_QUEUE_SIZE_UART];
+static uint16_t adc_buf[EVENT_QUEUE_SIZE_ADC];
+static uint16_t main_buf[EVENT_QUEUE_SIZE_MAIN];
+static uint16_t timer_buf[EVENT_QUEUE_SIZE_TIMER];
+
+static event_queue_t queues[event_src_count];
+
+/** Sources in the order event_get_class() drains them and their classes */
+static const struct {
+	event_source_t source;
+	event_class_t class;
+} drain_order[event_src_count] = {
+	{ event_src_adc, event_class_safety },
+	{ event_src_uart, event_class_protocol },
+	{ event_src_buttons, event_class_ui },
+	{ event_src_main, event_class_ui },
+	{ event_src_timer, event_class_ui },
+};
+
+static void queue_init(event_queue_t *q, uint16_t *buf, uint16_t size)
+{
+	memset(buf, 0, size * sizeof(*buf));
+	q->buf = buf;
+	q->mask = size - 1;
+	q->write = q->read = 0;
+	q->peak = 0;
+	q->drops = 0;
+	q->drops_base = 0;
+}
+
+/**
+  * @brief Look at the oldest event of a queue without removing it
+  * @param q the queue
+  * @param e the event and data
+  * @retval false if the queue is empty
+  */
+static bool queue_peek(event_queue_t *q, uint16_t *e)
+{
+	uint16_t read = q->read;
+	if (read == q->write) {
+		return false;
+	}
+	event_barrier();
+	*e = q->buf[read & q->mask];
+	return true;
+}
+
+/**
+  * @brief Remove the oldest event of a non empty queue
+  * @param q the queue
+  * @retval None
+  */
+static void queue_drop(event_queue_t *q)
+{
+	event_barrier();
+	q->read = q->read + 1;
+}
+
+/**
+  * @brief Check if a queued event is a plain rotary encoder detent
+  * @param e the event and data
+  * @retval true for event_rot_left and event_rot_right
+  */
+static bool is_rotation(uint16_t e)
+{
+	return (e >> 8) == event_rot_left || (e >> 8) == event_rot_right;
+}
 
 /**
   * @brief Initialize the event module
@@ -41,8 +140,11 @@ static uint8_t buffer[2*MAX_EVENTS];
   */
 void event_init(void)
 {
-	ringbuf_init(&events, (uint8_t*) buffer, sizeof(buffer));
-	memset(buffer, 0, sizeof(buffer));
+	queue_init(&queues[event_src_buttons], buttons_buf, EVENT_QUEUE_SIZE_BUTTONS);
+	queue_init(&queues[event_src_uart], uart_buf, EVENT_QUEUE_SIZE_UART);
+	queue_init(&queues[event_src_adc], adc_buf, EVENT_QUEUE_SIZE_ADC);
+	queue_init(&queues[event_src_main], main_buf, EVENT_QUEUE_SIZE_MAIN);
+	queue_init(&queues[event_src_timer], timer_buf, EVENT_QUEUE_SIZE_TIMER);
 }
 
 /**
@@ -53,27 +155,134 @@ void event_init(void)
   */
 bool event_get(event_t *event, uint8_t *data)
 {
-	bool got_event = true;
-	uint16_t e;
-	if (!ringbuf_get(&events, &e)) {
-		*event = event_none;
-		*data = 0;
-		got_event = false;
-	} else {
-		*event = e >> 8;
-		*data = e & 0xff;
+	return event_get_class(event_class_ui, event, data);
+}
+
+/**
+  * @brief Fetch the next event of a class or a more urgent one
+  * @param lowest the least urgent class to fetch
+  * @param event the type of event received or 'event_none' if no events in queue
+  * @param data additional event data
+  * @retval true if an event was found
+  */
+bool event_get_class(event_class_t lowest, event_t *event, uint8_t *data)
+{
+	for (uint32_t i = 0; i < event_src_count && drain_order[i].class <= lowest; i++) {
+		event_queue_t *q = &queues[drain_order[i].source];
+		uint16_t e;
+		while (queue_peek(q, &e)) {
+			queue_drop(q);
+			if (!is_rotation(e)) {
+				*event = e >> 8;
+				*data = e & 0xff;
+				TRACE_EVENT(trace_event_get, *event, *data);
+				return true;
+			}
+			/** Merge a run of rotations into one event with the net step count */
+			int32_t delta = 0;
+			while (true) {
+				delta += (e >> 8) == event_rot_right ? (e & 0xff) : -(e & 0xff);
+				if (!queue_peek(q, &e) || !is_rotation(e)) {
+					break;
+				}
+				queue_drop(q);
+			}
+			if (delta != 0) {
+				*event = delta > 0 ? event_rot_right : event_rot_left;
+				delta = delta > 0 ? delta : -delta;
+				*data = delta > 0xff ? 0xff : delta;
+				TRACE_EVENT(trace_event_get, *event, *data);
+				return true;
+			}
+		}
+	}
+	*event = event_none;
+	*data = 0;
+	return false;
+}
 
+/**
+  * @brief Place event in the fifo of the given source
+  * @param source the context posting, each source must have a single producer
+  * @param event event type
+  * @param data additional event data
+  * @retval true if the event was queued, false if it was dropped and counted
+  */
+bool event_put_from(event_source_t source, event_t event, uint8_t data)
+{
+	event_queue_t *q = &queues[source];
+	uint16_t write = q->write;
+	uint16_t used = write - q->read;
+	if (used > q->mask) {
+		q->drops++;
+		TRACE_EVENT(trace_event_drop, event, data);
+		return false;
+	}
+	q->buf[write & q->mask] = (uint16_t) (event << 8 | data);
+	event_barrier();
+	q->write = write + 1;
+	TRACE_EVENT(trace_event_put, event, data);
+	if (used + 1 > q->peak) {
+		q->peak = used + 1;
 	}
-	return got_event;
+	return true;
 }
 
 /**
-  * @brief Place event in event fifo
+  * @brief Place event in event fifo, the source is given by the event type
   * @param event event type
   * @param data additional event data
-  * @retval None
+  * @retval true if the event was queued
   */
 bool event_put(event_t event, uint8_t data)
 {
-	return ringbuf_put(&events, (uint16_t) (event << 8 | data));
+	event_source_t source;
+	switch (event) {
+		case event_uart_rx:
+		case event_uart_rx_block:
+			source = event_src_uart;
+			break;
+		case event_ocp:
+		case event_ovp:
+		case event_limit_mode:
+		case event_power_fail:
+			source = event_src_adc;
+			break;
+		case event_vout_ramped:
+			/** Posted from TIM3, which does not share the ADC ISR priority */
+			source = event_src_timer;
+			break;
+		default:
+			source = event_src_buttons;
+			break;
+	}
+	return event_put_from(source, event, data);
+}
+
+/**
+  * @brief Get the statistics of an event source
+  * @param source the event source
+  * @param stats filled in with the counters
+  * @retval None
+  */
+void event_get_stats(event_source_t source, event_stats_t *stats)
+{
+	event_queue_t *q = &queues[source];
+	stats->drops = q->drops - q->drops_base;
+	stats->peak = q->peak;
+	stats->size = q->mask + 1;
+}
+
+/**
+  * @brief Restart the statistics of all event sources
+  * @retval None
+  */
+void event_reset_stats(void)
+{
+	for (uint32_t i = 0; i < event_src_count; i++) {
+		event_queue_t *q = &queues[i];
+		q->drops_base = q->drops;
+		/** The producer only raises the peak, start from what is queued now */
+		q->peak = (uint16_t) (q->write - q->read);
+	}
 }
@@ -40,10 +40,23 @@
  *
  * ## Thread Safety
  *
- * The event queue is designed to be safe for ISR-to-mainloop communication:
- * - event_put() is called from ISRs with interrupts disabled
- * - event_get() is called from main loop with interrupts enabled
- * - The queue uses simple indices for lockless operation
+ * Each event source has its own single producer, single consumer queue so
+ * no interrupts need to be disabled:
+ * - event_put() is called from ISRs and picks the queue from the event type
+ *   (buttons and rotary encoder, UART, ADC protection, TIM3 V_out ramp)
+ * - event_put_from(event_src_main, ...) is used from the main loop
+ * - event_get() is called from main loop and drains ADC, UART, buttons,
+ *   main and timer in that order
+ *
+ * ## Priority
+ *
+ * The queues are drained by class, safety (ADC) before protocol (UART)
+ * before UI (buttons, rotary encoder, main loop, V_out ramp). A burst at the
+ * knob does not hold back the next frame of the host. event_get_class()
+ * fetches only the more urgent classes, the main loop uses it to handle
+ * protocol frames between the scheduled jobs such as redraws.
+ *
+ * A full queue drops the event and counts it, see event_get_stats().
  *
  * @see uui.h for event handling in the UI framework
  */
@@ -71,9 +84,9 @@ typedef enum {
     event_button_sel,
     /** @brief ENABLE button pressed (power on/off toggle) */
     event_button_enable,
-    /** @brief Rotary encoder rotated counter-clockwise */
+    /** @brief Rotary encoder rotated counter-clockwise, data is the step count */
     event_rot_left,
-    /** @brief Rotary encoder rotated clockwise */
+    /** @brief Rotary encoder rotated clockwise, data is the step count */
     event_rot_right,
     /** @brief Rotary encoder rotated CCW with button held */
     event_rot_left_set,
@@ -83,12 +96,62 @@ typedef enum {
     event_rot_press,
     /** @brief UART data received (complete frame available) */
     event_uart_rx,
+    /** @brief UART data available in the RX ring (idle line or ring half full) */
+    event_uart_rx_block,
     /** @brief Over Current Protection triggered */
     event_ocp,
     /** @brief Over Voltage Protection triggered */
-    event_ovp
+    event_ovp,
+    /** @brief Output changed between CV and CC, data bit 0 is 1 when current
+     *         limited, see pwrctl_limit_mode_us() for the time of the change */
+    event_limit_mode,
+    /** @brief V_out soft start ramp reached the setting */
+    event_vout_ramped,
+    /** @brief V_in sagged (data 1) or recovered (data 0), see hw_power_failing() */
+    event_power_fail
 } event_t;
 
+/**
+ * @brief Event sources, each with its own queue and drop counter
+ */
+typedef enum {
+    /** @brief Button and rotary encoder ISRs */
+    event_src_buttons = 0,
+    /** @brief USART1 ISR */
+    event_src_uart,
+    /** @brief ADC and DMA ISRs, OCP/OVP */
+    event_src_adc,
+    /** @brief Main loop */
+    event_src_main,
+    /** @brief TIM3 ISR, V_out ramp */
+    event_src_timer,
+    event_src_count
+} event_source_t;
+
+/**
+ * @brief Event classes, most urgent first
+ */
+typedef enum {
+    /** @brief OCP, OVP, power failure and the other events of the ADC */
+    event_class_safety = 0,
+    /** @brief UART data of the serial protocol */
+    event_class_protocol,
+    /** @brief Buttons, rotary encoder and events posted by the main loop */
+    event_class_ui,
+} event_class_t;
+
+/**
+ * @brief Counters of an event source queue
+ */
+typedef struct {
+    /** @brief Events dropped because the queue was full */
+    uint32_t drops;
+    /** @brief Highest number of events queued at once */
+    uint16_t peak;
+    /** @brief Queue size */
+    uint16_t size;
+} event_stats_t;
+
 /**
  * @brief Button press duration types
  *
@@ -114,8 +177,8 @@ void event_init(void);
 /**
  * @brief Retrieve the next event from the queue
  *
- * Removes and returns the oldest event from the FIFO queue.
- * If the queue is empty, event_none is returned.
+ * Removes and returns the oldest event of the most urgent class that has
+ * one queued. If all queues are empty, event_none is returned.
  *
  * @param[out] event Pointer to receive the event type
  * @param[out] data  Pointer to receive additional event data
@@ -125,25 +188,69 @@ void event_init(void);
  * @note Called from main loop, not from ISRs
  * @note The data field interpretation depends on event type:
  *       - For button events: button_press_t (short/long press)
- *       - For rotation events: number of detents
+ *       - For rotation events: number of steps, consecutive
+ *         event_rot_left/event_rot_right events are merged into one event
+ *         in the direction of the net step count
  *       - For protection events: trigger value
  */
 bool event_get(event_t *event, uint8_t *data);
 
+/**
+ * @brief Retrieve the next event of a class or a more urgent one
+ *
+ * Like event_get(), less urgent events stay queued.
+ *
+ * @param[in]  lowest The least urgent class to retrieve
+ * @param[out] event  Pointer to receive the event type
+ * @param[out] data   Pointer to receive additional event data
+ * @return true if an event was retrieved
+ * @return false if no event of the classes was queued (event set to event_none)
+ *
+ * @note Called from main loop, not from ISRs
+ */
+bool event_get_class(event_class_t lowest, event_t *event, uint8_t *data);
+
 /**
  * @brief Add an event to the queue
  *
- * Places a new event at the end of the FIFO queue. If the queue
- * is full, the event is silently dropped.
+ * Places a new event at the end of the queue of the source owning the
+ * event type. If the queue is full, the event is dropped and counted.
  *
  * @param[in] event Event type to add
  * @param[in] data  Additional event data (interpretation depends on event type)
  * @return true if the event was added to the queue
  * @return false if the queue was full (event dropped)
  *
- * @note Safe to call from ISRs
+ * @note Only call from the ISR owning the event type, use event_put_from()
+ *       with event_src_main from the main loop
  * @note Queue overflow indicates system is not processing events fast enough
  */
 bool event_put(event_t event, uint8_t data);
 
+/**
+ * @brief Add an event to the queue of a given source
+ *
+ * @param[in] source The posting context, at most one producer per source
+ * @param[in] event  Event type to add
+ * @param[in] data   Additional event data
+ * @return true if the event was added to the queue
+ * @return false if the queue was full (event dropped and counted)
+ */
+bool event_put_from(event_source_t source, event_t event, uint8_t data);
+
+/**
+ * @brief Get the drop counter and high water mark of an event source
+ *
+ * @param[in]  source The event source
+ * @param[out] stats  Filled in with the counters
+ */
+void event_get_stats(event_source_t source, event_stats_t *stats);
+
+/**
+ * @brief Restart the drop counters and high water marks of all sources
+ *
+ * Called from the main loop, the producers keep running.
+ */
+void event_reset_stats(void);
+
 #endif // __EVENT_H__
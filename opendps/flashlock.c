@@ -23,6 +23,7 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <flash.h>
 #include "flashlock.h"
 
@@ -51,3 +52,38 @@ void unlock_flash(void)
     }
     flash_unlock_count++;
 }
+
+/**
+  * @brief Program a block of erased flash, see flashlock.h
+  * @param address half word aligned flash address
+  * @param data data to program
+  * @param length number of bytes, even
+  * @retval true if the block was programmed and reads back as data
+  * @note Calls nothing, so all of it runs from SRAM with FLASH_RAMFUNC
+  */
+RAMFUNC_FLASH bool flash_program_block(uint32_t address, const void *data, uint32_t length)
+{
+    volatile uint16_t *dst = (volatile uint16_t*) address;
+    const uint16_t *src = data;
+    uint32_t count = length / 2;
+    if (address % 2 || length % 2) {
+        return false;
+    }
+    while (FLASH_SR & FLASH_SR_BSY) ;
+    FLASH_SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR; /** Write 1 to clear */
+    FLASH_CR |= FLASH_CR_PG;
+    for (uint32_t i = 0; i < count; i++) {
+        dst[i] = src[i];
+        while (FLASH_SR & FLASH_SR_BSY) ;
+    }
+    FLASH_CR &= ~FLASH_CR_PG;
+    if (FLASH_SR & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (dst[i] != src[i]) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -78,6 +78,10 @@
 #ifndef __FLASHLOCK_H__
 #define __FLASHLOCK_H__
 
+#include <stdint.h>
+#include <stdbool.h>
+#include "ramfunc.h"
+
 /**
  * @brief Unlock flash memory for writing
  *
@@ -106,4 +110,19 @@ void unlock_flash(void);
  */
 void lock_flash(void);
 
+/**
+ * @brief Program a block of erased flash
+ *
+ * Streams the block as half words with the PG bit set once, waiting only
+ * for BSY between them, then checks the error flags and compares the whole
+ * block once. Runs from SRAM with FLASH_RAMFUNC. The flash must be
+ * unlocked.
+ *
+ * @param[in] address Half word aligned flash address, erased
+ * @param[in] data    Data to program, a flash address works too
+ * @param[in] length  Number of bytes, even
+ * @return true if the block was programmed and reads back as data
+ */
+RAMFUNC_FLASH bool flash_program_block(uint32_t address, const void *data, uint32_t length);
+
 #endif // __FLASHLOCK_H__
@@ -0,0 +1,94 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "framepool.h"
+
+#if CONFIG_FRAME_POOL_SIZE > 32
+ #error "CONFIG_FRAME_POOL_SIZE is limited to 32 frames"
+#endif
+
+static frame_t pool[CONFIG_FRAME_POOL_SIZE];
+/** Bit n is set when pool[n] is in use */
+static uint32_t in_use;
+static uint32_t low_water = CONFIG_FRAME_POOL_SIZE;
+
+/**
+  * @brief Count the free frames
+  * @retval uint32_t free frames
+  */
+uint32_t frame_pool_free(void)
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < CONFIG_FRAME_POOL_SIZE; i++) {
+        if (!(in_use & (1u << i))) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+  * @brief Take a frame from the pool
+  * @retval frame_t* the frame, NULL if all frames are in use
+  */
+frame_t *frame_acquire(void)
+{
+    for (uint32_t i = 0; i < CONFIG_FRAME_POOL_SIZE; i++) {
+        if (!(in_use & (1u << i))) {
+            in_use |= 1u << i;
+            uint32_t free = frame_pool_free();
+            if (free < low_water) {
+                low_water = free;
+            }
+            pool[i].length = 0;
+            pool[i].unpack_pos = 0;
+            return &pool[i];
+        }
+    }
+    low_water = 0;
+    return NULL;
+}
+
+/**
+  * @brief Hand a frame back to the pool
+  * @param frame frame from frame_acquire(), NULL is ignored
+  * @retval none
+  */
+void frame_release(frame_t *frame)
+{
+    if (frame >= pool && frame < &pool[CONFIG_FRAME_POOL_SIZE]) {
+        in_use &= ~(1u << (frame - pool));
+    }
+}
+
+/**
+  * @brief Fewest frames that have been free at any time
+  * @retval uint32_t low water mark
+  */
+uint32_t frame_pool_low_water(void)
+{
+    return low_water;
+}
@@ -0,0 +1,80 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file framepool.h
+ * @brief Statically allocated pool of protocol frames
+ *
+ * A frame_t is some 140 bytes and used to be built on the stack of every
+ * protocol handler, with a second one for the cmd_tagged and cmd_addressed
+ * envelopes and a third while a cmd_batch runs its sub-commands. The frames are instead
+ * taken from a small pool that is sized for the deepest nesting, so the
+ * stack need not be dimensioned for it and the RAM shows up in the map
+ * file.
+ *
+ * A frame is taken with frame_acquire() and handed back with
+ * frame_release() once it has been sent. The pool is used from the main
+ * loop only and does no locking.
+ */
+
+#ifndef __FRAMEPOOL_H__
+#define __FRAMEPOOL_H__
+
+#include <stdint.h>
+#include "uframe.h"
+
+/**
+ * Number of frames in the pool. A tagged response inside a batch needs
+ * three: the sub-command, its response and the envelope.
+ */
+#ifndef CONFIG_FRAME_POOL_SIZE
+ #define CONFIG_FRAME_POOL_SIZE (3)
+#endif // CONFIG_FRAME_POOL_SIZE
+
+/**
+  * @brief Take a frame from the pool
+  * @retval frame_t* the frame, NULL if all frames are in use
+  */
+frame_t *frame_acquire(void);
+
+/**
+  * @brief Hand a frame back to the pool
+  * @param frame frame from frame_acquire(), NULL is ignored
+  * @retval none
+  */
+void frame_release(frame_t *frame);
+
+/**
+  * @brief Number of frames currently free
+  * @retval uint32_t free frames
+  */
+uint32_t frame_pool_free(void);
+
+/**
+  * @brief Fewest frames that have been free at any time, for sizing the pool
+  * @retval uint32_t low water mark
+  */
+uint32_t frame_pool_low_water(void);
+
+#endif // __FRAMEPOOL_H__
@@ -32,7 +32,7 @@
 #include "uui.h"
 #include "uui_number.h"
 #include "dbg_printf.h"
-#include "mini-printf.h"
+#include "numfmt.h"
 #include "dps-model.h"
 #include "ili9163c.h"
 
@@ -52,8 +52,9 @@ static void current_changed(ui_number_t *item);
 static void cc_tick(void);
 static void past_save(past_t *past);
 static void past_restore(past_t *past);
-static set_param_status_t set_parameter(char *name, char *value);
-static set_param_status_t get_parameter(char *name, char *value, uint32_t value_len);
+static set_param_status_t set_parameter(const char *name, char *value);
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len);
+static set_param_status_t set_setpoint(uint8_t mask, int32_t mv, int32_t ma);
 
 /* We need to keep copies of the user settings as the value in the UI will
  * be replaced with measurements when output is active
@@ -111,7 +112,7 @@ ui_number_t cc_current = {
 };
 
 /* This is the screen definition */
-ui_screen_t cc_screen = {
+static const ui_screen_desc_t cc_screen_desc = {
     .id = SCREEN_ID,
     .name = "cc",
     .icon_data = (uint8_t *) gfx_cc,
@@ -125,6 +126,7 @@ ui_screen_t cc_screen = {
     .past_restore = &past_restore,
     .set_parameter = &set_parameter,
     .get_parameter = &get_parameter,
+    .set_setpoint = &set_setpoint,
     .tick = &cc_tick,
     .num_items = 2,
     .parameters = {
@@ -145,6 +147,10 @@ ui_screen_t cc_screen = {
     .items = { (ui_item_t*) &cc_voltage, (ui_item_t*) &cc_current }
 };
 
+ui_screen_t cc_screen = {
+    .desc = &cc_screen_desc,
+};
+
 /**
  * @brief      Set function parameter
  *
@@ -153,7 +159,7 @@ ui_screen_t cc_screen = {
  *
  * @retval     set_param_status_t status code
  */
-static set_param_status_t set_parameter(char *name, char *value)
+static set_param_status_t set_parameter(const char *name, char *value)
 {
 
     int32_t ivalue = atoi(value);
@@ -179,6 +185,42 @@ static set_param_status_t set_parameter(char *name, char *value)
     return ps_unknown_name;
 }
 
+/**
+ * @brief      Set the voltage and/or current setting from binary values.
+ *             Both values are range checked before any of them is applied.
+ *
+ * @param[in]  mask  SETPOINT_VOLTAGE and/or SETPOINT_CURRENT
+ * @param[in]  mv    voltage in millivolt
+ * @param[in]  ma    current in milliampere
+ *
+ * @retval     set_param_status_t status code
+ */
+static set_param_status_t set_setpoint(uint8_t mask, int32_t mv, int32_t ma)
+{
+    if (!(mask & (SETPOINT_VOLTAGE | SETPOINT_CURRENT))) {
+        return ps_unknown_name;
+    }
+    if ((mask & SETPOINT_VOLTAGE) && (mv < cc_voltage.min || mv > cc_voltage.max)) {
+        emu_printf("[CC] Voltage %d is out of range (min:%d max:%d)\n", mv, cc_voltage.min, cc_voltage.max);
+        return ps_range_error;
+    }
+    if ((mask & SETPOINT_CURRENT) && (ma < cc_current.min || ma > cc_current.max)) {
+        emu_printf("[CC] Current %d is out of range (min:%d max:%d)\n", ma, cc_current.min, cc_current.max);
+        return ps_range_error;
+    }
+    if (mask & SETPOINT_VOLTAGE) {
+        cc_voltage.value = mv;
+        voltage_changed(&cc_voltage);
+        cc_voltage.ui.needs_redraw = true;
+    }
+    if (mask & SETPOINT_CURRENT) {
+        cc_current.value = ma;
+        current_changed(&cc_current);
+        cc_current.ui.needs_redraw = true;
+    }
+    return ps_ok;
+}
+
 /**
  * @brief      Get function parameter
  *
@@ -188,13 +230,13 @@ static set_param_status_t set_parameter(char *name, char *value)
  *
  * @retval     set_param_status_t status code
  */
-static set_param_status_t get_parameter(char *name, char *value, uint32_t value_len)
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len)
 {
     if (strcmp("voltage", name) == 0 || strcmp("u", name) == 0) {
-        (void) mini_snprintf(value, value_len, "%d", (pwrctl_vout_enabled() ? saved_u : cc_voltage.value));
+        (void) numfmt_int(value, value_len, (pwrctl_vout_enabled() ? saved_u : cc_voltage.value));
         return ps_ok;
     } else if (strcmp("current", name) == 0 || strcmp("i", name) == 0) {
-        (void) mini_snprintf(value, value_len, "%d", pwrctl_vout_enabled() ? saved_i : cc_current.value);
+        (void) numfmt_int(value, value_len, pwrctl_vout_enabled() ? saved_i : cc_current.value);
         return ps_ok;
     }
     return ps_unknown_name;
@@ -210,8 +252,7 @@ static void cc_enable(bool enabled)
     if (enabled) {
         saved_u = cc_voltage.value;
         saved_i = cc_current.value;
-        (void) pwrctl_set_vout(cc_voltage.max - 1000); /** Updated in cc_tick */
-        (void) pwrctl_set_iout(cc_current.value);
+        (void) pwrctl_set_vout_iout(cc_voltage.max - 1000, cc_current.value); /** V_out updated in cc_tick */
         (void) pwrctl_set_ilimit(0xFFFF); /** Set the current limit to the maximum to prevent OCP (over current protection) firing */
         (void) pwrctl_set_vlimit(cc_voltage.value);
         pwrctl_enable_vout(true);
@@ -256,10 +297,10 @@ static void current_changed(ui_number_t *item)
 static void past_save(past_t *past)
 {
     /** @todo: past bug causes corruption for units smaller than 4 bytes (#27) */
-    if (!past_write_unit(past, (SCREEN_ID << 24) | PAST_U, (void*) &saved_u, 4 /* sizeof(cc_voltage.value) */ )) {
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_U, (void*) &saved_u, 4 /* sizeof(cc_voltage.value) */ )) {
         /** @todo: handle past write failures */
     }
-    if (!past_write_unit(past, (SCREEN_ID << 24) | PAST_I, (void*) &saved_i, 4 /* sizeof(cc_current.value) */ )) {
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_I, (void*) &saved_i, 4 /* sizeof(cc_current.value) */ )) {
         /** @todo: handle past write failures */
     }
 }
@@ -293,12 +334,10 @@ static void past_restore(past_t *past)
  */
 static void cc_tick(void)
 {
-    uint16_t i_out_raw, v_in_raw, v_out_raw;
-    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
     /** Continously update max voltage output value
       * Max output voltage = Vin / VIN_VOUT_RATIO
       * Add 0.5f to ensure correct rounding when truncated */
-    cc_voltage.max = (float) pwrctl_calc_vin(v_in_raw) / VIN_VOUT_RATIO + 0.5f;
+    cc_voltage.max = (float) pwrctl_measured(pwrctl_meas_v_in) / VIN_VOUT_RATIO + 0.5f;
     if (pwrctl_vout_enabled()) {
         if (cc_voltage.ui.has_focus) {
             /** If the voltage setting has focus, make sure we're displaying
@@ -309,7 +348,7 @@ static void cc_tick(void)
             }
         } else {
             /** No focus, update display if necessary */
-            int32_t new_u = pwrctl_calc_vout(v_out_raw);
+            int32_t new_u = pwrctl_measured(pwrctl_meas_v_out);
             if (new_u != cc_voltage.value) {
                 cc_voltage.value = new_u;
                 cc_voltage.ui.draw(&cc_voltage.ui);
@@ -325,7 +364,7 @@ static void cc_tick(void)
             }
         } else {
             /** No focus, update display if necessary */
-            int32_t new_i = pwrctl_calc_iout(i_out_raw);
+            int32_t new_i = pwrctl_measured(pwrctl_meas_i_out);
             if (new_i != cc_current.value) {
                 cc_current.value = new_i;
                 cc_current.ui.draw(&cc_current.ui);
@@ -356,3 +395,5 @@ void func_cc_init(uui_t *ui)
     number_init(&cc_current);
     uui_add_screen(ui, &cc_screen);
 }
+
+UUI_REGISTER_FUNCTION(20, func_cc_init);
@@ -0,0 +1,603 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfx-cc.h"
+#include "gfx-cv.h"
+#include "gfx-chg.h"
+#include "hw.h"
+#include "isrhook.h"
+#include "event.h"
+#include "sched.h"
+#include "ramfunc.h"
+#include "func_chg.h"
+#include "uui.h"
+#include "uui_number.h"
+#include "dbg_printf.h"
+#include "numfmt.h"
+#include "dps-model.h"
+#include "ili9163c.h"
+#include "opendps.h"
+
+/*
+ * This is the implementation of the charger screen. It has two editable
+ * values, the charge voltage and the charge current. When power is enabled
+ * the cell is charged at constant current until it reaches the charge
+ * voltage, then at constant voltage until the current has tapered off to
+ * the termination current, at which point the output is switched off. The
+ * ADC ISR follows the CC/CV mode and averages the current, a once a second
+ * scheduler job makes the decisions, see func_chg.h.
+ */
+
+static void chg_enable(bool _enable);
+static void voltage_changed(ui_number_t *item);
+static void current_changed(ui_number_t *item);
+static void chg_tick(void);
+static void chg_limit_tick(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_raw);
+static void chg_check(void);
+static void deactivated(void);
+static void past_save(past_t *past);
+static void past_restore(past_t *past);
+static set_param_status_t set_parameter(const char *name, char *value);
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len);
+static set_param_status_t set_setpoint(uint8_t mask, int32_t mv, int32_t ma);
+
+/* We need to keep copies of the user settings as the value in the UI will
+ * be replaced with measurements when output is active
+ */
+static int32_t saved_u, saved_i;
+/** Termination current in mA, 0 for a tenth of the charge current */
+static int32_t taper_ma;
+/** Charge time limit in seconds, 0 for none */
+static int32_t timeout_s;
+
+/** Where the charge cycle is, reported as the "phase" parameter */
+typedef enum {
+    chg_idle = 0,
+    chg_cc,
+    chg_cv,
+    chg_done,
+} chg_phase_t;
+
+static chg_phase_t phase;
+static uint32_t elapsed_s;
+static uint32_t taper_count;
+static sched_job_t check_job;
+
+/** CV/CC mode evaluated from the ADC ISR, see chg_limit_tick() */
+static volatile bool cc_mode;
+static uint32_t mode_count;
+/** Number of samples a new mode must persist before it is reported, ~0.75ms */
+#define MODE_DEBOUNCE_SAMPLES  (16)
+
+/** Samples in the I_out average, ~200ms so every check sees a fresh window */
+#define CHG_WINDOW_SHIFT  (12)
+#define CHG_WINDOW_SAMPLES  (1 << CHG_WINDOW_SHIFT)
+/** No complete window since the output was enabled */
+#define CHG_NO_MEAN  (0xFFFFFFFF)
+/** Averaged raw I_out, written once per window by the ADC ISR */
+static volatile uint32_t i_mean_raw;
+static uint32_t i_acc, acc_count;
+
+/** Interval of the termination check */
+#define CHG_CHECK_MS  (1000)
+/** Consecutive checks below the taper current that end the charge */
+#define CHG_TAPER_CHECKS  (5)
+
+static enum {
+    CUR_GFX_NOT_DRAWN,
+    CUR_GFX_CV,
+    CUR_GFX_CC,
+} current_mode_gfx;
+
+#define SCREEN_ID     (9)
+#define PAST_U        (0)
+#define PAST_I        (1)
+#define PAST_TAPER    (2)
+#define PAST_TIMEOUT  (3)
+#define XPOS_CCCV     (25)
+
+/* This is the definition of the voltage item in the UI */
+ui_number_t chg_voltage = {
+    {
+        .type = ui_item_number,
+        .id = 10,
+        .x = 120,
+        .y = 15,
+        .can_focus = true,
+    },
+    .font_size = FONT_METER_LARGE,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = COLOR_VOLTAGE,
+    .value = 0,
+    .min = 0,
+    .max = 0, /** Set at init, continously updated in the tick callback */
+    .si_prefix = si_milli,
+    .num_digits = 2,
+    .num_decimals = 2,
+    .unit = unit_volt, /** Affects the unit printed on screen */
+    .changed = &voltage_changed,
+};
+
+/* This is the definition of the current item in the UI */
+ui_number_t chg_current = {
+    {
+        .type = ui_item_number,
+        .id = 11,
+        .x = 120,
+        .y = 60,
+        .can_focus = true,
+    },
+    .font_size = FONT_METER_LARGE,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = COLOR_AMPERAGE,
+    .value = 0,
+    .min = 0,
+    .max = CONFIG_DPS_MAX_CURRENT,
+    .si_prefix = si_milli,
+    .num_digits = CURRENT_DIGITS,
+    .num_decimals = CURRENT_DECIMALS,
+    .unit = unit_ampere,
+    .changed = &current_changed,
+};
+
+/* This is the screen definition */
+static const ui_screen_desc_t chg_screen_desc = {
+    .id = SCREEN_ID,
+    .name = "chg",
+    .icon_data = (uint8_t *) gfx_chg,
+    .icon_data_len = sizeof(gfx_chg),
+    .icon_width = GFX_CHG_WIDTH,
+    .icon_height = GFX_CHG_HEIGHT,
+    .activated = NULL,
+    .deactivated = &deactivated,
+    .enable = &chg_enable,
+    .past_save = &past_save,
+    .past_restore = &past_restore,
+    .tick = &chg_tick,
+    .set_parameter = &set_parameter,
+    .get_parameter = &get_parameter,
+    .set_setpoint = &set_setpoint,
+    .num_items = 2,
+    .parameters = {
+        {
+            .name = "voltage",
+            .unit = unit_volt,
+            .prefix = si_milli
+        },
+        {
+            .name = "current",
+            .unit = unit_ampere,
+            .prefix = si_milli
+        },
+        {
+            .name = "taper",
+            .unit = unit_ampere,
+            .prefix = si_milli
+        },
+        {
+            .name = "timeout",
+            .unit = unit_second,
+            .prefix = si_none
+        },
+        {
+            .name = "phase",
+            .unit = unit_none,
+            .prefix = si_none
+        },
+        {
+            .name = {'\0'} /** Terminator */
+        },
+    },
+    .items = { (ui_item_t*) &chg_voltage, (ui_item_t*) &chg_current }
+};
+
+ui_screen_t chg_screen = {
+    .desc = &chg_screen_desc,
+};
+
+/**
+ * @brief      Set function parameter
+ *
+ * @param[in]  name   name of parameter
+ * @param[in]  value  value of parameter as a string - always in SI units
+ *
+ * @retval     set_param_status_t status code
+ */
+static set_param_status_t set_parameter(const char *name, char *value)
+{
+    int32_t ivalue = atoi(value);
+    if (strcmp("voltage", name) == 0 || strcmp("u", name) == 0) {
+        if (ivalue < chg_voltage.min || ivalue > chg_voltage.max) {
+            emu_printf("[CHG] Voltage %d is out of range (min:%d max:%d)\n", ivalue, chg_voltage.min, chg_voltage.max);
+            return ps_range_error;
+        }
+        emu_printf("[CHG] Setting voltage to %d\n", ivalue);
+        chg_voltage.value = ivalue;
+        voltage_changed(&chg_voltage);
+        return ps_ok;
+    } else if (strcmp("current", name) == 0 || strcmp("i", name) == 0) {
+        if (ivalue < chg_current.min || ivalue > chg_current.max) {
+            emu_printf("[CHG] Current %d is out of range (min:%d max:%d)\n", ivalue, chg_current.min, chg_current.max);
+            return ps_range_error;
+        }
+        emu_printf("[CHG] Setting current to %d\n", ivalue);
+        chg_current.value = ivalue;
+        current_changed(&chg_current);
+        return ps_ok;
+    } else if (strcmp("taper", name) == 0) {
+        if (ivalue < 0 || ivalue > CONFIG_DPS_MAX_CURRENT) {
+            emu_printf("[CHG] Taper %d is out of range (min:0 max:%d)\n", ivalue, CONFIG_DPS_MAX_CURRENT);
+            return ps_range_error;
+        }
+        emu_printf("[CHG] Setting taper to %d\n", ivalue);
+        taper_ma = ivalue;
+        return ps_ok;
+    } else if (strcmp("timeout", name) == 0) {
+        if (ivalue < 0) {
+            emu_printf("[CHG] Timeout %d is out of range\n", ivalue);
+            return ps_range_error;
+        }
+        emu_printf("[CHG] Setting timeout to %d\n", ivalue);
+        timeout_s = ivalue;
+        return ps_ok;
+    } else if (strcmp("phase", name) == 0) {
+        return ps_not_supported;
+    }
+    return ps_unknown_name;
+}
+
+/**
+ * @brief      Set the voltage and/or current setting from binary values.
+ *             Both values are range checked before any of them is applied.
+ *
+ * @param[in]  mask  SETPOINT_VOLTAGE and/or SETPOINT_CURRENT
+ * @param[in]  mv    voltage in millivolt
+ * @param[in]  ma    current in milliampere
+ *
+ * @retval     set_param_status_t status code
+ */
+static set_param_status_t set_setpoint(uint8_t mask, int32_t mv, int32_t ma)
+{
+    if (!(mask & (SETPOINT_VOLTAGE | SETPOINT_CURRENT))) {
+        return ps_unknown_name;
+    }
+    if ((mask & SETPOINT_VOLTAGE) && (mv < chg_voltage.min || mv > chg_voltage.max)) {
+        emu_printf("[CHG] Voltage %d is out of range (min:%d max:%d)\n", mv, chg_voltage.min, chg_voltage.max);
+        return ps_range_error;
+    }
+    if ((mask & SETPOINT_CURRENT) && (ma < chg_current.min || ma > chg_current.max)) {
+        emu_printf("[CHG] Current %d is out of range (min:%d max:%d)\n", ma, chg_current.min, chg_current.max);
+        return ps_range_error;
+    }
+    if (mask & SETPOINT_VOLTAGE) {
+        chg_voltage.value = mv;
+        voltage_changed(&chg_voltage);
+        chg_voltage.ui.needs_redraw = true;
+    }
+    if (mask & SETPOINT_CURRENT) {
+        chg_current.value = ma;
+        current_changed(&chg_current);
+        chg_current.ui.needs_redraw = true;
+    }
+    return ps_ok;
+}
+
+/**
+ * @brief      Get function parameter
+ *
+ * @param[in]  name       name of parameter
+ * @param[in]  value      value of parameter as a string - always in SI units
+ * @param[in]  value_len  length of value buffer
+ *
+ * @retval     set_param_status_t status code
+ */
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len)
+{
+    if (strcmp("voltage", name) == 0 || strcmp("u", name) == 0) {
+        (void) numfmt_int(value, value_len, pwrctl_vout_enabled() ? saved_u : chg_voltage.value);
+        return ps_ok;
+    } else if (strcmp("current", name) == 0 || strcmp("i", name) == 0) {
+        (void) numfmt_int(value, value_len, pwrctl_vout_enabled() ? saved_i : chg_current.value);
+        return ps_ok;
+    } else if (strcmp("taper", name) == 0) {
+        (void) numfmt_int(value, value_len, taper_ma);
+        return ps_ok;
+    } else if (strcmp("timeout", name) == 0) {
+        (void) numfmt_int(value, value_len, timeout_s);
+        return ps_ok;
+    } else if (strcmp("phase", name) == 0) {
+        (void) numfmt_int(value, value_len, phase);
+        return ps_ok;
+    }
+    return ps_unknown_name;
+}
+
+/**
+ * @brief      Clear the CC or CV logo from the screen
+ */
+static void clear_mode_gfx(void)
+{
+    if (current_mode_gfx == CUR_GFX_CV) {
+        tft_fill(XPOS_CCCV, 128 - GFX_CV_HEIGHT, GFX_CV_WIDTH, GFX_CV_HEIGHT, BLACK);
+    } else if (current_mode_gfx == CUR_GFX_CC) {
+        tft_fill(XPOS_CCCV, 128 - GFX_CC_HEIGHT, GFX_CC_WIDTH, GFX_CC_HEIGHT, BLACK);
+    }
+    current_mode_gfx = CUR_GFX_NOT_DRAWN;
+}
+
+/**
+ * @brief      Callback for when the function is enabled
+ *
+ * @param[in]  enabled  true when function is enabled
+ */
+static void chg_enable(bool enabled)
+{
+    emu_printf("[CHG] %s output\n", enabled ? "Enable" : "Disable");
+    if (enabled) {
+        /** Display will now show the current values, keep the user setting saved */
+        saved_u = chg_voltage.value;
+        saved_i = chg_current.value;
+        (void) pwrctl_set_vout_iout(chg_voltage.value, chg_current.value);
+        (void) pwrctl_set_ilimit(0xFFFF); /** Set the current limit to the maximum to prevent OCP (over current protection) firing */
+        cc_mode = false;
+        mode_count = 0;
+        i_mean_raw = CHG_NO_MEAN;
+        i_acc = acc_count = 0;
+        phase = chg_cc;
+        elapsed_s = taper_count = 0;
+        pwrctl_enable_vout(true);
+        isrhook_set(isrhook_limit, &chg_limit_tick, ISRHOOK_BUDGET_LIMIT);
+        sched_start(&check_job, &chg_check, CHG_CHECK_MS, CHG_CHECK_MS);
+    } else {
+        sched_cancel(&check_job);
+        isrhook_set(isrhook_limit, NULL, 0);
+        pwrctl_enable_vout(false);
+        if (phase != chg_done) {
+            phase = chg_idle;
+        }
+        /** Make sure we're displaying the settings and not the current
+          * measurements when the power output is switched off */
+        chg_voltage.value = saved_u;
+        chg_voltage.ui.draw(&chg_voltage.ui);
+        chg_current.value = saved_i;
+        chg_current.ui.draw(&chg_current.ui);
+        clear_mode_gfx();
+    }
+}
+
+/**
+ * @brief      Callback for when value of the voltage item is changed
+ *
+ * @param      item  The voltage item
+ */
+static void voltage_changed(ui_number_t *item)
+{
+    saved_u = item->value;
+    (void) pwrctl_set_vout(item->value);
+}
+
+/**
+ * @brief      Callback for when value of the current item is changed
+ *
+ * @param      item  The current item
+ */
+static void current_changed(ui_number_t *item)
+{
+    saved_i = item->value;
+    (void) pwrctl_set_iout(item->value);
+}
+
+/**
+ * @brief      Do any required clean up before changing away from this screen
+ */
+static void deactivated(void)
+{
+    clear_mode_gfx();
+}
+
+/**
+ * @brief      Save persistent parameters
+ *
+ * @param      past  The past
+ */
+static void past_save(past_t *past)
+{
+    /** @todo: past bug causes corruption for units smaller than 4 bytes (#27) */
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_U, (void*) &saved_u, 4 /* sizeof(chg_voltage.value) */ )) {
+        /** @todo: handle past write failures */
+    }
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_I, (void*) &saved_i, 4 /* sizeof(chg_current.value) */ )) {
+        /** @todo: handle past write failures */
+    }
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_TAPER, (void*) &taper_ma, sizeof(taper_ma))) {
+        /** @todo: handle past write failures */
+    }
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_TIMEOUT, (void*) &timeout_s, sizeof(timeout_s))) {
+        /** @todo: handle past write failures */
+    }
+}
+
+/**
+ * @brief      Restore persistent parameters
+ *
+ * @param      past  The past
+ */
+static void past_restore(past_t *past)
+{
+    uint32_t length;
+    uint32_t *p = 0;
+    if (past_read_unit(past, (SCREEN_ID << 24) | PAST_U, (const void**) &p, &length)) {
+        saved_u = chg_voltage.value = *p;
+        (void) length;
+    }
+    if (past_read_unit(past, (SCREEN_ID << 24) | PAST_I, (const void**) &p, &length)) {
+        saved_i = chg_current.value = *p;
+        (void) length;
+    }
+    if (past_read_unit(past, (SCREEN_ID << 24) | PAST_TAPER, (const void**) &p, &length)) {
+        taper_ma = *p;
+    }
+    if (past_read_unit(past, (SCREEN_ID << 24) | PAST_TIMEOUT, (const void**) &p, &length)) {
+        timeout_s = *p;
+    }
+}
+
+/**
+ * @brief      Show the setting of an item while it has focus and the
+ *             measurement otherwise
+ *
+ * @param      item     The item
+ * @param[in]  setting  The user setting
+ * @param[in]  actual   The measured value
+ */
+static void show(ui_number_t *item, int32_t setting, int32_t actual)
+{
+    int32_t value = item->ui.has_focus ? setting : actual;
+    if (item->value != value) {
+        item->value = value;
+        item->ui.draw(&item->ui);
+    }
+}
+
+/**
+ * @brief      Update the UI. We need to be careful about the values shown
+ *             as they will differ depending on the current state of the UI.
+ *             Power off: always show current setting
+ *             Power on : show measured output value unless the item has
+ *                        focus in which case we shall display the setting.
+ */
+static void chg_tick(void)
+{
+    /** Continously update max voltage output value
+      * Max output voltage = Vin / VIN_VOUT_RATIO
+      * Add 0.5f to ensure correct rounding when truncated */
+    chg_voltage.max = (float) pwrctl_measured(pwrctl_meas_v_in) / VIN_VOUT_RATIO + 0.5f;
+    if (pwrctl_vout_enabled()) {
+        show(&chg_voltage, saved_u, pwrctl_measured(pwrctl_meas_v_out));
+        show(&chg_current, saved_i, pwrctl_measured(pwrctl_meas_i_out));
+
+        /** Display the CV or CC mode found by chg_limit_tick */
+        if (cc_mode) {
+            if (current_mode_gfx != CUR_GFX_CC) {
+                tft_blit_compressed(gfx_cc, GFX_CC_WIDTH, GFX_CC_HEIGHT, XPOS_CCCV, 128 - GFX_CC_HEIGHT);
+                current_mode_gfx = CUR_GFX_CC;
+            }
+        } else {
+            if (current_mode_gfx != CUR_GFX_CV) {
+                tft_blit_compressed(gfx_cv, GFX_CV_WIDTH, GFX_CV_HEIGHT, XPOS_CCCV, 128 - GFX_CV_HEIGHT);
+                current_mode_gfx = CUR_GFX_CV;
+            }
+        }
+    }
+}
+
+/**
+ * @brief      Follow the charge cycle, called every CHG_CHECK_MS by the
+ *             scheduler. CC moves to CV when the ISR reports CV mode, CV
+ *             ends when the averaged current has stayed below the taper
+ *             current for CHG_TAPER_CHECKS checks. The timeout ends the
+ *             charge in any phase.
+ */
+static void chg_check(void)
+{
+    elapsed_s += CHG_CHECK_MS / 1000;
+    if (phase == chg_cc && !cc_mode) {
+        emu_printf("[CHG] CV after %u s\n", elapsed_s);
+        phase = chg_cv;
+    }
+    uint32_t mean = i_mean_raw;
+    if (phase == chg_cv && mean != CHG_NO_MEAN) {
+        int32_t taper = taper_ma ? taper_ma : saved_i / 10;
+        if (!cc_mode && (int32_t) pwrctl_calc_iout(mean) < taper) {
+            taper_count++;
+        } else {
+            taper_count = 0;
+        }
+    }
+    bool timed_out = timeout_s && elapsed_s >= (uint32_t) timeout_s;
+    if (taper_count >= CHG_TAPER_CHECKS || timed_out) {
+        emu_printf("[CHG] Done after %u s%s\n", elapsed_s, timed_out ? " (timeout)" : "");
+        phase = chg_done;
+        sched_cancel(&check_job);
+        (void) opendps_enable_output(false);
+    }
+}
+
+/**
+ * @brief      Follow CV/CC transitions and average I_out from the ADC ISR.
+ *             A mode change has to persist for MODE_DEBOUNCE_SAMPLES samples
+ *             so noise around the crossover does not flood the event queue.
+ *             The mean current is published with a single word write once
+ *             every CHG_WINDOW_SAMPLES samples.
+ *
+ * @param[in]  i_raw     Raw I_out, offset corrected
+ * @param[in]  v_in_raw  Raw V_in, unused
+ * @param[in]  v_raw     Raw V_out
+ */
+RAMFUNC_HOOK static void chg_limit_tick(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_raw)
+{
+    (void) v_in_raw;
+    if (pwrctl_calc_cc_mode(i_raw, v_raw) == cc_mode) {
+        mode_count = 0;
+    } else if (++mode_count == MODE_DEBOUNCE_SAMPLES) {
+        mode_count = 0;
+        cc_mode = !cc_mode;
+        (void) pwrctl_put_limit_mode(cc_mode);
+    }
+    i_acc += i_raw;
+    if (++acc_count == CHG_WINDOW_SAMPLES) {
+        i_mean_raw = i_acc >> CHG_WINDOW_SHIFT;
+        i_acc = acc_count = 0;
+    }
+}
+
+/**
+ * @brief      Initialise the charger module and add its screen to the UI
+ *
+ * @param      ui    The user interface
+ */
+void func_chg_init(uui_t *ui)
+{
+    chg_voltage.value = 0; /** read from past */
+    chg_current.value = 0; /** read from past */
+    uint16_t i_out_raw, v_in_raw, v_out_raw;
+    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
+    (void) i_out_raw;
+    (void) v_out_raw;
+    chg_voltage.max = pwrctl_calc_vin(v_in_raw); /** @todo: subtract for LDO */
+    number_init(&chg_voltage);
+    /** Start at the second most significant digit preventing the user from
+        accidentally cranking up the setting 10V or more */
+    chg_voltage.cur_digit = 2;
+    number_init(&chg_current);
+    uui_add_screen(ui, &chg_screen);
+}
+
+UUI_REGISTER_FUNCTION(50, func_chg_init);
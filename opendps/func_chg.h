@@ -0,0 +1,85 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file func_chg.h
+ * @brief Battery Charger (CHG) Function Mode
+ *
+ * This module implements a CC/CV charger for OpenDPS that does the CC to CV
+ * transition and the termination on the device, so a charge does not depend
+ * on a host polling the output and stays safe if the link drops.
+ *
+ * ## Parameters
+ *
+ * | Name    | Unit | Description |
+ * |---------|------|-------------|
+ * | voltage | mV   | Charge (float) voltage |
+ * | current | mA   | Constant charge current |
+ * | taper   | mA   | Termination current, 0 for current/10 |
+ * | timeout | s    | Charge time limit, 0 for none |
+ * | phase   | -    | Read only, 0 idle, 1 CC, 2 CV, 3 done |
+ *
+ * ## Behavior
+ *
+ * The output is set up like CL mode, with the current limit working as the
+ * constant charge current. The isrhook_limit hook follows the CC/CV mode the
+ * same way func_cl does and averages I_out over CHG_WINDOW_SAMPLES samples.
+ * A scheduler job checks once a second:
+ *
+ * 1. **CC**: the cell voltage is below the charge voltage, the current is
+ *    limited. Moves to CV when the ISR reports CV mode.
+ * 2. **CV**: the voltage is held, the current tapers off. When the averaged
+ *    current has been below the taper current for CHG_TAPER_CHECKS checks
+ *    the output is switched off.
+ * 3. **Done**: output off, the phase stays done until the next enable.
+ *
+ * The timeout ends the charge in any phase. Taper and timeout are saved
+ * with the voltage and current when the output is enabled.
+ *
+ * @see func_cl.h for the isrhook_limit hook used to follow CV/CC transitions
+ * @see sched.h for the job running the checks
+ */
+
+#ifndef __FUNC_CHG_H__
+#define __FUNC_CHG_H__
+
+#include "uui.h"
+
+/**
+ * @brief Initialize and register the charger function
+ *
+ * Creates the charger screen and registers it with the UI framework.
+ * This includes:
+ * - Creating charge voltage and current input items
+ * - Setting up parameter handlers for remote control
+ * - Restoring saved settings from PAST
+ *
+ * @param[in,out] ui The user interface to add the charger function to
+ *
+ * @note Called once during system initialization
+ * @note Must be called after uui_init() and past_init()
+ */
+void func_chg_init(uui_t *ui);
+
+#endif // __FUNC_CHG_H__
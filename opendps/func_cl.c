@@ -30,11 +30,14 @@
 #include "gfx-cv.h"
 #include "gfx-cl.h"
 #include "hw.h"
+#include "isrhook.h"
+#include "event.h"
+#include "ramfunc.h"
 #include "func_cl.h"
 #include "uui.h"
 #include "uui_number.h"
 #include "dbg_printf.h"
-#include "mini-printf.h"
+#include "numfmt.h"
 #include "dps-model.h"
 #include "ili9163c.h"
 
@@ -50,18 +53,26 @@ static void cl_enable(bool _enable);
 static void voltage_changed(ui_number_t *item);
 static void current_changed(ui_number_t *item);
 static void cl_tick(void);
+static void cl_limit_tick(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_raw);
 static void deactivated(void);
 static void past_save(past_t *past);
 static void past_restore(past_t *past);
-static set_param_status_t set_parameter(char *name, char *value);
-static set_param_status_t get_parameter(char *name, char *value, uint32_t value_len);
+static set_param_status_t set_parameter(const char *name, char *value);
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len);
+static set_param_status_t set_setpoint(uint8_t mask, int32_t mv, int32_t ma);
 
 /* We need to keep copies of the user settings as the value in the UI will
  * be replaced with measurements when output is active
  */
 static int32_t saved_u, saved_i;
 
-enum {
+/** CV/CC mode evaluated from the ADC ISR, see cl_limit_tick() */
+static volatile bool cc_mode;
+static uint32_t mode_count;
+/** Number of samples a new mode must persist before it is reported, ~0.75ms */
+#define MODE_DEBOUNCE_SAMPLES  (16)
+
+static enum {
     CUR_GFX_NOT_DRAWN, 
     CUR_GFX_CV,
     CUR_GFX_CC,
@@ -119,7 +130,7 @@ ui_number_t cl_current = {
 };
 
 /* This is the screen definition */
-ui_screen_t cl_screen = {
+static const ui_screen_desc_t cl_screen_desc = {
     .id = SCREEN_ID,
     .name = "cl",
     .icon_data = (uint8_t *) gfx_cl,
@@ -134,6 +145,7 @@ ui_screen_t cl_screen = {
     .tick = &cl_tick,
     .set_parameter = &set_parameter,
     .get_parameter = &get_parameter,
+    .set_setpoint = &set_setpoint,
     .num_items = 2,
     .parameters = {
         {
@@ -153,6 +165,10 @@ ui_screen_t cl_screen = {
     .items = { (ui_item_t*) &cl_voltage, (ui_item_t*) &cl_current }
 };
 
+ui_screen_t cl_screen = {
+    .desc = &cl_screen_desc,
+};
+
 /**
  * @brief      Set function parameter
  *
@@ -161,7 +177,7 @@ ui_screen_t cl_screen = {
  *
  * @retval     set_param_status_t status code
  */
-static set_param_status_t set_parameter(char *name, char *value)
+static set_param_status_t set_parameter(const char *name, char *value)
 {
     int32_t ivalue = atoi(value);
     if (strcmp("voltage", name) == 0 || strcmp("u", name) == 0) {
@@ -186,6 +202,42 @@ static set_param_status_t set_parameter(char *name, char *value)
     return ps_unknown_name;
 }
 
+/**
+ * @brief      Set the voltage and/or current setting from binary values.
+ *             Both values are range checked before any of them is applied.
+ *
+ * @param[in]  mask  SETPOINT_VOLTAGE and/or SETPOINT_CURRENT
+ * @param[in]  mv    voltage in millivolt
+ * @param[in]  ma    current in milliampere
+ *
+ * @retval     set_param_status_t status code
+ */
+static set_param_status_t set_setpoint(uint8_t mask, int32_t mv, int32_t ma)
+{
+    if (!(mask & (SETPOINT_VOLTAGE | SETPOINT_CURRENT))) {
+        return ps_unknown_name;
+    }
+    if ((mask & SETPOINT_VOLTAGE) && (mv < cl_voltage.min || mv > cl_voltage.max)) {
+        emu_printf("[CL] Voltage %d is out of range (min:%d max:%d)\n", mv, cl_voltage.min, cl_voltage.max);
+        return ps_range_error;
+    }
+    if ((mask & SETPOINT_CURRENT) && (ma < cl_current.min || ma > cl_current.max)) {
+        emu_printf("[CL] Current %d is out of range (min:%d max:%d)\n", ma, cl_current.min, cl_current.max);
+        return ps_range_error;
+    }
+    if (mask & SETPOINT_VOLTAGE) {
+        cl_voltage.value = mv;
+        voltage_changed(&cl_voltage);
+        cl_voltage.ui.needs_redraw = true;
+    }
+    if (mask & SETPOINT_CURRENT) {
+        cl_current.value = ma;
+        current_changed(&cl_current);
+        cl_current.ui.needs_redraw = true;
+    }
+    return ps_ok;
+}
+
 /**
  * @brief      Get function parameter
  *
@@ -195,14 +247,14 @@ static set_param_status_t set_parameter(char *name, char *value)
  *
  * @retval     set_param_status_t status code
  */
-static set_param_status_t get_parameter(char *name, char *value, uint32_t value_len)
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len)
 {
     if (strcmp("voltage", name) == 0 || strcmp("u", name) == 0) {
         /** value returned in millivolt, module internal representation is centivolt */
-        (void) mini_snprintf(value, value_len, "%d", (pwrctl_vout_enabled() ? saved_u : cl_voltage.value));
+        (void) numfmt_int(value, value_len, (pwrctl_vout_enabled() ? saved_u : cl_voltage.value));
         return ps_ok;
     } else if (strcmp("current", name) == 0 || strcmp("i", name) == 0) {
-        (void) mini_snprintf(value, value_len, "%d", pwrctl_vout_enabled() ? saved_i : cl_current.value);
+        (void) numfmt_int(value, value_len, pwrctl_vout_enabled() ? saved_i : cl_current.value);
         return ps_ok;
     }
     return ps_unknown_name;
@@ -220,11 +272,14 @@ static void cl_enable(bool enabled)
         /** Display will now show the current values, keep the user setting saved */
         saved_u = cl_voltage.value;
         saved_i = cl_current.value;
-        (void) pwrctl_set_vout(cl_voltage.value);
-        (void) pwrctl_set_iout(cl_current.value);
+        (void) pwrctl_set_vout_iout(cl_voltage.value, cl_current.value);
         (void) pwrctl_set_ilimit(0xFFFF); /** Set the current limit to the maximum to prevent OCP (over current protection) firing */
+        cc_mode = false;
+        mode_count = 0;
         pwrctl_enable_vout(true);
+        isrhook_set(isrhook_limit, &cl_limit_tick, ISRHOOK_BUDGET_LIMIT);
     } else {
+        isrhook_set(isrhook_limit, NULL, 0);
         pwrctl_enable_vout(false);
         /** Make sure we're displaying the settings and not the current
           * measurements when the power output is switched off */
@@ -287,10 +342,10 @@ static void deactivated(void)
 static void past_save(past_t *past)
 {
     /** @todo: past bug causes corruption for units smaller than 4 bytes (#27) */
-    if (!past_write_unit(past, (SCREEN_ID << 24) | PAST_U, (void*) &saved_u, 4 /* sizeof(cl_voltage.value) */ )) {
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_U, (void*) &saved_u, 4 /* sizeof(cl_voltage.value) */ )) {
         /** @todo: handle past write failures */
     }
-    if (!past_write_unit(past, (SCREEN_ID << 24) | PAST_I, (void*) &saved_i, 4 /* sizeof(cl_current.value) */ )) {
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_I, (void*) &saved_i, 4 /* sizeof(cl_current.value) */ )) {
         /** @todo: handle past write failures */
     }
 }
@@ -324,16 +379,14 @@ static void past_restore(past_t *past)
  */
 static void cl_tick(void)
 {
-    uint16_t i_out_raw, v_in_raw, v_out_raw;
-    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
     /** Continously update max voltage output value
       * Max output voltage = Vin / VIN_VOUT_RATIO
       * Add 0.5f to ensure correct rounding when truncated */
-    cl_voltage.max = (float) pwrctl_calc_vin(v_in_raw) / VIN_VOUT_RATIO + 0.5f;
+    cl_voltage.max = (float) pwrctl_measured(pwrctl_meas_v_in) / VIN_VOUT_RATIO + 0.5f;
     if (pwrctl_vout_enabled()) {
 
-        int32_t vout_actual = pwrctl_calc_vout(v_out_raw);
-        int32_t cout_actual = pwrctl_calc_iout(i_out_raw);
+        int32_t vout_actual = pwrctl_measured(pwrctl_meas_v_out);
+        int32_t cout_actual = pwrctl_measured(pwrctl_meas_i_out);
 
         if (cl_voltage.ui.has_focus) {
             /** If the voltage setting has focus, make sure we're displaying
@@ -365,24 +418,42 @@ static void cl_tick(void)
             }
         }
 
-        /** Determine if we are in CV or CC mode and display it */
-        int32_t vout_diff = abs(saved_u - vout_actual);
-        int32_t cout_diff = abs(saved_i - cout_actual);
-
-        if (cout_diff < vout_diff) {
+        /** Display the CV or CC mode found by cl_limit_tick */
+        if (cc_mode) {
             if (current_mode_gfx != CUR_GFX_CC) {
-                tft_blit((uint16_t*) gfx_cc, GFX_CC_WIDTH, GFX_CC_HEIGHT, XPOS_CCCV, 128 - GFX_CC_HEIGHT);
+                tft_blit_compressed(gfx_cc, GFX_CC_WIDTH, GFX_CC_HEIGHT, XPOS_CCCV, 128 - GFX_CC_HEIGHT);
                 current_mode_gfx = CUR_GFX_CC;
             }
         } else {
             if (current_mode_gfx != CUR_GFX_CV) {
-                tft_blit((uint16_t*) gfx_cv, GFX_CV_WIDTH, GFX_CV_HEIGHT, XPOS_CCCV, 128 - GFX_CV_HEIGHT);
+                tft_blit_compressed(gfx_cv, GFX_CV_WIDTH, GFX_CV_HEIGHT, XPOS_CCCV, 128 - GFX_CV_HEIGHT);
                 current_mode_gfx = CUR_GFX_CV;
             }
         }
     }
 }
 
+/**
+ * @brief      Follow CV/CC transitions from the ADC ISR. A mode change has to
+ *             persist for MODE_DEBOUNCE_SAMPLES samples so noise around the
+ *             crossover does not flood the event queue.
+ *
+ * @param[in]  i_raw     Raw I_out, offset corrected
+ * @param[in]  v_in_raw  Raw V_in, unused
+ * @param[in]  v_raw     Raw V_out
+ */
+RAMFUNC_HOOK static void cl_limit_tick(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_raw)
+{
+    (void) v_in_raw;
+    if (pwrctl_calc_cc_mode(i_raw, v_raw) == cc_mode) {
+        mode_count = 0;
+    } else if (++mode_count == MODE_DEBOUNCE_SAMPLES) {
+        mode_count = 0;
+        cc_mode = !cc_mode;
+        (void) pwrctl_put_limit_mode(cc_mode);
+    }
+}
+
 /**
  * @brief      Initialise the CL module and add its screen to the UI
  *
@@ -404,3 +475,5 @@ void func_cl_init(uui_t *ui)
     number_init(&cl_current);
     uui_add_screen(ui, &cl_screen);
 }
+
+UUI_REGISTER_FUNCTION(30, func_cl_init);
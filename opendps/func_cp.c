@@ -0,0 +1,452 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfx-cp.h"
+#include "hw.h"
+#include "isrhook.h"
+#include "pwrctl.h"
+#include "ramfunc.h"
+#include "func_cp.h"
+#include "uui.h"
+#include "uui_number.h"
+#include "dbg_printf.h"
+#include "numfmt.h"
+#include "dps-model.h"
+#include "ili9163c.h"
+
+/*
+ * This is the implementation of the CP screen. It has two editable values,
+ * the output power and the voltage limit. When power is enabled it will
+ * continously display the measured output power and voltage. The current is
+ * regulated from the ADC ISR by cp_limit_tick(), see func_cp.h.
+ */
+
+static void cp_enable(bool _enable);
+static void power_changed(ui_number_t *item);
+static void voltage_changed(ui_number_t *item);
+static void cp_tick(void);
+static void cp_limit_tick(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_raw);
+static void past_save(past_t *past);
+static void past_restore(past_t *past);
+static set_param_status_t set_parameter(const char *name, char *value);
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len);
+static set_param_status_t set_setpoint(uint8_t mask, int32_t mv, int32_t ma);
+
+/* We need to keep copies of the user settings as the value in the UI will
+ * be replaced with measurements when output is active
+ */
+static int32_t saved_p, saved_u;
+
+/** Samples averaged per current update, ~0.4ms */
+#define CP_WINDOW_SHIFT  (3)
+#define CP_WINDOW_SAMPLES  (1 << CP_WINDOW_SHIFT)
+/** Below this V_out the power tells nothing about the current to set */
+#define CP_MIN_MV  (100)
+/** Current increase per window below CP_MIN_MV */
+#define CP_RAMP_MA  (CONFIG_DPS_MAX_CURRENT / 32)
+
+/** Read by the ADC ISR, written by the UI */
+static volatile uint32_t cp_power_mw;
+static volatile uint32_t cp_limit_mv;
+/** Owned by the ADC ISR while the output is enabled */
+static uint32_t cp_i_ma;
+static uint32_t v_acc, i_acc, acc_count;
+
+#define SCREEN_ID  (4)
+#define PAST_P     (0)
+#define PAST_U     (1)
+
+/* This is the definition of the power item in the UI */
+ui_number_t cp_power = {
+    {
+        .type = ui_item_number,
+        .id = 10,
+        .x = 120,
+        .y = 15,
+        .can_focus = true,
+    },
+    .font_size = FONT_METER_LARGE,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = COLOR_AMPERAGE,
+    .value = 0,
+    .min = 0,
+    .max = 0, /** Set at init, continously updated in the tick callback */
+    .si_prefix = si_milli,
+    .num_digits = 3,
+    .num_decimals = 1,
+    .unit = unit_watt, /** Affects the unit printed on screen */
+    .changed = &power_changed,
+};
+
+/* This is the definition of the voltage limit item in the UI */
+ui_number_t cp_voltage = {
+    {
+        .type = ui_item_number,
+        .id = 11,
+        .x = 120,
+        .y = 60,
+        .can_focus = true,
+    },
+    .font_size = FONT_METER_LARGE,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = COLOR_VOLTAGE,
+    .value = 0,
+    .min = 0,
+    .max = 0, /** Set at init, continously updated in the tick callback */
+    .si_prefix = si_milli,
+    .num_digits = 2,
+    .num_decimals = 2,
+    .unit = unit_volt,
+    .changed = &voltage_changed,
+};
+
+/* This is the screen definition */
+static const ui_screen_desc_t cp_screen_desc = {
+    .id = SCREEN_ID,
+    .name = "cp",
+    .icon_data = (uint8_t *) gfx_cp,
+    .icon_data_len = sizeof(gfx_cp),
+    .icon_width = GFX_CP_WIDTH,
+    .icon_height = GFX_CP_HEIGHT,
+    .activated = NULL,
+    .deactivated = NULL,
+    .enable = &cp_enable,
+    .past_save = &past_save,
+    .past_restore = &past_restore,
+    .tick = &cp_tick,
+    .set_parameter = &set_parameter,
+    .get_parameter = &get_parameter,
+    .set_setpoint = &set_setpoint,
+    .num_items = 2,
+    .parameters = {
+        {
+            .name = "power",
+            .unit = unit_watt,
+            .prefix = si_milli
+        },
+        {
+            .name = "voltage",
+            .unit = unit_volt,
+            .prefix = si_milli
+        },
+        {
+            .name = {'\0'} /** Terminator */
+        },
+    },
+    .items = { (ui_item_t*) &cp_power, (ui_item_t*) &cp_voltage }
+};
+
+ui_screen_t cp_screen = {
+    .desc = &cp_screen_desc,
+};
+
+/**
+ * @brief      Set function parameter
+ *
+ * @param[in]  name   name of parameter
+ * @param[in]  value  value of parameter as a string - always in SI units
+ *
+ * @retval     set_param_status_t status code
+ */
+static set_param_status_t set_parameter(const char *name, char *value)
+{
+    int32_t ivalue = atoi(value);
+    if (strcmp("power", name) == 0 || strcmp("p", name) == 0) {
+        if (ivalue < cp_power.min || ivalue > cp_power.max) {
+            emu_printf("[CP] Power %d is out of range (min:%d max:%d)\n", ivalue, cp_power.min, cp_power.max);
+            return ps_range_error;
+        }
+        emu_printf("[CP] Setting power to %d\n", ivalue);
+        cp_power.value = ivalue;
+        power_changed(&cp_power);
+        return ps_ok;
+    } else if (strcmp("voltage", name) == 0 || strcmp("u", name) == 0) {
+        if (ivalue < cp_voltage.min || ivalue > cp_voltage.max) {
+            emu_printf("[CP] Voltage %d is out of range (min:%d max:%d)\n", ivalue, cp_voltage.min, cp_voltage.max);
+            return ps_range_error;
+        }
+        emu_printf("[CP] Setting voltage to %d\n", ivalue);
+        cp_voltage.value = ivalue;
+        voltage_changed(&cp_voltage);
+        return ps_ok;
+    }
+    return ps_unknown_name;
+}
+
+/**
+ * @brief      Set the voltage limit from a binary value. CP has no current
+ *             setting, a request for one is refused before anything is
+ *             applied.
+ *
+ * @param[in]  mask  SETPOINT_VOLTAGE
+ * @param[in]  mv    voltage in millivolt
+ * @param[in]  ma    unused
+ *
+ * @retval     set_param_status_t status code
+ */
+static set_param_status_t set_setpoint(uint8_t mask, int32_t mv, int32_t ma)
+{
+    (void) ma;
+    if (mask & SETPOINT_CURRENT) {
+        return ps_not_supported;
+    }
+    if (!(mask & SETPOINT_VOLTAGE)) {
+        return ps_unknown_name;
+    }
+    if (mv < cp_voltage.min || mv > cp_voltage.max) {
+        emu_printf("[CP] Voltage %d is out of range (min:%d max:%d)\n", mv, cp_voltage.min, cp_voltage.max);
+        return ps_range_error;
+    }
+    cp_voltage.value = mv;
+    voltage_changed(&cp_voltage);
+    cp_voltage.ui.needs_redraw = true;
+    return ps_ok;
+}
+
+/**
+ * @brief      Get function parameter
+ *
+ * @param[in]  name       name of parameter
+ * @param[in]  value      value of parameter as a string - always in SI units
+ * @param[in]  value_len  length of value buffer
+ *
+ * @retval     set_param_status_t status code
+ */
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len)
+{
+    if (strcmp("power", name) == 0 || strcmp("p", name) == 0) {
+        (void) numfmt_int(value, value_len, pwrctl_vout_enabled() ? saved_p : cp_power.value);
+        return ps_ok;
+    } else if (strcmp("voltage", name) == 0 || strcmp("u", name) == 0) {
+        (void) numfmt_int(value, value_len, pwrctl_vout_enabled() ? saved_u : cp_voltage.value);
+        return ps_ok;
+    }
+    return ps_unknown_name;
+}
+
+/**
+ * @brief      Callback for when the function is enabled
+ *
+ * @param[in]  enabled  true when function is enabled
+ */
+static void cp_enable(bool enabled)
+{
+    emu_printf("[CP] %s output\n", enabled ? "Enable" : "Disable");
+    if (enabled) {
+        /** Display will now show the current values, keep the user setting saved */
+        saved_p = cp_power.value;
+        saved_u = cp_voltage.value;
+        cp_power_mw = saved_p;
+        cp_limit_mv = saved_u;
+        /** Start from no current, cp_limit_tick() finds the right one */
+        cp_i_ma = 0;
+        v_acc = i_acc = acc_count = 0;
+        (void) pwrctl_set_vout_iout(saved_u, 0);
+        (void) pwrctl_set_vlimit(0xFFFF); /** Set the voltage limit to the maximum to prevent OVP (over voltage protection) firing */
+        (void) pwrctl_set_ilimit(0xFFFF); /** Set the current limit to the maximum to prevent OCP (over current protection) firing */
+        pwrctl_enable_vout(true);
+        isrhook_set(isrhook_limit, &cp_limit_tick, ISRHOOK_BUDGET_LIMIT);
+    } else {
+        isrhook_set(isrhook_limit, NULL, 0);
+        pwrctl_enable_vout(false);
+        /** Make sure we're displaying the settings and not the current
+          * measurements when the power output is switched off */
+        cp_power.value = saved_p;
+        cp_power.ui.draw(&cp_power.ui);
+        cp_voltage.value = saved_u;
+        cp_voltage.ui.draw(&cp_voltage.ui);
+    }
+}
+
+/**
+ * @brief      Callback for when value of the power item is changed
+ *
+ * @param      item  The power item
+ */
+static void power_changed(ui_number_t *item)
+{
+    saved_p = item->value;
+    cp_power_mw = item->value;
+}
+
+/**
+ * @brief      Callback for when value of the voltage item is changed
+ *
+ * @param      item  The voltage item
+ */
+static void voltage_changed(ui_number_t *item)
+{
+    saved_u = item->value;
+    cp_limit_mv = item->value;
+    (void) pwrctl_set_vout(item->value);
+}
+
+/**
+ * @brief      Save persistent parameters
+ *
+ * @param      past  The past
+ */
+static void past_save(past_t *past)
+{
+    /** @todo: past bug causes corruption for units smaller than 4 bytes (#27) */
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_P, (void*) &saved_p, 4 /* sizeof(cp_power.value) */ )) {
+        /** @todo: handle past write failures */
+    }
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_U, (void*) &saved_u, 4 /* sizeof(cp_voltage.value) */ )) {
+        /** @todo: handle past write failures */
+    }
+}
+
+/**
+ * @brief      Restore persistent parameters
+ *
+ * @param      past  The past
+ */
+static void past_restore(past_t *past)
+{
+    uint32_t length;
+    uint32_t *p = 0;
+    if (past_read_unit(past, (SCREEN_ID << 24) | PAST_P, (const void**) &p, &length)) {
+        saved_p = cp_power.value = *p;
+        (void) length;
+    }
+    if (past_read_unit(past, (SCREEN_ID << 24) | PAST_U, (const void**) &p, &length)) {
+        saved_u = cp_voltage.value = *p;
+        (void) length;
+    }
+}
+
+/**
+ * @brief      Show the setting of an item while it has focus and the
+ *             measurement otherwise
+ *
+ * @param      item     The item
+ * @param[in]  setting  The user setting
+ * @param[in]  actual   The measured value
+ */
+static void show(ui_number_t *item, int32_t setting, int32_t actual)
+{
+    int32_t value = item->ui.has_focus ? setting : actual;
+    if (item->value != value) {
+        item->value = value;
+        item->ui.draw(&item->ui);
+    }
+}
+
+/**
+ * @brief      Update the UI. We need to be careful about the values shown
+ *             as they will differ depending on the current state of the UI.
+ *             Power off: always show current setting
+ *             Power on : show measured output value unless the item has
+ *                        focus in which case we shall display the setting.
+ */
+static void cp_tick(void)
+{
+    /** Continously update max voltage output value
+      * Max output voltage = Vin / VIN_VOUT_RATIO
+      * Add 0.5f to ensure correct rounding when truncated */
+    cp_voltage.max = (float) pwrctl_measured(pwrctl_meas_v_in) / VIN_VOUT_RATIO + 0.5f;
+    cp_power.max = (int64_t) cp_voltage.max * CONFIG_DPS_MAX_CURRENT / 1000;
+    if (pwrctl_vout_enabled()) {
+        int32_t vout_actual = pwrctl_measured(pwrctl_meas_v_out);
+        int32_t pout_actual = (int64_t) vout_actual * pwrctl_measured(pwrctl_meas_i_out) / 1000;
+        show(&cp_power, saved_p, pout_actual);
+        show(&cp_voltage, saved_u, vout_actual);
+    }
+}
+
+/**
+ * @brief      Regulate the output power from the ADC ISR. Every
+ *             CP_WINDOW_SAMPLES samples the current setting moves half way
+ *             to the current that gives the set power at the measured
+ *             voltage. Integer only.
+ *
+ * @param[in]  i_raw     Raw I_out, offset corrected
+ * @param[in]  v_in_raw  Raw V_in, unused
+ * @param[in]  v_raw     Raw V_out
+ */
+RAMFUNC_HOOK static void cp_limit_tick(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_raw)
+{
+    (void) v_in_raw;
+    v_acc += v_raw;
+    i_acc += i_raw;
+    if (++acc_count < CP_WINDOW_SAMPLES) {
+        return;
+    }
+    uint32_t v_mv = pwrctl_calc_vout(v_acc >> CP_WINDOW_SHIFT);
+    int32_t i_ma = pwrctl_calc_iout(i_acc >> CP_WINDOW_SHIFT);
+    v_acc = i_acc = acc_count = 0;
+
+    int32_t i_set = cp_i_ma;
+    if (v_mv < CP_MIN_MV) {
+        i_set += CP_RAMP_MA;
+    } else {
+        /** (P - V * I) / V, the power error as a current */
+        int32_t i_req = (uint64_t) cp_power_mw * 1000 / v_mv;
+        i_set += (i_req - i_ma) / 2;
+        /** At the voltage limit the load draws less than asked for, do
+          * not wind up past the current the power needs there */
+        if (v_mv >= cp_limit_mv && i_set > i_req) {
+            i_set = i_req;
+        }
+    }
+    if (i_set < 0) {
+        i_set = 0;
+    } else if (i_set > CONFIG_DPS_MAX_CURRENT) {
+        i_set = CONFIG_DPS_MAX_CURRENT;
+    }
+    cp_i_ma = i_set;
+    pwrctl_drive_iout(cp_i_ma);
+}
+
+/**
+ * @brief      Initialise the CP module and add its screen to the UI
+ *
+ * @param      ui    The user interface
+ */
+void func_cp_init(uui_t *ui)
+{
+    cp_power.value = 0; /** read from past */
+    cp_voltage.value = 0; /** read from past */
+    uint16_t i_out_raw, v_in_raw, v_out_raw;
+    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
+    (void) i_out_raw;
+    (void) v_out_raw;
+    cp_voltage.max = pwrctl_calc_vin(v_in_raw); /** @todo: subtract for LDO */
+    cp_power.max = (int64_t) cp_voltage.max * CONFIG_DPS_MAX_CURRENT / 1000;
+    number_init(&cp_power);
+    number_init(&cp_voltage);
+    /** Start at the second most significant digit preventing the user from
+        accidentally cranking up the setting 10V or more */
+    cp_voltage.cur_digit = 2;
+    uui_add_screen(ui, &cp_screen);
+}
+
+UUI_REGISTER_FUNCTION(40, func_cp_init);
@@ -0,0 +1,79 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file func_cp.h
+ * @brief Constant Power (CP) Function Mode
+ *
+ * This module implements a constant power operating mode for OpenDPS, for
+ * loads like LEDs and heaters that are specified by the power they take.
+ *
+ * ## Parameters
+ *
+ * | Name    | Unit | Description |
+ * |---------|------|-------------|
+ * | power   | mW   | Target output power |
+ * | voltage | mV   | Maximum output voltage |
+ *
+ * ## Behavior
+ *
+ * The output voltage is set to the limit and the current is regulated from
+ * the ADC ISR through the isrhook_limit hook. Every CP_WINDOW_SAMPLES samples
+ * the averaged V_out and I_out, converted with the integer calibration,
+ * give the current that would deliver the power at the present voltage, and
+ * the current setting moves half way there. On a resistive load this is a
+ * Newton iteration that settles within a few windows, i.e. in well under a
+ * millisecond after a load step.
+ *
+ * When the load cannot take the power below the voltage limit the output
+ * stays at the limit with the current the load draws. Below CP_MIN_MV
+ * (a short or startup) the current ramps up instead of jumping to the
+ * maximum.
+ *
+ * @see func_cl.h for the isrhook_limit hook used to follow CV/CC transitions
+ * @see pwrctl_drive_iout() for how the current is set from the ISR
+ */
+
+#ifndef __FUNC_CP_H__
+#define __FUNC_CP_H__
+
+#include "uui.h"
+
+/**
+ * @brief Initialize and register the CP function
+ *
+ * Creates the CP screen and registers it with the UI framework.
+ * This includes:
+ * - Creating power and voltage limit input items
+ * - Setting up parameter handlers for remote control
+ * - Restoring saved settings from PAST
+ *
+ * @param[in,out] ui The user interface to add the CP function to
+ *
+ * @note Called once during system initialization
+ * @note Must be called after uui_init() and past_init()
+ */
+void func_cp_init(uui_t *ui);
+
+#endif // __FUNC_CP_H__
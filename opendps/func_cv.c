@@ -26,13 +26,16 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include "gfx-cc.h"
 #include "gfx-cv.h"
 #include "hw.h"
+#include "isrhook.h"
+#include "ramfunc.h"
 #include "func_cv.h"
 #include "uui.h"
 #include "uui_number.h"
 #include "dbg_printf.h"
-#include "mini-printf.h"
+#include "numfmt.h"
 #include "dps-model.h"
 #include "ili9163c.h"
 
@@ -48,19 +51,28 @@ static void cv_enable(bool _enable);
 static void voltage_changed(ui_number_t *item);
 static void current_changed(ui_number_t *item);
 static void cv_tick(void);
+static void cv_limit_tick(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_raw);
+static void deactivated(void);
 static void past_save(past_t *past);
 static void past_restore(past_t *past);
-static set_param_status_t set_parameter(char *name, char *value);
-static set_param_status_t get_parameter(char *name, char *value, uint32_t value_len);
+static set_param_status_t set_parameter(const char *name, char *value);
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len);
+static set_param_status_t set_setpoint(uint8_t mask, int32_t mv, int32_t ma);
 
 /* We need to keep copies of the user settings as the value in the UI will
  * be replaced with measurements when output is active
  */
 static int32_t saved_u, saved_i;
 
+/** CV/CC regime followed from the ADC ISR, see cv_limit_tick() */
+static volatile bool cc_mode;
+/** The CC logo is on screen */
+static bool cc_drawn;
+
 #define SCREEN_ID  (1)
 #define PAST_U     (0)
 #define PAST_I     (1)
+#define XPOS_CC    (25)
 
 /* This is the definition of the voltage item in the UI */
 ui_number_t cv_voltage = {
@@ -109,7 +121,7 @@ ui_number_t cv_current = {
 };
 
 /* This is the screen definition */
-ui_screen_t cv_screen = {
+static const ui_screen_desc_t cv_screen_desc = {
     .id = SCREEN_ID,
     .name = "cv",
     .icon_data = (uint8_t *) gfx_cv,
@@ -117,13 +129,14 @@ ui_screen_t cv_screen = {
     .icon_width = GFX_CV_WIDTH,
     .icon_height = GFX_CV_HEIGHT,
     .activated = NULL,
-    .deactivated = NULL,
+    .deactivated = &deactivated,
     .enable = &cv_enable,
     .past_save = &past_save,
     .past_restore = &past_restore,
     .tick = &cv_tick,
     .set_parameter = &set_parameter,
     .get_parameter = &get_parameter,
+    .set_setpoint = &set_setpoint,
     .num_items = 2,
     .parameters = {
         {
@@ -143,6 +156,10 @@ ui_screen_t cv_screen = {
     .items = { (ui_item_t*) &cv_voltage, (ui_item_t*) &cv_current }
 };
 
+ui_screen_t cv_screen = {
+    .desc = &cv_screen_desc,
+};
+
 /**
  * @brief      Set function parameter
  *
@@ -151,7 +168,7 @@ ui_screen_t cv_screen = {
  *
  * @retval     set_param_status_t status code
  */
-static set_param_status_t set_parameter(char *name, char *value)
+static set_param_status_t set_parameter(const char *name, char *value)
 {
     int32_t ivalue = atoi(value);
     if (strcmp("voltage", name) == 0 || strcmp("u", name) == 0) {
@@ -176,6 +193,42 @@ static set_param_status_t set_parameter(char *name, char *value)
     return ps_unknown_name;
 }
 
+/**
+ * @brief      Set the voltage and/or current setting from binary values.
+ *             Both values are range checked before any of them is applied.
+ *
+ * @param[in]  mask  SETPOINT_VOLTAGE and/or SETPOINT_CURRENT
+ * @param[in]  mv    voltage in millivolt
+ * @param[in]  ma    current in milliampere
+ *
+ * @retval     set_param_status_t status code
+ */
+static set_param_status_t set_setpoint(uint8_t mask, int32_t mv, int32_t ma)
+{
+    if (!(mask & (SETPOINT_VOLTAGE | SETPOINT_CURRENT))) {
+        return ps_unknown_name;
+    }
+    if ((mask & SETPOINT_VOLTAGE) && (mv < cv_voltage.min || mv > cv_voltage.max)) {
+        emu_printf("[CV] Voltage %d is out of range (min:%d max:%d)\n", mv, cv_voltage.min, cv_voltage.max);
+        return ps_range_error;
+    }
+    if ((mask & SETPOINT_CURRENT) && (ma < cv_current.min || ma > cv_current.max)) {
+        emu_printf("[CV] Current %d is out of range (min:%d max:%d)\n", ma, cv_current.min, cv_current.max);
+        return ps_range_error;
+    }
+    if (mask & SETPOINT_VOLTAGE) {
+        cv_voltage.value = mv;
+        voltage_changed(&cv_voltage);
+        cv_voltage.ui.needs_redraw = true;
+    }
+    if (mask & SETPOINT_CURRENT) {
+        cv_current.value = ma;
+        current_changed(&cv_current);
+        cv_current.ui.needs_redraw = true;
+    }
+    return ps_ok;
+}
+
 /**
  * @brief      Get function parameter
  *
@@ -185,13 +238,13 @@ static set_param_status_t set_parameter(char *name, char *value)
  *
  * @retval     set_param_status_t status code
  */
-static set_param_status_t get_parameter(char *name, char *value, uint32_t value_len)
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len)
 {
     if (strcmp("voltage", name) == 0 || strcmp("u", name) == 0) {
-        (void) mini_snprintf(value, value_len, "%d", (pwrctl_vout_enabled() ? saved_u : cv_voltage.value));
+        (void) numfmt_int(value, value_len, (pwrctl_vout_enabled() ? saved_u : cv_voltage.value));
         return ps_ok;
     } else if (strcmp("current", name) == 0 || strcmp("i", name) == 0) {
-        (void) mini_snprintf(value, value_len, "%d", pwrctl_vout_enabled() ? saved_i : cv_current.value);
+        (void) numfmt_int(value, value_len, pwrctl_vout_enabled() ? saved_i : cv_current.value);
         return ps_ok;
     }
     return ps_unknown_name;
@@ -209,12 +262,14 @@ static void cv_enable(bool enabled)
         /** Display will now show the current values, keep the user setting saved */
         saved_u = cv_voltage.value;
         saved_i = cv_current.value;
-        (void) pwrctl_set_vout(cv_voltage.value);
-        (void) pwrctl_set_iout(CONFIG_DPS_MAX_CURRENT);
+        (void) pwrctl_set_vout_iout(cv_voltage.value, CONFIG_DPS_MAX_CURRENT);
         (void) pwrctl_set_ilimit(cv_current.value);
         (void) pwrctl_set_vlimit(0xFFFF); /** Set the voltage limit to the maximum to prevent OVP (over voltage protection) firing */
+        cc_mode = false;
         pwrctl_enable_vout(true);
+        isrhook_set(isrhook_limit, &cv_limit_tick, ISRHOOK_BUDGET_LIMIT);
     } else {
+        isrhook_set(isrhook_limit, NULL, 0);
         pwrctl_enable_vout(false);
         /** Make sure we're displaying the settings and not the current
           * measurements when the power output is switched off */
@@ -222,6 +277,7 @@ static void cv_enable(bool enabled)
         cv_voltage.ui.draw(&cv_voltage.ui);
         cv_current.value = saved_i;
         cv_current.ui.draw(&cv_current.ui);
+        deactivated();
     }
 }
 
@@ -247,6 +303,18 @@ static void current_changed(ui_number_t *item)
     (void) pwrctl_set_ilimit(item->value);
 }
 
+/**
+ * @brief      Do any required clean up before changing away from this screen
+ */
+static void deactivated(void)
+{
+    /** Ensure the CC logo has been cleared from the screen */
+    if (cc_drawn) {
+        tft_fill(XPOS_CC, 128 - GFX_CC_HEIGHT, GFX_CC_WIDTH, GFX_CC_HEIGHT, BLACK);
+        cc_drawn = false;
+    }
+}
+
 /**
  * @brief      Save persistent parameters
  *
@@ -255,10 +323,10 @@ static void current_changed(ui_number_t *item)
 static void past_save(past_t *past)
 {
     /** @todo: past bug causes corruption for units smaller than 4 bytes (#27) */
-    if (!past_write_unit(past, (SCREEN_ID << 24) | PAST_U, (void*) &saved_u, 4 /* sizeof(cv_voltage.value) */ )) {
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_U, (void*) &saved_u, 4 /* sizeof(cv_voltage.value) */ )) {
         /** @todo: handle past write failures */
     }
-    if (!past_write_unit(past, (SCREEN_ID << 24) | PAST_I, (void*) &saved_i, 4 /* sizeof(cv_current.value) */ )) {
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_I, (void*) &saved_i, 4 /* sizeof(cv_current.value) */ )) {
         /** @todo: handle past write failures */
     }
 }
@@ -292,12 +360,10 @@ static void past_restore(past_t *past)
  */
 static void cv_tick(void)
 {
-    uint16_t i_out_raw, v_in_raw, v_out_raw;
-    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
     /** Continously update max voltage output value
       * Max output voltage = Vin / VIN_VOUT_RATIO
       * Add 0.5f to ensure correct rounding when truncated */
-    cv_voltage.max = (float) pwrctl_calc_vin(v_in_raw) / VIN_VOUT_RATIO + 0.5f;
+    cv_voltage.max = (float) pwrctl_measured(pwrctl_meas_v_in) / VIN_VOUT_RATIO + 0.5f;
     if (pwrctl_vout_enabled()) {
         if (cv_voltage.ui.has_focus) {
             /** If the voltage setting has focus, make sure we're displaying
@@ -308,7 +374,7 @@ static void cv_tick(void)
             }
         } else {
             /** No focus, update display if necessary */
-            int32_t new_u = pwrctl_calc_vout(v_out_raw);
+            int32_t new_u = pwrctl_measured(pwrctl_meas_v_out);
             if (new_u != cv_voltage.value) {
                 cv_voltage.value = new_u;
                 cv_voltage.ui.draw(&cv_voltage.ui);
@@ -324,12 +390,38 @@ static void cv_tick(void)
             }
         } else {
             /** No focus, update display if necessary */
-            int32_t new_i = pwrctl_calc_iout(i_out_raw);
+            int32_t new_i = pwrctl_measured(pwrctl_meas_i_out);
             if (new_i != cv_current.value) {
                 cv_current.value = new_i;
                 cv_current.ui.draw(&cv_current.ui);
             }
         }
+
+        /** Show when cv_limit_tick found the output current limited */
+        if (cc_mode && !cc_drawn) {
+            tft_blit_compressed(gfx_cc, GFX_CC_WIDTH, GFX_CC_HEIGHT, XPOS_CC, 128 - GFX_CC_HEIGHT);
+            cc_drawn = true;
+        } else if (!cc_mode && cc_drawn) {
+            deactivated();
+        }
+    }
+}
+
+/**
+ * @brief      Follow CV/CC transitions from the ADC ISR. The hysteresis of
+ *             pwrctl_calc_cc_regime() keeps noise around the thresholds from
+ *             flooding the event queue.
+ *
+ * @param[in]  i_raw     Raw I_out, offset corrected
+ * @param[in]  v_in_raw  Raw V_in, unused
+ * @param[in]  v_raw     Raw V_out
+ */
+RAMFUNC_HOOK static void cv_limit_tick(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_raw)
+{
+    (void) v_in_raw;
+    if (pwrctl_calc_cc_regime(i_raw, v_raw, cc_mode) != cc_mode) {
+        cc_mode = !cc_mode;
+        (void) pwrctl_put_limit_mode(cc_mode);
     }
 }
 
@@ -354,3 +446,5 @@ void func_cv_init(uui_t *ui)
     number_init(&cv_current);
     uui_add_screen(ui, &cv_screen);
 }
+
+UUI_REGISTER_FUNCTION(10, func_cv_init);
@@ -29,58 +29,160 @@
 #include "gfx-sin.h"
 #include "gfx-saw.h"
 #include "gfx-square.h"
+#include "gfx-arb.h"
 #include "hw.h"
+#include "isrhook.h"
+#include "perf.h"
 #include "func_gen.h"
+#include "wavegen.h"
+#include "ramfunc.h"
+#include "ctrlblk.h"
 #include "uui.h"
 #include "uui_number.h"
 #include "uui_icon.h"
 #include "dbg_printf.h"
-#include "mini-printf.h"
+#include "numfmt.h"
 #include "dps-model.h"
 #include "ili9163c.h"
 #include "font-full_small.h"
-
+#ifdef CONFIG_SERIAL_PROTOCOL
+#include "uframe.h"
+#include "protocol.h"
+#include "serialhandler.h"
+#ifdef CONFIG_LOCKIN
+#include "framepool.h"
+#include "lockin.h"
+#endif // CONFIG_LOCKIN
+#endif // CONFIG_SERIAL_PROTOCOL
+
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+/* The waveform is streamed to the DAC by DMA with FUNCGEN_WAVE_POINTS points per
+ * period, fewer above DAC_WAVE_MAX_RATE / FUNCGEN_WAVE_POINTS Hz. */
+#define MAX_FREQUENCY   5000
+#ifndef FUNCGEN_WAVE_POINTS
+ #define FUNCGEN_WAVE_POINTS  (128)
+#endif
+static uint16_t wave_buf[FUNCGEN_WAVE_POINTS];
+static bool wave_enabled;
+static void wave_update(void);
+#else // CONFIG_FUNCGEN_DAC_DMA
 /* We are reacting on the ADC's IRQ which runs at ~20kHz.
  * As such we want at least 20 points per period so the shape of the function is 
  * "clean", so we limit generation to 1kHz. 
  */
 #define MAX_FREQUENCY   999
+#endif // CONFIG_FUNCGEN_DAC_DMA
+
+struct gen_params;
+/* The basic generator function that's selected at runtime, phase is 0..2^32 for one period */
+typedef int32_t (*compute_func_t)(uint32_t phase, const struct gen_params *p);
+
+/* The phase accumulator has PHASE_FRAC_BITS bits below the 32 bits that index the waveform */
+#define PHASE_FRAC_BITS  (8)
+
+/* A sweeping phase increment has SWEEP_FRAC_BITS more fractional bits, the relative
+ * rate of a logarithmic sweep has SWEEP_LOG_BITS */
+#define SWEEP_FRAC_BITS  (16)
+#define SWEEP_LOG_BITS   (36)
 
-/* The basic generator function that's selected at runtime */
-typedef int32_t (*compute_func_t)(uint32_t time_in_us, uint32_t period_in_us, int32_t max);
+/* Limits of the parameters that are not on the screen */
+#define MIN_DUTY         (1)
+#define MAX_DUTY         (99)
+#define MIN_SWEEP_MS     (10)
+#define MAX_SWEEP_MS     (60000)
 
 /*
  * This is the implementation of the function generator screen. It has three editable values,
  * voltage, frequency and function type. */
-static void    func_gen(void);
-static int16_t sin1(int16_t angle);
-static int32_t square_gen(uint32_t time_in_us, uint32_t period_in_us, int32_t max);
-static int32_t saw_gen(uint32_t time_in_us, uint32_t period_in_us, int32_t max);
-static int32_t sin_gen(uint32_t time_in_us, uint32_t period_in_us, int32_t max);
+#ifndef CONFIG_FUNCGEN_DAC_DMA
+static void    func_gen(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw);
+#endif // CONFIG_FUNCGEN_DAC_DMA
+static int32_t square_gen(uint32_t phase, const struct gen_params *p);
+static int32_t saw_gen(uint32_t phase, const struct gen_params *p);
+static int32_t sin_gen(uint32_t phase, const struct gen_params *p);
+static int32_t arb_gen(uint32_t phase, const struct gen_params *p);
 
-/* The basic generator function that's selected at runtime */
-static compute_func_t compute_func = &square_gen;
 
 static void funcgen_enable(bool _enable);
 static void voltage_changed(ui_number_t *item);
 static void frequency_changed(ui_number_t *item);
 static void func_changed(ui_icon_t *item);
 static void func_gen_tick(void);
-static void compute_period_from_freq(int32_t freq);
-static void activated(void);
-static void deactivated(void);
+static uint32_t compute_phase_inc_from_freq(int32_t freq);
+static void gen_publish(void);
 static void past_save(past_t *past);
 static void past_restore(past_t *past);
-static set_param_status_t set_parameter(char *name, char *value);
-static set_param_status_t get_parameter(char *name, char *value, uint32_t value_len);
-
-/* We need to keep copies of the period to avoid recomputing it every time. */
-static uint32_t period_us;
+static set_param_status_t set_parameter(const char *name, char *value);
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len);
+
+/* The generator settings the ISR uses, published together through gen_ctrl */
+typedef struct gen_params {
+    /* Phase advance per microsecond, precomputed when the frequency changes so the ISR does not divide */
+    uint32_t phase_inc;
+    /* The basic generator function that's selected at runtime */
+    compute_func_t compute_func;
+    /* Amplitude in mV */
+    int32_t voltage;
+    /* DC offset in mV added to the waveform */
+    int32_t offset;
+    /* Phase where the square falls */
+    uint32_t duty;
+    /* Periods output per burst, 0 for a continuous output */
+    uint32_t burst;
+    /* Periods from one burst to the next, 0 for a single burst */
+    uint32_t burst_period;
+    /* Periods counted before the count stops or restarts, burst_period or burst */
+    uint32_t burst_limit;
+    /* Phase increments the sweep runs between, with SWEEP_FRAC_BITS */
+    int64_t sweep_start;
+    int64_t sweep_end;
+    /* Change of the increment per microsecond, 0 without a sweep. With SWEEP_FRAC_BITS for
+     * a linear sweep, relative with SWEEP_LOG_BITS for a logarithmic one */
+    int64_t sweep_rate;
+    bool sweep_log;
+} gen_params_t;
+static gen_params_t gen_params[2] = {
+    { .compute_func = &square_gen, .duty = 0x80000000 },
+    { .compute_func = &square_gen, .duty = 0x80000000 },
+};
+static ctrlblk_t gen_ctrl = CTRLBLK_INIT(&gen_params[0], &gen_params[1]);
+/* Phase accumulator and last timestamp, only touched by the ISR once enabled */
+static uint64_t phase;
+static uint16_t last_time_us;
+/* Sweep and burst state of the ISR, restarted when gen_ctrl is published */
+static uint32_t gen_version;
+static int64_t sweep_inc;
+static uint32_t burst_count;
+
+/* The settings that are only set by parameter, persisted together */
+typedef struct {
+    int32_t duty;           /* % */
+    int32_t offset;         /* mV */
+    int32_t burst;          /* Periods */
+    int32_t burst_period;   /* Periods */
+    int32_t sweep_to;       /* dHz, 0 for no sweep */
+    int32_t sweep_ms;
+    int32_t sweep_log;      /* 0 linear, 1 logarithmic */
+} gen_shape_t;
+static gen_shape_t gen_shape = { .duty = 50, .sweep_ms = 1000 };
 
 #define SCREEN_ID  (5)
 #define PAST_U     (0)
 #define PAST_P     (1)
 #define PAST_F     (2)
+#define PAST_A     (3)
+#define PAST_N     (4)
+#define PAST_S     (5)
+
+/* The arbitrary waveform table, one period of uploaded samples where 0xffff is the set voltage */
+#ifndef FUNCGEN_ARB_POINTS
+ #define FUNCGEN_ARB_POINTS  (128)
+#endif
+static uint16_t arb_table[FUNCGEN_ARB_POINTS];
+/* Number of valid samples in arb_table, the arbitrary function outputs 0V while it is 0 */
+static volatile uint32_t arb_len;
+/* Where the table is persisted when an upload completes */
+static past_t *arb_past;
 
 /* This is the definition of the voltage item in the UI */
 ui_number_t gen_voltage = {
@@ -122,7 +224,11 @@ ui_number_t gen_freq = {
     .min = 0,
     .max = MAX_FREQUENCY * 10, /* In dHz */
     .si_prefix = si_deci,
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+    .num_digits = 4,
+#else // CONFIG_FUNCGEN_DAC_DMA
     .num_digits = 3,
+#endif // CONFIG_FUNCGEN_DAC_DMA
     .num_decimals = 1,
     .unit = unit_hertz,
     .changed = &frequency_changed,
@@ -141,21 +247,31 @@ ui_icon_t gen_func = {
     .icons_width = GFX_SQUARE_WIDTH,
     .icons_height = GFX_SQUARE_HEIGHT,
     .value = 0,
-    .num_icons = 3,
+    .num_icons = 4,
     .changed = &func_changed,
-    .icons = { gfx_square, gfx_saw, gfx_sin}
+    .icons = { gfx_square, gfx_saw, gfx_sin, gfx_arb }
+};
+
+/* Drawn once per display clear, the display is cleared when switching to
+   or from this screen as its layout differs from the other functions */
+static const ui_label_t gen_labels[] = {
+    { .text = "Vout:", .x = 6, .y = 15+FONT_FULL_SMALL_MAX_GLYPH_HEIGHT },
+    { .text = "Freq:", .x = 6, .y = 42+FONT_FULL_SMALL_MAX_GLYPH_HEIGHT },
+    { .text = "Func:", .x = 6, .y = 69+FONT_FULL_SMALL_MAX_GLYPH_HEIGHT },
 };
 
 /* This is the screen definition */
-ui_screen_t gen_screen = {
+static const ui_screen_desc_t gen_screen_desc = {
     .id = SCREEN_ID,
     .name = "funcgen",
     .icon_data = (uint8_t *) gfx_sin,
     .icon_data_len = sizeof(gfx_sin),
     .icon_width = GFX_SIN_WIDTH,
     .icon_height = GFX_SIN_HEIGHT,
-    .activated = &activated,
-    .deactivated = &deactivated,
+    .labels = gen_labels,
+    .num_labels = sizeof(gen_labels) / sizeof(gen_labels[0]),
+    .activated = NULL,
+    .deactivated = NULL,
     .enable = &funcgen_enable,
     .past_save = &past_save,
     .past_restore = &past_restore,
@@ -179,6 +295,16 @@ ui_screen_t gen_screen = {
             .unit = unit_none,
             .prefix = si_none
         },
+        {
+            .name = "duty",
+            .unit = unit_none,
+            .prefix = si_none
+        },
+        {
+            .name = "offset",
+            .unit = unit_volt,
+            .prefix = si_milli
+        },
         {
             .name = {'\0'} /** Terminator */
         },
@@ -186,141 +312,159 @@ ui_screen_t gen_screen = {
     .items = { (ui_item_t*) &gen_voltage, (ui_item_t*) &gen_freq, (ui_item_t*) &gen_func }
 };
 
+ui_screen_t gen_screen = {
+    .desc = &gen_screen_desc,
+};
+
 /**
- * @brief      Compute a square signal as selected by the user
+ * @brief      Compute the uploaded arbitrary signal as selected by the user
  *
- * @param[in]  time   the current clock in microsecond 
- * @param[in]  period period of the generated signal in microsecond (frequency in range 0 to 5KHz, period is in range 200 to 1<<31)
- * @param[in]  max    the amplitude of the voltage for this generator
+ * @param[in]  phase  position in the period, 0 to 2^32
+ * @param[in]  p      the generator settings
  *
  * @retval     int32_t the voltage to apply
  */
-static int32_t square_gen(uint32_t time_in_us, uint32_t period_in_us, int32_t max)
+RAMFUNC_HOOK static int32_t arb_gen(uint32_t phase, const gen_params_t *p)
 {
-    if (!period_in_us) return max;
-    /** The time is ticking at 1000000Hz so a unit is 1us. The production is 1 for t in [(t%T) ; (t%T+T/2)], 0 otherwise */
-    uint32_t t = time_in_us % period_in_us;
-    return t <= period_in_us / 2 ? max : 0;
+    return wavegen_table(phase, p->voltage, arb_table, arb_len);
 }
 
 /**
- * @brief      Compute a saw signal as selected by the user
+ * @brief      Compute the square wave, high until the phase set by the duty cycle
  *
- * @param[in]  time   the current clock in microsecond 
- * @param[in]  period period of the generated signal in microsecond (frequency in range 0 to 5KHz, period is in range 200 to 1<<31)
- * @param[in]  max    the amplitude of the voltage for this generator
+ * @param[in]  phase  position in the period, 0 to 2^32
+ * @param[in]  p      the generator settings
  *
  * @retval     int32_t the voltage to apply
  */
-static int32_t saw_gen(uint32_t time_in_us, uint32_t period_in_us, int32_t max)
+RAMFUNC_HOOK static int32_t square_gen(uint32_t phase, const gen_params_t *p)
 {
-    if (!period_in_us) return max;
-    /* The time is ticking at 1000000Hz so a unit is 1us. The production is (max*(t%T))/T */
-    uint64_t t = time_in_us % period_in_us;
-    /* Here, because the longest period is 10s and max is in millivolt, we can overflow an uint32_t
-       Since CortexM3 has a hw 64 bits multiply and divider, it shouldn't cost more to use it */
-    return (int32_t)((t * max) / period_in_us);
+    return wavegen_pulse(phase, p->voltage, p->duty);
 }
 
-/*
- * The number of bits of our data type: here 16 (sizeof operator returns bytes).
- */
-#define INT16_BITS  (8 * sizeof(int16_t))
-#ifndef INT16_MAX
-#define INT16_MAX   ((1<<(INT16_BITS-1))-1)
-#endif
- 
-/*
- * "5 bit" large table = 32 values. The mask: all bit belonging to the table
- * are 1, the all above 0.
- */
-#define TABLE_BITS  (5)
-#define TABLE_SIZE  (1<<TABLE_BITS)
-#define TABLE_MASK  (TABLE_SIZE-1)
- 
-/*
- * The lookup table is to 90DEG, the input can be -360 to 360 DEG, where negative
- * values are transformed to positive before further processing. We need two
- * additional bits (*4) to represent 360 DEG:
- */
-#define LOOKUP_BITS (TABLE_BITS+2)
-#define LOOKUP_MASK ((1<<LOOKUP_BITS)-1)
-#define FLIP_BIT    (1<<TABLE_BITS)
-#define NEGATE_BIT  (1<<(TABLE_BITS+1))
-#define INTERP_BITS (INT16_BITS-1-LOOKUP_BITS)
-#define INTERP_MASK ((1<<INTERP_BITS)-1)
- 
 /**
- * "5 bit" lookup table for the offsets. These are the sines for exactly
- * at 0deg, 11.25deg, 22.5deg etc. The values are from -1 to 1 in Q15.
- */
-static int16_t sin90[TABLE_SIZE+1] = {
-  0x0000,0x0647,0x0c8b,0x12c7,0x18f8,0x1f19,0x2527,0x2b1e,
-  0x30fb,0x36b9,0x3c56,0x41cd,0x471c,0x4c3f,0x5133,0x55f4,
-  0x5a81,0x5ed6,0x62f1,0x66ce,0x6a6c,0x6dc9,0x70e1,0x73b5,
-  0x7640,0x7883,0x7a7c,0x7c29,0x7d89,0x7e9c,0x7f61,0x7fd7,
-  0x7fff
-};
- 
-/**
- * Sine calculation using interpolated table lookup.
- * Instead of radiants or degrees we use "turns" here. Means this
- * sine does NOT return one phase for 0 to 2*PI, but for 0 to 1.
- * Input: -1 to 1 as int16 Q15  == -32768 to 32767.
- * Output: -1 to 1 as int16 Q15 == -32768 to 32767.
+ * @brief      Compute the saw tooth
  *
- * See the full description at www.AtWillys.de for the detailed
- * explanation.
+ * @param[in]  phase  position in the period, 0 to 2^32
+ * @param[in]  p      the generator settings
  *
- * @param int16_t angle Q15
- * @return int16_t Q15
+ * @retval     int32_t the voltage to apply
  */
-static int16_t sin1(int16_t angle)
+RAMFUNC_HOOK static int32_t saw_gen(uint32_t phase, const gen_params_t *p)
 {
-  int16_t v0, v1;
-  if(angle < 0) { angle += INT16_MAX; angle += 1; }
-  v0 = (angle >> INTERP_BITS);
-  if(v0 & FLIP_BIT) { v0 = ~v0; v1 = ~angle; } else { v1 = angle; }
-  v0 &= TABLE_MASK;
-  v1 = sin90[v0] + (int16_t) (((int32_t) (sin90[v0+1]-sin90[v0]) * (v1 & INTERP_MASK)) >> INTERP_BITS);
-  if((angle >> INTERP_BITS) & NEGATE_BIT) v1 = -v1;
-  return v1;
+    return wavegen_saw(phase, p->voltage);
 }
 
-
 /**
- * @brief      Compute a sin signal as selected by the user
+ * @brief      Compute the sine
  *
- * @param[in]  time   the current clock in microsecond 
- * @param[in]  period period of the generated signal in microsecond (frequency in range 0 to 5KHz, period is in range 200 to 1<<31)
- * @param[in]  max    the amplitude of the voltage for this generator
+ * @param[in]  phase  position in the period, 0 to 2^32
+ * @param[in]  p      the generator settings
  *
  * @retval     int32_t the voltage to apply
  */
-static int32_t sin_gen(uint32_t time_in_us, uint32_t period_in_us, int32_t max)
+RAMFUNC_HOOK static int32_t sin_gen(uint32_t phase, const gen_params_t *p)
 {
-    if (!period_in_us) return max;
-    /** The time is ticking at 1000000Hz so a unit is 1us. The production is (max/2) * sin((t%T)/T*2*PI) + (max/2) */
-    uint64_t t = time_in_us % period_in_us;
-    
-    /* Here, because the longest period is 10s and max is in millivolt, we can overflow an uint32_t
-       Since CortexM3 has a hw 64 bits multiply and divider, it shouldn't cost more to use it.
-       There's a small error in amplitude here to avoid dividing by 32767 */
-    return (max/2) * sin1((int16_t)((t * 32768) / period_in_us)) / 32768 + max/2; 
+    return wavegen_sin(phase, p->voltage);
 }
 
+#ifndef CONFIG_FUNCGEN_DAC_DMA
 /**
  * @brief     Get the new output to apply to the DAC.
  *            This is called in a ISR context, so we have to be as fast as possible here.
- */ 
-static void func_gen(void)
+ *            The phase accumulator is advanced by the time since the last call,
+ *            only the low 16 bits of the clock are used so the high word rolling
+ *            over cannot cause a glitch.
+ * @param     i_raw unused
+ * @param     v_in_raw unused
+ * @param     v_out_raw unused
+ */
+RAMFUNC_HOOK static void func_gen(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw)
 {
-    /* period_us is updated atomically (it's a word) in the UI's event code and so is max value */
-    int32_t v = (*compute_func)(cur_time_us(), period_us, gen_voltage.value);
-    (void) pwrctl_set_vout(v);
+    (void) i_raw;
+    (void) v_in_raw;
+    (void) v_out_raw;
+    PERF_BEGIN(perf_func_gen);
+    uint16_t now = cur_time_us();
+    uint16_t dt = now - last_time_us;
+    last_time_us = now;
+    /* The UI publishes frequency, function and voltage together, one read gets a matching set */
+    const gen_params_t *p = ctrlblk_read(&gen_ctrl);
+    int32_t v;
+    if (!p->phase_inc) {
+        v = p->voltage;
+    } else {
+        uint32_t inc = p->phase_inc;
+        if (gen_version != gen_ctrl.version) {
+            /* New settings restart the sweep and the burst */
+            gen_version = gen_ctrl.version;
+            sweep_inc = p->sweep_start;
+            burst_count = 0;
+        }
+        if (p->sweep_rate) {
+            int64_t step = p->sweep_rate;
+            if (p->sweep_log) {
+                step = ((sweep_inc >> SWEEP_FRAC_BITS) * p->sweep_rate) >> (SWEEP_LOG_BITS - SWEEP_FRAC_BITS);
+            }
+            sweep_inc += step * dt;
+            if (p->sweep_rate > 0 ? sweep_inc >= p->sweep_end : sweep_inc <= p->sweep_end) {
+                sweep_inc = p->sweep_start;
+            }
+            inc = (uint32_t) (sweep_inc >> SWEEP_FRAC_BITS);
+        }
+        uint32_t last = (uint32_t) (phase >> PHASE_FRAC_BITS);
+        phase += (uint64_t) inc * dt;
+        uint32_t cur = (uint32_t) (phase >> PHASE_FRAC_BITS);
+        if (p->burst && cur < last && burst_count < p->burst_limit && ++burst_count == p->burst_period) {
+            burst_count = 0;
+        }
+        v = !p->burst || burst_count < p->burst ? (*p->compute_func)(cur, p) : 0;
+    }
+    (void) pwrctl_set_vout(v + p->offset);
 //    pwrctl_enable_vout(v > 0);
+    PERF_END(perf_func_gen);
+}
+
+RAMFUNC_HOOK uint32_t func_gen_phase(void)
+{
+    return (uint32_t) (phase >> PHASE_FRAC_BITS);
 }
+#endif // CONFIG_FUNCGEN_DAC_DMA
 
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+/**
+ * @brief     Render one period of the current waveform and (re)start streaming it.
+ *            Called from the UI whenever a parameter changes while enabled.
+ */
+static void wave_update(void)
+{
+    const gen_params_t *gen = ctrlblk_read(&gen_ctrl);
+    if (!wave_enabled) {
+        return;
+    }
+    uint32_t freq = gen_freq.value; /* dHz */
+    uint32_t points = FUNCGEN_WAVE_POINTS;
+    if (freq == 0) {
+        /* DC at the set voltage */
+        points = 1;
+        freq = 10;
+    } else if ((uint64_t) freq * points > (uint64_t) DAC_WAVE_MAX_RATE * 10) {
+        points = (DAC_WAVE_MAX_RATE * 10) / freq;
+    }
+    if (freq % 10 && points >= 10) {
+        /* Keep the sample rate a whole number of Hz for fractional frequencies */
+        points -= points % 10;
+    }
+    for (uint32_t i = 0; i < points; i++) {
+        uint32_t p = (uint32_t) (((uint64_t) i << 32) / points);
+        int32_t mv = (gen_freq.value ? (*gen->compute_func)(p, gen) : gen->voltage) + gen->offset;
+        wave_buf[i] = pwrctl_calc_vout_dac(mv);
+    }
+    if (!hw_dac_wave_start(wave_buf, points, (freq * points + 5) / 10)) {
+        emu_printf("[FNCGEN] Failed to start DAC DMA\n");
+    }
+}
+#endif // CONFIG_FUNCGEN_DAC_DMA
 
 /**
  * @brief      Set function parameter
@@ -330,7 +474,7 @@ static void func_gen(void)
  *
  * @retval     set_param_status_t status code
  */
-static set_param_status_t set_parameter(char *name, char *value)
+static set_param_status_t set_parameter(const char *name, char *value)
 {
     int32_t ivalue = atoi(value);
     if (strcmp("voltage", name) == 0 || strcmp("u", name) == 0) {
@@ -361,7 +505,59 @@ static set_param_status_t set_parameter(char *name, char *value)
         func_changed(&gen_func);
         return ps_ok;
     }
-    return ps_unknown_name;
+    gen_shape_t shape = gen_shape;
+    if (strcmp("duty", name) == 0) {
+        if (ivalue < MIN_DUTY || ivalue > MAX_DUTY) {
+            return ps_range_error;
+        }
+        shape.duty = ivalue;
+    } else if (strcmp("offset", name) == 0) {
+        if (ivalue < 0 || ivalue > gen_voltage.max) {
+            return ps_range_error;
+        }
+        shape.offset = ivalue;
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+    } else if (strcmp("burst", name) == 0 || strcmp("burst_period", name) == 0 || strcmp("sweep_to", name) == 0 ||
+               strcmp("sweep_ms", name) == 0 || strcmp("sweep_log", name) == 0) {
+        /** The DMA repeats a single rendered period */
+        return ps_not_supported;
+#else // CONFIG_FUNCGEN_DAC_DMA
+    } else if (strcmp("burst", name) == 0) {
+        if (ivalue < 0 || (shape.burst_period && ivalue >= shape.burst_period)) {
+            return ps_range_error;
+        }
+        shape.burst = ivalue;
+    } else if (strcmp("burst_period", name) == 0) {
+        if (ivalue < 0 || (ivalue && ivalue <= shape.burst)) {
+            return ps_range_error;
+        }
+        shape.burst_period = ivalue;
+    } else if (strcmp("sweep_to", name) == 0) {
+        if (ivalue < 0 || ivalue > gen_freq.max) {
+            return ps_range_error;
+        }
+        shape.sweep_to = ivalue;
+    } else if (strcmp("sweep_ms", name) == 0) {
+        if (ivalue < MIN_SWEEP_MS || ivalue > MAX_SWEEP_MS) {
+            return ps_range_error;
+        }
+        shape.sweep_ms = ivalue;
+    } else if (strcmp("sweep_log", name) == 0) {
+        if (ivalue < 0 || ivalue > 1) {
+            return ps_range_error;
+        }
+        shape.sweep_log = ivalue;
+#endif // CONFIG_FUNCGEN_DAC_DMA
+    } else {
+        return ps_unknown_name;
+    }
+    emu_printf("[FNCGEN] Setting %s to %d\n", name, ivalue);
+    gen_shape = shape;
+    gen_publish();
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+    wave_update();
+#endif // CONFIG_FUNCGEN_DAC_DMA
+    return ps_ok;
 }
 
 /**
@@ -373,30 +569,123 @@ static set_param_status_t set_parameter(char *name, char *value)
  *
  * @retval     set_param_status_t status code
  */
-static set_param_status_t get_parameter(char *name, char *value, uint32_t value_len)
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len)
 {
     if (strcmp("voltage", name) == 0 || strcmp("u", name) == 0) {
         /** value returned in millivolt, module internal representation is centivolt */
-        (void) mini_snprintf(value, value_len, "%d", gen_voltage.value);
+        (void) numfmt_int(value, value_len, gen_voltage.value);
         return ps_ok;
     } else if (strcmp("freq", name) == 0 || strcmp("f", name) == 0) {
-        (void) mini_snprintf(value, value_len, "%d", gen_freq.value);
+        (void) numfmt_int(value, value_len, gen_freq.value);
         return ps_ok;
     } else if (strcmp("func", name) == 0 || strcmp("n", name) == 0) {
-        (void) mini_snprintf(value, value_len, "%d", gen_func.value);
+        (void) numfmt_int(value, value_len, gen_func.value);
+        return ps_ok;
+    } else if (strcmp("duty", name) == 0) {
+        (void) numfmt_int(value, value_len, gen_shape.duty);
+        return ps_ok;
+    } else if (strcmp("offset", name) == 0) {
+        (void) numfmt_int(value, value_len, gen_shape.offset);
+        return ps_ok;
+    } else if (strcmp("burst", name) == 0) {
+        (void) numfmt_int(value, value_len, gen_shape.burst);
+        return ps_ok;
+    } else if (strcmp("burst_period", name) == 0) {
+        (void) numfmt_int(value, value_len, gen_shape.burst_period);
+        return ps_ok;
+    } else if (strcmp("sweep_to", name) == 0) {
+        (void) numfmt_int(value, value_len, gen_shape.sweep_to);
+        return ps_ok;
+    } else if (strcmp("sweep_ms", name) == 0) {
+        (void) numfmt_int(value, value_len, gen_shape.sweep_ms);
+        return ps_ok;
+    } else if (strcmp("sweep_log", name) == 0) {
+        (void) numfmt_int(value, value_len, gen_shape.sweep_log);
         return ps_ok;
     }
     return ps_unknown_name;
 }
 
 /**
- * @brief       Compute the period in microsecond from the given frequency 
+ * @brief       Compute the phase increment per microsecond from the given frequency
  * @param[in]   freq    Frequency in dHz
+ * @retval      the phase increment
+ */
+static uint32_t compute_phase_inc_from_freq(int32_t freq)
+{
+    /* One period is 2^(32+PHASE_FRAC_BITS) and lasts 1e7/freq us as the frequency is in dHz */
+    if (freq <= 0) {
+        return 0;
+    } else {
+        return (uint32_t) ((((uint64_t) freq << (32 + PHASE_FRAC_BITS)) + 5000000) / 10000000);
+    }
+}
+
+#ifndef CONFIG_FUNCGEN_DAC_DMA
+/**
+ * @brief       Base 2 logarithm
+ * @param[in]   x       the value, above 0
+ * @retval      log2(x) with 16 fractional bits
  */
-static void compute_period_from_freq(int32_t freq)
+static int32_t log2_q16(uint32_t x)
 {
-    /* Compute the period to use in microseconds, that's 1e6/freq (and since the frequency is in dHz, needs Hz here) */
-    period_us = (uint32_t)(1000000.0 / (freq * 0.1) + .5);
+    int32_t n = 31 - __builtin_clz(x);
+    /* x / 2^n is in [1, 2), each squaring yields one more fractional bit */
+    uint64_t y = ((uint64_t) x << 30) >> n;
+    int32_t result = n << 16;
+    for (int32_t bit = 1 << 15; bit; bit >>= 1) {
+        y = (y * y) >> 30;
+        if (y >= (2ULL << 30)) {
+            y >>= 1;
+            result |= bit;
+        }
+    }
+    return result;
+}
+#endif // CONFIG_FUNCGEN_DAC_DMA
+
+/**
+ * @brief       Publish the voltage, frequency and function items and the
+ *              parameter only settings to the generator. Everything the ISR
+ *              needs is precomputed here so its cost does not depend on them.
+ */
+static void gen_publish(void)
+{
+    static const compute_func_t funcs[] = { &square_gen, &saw_gen, &sin_gen, &arb_gen, 0 };
+    uint32_t inc = compute_phase_inc_from_freq(gen_freq.value);
+    int64_t sweep_start = (int64_t) inc << SWEEP_FRAC_BITS;
+    int64_t sweep_end = sweep_start;
+    int64_t sweep_rate = 0;
+#ifndef CONFIG_FUNCGEN_DAC_DMA
+    if (inc && gen_shape.sweep_to && gen_shape.sweep_to != gen_freq.value) {
+        int64_t us = (int64_t) gen_shape.sweep_ms * 1000;
+        sweep_end = (int64_t) compute_phase_inc_from_freq(gen_shape.sweep_to) << SWEEP_FRAC_BITS;
+        if (gen_shape.sweep_log) {
+            /* The increment grows by ln(end/start) / us per microsecond, ln(2) has 32 fractional bits */
+            int64_t octaves = log2_q16(gen_shape.sweep_to) - log2_q16(gen_freq.value);
+            sweep_rate = ((octaves * 2977044472LL) >> (32 + 16 - SWEEP_LOG_BITS)) / us;
+        } else {
+            sweep_rate = (sweep_end - sweep_start) / us;
+        }
+        if (!sweep_rate) {
+            sweep_rate = sweep_end > sweep_start ? 1 : -1;
+        }
+    }
+#endif // CONFIG_FUNCGEN_DAC_DMA
+    gen_params_t *p = ctrlblk_begin(&gen_ctrl);
+    p->phase_inc = inc;
+    p->compute_func = funcs[gen_func.value];
+    p->voltage = gen_voltage.value;
+    p->offset = gen_shape.offset;
+    p->duty = (uint32_t) (((uint64_t) gen_shape.duty << 32) / 100);
+    p->burst = gen_shape.burst;
+    p->burst_period = gen_shape.burst_period;
+    p->burst_limit = gen_shape.burst_period ? gen_shape.burst_period : gen_shape.burst;
+    p->sweep_start = sweep_start;
+    p->sweep_end = sweep_end;
+    p->sweep_rate = sweep_rate;
+    p->sweep_log = gen_shape.sweep_log;
+    ctrlblk_publish(&gen_ctrl);
 }
 
 /**
@@ -408,22 +697,33 @@ static void funcgen_enable(bool enabled)
 {
     emu_printf("[FNCGEN] %s output\n", enabled ? "Enable" : "Disable");
     if (enabled) {
-        compute_period_from_freq(gen_freq.value);
-        func_changed(&gen_func);
+        gen_publish();
+        phase = 0;
+        last_time_us = cur_time_us();
         /* Draw the current function to the expected position */
-        tft_blit((uint16_t*) gen_func.icons[gen_func.value], gen_func.icons_width, gen_func.icons_height, XPOS_ICON, 128 - GFX_SIN_HEIGHT);
-        (void) pwrctl_set_vout(gen_voltage.value);
-        (void) pwrctl_set_iout(CONFIG_DPS_MAX_CURRENT);
+        tft_blit_compressed(gen_func.icons[gen_func.value], gen_func.icons_width, gen_func.icons_height, XPOS_ICON, 128 - GFX_SIN_HEIGHT);
+        (void) pwrctl_set_vout_iout(gen_voltage.value, CONFIG_DPS_MAX_CURRENT);
         (void) pwrctl_set_vlimit(0xFFFF);
         (void) pwrctl_set_ilimit(0xFFFF); /** Set the current limit to the maximum to prevent OCP (over current protection) firing */
         pwrctl_enable_vout(true);
-        funcgen_tick = &func_gen;
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+        wave_enabled = true;
+        wave_update();
+#else // CONFIG_FUNCGEN_DAC_DMA
+        isrhook_set(isrhook_funcgen, &func_gen, ISRHOOK_BUDGET_FUNCGEN);
+#endif // CONFIG_FUNCGEN_DAC_DMA
     } else {
-        funcgen_tick = &fg_noop;
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+        wave_enabled = false;
+        hw_dac_wave_stop();
+#else // CONFIG_FUNCGEN_DAC_DMA
+        isrhook_set(isrhook_funcgen, NULL, 0);
+#endif // CONFIG_FUNCGEN_DAC_DMA
         (void) pwrctl_set_vout(0);
         pwrctl_enable_vout(false);
         /** Ensure the function logo has been cleared from the screen */
         tft_fill(XPOS_ICON, 128 - GFX_SIN_HEIGHT, GFX_SIN_WIDTH, GFX_SIN_HEIGHT, BLACK);
+        uui_invalidate_icon(&gen_screen);
     }
 }
 
@@ -435,6 +735,10 @@ static void funcgen_enable(bool enabled)
 static void voltage_changed(ui_number_t * item)
 {
     (void)item;
+    gen_publish();
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+    wave_update();
+#endif // CONFIG_FUNCGEN_DAC_DMA
 }
 
 /**
@@ -444,7 +748,11 @@ static void voltage_changed(ui_number_t * item)
  */
 static void frequency_changed(ui_number_t *item)
 {
-    compute_period_from_freq(item->value);
+    (void)item;
+    gen_publish();
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+    wave_update();
+#endif // CONFIG_FUNCGEN_DAC_DMA
 }
 
 /**
@@ -454,33 +762,11 @@ static void frequency_changed(ui_number_t *item)
  */
 static void func_changed(ui_icon_t *item)
 {
-    static compute_func_t funcs[] = { &square_gen, &saw_gen, &sin_gen, 0 };
-    compute_func = funcs[item->value];
-}
-
-/**
- * @brief      Do any required clean up before changing away from this screen
- */
-static void activated(void)
-{
-    /** The screen is different here, let's clear it */
-    tft_clear();
-    for (uint32_t i = 0; i < gen_screen.num_items; i++) {
-        gen_screen.items[i]->draw(gen_screen.items[i]);
-    }
-    tft_puts(FONT_FULL_SMALL, "Vout:", 6, 15+FONT_FULL_SMALL_MAX_GLYPH_HEIGHT, 64, 20, WHITE, false);
-    tft_puts(FONT_FULL_SMALL, "Freq:", 6, 42+FONT_FULL_SMALL_MAX_GLYPH_HEIGHT, 64, 20, WHITE, false);
-    tft_puts(FONT_FULL_SMALL, "Func:", 6, 69+FONT_FULL_SMALL_MAX_GLYPH_HEIGHT, 64, 20, WHITE, false);
-}
-
-
-/**
- * @brief      Do any required clean up before changing away from this screen
- */
-static void deactivated(void)
-{
-    /** Ensure the sin logo has been cleared from the screen */
-    tft_clear();
+    (void)item;
+    gen_publish();
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+    wave_update();
+#endif // CONFIG_FUNCGEN_DAC_DMA
 }
 
 /**
@@ -492,15 +778,18 @@ static void past_save(past_t *past)
 {
     int32_t t = gen_voltage.value;
     /** @todo: past bug causes corruption for units smaller than 4 bytes (#27) */
-    if (!past_write_unit(past, (SCREEN_ID << 24) | PAST_U, (void*) &t, 4 /* sizeof(gen_voltage.value) */ )) {
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_U, (void*) &t, 4 /* sizeof(gen_voltage.value) */ )) {
         /** @todo: handle past write failures */
     }
     t = gen_freq.value;
-    if (!past_write_unit(past, (SCREEN_ID << 24) | PAST_P, (void*) &t, 4 /* sizeof(gen_freq.value) */ )) {
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_P, (void*) &t, 4 /* sizeof(gen_freq.value) */ )) {
         /** @todo: handle past write failures */
     }
     t = gen_func.value;
-    if (!past_write_unit(past, (SCREEN_ID << 24) | PAST_F, (void*) &t, 4 /* sizeof(gen_freq.value) */ )) {
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_F, (void*) &t, 4 /* sizeof(gen_freq.value) */ )) {
+        /** @todo: handle past write failures */
+    }
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_S, (void*) &gen_shape, sizeof(gen_shape))) {
         /** @todo: handle past write failures */
     }
 }
@@ -514,6 +803,7 @@ static void past_restore(past_t *past)
 {
     uint32_t length;
     uint32_t *p = 0;
+    arb_past = past;
     if (past_read_unit(past, (SCREEN_ID << 24) | PAST_U, (const void**) &p, &length)) {
         gen_voltage.value = *p;
         (void) length;
@@ -526,6 +816,20 @@ static void past_restore(past_t *past)
         gen_func.value = *p;
         (void) length;
     }
+    if (past_read_unit(past, (SCREEN_ID << 24) | PAST_S, (const void**) &p, &length) && length == sizeof(gen_shape)) {
+        const gen_shape_t *shape = (const gen_shape_t*) p;
+        if (shape->duty >= MIN_DUTY && shape->duty <= MAX_DUTY &&
+            shape->sweep_ms >= MIN_SWEEP_MS && shape->sweep_ms <= MAX_SWEEP_MS) {
+            gen_shape = *shape;
+        }
+    }
+    if (past_read_unit(past, (SCREEN_ID << 24) | PAST_N, (const void**) &p, &length) && *p <= FUNCGEN_ARB_POINTS) {
+        uint32_t len = *p;
+        if (past_read_unit(past, (SCREEN_ID << 24) | PAST_A, (const void**) &p, &length) && length >= 2 * len) {
+            memcpy(arb_table, p, 2 * len);
+            arb_len = len;
+        }
+    }
 }
 
 /**
@@ -538,16 +842,109 @@ static void past_restore(past_t *past)
  */
 static void func_gen_tick(void)
 {
-    uint16_t i_out_raw, v_in_raw, v_out_raw;
-    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
     /** Continously update max voltage output value
       * Max output voltage = Vin / VIN_VOUT_RATIO
       * Add 0.5f to ensure correct rounding when truncated */
-    gen_voltage.max = (float) pwrctl_calc_vin(v_in_raw) / VIN_VOUT_RATIO + 0.5f;
+    gen_voltage.max = (float) pwrctl_measured(pwrctl_meas_v_in) / VIN_VOUT_RATIO + 0.5f;
  //   if (gen_voltage.value > gen_voltage.max) 
  //       gen_voltage.value = gen_voltage.max;
 }
 
+#ifdef CONFIG_SERIAL_PROTOCOL
+/**
+  * @brief Handle a wave upload command, storing one chunk of the arbitrary waveform
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_wave_upload(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t flags, offset, count;
+    uint16_t samples[WAVE_UPLOAD_CHUNK];
+    if (!protocol_unpack_wave_upload(frame, &flags, &offset, &count, samples) ||
+        offset + count > FUNCGEN_ARB_POINTS || ((flags & WAVE_UPLOAD_COMMIT) && offset + count == 0)) {
+        return cmd_failed;
+    }
+    memcpy(&arb_table[offset], samples, 2 * count);
+    if (flags & WAVE_UPLOAD_COMMIT) {
+        uint32_t len = offset + count;
+        arb_len = len;
+        if (arb_past) {
+            /** Round up to whole words, see the past bug mentioned in past_save() */
+            if (!past_write_unit(arb_past, (SCREEN_ID << 24) | PAST_A, (void*) arb_table, (2 * len + 3) & ~3) ||
+                !past_write_unit(arb_past, (SCREEN_ID << 24) | PAST_N, (void*) &len, 4)) {
+                return cmd_failed;
+            }
+        }
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+        wave_update();
+#endif // CONFIG_FUNCGEN_DAC_DMA
+    }
+    return cmd_success;
+}
+
+static const command_entry_t wave_upload_command = {
+    .cmd = cmd_wave_upload, .min_length = 4, .handler = &handle_wave_upload
+};
+
+#ifdef CONFIG_LOCKIN
+/** Generator frequency in dHz when the lock-in measurement started */
+static uint16_t lockin_freq;
+
+/**
+  * @brief Handle a lock-in command, starting or reading a measurement
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_lockin(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, settle;
+    uint16_t periods;
+    lockin_result_t result;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &settle);
+    unpack16(frame, &periods);
+    if (periods) {
+        /** Without a running generator the phase never wraps */
+        if (!isrhook_is(isrhook_funcgen, &func_gen) || gen_freq.value <= 0) {
+            return cmd_failed;
+        }
+        lockin_freq = gen_freq.value;
+        return lockin_start(settle, periods) ? cmd_success : cmd_failed;
+    }
+
+    lockin_get(&result);
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_lockin);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, result.state);
+    pack16(frame_resp, lockin_freq);
+    pack32(frame_resp, result.samples);
+    pack32(frame_resp, result.i_dc);
+    pack32(frame_resp, result.v_dc);
+    pack32(frame_resp, (uint32_t) result.i_re);
+    pack32(frame_resp, (uint32_t) result.i_im);
+    pack32(frame_resp, (uint32_t) result.v_re);
+    pack32(frame_resp, (uint32_t) result.v_im);
+    end_frame(frame_resp);
+    serial_send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+static const command_entry_t lockin_command = {
+    .cmd = cmd_lockin, .min_length = 4, .handler = &handle_lockin
+};
+#endif // CONFIG_LOCKIN
+#endif // CONFIG_SERIAL_PROTOCOL
+
 /**
  * @brief      Initialise the CL module and add its screen to the UI
  *
@@ -570,4 +967,16 @@ void func_gen_init(uui_t *ui)
     number_init(&gen_freq);
     icon_init(&gen_func);
     uui_add_screen(ui, &gen_screen);
+#ifdef CONFIG_SERIAL_PROTOCOL
+    if (!serial_register_command(&wave_upload_command)) {
+        emu_printf("[FNCGEN] Failed to register the wave upload command\n");
+    }
+#ifdef CONFIG_LOCKIN
+    if (!serial_register_command(&lockin_command)) {
+        emu_printf("[FNCGEN] Failed to register the lock-in command\n");
+    }
+#endif // CONFIG_LOCKIN
+#endif // CONFIG_SERIAL_PROTOCOL
 }
+
+UUI_REGISTER_FUNCTION(60, func_gen_init);
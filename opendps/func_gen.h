@@ -36,16 +36,27 @@
  * - **Square**: Square wave with adjustable duty cycle
  * - **Sawtooth**: Linear ramp waveform
  * - **Triangle**: Symmetric triangle wave
+ * - **Arbitrary**: One period of samples uploaded with cmd_wave_upload
  *
  * ## Parameters
  *
- * | Name      | Unit | Description |
- * |-----------|------|-------------|
- * | waveform  | -    | Waveform type (sine, square, etc.) |
- * | frequency | Hz   | Output frequency |
- * | amplitude | mV   | Peak-to-peak voltage |
- * | offset    | mV   | DC offset voltage |
- * | duty      | %    | Duty cycle (for square wave) |
+ * | Name         | Unit | Description |
+ * |--------------|------|-------------|
+ * | func         | -    | Waveform type (square, saw, sine, arbitrary) |
+ * | freq         | dHz  | Output frequency |
+ * | voltage      | mV   | Peak-to-peak voltage |
+ * | offset       | mV   | DC offset voltage |
+ * | duty         | %    | Duty cycle of the square wave, 1 to 99 |
+ * | burst        | -    | Periods output per burst, 0 for a continuous output |
+ * | burst_period | -    | Periods from burst to burst, 0 for a single burst |
+ * | sweep_to     | dHz  | Frequency swept to from freq, 0 for no sweep |
+ * | sweep_ms     | ms   | Duration of a sweep, it then starts over |
+ * | sweep_log    | -    | 1 for a logarithmic sweep, 0 for a linear one |
+ *
+ * Only voltage, freq and func are on the screen, the rest are set with
+ * dpsctl -p and persisted with them. Any parameter change restarts the
+ * burst and the sweep, between bursts the output is at the offset. The
+ * burst and sweep parameters are not supported with CONFIG_FUNCGEN_DAC_DMA.
  *
  * ## Limitations
  *
@@ -57,12 +68,17 @@
  *
  * ## Implementation
  *
- * The function generator uses the funcgen_tick callback from hw.h
- * which is called at a high rate (~50 kHz) from the ADC ISR.
- * This provides consistent timing for waveform generation.
+ * The function generator sets the isrhook_funcgen hook of isrhook.h, which
+ * is called at a high rate (~21 kHz) from the ADC ISR. Each call
+ * advances a phase accumulator by the microseconds elapsed times an
+ * increment precomputed from the frequency, and the top bits of the phase
+ * index the wavetable. The ISR does no divisions and the frequency does not
+ * depend on the exact ADC rate. Duty cycle, offset, burst and sweep are
+ * turned into phase thresholds, period counts and a per microsecond change
+ * of the phase increment when a parameter changes.
  *
  * @note This function is only available when CONFIG_FUNCGEN_ENABLE is defined
- * @see hw.h for the funcgen_tick mechanism
+ * @see isrhook.h for the per sample hooks
  * @see uui.h for the UI framework
  */
 
@@ -89,4 +105,15 @@
  */
 void func_gen_init(uui_t *ui);
 
+#ifndef CONFIG_FUNCGEN_DAC_DMA
+/**
+ * @brief Get the phase of the waveform being generated
+ *
+ * @return the phase, 0 to 2^32 for one period
+ * @note Read from the ADC ISR by the lock-in hook, which runs after the
+ *       function generator hook, see lockin.h
+ */
+uint32_t func_gen_phase(void);
+#endif // CONFIG_FUNCGEN_DAC_DMA
+
 #endif // __FUNC_GEN_H__
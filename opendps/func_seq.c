@@ -0,0 +1,567 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfx-seq.h"
+#include "hw.h"
+#include "tick.h"
+#include "func_seq.h"
+#include "uui.h"
+#include "uui_number.h"
+#include "dbg_printf.h"
+#include "numfmt.h"
+#include "dps-model.h"
+#include "ili9163c.h"
+#include "font-full_small.h"
+#include "opendps.h"
+#ifdef CONFIG_SERIAL_PROTOCOL
+#include "uframe.h"
+#include "protocol.h"
+#include "serialhandler.h"
+#endif // CONFIG_SERIAL_PROTOCOL
+
+/*
+ * This is the implementation of the sequencer screen. It shows the setpoints
+ * of the running step, the step number and has one editable value, the number
+ * of loops. The program itself is uploaded with cmd_seq_upload.
+ *
+ * While a program runs the TIM3 ISR owns the run state below. It applies a
+ * step and starts the alarm for the end of it, the UI only reads the state
+ * and starts the alarm when the program waits for a trigger.
+ */
+
+static void seq_enable(bool _enable);
+static void loops_changed(ui_number_t *item);
+static void seq_tick(void);
+static void past_save(past_t *past);
+static void past_restore(past_t *past);
+static set_param_status_t set_parameter(const char *name, char *value);
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len);
+static void seq_advance(void);
+
+#define SCREEN_ID  (6)
+#define PAST_L     (0)
+#define PAST_T     (1)
+#define PAST_S     (2)
+#define PAST_N     (3)
+
+#ifndef SEQ_MAX_STEPS
+ #define SEQ_MAX_STEPS  (32)
+#endif
+
+/* cur_step before the first step of a run has been applied */
+#define SEQ_NOT_STARTED  (0xffffffff)
+
+typedef enum {
+    seq_trigger_enable = 0, /** Start when the output is enabled */
+    seq_trigger_wait,       /** Start on the first trigger */
+    seq_trigger_last
+} seq_trigger_t;
+
+typedef struct {
+    uint32_t duration_us; /** 0 holds the step until the next trigger */
+    uint16_t mv;
+    uint16_t ma;
+} seq_step_t;
+
+/* The program, only changed when not running */
+static seq_step_t steps[SEQ_MAX_STEPS];
+static uint32_t num_steps;
+static seq_trigger_t trigger_mode;
+/* Where the program is persisted when an upload completes */
+static past_t *seq_past;
+
+/* Run state */
+static volatile bool running;   /** A program is running, cleared by the ISR after the last loop */
+static volatile bool waiting;   /** The current step waits for a trigger, no alarm is pending */
+static volatile bool finished;  /** Set by the ISR after the last loop for the tick to turn off the output */
+static volatile uint32_t cur_step;
+static volatile uint32_t loop_count;
+static uint64_t next_at;        /** End of the current step in get_time_us() time */
+
+/* This is the definition of the voltage item in the UI */
+ui_number_t seq_voltage = {
+    {
+        .type = ui_item_number,
+        .id = 10,
+        .x = 120,
+        .y = 10,
+        .can_focus = false,
+    },
+    .font_size = FONT_METER_MEDIUM,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = COLOR_VOLTAGE,
+    .value = 0,
+    .min = 0,
+    .max = 0,
+    .si_prefix = si_milli,
+    .num_digits = 2,
+    .num_decimals = 2,
+    .unit = unit_volt,
+};
+
+/* This is the definition of the current item in the UI */
+ui_number_t seq_current = {
+    {
+        .type = ui_item_number,
+        .id = 11,
+        .x = 120,
+        .y = 35,
+        .can_focus = false,
+    },
+    .font_size = FONT_METER_MEDIUM,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = COLOR_AMPERAGE,
+    .value = 0,
+    .min = 0,
+    .max = CONFIG_DPS_MAX_CURRENT,
+    .si_prefix = si_milli,
+    .num_digits = CURRENT_DIGITS,
+    .num_decimals = CURRENT_DECIMALS,
+    .unit = unit_ampere,
+};
+
+/* This is the definition of the step number item in the UI */
+ui_number_t seq_step = {
+    {
+        .type = ui_item_number,
+        .id = 12,
+        .x = 120,
+        .y = 60,
+        .can_focus = false,
+    },
+    .font_size = FONT_METER_MEDIUM,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = WHITE,
+    .value = 0,
+    .min = 0,
+    .max = SEQ_MAX_STEPS,
+    .si_prefix = si_none,
+    .num_digits = 2,
+    .num_decimals = 0,
+    .unit = unit_none,
+};
+
+/* This is the definition of the loop count item in the UI */
+ui_number_t seq_loops = {
+    {
+        .type = ui_item_number,
+        .id = 13,
+        .x = 120,
+        .y = 85,
+        .can_focus = true,
+    },
+    .font_size = FONT_METER_MEDIUM,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = WHITE,
+    .value = 1,
+    .min = 0,
+    .max = 99,
+    .si_prefix = si_none,
+    .num_digits = 2,
+    .num_decimals = 0,
+    .unit = unit_none,
+    .changed = &loops_changed,
+};
+
+/* The labels next to the items, the display is cleared when switching to or
+   from this screen as its layout differs from the other functions */
+static const ui_label_t seq_labels[] = {
+    { .text = "Vout:", .x = 6, .y = 10+FONT_FULL_SMALL_MAX_GLYPH_HEIGHT },
+    { .text = "Ilim:", .x = 6, .y = 35+FONT_FULL_SMALL_MAX_GLYPH_HEIGHT },
+    { .text = "Step:", .x = 6, .y = 60+FONT_FULL_SMALL_MAX_GLYPH_HEIGHT },
+    { .text = "Loops:", .x = 6, .y = 85+FONT_FULL_SMALL_MAX_GLYPH_HEIGHT },
+};
+
+/* This is the screen definition */
+static const ui_screen_desc_t seq_screen_desc = {
+    .id = SCREEN_ID,
+    .name = "seq",
+    .icon_data = (uint8_t *) gfx_seq,
+    .icon_data_len = sizeof(gfx_seq),
+    .icon_width = GFX_SEQ_WIDTH,
+    .icon_height = GFX_SEQ_HEIGHT,
+    .labels = seq_labels,
+    .num_labels = sizeof(seq_labels) / sizeof(seq_labels[0]),
+    .activated = NULL,
+    .deactivated = NULL,
+    .enable = &seq_enable,
+    .past_save = &past_save,
+    .past_restore = &past_restore,
+    .tick = &seq_tick,
+    .set_parameter = &set_parameter,
+    .get_parameter = &get_parameter,
+    .num_items = 4,
+    .parameters = {
+        {
+            .name = "loops",
+            .unit = unit_none,
+            .prefix = si_none
+        },
+        {
+            .name = "trigger",
+            .unit = unit_none,
+            .prefix = si_none
+        },
+        {
+            .name = "run",
+            .unit = unit_none,
+            .prefix = si_none
+        },
+        {
+            .name = {'\0'} /** Terminator */
+        },
+    },
+    .items = { (ui_item_t*) &seq_voltage, (ui_item_t*) &seq_current, (ui_item_t*) &seq_step, (ui_item_t*) &seq_loops }
+};
+
+ui_screen_t seq_screen = {
+    .desc = &seq_screen_desc,
+};
+
+/**
+ * @brief      Apply the next step of the program, called from the TIM3 ISR
+ */
+static void seq_advance(void)
+{
+    uint32_t i = cur_step + 1;
+    if (i >= num_steps) {
+        loop_count++;
+        if (seq_loops.value && loop_count >= (uint32_t) seq_loops.value) {
+            (void) pwrctl_set_vout(0);
+            running = false;
+            finished = true;
+            return;
+        }
+        i = 0;
+    }
+    cur_step = i;
+    (void) pwrctl_set_vout(steps[i].mv);
+    (void) pwrctl_set_ilimit(steps[i].ma);
+    if (steps[i].duration_us) {
+        /** Deadlines are relative to the previous one so latency does not accumulate */
+        next_at += steps[i].duration_us;
+        hw_alarm_start(next_at, &seq_advance);
+    } else {
+        waiting = true;
+    }
+}
+
+/**
+ * @brief      Continue a program waiting for a trigger
+ *
+ * @retval     true if the program was waiting
+ */
+static bool seq_trigger(void)
+{
+    if (!running || !waiting) {
+        return false;
+    }
+    /** No alarm is pending while waiting so the ISR does not touch next_at */
+    waiting = false;
+    next_at = get_time_us();
+    hw_alarm_start(next_at, &seq_advance);
+    return true;
+}
+
+/**
+ * @brief      Set function parameter
+ *
+ * @param[in]  name   name of parameter
+ * @param[in]  value  value of parameter as a string - always in SI units
+ *
+ * @retval     set_param_status_t status code
+ */
+static set_param_status_t set_parameter(const char *name, char *value)
+{
+    int32_t ivalue = atoi(value);
+    if (strcmp("loops", name) == 0 || strcmp("l", name) == 0) {
+        if (ivalue < seq_loops.min || ivalue > seq_loops.max) {
+            emu_printf("[SEQ] Loops %d is out of range (min:%d max:%d)\n", ivalue, seq_loops.min, seq_loops.max);
+            return ps_range_error;
+        }
+        emu_printf("[SEQ] Setting loops to %d\n", ivalue);
+        seq_loops.value = ivalue;
+        loops_changed(&seq_loops);
+        return ps_ok;
+    } else if (strcmp("trigger", name) == 0 || strcmp("t", name) == 0) {
+        if (ivalue < 0 || ivalue >= seq_trigger_last) {
+            emu_printf("[SEQ] Trigger %d is out of range (min:0 max:%d)\n", ivalue, seq_trigger_last - 1);
+            return ps_range_error;
+        }
+        emu_printf("[SEQ] Setting trigger to %d\n", ivalue);
+        trigger_mode = ivalue;
+        return ps_ok;
+    } else if (strcmp("run", name) == 0 || strcmp("r", name) == 0) {
+        if (ivalue != 1) {
+            return ps_range_error;
+        }
+        return seq_trigger() ? ps_ok : ps_not_supported;
+    }
+    return ps_unknown_name;
+}
+
+/**
+ * @brief      Get function parameter
+ *
+ * @param[in]  name       name of parameter
+ * @param[in]  value      value of parameter as a string - always in SI units
+ * @param[in]  value_len  length of value buffer
+ *
+ * @retval     set_param_status_t status code
+ */
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len)
+{
+    if (strcmp("loops", name) == 0 || strcmp("l", name) == 0) {
+        (void) numfmt_int(value, value_len, seq_loops.value);
+        return ps_ok;
+    } else if (strcmp("trigger", name) == 0 || strcmp("t", name) == 0) {
+        (void) numfmt_int(value, value_len, trigger_mode);
+        return ps_ok;
+    } else if (strcmp("run", name) == 0 || strcmp("r", name) == 0) {
+        (void) numfmt_int(value, value_len, running ? 1 : 0);
+        return ps_ok;
+    }
+    return ps_unknown_name;
+}
+
+/**
+ * @brief      Show the setpoints of the first step while the output is off.
+ *             The items are drawn at the next refresh of the screen.
+ */
+static void show_program(void)
+{
+    seq_voltage.value = num_steps ? steps[0].mv : 0;
+    seq_current.value = num_steps ? steps[0].ma : 0;
+    seq_step.value = 0;
+    seq_voltage.ui.needs_redraw = true;
+    seq_current.ui.needs_redraw = true;
+    seq_step.ui.needs_redraw = true;
+}
+
+/**
+ * @brief      Callback for when the function is enabled
+ *
+ * @param[in]  enabled  true when function is enabled
+ */
+static void seq_enable(bool enabled)
+{
+    emu_printf("[SEQ] %s output\n", enabled ? "Enable" : "Disable");
+    if (enabled) {
+        cur_step = SEQ_NOT_STARTED;
+        loop_count = 0;
+        finished = false;
+        waiting = false;
+        (void) pwrctl_set_vout_iout(0, CONFIG_DPS_MAX_CURRENT);
+        (void) pwrctl_set_ilimit(num_steps ? steps[0].ma : CONFIG_DPS_MAX_CURRENT);
+        (void) pwrctl_set_vlimit(0xFFFF); /** Set the voltage limit to the maximum to prevent OVP (over voltage protection) firing */
+        pwrctl_enable_vout(true);
+        if (num_steps) {
+            running = true;
+            waiting = true;
+            if (trigger_mode == seq_trigger_enable) {
+                (void) seq_trigger();
+            }
+        }
+    } else {
+        hw_alarm_stop();
+        running = false;
+        waiting = false;
+        pwrctl_enable_vout(false);
+        show_program();
+        seq_voltage.ui.draw(&seq_voltage.ui);
+        seq_current.ui.draw(&seq_current.ui);
+        seq_step.ui.draw(&seq_step.ui);
+    }
+}
+
+/**
+ * @brief      Callback for when value of the loops item is changed
+ *
+ * @param      item  The loops item
+ */
+static void loops_changed(ui_number_t *item)
+{
+    (void) item;
+    /** Read by the ISR at the end of each loop */
+}
+
+/**
+ * @brief      Save persistent parameters
+ *
+ * @param      past  The past
+ */
+static void past_save(past_t *past)
+{
+    int32_t t = seq_loops.value;
+    /** @todo: past bug causes corruption for units smaller than 4 bytes (#27) */
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_L, (void*) &t, 4 /* sizeof(seq_loops.value) */ )) {
+        /** @todo: handle past write failures */
+    }
+    t = trigger_mode;
+    if (!past_queue_unit(past, (SCREEN_ID << 24) | PAST_T, (void*) &t, 4 /* sizeof(trigger_mode) */ )) {
+        /** @todo: handle past write failures */
+    }
+}
+
+/**
+ * @brief      Restore persistent parameters
+ *
+ * @param      past  The past
+ */
+static void past_restore(past_t *past)
+{
+    uint32_t length;
+    uint32_t *p = 0;
+    seq_past = past;
+    if (past_read_unit(past, (SCREEN_ID << 24) | PAST_L, (const void**) &p, &length)) {
+        seq_loops.value = *p;
+        (void) length;
+    }
+    if (past_read_unit(past, (SCREEN_ID << 24) | PAST_T, (const void**) &p, &length) && *p < seq_trigger_last) {
+        trigger_mode = *p;
+    }
+    if (past_read_unit(past, (SCREEN_ID << 24) | PAST_N, (const void**) &p, &length) && *p <= SEQ_MAX_STEPS) {
+        uint32_t count = *p;
+        if (past_read_unit(past, (SCREEN_ID << 24) | PAST_S, (const void**) &p, &length) && length >= count * sizeof(seq_step_t)) {
+            memcpy(steps, p, count * sizeof(seq_step_t));
+            num_steps = count;
+        }
+    }
+}
+
+/**
+ * @brief      Update the UI from the run state. While running the voltage
+ *             and current items show the setpoints of the current step.
+ */
+static void seq_tick(void)
+{
+    if (finished) {
+        finished = false;
+        (void) opendps_enable_output(false);
+    }
+    if (!running) {
+        return;
+    }
+    uint32_t i = cur_step;
+    if (i < num_steps) {
+        if (seq_step.value != (int32_t) i + 1) {
+            seq_step.value = i + 1;
+            seq_step.ui.draw(&seq_step.ui);
+        }
+        if (seq_voltage.value != steps[i].mv) {
+            seq_voltage.value = steps[i].mv;
+            seq_voltage.ui.draw(&seq_voltage.ui);
+        }
+        if (seq_current.value != steps[i].ma) {
+            seq_current.value = steps[i].ma;
+            seq_current.ui.draw(&seq_current.ui);
+        }
+    }
+}
+
+#ifdef CONFIG_SERIAL_PROTOCOL
+/**
+  * @brief Handle a sequencer upload command, storing one chunk of the program
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_seq_upload(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, flags, index, count;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &flags);
+    unpack8(frame, &index);
+    unpack8(frame, &count);
+    /** The ISR reads the program while running. Unpacking consumes the
+        length, what is left are the steps */
+    if (running || count > SEQ_UPLOAD_CHUNK || frame->length != sizeof(seq_step_t) * (uint32_t) count ||
+        index + count > SEQ_MAX_STEPS || ((flags & SEQ_UPLOAD_COMMIT) && index + count == 0)) {
+        return cmd_failed;
+    }
+    /** Check the whole chunk before touching the program */
+    seq_step_t chunk[SEQ_UPLOAD_CHUNK];
+    for (uint32_t i = 0; i < count; i++) {
+        unpack16(frame, &chunk[i].mv);
+        unpack16(frame, &chunk[i].ma);
+        unpack32(frame, &chunk[i].duration_us);
+        if (chunk[i].ma > CONFIG_DPS_MAX_CURRENT) {
+            return cmd_failed;
+        }
+    }
+    memcpy(&steps[index], chunk, count * sizeof(seq_step_t));
+    if (flags & SEQ_UPLOAD_COMMIT) {
+        num_steps = index + count;
+        if (seq_past) {
+            if (!past_write_unit(seq_past, (SCREEN_ID << 24) | PAST_S, (void*) steps, num_steps * sizeof(seq_step_t)) ||
+                !past_write_unit(seq_past, (SCREEN_ID << 24) | PAST_N, (void*) &num_steps, 4)) {
+                return cmd_failed;
+            }
+        }
+        show_program();
+    }
+    return cmd_success;
+}
+
+static const command_entry_t seq_upload_command = {
+    .cmd = cmd_seq_upload, .min_length = 4, .handler = &handle_seq_upload
+};
+#endif // CONFIG_SERIAL_PROTOCOL
+
+/**
+ * @brief      Initialise the sequencer module and add its screen to the UI
+ *
+ * @param      ui    The user interface
+ */
+void func_seq_init(uui_t *ui)
+{
+    uint16_t i_out_raw, v_in_raw, v_out_raw;
+    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
+    (void) i_out_raw;
+    (void) v_out_raw;
+    seq_voltage.max = pwrctl_calc_vin(v_in_raw);
+    number_init(&seq_voltage);
+    number_init(&seq_current);
+    number_init(&seq_step);
+    number_init(&seq_loops);
+    uui_add_screen(ui, &seq_screen);
+    show_program();
+#ifdef CONFIG_SERIAL_PROTOCOL
+    if (!serial_register_command(&seq_upload_command)) {
+        emu_printf("[SEQ] Failed to register the upload command\n");
+    }
+#endif // CONFIG_SERIAL_PROTOCOL
+}
+
+UUI_REGISTER_FUNCTION(70, func_seq_init);
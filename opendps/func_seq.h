@@ -0,0 +1,79 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file func_seq.h
+ * @brief Sequencer (List) Function Mode
+ *
+ * This module implements a sequencer operating mode for OpenDPS. It runs a
+ * stored program of (voltage, current limit, duration) steps on its own, so
+ * the host is not involved while a program runs and step timing does not
+ * depend on the serial link.
+ *
+ * ## Parameters
+ *
+ * | Name    | Unit | Description |
+ * |---------|------|-------------|
+ * | loops   | -    | Number of times the program runs, 0 repeats until stopped |
+ * | trigger | -    | 0 starts when the output is enabled, 1 waits for a trigger |
+ * | run     | -    | Write 1 to trigger, reads 1 while a program is running |
+ *
+ * ## Programs
+ *
+ * The steps are uploaded with cmd_seq_upload and kept in flash, see
+ * protocol.h. A step with a duration of 0 holds its setpoints until the
+ * next trigger. When the last loop has completed the output is turned off.
+ *
+ * ## Implementation
+ *
+ * Step changes are made from the TIM3 compare interrupt, see
+ * hw_alarm_start(). Step deadlines are computed from the start of the
+ * program so interrupt latency does not add up over a run.
+ *
+ * @note This function is only available when CONFIG_SEQUENCER_ENABLE is defined
+ * @see uui.h for the UI framework
+ */
+
+#ifndef __FUNC_SEQ_H__
+#define __FUNC_SEQ_H__
+
+#include "uui.h"
+
+/**
+ * @brief Initialize and register the sequencer function
+ *
+ * Creates the sequencer screen and registers it with the UI framework.
+ * This includes:
+ * - Creating the setpoint display and loop count input items
+ * - Setting up parameter handlers and the cmd_seq_upload command
+ * - Restoring the saved program from PAST
+ *
+ * @param[in,out] ui The user interface to add the sequencer function to
+ *
+ * @note Called once during system initialization
+ * @note Must be called after uui_init() and past_init()
+ */
+void func_seq_init(uui_t *ui);
+
+#endif // __FUNC_SEQ_H__
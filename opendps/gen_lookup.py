@@ -45,13 +45,51 @@ def image_to_bgr565(im):
 
     # Convert 24-bit RGB to 16-bit BGR
     bgr565array = []
-    for x in range(len(image_bytes) / 3):
-        bgr565 = rgb888_to_bgr565(ord(image_bytes[x*3]), ord(image_bytes[x*3+1]), ord(image_bytes[x*3+2]))
+    for x in range(len(image_bytes) // 3):
+        bgr565 = rgb888_to_bgr565(image_bytes[x*3], image_bytes[x*3+1], image_bytes[x*3+2])
         bgr565array.append((bgr565 >> 8) & 0xFF)
         bgr565array.append(bgr565 & 0xFF)
 
     return bgr565array
 
+"""
+Run length encode a bgr565 byte array for tft_blit_compressed()
+
+The output is a sequence of packets, each starting with a control byte:
+  0x80 | (n-1) : the following pixel (2 bytes) is repeated n times
+  0x00 | (n-1) : n literal pixels (2*n bytes) follow
+where n is 1..128. Runs shorter than 3 pixels are stored as literals.
+"""
+def rle_compress_bgr565(bgr565array):
+    pixels = [(bgr565array[i], bgr565array[i+1]) for i in range(0, len(bgr565array), 2)]
+    rle_array = []
+    literal = []
+
+    def flush_literal():
+        while literal:
+            chunk = literal[:128]
+            del literal[:128]
+            rle_array.append(len(chunk) - 1)
+            for p in chunk:
+                rle_array.extend(p)
+
+    i = 0
+    while i < len(pixels):
+        run = 1
+        while i + run < len(pixels) and run < 128 and pixels[i + run] == pixels[i]:
+            run += 1
+        if run >= 3:
+            flush_literal()
+            rle_array.append(0x80 | (run - 1))
+            rle_array.extend(pixels[i])
+            i += run
+        else:
+            literal.append(pixels[i])
+            i += 1
+    flush_literal()
+
+    return rle_array
+
 """
 Generate the lookup table for bytes consisting of packed 2bpp pixels
 """
@@ -75,6 +113,9 @@ def generate_pixel_lookup_table(output_filename):
   *   - Two 2-bit pixels at a time means the result is a pair of two 16-bit bgr565 pixels -- a single uint32_t is used to describe both in one value
   *   - Originally, this was a 256-entry uint64_t array, and allowed expanding all 4 pixels for an input byte in a single operation
   *   - The 64-bit table used a lot more flash space.
+  * With CONFIG_TFT_WIDE_GLYPH the 256-entry mono2bpp_lookup4 table expands all 4 pixels of a byte again:
+  *   - 2KB of flash for the white table, MONO2BPP_LOOKUP4() initializes tables with a color mask already applied, 2KB each
+  *   - The first pixel of a byte is in the low bits of the byte and in the low 16 bits of the entry
 """
 
     # Generate the C source file
@@ -82,6 +123,7 @@ def generate_pixel_lookup_table(output_filename):
     source_file.write("#include \"%s\"\n\n" % (header_filename))
     source_file.write("/**%s  */\n\n" % (description))
     source_file.write("const uint32_t mono2bpp_lookup[16] = {")
+    pairs = []
     for n in range(0,16):
         if not(n % 4):
             source_file.write("\n   ")
@@ -90,7 +132,11 @@ def generate_pixel_lookup_table(output_filename):
         a565 = socket.htons(rgb888_to_bgr565(a, a, a))
         b565 = socket.htons(rgb888_to_bgr565(b, b, b))
         source_file.write(" 0x%04X%04X," % (a565,b565))
+        pairs.append((a565 << 16) | b565)
     source_file.write("\n};\n")
+    source_file.write("\n#ifdef CONFIG_TFT_WIDE_GLYPH\n")
+    source_file.write("const uint64_t mono2bpp_lookup4[256] = MONO2BPP_LOOKUP4(0xFFFFFFFFFFFFFFFFULL);\n")
+    source_file.write("#endif // CONFIG_TFT_WIDE_GLYPH\n")
 
     # Generate the C header file
     header_file = open(header_filename, "w")
@@ -98,6 +144,18 @@ def generate_pixel_lookup_table(output_filename):
     header_file.write("#define __LOOKUP_%s_H__\n\n" % (output_filename.upper()))
     header_file.write("#include <stdint.h>\n\n")
     header_file.write("extern const uint32_t mono2bpp_lookup[16];\n\n")
+    header_file.write("#ifdef CONFIG_TFT_WIDE_GLYPH\n")
+    header_file.write("/** Initializer of a 256-entry table expanding a byte, four pixels, masked with a color repeated four times */\n")
+    header_file.write("#define MONO2BPP_LOOKUP4(mask) { \\")
+    for n in range(0,256):
+        if not(n % 4):
+            header_file.write("\n   ")
+        header_file.write(" 0x%08X%08XULL & (mask)," % (pairs[n >> 4], pairs[n & 0xF]))
+        if n % 4 == 3:
+            header_file.write(" \\")
+    header_file.write("\n}\n\n")
+    header_file.write("extern const uint64_t mono2bpp_lookup4[256];\n")
+    header_file.write("#endif // CONFIG_TFT_WIDE_GLYPH\n\n")
     header_file.write("#endif // __LOOKUP_%s_H__\n" % (output_filename.upper()))
 
 """
@@ -293,7 +351,7 @@ def convert_font_to_c(font_fname, characters, font_size, font_spacing, output_fi
 """
 Convert the specified font to a pair of .c/.h C language lookup tables in BGR565 format
 """
-def convert_graphic_to_c(graphic_fname, output_filename):
+def convert_graphic_to_c(graphic_fname, output_filename, rle):
     print(f"Converting {graphic_fname} to gfx-{output_filename}.c/h")
 
     graphic_image = Image.open(graphic_fname)
@@ -303,6 +361,8 @@ def convert_graphic_to_c(graphic_fname, output_filename):
 
     # Convert image to bgr565 byte list
     graphic_data = image_to_bgr565(graphic_image)
+    if rle:
+        graphic_data = rle_compress_bgr565(graphic_data)
 
     # Generate the output filenames
     gfx_source_filename = "gfx-%s.c" % (output_filename)
@@ -342,6 +402,9 @@ def convert_graphic_to_c(graphic_fname, output_filename):
     gfx_header_file.write("#define GFX_%s_HEIGHT (%d)\n" % (output_filename.upper(), height))
     gfx_header_file.write("#define GFX_%s_WIDTH  (%d)\n\n" % (output_filename.upper(), width))
 
+    if rle:
+        gfx_header_file.write("/** RLE compressed, draw using tft_blit_compressed() */\n")
+
     gfx_header_file.write("extern const uint8_t gfx_%s[%d];\n\n" % (output_filename, len(graphic_data)))
 
     gfx_header_file.write("#endif // __GFX_%s_H__" % (output_filename.upper()))
@@ -356,6 +419,7 @@ def main():
     parser.add_argument('-sp', '--font_spacing', type=int, help="The number of pixels to space characters by")
     parser.add_argument('-o',  '--output',       type=str, required=True, help="The output file name")
     parser.add_argument('-a',  '--ascii',                  help="Whether to generate the entire ascii character set", dest="ascii", action="store_true")
+    parser.add_argument('-r',  '--rle',                    help="Run length encode the image data", dest="rle", action="store_true")
 
     group = parser.add_mutually_exclusive_group(required=True)
     group.add_argument('-f',  '--font_file',    type=str, help="The font to use")
@@ -391,7 +455,7 @@ def main():
             print("Can't find file {args.image_file}")
             sys.exit(1)
 
-        convert_graphic_to_c(args.image_file, args.output)
+        convert_graphic_to_c(args.image_file, args.output, args.rle)
 
     elif args.lookup_table:
 
@@ -0,0 +1,109 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+Generate dps-model-fix.h, the default calibration coefficients of each model
+in dps-model.h converted to the Q16.16 fixed point format used by pwrctl.c
+
+The conversion mimics coef_to_fix() in pwrctl.c, single precision floats
+included, so a build using the generated constants converts exactly like one
+using the coefficients from dps-model.h.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+CAL_FRAC_BITS = 16
+
+# Coefficients converted for every model, in dps-model.h naming
+COEFS = ["A_ADC_K", "A_ADC_C", "A_DAC_K", "A_DAC_C", "V_ADC_K", "V_ADC_C", "V_DAC_K", "V_DAC_C", "VIN_ADC_K", "VIN_ADC_C"]
+
+def f32(value):
+    """
+    Round a Python float to single precision
+    """
+    return struct.unpack("f", struct.pack("f", value))[0]
+
+def coef_to_fix(coef):
+    """
+    Convert a coefficient to Q16.16 the way coef_to_fix() in pwrctl.c does
+    """
+    coef = f32(coef)
+    return int(f32(f32(coef * (1 << CAL_FRAC_BITS)) + (-0.5 if coef < 0 else 0.5)))
+
+def parse_models(file_name):
+    """
+    Return the model names in dps-model.h in order and a dictionary of model
+    name to a dictionary of its float coefficients. The default coefficients
+    used by models not defining their own are found under the name None.
+    """
+    models = []
+    coefs = {None: {}}
+    model = None
+    depth = 0
+    model_depth = None # Nesting of the #if defined(MODEL) chain
+    for line in open(file_name):
+        m = re.match(r"\s*#\s*(if|ifdef|ifndef|elif|else|endif)\b\s*(?:defined\((\w+)\))?", line)
+        if m:
+            directive, name = m.groups()
+            if directive.startswith("if"):
+                depth += 1
+                if directive == "if" and name and model_depth is None:
+                    model_depth = depth
+            if depth == model_depth:
+                model = name if directive in ("if", "elif") else None
+                if model:
+                    models.append(model)
+                    coefs[model] = {}
+            if directive == "endif":
+                if depth == model_depth:
+                    model_depth = None
+                depth -= 1
+            continue
+        m = re.match(r"\s*#\s*define\s+(\w+)\s+\(float\)\s*([-+0-9.eE]+)f", line)
+        if m and m.group(1) in COEFS:
+            coefs[model][m.group(1)] = float(m.group(2))
+    return models, coefs
+
+def generate(models, coefs, output_filename):
+    out = open(output_filename, "w")
+    out.write("/**\n")
+    out.write("  * This file was auto-generated by gen_model.py from dps-model.h!\n")
+    out.write("  *\n")
+    out.write("  * Default calibration coefficients of each model in Q16.16 fixed point,\n")
+    out.write("  * letting pwrctl.c fold the conversions of uncalibrated channels at\n")
+    out.write("  * compile time. Run make model after changing dps-model.h.\n")
+    out.write("  */\n\n")
+    out.write("#ifndef __DPS_MODEL_FIX_H__\n")
+    out.write("#define __DPS_MODEL_FIX_H__\n\n")
+    for i, model in enumerate(models):
+        out.write("#%s defined(%s)\n" % ("if" if i == 0 else "elif", model))
+        values = dict(coefs[None])
+        values.update(coefs[model])
+        missing = [c for c in COEFS if c not in values]
+        if missing:
+            print("Error: %s lacks %s" % (model, ", ".join(missing)))
+            sys.exit(1)
+        for coef in COEFS:
+            out.write(" #define %s_FIX (%d)\n" % (coef, coef_to_fix(values[coef])))
+        for coef in ["A_ADC_K", "V_ADC_K"]:
+            inv = coef_to_fix(f32(1.0 / f32(values[coef]))) if values[coef] else 0
+            out.write(" #define %s_INV_FIX (%d)\n" % (coef, inv))
+    out.write("#else\n")
+    out.write(" #error \"Please set MODEL to the device you want to build for\"\n")
+    out.write("#endif // MODEL\n\n")
+    out.write("#endif // __DPS_MODEL_FIX_H__\n")
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate fixed point default calibration coefficients")
+    parser.add_argument("-i", "--input", default="dps-model.h", help="Model header")
+    parser.add_argument("-o", "--output", default="dps-model-fix.h", help="Generated header")
+    args = parser.parse_args()
+    models, coefs = parse_models(args.input)
+    generate(models, coefs, args.output)
+    print("Generated %s for %s" % (args.output, ", ".join(models)))
+
+if __name__ == "__main__":
+    main()
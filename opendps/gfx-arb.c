@@ -0,0 +1,24 @@
+/** Gfx generated from `./gen_lookup.py -i gfx/png/arb.png -o arb -r` */
+
+#include "gfx-arb.h"
+
+const uint8_t gfx_arb[284] = {
+  0xae, 0x00, 0x00, 0x84, 0x39, 0xc7, 0x99, 0x00, 0x00, 0x00, 0x39, 0xc7, 0x85, 0xff, 0xff, 0x00, 
+  0xbd, 0xd7, 0x97, 0x00, 0x00, 0x01, 0x39, 0xc7, 0xff, 0xff, 0x83, 0xbd, 0xd7, 0x01, 0xff, 0xff, 
+  0xbd, 0xd7, 0x97, 0x00, 0x00, 0x07, 0x39, 0xc7, 0xff, 0xff, 0xbd, 0xd7, 0x00, 0x00, 0x00, 0x00, 
+  0x39, 0xc7, 0xff, 0xff, 0xbd, 0xd7, 0x82, 0x39, 0xc7, 0x94, 0x00, 0x00, 0x05, 0x39, 0xc7, 0xff, 
+  0xff, 0xbd, 0xd7, 0x00, 0x00, 0x00, 0x00, 0x39, 0xc7, 0x85, 0xff, 0xff, 0x00, 0xbd, 0xd7, 0x89, 
+  0x00, 0x00, 0x84, 0x39, 0xc7, 0x83, 0x00, 0x00, 0x06, 0x39, 0xc7, 0xff, 0xff, 0xbd, 0xd7, 0x00, 
+  0x00, 0x00, 0x00, 0x39, 0xc7, 0xff, 0xff, 0x83, 0xbd, 0xd7, 0x01, 0xff, 0xff, 0xbd, 0xd7, 0x88, 
+  0x00, 0x00, 0x00, 0x39, 0xc7, 0x85, 0xff, 0xff, 0x05, 0xbd, 0xd7, 0x00, 0x00, 0x00, 0x00, 0x39, 
+  0xc7, 0xff, 0xff, 0xbd, 0xd7, 0x86, 0x00, 0x00, 0x02, 0x39, 0xc7, 0xff, 0xff, 0xbd, 0xd7, 0x88, 
+  0x00, 0x00, 0x01, 0x39, 0xc7, 0xff, 0xff, 0x83, 0xbd, 0xd7, 0x01, 0xff, 0xff, 0xbd, 0xd7, 0x82, 
+  0x39, 0xc7, 0x01, 0xff, 0xff, 0xbd, 0xd7, 0x86, 0x00, 0x00, 0x02, 0x39, 0xc7, 0xff, 0xff, 0xbd, 
+  0xd7, 0x88, 0x00, 0x00, 0x05, 0x39, 0xc7, 0xff, 0xff, 0xbd, 0xd7, 0x00, 0x00, 0x00, 0x00, 0x39, 
+  0xc7, 0x85, 0xff, 0xff, 0x00, 0xbd, 0xd7, 0x86, 0x00, 0x00, 0x02, 0x39, 0xc7, 0xff, 0xff, 0xbd, 
+  0xd7, 0x88, 0x00, 0x00, 0x06, 0x39, 0xc7, 0xff, 0xff, 0xbd, 0xd7, 0x00, 0x00, 0x00, 0x00, 0x39, 
+  0xc7, 0xff, 0xff, 0x83, 0xbd, 0xd7, 0x01, 0xff, 0xff, 0xbd, 0xd7, 0x86, 0x00, 0x00, 0x02, 0x39, 
+  0xc7, 0xff, 0xff, 0xbd, 0xd7, 0x89, 0x39, 0xc7, 0x01, 0xff, 0xff, 0xbd, 0xd7, 0x90, 0x00, 0x00, 
+  0x00, 0x39, 0xc7, 0x8c, 0xff, 0xff, 0x00, 0xbd, 0xd7, 0x90, 0x00, 0x00, 0x01, 0x39, 0xc7, 0xff, 
+  0xff, 0x8a, 0xbd, 0xd7, 0x01, 0xff, 0xff, 0xbd, 0xd7, 0xb8, 0x00, 0x00
+};
\ No newline at end of file
@@ -0,0 +1,14 @@
+/** Gfx generated from `./gen_lookup.py -i gfx/png/arb.png -o arb -r` */
+
+#ifndef __GFX_ARB_H__
+#define __GFX_ARB_H__
+
+#include <stdint.h>
+
+#define GFX_ARB_HEIGHT (15)
+#define GFX_ARB_WIDTH  (32)
+
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_arb[284];
+
+#endif // __GFX_ARB_H__
\ No newline at end of file
@@ -1,4 +1,4 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/cc.png -o cc` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/cc.png -o cc -r` */
 
 #ifndef __GFX_CC_H__
 #define __GFX_CC_H__
@@ -8,6 +8,7 @@
 #define GFX_CC_HEIGHT (15)
 #define GFX_CC_WIDTH  (16)
 
-extern const uint8_t gfx_cc[480];
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_cc[326];
 
 #endif // __GFX_CC_H__
\ No newline at end of file
@@ -0,0 +1,19 @@
+/** Gfx generated from `./gen_lookup.py -i gfx/png/chg.png -o chg -r` */
+
+#include "gfx-chg.h"
+
+const uint8_t gfx_chg[193] = {
+  0x94, 0x00, 0x00, 0x85, 0xff, 0xff, 0x89, 0x00, 0x00, 0x00, 0xff, 0xff, 0x83, 0x00, 0x00, 0x00, 
+  0xff, 0xff, 0x87, 0x00, 0x00, 0x89, 0xff, 0xff, 0x85, 0x00, 0x00, 0x00, 0xff, 0xff, 0x87, 0x00, 
+  0x00, 0x00, 0xff, 0xff, 0x85, 0x00, 0x00, 0x00, 0xff, 0xff, 0x83, 0x00, 0x00, 0x04, 0xff, 0xff, 
+  0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0x85, 0x00, 0x00, 0x00, 0xff, 0xff, 0x82, 0x00, 
+  0x00, 0x01, 0xff, 0xff, 0xff, 0xff, 0x82, 0x00, 0x00, 0x00, 0xff, 0xff, 0x85, 0x00, 0x00, 0x04, 
+  0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x83, 0x00, 0x00, 0x00, 0xff, 0xff, 
+  0x85, 0x00, 0x00, 0x01, 0xff, 0xff, 0x00, 0x00, 0x85, 0xff, 0xff, 0x01, 0x00, 0x00, 0xff, 0xff, 
+  0x85, 0x00, 0x00, 0x00, 0xff, 0xff, 0x83, 0x00, 0x00, 0x04, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 
+  0x00, 0x00, 0xff, 0xff, 0x85, 0x00, 0x00, 0x00, 0xff, 0xff, 0x82, 0x00, 0x00, 0x01, 0xff, 0xff, 
+  0xff, 0xff, 0x82, 0x00, 0x00, 0x00, 0xff, 0xff, 0x85, 0x00, 0x00, 0x04, 0xff, 0xff, 0x00, 0x00, 
+  0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x83, 0x00, 0x00, 0x00, 0xff, 0xff, 0x85, 0x00, 0x00, 0x00, 
+  0xff, 0xff, 0x87, 0x00, 0x00, 0x00, 0xff, 0xff, 0x85, 0x00, 0x00, 0x89, 0xff, 0xff, 0x92, 0x00, 
+  0x00
+};
\ No newline at end of file
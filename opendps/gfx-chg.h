@@ -0,0 +1,14 @@
+/** Gfx generated from `./gen_lookup.py -i gfx/png/chg.png -o chg -r` */
+
+#ifndef __GFX_CHG_H__
+#define __GFX_CHG_H__
+
+#include <stdint.h>
+
+#define GFX_CHG_HEIGHT (15)
+#define GFX_CHG_WIDTH  (16)
+
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_chg[193];
+
+#endif // __GFX_CHG_H__
\ No newline at end of file
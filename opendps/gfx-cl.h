@@ -1,4 +1,4 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/cl.png -o cl` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/cl.png -o cl -r` */
 
 #ifndef __GFX_CL_H__
 #define __GFX_CL_H__
@@ -8,6 +8,7 @@
 #define GFX_CL_HEIGHT (15)
 #define GFX_CL_WIDTH  (16)
 
-extern const uint8_t gfx_cl[480];
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_cl[283];
 
 #endif // __GFX_CL_H__
\ No newline at end of file
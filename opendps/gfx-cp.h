@@ -0,0 +1,14 @@
+/** Gfx generated from `./gen_lookup.py -i gfx/png/cp.png -o cp -r` */
+
+#ifndef __GFX_CP_H__
+#define __GFX_CP_H__
+
+#include <stdint.h>
+
+#define GFX_CP_HEIGHT (15)
+#define GFX_CP_WIDTH  (16)
+
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_cp[298];
+
+#endif // __GFX_CP_H__
\ No newline at end of file
@@ -1,4 +1,4 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/crosshair.png -o crosshair` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/crosshair.png -o crosshair -r` */
 
 #ifndef __GFX_CROSSHAIR_H__
 #define __GFX_CROSSHAIR_H__
@@ -8,6 +8,7 @@
 #define GFX_CROSSHAIR_HEIGHT (15)
 #define GFX_CROSSHAIR_WIDTH  (16)
 
-extern const uint8_t gfx_crosshair[480];
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_crosshair[226];
 
 #endif // __GFX_CROSSHAIR_H__
\ No newline at end of file
@@ -1,4 +1,4 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/cv.png -o cv` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/cv.png -o cv -r` */
 
 #ifndef __GFX_CV_H__
 #define __GFX_CV_H__
@@ -8,6 +8,7 @@
 #define GFX_CV_HEIGHT (15)
 #define GFX_CV_WIDTH  (16)
 
-extern const uint8_t gfx_cv[480];
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_cv[347];
 
 #endif // __GFX_CV_H__
\ No newline at end of file
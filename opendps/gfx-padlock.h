@@ -1,4 +1,4 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/padlock.png -o padlock` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/padlock.png -o padlock -r` */
 
 #ifndef __GFX_PADLOCK_H__
 #define __GFX_PADLOCK_H__
@@ -8,6 +8,7 @@
 #define GFX_PADLOCK_HEIGHT (16)
 #define GFX_PADLOCK_WIDTH  (12)
 
-extern const uint8_t gfx_padlock[384];
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_padlock[153];
 
 #endif // __GFX_PADLOCK_H__
\ No newline at end of file
@@ -1,4 +1,4 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/power.png -o power` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/power.png -o power -r` */
 
 #ifndef __GFX_POWER_H__
 #define __GFX_POWER_H__
@@ -8,6 +8,7 @@
 #define GFX_POWER_HEIGHT (16)
 #define GFX_POWER_WIDTH  (16)
 
-extern const uint8_t gfx_power[512];
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_power[363];
 
 #endif // __GFX_POWER_H__
\ No newline at end of file
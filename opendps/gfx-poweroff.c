@@ -1,38 +1,32 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/poweroff.png -o poweroff` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/poweroff.png -o poweroff -r` */
 
 #include "gfx-poweroff.h"
 
-const uint8_t gfx_poweroff[512] = {
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 
-  0x00, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x1d, 
-  0x00, 0x1d, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x1d, 
-  0x00, 0x1d, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x1a, 0x00, 0x11, 0x00, 0x00, 0x00, 0x03, 0x00, 0x1d, 
-  0x00, 0x1d, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x06, 0x00, 0x1d, 0x00, 0x1f, 0x00, 0x13, 0x00, 0x00, 0x00, 0x03, 0x00, 0x1d, 
-  0x00, 0x1d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x1d, 0x00, 0x06, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x16, 0x00, 0x1f, 0x00, 0x16, 0x00, 0x01, 0x00, 0x00, 0x00, 0x03, 0x00, 0x1d, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x16, 0x00, 0x1f, 0x00, 0x16, 0x00, 0x00, 
-  0x00, 0x06, 0x00, 0x1e, 0x00, 0x1d, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00, 0x00, 0x05, 0x00, 0x1d, 0x00, 0x1e, 0x00, 0x06, 
-  0x00, 0x0c, 0x00, 0x1f, 0x00, 0x17, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x17, 0x00, 0x1f, 0x00, 0x0c, 
-  0x00, 0x10, 0x00, 0x1f, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 
-  0x00, 0x1f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x00, 0x1f, 0x00, 0x10, 
-  0x00, 0x0c, 0x00, 0x1f, 0x00, 0x17, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x17, 0x00, 0x1f, 0x00, 0x0c, 
-  0x00, 0x06, 0x00, 0x1e, 0x00, 0x1d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x1d, 0x00, 0x1e, 0x00, 0x06, 
-  0x00, 0x00, 0x00, 0x16, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x16, 0x00, 0x1f, 0x00, 0x16, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x16, 0x00, 0x1f, 0x00, 0x1d, 0x00, 0x06, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x1d, 0x00, 0x15, 0x00, 0x10, 
-  0x00, 0x10, 0x00, 0x15, 0x00, 0x1d, 0x00, 0x1f, 0x00, 0x1c, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x05, 0x00, 0x14, 0x00, 0x1d, 0x00, 0x1f, 0x00, 0x1f, 
-  0x00, 0x1f, 0x00, 0x1f, 0x00, 0x1d, 0x00, 0x14, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x0b, 0x00, 0x12, 
-  0x00, 0x12, 0x00, 0x0b, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+const uint8_t gfx_poweroff[406] = {
+  0x86, 0x00, 0x00, 0x01, 0x00, 0x0c, 0x00, 0x0c, 0x85, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x85, 0x00, 
+  0x00, 0x03, 0x00, 0x03, 0x00, 0x1d, 0x00, 0x1d, 0x00, 0x03, 0x83, 0x00, 0x00, 0x01, 0x00, 0x1f, 
+  0x00, 0x1f, 0x82, 0x00, 0x00, 0x06, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x1d, 
+  0x00, 0x1d, 0x00, 0x03, 0x82, 0x00, 0x00, 0x01, 0x00, 0x1f, 0x00, 0x1f, 0x82, 0x00, 0x00, 0x0b, 
+  0x00, 0x09, 0x00, 0x1a, 0x00, 0x11, 0x00, 0x00, 0x00, 0x03, 0x00, 0x1d, 0x00, 0x1d, 0x00, 0x03, 
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x82, 0x00, 0x00, 0x31, 0x00, 0x06, 0x00, 0x1d, 
+  0x00, 0x1f, 0x00, 0x13, 0x00, 0x00, 0x00, 0x03, 0x00, 0x1d, 0x00, 0x1d, 0x00, 0x00, 0x00, 0x00, 
+  0x00, 0x1f, 0x00, 0x1f, 0x00, 0x1d, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x16, 0x00, 0x1f, 
+  0x00, 0x16, 0x00, 0x01, 0x00, 0x00, 0x00, 0x03, 0x00, 0x1d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 
+  0x00, 0x1f, 0x00, 0x16, 0x00, 0x1f, 0x00, 0x16, 0x00, 0x00, 0x00, 0x06, 0x00, 0x1e, 0x00, 0x1d, 
+  0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 
+  0x00, 0x00, 0x00, 0x05, 0x00, 0x1d, 0x00, 0x1e, 0x00, 0x06, 0x00, 0x0c, 0x00, 0x1f, 0x00, 0x17, 
+  0x84, 0x00, 0x00, 0x01, 0x00, 0x1f, 0x00, 0x1f, 0x82, 0x00, 0x00, 0x05, 0x00, 0x17, 0x00, 0x1f, 
+  0x00, 0x0c, 0x00, 0x10, 0x00, 0x1f, 0x00, 0x14, 0x83, 0x00, 0x00, 0x01, 0x00, 0x1f, 0x00, 0x1f, 
+  0x83, 0x00, 0x00, 0x05, 0x00, 0x14, 0x00, 0x1f, 0x00, 0x10, 0x00, 0x0c, 0x00, 0x1f, 0x00, 0x17, 
+  0x82, 0x00, 0x00, 0x01, 0x00, 0x1f, 0x00, 0x1f, 0x84, 0x00, 0x00, 0x09, 0x00, 0x17, 0x00, 0x1f, 
+  0x00, 0x0c, 0x00, 0x06, 0x00, 0x1e, 0x00, 0x1d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 
+  0x84, 0x00, 0x00, 0x09, 0x00, 0x05, 0x00, 0x1d, 0x00, 0x1e, 0x00, 0x06, 0x00, 0x00, 0x00, 0x16, 
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x85, 0x00, 0x00, 0x02, 0x00, 0x16, 0x00, 0x1f, 
+  0x00, 0x16, 0x83, 0x00, 0x00, 0x02, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x05, 0x83, 0x00, 0x00, 0x04, 
+  0x00, 0x05, 0x00, 0x16, 0x00, 0x1f, 0x00, 0x1d, 0x00, 0x06, 0x82, 0x00, 0x00, 0x82, 0x00, 0x1f, 
+  0x08, 0x00, 0x1d, 0x00, 0x15, 0x00, 0x10, 0x00, 0x10, 0x00, 0x15, 0x00, 0x1d, 0x00, 0x1f, 0x00, 
+  0x1c, 0x00, 0x09, 0x82, 0x00, 0x00, 0x04, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x05, 0x00, 0x14, 0x00, 
+  0x1d, 0x83, 0x00, 0x1f, 0x02, 0x00, 0x1d, 0x00, 0x14, 0x00, 0x05, 0x82, 0x00, 0x00, 0x01, 0x00, 
+  0x1f, 0x00, 0x1f, 0x82, 0x00, 0x00, 0x05, 0x00, 0x04, 0x00, 0x0b, 0x00, 0x12, 0x00, 0x12, 0x00, 
+  0x0b, 0x00, 0x04, 0x84, 0x00, 0x00
 };
\ No newline at end of file
@@ -1,4 +1,4 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/poweroff.png -o poweroff` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/poweroff.png -o poweroff -r` */
 
 #ifndef __GFX_POWEROFF_H__
 #define __GFX_POWEROFF_H__
@@ -8,6 +8,7 @@
 #define GFX_POWEROFF_HEIGHT (16)
 #define GFX_POWEROFF_WIDTH  (16)
 
-extern const uint8_t gfx_poweroff[512];
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_poweroff[406];
 
 #endif // __GFX_POWEROFF_H__
\ No newline at end of file
@@ -1,38 +1,29 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/poweron.png -o poweron` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/poweron.png -o poweron -r` */
 
 #include "gfx-poweron.h"
 
-const uint8_t gfx_poweron[512] = {
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x20, 
-  0x03, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x07, 0x80, 
-  0x07, 0x80, 0x00, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe0, 0x07, 0x80, 
-  0x07, 0x80, 0x00, 0xe0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x02, 0x60, 0x06, 0xc0, 0x04, 0x80, 0x00, 0x00, 0x00, 0xe0, 0x07, 0x80, 
-  0x07, 0x80, 0x00, 0xe0, 0x00, 0x00, 0x04, 0x80, 0x06, 0xc0, 0x02, 0x60, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x01, 0x80, 0x07, 0x60, 0x07, 0xe0, 0x04, 0xc0, 0x00, 0x00, 0x00, 0xe0, 0x07, 0x80, 
-  0x07, 0x80, 0x00, 0xe0, 0x00, 0x00, 0x04, 0xc0, 0x07, 0xe0, 0x07, 0x60, 0x01, 0x80, 0x00, 0x00, 
-  0x00, 0x00, 0x05, 0xc0, 0x07, 0xe0, 0x05, 0x80, 0x00, 0x40, 0x00, 0x00, 0x00, 0xe0, 0x07, 0x80, 
-  0x07, 0x80, 0x00, 0xe0, 0x00, 0x00, 0x00, 0x40, 0x05, 0x80, 0x07, 0xe0, 0x05, 0xc0, 0x00, 0x00, 
-  0x01, 0x80, 0x07, 0xc0, 0x07, 0x80, 0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x07, 0xa0, 
-  0x07, 0xa0, 0x00, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x07, 0x80, 0x07, 0xc0, 0x01, 0x80, 
-  0x03, 0x40, 0x07, 0xe0, 0x05, 0xe0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xa0, 
-  0x02, 0xa0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0xe0, 0x07, 0xe0, 0x03, 0x40, 
-  0x04, 0x20, 0x07, 0xe0, 0x05, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x20, 0x07, 0xe0, 0x04, 0x20, 
-  0x03, 0x40, 0x07, 0xe0, 0x05, 0xe0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0xe0, 0x07, 0xe0, 0x03, 0x40, 
-  0x01, 0x80, 0x07, 0xc0, 0x07, 0x80, 0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x07, 0x80, 0x07, 0xc0, 0x01, 0x80, 
-  0x00, 0x00, 0x05, 0xc0, 0x07, 0xe0, 0x05, 0xa0, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x05, 0xa0, 0x07, 0xe0, 0x05, 0xc0, 0x00, 0x00, 
-  0x00, 0x00, 0x01, 0x80, 0x07, 0x60, 0x07, 0xe0, 0x05, 0x80, 0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x05, 0x80, 0x07, 0xe0, 0x07, 0x60, 0x01, 0x80, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x02, 0x40, 0x07, 0x40, 0x07, 0xe0, 0x07, 0x80, 0x05, 0x80, 0x04, 0x20, 
-  0x04, 0x20, 0x05, 0x80, 0x07, 0x80, 0x07, 0xe0, 0x07, 0x40, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x05, 0x20, 0x07, 0x80, 0x07, 0xe0, 0x07, 0xe0, 
-  0x07, 0xe0, 0x07, 0xe0, 0x07, 0x80, 0x05, 0x20, 0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x20, 0x02, 0xc0, 0x04, 0xa0, 
-  0x04, 0xa0, 0x02, 0xc0, 0x01, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+const uint8_t gfx_poweron[363] = {
+  0x86, 0x00, 0x00, 0x01, 0x03, 0x20, 0x03, 0x20, 0x8c, 0x00, 0x00, 0x03, 0x00, 0xc0, 0x07, 0x80, 
+  0x07, 0x80, 0x00, 0xc0, 0x88, 0x00, 0x00, 0x09, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe0, 
+  0x07, 0x80, 0x07, 0x80, 0x00, 0xe0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x84, 0x00, 0x00, 0x0b, 
+  0x02, 0x60, 0x06, 0xc0, 0x04, 0x80, 0x00, 0x00, 0x00, 0xe0, 0x07, 0x80, 0x07, 0x80, 0x00, 0xe0, 
+  0x00, 0x00, 0x04, 0x80, 0x06, 0xc0, 0x02, 0x60, 0x82, 0x00, 0x00, 0x31, 0x01, 0x80, 0x07, 0x60, 
+  0x07, 0xe0, 0x04, 0xc0, 0x00, 0x00, 0x00, 0xe0, 0x07, 0x80, 0x07, 0x80, 0x00, 0xe0, 0x00, 0x00, 
+  0x04, 0xc0, 0x07, 0xe0, 0x07, 0x60, 0x01, 0x80, 0x00, 0x00, 0x00, 0x00, 0x05, 0xc0, 0x07, 0xe0, 
+  0x05, 0x80, 0x00, 0x40, 0x00, 0x00, 0x00, 0xe0, 0x07, 0x80, 0x07, 0x80, 0x00, 0xe0, 0x00, 0x00, 
+  0x00, 0x40, 0x05, 0x80, 0x07, 0xe0, 0x05, 0xc0, 0x00, 0x00, 0x01, 0x80, 0x07, 0xc0, 0x07, 0x80, 
+  0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x07, 0xa0, 0x07, 0xa0, 0x00, 0xc0, 0x00, 0x00, 
+  0x00, 0x00, 0x01, 0x40, 0x07, 0x80, 0x07, 0xc0, 0x01, 0x80, 0x03, 0x40, 0x07, 0xe0, 0x05, 0xe0, 
+  0x83, 0x00, 0x00, 0x01, 0x02, 0xa0, 0x02, 0xa0, 0x83, 0x00, 0x00, 0x05, 0x05, 0xe0, 0x07, 0xe0, 
+  0x03, 0x40, 0x04, 0x20, 0x07, 0xe0, 0x05, 0x20, 0x89, 0x00, 0x00, 0x05, 0x05, 0x20, 0x07, 0xe0, 
+  0x04, 0x20, 0x03, 0x40, 0x07, 0xe0, 0x05, 0xe0, 0x89, 0x00, 0x00, 0x06, 0x05, 0xe0, 0x07, 0xe0, 
+  0x03, 0x40, 0x01, 0x80, 0x07, 0xc0, 0x07, 0x80, 0x01, 0x40, 0x87, 0x00, 0x00, 0x08, 0x01, 0x40, 
+  0x07, 0x80, 0x07, 0xc0, 0x01, 0x80, 0x00, 0x00, 0x05, 0xc0, 0x07, 0xe0, 0x05, 0xa0, 0x00, 0x20, 
+  0x85, 0x00, 0x00, 0x0a, 0x00, 0x20, 0x05, 0xa0, 0x07, 0xe0, 0x05, 0xc0, 0x00, 0x00, 0x00, 0x00, 
+  0x01, 0x80, 0x07, 0x60, 0x07, 0xe0, 0x05, 0x80, 0x01, 0x40, 0x83, 0x00, 0x00, 0x04, 0x01, 0x40, 
+  0x05, 0x80, 0x07, 0xe0, 0x07, 0x60, 0x01, 0x80, 0x82, 0x00, 0x00, 0x0b, 0x02, 0x40, 0x07, 0x40, 
+  0x07, 0xe0, 0x07, 0x80, 0x05, 0x80, 0x04, 0x20, 0x04, 0x20, 0x05, 0x80, 0x07, 0x80, 0x07, 0xe0, 
+  0x07, 0x40, 0x02, 0x40, 0x84, 0x00, 0x00, 0x02, 0x01, 0x40, 0x05, 0x20, 0x07, 0x80, 0x83, 0x07, 
+  0xe0, 0x02, 0x07, 0x80, 0x05, 0x20, 0x01, 0x40, 0x87, 0x00, 0x00, 0x05, 0x01, 0x20, 0x02, 0xc0, 
+  0x04, 0xa0, 0x04, 0xa0, 0x02, 0xc0, 0x01, 0x20, 0x84, 0x00, 0x00
 };
\ No newline at end of file
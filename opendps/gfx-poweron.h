@@ -1,4 +1,4 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/poweron.png -o poweron` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/poweron.png -o poweron -r` */
 
 #ifndef __GFX_POWERON_H__
 #define __GFX_POWERON_H__
@@ -8,6 +8,7 @@
 #define GFX_POWERON_HEIGHT (16)
 #define GFX_POWERON_WIDTH  (16)
 
-extern const uint8_t gfx_poweron[512];
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_poweron[363];
 
 #endif // __GFX_POWERON_H__
\ No newline at end of file
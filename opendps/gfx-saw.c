@@ -1,66 +1,27 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/saw.png -o saw` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/saw.png -o saw -r` */
 
 #include "gfx-saw.h"
 
-const uint8_t gfx_saw[960] = {
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x04, 0x5a, 0xcb, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x4a, 0x89, 0xb5, 0xb6, 0xf7, 0xde, 0xbd, 0xf7, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x18, 0xe3, 0x84, 0x10, 0xdf, 0x1b, 0xff, 0xff, 0xd6, 0xda, 0xe7, 0x3c, 0xbd, 0xf7, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x41, 0x63, 0x2c, 
+const uint8_t gfx_saw[325] = {
+  0x8d, 0x00, 0x00, 0x01, 0x21, 0x04, 0x5a, 0xcb, 0x9a, 0x00, 0x00, 0x04, 0x00, 0x20, 0x4a, 0x89, 
+  0xb5, 0xb6, 0xf7, 0xde, 0xbd, 0xf7, 0x98, 0x00, 0x00, 0x06, 0x18, 0xe3, 0x84, 0x10, 0xdf, 0x1b, 
+  0xff, 0xff, 0xd6, 0xda, 0xe7, 0x3c, 0xbd, 0xf7, 0x95, 0x00, 0x00, 0x09, 0x08, 0x41, 0x63, 0x2c, 
   0xc6, 0x58, 0xff, 0xff, 0xef, 0x9d, 0x94, 0xb2, 0x31, 0x86, 0x00, 0x00, 0xbd, 0xf7, 0xbd, 0xf7, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x04, 0x8c, 0x71, 0xe7, 0x5c, 0xff, 0xff, 
-  0xce, 0x79, 0x63, 0x2c, 0x08, 0x61, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbd, 0xf7, 0xbd, 0xf7, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x20, 0x52, 0xaa, 0xb5, 0xd6, 0xf7, 0xde, 0xef, 0x9d, 0x94, 0xb2, 0x31, 0x86, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbd, 0xf7, 0xbd, 0xf7, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x7b, 0xcf, 0xde, 0xfb, 0xff, 0xff, 0xd6, 0xda, 0x73, 0xce, 0x10, 0xa2, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbd, 0xf7, 0xbd, 0xf7, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0xa2, 
-  0xe7, 0x5c, 0xad, 0x55, 0x42, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbd, 0xf7, 0xbd, 0xf7, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0xc3, 0x6b, 0x6d, 0xc6, 0x38, 0xef, 0x9d, 
-  0x08, 0x41, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbd, 0xf7, 0xbd, 0xf7, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x08, 0x61, 0x5a, 0xeb, 0xb5, 0xd6, 0xf7, 0xde, 0xff, 0xff, 0xd6, 0xba, 0x7b, 0xef, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbd, 0xf7, 0xbd, 0xf7, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x61, 0x5a, 0xeb, 
-  0xb5, 0xd6, 0xf7, 0xde, 0xff, 0xff, 0xd6, 0xba, 0x7b, 0xef, 0x21, 0x44, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbd, 0xf7, 0xbd, 0xf7, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x52, 0xaa, 0xad, 0x95, 0xf7, 0xbe, 0xff, 0xff, 
-  0xe7, 0x3c, 0x84, 0x30, 0x29, 0x45, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbd, 0xf7, 0xbd, 0xf7, 
-  0x00, 0x00, 0x42, 0x08, 0x9d, 0x13, 0xe7, 0x5c, 0xff, 0xff, 0xef, 0x7d, 0x94, 0xb2, 0x39, 0xc7, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbd, 0xf7, 0xe7, 0x3c, 
-  0xd6, 0xba, 0xff, 0xff, 0xf7, 0xde, 0xb5, 0xb6, 0x5a, 0xeb, 0x08, 0x61, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbd, 0xf7, 0xf7, 0xde, 
-  0xbe, 0x17, 0x6b, 0x4d, 0x10, 0xa2, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x52, 0x8a, 0x21, 0x04, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+  0x93, 0x00, 0x00, 0x06, 0x21, 0x04, 0x8c, 0x71, 0xe7, 0x5c, 0xff, 0xff, 0xce, 0x79, 0x63, 0x2c, 
+  0x08, 0x61, 0x82, 0x00, 0x00, 0x01, 0xbd, 0xf7, 0xbd, 0xf7, 0x90, 0x00, 0x00, 0x06, 0x00, 0x20, 
+  0x52, 0xaa, 0xb5, 0xd6, 0xf7, 0xde, 0xef, 0x9d, 0x94, 0xb2, 0x31, 0x86, 0x85, 0x00, 0x00, 0x01, 
+  0xbd, 0xf7, 0xbd, 0xf7, 0x8f, 0x00, 0x00, 0x05, 0x7b, 0xcf, 0xde, 0xfb, 0xff, 0xff, 0xd6, 0xda, 
+  0x73, 0xce, 0x10, 0xa2, 0x87, 0x00, 0x00, 0x01, 0xbd, 0xf7, 0xbd, 0xf7, 0x8e, 0x00, 0x00, 0x03, 
+  0x10, 0xa2, 0xe7, 0x5c, 0xad, 0x55, 0x42, 0x28, 0x8a, 0x00, 0x00, 0x01, 0xbd, 0xf7, 0xbd, 0xf7, 
+  0x8b, 0x00, 0x00, 0x04, 0x18, 0xc3, 0x6b, 0x6d, 0xc6, 0x38, 0xef, 0x9d, 0x08, 0x41, 0x8c, 0x00, 
+  0x00, 0x01, 0xbd, 0xf7, 0xbd, 0xf7, 0x88, 0x00, 0x00, 0x06, 0x08, 0x61, 0x5a, 0xeb, 0xb5, 0xd6, 
+  0xf7, 0xde, 0xff, 0xff, 0xd6, 0xba, 0x7b, 0xef, 0x8d, 0x00, 0x00, 0x01, 0xbd, 0xf7, 0xbd, 0xf7, 
+  0x85, 0x00, 0x00, 0x07, 0x08, 0x61, 0x5a, 0xeb, 0xb5, 0xd6, 0xf7, 0xde, 0xff, 0xff, 0xd6, 0xba, 
+  0x7b, 0xef, 0x21, 0x44, 0x8f, 0x00, 0x00, 0x01, 0xbd, 0xf7, 0xbd, 0xf7, 0x82, 0x00, 0x00, 0x07, 
+  0x00, 0x20, 0x52, 0xaa, 0xad, 0x95, 0xf7, 0xbe, 0xff, 0xff, 0xe7, 0x3c, 0x84, 0x30, 0x29, 0x45, 
+  0x92, 0x00, 0x00, 0x09, 0xbd, 0xf7, 0xbd, 0xf7, 0x00, 0x00, 0x42, 0x08, 0x9d, 0x13, 0xe7, 0x5c, 
+  0xff, 0xff, 0xef, 0x7d, 0x94, 0xb2, 0x39, 0xc7, 0x95, 0x00, 0x00, 0x07, 0xbd, 0xf7, 0xe7, 0x3c, 
+  0xd6, 0xba, 0xff, 0xff, 0xf7, 0xde, 0xb5, 0xb6, 0x5a, 0xeb, 0x08, 0x61, 0x97, 0x00, 0x00, 0x04, 
+  0xbd, 0xf7, 0xf7, 0xde, 0xbe, 0x17, 0x6b, 0x4d, 0x10, 0xa2, 0x9a, 0x00, 0x00, 0x01, 0x52, 0x8a, 
+  0x21, 0x04, 0x8f, 0x00, 0x00
 };
\ No newline at end of file
@@ -1,4 +1,4 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/saw.png -o saw` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/saw.png -o saw -r` */
 
 #ifndef __GFX_SAW_H__
 #define __GFX_SAW_H__
@@ -8,6 +8,7 @@
 #define GFX_SAW_HEIGHT (15)
 #define GFX_SAW_WIDTH  (32)
 
-extern const uint8_t gfx_saw[960];
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_saw[325];
 
 #endif // __GFX_SAW_H__
\ No newline at end of file
@@ -0,0 +1,26 @@
+/** Gfx generated from `./gen_lookup.py -i gfx/png/seq.png -o seq -r` */
+
+#include "gfx-seq.h"
+
+const uint8_t gfx_seq[320] = {
+  0x90, 0x00, 0x00, 0x00, 0x39, 0xc7, 0x84, 0xff, 0xff, 0x03, 0x39, 0xc7, 0x00, 0x00, 0x00, 0x00, 
+  0x39, 0xc7, 0x83, 0xff, 0xff, 0x03, 0x39, 0xc7, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x82, 0x00, 
+  0x00, 0x0d, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 
+  0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x39, 0xc7, 0x85, 0x00, 
+  0x00, 0x09, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 
+  0xff, 0xff, 0xff, 0xff, 0x39, 0xc7, 0x85, 0x00, 0x00, 0x0a, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 
+  0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x39, 0xc7, 0xff, 0xff, 0xff, 0xff, 0x39, 0xc7, 
+  0x84, 0x00, 0x00, 0x08, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 
+  0x00, 0x00, 0x00, 0x00, 0x39, 0xc7, 0x82, 0xff, 0xff, 0x00, 0x39, 0xc7, 0x82, 0x00, 0x00, 0x05, 
+  0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x83, 0x00, 0x00, 0x0b, 
+  0x39, 0xc7, 0xff, 0xff, 0xff, 0xff, 0x39, 0xc7, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 
+  0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x84, 0x00, 0x00, 0x0a, 0x39, 0xc7, 0xff, 0xff, 
+  0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 
+  0xff, 0xff, 0x85, 0x00, 0x00, 0x09, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 
+  0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x85, 0x00, 0x00, 0x0c, 0xff, 0xff, 
+  0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x39, 0xc7, 0xff, 0xff, 
+  0xff, 0xff, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x82, 0x00, 0x00, 0x0b, 0xff, 0xff, 0xff, 0xff, 
+  0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 
+  0x00, 0x00, 0x39, 0xc7, 0x84, 0xff, 0xff, 0x03, 0x39, 0xc7, 0x00, 0x00, 0x00, 0x00, 0x39, 0xc7, 
+  0x84, 0xff, 0xff, 0x8c, 0x00, 0x00, 0x02, 0x39, 0xc7, 0xff, 0xff, 0xff, 0xff, 0x8f, 0x00, 0x00
+};
\ No newline at end of file
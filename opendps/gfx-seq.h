@@ -0,0 +1,14 @@
+/** Gfx generated from `./gen_lookup.py -i gfx/png/seq.png -o seq -r` */
+
+#ifndef __GFX_SEQ_H__
+#define __GFX_SEQ_H__
+
+#include <stdint.h>
+
+#define GFX_SEQ_HEIGHT (15)
+#define GFX_SEQ_WIDTH  (16)
+
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_seq[320];
+
+#endif // __GFX_SEQ_H__
\ No newline at end of file
@@ -1,66 +1,26 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/sin.png -o sin` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/sin.png -o sin -r` */
 
 #include "gfx-sin.h"
 
-const uint8_t gfx_sin[960] = {
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x20, 0x21, 0x04, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x61, 0x73, 0x8e, 0xc6, 0x58, 
-  0xf7, 0xde, 0xff, 0xff, 0xf7, 0xde, 0xad, 0x75, 0x31, 0x86, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x52, 0xaa, 0xe7, 0x5c, 0xf7, 0xde, 0xbe, 0x17, 
-  0x7b, 0xef, 0x63, 0x2c, 0x7c, 0x0f, 0xe7, 0x3c, 0xf7, 0xde, 0x6b, 0x6d, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x08, 0x41, 0x9d, 0x13, 0xff, 0xff, 0xbd, 0xf7, 0x29, 0x65, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x61, 0xa5, 0x54, 0xff, 0xff, 0x73, 0xae, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x10, 0xa2, 0xce, 0x79, 0xf7, 0xde, 0x7b, 0xcf, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9c, 0xf3, 0xf7, 0xde, 0x4a, 0x49, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x18, 0xe3, 0xd6, 0xba, 0xef, 0x9d, 0x4a, 0x69, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0xce, 0x79, 0xdf, 0x1b, 
-  0x08, 0x61, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0xde, 0xfb, 0xef, 0x7d, 0x39, 0xe7, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x31, 0x86, 0xf7, 0xde, 
-  0x94, 0xd2, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x29, 0x65, 
-  0xc6, 0x38, 0x29, 0x85, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x8c, 0x51, 
-  0xf7, 0xde, 0x39, 0xe7, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0xce, 0x59, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x41, 
-  0xd6, 0xda, 0xde, 0xfb, 0x08, 0x61, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7c, 0x0f, 0xff, 0xff, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x31, 0xa6, 0xf7, 0xbe, 0xad, 0x75, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x4a, 0x89, 0xf7, 0xde, 0x9d, 0x13, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x63, 0x2c, 0xf7, 0xde, 0x9c, 0xd3, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x48, 0xef, 0x9d, 0xc6, 0x38, 0x08, 0x41, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x73, 0x8e, 0xff, 0xff, 0xad, 0x75, 0x10, 0x82, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x6b, 0x6d, 0xf7, 0xbe, 0xc6, 0x58, 0x10, 0xa2, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5b, 0x0b, 0xf7, 0xbe, 0xde, 0xfb, 0x5b, 0x0b, 0x18, 0xc3, 
-  0x18, 0xe3, 0x5a, 0xcb, 0xce, 0x59, 0xff, 0xff, 0xa5, 0x34, 0x08, 0x61, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x31, 0x86, 0xce, 0x79, 0xff, 0xff, 0xff, 0xff, 
-  0xff, 0xff, 0xff, 0xff, 0xce, 0x59, 0x4a, 0x69, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x39, 0xc7, 0x5a, 0xeb, 
-  0x5a, 0xcb, 0x29, 0x65, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+const uint8_t gfx_sin[317] = {
+  0x87, 0x00, 0x00, 0x02, 0x00, 0x20, 0x21, 0x04, 0x00, 0x20, 0x99, 0x00, 0x00, 0x07, 0x08, 0x61, 
+  0x73, 0x8e, 0xc6, 0x58, 0xf7, 0xde, 0xff, 0xff, 0xf7, 0xde, 0xad, 0x75, 0x31, 0x86, 0x96, 0x00, 
+  0x00, 0x09, 0x52, 0xaa, 0xe7, 0x5c, 0xf7, 0xde, 0xbe, 0x17, 0x7b, 0xef, 0x63, 0x2c, 0x7c, 0x0f, 
+  0xe7, 0x3c, 0xf7, 0xde, 0x6b, 0x6d, 0x93, 0x00, 0x00, 0x04, 0x08, 0x41, 0x9d, 0x13, 0xff, 0xff, 
+  0xbd, 0xf7, 0x29, 0x65, 0x83, 0x00, 0x00, 0x03, 0x08, 0x61, 0xa5, 0x54, 0xff, 0xff, 0x73, 0xae, 
+  0x91, 0x00, 0x00, 0x03, 0x10, 0xa2, 0xce, 0x79, 0xf7, 0xde, 0x7b, 0xcf, 0x87, 0x00, 0x00, 0x02, 
+  0x9c, 0xf3, 0xf7, 0xde, 0x4a, 0x49, 0x8f, 0x00, 0x00, 0x03, 0x18, 0xe3, 0xd6, 0xba, 0xef, 0x9d, 
+  0x4a, 0x69, 0x88, 0x00, 0x00, 0x03, 0x00, 0x20, 0xce, 0x79, 0xdf, 0x1b, 0x08, 0x61, 0x8e, 0x00, 
+  0x00, 0x02, 0xde, 0xfb, 0xef, 0x7d, 0x39, 0xe7, 0x8a, 0x00, 0x00, 0x02, 0x31, 0x86, 0xf7, 0xde, 
+  0x94, 0xd2, 0x8d, 0x00, 0x00, 0x02, 0x29, 0x65, 0xc6, 0x38, 0x29, 0x85, 0x8c, 0x00, 0x00, 0x02, 
+  0x8c, 0x51, 0xf7, 0xde, 0x39, 0xe7, 0x8b, 0x00, 0x00, 0x01, 0x00, 0x20, 0xce, 0x59, 0x8e, 0x00, 
+  0x00, 0x03, 0x08, 0x41, 0xd6, 0xda, 0xde, 0xfb, 0x08, 0x61, 0x8a, 0x00, 0x00, 0x01, 0x7c, 0x0f, 
+  0xff, 0xff, 0x8f, 0x00, 0x00, 0x02, 0x31, 0xa6, 0xf7, 0xbe, 0xad, 0x75, 0x89, 0x00, 0x00, 0x02, 
+  0x4a, 0x89, 0xf7, 0xde, 0x9d, 0x13, 0x90, 0x00, 0x00, 0x02, 0x63, 0x2c, 0xf7, 0xde, 0x9c, 0xd3, 
+  0x87, 0x00, 0x00, 0x03, 0x42, 0x48, 0xef, 0x9d, 0xc6, 0x38, 0x08, 0x41, 0x91, 0x00, 0x00, 0x03, 
+  0x73, 0x8e, 0xff, 0xff, 0xad, 0x75, 0x10, 0x82, 0x84, 0x00, 0x00, 0x03, 0x6b, 0x6d, 0xf7, 0xbe, 
+  0xc6, 0x58, 0x10, 0xa2, 0x93, 0x00, 0x00, 0x0a, 0x5b, 0x0b, 0xf7, 0xbe, 0xde, 0xfb, 0x5b, 0x0b, 
+  0x18, 0xc3, 0x18, 0xe3, 0x5a, 0xcb, 0xce, 0x59, 0xff, 0xff, 0xa5, 0x34, 0x08, 0x61, 0x95, 0x00, 
+  0x00, 0x01, 0x31, 0x86, 0xce, 0x79, 0x83, 0xff, 0xff, 0x01, 0xce, 0x59, 0x4a, 0x69, 0x99, 0x00, 
+  0x00, 0x03, 0x39, 0xc7, 0x5a, 0xeb, 0x5a, 0xcb, 0x29, 0x65, 0x85, 0x00, 0x00
 };
\ No newline at end of file
@@ -1,4 +1,4 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/sin.png -o sin` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/sin.png -o sin -r` */
 
 #ifndef __GFX_SIN_H__
 #define __GFX_SIN_H__
@@ -8,6 +8,7 @@
 #define GFX_SIN_HEIGHT (15)
 #define GFX_SIN_WIDTH  (32)
 
-extern const uint8_t gfx_sin[960];
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_sin[317];
 
 #endif // __GFX_SIN_H__
\ No newline at end of file
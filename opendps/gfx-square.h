@@ -1,4 +1,4 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/square.png -o square` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/square.png -o square -r` */
 
 #ifndef __GFX_SQUARE_H__
 #define __GFX_SQUARE_H__
@@ -8,6 +8,7 @@
 #define GFX_SQUARE_HEIGHT (15)
 #define GFX_SQUARE_WIDTH  (32)
 
-extern const uint8_t gfx_square[960];
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_square[236];
 
 #endif // __GFX_SQUARE_H__
\ No newline at end of file
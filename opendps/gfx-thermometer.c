@@ -1,99 +1,71 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/thermometer.png -o thermometer` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/thermometer.png -o thermometer -r` */
 
 #include "gfx-thermometer.h"
 
-const uint8_t gfx_thermometer[1480] = {
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5a, 0xeb, 
-  0xbe, 0x17, 0xff, 0xff, 0xff, 0xff, 0xb5, 0xb6, 0x4a, 0x69, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x10, 0x82, 0xb5, 0xb6, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 
-  0xff, 0xff, 0x9c, 0xf3, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xa5, 0x34, 0xff, 0xff, 0xff, 0xff, 
-  0x94, 0xd2, 0x42, 0x28, 0x42, 0x28, 0xad, 0x75, 0xff, 0xff, 0xff, 0xff, 0x84, 0x50, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x42, 0x28, 0xff, 0xff, 0xff, 0xff, 0x6b, 0x8d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x8c, 0x71, 0xff, 0xff, 0xf7, 0xbe, 0x21, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x8c, 0x71, 0xff, 0xff, 0xbe, 0x17, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x61, 0xdf, 0x1b, 0xff, 0xff, 0x5a, 0xeb, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0xa5, 0x14, 0xff, 0xff, 0x84, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0xad, 0x95, 0xff, 0xff, 0x7b, 0xcf, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xa5, 0x14, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xad, 0x95, 0xff, 0xff, 0x7b, 0xcf, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x9d, 0x13, 0xff, 0xff, 0x84, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0xb5, 0xb6, 0xff, 0xff, 0x73, 0xce, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9d, 0x13, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 
-  0x5a, 0xeb, 0x9c, 0xd3, 0x9c, 0xf3, 0x5a, 0xcb, 0x00, 0x00, 0xad, 0x95, 0xff, 0xff, 0x73, 0xce, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+const uint8_t gfx_thermometer[1039] = {
+  0x86, 0x00, 0x00, 0x05, 0x5a, 0xeb, 0xbe, 0x17, 0xff, 0xff, 0xff, 0xff, 0xb5, 0xb6, 0x4a, 0x69, 
+  0x8b, 0x00, 0x00, 0x01, 0x10, 0x82, 0xb5, 0xb6, 0x85, 0xff, 0xff, 0x00, 0x9c, 0xf3, 0x8a, 0x00, 
+  0x00, 0x09, 0xa5, 0x34, 0xff, 0xff, 0xff, 0xff, 0x94, 0xd2, 0x42, 0x28, 0x42, 0x28, 0xad, 0x75, 
+  0xff, 0xff, 0xff, 0xff, 0x84, 0x50, 0x88, 0x00, 0x00, 0x03, 0x42, 0x28, 0xff, 0xff, 0xff, 0xff, 
+  0x6b, 0x8d, 0x83, 0x00, 0x00, 0x03, 0x8c, 0x71, 0xff, 0xff, 0xf7, 0xbe, 0x21, 0x24, 0x87, 0x00, 
+  0x00, 0x02, 0x8c, 0x71, 0xff, 0xff, 0xbe, 0x17, 0x84, 0x00, 0x00, 0x03, 0x08, 0x61, 0xdf, 0x1b, 
+  0xff, 0xff, 0x5a, 0xeb, 0x87, 0x00, 0x00, 0x02, 0xa5, 0x14, 0xff, 0xff, 0x84, 0x10, 0x85, 0x00, 
+  0x00, 0x02, 0xad, 0x95, 0xff, 0xff, 0x7b, 0xcf, 0x87, 0x00, 0x00, 0x02, 0xa5, 0x14, 0xff, 0xff, 
+  0x84, 0x30, 0x85, 0x00, 0x00, 0x02, 0xad, 0x95, 0xff, 0xff, 0x7b, 0xcf, 0x87, 0x00, 0x00, 0x02, 
+  0x9d, 0x13, 0xff, 0xff, 0x84, 0x50, 0x85, 0x00, 0x00, 0x02, 0xb5, 0xb6, 0xff, 0xff, 0x73, 0xce, 
+  0x87, 0x00, 0x00, 0x0b, 0x9d, 0x13, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 0x5a, 0xeb, 0x9c, 0xd3, 
+  0x9c, 0xf3, 0x5a, 0xcb, 0x00, 0x00, 0xad, 0x95, 0xff, 0xff, 0x73, 0xce, 0x87, 0x00, 0x00, 0x0b, 
   0x9d, 0x13, 0xff, 0xff, 0x84, 0x10, 0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0xff, 0xff, 0xad, 0x75, 
-  0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x73, 0xce, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9d, 0x13, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 
-  0xad, 0x75, 0xff, 0xff, 0xff, 0xff, 0xad, 0x75, 0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x73, 0xce, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x9d, 0x13, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 0x9c, 0xd3, 0xff, 0xff, 0xff, 0xff, 0x9c, 0xd3, 
-  0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x73, 0xce, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9d, 0x13, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 
-  0x9c, 0xd3, 0xff, 0xff, 0xff, 0xff, 0x9c, 0xd3, 0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x73, 0xce, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x9d, 0x13, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 0x9c, 0xd3, 0xff, 0xff, 0xff, 0xff, 0x9c, 0xd3, 
-  0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x73, 0xce, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9d, 0x13, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 
+  0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x73, 0xce, 0x87, 0x00, 0x00, 0x0b, 0x9d, 0x13, 0xff, 0xff, 
+  0x84, 0x30, 0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0xff, 0xff, 0xad, 0x75, 0x00, 0x00, 0xad, 0x75, 
+  0xff, 0xff, 0x73, 0xce, 0x87, 0x00, 0x00, 0x0b, 0x9d, 0x13, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 
   0x9c, 0xd3, 0xff, 0xff, 0xff, 0xff, 0x9c, 0xd3, 0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x73, 0xce, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+  0x87, 0x00, 0x00, 0x0b, 0x9d, 0x13, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 0x9c, 0xd3, 0xff, 0xff, 
+  0xff, 0xff, 0x9c, 0xd3, 0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x73, 0xce, 0x87, 0x00, 0x00, 0x0b, 
   0x9d, 0x13, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 0x9c, 0xd3, 0xff, 0xff, 0xff, 0xff, 0x9c, 0xd3, 
-  0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x73, 0xce, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9d, 0x13, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 
+  0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x73, 0xce, 0x87, 0x00, 0x00, 0x0b, 0x9d, 0x13, 0xff, 0xff, 
+  0x84, 0x30, 0x00, 0x00, 0x9c, 0xd3, 0xff, 0xff, 0xff, 0xff, 0x9c, 0xd3, 0x00, 0x00, 0xad, 0x75, 
+  0xff, 0xff, 0x73, 0xce, 0x87, 0x00, 0x00, 0x0b, 0x9d, 0x13, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 
   0x9c, 0xd3, 0xff, 0xff, 0xff, 0xff, 0x9c, 0xd3, 0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x73, 0xce, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+  0x87, 0x00, 0x00, 0x0b, 0x9d, 0x13, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 0x9c, 0xd3, 0xff, 0xff, 
+  0xff, 0xff, 0x9c, 0xd3, 0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x73, 0xce, 0x87, 0x00, 0x00, 0x0b, 
   0x9d, 0x13, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 0x9c, 0xd3, 0xff, 0xff, 0xff, 0xff, 0x9c, 0xd3, 
-  0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x73, 0xce, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x94, 0xd2, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 
-  0x9c, 0xd3, 0xff, 0xff, 0xff, 0xff, 0x9c, 0xd3, 0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x6b, 0x6d, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x04, 
-  0xd6, 0xba, 0xff, 0xff, 0x8c, 0x71, 0x00, 0x00, 0x9c, 0xd3, 0xff, 0xff, 0xff, 0xff, 0x94, 0xd2, 
-  0x00, 0x00, 0xbd, 0xf7, 0xff, 0xff, 0xb5, 0xd6, 0x08, 0x41, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x29, 0x45, 0xd6, 0xda, 0xff, 0xff, 0xff, 0xff, 0x63, 0x0c, 0x00, 0x00, 
-  0x9c, 0xf3, 0xff, 0xff, 0xff, 0xff, 0x9c, 0xf3, 0x00, 0x00, 0x84, 0x10, 0xff, 0xff, 0xff, 0xff, 
-  0xbd, 0xd7, 0x08, 0x61, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x82, 0xd6, 0xda, 0xff, 0xff, 
-  0xef, 0x7d, 0x5a, 0xcb, 0x00, 0x00, 0x00, 0x00, 0x94, 0xd2, 0xff, 0xff, 0xff, 0xff, 0x9c, 0xf3, 
-  0x00, 0x00, 0x00, 0x00, 0x6b, 0x8d, 0xff, 0xff, 0xff, 0xff, 0xbd, 0xd7, 0x08, 0x41, 0x00, 0x00, 
-  0x00, 0x00, 0x94, 0xd2, 0xff, 0xff, 0xef, 0x9d, 0x39, 0xc7, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0xad, 0x75, 0xff, 0xff, 0xff, 0xff, 0xad, 0x95, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5a, 0xeb, 
-  0xf7, 0xde, 0xff, 0xff, 0x73, 0xce, 0x00, 0x00, 0x21, 0x24, 0xf7, 0xde, 0xff, 0xff, 0x6b, 0x6d, 
-  0x00, 0x00, 0x00, 0x00, 0x18, 0xc3, 0xb5, 0xb6, 0xf7, 0xbe, 0xff, 0xff, 0xff, 0xff, 0xf7, 0xbe, 
-  0xb5, 0xb6, 0x18, 0xe3, 0x00, 0x00, 0x00, 0x00, 0x8c, 0x91, 0xff, 0xff, 0xdf, 0x1b, 0x10, 0xa2, 
-  0x7b, 0xcf, 0xff, 0xff, 0xd6, 0xba, 0x00, 0x00, 0x00, 0x00, 0x08, 0x61, 0xce, 0x79, 0xff, 0xff, 
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xce, 0x99, 0x08, 0x61, 0x00, 0x00, 
-  0x21, 0x04, 0xef, 0x7d, 0xff, 0xff, 0x5a, 0xeb, 0xb5, 0xd6, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 
-  0x00, 0x00, 0x84, 0x30, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 
-  0xff, 0xff, 0xff, 0xff, 0x8c, 0x71, 0x00, 0x00, 0x00, 0x00, 0xa5, 0x34, 0xff, 0xff, 0x94, 0xb2, 
-  0xef, 0x7d, 0xff, 0xff, 0x4a, 0x69, 0x00, 0x00, 0x00, 0x00, 0xc6, 0x18, 0xff, 0xff, 0xff, 0xff, 
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xc6, 0x38, 0x00, 0x00, 
-  0x00, 0x00, 0x73, 0xce, 0xff, 0xff, 0xbd, 0xd7, 0xf7, 0xbe, 0xff, 0xff, 0x42, 0x08, 0x00, 0x00, 
-  0x00, 0x20, 0xc6, 0x58, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 
-  0xff, 0xff, 0xff, 0xff, 0xce, 0x79, 0x00, 0x20, 0x00, 0x00, 0x6b, 0x4d, 0xff, 0xff, 0xc6, 0x58, 
-  0xde, 0xfb, 0xff, 0xff, 0x5a, 0xeb, 0x00, 0x00, 0x00, 0x00, 0xbd, 0xf7, 0xff, 0xff, 0xff, 0xff, 
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xbe, 0x17, 0x00, 0x00, 
-  0x00, 0x00, 0x84, 0x50, 0xff, 0xff, 0xad, 0x75, 0xa5, 0x34, 0xff, 0xff, 0x9d, 0x13, 0x00, 0x00, 
-  0x00, 0x00, 0x63, 0x0c, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 
-  0xff, 0xff, 0xff, 0xff, 0x63, 0x4c, 0x00, 0x00, 0x00, 0x00, 0xbd, 0xf7, 0xff, 0xff, 0x84, 0x30, 
-  0x63, 0x2c, 0xff, 0xff, 0xe7, 0x3c, 0x10, 0x82, 0x00, 0x00, 0x00, 0x00, 0x9d, 0x13, 0xff, 0xff, 
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xa5, 0x34, 0x00, 0x00, 0x00, 0x00, 
-  0x31, 0xa6, 0xf7, 0xde, 0xff, 0xff, 0x42, 0x48, 0x10, 0x82, 0xe7, 0x3c, 0xff, 0xff, 0x9c, 0xf3, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7b, 0xef, 0xd6, 0xba, 0xff, 0xff, 0xff, 0xff, 0xd6, 0xba, 
-  0x7b, 0xef, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xb5, 0xd6, 0xff, 0xff, 0xc6, 0x58, 0x00, 0x20, 
-  0x00, 0x00, 0x6b, 0x4d, 0xff, 0xff, 0xff, 0xff, 0x6b, 0x6d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x10, 0xa2, 0x42, 0x08, 0x42, 0x08, 0x18, 0xc3, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x94, 0xb2, 
-  0xff, 0xff, 0xff, 0xff, 0x4a, 0x69, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xa5, 0x34, 0xff, 0xff, 
-  0xff, 0xff, 0x94, 0xb2, 0x10, 0xa2, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x18, 0xe3, 0xad, 0x55, 0xff, 0xff, 0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x08, 0x41, 0xad, 0x95, 0xff, 0xff, 0xff, 0xff, 0xe7, 0x3c, 0x84, 0x10, 
-  0x42, 0x08, 0x31, 0xa6, 0x31, 0xa6, 0x42, 0x28, 0x8c, 0x91, 0xef, 0x7d, 0xff, 0xff, 0xff, 0xff, 
-  0x8c, 0x91, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x73, 0x8e, 0xef, 0x7d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf7, 0xde, 0xff, 0xff, 0xff, 0xff, 
-  0xff, 0xff, 0xff, 0xff, 0xd6, 0xda, 0x5a, 0xeb, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x04, 0x73, 0xae, 0xc6, 0x38, 
-  0xef, 0x9d, 0xff, 0xff, 0xff, 0xff, 0xef, 0x9d, 0xbd, 0xf7, 0x63, 0x2c, 0x10, 0xa2, 0x00, 0x00, 
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+  0x00, 0x00, 0xad, 0x75, 0xff, 0xff, 0x73, 0xce, 0x87, 0x00, 0x00, 0x0b, 0x94, 0xd2, 0xff, 0xff, 
+  0x84, 0x30, 0x00, 0x00, 0x9c, 0xd3, 0xff, 0xff, 0xff, 0xff, 0x9c, 0xd3, 0x00, 0x00, 0xad, 0x75, 
+  0xff, 0xff, 0x6b, 0x6d, 0x86, 0x00, 0x00, 0x0d, 0x21, 0x04, 0xd6, 0xba, 0xff, 0xff, 0x8c, 0x71, 
+  0x00, 0x00, 0x9c, 0xd3, 0xff, 0xff, 0xff, 0xff, 0x94, 0xd2, 0x00, 0x00, 0xbd, 0xf7, 0xff, 0xff, 
+  0xb5, 0xd6, 0x08, 0x41, 0x84, 0x00, 0x00, 0x0f, 0x29, 0x45, 0xd6, 0xda, 0xff, 0xff, 0xff, 0xff, 
+  0x63, 0x0c, 0x00, 0x00, 0x9c, 0xf3, 0xff, 0xff, 0xff, 0xff, 0x9c, 0xf3, 0x00, 0x00, 0x84, 0x10, 
+  0xff, 0xff, 0xff, 0xff, 0xbd, 0xd7, 0x08, 0x61, 0x82, 0x00, 0x00, 0x17, 0x10, 0x82, 0xd6, 0xda, 
+  0xff, 0xff, 0xef, 0x7d, 0x5a, 0xcb, 0x00, 0x00, 0x00, 0x00, 0x94, 0xd2, 0xff, 0xff, 0xff, 0xff, 
+  0x9c, 0xf3, 0x00, 0x00, 0x00, 0x00, 0x6b, 0x8d, 0xff, 0xff, 0xff, 0xff, 0xbd, 0xd7, 0x08, 0x41, 
+  0x00, 0x00, 0x00, 0x00, 0x94, 0xd2, 0xff, 0xff, 0xef, 0x9d, 0x39, 0xc7, 0x82, 0x00, 0x00, 0x03, 
+  0xad, 0x75, 0xff, 0xff, 0xff, 0xff, 0xad, 0x95, 0x82, 0x00, 0x00, 0x1f, 0x5a, 0xeb, 0xf7, 0xde, 
+  0xff, 0xff, 0x73, 0xce, 0x00, 0x00, 0x21, 0x24, 0xf7, 0xde, 0xff, 0xff, 0x6b, 0x6d, 0x00, 0x00, 
+  0x00, 0x00, 0x18, 0xc3, 0xb5, 0xb6, 0xf7, 0xbe, 0xff, 0xff, 0xff, 0xff, 0xf7, 0xbe, 0xb5, 0xb6, 
+  0x18, 0xe3, 0x00, 0x00, 0x00, 0x00, 0x8c, 0x91, 0xff, 0xff, 0xdf, 0x1b, 0x10, 0xa2, 0x7b, 0xcf, 
+  0xff, 0xff, 0xd6, 0xba, 0x00, 0x00, 0x00, 0x00, 0x08, 0x61, 0xce, 0x79, 0x85, 0xff, 0xff, 0x0c, 
+  0xce, 0x99, 0x08, 0x61, 0x00, 0x00, 0x21, 0x04, 0xef, 0x7d, 0xff, 0xff, 0x5a, 0xeb, 0xb5, 0xd6, 
+  0xff, 0xff, 0x84, 0x30, 0x00, 0x00, 0x00, 0x00, 0x84, 0x30, 0x87, 0xff, 0xff, 0x0b, 0x8c, 0x71, 
+  0x00, 0x00, 0x00, 0x00, 0xa5, 0x34, 0xff, 0xff, 0x94, 0xb2, 0xef, 0x7d, 0xff, 0xff, 0x4a, 0x69, 
+  0x00, 0x00, 0x00, 0x00, 0xc6, 0x18, 0x87, 0xff, 0xff, 0x0b, 0xc6, 0x38, 0x00, 0x00, 0x00, 0x00, 
+  0x73, 0xce, 0xff, 0xff, 0xbd, 0xd7, 0xf7, 0xbe, 0xff, 0xff, 0x42, 0x08, 0x00, 0x00, 0x00, 0x20, 
+  0xc6, 0x58, 0x87, 0xff, 0xff, 0x0b, 0xce, 0x79, 0x00, 0x20, 0x00, 0x00, 0x6b, 0x4d, 0xff, 0xff, 
+  0xc6, 0x58, 0xde, 0xfb, 0xff, 0xff, 0x5a, 0xeb, 0x00, 0x00, 0x00, 0x00, 0xbd, 0xf7, 0x87, 0xff, 
+  0xff, 0x0b, 0xbe, 0x17, 0x00, 0x00, 0x00, 0x00, 0x84, 0x50, 0xff, 0xff, 0xad, 0x75, 0xa5, 0x34, 
+  0xff, 0xff, 0x9d, 0x13, 0x00, 0x00, 0x00, 0x00, 0x63, 0x0c, 0x87, 0xff, 0xff, 0x0c, 0x63, 0x4c, 
+  0x00, 0x00, 0x00, 0x00, 0xbd, 0xf7, 0xff, 0xff, 0x84, 0x30, 0x63, 0x2c, 0xff, 0xff, 0xe7, 0x3c, 
+  0x10, 0x82, 0x00, 0x00, 0x00, 0x00, 0x9d, 0x13, 0x85, 0xff, 0xff, 0x0a, 0xa5, 0x34, 0x00, 0x00, 
+  0x00, 0x00, 0x31, 0xa6, 0xf7, 0xde, 0xff, 0xff, 0x42, 0x48, 0x10, 0x82, 0xe7, 0x3c, 0xff, 0xff, 
+  0x9c, 0xf3, 0x82, 0x00, 0x00, 0x05, 0x7b, 0xef, 0xd6, 0xba, 0xff, 0xff, 0xff, 0xff, 0xd6, 0xba, 
+  0x7b, 0xef, 0x82, 0x00, 0x00, 0x08, 0xb5, 0xd6, 0xff, 0xff, 0xc6, 0x58, 0x00, 0x20, 0x00, 0x00, 
+  0x6b, 0x4d, 0xff, 0xff, 0xff, 0xff, 0x6b, 0x6d, 0x82, 0x00, 0x00, 0x03, 0x10, 0xa2, 0x42, 0x08, 
+  0x42, 0x08, 0x18, 0xc3, 0x82, 0x00, 0x00, 0x03, 0x94, 0xb2, 0xff, 0xff, 0xff, 0xff, 0x4a, 0x69, 
+  0x82, 0x00, 0x00, 0x04, 0xa5, 0x34, 0xff, 0xff, 0xff, 0xff, 0x94, 0xb2, 0x10, 0xa2, 0x85, 0x00, 
+  0x00, 0x04, 0x18, 0xe3, 0xad, 0x55, 0xff, 0xff, 0xff, 0xff, 0x84, 0x30, 0x83, 0x00, 0x00, 0x0e, 
+  0x08, 0x41, 0xad, 0x95, 0xff, 0xff, 0xff, 0xff, 0xe7, 0x3c, 0x84, 0x10, 0x42, 0x08, 0x31, 0xa6, 
+  0x31, 0xa6, 0x42, 0x28, 0x8c, 0x91, 0xef, 0x7d, 0xff, 0xff, 0xff, 0xff, 0x8c, 0x91, 0x86, 0x00, 
+  0x00, 0x01, 0x73, 0x8e, 0xef, 0x7d, 0x82, 0xff, 0xff, 0x00, 0xf7, 0xde, 0x83, 0xff, 0xff, 0x01, 
+  0xd6, 0xda, 0x5a, 0xeb, 0x88, 0x00, 0x00, 0x09, 0x21, 0x04, 0x73, 0xae, 0xc6, 0x38, 0xef, 0x9d, 
+  0xff, 0xff, 0xff, 0xff, 0xef, 0x9d, 0xbd, 0xf7, 0x63, 0x2c, 0x10, 0xa2, 0x84, 0x00, 0x00
 };
\ No newline at end of file
@@ -1,4 +1,4 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/thermometer.png -o thermometer` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/thermometer.png -o thermometer -r` */
 
 #ifndef __GFX_THERMOMETER_H__
 #define __GFX_THERMOMETER_H__
@@ -8,6 +8,7 @@
 #define GFX_THERMOMETER_HEIGHT (37)
 #define GFX_THERMOMETER_WIDTH  (20)
 
-extern const uint8_t gfx_thermometer[1480];
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_thermometer[1039];
 
 #endif // __GFX_THERMOMETER_H__
\ No newline at end of file
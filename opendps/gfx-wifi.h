@@ -1,4 +1,4 @@
-/** Gfx generated from `./gen_lookup.py -i gfx/png/wifi.png -o wifi` */
+/** Gfx generated from `./gen_lookup.py -i gfx/png/wifi.png -o wifi -r` */
 
 #ifndef __GFX_WIFI_H__
 #define __GFX_WIFI_H__
@@ -8,6 +8,7 @@
 #define GFX_WIFI_HEIGHT (16)
 #define GFX_WIFI_WIDTH  (19)
 
-extern const uint8_t gfx_wifi[608];
+/** RLE compressed, draw using tft_blit_compressed() */
+extern const uint8_t gfx_wifi[373];
 
 #endif // __GFX_WIFI_H__
\ No newline at end of file
@@ -15,6 +15,9 @@
   *   - Two 2-bit pixels at a time means the result is a pair of two 16-bit bgr565 pixels -- a single uint32_t is used to describe both in one value
   *   - Originally, this was a 256-entry uint64_t array, and allowed expanding all 4 pixels for an input byte in a single operation
   *   - The 64-bit table used a lot more flash space.
+  * With CONFIG_TFT_WIDE_GLYPH the 256-entry mono2bpp_lookup4 table expands all 4 pixels of a byte again:
+  *   - 2KB of flash for the white table, MONO2BPP_LOOKUP4() initializes tables with a color mask already applied, 2KB each
+  *   - The first pixel of a byte is in the low bits of the byte and in the low 16 bits of the entry
   */
 
 const uint32_t mono2bpp_lookup[16] = {
@@ -23,3 +26,7 @@ const uint32_t mono2bpp_lookup[16] = {
     0x54A50000, 0x54A5AA52, 0x54A554A5, 0x54A5FFFF,
     0xFFFF0000, 0xFFFFAA52, 0xFFFF54A5, 0xFFFFFFFF,
 };
+
+#ifdef CONFIG_TFT_WIDE_GLYPH
+const uint64_t mono2bpp_lookup4[256] = MONO2BPP_LOOKUP4(0xFFFFFFFFFFFFFFFFULL);
+#endif // CONFIG_TFT_WIDE_GLYPH
@@ -5,4 +5,76 @@
 
 extern const uint32_t mono2bpp_lookup[16];
 
+#ifdef CONFIG_TFT_WIDE_GLYPH
+/** Initializer of a 256-entry table expanding a byte, four pixels, masked with a color repeated four times */
+#define MONO2BPP_LOOKUP4(mask) { \
+    0x0000000000000000ULL & (mask), 0x000000000000AA52ULL & (mask), 0x00000000000054A5ULL & (mask), 0x000000000000FFFFULL & (mask), \
+    0x00000000AA520000ULL & (mask), 0x00000000AA52AA52ULL & (mask), 0x00000000AA5254A5ULL & (mask), 0x00000000AA52FFFFULL & (mask), \
+    0x0000000054A50000ULL & (mask), 0x0000000054A5AA52ULL & (mask), 0x0000000054A554A5ULL & (mask), 0x0000000054A5FFFFULL & (mask), \
+    0x00000000FFFF0000ULL & (mask), 0x00000000FFFFAA52ULL & (mask), 0x00000000FFFF54A5ULL & (mask), 0x00000000FFFFFFFFULL & (mask), \
+    0x0000AA5200000000ULL & (mask), 0x0000AA520000AA52ULL & (mask), 0x0000AA52000054A5ULL & (mask), 0x0000AA520000FFFFULL & (mask), \
+    0x0000AA52AA520000ULL & (mask), 0x0000AA52AA52AA52ULL & (mask), 0x0000AA52AA5254A5ULL & (mask), 0x0000AA52AA52FFFFULL & (mask), \
+    0x0000AA5254A50000ULL & (mask), 0x0000AA5254A5AA52ULL & (mask), 0x0000AA5254A554A5ULL & (mask), 0x0000AA5254A5FFFFULL & (mask), \
+    0x0000AA52FFFF0000ULL & (mask), 0x0000AA52FFFFAA52ULL & (mask), 0x0000AA52FFFF54A5ULL & (mask), 0x0000AA52FFFFFFFFULL & (mask), \
+    0x000054A500000000ULL & (mask), 0x000054A50000AA52ULL & (mask), 0x000054A5000054A5ULL & (mask), 0x000054A50000FFFFULL & (mask), \
+    0x000054A5AA520000ULL & (mask), 0x000054A5AA52AA52ULL & (mask), 0x000054A5AA5254A5ULL & (mask), 0x000054A5AA52FFFFULL & (mask), \
+    0x000054A554A50000ULL & (mask), 0x000054A554A5AA52ULL & (mask), 0x000054A554A554A5ULL & (mask), 0x000054A554A5FFFFULL & (mask), \
+    0x000054A5FFFF0000ULL & (mask), 0x000054A5FFFFAA52ULL & (mask), 0x000054A5FFFF54A5ULL & (mask), 0x000054A5FFFFFFFFULL & (mask), \
+    0x0000FFFF00000000ULL & (mask), 0x0000FFFF0000AA52ULL & (mask), 0x0000FFFF000054A5ULL & (mask), 0x0000FFFF0000FFFFULL & (mask), \
+    0x0000FFFFAA520000ULL & (mask), 0x0000FFFFAA52AA52ULL & (mask), 0x0000FFFFAA5254A5ULL & (mask), 0x0000FFFFAA52FFFFULL & (mask), \
+    0x0000FFFF54A50000ULL & (mask), 0x0000FFFF54A5AA52ULL & (mask), 0x0000FFFF54A554A5ULL & (mask), 0x0000FFFF54A5FFFFULL & (mask), \
+    0x0000FFFFFFFF0000ULL & (mask), 0x0000FFFFFFFFAA52ULL & (mask), 0x0000FFFFFFFF54A5ULL & (mask), 0x0000FFFFFFFFFFFFULL & (mask), \
+    0xAA52000000000000ULL & (mask), 0xAA5200000000AA52ULL & (mask), 0xAA520000000054A5ULL & (mask), 0xAA5200000000FFFFULL & (mask), \
+    0xAA520000AA520000ULL & (mask), 0xAA520000AA52AA52ULL & (mask), 0xAA520000AA5254A5ULL & (mask), 0xAA520000AA52FFFFULL & (mask), \
+    0xAA52000054A50000ULL & (mask), 0xAA52000054A5AA52ULL & (mask), 0xAA52000054A554A5ULL & (mask), 0xAA52000054A5FFFFULL & (mask), \
+    0xAA520000FFFF0000ULL & (mask), 0xAA520000FFFFAA52ULL & (mask), 0xAA520000FFFF54A5ULL & (mask), 0xAA520000FFFFFFFFULL & (mask), \
+    0xAA52AA5200000000ULL & (mask), 0xAA52AA520000AA52ULL & (mask), 0xAA52AA52000054A5ULL & (mask), 0xAA52AA520000FFFFULL & (mask), \
+    0xAA52AA52AA520000ULL & (mask), 0xAA52AA52AA52AA52ULL & (mask), 0xAA52AA52AA5254A5ULL & (mask), 0xAA52AA52AA52FFFFULL & (mask), \
+    0xAA52AA5254A50000ULL & (mask), 0xAA52AA5254A5AA52ULL & (mask), 0xAA52AA5254A554A5ULL & (mask), 0xAA52AA5254A5FFFFULL & (mask), \
+    0xAA52AA52FFFF0000ULL & (mask), 0xAA52AA52FFFFAA52ULL & (mask), 0xAA52AA52FFFF54A5ULL & (mask), 0xAA52AA52FFFFFFFFULL & (mask), \
+    0xAA5254A500000000ULL & (mask), 0xAA5254A50000AA52ULL & (mask), 0xAA5254A5000054A5ULL & (mask), 0xAA5254A50000FFFFULL & (mask), \
+    0xAA5254A5AA520000ULL & (mask), 0xAA5254A5AA52AA52ULL & (mask), 0xAA5254A5AA5254A5ULL & (mask), 0xAA5254A5AA52FFFFULL & (mask), \
+    0xAA5254A554A50000ULL & (mask), 0xAA5254A554A5AA52ULL & (mask), 0xAA5254A554A554A5ULL & (mask), 0xAA5254A554A5FFFFULL & (mask), \
+    0xAA5254A5FFFF0000ULL & (mask), 0xAA5254A5FFFFAA52ULL & (mask), 0xAA5254A5FFFF54A5ULL & (mask), 0xAA5254A5FFFFFFFFULL & (mask), \
+    0xAA52FFFF00000000ULL & (mask), 0xAA52FFFF0000AA52ULL & (mask), 0xAA52FFFF000054A5ULL & (mask), 0xAA52FFFF0000FFFFULL & (mask), \
+    0xAA52FFFFAA520000ULL & (mask), 0xAA52FFFFAA52AA52ULL & (mask), 0xAA52FFFFAA5254A5ULL & (mask), 0xAA52FFFFAA52FFFFULL & (mask), \
+    0xAA52FFFF54A50000ULL & (mask), 0xAA52FFFF54A5AA52ULL & (mask), 0xAA52FFFF54A554A5ULL & (mask), 0xAA52FFFF54A5FFFFULL & (mask), \
+    0xAA52FFFFFFFF0000ULL & (mask), 0xAA52FFFFFFFFAA52ULL & (mask), 0xAA52FFFFFFFF54A5ULL & (mask), 0xAA52FFFFFFFFFFFFULL & (mask), \
+    0x54A5000000000000ULL & (mask), 0x54A500000000AA52ULL & (mask), 0x54A50000000054A5ULL & (mask), 0x54A500000000FFFFULL & (mask), \
+    0x54A50000AA520000ULL & (mask), 0x54A50000AA52AA52ULL & (mask), 0x54A50000AA5254A5ULL & (mask), 0x54A50000AA52FFFFULL & (mask), \
+    0x54A5000054A50000ULL & (mask), 0x54A5000054A5AA52ULL & (mask), 0x54A5000054A554A5ULL & (mask), 0x54A5000054A5FFFFULL & (mask), \
+    0x54A50000FFFF0000ULL & (mask), 0x54A50000FFFFAA52ULL & (mask), 0x54A50000FFFF54A5ULL & (mask), 0x54A50000FFFFFFFFULL & (mask), \
+    0x54A5AA5200000000ULL & (mask), 0x54A5AA520000AA52ULL & (mask), 0x54A5AA52000054A5ULL & (mask), 0x54A5AA520000FFFFULL & (mask), \
+    0x54A5AA52AA520000ULL & (mask), 0x54A5AA52AA52AA52ULL & (mask), 0x54A5AA52AA5254A5ULL & (mask), 0x54A5AA52AA52FFFFULL & (mask), \
+    0x54A5AA5254A50000ULL & (mask), 0x54A5AA5254A5AA52ULL & (mask), 0x54A5AA5254A554A5ULL & (mask), 0x54A5AA5254A5FFFFULL & (mask), \
+    0x54A5AA52FFFF0000ULL & (mask), 0x54A5AA52FFFFAA52ULL & (mask), 0x54A5AA52FFFF54A5ULL & (mask), 0x54A5AA52FFFFFFFFULL & (mask), \
+    0x54A554A500000000ULL & (mask), 0x54A554A50000AA52ULL & (mask), 0x54A554A5000054A5ULL & (mask), 0x54A554A50000FFFFULL & (mask), \
+    0x54A554A5AA520000ULL & (mask), 0x54A554A5AA52AA52ULL & (mask), 0x54A554A5AA5254A5ULL & (mask), 0x54A554A5AA52FFFFULL & (mask), \
+    0x54A554A554A50000ULL & (mask), 0x54A554A554A5AA52ULL & (mask), 0x54A554A554A554A5ULL & (mask), 0x54A554A554A5FFFFULL & (mask), \
+    0x54A554A5FFFF0000ULL & (mask), 0x54A554A5FFFFAA52ULL & (mask), 0x54A554A5FFFF54A5ULL & (mask), 0x54A554A5FFFFFFFFULL & (mask), \
+    0x54A5FFFF00000000ULL & (mask), 0x54A5FFFF0000AA52ULL & (mask), 0x54A5FFFF000054A5ULL & (mask), 0x54A5FFFF0000FFFFULL & (mask), \
+    0x54A5FFFFAA520000ULL & (mask), 0x54A5FFFFAA52AA52ULL & (mask), 0x54A5FFFFAA5254A5ULL & (mask), 0x54A5FFFFAA52FFFFULL & (mask), \
+    0x54A5FFFF54A50000ULL & (mask), 0x54A5FFFF54A5AA52ULL & (mask), 0x54A5FFFF54A554A5ULL & (mask), 0x54A5FFFF54A5FFFFULL & (mask), \
+    0x54A5FFFFFFFF0000ULL & (mask), 0x54A5FFFFFFFFAA52ULL & (mask), 0x54A5FFFFFFFF54A5ULL & (mask), 0x54A5FFFFFFFFFFFFULL & (mask), \
+    0xFFFF000000000000ULL & (mask), 0xFFFF00000000AA52ULL & (mask), 0xFFFF0000000054A5ULL & (mask), 0xFFFF00000000FFFFULL & (mask), \
+    0xFFFF0000AA520000ULL & (mask), 0xFFFF0000AA52AA52ULL & (mask), 0xFFFF0000AA5254A5ULL & (mask), 0xFFFF0000AA52FFFFULL & (mask), \
+    0xFFFF000054A50000ULL & (mask), 0xFFFF000054A5AA52ULL & (mask), 0xFFFF000054A554A5ULL & (mask), 0xFFFF000054A5FFFFULL & (mask), \
+    0xFFFF0000FFFF0000ULL & (mask), 0xFFFF0000FFFFAA52ULL & (mask), 0xFFFF0000FFFF54A5ULL & (mask), 0xFFFF0000FFFFFFFFULL & (mask), \
+    0xFFFFAA5200000000ULL & (mask), 0xFFFFAA520000AA52ULL & (mask), 0xFFFFAA52000054A5ULL & (mask), 0xFFFFAA520000FFFFULL & (mask), \
+    0xFFFFAA52AA520000ULL & (mask), 0xFFFFAA52AA52AA52ULL & (mask), 0xFFFFAA52AA5254A5ULL & (mask), 0xFFFFAA52AA52FFFFULL & (mask), \
+    0xFFFFAA5254A50000ULL & (mask), 0xFFFFAA5254A5AA52ULL & (mask), 0xFFFFAA5254A554A5ULL & (mask), 0xFFFFAA5254A5FFFFULL & (mask), \
+    0xFFFFAA52FFFF0000ULL & (mask), 0xFFFFAA52FFFFAA52ULL & (mask), 0xFFFFAA52FFFF54A5ULL & (mask), 0xFFFFAA52FFFFFFFFULL & (mask), \
+    0xFFFF54A500000000ULL & (mask), 0xFFFF54A50000AA52ULL & (mask), 0xFFFF54A5000054A5ULL & (mask), 0xFFFF54A50000FFFFULL & (mask), \
+    0xFFFF54A5AA520000ULL & (mask), 0xFFFF54A5AA52AA52ULL & (mask), 0xFFFF54A5AA5254A5ULL & (mask), 0xFFFF54A5AA52FFFFULL & (mask), \
+    0xFFFF54A554A50000ULL & (mask), 0xFFFF54A554A5AA52ULL & (mask), 0xFFFF54A554A554A5ULL & (mask), 0xFFFF54A554A5FFFFULL & (mask), \
+    0xFFFF54A5FFFF0000ULL & (mask), 0xFFFF54A5FFFFAA52ULL & (mask), 0xFFFF54A5FFFF54A5ULL & (mask), 0xFFFF54A5FFFFFFFFULL & (mask), \
+    0xFFFFFFFF00000000ULL & (mask), 0xFFFFFFFF0000AA52ULL & (mask), 0xFFFFFFFF000054A5ULL & (mask), 0xFFFFFFFF0000FFFFULL & (mask), \
+    0xFFFFFFFFAA520000ULL & (mask), 0xFFFFFFFFAA52AA52ULL & (mask), 0xFFFFFFFFAA5254A5ULL & (mask), 0xFFFFFFFFAA52FFFFULL & (mask), \
+    0xFFFFFFFF54A50000ULL & (mask), 0xFFFFFFFF54A5AA52ULL & (mask), 0xFFFFFFFF54A554A5ULL & (mask), 0xFFFFFFFF54A5FFFFULL & (mask), \
+    0xFFFFFFFFFFFF0000ULL & (mask), 0xFFFFFFFFFFFFAA52ULL & (mask), 0xFFFFFFFFFFFF54A5ULL & (mask), 0xFFFFFFFFFFFFFFFFULL & (mask), \
+}
+
+extern const uint64_t mono2bpp_lookup4[256];
+#endif // CONFIG_TFT_WIDE_GLYPH
+
 #endif // __LOOKUP_GFX_LOOKUP_H__
@@ -34,17 +34,52 @@
 #include <exti.h>
 #include <usart.h>
 #include <scb.h>
+#ifdef CONFIG_ADC_DMA
+#include <dma.h>
+#endif // CONFIG_ADC_DMA
+#if defined(CONFIG_OCP_BENCH) || defined(CONFIG_ADC_PROFILES)
+#include <cortex.h>
+#endif
+#include <dwt.h>
 #include "tick.h"
 #include "spi_driver.h"
 #include "pwrctl.h"
 #include "hw.h"
 #include "event.h"
 #include "dps-model.h"
+#include "perf.h"
+#include "probe.h"
+#include "load.h"
+#include "ramfunc.h"
+#include "isrhook.h"
+#if defined(CONFIG_USART_TX_IRQ) || defined(CONFIG_USART_RX_RING)
+#include "ringbuf.h"
+#endif // CONFIG_USART_TX_IRQ || CONFIG_USART_RX_RING
+#ifdef CONFIG_ADC_RECORDER
+#include "recorder.h"
+#endif // CONFIG_ADC_RECORDER
+#ifdef CONFIG_ENERGY_METER
+#include "energy.h"
+#endif // CONFIG_ENERGY_METER
+#ifdef CONFIG_WINDOW_STATS
+#include "winstats.h"
+#endif // CONFIG_WINDOW_STATS
+#ifdef CONFIG_OCP_BENCH
+#include "wdog.h"
+#endif // CONFIG_OCP_BENCH
+#ifdef CONFIG_LOCKIN
+#include "func_gen.h"
+#include "lockin.h"
+#endif // CONFIG_LOCKIN
 
 /** Linker file symbols */
 extern uint32_t *_ram_vect_start;
 extern uint32_t *_ram_vect_end;
 extern uint32_t *vector_table;
+#if defined(CONFIG_RAMFUNC) || defined(CONFIG_FLASH_RAMFUNC)
+/** Load and run addresses of the .ramfunc section, see stm32f100_app.ld */
+extern uint32_t _ramfunc_loadaddr, _ramfunc_start, _ramfunc_end;
+#endif // CONFIG_RAMFUNC || CONFIG_FLASH_RAMFUNC
 
 
 static void common_timer_init(enum rcc_periph_clken rcc, uint32_t timer, uint32_t period, uint32_t prescaler);
@@ -57,18 +92,121 @@ static void exti_init(void);
 static void dac_init(void);
 static void button_irq_init(void);
 static void copy_vectors(void);
-#ifdef CONFIG_FUNCGEN_ENABLE
+#if defined(CONFIG_RAMFUNC) || defined(CONFIG_FLASH_RAMFUNC)
+static void copy_ramfuncs(void);
+#endif // CONFIG_RAMFUNC || CONFIG_FLASH_RAMFUNC
+static void hooks_init(void);
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+/** DMA owns DAC_DHR12R1, keep the V_out loop and hw_set_dacs() from writing it */
+static volatile bool dac_wave_running;
+#endif
 static void tim3_init(void);
-void (*funcgen_tick)(void) = &fg_noop;
-volatile uint16_t cur_time_hiw;
+/** TIM3 wraps counted by the update ISR, time_wraps_next is time_wraps + 1 while it is being updated */
+static volatile uint64_t time_wraps;
+static volatile uint64_t time_wraps_next;
+/** Odd while the update ISR changes time_wraps */
+static volatile uint32_t time_seq;
+#ifdef CONFIG_SEQUENCER_ENABLE
+static volatile uint64_t alarm_at;
+static void (*volatile alarm_cb)(void);
+#endif // CONFIG_SEQUENCER_ENABLE
+#ifdef CONFIG_VOUT_SOFT_START
+static uint16_t ramp_period;
+static void (*volatile ramp_cb)(void);
+#endif // CONFIG_VOUT_SOFT_START
+
+/** The ADC needs 1us (tSTAB) after power on before it can be calibrated,
+    this leaves a generous margin (ms) */
+#ifndef ADC_STARTUP_MS
+#define ADC_STARTUP_MS  (10)
 #endif
+/** When adc1_init() powered the ADC on */
+static uint64_t adc_power_on_ticks;
+
+#ifdef CONFIG_ADC_PROFILES
+/** TIM2 counts at 48MHz / 9 */
+#define TIM2_CLOCK_HZ  (48000000 / 9)
+
+/** The settings of an acquisition profile, see adc_profile_t */
+typedef struct {
+    uint16_t period;            /** TIM2 period, sample sets at TIM2_CLOCK_HZ / (period + 1) */
+    uint8_t sample_time;        /** ADC_SMPR_SMP_* of I_out, V_in and V_out */
+    uint8_t oversample_less;    /** log2 of how many times fewer than ADC_OVERSAMPLE_RATIO samples are decimated */
+} adc_profile_params_t;
+
+/** A scan of the three channels takes 3 * (sample time + 12.5) cycles of the 12MHz ADC clock */
+static const adc_profile_params_t adc_profiles[adc_profile_count] = {
+    [adc_profile_default] = { 0xFF, ADC_SMPR_SMP_28DOT5CYC, 0 },
+    [adc_profile_low_noise] = { 0x3FF, ADC_SMPR_SMP_239DOT5CYC, 0 },
+    [adc_profile_high_speed] = { 0x9F, ADC_SMPR_SMP_13DOT5CYC, 3 },
+};
+
+static adc_profile_t adc_profile = adc_profile_default;
+/** Set once tim2_init() has started the trigger */
+static bool tim2_running;
+
+ #define TIM2_PERIOD      (adc_profiles[adc_profile].period)
+ #define ADC_SAMPLE_TIME  (adc_profiles[adc_profile].sample_time)
+#else // CONFIG_ADC_PROFILES
+ #define TIM2_PERIOD      (0xFF)
+ #define ADC_SAMPLE_TIME  (ADC_SMPR_SMP_28DOT5CYC)
+#endif // CONFIG_ADC_PROFILES
 
 static volatile uint16_t i_out_adc;
 static volatile uint16_t i_out_trig_adc;
 static volatile uint16_t v_in_adc;
 static volatile uint16_t v_out_adc;
 static volatile uint16_t v_out_trig_adc;
+#ifdef CONFIG_BUTTON_TIMER
+/** Set while the TIM3 channel 3 debounce lockout runs */
+static volatile bool debounce_active;
+#else // CONFIG_BUTTON_TIMER
 static volatile uint64_t last_button_down;
+#endif // CONFIG_BUTTON_TIMER
+#ifdef CONFIG_TRIP_SNAPSHOT
+/** Ring of the last sample sets, frozen into trip_snapshot at a trip */
+static uint16_t trip_history[TRIP_SNAPSHOT_SAMPLES][3];
+static uint32_t trip_history_pos;
+static trip_t trip_pending;
+static volatile trip_snapshot_t trip_snapshot;
+#endif // CONFIG_TRIP_SNAPSHOT
+#ifdef CONFIG_OCP_BENCH
+/** Time given the output to settle before each synthetic trip (ms) */
+#ifndef OCP_BENCH_SETTLE_MS
+#define OCP_BENCH_SETTLE_MS  (5)
+#endif
+/** Longest wait for a synthetic trip before the bench gives up (ms) */
+#ifndef OCP_BENCH_TIMEOUT_MS
+#define OCP_BENCH_TIMEOUT_MS  (50)
+#endif
+/** Set by hw_ocp_bench() with the synthetic limit, cleared by the trip */
+static volatile bool ocp_bench_armed;
+/** DWT_CYCCNT when the synthetic limit was published */
+static volatile uint32_t ocp_bench_start;
+/** Cycles from publishing the limit until the output was disabled */
+static volatile uint32_t ocp_bench_cycles;
+#endif // CONFIG_OCP_BENCH
+/** Calibration statistics, filled while adc_stats_left is non zero */
+static adc_stats_t adc_stats;
+static volatile uint32_t adc_stats_left;
+#ifdef CONFIG_ADC_OVERSAMPLE
+/** Boxcar accumulators, one per channel, emptied every ADC_OVERSAMPLE_RATIO samples */
+static uint32_t i_out_acc, v_in_acc, v_out_acc;
+static uint32_t oversample_count;
+/** Latest decimated sums, ADC_OVERSAMPLE_SHIFT bits wider than a raw sample */
+static volatile uint32_t i_out_dec, v_in_dec, v_out_dec;
+#ifdef CONFIG_ADC_PROFILES
+/** Samples per decimated sum of the profile and the shift scaling the sum
+  * to ADC_OVERSAMPLE_SHIFT bits */
+static uint32_t oversample_ratio = ADC_OVERSAMPLE_RATIO;
+static uint32_t oversample_scale;
+ #define OVERSAMPLE_RATIO  oversample_ratio
+ #define OVERSAMPLE_SCALE  oversample_scale
+#else // CONFIG_ADC_PROFILES
+ #define OVERSAMPLE_RATIO  ADC_OVERSAMPLE_RATIO
+ #define OVERSAMPLE_SCALE  0
+#endif // CONFIG_ADC_PROFILES
+#endif // CONFIG_ADC_OVERSAMPLE
 
 typedef enum {
     adc_cha_i_out = 0,
@@ -77,14 +215,48 @@ typedef enum {
     adc_cha_max,
 
 } adc_channel_t;
+#ifndef CONFIG_ADC_DMA
 _Static_assert (adc_cha_max <= 4, "Max 4 channels for injected sampling");
+#endif // CONFIG_ADC_DMA
 
 const uint8_t channels[adc_cha_max] = { ADC_CHA_IOUT, ADC_CHA_VIN, ADC_CHA_VOUT }; /** Must have the same order as adc_channel_t */
 
+#ifdef CONFIG_ADC_DMA
+/** Number of scan sequences in each half of the DMA buffer. Processing
+  * happens on the half and full transfer interrupts, so with N sequences per
+  * half the interrupt rate drops to 1/N of the sample rate. */
+#ifndef ADC_DMA_SEQUENCES
+ #define ADC_DMA_SEQUENCES  (1)
+#endif
+/** Double buffered sample array, DMA writes one half while the other half is
+  * being processed. Layout is [half][sequence][adc_channel_t] */
+static volatile uint16_t adc_dma_buffer[2 * ADC_DMA_SEQUENCES * adc_cha_max];
+#endif // CONFIG_ADC_DMA
+
+#ifdef CONFIG_USART_TX_IRQ
+/** Transmit ring of bytes drained by usart1_isr */
+static uint8_t tx_buffer[USART_TX_RING_SIZE];
+static ringbuf_t tx_ring;
+#endif // CONFIG_USART_TX_IRQ
+
+#ifdef CONFIG_USART_RX_RING
+/** Receive ring filled by usart1_isr, drained by the main loop */
+static uint8_t rx_buffer[USART_RX_RING_SIZE];
+static ringbuf_t rx_ring;
+#endif // CONFIG_USART_RX_RING
+
+/** Receive errors counted by usart1_isr */
+static volatile hw_usart_errors_t usart_errors;
+
 /** Used to handle long presses */
 #define LONGPRESS_TIME_MS (1000)
 static volatile event_t longpress_event;
+#ifdef CONFIG_BUTTON_TIMER
+/** get_time_us() at which the TIM3 channel 4 compare posts the long press */
+static volatile uint64_t longpress_at;
+#else // CONFIG_BUTTON_TIMER
 static volatile uint64_t longpress_start;
+#endif // CONFIG_BUTTON_TIMER
 static volatile bool longpress_detected;
 /** Used to filter SET press from SET + ROT */
 static volatile bool set_pressed = false;
@@ -95,31 +267,52 @@ static volatile bool m1_and_m2_pressed = false;
 
 #define DEBOUNCE_TIME_MS    (30)
 
+#ifdef CONFIG_ROTARY_ACCEL
+/** Detents closer than these in the same direction count as several steps */
+#ifndef ROTARY_ACCEL_FAST_MS
+ #define ROTARY_ACCEL_FAST_MS       (15)
+#endif
+#ifndef ROTARY_ACCEL_FAST_STEPS
+ #define ROTARY_ACCEL_FAST_STEPS    (5)
+#endif
+#ifndef ROTARY_ACCEL_MEDIUM_MS
+ #define ROTARY_ACCEL_MEDIUM_MS     (40)
+#endif
+#ifndef ROTARY_ACCEL_MEDIUM_STEPS
+ #define ROTARY_ACCEL_MEDIUM_STEPS  (2)
+#endif
+#endif // CONFIG_ROTARY_ACCEL
+
 /** We skip the first 40 samples. For a connected ESP8266 the first sample
   * will read a current draw of ~3A which will trigger the OCP.
   * @todo Investigate if the ESP8266 _really_ draws 3A or if it is a DPS issue
   */
 #define STARTUP_SKIP_COUNT   (40)
 
-/** Once we are checking for OCP, we need 20 over currents in a row to trigger
-  * OCP. This is due to spikes in the ADC readings.
-  * @todo Investigate if the spikes are real or is a DPS issue
-  */
-#define OCP_FILTER_COUNT (20)
-
-/** Once we are checking for OVP, we need 20 over voltages in a row to trigger
-  * OVP. This is due to spikes in the ADC readings.
-  * @todo Investigate if the spikes are real or is a DPS issue
-  */
-#define OVP_FILTER_COUNT (20)
-
 #ifdef CONFIG_ADC_BENCHMARK
 static uint64_t adc_tick_start;
 #endif // CONFIG_ADC_BENCHMARK
 
+#ifdef CONFIG_ADC_AWD
+/** Analog watchdog high threshold that can never be exceeded by a 12 bit sample */
+#define ADC_AWD_DISARMED  (0xfff)
+#endif // CONFIG_ADC_AWD
+
 /** Number of ADC conversions performed */
 static uint32_t adc_counter;
 
+#ifdef CONFIG_POWER_FAIL
+/** V_in average in 1/256 ADC counts, following V_in with a time constant of
+  * 2^POWER_FAIL_AVG_SHIFT samples, about 390ms */
+#define POWER_FAIL_AVG_SHIFT       (13)
+/** Sample sets in a row below the sag threshold for a power failure, 0.5ms */
+#define POWER_FAIL_SAMPLES         (10)
+/** Sample sets in a row above the sag threshold for V_in to have recovered, 100ms */
+#define POWER_FAIL_RECOVER_SAMPLES (2100)
+static uint32_t v_in_avg;
+static volatile bool power_failing;
+#endif // CONFIG_POWER_FAIL
+
 /** The ADC reading on channel ADC_CHA_IOUT when power out was disabled on the
   * DPS5005 I used to develop OpenDPS. When testing on another unit I noticed
   * the current measurement was quite off, the reason being the ADC reading
@@ -136,6 +329,21 @@ static int32_t adc_i_offset;
 static bool measure_i_out = true;
 /** Used to calculate mean value of ADC_CHA_IOUT when power out is disabled */
 static uint32_t i_offset_calc;
+#ifdef CONFIG_I_AUTO_ZERO
+/** The zero current average follows the I_out samples taken while power out
+  * is disabled with a time constant of 2^I_AUTO_ZERO_SHIFT samples, ~0.8s */
+#define I_AUTO_ZERO_SHIFT      (14)
+/** Samples after power out was disabled before I_out reads 0mA, ~200ms for
+  * the output capacitors to discharge into the load */
+#define I_AUTO_ZERO_SETTLE     (4200)
+/** Largest correction of the boot time offset, a reading further off than
+  * this is a current and not drift */
+#define I_AUTO_ZERO_MAX_DRIFT  (16)
+/** Zero current I_out reading in 1/65536 ADC counts */
+static int32_t i_zero_avg;
+static int32_t adc_i_offset_boot;
+static uint32_t i_zero_settle;
+#endif // CONFIG_I_AUTO_ZERO
 
 /**
   * @brief Initialize the hardware
@@ -144,6 +352,9 @@ static uint32_t i_offset_calc;
 void hw_init(void)
 {
     copy_vectors();
+#if defined(CONFIG_RAMFUNC) || defined(CONFIG_FLASH_RAMFUNC)
+    copy_ramfuncs(); /** Before any RAM function can run */
+#endif // CONFIG_RAMFUNC || CONFIG_FLASH_RAMFUNC
     clock_init();
     systick_init();
     gpio_init();
@@ -153,9 +364,8 @@ void hw_init(void)
     spi_init();
     dac_init();
     button_irq_init();
-#ifdef CONFIG_FUNCGEN_ENABLE
     tim3_init();
-#endif
+    hooks_init();
 
 //    AFIO_MAPR |= AFIO_MAPR_PD01_REMAP; /** @todo The original DPS FW does this, things go south if I do it... */
 }
@@ -169,9 +379,60 @@ void hw_init(void)
   */
 void hw_get_adc_values(uint16_t *i_out_raw, uint16_t *v_in_raw, uint16_t *v_out_raw)
 {
+#ifdef CONFIG_ADC_OVERSAMPLE
+    /** Round the decimated values to the 12 bit scale of a raw sample */
+    *i_out_raw = (i_out_dec + (ADC_OVERSAMPLE_RATIO / 2)) >> ADC_OVERSAMPLE_SHIFT;
+    *v_in_raw = (v_in_dec + (ADC_OVERSAMPLE_RATIO / 2)) >> ADC_OVERSAMPLE_SHIFT;
+    *v_out_raw = (v_out_dec + (ADC_OVERSAMPLE_RATIO / 2)) >> ADC_OVERSAMPLE_SHIFT;
+#else // CONFIG_ADC_OVERSAMPLE
     *i_out_raw = i_out_adc;
     *v_in_raw = v_in_adc;
     *v_out_raw = v_out_adc;
+#endif // CONFIG_ADC_OVERSAMPLE
+}
+
+#ifdef CONFIG_ADC_OVERSAMPLE
+/**
+  * @brief Read latest decimated ADC measurements at full resolution
+  * @param i_out_hires sum of the last ADC_OVERSAMPLE_RATIO I_out samples
+  * @param v_in_hires sum of the last ADC_OVERSAMPLE_RATIO V_in samples
+  * @param v_out_hires sum of the last ADC_OVERSAMPLE_RATIO V_out samples
+  * @retval none
+  */
+void hw_get_adc_values_hires(uint32_t *i_out_hires, uint32_t *v_in_hires, uint32_t *v_out_hires)
+{
+    *i_out_hires = i_out_dec;
+    *v_in_hires = v_in_dec;
+    *v_out_hires = v_out_dec;
+}
+#endif // CONFIG_ADC_OVERSAMPLE
+
+/**
+  * @brief Start accumulating ADC samples
+  * @param count number of sample sets, 0 stops
+  * @retval none
+  */
+void hw_adc_stats_start(uint16_t count)
+{
+    adc_stats_left = 0;
+    memset(&adc_stats, 0, sizeof(adc_stats));
+    adc_stats.count = count;
+    /** Written last, the ISR does not touch adc_stats until now */
+    adc_stats_left = count;
+}
+
+/**
+  * @brief Get the accumulated ADC samples
+  * @param stats receives the statistics
+  * @retval true if all requested samples have been accumulated
+  */
+bool hw_adc_stats_get(adc_stats_t *stats)
+{
+    if (adc_stats_left || !adc_stats.count) {
+        return false;
+    }
+    *stats = adc_stats;
+    return true;
 }
 
 /**
@@ -194,6 +455,23 @@ void hw_set_current_dac(uint16_t i_dac)
     DAC_DHR12R2(DAC1) = i_dac;
 }
 
+/**
+  * @brief Set both DAC values in one write of the dual holding register
+  * @param v_dac the output voltage DAC value
+  * @param i_dac the output current DAC value
+  * @retval none
+  */
+RAMFUNC_HOOK void hw_set_dacs(uint16_t v_dac, uint16_t i_dac)
+{
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+    if (dac_wave_running) {
+        DAC_DHR12R2(DAC1) = i_dac; /** DMA owns channel 1 */
+        return;
+    }
+#endif // CONFIG_FUNCGEN_DAC_DMA
+    DAC_DHR12RD(DAC1) = ((uint32_t) i_dac << 16) | v_dac;
+}
+
 /**
   * @brief Initialize TIM4 that drives the backlight of the TFT
   * @retval None
@@ -240,6 +518,73 @@ uint16_t hw_get_itrig_ma(void)
     return i_out_trig_adc;
 }
 
+#ifdef CONFIG_OCP_BENCH
+/**
+  * @brief Trip the OCP with a synthetic limit and time the response
+  * @param runs number of trips
+  * @param stats receives the latencies in CPU cycles
+  * @retval number of runs that tripped, 0 if the output was disabled
+  * @note Blocks the main loop for OCP_BENCH_SETTLE_MS and the latency of
+  *       each run. The output and the current limit are restored afterwards.
+  */
+uint32_t hw_ocp_bench(uint32_t runs, perf_stats_t *stats)
+{
+    stats->count = 0;
+    stats->min = UINT32_MAX;
+    stats->max = 0;
+    stats->total = 0;
+    if (!pwrctl_vout_enabled()) {
+        return 0;
+    }
+    SCB_DEMCR |= SCB_DEMCR_TRCENA;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+    uint32_t i_limit = pwrctl_get_ilimit();
+    for (uint32_t run = 0; run < runs; run++) {
+        if (!pwrctl_vout_enabled()) {
+            (void) pwrctl_set_ilimit(i_limit);
+            pwrctl_enable_vout(true);
+        }
+        /** Let the output settle and the OCP filter forget the last trip */
+        uint64_t timeout = get_ticks() + OCP_BENCH_SETTLE_MS;
+        while (get_ticks() < timeout) ;
+#ifdef CONFIG_VOUT_SOFT_START
+        timeout = get_ticks() + OCP_BENCH_TIMEOUT_MS;
+        while (pwrctl_vout_ramping() && get_ticks() < timeout) ;
+#endif // CONFIG_VOUT_SOFT_START
+        wdog_kick(); /** Each wait is well within the watchdog period */
+
+        /** Any I_out sample above the lowest non zero limit trips */
+        ocp_bench_armed = true;
+        ocp_bench_start = DWT_CYCCNT;
+        pwrctl_set_ilimit_raw(1);
+        timeout = get_ticks() + OCP_BENCH_TIMEOUT_MS;
+        while (ocp_bench_armed && get_ticks() < timeout) ;
+        wdog_kick();
+
+        cm_disable_interrupts();
+        bool tripped = !ocp_bench_armed;
+        ocp_bench_armed = false;
+        cm_enable_interrupts();
+        if (!tripped) {
+            break;
+        }
+        stats->count++;
+        stats->total += ocp_bench_cycles;
+        if (ocp_bench_cycles < stats->min) {
+            stats->min = ocp_bench_cycles;
+        }
+        if (ocp_bench_cycles > stats->max) {
+            stats->max = ocp_bench_cycles;
+        }
+    }
+    (void) pwrctl_set_ilimit(i_limit);
+    if (!pwrctl_vout_enabled()) {
+        pwrctl_enable_vout(true);
+    }
+    return stats->count;
+}
+#endif // CONFIG_OCP_BENCH
+
 /**
   * @brief Get the ADC value that triggered the OVP
   * @retval Trigger value in mV
@@ -249,6 +594,7 @@ uint16_t hw_get_vtrig_mv(void)
     return v_out_trig_adc;
 }
 
+#ifndef CONFIG_BUTTON_TIMER
 /**
   * @brief Check if it current press is a long press, inject event if so
   * @retval None
@@ -257,12 +603,13 @@ void hw_longpress_check(void)
 {
     if (longpress_event != event_none) {
         if (get_ticks() - longpress_start > LONGPRESS_TIME_MS) {
-            event_put(longpress_event, press_long);
+            event_put_from(event_src_main, longpress_event, press_long);
             longpress_detected = true;
             longpress_event = event_none;
         }
     }
 }
+#endif // CONFIG_BUTTON_TIMER
 
 #ifdef CONFIG_ADC_BENCHMARK
 /**
@@ -285,68 +632,373 @@ bool hw_sel_button_pressed(void)
     return !gpio_get(BUTTON_SEL_PORT, BUTTON_SEL_PIN);
 }
 
+void hw_wait_for_interrupt(void)
+{
+    __asm__ volatile ("wfi");
+}
+
+#ifdef CONFIG_TRIP_SNAPSHOT
 /**
-  * @brief Add some filtering to OCPs
+  * @brief Freeze the sample history, setpoints and time unless already frozen
+  * @param trip what tripped
   * @retval None
+  * @note Called from interrupt context
   */
-static void handle_ocp(uint16_t raw)
+static void trip_snapshot_freeze(trip_t trip)
+{
+    if (trip_snapshot.trip != trip_none) {
+        return;
+    }
+    trip_snapshot.time_us = cur_time_us();
+    trip_snapshot.v_dac = DAC_DHR12R1(DAC1);
+    trip_snapshot.i_dac = DAC_DHR12R2(DAC1);
+    for (uint32_t i = 0; i < TRIP_SNAPSHOT_SAMPLES; i++) {
+        uint32_t pos = (trip_history_pos + i) % TRIP_SNAPSHOT_SAMPLES;
+        trip_snapshot.samples[i][0] = trip_history[pos][0];
+        trip_snapshot.samples[i][1] = trip_history[pos][1];
+        trip_snapshot.samples[i][2] = trip_history[pos][2];
+    }
+    trip_snapshot.trip = trip;
+}
+
+bool hw_get_trip_snapshot(trip_snapshot_t *snapshot)
+{
+    if (trip_snapshot.trip == trip_none) {
+        return false;
+    }
+    /** Frozen until cleared, the ISR does not touch it */
+    memcpy(snapshot, (const void*) &trip_snapshot, sizeof(*snapshot));
+    return true;
+}
+
+void hw_clear_trip_snapshot(void)
+{
+    trip_snapshot.trip = trip_none;
+}
+#endif // CONFIG_TRIP_SNAPSHOT
+
+#ifdef CONFIG_OCP_BENCH
+/**
+  * @brief Disable the output and time a trip armed by hw_ocp_bench()
+  * @retval true if the trip was synthetic, it is then not reported
+  */
+RAMFUNC_ISR static bool ocp_bench_trip(void)
+{
+    if (!ocp_bench_armed) {
+        return false;
+    }
+    pwrctl_enable_vout(false);
+    ocp_bench_cycles = DWT_CYCCNT - ocp_bench_start;
+    ocp_bench_armed = false;
+    return true;
+}
+#endif // CONFIG_OCP_BENCH
+
+/**
+  * @brief Disable the output on an over current
+  * @param raw the sample that tripped OCP
+  * @retval None
+  */
+RAMFUNC_ISR static void ocp_trip(uint16_t raw)
+{
+#ifdef CONFIG_OCP_BENCH
+    if (ocp_bench_trip()) {
+        return;
+    }
+#endif // CONFIG_OCP_BENCH
+    i_out_trig_adc = raw;
+    pwrctl_enable_vout(false);
+#ifdef CONFIG_ADC_RECORDER
+    recorder_trigger(recorder_trigger_ocp);
+#endif // CONFIG_ADC_RECORDER
+#ifdef CONFIG_TRIP_SNAPSHOT
+    trip_pending = trip_ocp; /** Frozen once this sample is in the history */
+#endif // CONFIG_TRIP_SNAPSHOT
+    event_put(event_ocp, 0);
+}
+
+/**
+  * @brief Add some filtering to OCPs, trips after ocp_samples over currents
+  *        in a row
+  * @param raw the over current sample
+  * @param ctrl the current limits
+  * @retval None
+  */
+RAMFUNC_ISR static void handle_ocp(uint16_t raw, const pwrctl_params_t *ctrl)
 {
     static uint32_t ocp_count = 0;
     static uint32_t last_tick_counter = 0;
-    if (last_tick_counter+1 == adc_counter) {
-        ocp_count++;
-        last_tick_counter++;
-        if (ocp_count == OCP_FILTER_COUNT) {
-            i_out_trig_adc = raw;
-            pwrctl_enable_vout(false);
-            event_put(event_ocp, 0);
-        }
-    } else {
+    PROBE_HIGH(PROBE_OCP);
+    if (last_tick_counter+1 != adc_counter) {
         ocp_count = 0;
-        last_tick_counter = adc_counter;
+    }
+    last_tick_counter = adc_counter;
+    if (++ocp_count == ctrl->ocp_samples) {
+        ocp_trip(raw);
+    }
+    PROBE_LOW(PROBE_OCP);
+}
+
+/**
+  * @brief Integrating OCP, called for every sample while ocp_i2t is set
+  * @param raw the I_out sample
+  * @param ctrl the current limits
+  * @retval None
+  * @note The integral grows by raw^2 - limit^2 above the limit and shrinks by
+  *       as much below it, so a short inrush is let through while a sustained
+  *       over current trips in a time that falls with the square of the
+  *       current. ocp_i2t samples at twice the limit trip it.
+  */
+RAMFUNC_ISR static void handle_ocp_i2t(uint16_t raw, const pwrctl_params_t *ctrl)
+{
+    static uint64_t heat = 0;
+    uint64_t limit_sq = (uint64_t) ctrl->i_limit_raw * ctrl->i_limit_raw;
+    uint64_t raw_sq = (uint32_t) raw * raw;
+    if (raw_sq > limit_sq) {
+        heat += raw_sq - limit_sq;
+    } else {
+        uint64_t cooling = limit_sq - raw_sq;
+        heat = heat > cooling ? heat - cooling : 0;
+    }
+    if (!pwrctl_vout_enabled()) {
+        return;
+    }
+    if (heat >= 3 * limit_sq * ctrl->ocp_i2t) {
+        heat = 0;
+        ocp_trip(raw);
     }
 }
 
 /**
-  * @brief Add some filtering to OVPs
+  * @brief Add some filtering to OVPs, trips after ovp_samples over voltages
+  *        in a row
+  * @param raw the over voltage sample
+  * @param ctrl the voltage limits
   * @retval None
   */
-static void handle_ovp(uint16_t raw)
+RAMFUNC_ISR static void handle_ovp(uint16_t raw, const pwrctl_params_t *ctrl)
 {
     static uint32_t ovp_count = 0;
     static uint32_t last_tick_counter = 0;
-    if (last_tick_counter+1 == adc_counter) {
-        ovp_count++;
-        last_tick_counter++;
-        if (ovp_count == OVP_FILTER_COUNT) {
-            v_out_trig_adc = raw;
-            pwrctl_enable_vout(false);
-            event_put(event_ovp, 0);
-        }
-    } else {
+    if (last_tick_counter+1 != adc_counter) {
         ovp_count = 0;
-        last_tick_counter = adc_counter;
+    }
+    last_tick_counter = adc_counter;
+    if (++ovp_count == ctrl->ovp_samples) {
+        v_out_trig_adc = raw;
+        pwrctl_enable_vout(false);
+#ifdef CONFIG_ADC_RECORDER
+        recorder_trigger(recorder_trigger_ovp);
+#endif // CONFIG_ADC_RECORDER
+#ifdef CONFIG_TRIP_SNAPSHOT
+        trip_pending = trip_ovp;
+#endif // CONFIG_TRIP_SNAPSHOT
+        event_put(event_ovp, 0);
     }
 }
 
+#ifdef CONFIG_POWER_FAIL
 /**
-  * @brief ADC1 ISR
+  * @brief Detect a V_in sag, cutting the backlight and telling the main loop
+  *        to write the queued settings while the input capacitors hold up
+  * @param v_in the V_in sample
   * @retval None
-  * @note ADC conversions are performed at a speed of ~21kHz
   */
-void adc1_2_isr(void)
+RAMFUNC_ISR static void handle_power_fail(uint16_t v_in)
 {
-#ifdef CONFIG_ADC_BENCHMARK
-    if (adc_counter == 0) {
-        adc_tick_start = get_ticks();
+    static uint32_t count;
+    uint32_t v_in_q8 = (uint32_t) v_in << 8;
+    if (!v_in_avg) {
+        v_in_avg = v_in_q8;
     }
-#endif // CONFIG_ADC_BENCHMARK
+    bool sagging = v_in_q8 * 100 < v_in_avg * (100 - POWER_FAIL_SAG_PERCENT);
+    if (sagging == power_failing) {
+        count = 0;
+        if (!power_failing) {
+            /** Held while failing so the average does not follow V_in down */
+            v_in_avg = v_in_avg + ((int32_t) (v_in_q8 - v_in_avg) >> POWER_FAIL_AVG_SHIFT);
+        }
+    } else if (++count == (power_failing ? POWER_FAIL_RECOVER_SAMPLES : POWER_FAIL_SAMPLES)) {
+        count = 0;
+        power_failing = sagging;
+        if (sagging) {
+            TIM4_CCR2 = 0; /** The backlight is the largest load we can shed */
+        }
+        event_put(event_power_fail, sagging);
+    }
+}
 
-    // Clear Injected End Of Conversion (JEOC)
-    ADC_SR(ADC1) &= ~ADC_SR_JEOC;
-    // If pwrctl_i_limit_raw == 0, the setting hasn't been read from past yet
+bool hw_power_failing(void)
+{
+    return power_failing;
+}
+#endif // CONFIG_POWER_FAIL
+
+#ifdef CONFIG_I_AUTO_ZERO
+/**
+  * @brief Track the drift of the I_out offset while power out is disabled
+  *        and nothing flows, after the boot time measurement
+  * @param raw the I_out sample without the offset
+  * @retval None
+  * @note adc_i_offset is only written here and read in this ISR, the main
+  *       loop reads it with a single load
+  */
+RAMFUNC_ISR static void i_auto_zero(uint16_t raw)
+{
+    if (pwrctl_vout_enabled()) {
+        i_zero_settle = 0;
+        return;
+    }
+    if (i_zero_settle < I_AUTO_ZERO_SETTLE) {
+        if (++i_zero_settle == I_AUTO_ZERO_SETTLE) {
+            /** Start from the offset in use */
+            i_zero_avg = (ADC_CHA_IOUT_GOLDEN_VALUE - adc_i_offset) << 16;
+        }
+        return;
+    }
+    i_zero_avg += (((int32_t) raw << 16) - i_zero_avg) >> I_AUTO_ZERO_SHIFT;
+    int32_t offset = ADC_CHA_IOUT_GOLDEN_VALUE - ((i_zero_avg + 0x8000) >> 16);
+    if (offset > adc_i_offset_boot + I_AUTO_ZERO_MAX_DRIFT) {
+        offset = adc_i_offset_boot + I_AUTO_ZERO_MAX_DRIFT;
+    } else if (offset < adc_i_offset_boot - I_AUTO_ZERO_MAX_DRIFT) {
+        offset = adc_i_offset_boot - I_AUTO_ZERO_MAX_DRIFT;
+    }
+    adc_i_offset = offset;
+}
+#endif // CONFIG_I_AUTO_ZERO
+
+#ifdef CONFIG_VOUT_LOOP
+/**
+  * @brief The V_out control loop hook
+  * @param i_raw raw I_out, offset corrected
+  * @param v_in_raw raw V_in, unused
+  * @param v_out_raw raw V_out
+  * @retval None
+  */
+RAMFUNC_HOOK static void vout_loop_hook(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw)
+{
+    (void) v_in_raw;
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+    if (dac_wave_running) {
+        return;
+    }
+#endif // CONFIG_FUNCGEN_DAC_DMA
+    pwrctl_vout_loop(i_raw, v_out_raw);
+}
+#endif // CONFIG_VOUT_LOOP
+
+#ifdef CONFIG_ENERGY_METER
+/**
+  * @brief The energy meter hook, accumulates while the output is on
+  * @param i_raw raw I_out, offset corrected
+  * @param v_in_raw raw V_in, unused
+  * @param v_out_raw raw V_out
+  * @retval None
+  */
+RAMFUNC_HOOK static void energy_hook(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw)
+{
+    (void) v_in_raw;
+    if (pwrctl_vout_enabled()) {
+        energy_sample(i_raw, v_out_raw);
+    }
+}
+#endif // CONFIG_ENERGY_METER
+
+#ifdef CONFIG_WINDOW_STATS
+/**
+  * @brief The window statistics hook
+  * @param i_raw raw I_out, offset corrected
+  * @param v_in_raw raw V_in, unused
+  * @param v_out_raw raw V_out
+  * @retval None
+  */
+RAMFUNC_HOOK static void winstats_hook(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw)
+{
+    (void) v_in_raw;
+    winstats_sample(i_raw, v_out_raw);
+}
+#endif // CONFIG_WINDOW_STATS
+
+#ifdef CONFIG_ADC_RECORDER
+/**
+  * @brief The ADC recorder hook
+  * @param i_raw raw I_out, offset corrected
+  * @param v_in_raw raw V_in
+  * @param v_out_raw raw V_out
+  * @retval None
+  */
+RAMFUNC_HOOK static void recorder_hook(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw)
+{
+    recorder_sample(i_raw, v_in_raw, v_out_raw);
+}
+#endif // CONFIG_ADC_RECORDER
+
+#ifdef CONFIG_LOCKIN
+/**
+  * @brief The lock-in hook, runs after the function generator moved its phase
+  * @param i_raw raw I_out, offset corrected
+  * @param v_in_raw raw V_in, unused
+  * @param v_out_raw raw V_out
+  * @retval None
+  */
+RAMFUNC_HOOK static void lockin_hook(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw)
+{
+    (void) v_in_raw;
+    lockin_sample(func_gen_phase(), i_raw, v_out_raw);
+}
+#endif // CONFIG_LOCKIN
+
+/**
+  * @brief Enable the cycle counter the hooks are timed with and set the
+  *        hooks that run whatever the screen
+  * @retval None
+  * @note The screens set the limit and function generator hooks themselves
+  */
+static void hooks_init(void)
+{
+    SCB_DEMCR |= SCB_DEMCR_TRCENA;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+#ifdef CONFIG_VOUT_LOOP
+    isrhook_set(isrhook_vout_loop, &vout_loop_hook, ISRHOOK_BUDGET_VOUT_LOOP);
+#endif // CONFIG_VOUT_LOOP
+#ifdef CONFIG_ENERGY_METER
+    isrhook_set(isrhook_energy, &energy_hook, ISRHOOK_BUDGET_ENERGY);
+#endif // CONFIG_ENERGY_METER
+#ifdef CONFIG_WINDOW_STATS
+    isrhook_set(isrhook_winstats, &winstats_hook, ISRHOOK_BUDGET_WINSTATS);
+#endif // CONFIG_WINDOW_STATS
+#ifdef CONFIG_ADC_RECORDER
+    isrhook_set(isrhook_recorder, &recorder_hook, ISRHOOK_BUDGET_RECORDER);
+#endif // CONFIG_ADC_RECORDER
+#ifdef CONFIG_LOCKIN
+    isrhook_set(isrhook_lockin, &lockin_hook, ISRHOOK_BUDGET_LOCKIN);
+#endif // CONFIG_LOCKIN
+}
+
+/**
+  * @brief The DWT cycle counter, enabled by hooks_init()
+  * @retval CPU cycles
+  */
+RAMFUNC_HOOK uint32_t isrhook_clock(void)
+{
+    return DWT_CYCCNT;
+}
+
+/**
+  * @brief Process one set of ADC samples
+  * @param i raw I_out sample
+  * @param v_in raw V_in sample
+  * @param v_out raw V_out sample
+  * @retval None
+  * @note Called from interrupt context for each sample set
+  */
+static inline void adc_process_sample(uint32_t i, uint16_t v_in, uint16_t v_out)
+{
+    PERF_BEGIN(perf_adc_isr);
+    /** One coherent set of limits for this sample set */
+    const pwrctl_params_t *ctrl = pwrctl_params();
+    // If i_limit_raw == 0, the setting hasn't been read from past yet
     adc_counter++;
-    uint32_t i = adc_read_injected(ADC1, adc_cha_i_out + 1); // Yes, this is correct
 
     /** @todo Make sure power out is not enabled during this measurement */
     if (measure_i_out) {
@@ -355,32 +1007,230 @@ void adc1_2_isr(void)
         } else {
             adc_i_offset = ADC_CHA_IOUT_GOLDEN_VALUE - (i_offset_calc / ADC_I_OFFSET_COUNT);
             measure_i_out = false;
+#ifdef CONFIG_I_AUTO_ZERO
+            adc_i_offset_boot = adc_i_offset;
+#endif // CONFIG_I_AUTO_ZERO
+#ifdef CONFIG_ADC_AWD
+            hw_update_ocp_watchdog(); /** Threshold depends on the offset */
+#endif // CONFIG_ADC_AWD
         }
     }
-    if (pwrctl_i_limit_raw) {
+#ifdef CONFIG_I_AUTO_ZERO
+    else {
+        i_auto_zero(i);
+    }
+#endif // CONFIG_I_AUTO_ZERO
+    if (ctrl->i_limit_raw) {
         if (adc_counter >= STARTUP_SKIP_COUNT) {
             i += adc_i_offset;
-            if (i > pwrctl_i_limit_raw && pwrctl_vout_enabled()) { /** OCP! */
-                handle_ocp(i);
+#ifndef CONFIG_ADC_AWD
+            if (ctrl->ocp_i2t) {
+                handle_ocp_i2t(i, ctrl);
+            } else if (i > ctrl->i_limit_raw && pwrctl_vout_enabled()) { /** OCP! */
+                handle_ocp(i, ctrl);
             }
+#endif // CONFIG_ADC_AWD
             i_out_adc = i;
         }
     }
 
-    v_in_adc = adc_read_injected(ADC1, adc_cha_v_in + 1); // Yes, this is correct
-    v_out_adc = adc_read_injected(ADC1, adc_cha_v_out + 1); // Yes, this is correct
+    v_in_adc = v_in;
+    v_out_adc = v_out;
+#ifdef CONFIG_POWER_FAIL
+    if (adc_counter >= STARTUP_SKIP_COUNT) {
+        handle_power_fail(v_in);
+    }
+#endif // CONFIG_POWER_FAIL
+    if (adc_stats_left) {
+        uint32_t i_adc = i_out_adc;
+        adc_stats.sum[0] += i_adc;
+        adc_stats.sum[1] += v_in;
+        adc_stats.sum[2] += v_out;
+        adc_stats.sum_sq[0] += i_adc * i_adc;
+        adc_stats.sum_sq[1] += (uint32_t) v_in * v_in;
+        adc_stats.sum_sq[2] += (uint32_t) v_out * v_out;
+        adc_stats_left--;
+    }
+#ifdef CONFIG_ADC_OVERSAMPLE
+    i_out_acc += i_out_adc;
+    v_in_acc += v_in;
+    v_out_acc += v_out;
+    if (++oversample_count == OVERSAMPLE_RATIO) {
+        i_out_dec = i_out_acc << OVERSAMPLE_SCALE;
+        v_in_dec = v_in_acc << OVERSAMPLE_SCALE;
+        v_out_dec = v_out_acc << OVERSAMPLE_SCALE;
+        i_out_acc = v_in_acc = v_out_acc = 0;
+        oversample_count = 0;
+    }
+#endif // CONFIG_ADC_OVERSAMPLE
 
     /** Check to see if an over voltage limit has been triggered */
-    if (pwrctl_v_limit_raw) {
-        if (v_out_adc > pwrctl_v_limit_raw && pwrctl_vout_enabled()) { /** OVP! */
-            handle_ovp(v_out_adc);
+    if (ctrl->v_limit_raw) {
+        if (v_out_adc > ctrl->v_limit_raw && pwrctl_vout_enabled()) { /** OVP! */
+            handle_ovp(v_out_adc, ctrl);
         }
     }
 
-#ifdef CONFIG_FUNCGEN_ENABLE
-    (*funcgen_tick)();
-#endif
+#ifdef CONFIG_TRIP_SNAPSHOT
+    trip_history[trip_history_pos][0] = i;
+    trip_history[trip_history_pos][1] = v_in;
+    trip_history[trip_history_pos][2] = v_out;
+    if (++trip_history_pos == TRIP_SNAPSHOT_SAMPLES) {
+        trip_history_pos = 0;
+    }
+    if (trip_pending != trip_none) {
+        trip_snapshot_freeze(trip_pending);
+        trip_pending = trip_none;
+    }
+#endif // CONFIG_TRIP_SNAPSHOT
+
+    isrhook_run(i_out_adc, v_in, v_out);
+    PERF_END(perf_adc_isr);
+}
+
+#ifdef CONFIG_ADC_AWD
+/**
+  * @brief Arm the analog watchdog on the I_out channel with the current limit
+  * @retval None
+  * @note The watchdog is disarmed (threshold set to max) while power out is
+  *       disabled, no limit has been set or the offset is still being measured
+  */
+void hw_update_ocp_watchdog(void)
+{
+    int32_t threshold = ADC_AWD_DISARMED;
+    uint32_t i_limit_raw = pwrctl_params()->i_limit_raw;
+    if (i_limit_raw && pwrctl_vout_enabled() && !measure_i_out) {
+        /** The ISR adds adc_i_offset to the sample, the watchdog sees the sample as is */
+        threshold = (int32_t) i_limit_raw - adc_i_offset;
+        if (threshold < 0) {
+            threshold = 0;
+        } else if (threshold > ADC_AWD_DISARMED) {
+            threshold = ADC_AWD_DISARMED;
+        }
+    }
+    adc_set_watchdog_high_threshold(ADC1, threshold);
+}
+
+/**
+  * @brief Handle an analog watchdog trip, ie. an OCP detected by the ADC
+  * @retval None
+  */
+RAMFUNC_ISR static void handle_awd(void)
+{
+    ADC_SR(ADC1) &= ~ADC_SR_AWD;
+#ifdef CONFIG_OCP_BENCH
+    if (ocp_bench_trip()) {
+        return;
+    }
+#endif // CONFIG_OCP_BENCH
+    if (pwrctl_vout_enabled()) {
+        /** The watchdog only tells us the limit was passed, not by how much */
+        i_out_trig_adc = pwrctl_params()->i_limit_raw;
+        pwrctl_enable_vout(false);
+#ifdef CONFIG_ADC_RECORDER
+        recorder_trigger(recorder_trigger_ocp);
+#endif // CONFIG_ADC_RECORDER
+#ifdef CONFIG_TRIP_SNAPSHOT
+        trip_snapshot_freeze(trip_ocp);
+#endif // CONFIG_TRIP_SNAPSHOT
+        event_put(event_ocp, 0);
+    }
+}
+#endif // CONFIG_ADC_AWD
+
+#ifdef CONFIG_ADC_DMA
+#ifdef CONFIG_ADC_AWD
+/**
+  * @brief ADC1 ISR, only used for the analog watchdog in DMA mode
+  * @retval None
+  */
+RAMFUNC_ISR void adc1_2_isr(void)
+{
+    PROBE_HIGH(PROBE_ADC);
+    if (ADC_SR(ADC1) & ADC_SR_AWD) {
+        handle_awd();
+    }
+    PROBE_LOW(PROBE_ADC);
+}
+#endif // CONFIG_ADC_AWD
+
+/**
+  * @brief ADC1 DMA ISR, fires when either half of adc_dma_buffer is filled
+  * @retval None
+  * @note Each half holds ADC_DMA_SEQUENCES scan sequences sampled at ~21kHz
+  */
+RAMFUNC_ISR void dma1_channel1_isr(void)
+{
+    uint32_t offset;
+    PROBE_HIGH(PROBE_ADC);
+    LOAD_ISR_BEGIN();
+#ifdef CONFIG_ADC_BENCHMARK
+    if (adc_counter == 0) {
+        adc_tick_start = get_ticks();
+    }
+#endif // CONFIG_ADC_BENCHMARK
+
+#ifdef CONFIG_LOAD_METER
+    if ((DMA1_ISR & (DMA_ISR_HTIF1 | DMA_ISR_TCIF1)) == (DMA_ISR_HTIF1 | DMA_ISR_TCIF1)) {
+        /** Both halves are ready, one of them has been overwritten */
+        load_isr_overrun();
+    }
+#endif // CONFIG_LOAD_METER
+    if (DMA1_ISR & DMA_ISR_HTIF1) {
+        DMA1_IFCR |= DMA_IFCR_CHTIF1;
+        offset = 0;
+    } else {
+        DMA1_IFCR |= DMA_IFCR_CTCIF1;
+        offset = ADC_DMA_SEQUENCES * adc_cha_max;
+    }
+    for (uint32_t seq = 0; seq < ADC_DMA_SEQUENCES; seq++) {
+        volatile uint16_t *sample = &adc_dma_buffer[offset + seq * adc_cha_max];
+        adc_process_sample(sample[adc_cha_i_out], sample[adc_cha_v_in], sample[adc_cha_v_out]);
+    }
+    LOAD_ISR_END();
+    PROBE_LOW(PROBE_ADC);
 }
+#else // CONFIG_ADC_DMA
+/**
+  * @brief ADC1 ISR
+  * @retval None
+  * @note ADC conversions are performed at a speed of ~21kHz
+  */
+RAMFUNC_ISR void adc1_2_isr(void)
+{
+    PROBE_HIGH(PROBE_ADC);
+    LOAD_ISR_BEGIN();
+#ifdef CONFIG_ADC_BENCHMARK
+    if (adc_counter == 0) {
+        adc_tick_start = get_ticks();
+    }
+#endif // CONFIG_ADC_BENCHMARK
+
+#ifdef CONFIG_ADC_AWD
+    if (ADC_SR(ADC1) & ADC_SR_AWD) {
+        handle_awd();
+    }
+    if (!(ADC_SR(ADC1) & ADC_SR_JEOC)) {
+        PROBE_LOW(PROBE_ADC);
+        return;
+    }
+#endif // CONFIG_ADC_AWD
+
+    // Clear Injected End Of Conversion (JEOC)
+    ADC_SR(ADC1) &= ~ADC_SR_JEOC;
+    adc_process_sample(adc_read_injected(ADC1, adc_cha_i_out + 1), // Yes, this is correct
+                       adc_read_injected(ADC1, adc_cha_v_in + 1),
+                       adc_read_injected(ADC1, adc_cha_v_out + 1));
+#ifdef CONFIG_LOAD_METER
+    if (ADC_SR(ADC1) & ADC_SR_JEOC) {
+        /** The next conversion completed before we were done with this one */
+        load_isr_overrun();
+    }
+#endif // CONFIG_LOAD_METER
+    LOAD_ISR_END();
+    PROBE_LOW(PROBE_ADC);
+}
+#endif // CONFIG_ADC_DMA
 
 /**
   * @brief Handle USART1 interrupts
@@ -388,25 +1238,136 @@ void adc1_2_isr(void)
   */
 void usart1_isr(void)
 {
+    /** The error flags are cleared by the data register read that follows */
+    uint32_t sr = USART_SR(USART1);
+    if ((USART_CR1(USART1) & USART_CR1_RXNEIE) != 0 && (sr & USART_SR_RXNE) != 0) {
+        if (sr & USART_SR_ORE) {
+            usart_errors.overrun++;
+        }
+        if (sr & (USART_SR_FE | USART_SR_NE)) {
+            usart_errors.noise++;
+        }
+    }
+#ifdef CONFIG_USART_RX_RING
+    if (((USART_CR1(USART1) & USART_CR1_RXNEIE) != 0) &&
+        ((sr & USART_SR_RXNE) != 0)) {
+        if (!ringbuf_put8(&rx_ring, usart_recv(USART1))) {
+            usart_errors.dropped++;
+        }
+        /** Do not wait for the idle line if a long burst is filling the ring */
+        if (ringbuf_free(&rx_ring) == USART_RX_RING_SIZE / 2) {
+            event_put(event_uart_rx_block, 0);
+        }
+    } else if (((USART_CR1(USART1) & USART_CR1_IDLEIE) != 0) &&
+               ((sr & USART_SR_IDLE) != 0)) {
+        /** IDLE is cleared by reading SR followed by DR */
+        (void) USART_DR(USART1);
+        event_put(event_uart_rx_block, 0);
+    }
+#else // CONFIG_USART_RX_RING
     if (((USART_CR1(USART1) & USART_CR1_RXNEIE) != 0) &&
-        ((USART_SR(USART1) & USART_SR_RXNE) != 0)) {
+        ((sr & USART_SR_RXNE) != 0)) {
         uint8_t ch = usart_recv(USART1);
         event_put(event_uart_rx, ch);
     }
+#endif // CONFIG_USART_RX_RING
 
-#ifdef TX_IRQ
+#ifdef CONFIG_USART_TX_IRQ
     if (((USART_CR1(USART1) & USART_CR1_TXEIE) != 0) &&
         ((USART_SR(USART1) & USART_SR_TXE) != 0)) {
-        int32_t data;
-        data = ringbuf_read_ch(&output_ring, NULL);
-        if (data == -1) {
-            USART_CR1(USART1) &= ~USART_CR1_TXEIE;
-        } else {
+        uint8_t data;
+        if (ringbuf_get8(&tx_ring, &data)) {
             usart_send(USART1, data);
+        } else {
+            USART_CR1(USART1) &= ~USART_CR1_TXEIE;
         }
     }
-#endif // TX_IRQ
+#endif // CONFIG_USART_TX_IRQ
+}
+
+/**
+  * @brief Change USART1 baud rate once the transmitter is idle
+  * @param baudrate the new baud rate
+  * @retval None
+  */
+void hw_usart_set_baudrate(uint32_t baudrate)
+{
+#ifdef CONFIG_USART_TX_IRQ
+    hw_usart_flush();
+#else // CONFIG_USART_TX_IRQ
+    while ((USART_SR(USART1) & USART_SR_TC) == 0) ;
+#endif // CONFIG_USART_TX_IRQ
+    usart_disable(USART1);
+    usart_set_baudrate(USART1, baudrate);
+    usart_enable(USART1);
+}
+
+/**
+  * @brief Get the receive error counters of USART1
+  * @param errors filled in with the counters
+  * @param reset clear the counters after reading them
+  * @retval None
+  */
+void hw_usart_get_errors(hw_usart_errors_t *errors, bool reset)
+{
+    cm_disable_interrupts();
+    *errors = usart_errors;
+    if (reset) {
+        usart_errors = (hw_usart_errors_t) { 0 };
+    }
+    cm_enable_interrupts();
+}
+
+#ifdef CONFIG_USART_RX_RING
+/**
+  * @brief Copy received data out of the RX ring
+  * @param data buffer to copy to
+  * @param size size of buffer
+  * @retval number of bytes copied, 0 when all received data has been read
+  */
+uint32_t hw_usart_rx_read(uint8_t *data, uint32_t size)
+{
+    return ringbuf_get_n(&rx_ring, data, size);
 }
+#endif // CONFIG_USART_RX_RING
+
+#ifdef CONFIG_USART_TX_IRQ
+/**
+  * @brief Get free space in the USART1 TX ring
+  * @retval number of bytes that can be queued
+  */
+uint32_t hw_usart_tx_free(void)
+{
+    return ringbuf_free(&tx_ring);
+}
+
+/**
+  * @brief Queue data for transmission on USART1
+  * @param data data to send
+  * @param length number of bytes
+  * @retval false if there was no room for all of the data, nothing queued
+  */
+bool hw_usart_send(const uint8_t *data, uint32_t length)
+{
+    if (ringbuf_free(&tx_ring) < length) {
+        return false;
+    }
+    (void) ringbuf_put_n(&tx_ring, data, length);
+    /** The ISR is the only consumer and disables TXEIE when the ring runs dry */
+    USART_CR1(USART1) |= USART_CR1_TXEIE;
+    return true;
+}
+
+/**
+  * @brief Wait for all queued data to be transmitted
+  * @retval None
+  */
+void hw_usart_flush(void)
+{
+    while (ringbuf_free(&tx_ring) < USART_TX_RING_SIZE) ;
+    while ((USART_SR(USART1) & USART_SR_TC) == 0) ;
+}
+#endif // CONFIG_USART_TX_IRQ
 /**
   * @brief Enable clocks
   * @retval None
@@ -427,28 +1388,98 @@ static void clock_init(void)
   */
 static void adc1_init(void)
 {
-    int i;
+#ifdef CONFIG_ADC_DMA
+    /** DMA1 channel 1 moves each scan sequence from ADC_DR into adc_dma_buffer.
+      * Circular mode with half and full transfer interrupts gives us a double
+      * buffer without having to restart the DMA. */
+    rcc_periph_clock_enable(RCC_DMA1);
+    dma_channel_reset(DMA1, DMA_CHANNEL1);
+    dma_set_peripheral_address(DMA1, DMA_CHANNEL1, (uint32_t) &ADC_DR(ADC1));
+    dma_set_memory_address(DMA1, DMA_CHANNEL1, (uint32_t) adc_dma_buffer);
+    dma_set_number_of_data(DMA1, DMA_CHANNEL1, sizeof(adc_dma_buffer) / sizeof(adc_dma_buffer[0]));
+    dma_set_read_from_peripheral(DMA1, DMA_CHANNEL1);
+    dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL1);
+    dma_set_peripheral_size(DMA1, DMA_CHANNEL1, DMA_CCR_PSIZE_16BIT);
+    dma_set_memory_size(DMA1, DMA_CHANNEL1, DMA_CCR_MSIZE_16BIT);
+    dma_set_priority(DMA1, DMA_CHANNEL1, DMA_CCR_PL_VERY_HIGH);
+    dma_enable_circular_mode(DMA1, DMA_CHANNEL1);
+    dma_enable_half_transfer_interrupt(DMA1, DMA_CHANNEL1);
+    dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL1);
+    nvic_set_priority(NVIC_DMA1_CHANNEL1_IRQ, 0);
+    nvic_enable_irq(NVIC_DMA1_CHANNEL1_IRQ);
+    dma_enable_channel(DMA1, DMA_CHANNEL1);
+#endif // CONFIG_ADC_DMA
+#if !defined(CONFIG_ADC_DMA) || defined(CONFIG_ADC_AWD)
     nvic_set_priority(NVIC_ADC1_2_IRQ, 0);
     nvic_enable_irq(NVIC_ADC1_2_IRQ);
+#endif
     rcc_periph_clock_enable(RCC_ADC1);
     adc_power_off(ADC1); // Make sure the ADC doesn't run during config.
 
-    /** @todo Use scan mode which does all channels in one sweep and generates the interrupt/EOC/JEOC flags set at the end of all channels, not each one. */
     adc_enable_scan_mode(ADC1);
     adc_set_single_conversion_mode(ADC1);
+#ifdef CONFIG_ADC_DMA
+    // TIM2 TRGO is not available for regular conversions, use TIM2 CC2 instead
+    adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_TIM2_CC2);
+    adc_enable_dma(ADC1);
+#else // CONFIG_ADC_DMA
+    /** @todo Use scan mode which does all channels in one sweep and generates the interrupt/EOC/JEOC flags set at the end of all channels, not each one. */
     // Use TIM2 TRGO as injected conversion trigger
     adc_enable_external_trigger_injected(ADC1,ADC_CR2_JEXTSEL_TIM2_TRGO);
     // Generate the ADC1_2_IRQ
     adc_enable_eoc_interrupt_injected(ADC1);
+#endif // CONFIG_ADC_DMA
+#ifdef CONFIG_ADC_AWD
+    /** Let the analog watchdog guard I_out, OVP is still checked in software
+      * as there is only one watchdog and one set of thresholds */
+    adc_set_watchdog_high_threshold(ADC1, ADC_AWD_DISARMED);
+    adc_set_watchdog_low_threshold(ADC1, 0);
+    adc_enable_analog_watchdog_on_selected_channel(ADC1, ADC_CHA_IOUT);
+#ifdef CONFIG_ADC_DMA
+    adc_enable_analog_watchdog_regular(ADC1);
+#else // CONFIG_ADC_DMA
+    adc_enable_analog_watchdog_injected(ADC1);
+#endif // CONFIG_ADC_DMA
+    adc_enable_awd_interrupt(ADC1);
+#endif // CONFIG_ADC_AWD
     adc_set_right_aligned(ADC1);
-    //adc_enable_temperature_sensor(); /** @todo Use internal temperature sensor for monitoring */
-    adc_set_sample_time_on_all_channels(ADC1, ADC_SMPR_SMP_28DOT5CYC);
+    adc_set_sample_time_on_all_channels(ADC1, ADC_SAMPLE_TIME);
+#ifdef CONFIG_ADC_DMA
+    adc_set_regular_sequence(ADC1, adc_cha_max, (uint8_t*) channels);
+#else // CONFIG_ADC_DMA
     adc_set_injected_sequence(ADC1, adc_cha_max, (uint8_t*) channels);
+#endif // CONFIG_ADC_DMA
+#ifdef CONFIG_CHIP_TEMP
+    {
+        /** The sensor needs 17us sampling, converted on the other group when
+          * hw_chip_temp() asks for it. A triggered scan interrupts it and it
+          * finishes in the gap before the next one */
+        uint8_t temp_channel = ADC_CHANNEL_TEMP;
+        adc_enable_temperature_sensor();
+        adc_set_sample_time(ADC1, ADC_CHANNEL_TEMP, ADC_SMPR_SMP_239DOT5CYC);
+#ifdef CONFIG_ADC_DMA
+        adc_enable_external_trigger_injected(ADC1, ADC_CR2_JEXTSEL_JSWSTART);
+        adc_set_injected_sequence(ADC1, 1, &temp_channel);
+#else // CONFIG_ADC_DMA
+        adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_SWSTART);
+        adc_set_regular_sequence(ADC1, 1, &temp_channel);
+#endif // CONFIG_ADC_DMA
+    }
+#endif // CONFIG_CHIP_TEMP
     adc_power_on(ADC1);
 
+    adc_power_on_ticks = get_ticks();
+}
+
+/**
+  * @brief Calibrate ADC1 once it has stabilized and start the trigger
+  * @retval None
+  */
+void hw_adc_start(void)
+{
     // Wait for ADC starting up.
-    for (i = 0; i < 800000; i++) {
-        __asm__("nop");
+    while (get_ticks() - adc_power_on_ticks < ADC_STARTUP_MS) {
+        hw_wait_for_interrupt();
     }
 
     adc_reset_calibration(ADC1);
@@ -457,6 +1488,100 @@ static void adc1_init(void)
     tim2_init(); // Start TIM2 trigger now that the ADC is online
 }
 
+#ifdef CONFIG_ADC_PROFILES
+/**
+  * @brief Select an acquisition profile
+  * @param profile the profile
+  * @retval false if there is no such profile
+  */
+bool hw_adc_set_profile(adc_profile_t profile)
+{
+    if (profile >= adc_profile_count) {
+        return false;
+    }
+    const adc_profile_params_t *p = &adc_profiles[profile];
+    /** No scan is triggered while the settings are half changed */
+    if (tim2_running) {
+        timer_disable_counter(TIM2);
+    }
+    for (uint32_t i = 0; i < adc_cha_max; i++) {
+        adc_set_sample_time(ADC1, channels[i], p->sample_time);
+    }
+#ifdef CONFIG_ADC_OVERSAMPLE
+    {
+        uint32_t shift = ADC_OVERSAMPLE_SHIFT > p->oversample_less ? ADC_OVERSAMPLE_SHIFT - p->oversample_less : 0;
+        bool masked = cm_mask_interrupts(true);
+        i_out_acc = v_in_acc = v_out_acc = 0;
+        oversample_count = 0;
+        oversample_ratio = 1 << shift;
+        oversample_scale = ADC_OVERSAMPLE_SHIFT - shift;
+        (void) cm_mask_interrupts(masked);
+    }
+#endif // CONFIG_ADC_OVERSAMPLE
+    adc_profile = profile;
+    if (tim2_running) {
+        timer_set_period(TIM2, p->period);
+#ifdef CONFIG_ADC_DMA
+        timer_set_oc_value(TIM2, TIM_OC2, (p->period + 1) / 2);
+#endif // CONFIG_ADC_DMA
+        timer_set_counter(TIM2, 0);
+        timer_enable_counter(TIM2);
+    }
+    return true;
+}
+
+/**
+  * @brief Get the acquisition profile
+  * @param rate_hz receives the sample set rate, may be NULL
+  * @param decimation receives the sample sets per decimated measurement, may be NULL
+  * @retval the profile
+  */
+adc_profile_t hw_adc_get_profile(uint32_t *rate_hz, uint32_t *decimation)
+{
+    if (rate_hz) {
+        *rate_hz = TIM2_CLOCK_HZ / (adc_profiles[adc_profile].period + 1);
+    }
+    if (decimation) {
+#ifdef CONFIG_ADC_OVERSAMPLE
+        *decimation = oversample_ratio;
+#else // CONFIG_ADC_OVERSAMPLE
+        *decimation = 1;
+#endif // CONFIG_ADC_OVERSAMPLE
+    }
+    return adc_profile;
+}
+#endif // CONFIG_ADC_PROFILES
+
+#ifdef CONFIG_CHIP_TEMP
+bool hw_chip_temp(int16_t *temp)
+{
+    static bool started;
+    uint16_t raw;
+#ifdef CONFIG_ADC_DMA
+    if (!started || !adc_eoc_injected(ADC1)) {
+        started = true;
+        adc_start_conversion_injected(ADC1);
+        return false;
+    }
+    raw = adc_read_injected(ADC1, 1);
+    ADC_SR(ADC1) &= ~ADC_SR_JEOC;
+    adc_start_conversion_injected(ADC1);
+#else // CONFIG_ADC_DMA
+    if (!started || !adc_eoc(ADC1)) {
+        started = true;
+        adc_start_conversion_regular(ADC1);
+        return false;
+    }
+    raw = adc_read_regular(ADC1); /** Clears EOC */
+    adc_start_conversion_regular(ADC1);
+#endif // CONFIG_ADC_DMA
+    /** 3.3V full scale, 12 bits */
+    int32_t uv = (int32_t) raw * 3300000 / 4096;
+    *temp = 250 + (CHIP_TEMP_V25_MV * 1000 - uv) * 10 / CHIP_TEMP_SLOPE_UV;
+    return true;
+}
+#endif // CONFIG_CHIP_TEMP
+
 /**
   * @brief Initialize USART1
   * @retval None
@@ -464,7 +1589,12 @@ static void adc1_init(void)
 static void usart_init(void)
 {
     rcc_periph_clock_enable(RCC_USART1);
+#ifdef CONFIG_BUS_ADDRESS
+    /** Idle units on a shared line must not drive it */
+    gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_ALTFN_OPENDRAIN, GPIO_USART1_TX);
+#else // CONFIG_BUS_ADDRESS
     gpio_set_mode(GPIOA, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO_USART1_TX);
+#endif // CONFIG_BUS_ADDRESS
     gpio_set_mode(GPIOA, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT, GPIO_USART1_RX);
 
     nvic_enable_irq(NVIC_USART1_IRQ);
@@ -477,6 +1607,15 @@ static void usart_init(void)
 
     // Enable USART1 Receive interrupt.
     USART_CR1(USART1) |= USART_CR1_RXNEIE;
+#ifdef CONFIG_USART_RX_RING
+    /** The main loop is notified on idle line, i.e. after each frame */
+    ringbuf_init8(&rx_ring, rx_buffer, sizeof(rx_buffer));
+    USART_CR1(USART1) |= USART_CR1_IDLEIE;
+#endif // CONFIG_USART_RX_RING
+#ifdef CONFIG_USART_TX_IRQ
+    /** TXEIE is enabled by hw_usart_send when there is data to send */
+    ringbuf_init8(&tx_ring, tx_buffer, sizeof(tx_buffer));
+#endif // CONFIG_USART_TX_IRQ
 
     usart_enable(USART1);
 }
@@ -703,6 +1842,17 @@ static void gpio_init(void)
 
     // PD15 I 0 Flt
     gpio_set_mode(GPIOD, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT, GPIO15);
+
+#ifdef CONFIG_DEBUG_PROBES
+    gpio_clear(PROBE_ADC_PORT, PROBE_ADC_PIN);
+    gpio_set_mode(PROBE_ADC_PORT, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_PUSHPULL, PROBE_ADC_PIN);
+    gpio_clear(PROBE_OCP_PORT, PROBE_OCP_PIN);
+    gpio_set_mode(PROBE_OCP_PORT, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_PUSHPULL, PROBE_OCP_PIN);
+    gpio_clear(PROBE_SPI_PORT, PROBE_SPI_PIN);
+    gpio_set_mode(PROBE_SPI_PORT, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_PUSHPULL, PROBE_SPI_PIN);
+    gpio_clear(PROBE_FRAME_PORT, PROBE_FRAME_PIN);
+    gpio_set_mode(PROBE_FRAME_PORT, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_PUSHPULL, PROBE_FRAME_PIN);
+#endif // CONFIG_DEBUG_PROBES
 }
 
 /**
@@ -746,22 +1896,33 @@ static void common_timer_init(enum rcc_periph_clken rcc, uint32_t timer, uint32_
 } 
 
 /**
-  * @brief Set up TIM2 for injected ADC1 sampling
-  * This timer fires at 20915Hz (that is 48MHz / 9 / 255)
+  * @brief Set up TIM2 for ADC1 sampling
+  * This timer fires at 20915Hz (that is 48MHz / 9 / 255), the period is
+  * that of the ADC profile with CONFIG_ADC_PROFILES
   * @retval None
   */
 static void tim2_init(void)
 {
     uint32_t timer = TIM2;
-    common_timer_init(RCC_TIM2, timer, 0xFF, 8);
+    common_timer_init(RCC_TIM2, timer, TIM2_PERIOD, 8);
+#ifdef CONFIG_ADC_DMA
+    // Generate a CC2 event once every period to trigger the regular scan
+    timer_set_oc_mode(timer, TIM_OC2, TIM_OCM_PWM1);
+    timer_set_oc_value(timer, TIM_OC2, (TIM2_PERIOD + 1) / 2);
+    timer_enable_oc_output(timer, TIM_OC2);
+#else // CONFIG_ADC_DMA
     timer_set_master_mode(timer, TIM_CR2_MMS_UPDATE); // Generate TRGO on every update.
+#endif // CONFIG_ADC_DMA
     timer_enable_counter(timer);
+#ifdef CONFIG_ADC_PROFILES
+    tim2_running = true;
+#endif // CONFIG_ADC_PROFILES
 }
 
-#ifdef CONFIG_FUNCGEN_ENABLE
 /**
-  * @brief Set up TIM3 for function generator sampling
-  * This timer fires at 1000000Hz (that is 48MHz / 1 / 48) 
+  * @brief Set up TIM3 as the microsecond time base
+  * This timer counts at 1000000Hz (that is 48MHz / 1 / 48) and interrupts
+  * on every 16 bit wrap
   * @retval None
   */
 static void tim3_init(void)
@@ -774,26 +1935,224 @@ static void tim3_init(void)
     timer_enable_irq(timer, TIM_DIER_UIE); /* Update IRQ enable */
 }
 
-void tim3_isr(void) {
-  if (timer_get_flag(TIM3, TIM_DIER_UIE)) {
-      timer_clear_flag(TIM3, TIM_DIER_UIE);
-  }
-  cur_time_hiw ++;
+/**
+  * @brief Count a TIM3 wrap
+  * Readers in the ADC ISR may interrupt this half way. They use
+  * time_wraps_next while time_seq is odd and time_wraps plus a pending
+  * update otherwise, so every step below leaves a consistent time.
+  * @retval None
+  */
+static void time_wrap(void)
+{
+    uint64_t next = time_wraps + 1;
+    time_wraps_next = next;
+    __sync_synchronize();
+    time_seq++;
+    __sync_synchronize();
+    timer_clear_flag(TIM3, TIM_SR_UIF);
+    time_wraps = next;
+    __sync_synchronize();
+    time_seq++;
 }
 
-uint32_t cur_time_us(void)
+uint64_t get_time_us(void)
 {
-    uint32_t t = timer_get_counter(TIM3);
-    t |= (cur_time_hiw << 16U);
-    return t;
+    uint32_t seq;
+    uint64_t wraps;
+    uint16_t count;
+    bool pending;
+    do {
+        seq = time_seq;
+        __sync_synchronize();
+        if (seq & 1) {
+            /** We interrupted time_wrap(), it will not run again until we are done */
+            wraps = time_wraps_next;
+            count = timer_get_counter(TIM3);
+            pending = false;
+        } else {
+            wraps = time_wraps;
+            count = timer_get_counter(TIM3);
+            pending = timer_get_flag(TIM3, TIM_SR_UIF);
+        }
+        __sync_synchronize();
+        /** time_wrap() ran meanwhile if time_seq changed, read again */
+    } while (seq != time_seq);
+    if (pending && count < 0x8000) {
+        /** The counter wrapped before it was read but the ISR has not run yet */
+        wraps++;
+    }
+    return (wraps << 16) | count;
 }
+
+RAMFUNC_HOOK uint32_t cur_time_us(void)
+{
+    return (uint32_t) get_time_us();
+}
+
+#ifdef CONFIG_SEQUENCER_ENABLE
 /**
-  * @brief Do nothing
-  * This avoid to test a (shared) variable and branch in an isr, and instead, branch to a function in all cases
+  * @brief Run the alarm callback if the alarm time has been reached
+  * Called from the TIM3 ISR on every update and compare interrupt
+  * @retval None
   */
-void fg_noop(void) {
+static void alarm_check(void)
+{
+    void (*cb)(void) = alarm_cb;
+    if (cb && get_time_us() >= alarm_at) {
+        alarm_cb = 0;
+        timer_disable_irq(TIM3, TIM_DIER_CC1IE);
+        (*cb)();
+    }
 }
-#endif
+#endif // CONFIG_SEQUENCER_ENABLE
+
+#ifdef CONFIG_BUTTON_TIMER
+/**
+  * @brief Post the long press once its time has been reached
+  * Called from the TIM3 ISR on the channel 4 compare, which matches once per
+  * 65.536ms wrap until then
+  * @retval None
+  */
+static void longpress_check(void)
+{
+    if (longpress_event != event_none && get_time_us() >= longpress_at) {
+        timer_disable_irq(TIM3, TIM_DIER_CC4IE);
+        event_put(longpress_event, press_long);
+        longpress_detected = true;
+        longpress_event = event_none;
+    }
+}
+#endif // CONFIG_BUTTON_TIMER
+
+void tim3_isr(void) {
+  if (timer_get_flag(TIM3, TIM_SR_UIF)) {
+      time_wrap();
+  }
+#ifdef CONFIG_SEQUENCER_ENABLE
+  if (timer_get_flag(TIM3, TIM_SR_CC1IF)) {
+      timer_clear_flag(TIM3, TIM_SR_CC1IF);
+  }
+  alarm_check();
+#endif // CONFIG_SEQUENCER_ENABLE
+#ifdef CONFIG_VOUT_SOFT_START
+  if ((TIM_DIER(TIM3) & TIM_DIER_CC2IE) && timer_get_flag(TIM3, TIM_SR_CC2IF)) {
+      timer_clear_flag(TIM3, TIM_SR_CC2IF);
+      /** Relative to the previous match so the period does not drift with ISR latency */
+      timer_set_oc_value(TIM3, TIM_OC2, TIM_CCR2(TIM3) + ramp_period);
+      void (*cb)(void) = ramp_cb;
+      if (cb) {
+          (*cb)();
+      }
+  }
+#endif // CONFIG_VOUT_SOFT_START
+#ifdef CONFIG_BUTTON_TIMER
+  if ((TIM_DIER(TIM3) & TIM_DIER_CC3IE) && timer_get_flag(TIM3, TIM_SR_CC3IF)) {
+      timer_clear_flag(TIM3, TIM_SR_CC3IF);
+      timer_disable_irq(TIM3, TIM_DIER_CC3IE);
+      debounce_active = false;
+  }
+  if ((TIM_DIER(TIM3) & TIM_DIER_CC4IE) && timer_get_flag(TIM3, TIM_SR_CC4IF)) {
+      timer_clear_flag(TIM3, TIM_SR_CC4IF);
+      longpress_check();
+  }
+#endif // CONFIG_BUTTON_TIMER
+}
+
+#ifdef CONFIG_SEQUENCER_ENABLE
+void hw_alarm_start(uint64_t at_us, void (*cb)(void))
+{
+    /** Clear the callback first as update interrupts check the alarm too */
+    alarm_cb = 0;
+    timer_disable_irq(TIM3, TIM_DIER_CC1IE);
+    alarm_at = at_us;
+    alarm_cb = cb;
+    /** The compare matches once per 65.536ms wrap, alarm_check() sorts out the high bits */
+    timer_set_oc_value(TIM3, TIM_OC1, at_us & 0xffff);
+    timer_clear_flag(TIM3, TIM_SR_CC1IF);
+    timer_enable_irq(TIM3, TIM_DIER_CC1IE);
+    /** Check from the ISR right away in case the time has already passed */
+    timer_generate_event(TIM3, TIM_EGR_CC1G);
+}
+
+void hw_alarm_stop(void)
+{
+    alarm_cb = 0;
+    timer_disable_irq(TIM3, TIM_DIER_CC1IE);
+}
+#endif // CONFIG_SEQUENCER_ENABLE
+
+#ifdef CONFIG_VOUT_SOFT_START
+void hw_ramp_timer_start(uint16_t period_us, void (*cb)(void))
+{
+    ramp_cb = 0;
+    timer_disable_irq(TIM3, TIM_DIER_CC2IE);
+    ramp_period = period_us;
+    ramp_cb = cb;
+    timer_set_oc_value(TIM3, TIM_OC2, (uint16_t) (timer_get_counter(TIM3) + period_us));
+    timer_clear_flag(TIM3, TIM_SR_CC2IF);
+    timer_enable_irq(TIM3, TIM_DIER_CC2IE);
+}
+
+void hw_ramp_timer_stop(void)
+{
+    ramp_cb = 0;
+    timer_disable_irq(TIM3, TIM_DIER_CC2IE);
+}
+#endif // CONFIG_VOUT_SOFT_START
+
+#ifdef CONFIG_FUNCGEN_ENABLE
+
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+/** Timer clock of TIM6 */
+#define DAC_WAVE_TIMER_CLOCK  (48000000)
+
+bool hw_dac_wave_start(const uint16_t *buf, uint32_t count, uint32_t sample_rate_hz)
+{
+    if (!buf || count == 0 || count > 0xffff || sample_rate_hz == 0 || sample_rate_hz > DAC_WAVE_MAX_RATE) {
+        return false;
+    }
+    hw_dac_wave_stop();
+
+    /** Smallest prescaler that makes the period fit in 16 bits */
+    uint32_t ticks = (DAC_WAVE_TIMER_CLOCK + sample_rate_hz / 2) / sample_rate_hz;
+    uint32_t prescaler = (ticks - 1) / 0x10000;
+    uint32_t period = (ticks + prescaler / 2) / (prescaler + 1);
+
+    rcc_periph_clock_enable(RCC_TIM6);
+    rcc_periph_reset_pulse(RST_TIM6);
+    timer_set_prescaler(TIM6, prescaler);
+    timer_set_period(TIM6, period - 1);
+    timer_set_master_mode(TIM6, TIM_CR2_MMS_UPDATE); // Generate TRGO on every update.
+
+    /** The value line parts only have DAC channel 1 DMA on DMA1 channel 3 when remapped */
+    AFIO_MAPR2 |= AFIO_MAPR2_TIM67_DAC_DMA_REMAP;
+    dma_channel_reset(DMA1, DMA_CHANNEL3);
+    dma_set_peripheral_address(DMA1, DMA_CHANNEL3, (uint32_t) &DAC_DHR12R1(DAC1));
+    dma_set_memory_address(DMA1, DMA_CHANNEL3, (uint32_t) buf);
+    dma_set_number_of_data(DMA1, DMA_CHANNEL3, count);
+    dma_set_read_from_memory(DMA1, DMA_CHANNEL3);
+    dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL3);
+    dma_set_peripheral_size(DMA1, DMA_CHANNEL3, DMA_CCR_PSIZE_16BIT);
+    dma_set_memory_size(DMA1, DMA_CHANNEL3, DMA_CCR_MSIZE_16BIT);
+    dma_set_priority(DMA1, DMA_CHANNEL3, DMA_CCR_PL_MEDIUM); // Below the ADC DMA
+    dma_enable_circular_mode(DMA1, DMA_CHANNEL3);
+    dma_enable_channel(DMA1, DMA_CHANNEL3);
+
+    DAC_CR(DAC1)      = 0x00031007; // BOFF2, EN2, DMAEN1, TIM6 TRGO, TEN1, BOFF1, EN1
+    timer_enable_counter(TIM6);
+    dac_wave_running = true;
+    return true;
+}
+
+void hw_dac_wave_stop(void)
+{
+    dac_wave_running = false;
+    timer_disable_counter(TIM6);
+    DAC_CR(DAC1)      = 0x00030003; // Back to software written DHR, see dac_init()
+    dma_disable_channel(DMA1, DMA_CHANNEL3);
+}
+#endif // CONFIG_FUNCGEN_DAC_DMA
+#endif // CONFIG_FUNCGEN_ENABLE
 
 /**
   * @brief Start a (possible) long press
@@ -802,9 +2161,20 @@ void fg_noop(void) {
   */
 static void longpress_begin(event_t event)
 {
+#ifdef CONFIG_BUTTON_TIMER
+    timer_disable_irq(TIM3, TIM_DIER_CC4IE);
+    longpress_event = event;
+    longpress_detected = false;
+    longpress_at = get_time_us() + LONGPRESS_TIME_MS * 1000;
+    /** The compare matches once per wrap, longpress_check() sorts out the high bits */
+    timer_set_oc_value(TIM3, TIM_OC4, longpress_at & 0xffff);
+    timer_clear_flag(TIM3, TIM_SR_CC4IF);
+    timer_enable_irq(TIM3, TIM_DIER_CC4IE);
+#else // CONFIG_BUTTON_TIMER
     longpress_event = event;
     longpress_detected = false;
     longpress_start = get_ticks();
+#endif // CONFIG_BUTTON_TIMER
 }
 
 /**
@@ -813,24 +2183,131 @@ static void longpress_begin(event_t event)
   */
 static bool longpress_end(void)
 {
+#ifdef CONFIG_BUTTON_TIMER
+    timer_disable_irq(TIM3, TIM_DIER_CC4IE);
+#endif // CONFIG_BUTTON_TIMER
     bool temp = longpress_detected;
     longpress_event = event_none;
+#ifndef CONFIG_BUTTON_TIMER
     longpress_start = 0;
+#endif // CONFIG_BUTTON_TIMER
     longpress_detected = false;
     return temp;
 }
 
+/**
+  * @brief Number of steps a rotary encoder detent is worth
+  * @param right true for a clockwise detent
+  * @retval the step count, more when the knob is turned fast in one direction
+  */
+static uint8_t rotary_steps(bool right)
+{
+#ifdef CONFIG_ROTARY_ACCEL
+    static uint64_t last_detent;
+    static bool last_right;
+    uint64_t t = get_ticks();
+    uint32_t dt = t - last_detent;
+    bool same_direction = right == last_right;
+    last_detent = t;
+    last_right = right;
+    if (same_direction) {
+        if (dt < ROTARY_ACCEL_FAST_MS) {
+            return ROTARY_ACCEL_FAST_STEPS;
+        } else if (dt < ROTARY_ACCEL_MEDIUM_MS) {
+            return ROTARY_ACCEL_MEDIUM_STEPS;
+        }
+    }
+#else // CONFIG_ROTARY_ACCEL
+    (void) right;
+#endif // CONFIG_ROTARY_ACCEL
+    return 1;
+}
+
+#ifdef CONFIG_ROTARY_QEI
+#ifdef BUTTON_ROT_TIMER
+/**
+  * @brief Set up quadrature decoding in the timer encoder mode
+  * @note The timer counts every channel A edge, up or down depending on the
+  *       level of channel B, which is one count per edge of the EXTI decoder
+  * @retval None
+  */
+static void rotary_timer_init(void)
+{
+    rcc_periph_clock_enable(BUTTON_ROT_TIMER_RCC);
+    timer_set_period(BUTTON_ROT_TIMER, 0xffff);
+    timer_ic_set_input(BUTTON_ROT_TIMER, TIM_IC1, TIM_IC_IN_TI1);
+    timer_ic_set_input(BUTTON_ROT_TIMER, TIM_IC2, TIM_IC_IN_TI2);
+    timer_ic_set_filter(BUTTON_ROT_TIMER, TIM_IC1, TIM_IC_CK_INT_N_8);
+    timer_ic_set_filter(BUTTON_ROT_TIMER, TIM_IC2, TIM_IC_CK_INT_N_8);
+    timer_slave_set_mode(BUTTON_ROT_TIMER, TIM_SMCR_SMS_EM1);
+    timer_enable_counter(BUTTON_ROT_TIMER);
+}
+#else // BUTTON_ROT_TIMER
+/** Encoder position counted by the channel A ISR when no timer decodes it */
+static volatile uint16_t rot_position;
+#endif // BUTTON_ROT_TIMER
+
+/**
+  * @brief Current encoder position
+  * @retval position in channel A edges, counting up clockwise
+  */
+static uint16_t rotary_position(void)
+{
+#ifdef BUTTON_ROT_TIMER
+    return TIM_CNT(BUTTON_ROT_TIMER);
+#else // BUTTON_ROT_TIMER
+    return rot_position;
+#endif // BUTTON_ROT_TIMER
+}
+
+/**
+  * @brief Post the rotary events for the encoder movement since the last call
+  * @retval None
+  */
+void hw_rotary_poll(void)
+{
+    static uint16_t last_position;
+    uint16_t position = rotary_position();
+    int16_t delta = (int16_t) (position - last_position);
+    last_position = position;
+    if (delta == 0) {
+        return;
+    }
+    bool right = delta > 0;
+    if (set_pressed) {
+        /** One screen change per poll, however far the knob was turned */
+        set_skip = true;
+        (void) longpress_end();
+        event_put_from(event_src_main, right ? event_rot_right_set : event_rot_left_set, press_short);
+    } else {
+        uint32_t steps = (right ? delta : -delta) * rotary_steps(right);
+        event_put_from(event_src_main, right ? event_rot_right : event_rot_left, steps > 0xff ? 0xff : steps);
+    }
+}
+#endif // CONFIG_ROTARY_QEI
+
 /**
   * @brief Detect if button is bouncing
   * @retval true if button is bounding 
   */
 static bool is_bouncing(void)
 {
+#ifdef CONFIG_BUTTON_TIMER
+    /** Presses are ignored until the one-shot TIM3 channel 3 compare ends the lockout */
+    if (debounce_active)
+        return true;
+    debounce_active = true;
+    timer_set_oc_value(TIM3, TIM_OC3, (uint16_t) (timer_get_counter(TIM3) + DEBOUNCE_TIME_MS * 1000));
+    timer_clear_flag(TIM3, TIM_SR_CC3IF);
+    timer_enable_irq(TIM3, TIM_DIER_CC3IE);
+    return false;
+#else // CONFIG_BUTTON_TIMER
     uint64_t t = get_ticks();
     if (t - last_button_down < DEBOUNCE_TIME_MS)
         return true;
     last_button_down = t;
     return false;
+#endif // CONFIG_BUTTON_TIMER
 } 
 
 /**
@@ -872,8 +2349,14 @@ void BUTTON_M1_isr(void)
     if (falling) {
         if (is_bouncing()) return;
         m1_pressed = true;
-        if (m2_pressed)
+        if (m2_pressed) {
             m1_and_m2_pressed = true;
+#ifdef CONFIG_PRESETS
+            (void) longpress_end(); /** No preset save from the M1 + M2 combo */
+        } else {
+            longpress_begin(event_button_m1);
+#endif // CONFIG_PRESETS
+        }
         exti_set_trigger(BUTTON_M1_EXTI, EXTI_TRIGGER_RISING);
     } else {
         m1_pressed = false;
@@ -883,7 +2366,14 @@ void BUTTON_M1_isr(void)
                 m1_and_m2_pressed = false;
                 event_put(event_buttom_m1_and_m2, press_short);
             } else {
+#ifdef CONFIG_PRESETS
+                if (!longpress_end()) {
+                    // Not a long press, send short press
+                    event_put(event_button_m1, press_short);
+                }
+#else // CONFIG_PRESETS
                 event_put(event_button_m1, press_short);
+#endif // CONFIG_PRESETS
             }
         }
 
@@ -903,8 +2393,14 @@ void BUTTON_M2_isr(void)
     if (falling) {
         if (is_bouncing()) return;
         m2_pressed = true;
-        if (m1_pressed)
+        if (m1_pressed) {
             m1_and_m2_pressed = true;
+#ifdef CONFIG_PRESETS
+            (void) longpress_end(); /** No preset save from the M1 + M2 combo */
+        } else {
+            longpress_begin(event_button_m2);
+#endif // CONFIG_PRESETS
+        }
         exti_set_trigger(BUTTON_M2_EXTI, EXTI_TRIGGER_RISING);
     } else {
         m2_pressed = false;
@@ -914,7 +2410,14 @@ void BUTTON_M2_isr(void)
                 m1_and_m2_pressed = false;
                 event_put(event_buttom_m1_and_m2, press_short);
             } else {
+#ifdef CONFIG_PRESETS
+                if (!longpress_end()) {
+                    // Not a long press, send short press
+                    event_put(event_button_m2, press_short);
+                }
+#else // CONFIG_PRESETS
                 event_put(event_button_m2, press_short);
+#endif // CONFIG_PRESETS
             }
         }
 
@@ -964,17 +2467,22 @@ void BUTTON_ROTARY_isr(void)
         falling = !falling;
     }
 
+#if !defined(CONFIG_ROTARY_QEI) || !defined(BUTTON_ROT_TIMER)
     if (exti_get_flag_status(BUTTON_ROT_A_EXTI)) {
         exti_reset_request(BUTTON_ROT_A_EXTI);
         bool a = (((uint16_t) GPIO_IDR(BUTTON_ROT_A_PORT)) & BUTTON_ROT_A_PIN) ? 1 : 0; // Slightly faster than gpio_get(...)
         bool b = (((uint16_t) GPIO_IDR(BUTTON_ROT_B_PORT)) & BUTTON_ROT_B_PIN) ? 1 : 0;
+#ifdef CONFIG_ROTARY_QEI
+        /** Just count, hw_rotary_poll() turns the position into events */
+        rot_position += a == b ? -1 : 1;
+#else // CONFIG_ROTARY_QEI
         if (a == b) {
             if (set_pressed) {
                 set_skip = true;
                 (void) longpress_end();
                 event_put(event_rot_left_set, press_short);
             } else {
-                event_put(event_rot_left, press_short);
+                event_put(event_rot_left, rotary_steps(false));
             }
         } else {
             if (set_pressed) {
@@ -982,10 +2490,12 @@ void BUTTON_ROTARY_isr(void)
                 (void) longpress_end();
                 event_put(event_rot_right_set, press_short);
             } else {
-                event_put(event_rot_right, press_short);
+                event_put(event_rot_right, rotary_steps(true));
             }
         }
+#endif // CONFIG_ROTARY_QEI
     }
+#endif // !CONFIG_ROTARY_QEI || !BUTTON_ROT_TIMER
 
     if (exti_get_flag_status(BUTTON_ROT_B_EXTI)) {
         exti_reset_request(BUTTON_ROT_B_EXTI);
@@ -998,6 +2508,15 @@ void BUTTON_ROTARY_isr(void)
   */
 static void button_irq_init(void)
 {
+#ifdef CONFIG_BUTTON_TIMER
+    /** Same priority as TIM3 so the button ISRs and the debounce and long
+      * press compares never preempt each other */
+    nvic_set_priority(BUTTON_SEL_NVIC, 1);
+    nvic_set_priority(BUTTON_M1_NVIC, 1);
+    nvic_set_priority(BUTTON_M2_NVIC, 1);
+    nvic_set_priority(BUTTON_ENABLE_NVIC, 1);
+    nvic_set_priority(BUTTON_ROTARY_NVIC, 1);
+#endif // CONFIG_BUTTON_TIMER
     nvic_enable_irq(BUTTON_SEL_NVIC);
     exti_select_source(BUTTON_SEL_EXTI, BUTTON_SEL_PORT);
     exti_set_trigger(BUTTON_SEL_EXTI, EXTI_TRIGGER_FALLING);
@@ -1020,19 +2539,40 @@ static void button_irq_init(void)
 
     nvic_enable_irq(BUTTON_ROTARY_NVIC);
 
+#if defined(CONFIG_ROTARY_QEI) && defined(BUTTON_ROT_TIMER)
+    rotary_timer_init();
+#else // CONFIG_ROTARY_QEI && BUTTON_ROT_TIMER
     exti_select_source(BUTTON_ROT_A_EXTI, BUTTON_ROT_A_PORT);
     exti_set_trigger(BUTTON_ROT_A_EXTI, EXTI_TRIGGER_BOTH);
     exti_enable_request(BUTTON_ROT_A_EXTI);
+#endif // CONFIG_ROTARY_QEI && BUTTON_ROT_TIMER
 
+#ifndef CONFIG_ROTARY_QEI
+    /** The position counter only needs the channel A edges */
     exti_select_source(BUTTON_ROT_B_EXTI, BUTTON_ROT_B_PORT);
     exti_set_trigger(BUTTON_ROT_B_EXTI, EXTI_TRIGGER_BOTH);
     exti_enable_request(BUTTON_ROT_B_EXTI);
+#endif // CONFIG_ROTARY_QEI
 
     exti_select_source(BUTTON_ROT_PRESS_EXTI, BUTTON_ROT_PRESS_PORT);
     exti_set_trigger(BUTTON_ROT_PRESS_EXTI, EXTI_TRIGGER_FALLING);
     exti_enable_request(BUTTON_ROT_PRESS_EXTI);
 }
 
+#if defined(CONFIG_RAMFUNC) || defined(CONFIG_FLASH_RAMFUNC)
+/**
+  * @brief Copy the functions of the .ramfunc section to the internal SRAM
+  * @retval None
+  */
+static void copy_ramfuncs(void)
+{
+    uint32_t *src = &_ramfunc_loadaddr;
+    for (uint32_t *dst = &_ramfunc_start; dst < &_ramfunc_end; ) {
+        *dst++ = *src++;
+    }
+}
+#endif // CONFIG_RAMFUNC || CONFIG_FLASH_RAMFUNC
+
 /**
   * @brief Relocate the vector table to the internal SRAM
   * @retval None
@@ -51,6 +51,7 @@
 #ifndef __HW_H__
 #define __HW_H__
 #include "dps-model.h"
+#include "perf.h"
 
 /**
  * @def V_IO_DELTA
@@ -80,6 +81,21 @@
 /** @brief ADC channel for output voltage measurement (V_out) */
 #define ADC_CHA_VOUT  (9)
 
+#ifdef CONFIG_ADC_OVERSAMPLE
+/**
+ * @brief log2 of the number of samples accumulated per decimated value
+ *
+ * The ADC ISR sums ADC_OVERSAMPLE_RATIO samples per channel before latching
+ * them, so decimated values are produced at ~21kHz / ADC_OVERSAMPLE_RATIO
+ * and carry ADC_OVERSAMPLE_SHIFT extra bits of resolution.
+ */
+#ifndef ADC_OVERSAMPLE_SHIFT
+#define ADC_OVERSAMPLE_SHIFT  (6)
+#endif
+/** @brief Number of samples accumulated per decimated value */
+#define ADC_OVERSAMPLE_RATIO  (1 << ADC_OVERSAMPLE_SHIFT)
+#endif // CONFIG_ADC_OVERSAMPLE
+
 /** @} */ // end of ADC_Channels
 
 /**
@@ -184,9 +200,52 @@
 #define BUTTON_ROTARY_isr     exti9_5_isr
 /** @brief Rotary encoder NVIC interrupt number */
 #define BUTTON_ROTARY_NVIC    NVIC_EXTI9_5_IRQ
+/**
+ * A target whose encoder A and B are routed to channel 1 and 2 of a free
+ * timer may define BUTTON_ROT_TIMER (eg. TIM3) and BUTTON_ROT_TIMER_RCC in
+ * dps-model.h to have the timer decode the encoder with CONFIG_ROTARY_QEI.
+ * The stock boards route A/B to PB8/PB9, which are TIM4 channel 3 and 4 and
+ * cannot run the encoder mode.
+ */
 
 /** @} */ // end of Button_GPIO
 
+/**
+ * @defgroup Probe_GPIO Debug Probe GPIO Configuration
+ * @brief Pins driven by the probes of probe.h with CONFIG_DEBUG_PROBES
+ *
+ * Pins left floating by gpio_init() on all models in dps-model.h. Override
+ * with e.g. -DPROBE_OCP_PORT=GPIOC -DPROBE_OCP_PIN=GPIO14 for a board
+ * where they are not reachable.
+ * @{
+ */
+#ifndef PROBE_ADC_PORT
+ /** @brief ADC ISR probe port */
+ #define PROBE_ADC_PORT   GPIOA
+ /** @brief ADC ISR probe pin */
+ #define PROBE_ADC_PIN    GPIO11
+#endif
+#ifndef PROBE_OCP_PORT
+ /** @brief OCP probe port */
+ #define PROBE_OCP_PORT   GPIOA
+ /** @brief OCP probe pin */
+ #define PROBE_OCP_PIN    GPIO12
+#endif
+#ifndef PROBE_SPI_PORT
+ /** @brief SPI DMA probe port */
+ #define PROBE_SPI_PORT   GPIOB
+ /** @brief SPI DMA probe pin */
+ #define PROBE_SPI_PIN    GPIO10
+#endif
+#ifndef PROBE_FRAME_PORT
+ /** @brief Protocol frame probe port */
+ #define PROBE_FRAME_PORT GPIOB
+ /** @brief Protocol frame probe pin, BOOT1, only sampled at reset */
+ #define PROBE_FRAME_PIN  GPIO2
+#endif
+
+/** @} */ // end of Probe_GPIO
+
 
 /**
  * @brief Initialize all hardware subsystems
@@ -205,9 +264,62 @@
  * hardware-related functions.
  *
  * @note This function enables global interrupts
+ * @note The ADC is only powered up, hw_adc_start() starts the sampling
  */
 void hw_init(void);
 
+/**
+ * @brief Calibrate the ADC and start sampling
+ *
+ * Waits until the ADC powered up by hw_init() has been on for ADC_STARTUP_MS,
+ * so other initialization between the two calls overlaps the wait, then
+ * calibrates it and starts the TIM2 trigger.
+ */
+void hw_adc_start(void);
+
+#ifdef CONFIG_ADC_PROFILES
+/**
+ * @brief ADC acquisition profiles, trading noise against bandwidth
+ *
+ * A profile sets the TIM2 sample set rate, the sample time of the I_out,
+ * V_in and V_out channels and, with CONFIG_ADC_OVERSAMPLE, the number of
+ * samples decimated per measurement:
+ * - low noise: ~5.2kHz, 239.5 cycles, 2^ADC_OVERSAMPLE_SHIFT samples
+ * - default: ~21kHz, 28.5 cycles, 2^ADC_OVERSAMPLE_SHIFT samples
+ * - high speed: ~33kHz, 13.5 cycles, 2^(ADC_OVERSAMPLE_SHIFT - 3) samples
+ *
+ * Everything fed from the ADC ISR runs at the rate of the profile. OCP and
+ * OVP trip after the same number of samples, in less or more time.
+ */
+typedef enum {
+    adc_profile_default = 0,
+    adc_profile_low_noise,
+    adc_profile_high_speed,
+    adc_profile_count
+} adc_profile_t;
+
+/**
+ * @brief Select an acquisition profile
+ *
+ * May be called before hw_adc_start() and while sampling, the decimation
+ * starts over.
+ *
+ * @param profile The profile
+ * @return false if there is no such profile
+ */
+bool hw_adc_set_profile(adc_profile_t profile);
+
+/**
+ * @brief Get the acquisition profile
+ *
+ * @param[out] rate_hz    Sample set rate, may be NULL
+ * @param[out] decimation Sample sets per decimated measurement, 1 without
+ *                        CONFIG_ADC_OVERSAMPLE, may be NULL
+ * @return the profile
+ */
+adc_profile_t hw_adc_get_profile(uint32_t *rate_hz, uint32_t *decimation);
+#endif // CONFIG_ADC_PROFILES
+
 /**
  * @brief Read the latest ADC measurements
  *
@@ -226,6 +338,55 @@ void hw_init(void);
  */
 void hw_get_adc_values(uint16_t *i_out_raw, uint16_t *v_in_raw, uint16_t *v_out_raw);
 
+#ifdef CONFIG_ADC_OVERSAMPLE
+/**
+ * @brief Read the latest decimated ADC measurements at full resolution
+ *
+ * Returns the sum of the last ADC_OVERSAMPLE_RATIO samples of each channel,
+ * ie. the mean value with ADC_OVERSAMPLE_SHIFT fractional bits. When
+ * oversampling is enabled, hw_get_adc_values() returns the same values
+ * rounded to 12 bits.
+ *
+ * @param[out] i_out_hires Pointer to receive decimated output current value
+ * @param[out] v_in_hires  Pointer to receive decimated input voltage value
+ * @param[out] v_out_hires Pointer to receive decimated output voltage value
+ *
+ * @see pwrctl_calc_vin_hires(), pwrctl_calc_vout_hires() and
+ *      pwrctl_calc_iout_hires() for conversion to physical units
+ */
+void hw_get_adc_values_hires(uint32_t *i_out_hires, uint32_t *v_in_hires, uint32_t *v_out_hires);
+#endif // CONFIG_ADC_OVERSAMPLE
+
+/**
+ * @brief Raw ADC samples accumulated by the ADC ISR
+ *
+ * Channels are indexed I_out, V_in, V_out as in hw_get_adc_values(). The
+ * mean and variance of each channel follow from the sums.
+ */
+typedef struct {
+    uint32_t count;      /**< Number of sample sets accumulated */
+    uint32_t sum[3];     /**< Sum of the raw samples */
+    uint64_t sum_sq[3];  /**< Sum of the squared raw samples */
+} adc_stats_t;
+
+/**
+ * @brief Start accumulating ADC samples
+ *
+ * The ADC ISR adds the next count sample sets to the statistics, replacing
+ * any accumulation in progress. At ~21kHz 65535 samples take about 3s.
+ *
+ * @param[in] count Number of sample sets to accumulate, 0 stops
+ */
+void hw_adc_stats_start(uint16_t count);
+
+/**
+ * @brief Get the accumulated ADC samples
+ *
+ * @param[out] stats Receives the statistics once complete
+ * @return true if the count given to hw_adc_stats_start() has been reached
+ */
+bool hw_adc_stats_get(adc_stats_t *stats);
+
 /**
  * @brief Set the output voltage DAC value
  *
@@ -253,6 +414,21 @@ void hw_set_voltage_dac(uint16_t v_dac);
  */
 void hw_set_current_dac(uint16_t i_dac);
 
+/**
+ * @brief Set the output voltage and current DAC values together
+ *
+ * Writes both channels with a single store to the dual holding register
+ * (DAC_DHR12RD), so the outputs never see a new voltage with an old current
+ * or the other way round. While the DMA waveform owns channel 1 only the
+ * current is written.
+ *
+ * @param[in] v_dac Raw voltage DAC value (0-4095)
+ * @param[in] i_dac Raw current DAC value (0-4095)
+ *
+ * @see pwrctl_set_vout_iout() for the high-level function
+ */
+void hw_set_dacs(uint16_t v_dac, uint16_t i_dac);
+
 /**
  * @brief Initialize and enable the TFT backlight
  *
@@ -313,6 +489,7 @@ uint16_t hw_get_itrig_ma(void);
  */
 uint16_t hw_get_vtrig_mv(void);
 
+#ifndef CONFIG_BUTTON_TIMER
 /**
  * @brief Check for long button press and inject event
  *
@@ -328,6 +505,20 @@ uint16_t hw_get_vtrig_mv(void);
  * @note This function should be called regularly from the main loop
  */
 void hw_longpress_check(void);
+#endif // CONFIG_BUTTON_TIMER
+
+#ifdef CONFIG_ROTARY_QEI
+/**
+ * @brief Post rotary events for the encoder movement since the last call
+ *
+ * The encoder position is counted by a timer in encoder mode when the target
+ * defines BUTTON_ROT_TIMER, else by the channel A interrupt. Either way the
+ * movement is turned into events here rather than one event per edge.
+ *
+ * @note This function should be called regularly from the main loop
+ */
+void hw_rotary_poll(void);
+#endif // CONFIG_ROTARY_QEI
 
 /**
  * @brief Check if the SEL button is currently pressed
@@ -341,6 +532,218 @@ void hw_longpress_check(void);
  */
 bool hw_sel_button_pressed(void);
 
+/**
+ * @brief Sleep until the next interrupt
+ *
+ * Executes WFI. The SysTick interrupt wakes the CPU at least every 1ms.
+ */
+void hw_wait_for_interrupt(void);
+
+#ifdef CONFIG_ADC_AWD
+/**
+ * @brief Reprogram the ADC analog watchdog used for OCP
+ *
+ * Loads the analog watchdog high threshold from the published i_limit_raw, compensated
+ * for the measured I_out offset. When the I_out sample exceeds the threshold
+ * the output is cut off from the watchdog interrupt, with a latency of at most
+ * one conversion and without the software OCP filter.
+ *
+ * The watchdog is disarmed while the output is disabled.
+ *
+ * @note Called by pwrctl whenever the current limit or output state changes
+ */
+void hw_update_ocp_watchdog(void);
+#endif // CONFIG_ADC_AWD
+
+#ifdef CONFIG_OCP_BENCH
+/**
+ * @brief Measure the OCP trip latency
+ *
+ * For each run the output is enabled and left to settle, then a current
+ * limit any I_out sample exceeds is published with pwrctl_set_ilimit_raw().
+ * The latency is the number of CPU cycles from publishing the limit until
+ * the OCP path returns from pwrctl_enable_vout(false), the ADC sampling, the
+ * OCP filter (or analog watchdog) and the DAC zeroing included. The
+ * synthetic trips post no event_ocp. Requires the output to be enabled,
+ * which it is again with the current limit restored on return.
+ *
+ * @param[in]  runs  Number of trips
+ * @param[out] stats Receives the count, min, max and total latency in cycles
+ * @return Number of runs that tripped, fewer than runs if one timed out
+ */
+uint32_t hw_ocp_bench(uint32_t runs, perf_stats_t *stats);
+#endif // CONFIG_OCP_BENCH
+
+#ifdef CONFIG_TRIP_SNAPSHOT
+/** @brief Number of sample sets kept up to an OCP/OVP trip */
+#ifndef TRIP_SNAPSHOT_SAMPLES
+ #define TRIP_SNAPSHOT_SAMPLES  (16)
+#endif
+
+/**
+ * @brief Protection that cut the output
+ */
+typedef enum {
+    trip_none = 0,      /**< No trip since power up or the last clear */
+    trip_ocp,           /**< Over current protection */
+    trip_ovp,           /**< Over voltage protection */
+} trip_t;
+
+/**
+ * @brief State of the DPS at the first trip
+ */
+typedef struct {
+    trip_t trip;                /**< What tripped */
+    uint32_t time_us;           /**< cur_time_us() at the trip */
+    uint16_t v_dac;             /**< V_out DAC setpoint */
+    uint16_t i_dac;             /**< I_limit DAC setpoint */
+    uint16_t samples[TRIP_SNAPSHOT_SAMPLES][3]; /**< Raw I_out, V_in, V_out, oldest first, the last one tripped */
+} trip_snapshot_t;
+
+/**
+ * @brief Get the snapshot taken at the first OCP/OVP trip
+ *
+ * The ADC interrupt keeps the last TRIP_SNAPSHOT_SAMPLES sample sets and
+ * freezes them together with the DAC setpoints and a timestamp when the
+ * output is cut. Later trips are ignored until the snapshot is cleared.
+ *
+ * @param snapshot Filled in with the snapshot
+ * @return true if a trip has been captured
+ */
+bool hw_get_trip_snapshot(trip_snapshot_t *snapshot);
+
+/**
+ * @brief Clear the trip snapshot and capture the next trip
+ */
+void hw_clear_trip_snapshot(void);
+#endif // CONFIG_TRIP_SNAPSHOT
+
+#ifdef CONFIG_POWER_FAIL
+/** @brief V_in sag, in percent below its recent level, that counts as a power failure */
+#ifndef POWER_FAIL_SAG_PERCENT
+ #define POWER_FAIL_SAG_PERCENT  (15)
+#endif
+
+/**
+ * @brief Check for a V_in power failure
+ *
+ * The ADC interrupt follows V_in with a slow moving average so a battery
+ * running down is not mistaken for a power failure. When V_in drops
+ * POWER_FAIL_SAG_PERCENT below the average it turns the backlight off to
+ * stretch the hold-up time of the input capacitors and posts
+ * event_power_fail with data 1, and with data 0 once V_in has recovered.
+ * The backlight is left for the main loop to turn back on.
+ *
+ * @return true from the sag until V_in has recovered
+ */
+bool hw_power_failing(void);
+#endif // CONFIG_POWER_FAIL
+
+#ifdef CONFIG_CHIP_TEMP
+/** @brief Temperature sensor voltage at 25 degrees C (mV), typical for the STM32F100 */
+#ifndef CHIP_TEMP_V25_MV
+ #define CHIP_TEMP_V25_MV      (1410)
+#endif
+/** @brief Temperature sensor slope (uV per degree C), falling with temperature */
+#ifndef CHIP_TEMP_SLOPE_UV
+ #define CHIP_TEMP_SLOPE_UV    (4300)
+#endif
+
+/**
+ * @brief Read the STM32 die temperature
+ *
+ * The internal temperature sensor is converted on the ADC group the V/I scan
+ * does not use (regular, or injected with CONFIG_ADC_DMA), started by
+ * software with a long sample time so it barely delays the scan. Each call
+ * returns the result of the conversion the previous call started and starts
+ * the next one, so call it periodically.
+ *
+ * @param[out] temp Die temperature in 0.1 degrees C, accurate to a few degrees
+ * @return false if no conversion has completed yet
+ */
+bool hw_chip_temp(int16_t *temp);
+#endif // CONFIG_CHIP_TEMP
+
+/**
+ * @brief Change the USART1 baud rate
+ *
+ * Waits for pending transmissions to complete so that a response sent at
+ * the old rate is not cut off before switching.
+ *
+ * @param baudrate New baud rate
+ */
+void hw_usart_set_baudrate(uint32_t baudrate);
+
+/**
+ * @brief Receive errors of USART1 counted by its interrupt
+ */
+typedef struct {
+    uint32_t overrun;   /**< Bytes lost because the previous one was not read in time */
+    uint32_t noise;     /**< Bytes with a bad stop bit or noise, wrong baud rate or a bad line */
+    uint32_t dropped;   /**< Bytes dropped by a full receive ring */
+} hw_usart_errors_t;
+
+/**
+ * @brief Get the receive error counters of USART1
+ *
+ * @param errors Filled in with the counters since power up or the last reset
+ * @param reset  Clear the counters after reading them
+ */
+void hw_usart_get_errors(hw_usart_errors_t *errors, bool reset);
+
+#ifdef CONFIG_USART_RX_RING
+/** @brief Capacity of the USART1 receive ring in bytes, must hold what arrives during a main loop stall */
+#define USART_RX_RING_SIZE  (256)
+
+/**
+ * @brief Read data received on USART1
+ *
+ * Copies bytes received since the last call out of the receive ring.
+ * Called from the main loop on event_uart_rx_block until it returns 0.
+ *
+ * @param data Buffer to copy received bytes to
+ * @param size Size of the buffer
+ * @return Number of bytes copied
+ */
+uint32_t hw_usart_rx_read(uint8_t *data, uint32_t size);
+#endif // CONFIG_USART_RX_RING
+
+#ifdef CONFIG_USART_TX_IRQ
+/** @brief Capacity of the USART1 transmit ring in bytes, room for two full frames */
+#define USART_TX_RING_SIZE  (256)
+
+/**
+ * @brief Queue data for interrupt driven transmission on USART1
+ *
+ * The data is copied to the TX ring and sent from the USART1 TXE interrupt,
+ * so the caller does not wait for the bytes to leave the wire. Either all
+ * of the data is queued or none of it, so a frame is never split.
+ *
+ * @param data   Data to send
+ * @param length Number of bytes to send
+ * @return true if the data was queued
+ * @return false if the TX ring does not have room for length bytes
+ *
+ * @note Callers that cannot drop data retry until this succeeds
+ */
+bool hw_usart_send(const uint8_t *data, uint32_t length);
+
+/**
+ * @brief Get the free space in the USART1 transmit ring
+ *
+ * @return Number of bytes hw_usart_send() can currently accept
+ */
+uint32_t hw_usart_tx_free(void);
+
+/**
+ * @brief Wait until all queued data has been transmitted
+ *
+ * Blocks until the TX ring is empty and the last byte has left the shift
+ * register. Used before resetting the device.
+ */
+void hw_usart_flush(void);
+#endif // CONFIG_USART_TX_IRQ
+
 #ifdef CONFIG_ADC_BENCHMARK
 /**
  * @brief Print ADC timing information for benchmarking
@@ -353,44 +756,107 @@ bool hw_sel_button_pressed(void);
 void hw_print_ticks(void);
 #endif // CONFIG_ADC_BENCHMARK
 
-#ifdef CONFIG_FUNCGEN_ENABLE
 /**
- * @brief Function pointer for function generator tick callback
+ * @brief Get current time in microseconds, truncated to 32 bits
  *
- * This pointer is called on each ADC update (approximately 50kHz) to
- * allow the function generator to update its output waveform in real-time.
+ * The low 32 bits of get_time_us(), for code that only needs time
+ * differences shorter than the wrap.
  *
- * By using a function pointer instead of a conditional check, we avoid
- * branch prediction overhead in the time-critical ADC ISR, ensuring
- * consistent latency for waveform generation.
+ * @return Current time in microseconds (wraps at 32-bit overflow)
  *
- * @note Set to fg_noop() when function generator is not active
- * @see fg_noop()
+ * @note Overflow occurs approximately every 71 minutes
+ * @see get_time_us() in tick.h
  */
-extern void (*funcgen_tick)(void);
+uint32_t cur_time_us(void);
 
+#ifdef CONFIG_SEQUENCER_ENABLE
 /**
- * @brief No-operation function for function generator tick
+ * @brief Call a function at a given microsecond time
  *
- * An empty function used as the default value for funcgen_tick when
- * the function generator is not active. This maintains consistent
- * timing in the ADC ISR by always calling a function.
+ * The TIM3 channel 1 compare interrupt calls cb once get_time_us() has
+ * reached at_us, right away if it already has. Only one alarm is pending,
+ * starting a new one replaces it. cb may start the next alarm.
  *
- * @see funcgen_tick
+ * @param at_us  Time to call cb at, see get_time_us()
+ * @param cb     Called from the TIM3 ISR
  */
-void fg_noop(void);
+void hw_alarm_start(uint64_t at_us, void (*cb)(void));
 
 /**
- * @brief Get current time in microseconds
+ * @brief Cancel the pending alarm, if any
+ */
+void hw_alarm_stop(void);
+#endif // CONFIG_SEQUENCER_ENABLE
+
+#ifdef CONFIG_VOUT_SOFT_START
+/**
+ * @brief Call a function periodically from the TIM3 ISR
  *
- * Returns a high-resolution timestamp in microseconds, updated by
- * a hardware timer. Used for precise timing in the function generator.
+ * Uses TIM3 channel 2 next to the channel 1 alarm. Each match is
+ * rescheduled from the previous one so the rate does not drift.
  *
- * @return Current time in microseconds (wraps at 32-bit overflow)
+ * @param period_us  Time between calls in microseconds
+ * @param cb         Called from the TIM3 ISR, may stop the timer
+ */
+void hw_ramp_timer_start(uint16_t period_us, void (*cb)(void));
+
+/**
+ * @brief Stop the periodic ramp timer
+ */
+void hw_ramp_timer_stop(void);
+#endif // CONFIG_VOUT_SOFT_START
+
+#ifdef CONFIG_FUNCGEN_ENABLE
+#ifdef CONFIG_FUNCGEN_DAC_DMA
+/** @brief Highest DAC update rate accepted by hw_dac_wave_start() */
+#define DAC_WAVE_MAX_RATE  (250000)
+
+/**
+ * @brief Stream a waveform to the V_out DAC
  *
- * @note Overflow occurs approximately every 71 minutes
+ * TIM6 triggers a DAC conversion at sample_rate_hz and DMA1 channel 3 feeds
+ * DAC_DHR12R1 from buf, wrapping around at the end. The CPU is not involved
+ * until hw_dac_wave_stop() is called, writes to the V_out DAC register are
+ * overwritten meanwhile.
+ *
+ * @param buf            DAC values, must stay valid while streaming
+ * @param count          Number of values in buf
+ * @param sample_rate_hz DAC update rate
+ * @return true if streaming was started
  */
-uint32_t cur_time_us(void);
+bool hw_dac_wave_start(const uint16_t *buf, uint32_t count, uint32_t sample_rate_hz);
+
+/**
+ * @brief Stop streaming and return the V_out DAC to software writes
+ */
+void hw_dac_wave_stop(void);
+#endif // CONFIG_FUNCGEN_DAC_DMA
 #endif // CONFIG_FUNCGEN_ENABLE
 
+#ifdef DPS_EMULATOR
+/**
+ * @brief Start the simulated ADC of the PC emulator
+ *
+ * Samples from the power stage model are fed through a simulated ADC ISR
+ * at the sample rate of the real hardware, see emu/powerstage.c
+ *
+ * @note Only available when compiling with DPS_EMULATOR defined
+ */
+void hw_emul_start_adc(void);
+
+/**
+ * @brief Receive data on the emulated USART
+ *
+ * Queues a whole datagram from the emulator comms thread for
+ * hw_usart_rx_read() and posts a single event_uart_rx_block.
+ *
+ * @param data Received data
+ * @param length Number of bytes
+ * @return false if the RX ring had no room, nothing was queued
+ *
+ * @note Only available when compiling with DPS_EMULATOR defined
+ */
+bool hw_emul_usart_rx(const uint8_t *data, uint32_t length);
+#endif // DPS_EMULATOR
+
 #endif // __HW_H__
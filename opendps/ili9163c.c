@@ -27,6 +27,7 @@
 #include "ili9163c_settings.h"
 #include "ili9163c_registers.h"
 #include <limits.h>
+#include <stddef.h>
 #include <gpio.h>
 #include "tick.h"
 #include "spi_driver.h"
@@ -36,12 +37,22 @@ static uint8_t mad_ctrl_value;
 static uint8_t colorspace_data;
 static int16_t screen_width, screen_height;
 static uint8_t rotation;
+/** GRAM offsets of the visible area for the current rotation */
+static uint8_t column_offset = 2, page_offset = 1;
+/** The address ranges last sent, the controller keeps them until changed */
+static uint32_t last_columns, last_pages;
+static bool window_valid;
+
+/** Longest sequence built by ili9163c_set_window(): CASET, PASET, RAMWR */
+#define WINDOW_SEQ_SIZE  (3 * 2 + 2 * 4)
 
 static void chip_init(void);
 static void write_command(uint8_t c);
 static void write_data(uint8_t c);
 static void write_data16(uint16_t d);
 static void color_space(uint8_t cspace);
+static uint32_t seq_add(uint8_t *seq, uint32_t len, uint8_t cmd, const uint8_t *params, uint8_t num_params);
+static void seq_send(const uint8_t *seq, uint32_t len);
 
 void ili9163c_init(void)
 {
@@ -88,6 +99,7 @@ void ili9163c_get_geometry(uint16_t *width, uint16_t *height)
 
 static void write_command(uint8_t c)
 {
+    spi_dma_fence();
     gpio_clear(TFT_A0_PORT, TFT_A0_PIN);
     uint8_t tx_buf[1] = {c};
     (void) spi_dma_transceive((uint8_t*) tx_buf, sizeof(tx_buf), 0, 0);
@@ -95,6 +107,7 @@ static void write_command(uint8_t c)
 
 static void write_data(uint8_t c)
 {
+    spi_dma_fence();
     gpio_set(TFT_A0_PORT, TFT_A0_PIN);
     uint8_t tx_buf[1] = {c};
     (void) spi_dma_transceive((uint8_t*) tx_buf, sizeof(tx_buf), 0, 0);
@@ -102,11 +115,56 @@ static void write_data(uint8_t c)
 
 static void write_data16(uint16_t d)
 {
+    spi_dma_fence();
     gpio_set(TFT_A0_PORT, TFT_A0_PIN);
     uint8_t tx_buf[2] = {(uint8_t) (d >> 8), (uint8_t) (d & 0xff)};
     (void) spi_dma_transceive((uint8_t*) tx_buf, sizeof(tx_buf), 0, 0);
 }
 
+/**
+ * @brief      Append a command to a sequence for seq_send()
+ *
+ * @param      seq         The sequence, [cmd] [num_params] [params] per command
+ * @param[in]  len         Current length of the sequence
+ * @param[in]  cmd         The command
+ * @param[in]  params      Its parameters
+ * @param[in]  num_params  Number of parameters
+ *
+ * @return     New length of the sequence
+ */
+static uint32_t seq_add(uint8_t *seq, uint32_t len, uint8_t cmd, const uint8_t *params, uint8_t num_params)
+{
+    seq[len++] = cmd;
+    seq[len++] = num_params;
+    for (uint32_t i = 0; i < num_params; i++) {
+        seq[len++] = params[i];
+    }
+    return len;
+}
+
+/**
+ * @brief      Send a command sequence, A0 changes only between a command and
+ *             its parameters and each goes out in one polled transfer
+ *
+ * @param[in]  seq   The sequence built by seq_add()
+ * @param[in]  len   Length of the sequence
+ */
+static void seq_send(const uint8_t *seq, uint32_t len)
+{
+    spi_dma_fence();
+    while (len) {
+        uint8_t num_params = seq[1];
+        gpio_clear(TFT_A0_PORT, TFT_A0_PIN);
+        (void) spi_write_polled(&seq[0], 1);
+        if (num_params) {
+            gpio_set(TFT_A0_PORT, TFT_A0_PIN);
+            (void) spi_write_polled(&seq[2], num_params);
+        }
+        seq += 2 + num_params;
+        len -= 2 + num_params;
+    }
+}
+
 static void chip_init(void)
 {
     uint8_t i;
@@ -162,6 +220,7 @@ static void chip_init(void)
     write_command(CMD_VCOMOFFS);
     write_data(0); // 0x40
 
+    window_valid = false; /** Set here without the display offsets */
     write_command(CMD_CLMADRS); // Set Column Address
     write_data16(0x00);
     write_data16(_GRAMWIDTH);
@@ -209,8 +268,9 @@ void ili9163c_draw_vline(int16_t x, int16_t y, int16_t h, uint16_t color)
     if (ili9163c_boundary_check(x,y)) return;
     if (((y + h) - 1) >= screen_height) h = screen_height-y;
     ili9163c_set_window(x,y,x,(y+h)-1);
-    while (h-- > 0) {
-        write_data16(color);
+    if (h > 0) {
+        gpio_set(TFT_A0_PORT, TFT_A0_PIN);
+        (void) spi_dma_fill16(color, h);
     }
 }
 
@@ -219,8 +279,9 @@ void ili9163c_draw_hline(int16_t x, int16_t y, int16_t w, uint16_t color)
     if (ili9163c_boundary_check(x,y)) return;
     if (((x+w) - 1) >= screen_width) w = screen_width-x;
     ili9163c_set_window(x,y,(x+w)-1,y);
-    while (w-- > 0) {
-        write_data16(color);
+    if (w > 0) {
+        gpio_set(TFT_A0_PORT, TFT_A0_PIN);
+        (void) spi_dma_fill16(color, w);
     }
 }
 
@@ -232,17 +293,9 @@ bool ili9163c_boundary_check(int16_t x,int16_t y)
 
 void ili9163c_fill_screen(uint16_t color)
 {
-    uint32_t i;
-    uint8_t hi = color >> 8;
-    uint8_t lo = color & 0xff;
-    uint8_t fill[] = {hi, lo, hi, lo, hi, lo, hi, lo, hi, lo, hi, lo, hi, lo, hi, lo};
-    uint8_t dummy[sizeof(fill)];
-    gpio_clear(TFT_A0_PORT, TFT_A0_PIN);
     ili9163c_set_window(0, 0, _GRAMWIDTH+2, _GRAMHEIGH); // Note! For some reason filling WxH is results in two vertical lines to the far right...
     gpio_set(TFT_A0_PORT, TFT_A0_PIN);
-    for (i = 0;i < ((_GRAMWIDTH+2) * _GRAMHEIGH)/(sizeof(fill)/2); i++) {
-        (void) spi_dma_transceive((uint8_t*) fill, sizeof(fill), (uint8_t*) dummy, sizeof(dummy));
-    }
+    (void) spi_dma_fill16(color, (_GRAMWIDTH+2) * _GRAMHEIGH);
 }
 
 // fill a rectangle
@@ -252,84 +305,74 @@ void ili9163c_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t col
     if (((x + w) - 1) >= screen_width)  w = screen_width  - x;
     if (((y + h) - 1) >= screen_height) h = screen_height - y;
     ili9163c_set_window(x,y,(x+w)-1,(y+h)-1);
-    for (y = h;y > 0;y--) {
-        for (x = w;x > 1;x--) {
-            write_data16(color);
-        }
-        write_data16(color);
+    if (w > 0 && h > 0) {
+        gpio_set(TFT_A0_PORT, TFT_A0_PIN);
+        (void) spi_dma_fill16(color, (uint32_t) w * h);
     }
 }
 
 void ili9163c_set_window(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
 {
-    write_command(CMD_CLMADRS); // Column
-    if (rotation == 3)
-    {
-        write_data16(x0 + 3);
-        write_data16(x1 + 3);
-    }
-    else if (rotation == 2)
-    {
-        write_data16(x0 + 2);
-        write_data16(x1 + 2);
-    }
-    else if (rotation == 1)
-    {
-        write_data16(x0 + 1);
-        write_data16(x1 + 1);
-    }
-    else
-    {
-        write_data16(x0 + 2);
-        write_data16(x1 + 2);
+    uint8_t seq[WINDOW_SEQ_SIZE];
+    uint32_t len = 0;
+    uint32_t columns = (uint32_t) (x0 + column_offset) << 16 | (uint16_t) (x1 + column_offset);
+    uint32_t pages = (uint32_t) (y0 + page_offset) << 16 | (uint16_t) (y1 + page_offset);
+
+    /** Consecutive glyphs on a line share the page range, skip what the
+      * controller already has */
+    if (!window_valid || columns != last_columns) {
+        uint8_t params[4] = { columns >> 24, columns >> 16, columns >> 8, columns };
+        len = seq_add(seq, len, CMD_CLMADRS, params, sizeof(params)); // Column
     }
-
-    write_command(CMD_PGEADRS); // Page
-    if (rotation == 3)
-    {
-        write_data16(y0 + 2);
-        write_data16(y1 + 2);
-    }
-    else if (rotation == 2)
-    {
-        write_data16(y0 + 3);
-        write_data16(y1 + 3);
-    }
-    else if (rotation == 1)
-    {
-        write_data16(y0 + 2);
-        write_data16(y1 + 2);
-    }
-    else
-    {
-        write_data16(y0 + 1);
-        write_data16(y1 + 1);
+    if (!window_valid || pages != last_pages) {
+        uint8_t params[4] = { pages >> 24, pages >> 16, pages >> 8, pages };
+        len = seq_add(seq, len, CMD_PGEADRS, params, sizeof(params)); // Page
     }
-    write_command(CMD_RAMWR); // Into RAM
+    len = seq_add(seq, len, CMD_RAMWR, NULL, 0); // Into RAM
+    seq_send(seq, len);
+    last_columns = columns;
+    last_pages = pages;
+    window_valid = true;
 }
 
 
+void ili9163c_set_scroll(uint16_t line)
+{
+    uint8_t seq[2 + 2];
+    uint8_t params[2] = { (uint8_t) ((__OFFSET + line) >> 8), (uint8_t) (__OFFSET + line) };
+    seq_send(seq, seq_add(seq, 0, CMD_VSSTADRS, params, sizeof(params)));
+}
+
 void ili9163c_set_rotation(uint8_t m)
 {
     rotation = m % 4; // can't be higher than 3
+    window_valid = false;
     switch (rotation) {
     case 0:
         mad_ctrl_value = 0b00001000;
+        column_offset = 2;
+        page_offset = 1;
         screen_width  = _TFTWIDTH;
         screen_height = _TFTHEIGHT;
         break;
     case 1:
         mad_ctrl_value = 0b01101000;
+        column_offset = 1;
+        page_offset = 2;
         screen_width  = _TFTHEIGHT;
         screen_height = _TFTWIDTH;
         break;
     case 2:
         mad_ctrl_value = 0b11001000;
+        column_offset = 2;
+        page_offset = 3;
         screen_width  = _TFTWIDTH;
         screen_height = _TFTHEIGHT;
         break;
     case 3:
         mad_ctrl_value = 0b10101000;
+        column_offset = 3;
+        page_offset = 2;
         screen_width  = _TFTWIDTH;
         screen_height = _TFTHEIGHT;
         break;
@@ -279,4 +279,18 @@ void ili9163c_draw_vline(int16_t x, int16_t y, int16_t h, uint16_t color);
  */
 void ili9163c_draw_hline(int16_t x, int16_t y, int16_t w, uint16_t color);
 
+/**
+ * @brief Set the first line of the vertical scroll area
+ *
+ * The scroll area set up at init covers the visible lines of the panel.
+ * The display shows the area starting at the given line and wraps around
+ * at its end, without any change to the frame memory. In rotations 1 and
+ * 3 the row/column exchange makes the panel's vertical scroll move along
+ * the x axis of the screen.
+ *
+ * @param[in] line First line to show, 0 to _TFTHEIGHT-1. 0 is the
+ *                 normal, unscrolled display.
+ */
+void ili9163c_set_scroll(uint16_t line);
+
 #endif // _ILI9163C_H_
@@ -0,0 +1,109 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "isrhook.h"
+#include "ramfunc.h"
+
+/** One slot, the counters are written by the ADC ISR only */
+typedef struct {
+    isrhook_func_t volatile func;
+    volatile uint16_t budget;
+    uint32_t runs;
+    uint32_t overruns;
+    uint32_t max_cycles;
+} hook_t;
+
+static hook_t hooks[isrhook_count];
+static volatile bool reset_pending;
+
+void isrhook_set(isrhook_slot_t slot, isrhook_func_t func, uint16_t budget_cycles)
+{
+    if (slot >= isrhook_count) {
+        return;
+    }
+    /** The ISR may read the budget of the old hook once, that is harmless */
+    hooks[slot].budget = budget_cycles;
+    hooks[slot].func = func;
+}
+
+bool isrhook_enabled(isrhook_slot_t slot)
+{
+    return slot < isrhook_count && hooks[slot].func != NULL;
+}
+
+bool isrhook_is(isrhook_slot_t slot, isrhook_func_t func)
+{
+    return slot < isrhook_count && func && hooks[slot].func == func;
+}
+
+RAMFUNC_HOOK void isrhook_run(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw)
+{
+    if (reset_pending) {
+        for (uint32_t slot = 0; slot < isrhook_count; slot++) {
+            hooks[slot].runs = hooks[slot].overruns = hooks[slot].max_cycles = 0;
+        }
+        reset_pending = false;
+    }
+    uint32_t start = isrhook_clock();
+    for (uint32_t slot = 0; slot < isrhook_count; slot++) {
+        hook_t *hook = &hooks[slot];
+        isrhook_func_t func = hook->func;
+        if (!func) {
+            continue;
+        }
+        func(i_raw, v_in_raw, v_out_raw);
+        /** Each call is timed from the end of the previous one, one clock read per hook */
+        uint32_t end = isrhook_clock();
+        uint32_t cycles = end - start;
+        start = end;
+        hook->runs++;
+        if (cycles > hook->max_cycles) {
+            hook->max_cycles = cycles;
+        }
+        if (cycles > hook->budget) {
+            hook->overruns++;
+        }
+    }
+}
+
+bool isrhook_get_stats(isrhook_slot_t slot, isrhook_stats_t *stats)
+{
+    if (slot >= isrhook_count) {
+        return false;
+    }
+    hook_t *hook = &hooks[slot];
+    stats->enabled = hook->func != NULL;
+    stats->budget = hook->budget;
+    stats->runs = hook->runs;
+    stats->overruns = hook->overruns;
+    stats->max_cycles = hook->max_cycles;
+    return true;
+}
+
+void isrhook_reset_stats(void)
+{
+    reset_pending = true;
+}
@@ -0,0 +1,156 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/**
+ * @file isrhook.h
+ * @brief Per sample hooks of the ADC ISR
+ *
+ * Everything that runs for each ADC sample set besides the OCP/OVP checks
+ * registers a hook in a slot of a fixed table. isrhook_run() calls the
+ * enabled hooks in slot order, so the control loop always sees the setpoints
+ * the regime detection left and the lock-in always reads the phase the DDS
+ * just advanced. Screens enable their hook when they start their output and
+ * disable it again when they stop, a disabled slot costs a load and a
+ * branch.
+ *
+ * Every hook has a budget in CPU cycles. isrhook_run() times each call with
+ * isrhook_clock(), counts the calls that went over the budget and keeps the
+ * longest call. The budget is not enforced, a hook that overruns still runs
+ * every sample set. Read over cmd_isr_hooks.
+ */
+
+#ifndef __ISRHOOK_H__
+#define __ISRHOOK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief A per sample hook
+ *
+ * @param[in] i_raw Raw I_out, offset corrected
+ * @param[in] v_in_raw Raw V_in
+ * @param[in] v_out_raw Raw V_out
+ * @note Called from the ADC ISR
+ */
+typedef void (*isrhook_func_t)(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw);
+
+/** @brief Hook slots, in the order they run and of cmd_isr_hooks */
+typedef enum {
+    isrhook_limit = 0,      /**< CV/CC regime detection of the screens */
+    isrhook_vout_loop,      /**< The V_out control loop */
+    isrhook_energy,         /**< Energy and charge accumulators */
+    isrhook_winstats,       /**< Window statistics */
+    isrhook_recorder,       /**< ADC recorder */
+    isrhook_funcgen,        /**< The function generator's DDS */
+    isrhook_lockin,         /**< Lock-in demodulator, reads the DDS phase */
+    isrhook_adcnoise,       /**< ADC noise windows of the calibration screen */
+    isrhook_count
+} isrhook_slot_t;
+
+/**
+ * @brief Default budgets in cycles
+ *
+ * At 48MHz the ADC ISR has some 2300 cycles between two sample sets at
+ * 21kHz, the hooks together have to stay well below that.
+ */
+#define ISRHOOK_BUDGET_LIMIT      (150)
+#define ISRHOOK_BUDGET_VOUT_LOOP  (200)
+#define ISRHOOK_BUDGET_ENERGY     (100)
+#define ISRHOOK_BUDGET_WINSTATS   (100)
+#define ISRHOOK_BUDGET_RECORDER   (100)
+#define ISRHOOK_BUDGET_FUNCGEN    (300)
+#define ISRHOOK_BUDGET_LOCKIN     (250)
+#define ISRHOOK_BUDGET_ADCNOISE   (150)
+
+/** @brief Accounting of one slot */
+typedef struct {
+    bool enabled;           /**< A hook is set */
+    uint16_t budget;        /**< Budget in cycles */
+    uint32_t runs;          /**< Calls */
+    uint32_t overruns;      /**< Calls that took longer than the budget */
+    uint32_t max_cycles;    /**< Longest call */
+} isrhook_stats_t;
+
+/**
+ * @brief Set or clear the hook of a slot
+ *
+ * @param[in] slot The slot
+ * @param[in] func The hook, NULL disables the slot
+ * @param[in] budget_cycles Cycles the hook is expected to need at most
+ * @note The accounting of the slot is kept, see isrhook_reset_stats()
+ */
+void isrhook_set(isrhook_slot_t slot, isrhook_func_t func, uint16_t budget_cycles);
+
+/**
+ * @brief Check if a hook is set
+ *
+ * @param[in] slot The slot
+ * @return true if the slot holds a hook
+ */
+bool isrhook_enabled(isrhook_slot_t slot);
+
+/**
+ * @brief Check if the slot holds a specific hook
+ *
+ * @param[in] slot The slot
+ * @param[in] func The hook
+ * @return true if func is the hook of the slot
+ */
+bool isrhook_is(isrhook_slot_t slot, isrhook_func_t func);
+
+/**
+ * @brief Run the enabled hooks in slot order, called from the ADC ISR for
+ *        each sample set
+ *
+ * @param[in] i_raw Raw I_out, offset corrected
+ * @param[in] v_in_raw Raw V_in
+ * @param[in] v_out_raw Raw V_out
+ */
+void isrhook_run(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw);
+
+/**
+ * @brief Get the accounting of a slot
+ *
+ * @param[in] slot The slot
+ * @param[out] stats Receives the accounting
+ * @return false if there is no such slot
+ */
+bool isrhook_get_stats(isrhook_slot_t slot, isrhook_stats_t *stats);
+
+/**
+ * @brief Clear the accounting of all slots
+ *
+ * @note The ADC ISR owns the counters, they are cleared at the start of the
+ *       next sample set
+ */
+void isrhook_reset_stats(void);
+
+/**
+ * @brief The cycle counter the hooks are timed with, provided by hw.c
+ *
+ * @return Free running count of CPU cycles
+ */
+uint32_t isrhook_clock(void);
+
+#endif // __ISRHOOK_H__
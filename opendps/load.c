@@ -0,0 +1,114 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <cortex.h>
+#include "hw.h"
+#include "load.h"
+
+/** Totals since power up, the unsigned differences survive wrapping */
+static volatile uint32_t isr_us;
+static volatile uint32_t isr_calls;
+static volatile uint32_t isr_overruns;
+/** Longest ISR run in the current window */
+static volatile uint16_t isr_max_us;
+static uint32_t idle_us;
+
+/** Time and totals when the current window was opened */
+static uint32_t window_start;
+static uint32_t window_isr_us;
+static uint32_t window_idle_us;
+
+/** The last closed window */
+static load_stats_t last;
+
+void load_init(void)
+{
+    cm_disable_interrupts();
+    isr_us = isr_calls = isr_overruns = 0;
+    isr_max_us = 0;
+    cm_enable_interrupts();
+    idle_us = 0;
+    window_isr_us = window_idle_us = 0;
+    window_start = cur_time_us();
+    last = (load_stats_t) { 0 };
+}
+
+void load_isr_done(uint16_t us)
+{
+    isr_us += us;
+    isr_calls++;
+    if (us > isr_max_us) {
+        isr_max_us = us;
+    }
+}
+
+void load_isr_overrun(void)
+{
+    isr_overruns++;
+}
+
+void load_sleep(void)
+{
+    uint32_t start = cur_time_us();
+    uint32_t isr_start = isr_us;
+    hw_wait_for_interrupt();
+    uint32_t slept = cur_time_us() - start;
+    /** The ISR that woke us, and any that followed, was not idle time */
+    uint32_t busy = isr_us - isr_start;
+    if (slept > busy) {
+        idle_us += slept - busy;
+    }
+}
+
+void load_tick(void)
+{
+    uint32_t now = cur_time_us();
+    uint32_t span_ms = (now - window_start) / 1000;
+    if (span_ms < LOAD_WINDOW_MS) {
+        return;
+    }
+    uint32_t isr_total = isr_us;
+    /** Both deltas are at most the span, us / ms gives 1/1000 */
+    uint32_t idle = (idle_us - window_idle_us) / span_ms;
+    uint32_t isr = (isr_total - window_isr_us) / span_ms;
+    last.window_ms = span_ms > UINT16_MAX ? UINT16_MAX : span_ms;
+    last.idle_permille = idle > 1000 ? 1000 : idle;
+    last.isr_permille = isr > 1000 ? 1000 : isr;
+    cm_disable_interrupts();
+    last.isr_max_us = isr_max_us;
+    isr_max_us = 0;
+    cm_enable_interrupts();
+    window_start = now;
+    window_isr_us = isr_total;
+    window_idle_us = idle_us;
+}
+
+void load_get(load_stats_t *stats)
+{
+    *stats = last;
+    stats->isr_calls = isr_calls;
+    stats->overruns = isr_overruns;
+}
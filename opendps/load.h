@@ -0,0 +1,117 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file load.h
+ * @brief CPU load and ADC ISR headroom meter
+ *
+ * Available with CONFIG_LOAD_METER. Times are taken from the 1MHz TIM3 time
+ * base, which unlike the DWT cycle counter keeps running while the CPU sleeps.
+ *
+ * The main loop sleeps through load_sleep() which accounts the time spent in
+ * WFI, less the ADC ISR time that elapsed meanwhile, as idle. Other (short)
+ * interrupts serviced while asleep are counted as idle. The ADC ISR is
+ * bracketed by LOAD_ISR_BEGIN() and LOAD_ISR_END() and reports an overrun via
+ * load_isr_overrun() when the next conversion completed before it was done.
+ *
+ * load_tick() closes a measurement window every LOAD_WINDOW_MS and the
+ * closed window is read with load_get(), over cmd_load_stats or on the load
+ * screen of the settings UI.
+ *
+ * Without CONFIG_LOAD_METER the macros expand to nothing.
+ */
+
+#ifndef __LOAD_H__
+#define __LOAD_H__
+
+#include <stdint.h>
+
+/** @brief Length of a measurement window */
+#define LOAD_WINDOW_MS (1000)
+
+/**
+ * @brief Load of the last closed window, ratios in 1/1000 of the window
+ */
+typedef struct {
+    uint16_t window_ms;     /** Actual length of the window */
+    uint16_t idle_permille; /** Main loop asleep in WFI */
+    uint16_t isr_permille;  /** Spent in the ADC ISR */
+    uint16_t isr_max_us;    /** Longest ADC ISR run */
+    uint32_t isr_calls;     /** ADC ISR runs since power up */
+    uint32_t overruns;      /** ADC ISR overruns since power up */
+} load_stats_t;
+
+#ifdef CONFIG_LOAD_METER
+
+#include <timer.h>
+
+/** @brief Start timing the ADC ISR, opens a scope local variable */
+#define LOAD_ISR_BEGIN() uint16_t load_isr_start = (uint16_t) timer_get_counter(TIM3)
+
+/** @brief Stop timing the ADC ISR, the 16 bit difference handles the wrap */
+#define LOAD_ISR_END() load_isr_done((uint16_t) (timer_get_counter(TIM3) - load_isr_start))
+
+/**
+ * @brief Clear the statistics and open the first window
+ */
+void load_init(void);
+
+/**
+ * @brief Record one ADC ISR run, called from the ISR
+ *
+ * @param[in] us Time spent in microseconds
+ */
+void load_isr_done(uint16_t us);
+
+/**
+ * @brief Count an ADC ISR overrun, called from the ISR
+ */
+void load_isr_overrun(void);
+
+/**
+ * @brief Sleep until the next interrupt, accounting the time as idle
+ */
+void load_sleep(void);
+
+/**
+ * @brief Close the current window when LOAD_WINDOW_MS has passed, called
+ *        from the main loop
+ */
+void load_tick(void);
+
+/**
+ * @brief Get the load of the last closed window
+ *
+ * @param[out] stats Filled in with the statistics
+ */
+void load_get(load_stats_t *stats);
+
+#else // CONFIG_LOAD_METER
+
+#define LOAD_ISR_BEGIN()
+#define LOAD_ISR_END()
+
+#endif // CONFIG_LOAD_METER
+
+#endif // __LOAD_H__
@@ -0,0 +1,127 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lockin.h"
+#include "wavegen.h"
+#include "ramfunc.h"
+
+/** A quarter turn of a wavegen phase, turns a sine into a cosine */
+#define QUARTER_TURN  (0x40000000)
+
+/** Sums of the sample sets, the products carry 15 fractional bits */
+typedef struct {
+    uint32_t samples;
+    uint32_t sum_i, sum_v;
+    int64_t sum_cos, sum_sin;
+    int64_t i_cos, i_sin;
+    int64_t v_cos, v_sin;
+} lockin_acc_t;
+
+static volatile lockin_state_t state;
+static uint32_t settle_left, periods_left;
+static uint32_t last_phase;
+static lockin_acc_t acc;
+
+bool lockin_start(uint32_t settle, uint32_t periods)
+{
+    if (periods == 0) {
+        return false;
+    }
+    /** The ISR leaves the sums alone until the state reads waiting */
+    state = lockin_idle;
+    acc = (lockin_acc_t) { 0 };
+    settle_left = settle;
+    periods_left = periods;
+    last_phase = 0;
+    state = lockin_waiting;
+    return true;
+}
+
+RAMFUNC_HOOK void lockin_sample(uint32_t phase, uint16_t i_out, uint16_t v_out)
+{
+    if (state != lockin_waiting && state != lockin_running) {
+        return;
+    }
+    bool wrapped = phase < last_phase;
+    last_phase = phase;
+    if (wrapped) {
+        if (state == lockin_waiting) {
+            if (settle_left) {
+                settle_left--;
+            } else {
+                state = lockin_running;
+            }
+        } else if (--periods_left == 0) {
+            state = lockin_done;
+            return;
+        }
+    }
+    if (state != lockin_running) {
+        return;
+    }
+    int32_t s = wavegen_sin_q15(phase);
+    int32_t c = wavegen_sin_q15(phase + QUARTER_TURN);
+    acc.samples++;
+    acc.sum_i += i_out;
+    acc.sum_v += v_out;
+    acc.sum_cos += c;
+    acc.sum_sin += s;
+    acc.i_cos += (int32_t) i_out * c;
+    acc.i_sin += (int32_t) i_out * s;
+    acc.v_cos += (int32_t) v_out * c;
+    acc.v_sin += (int32_t) v_out * s;
+}
+
+/**
+  * @brief Project a channel on the reference, the mean removed
+  * @param sum_x_ref sum of the samples times the reference
+  * @param mean mean of the samples with LOCKIN_FRAC_BITS
+  * @param sum_ref sum of the reference
+  * @retval the component with LOCKIN_FRAC_BITS, 2/n times the mean free sum
+  */
+static int32_t project(int64_t sum_x_ref, uint32_t mean, int64_t sum_ref)
+{
+    int64_t sum = sum_x_ref - (((int64_t) mean * sum_ref) >> LOCKIN_FRAC_BITS);
+    /** 2 * sum / n has 15 fractional bits */
+    return (int32_t) (sum / ((int64_t) acc.samples << (15 - LOCKIN_FRAC_BITS - 1)));
+}
+
+void lockin_get(lockin_result_t *result)
+{
+    *result = (lockin_result_t) { .state = state };
+    if (result->state != lockin_done || acc.samples == 0) {
+        return;
+    }
+    uint32_t n = acc.samples;
+    result->samples = n;
+    result->i_dc = (((uint64_t) acc.sum_i << LOCKIN_FRAC_BITS) + n / 2) / n;
+    result->v_dc = (((uint64_t) acc.sum_v << LOCKIN_FRAC_BITS) + n / 2) / n;
+    /** x = A sin(wt + p) = A cos(p) sin(wt) + A sin(p) cos(wt) */
+    result->i_re = project(acc.i_sin, result->i_dc, acc.sum_sin);
+    result->i_im = project(acc.i_cos, result->i_dc, acc.sum_cos);
+    result->v_re = project(acc.v_sin, result->v_dc, acc.sum_sin);
+    result->v_im = project(acc.v_cos, result->v_dc, acc.sum_cos);
+}
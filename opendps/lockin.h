@@ -0,0 +1,112 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+/**
+ * @file lockin.h
+ * @brief Lock-in measurement of the load impedance
+ *
+ * Correlates every I_out and V_out sample of the ADC ISR with the sine and
+ * cosine of the function generator's phase, a synchronous demodulator. Over
+ * whole periods of the generator this yields the amplitude and phase of the
+ * I_out and V_out components at the generator frequency, the load
+ * impedance is their ratio V / I.
+ *
+ * ## Operation
+ *
+ * ```
+ * lockin_start() -> waiting -> <settle> periods -> running -> <periods> periods -> done
+ * ```
+ *
+ * Accumulation starts where the generator's phase wraps, so the sums always
+ * cover whole periods and reject DC and the harmonics of the generator.
+ * Each sample costs two wavetable lookups and four 32 bit multiply
+ * accumulates into 64 bit sums.
+ *
+ * Phasors are raw ADC counts with LOCKIN_FRAC_BITS fractional bits, the host
+ * scales them with the ADC calibration (V_ADC_K, A_ADC_K). A constant delay
+ * between the generator phase and the samples turns both phasors alike and
+ * cancels out of the impedance.
+ *
+ * @note Enabled by CONFIG_LOCKIN, needs the ISR driven function generator
+ */
+
+#ifndef __LOCKIN_H__
+#define __LOCKIN_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** @brief Fractional bits of the phasors and DC levels */
+#define LOCKIN_FRAC_BITS  (8)
+
+/**
+ * @brief Measurement states
+ */
+typedef enum {
+    lockin_idle = 0,    /**< Nothing measured */
+    lockin_waiting,     /**< Waiting for the settle periods to pass */
+    lockin_running,     /**< Accumulating */
+    lockin_done,        /**< Result ready */
+} lockin_state_t;
+
+/**
+ * @brief Result of a measurement
+ */
+typedef struct {
+    lockin_state_t state;   /**< Current state, the rest is valid when done */
+    uint32_t samples;       /**< Sample sets accumulated */
+    uint32_t i_dc;          /**< Mean I_out */
+    uint32_t v_dc;          /**< Mean V_out */
+    int32_t i_re, i_im;     /**< I_out phasor against the generator's sine */
+    int32_t v_re, v_im;     /**< V_out phasor against the generator's sine */
+} lockin_result_t;
+
+/**
+ * @brief Start a measurement, dropping the previous result
+ *
+ * @param settle   Generator periods to skip before accumulating
+ * @param periods  Generator periods to accumulate, at least 1
+ * @return false if periods is 0
+ */
+bool lockin_start(uint32_t settle, uint32_t periods);
+
+/**
+ * @brief Accumulate one sample set
+ *
+ * @param phase  The generator's phase, 0 to 2^32 for one period
+ * @param i_out  Raw I_out sample
+ * @param v_out  Raw V_out sample
+ * @note Called from the ADC interrupt for every sample set
+ */
+void lockin_sample(uint32_t phase, uint16_t i_out, uint16_t v_out);
+
+/**
+ * @brief Get the state and, once done, the result of the measurement
+ *
+ * @param result Filled in with the result
+ */
+void lockin_get(lockin_result_t *result);
+
+#endif // __LOCKIN_H__
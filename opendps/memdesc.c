@@ -0,0 +1,82 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "memdesc.h"
+#ifdef CONFIG_ADC_RECORDER
+#include "recorder.h"
+#endif // CONFIG_ADC_RECORDER
+#ifdef CONFIG_ENERGY_METER
+#include "energy.h"
+#endif // CONFIG_ENERGY_METER
+
+#ifdef CONFIG_MEMDESC_BYTES
+_Static_assert (sizeof(memdesc_t) == CONFIG_MEMDESC_BYTES, "MEMDESC_BYTES in the Makefile must match memdesc_t");
+#endif // CONFIG_MEMDESC_BYTES
+
+/** Placed at MEMDESC_ADDRESS, not cleared by the startup code */
+memdesc_t memdesc __attribute__((section(".memdesc")));
+
+void memdesc_init(void)
+{
+    memdesc.magic = 0;
+    memdesc.version = MEMDESC_VERSION;
+    memdesc.count = 0;
+#ifdef CONFIG_ADC_RECORDER
+    recorder_memdesc();
+#endif // CONFIG_ADC_RECORDER
+#ifdef CONFIG_ENERGY_METER
+    (void) memdesc_add(MEMDESC_ID_ENERGY, &energy_acc, sizeof(energy_acc));
+#endif // CONFIG_ENERGY_METER
+    /** Last, a reader ignores the descriptor until it is complete */
+    memdesc.magic = MEMDESC_MAGIC;
+}
+
+memdesc_entry_t *memdesc_add(uint32_t id, const volatile void *address, uint32_t length)
+{
+    if (memdesc.count >= MEMDESC_ENTRIES) {
+        return NULL;
+    }
+    memdesc_entry_t *entry = &memdesc.entries[memdesc.count++];
+    entry->id = id;
+    entry->address = (uint32_t) (uintptr_t) address;
+    entry->length = length;
+    entry->seq = 0;
+    return entry;
+}
+
+void memdesc_begin(memdesc_entry_t *entry)
+{
+    if (entry && !(entry->seq & 1)) {
+        entry->seq++;
+    }
+}
+
+void memdesc_end(memdesc_entry_t *entry)
+{
+    if (entry && (entry->seq & 1)) {
+        entry->seq++;
+    }
+}
@@ -0,0 +1,122 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file memdesc.h
+ * @brief RAM descriptor for reading capture buffers over SWD
+ *
+ * Available with CONFIG_SWD_READOUT. Pulling a recording over the serial
+ * protocol takes seconds, a debug probe reads the same RAM in a fraction
+ * of that while the firmware keeps running. The descriptor lists where the
+ * buffers are and sits at MEMDESC_ADDRESS, just below the bootcom area, so
+ * `ocd-client.py readout` finds it without the map file.
+ *
+ * Each entry has a four character id, the address and length of a buffer
+ * and a sequence number. The sequence number is odd while the owner is
+ * changing the buffer as a whole and is bumped to the next even number
+ * when it is consistent again. A reader checks that it is even and the
+ * same before and after reading. Entries that are updated continuously,
+ * like the energy sums, keep it at 0 and are read until two reads agree.
+ *
+ * | Id   | Buffer |
+ * |------|--------|
+ * | RECS | ADC recorder sample ring |
+ * | RECL | recorder_layout_t of the last finished recording |
+ * | ENRG | energy_acc_t, live |
+ */
+
+#ifndef __MEMDESC_H__
+#define __MEMDESC_H__
+
+#include <stdint.h>
+
+/** @brief "MDSC" */
+#define MEMDESC_MAGIC    (0x4353444d)
+#define MEMDESC_VERSION  (1)
+#define MEMDESC_ENTRIES  (4)
+
+/** @brief Entry id from four characters, in memory order */
+#define MEMDESC_ID(a, b, c, d) \
+    ((uint32_t) (a) | (uint32_t) (b) << 8 | (uint32_t) (c) << 16 | (uint32_t) (d) << 24)
+
+#define MEMDESC_ID_REC_SAMPLES  MEMDESC_ID('R', 'E', 'C', 'S')
+#define MEMDESC_ID_REC_LAYOUT   MEMDESC_ID('R', 'E', 'C', 'L')
+#define MEMDESC_ID_ENERGY       MEMDESC_ID('E', 'N', 'R', 'G')
+
+/**
+ * @brief One buffer
+ */
+typedef struct {
+    uint32_t id;            /** MEMDESC_ID() */
+    uint32_t address;       /** Start of the buffer */
+    uint32_t length;        /** Length in bytes */
+    volatile uint32_t seq;  /** Odd while the buffer is being changed */
+} memdesc_entry_t;
+
+/**
+ * @brief The descriptor, placed at MEMDESC_ADDRESS by the linker script
+ */
+typedef struct {
+    uint32_t magic;         /** MEMDESC_MAGIC once initialized */
+    uint16_t version;       /** MEMDESC_VERSION */
+    uint16_t count;         /** Entries in use */
+    memdesc_entry_t entries[MEMDESC_ENTRIES];
+} memdesc_t;
+
+/** @brief Where the linker puts the descriptor, below the 16 byte bootcom area */
+#define MEMDESC_ADDRESS (0x20001ff0 - sizeof(memdesc_t))
+
+extern memdesc_t memdesc;
+
+/**
+ * @brief Initialize the descriptor and add the buffers of the enabled features
+ */
+void memdesc_init(void);
+
+/**
+ * @brief Add a buffer
+ * @param id MEMDESC_ID() of the buffer
+ * @param address start of the buffer
+ * @param length length in bytes
+ * @retval memdesc_entry_t* the entry, NULL if the descriptor is full
+ */
+memdesc_entry_t *memdesc_add(uint32_t id, const volatile void *address, uint32_t length);
+
+/**
+ * @brief Mark the buffer of an entry as being changed, the sequence number
+ * turns odd
+ * @param entry the entry, NULL is ignored
+ * @retval none
+ */
+void memdesc_begin(memdesc_entry_t *entry);
+
+/**
+ * @brief Mark the buffer of an entry as consistent, the sequence number
+ * turns even
+ * @param entry the entry, NULL is ignored
+ * @retval none
+ */
+void memdesc_end(memdesc_entry_t *entry);
+
+#endif // __MEMDESC_H__
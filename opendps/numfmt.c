@@ -0,0 +1,96 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "numfmt.h"
+
+const uint32_t numfmt_pow10_table[NUMFMT_MAX_DIGITS] = {
+    1,
+    10,
+    100,
+    1000,
+    10000,
+    100000,
+    1000000,
+    10000000,
+    100000000,
+    1000000000,
+};
+
+/**
+ * @brief      Take the digit at one power of ten off a value
+ *
+ * @param      value  The value, must be below 10 times the power
+ * @param[in]  exp    The power of ten
+ *
+ * @return     The digit
+ */
+static inline uint8_t take_digit(uint32_t *value, uint32_t exp)
+{
+    uint32_t p = numfmt_pow10_table[exp];
+    uint8_t digit = 0;
+    while (*value >= p) {
+        *value -= p;
+        digit++;
+    }
+    return digit;
+}
+
+void numfmt_digits(uint32_t value, uint32_t low, uint32_t count, uint8_t *digits)
+{
+    uint32_t exp = NUMFMT_MAX_DIGITS;
+    /** Drop the digits above the wanted ones, from the top so each step stays below 10 */
+    while (exp-- > low + count) {
+        (void) take_digit(&value, exp);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        digits[i] = take_digit(&value, low + count - 1 - i);
+    }
+}
+
+uint32_t numfmt_int(char *buf, uint32_t size, int32_t value)
+{
+    uint8_t digits[NUMFMT_MAX_DIGITS];
+    uint32_t magnitude = value < 0 ? -(uint32_t) value : (uint32_t) value;
+    uint32_t count = 1;
+    uint32_t len = 0;
+    if (size == 0) {
+        return 0;
+    }
+    while (count < NUMFMT_MAX_DIGITS && magnitude >= numfmt_pow10_table[count]) {
+        count++;
+    }
+    if ((value < 0) + count >= size) {
+        buf[0] = 0;
+        return 0;
+    }
+    numfmt_digits(magnitude, 0, count, digits);
+    if (value < 0) {
+        buf[len++] = '-';
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        buf[len++] = '0' + digits[i];
+    }
+    buf[len] = 0;
+    return len;
+}
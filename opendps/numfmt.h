@@ -0,0 +1,82 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file numfmt.h
+ * @brief Integer to decimal conversion for the UI and the protocol
+ *
+ * The display redraws numbers digit by digit and the remote control
+ * readback converts every parameter to a string. Both are done here with a
+ * table of powers of ten and repeated subtraction, at most nine compares
+ * per digit, instead of a division and a modulo (or a loop computing the
+ * power) for each digit.
+ */
+
+#ifndef __NUMFMT_H__
+#define __NUMFMT_H__
+
+#include <stdint.h>
+
+/** @brief Number of decimal digits in the largest uint32_t */
+#define NUMFMT_MAX_DIGITS  (10)
+
+/** @brief 10^0 .. 10^9 */
+extern const uint32_t numfmt_pow10_table[NUMFMT_MAX_DIGITS];
+
+/**
+ * @brief      Power of ten
+ *
+ * @param[in]  exp   Exponent, 0..9
+ *
+ * @return     10^exp, 0 if exp is out of range
+ */
+static inline uint32_t numfmt_pow10(uint32_t exp)
+{
+    return exp < NUMFMT_MAX_DIGITS ? numfmt_pow10_table[exp] : 0;
+}
+
+/**
+ * @brief      Split a value into a fixed number of decimal digits
+ *
+ * @param[in]  value   The value
+ * @param[in]  low     Power of ten of the least significant digit wanted
+ * @param[in]  count   Number of digits wanted, low + count <= NUMFMT_MAX_DIGITS
+ * @param[out] digits  Receives count digits 0..9, most significant first.
+ *                     Digits above low + count - 1 are dropped.
+ */
+void numfmt_digits(uint32_t value, uint32_t low, uint32_t count, uint8_t *digits);
+
+/**
+ * @brief      Format a signed integer, like snprintf with "%d"
+ *
+ * @param      buf   The output buffer, always terminated if size > 0
+ * @param[in]  size  Size of buf
+ * @param[in]  value The value
+ *
+ * @return     Number of characters written, excluding the terminator. 0 if
+ *             the number did not fit, buf is then empty.
+ */
+uint32_t numfmt_int(char *buf, uint32_t size, int32_t value);
+
+#endif // __NUMFMT_H__
@@ -33,8 +33,10 @@
 #include <timer.h>
 #include "dbg_printf.h"
 #include "tick.h"
+#include "bootcom.h"
 #include "tft.h"
 #include "event.h"
+#include "sched.h"
 #include "hw.h"
 #include "pwrctl.h"
 #include "protocol.h"
@@ -66,18 +68,33 @@
 #include "opendps.h"
 #include "settings_calibration.h"
 #include "my_assert.h"
-#ifdef CONFIG_CV_ENABLE
-#include "func_cv.h"
-#endif // CONFIG_CV_ENABLE
-#ifdef CONFIG_CC_ENABLE
-#include "func_cc.h"
-#endif // CONFIG_CC_ENABLE
-#ifdef CONFIG_CL_ENABLE
-#include "func_cl.h"
-#endif // CONFIG_CL_ENABLE
-#ifdef CONFIG_FUNCGEN_ENABLE
-#include "func_gen.h"
-#endif // CONFIG_FUNCGEN_ENABLE
+#include "perf.h"
+#include "trace.h"
+#if defined(CONFIG_PRESETS) || defined(CONFIG_FUNC_STAGING)
+#include "numfmt.h"
+#endif // CONFIG_PRESETS || CONFIG_FUNC_STAGING
+#ifdef CONFIG_SWD_READOUT
+#include "memdesc.h"
+#endif // CONFIG_SWD_READOUT
+#ifdef CONFIG_LOAD_METER
+#include "load.h"
+#include "settings_load.h"
+#endif // CONFIG_LOAD_METER
+#ifdef CONFIG_STACK_MONITOR
+#include "stackmon.h"
+#endif // CONFIG_STACK_MONITOR
+#ifdef CONFIG_ENERGY_METER
+#include "settings_energy.h"
+#endif // CONFIG_ENERGY_METER
+#ifdef CONFIG_TREND_PLOT
+#include "settings_trend.h"
+#endif // CONFIG_TREND_PLOT
+#ifdef CONFIG_WINDOW_STATS
+#include "winstats.h"
+#endif // CONFIG_WINDOW_STATS
+#ifdef CONFIG_CAL_LUT
+#include "cal_lut.h"
+#endif // CONFIG_CAL_LUT
 
 #ifdef DPS_EMULATOR
 #include "dpsemul.h"
@@ -90,12 +107,65 @@
 #define TFT_HEIGHT  (128)
 #define TFT_WIDTH   (128)
 
+/** Time the display controller needs after init before it is cleared (ms) */
+#define TFT_SETTLE_MS  (50)
+
+#ifdef CONFIG_SPLASH_SCREEN
+/** How long the splash screen is shown (ms) */
+#ifdef CONFIG_SPLASH_MS
+#define SPLASH_MS  (CONFIG_SPLASH_MS)
+#else
+#define SPLASH_MS  (750)
+#endif
+#endif // CONFIG_SPLASH_SCREEN
+
 /** How ofter we update the measurements in the UI (ms) */
 #define UI_UPDATE_INTERVAL_MS  (250)
 
+#ifdef CONFIG_ADAPTIVE_UI
+/** UI update interval once the readings have settled (ms) */
+#ifdef CONFIG_UI_IDLE_INTERVAL_MS
+#define UI_IDLE_INTERVAL_MS  (CONFIG_UI_IDLE_INTERVAL_MS)
+#else
+#define UI_IDLE_INTERVAL_MS  (1000)
+#endif
+/** Slow down after this long without input or published changes (ms) */
+#ifdef CONFIG_UI_IDLE_AFTER_MS
+#define UI_IDLE_AFTER_MS  (CONFIG_UI_IDLE_AFTER_MS)
+#else
+#define UI_IDLE_AFTER_MS  (2000)
+#endif
+#endif // CONFIG_ADAPTIVE_UI
+
+#ifndef CONFIG_BUTTON_TIMER
+/** How often we check if a held button became a long press (ms) */
+#define LONGPRESS_CHECK_INTERVAL_MS  (10)
+#endif // CONFIG_BUTTON_TIMER
+
+#ifdef CONFIG_ROTARY_QEI
+/** How often the rotary encoder position is turned into events (ms) */
+#define ROTARY_POLL_INTERVAL_MS  (10)
+#endif // CONFIG_ROTARY_QEI
+
+/** How late the periodic jobs may start before it counts as a miss (ms),
+    see sched_watch() */
+#define UI_TICK_DEADLINE_MS  (50)
+#define INPUT_POLL_DEADLINE_MS  (10)
+#define CHIP_TEMP_DEADLINE_MS  (50)
+
 /** Timeout for waiting for wifi connction (ms) */
 #define WIFI_CONNECT_TIMEOUT  (10000)
 
+#ifdef CONFIG_PAST_WRITE_BEHIND
+/** Queued settings are written to flash after this long without user input
+  * (ms). A power failure writes them right away so they can wait longer */
+#ifdef CONFIG_POWER_FAIL
+ #define PAST_FLUSH_DELAY_MS  (15000)
+#else
+ #define PAST_FLUSH_DELAY_MS  (3000)
+#endif // CONFIG_POWER_FAIL
+#endif // CONFIG_PAST_WRITE_BEHIND
+
 /** Blit positions */
 #define XPOS_WIFI     (4)
 #define XPOS_LOCK    (27)
@@ -114,22 +184,58 @@ static void ui_flash(void);
 static void read_past_settings(void);
 static void write_past_settings(void);
 static void check_master_reset(void);
+static void ui_tick(void);
+static void tft_flash(void);
+static void wifi_flash(void);
+static void lock_flash(void);
+static void wifi_connect_timeout(void);
+static void ui_redraw(void);
+static uint8_t backlight_level(void);
+#ifdef CONFIG_NOTIFY
+static void notify_state(void);
+#endif // CONFIG_NOTIFY
+#ifdef CONFIG_ADAPTIVE_UI
+static void ui_activity(void);
+#endif // CONFIG_ADAPTIVE_UI
+
+/** Startup timestamps (ms), see opendps_boot_times() */
+static uint32_t boot_times[boot_phases];
 
 /** UI settings */
 static uint16_t bg_color;
 static uint32_t ui_width;
 static uint32_t ui_height;
+/** Set when opendps_set_setpoint changed values the display has not caught up with */
+static bool setpoint_pending;
+
+/** Periodic UI jobs */
+static sched_job_t ui_tick_job;
+#ifdef CONFIG_ADAPTIVE_UI
+/** Time of the last input or published change, and if ui_tick_job runs slow */
+static uint64_t last_ui_activity;
+static bool ui_idle;
+#endif // CONFIG_ADAPTIVE_UI
+/** Screen changes are drawn by this job so commands can reply first */
+static sched_job_t ui_redraw_job;
+static bool ui_clear_pending;
+#ifndef CONFIG_BUTTON_TIMER
+static sched_job_t longpress_job;
+#endif // CONFIG_BUTTON_TIMER
+#ifdef CONFIG_ROTARY_QEI
+static sched_job_t rotary_job;
+#endif // CONFIG_ROTARY_QEI
 
 /** Used to make the screen flash */
-static uint32_t tft_flashing_period;
+static sched_job_t tft_flash_job;
 static uint32_t tft_flash_counter;
 
 /** Used for flashing the wifi icon */
-static uint32_t wifi_status_flashing_period;
+static sched_job_t wifi_flash_job;
+static sched_job_t wifi_timeout_job;
 static bool wifi_status_visible;
 
 /** Used for flashing the lock icon */
-static uint32_t lock_flashing_period;
+static sched_job_t lock_flash_job;
 static bool lock_visible;
 static uint32_t lock_flash_counter;
 
@@ -139,9 +245,26 @@ static bool is_locked;
 static bool is_temperature_locked;
 static bool is_enabled;
 
+/** State of opendps_get_status() that is not read from elsewhere */
+static uint16_t status_latched;     /** PING_STATUS_OCP/OVP until the output is enabled again */
+static bool status_cc;
+static uint16_t status_seq;
+static uint16_t status_last;
+
+/** State of the power icon on the display, it is only redrawn when this
+    changes or the display has been cleared */
+static bool power_icon_drawn;
+static bool power_icon_enabled;
+static uint32_t power_icon_clear_count;
+
 /** Last settings written to past */
 static bool     last_tft_inv_setting;
 
+#ifdef CONFIG_PAST_WRITE_BEHIND
+/** Time of the last button or encoder event, for flushing queued past writes */
+static uint64_t last_ui_event;
+#endif // CONFIG_PAST_WRITE_BEHIND
+
 #ifdef CONFIG_THERMAL_LOCKOUT
 /** Temperature readings, invalid at start */
 static int16_t temp1 = INVALID_TEMPERATURE;
@@ -152,6 +275,11 @@ static int16_t temp2 = INVALID_TEMPERATURE;
     73% is closest to previous default (0x5DC0) */
 static int8_t last_tft_brightness = 73;
 
+#ifdef CONFIG_HEADLESS
+/** Nothing is drawn and the backlight is off, see opendps_set_headless() */
+static bool headless;
+#endif // CONFIG_HEADLESS
+
 #ifndef CONFIG_TEMPERATURE_ALERT_LEVEL
  #define CONFIG_TEMPERATURE_ALERT_LEVEL  (500)
 #endif // CONFIG_TEMPERATURE_ALERT_LEVEL
@@ -160,12 +288,52 @@ static int8_t last_tft_brightness = 73;
 /** Temperature when the DPS goes into shutdown mode,
     in x10 degrees whatever-temperature-unit-you-prefer */
 static int16_t shutdown_temperature = CONFIG_TEMPERATURE_ALERT_LEVEL;
+/** Set while the temperatures reported by the host are above it */
+static bool host_temperature_alert;
 #endif // CONFIG_THERMAL_LOCKOUT
 
+#ifdef CONFIG_PRESETS
+/** A preset slot, stored as unit past_preset_0 + slot up to the used values */
+typedef struct {
+    uint8_t function;   /** Index in func_ui, PRESET_EMPTY if never saved */
+    uint8_t num_values;
+    uint16_t reserved;
+    int32_t values[MAX_PARAMETERS];
+} preset_t;
+#define PRESET_EMPTY  (0xff)
+#define PRESET_LENGTH(num_values)  (4 + 4 * (num_values))
+/** Read from past at boot so a recall does not walk the flash */
+static preset_t presets[CONFIG_PRESET_SLOTS];
+#endif // CONFIG_PRESETS
+
+#ifdef CONFIG_FUNC_STAGING
+/** Parameter values staged for a function by opendps_stage_parameter() */
+typedef struct {
+    uint32_t mask;      /** Bit n set if values[n] is staged */
+    int32_t values[MAX_PARAMETERS];
+} staged_t;
+/** Indexed like func_ui */
+static staged_t staged[MAX_SCREENS];
+#endif // CONFIG_FUNC_STAGING
+
+#ifdef CONFIG_CHIP_TEMP
+/** Die temperature (0.1 degrees C) that locks the output out, and how far
+    it must fall below it to unlock again */
+#ifndef CONFIG_CHIP_TEMP_ALERT_LEVEL
+ #define CONFIG_CHIP_TEMP_ALERT_LEVEL  (700)
+#endif // CONFIG_CHIP_TEMP_ALERT_LEVEL
+#define CHIP_TEMP_HYSTERESIS  (50)
+static sched_job_t chip_temp_job;
+static bool chip_temperature_alert;
+#endif // CONFIG_CHIP_TEMP
+
 /** Our parameter storage */
-static past_t g_past = {
-    .blocks = {0x0800f800, 0x0800fc00}
-};
+static past_t g_past;
+
+#ifndef DPS_EMULATOR
+/** Linker file symbols */
+extern uint32_t *_past_start;
+#endif // DPS_EMULATOR
 
 /** The function UI displaying the current active function */
 #define FUNC_UI_ID (0)
@@ -179,6 +347,17 @@ static uui_t main_ui;
 /** The UI we are currently displaying (func_ui or setting_ui) */
 static uui_t *current_ui;
 
+#ifdef CONFIG_NOTIFY
+/** State last passed to serial_notify(), see notify_state() */
+static struct {
+    bool output;
+    uint8_t screen;
+    uint8_t function;
+    uint32_t num_params;
+    int32_t params[MAX_PARAMETERS];
+} notified;
+#endif // CONFIG_NOTIFY
+
 
 static void main_ui_tick(void);
 
@@ -205,13 +384,17 @@ ui_number_t input_voltage = {
 };
 
 /* This is the screen definition */
-ui_screen_t main_screen = {
+static const ui_screen_desc_t main_screen_desc = {
     .name = "main",
     .tick = &main_ui_tick,
     .num_items = 1,
     .items = { (ui_item_t*) &input_voltage }
 };
 
+ui_screen_t main_screen = {
+    .desc = &main_screen_desc,
+};
+
 /**
  * @brief      List function names of device
  *
@@ -220,11 +403,11 @@ ui_screen_t main_screen = {
  *
  * @return     Number of items returned
  */
-uint32_t opendps_get_function_names(char* names[], size_t size)
+uint32_t opendps_get_function_names(const char* names[], size_t size)
 {
     uint32_t i;
     for (i = 0; i < current_ui->num_screens && i < size; i++) {
-        names[i] = current_ui->screens[i]->name;
+        names[i] = current_ui->screens[i]->desc->name;
     }
     return i;
 }
@@ -236,7 +419,7 @@ uint32_t opendps_get_function_names(char* names[], size_t size)
  */
 const char* opendps_get_curr_function_name(void)
 {
-    return (const char*) current_ui->screens[current_ui->cur_screen]->name;
+    return current_ui->screens[current_ui->cur_screen]->desc->name;
 }
 
 /**
@@ -274,10 +457,10 @@ uint32_t opendps_get_app_git_hash(const char** git_hash)
  *
  * @return     Number of items returned
  */
-uint32_t opendps_get_curr_function_params(ui_parameter_t **parameters)
+uint32_t opendps_get_curr_function_params(const ui_parameter_t **parameters)
 {
     uint32_t i = 0;
-    *parameters = (ui_parameter_t*) &current_ui->screens[current_ui->cur_screen]->parameters;
+    *parameters = current_ui->screens[current_ui->cur_screen]->desc->parameters;
     while ((*parameters)[i].name[0] != 0) {
         i++;
     }
@@ -293,10 +476,10 @@ uint32_t opendps_get_curr_function_params(ui_parameter_t **parameters)
  *
  * @return     true if param exists
  */
-bool opendps_get_curr_function_param_value(char *name, char *value, uint32_t value_len)
+bool opendps_get_curr_function_param_value(const char *name, char *value, uint32_t value_len)
 {
-    if (current_ui->screens[current_ui->cur_screen]->get_parameter) {
-        return ps_ok == current_ui->screens[current_ui->cur_screen]->get_parameter(name, value, value_len);
+    if (current_ui->screens[current_ui->cur_screen]->desc->get_parameter) {
+        return ps_ok == current_ui->screens[current_ui->cur_screen]->desc->get_parameter(name, value, value_len);
     }
     return false;
 }
@@ -309,18 +492,261 @@ bool opendps_get_curr_function_param_value(char *name, char *value, uint32_t val
  *
  * @return     Status of the operation
  */
-set_param_status_t opendps_set_parameter(char *name, char *value)
+set_param_status_t opendps_set_parameter(const char *name, char *value)
 {
     set_param_status_t status = ps_not_supported;
-    if (current_ui->screens[current_ui->cur_screen]->set_parameter) {
-        status = current_ui->screens[current_ui->cur_screen]->set_parameter(name, value);
+    if (current_ui->screens[current_ui->cur_screen]->desc->set_parameter) {
+        status = current_ui->screens[current_ui->cur_screen]->desc->set_parameter(name, value);
         if (status == ps_ok) {
             uui_refresh(current_ui, true);
+#ifdef CONFIG_NOTIFY
+            notify_state();
+#endif // CONFIG_NOTIFY
         }
     }
     return status;
 }
 
+/**
+ * @brief      Set the voltage and/or current setting of the current function
+ *             without going through the string parameters. The output follows
+ *             at once, the display is updated on the next UI tick.
+ *
+ * @param      mask  SETPOINT_VOLTAGE and/or SETPOINT_CURRENT
+ * @param      mv    Voltage in millivolt
+ * @param      ma    Current in milliampere
+ *
+ * @return     Status of the operation
+ */
+set_param_status_t opendps_set_setpoint(uint8_t mask, int32_t mv, int32_t ma)
+{
+    set_param_status_t status = ps_not_supported;
+    if (current_ui->screens[current_ui->cur_screen]->desc->set_setpoint) {
+        status = current_ui->screens[current_ui->cur_screen]->desc->set_setpoint(mask, mv, ma);
+        if (status == ps_ok) {
+            setpoint_pending = true;
+#ifdef CONFIG_NOTIFY
+            notify_state();
+#endif // CONFIG_NOTIFY
+        }
+    }
+    return status;
+}
+
+#if defined(CONFIG_PRESETS) || defined(CONFIG_FUNC_STAGING)
+/**
+ * @brief      Select a function for new values. Selecting another function
+ *             turns the output off, the current one is only reactivated.
+ *             Nothing is drawn until ui_redraw_job runs.
+ *
+ * @param[in]  index  Index of the function in func_ui
+ */
+static void select_function_deferred(uint32_t index)
+{
+    if (current_ui != &func_ui) {
+        (void) opendps_change_screen(FUNC_UI_ID);
+    }
+    if (index != func_ui.cur_screen) {
+        uui_set_screen_deferred(&func_ui, index);
+    } else {
+        uui_activate_deferred(&func_ui); /** Redraws the new values */
+    }
+}
+#endif // CONFIG_PRESETS || CONFIG_FUNC_STAGING
+
+#ifdef CONFIG_PRESETS
+/**
+ * @brief      Store the current function and its parameter values in a
+ *             preset slot, written to past with the other queued settings
+ *
+ * @param[in]  slot  The preset slot
+ *
+ * @return     true if the preset was stored
+ */
+bool opendps_save_preset(uint32_t slot)
+{
+    if (slot >= CONFIG_PRESET_SLOTS) {
+        return false;
+    }
+    const ui_screen_desc_t *desc = func_ui.screens[func_ui.cur_screen]->desc;
+    preset_t preset;
+    char value[12];
+    uint32_t i;
+    memset(&preset, 0, sizeof(preset));
+    preset.function = func_ui.cur_screen;
+    for (i = 0; i < MAX_PARAMETERS && desc->parameters[i].name[0]; i++) {
+        if (!desc->get_parameter || desc->get_parameter(desc->parameters[i].name, value, sizeof(value)) != ps_ok) {
+            return false;
+        }
+        preset.values[i] = atoi(value);
+    }
+    preset.num_values = i;
+    presets[slot] = preset;
+    return past_queue_unit(&g_past, past_preset_0 + slot, (void*) &preset, PRESET_LENGTH(preset.num_values));
+}
+
+/**
+ * @brief      Switch to the function of a preset slot and apply its values.
+ *             Selecting another function turns the output off, the values
+ *             of the current function apply at once. The screen is redrawn
+ *             once, after the command or button press has been handled.
+ *
+ * @param[in]  slot    The preset slot
+ * @param[out] status  ps_ok or the first error setting a value, read only
+ *                     parameters are skipped
+ *
+ * @return     false if the slot is empty or the function is not available
+ */
+bool opendps_recall_preset(uint32_t slot, set_param_status_t *status)
+{
+    if (slot >= CONFIG_PRESET_SLOTS || presets[slot].function >= func_ui.num_screens || is_temperature_locked) {
+        return false;
+    }
+    const preset_t *preset = &presets[slot];
+    select_function_deferred(preset->function);
+    const ui_screen_desc_t *desc = func_ui.screens[preset->function]->desc;
+    char value[12];
+    *status = ps_ok;
+    for (uint32_t i = 0; i < preset->num_values && desc->parameters[i].name[0]; i++) {
+        (void) numfmt_int(value, sizeof(value), preset->values[i]);
+        set_param_status_t s = desc->set_parameter ? desc->set_parameter(desc->parameters[i].name, value) : ps_not_supported;
+        if (s != ps_ok && s != ps_not_supported && *status == ps_ok) {
+            *status = s;
+        }
+    }
+    sched_start(&ui_redraw_job, &ui_redraw, 0, 0);
+#ifdef CONFIG_NOTIFY
+    notify_state();
+#endif // CONFIG_NOTIFY
+    return true;
+}
+
+/**
+  * @brief Check if an item of the current function is being edited
+  * @retval true if M1 and M2 move between the settings
+  */
+static bool func_ui_editing(void)
+{
+    ui_screen_t *screen = func_ui.screens[func_ui.cur_screen];
+    return screen->desc->items[screen->cur_item]->has_focus;
+}
+
+/**
+  * @brief Restore a preset slot read from past
+  * @param reader the reader, arg points to the preset_t to restore
+  * @param data the stored preset
+  * @param length length of the stored preset
+  * @retval none
+  */
+static void restore_preset(const past_reader_t *reader, const void *data, uint32_t length)
+{
+    const preset_t *stored = (const preset_t*) data;
+    if (length < PRESET_LENGTH(0) || stored->num_values > MAX_PARAMETERS || length < PRESET_LENGTH(stored->num_values)) {
+        return; /** Stored by a build with more parameters, left empty */
+    }
+    memcpy(reader->arg, data, PRESET_LENGTH(stored->num_values));
+}
+#endif // CONFIG_PRESETS
+
+#ifdef CONFIG_FUNC_STAGING
+/**
+ * @brief      Find a function by name
+ *
+ * @param[in]  name   The function name
+ * @param[out] index  Receives the index of the function in func_ui
+ *
+ * @return     true if there is such a function
+ */
+bool opendps_find_function(const char *name, uint32_t *index)
+{
+    for (uint32_t i = 0; i < func_ui.num_screens; i++) {
+        if (strcmp(func_ui.screens[i]->desc->name, name) == 0) {
+            *index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief      Stage a parameter value for a function, the current one or
+ *             any other. Nothing changes until opendps_switch_function().
+ *
+ * @param[in]  index  Index of the function in func_ui
+ * @param[in]  name   Name of the parameter as listed by the function
+ * @param[in]  value  The value, in the unit of the parameter
+ *
+ * @return     ps_ok, ps_unknown_name if the function has no such parameter
+ */
+set_param_status_t opendps_stage_parameter(uint32_t index, const char *name, int32_t value)
+{
+    if (index >= func_ui.num_screens) {
+        return ps_unknown_name;
+    }
+    const ui_parameter_t *params = func_ui.screens[index]->desc->parameters;
+    for (uint32_t i = 0; i < MAX_PARAMETERS && params[i].name[0]; i++) {
+        if (strcmp(params[i].name, name) == 0) {
+            staged[index].values[i] = value;
+            staged[index].mask |= 1 << i;
+            return ps_ok;
+        }
+    }
+    return ps_unknown_name;
+}
+
+/**
+ * @brief      Drop the staged values of a function
+ *
+ * @param[in]  index  Index of the function in func_ui
+ */
+void opendps_unstage(uint32_t index)
+{
+    if (index < func_ui.num_screens) {
+        staged[index].mask = 0;
+    }
+}
+
+/**
+ * @brief      Switch to a function and apply its staged values. Selecting
+ *             another function turns the output off, staged values of the
+ *             current one apply at once. The screen is redrawn once, after
+ *             the command has been handled.
+ *
+ * @param[in]  index   Index of the function in func_ui
+ * @param[out] status  ps_ok or the first error applying a staged value,
+ *                     read only parameters are skipped
+ *
+ * @return     false if there is no such function or the output is locked
+ *             by temperature
+ */
+bool opendps_switch_function(uint32_t index, set_param_status_t *status)
+{
+    if (index >= func_ui.num_screens || is_temperature_locked) {
+        return false;
+    }
+    select_function_deferred(index);
+    const ui_screen_desc_t *desc = func_ui.screens[index]->desc;
+    char value[12];
+    *status = ps_ok;
+    for (uint32_t i = 0; i < MAX_PARAMETERS && desc->parameters[i].name[0]; i++) {
+        if (!(staged[index].mask & (1 << i))) {
+            continue;
+        }
+        (void) numfmt_int(value, sizeof(value), staged[index].values[i]);
+        set_param_status_t s = desc->set_parameter ? desc->set_parameter(desc->parameters[i].name, value) : ps_not_supported;
+        if (s != ps_ok && s != ps_not_supported && *status == ps_ok) {
+            *status = s;
+        }
+    }
+    staged[index].mask = 0;
+    sched_start(&ui_redraw_job, &ui_redraw, 0, 0);
+#ifdef CONFIG_NOTIFY
+    notify_state();
+#endif // CONFIG_NOTIFY
+    return true;
+}
+#endif // CONFIG_FUNC_STAGING
+
 /**
  * @brief      Sets Calibration Data
  *
@@ -353,6 +779,22 @@ set_param_status_t opendps_set_calibration(char *name, float *value)
         param = past_VIN_ADC_K;
     } else if(strcmp(name,"VIN_ADC_C")==0){
         param = past_VIN_ADC_C;
+#ifdef CONFIG_VOUT_LOOP
+    } else if(strcmp(name,"V_LOOP_KP")==0){
+        param = past_V_LOOP_KP;
+    } else if(strcmp(name,"V_LOOP_KI")==0){
+        param = past_V_LOOP_KI;
+#endif // CONFIG_VOUT_LOOP
+#ifdef CONFIG_VOUT_SOFT_START
+    } else if(strcmp(name,"V_SLEW")==0){
+        param = past_V_SLEW;
+#endif // CONFIG_VOUT_SOFT_START
+    } else if(strcmp(name,"OCP_SAMPLES")==0){
+        param = past_OCP_SAMPLES;
+    } else if(strcmp(name,"OVP_SAMPLES")==0){
+        param = past_OVP_SAMPLES;
+    } else if(strcmp(name,"OCP_I2T")==0){
+        param = past_OCP_I2T;
     } else {
         return ps_not_supported;
     }
@@ -367,6 +809,39 @@ set_param_status_t opendps_set_calibration(char *name, float *value)
     return ps_ok;
 }
 
+#ifdef CONFIG_CAL_LUT
+/**
+ * @brief      Sets a Calibration Table
+ *
+ * @param      channel The pwrctl_cal_channel_t to set the table of
+ * @param      points  (x, y) pairs, count * 2 values
+ * @param      count   Number of points, 0 removes the table
+ *
+ * @return     True on success
+ */
+bool opendps_set_calibration_lut(uint32_t channel, uint16_t *points, uint32_t count)
+{
+    cal_lut_t lut;
+    uint32_t length = count * CAL_LUT_POINT_SIZE;
+
+    if (channel >= pwrctl_cal_channels) {
+        return false;
+    }
+    if (count == 0) {
+        past_erase_unit(&g_past, past_A_ADC_LUT + channel);
+    } else if (!cal_lut_load(&lut, points, length)) {
+        return false;
+    } else if (!past_write_unit(&g_past, past_A_ADC_LUT + channel, (void*) points, length)) {
+        dbg_printf("Error: past write opendps set calibration table failed!\n");
+        return false;
+    }
+
+    /** Re-init pwrctl with the new table */
+    pwrctl_init(&g_past);
+    return true;
+}
+#endif // CONFIG_CAL_LUT
+
 /**
  * @brief      Clear Calibration Data
  *
@@ -384,6 +859,21 @@ bool opendps_clear_calibration(void)
     past_erase_unit(&g_past, past_V_ADC_C);
     past_erase_unit(&g_past, past_VIN_ADC_K);
     past_erase_unit(&g_past, past_VIN_ADC_C);
+#ifdef CONFIG_VOUT_LOOP
+    past_erase_unit(&g_past, past_V_LOOP_KP);
+    past_erase_unit(&g_past, past_V_LOOP_KI);
+#endif // CONFIG_VOUT_LOOP
+#ifdef CONFIG_VOUT_SOFT_START
+    past_erase_unit(&g_past, past_V_SLEW);
+#endif // CONFIG_VOUT_SOFT_START
+    past_erase_unit(&g_past, past_OCP_SAMPLES);
+    past_erase_unit(&g_past, past_OVP_SAMPLES);
+    past_erase_unit(&g_past, past_OCP_I2T);
+#ifdef CONFIG_CAL_LUT
+    for (uint32_t ch = 0; ch < pwrctl_cal_channels; ch++) {
+        past_erase_unit(&g_past, past_A_ADC_LUT + ch);
+    }
+#endif // CONFIG_CAL_LUT
 
     /** Re-init pwrctl as calibration coefs have now been cleared */
     pwrctl_init(&g_past);
@@ -400,9 +890,9 @@ bool opendps_clear_calibration(void)
  */
 bool opendps_enable_output(bool enable)
 {
-    if (!is_temperature_locked && current_ui->screens[current_ui->cur_screen]->enable) {
+    if (!is_temperature_locked && current_ui->screens[current_ui->cur_screen]->desc->enable) {
         if (current_ui->screens[current_ui->cur_screen]->is_enabled != enable) {
-            event_put(event_button_enable, press_short); /** @todo: call directly as this will not work for temperature alarm */
+            event_put_from(event_src_main, event_button_enable, press_short); /** @todo: call directly as this will not work for temperature alarm */
         }
     } else {
         emu_printf("Output enable failed %s\n", is_temperature_locked ? "due to high temperature" : "");
@@ -416,7 +906,11 @@ bool opendps_enable_function_idx(uint32_t index)
     if (is_temperature_locked) {
         return false;
     } else {
-        uui_set_screen(current_ui, index);
+        uui_set_screen_deferred(current_ui, index);
+        sched_start(&ui_redraw_job, &ui_redraw, 0, 0);
+#ifdef CONFIG_NOTIFY
+        notify_state();
+#endif // CONFIG_NOTIFY
         return true; /** @todo: handle failure */
     }
 }
@@ -426,19 +920,25 @@ bool opendps_enable_function_idx(uint32_t index)
  */
 static void main_ui_tick(void)
 {
-    uint16_t i_out_raw, v_in_raw, v_out_raw;
-    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
-    (void) i_out_raw;
-    (void) v_out_raw;
-
-    // update input voltage value
-    input_voltage.value = pwrctl_calc_vin(v_in_raw);
-    input_voltage.ui.draw(&input_voltage.ui);
-
     // Update power button
     opendps_update_power_status(is_enabled);
 }
 
+/**
+ * @brief      Redraw the input voltage when a new value was published
+ *
+ * @param[in]  changed  The PWRCTL_MEAS_* mask of changed measurements
+ */
+static void main_ui_measured(uint32_t changed)
+{
+    if (changed & PWRCTL_MEAS_V_IN) {
+        input_voltage.value = pwrctl_measured(pwrctl_meas_v_in);
+        if (main_ui.is_visible) {
+            input_voltage.ui.draw(&input_voltage.ui);
+        }
+    }
+}
+
 /**
   * @brief Initialize the UI
   * @retval none
@@ -451,23 +951,20 @@ static void ui_init(void)
 
     /** Initialise the function screens */
     uui_init(&func_ui, &g_past);
-#ifdef CONFIG_CV_ENABLE
-    func_cv_init(&func_ui);
-#endif // CONFIG_CV_ENABLE
-#ifdef CONFIG_CC_ENABLE
-    func_cc_init(&func_ui);
-#endif // CONFIG_CC_ENABLE
-#ifdef CONFIG_CL_ENABLE
-    func_cl_init(&func_ui);
-#endif // CONFIG_CL_ENABLE
-#ifdef CONFIG_FUNCGEN_ENABLE
-    func_gen_init(&func_ui);
-#endif // CONFIG_FUNCGEN_ENABLE
-
+    uui_init_functions(&func_ui);
 
     /** Initialise the settings screens */
     uui_init(&settings_ui, &g_past);
     settings_calibration_init(&settings_ui);
+#ifdef CONFIG_LOAD_METER
+    settings_load_init(&settings_ui);
+#endif // CONFIG_LOAD_METER
+#ifdef CONFIG_ENERGY_METER
+    settings_energy_init(&settings_ui);
+#endif // CONFIG_ENERGY_METER
+#ifdef CONFIG_TREND_PLOT
+    settings_trend_init(&settings_ui);
+#endif // CONFIG_TREND_PLOT
 
     /** Initialise the main screens */
     uui_init(&main_ui, &g_past);
@@ -475,6 +972,7 @@ static void ui_init(void)
     input_voltage.ui.x = XPOS_INVOLT;
     input_voltage.ui.y = ui_height - font_meter_small_height;
     uui_add_screen(&main_ui, &main_screen);
+    (void) pwrctl_subscribe(&main_ui_measured);
 
     /** Activate the UIs */
     current_ui = &func_ui;
@@ -490,6 +988,31 @@ static void ui_init(void)
   */
 static void ui_handle_event(event_t event, uint8_t data)
 {
+#ifdef CONFIG_PAST_WRITE_BEHIND
+    last_ui_event = get_ticks();
+#endif // CONFIG_PAST_WRITE_BEHIND
+#ifdef CONFIG_ADAPTIVE_UI
+    ui_activity();
+#endif // CONFIG_ADAPTIVE_UI
+#ifdef CONFIG_HEADLESS
+    if (headless) {
+        switch(event) {
+            case event_button_m1:
+            case event_button_m2:
+            case event_button_sel:
+            case event_rot_press:
+            case event_rot_left:
+            case event_rot_right:
+            case event_button_enable:
+                /** Someone is at the unit, wake the screen and drop the
+                  * input like a screen saver does */
+                opendps_set_headless(false, false);
+                return;
+            default:
+                break;
+        }
+    }
+#endif // CONFIG_HEADLESS
     if (event == event_rot_press && data == press_long) {
         opendps_lock(!is_locked);
         return;
@@ -510,8 +1033,10 @@ static void ui_handle_event(event_t event, uint8_t data)
             case event_rot_left:
             case event_rot_right:
             case event_button_enable:
-                lock_flashing_period = LOCK_FLASHING_PERIOD;
                 lock_flash_counter = LOCK_FLASHING_COUNTER;
+                if (!sched_active(&lock_flash_job)) {
+                    sched_start(&lock_flash_job, &lock_flash, 0, LOCK_FLASHING_PERIOD);
+                }
                 return;
             default:
                 break;
@@ -527,11 +1052,16 @@ static void ui_handle_event(event_t event, uint8_t data)
                 (void) v_in_raw;
                 (void) v_out_raw;
                 uint16_t trig = hw_get_itrig_ma();
-                dbg_printf("%10u OCP: trig:%umA limit:%umA cur:%umA\n", (uint32_t) (get_ticks()), pwrctl_calc_iout(trig), pwrctl_calc_iout(pwrctl_i_limit_raw), pwrctl_calc_iout(i_out_raw));
+                dbg_printf("%10u OCP: trig:%umA limit:%umA cur:%umA\n", (uint32_t) (get_ticks()), pwrctl_calc_iout(trig), pwrctl_calc_iout(pwrctl_params()->i_limit_raw), pwrctl_calc_iout(i_out_raw));
 #endif // CONFIG_OCP_DEBUGGING
                 ui_flash(); /** @todo When OCP kicks in, show last I_out on screen */
+                status_latched |= PING_STATUS_OCP;
+                status_seq++;
+#ifdef CONFIG_NOTIFY
+                serial_notify(notify_trip, 1, 0);
+#endif // CONFIG_NOTIFY
                 opendps_update_power_status(false);
-                uui_handle_screen_event(current_ui, event);
+                uui_handle_screen_event(current_ui, event, data);
             }
             break;
         case event_ovp:
@@ -542,35 +1072,95 @@ static void ui_handle_event(event_t event, uint8_t data)
                 (void) i_out_raw;
                 (void) v_in_raw;
                 uint16_t trig = hw_get_vtrig_mv();
-                dbg_printf("%10u OVP: trig:%umV limit:%umV cur:%umV\n", (uint32_t) (get_ticks()), pwrctl_calc_iout(trig), pwrctl_calc_vout(pwrctl_v_limit_raw), pwrctl_calc_vout(v_out_raw));
+                dbg_printf("%10u OVP: trig:%umV limit:%umV cur:%umV\n", (uint32_t) (get_ticks()), pwrctl_calc_iout(trig), pwrctl_calc_vout(pwrctl_params()->v_limit_raw), pwrctl_calc_vout(v_out_raw));
 #endif // CONFIG_OVP_DEBUGGING
                 ui_flash(); /** @todo When OVP kicks in, show last V_out on screen */
+                status_latched |= PING_STATUS_OVP;
+                status_seq++;
+#ifdef CONFIG_NOTIFY
+                serial_notify(notify_trip, 2, 0);
+#endif // CONFIG_NOTIFY
                 opendps_update_power_status(false);
-                uui_handle_screen_event(current_ui, event);
+                uui_handle_screen_event(current_ui, event, data);
+            }
+            break;
+#ifdef CONFIG_POWER_FAIL
+        case event_power_fail:
+            if (data) {
+                dbg_printf("%10u V_in power failure\n", (uint32_t) (get_ticks()));
+                /** Write the settings while the input capacitors hold up */
+                if (past_pending(&g_past) && !past_flush(&g_past)) {
+                    dbg_printf("Error: past flush failed!\n");
+                }
+            } else {
+                hw_set_backlight(backlight_level());
+            }
+            break;
+#endif // CONFIG_POWER_FAIL
+#ifdef CONFIG_VOUT_SOFT_START
+        case event_vout_ramped:
+            dbg_printf("%10u V_out ramp done\n", (uint32_t) (get_ticks()));
+            break;
+#endif // CONFIG_VOUT_SOFT_START
+        case event_limit_mode:
+            status_cc = data & 1;
+            status_seq++;
+            /** Show a CV/CC change now instead of at the next UI tick */
+            if (current_ui == &func_ui) {
+                uui_tick(current_ui);
             }
+#ifdef CONFIG_NOTIFY
+            serial_notify(notify_limit_mode, 0, status_cc);
+            serial_notify(notify_regime, status_cc, pwrctl_limit_mode_us(data));
+#endif // CONFIG_NOTIFY
             break;
         case event_buttom_m1_and_m2: ;
             uint8_t target_screen_id = current_ui == &func_ui ? SETTINGS_UI_ID : FUNC_UI_ID; /** Change between the settings and functional screen */
             opendps_change_screen(target_screen_id);
             break;
+#ifdef CONFIG_PRESETS
+        case event_button_m1:
+        case event_button_m2:
+            if (current_ui == &func_ui && !func_ui_editing()) {
+                /** M1 and M2 are preset slots 0 and 1 unless moving between settings */
+                uint32_t slot = event == event_button_m1 ? 0 : 1;
+                set_param_status_t status;
+                if (data == press_long) {
+                    if (opendps_save_preset(slot)) {
+                        ui_flash();
+                    }
+                } else if (!opendps_recall_preset(slot, &status)) {
+                    ui_flash();
+                }
+                break;
+            }
+            uui_handle_screen_event(current_ui, event, data);
+            uui_refresh(current_ui, false);
+            break;
+#endif // CONFIG_PRESETS
         case event_button_enable:
 #pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
             write_past_settings();
             /** Deliberate fallthrough */
+#ifndef CONFIG_PRESETS
         case event_button_m1:
         case event_button_m2:
+#endif // CONFIG_PRESETS
         case event_button_sel:
         case event_rot_press:
         case event_rot_left:
         case event_rot_right:
         case event_rot_left_set:
         case event_rot_right_set:
-            uui_handle_screen_event(current_ui, event);
+            uui_handle_screen_event(current_ui, event, data);
             uui_refresh(current_ui, false);
             break;
         default:
             break;
     }
+#ifdef CONFIG_NOTIFY
+    notify_state();
+#endif // CONFIG_NOTIFY
 }
 
 /**
@@ -582,10 +1172,16 @@ void opendps_lock(bool lock)
 {
     if (is_locked != lock) {
         is_locked = lock;
-        lock_flashing_period = 0;
-        if (is_locked) {
+        status_seq++;
+#ifdef CONFIG_NOTIFY
+        serial_notify(notify_lock, 0, lock);
+#endif // CONFIG_NOTIFY
+        sched_cancel(&lock_flash_job);
+        if (!main_ui.is_visible) {
+            lock_visible = is_locked; /** Drawn when the status bar is shown */
+        } else if (is_locked) {
             lock_visible = true;
-            tft_blit((uint16_t*) gfx_padlock, GFX_PADLOCK_WIDTH, GFX_PADLOCK_HEIGHT, XPOS_LOCK, ui_height-GFX_PADLOCK_HEIGHT);
+            tft_blit_compressed(gfx_padlock, GFX_PADLOCK_WIDTH, GFX_PADLOCK_HEIGHT, XPOS_LOCK, ui_height-GFX_PADLOCK_HEIGHT);
         } else {
             lock_visible = false;
             tft_fill(XPOS_LOCK, ui_height-GFX_PADLOCK_HEIGHT, GFX_PADLOCK_WIDTH, GFX_PADLOCK_HEIGHT, bg_color);
@@ -603,96 +1199,199 @@ void opendps_temperature_lock(bool lock)
 {
     if (is_temperature_locked != lock) {
         is_temperature_locked = lock;
+        status_seq++;
+#ifdef CONFIG_NOTIFY
+        serial_notify(notify_thermal, 0, lock);
+#endif // CONFIG_NOTIFY
         if (is_temperature_locked) {
             emu_printf("DPS disabled due to temperature\n");
             /** @todo Right now we cannot use opendps_enable_output here */
             uui_disable_cur_screen(current_ui);
             tft_clear();
             uui_show(current_ui, false);
-            uui_show(&main_ui, false);
-            tft_blit((uint16_t*) gfx_thermometer, GFX_THERMOMETER_WIDTH, GFX_THERMOMETER_HEIGHT, 1+(ui_width-GFX_THERMOMETER_WIDTH)/2, 30);
+            opendps_show_status_bar(false);
+            tft_blit_compressed(gfx_thermometer, GFX_THERMOMETER_WIDTH, GFX_THERMOMETER_HEIGHT, 1+(ui_width-GFX_THERMOMETER_WIDTH)/2, 30);
         } else {
             emu_printf("DPS enabled due to temperature\n");
             tft_clear();
             uui_show(current_ui, true);
-            uui_show(&main_ui, true);
-            uui_refresh(current_ui, true);
-            uui_refresh(&main_ui, true);
+            ui_clear_pending = false;
+            if (!uui_flush(current_ui)) {
+                uui_refresh(current_ui, true);
+            }
+            opendps_show_status_bar(true);
         }
+#ifdef CONFIG_NOTIFY
+        notify_state();
+#endif // CONFIG_NOTIFY
     }
 }
 #endif // CONFIG_THERMAL_LOCKOUT
 
+#ifdef CONFIG_ADAPTIVE_UI
 /**
-  * @brief Do periodical updates in the UI
+  * @brief Note that something on screen changes, updating the UI every
+  *        UI_UPDATE_INTERVAL_MS again if it had slowed down
   * @retval none
   */
-static void ui_tick(void)
+static void ui_activity(void)
 {
-    static uint64_t last_wifi_update = 0;
-    static uint64_t last_tft_flash = 0;
-    static uint64_t last_lock_flash = 0;
+    last_ui_activity = get_ticks();
+    if (ui_idle) {
+        ui_idle = false;
+        sched_start(&ui_tick_job, &ui_tick, UI_UPDATE_INTERVAL_MS, UI_UPDATE_INTERVAL_MS);
+    }
+}
+#endif // CONFIG_ADAPTIVE_UI
 
-    static uint64_t last = 0;
-    /** Update on the first call and every UI_UPDATE_INTERVAL_MS ms */
-    if (last > 0 && get_ticks() - last < UI_UPDATE_INTERVAL_MS) {
-        return;
+/**
+  * @brief Get the backlight level the display should have
+  * @retval last_tft_brightness, 0 in headless mode
+  */
+static uint8_t backlight_level(void)
+{
+#ifdef CONFIG_HEADLESS
+    if (headless) {
+        return 0;
     }
+#endif // CONFIG_HEADLESS
+    return last_tft_brightness;
+}
 
-    last = get_ticks();
-    uui_tick(current_ui);
-    uui_tick(&main_ui);
+/**
+  * @brief Do periodical updates in the UI, run every UI_UPDATE_INTERVAL_MS
+  *        or every UI_IDLE_INTERVAL_MS while the readings are stable
+  * @retval none
+  */
+static void ui_tick(void)
+{
+    /** Convert the ADC readings once for all screens and observers */
+    uint32_t changed = pwrctl_publish();
+#ifdef CONFIG_HEADLESS
+    if (headless) {
+        /** The readings stay current for the host, the screens are brought
+          * up to date when headless mode ends */
+        setpoint_pending = false;
+    } else
+#endif // CONFIG_HEADLESS
+    {
+        uui_tick(current_ui);
+        if (main_ui.is_visible) {
+            uui_tick(&main_ui);
+        }
+    }
+    if (setpoint_pending) {
+        setpoint_pending = false;
+        uui_refresh(current_ui, false);
+        changed = 1;
+    }
+#ifdef CONFIG_ADAPTIVE_UI
+    if (changed) {
+        ui_activity();
+    } else if (!ui_idle && get_ticks() - last_ui_activity > UI_IDLE_AFTER_MS) {
+        /** Nothing to redraw, leave the time to the protocol and control work */
+        ui_idle = true;
+        sched_start(&ui_tick_job, &ui_tick, UI_IDLE_INTERVAL_MS, UI_IDLE_INTERVAL_MS);
+    }
+#else
+    (void) changed;
+#endif // CONFIG_ADAPTIVE_UI
+
+#ifdef CONFIG_PAST_WRITE_BEHIND
+    {
+        /** Commit queued settings when the user has left the device alone
+          * for a while or the output was just turned off */
+        static bool was_enabled;
+        bool turned_off = was_enabled && !pwrctl_vout_enabled();
+        was_enabled = pwrctl_vout_enabled();
+        bool flush_now = turned_off;
+#ifdef CONFIG_POWER_FAIL
+        /** Settings changed while V_in is down are not held back either */
+        flush_now = flush_now || hw_power_failing();
+#endif // CONFIG_POWER_FAIL
+        if (past_pending(&g_past) && (flush_now || get_ticks() - last_ui_event > PAST_FLUSH_DELAY_MS)) {
+            if (!past_flush(&g_past)) {
+                dbg_printf("Error: past flush failed!\n");
+            }
+        }
+    }
+#endif // CONFIG_PAST_WRITE_BEHIND
 
 #ifndef CONFIG_SPLASH_SCREEN
     {
         // Light up the display now that the UI has been drawn
         static bool first = true;
         if (first) {
-            hw_enable_backlight(last_tft_brightness);
+            hw_enable_backlight(backlight_level());
             first = false;
         }
     }
 #endif // CONFIG_SPLASH_SCREEN
+}
 
-    if (wifi_status_flashing_period > 0 && get_ticks() - last_wifi_update > wifi_status_flashing_period) {
-        last_wifi_update = get_ticks();
-        if (wifi_status_visible) {
-            tft_fill(XPOS_WIFI, ui_height-GFX_WIFI_HEIGHT, GFX_WIFI_WIDTH, GFX_WIFI_HEIGHT, bg_color);
-        } else {
-            tft_blit((uint16_t*) gfx_wifi, GFX_WIFI_WIDTH, GFX_WIFI_HEIGHT, XPOS_WIFI, ui_height-GFX_WIFI_HEIGHT);
-        }
-        wifi_status_visible = !wifi_status_visible;
+/**
+  * @brief Toggle the wifi icon while the wifi status flashes
+  * @retval none
+  */
+static void wifi_flash(void)
+{
+    if (!main_ui.is_visible) {
+        /** Keep the phase, the icon is drawn when the status bar is shown */
+    } else if (wifi_status_visible) {
+        tft_fill(XPOS_WIFI, ui_height-GFX_WIFI_HEIGHT, GFX_WIFI_WIDTH, GFX_WIFI_HEIGHT, bg_color);
+    } else {
+        tft_blit_compressed(gfx_wifi, GFX_WIFI_WIDTH, GFX_WIFI_HEIGHT, XPOS_WIFI, ui_height-GFX_WIFI_HEIGHT);
     }
+    wifi_status_visible = !wifi_status_visible;
+}
 
-    if (lock_flashing_period > 0 && get_ticks() - last_lock_flash > lock_flashing_period) {
-        last_lock_flash = get_ticks();
-        lock_visible = !lock_visible;
-        if (lock_visible) {
-            tft_blit((uint16_t*) gfx_padlock, GFX_PADLOCK_WIDTH, GFX_PADLOCK_HEIGHT, XPOS_LOCK, ui_height-GFX_PADLOCK_HEIGHT);
-        } else {
-            tft_fill(XPOS_LOCK, ui_height-GFX_PADLOCK_HEIGHT, GFX_PADLOCK_WIDTH, GFX_PADLOCK_HEIGHT, bg_color);
-        }
-        lock_flash_counter--;
-        if (lock_flash_counter == 0) {
-            lock_visible = true;
-            /** If the user hammers the locked buttons we might end up with an
-                invisible locking symbol at the end of the flashing */
-            tft_blit((uint16_t*) gfx_padlock, GFX_PADLOCK_WIDTH, GFX_PADLOCK_HEIGHT, XPOS_LOCK, ui_height-GFX_PADLOCK_HEIGHT);
-            lock_flashing_period = 0;
-        }
+/**
+  * @brief Turn off the wifi icon if the connection never came up
+  * @retval none
+  */
+static void wifi_connect_timeout(void)
+{
+    if (wifi_status == wifi_connecting) {
+        opendps_update_wifi_status(wifi_off);
     }
+}
 
-    if (tft_flashing_period > 0 && get_ticks() - last_tft_flash > tft_flashing_period) {
-        last_tft_flash = get_ticks();
-        tft_flash_counter--;
-        tft_invert(!tft_is_inverted());
-        if (tft_flash_counter == 0) {
-            tft_flashing_period = 0;
+/**
+  * @brief Toggle the lock icon when a locked button was pressed
+  * @retval none
+  */
+static void lock_flash(void)
+{
+    lock_visible = !lock_visible;
+    if (!main_ui.is_visible) {
+        /** Drawn when the status bar is shown */
+    } else if (lock_visible) {
+        tft_blit_compressed(gfx_padlock, GFX_PADLOCK_WIDTH, GFX_PADLOCK_HEIGHT, XPOS_LOCK, ui_height-GFX_PADLOCK_HEIGHT);
+    } else {
+        tft_fill(XPOS_LOCK, ui_height-GFX_PADLOCK_HEIGHT, GFX_PADLOCK_WIDTH, GFX_PADLOCK_HEIGHT, bg_color);
+    }
+    lock_flash_counter--;
+    if (lock_flash_counter == 0) {
+        lock_visible = true;
+        /** If the user hammers the locked buttons we might end up with an
+            invisible locking symbol at the end of the flashing */
+        if (main_ui.is_visible) {
+            tft_blit_compressed(gfx_padlock, GFX_PADLOCK_WIDTH, GFX_PADLOCK_HEIGHT, XPOS_LOCK, ui_height-GFX_PADLOCK_HEIGHT);
         }
+        sched_cancel(&lock_flash_job);
     }
+}
 
-    if (wifi_status == wifi_connecting && get_ticks() > WIFI_CONNECT_TIMEOUT) {
-        opendps_update_wifi_status(wifi_off);
+/**
+  * @brief Invert the TFT while it flashes
+  * @retval none
+  */
+static void tft_flash(void)
+{
+    tft_flash_counter--;
+    tft_invert(!tft_is_inverted());
+    if (tft_flash_counter == 0) {
+        sched_cancel(&tft_flash_job);
     }
 }
 
@@ -705,6 +1404,31 @@ void opendps_handle_ping(void)
     ui_flash();
 }
 
+/**
+  * @brief Get the compact status word of the heartbeat ping
+  * @param seq receives the number of state changes so far
+  * @retval the PING_STATUS_* flags and the function index
+  */
+uint16_t opendps_get_status(uint16_t *seq)
+{
+    bool output = pwrctl_vout_enabled();
+    if (output) {
+        status_latched = 0;
+    }
+    uint16_t status = status_latched | ((uint16_t) func_ui.cur_screen << PING_STATUS_FUNC_SHIFT);
+    status |= output ? PING_STATUS_OUTPUT : 0;
+    status |= status_cc ? PING_STATUS_CC : 0;
+    status |= is_temperature_locked ? PING_STATUS_THERMAL : 0;
+    status |= is_locked ? PING_STATUS_LOCKED : 0;
+    /** Output and function changes are not events, count them when seen */
+    if ((status ^ status_last) & (PING_STATUS_OUTPUT | PING_STATUS_FUNC_MASK)) {
+        status_seq++;
+    }
+    status_last = status;
+    *seq = status_seq;
+    return status;
+}
+
 /**
   * @brief Update wifi status icon
   * @param status new wifi status
@@ -716,28 +1440,148 @@ void opendps_update_wifi_status(wifi_status_t status)
         wifi_status = status;
         switch(wifi_status) {
             case wifi_off:
-                wifi_status_flashing_period = 0;
+                sched_cancel(&wifi_flash_job);
                 wifi_status_visible = true;
-                tft_fill(XPOS_WIFI, ui_height-GFX_WIFI_HEIGHT, GFX_WIFI_WIDTH, GFX_WIFI_HEIGHT, bg_color);
+                if (main_ui.is_visible) {
+                    tft_fill(XPOS_WIFI, ui_height-GFX_WIFI_HEIGHT, GFX_WIFI_WIDTH, GFX_WIFI_HEIGHT, bg_color);
+                }
                 break;
             case wifi_connecting:
-                wifi_status_flashing_period = WIFI_CONNECTING_FLASHING_PERIOD;
+                sched_start(&wifi_flash_job, &wifi_flash, WIFI_CONNECTING_FLASHING_PERIOD, WIFI_CONNECTING_FLASHING_PERIOD);
+                /** Give up WIFI_CONNECT_TIMEOUT ms after power up */
+                sched_start(&wifi_timeout_job, &wifi_connect_timeout,
+                            get_ticks() < WIFI_CONNECT_TIMEOUT ? WIFI_CONNECT_TIMEOUT - get_ticks() : 0, 0);
                 break;
             case wifi_connected:
-                wifi_status_flashing_period = 0;
+                sched_cancel(&wifi_flash_job);
                 wifi_status_visible = false;
-                tft_blit((uint16_t*) gfx_wifi, GFX_WIFI_WIDTH, GFX_WIFI_HEIGHT, XPOS_WIFI, ui_height-GFX_WIFI_HEIGHT);
+                if (main_ui.is_visible) {
+                    tft_blit_compressed(gfx_wifi, GFX_WIFI_WIDTH, GFX_WIFI_HEIGHT, XPOS_WIFI, ui_height-GFX_WIFI_HEIGHT);
+                }
                 break;
             case wifi_error:
-                wifi_status_flashing_period = WIFI_ERROR_FLASHING_PERIOD;
+                sched_start(&wifi_flash_job, &wifi_flash, WIFI_ERROR_FLASHING_PERIOD, WIFI_ERROR_FLASHING_PERIOD);
                 break;
             case wifi_upgrading:
-                wifi_status_flashing_period = WIFI_UPGRADING_FLASHING_PERIOD;
+                sched_start(&wifi_flash_job, &wifi_flash, WIFI_UPGRADING_FLASHING_PERIOD, WIFI_UPGRADING_FLASHING_PERIOD);
                 break;
         }
     }
 }
 
+/**
+  * @brief Draw the icons and items of the status bar
+  * @retval none
+  */
+static void draw_status_bar(void)
+{
+    power_icon_drawn = false;
+    opendps_update_power_status(is_enabled);
+    if (wifi_status == wifi_connected || (sched_active(&wifi_flash_job) && wifi_status_visible)) {
+        tft_blit_compressed(gfx_wifi, GFX_WIFI_WIDTH, GFX_WIFI_HEIGHT, XPOS_WIFI, ui_height-GFX_WIFI_HEIGHT);
+    }
+    if (lock_visible) {
+        tft_blit_compressed(gfx_padlock, GFX_PADLOCK_WIDTH, GFX_PADLOCK_HEIGHT, XPOS_LOCK, ui_height-GFX_PADLOCK_HEIGHT);
+    }
+    uui_refresh(&main_ui, true);
+}
+
+#ifdef CONFIG_HEADLESS
+/**
+  * @brief Enter or leave headless mode
+  * @param enable true to stop drawing and turn the backlight off
+  * @param store true to also start in this mode at power up
+  * @retval none
+  */
+void opendps_set_headless(bool enable, bool store)
+{
+    if (store) {
+        uint32_t setting = enable;
+        if (!past_queue_unit(&g_past, past_headless, (void*) &setting, sizeof(setting))) {
+            dbg_printf("Error: past write headless failed!\n");
+        }
+    }
+    if (enable == headless) {
+        return;
+    }
+    headless = enable;
+    tft_suspend(enable);
+    hw_set_backlight(backlight_level());
+    if (enable) {
+        return;
+    }
+    /** The only drawing of the current state, the following ticks draw what
+      * changes from here on */
+    tft_clear();
+    ui_clear_pending = false;
+    if (current_ui->is_visible && !uui_flush(current_ui)) {
+        uui_refresh(current_ui, true);
+    }
+#ifdef CONFIG_THERMAL_LOCKOUT
+    if (is_temperature_locked) {
+        tft_blit_compressed(gfx_thermometer, GFX_THERMOMETER_WIDTH, GFX_THERMOMETER_HEIGHT, 1+(ui_width-GFX_THERMOMETER_WIDTH)/2, 30);
+    }
+#endif // CONFIG_THERMAL_LOCKOUT
+    if (main_ui.is_visible) {
+        draw_status_bar();
+    }
+    sched_start(&ui_tick_job, &ui_tick, UI_UPDATE_INTERVAL_MS, UI_UPDATE_INTERVAL_MS);
+#ifdef CONFIG_ADAPTIVE_UI
+    last_ui_activity = get_ticks();
+    ui_idle = false;
+#endif // CONFIG_ADAPTIVE_UI
+}
+
+/**
+  * @brief Check if the unit is in headless mode
+  * @retval true if nothing is drawn
+  */
+bool opendps_headless(void)
+{
+    return headless;
+}
+#endif // CONFIG_HEADLESS
+
+#ifdef CONFIG_ADC_PROFILES
+/**
+  * @brief Select an ADC acquisition profile
+  * @param profile the profile
+  * @param store true to also select it at power up
+  * @retval false if there is no such profile
+  */
+bool opendps_set_adc_profile(adc_profile_t profile, bool store)
+{
+    if (!hw_adc_set_profile(profile)) {
+        return false;
+    }
+    if (store) {
+        uint32_t setting = profile;
+        if (!past_queue_unit(&g_past, past_adc_profile, (void*) &setting, sizeof(setting))) {
+            dbg_printf("Error: past write ADC profile failed!\n");
+        }
+    }
+    return true;
+}
+#endif // CONFIG_ADC_PROFILES
+
+/**
+  * @brief Show or hide the status bar
+  * @param show true to show, false to hide
+  * @retval none
+  */
+void opendps_show_status_bar(bool show)
+{
+    if (main_ui.is_visible == show) {
+        return;
+    }
+    uui_show(&main_ui, show);
+    if (show) {
+        /** The icons were not drawn while hidden, whatever is in their
+            place belongs to the screen that hid the status bar */
+        draw_status_bar();
+    }
+}
+
 /**
   * @brief Update power enable status icon
   * @param enabled new power status
@@ -747,13 +1591,23 @@ void opendps_update_power_status(bool enabled)
 {
     is_enabled = enabled;
 
+    if (!main_ui.is_visible) {
+        return; /** Drawn when the status bar is shown */
+    }
+    if (power_icon_drawn && power_icon_enabled == is_enabled && power_icon_clear_count == tft_clear_count()) {
+        return;
+    }
+    power_icon_drawn = true;
+    power_icon_enabled = is_enabled;
+    power_icon_clear_count = tft_clear_count();
+
     if (is_enabled) {
 #ifdef CONFIG_POWER_COLORED
-        tft_blit((uint16_t*) gfx_poweron,
+        tft_blit_compressed(gfx_poweron,
                 GFX_POWERON_WIDTH, GFX_POWERON_HEIGHT,
                 TFT_WIDTH-GFX_POWERON_WIDTH, TFT_HEIGHT-GFX_POWERON_HEIGHT);
 #else
-        tft_blit((uint16_t*) gfx_power,
+        tft_blit_compressed(gfx_power,
                 GFX_POWER_WIDTH, GFX_POWER_HEIGHT,
                 TFT_WIDTH-GFX_POWER_WIDTH, TFT_HEIGHT-GFX_POWER_HEIGHT);
 #endif //CONFIG_POWER_COLORED
@@ -762,7 +1616,7 @@ void opendps_update_power_status(bool enabled)
 // red poweroff button visible only if colored and off_visible are set
 #ifdef CONFIG_POWER_COLORED
 #ifdef CONFIG_POWER_OFF_VISIBLE
-        tft_blit((uint16_t*) gfx_poweroff,
+        tft_blit_compressed(gfx_poweroff,
                 GFX_POWEROFF_WIDTH, GFX_POWEROFF_HEIGHT,
                 TFT_WIDTH-GFX_POWEROFF_WIDTH, TFT_HEIGHT-GFX_POWEROFF_HEIGHT);
 #else //not CONFIG_POWER_OFF_VISIBLE
@@ -788,10 +1642,41 @@ void opendps_set_temperature(int16_t _temp1, int16_t _temp2)
     temp1 = _temp1;
     temp2 = _temp2;
     bool alert = temp1 > shutdown_temperature || temp2 > shutdown_temperature;
+    host_temperature_alert = alert;
+#ifdef CONFIG_CHIP_TEMP
+    alert = alert || chip_temperature_alert;
+#endif // CONFIG_CHIP_TEMP
     opendps_temperature_lock(alert);
     emu_printf("Got temperature %d and %d %s\n", temp1, temp2, alert ? "[ALERT]" : "");
 }
 
+#ifdef CONFIG_CHIP_TEMP
+/**
+  * @brief Check the die temperature, run every CONFIG_CHIP_TEMP_MS. Locks
+  *        the output out on its own, whether or not a host reports
+  *        temperatures
+  * @retval none
+  */
+static void chip_temp_check(void)
+{
+    int16_t temp;
+    if (!hw_chip_temp(&temp)) {
+        return;
+    }
+    bool alert = chip_temperature_alert;
+    if (temp > CONFIG_CHIP_TEMP_ALERT_LEVEL) {
+        alert = true;
+    } else if (temp < CONFIG_CHIP_TEMP_ALERT_LEVEL - CHIP_TEMP_HYSTERESIS) {
+        alert = false;
+    }
+    if (alert != chip_temperature_alert) {
+        chip_temperature_alert = alert;
+        dbg_printf("Die temperature %d %s\n", temp, alert ? "[ALERT]" : "");
+        opendps_temperature_lock(alert || host_temperature_alert);
+    }
+}
+#endif // CONFIG_CHIP_TEMP
+
 /**
   * @brief Get temperatures
   * @param temp1 first temperature we can deal with
@@ -814,11 +1699,64 @@ void opendps_get_temperature(int16_t *_temp1, int16_t *_temp2, bool *temp_shutdo
  */
 void opendps_upgrade_start(void)
 {
+    (void) past_flush(&g_past);
     /** Bootloader does not know how to garbage collect past, perform if needed */
     (void) past_gc_check(&g_past);
+#ifdef CONFIG_USART_TX_IRQ
+    hw_usart_flush();
+#endif // CONFIG_USART_TX_IRQ
+    scb_reset_system();
+}
+
+/**
+ * @brief      Restart with the settings stored in past
+ */
+void opendps_restart(void)
+{
+    (void) past_flush(&g_past);
+#ifdef CONFIG_USART_TX_IRQ
+    hw_usart_flush();
+#endif // CONFIG_USART_TX_IRQ
     scb_reset_system();
 }
 
+#ifdef CONFIG_CLONE
+/**
+ * @brief      Read a window of the settings snapshot
+ *
+ * @param[in]  offset  Offset of the window
+ * @param[out] buf     Receives the bytes
+ * @param[in]  size    Size of the window
+ * @param[out] total   Receives the length of the snapshot
+ *
+ * @return     Number of bytes copied
+ */
+uint32_t opendps_config_export(uint32_t offset, uint8_t *buf, uint32_t size, uint32_t *total)
+{
+    /** Queued settings are part of the snapshot as past returns them */
+    return clone_export(&g_past, offset, buf, size, total);
+}
+
+/**
+ * @brief      Write a chunk of a settings snapshot
+ *
+ * @param[in]  offset  Offset of the chunk
+ * @param[in]  data    The chunk
+ * @param[in]  count   Number of bytes
+ * @param[in]  commit  This is the last chunk
+ *
+ * @return     clone_ok or the reason the import failed
+ */
+clone_status_t opendps_config_import(uint32_t offset, const uint8_t *data, uint32_t count, bool commit)
+{
+    if (offset == 0) {
+        /** Settings queued before the import must not overwrite it later */
+        (void) past_flush(&g_past);
+    }
+    return clone_import(&g_past, offset, data, count, commit);
+}
+#endif // CONFIG_CLONE
+
 /**
  * @brief      Change the current screen
  *
@@ -833,18 +1771,93 @@ bool opendps_change_screen(uint8_t screen_id)
 
     uui_disable_cur_screen(current_ui); /** Turn off the output */
     opendps_update_power_status(false); /** Update the power icon status */
+    {
+        ui_screen_t *screen = current_ui->screens[current_ui->cur_screen];
+        if (screen->desc->deactivated) {
+            screen->desc->deactivated(); /** Eg. the trend screen scrolls back */
+        }
+    }
 
     if (screen_id == FUNC_UI_ID)
         current_ui = &func_ui;
     else if (screen_id == SETTINGS_UI_ID)
         current_ui = &settings_ui;
 
-    tft_clear(); /** Clear any previous screen */
-    uui_activate(current_ui);
+    ui_clear_pending = true; /** Clear any previous screen */
+    uui_activate_deferred(current_ui);
+    sched_start(&ui_redraw_job, &ui_redraw, 0, 0);
+#ifdef CONFIG_NOTIFY
+    notify_state();
+#endif // CONFIG_NOTIFY
 
     return true;
 }
 
+/**
+  * @brief Draw a screen that was switched to since the last run, this is
+  *        done in a job of its own so the command that switched screens
+  *        does not wait for the display
+  * @retval none
+  */
+static void ui_redraw(void)
+{
+    if (!current_ui->is_visible) {
+        return; /** Drawn when the UI is shown again */
+    }
+    if (ui_clear_pending) {
+        ui_clear_pending = false;
+        tft_clear();
+    }
+    (void) uui_flush(current_ui);
+}
+
+#ifdef CONFIG_NOTIFY
+/**
+  * @brief Notify the host of the output, screen, function and parameter
+  *        changes since the previous call, called after anything that may
+  *        have changed them
+  * @retval none
+  */
+static void notify_state(void)
+{
+    bool output = pwrctl_vout_enabled();
+    if (output != notified.output) {
+        notified.output = output;
+        serial_notify(notify_output, 0, output);
+    }
+    uint8_t screen = current_ui == &func_ui ? FUNC_UI_ID : SETTINGS_UI_ID;
+    if (screen != notified.screen) {
+        notified.screen = screen;
+        serial_notify(notify_screen, screen, 0);
+    }
+    bool function_changed = func_ui.cur_screen != notified.function;
+    if (function_changed) {
+        notified.function = func_ui.cur_screen;
+        notified.num_params = 0; /** The host reads the parameters of the new function */
+        serial_notify(notify_function, notified.function, 0);
+    }
+    if (current_ui == &func_ui && serial_notify_wanted(notify_parameter)) {
+        const ui_parameter_t *params;
+        uint32_t num = opendps_get_curr_function_params(&params);
+        char value[12];
+        if (num > MAX_PARAMETERS) {
+            num = MAX_PARAMETERS;
+        }
+        for (uint32_t i = 0; i < num; i++) {
+            if (!opendps_get_curr_function_param_value(params[i].name, value, sizeof(value))) {
+                continue;
+            }
+            int32_t v = atoi(value);
+            if (i < notified.num_params && v != notified.params[i]) {
+                serial_notify(notify_parameter, i, v);
+            }
+            notified.params[i] = v;
+        }
+        notified.num_params = num;
+    }
+}
+#endif // CONFIG_NOTIFY
+
 #ifdef CONFIG_SPLASH_SCREEN
 /**
   * @brief Draw splash screen
@@ -852,7 +1865,7 @@ bool opendps_change_screen(uint8_t screen_id)
   */
 static void ui_draw_splash_screen(void)
 {
-    tft_blit((uint16_t*) logo, logo_width, logo_height, (ui_width-logo_width)/2, (ui_height-logo_height)/2);
+    tft_blit_compressed(logo, logo_width, logo_height, (ui_width-logo_width)/2, (ui_height-logo_height)/2);
 }
 #endif // CONFIG_SPLASH_SCREEN
 
@@ -862,47 +1875,101 @@ static void ui_draw_splash_screen(void)
   */
 static void ui_flash(void)
 {
-    tft_flashing_period = TFT_FLASHING_PERIOD;
     tft_flash_counter = TFT_FLASHING_COUNTER;
+    if (!sched_active(&tft_flash_job)) {
+        sched_start(&tft_flash_job, &tft_flash, 0, TFT_FLASHING_PERIOD);
+    }
 }
 
 /**
-  * @brief Read settings from past
+  * @brief Restore a setting stored as a 32 bit word
+  * @param reader the reader, arg points to the uint32_t to restore
+  * @param data the stored data
+  * @param length length of the stored data
   * @retval none
   */
-static void read_past_settings(void)
+static void restore_word(const past_reader_t *reader, const void *data, uint32_t length)
 {
-    bool     inverse_setting = false;
-    uint32_t length;
-    uint32_t *p = 0;
-    if (past_read_unit(&g_past, past_tft_inversion, (const void**) &p, &length)) {
-        if (p) {
-            inverse_setting = !!(*p);
-        }
+    (void) length;
+    if (data) {
+        *(uint32_t*) reader->arg = *(const uint32_t*) data;
     }
-    tft_invert(inverse_setting);
-
-    if (past_read_unit(&g_past, past_tft_brightness, (const void**) &p, &length)) {
-        if (p) {
-            last_tft_brightness = *p;
-        }
-    }
-    hw_set_backlight(last_tft_brightness);
-
+}
 
 #ifdef GIT_VERSION
-    /** Update app git hash in past if needed */
-    char *ver = 0;
-    bool exists = past_read_unit(&g_past, past_app_git_hash, (const void**) &ver, &length);
+/**
+  * @brief Compare the stored app git hash with ours
+  * @param reader the reader, arg points to a bool set if they match
+  * @param data the stored hash
+  * @param length length of the stored hash
+  * @retval none
+  */
+static void check_git_hash(const past_reader_t *reader, const void *data, uint32_t length)
+{
+    *(bool*) reader->arg = strncmp(data, GIT_VERSION, length) == 0;
+}
+#endif // GIT_VERSION
 
-    if (!exists) /** If hash isn't stored in past then write it in */
+/**
+  * @brief Read settings from past
+  * @retval none
+  */
+static void read_past_settings(void)
+{
+    uint32_t inverse_setting = 0;
+    uint32_t brightness = last_tft_brightness;
+#ifdef CONFIG_HEADLESS
+    uint32_t headless_setting = 0;
+#endif // CONFIG_HEADLESS
+#ifdef CONFIG_ADC_PROFILES
+    uint32_t adc_profile_setting = adc_profile_default;
+#endif // CONFIG_ADC_PROFILES
+#ifdef GIT_VERSION
+    bool hash_current = false;
+#endif // GIT_VERSION
+    const past_reader_t readers[] = {
+        { past_tft_inversion, &restore_word, &inverse_setting },
+        { past_tft_brightness, &restore_word, &brightness },
+#ifdef CONFIG_HEADLESS
+        { past_headless, &restore_word, &headless_setting },
+#endif // CONFIG_HEADLESS
+#ifdef CONFIG_ADC_PROFILES
+        { past_adc_profile, &restore_word, &adc_profile_setting },
+#endif // CONFIG_ADC_PROFILES
+#ifdef GIT_VERSION
+        { past_app_git_hash, &check_git_hash, &hash_current },
+#endif // GIT_VERSION
+    };
+    (void) past_read_many(&g_past, readers, sizeof(readers) / sizeof(readers[0]));
+#ifdef CONFIG_PRESETS
     {
-        if (!past_write_unit(&g_past, past_app_git_hash, (void*) &GIT_VERSION, strlen(GIT_VERSION))) {
-            dbg_printf("Error: past write app git hash failed!\n"); /** @todo Handle past write errors */
+        past_reader_t preset_readers[CONFIG_PRESET_SLOTS];
+        for (uint32_t i = 0; i < CONFIG_PRESET_SLOTS; i++) {
+            presets[i].function = PRESET_EMPTY;
+            preset_readers[i].id = past_preset_0 + i;
+            preset_readers[i].restore = &restore_preset;
+            preset_readers[i].arg = &presets[i];
         }
+        (void) past_read_many(&g_past, preset_readers, CONFIG_PRESET_SLOTS);
     }
-    else if (strncmp(ver, GIT_VERSION, length) != 0) /** Else if hash is stored in past but is different then update it */
-    {
+#endif // CONFIG_PRESETS
+
+    tft_invert(!!inverse_setting);
+    last_tft_brightness = brightness;
+#ifdef CONFIG_HEADLESS
+    /** Starting headless skips the splash screen too */
+    headless = !!headless_setting;
+    tft_suspend(headless);
+#endif // CONFIG_HEADLESS
+    hw_set_backlight(backlight_level());
+#ifdef CONFIG_ADC_PROFILES
+    /** Before hw_adc_start(), sampling starts with the stored profile */
+    (void) hw_adc_set_profile(adc_profile_setting);
+#endif // CONFIG_ADC_PROFILES
+
+#ifdef GIT_VERSION
+    /** Update app git hash in past if it is missing or different */
+    if (!hash_current) {
         if (!past_write_unit(&g_past, past_app_git_hash, (void*) &GIT_VERSION, strlen(GIT_VERSION))) {
             dbg_printf("Error: past write app git hash failed!\n"); /** @todo Handle past write errors */
         }
@@ -921,16 +1988,26 @@ static void write_past_settings(void)
     if (tft_is_inverted() != last_tft_inv_setting) {
         last_tft_inv_setting = tft_is_inverted();
         uint32_t setting = last_tft_inv_setting;
-        if (!past_write_unit(&g_past, past_tft_inversion, (void*) &setting, sizeof(setting))) {
+        if (!past_queue_unit(&g_past, past_tft_inversion, (void*) &setting, sizeof(setting))) {
             /** @todo Handle past write errors */
             dbg_printf("Error: past write inv failed!\n");
         }
     }
 
+#ifdef CONFIG_POWER_FAIL
+    if (hw_power_failing()) {
+        return; /** The backlight is off for the power failure, not by the user */
+    }
+#endif // CONFIG_POWER_FAIL
+#ifdef CONFIG_HEADLESS
+    if (headless) {
+        return; /** The backlight is off for headless mode, not by the user */
+    }
+#endif // CONFIG_HEADLESS
     if(hw_get_backlight() != last_tft_brightness) {
         last_tft_brightness = hw_get_backlight();
         uint32_t setting = last_tft_brightness;
-        if (!past_write_unit(&g_past, past_tft_brightness, (void*) &setting, sizeof(setting))) {
+        if (!past_queue_unit(&g_past, past_tft_brightness, (void*) &setting, sizeof(setting))) {
             /** @todo Handle past write errors */
             dbg_printf("Error: past write inv failed!\n");
         }
@@ -952,9 +2029,52 @@ static void check_master_reset(void)
     }
 }
 
+/**
+  * @brief React on an event
+  * @param event the event
+  * @param data additional event data
+  * @retval None
+  */
+static void handle_event(event_t event, uint8_t data)
+{
+    if (event) {
+        emu_printf(" Event %d 0x%02x\n", event, data);
+    }
+    switch(event) {
+        case event_none:
+            dbg_printf("Weird, should not receive 'none events'\n");
+            break;
+        case event_uart_rx:
+            serial_handle_rx_char(data);
+            break;
+#ifdef CONFIG_USART_RX_RING
+        case event_uart_rx_block:
+            {
+                uint8_t buf[32];
+                uint32_t len;
+                while ((len = hw_usart_rx_read(buf, sizeof(buf))) > 0) {
+                    for (uint32_t i = 0; i < len; i++) {
+                        serial_handle_rx_char(buf[i]);
+                    }
+                }
+            }
+            break;
+#endif // CONFIG_USART_RX_RING
+        case event_ocp:
+            break;
+        default:
+            break;
+    }
+    ui_handle_event(event, data);
+}
+
 /**
   * @brief This is the app event handler, pulling an event off the event queue
-  *        and reacting on it.
+  *        and reacting on it. Scheduled jobs are run between events and the
+  *        CPU sleeps until the next interrupt when there is nothing to do.
+  *        Safety and protocol events are handled between the scheduled jobs
+  *        too, so a frame from the host waits for at most one redraw rather
+  *        than for all queued UI work.
   * @retval None
   */
 static void event_handler(void)
@@ -962,31 +2082,83 @@ static void event_handler(void)
     while(1) {
         event_t event;
         uint8_t data = 0;
+        bool idle = false;
         if (!event_get(&event, &data)) {
-            hw_longpress_check();
-            ui_tick();
-        } else {
-            if (event) {
-                emu_printf(" Event %d 0x%02x\n", event, data);
+            if (past_gc_busy(&g_past)) {
+                /** Compact the settings a few units at a time while idle */
+                if (!past_gc_step(&g_past)) {
+                    dbg_printf("Error: past GC failed!\n");
+                }
+            } else {
+                idle = true;
             }
-            switch(event) {
-                case event_none:
-                    dbg_printf("Weird, should not receive 'none events'\n");
-                    break;
-                case event_uart_rx:
-                    serial_handle_rx_char(data);
-                    break;
-                case event_ocp:
-                    break;
-                default:
-                    break;
+        } else {
+            handle_event(event, data);
+        }
+
+        while (sched_run_next()) {
+            while (event_get_class(event_class_protocol, &event, &data)) {
+                handle_event(event, data);
+                idle = false;
             }
-            ui_handle_event(event, data);
         }
 
+#ifdef CONFIG_LOAD_METER
+        load_tick();
+#endif // CONFIG_LOAD_METER
+
+#ifdef CONFIG_SERIAL_PROTOCOL
+        serial_tick();
+#endif // CONFIG_SERIAL_PROTOCOL
+
 #ifdef CONFIG_WDOG
-        wdog_kick();
+        /** A loop that spins without running the critical jobs is reset
+          * like a hung one */
+        if (sched_healthy()) {
+            wdog_kick();
+        }
 #endif // CONFIG_WDOG
+
+        /** The 1ms SysTick bounds the sleep, so an event posted after the
+          * queue was found empty waits at most that long */
+        if (idle) {
+#ifdef CONFIG_LOAD_METER
+            load_sleep();
+#else // CONFIG_LOAD_METER
+            hw_wait_for_interrupt();
+#endif // CONFIG_LOAD_METER
+        }
+    }
+}
+
+/**
+  * @brief Get the startup timestamps
+  * @retval boot_phases times in ms, 0 for phases not reached yet
+  */
+const uint32_t *opendps_boot_times(void)
+{
+    return boot_times;
+}
+
+/**
+  * @brief Record when a startup phase completed
+  * @param phase the phase
+  * @retval none
+  */
+static void boot_mark(boot_phase_t phase)
+{
+    boot_times[phase] = (uint32_t) get_ticks();
+}
+
+/**
+  * @brief Sleep until a point in time during startup, before the scheduler runs
+  * @param ticks get_ticks() to wait for
+  * @retval none
+  */
+static void boot_wait(uint64_t ticks)
+{
+    while (get_ticks() < ticks) {
+        hw_wait_for_interrupt();
     }
 }
 
@@ -996,7 +2168,32 @@ static void event_handler(void)
   */
 int main(int argc, char const *argv[])
 {
-    hw_init();
+#ifdef CONFIG_STACK_MONITOR
+    stackmon_paint(); // Interrupts are still disabled after reset
+#endif // CONFIG_STACK_MONITOR
+    hw_init(); // The ADC stabilizes while the display and past are set up
+    boot_mark(boot_hw_init);
+    {
+        uint32_t magic, boot_ms;
+        if (bootcom_get(&magic, &boot_ms) && magic == BOOTCOM_BOOT_TIME) {
+            boot_times[boot_loader] = boot_ms;
+        }
+    }
+#ifdef CONFIG_PERF
+    perf_init();
+#endif // CONFIG_PERF
+#ifdef CONFIG_TRACE
+    trace_init();
+#endif // CONFIG_TRACE
+#ifdef CONFIG_LOAD_METER
+    load_init();
+#endif // CONFIG_LOAD_METER
+#ifdef CONFIG_WINDOW_STATS
+    winstats_init();
+#endif // CONFIG_WINDOW_STATS
+#ifdef CONFIG_SWD_READOUT
+    memdesc_init();
+#endif // CONFIG_SWD_READOUT
 
 #ifdef CONFIG_COMMANDLINE
     dbg_printf("Welcome to OpenDPS!\n");
@@ -1004,26 +2201,63 @@ int main(int argc, char const *argv[])
 #endif // CONFIG_COMMANDLINE
 
     tft_init();
-    delay_ms(50); // Without this delay we will observe some flickering
-    tft_clear();
+    /** Without this delay we will observe some flickering, read past meanwhile */
+    uint64_t tft_ready = get_ticks() + TFT_SETTLE_MS;
+    boot_mark(boot_tft_init);
 #ifdef DPS_EMULATOR
     dps_emul_init(&g_past, argc, argv);
 #else // DPS_EMULATOR
     (void) argc;
     (void) argv;
-    g_past.blocks[0] = 0x0800f800;
-    g_past.blocks[1] = 0x0800fc00;
+    for (uint32_t i = 0; i < PAST_NUM_BLOCKS; i++) {
+        g_past.blocks[i] = (uint32_t) &_past_start + i * PAST_BLOCK_SIZE;
+    }
 #endif // DPS_EMULATOR
     if (!past_init(&g_past)) {
         dbg_printf("Error: past init failed!\n");
         /** @todo Handle past init failure */
     }
+    boot_mark(boot_past_init);
 
     pwrctl_init(&g_past); // Must be after DAC init and Past init
     event_init();
     check_master_reset();
     read_past_settings();
+    boot_mark(boot_settings);
+    boot_wait(tft_ready);
+    tft_clear();
+#ifdef CONFIG_SPLASH_SCREEN
+    /** The ADC and the UI are started while the splash screen is shown */
+    ui_draw_splash_screen();
+    hw_enable_backlight(backlight_level());
+    uint64_t splash_done = get_ticks() + SPLASH_MS;
+#endif // CONFIG_SPLASH_SCREEN
+    hw_adc_start();
+    boot_mark(boot_adc_ready);
     ui_init();
+    sched_start(&ui_tick_job, &ui_tick, 0, UI_UPDATE_INTERVAL_MS);
+    sched_watch(&ui_tick_job, "ui", UI_TICK_DEADLINE_MS, true);
+    sched_watch(&ui_redraw_job, "redraw", UI_TICK_DEADLINE_MS, false);
+#ifndef CONFIG_BUTTON_TIMER
+    sched_start(&longpress_job, &hw_longpress_check, LONGPRESS_CHECK_INTERVAL_MS, LONGPRESS_CHECK_INTERVAL_MS);
+    sched_watch(&longpress_job, "press", INPUT_POLL_DEADLINE_MS, true);
+#endif // CONFIG_BUTTON_TIMER
+#ifdef CONFIG_ROTARY_QEI
+    sched_start(&rotary_job, &hw_rotary_poll, ROTARY_POLL_INTERVAL_MS, ROTARY_POLL_INTERVAL_MS);
+    sched_watch(&rotary_job, "rotary", INPUT_POLL_DEADLINE_MS, true);
+#endif // CONFIG_ROTARY_QEI
+#ifdef CONFIG_CHIP_TEMP
+    sched_start(&chip_temp_job, &chip_temp_check, 0, CONFIG_CHIP_TEMP_MS);
+    sched_watch(&chip_temp_job, "temp", CHIP_TEMP_DEADLINE_MS, true);
+#endif // CONFIG_CHIP_TEMP
+
+    boot_mark(boot_ui_init);
+
+#ifdef CONFIG_SPLASH_SCREEN
+    boot_wait(splash_done);
+    tft_clear();
+    uui_refresh(current_ui, true);
+#endif // CONFIG_SPLASH_SCREEN
 
 #ifdef CONFIG_WIFI
     /** Rationale: the ESP8266 could send this message when it starts up but
@@ -1036,17 +2270,18 @@ int main(int argc, char const *argv[])
     opendps_update_wifi_status(wifi_connecting);
 #endif // CONFIG_WIFI
 
-#ifdef CONFIG_SPLASH_SCREEN
-    tft_clear();
-    ui_draw_splash_screen();
-    hw_enable_backlight(last_tft_brightness);
-    delay_ms(750);
-    tft_clear();
-    uui_refresh(current_ui, true);
-#endif // CONFIG_SPLASH_SCREEN
 #ifdef CONFIG_WDOG
     wdog_init();
 #endif // CONFIG_WDOG
+    boot_mark(boot_ready);
+#ifdef DPS_EMULATOR
+    bench_hooks_t hooks = {
+        .past = &g_past,
+        .handle_event = &ui_handle_event,
+        .tick = &ui_tick,
+    };
+    dps_emul_bench(&hooks); /** Does not return in benchmark mode */
+#endif // DPS_EMULATOR
     event_handler();
     return 0;
 }
@@ -55,6 +55,12 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "protocol.h"
+#ifdef CONFIG_ADC_PROFILES
+#include "hw.h"
+#endif // CONFIG_ADC_PROFILES
+#ifdef CONFIG_CLONE
+#include "clone.h"
+#endif // CONFIG_CLONE
 
 /**
  * @def OPENDPS_MAX_PARAMETERS
@@ -85,6 +91,7 @@
  * @return false if the index is out of range or the function failed to enable
  *
  * @note The function index must be less than the number of registered functions
+ * @note The new screen is drawn by a job that runs after the caller returns
  * @see opendps_get_function_names() to get the list of available functions
  */
 bool opendps_enable_function_idx(uint32_t func_idx);
@@ -104,7 +111,7 @@ bool opendps_enable_function_idx(uint32_t func_idx);
  * @note The returned pointers point to static strings and must not be freed
  * @note The array should have at least MAX_SCREENS elements
  */
-uint32_t opendps_get_function_names(char* names[], size_t size);
+uint32_t opendps_get_function_names(const char* names[], size_t size);
 
 /**
  * @brief Get the name of the currently active function
@@ -158,7 +165,7 @@ uint32_t opendps_get_app_git_hash(const char** git_hash);
  * @note The returned pointer points to the function's internal parameter array
  * @see ui_parameter_t for the parameter structure definition
  */
-uint32_t opendps_get_curr_function_params(ui_parameter_t **parameters);
+uint32_t opendps_get_curr_function_params(const ui_parameter_t **parameters);
 
 /**
  * @brief Get the value of a named parameter from the current function
@@ -174,7 +181,7 @@ uint32_t opendps_get_curr_function_params(ui_parameter_t **parameters);
  *
  * @note The value string format depends on the parameter type and unit
  */
-bool opendps_get_curr_function_param_value(char *name, char *value, uint32_t value_len);
+bool opendps_get_curr_function_param_value(const char *name, char *value, uint32_t value_len);
 
 /**
  * @brief Set a parameter to a new value
@@ -192,7 +199,100 @@ bool opendps_get_curr_function_param_value(char *name, char *value, uint32_t val
  *
  * @see set_param_status_t for all possible return values
  */
-set_param_status_t opendps_set_parameter(char *name, char *value);
+set_param_status_t opendps_set_parameter(const char *name, char *value);
+
+/**
+ * @brief Set the voltage and/or current setting of the current function
+ *
+ * Binary alternative to opendps_set_parameter for remote control. The
+ * output follows immediately while the display is redrawn on the next UI
+ * tick. Values are range checked before any of them is applied.
+ *
+ * @param[in] mask  SETPOINT_VOLTAGE and/or SETPOINT_CURRENT
+ * @param[in] mv    Voltage setting in millivolt
+ * @param[in] ma    Current setting in milliampere
+ * @return ps_ok if the setting was applied
+ * @return ps_range_error if a value is outside valid bounds
+ * @return ps_not_supported if the current function has no such setting
+ */
+set_param_status_t opendps_set_setpoint(uint8_t mask, int32_t mv, int32_t ma);
+
+#ifdef CONFIG_PRESETS
+#ifndef CONFIG_PRESET_SLOTS
+ #define CONFIG_PRESET_SLOTS  (4)
+#endif
+
+/**
+ * @brief Store the current function and its parameters in a preset slot
+ *
+ * The slot is kept in RAM for recall and queued for writing to past, slots
+ * 0 and 1 are also saved by a long press on M1 and M2.
+ *
+ * @param[in] slot  Preset slot, below CONFIG_PRESET_SLOTS
+ * @return true if the preset was stored
+ */
+bool opendps_save_preset(uint32_t slot);
+
+/**
+ * @brief Recall a preset slot
+ *
+ * Switches to the function of the preset, turning the output off if the
+ * function changes, and applies all its settings before the screen is
+ * redrawn once. Slots 0 and 1 are also recalled by a short press on M1 and
+ * M2 when no setting is being edited.
+ *
+ * @param[in]  slot    Preset slot, below CONFIG_PRESET_SLOTS
+ * @param[out] status  ps_ok or the first error applying a setting
+ * @return false if the slot is empty or the output is locked by temperature
+ */
+bool opendps_recall_preset(uint32_t slot, set_param_status_t *status);
+#endif // CONFIG_PRESETS
+
+#ifdef CONFIG_FUNC_STAGING
+/**
+ * @brief Find a function by name
+ *
+ * @param[in]  name   Function name, e.g. "cv"
+ * @param[out] index  Receives the index of the function
+ * @return true if there is such a function
+ */
+bool opendps_find_function(const char *name, uint32_t *index);
+
+/**
+ * @brief Stage a parameter value for a function
+ *
+ * The value is kept aside until the function is selected with
+ * opendps_switch_function(), whether the function is the current one or
+ * not. The range is checked when the value is applied.
+ *
+ * @param[in] index  Function index
+ * @param[in] name   Parameter name as listed by the function, e.g. "voltage"
+ * @param[in] value  The value in the unit of the parameter
+ * @return ps_ok, or ps_unknown_name if the function has no such parameter
+ */
+set_param_status_t opendps_stage_parameter(uint32_t index, const char *name, int32_t value);
+
+/**
+ * @brief Drop the values staged for a function
+ *
+ * @param[in] index  Function index
+ */
+void opendps_unstage(uint32_t index);
+
+/**
+ * @brief Switch to a function with its staged values applied
+ *
+ * Selecting another function turns the output off as
+ * opendps_enable_function_idx() does, the staged values are applied before
+ * the screen is redrawn once and then dropped.
+ *
+ * @param[in]  index   Function index
+ * @param[out] status  ps_ok or the first error applying a staged value
+ * @return false if there is no such function or the output is locked by
+ *         temperature
+ */
+bool opendps_switch_function(uint32_t index, set_param_status_t *status);
+#endif // CONFIG_FUNC_STAGING
 
 /**
  * @brief Set calibration data for ADC/DAC conversion
@@ -231,6 +331,23 @@ set_param_status_t opendps_set_calibration(char *name, float *value);
  */
 bool opendps_clear_calibration(void);
 
+#ifdef CONFIG_CAL_LUT
+/**
+ * @brief Set the piecewise linear calibration table of a channel
+ *
+ * The table replaces the K and C coefficients of the channel for all
+ * conversions and is stored in persistent storage. Both x and y must be
+ * strictly increasing, see cal_lut.h.
+ *
+ * @param[in] channel The pwrctl_cal_channel_t of the table
+ * @param[in] points  count (x, y) pairs, x first
+ * @param[in] count   Number of points, 2..CAL_LUT_MAX_POINTS, 0 removes the table
+ * @return true if the table was stored or removed
+ * @return false if the channel or table is invalid or writing failed
+ */
+bool opendps_set_calibration_lut(uint32_t channel, uint16_t *points, uint32_t count);
+#endif // CONFIG_CAL_LUT
+
 /**
  * @brief Enable or disable power output
  *
@@ -261,6 +378,18 @@ bool opendps_enable_output(bool enable);
  */
 void opendps_update_power_status(bool enabled);
 
+/**
+ * @brief Show or hide the status bar
+ *
+ * The status bar is the input voltage and the power, wifi and lock icons
+ * along the bottom of the display. While hidden their state is still
+ * tracked but nothing is drawn, showing the status bar draws it again.
+ * Used by screens that take over the whole display.
+ *
+ * @param[in] show true to show the status bar, false to hide it
+ */
+void opendps_show_status_bar(bool show);
+
 /**
  * @brief Update the WiFi status indicator on the display
  *
@@ -288,6 +417,19 @@ void opendps_update_wifi_status(wifi_status_t status);
  */
 void opendps_handle_ping(void);
 
+/**
+ * @brief Get the compact status word of the heartbeat ping
+ *
+ * OCP and OVP stay set until the output is enabled again. The sequence
+ * number counts trips, CC/CV, lock and thermal changes and the output and
+ * function changes seen by a call, a host that sees it move knows it
+ * missed something between two pings.
+ *
+ * @param seq Receives the number of state changes so far
+ * @return The PING_STATUS_* flags and the function index
+ */
+uint16_t opendps_get_status(uint16_t *seq);
+
 /**
  * @brief Lock or unlock the user interface
  *
@@ -316,6 +458,39 @@ void opendps_lock(bool lock);
  */
 void opendps_temperature_lock(bool lock);
 
+#ifdef CONFIG_HEADLESS
+/**
+ * @brief Enter or leave headless mode
+ *
+ * In headless mode the backlight is off, nothing is sent to the display and
+ * the UI tick only publishes the readings, leaving the time to control and
+ * the protocol. Leaving it draws the current screen once. A button press or
+ * turn of the encoder also leaves it, and is otherwise ignored.
+ *
+ * @param[in] enable true to enter headless mode
+ * @param[in] store  true to also start in this mode at power up
+ */
+void opendps_set_headless(bool enable, bool store);
+
+/**
+ * @brief Check if the unit is in headless mode
+ *
+ * @return true if nothing is drawn
+ */
+bool opendps_headless(void);
+#endif // CONFIG_HEADLESS
+
+#ifdef CONFIG_ADC_PROFILES
+/**
+ * @brief Select an ADC acquisition profile
+ *
+ * @param[in] profile The profile, see adc_profile_t
+ * @param[in] store   true to also select it at power up
+ * @return false if there is no such profile
+ */
+bool opendps_set_adc_profile(adc_profile_t profile, bool store);
+#endif // CONFIG_ADC_PROFILES
+
 /**
  * @brief Set temperature sensor readings
  *
@@ -363,6 +538,43 @@ void opendps_get_temperature(int16_t *temp1, int16_t *temp2, bool *temp_shutdown
  */
 void opendps_upgrade_start(void);
 
+/**
+ * @brief Restart the device
+ *
+ * Writes the queued settings to past and resets, the functions and
+ * settings are then restored from past as at power up.
+ *
+ * @note This function does not return - the device resets
+ */
+void opendps_restart(void);
+
+#ifdef CONFIG_CLONE
+/**
+ * @brief Read a window of the settings snapshot, see clone_export()
+ *
+ * @param[in]  offset  Offset of the window in the snapshot
+ * @param[out] buf     Receives the bytes of the window
+ * @param[in]  size    Size of the window
+ * @param[out] total   Receives the length of the snapshot
+ * @return number of bytes copied to buf
+ */
+uint32_t opendps_config_export(uint32_t offset, uint8_t *buf, uint32_t size, uint32_t *total);
+
+/**
+ * @brief Write a chunk of a settings snapshot, see clone_import()
+ *
+ * The snapshot takes effect in past once committed, the caller restarts
+ * the device with opendps_restart() for the settings to be used.
+ *
+ * @param[in] offset  Offset of the chunk in the snapshot
+ * @param[in] data    The chunk
+ * @param[in] count   Number of bytes in the chunk
+ * @param[in] commit  This is the last chunk
+ * @return clone_ok or the reason the import failed
+ */
+clone_status_t opendps_config_import(uint32_t offset, const uint8_t *data, uint32_t count, bool commit);
+#endif // CONFIG_CLONE
+
 /**
  * @brief Switch to a different screen
  *
@@ -374,7 +586,33 @@ void opendps_upgrade_start(void);
  *                      - 1: Settings/calibration screen
  * @return true if the screen was successfully changed
  * @return false if the screen_id is invalid
+ *
+ * @note The new screen is drawn by a job that runs after the caller returns
  */
 bool opendps_change_screen(uint8_t screen_id);
 
+/**
+ * @brief Startup phases timed by main(), in the order they complete
+ */
+typedef enum {
+    boot_hw_init = 0,   /**< Hardware initialized, the ADC is powering up */
+    boot_tft_init,      /**< Display controller initialized */
+    boot_past_init,     /**< Settings storage mounted */
+    boot_settings,      /**< Calibration and settings read from past */
+    boot_adc_ready,     /**< ADC calibrated and sampling */
+    boot_ui_init,       /**< Screens set up and UI jobs scheduled */
+    boot_ready,         /**< Splash screen gone, entering the event loop */
+    boot_loader,        /**< ms DPSBoot ran before the app, not a timestamp */
+    boot_phases
+} boot_phase_t;
+
+/**
+ * @brief Get the startup timestamps
+ *
+ * @return boot_phases times in ms since hw_init() started the SysTick, 0 for
+ *         phases not reached yet. boot_loader is the time spent in the
+ *         bootloader, 0 if it does not report it
+ */
+const uint32_t *opendps_boot_times(void);
+
 #endif // __OPENDPS_H__
@@ -29,6 +29,7 @@
 #include "past.h"
 #include <flash.h>
 #include "flashlock.h"
+#include "perf.h"
 
 /*
  * Friday the 13th of April: just discovered past gets corrupted when writing
@@ -55,9 +56,21 @@
  *    .
  * [ 0xffffffff ] [ 0xffffffff ]
  *
- * Each of the two Past blocks begin with the Past magic, followed by a past
- * counter which is increased by one for each garbage collection. The counter is
- * never expected to wrap as the number of erase cycles is far less than a 32
+ * Small units may instead be stored as compact units, with the id and size
+ * packed into a single header word:
+ *
+ * [ id:16 | 0xc5:8 | size:8 ] [   data+   ] [ padding <1-3 bytes> ]
+ *
+ * The short id keeps the top and bottom bytes of the unit id, which covers the
+ * ids of pastunits.h and the (SCREEN_ID << 24) | n screen units. The 0xc5 tag
+ * tells a compact header from a unit id, unit ids with 0xc5 in bits 8..15 are
+ * therefore reserved. Compact units are read whatever the build, they are only
+ * written when CONFIG_PAST_COMPACT is defined. A four byte setting then takes
+ * 8 bytes instead of 12.
+ *
+ * Each Past block in use begins with the Past magic, followed by a past
+ * counter which is increased by one for each block taken into use. The counter
+ * is never expected to wrap as the number of erase cycles is far less than a 32
  * bit ingeter...
  *
  * Each unit begins at an even 32 bit boundary. The unit id 0xffffffff denotes
@@ -66,9 +79,13 @@
  * (MWU) on the STM32F100, for which this module is targeted. It adapting this
  * module for eg. STM32F4s, that need to change because of the MWU of 8 bytes.
  *
- * Past uses two blocks. When one block is full (it gets filled as parameters
- * are added (obviously) and rewritten) the block is compacted and rewritten
- * into the other Past block.
+ * Past uses a ring of PAST_NUM_BLOCKS blocks (two by default). Units are
+ * appended to the block with the highest counter. When it is full (it gets
+ * filled as parameters are added (obviously) and rewritten) the next erased
+ * block is taken into use. One block is always kept erased, when no other is
+ * left the oldest block is compacted into it and erased. With two blocks this
+ * is the classic ping-pong scheme, more blocks spread the erase cycles and
+ * make garbage collections less frequent.
  *
  * * Writing a unit *
  * When writing a unit, the unit data is written first. Secondly, the size and
@@ -76,10 +93,16 @@
  * change that power is lost during this last write. If so, an attempt will be
  * made to clean up the write during the next power cycle.
  *
+ * The header word of a compact unit is written last in the same way. Flash
+ * is programmed a halfword at a time, the short id in the upper halfword goes
+ * last and a header with the short id 0xffff is an uncommitted unit that is
+ * skipped like a removed one.
+ *
  * * Removing a unit *
  * When removing a unit, the id field is written as 0x00000000, the length is
  * kept and the data is overwritten with zeros. This is why 0 is not a valid
- * unit id.
+ * unit id. For compact units only the short id halfword is cleared, keeping
+ * the size.
  *
  * * Rewriting a unit *
  * Rewriting is not an operation in itself in terms that the user does not have
@@ -88,12 +111,17 @@
  *
  * * Reading a unit *
  * When reading a unit, a pointer to the data in flash is returned along with
- * the size. The data is read only.
+ * the size. The data is read only. Unit addresses are kept in a small hashed
+ * RAM index built at startup and updated on writes, erases and garbage
+ * collections so finding a unit usually needs no scan.
  *
  * * Past startup *
  * When the module is initialized, the integrity of the Past data is checked.
- * First, the module selects the current data block based on the Past counters
- * at offset 4 (assuming the Past magics are in place). Next the data is checked
+ * First, the module orders the blocks in use based on the Past counters at
+ * offset 4 (assuming the Past magics are in place), the current data block is
+ * the one with the highest counter. Copies of a unit left by an interrupted
+ * write or garbage collection are removed, keeping the newest one. Next the
+ * data of the current block is checked
  * for consistency. It should be possible to reach the end marker unit
  * (0xffffffff) while parsing the data. If so, the resto of the block is checked
  * for erased data. If none erased data is found following the end marker, we
@@ -103,10 +131,17 @@
  * * Garbage collection *
  * As units get rewritten, Past will be filled with old unit data an at some
  * point it will be full. At this point it will perform a garbage collection,
- * copying all units to the other flash block. It will first erase that block
- * and then copy the valid data from the old block. When completed it will
- * update the block counter att offset 4 and at the very last write the past
- * magic at offset 0.
+ * copying all units of the oldest block to the erased block. It will first
+ * erase that block and then copy the valid data from the old block. When
+ * completed it will update the block counter att offset 4, write the past
+ * magic at offset 0 and at the very last erase the old block.
+ *
+ * Garbage collection runs incrementally when a write leaves the block nearly
+ * full. Each call to past_gc_step() erases one page or copies a few units.
+ * The old block is used for reading until the magic of the new block has
+ * been written, after that the copies in the new block are the newest ones, so
+ * a power failure during GC is handled as above. Writes and erases during GC
+ * complete it first as they would otherwise be missed by the copying.
  *
  */
 
@@ -116,25 +151,73 @@
 /** The 'end' unit is the first chunk of unwritten flash */
 #define PAST_UNIT_ID_END      (0xffffffff)
 
-#define PAST_BLOCK_SIZE     (1024)  //STM32F100
-
 #define HEADER_COUNTER_OFFSET     (4)
 #define HEADER_FIRST_UNIT_OFFSET  (8)
 
 #define UNIT_SIZE_OFFSET  (4)
 #define UNIT_DATA_OFFSET  (8)
 
+/** Compact units, [short id:16][tag:8][size:8] followed by the data */
+#define UNIT_COMPACT_TAG           (0xc5)
+#define UNIT_COMPACT_DATA_OFFSET   (4)
+#define UNIT_COMPACT_MAX_SIZE      (0xff)
+#define UNIT_COMPACT_ID_UNCOMMITTED (0xffff)
+#define UNIT_IS_COMPACT(word)      ((((word) >> 8) & 0xff) == UNIT_COMPACT_TAG)
+/** Short ids keep the top and bottom bytes of the unit id */
+#define UNIT_SHORT_ID(id)          ((((id) >> 16) & 0xff00) | ((id) & 0xff))
+#define UNIT_LONG_ID(short_id)     ((((short_id) & 0xff00) << 16) | ((short_id) & 0xff))
+
 #define PAST_GC_LIMIT    (32)
 
+/** Live units copied per past_gc_step() */
+#define PAST_GC_UNITS_PER_STEP  (4)
+
+/** Incremental GC states */
+#define PAST_GC_IDLE     (0)
+#define PAST_GC_ERASE    (1) /** Erase the new block */
+#define PAST_GC_COPY     (2) /** Copy live units to the new block */
+#define PAST_GC_COMMIT   (3) /** Write the new block header and switch to it */
+#define PAST_GC_CLEANUP  (4) /** Erase the old block */
+
+/** No block, for GCs that only take a new block into use */
+#define PAST_BLOCK_NONE  (0xffffffff)
+
 static int32_t past_find_unit(past_t *past, past_id_t id);
+static int32_t past_scan_block(uint32_t base, past_id_t id);
+static bool past_block_is_empty(uint32_t base);
+static void past_order_insert(past_t *past, uint32_t block);
+static void past_order_remove(past_t *past, uint32_t block);
+static void past_build_index(past_t *past);
+static void past_clear_index(past_t *past);
+static past_index_t *past_index_entry(past_t *past, past_id_t id, bool insert);
+static void past_index_set(past_t *past, past_id_t id, uint32_t address);
+#ifdef CONFIG_PAST_WRITE_BEHIND
+static past_queued_unit_t *past_find_queued(past_t *past, past_id_t id);
+static bool past_dequeue(past_t *past, past_id_t id);
+static bool past_unit_equals(uint32_t address, const uint8_t *data, uint32_t length);
+#endif // CONFIG_PAST_WRITE_BEHIND
 static bool past_erase_unit_at(uint32_t address);
 static bool past_garbage_collect(past_t *past);
+static bool past_gc_start(past_t *past, bool compact_cur_block);
+static bool past_gc_settle(past_t *past);
 static inline bool flash_write32(uint32_t address, uint32_t data);
 static inline uint32_t flash_read32(uint32_t address); /** @todo Make a macro out of read32*/
+static inline const void *flash_data(uint32_t address);
 #ifndef CONFIG_PAST_NO_GC
-static bool copy_parameters(past_t *past, uint32_t src_base, uint32_t dst_base);
+static bool copy_units(past_t *past, uint32_t src_base, uint32_t count);
 #endif // CONFIG_PAST_NO_GC
 static uint32_t past_remaining_size(past_t *past);
+static uint32_t past_unit_header(uint32_t address, past_id_t *id, uint32_t *size);
+#ifdef CONFIG_PAST_COMPACT
+static uint32_t past_compact_header(past_id_t id, uint32_t length);
+#endif // CONFIG_PAST_COMPACT
+static inline bool flash_write16(uint32_t address, uint16_t data);
+static inline uint32_t word_align(uint32_t size);
+#ifdef CONFIG_PAST_STAGING
+static bool past_drop_unit(past_t *past, past_id_t id);
+static bool past_find_staged(past_t *past, past_id_t *id);
+static bool past_apply_staged(past_t *past);
+#endif // CONFIG_PAST_STAGING
 
 /**
   * @brief Initialize the past, format or garbage collect if needed
@@ -146,47 +229,73 @@ bool past_init(past_t *past)
 {
     bool success = false;
     if (past) {
-        /** Check which block is the current one */
-        uint32_t magic_1 = flash_read32(past->blocks[0]);
-        uint32_t magic_2 = flash_read32(past->blocks[1]);
-        uint32_t counter_1 = flash_read32(past->blocks[0] + HEADER_COUNTER_OFFSET);
-        uint32_t counter_2 = flash_read32(past->blocks[1] + HEADER_COUNTER_OFFSET);
+        past->_gc_state = PAST_GC_IDLE;
+        past->_num_used = 0;
+        /** Find the blocks in use, the current one has the highest counter */
+        for (uint32_t i = 0; i < PAST_NUM_BLOCKS; i++) {
+            if (PAST_MAGIC == flash_read32(past->blocks[i])) {
+                past_order_insert(past, i);
+            }
+        }
         success = true;
-        if (PAST_MAGIC == magic_1 && PAST_MAGIC == magic_2) {
-            past->_cur_block = counter_2 > counter_1 ? 1 : 0;
-            past->_counter = counter_2 > counter_1 ? counter_2 : counter_1;
-        } else if (PAST_MAGIC == magic_2) {
-            past->_cur_block = 1;
-            past->_counter = counter_2;
-        } else if (PAST_MAGIC == magic_1) {
-            past->_cur_block = 0;
-            past->_counter = counter_1;
+        if (past->_num_used) {
+            past->_cur_block = past->_order[past->_num_used - 1];
+            past->_counter = flash_read32(past->blocks[past->_cur_block] + HEADER_COUNTER_OFFSET);
         } else {
-            /** No valid Past in either block */
-            past->_cur_block = 0;
-            past->_counter = 0;
+            /** No valid Past in any block */
             success &= past_format(past);
         }
         if (success) {
-            int32_t addr = past_find_unit(past, PAST_UNIT_ID_END);
+            bool compact = false;
+            uint32_t base = past->blocks[past->_cur_block];
+            int32_t addr = past_scan_block(base, PAST_UNIT_ID_END);
             if (addr < 0) {
                 /** Past is full as current block contains no erased space */
-                past->_valid = success = past_garbage_collect(past);
+                past->_end_addr = base + PAST_BLOCK_SIZE;
+                compact = true;
             } else {
                 past->_end_addr = (uint32_t) addr;
-                past->_valid = true;
+                /** Now check all space following the end address is erased space.
+                  * If not we have a half completed write operation we need to clear
+                  * by a garbage collect */
+                uint32_t check_addr = past->_end_addr;
+                while (check_addr < base + PAST_BLOCK_SIZE) {
+                    if (flash_read32(check_addr) != PAST_UNIT_ID_END) {
+                        compact = true;
+                        break;
+                    }
+                    check_addr += 4;
+                }
             }
-            /** Now check all space following the end address is erased space.
-              * If not we have a half completed write operation we need to clear
-              * by a garbage collect */
-            uint32_t check_addr = past->_end_addr;
-            while (check_addr < past->blocks[past->_cur_block] + PAST_BLOCK_SIZE) {
-                if (flash_read32(check_addr) != PAST_UNIT_ID_END) {
-                    success &= past_garbage_collect(past);
-                    break;
+            past->_valid = true;
+            /** Also removes old copies of units left by interrupted writes and GCs */
+            past_build_index(past);
+            /** A GC interrupted before erasing the block it emptied */
+            uint32_t i = 0;
+            while (i + 1 < past->_num_used) {
+                uint32_t block = past->_order[i];
+                if (past_block_is_empty(past->blocks[block])) {
+                    unlock_flash();
+                    flash_erase_page(past->blocks[block]);
+                    lock_flash();
+                    past_order_remove(past, block);
+                } else {
+                    i++;
                 }
-                check_addr += 4;
             }
+            if (compact) {
+                past->_valid = success = past_gc_start(past, true) && past_gc_settle(past);
+            }
+#ifdef CONFIG_PAST_STAGING
+            /** Finish a commit cut short by a reset, or drop what was staged */
+            if (success) {
+                if (past_find_unit(past, PAST_UNIT_ID_COMMIT) > 0) {
+                    (void) past_apply_staged(past);
+                } else {
+                    (void) past_abort(past);
+                }
+            }
+#endif // CONFIG_PAST_STAGING
         }
     }
     return success;
@@ -207,19 +316,133 @@ bool past_read_unit(past_t *past, past_id_t id, const void **data, uint32_t *len
         return false;
     }
     *length = 0;
+#ifdef CONFIG_PAST_WRITE_BEHIND
+    past_queued_unit_t *queued = past_find_queued(past, id);
+    if (queued) {
+        *length = queued->length;
+        *data = (const void*) queued->data;
+        return true;
+    }
+#endif // CONFIG_PAST_WRITE_BEHIND
     int32_t address = past_find_unit(past, id);
     if (address > 0) {
-        *length = flash_read32(address + UNIT_SIZE_OFFSET);
+        past_id_t cur_id;
+        uint32_t data_offset = past_unit_header(address, &cur_id, length);
 #ifdef DPS_EMULATOR
-        uint32_t temp = flash_read32(address + UNIT_DATA_OFFSET);
+        uint32_t temp = flash_read32(address + data_offset);
         *data = (const void*) &temp;
 #else // DPS_EMULATOR
-        *data = (const void*) address + UNIT_DATA_OFFSET;
+        *data = (const void*) address + data_offset;
 #endif // DPS_EMULATOR
     }
     return address > 0 ? true : false;
 }
 
+/**
+  * @brief Start a walk over all units in past
+  * @param past An initialized past structure
+  * @param iter Walk position to initialize
+  * @retval none
+  */
+void past_iter_init(past_t *past, past_iter_t *iter)
+{
+    (void) past;
+    memset(iter, 0, sizeof(*iter));
+}
+
+/**
+  * @brief Get the next unit of a walk over past
+  * @param past An initialized past structure
+  * @param iter Walk position
+  * @param id Unit id read
+  * @param data Pointer to data read
+  * @param length Length of data read
+  * @retval true if a unit was read
+  *         false at the end of the walk
+  */
+bool past_iter_next(past_t *past, past_iter_t *iter, past_id_t *id, const void **data, uint32_t *length)
+{
+    if (!past || !past->_valid || !iter || !id || !data || !length) {
+        return false;
+    }
+    while (iter->_block < past->_num_used) {
+        uint32_t base = past->blocks[past->_order[iter->_block]];
+        if (!iter->_address) {
+            iter->_address = base + HEADER_FIRST_UNIT_OFFSET;
+        }
+        while (iter->_address < base + PAST_BLOCK_SIZE) {
+            uint32_t address = iter->_address;
+            past_id_t cur_id;
+            uint32_t cur_size;
+            uint32_t data_offset = past_unit_header(address, &cur_id, &cur_size);
+            if (!data_offset) {
+                break;
+            }
+            iter->_address += data_offset + word_align(cur_size);
+            if (cur_id == PAST_UNIT_ID_INVALID) {
+                continue;
+            }
+#ifdef CONFIG_PAST_WRITE_BEHIND
+            if (past_find_queued(past, cur_id)) {
+                continue; /** Returned with the queued units */
+            }
+#endif // CONFIG_PAST_WRITE_BEHIND
+            /** A GC copies units before the block they came from is erased */
+            if (past->_gc_state != PAST_GC_IDLE && past_find_unit(past, cur_id) != (int32_t) address) {
+                continue;
+            }
+            *id = cur_id;
+            *length = cur_size;
+#ifdef DPS_EMULATOR
+            iter->_temp = flash_read32(address + data_offset);
+            *data = (const void*) &iter->_temp;
+#else // DPS_EMULATOR
+            *data = (const void*) (address + data_offset);
+#endif // DPS_EMULATOR
+            return true;
+        }
+        iter->_block++;
+        iter->_address = 0;
+    }
+#ifdef CONFIG_PAST_WRITE_BEHIND
+    if (iter->_queued < past->_queue_count) {
+        past_queued_unit_t *queued = &past->_queue[iter->_queued++];
+        *id = queued->id;
+        *length = queued->length;
+        *data = (const void*) queued->data;
+        return true;
+    }
+#endif // CONFIG_PAST_WRITE_BEHIND
+    return false;
+}
+
+/**
+  * @brief Read several units from past in one walk
+  * @param past An initialized past structure
+  * @param readers Unit ids and their restore handlers
+  * @param count Number of readers
+  * @retval number of restore handlers called
+  */
+uint32_t past_read_many(past_t *past, const past_reader_t *readers, uint32_t count)
+{
+    uint32_t found = 0;
+    past_iter_t iter;
+    past_id_t id;
+    const void *data;
+    uint32_t length;
+    past_iter_init(past, &iter);
+    while (past_iter_next(past, &iter, &id, &data, &length)) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (readers[i].id == id) {
+                readers[i].restore(&readers[i], data, length);
+                found++;
+                break;
+            }
+        }
+    }
+    return found;
+}
+
 /**
   * @brief Write unit to past
   * @param past An initialized past structure
@@ -234,7 +457,7 @@ bool past_write_unit(past_t *past, past_id_t id, void *data, uint32_t length)
     if (length < 4) {
         return false; /** https://github.com/kanflo/opendps/issues/27 */
     }
-    if (!past || !past->_valid || !data || !length || id == PAST_UNIT_ID_INVALID || id == PAST_UNIT_ID_END) {
+    if (!past || !past->_valid || !data || !length || id == PAST_UNIT_ID_INVALID || id == PAST_UNIT_ID_END || UNIT_IS_COMPACT(id)) {
 #ifdef DPS_EMULATOR
         if (!past) {
             emu_printf("Past is NULL\n");
@@ -254,42 +477,57 @@ bool past_write_unit(past_t *past, past_id_t id, void *data, uint32_t length)
         if (id == PAST_UNIT_ID_END) {
             emu_printf("Id is equal to end\n");
         }
+        if (UNIT_IS_COMPACT(id)) {
+            emu_printf("Id is reserved for compact units\n");
+        }
 #endif // DPS_EMULATOR
         return false;
     }
+#ifdef CONFIG_PAST_COMPACT
+    uint32_t compact_header = past_compact_header(id, length);
+#else // CONFIG_PAST_COMPACT
+    uint32_t compact_header = 0;
+#endif // CONFIG_PAST_COMPACT
+    uint32_t data_offset = compact_header ? UNIT_COMPACT_DATA_OFFSET : UNIT_DATA_OFFSET;
+    if (data_offset + length > PAST_BLOCK_SIZE - HEADER_FIRST_UNIT_OFFSET) {
+        return false; /** Would never fit in a block */
+    }
     uint32_t end_address;
     uint32_t wi = 0; /** word index */
     uint32_t temp;
     bool success = false;
-    unlock_flash();
-
-    if (past_remaining_size(past) < UNIT_DATA_OFFSET + length) {
+    PERF_BEGIN(perf_past_write);
+#ifdef CONFIG_PAST_WRITE_BEHIND
+    /** This write supersedes any queued one */
+    (void) past_dequeue(past, id);
+#endif // CONFIG_PAST_WRITE_BEHIND
+    if (!past_gc_settle(past)) {
+        return false;
+    }
+    /** Each GC frees the space of one more block, the oldest one might be
+      * mostly valid units */
+    for (uint32_t i = 0; i < PAST_NUM_BLOCKS && past_remaining_size(past) < data_offset + length; i++) {
         if (!past_garbage_collect(past)) {
             return false;
         }
     }
-    if (past_remaining_size(past) < UNIT_DATA_OFFSET + length) {
+    if (past_remaining_size(past) < data_offset + length) {
         return false;
     }
+    /** Unlock after GC as it locks the flash when done */
+    unlock_flash();
     end_address = past->_end_addr;
     do {
         /** Check if there is an old version of the unit */
         int32_t old_addr = past_find_unit(past, id);
-        /** Write the new unit */
-        if (!flash_write32(end_address+UNIT_SIZE_OFFSET, length)) {
+        /** Write the new unit, compact units have the size in the header */
+        if (!compact_header && !flash_write32(end_address+UNIT_SIZE_OFFSET, length)) {
             break;
         }
-        while(4*wi < length) {
-            temp = ((uint32_t*)(data))[wi];
-            if (!flash_write32(end_address+UNIT_DATA_OFFSET+4*wi, temp)) {
-                break;
-            }
-            wi++;
-            if (length % 4 && 4*(wi+1) >= length) {
-                /** Data not even multiple of 4, reading one more word would
-                  * cause an out of bound buffer read */
-                break;
-            }
+        /** The whole words in one go, reading no further than length */
+        wi = length / 4;
+        if (wi && !flash_program_block(end_address+data_offset, data, 4*wi)) {
+            break;
         }
         if (length % 4) { /** Write remaining 1..3 bytes */
             temp = 0;
@@ -297,15 +535,16 @@ bool past_write_unit(past_t *past, past_id_t id, void *data, uint32_t length)
                 uint8_t b = ((uint8_t*)(data))[4*wi + i];
                 temp |= b << (8*i);
             }
-            if (!flash_write32(end_address+UNIT_DATA_OFFSET+4*wi, temp)) {
+            if (!flash_write32(end_address+data_offset+4*wi, temp)) {
                 break;
             }
         }
-        if (!flash_write32(end_address, id)) {
+        if (!flash_write32(end_address, compact_header ? compact_header : id)) {
             break;
         }
+        past_index_set(past, id, end_address);
         /** Update end addres of the past struct */
-        end_address += UNIT_DATA_OFFSET + length;
+        end_address += data_offset + length;
         if (end_address % 4) {
             end_address += 4 - (end_address % 4); // Word align
         }
@@ -320,8 +559,13 @@ bool past_write_unit(past_t *past, past_id_t id, void *data, uint32_t length)
         success = true;
     } while(0);
     lock_flash();
-    /** This serves as a workaround for #53 */
-    (void) past_gc_check(past);
+#ifndef CONFIG_PAST_NO_GC
+    /** Move on to the next block before this one is full, this serves as a workaround for #53 */
+    if (success && past->_gc_state == PAST_GC_IDLE && past_remaining_size(past) < PAST_GC_LIMIT) {
+        (void) past_gc_start(past, false);
+    }
+#endif // CONFIG_PAST_NO_GC
+    PERF_END(perf_past_write);
     return success;
 }
 
@@ -338,8 +582,20 @@ bool past_erase_unit(past_t *past, past_id_t id)
         return false;
     }
     bool success = false;
+#ifdef CONFIG_PAST_WRITE_BEHIND
+    bool was_queued = past_dequeue(past, id);
+#endif // CONFIG_PAST_WRITE_BEHIND
+    if (!past_gc_settle(past)) {
+        return false;
+    }
     do {
         int32_t address = past_find_unit(past, id);
+#ifdef CONFIG_PAST_WRITE_BEHIND
+        if (address < 0 && was_queued) {
+            success = true; /** Never made it to flash */
+            break;
+        }
+#endif // CONFIG_PAST_WRITE_BEHIND
         if (address == 0) {
             break;
         } else if (address < 0) {
@@ -348,13 +604,229 @@ bool past_erase_unit(past_t *past, past_id_t id)
         if (!past_erase_unit_at((uint32_t) address)) {
             break;
         }
+        past_index_set(past, id, 0);
         success = true;
     } while(0);
     return success;
 }
 
 /**
-  * @brief Format the past area (both blocks) and initialize the first one
+  * @brief Queue unit write, coalescing it with any queued write of the unit
+  * @param past An initialized past structure
+  * @param id Unit id to write
+  * @param data Data to write
+  * @param length Size of data
+  * @retval true if the unit was queued or written
+  *         false if the unit was invalid or writing failed
+  */
+bool past_queue_unit(past_t *past, past_id_t id, void *data, uint32_t length)
+{
+#ifdef CONFIG_PAST_WRITE_BEHIND
+    if (!past || !past->_valid || !data || length < 4 || id == PAST_UNIT_ID_INVALID || id == PAST_UNIT_ID_END || UNIT_IS_COMPACT(id)) {
+        return false;
+    }
+    if (length > PAST_QUEUE_DATA_SIZE) {
+        return past_write_unit(past, id, data, length);
+    }
+    past_queued_unit_t *queued = past_find_queued(past, id);
+    if (!queued) {
+        if (past->_queue_count == PAST_QUEUE_SIZE && !past_flush(past)) {
+            return false;
+        }
+        queued = &past->_queue[past->_queue_count++];
+        queued->id = id;
+    }
+    queued->length = length;
+    memcpy(queued->data, data, length);
+    return true;
+#else // CONFIG_PAST_WRITE_BEHIND
+    return past_write_unit(past, id, data, length);
+#endif // CONFIG_PAST_WRITE_BEHIND
+}
+
+/**
+  * @brief Write queued units to flash
+  * @param past An initialized past structure
+  * @retval true if all queued units were written
+  *         false if writing failed
+  */
+bool past_flush(past_t *past)
+{
+    bool success = true;
+#ifdef CONFIG_PAST_WRITE_BEHIND
+    if (!past || !past->_valid) {
+        return false;
+    }
+    while (past->_queue_count) {
+        past_queued_unit_t unit = past->_queue[0];
+        (void) past_dequeue(past, unit.id);
+        int32_t address = past_find_unit(past, unit.id);
+        if (address > 0 && past_unit_equals((uint32_t) address, (uint8_t*) unit.data, unit.length)) {
+            continue; /** Already in flash */
+        }
+        success &= past_write_unit(past, unit.id, (void*) unit.data, unit.length);
+    }
+#else // CONFIG_PAST_WRITE_BEHIND
+    (void) past;
+#endif // CONFIG_PAST_WRITE_BEHIND
+    return success;
+}
+
+/**
+  * @brief Check for queued unit writes
+  * @param past An initialized past structure
+  * @retval true if there are queued writes
+  */
+bool past_pending(past_t *past)
+{
+#ifdef CONFIG_PAST_WRITE_BEHIND
+    return past && past->_queue_count > 0;
+#else // CONFIG_PAST_WRITE_BEHIND
+    (void) past;
+    return false;
+#endif // CONFIG_PAST_WRITE_BEHIND
+}
+
+#ifdef CONFIG_PAST_STAGING
+/**
+  * @brief Stage a unit write or erase for past_commit()
+  * @param past An initialized past structure
+  * @param id Unit id to stage
+  * @param data Data to write, NULL to stage an erase
+  * @param length Size of data
+  * @retval true if the unit was staged
+  *         false if the unit was invalid or writing failed
+  */
+bool past_stage_unit(past_t *past, past_id_t id, void *data, uint32_t length)
+{
+    if (!past || !past->_valid || (id & (PAST_STAGED_BIT | PAST_STAGED_ERASE_BIT)) ||
+        id == PAST_UNIT_ID_COMMIT || length > PAST_STAGE_DATA_SIZE) {
+        return false;
+    }
+    /** The last staging of a unit wins */
+    if (!past_drop_unit(past, id | PAST_STAGED_BIT | (data ? PAST_STAGED_ERASE_BIT : 0))) {
+        return false;
+    }
+    if (!data) {
+        uint32_t none = 0;
+        return past_write_unit(past, id | PAST_STAGED_BIT | PAST_STAGED_ERASE_BIT, (void*) &none, sizeof(none));
+    }
+    return past_write_unit(past, id | PAST_STAGED_BIT, data, length);
+}
+
+/**
+  * @brief Apply all staged units behind a commit record
+  * @param past An initialized past structure
+  * @retval true if all staged units were applied
+  *         false if writing failed
+  */
+bool past_commit(past_t *past)
+{
+    uint32_t record = 0;
+    if (!past || !past->_valid || !past_write_unit(past, PAST_UNIT_ID_COMMIT, (void*) &record, sizeof(record))) {
+        return false;
+    }
+    return past_apply_staged(past);
+}
+
+/**
+  * @brief Erase all staged units
+  * @param past An initialized past structure
+  * @retval true if all staged units were erased
+  *         false if erasing failed
+  */
+bool past_abort(past_t *past)
+{
+    past_id_t staged;
+    if (!past || !past->_valid) {
+        return false;
+    }
+    while (past_find_staged(past, &staged)) {
+        if (!past_erase_unit(past, staged)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+  * @brief Erase a unit if it is stored or queued
+  * @param past An initialized past structure
+  * @param id Unit id to erase
+  * @retval true if the unit is gone
+  *         false if erasing failed
+  */
+static bool past_drop_unit(past_t *past, past_id_t id)
+{
+#ifdef CONFIG_PAST_WRITE_BEHIND
+    (void) past_dequeue(past, id);
+#endif // CONFIG_PAST_WRITE_BEHIND
+    return past_find_unit(past, id) > 0 ? past_erase_unit(past, id) : true;
+}
+
+/**
+  * @brief Find any staged unit
+  * @param past An initialized past structure
+  * @param id The staged id found
+  * @retval true if a staged unit was found
+  */
+static bool past_find_staged(past_t *past, past_id_t *id)
+{
+    past_iter_t iter;
+    const void *data;
+    uint32_t length;
+    past_iter_init(past, &iter);
+    while (past_iter_next(past, &iter, id, &data, &length)) {
+        if (*id & PAST_STAGED_BIT) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+  * @brief Move the staged units to their ids and erase the commit record,
+  *        the walk restarts after each unit as writes move units around
+  * @param past An initialized past structure
+  * @retval true if all staged units were applied
+  *         false if writing failed
+  */
+static bool past_apply_staged(past_t *past)
+{
+    uint32_t buffer[PAST_STAGE_DATA_SIZE / 4];
+    past_id_t staged;
+    while (past_find_staged(past, &staged)) {
+        past_id_t id = staged & ~(PAST_STAGED_BIT | PAST_STAGED_ERASE_BIT);
+        if (staged & PAST_STAGED_ERASE_BIT) {
+            if (!past_drop_unit(past, id)) {
+                return false;
+            }
+        } else {
+            past_id_t cur_id;
+            uint32_t length;
+            int32_t address = past_find_unit(past, staged);
+            if (address <= 0) {
+                return false;
+            }
+            uint32_t data_offset = past_unit_header((uint32_t) address, &cur_id, &length);
+            if (length > sizeof(buffer)) {
+                return false;
+            }
+            memcpy(buffer, flash_data((uint32_t) address + data_offset), length);
+            if (!past_write_unit(past, id, (void*) buffer, length)) {
+                return false;
+            }
+        }
+        if (!past_erase_unit(past, staged)) {
+            return false;
+        }
+    }
+    return past_drop_unit(past, PAST_UNIT_ID_COMMIT);
+}
+#endif // CONFIG_PAST_STAGING
+
+/**
+  * @brief Format the past area (all blocks) and initialize the first one
   * @param past pointer to an initialized past structure
   * @retval True if formatting was successful
   *         False in case of unrecoverable errors
@@ -362,23 +834,32 @@ bool past_erase_unit(past_t *past, past_id_t id)
 bool past_format(past_t *past)
 {
     bool success = false;
-    if (!past || /* !past->blocks[0] || */ !past->blocks[1]) {
+    if (!past || /* !past->blocks[0] || */ !past->blocks[PAST_NUM_BLOCKS - 1]) {
         return success;
     }
     unlock_flash();
     do {
         uint32_t cur_base;
-        flash_erase_page(past->blocks[0]);
-        if (!(FLASH_SR_EOP & flash_get_status_flags())) {
-            break;
+        uint32_t i;
+        for (i = 0; i < PAST_NUM_BLOCKS; i++) {
+            flash_erase_page(past->blocks[i]);
+            if (!(FLASH_SR_EOP & flash_get_status_flags())) {
+                break;
+            }
         }
-        flash_erase_page(past->blocks[1]);
-        if (!(FLASH_SR_EOP & flash_get_status_flags())) {
+        if (i < PAST_NUM_BLOCKS) {
             break;
         }
         past->_cur_block = 0;
         past->_counter = 0;
+        past->_order[0] = 0;
+        past->_num_used = 1;
         past->_end_addr = past->blocks[0] + HEADER_FIRST_UNIT_OFFSET;
+        past->_gc_state = PAST_GC_IDLE;
+        past_clear_index(past);
+#ifdef CONFIG_PAST_WRITE_BEHIND
+        past->_queue_count = 0;
+#endif // CONFIG_PAST_WRITE_BEHIND
         cur_base = past->blocks[past->_cur_block];
         if (!flash_write32(cur_base + HEADER_COUNTER_OFFSET, past->_counter)) {
             break;
@@ -416,110 +897,362 @@ static uint32_t past_remaining_size(past_t *past)
 static bool past_erase_unit_at(uint32_t address)
 {
     bool success = true;
-    uint32_t length = flash_read32(address + UNIT_SIZE_OFFSET);
+    past_id_t id;
+    uint32_t length;
+    uint32_t data_offset = past_unit_header(address, &id, &length);
+    if (!data_offset) {
+        return false;
+    }
     unlock_flash();
 
-    if (length % 4) {
-        length = 4*(length/4) + 4;
-    }
+    length = word_align(length);
     do {
         /** Wipe data, always an even multiple of 4 bytes */
         for (uint32_t i = 0; i < length/4 && success; i++) {
-            success &= flash_write32(address + UNIT_DATA_OFFSET + 4*i, 0);
+            success &= flash_write32(address + data_offset + 4*i, 0);
+        }
+        /** Wipe unit id, compact units keep the size in the lower halfword */
+        if (data_offset == UNIT_COMPACT_DATA_OFFSET) {
+            success &= flash_write16(address + 2, 0);
+        } else {
+            success &= flash_write32(address, 0);
         }
-        /** Wipe unit id */
-        success &= flash_write32(address, 0);
     } while(0);
     lock_flash();
     return success;
 }
 
 /**
-  * @brief Find unit and return address
+  * @brief Find the newest copy of a unit and return address
   * @param past pointer to an initialized past structure
   * @param id id of unit to search for
   * @retval address of unit or -1 if not found or an error occured
   */
 static int32_t past_find_unit(past_t *past, past_id_t id)
 {
-    uint32_t base = past->blocks[past->_cur_block];
+    if (id == PAST_UNIT_ID_END) {
+        return past_scan_block(past->blocks[past->_cur_block], id);
+    } else if (id != PAST_UNIT_ID_INVALID) {
+        past_index_t *entry = past_index_entry(past, id, false);
+        if (entry) {
+            return entry->address ? (int32_t) entry->address : -1;
+        } else if (!past->_index_overflow) {
+            return -1; /** Every unit in the blocks is indexed */
+        }
+    }
+    for (uint32_t i = past->_num_used; i > 0; i--) {
+        int32_t address = past_scan_block(past->blocks[past->_order[i - 1]], id);
+        if (address >= 0) {
+            return address;
+        }
+    }
+    return -1;
+}
+
+/**
+  * @brief Find the last copy of a unit in a block
+  * @param base base address of the block
+  * @param id id of unit to search for, PAST_UNIT_ID_END finds the end of the block
+  * @retval address of unit or -1 if not found or an error occured
+  */
+static int32_t past_scan_block(uint32_t base, past_id_t id)
+{
     uint32_t cur_address = base + HEADER_FIRST_UNIT_OFFSET;
-    uint32_t cur_id, cur_size;
-    bool found = false;
-    do {
-        cur_id = flash_read32(cur_address);
+    past_id_t cur_id;
+    uint32_t cur_size;
+    int32_t found = -1;
+    while (cur_address < base + PAST_BLOCK_SIZE) {
+        uint32_t data_offset = past_unit_header(cur_address, &cur_id, &cur_size);
         if (id == cur_id) {
-            found = true;
+            found = (int32_t) cur_address;
+        }
+        if (!data_offset) {
+            break; /** Reached end or fatal error */
+        }
+        cur_address += data_offset + word_align(cur_size);
+    }
+    return found;
+}
+
+/**
+  * @brief Check if a block holds no valid units
+  * @param base base address of the block
+  * @retval true if all units in the block are erased
+  */
+static bool past_block_is_empty(uint32_t base)
+{
+    uint32_t cur_address = base + HEADER_FIRST_UNIT_OFFSET;
+    while (cur_address < base + PAST_BLOCK_SIZE) {
+        past_id_t cur_id;
+        uint32_t cur_size;
+        uint32_t data_offset = past_unit_header(cur_address, &cur_id, &cur_size);
+        if (!data_offset) {
             break;
-        } else if (cur_id == PAST_UNIT_ID_END) {
-            cur_address = 0; /** Reached end */
+        }
+        if (cur_id != PAST_UNIT_ID_INVALID) {
+            return false;
+        }
+        cur_address += data_offset + word_align(cur_size);
+    }
+    return true;
+}
+
+/**
+  * @brief Add a block to the blocks in use, keeping them ordered by counter
+  * @param past pointer to a past structure
+  * @param block index of the block
+  * @retval none
+  */
+static void past_order_insert(past_t *past, uint32_t block)
+{
+    uint32_t counter = flash_read32(past->blocks[block] + HEADER_COUNTER_OFFSET);
+    uint32_t i = past->_num_used;
+    while (i > 0 && flash_read32(past->blocks[past->_order[i - 1]] + HEADER_COUNTER_OFFSET) > counter) {
+        past->_order[i] = past->_order[i - 1];
+        i--;
+    }
+    past->_order[i] = block;
+    past->_num_used++;
+}
+
+/**
+  * @brief Remove a block from the blocks in use
+  * @param past pointer to a past structure
+  * @param block index of the block
+  * @retval none
+  */
+static void past_order_remove(past_t *past, uint32_t block)
+{
+    for (uint32_t i = 0; i < past->_num_used; i++) {
+        if (past->_order[i] == block) {
+            memmove(&past->_order[i], &past->_order[i + 1], past->_num_used - i - 1);
+            past->_num_used--;
             break;
-        } else { /** Move on */
-            cur_size = flash_read32(cur_address + UNIT_SIZE_OFFSET);
-            if (cur_size == 0 || cur_size == 0xffffffff) {
-                cur_address = -1; /** Fatal error */
+        }
+    }
+}
+
+/**
+  * @brief Rebuild the RAM index of unit addresses from the blocks in use,
+  *        erasing all but the newest copy of each unit
+  * @param past pointer to an initialized past structure
+  * @retval none
+  */
+static void past_build_index(past_t *past)
+{
+    past_clear_index(past);
+    for (uint32_t i = 0; i < past->_num_used; i++) {
+        uint32_t base = past->blocks[past->_order[i]];
+        uint32_t cur_address = base + HEADER_FIRST_UNIT_OFFSET;
+        while (cur_address < base + PAST_BLOCK_SIZE) {
+            past_id_t cur_id;
+            uint32_t cur_size;
+            uint32_t data_offset = past_unit_header(cur_address, &cur_id, &cur_size);
+            if (!data_offset) {
                 break;
             }
-            if (cur_size % 4) {
-                cur_size += 4 - (cur_size % 4); // Word align
+            if (cur_id != PAST_UNIT_ID_INVALID) {
+                /** Blocks are visited oldest first so a unit seen before is
+                  * an old copy, left by an interrupted write or GC */
+                uint32_t old_address = 0;
+                past_index_t *entry = past_index_entry(past, cur_id, true);
+                if (entry) {
+                    old_address = entry->address;
+                    entry->address = cur_address;
+                } else if (past_find_unit(past, cur_id) != (int32_t) cur_address) {
+                    old_address = cur_address; /** Not indexed, keep the copy a scan finds */
+                }
+                if (old_address) {
+                    (void) past_erase_unit_at(old_address);
+                }
             }
-            if (cur_size == 0) {
-                /** Make sure we do not get stuck */
-                cur_address = 0;
-                break;
+            cur_address += data_offset + word_align(cur_size);
+        }
+    }
+}
+
+/**
+  * @brief Empty the RAM index
+  * @param past pointer to an initialized past structure
+  * @retval none
+  */
+static void past_clear_index(past_t *past)
+{
+    memset(past->_index, 0, sizeof(past->_index));
+    past->_index_overflow = false;
+}
+
+/**
+  * @brief Find the index entry of a unit using linear probing
+  * @param past pointer to an initialized past structure
+  * @param id id of unit to look up
+  * @param insert add an entry for the unit if there is none
+  * @retval the entry or NULL if not found (or no room when inserting)
+  */
+static past_index_t *past_index_entry(past_t *past, past_id_t id, bool insert)
+{
+    /** Screen units keep the screen id in the top byte */
+    uint32_t slot = (id ^ (id >> 24)) % PAST_INDEX_SIZE;
+    for (uint32_t i = 0; i < PAST_INDEX_SIZE; i++) {
+        past_index_t *entry = &past->_index[(slot + i) % PAST_INDEX_SIZE];
+        if (entry->id == id) {
+            return entry;
+        } else if (entry->id == PAST_UNIT_ID_INVALID) {
+            if (!insert) {
+                return NULL;
             }
-            cur_address += UNIT_DATA_OFFSET + cur_size;
+            entry->id = id;
+            entry->address = 0;
+            return entry;
+        }
+    }
+    if (insert) {
+        past->_index_overflow = true;
+    }
+    return NULL;
+}
+
+/**
+  * @brief Update the address of a unit in the RAM index
+  * @param past pointer to an initialized past structure
+  * @param id id of unit
+  * @param address address of the unit or 0 if it was erased
+  * @retval none
+  */
+static void past_index_set(past_t *past, past_id_t id, uint32_t address)
+{
+    /** An erased unit keeps its entry, other lookups probe past it */
+    past_index_t *entry = past_index_entry(past, id, address != 0);
+    if (entry) {
+        entry->address = address;
+    }
+}
+
+#ifdef CONFIG_PAST_WRITE_BEHIND
+/**
+  * @brief Find queued write of unit
+  * @param past pointer to an initialized past structure
+  * @param id id of unit
+  * @retval the queued unit or NULL
+  */
+static past_queued_unit_t *past_find_queued(past_t *past, past_id_t id)
+{
+    for (uint32_t i = 0; i < past->_queue_count; i++) {
+        if (past->_queue[i].id == id) {
+            return &past->_queue[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+  * @brief Compare unit in flash with data
+  * @param address address of unit (points to id)
+  * @param data data to compare with
+  * @param length length of data
+  * @retval true if the unit holds exactly the given data
+  */
+static bool past_unit_equals(uint32_t address, const uint8_t *data, uint32_t length)
+{
+    past_id_t id;
+    uint32_t size;
+    uint32_t data_offset = past_unit_header(address, &id, &size);
+    if (!data_offset || size != length) {
+        return false;
+    }
+    for (uint32_t i = 0; i < length; i++) {
+        uint32_t word = flash_read32(address + data_offset + 4*(i/4));
+        if (((word >> (8*(i%4))) & 0xff) != data[i]) {
+            return false;
         }
+    }
+    return true;
+}
 
-    } while (cur_address < base + PAST_BLOCK_SIZE);
-    return found ? (int32_t) cur_address : -1;
+/**
+  * @brief Remove queued write of unit, keeping the queue in order
+  * @param past pointer to an initialized past structure
+  * @param id id of unit
+  * @retval true if the unit was queued
+  */
+static bool past_dequeue(past_t *past, past_id_t id)
+{
+    past_queued_unit_t *queued = past_find_queued(past, id);
+    if (!queued) {
+        return false;
+    }
+    uint32_t i = queued - past->_queue;
+    memmove(queued, queued + 1, (past->_queue_count - i - 1) * sizeof(*queued));
+    past->_queue_count--;
+    return true;
 }
+#endif // CONFIG_PAST_WRITE_BEHIND
 
 /**
-  * @brief Perform garbage collection
+  * @brief Perform garbage collection, completing any incremental GC in progress
   * @param past pointer to an initialized past structure
   * @retval true if GC was successful
   */
 static bool past_garbage_collect(past_t *past)
+{
+    if (past->_gc_state == PAST_GC_IDLE && !past_gc_start(past, false)) {
+        return false;
+    }
+    return past_gc_settle(past);
+}
+
+/**
+  * @brief Start an incremental GC taking the next erased block into use
+  * @param past pointer to an initialized past structure
+  * @param compact_cur_block move the units of the current block instead of
+  *        those of the oldest one
+  * @retval true if the GC was started
+  */
+static bool past_gc_start(past_t *past, bool compact_cur_block)
 {
 #ifdef CONFIG_PAST_NO_GC
     (void) past;
+    (void) compact_cur_block;
     return true; /** Always consider it a success if functionality is lacking */
 #else // CONFIG_PAST_NO_GC
-    bool success = false;
-    unlock_flash();
-    do {
-        /** Format the new block */
-        uint32_t new_block = past->blocks[past->_cur_block ? 0 : 1];
-        uint32_t old_block = past->blocks[past->_cur_block];
-        flash_erase_page(new_block);
-        if (!(FLASH_SR_EOP & flash_get_status_flags())) {
-            break;
-        }
-        if (!copy_parameters(past, old_block, new_block)) {
-            break;
-        }
-
-        if (!flash_write32(new_block + HEADER_COUNTER_OFFSET, past->_counter+1)) {
-            break;
-        }
-        if (!flash_write32(new_block, PAST_MAGIC)) {
+    uint32_t i;
+    /** Use the blocks in turn */
+    for (i = 1; i <= PAST_NUM_BLOCKS; i++) {
+        uint32_t block = (past->_cur_block + i) % PAST_NUM_BLOCKS;
+        if (PAST_MAGIC != flash_read32(past->blocks[block])) {
+            past->_gc_block = block;
             break;
         }
+    }
+    if (i > PAST_NUM_BLOCKS) {
+        return false; /** No erased block */
+    }
+    if (compact_cur_block) {
+        past->_gc_victim = past->_cur_block;
+    } else if (past->_num_used + 1 >= PAST_NUM_BLOCKS) {
+        /** Keep one block erased for the next GC */
+        past->_gc_victim = past->_order[0];
+    } else {
+        past->_gc_victim = PAST_BLOCK_NONE;
+    }
+    past->_gc_state = PAST_GC_ERASE;
+    return true;
+#endif // CONFIG_PAST_NO_GC
+}
 
-        flash_erase_page(old_block);
-        if (!(FLASH_SR_EOP & flash_get_status_flags())) {
-            break;
+/**
+  * @brief Complete an incremental GC in progress
+  * @param past pointer to an initialized past structure
+  * @retval true if the GC was successful
+  */
+static bool past_gc_settle(past_t *past)
+{
+    while (past->_gc_state != PAST_GC_IDLE) {
+        if (!past_gc_step(past)) {
+            return false;
         }
-
-        past->_counter++;
-        past->_cur_block = past->_cur_block ? 0 : 1;
-        success = true;
-        /** Past is now ready for writing */
-    } while(0);
-    lock_flash();
-    return success;
-#endif // CONFIG_PAST_NO_GC
+    }
+    return true;
 }
 
 /**
@@ -558,46 +1291,147 @@ static inline uint32_t flash_read32(uint32_t address)
 }
 
 /**
-  * @brief Copy all valid parameters from src to dst
-  * @param past pointer to an initialized past structure
+  * @brief Get a pointer to data in flash
+  * @param address flash address
+  * @retval pointer to the data at the address
+  */
+static inline const void *flash_data(uint32_t address)
+{
+#ifdef DPS_EMULATOR
+    return flash_emul_data(address);
+#else // DPS_EMULATOR
+    return (const void*) address;
+#endif // DPS_EMULATOR
+}
+
+/**
+  * @brief Write 16 bits to flash, used to clear the short id of compact units
+  * @param address address to write to
+  * @param data data to write
+  * @retval true if write was successful
+  */
+static inline bool flash_write16(uint32_t address, uint16_t data)
+{
+    bool success = false;
+    if (address % 2 == 0) {
+        flash_program_half_word(address, data);
+        success = FLASH_SR_EOP & flash_get_status_flags();
+#ifndef DPS_EMULATOR
+        uint16_t *p = (uint16_t*) address;
+        success &= *p == data; // Verify write
+#endif // DPS_EMULATOR
+    }
+    return success;
+}
+
+/**
+  * @brief Round a unit size up to a multiple of 4 bytes
+  * @param size size in bytes
+  * @retval word aligned size
+  */
+static inline uint32_t word_align(uint32_t size)
+{
+    if (size % 4) {
+        size += 4 - (size % 4);
+    }
+    return size;
+}
+
+/**
+  * @brief Decode the header of a unit, normal or compact
+  * @param address address of unit (points to id)
+  * @param id id of the unit, PAST_UNIT_ID_INVALID if it was removed or never
+  *        committed and PAST_UNIT_ID_END at the end of the block
+  * @param size size of the unit data in bytes
+  * @retval offset of the unit data from address, 0 at the end of the block or
+  *         if the header is corrupt
+  */
+static uint32_t past_unit_header(uint32_t address, past_id_t *id, uint32_t *size)
+{
+    uint32_t header = flash_read32(address);
+    *id = header;
+    *size = 0;
+    if (header == PAST_UNIT_ID_END) {
+        return 0;
+    }
+    if (UNIT_IS_COMPACT(header)) {
+        uint32_t short_id = header >> 16;
+        *id = short_id == UNIT_COMPACT_ID_UNCOMMITTED ? PAST_UNIT_ID_INVALID : UNIT_LONG_ID(short_id);
+        *size = header & UNIT_COMPACT_MAX_SIZE;
+        return *size ? UNIT_COMPACT_DATA_OFFSET : 0;
+    }
+    *size = flash_read32(address + UNIT_SIZE_OFFSET);
+    if (*size == 0 || *size == 0xffffffff) {
+        return 0;
+    }
+    return UNIT_DATA_OFFSET;
+}
+
+#ifdef CONFIG_PAST_COMPACT
+/**
+  * @brief Get the compact header of a unit
+  * @param id unit id
+  * @param length size of the unit data in bytes
+  * @retval header word or 0 if the unit must be stored in the normal format
+  */
+static uint32_t past_compact_header(past_id_t id, uint32_t length)
+{
+    uint32_t short_id = UNIT_SHORT_ID(id);
+    if (length > UNIT_COMPACT_MAX_SIZE || UNIT_LONG_ID(short_id) != id || short_id == UNIT_COMPACT_ID_UNCOMMITTED) {
+        return 0;
+    }
+    return short_id << 16 | UNIT_COMPACT_TAG << 8 | length;
+}
+#endif // CONFIG_PAST_COMPACT
+
+/**
+  * @brief Copy valid units from the old block to the new one, continuing
+  *        where the previous call stopped
+  * @param past pointer to a past structure with a GC in progress
   * @param src_base source base address
-  * @param dst_base destination base address
+  * @param count maximum number of units to copy
   * @retval true if copying was successful
   */
 #ifndef CONFIG_PAST_NO_GC
-static bool copy_parameters(past_t *past, uint32_t src_base, uint32_t dst_base)
+static bool copy_units(past_t *past, uint32_t src_base, uint32_t count)
 {
     bool success = true;
-    uint32_t src = src_base + HEADER_FIRST_UNIT_OFFSET;
-    uint32_t dst = dst_base + HEADER_FIRST_UNIT_OFFSET;
-    do {
-        uint32_t id = flash_read32(src);
-        if (id == PAST_UNIT_ID_END) {
+    bool done = false;
+    uint32_t src = past->_gc_src;
+    uint32_t dst = past->_gc_dst;
+    while (count && !done) {
+        past_id_t id;
+        uint32_t size;
+        uint32_t data_offset = past_unit_header(src, &id, &size);
+        if (!data_offset || size > 0x7fffffff) {
+            done = true;
             break;
         }
-        int32_t size = flash_read32(src + UNIT_SIZE_OFFSET);
-        if (size <= 0) {
-            break;
-        }
-        uint32_t aligned_size = size;
-        if (aligned_size % 4) {
-            aligned_size += 4 - aligned_size % 4;
-        }
+        uint32_t aligned_size = word_align(size);
         if (id != 0) {
-            for (uint32_t i = 0; i < aligned_size / 4 && success; i++) {
-                success &= flash_write32(dst + UNIT_DATA_OFFSET + 4*i, flash_read32(src + UNIT_DATA_OFFSET + 4*i));
+            if (aligned_size) {
+                success &= flash_program_block(dst + data_offset, flash_data(src + data_offset), aligned_size);
+            }
+            if (data_offset == UNIT_COMPACT_DATA_OFFSET) {
+                /** The header holds both the size and the id */
+                success &= flash_write32(dst, flash_read32(src));
+            } else {
+                success &= flash_write32(dst + UNIT_SIZE_OFFSET, size);
+                success &= flash_write32(dst, id);
             }
-            success &= flash_write32(dst + UNIT_SIZE_OFFSET, size);
-            success &= flash_write32(dst, id);
             if (!success) {
                 break;
             }
-            dst += UNIT_DATA_OFFSET + aligned_size;
+            dst += data_offset + aligned_size;
+            count--;
         }
-        src += UNIT_DATA_OFFSET + aligned_size;
-    } while (src < src_base + PAST_BLOCK_SIZE);
-    if (success) {
-        past->_end_addr = dst;
+        src += data_offset + aligned_size;
+        done = src >= src_base + PAST_BLOCK_SIZE;
+    }
+    past->_gc_src = src;
+    past->_gc_dst = dst;
+    if (success && done) {
+        past->_gc_state = PAST_GC_COMMIT;
     }
     return success;
 }
@@ -613,9 +1447,96 @@ bool past_gc_check(past_t *past)
 #ifdef CONFIG_PAST_NO_GC
     (void) past;
 #else // CONFIG_PAST_NO_GC
-    if (past_remaining_size(past) < PAST_GC_LIMIT) {
+    if (past->_gc_state != PAST_GC_IDLE || past_remaining_size(past) < PAST_GC_LIMIT) {
         return past_garbage_collect(past);
     }
 #endif // CONFIG_PAST_NO_GC
     return false;
 }
+
+/**
+  * @brief Perform the next step of an incremental GC
+  * @param past pointer to an initialized past structure
+  * @retval false if the GC failed
+  */
+bool past_gc_step(past_t *past)
+{
+#ifdef CONFIG_PAST_NO_GC
+    (void) past;
+    return true;
+#else // CONFIG_PAST_NO_GC
+    if (!past || past->_gc_state == PAST_GC_IDLE) {
+        return true;
+    }
+    bool success = false;
+    bool has_victim = past->_gc_victim != PAST_BLOCK_NONE;
+    uint32_t new_block = past->blocks[past->_gc_block];
+    uint32_t old_block = has_victim ? past->blocks[past->_gc_victim] : 0;
+    unlock_flash();
+    switch (past->_gc_state) {
+        case PAST_GC_ERASE:
+            /** Format the new block */
+            flash_erase_page(new_block);
+            if (!(FLASH_SR_EOP & flash_get_status_flags())) {
+                break;
+            }
+            past->_gc_src = old_block + HEADER_FIRST_UNIT_OFFSET;
+            past->_gc_dst = new_block + HEADER_FIRST_UNIT_OFFSET;
+            past->_gc_state = has_victim ? PAST_GC_COPY : PAST_GC_COMMIT;
+            success = true;
+            break;
+
+        case PAST_GC_COPY:
+            success = copy_units(past, old_block, PAST_GC_UNITS_PER_STEP);
+            break;
+
+        case PAST_GC_COMMIT:
+            if (!flash_write32(new_block + HEADER_COUNTER_OFFSET, past->_counter+1)) {
+                break;
+            }
+            if (!flash_write32(new_block, PAST_MAGIC)) {
+                break;
+            }
+            past->_counter++;
+            past->_order[past->_num_used++] = past->_gc_block;
+            past->_cur_block = past->_gc_block;
+            past->_end_addr = past->_gc_dst;
+            past->_gc_state = has_victim ? PAST_GC_CLEANUP : PAST_GC_IDLE;
+            success = true;
+            /** Past is now ready for writing */
+            break;
+
+        case PAST_GC_CLEANUP:
+            flash_erase_page(old_block);
+            if (!(FLASH_SR_EOP & flash_get_status_flags())) {
+                break;
+            }
+            past_order_remove(past, past->_gc_victim);
+            past_build_index(past);
+            past->_gc_state = PAST_GC_IDLE;
+            success = true;
+            break;
+
+        default:
+            break;
+    }
+    lock_flash();
+    if (!success) {
+        /** Start over on the next GC, the index drops any copies in the new
+          * block if it was taken into use */
+        past->_gc_state = PAST_GC_IDLE;
+        past_build_index(past);
+    }
+    return success;
+#endif // CONFIG_PAST_NO_GC
+}
+
+/**
+  * @brief Check if an incremental GC is in progress
+  * @param past pointer to an initialized past structure
+  * @retval true if past_gc_step() has work to do
+  */
+bool past_gc_busy(past_t *past)
+{
+    return past && past->_gc_state != PAST_GC_IDLE;
+}
@@ -32,12 +32,16 @@
  *
  * ## Design
  *
- * PAST uses two flash blocks in a ping-pong arrangement:
- * - One block is always active (contains current data)
- * - The other is either erased or being prepared
- * - When active block is full, data is copied to the other block
+ * PAST uses a ring of PAST_NUM_BLOCKS flash blocks:
+ * - The block with the highest counter is active (receives new units)
+ * - Older blocks in use still hold units that have not been rewritten
+ * - One block is always erased or being prepared
+ * - When the active block is full the next erased block is taken into use,
+ *   if it is the last one the units of the oldest block are copied to it
  *   (garbage collection), omitting deleted entries
  *
+ * With two blocks this is a ping-pong arrangement.
+ *
  * ## Unit Format
  *
  * Each unit (key-value pair) is stored as:
@@ -52,19 +56,30 @@
  * - Data: Actual data bytes
  * - Padding: Alignment padding to 4-byte boundary
  *
+ * With CONFIG_PAST_COMPACT, units of up to 255 bytes whose ID only uses the
+ * top and bottom bytes are written with a single header word:
+ * ```
+ * +--------+------+-------+--------+--------+
+ * | ID(16) | 0xC5 | Len(8)| Data...| Pad... |
+ * +--------+------+-------+--------+--------+
+ * ```
+ * Both formats are always read.
+ *
  * ## Wear Leveling
  *
  * - New data is always appended at the end of the block
  * - Updates create new copies (old data marked as deleted)
  * - Garbage collection recovers space by copying only valid data
- * - Two-block design ensures power-fail safety
+ * - Blocks are taken into use in turn, spreading erase cycles
+ * - Keeping one block erased ensures power-fail safety
  *
  * ## Usage Example
  *
  * ```c
  * past_t past;
- * past.blocks[0] = 0x08007000;  // First flash block address
- * past.blocks[1] = 0x08007400;  // Second flash block address
+ * for (uint32_t i = 0; i < PAST_NUM_BLOCKS; i++) {
+ *     past.blocks[i] = 0x08007000 + i * PAST_BLOCK_SIZE;  // Flash block addresses
+ * }
  *
  * if (!past_init(&past)) {
  *     // Handle initialization failure
@@ -101,9 +116,78 @@
  * Reserved values:
  * - 0x00000000: Indicates deleted/invalid unit
  * - 0xFFFFFFFF: Indicates erased flash (unused space)
+ * - 0xXXXXC5XX: Compact unit headers
+ * - 0x00200000 and ids with bit 22 or 23 set: Staged units, see past_stage_unit()
  */
 typedef uint32_t past_id_t;
 
+/** @brief Size of a flash block (page) in bytes */
+#define PAST_BLOCK_SIZE (1024) //STM32F100
+
+/**
+ * @def PAST_NUM_BLOCKS
+ * @brief Number of flash blocks used by PAST
+ *
+ * Can be overridden by defining CONFIG_PAST_NUM_BLOCKS at compile time, the
+ * app and the bootloader must agree on it.
+ */
+#ifdef CONFIG_PAST_NUM_BLOCKS
+ #define PAST_NUM_BLOCKS (CONFIG_PAST_NUM_BLOCKS)
+#else
+ #define PAST_NUM_BLOCKS (2)
+#endif
+
+/**
+ * @def PAST_INDEX_SIZE
+ * @brief Number of unit addresses cached in RAM
+ *
+ * Lookups of indexed units do not need to scan the flash block, units that
+ * do not fit in the index are still found by scanning. Can be overridden by
+ * defining CONFIG_PAST_INDEX_SIZE at compile time.
+ */
+#ifdef CONFIG_PAST_INDEX_SIZE
+ #define PAST_INDEX_SIZE (CONFIG_PAST_INDEX_SIZE)
+#else
+ #define PAST_INDEX_SIZE (32)
+#endif
+
+/**
+ * @brief PAST index entry - internal use
+ */
+typedef struct {
+    /** @brief Unit id, 0 if the entry is unused */
+    past_id_t id;
+    /** @brief Address of the unit in the current block, 0 if erased */
+    uint32_t address;
+} past_index_t;
+
+#ifdef CONFIG_PAST_WRITE_BEHIND
+/**
+ * @def PAST_QUEUE_SIZE
+ * @brief Number of unit writes past_queue_unit() can hold back
+ */
+#ifdef CONFIG_PAST_QUEUE_SIZE
+ #define PAST_QUEUE_SIZE (CONFIG_PAST_QUEUE_SIZE)
+#else
+ #define PAST_QUEUE_SIZE (8)
+#endif
+
+/** @brief Largest unit in bytes that can be queued, larger ones are written directly */
+#define PAST_QUEUE_DATA_SIZE (8)
+
+/**
+ * @brief Queued unit write - internal use
+ */
+typedef struct {
+    /** @brief Unit id */
+    past_id_t id;
+    /** @brief Length of the unit data in bytes */
+    uint32_t length;
+    /** @brief Unit data */
+    uint32_t data[PAST_QUEUE_DATA_SIZE / 4];
+} past_queued_unit_t;
+#endif // CONFIG_PAST_WRITE_BEHIND
+
 /**
  * @brief PAST instance structure
  *
@@ -113,8 +197,8 @@ typedef uint32_t past_id_t;
  */
 typedef struct {
     /** @brief Flash block addresses (user must initialize before past_init) */
-    uint32_t blocks[2];
-    /** @brief Index of currently active block (0 or 1) - internal use */
+    uint32_t blocks[PAST_NUM_BLOCKS];
+    /** @brief Index of currently active block - internal use */
     uint32_t _cur_block;
     /** @brief Generation counter for GC tracking - internal use */
     uint32_t _counter;
@@ -122,16 +206,71 @@ typedef struct {
     uint32_t _end_addr;
     /** @brief true if PAST is initialized and valid - internal use */
     bool _valid;
+    /** @brief Indices of the blocks in use, oldest first - internal use */
+    uint8_t _order[PAST_NUM_BLOCKS];
+    /** @brief Number of blocks in _order - internal use */
+    uint32_t _num_used;
+    /** @brief Hashed id to address index of the current block - internal use */
+    past_index_t _index[PAST_INDEX_SIZE];
+    /** @brief true if a unit did not fit in the index - internal use */
+    bool _index_overflow;
+#ifdef CONFIG_PAST_WRITE_BEHIND
+    /** @brief Unit writes not yet committed to flash - internal use */
+    past_queued_unit_t _queue[PAST_QUEUE_SIZE];
+    /** @brief Number of units in _queue - internal use */
+    uint32_t _queue_count;
+#endif // CONFIG_PAST_WRITE_BEHIND
+    /** @brief Step of an ongoing incremental GC, 0 if none - internal use */
+    uint32_t _gc_state;
+    /** @brief Block being taken into use by the GC - internal use */
+    uint32_t _gc_block;
+    /** @brief Block the GC copies units from and erases - internal use */
+    uint32_t _gc_victim;
+    /** @brief Next unit to copy from the old block - internal use */
+    uint32_t _gc_src;
+    /** @brief Next write address in the new block - internal use */
+    uint32_t _gc_dst;
 } past_t;
 
+/**
+ * @brief Position of a walk over all stored units, see past_iter_next()
+ */
+typedef struct {
+    /** @brief Position in _order of the block being walked - internal use */
+    uint32_t _block;
+    /** @brief Address of the next unit in the block, 0 to start - internal use */
+    uint32_t _address;
+#ifdef CONFIG_PAST_WRITE_BEHIND
+    /** @brief Next queued unit once the blocks are done - internal use */
+    uint32_t _queued;
+#endif // CONFIG_PAST_WRITE_BEHIND
+#ifdef DPS_EMULATOR
+    /** @brief Copy of the first data word of the unit - internal use */
+    uint32_t _temp;
+#endif // DPS_EMULATOR
+} past_iter_t;
+
+/**
+ * @brief Restore handler of a unit id, see past_read_many()
+ */
+typedef struct past_reader {
+    /** @brief Unit id to restore */
+    past_id_t id;
+    /** @brief Called with the unit data if the unit is stored */
+    void (*restore)(const struct past_reader *reader, const void *data, uint32_t length);
+    /** @brief Passed on to restore(), typically the variable to restore */
+    void *arg;
+} past_reader_t;
+
 /**
  * @brief Initialize the PAST system
  *
  * Prepares the PAST for use by:
- * 1. Reading block headers to find the active block
- * 2. Scanning the active block to find the end of valid data
- * 3. Performing garbage collection if needed
- * 4. Formatting both blocks if no valid data is found
+ * 1. Reading block headers to order the blocks in use and find the active one
+ * 2. Removing old unit copies left by interrupted writes
+ * 3. Scanning the active block to find the end of valid data
+ * 4. Performing garbage collection if needed
+ * 5. Formatting all blocks if no valid data is found
  *
  * @param[in,out] past PAST structure with blocks[] initialized to flash addresses
  * @return true if initialization succeeded
@@ -160,6 +299,48 @@ bool past_init(past_t *past);
  */
 bool past_read_unit(past_t *past, past_id_t id, const void **data, uint32_t *length);
 
+/**
+ * @brief Start a walk over all stored units
+ *
+ * @param[in]  past Initialized PAST structure
+ * @param[out] iter Walk position to initialize
+ */
+void past_iter_init(past_t *past, past_iter_t *iter);
+
+/**
+ * @brief Get the next unit of a walk
+ *
+ * Units are returned in storage order, each stored unit once with its
+ * newest data. Queued writes are returned last. The walk reads each unit
+ * header once, so visiting all n units costs O(n) flash reads where n calls
+ * to past_read_unit() cost O(n^2) once the index has overflowed.
+ *
+ * @param[in]     past   Initialized PAST structure
+ * @param[in,out] iter   Walk position from past_iter_init()
+ * @param[out]    id     Receives the unit ID
+ * @param[out]    data   Receives pointer to unit data, as past_read_unit()
+ * @param[out]    length Receives length of unit data in bytes
+ * @return true if a unit was returned
+ * @return false at the end of the walk
+ *
+ * @note Writes and erases during the walk invalidate it
+ */
+bool past_iter_next(past_t *past, past_iter_t *iter, past_id_t *id, const void **data, uint32_t *length);
+
+/**
+ * @brief Read several units in one walk
+ *
+ * Walks the stored units once with past_iter_next() and calls the restore
+ * handler of every unit in the table that is stored. Handlers of units that
+ * are not stored are not called, so defaults set before the call remain.
+ *
+ * @param[in] past    Initialized PAST structure
+ * @param[in] readers Table of unit IDs and their handlers
+ * @param[in] count   Number of entries in the table
+ * @return Number of handlers called
+ */
+uint32_t past_read_many(past_t *past, const past_reader_t *readers, uint32_t count);
+
 /**
  * @brief Write a unit to PAST
  *
@@ -178,6 +359,45 @@ bool past_read_unit(past_t *past, past_id_t id, const void **data, uint32_t *len
  */
 bool past_write_unit(past_t *past, past_id_t id, void *data, uint32_t length);
 
+/**
+ * @brief Queue a unit write to PAST
+ *
+ * Like past_write_unit() but the write is held back in RAM until
+ * past_flush() is called. Queueing a unit that is already queued replaces
+ * the queued data, so repeated saves of a setting cost a single flash
+ * write. Queued units are returned by past_read_unit().
+ *
+ * Without CONFIG_PAST_WRITE_BEHIND, or for units larger than
+ * PAST_QUEUE_DATA_SIZE, this writes the unit directly.
+ *
+ * @param[in,out] past   Initialized PAST structure
+ * @param[in]     id     Unit ID (must not be 0 or 0xFFFFFFFF)
+ * @param[in]     data   Pointer to data to store
+ * @param[in]     length Length of data in bytes
+ * @return true if the unit was queued or written
+ * @return false if the unit is invalid or writing failed
+ */
+bool past_queue_unit(past_t *past, past_id_t id, void *data, uint32_t length);
+
+/**
+ * @brief Write all queued units to flash
+ *
+ * Units identical to what is already stored are not rewritten.
+ *
+ * @param[in,out] past Initialized PAST structure
+ * @return true if all queued units were written
+ * @return false if any write failed, the unit is dropped from the queue
+ */
+bool past_flush(past_t *past);
+
+/**
+ * @brief Check for queued unit writes
+ *
+ * @param[in] past Initialized PAST structure
+ * @return true if past_flush() has units to write
+ */
+bool past_pending(past_t *past);
+
 /**
  * @brief Erase a unit from PAST
  *
@@ -210,16 +430,91 @@ bool past_format(past_t *past);
  * @brief Check if garbage collection is needed and perform it
  *
  * Checks the fill level of the current block and performs garbage
- * collection if it's nearly full. GC copies valid units to the other
- * block and switches the active block.
+ * collection if it's nearly full. GC takes the next erased block into use,
+ * copying the valid units of the oldest block to it when it is the last
+ * erased one. An incremental GC in progress
+ * is completed.
  *
  * @param[in,out] past Initialized PAST structure
  * @return true if GC was performed
  * @return false if GC was not needed or failed
  *
- * @note Usually called automatically by past_write_unit()
  * @note Safe to call explicitly to pre-emptively free space
  */
 bool past_gc_check(past_t *past);
 
+/**
+ * @brief Perform the next step of an incremental garbage collection
+ *
+ * past_write_unit() starts an incremental GC when the current block is
+ * nearly full instead of blocking until all units are copied. Each step
+ * erases one page or copies a few units, call this from the main loop
+ * while past_gc_busy() returns true. The new block is not used until its
+ * magic has been written, a power failure during GC leaves the current
+ * block intact.
+ *
+ * @param[in,out] past Initialized PAST structure
+ * @return false if the GC failed
+ *
+ * @note Writes and erases issued during GC complete it first
+ */
+bool past_gc_step(past_t *past);
+
+/**
+ * @brief Check if an incremental garbage collection is in progress
+ *
+ * @param[in] past Initialized PAST structure
+ * @return true if past_gc_step() has work to do
+ */
+bool past_gc_busy(past_t *past);
+
+#ifdef CONFIG_PAST_STAGING
+/** @brief Id bit of a staged unit write, see past_stage_unit() */
+#define PAST_STAGED_BIT        (0x00800000)
+/** @brief Id bit of a staged unit erase */
+#define PAST_STAGED_ERASE_BIT  (0x00400000)
+/** @brief Id of the record written while past_commit() applies staged units */
+#define PAST_UNIT_ID_COMMIT    (0x00200000)
+/** @brief Largest unit in bytes that can be staged */
+#define PAST_STAGE_DATA_SIZE   (256)
+
+/**
+ * @brief Stage a unit write or erase for past_commit()
+ *
+ * The unit is stored under its id with PAST_STAGED_BIT set and is not seen
+ * by past_read_unit() of the id until committed. Staging a unit again
+ * replaces the staged write or erase. Staged units left by a reset before
+ * past_commit() are dropped by past_init().
+ *
+ * @param[in,out] past   Initialized PAST structure
+ * @param[in]     id     Unit ID, without the staged bits
+ * @param[in]     data   Data to store, NULL stages erasing the unit
+ * @param[in]     length Length of data in bytes, at most PAST_STAGE_DATA_SIZE
+ * @return true if the unit was staged
+ * @return false if the unit is invalid or writing failed
+ */
+bool past_stage_unit(past_t *past, past_id_t id, void *data, uint32_t length);
+
+/**
+ * @brief Apply all staged units as one transaction
+ *
+ * A commit record is written before the staged units are moved to their
+ * ids, a reset part way is completed by past_init() so either none or all
+ * of the staged units take effect.
+ *
+ * @param[in,out] past Initialized PAST structure
+ * @return true if all staged units were applied
+ * @return false if writing failed, past_init() retries the rest
+ */
+bool past_commit(past_t *past);
+
+/**
+ * @brief Drop all staged units
+ *
+ * @param[in,out] past Initialized PAST structure
+ * @return true if all staged units were erased
+ */
+bool past_abort(past_t *past);
+#endif // CONFIG_PAST_STAGING
+
 #endif // __PAST_H__
@@ -37,14 +37,22 @@
  * | Display settings | 2, 14 | TFT inversion, brightness |
  * | Version info | 3-4 | Git hashes for boot/app |
  * | Calibration | 5-13 | ADC/DAC calibration coefficients |
- * | System | 0xFF | Upgrade status flag |
+ * | V_out loop | 16-17 | Closed loop V_out trim gains |
+ * | Soft start | 18 | V_out enable slew rate |
+ * | Calibration tables | 19-23 | Piecewise linear ADC/DAC calibration |
+ * | OCP/OVP filter | 24-26 | Trip sample counts and I2t time |
+ * | UI | 27 | Headless mode |
+ * | ADC | 28 | Acquisition profile |
+ * | Presets | 0x80-0x8F | Function and parameters of each preset slot |
+ * | System | 0xFE-0xFF | Upgrade progress and status flag |
  *
  * ## Adding New Units
  *
  * When adding a new persistent setting:
  * 1. Add a new enum value here (use next available ID)
  * 2. Document the data format in a comment
- * 3. Use past_read_unit() and past_write_unit() to access
+ * 3. Use past_read_unit() and past_write_unit() to access, or a
+ *    past_read_many() table to restore several units in one walk
  *
  * @see past.h for the storage system
  * @see pwrctl.h for calibration usage
@@ -93,6 +101,41 @@ typedef enum {
     past_VIN_ADC_C,
     /** @brief TFT brightness level (0-100) */
     past_tft_brightness,
+    /** @brief V_out loop proportional gain (float) */
+    past_V_LOOP_KP,
+    /** @brief V_out loop integral gain (float) */
+    past_V_LOOP_KI,
+    /** @brief V_out soft start slew rate in mV/ms (float) */
+    past_V_SLEW,
+    /**
+     * @brief Calibration tables: ([x:16] [y:16]) * n, see cal_lut.h
+     * Must stay in pwrctl_cal_channel_t order
+     */
+    past_A_ADC_LUT,
+    past_A_DAC_LUT,
+    past_V_ADC_LUT,
+    past_V_DAC_LUT,
+    past_VIN_ADC_LUT,
+    /** @brief Consecutive over current samples that trip OCP (float) */
+    past_OCP_SAMPLES,
+    /** @brief Consecutive over voltage samples that trip OVP (float) */
+    past_OVP_SAMPLES,
+    /** @brief ms at twice the current limit that trip OCP, 0 disables I2t (float) */
+    past_OCP_I2T,
+    /** @brief Start in headless mode, see opendps_set_headless() (uint32_t) */
+    past_headless,
+    /** @brief ADC acquisition profile selected at power up, see adc_profile_t (uint32_t) */
+    past_adc_profile,
+    /**
+     * @brief Preset slot n is unit past_preset_0 + n:
+     * [function:8] [count:8] [reserved:16] ([value:32]) * count
+     */
+    past_preset_0 = 0x80,
+    /**
+     * @brief Progress of a raw upgrade: [offset:32] [fw_crc:16] [crc:16]
+     * Written by the bootloader, lets an interrupted upgrade resume
+     */
+    past_upgrade_progress = 0xfe,
     /**
      * @brief Upgrade in progress flag
      * Presence indicates incomplete upgrade; bootloader won't boot app
@@ -0,0 +1,72 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <cortex.h>
+#include <dwt.h>
+#include <scb.h>
+#include "perf.h"
+
+static perf_stats_t probes[perf_probe_count];
+
+void perf_init(void)
+{
+    SCB_DEMCR |= SCB_DEMCR_TRCENA;
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+    perf_reset();
+}
+
+void perf_record(perf_probe_t probe, uint32_t cycles)
+{
+    perf_stats_t *s = &probes[probe];
+    s->count++;
+    s->total += cycles;
+    if (cycles < s->min) {
+        s->min = cycles;
+    }
+    if (cycles > s->max) {
+        s->max = cycles;
+    }
+}
+
+void perf_get(perf_probe_t probe, perf_stats_t *stats)
+{
+    /** The ISR probes must not change halfway through the copy */
+    cm_disable_interrupts();
+    *stats = probes[probe];
+    cm_enable_interrupts();
+}
+
+void perf_reset(void)
+{
+    cm_disable_interrupts();
+    for (uint32_t i = 0; i < perf_probe_count; i++) {
+        probes[i].count = 0;
+        probes[i].min = UINT32_MAX;
+        probes[i].max = 0;
+        probes[i].total = 0;
+    }
+    cm_enable_interrupts();
+}
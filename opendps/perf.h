@@ -0,0 +1,119 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file perf.h
+ * @brief Cycle counting probes
+ *
+ * Available with CONFIG_PERF. A probe measures the CPU cycles between
+ * PERF_BEGIN() and PERF_END() using the DWT cycle counter of the Cortex-M3
+ * and keeps the number of calls, the shortest, longest and total time in RAM.
+ * The statistics are read with cmd_perf_report.
+ *
+ * Probes nest, the time of an inner probe is included in the outer one (e.g.
+ * spi_dma_transceive() in uui_refresh()). A probe must only be used from one
+ * context, the ADC ISR probes are only updated from the ISR and the others
+ * only from the main loop.
+ *
+ * Without CONFIG_PERF the macros expand to nothing.
+ */
+
+#ifndef __PERF_H__
+#define __PERF_H__
+
+#include <stdint.h>
+
+/**
+ * @brief Probe points
+ */
+typedef enum {
+    /** @brief Processing of one ADC sample set, ADC or DMA ISR */
+    perf_adc_isr = 0,
+    /** @brief The function generator hook in the ADC ISR */
+    perf_func_gen,
+    /** @brief handle_frame() in the serial protocol handler */
+    perf_handle_frame,
+    /** @brief uui_refresh() */
+    perf_uui_refresh,
+    /** @brief spi_dma_transceive() */
+    perf_spi_dma,
+    /** @brief Completed past_write_unit() calls */
+    perf_past_write,
+    perf_probe_count
+} perf_probe_t;
+
+/**
+ * @brief Statistics of a probe, times in CPU cycles
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+} perf_stats_t;
+
+#ifdef CONFIG_PERF
+
+#include <dwt.h>
+
+/** @brief Start timing probe <p>, opens a scope local variable */
+#define PERF_BEGIN(p) uint32_t perf_start_##p = DWT_CYCCNT
+
+/** @brief Stop timing probe <p> and record the result */
+#define PERF_END(p) perf_record(p, DWT_CYCCNT - perf_start_##p)
+
+/**
+ * @brief Enable the DWT cycle counter and clear all probes
+ */
+void perf_init(void);
+
+/**
+ * @brief Record one measurement
+ *
+ * @param[in] probe  The probe
+ * @param[in] cycles Cycles spent
+ */
+void perf_record(perf_probe_t probe, uint32_t cycles);
+
+/**
+ * @brief Get the statistics of a probe
+ *
+ * @param[in]  probe The probe
+ * @param[out] stats Filled in with the statistics
+ */
+void perf_get(perf_probe_t probe, perf_stats_t *stats);
+
+/**
+ * @brief Clear the statistics of all probes
+ */
+void perf_reset(void);
+
+#else // CONFIG_PERF
+
+#define PERF_BEGIN(p)
+#define PERF_END(p)
+
+#endif // CONFIG_PERF
+
+#endif // __PERF_H__
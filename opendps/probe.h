@@ -0,0 +1,64 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file probe.h
+ * @brief GPIO probes for a logic analyzer
+ *
+ * Available with CONFIG_DEBUG_PROBES. Each probe drives a spare pin, see
+ * Probe_GPIO in hw.h, high while the instrumented code runs:
+ *
+ *  PROBE_ADC    ADC ISR (adc1_2_isr() or dma1_channel1_isr()), entry to exit
+ *  PROBE_OCP    handle_ocp(), the last pulse ends when the output is cut
+ *  PROBE_SPI    spi_dma_transceive(), start to end of the transfer
+ *  PROBE_FRAME  handle_frame() in the serial protocol handler
+ *
+ * Unlike the cycle counts of perf.h the edges show the real interrupt entry
+ * latency and how the stages overlap. A probe is a single store to the
+ * BSRR or BRR register of the port. Without CONFIG_DEBUG_PROBES the macros
+ * expand to nothing.
+ */
+
+#ifndef __PROBE_H__
+#define __PROBE_H__
+
+#ifdef CONFIG_DEBUG_PROBES
+
+#include <gpio.h>
+#include "hw.h"
+
+/** @brief Drive probe <p> high */
+#define PROBE_HIGH(p) GPIO_BSRR(p##_PORT) = p##_PIN
+
+/** @brief Drive probe <p> low */
+#define PROBE_LOW(p) GPIO_BRR(p##_PORT) = p##_PIN
+
+#else // CONFIG_DEBUG_PROBES
+
+#define PROBE_HIGH(p)
+#define PROBE_LOW(p)
+
+#endif // CONFIG_DEBUG_PROBES
+
+#endif // __PROBE_H__
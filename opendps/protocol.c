@@ -43,6 +43,14 @@ void protocol_create_ping(frame_t *frame)
 	end_frame(frame);
 }
 
+void protocol_create_set_baudrate(frame_t *frame, uint32_t baudrate)
+{
+	set_frame_header(frame);
+	pack8(frame, cmd_set_baudrate);
+	pack32(frame, baudrate);
+	end_frame(frame);
+}
+
 void protocol_create_status(frame_t *frame)
 {
 	set_frame_header(frame);
@@ -137,6 +145,29 @@ bool protocol_unpack_upgrade_start(frame_t *frame, uint16_t *chunk_size, uint16_
 	return frame->length == 0 && cmd == cmd_upgrade_start;
 }
 
+bool protocol_unpack_stream_start(frame_t *frame, uint16_t *interval_ms, uint8_t *batch)
+{
+	uint8_t cmd;
+
+	start_frame_unpacking(frame);
+	UNPACK8(frame, &cmd);
+	UNPACK16(frame, interval_ms);
+	UNPACK8(frame, batch);
+
+	return frame->length == 0 && cmd == cmd_stream_start;
+}
+
+bool protocol_unpack_set_baudrate(frame_t *frame, uint32_t *baudrate)
+{
+	uint8_t cmd;
+
+	start_frame_unpacking(frame);
+	UNPACK8(frame, &cmd);
+	UNPACK32(frame, baudrate);
+
+	return frame->length == 0 && cmd == cmd_set_baudrate;
+}
+
 bool protocol_unpack_ocp(frame_t *frame, uint16_t *i_cut)
 {
 	uint8_t cmd;
@@ -148,3 +179,70 @@ bool protocol_unpack_ocp(frame_t *frame, uint16_t *i_cut)
 	return frame->length == 0 && cmd == cmd_ocp_event;
 }
 
+void protocol_create_wave_upload(frame_t *frame, uint8_t flags, uint8_t offset, uint8_t count, const uint16_t *samples)
+{
+	set_frame_header(frame);
+	pack8(frame, cmd_wave_upload);
+	pack8(frame, flags);
+	pack8(frame, offset);
+	pack8(frame, count);
+	for (uint32_t i = 0; i < count; i++) {
+		pack16(frame, samples[i]);
+	}
+	end_frame(frame);
+}
+
+bool protocol_unpack_wave_upload(frame_t *frame, uint8_t *flags, uint8_t *offset, uint8_t *count, uint16_t *samples)
+{
+	uint8_t cmd;
+
+	start_frame_unpacking(frame);
+	UNPACK8(frame, &cmd);
+	UNPACK8(frame, flags);
+	UNPACK8(frame, offset);
+	UNPACK8(frame, count);
+	/** Unpacking consumes the length, what is left are the samples */
+	if (cmd != cmd_wave_upload || *count > WAVE_UPLOAD_CHUNK || frame->length != 2 * (uint32_t) *count) {
+		return false;
+	}
+	for (uint32_t i = 0; i < *count; i++) {
+		UNPACK16(frame, &samples[i]);
+	}
+
+	return true;
+}
+
+bool protocol_unpack_capabilities(frame_t *frame, capabilities_t *caps)
+{
+	uint8_t cmd;
+	uint8_t status;
+	uint8_t count;
+	uint32_t baudrate;
+
+	start_frame_unpacking(frame);
+	UNPACK8(frame, &cmd);
+	UNPACK8(frame, &status);
+	if (cmd != (cmd_response | cmd_capabilities) || !status) {
+		return false;
+	}
+	UNPACK32(frame, &caps->features);
+	UNPACK16(frame, &caps->max_frame);
+	UNPACK16(frame, &caps->max_msg);
+	UNPACK8(frame, &caps->msg_window);
+	UNPACK8(frame, &caps->batch);
+	UNPACK8(frame, &caps->schedule);
+	UNPACK8(frame, &caps->pipeline);
+	UNPACK8(frame, &caps->stream_samples);
+	UNPACK16(frame, &caps->stream_min_ms);
+	UNPACK32(frame, &caps->cur_baudrate);
+	UNPACK8(frame, &count);
+	caps->max_baudrate = caps->cur_baudrate;
+	for (; count > 0 && frame->length >= 4; count--) {
+		UNPACK32(frame, &baudrate);
+		if (baudrate > caps->max_baudrate) {
+			caps->max_baudrate = baudrate;
+		}
+	}
+
+	return frame->length == 0 && count == 0;
+}
@@ -57,6 +57,54 @@
  * | cmd_temperature_report | Send temperature readings |
  * | cmd_upgrade_start | Begin firmware upgrade |
  * | cmd_upgrade_data | Send firmware data chunk |
+ * | cmd_stream_start | Start pushing batched V/I samples |
+ * | cmd_stream_stop | Stop pushing samples |
+ * | cmd_set_baudrate | Switch the serial link to a higher baud rate |
+ * | cmd_tagged | Tag a command so its response can be matched |
+ * | cmd_batch | Run several commands in one frame |
+ * | cmd_set_parameters_bin | Set function parameters by index |
+ * | cmd_get_parameters_bin | Get function parameter values |
+ * | cmd_query_compact | Get changed status fields as deltas |
+ * | cmd_record_start | Arm the ADC sample recorder |
+ * | cmd_record_dump | Download the ADC recording |
+ * | cmd_trip_snapshot | Read the samples frozen at an OCP/OVP trip |
+ * | cmd_event_stats | Get event queue drop counters |
+ * | cmd_wave_upload | Upload an arbitrary waveform to the function generator |
+ * | cmd_seq_upload | Upload a sequencer program |
+ * | cmd_cal_sweep | Step a DAC and report averaged ADC readings |
+ * | cmd_set_cal_lut | Set a piecewise linear calibration table |
+ * | cmd_perf_report | Read the cycle counting probes |
+ * | cmd_load_stats | Get CPU load and ADC ISR headroom |
+ * | cmd_set_setpoint | Set the output voltage and/or current |
+ * | cmd_energy_stats | Get (and reset) the delivered charge and energy |
+ * | cmd_window_stats | Get I_out and V_out statistics since the last read |
+ * | cmd_boot_times | Get the time each startup phase completed |
+ * | cmd_fragment | One fragment of a message larger than a frame |
+ * | cmd_fragment_ack | Acknowledge the fragments of a message |
+ * | cmd_log | Deferred debug log entries (DPS to host) |
+ * | cmd_ram_stats | Get RAM section sizes and the stack high water mark |
+ * | cmd_clock_sync | Read the device clock for host clock offset estimation |
+ * | cmd_schedule | Run a command at a given device time |
+ * | cmd_schedule_status | List the scheduled commands and their outcome |
+ * | cmd_schedule_cancel | Drop all scheduled commands |
+ * | cmd_capabilities | Get the optional features and protocol limits |
+ * | cmd_subscribe | Choose the state changes to be notified of |
+ * | cmd_notify | State change notification (DPS to host) |
+ * | cmd_save_preset | Store the function and its parameters in a preset slot |
+ * | cmd_recall_preset | Switch to the function and parameters of a preset |
+ * | cmd_ocp_bench | Trip the OCP on purpose and time its response |
+ * | cmd_ripple | Ripple amplitude and spectrum of the ADC recording |
+ * | cmd_lockin | Lock-in measurement of I_out and V_out at the generator frequency |
+ * | cmd_addressed | Address a command to one unit on a shared bus |
+ * | cmd_config_export | Read a chunk of the settings snapshot |
+ * | cmd_config_import | Write a chunk of a settings snapshot |
+ * | cmd_link_stats | Get (and reset) the serial link error counters |
+ * | cmd_sched_stats | Get (and reset) the deadline statistics of the scheduled jobs |
+ * | cmd_headless | Turn the display off and stop drawing, or back on |
+ * | cmd_adc_profile | Select or read the ADC acquisition profile |
+ * | cmd_isr_hooks | Get (and reset) the accounting of the ADC ISR hooks |
+ * | cmd_stage_parameters | Stage parameter values of any function |
+ * | cmd_switch_function | Select a function by index with its staged values |
  *
  * ## Communication Interfaces
  *
@@ -129,6 +177,106 @@ typedef enum {
     cmd_change_screen,
     /** @brief Set display backlight brightness */
     cmd_set_brightness,
+    /** @brief Start pushing sample frames to the host */
+    cmd_stream_start,
+    /** @brief Stop pushing sample frames to the host */
+    cmd_stream_stop,
+    /** @brief Batch of V/I samples (DPS->Host) */
+    cmd_stream_data,
+    /** @brief Change the serial link baud rate */
+    cmd_set_baudrate,
+    /** @brief Envelope carrying a host chosen tag echoed in the response */
+    cmd_tagged,
+    /** @brief Run several commands from one frame */
+    cmd_batch,
+    /** @brief Set parameters of the current function by index */
+    cmd_set_parameters_bin,
+    /** @brief Get parameter values of the current function */
+    cmd_get_parameters_bin,
+    /** @brief Get the status fields that changed since the last query */
+    cmd_query_compact,
+    /** @brief Arm the ADC sample recorder */
+    cmd_record_start,
+    /** @brief Read a chunk of the ADC recording */
+    cmd_record_dump,
+    /** @brief Read the snapshot taken at the last OCP/OVP trip */
+    cmd_trip_snapshot,
+    /** @brief Get the drop counters of the event queues */
+    cmd_event_stats,
+    /** @brief Upload a chunk of the function generator's arbitrary waveform */
+    cmd_wave_upload,
+    /** @brief Upload a chunk of the sequencer program */
+    cmd_seq_upload,
+    /** @brief Step a DAC through a range, averaging the ADCs at each point */
+    cmd_cal_sweep,
+    /** @brief Averaged ADC readings of one calibration point (DPS->Host) */
+    cmd_cal_data,
+    /** @brief Set or remove the calibration table of a channel */
+    cmd_set_cal_lut,
+    /** @brief Read the statistics of the cycle counting probes */
+    cmd_perf_report,
+    /** @brief Get the CPU load and ADC ISR headroom of the last window */
+    cmd_load_stats,
+    /** @brief Set the voltage and/or current setting without string parsing */
+    cmd_set_setpoint,
+    /** @brief Get the charge and energy delivered on the output */
+    cmd_energy_stats,
+    /** @brief Get the I_out and V_out statistics since the last read */
+    cmd_window_stats,
+    /** @brief Get the startup phase timestamps */
+    cmd_boot_times,
+    /** @brief A fragment of a message too large for one frame */
+    cmd_fragment,
+    /** @brief Acknowledge the fragments of a message received so far */
+    cmd_fragment_ack,
+    /** @brief Deferred debug log entries, sent by the DPS */
+    cmd_log,
+    /** @brief Get the RAM section sizes and the stack high water mark */
+    cmd_ram_stats,
+    /** @brief Read the device clock, see "Scheduled commands" */
+    cmd_clock_sync,
+    /** @brief Run a command at a given device time */
+    cmd_schedule,
+    /** @brief List the scheduled commands and their outcome */
+    cmd_schedule_status,
+    /** @brief Drop all scheduled commands */
+    cmd_schedule_cancel,
+    /** @brief Get the optional features and protocol limits of the build */
+    cmd_capabilities,
+    /** @brief Choose the state changes the DPS pushes notifications for */
+    cmd_subscribe,
+    /** @brief State change notification, sent by the DPS */
+    cmd_notify,
+    /** @brief Store the current function and its parameters in a preset slot */
+    cmd_save_preset,
+    /** @brief Switch to the function and parameters of a preset slot */
+    cmd_recall_preset,
+    /** @brief Trip the OCP with a synthetic limit and report the latency */
+    cmd_ocp_bench,
+    /** @brief Analyse the ripple of a channel of the ADC recording */
+    cmd_ripple,
+    /** @brief Start or read a lock-in measurement against the function generator */
+    cmd_lockin,
+    /** @brief Envelope carrying the bus address of the unit a command is for */
+    cmd_addressed,
+    /** @brief Read a chunk of the binary snapshot of the settings */
+    cmd_config_export,
+    /** @brief Write a chunk of a settings snapshot, applied on the last one */
+    cmd_config_import,
+    /** @brief Read and optionally reset the serial link error counters */
+    cmd_link_stats,
+    /** @brief Read and optionally reset the deadline statistics of the scheduled jobs */
+    cmd_sched_stats,
+    /** @brief Enter, leave or query headless mode */
+    cmd_headless,
+    /** @brief Select or read the ADC acquisition profile */
+    cmd_adc_profile,
+    /** @brief Read and optionally reset the accounting of the per sample hooks */
+    cmd_isr_hooks,
+    /** @brief Stage parameter values of a function, current or not */
+    cmd_stage_parameters,
+    /** @brief Select a function by index and apply its staged values */
+    cmd_switch_function,
     /** @brief Response flag - OR'd with command in responses */
     cmd_response = 0x80
 } command_t;
@@ -173,6 +321,8 @@ typedef enum {
     upgrade_overflow_error,
     /** @brief Received upgrade data without upgrade_start */
     upgrade_protocol_error,
+    /** @brief Upgrade data frame failed its CRC check, resend it */
+    upgrade_chunk_error,
     /** @brief Firmware successfully received and verified */
     upgrade_success = 16
 } upgrade_status_t;
@@ -198,6 +348,18 @@ typedef enum {
     reason_app_start_failed
 } upgrade_reason_t;
 
+/** @brief Upgrade capability flag, the bootloader accepts LZ compressed images */
+#define UPGRADE_CAP_LZ      (1 << 0)
+/** @brief Upgrade capability flag, the bootloader can resume an interrupted upgrade */
+#define UPGRADE_CAP_RESUME  (1 << 1)
+
+/** @brief cmd_upgrade_start flag, continue at the offset the bootloader offered */
+#define UPGRADE_START_RESUME  (1 << 0)
+
+/** @brief Compressed upgrade images start with these bytes, see unlz.h */
+#define UPGRADE_LZ_MAGIC      "DPZ1"
+#define UPGRADE_LZ_MAGIC_LEN  (4)
+
 /**
  * @brief Status codes for set_parameters command responses
  *
@@ -222,6 +384,367 @@ typedef enum {
  */
 #define INVALID_TEMPERATURE (0xffff)
 
+/**
+ * @def ENVELOPE_LENGTH
+ * @brief Bytes a cmd_tagged or a cmd_addressed envelope adds to a payload
+ *
+ * Chunked commands and responses are sized so the payload, command byte
+ * included, fits in MAX_PAYLOAD_LENGTH inside both envelopes: 61 - 4 = 57
+ * bytes. Frames the DPS sends on its own are never tagged and get 59 bytes.
+ */
+#define ENVELOPE_LENGTH (2)
+
+/**
+ * @def STREAM_MAX_SAMPLES
+ * @brief Maximum number of samples in one cmd_stream_data frame
+ *
+ * 8 header bytes and 4 per sample, 8 + 4 * 12 = 56 of 59 bytes.
+ */
+#define STREAM_MAX_SAMPLES (12)
+
+/**
+ * @def LOG_MAX_WORDS
+ * @brief Maximum number of log words in one cmd_log frame
+ *
+ * 3 header bytes and 4 per word, 3 + 4 * 14 = 59 of 59 bytes.
+ */
+#define LOG_MAX_WORDS (14)
+
+/**
+ * @def BATCH_MAX_COMMANDS
+ * @brief Maximum number of sub-commands in one cmd_batch frame
+ */
+#define BATCH_MAX_COMMANDS (16)
+
+/**
+ * @def SCHEDULE_MAX_COMMANDS
+ * @brief Number of commands cmd_schedule holds, pending or run
+ */
+#ifdef CONFIG_SCHEDULE_SLOTS
+ #define SCHEDULE_MAX_COMMANDS CONFIG_SCHEDULE_SLOTS
+#else
+ #define SCHEDULE_MAX_COMMANDS (4)
+#endif
+
+/**
+ * @def SCHEDULE_MAX_LENGTH
+ * @brief Longest command, command byte included, cmd_schedule accepts
+ */
+#define SCHEDULE_MAX_LENGTH (32)
+
+/**
+ * @brief State of a cmd_schedule slot, see cmd_schedule_status
+ */
+typedef enum {
+    schedule_pending = 1, /**< Waiting for its time */
+    schedule_done,        /**< Run and succeeded */
+    schedule_failed,      /**< Run and failed */
+} schedule_state_t;
+
+/**
+ * @brief Feature bits of cmd_capabilities, one per optional part of the
+ *        protocol enabled by a build flag
+ */
+#define CAP_FUNCGEN          (1 << 0)  /**< cmd_wave_upload, FUNCGEN_ENABLE */
+#define CAP_SEQUENCER        (1 << 1)  /**< cmd_seq_upload, SEQUENCER_ENABLE */
+#define CAP_THERMAL_LOCKOUT  (1 << 2)  /**< cmd_temperature_report, THERMAL_LOCKOUT */
+#define CAP_CAL_LUT          (1 << 3)  /**< cmd_set_cal_lut, CAL_LUT */
+#define CAP_ADC_RECORDER     (1 << 4)  /**< cmd_record_start/dump, ADC_RECORDER */
+#define CAP_TRIP_SNAPSHOT    (1 << 5)  /**< cmd_trip_snapshot, TRIP_SNAPSHOT */
+#define CAP_PERF             (1 << 6)  /**< cmd_perf_report, PERF */
+#define CAP_LOAD_METER       (1 << 7)  /**< cmd_load_stats, LOAD_METER */
+#define CAP_STACK_MONITOR    (1 << 8)  /**< cmd_ram_stats, STACK_MONITOR */
+#define CAP_ENERGY_METER     (1 << 9)  /**< cmd_energy_stats, ENERGY_METER */
+#define CAP_WINDOW_STATS     (1 << 10) /**< cmd_window_stats, WINDOW_STATS */
+#define CAP_DEFERRED_LOG     (1 << 11) /**< cmd_log, DEFERRED_LOG */
+#define CAP_SCHEDULE         (1 << 12) /**< cmd_clock_sync and cmd_schedule*, SCHEDULE */
+#define CAP_NOTIFY           (1 << 13) /**< cmd_subscribe and cmd_notify, NOTIFY */
+#define CAP_PRESETS          (1 << 14) /**< cmd_save_preset and cmd_recall_preset, PRESETS */
+#define CAP_OCP_BENCH        (1 << 15) /**< cmd_ocp_bench, OCP_BENCH */
+#define CAP_RIPPLE           (1 << 16) /**< cmd_ripple, RIPPLE */
+#define CAP_LOCKIN           (1 << 17) /**< cmd_lockin, LOCKIN */
+#define CAP_BUS              (1 << 18) /**< cmd_addressed, BUS_ADDRESS */
+#define CAP_CONFIG           (1 << 19) /**< cmd_config_export and cmd_config_import, CLONE */
+#define CAP_HEADLESS         (1 << 20) /**< cmd_headless, HEADLESS */
+#define CAP_ADC_PROFILE      (1 << 21) /**< cmd_adc_profile, ADC_PROFILES */
+#define CAP_FUNC_STAGING     (1 << 22) /**< cmd_stage_parameters and cmd_switch_function, FUNC_STAGING */
+#define CAP_ADC_NOISE        (1 << 23) /**< cmd_cal_report noise windows, ADC_NOISE */
+
+/**
+ * @def CAP_REQUEST_BYTES
+ * @brief Request size, framing and escaping included, the pipeline depth of
+ *        cmd_capabilities is counted in
+ */
+#define CAP_REQUEST_BYTES (32)
+
+/**
+ * @brief State changes of cmd_notify, bit n of the cmd_subscribe mask
+ *        subscribes to event n
+ */
+typedef enum {
+    notify_output = 0,  /**< Output enabled, <value> 1, or disabled, 0 */
+    notify_function,    /**< Function <index> selected */
+    notify_screen,      /**< Screen <index> shown, see opendps_change_screen() */
+    notify_parameter,   /**< Parameter <index> of the function changed to <value> */
+    notify_limit_mode,  /**< Output current limited, <value> 1, or regulating voltage, 0 */
+    notify_thermal,     /**< Thermal lockout engaged, <value> 1, or released, 0 */
+    notify_trip,        /**< Output cut by OCP, <index> 1, or OVP, 2 */
+    notify_lock,        /**< UI locked, <value> 1, or unlocked, 0 */
+    notify_regime,      /**< Output entered CC, <index> 1, or CV, 0, at <value> cur_time_us() */
+    notify_events
+} notify_event_t;
+
+/**
+ * @def NOTIFY_QUEUE_SIZE
+ * @brief Notifications waiting to be sent, more are dropped
+ */
+#define NOTIFY_QUEUE_SIZE (8)
+
+/**
+ * @def MSG_MAX_LENGTH
+ * @brief Largest response the DPS sends as a message, see "Messages"
+ */
+#ifdef CONFIG_MSG_MAX_LENGTH
+ #define MSG_MAX_LENGTH CONFIG_MSG_MAX_LENGTH
+#else
+ #define MSG_MAX_LENGTH (256)
+#endif
+
+/**
+ * @def MSG_WINDOW
+ * @brief Fragments sent before waiting for an acknowledgement
+ */
+#ifdef CONFIG_MSG_WINDOW
+ #define MSG_WINDOW CONFIG_MSG_WINDOW
+#else
+ #define MSG_WINDOW (4)
+#endif
+
+/**
+ * @def QUERY_COMPACT_SESSIONS
+ * @brief Number of hosts that can poll with cmd_query_compact independently
+ */
+#define QUERY_COMPACT_SESSIONS (4)
+
+/**
+ * @def QUERY_COMPACT_MAX_DELTAS
+ * @brief Space for deltas in one cmd_query_compact response
+ *
+ * 6 header bytes and the deltas, 6 + 51 = 57 of 57 bytes.
+ */
+#define QUERY_COMPACT_MAX_DELTAS (51)
+
+/** @brief Version of the cmd_ping heartbeat response */
+#define PING_VERSION (1)
+
+/**
+ * @brief Bits of the cmd_ping heartbeat status word, see opendps_get_status()
+ */
+#define PING_STATUS_OUTPUT      (1 << 0) /**< Output enabled */
+#define PING_STATUS_CC          (1 << 1) /**< Output current limited */
+#define PING_STATUS_OCP         (1 << 2) /**< Output cut by OCP, until enabled again */
+#define PING_STATUS_OVP         (1 << 3) /**< Output cut by OVP, until enabled again */
+#define PING_STATUS_THERMAL     (1 << 4) /**< Thermal lockout */
+#define PING_STATUS_LOCKED      (1 << 5) /**< UI locked */
+#define PING_STATUS_FUNC_SHIFT  (8)      /**< Index of the current function */
+#define PING_STATUS_FUNC_MASK   (0xff << PING_STATUS_FUNC_SHIFT)
+
+/** @brief cmd_query_compact request flag: send every field */
+#define QUERY_COMPACT_FULL   (1 << 0)
+/** @brief cmd_query_compact response flag: deltas are relative to zero */
+#define QUERY_COMPACT_RESET  (1 << 0)
+
+/**
+ * @brief Status fields of cmd_query_compact, bit numbers of the changed mask
+ */
+typedef enum {
+    query_v_in = 0,         /**< Input voltage in mV */
+    query_v_out,            /**< Output voltage in mV */
+    query_i_out,            /**< Output current in mA */
+    query_output_enabled,   /**< 1 if the output is on */
+    query_temp1,            /**< Temperature 1, see cmd_temperature_report */
+    query_temp2,            /**< Temperature 2 */
+    query_temp_shutdown,    /**< 1 if in temperature shutdown */
+    query_param_0,          /**< First parameter of the current function, as in cmd_get_parameters_bin */
+} query_field_t;
+
+/**
+ * @def QUERY_MAX_FIELDS
+ * @brief Number of bits in the cmd_query_compact changed mask
+ */
+#define QUERY_MAX_FIELDS (16)
+
+/**
+ * @def RECORDER_CHUNK
+ * @brief Maximum number of samples in one cmd_record_dump response
+ *
+ * 22 header bytes and 2 per sample, 22 + 2 * 17 = 56 of 57 bytes.
+ */
+#define RECORDER_CHUNK (17)
+
+/**
+ * @def TRIP_SNAPSHOT_CHUNK
+ * @brief Maximum number of sample sets in one cmd_trip_snapshot response
+ *
+ * 14 header bytes and 6 per sample set, 14 + 6 * 7 = 56 of 57 bytes.
+ */
+#define TRIP_SNAPSHOT_CHUNK (7)
+
+/**
+ * @def TRIP_SNAPSHOT_CLEAR
+ * @brief cmd_trip_snapshot flag, capture the next trip after responding
+ */
+#define TRIP_SNAPSHOT_CLEAR (1 << 0)
+
+/**
+ * @def WAVE_UPLOAD_CHUNK
+ * @brief Maximum number of samples in one cmd_wave_upload command
+ *
+ * 4 header bytes and 2 per sample, 4 + 2 * 26 = 56 of 57 bytes.
+ */
+#define WAVE_UPLOAD_CHUNK (26)
+
+/**
+ * @def WAVE_UPLOAD_COMMIT
+ * @brief cmd_wave_upload flag, this is the last chunk of the waveform
+ */
+#define WAVE_UPLOAD_COMMIT (1 << 0)
+
+/**
+ * @def SEQ_UPLOAD_CHUNK
+ * @brief Maximum number of steps in one cmd_seq_upload command
+ *
+ * 4 header bytes and 8 per step, 4 + 8 * 6 = 52 of 57 bytes.
+ */
+#define SEQ_UPLOAD_CHUNK (6)
+
+/**
+ * @def SEQ_UPLOAD_COMMIT
+ * @brief cmd_seq_upload flag, this is the last chunk of the program
+ */
+#define SEQ_UPLOAD_COMMIT (1 << 0)
+
+/**
+ * @def CONFIG_EXPORT_CHUNK
+ * @brief Maximum number of bytes in one cmd_config_export response
+ *
+ * 7 header bytes and the data, 7 + 48 = 55 of 57 bytes.
+ */
+#define CONFIG_EXPORT_CHUNK (48)
+
+/**
+ * @def CONFIG_IMPORT_CHUNK
+ * @brief Maximum number of bytes in one cmd_config_import command
+ *
+ * 5 header bytes and the data, 5 + 48 = 53 of 57 bytes.
+ */
+#define CONFIG_IMPORT_CHUNK (48)
+
+/**
+ * @def CONFIG_IMPORT_COMMIT
+ * @brief cmd_config_import flag, this is the last chunk of the snapshot
+ */
+#define CONFIG_IMPORT_COMMIT (1 << 0)
+
+/**
+ * @def LINK_STATS_RESET
+ * @brief cmd_link_stats flag, clear the counters once they are reported
+ */
+#define LINK_STATS_RESET (1 << 0)
+
+/**
+ * @def SCHED_STATS_RESET
+ * @brief cmd_sched_stats flag, clear the statistics once they are reported
+ */
+#define SCHED_STATS_RESET (1 << 0)
+
+/**
+ * @def SCHED_JOB_CRITICAL
+ * @brief cmd_sched_stats job flag, the watchdog depends on the job
+ */
+#define SCHED_JOB_CRITICAL (1 << 0)
+
+/**
+ * @def HEADLESS_ENABLE
+ * @brief cmd_headless flag, enter headless mode, leave it if clear
+ */
+#define HEADLESS_ENABLE (1 << 0)
+
+/**
+ * @def HEADLESS_STORE
+ * @brief cmd_headless flag, also start in the requested mode at power up
+ */
+#define HEADLESS_STORE (1 << 1)
+
+/**
+ * @def ADC_PROFILE_STORE
+ * @brief cmd_adc_profile flag, also select the profile at power up
+ */
+#define ADC_PROFILE_STORE (1 << 0)
+
+/**
+ * @def ISR_HOOKS_CHUNK
+ * @brief Maximum number of hooks in one cmd_isr_hooks response
+ *
+ * 5 header bytes and 15 per hook, 5 + 15 * 3 = 50 of 57 bytes.
+ */
+#define ISR_HOOKS_CHUNK (3)
+
+/**
+ * @def ISR_HOOKS_RESET
+ * @brief cmd_isr_hooks flag, clear the accounting of all hooks after responding
+ */
+#define ISR_HOOKS_RESET (1 << 0)
+
+/**
+ * @def CAL_SWEEP_V_DAC
+ * @brief cmd_cal_sweep channel, step the output voltage DAC
+ */
+#define CAL_SWEEP_V_DAC (0)
+
+/**
+ * @def CAL_SWEEP_A_DAC
+ * @brief cmd_cal_sweep channel, step the current limit DAC
+ */
+#define CAL_SWEEP_A_DAC (1)
+
+/**
+ * @def CAL_NOISE_STOP
+ * @brief cmd_cal_report noise channel flag, stop the noise windows after responding
+ */
+#define CAL_NOISE_STOP (1 << 7)
+
+/**
+ * @def PERF_REPORT_CHUNK
+ * @brief Maximum number of probes in one cmd_perf_report response
+ *
+ * 9 header bytes and 16 per probe, 9 + 16 * 3 = 57 of 57 bytes.
+ */
+#define PERF_REPORT_CHUNK (3)
+
+/**
+ * @def PERF_REPORT_RESET
+ * @brief cmd_perf_report flag, clear all probes after responding
+ */
+#define PERF_REPORT_RESET (1 << 0)
+
+/**
+ * @def OCP_BENCH_MAX_RUNS
+ * @brief Maximum number of trips of one cmd_ocp_bench
+ *
+ * Bounds the time the main loop is blocked, a run takes a few ms.
+ */
+#define OCP_BENCH_MAX_RUNS (32)
+
+/**
+ * @def SERIAL_BAUD_TIMEOUT_MS
+ * @brief Idle time after which a negotiated baud rate reverts to the default
+ *
+ * Hosts that keep a negotiated rate must send a frame (e.g. cmd_ping) at
+ * least this often.
+ */
+#define SERIAL_BAUD_TIMEOUT_MS (3000)
+
 /*
  * =============================================================================
  * Frame Creation Helpers
@@ -250,6 +773,14 @@ void protocol_create_response(frame_t *frame, command_t cmd, uint8_t success);
  */
 void protocol_create_ping(frame_t *frame);
 
+/**
+ * @brief Create a set baud rate command frame
+ *
+ * @param[out] frame    Frame structure to initialize
+ * @param[in]  baudrate Requested baud rate
+ */
+void protocol_create_set_baudrate(frame_t *frame, uint32_t baudrate);
+
 /**
  * @brief Create a power enable/disable command frame
  *
@@ -425,6 +956,75 @@ bool protocol_unpack_ocp(frame_t *frame, uint16_t *i_cut);
  */
 bool protocol_unpack_upgrade_start(frame_t *frame, uint16_t *chunk_size, uint16_t *crc);
 
+/**
+ * @brief Unpack a stream start command frame
+ *
+ * @param[in]  frame       Frame to unpack
+ * @param[out] interval_ms Time between samples in milliseconds
+ * @param[out] batch       Number of samples per cmd_stream_data frame
+ * @return true if unpacking succeeded, false otherwise
+ */
+bool protocol_unpack_stream_start(frame_t *frame, uint16_t *interval_ms, uint8_t *batch);
+
+/**
+ * @brief Unpack a set baud rate command frame
+ *
+ * @param[in]  frame    Frame to unpack
+ * @param[out] baudrate Requested baud rate
+ * @return true if unpacking succeeded, false otherwise
+ */
+bool protocol_unpack_set_baudrate(frame_t *frame, uint32_t *baudrate);
+
+/**
+ * @brief Create a wave upload command frame
+ *
+ * @param[out] frame   Frame to create
+ * @param[in]  flags   WAVE_UPLOAD_COMMIT on the last chunk
+ * @param[in]  offset  Index of the first sample in the table
+ * @param[in]  count   Number of samples, at most WAVE_UPLOAD_CHUNK
+ * @param[in]  samples The samples
+ */
+void protocol_create_wave_upload(frame_t *frame, uint8_t flags, uint8_t offset, uint8_t count, const uint16_t *samples);
+
+/**
+ * @brief Unpack a wave upload command frame
+ *
+ * @param[in]  frame   Frame to unpack
+ * @param[out] flags   WAVE_UPLOAD_* flags
+ * @param[out] offset  Index of the first sample in the table
+ * @param[out] count   Number of samples
+ * @param[out] samples Receives the samples, room for WAVE_UPLOAD_CHUNK
+ * @return true if unpacking succeeded, false if the frame is malformed or
+ *         carries more than WAVE_UPLOAD_CHUNK samples
+ */
+bool protocol_unpack_wave_upload(frame_t *frame, uint8_t *flags, uint8_t *offset, uint8_t *count, uint16_t *samples);
+
+/**
+ * @brief Limits of a cmd_capabilities response, see "Capabilities"
+ */
+typedef struct {
+    uint32_t features;           /**< CAP_* bits */
+    uint16_t max_frame;          /**< Largest frame */
+    uint16_t max_msg;            /**< Largest response sent as a message */
+    uint8_t msg_window;          /**< Fragments per acknowledgement */
+    uint8_t batch;               /**< Sub-commands of a cmd_batch */
+    uint8_t schedule;            /**< cmd_schedule slots */
+    uint8_t pipeline;            /**< Requests that may be in flight */
+    uint8_t stream_samples;      /**< Samples in a cmd_stream_data frame */
+    uint16_t stream_min_ms;      /**< Shortest stream interval */
+    uint32_t cur_baudrate;       /**< Rate of the link */
+    uint32_t max_baudrate;       /**< Fastest rate cmd_set_baudrate accepts */
+} capabilities_t;
+
+/**
+ * @brief Unpack a capabilities response frame
+ *
+ * @param[in]  frame Frame to unpack, without a cmd_tagged envelope
+ * @param[out] caps  The features and limits
+ * @return true if unpacking succeeded and the status was success, false otherwise
+ */
+bool protocol_unpack_capabilities(frame_t *frame, capabilities_t *caps);
+
 
 /*
  * =============================================================================
@@ -437,6 +1037,18 @@ bool protocol_unpack_upgrade_start(frame_t *frame, uint16_t *chunk_size, uint16_
  *  HOST:   [cmd_ping]
  *  DPS:    [cmd_response | cmd_ping] [1]
  *
+ * A host keeping a heartbeat asks for a versioned response instead, which
+ * does not flash the screen. It carries the PING_STATUS_* word, the number
+ * of state changes so far (see opendps_get_status()) and the measurements
+ * and parameters that changed, exactly as a cmd_query_compact of <session>
+ * with <flags> would. The DPS answers with the highest <version> it knows,
+ * PING_VERSION, a later version only appends fields. Devices that predate
+ * the heartbeat answer with the status alone.
+ *
+ *  HOST:   [cmd_ping] [version:8] [session:8] [flags:8]
+ *  DPS:    [cmd_response | cmd_ping] [<status>] [version:8] [status:16] [seq:16]
+ *          [session:8] [flags:8] [changed:16] ([delta:varint])*
+ *
  *
  * === Reading the status of the DPS ===
  *
@@ -520,14 +1132,701 @@ bool protocol_unpack_upgrade_start(frame_t *frame, uint16_t *chunk_size, uint16_
  *  2. Device restarts into bootloader
  *  3. Bootloader sends cmd_upgrade_start ack
  *  4. Host sends cmd_upgrade_data chunks
- *  5. Bootloader writes each chunk to flash and acks
+ *  5. Bootloader acks each chunk on receipt and writes it to flash while the
+ *     next one is received
  *  6. After last chunk, bootloader verifies CRC and boots app
  *
- *  HOST:     [cmd_upgrade_start] [chunk_size:16] [crc:16]
- *  DPS (BL): [cmd_response | cmd_upgrade_start] [<upgrade_status_t>] [<chunk_size:16>] [<upgrade_reason_t:8>]
+ * The ack of a chunk carries the result of writing the previous chunk, i.e.
+ * an erase or flash error is reported one chunk late. The last chunk is the
+ * first one shorter than <chunk_size>, an empty one if the binary is a
+ * multiple of <chunk_size>. It is acked once written and verified with
+ * upgrade_success or the error. The host must not send a chunk before the
+ * previous one has been acked.
+ *
+ * The firmware CRC is accumulated as chunks are written, each chunk is
+ * protected by the CRC of its frame. Every ack carries <offset>, the number
+ * of bytes written so far. Chunks that fail the frame CRC (upgrade_chunk_error)
+ * or could not be erased or flashed are dropped and the host may resend from
+ * <offset> instead of restarting the upgrade. upgrade_crc_error means the
+ * complete image did not match <crc> and is final.
+ *
+ * If <caps> has UPGRADE_CAP_LZ the upgrade data may be UPGRADE_LZ_MAGIC
+ * followed by the image compressed as described in unlz.h. The bootloader
+ * decompresses it while writing, <crc> is still that of the uncompressed
+ * image and <offset> counts upgrade data bytes. Only upgrade_chunk_error can
+ * be resumed from in a compressed upgrade, erase and flash errors are final.
+ *
+ * During raw upgrades the bootloader records its progress in past every 8kB. If an upgrade of the image with the same
+ * <crc> was interrupted and the recorded part of flash still matches, the
+ * start response offers <resume_offset> and <resume_crc>, the CRC of the
+ * first <resume_offset> bytes. The host checks <resume_crc> against its image
+ * and sends cmd_upgrade_start again with UPGRADE_START_RESUME to continue at
+ * <resume_offset> using raw data. Without the flag the upgrade starts over.
+ * The flag is only known to the bootloader, the app rejects it.
+ *
+ *  HOST:     [cmd_upgrade_start] [chunk_size:16] [crc:16] ([flags:8])
+ *  DPS (BL): [cmd_response | cmd_upgrade_start] [<upgrade_status_t>] [<chunk_size:16>] [<upgrade_reason_t:8>] [<caps:8>] [<resume_offset:32>] [<resume_crc:16>]
  *
  *  HOST:   [cmd_upgrade_data] [<payload>]+
- *  DPS BL: [cmd_response | cmd_upgrade_data] [<upgrade_status_t>]
+ *  DPS BL: [cmd_response | cmd_upgrade_data] [<upgrade_status_t>] [<offset:32>]
+ *
+ *
+ * === Streaming telemetry ===
+ * Instead of polling with cmd_query, the host can ask the DPS to push samples.
+ * The DPS samples V_out and I_out every <interval_ms> and sends a frame each
+ * time <batch> samples (1..STREAM_MAX_SAMPLES) have been collected. The
+ * sequence number is incremented for every frame, allowing the host to detect
+ * lost frames. Streaming stops on cmd_stream_stop.
+ *
+ *  HOST:   [cmd_stream_start] [interval_ms:16] [batch:8]
+ *  DPS:    [cmd_response | cmd_stream_start] [<status>]
+ *
+ *  DPS:    [cmd_stream_data] [seq:16] [interval_ms:16] [V_in:16] [count:8]
+ *          ([V_out:16] [I_out:16]) * count
+ *  HOST:   none
+ *
+ *  HOST:   [cmd_stream_stop]
+ *  DPS:    [cmd_response | cmd_stream_stop] [1]
+ *
+ *
+ * === Baud rate negotiation ===
+ * The link always starts at the build time default (CONFIG_BAUDRATE). The
+ * response is sent at the current rate, after which both sides switch. If
+ * no valid frame is received for SERIAL_BAUD_TIMEOUT_MS the DPS falls back
+ * to the default rate, so a host that went away or failed to switch can
+ * always reconnect. The timeout is suspended while streaming. Supported
+ * rates are 9600, 19200, 38400, 57600 and 115200.
+ *
+ *  HOST:   [cmd_set_baudrate] [baudrate:32]
+ *  DPS:    [cmd_response | cmd_set_baudrate] [<status>]
+ *
+ *
+ * === Tagged commands ===
+ * Any command may be wrapped in a cmd_tagged envelope. The DPS handles the
+ * inner command as usual and wraps its response in the same envelope with
+ * the tag copied from the request, allowing a host to have several commands
+ * in flight and match the responses by tag. Frames the DPS sends on its own
+ * (cmd_ocp_event, cmd_stream_data, cmd_cal_data, cmd_log, cmd_notify) are
+ * never tagged.
+ * A response that would not fit in a frame once tagged is replaced by a
+ * failure status.
+ *
+ *  HOST:   [cmd_tagged] [tag:8] [cmd] [optional_payload]*
+ *  DPS:    [cmd_response | cmd_tagged] [tag:8] [cmd_response | cmd] [<status>] [response_data]*
+ *
+ *
+ * === Batched commands ===
+ * A batch carries 1..BATCH_MAX_COMMANDS sub-commands, each prefixed with its
+ * length (command byte included). The whole batch is checked before anything
+ * is run, then the sub-commands run in order within one frame so no other
+ * command or UI event is handled in between. Execution stops at the first
+ * failing sub-command. The response holds the number of sub-commands run and
+ * the status of each. Sub-commands answering with data (eg. cmd_query) send
+ * their responses as usual, ahead of the batch response. cmd_batch,
+ * cmd_tagged, cmd_set_baudrate and cmd_upgrade_start cannot be batched.
+ *
+ *  HOST:   [cmd_batch] [count:8] ([len:8] [cmd] [optional_payload]*) * count
+ *  DPS:    [cmd_response | cmd_batch] [<status>] [run:8] [<status>] * run
+ *
+ *
+ * === Binary parameters ===
+ * Compact alternatives to cmd_set_parameters and cmd_list_parameters. A
+ * parameter is addressed by its index in the cmd_list_parameters response
+ * for the current function and values are signed 32 bit integers in the
+ * same unit as their string form. The set response carries one
+ * set_param_status_t per parameter, in the order given.
+ *
+ *  HOST:   [cmd_set_parameters_bin] ([index:8] [value:32]) *
+ *  DPS:    [cmd_response | cmd_set_parameters_bin] [1] ([<set_param_status_t>])*
+ *
+ *  HOST:   [cmd_get_parameters_bin]
+ *  DPS:    [cmd_response | cmd_get_parameters_bin] [<status>] [count:8] ([value:32]) * count
+ *
+ *
+ * === Compact query ===
+ * Each of QUERY_COMPACT_SESSIONS sessions remembers the values last sent to
+ * it. A response only carries the fields (see query_field_t) that changed
+ * since, as the difference to the previous value. Differences are zigzag
+ * encoded varints: 7 bits per byte, LSB first, MSB set on all but the last
+ * byte. They appear in field order with one bit set in <changed> for each.
+ * The session starts over from zero on its first query, when the host sets
+ * QUERY_COMPACT_FULL or when the current function changed; the response then
+ * has QUERY_COMPACT_RESET set. A host that lost a response must ask for a
+ * full query, the session has already moved on.
+ *
+ *  HOST:   [cmd_query_compact] [session:8] [flags:8]
+ *  DPS:    [cmd_response | cmd_query_compact] [<status>] [session:8] [flags:8] [changed:16] ([delta:varint])*
+ *
+ *
+ * === ADC recorder ===
+ * Available with CONFIG_ADC_RECORDER, see recorder.h. cmd_record_start arms
+ * the recorder with a channel mask (I_out 1, V_in 2, V_out 4), a decimation,
+ * the number of sample sets to keep after the trigger and a mask of triggers
+ * (now 1, OCP 2, OVP 4). Once <state> reads done (3) the host downloads the
+ * recording, oldest sample first, by asking for consecutive offsets until
+ * <total> samples have been read. Sample sets hold the selected channels in
+ * the order I_out, V_in, V_out and the first <pre> sets precede the trigger.
+ * Before the recording is done responses carry no samples.
+ *
+ *  HOST:   [cmd_record_start] [channels:8] [decimation:16] [post:16] [triggers:8]
+ *  DPS:    [cmd_response | cmd_record_start] [<status>]
+ *
+ *  HOST:   [cmd_record_dump] [offset:16]
+ *  DPS:    [cmd_response | cmd_record_dump] [<status>] [state:8] [channels:8] [decimation:16]
+ *          [trigger:8] [trigger_us:64] [pre:16] [total:16] [offset:16] [count:8] ([sample:16]) * count
+ *
+ *
+ * === Trip snapshot ===
+ * Available with CONFIG_TRIP_SNAPSHOT. When OCP or OVP cuts the output the
+ * last <total> raw sample sets are frozen together with the V and I DAC
+ * setpoints and a microsecond timestamp. <trip> is 0 (none), 1 (OCP) or
+ * 2 (OVP). Sample sets are I_out, V_in, V_out, oldest first, and the last one
+ * is the sample that tripped. The host reads consecutive offsets until
+ * <total> sets have been read. Only the first trip is kept, set
+ * TRIP_SNAPSHOT_CLEAR (1) in <flags> to capture the next one once this
+ * response has been sent.
+ *
+ *  HOST:   [cmd_trip_snapshot] [offset:8] [flags:8]
+ *  DPS:    [cmd_response | cmd_trip_snapshot] [<status>] [trip:8] [time_us:32] [v_dac:16] [i_dac:16]
+ *          [total:8] [offset:8] [count:8] ([i_out:16] [v_in:16] [v_out:16]) * count
+ *
+ *
+ * === Event queue statistics ===
+ * Every event source has its own queue, see event.h. The response holds one
+ * entry per source in the order buttons, UART, ADC, main loop with the number
+ * of events dropped since power up, the highest fill level seen and the
+ * queue size.
+ *
+ *  HOST:   [cmd_event_stats]
+ *  DPS:    [cmd_response | cmd_event_stats] [<status>] [count:8] ([drops:32] [peak:16] [size:16]) * count
+ *
+ *
+ * === Serial link statistics ===
+ * Counts what went wrong on the serial link since power up or the last
+ * reset, to tell the error cost of a higher baud rate or a noisy line.
+ *  <frames>     frames received intact
+ *  <crc>        frames failing the CRC
+ *  <length>     frames too short or too long for the receive buffer
+ *  <aborted>    frames cut off by the start of the next one
+ *  <rejected>   unknown commands and commands too short for their handler
+ *  <tx_dropped> responses dropped for lack of a frame to wrap them in
+ *  <timeouts>   returns to CONFIG_BAUDRATE after a silent host, see
+ *               cmd_set_baudrate
+ *  <overrun>    bytes lost because the USART was not read in time
+ *  <noise>      bytes with a framing error or noise
+ *  <rx_dropped> bytes dropped by a full receive ring
+ *  <events>     events dropped by full queues, the sum of cmd_event_stats
+ * With LINK_STATS_RESET (1) in the optional <flags> all counters, those of
+ * cmd_event_stats too, start over from zero after the response is packed.
+ *
+ *  HOST:   [cmd_link_stats] [flags:8]
+ *  DPS:    [cmd_response | cmd_link_stats] [<status>] [frames:32] [crc:32] [length:32] [aborted:32]
+ *          [rejected:32] [tx_dropped:32] [timeouts:32] [overrun:32] [noise:32] [rx_dropped:32] [events:32]
+ *
+ *
+ * === Scheduler statistics ===
+ * Reports the jobs watched by the scheduler, see sched_watch(). A job has
+ * a <deadline> in ms it may start after it was due, <misses> counts the
+ * runs that started later. <late> and <run> are the worst start after the
+ * due time and the worst run time in us. SCHED_JOB_CRITICAL (1) in the job
+ * <flags> marks a job the watchdog depends on. Jobs that do not fit the
+ * frame are left out. With SCHED_STATS_RESET (1) in the optional <flags>
+ * the statistics start over after the response is packed.
+ *
+ *  HOST:   [cmd_sched_stats] [flags:8]
+ *  DPS:    [cmd_response | cmd_sched_stats] [<status>] [count:8] ([name:cstr] [flags:8] [deadline:16]
+ *          [runs:32] [misses:16] [late:32] [run:32]) * count
+ *
+ *
+ * === Arbitrary waveform upload ===
+ * Available with CONFIG_FUNCGEN_ENABLE. Function 3 of the function generator
+ * plays a table of up to FUNCGEN_ARB_POINTS (128) samples as one period, each
+ * sample held for 1/<length> of the period. A sample is a fraction of the set
+ * voltage where 0xffff is the full voltage. The host writes the table in
+ * chunks of at most WAVE_UPLOAD_CHUNK samples at <offset> and sets
+ * WAVE_UPLOAD_COMMIT (1) in <flags> on the last one. The table then is
+ * <offset> + <count> samples long, takes effect and is saved to flash.
+ * Samples written before the commit may be played right away if the
+ * arbitrary function is running.
+ *
+ *  HOST:   [cmd_wave_upload] [flags:8] [offset:8] [count:8] ([sample:16]) * count
+ *  DPS:    [cmd_response | cmd_wave_upload] [<status>]
+ *
+ *
+ * === Sequencer program upload ===
+ * Available with CONFIG_SEQUENCER_ENABLE. The "seq" function runs a program
+ * of up to SEQ_MAX_STEPS (32) steps, each setting V_out to <mv> and the
+ * current limit to <ma> for <duration> microseconds. A step with a duration
+ * of 0 holds until the host triggers the sequencer by setting its "run"
+ * parameter to 1. The host writes the program in chunks of at most
+ * SEQ_UPLOAD_CHUNK steps at <index> and sets SEQ_UPLOAD_COMMIT (1) in <flags>
+ * on the last one. The program then is <index> + <count> steps long and is
+ * saved to flash. Uploads fail while a program is running.
+ *
+ *  HOST:   [cmd_seq_upload] [flags:8] [index:8] [count:8] ([mv:16] [ma:16] [duration:32]) * count
+ *  DPS:    [cmd_response | cmd_seq_upload] [<status>]
+ *
+ *
+ * === Calibration averaging and sweeps ===
+ * A cmd_cal_report carrying a sample count asks the DPS to average that many
+ * raw ADC sample sets (1..65535, ~21k per second) in the ADC interrupt rather
+ * than return a single reading. The request is acknowledged at once and the
+ * result is pushed as a cmd_cal_data frame when the samples are in. A plain
+ * cmd_cal_report still returns the full report described by unpack_cal_report
+ * in dpsctl.
+ *
+ *  HOST:   [cmd_cal_report] [samples:16]
+ *  DPS:    [cmd_response | cmd_cal_report] [<status>]
+ *
+ * cmd_cal_sweep steps the V_DAC (CAL_SWEEP_V_DAC) or the A_DAC
+ * (CAL_SWEEP_A_DAC) from <start> in <points> steps of <step>, waits
+ * <settle_ms> at each point and pushes one cmd_cal_data frame per point. The
+ * output must be enabled and the last point must be a valid 12 bit DAC value.
+ * Disabling the output aborts the sweep with a cmd_cal_data frame with status
+ * 0 and no readings. A sweep with 0 points cancels a running one. Only one
+ * averaging request or sweep is run at a time.
+ *
+ *  HOST:   [cmd_cal_sweep] [channel:8] [start:16] [step:16] [points:8] [settle_ms:16] [samples:16]
+ *  DPS:    [cmd_response | cmd_cal_sweep] [<status>]
+ *
+ * Means are raw ADC values in Q16.16 and variances raw ADC values squared in
+ * Q24.8.
+ *
+ *  DPS:    [cmd_cal_data] [status:8] [index:8] [v_dac:16] [i_dac:16] [samples:16]
+ *          ([mean:32] [variance:32]) * 3, in the order V_out, V_in, I_out
+ *  HOST:   none
+ *
+ * With CONFIG_ADC_NOISE a cmd_cal_report carrying a single <channel> byte,
+ * 0 V_out, 1 V_in or 2 I_out, returns the noise of that channel over the
+ * last full window of adcnoise.h, ADCNOISE_WINDOW (4096) sample sets. The
+ * first such request starts the windows, the first completes ~0.2s later
+ * and <windows> is 0 until then. Setting CAL_NOISE_STOP in <channel> stops
+ * them after the response unless the calibration screen shows them.
+ * <center>, <min> and <max> are raw ADC codes, <mean> is in Q16.16 and
+ * <stddev> has 8 fractional bits. Histogram bin n counts the samples of code
+ * <center> - 8 + n, the first and the last bin also count everything below
+ * and above.
+ *
+ *  HOST:   [cmd_cal_report] [channel:8]
+ *  DPS:    [cmd_response | cmd_cal_report] [<status>] [channel:8] [windows:32] [samples:16]
+ *          [center:16] [min:16] [max:16] [mean:32] [stddev:32] [count:16] * 16
+ *
+ *
+ * === Calibration tables ===
+ * Available with CONFIG_CAL_LUT. Sets the piecewise linear table of a
+ * channel, 0 A_ADC, 1 A_DAC, 2 V_ADC, 3 V_DAC, 4 VIN_ADC (see
+ * pwrctl_cal_channel_t), replacing its K and C coefficients. ADC tables map
+ * raw values to mA or mV, DAC tables mA or mV to raw values. A table holds
+ * 2..CAL_LUT_MAX_POINTS (12) points with both x and y strictly increasing, 0
+ * points removes it. Tables are removed by cmd_clear_calibration.
+ *
+ *  HOST:   [cmd_set_cal_lut] [channel:8] [count:8] ([x:16] [y:16]) * count
+ *  DPS:    [cmd_response | cmd_set_cal_lut] [<status>]
+ *
+ *
+ * === Performance probes ===
+ * Available with CONFIG_PERF, see perf.h. Returns up to PERF_REPORT_CHUNK
+ * probes starting at <offset> out of <total>, in the order ADC ISR, function
+ * generator, handle_frame, uui_refresh, spi_dma_transceive, past_write_unit.
+ * Times are CPU cycles at <clock_hz>, min is 0xffffffff for a probe that
+ * never ran. Setting PERF_REPORT_RESET (1) in <flags> clears all probes
+ * after the response has been built.
+ *
+ *  HOST:   [cmd_perf_report] [offset:8] [flags:8]
+ *  DPS:    [cmd_response | cmd_perf_report] [<status>] [clock_hz:32] [total:8] [offset:8] [count:8]
+ *          ([calls:32] [min:32] [max:32] [mean:32]) * count
+ *
+ *
+ * === CPU load ===
+ * Available with CONFIG_LOAD_METER, see load.h. Returns the last closed
+ * measurement window of ~1s: the time the main loop slept in WFI and the time
+ * spent in the ADC ISR, both in 1/1000 of <window_ms>, and the longest ADC ISR
+ * run in microseconds. <calls> and <overruns> count ADC ISR runs and runs
+ * that did not finish before the next conversion (DMA mode: before the other
+ * buffer half) since power up.
+ *
+ *  HOST:   [cmd_load_stats]
+ *  DPS:    [cmd_response | cmd_load_stats] [<status>] [window_ms:16] [idle_permille:16]
+ *          [isr_permille:16] [isr_max_us:16] [calls:32] [overruns:32]
+ *
+ *
+ * === Setpoint ===
+ * Sets the voltage (mask bit 0) and/or current (mask bit 1) setting of the
+ * current function in mV and mA. Which output setting a value controls
+ * follows the function, in CC the voltage is the limit and vice versa. Both
+ * values are range checked before any is applied and the output follows
+ * before the response is sent. The screen is redrawn on the next UI tick.
+ *
+ *  HOST:   [cmd_set_setpoint] [mask:8] [mv:32] [ma:32]
+ *  DPS:    [cmd_response | cmd_set_setpoint] [1] [<set_param_status_t>]
+ *
+ *
+ * === Energy ===
+ * Available with CONFIG_ENERGY_METER, see energy.h. Returns the charge in
+ * uAh and the energy in uWh delivered since the last reset, integrated over
+ * every ADC sample taken while the output was on, and the time in ms the
+ * output was on. All saturate at 0xffffffff. Setting ENERGY_RESET (1) in
+ * <flags> clears the totals after the response has been built.
+ *
+ *  HOST:   [cmd_energy_stats] [flags:8]
+ *  DPS:    [cmd_response | cmd_energy_stats] [<status>] [charge_uah:32] [energy_uwh:32]
+ *          [runtime_ms:32]
+ *
+ *
+ * === Window statistics ===
+ * Available with CONFIG_WINDOW_STATS, see winstats.h. Returns the smallest,
+ * largest and mean value and the mean of the squares of I_out (mA) and V_out
+ * (mV) over every ADC sample since the previous cmd_window_stats, and starts
+ * a new window. The RMS value is the square root of <mean_sq>. All but
+ * <window_ms> are 0 when the window holds no samples.
+ *
+ *  HOST:   [cmd_window_stats]
+ *  DPS:    [cmd_response | cmd_window_stats] [<status>] [samples:32] [window_ms:32]
+ *          [i_min:16] [i_max:16] [i_mean:16] [i_mean_sq:32]
+ *          [v_min:16] [v_max:16] [v_mean:16] [v_mean_sq:32]
+ *
+ *
+ * === Boot times ===
+ * Returns when each startup phase completed, in ms since the SysTick was
+ * started by hw_init(), in the order of boot_phase_t in opendps.h: hardware
+ * init, display init, past init, settings read, ADC ready, UI init and
+ * ready, when main() entered the event loop. The last one is not a
+ * timestamp but the time DPSBoot ran before starting the app, 0 with a
+ * bootloader that does not report it. Power up to ready is their sum.
+ *
+ *  HOST:   [cmd_boot_times]
+ *  DPS:    [cmd_response | cmd_boot_times] [<status>] [count:8] ([ms:32]) * count
+ *
+ *
+ * === Messages ===
+ * A command or response too large for one frame is sent as a message of
+ * fragments, see "Messages" in uframe.h for the fragment layout. Up to
+ * MSG_WINDOW fragments are sent at a time, the last one of a window and the
+ * last one of the message have UFRAME_FRAG_ACK set in <flags>.
+ *
+ * A response that does not fit in a frame, eg. of cmd_list_parameters, is
+ * sent as fragments carrying the response from [cmd_response | cmd] on. The
+ * host acknowledges a window with the index of the first fragment it is
+ * missing and the DPS answers with the next window. The last fragment of
+ * the message needs no acknowledgement, the DPS sends the message again
+ * from any index until another message replaces it.
+ *
+ *  HOST:   [cmd]
+ *  DPS:    [cmd_response | cmd_fragment] [msg_id:8] [index:8] [flags:8] [total:16] [data]*   (a window)
+ *  HOST:   [cmd_fragment_ack] [msg_id:8] [next:8]
+ *  DPS:    [cmd_response | cmd_fragment] ...   (the next window)
+ *
+ * A command larger than a frame, up to MAX_FRAME_LENGTH bytes from [cmd]
+ * on, is sent the other way. Fragments without UFRAME_FRAG_ACK are not
+ * answered. The DPS acknowledges a window with the first fragment it is
+ * missing, and answers the last fragment of the message with the response
+ * of the command.
+ *
+ *  HOST:   [cmd_fragment] [msg_id:8] [index:8] [flags:8] [total:16] [data]*   (a window)
+ *  DPS:    [cmd_response | cmd_fragment_ack] [msg_id:8] [next:8]
+ *  HOST:   [cmd_fragment] ...   (the last window)
+ *  DPS:    [cmd_response | cmd] [<status>] [response_data]*
+ *
+ *
+ * === Deferred debug log ===
+ * With CONFIG_DEFERRED_LOG the DPS records its debug messages in a RAM ring,
+ * see dbglog.h, and pushes them from the main loop when the link is idle.
+ * A frame carries up to LOG_MAX_WORDS words of whole entries. Each entry is
+ * a header word with the format string address in bits 0..27 and the number
+ * of argument words that follow in bits 28..31. <dropped> is the number of
+ * entries lost to a full ring since the previous frame. The host formats the
+ * messages with the format strings read from the firmware image.
+ *
+ *  DPS:    [cmd_log] [dropped:16] ([header:32] ([arg:32]) * nargs) *
+ *  HOST:   none
+ *
+ *
+ * === RAM stats ===
+ * Available with CONFIG_STACK_MONITOR, see stackmon.h. Returns the bytes of
+ * RAM used by .data, .bss and .ramfunc, the room left for the stack above
+ * them and the most of it used since boot.
+ *
+ *  HOST:   [cmd_ram_stats]
+ *  DPS:    [cmd_response | cmd_ram_stats] [<status>] [data:16] [bss:16] [ramfunc:16]
+ *          [stack:16] [stack_peak:16]
+ *
+ *
+ * === Scheduled commands ===
+ * Available with CONFIG_SCHEDULE. Lets a host line up commands on several
+ * units, eg. enabling the outputs of a series rig at the same moment,
+ * without the skew of sending to one unit after the other.
+ *
+ * The host first estimates the offset of each device clock to its own with
+ * a few cmd_clock_sync exchanges: with t0 and t1 the host time the request
+ * was sent and the response received, the device read <now_us> at about
+ * (t0 + t1) / 2. The exchange with the shortest round trip, through the WiFi
+ * proxy or not, gives the best estimate. <now_us> is get_time_us(), the time
+ * since boot.
+ *
+ *  HOST:   [cmd_clock_sync]
+ *  DPS:    [cmd_response | cmd_clock_sync] [<status>] [now_us:64]
+ *
+ * cmd_schedule then stores a command, formatted as a batch sub-command
+ * without the length, to be run once get_time_us() reaches <at_us>. The
+ * response tells if it was accepted and in which slot. A time that has
+ * passed, a full schedule or a command that cannot be batched fail, with the
+ * exception of cmd_batch which can be scheduled to run several commands at
+ * once. Scheduled commands run from the main loop, typically within a ms of
+ * their time. Their responses are not sent, the host reads the outcome of
+ * each with cmd_schedule_status: the slot state (see schedule_state_t), the
+ * command, its time and how many us late it ran. Slots of commands that have
+ * run are reused by later cmd_schedule requests. cmd_schedule_cancel drops
+ * all pending commands and clears the outcomes.
+ *
+ *  HOST:   [cmd_schedule] [at_us:64] [cmd] [optional_payload]*
+ *  DPS:    [cmd_response | cmd_schedule] [<status>] [slot:8]
+ *
+ *  HOST:   [cmd_schedule_status]
+ *  DPS:    [cmd_response | cmd_schedule_status] [<status>] [now_us:64]
+ *          ([slot:8] [state:8] [cmd:8] [at_us:64] [late_us:32]) *
+ *
+ *  HOST:   [cmd_schedule_cancel]
+ *  DPS:    [cmd_response | cmd_schedule_cancel] [<status>]
+ *
+ *
+ * === Capabilities ===
+ * Tells a host which optional parts of the protocol the build has, so it can
+ * use the fastest path both sides support rather than the one every firmware
+ * has. Firmware older than the command answers with a failure status, which
+ * means none of the features and the limits of the constants in this file.
+ *
+ * <features> holds the CAP_* bits of the enabled build flags. <max_frame> is
+ * MAX_FRAME_LENGTH, <max_msg> and <msg_window> the largest response sent as a
+ * message and its window (see "Messages"), <batch> BATCH_MAX_COMMANDS and
+ * <schedule> the number of cmd_schedule slots. <pipeline> is how many
+ * requests of up to CAP_REQUEST_BYTES a host may send ahead of their
+ * responses, in cmd_tagged envelopes, without overflowing the UART receive
+ * buffer. Streams take 1..<stream_samples> samples per frame at intervals
+ * down to <stream_min_ms>. The baud rates cmd_set_baudrate accepts follow,
+ * slowest first, along with the rate the link is running at.
+ *
+ *  HOST:   [cmd_capabilities]
+ *  DPS:    [cmd_response | cmd_capabilities] [<status>] [features:32] [max_frame:16]
+ *          [max_msg:16] [msg_window:8] [batch:8] [schedule:8] [pipeline:8]
+ *          [stream_samples:8] [stream_min_ms:16] [cur_baud:32] [count:8] ([baud:32]) * count
+ *
+ *
+ * === Notifications ===
+ * Available with CONFIG_NOTIFY. Instead of polling for changes the host can
+ * subscribe to the state changes of notify_event_t, whether made on the
+ * device or by a command. <mask> has bit n set for event n, 0 unsubscribes,
+ * and the response holds the events the build can notify of. There is one
+ * subscription, a new cmd_subscribe replaces it.
+ *
+ * Changes are queued as they happen and sent from the main loop, never
+ * inside the response of a command. <seq> is incremented for each
+ * notification, a gap means the queue of NOTIFY_QUEUE_SIZE was full and
+ * notifications were dropped, the host then reads the state with a query.
+ * Parameter values are signed and in the unit of cmd_get_parameters_bin.
+ * notify_regime is the timestamped form of notify_limit_mode, <value> is
+ * the unsigned cur_time_us() of the ADC sample the transition was detected
+ * in, wrapping every ~71 minutes. The detection runs on every sample with
+ * hysteresis, see pwrctl_calc_cc_regime(), the CV, CL and CHG functions
+ * report it.
+ *
+ *  HOST:   [cmd_subscribe] [mask:16]
+ *  DPS:    [cmd_response | cmd_subscribe] [<status>] [mask:16]
+ *
+ *  DPS:    [cmd_notify] [seq:8] [<notify_event_t>:8] [index:8] [value:32]
+ *  HOST:   none
+ *
+ *
+ * === Presets ===
+ * Available with CONFIG_PRESETS. A preset holds a function and the values of
+ * its parameters, there are CONFIG_PRESET_SLOTS slots kept in RAM and in
+ * past. Slots 0 and 1 are also saved with a long press and recalled with a
+ * short press of M1 and M2 while no setting is being edited.
+ *
+ * Recalling a preset of another function switches to it with the output
+ * off, as selecting a function does. Recalling one of the current function
+ * applies the values to it, the output following at once if enabled. The
+ * status is 0 for an empty or invalid slot, <param_status> the first
+ * set_param_status_t other than ps_ok of the values (read only parameters
+ * such as the charger phase are skipped).
+ *
+ *  HOST:   [cmd_save_preset] [slot:8]
+ *  DPS:    [cmd_response | cmd_save_preset] [<status>]
+ *
+ *  HOST:   [cmd_recall_preset] [slot:8]
+ *  DPS:    [cmd_response | cmd_recall_preset] [<status>] [<param_status>:8]
+ *
+ *
+ * === OCP bench ===
+ * Available with CONFIG_OCP_BENCH, see hw_ocp_bench(). Trips the OCP <runs>
+ * times with a synthetic current limit and reports the latency in CPU
+ * cycles from publishing the limit until the output has been disabled.
+ * The output must be enabled, the status is 0 otherwise or if the first
+ * run did not trip. <count> is the number of runs that tripped. Use it with
+ * the output unloaded at a safe setting, it is switched on and off <runs>
+ * times, up to OCP_BENCH_MAX_RUNS.
+ *
+ *  HOST:   [cmd_ocp_bench] [runs:8]
+ *  DPS:    [cmd_response | cmd_ocp_bench] [<status>] [clock_hz:32] [count:8]
+ *          [min:32] [max:32] [mean:32]
+ *
+ *
+ * === Ripple analysis ===
+ * Available with CONFIG_RIPPLE, see ripple.h. Analyses one channel (I_out 1,
+ * V_in 2, V_out 4) of the finished ADC recording, see "ADC recorder", and
+ * reports the peak amplitude at up to RIPPLE_MAX_BINS frequencies in Hz.
+ * <rate> is the undecimated ADC sample set rate in Hz, 0 for the nominal
+ * rate of the device. <mean>, <rms> and the amplitudes are raw ADC counts
+ * with 8 fractional bits, <min> and <max> raw samples. <dominant> indexes
+ * the largest amplitude. The status is 0 if no recording is done, the
+ * channel was not recorded or a frequency is not below half the rate of the
+ * recording.
+ *
+ *  HOST:   [cmd_ripple] [channel:8] [rate:32] [count:8] ([freq:16]) * count
+ *  DPS:    [cmd_response | cmd_ripple] [<status>] [samples:16] [min:16] [max:16]
+ *          [mean:32] [rms:32] [dominant:8] [count:8] ([amplitude:32]) * count
+ *
+ *
+ * === Lock-in measurement ===
+ * Available with CONFIG_LOCKIN, see lockin.h. Correlates I_out and V_out
+ * with the sine of the running function generator in the ADC interrupt.
+ * A request with <periods> above 0 skips <settle> generator periods and
+ * then accumulates <periods> periods, the status is 0 if the generator is
+ * not enabled or has no frequency. A request with <periods> 0 reads the
+ * measurement, <state> is 0 idle, 1 settling, 2 running and 3 done, the
+ * rest is valid once done. <freq> is the generator frequency in dHz when
+ * the measurement started. <i_dc>, <v_dc> and the signed phasors are raw
+ * ADC counts with 8 fractional bits, re in phase with the generator's sine
+ * and im a quarter period ahead. The load impedance is V / I, each scaled
+ * with its ADC calibration.
+ *
+ *  HOST:   [cmd_lockin] [settle:8] [periods:16]
+ *  DPS:    [cmd_response | cmd_lockin] [<status>]
+ *  HOST:   [cmd_lockin] [0:8] [0:16]
+ *  DPS:    [cmd_response | cmd_lockin] [<status>] [state:8] [freq:16]
+ *          [samples:32] [i_dc:32] [v_dc:32] [i_re:32] [i_im:32] [v_re:32] [v_im:32]
+ *
+ *
+ * === Addressed commands ===
+ * Built with BUS_ADDRESS=1..254 several units share one serial line, their
+ * TX pins are open drain so the line needs one pull-up (or an RS-485
+ * transceiver with automatic direction control). Such a unit only handles
+ * commands wrapped in a cmd_addressed envelope carrying its address or
+ * BUS_ADDRESS_BROADCAST, other frames are dropped by serial_handle_rx_char()
+ * as soon as their first two bytes are in. The response is wrapped in the
+ * same envelope and sent BUS_TURNAROUND_US after the request so the host has
+ * released the line. Broadcast commands are run but never answered, and a
+ * unit on a bus sends nothing on its own (cmd_ocp_event, cmd_stream_data,
+ * cmd_log, cmd_notify...), so only the unit addressed by the host ever
+ * talks. The envelope goes outside of cmd_tagged.
+ *
+ *  HOST:   [cmd_addressed] [address:8] [cmd] [optional_payload]*
+ *  DPS:    [cmd_response | cmd_addressed] [address:8] [cmd_response | cmd] [<status>] [response_data]*
+ *
+ *
+ * === Configuration snapshot ===
+ * Available with CONFIG_CLONE, see clone.h. The settings of a unit - power
+ * setting, display, presets and the settings of every function, but not its
+ * calibration - are read as one blob of <total> bytes ending with a CRC16 and
+ * written as such to other units. The blob is read in chunks of at most
+ * CONFIG_EXPORT_CHUNK bytes at <offset>, the host checks the CRC as a
+ * setting changed between two chunks makes it fail.
+ *
+ *  HOST:   [cmd_config_export] [offset:16]
+ *  DPS:    [cmd_response | cmd_config_export] [<status>] [total:16] [offset:16] [count:8] ([byte:8]) * count
+ *
+ * The host writes the blob in order from offset 0 in chunks of at most
+ * CONFIG_IMPORT_CHUNK bytes and sets CONFIG_IMPORT_COMMIT (1) in <flags> on
+ * the last one. Units are staged in flash as they come in, the commit checks
+ * the CRC and applies all of them at once, erasing the settings the blob did
+ * not have. <result> is a clone_status_t, 0 when the chunk was accepted: 1
+ * chunk not at the expected offset (ignored, the import goes on), 2 bad
+ * version, 3 unit outside of the snapshot scope, 4 CRC mismatch, 5 flash
+ * full. Other errors drop the import, which then starts over at offset 0. A
+ * reset before the commit leaves the settings untouched. After a commit the
+ * response is sent and the unit restarts with the new settings.
+ *
+ *  HOST:   [cmd_config_import] [flags:8] [offset:16] [count:8] ([byte:8]) * count
+ *  DPS:    [cmd_response | cmd_config_import] [<status>] [<result>:8]
+ *
+ *
+ * === Headless mode ===
+ * Available with CONFIG_HEADLESS, see opendps_set_headless(). With
+ * HEADLESS_ENABLE (1) in <flags> the backlight goes off and nothing is
+ * drawn until a request without it, or a press on the unit, brings the
+ * screen back. HEADLESS_STORE (2) makes the requested mode the power up
+ * mode too. A request without <flags> only reads the mode, <headless> is
+ * 1 in headless mode. cmd_set_brightness fails in headless mode.
+ *
+ *  HOST:   [cmd_headless] [flags:8]
+ *  DPS:    [cmd_response | cmd_headless] [<status>] [<headless>:8]
+ *
+ * === ADC acquisition profile ===
+ * Available with CONFIG_ADC_PROFILES, see adc_profile_t. <profile> 0 is the
+ * default ~21kHz, 1 low noise at ~5.2kHz with long sample times and 2 high
+ * speed at ~33kHz with short ones and less decimation. ADC_PROFILE_STORE (1)
+ * in <flags> selects the profile at power up too. A request without
+ * <profile> only reads it. The response carries the sample set rate of the
+ * profile and the sample sets per decimated measurement, 1 without
+ * CONFIG_ADC_OVERSAMPLE. Pass <rate> to cmd_ripple when analyzing a
+ * recording. An unknown profile fails.
+ *
+ *  HOST:   [cmd_adc_profile] [<profile>:8] [flags:8]
+ *  DPS:    [cmd_response | cmd_adc_profile] [<status>] [<profile>:8] [<rate>:32] [<decimation>:16]
+ *
+ *
+ * === ADC ISR hooks ===
+ * Returns up to ISR_HOOKS_CHUNK hook slots of isrhook.h starting at
+ * <offset> out of <total>, in the order they run: limit, V_out loop, energy,
+ * window statistics, recorder, function generator, lock-in and ADC noise.
+ * <enabled> is
+ * 1 while a hook is set, <budget> and <max> are CPU cycles, <overruns>
+ * counts the <runs> that took longer than the budget. The emulator has no
+ * cycle counter and reports 0 cycles. Setting ISR_HOOKS_RESET (1) in
+ * <flags> clears the accounting of all slots after the response has been
+ * built.
+ *
+ *  HOST:   [cmd_isr_hooks] [offset:8] [flags:8]
+ *  DPS:    [cmd_response | cmd_isr_hooks] [<status>] [total:8] [offset:8] [count:8]
+ *          ([enabled:8] [budget:16] [runs:32] [overruns:32] [max:32]) * count
+ *
+ *
+ * === Staged functions ===
+ * Available with CONFIG_FUNC_STAGING. cmd_stage_parameters keeps parameter
+ * values aside for the named function, which need not be the current one.
+ * Names and values are those of cmd_set_parameters, values in the unit of
+ * the parameter. <param_status> is ps_ok or ps_unknown_name for each value,
+ * ranges are checked when the values are applied. A request without values
+ * drops the values staged for the function. The status is 0 for an unknown
+ * function.
+ *
+ * cmd_switch_function selects the function at <index> in the list of
+ * cmd_list_functions and applies its staged values before the screen is
+ * redrawn, in one step. Selecting another function turns the output off as
+ * cmd_set_function does, staged values of the current function apply at
+ * once. The staged values are dropped once applied, <param_status> is the
+ * first set_param_status_t other than ps_ok applying them (read only
+ * parameters are skipped). The status is 0 for an invalid index or while
+ * the output is locked by temperature.
+ *
+ *  HOST:   [cmd_stage_parameters] [<function name>] \0 (<name> \0 <value> \0)*
+ *  DPS:    [cmd_response | cmd_stage_parameters] [<status>] [<param_status>:8]*
+ *
+ *  HOST:   [cmd_switch_function] [index:8]
+ *  DPS:    [cmd_response | cmd_switch_function] [<status>] [<param_status>:8]
+ */
+
+/**
+ * @def BUS_ADDRESS_BROADCAST
+ * @brief cmd_addressed address handled by every unit on the bus
+ */
+#define BUS_ADDRESS_BROADCAST (0xff)
+
+/**
+ * @def BUS_TURNAROUND_US
+ * @brief Delay between the end of a request and the addressed response
  */
+#ifndef BUS_TURNAROUND_US
+ #define BUS_TURNAROUND_US (500)
+#endif
 
 #endif // __PROTOCOL_H__
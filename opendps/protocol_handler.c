@@ -40,21 +40,206 @@
 #include "bootcom.h"
 #include "uframe.h"
 #include "opendps.h"
+#include "tick.h"
+#include "numfmt.h"
+#include "perf.h"
+#include "probe.h"
+#include "trace.h"
+#include "framepool.h"
+#include "sched.h"
+#include "isrhook.h"
+#ifdef CONFIG_CAL_LUT
+#include "cal_lut.h"
+#endif // CONFIG_CAL_LUT
+#ifdef CONFIG_ADC_RECORDER
+#include "recorder.h"
+#endif // CONFIG_ADC_RECORDER
+#ifdef CONFIG_RIPPLE
+#include "ripple.h"
+#endif // CONFIG_RIPPLE
+#ifdef CONFIG_CLONE
+#include "clone.h"
+#endif // CONFIG_CLONE
+#if defined(CONFIG_PERF) || defined(CONFIG_OCP_BENCH)
+#include <rcc.h>
+#endif // CONFIG_PERF || CONFIG_OCP_BENCH
+#ifdef CONFIG_LOAD_METER
+#include "load.h"
+#endif // CONFIG_LOAD_METER
+#ifdef CONFIG_STACK_MONITOR
+#include "stackmon.h"
+#endif // CONFIG_STACK_MONITOR
+#ifdef CONFIG_ENERGY_METER
+#include "energy.h"
+#endif // CONFIG_ENERGY_METER
+#ifdef CONFIG_WINDOW_STATS
+#include "winstats.h"
+#endif // CONFIG_WINDOW_STATS
+#ifdef CONFIG_ADC_NOISE
+#include "adcnoise.h"
+#endif // CONFIG_ADC_NOISE
+#ifdef CONFIG_DEFERRED_LOG
+#include "dbglog.h"
+#endif
 
 #ifdef DPS_EMULATOR
  extern void dps_emul_send_frame(frame_t *frame);
 #endif // DPS_EMULATOR
 
-typedef enum {
-    cmd_failed = 0,
-    cmd_success,
-    cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much,
-} command_status_t;
-
-static uint8_t frame_buffer[MAX_FRAME_LENGTH];
-static uint32_t rx_idx = 0;
+/** Received frames are unescaped and checked in place as they arrive */
+static frame_t rx_frame;
 static bool receiving_frame = false;
 
+/** Current serial link rate and time of the last valid frame, see cmd_set_baudrate */
+static uint32_t cur_baudrate = CONFIG_BAUDRATE;
+static uint64_t last_rx_frame;
+
+/** Serial link error counters, see cmd_link_stats */
+static struct {
+    uint32_t frames;
+    uint32_t crc;
+    uint32_t length;
+    uint32_t aborted;
+    uint32_t rejected;
+    uint32_t tx_dropped;
+    uint32_t timeouts;
+} link_stats;
+
+/** Rates a host may negotiate with cmd_set_baudrate */
+static const uint32_t supported_baudrates[] = { 9600, 19200, 38400, 57600, 115200 };
+
+/** Streaming telemetry state, see cmd_stream_start */
+static struct {
+    bool enabled;
+    uint16_t interval_ms;
+    uint8_t batch;
+    uint8_t count;
+    uint16_t seq;
+    uint64_t last_sample;
+    uint16_t v_out[STREAM_MAX_SAMPLES];
+    uint16_t i_out[STREAM_MAX_SAMPLES];
+} stream;
+
+/** Calibration averaging state, see cmd_cal_sweep */
+static struct {
+    bool active;
+    bool sweep;
+    bool sampling;
+    uint8_t channel;
+    uint8_t points;
+    uint8_t index;
+    uint16_t dac;
+    uint16_t step;
+    uint16_t settle_ms;
+    uint16_t samples;
+    uint64_t settle_at;
+} cal;
+
+/** Values last sent to each cmd_query_compact session */
+static struct {
+    bool valid;
+    const char *func;
+    int32_t fields[QUERY_MAX_FIELDS];
+} query_sessions[QUERY_COMPACT_SESSIONS];
+
+/** Tag of the request being handled, echoed in its response, see cmd_tagged */
+static struct {
+    bool active;
+    uint8_t tag;
+} resp_tag;
+
+#ifdef CONFIG_BUS_ADDRESS
+/** Address of the request being handled, see cmd_addressed */
+static struct {
+    bool active;
+    uint8_t address;
+    uint64_t rx_us;     /** When the request was received */
+} resp_bus;
+#endif // CONFIG_BUS_ADDRESS
+
+#ifdef CONFIG_SCHEDULE
+/** Set while a scheduled command runs, nobody waits for its response */
+static bool resp_muted;
+
+/** Commands stored by cmd_schedule, a slot is free while state is 0 */
+static struct {
+    uint8_t state;
+    uint8_t length;
+    uint8_t command[SCHEDULE_MAX_LENGTH];
+    uint64_t at_us;
+    uint32_t late_us;
+} schedule[SCHEDULE_MAX_COMMANDS];
+
+/** Due at the time of the earliest pending scheduled command */
+static sched_job_t schedule_job;
+#endif // CONFIG_SCHEDULE
+
+#ifdef CONFIG_NOTIFY
+/** Events subscribed to with cmd_subscribe, bit n for notify_event_t n */
+static uint16_t notify_mask;
+
+/** Notifications waiting for serial_tick() */
+static struct {
+    uint8_t seq;
+    uint8_t event;
+    uint8_t index;
+    int32_t value;
+} notify_queue[NOTIFY_QUEUE_SIZE];
+static uint32_t notify_read, notify_write;
+
+/** Sequence number of the next notification, also taken by dropped ones */
+static uint8_t notify_seq;
+#endif // CONFIG_NOTIFY
+
+/** Messages larger than a frame, one at a time in either direction share
+  * the buffer, see cmd_fragment. Received commands are run from a frame */
+static uint8_t msg_buffer[MSG_MAX_LENGTH];
+static umsg_t tx_msg = { .buffer = msg_buffer, .size = sizeof(msg_buffer) };
+static umsg_t rx_msg = {
+    .buffer = msg_buffer,
+    .size = sizeof(msg_buffer) < MAX_FRAME_LENGTH ? sizeof(msg_buffer) : MAX_FRAME_LENGTH
+};
+static uint8_t next_msg_id;
+
+/**
+ * @brief      Wrap a response in cmd_addressed and/or cmd_tagged envelopes
+ *
+ * @param[out] dst       The wrapped frame
+ * @param[in]  src       The response, as built by set_frame_header()..end_frame()
+ * @param[in]  envelope  The envelope bytes, [cmd_response | cmd] [value:8] each
+ * @param[in]  len       Length of envelope
+ */
+static void wrap_frame(frame_t *dst, const frame_t *src, const uint8_t *envelope, uint32_t len)
+{
+    /** Unescaped bytes between SOF and EOF, less the CRC */
+    uint32_t remaining = 0;
+    for (uint32_t i = 1; i < src->length - 1; i++) {
+        if (src->buffer[i] != _DLE) {
+            remaining++;
+        }
+    }
+    remaining -= 2;
+
+    set_frame_header(dst);
+    for (uint32_t i = 0; i < len; i++) {
+        pack8(dst, envelope[i]);
+    }
+    if (src->length + 2 * len > MAX_FRAME_LENGTH) {
+        /** The envelopes will not fit, report the command as failed */
+        pack8(dst, src->buffer[1]);
+        pack8(dst, 0);
+    } else {
+        for (uint32_t i = 1; remaining > 0; i++, remaining--) {
+            uint8_t b = src->buffer[i];
+            if (b == _DLE) {
+                b = src->buffer[++i] ^ _XOR;
+            }
+            pack8(dst, b);
+        }
+    }
+    end_frame(dst);
+}
+
 /**
   * @brief Send a frame on the uart
   * @param frame the frame to send
@@ -63,32 +248,317 @@ static bool receiving_frame = false;
   */
 static void send_frame(const frame_t *frame)
 {
+    frame_t *wrapped = NULL;
+    uint8_t envelope[4];
+    uint32_t len = 0;
+#ifdef CONFIG_SCHEDULE
+    if (resp_muted) {
+        return;
+    }
+#endif // CONFIG_SCHEDULE
+#ifdef CONFIG_BUS_ADDRESS
+    /** Only the unit addressed by the host talks on the bus */
+    if (!resp_bus.active || resp_bus.address == BUS_ADDRESS_BROADCAST) {
+        return;
+    }
+    envelope[len++] = cmd_response | cmd_addressed;
+    envelope[len++] = resp_bus.address;
+#endif // CONFIG_BUS_ADDRESS
+    if (resp_tag.active) {
+        envelope[len++] = cmd_response | cmd_tagged;
+        envelope[len++] = resp_tag.tag;
+    }
+    if (len) {
+        wrapped = frame_acquire();
+        if (!wrapped) {
+            link_stats.tx_dropped++;
+            dbg_printf("Error: no frame for wrapped response\n");
+            return;
+        }
+        wrap_frame(wrapped, frame, envelope, len);
+        frame = wrapped;
+    }
+#ifdef CONFIG_BUS_ADDRESS
+    /** Give the host time to release the line */
+    while (get_time_us() - resp_bus.rx_us < BUS_TURNAROUND_US) ;
+#endif // CONFIG_BUS_ADDRESS
 #ifdef DPS_EMULATOR
     dps_emul_send_frame(frame);
+#elif defined(CONFIG_USART_TX_IRQ)
+    /** Only waits if the previous frame is still being sent */
+    while (!hw_usart_send(frame->buffer, frame->length)) ;
 #else // DPS_EMULATOR
     for (uint32_t i = 0; i < frame->length; ++i)
         usart_send_blocking(USART1, frame->buffer[i]);
 #endif // DPS_EMULATOR
+    frame_release(wrapped);
+}
+
+void serial_send_frame(const frame_t *frame)
+{
+    send_frame(frame);
+}
+
+/**
+ * @brief      Send a frame unless the link is backed up
+ *
+ * @param[in]  frame  The frame
+ *
+ * @return     false if the frame was dropped
+ */
+static bool try_send_frame(const frame_t *frame)
+{
+#if !defined(DPS_EMULATOR) && defined(CONFIG_USART_TX_IRQ) && !defined(CONFIG_BUS_ADDRESS)
+    return hw_usart_send(frame->buffer, frame->length);
+#else
+    send_frame(frame);
+    return true;
+#endif
+}
+
+/**
+  * @brief Send the status response of a command that did not send its own
+  * @param cmd the command
+  * @param success the status returned by its handler
+  * @retval None
+  */
+static void send_response(command_t cmd, command_status_t success)
+{
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        dbg_printf("Error: no frame for response\n");
+        return;
+    }
+    protocol_create_response(frame_resp, cmd, success);
+    if (frame_resp->length > 0 && cmd != cmd_response) {
+        send_frame(frame_resp);
+    }
+    frame_release(frame_resp);
+}
+
+/**
+  * @brief Start a response that may not fit in one frame
+  * @retval umsg_t* the message to pack the response into, then call send_message()
+  */
+static umsg_t *start_message(void)
+{
+    rx_msg.active = false;
+    umsg_start(&tx_msg, next_msg_id++);
+    return &tx_msg;
+}
+
+/**
+  * @brief Send a window of fragments of the response message
+  * @param first index of the first fragment to send
+  * @retval None
+  */
+static void send_fragments(uint32_t first)
+{
+    uint32_t count = umsg_fragments(&tx_msg);
+    uint32_t last = first + MSG_WINDOW < count ? first + MSG_WINDOW : count;
+    for (uint32_t i = first; i < last; i++) {
+        frame_t *frame = frame_acquire();
+        if (!frame) {
+            /** The host asks for the rest once it times out */
+            return;
+        }
+        set_frame_header(frame);
+        pack8(frame, cmd_response | cmd_fragment);
+        umsg_pack_fragment(frame, &tx_msg, i, i == last - 1 ? UFRAME_FRAG_ACK : 0);
+        end_frame(frame);
+        send_frame(frame);
+        frame_release(frame);
+    }
+}
+
+/**
+  * @brief Send the response built with start_message(), in one frame if it
+  *        fits, else as fragments
+  * @retval command_status_t failed if the response did not fit in MSG_MAX_LENGTH
+  */
+static command_status_t send_message(void)
+{
+    if (tx_msg.overflow) {
+        tx_msg.active = false;
+        return cmd_failed;
+    }
+    /** Leave room for the escaped envelope of a tagged response */
+    if (FRAME_OVERHEAD(2) + uframe_escaped_length(tx_msg.buffer, tx_msg.length) >= MAX_FRAME_LENGTH) {
+        send_fragments(0);
+        return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+    }
+    tx_msg.active = false;
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack_bytes(frame_resp, tx_msg.buffer, tx_msg.length);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+/**
+  * @brief Read V_in, V_out and I_out
+  * @param v_in input voltage in millivolt
+  * @param v_out output voltage in millivolt
+  * @param i_out output current in milliampere
+  * @retval None
+  */
+static void get_output_values(uint16_t *v_in, uint16_t *v_out, uint16_t *i_out)
+{
+#ifdef CONFIG_ADC_OVERSAMPLE
+    uint32_t i_out_raw, v_in_raw, v_out_raw;
+    hw_get_adc_values_hires(&i_out_raw, &v_in_raw, &v_out_raw);
+    *v_in = pwrctl_calc_vin_hires(v_in_raw);
+    *v_out = pwrctl_calc_vout_hires(v_out_raw);
+    *i_out = pwrctl_calc_iout_hires(i_out_raw);
+#else // CONFIG_ADC_OVERSAMPLE
+    uint16_t i_out_raw, v_in_raw, v_out_raw;
+    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
+    *v_in = pwrctl_calc_vin(v_in_raw);
+    *v_out = pwrctl_calc_vout(v_out_raw);
+    *i_out = pwrctl_calc_iout(i_out_raw);
+#endif // CONFIG_ADC_OVERSAMPLE
+}
+
+/**
+  * @brief Append a value as a zigzag encoded varint, 7 bits per byte, LSB first
+  * @param buffer the buffer
+  * @param value the value
+  * @retval number of bytes used
+  */
+static uint32_t put_varint(uint8_t *buffer, int32_t value)
+{
+    uint32_t zz = ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+    uint32_t len = 0;
+    while (zz >= 0x80) {
+        buffer[len++] = (zz & 0x7f) | 0x80;
+        zz >>= 7;
+    }
+    buffer[len++] = zz;
+    return len;
+}
+
+/**
+  * @brief Pack the changes since the last compact query of a session,
+  *        from <session> on as in the cmd_query_compact response
+  * @param frame_resp the response being packed
+  * @param session_id the session, below QUERY_COMPACT_SESSIONS
+  * @param flags the QUERY_COMPACT_* request flags
+  * @param max_len the room for deltas, at most QUERY_COMPACT_MAX_DELTAS
+  * @retval None
+  */
+static void pack_query_compact(frame_t *frame_resp, uint8_t session_id, uint8_t flags, uint32_t max_len)
+{
+    const ui_parameter_t *params;
+    char value[16];
+    int32_t fields[QUERY_MAX_FIELDS];
+    uint8_t deltas[QUERY_COMPACT_MAX_DELTAS];
+    uint32_t num_fields, len = 0;
+    uint16_t changed = 0;
+
+    uint16_t v_in, v_out, i_out;
+    int16_t temp1 = INVALID_TEMPERATURE, temp2 = INVALID_TEMPERATURE;
+    bool temp_shutdown = 0;
+    get_output_values(&v_in, &v_out, &i_out);
+#ifdef CONFIG_THERMAL_LOCKOUT
+    opendps_get_temperature(&temp1, &temp2, &temp_shutdown);
+#endif // CONFIG_THERMAL_LOCKOUT
+    fields[query_v_in] = v_in;
+    fields[query_v_out] = v_out;
+    fields[query_i_out] = i_out;
+    fields[query_output_enabled] = pwrctl_vout_enabled();
+    fields[query_temp1] = temp1;
+    fields[query_temp2] = temp2;
+    fields[query_temp_shutdown] = temp_shutdown;
+    num_fields = query_param_0 + opendps_get_curr_function_params(&params);
+    if (num_fields > QUERY_MAX_FIELDS) {
+        num_fields = QUERY_MAX_FIELDS;
+    }
+    for (uint32_t i = query_param_0; i < num_fields; i++) {
+        fields[i] = 0;
+        if (opendps_get_curr_function_param_value(params[i - query_param_0].name, value, sizeof(value))) {
+            fields[i] = atoi(value);
+        }
+    }
+
+    /** Start over from zero for a new session, on request or when the function changed */
+    const char *func = opendps_get_curr_function_name();
+    bool reset = !query_sessions[session_id].valid || (flags & QUERY_COMPACT_FULL) || query_sessions[session_id].func != func;
+    if (reset) {
+        memset(query_sessions[session_id].fields, 0, sizeof(query_sessions[session_id].fields));
+        query_sessions[session_id].func = func;
+        query_sessions[session_id].valid = true;
+    }
+    int32_t *last = query_sessions[session_id].fields;
+    for (uint32_t i = 0; i < num_fields; i++) {
+        /** Fields that do not fit stay unsent and go out with the next query */
+        if (fields[i] != last[i] && len + 5 <= max_len) {
+            len += put_varint(&deltas[len], fields[i] - last[i]);
+            last[i] = fields[i];
+            changed |= 1 << i;
+        }
+    }
+
+    pack8(frame_resp, session_id);
+    pack8(frame_resp, reset ? QUERY_COMPACT_RESET : 0);
+    pack16(frame_resp, changed);
+    for (uint32_t i = 0; i < len; i++) {
+        pack8(frame_resp, deltas[i]);
+    }
+}
+
+/**
+  * @brief Handle a compact query command, sending the changes since the last one
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_query_compact(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, session_id, flags;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &session_id);
+    unpack8(frame, &flags);
+    if (session_id >= QUERY_COMPACT_SESSIONS) {
+        return cmd_failed;
+    }
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_query_compact);
+    pack8(frame_resp, 1);
+    pack_query_compact(frame_resp, session_id, flags, QUERY_COMPACT_MAX_DELTAS);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
 }
 
 /**
   * @brief Handle a query command
  * @retval command_status_t failed, success or "I sent my own frame"
   */
-static command_status_t handle_query(void)
+static command_status_t handle_query(frame_t *frame)
 {
+    (void) frame;
     emu_printf("%s\n", __FUNCTION__);
-    ui_parameter_t *params;
+    const ui_parameter_t *params;
     char value[16];
     uint32_t num_param = opendps_get_curr_function_params(&params);
     
     const char* curr_func = opendps_get_curr_function_name();
 
-    uint16_t i_out_raw, v_in_raw, v_out_raw;
-    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
-    uint16_t v_in = pwrctl_calc_vin(v_in_raw);
-    uint16_t v_out = pwrctl_calc_vout(v_out_raw);
-    uint16_t i_out = pwrctl_calc_iout(i_out_raw);
+    uint16_t v_in, v_out, i_out;
+    get_output_values(&v_in, &v_out, &i_out);
     uint8_t output_enabled = pwrctl_vout_enabled();  
     int16_t temp1 = INVALID_TEMPERATURE, temp2 = INVALID_TEMPERATURE;
     bool temp_shutdown = 0;
@@ -97,35 +567,39 @@ static command_status_t handle_query(void)
 #endif // CONFIG_THERMAL_LOCKOUT
 //    uint32_t len = protocol_create_query_response(frame_buffer, sizeof(frame_buffer), v_in, v_out_setting, v_out, i_out, i_limit, power_enabled);
 
-    frame_t frame;
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
 
-    set_frame_header(&frame);
-    pack8(&frame, cmd_response | cmd_query);
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_query);
 
     
-    pack8(&frame, 1); // Always success
-    pack16(&frame, v_in);
+    pack8(frame_resp, 1); // Always success
+    pack16(frame_resp, v_in);
     emu_printf("v_in = %d\n", v_in);
-    pack16(&frame, v_out);
+    pack16(frame_resp, v_out);
     emu_printf("v_out = %d\n", v_out);
-    pack16(&frame, i_out);
+    pack16(frame_resp, i_out);
     emu_printf("i_out = %d\n", i_out);
-    pack8(&frame, output_enabled);
+    pack8(frame_resp, output_enabled);
     emu_printf("output_enabled = %d\n", output_enabled);
-    pack16(&frame, temp1);
-    pack16(&frame, temp2);
-    pack8(&frame, temp_shutdown);
-    pack_cstr(&frame, curr_func);
+    pack16(frame_resp, temp1);
+    pack16(frame_resp, temp2);
+    pack8(frame_resp, temp_shutdown);
+    pack_cstr(frame_resp, curr_func);
     emu_printf("%s:\n", curr_func);
     for (uint32_t i=0; i < num_param; i++) {
         opendps_get_curr_function_param_value(params[i].name, value, sizeof(value));
         emu_printf(" %s = %s\n" , params[i].name, value);
-        pack_cstr(&frame, params[i].name);
-        pack_cstr(&frame, value);
+        pack_cstr(frame_resp, params[i].name);
+        pack_cstr(frame_resp, value);
     }
-    end_frame(&frame);
+    end_frame(frame_resp);
 
-    send_frame(&frame);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
     return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
 }
 
@@ -147,7 +621,7 @@ static command_status_t handle_set_function(frame_t *frame)
             func_name[i++] = ch;
         } while(i < sizeof(func_name) - 1 && ch && frame->length);
 
-        char *names[8];
+        const char *names[8];
         uint32_t num_funcs = opendps_get_function_names(names, 8);
         for (i = 0; i < num_funcs; i++) {
             if (strcmp(names[i], func_name) == 0) {
@@ -164,33 +638,35 @@ static command_status_t handle_set_function(frame_t *frame)
     }
     
     {
-        frame_t frame_resp;
-        set_frame_header(&frame_resp);
-        pack8(&frame_resp, cmd_response | cmd_set_function);
-        pack8(&frame_resp, success); // Always success
-        end_frame(&frame_resp);
-        send_frame(&frame_resp);
+        frame_t *frame_resp = frame_acquire();
+        if (!frame_resp) {
+            return cmd_failed;
+        }
+        set_frame_header(frame_resp);
+        pack8(frame_resp, cmd_response | cmd_set_function);
+        pack8(frame_resp, success); // Always success
+        end_frame(frame_resp);
+        send_frame(frame_resp);
+        frame_release(frame_resp);
     }
     return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
 }
 
-static command_status_t handle_list_functions(void)
+static command_status_t handle_list_functions(frame_t *frame)
 {
+    (void) frame;
     emu_printf("%s\n", __FUNCTION__);
-    char *names[OPENDPS_MAX_PARAMETERS];
+    const char *names[OPENDPS_MAX_PARAMETERS];
     uint32_t num_funcs = opendps_get_function_names(names, OPENDPS_MAX_PARAMETERS);
     emu_printf("Got %d functions\n" , num_funcs);
-    frame_t frame;
-    set_frame_header(&frame);
-    pack8(&frame, cmd_response | cmd_list_functions);
-    pack8(&frame, 1); // Always success
+    umsg_t *msg = start_message();
+    umsg_pack8(msg, cmd_response | cmd_list_functions);
+    umsg_pack8(msg, 1); // Always success
     for (uint32_t i=0; i < num_funcs; i++) {
         emu_printf(" %s\n" , names[i]);
-        pack_cstr(&frame, names[i]);
+        umsg_pack_cstr(msg, names[i]);
     }
-    end_frame(&frame);
-    send_frame(&frame);
-    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+    return send_message();
 }
 
 static command_status_t handle_set_parameters(frame_t *frame)
@@ -221,15 +697,19 @@ static command_status_t handle_set_parameters(frame_t *frame)
     }
 
     {
-        frame_t frame_resp;
-        set_frame_header(&frame_resp);
-        pack8(&frame_resp, cmd_response | cmd_set_parameters);
-        pack8(&frame_resp, 1); // Always success
+        frame_t *frame_resp = frame_acquire();
+        if (!frame_resp) {
+            return cmd_failed;
+        }
+        set_frame_header(frame_resp);
+        pack8(frame_resp, cmd_response | cmd_set_parameters);
+        pack8(frame_resp, 1); // Always success
         for (uint32_t i = 0; i < status_index; i++) {
-            pack8(&frame_resp, stats[i]);
+            pack8(frame_resp, stats[i]);
         }
-        end_frame(&frame_resp);
-        send_frame(&frame_resp);
+        end_frame(frame_resp);
+        send_frame(frame_resp);
+        frame_release(frame_resp);
     }
     return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
 }
@@ -263,42 +743,157 @@ static command_status_t handle_set_calibration(frame_t *frame)
     }
 
     {
-        frame_t frame_resp;
-        set_frame_header(&frame_resp);
-        pack8(&frame_resp, cmd_response | cmd_set_calibration);
-        pack8(&frame_resp, 1); // Always success
+        frame_t *frame_resp = frame_acquire();
+        if (!frame_resp) {
+            return cmd_failed;
+        }
+        set_frame_header(frame_resp);
+        pack8(frame_resp, cmd_response | cmd_set_calibration);
+        pack8(frame_resp, 1); // Always success
         for (uint32_t i = 0; i < status_index; i++) {
-            pack8(&frame_resp, stats[i]);
+            pack8(frame_resp, stats[i]);
         }
-        end_frame(&frame_resp);
-        send_frame(&frame_resp);
+        end_frame(frame_resp);
+        send_frame(frame_resp);
+        frame_release(frame_resp);
     }
     return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
 }
 
-static command_status_t handle_list_parameters(void)
+static command_status_t handle_list_parameters(frame_t *frame)
 {
+    (void) frame;
     emu_printf("%s\n", __FUNCTION__);
-    ui_parameter_t *params;
+    const ui_parameter_t *params;
     uint32_t num_param = opendps_get_curr_function_params(&params);
 
     const char* name = opendps_get_curr_function_name();
     emu_printf("Got %d parameters for %s\n" , num_param, name);
-    frame_t frame;
-    set_frame_header(&frame);
-    pack8(&frame, cmd_response | cmd_list_parameters);
-    pack8(&frame, 1); // Always success
+    umsg_t *msg = start_message();
+    umsg_pack8(msg, cmd_response | cmd_list_parameters);
+    umsg_pack8(msg, 1); // Always success
     /** Pack name of current function */
-    pack_cstr(&frame, name);
+    umsg_pack_cstr(msg, name);
 
     for (uint32_t i=0; i < num_param; i++) {
         emu_printf(" %s %d %d\n", params[i].name, params[i].unit, params[i].prefix);
-        pack_cstr(&frame, params[i].name);
-        pack8(&frame, params[i].unit);
-        pack8(&frame, params[i].prefix);
+        umsg_pack_cstr(msg, params[i].name);
+        umsg_pack8(msg, params[i].unit);
+        umsg_pack8(msg, params[i].prefix);
+    }
+    return send_message();
+}
+
+/**
+  * @brief Handle a set parameters command with binary values
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_set_parameters_bin(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    const ui_parameter_t *params;
+    uint32_t num_param = opendps_get_curr_function_params(&params);
+    set_param_status_t stats[OPENDPS_MAX_PARAMETERS];
+    uint32_t status_index = 0;
+    uint8_t cmd, index;
+    uint32_t value;
+    char value_str[12];
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    if (frame->length == 0 || frame->length % 5 != 0 || frame->length / 5 > OPENDPS_MAX_PARAMETERS) {
+        return cmd_failed;
+    }
+    while (frame->length) {
+        unpack8(frame, &index);
+        unpack32(frame, &value);
+        if (index >= num_param) {
+            stats[status_index++] = ps_unknown_name;
+        } else {
+            /** The screens take their values as decimal strings */
+            (void) numfmt_int(value_str, sizeof(value_str), (int32_t) value);
+            stats[status_index++] = opendps_set_parameter(params[index].name, value_str);
+        }
+    }
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_set_parameters_bin);
+    pack8(frame_resp, 1); // Always success
+    for (uint32_t i = 0; i < status_index; i++) {
+        pack8(frame_resp, stats[i]);
+    }
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+/**
+  * @brief Handle a set setpoint command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_set_setpoint(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, mask;
+    uint32_t mv, ma;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &mask);
+    unpack32(frame, &mv);
+    unpack32(frame, &ma);
+    set_param_status_t status = opendps_set_setpoint(mask, (int32_t) mv, (int32_t) ma);
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_set_setpoint);
+    pack8(frame_resp, 1); // Always success
+    pack8(frame_resp, status);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+/**
+  * @brief Handle a get parameters command with binary values
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_get_parameters_bin(frame_t *frame)
+{
+    (void) frame;
+    emu_printf("%s\n", __FUNCTION__);
+    const ui_parameter_t *params;
+    uint32_t num_param = opendps_get_curr_function_params(&params);
+    char value[12];
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
     }
-    end_frame(&frame);
-    send_frame(&frame);
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_get_parameters_bin);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, num_param);
+    for (uint32_t i = 0; i < num_param; i++) {
+        if (!opendps_get_curr_function_param_value(params[i].name, value, sizeof(value))) {
+            frame_release(frame_resp);
+            return cmd_failed;
+        }
+        pack32(frame_resp, (uint32_t) atoi(value));
+    }
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
     return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
 }
 
@@ -328,6 +923,11 @@ static command_status_t handle_set_brightness(frame_t *frame)
     unpack8(frame, &cmd);
     (void) cmd;
     unpack8(frame, &brightness_pct);
+#ifdef CONFIG_HEADLESS
+    if (opendps_headless()) {
+        return cmd_failed; /** The backlight stays off */
+    }
+#endif // CONFIG_HEADLESS
     hw_set_backlight(brightness_pct);
     return cmd_success;
 }
@@ -348,8 +948,9 @@ static command_status_t handle_temperature(frame_t *frame)
 }
 #endif // CONFIG_THERMAL_LOCKOUT
 
-static command_status_t handle_version(void)
+static command_status_t handle_version(frame_t *frame)
 {
+    (void) frame;
     emu_printf("%s\n", __FUNCTION__);
     uint32_t boot_str_len, app_str_len;
     const char *boot_git_hash = 0;
@@ -359,110 +960,405 @@ static command_status_t handle_version(void)
     boot_str_len = opendps_get_boot_git_hash(&boot_git_hash);
     app_str_len = opendps_get_app_git_hash(&app_git_hash);
 
-    frame_t frame;
-    set_frame_header(&frame);
-    pack8(&frame, cmd_response | cmd_version);
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_version);
     if (boot_str_len > 0 &&
         app_str_len > 0)
     {
-        pack8(&frame, 1);
-        pack_cstr(&frame, boot_git_hash);
-        pack_cstr(&frame, app_git_hash);
+        pack8(frame_resp, 1);
+        pack_cstr(frame_resp, boot_git_hash);
+        pack_cstr(frame_resp, app_git_hash);
     }
     else
     {
-        pack8(&frame, 0);
-        pack8(&frame, '\0'); pack8(&frame, '\0'); /** Pack two empty strings */ 
+        pack8(frame_resp, 0);
+        pack8(frame_resp, '\0'); pack8(frame_resp, '\0'); /** Pack two empty strings */ 
     }
-    end_frame(&frame);
+    end_frame(frame_resp);
 
-    send_frame(&frame);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
     return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
 }
 
+/** CAP_* bits of the optional protocol features in this build */
+static const uint32_t capabilities =
+#ifdef CONFIG_FUNCGEN_ENABLE
+    CAP_FUNCGEN |
+#endif // CONFIG_FUNCGEN_ENABLE
+#ifdef CONFIG_SEQUENCER_ENABLE
+    CAP_SEQUENCER |
+#endif // CONFIG_SEQUENCER_ENABLE
+#ifdef CONFIG_THERMAL_LOCKOUT
+    CAP_THERMAL_LOCKOUT |
+#endif // CONFIG_THERMAL_LOCKOUT
+#ifdef CONFIG_CAL_LUT
+    CAP_CAL_LUT |
+#endif // CONFIG_CAL_LUT
+#ifdef CONFIG_ADC_RECORDER
+    CAP_ADC_RECORDER |
+#endif // CONFIG_ADC_RECORDER
+#ifdef CONFIG_TRIP_SNAPSHOT
+    CAP_TRIP_SNAPSHOT |
+#endif // CONFIG_TRIP_SNAPSHOT
+#ifdef CONFIG_PERF
+    CAP_PERF |
+#endif // CONFIG_PERF
+#ifdef CONFIG_LOAD_METER
+    CAP_LOAD_METER |
+#endif // CONFIG_LOAD_METER
+#ifdef CONFIG_STACK_MONITOR
+    CAP_STACK_MONITOR |
+#endif // CONFIG_STACK_MONITOR
+#ifdef CONFIG_ENERGY_METER
+    CAP_ENERGY_METER |
+#endif // CONFIG_ENERGY_METER
+#ifdef CONFIG_WINDOW_STATS
+    CAP_WINDOW_STATS |
+#endif // CONFIG_WINDOW_STATS
+#ifdef CONFIG_DEFERRED_LOG
+    CAP_DEFERRED_LOG |
+#endif // CONFIG_DEFERRED_LOG
+#ifdef CONFIG_SCHEDULE
+    CAP_SCHEDULE |
+#endif // CONFIG_SCHEDULE
+#ifdef CONFIG_NOTIFY
+    CAP_NOTIFY |
+#endif // CONFIG_NOTIFY
+#ifdef CONFIG_PRESETS
+    CAP_PRESETS |
+#endif // CONFIG_PRESETS
+#ifdef CONFIG_OCP_BENCH
+    CAP_OCP_BENCH |
+#endif // CONFIG_OCP_BENCH
+#ifdef CONFIG_RIPPLE
+    CAP_RIPPLE |
+#endif // CONFIG_RIPPLE
+#ifdef CONFIG_LOCKIN
+    CAP_LOCKIN |
+#endif // CONFIG_LOCKIN
+#ifdef CONFIG_BUS_ADDRESS
+    CAP_BUS |
+#endif // CONFIG_BUS_ADDRESS
+#ifdef CONFIG_CLONE
+    CAP_CONFIG |
+#endif // CONFIG_CLONE
+#ifdef CONFIG_HEADLESS
+    CAP_HEADLESS |
+#endif // CONFIG_HEADLESS
+#ifdef CONFIG_ADC_PROFILES
+    CAP_ADC_PROFILE |
+#endif // CONFIG_ADC_PROFILES
+#ifdef CONFIG_FUNC_STAGING
+    CAP_FUNC_STAGING |
+#endif // CONFIG_FUNC_STAGING
+#ifdef CONFIG_ADC_NOISE
+    CAP_ADC_NOISE |
+#endif // CONFIG_ADC_NOISE
+    0;
+
 /**
-  * @brief Handle a cal report
+  * @brief Handle a capabilities command
+  * @param frame the received frame
   * @retval command_status_t failed, success or "I sent my own frame"
   */
-static command_status_t handle_cal_report(void)
+static command_status_t handle_capabilities(frame_t *frame)
 {
-    uint16_t i_out_raw, v_in_raw, v_out_raw;
-    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
+    (void) frame;
+    emu_printf("%s\n", __FUNCTION__);
+#ifdef CONFIG_USART_RX_RING
+    uint32_t rx_bytes = USART_RX_RING_SIZE;
+#else // CONFIG_USART_RX_RING
+    /** One event per received byte */
+    event_stats_t stats;
+    event_get_stats(event_src_uart, &stats);
+    uint32_t rx_bytes = stats.size;
+#endif // CONFIG_USART_RX_RING
+    uint32_t pipeline = rx_bytes / CAP_REQUEST_BYTES;
 
-    frame_t frame;
-    set_frame_header(&frame);
-    pack8(&frame, cmd_response | cmd_cal_report);
-    pack8(&frame, 1); 
-    pack16(&frame, v_out_raw);
-    pack16(&frame, v_in_raw);
-    pack16(&frame, i_out_raw);
-    pack16(&frame, DAC_DHR12R2(DAC1));
-    pack16(&frame, DAC_DHR12R1(DAC1));
-    pack_float(&frame, a_adc_k_coef);
-    pack_float(&frame, a_adc_c_coef);
-    pack_float(&frame, a_dac_k_coef);
-    pack_float(&frame, a_dac_c_coef);
-    pack_float(&frame, v_adc_k_coef);
-    pack_float(&frame, v_adc_c_coef);
-    pack_float(&frame, v_dac_k_coef);
-    pack_float(&frame, v_dac_c_coef);
-    pack_float(&frame, vin_adc_k_coef);
-    pack_float(&frame, vin_adc_c_coef);
-    end_frame(&frame);
-    send_frame(&frame);
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_capabilities);
+    pack8(frame_resp, 1);
+    pack32(frame_resp, capabilities);
+    pack16(frame_resp, MAX_FRAME_LENGTH);
+    pack16(frame_resp, MSG_MAX_LENGTH);
+    pack8(frame_resp, MSG_WINDOW);
+    pack8(frame_resp, BATCH_MAX_COMMANDS);
+#ifdef CONFIG_SCHEDULE
+    pack8(frame_resp, SCHEDULE_MAX_COMMANDS);
+#else // CONFIG_SCHEDULE
+    pack8(frame_resp, 0);
+#endif // CONFIG_SCHEDULE
+    pack8(frame_resp, pipeline < 1 ? 1 : pipeline > 255 ? 255 : pipeline);
+    pack8(frame_resp, STREAM_MAX_SAMPLES);
+    pack16(frame_resp, 1); /** Streams are sampled from the ms tick */
+    pack32(frame_resp, cur_baudrate);
+    pack8(frame_resp, sizeof(supported_baudrates) / sizeof(supported_baudrates[0]));
+    for (uint32_t i = 0; i < sizeof(supported_baudrates) / sizeof(supported_baudrates[0]); i++) {
+        pack32(frame_resp, supported_baudrates[i]);
+    }
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
     return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
 }
 
+#ifdef CONFIG_ADC_NOISE
 /**
-  * @brief  Clear and set calibration values
-  * @retval cmd_success on success else cmd_failed
+  * @brief Respond with the noise of one channel over the last full window
+  * @param flags the channel and CAL_NOISE_STOP
+  * @retval command_status_t failed or "I sent my own frame"
   */
-static command_status_t handle_clear_calibration(void)
+static command_status_t send_cal_noise(uint8_t flags)
 {
-    if (opendps_clear_calibration())
-        return cmd_success;
-    else
+    uint8_t channel = flags & ~CAL_NOISE_STOP;
+    if (channel >= adcnoise_channels) {
+        return cmd_failed;
+    }
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
         return cmd_failed;
+    }
+    adcnoise_t noise;
+    adcnoise_enable(ADCNOISE_USER_HOST, true);
+    (void) adcnoise_get(&noise);
+    if (flags & CAL_NOISE_STOP) {
+        adcnoise_enable(ADCNOISE_USER_HOST, false);
+    }
+    const adcnoise_stats_t *s = &noise.ch[channel];
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_cal_report);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, channel);
+    pack32(frame_resp, noise.windows);
+    pack16(frame_resp, noise.samples);
+    pack16(frame_resp, s->center);
+    pack16(frame_resp, s->min);
+    pack16(frame_resp, s->max);
+    pack32(frame_resp, s->mean);
+    pack32(frame_resp, s->stddev);
+    for (uint32_t i = 0; i < ADCNOISE_BINS; i++) {
+        pack16(frame_resp, s->hist[i]);
+    }
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
 }
+#endif // CONFIG_ADC_NOISE
 
 /**
-  * @brief Handle a wifi status command
-  * @param payload payload of command frame
-  * @param payload_len length of payload
- * @retval command_status_t failed, success or "I sent my own frame"
+  * @brief Handle a cal report
+  * @retval command_status_t failed, success or "I sent my own frame"
   */
-static command_status_t handle_wifi_status(frame_t *frame)
+static command_status_t handle_cal_report(frame_t *frame)
 {
-    emu_printf("%s\n", __FUNCTION__);
-    command_status_t success = cmd_failed;
-    wifi_status_t status;
-    if (protocol_unpack_wifi_status(frame, &status)) {
-        success = cmd_success;
-        opendps_update_wifi_status(status);
+    if (frame->length >= 3) {
+        /** Averaged report, the result is pushed by cal_tick() */
+        uint8_t cmd;
+        uint16_t samples;
+        start_frame_unpacking(frame);
+        unpack8(frame, &cmd);
+        (void) cmd;
+        unpack16(frame, &samples);
+        if (samples == 0 || cal.active) {
+            return cmd_failed;
+        }
+        cal.sweep = false;
+        cal.sampling = false;
+        cal.points = 1;
+        cal.index = 0;
+        cal.samples = samples;
+        cal.settle_at = get_ticks();
+        cal.active = true;
+        return cmd_success;
     }
-    return success;
+#ifdef CONFIG_ADC_NOISE
+    if (frame->length == 2) {
+        uint8_t cmd, flags;
+        start_frame_unpacking(frame);
+        unpack8(frame, &cmd);
+        (void) cmd;
+        unpack8(frame, &flags);
+        return send_cal_noise(flags);
+    }
+#endif // CONFIG_ADC_NOISE
+
+    uint16_t i_out_raw, v_in_raw, v_out_raw;
+    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_cal_report);
+    pack8(frame_resp, 1); 
+    pack16(frame_resp, v_out_raw);
+    pack16(frame_resp, v_in_raw);
+    pack16(frame_resp, i_out_raw);
+    pack16(frame_resp, DAC_DHR12R2(DAC1));
+    pack16(frame_resp, DAC_DHR12R1(DAC1));
+    pack_float(frame_resp, a_adc_k_coef);
+    pack_float(frame_resp, a_adc_c_coef);
+    pack_float(frame_resp, a_dac_k_coef);
+    pack_float(frame_resp, a_dac_c_coef);
+    pack_float(frame_resp, v_adc_k_coef);
+    pack_float(frame_resp, v_adc_c_coef);
+    pack_float(frame_resp, v_dac_k_coef);
+    pack_float(frame_resp, v_dac_c_coef);
+    pack_float(frame_resp, vin_adc_k_coef);
+    pack_float(frame_resp, vin_adc_c_coef);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
 }
 
 /**
-  * @brief Handle a lock command
-  * @param payload payload of command frame
-  * @param payload_len length of payload
- * @retval command_status_t failed, success or "I sent my own frame"
+  * @brief Set the DAC of the current sweep point and start settling
+  * @retval None
   */
-static command_status_t handle_lock(frame_t *frame)
+static void cal_set_dac(void)
 {
-    emu_printf("%s\n", __FUNCTION__);
-    command_status_t success = cmd_failed;
-    uint8_t status;
-    if (protocol_unpack_lock(frame, &status)) {
-        success = cmd_success;
-        opendps_lock(status);
+    if (cal.channel == CAL_SWEEP_V_DAC) {
+        pwrctl_set_vout_dac(cal.dac);
+    } else {
+        hw_set_current_dac(cal.dac);
     }
-    return success;
+    cal.sampling = false;
+    cal.settle_at = get_ticks() + cal.settle_ms;
 }
 
 /**
-  * @brief Handle an upgrade start command
+  * @brief Handle a cal sweep command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_cal_sweep(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, channel, points;
+    uint16_t start, step, settle_ms, samples;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &channel);
+    unpack16(frame, &start);
+    unpack16(frame, &step);
+    unpack8(frame, &points);
+    unpack16(frame, &settle_ms);
+    unpack16(frame, &samples);
+    if (points == 0) {
+        if (cal.active) {
+            hw_adc_stats_start(0);
+            cal.active = false;
+        }
+        return cmd_success;
+    }
+    if (channel > CAL_SWEEP_A_DAC || samples == 0 || cal.active || !pwrctl_vout_enabled() ||
+        start + (uint32_t) step * (points - 1) > 0xfff) {
+        return cmd_failed;
+    }
+    cal.sweep = true;
+    cal.channel = channel;
+    cal.points = points;
+    cal.index = 0;
+    cal.dac = start;
+    cal.step = step;
+    cal.settle_ms = settle_ms;
+    cal.samples = samples;
+    cal_set_dac();
+    cal.active = true;
+    return cmd_success;
+}
+
+#ifdef CONFIG_CAL_LUT
+/**
+  * @brief Handle a set calibration table command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_set_cal_lut(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, channel, count;
+    uint16_t points[2 * CAL_LUT_MAX_POINTS];
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &channel);
+    unpack8(frame, &count);
+    /** Unpacking consumes the length, what is left are the points */
+    if (count > CAL_LUT_MAX_POINTS || frame->length != count * CAL_LUT_POINT_SIZE) {
+        return cmd_failed;
+    }
+    for (uint32_t i = 0; i < 2 * count; i++) {
+        unpack16(frame, &points[i]);
+    }
+    return opendps_set_calibration_lut(channel, points, count) ? cmd_success : cmd_failed;
+}
+#endif // CONFIG_CAL_LUT
+
+/**
+  * @brief  Clear and set calibration values
+  * @retval cmd_success on success else cmd_failed
+  */
+static command_status_t handle_clear_calibration(frame_t *frame)
+{
+    (void) frame;
+    if (opendps_clear_calibration())
+        return cmd_success;
+    else
+        return cmd_failed;
+}
+
+/**
+  * @brief Handle a wifi status command
+  * @param payload payload of command frame
+  * @param payload_len length of payload
+ * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_wifi_status(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    command_status_t success = cmd_failed;
+    wifi_status_t status;
+    if (protocol_unpack_wifi_status(frame, &status)) {
+        success = cmd_success;
+        opendps_update_wifi_status(status);
+    }
+    return success;
+}
+
+/**
+  * @brief Handle a lock command
+  * @param payload payload of command frame
+  * @param payload_len length of payload
+ * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_lock(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    command_status_t success = cmd_failed;
+    uint8_t status;
+    if (protocol_unpack_lock(frame, &status)) {
+        success = cmd_success;
+        opendps_lock(status);
+    }
+    return success;
+}
+
+/**
+  * @brief Handle an upgrade start command
   * @param payload payload of command frame
   * @param payload_len length of payload
   * @retval false in case of errors, if successful the device reboots
@@ -501,115 +1397,1917 @@ static command_status_t handle_change_screen(frame_t *frame)
 }
 
 /**
-  * @brief Handle a receved frame
+  * @brief Handle a stream start command
   * @param frame the received frame
-  * @param length length of frame
-  * @retval None
+  * @retval command_status_t failed, success or "I sent my own frame"
   */
-static void handle_frame(uint8_t *data, uint32_t length)
+static command_status_t handle_stream_start(frame_t *frame)
 {
-    command_status_t success = cmd_failed;
-    command_t cmd = cmd_response;
+    emu_printf("%s\n", __FUNCTION__);
+    uint16_t interval_ms;
+    uint8_t batch;
+    if (!protocol_unpack_stream_start(frame, &interval_ms, &batch)) {
+        return cmd_failed;
+    }
+    if (interval_ms == 0 || batch == 0 || batch > STREAM_MAX_SAMPLES) {
+        return cmd_failed;
+    }
+    stream.interval_ms = interval_ms;
+    stream.batch = batch;
+    stream.count = 0;
+    stream.seq = 0;
+    stream.last_sample = get_ticks();
+    stream.enabled = true;
+    return cmd_success;
+}
 
-    frame_t frame;
+/**
+  * @brief Handle a stream stop command
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_stream_stop(frame_t *frame)
+{
+    (void) frame;
+    emu_printf("%s\n", __FUNCTION__);
+    stream.enabled = false;
+    return cmd_success;
+}
 
-    int32_t payload_len = uframe_extract_payload(&frame, data, length);
+#ifdef CONFIG_ADC_RECORDER
+/**
+  * @brief Handle a record start command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_record_start(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, channels, triggers;
+    uint16_t decimation, post_count;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &channels);
+    unpack16(frame, &decimation);
+    unpack16(frame, &post_count);
+    unpack8(frame, &triggers);
+    return recorder_arm(channels, decimation, post_count, triggers) ? cmd_success : cmd_failed;
+}
 
-    if (payload_len <= 0) {
-        dbg_printf("Frame error %ld\n", payload_len);
-    } else {
-        cmd = frame.buffer[0];
-        switch(cmd) {
-            case cmd_ping:
-                success = 1; // Response will be sent below
-                emu_printf("Got pinged\n");
-                opendps_handle_ping();
-                break;
-            case cmd_set_function:
-                success = handle_set_function(&frame);
-                break;
-            case cmd_list_functions:
-                success = handle_list_functions();
-                break;
-            case cmd_set_parameters:
-                success = handle_set_parameters(&frame);
-                break;
-            case cmd_list_parameters:
-                success = handle_list_parameters();
-                break;
-            case cmd_query:
-                success = handle_query();
-                break;
-            case cmd_wifi_status:
-                success = handle_wifi_status(&frame);
-                break;
-            case cmd_lock:
-                success = handle_lock(&frame);
-                break;
-            case cmd_upgrade_start:
-                success = handle_upgrade_start(&frame);
-                break;
-            case cmd_enable_output:
-                success = handle_enable_output(&frame);
-                break;
-#ifdef CONFIG_THERMAL_LOCKOUT
-            case cmd_temperature_report:
-                success = handle_temperature(&frame);
-                break;
-#endif // CONFIG_THERMAL_LOCKOUT
-            case cmd_version:
-                success = handle_version();
-                break;
-            case cmd_cal_report:
-                success = handle_cal_report();
-                break;
-            case cmd_set_calibration:
-                success = handle_set_calibration(&frame);
-                break;
-            case cmd_clear_calibration:
-                success = handle_clear_calibration();
-                break;
-            case cmd_change_screen:
-                success = handle_change_screen(&frame);
-                break;
-            case cmd_set_brightness:
-                success = handle_set_brightness(&frame);
-                break;
-            default:
-                emu_printf("Got unknown command %d (0x%02x)\n", cmd, cmd);
-                break;
+/**
+  * @brief Handle a record dump command, sending one chunk of the recording
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_record_dump(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    recorder_info_t info;
+    uint16_t samples[RECORDER_CHUNK];
+    uint16_t offset;
+    uint8_t cmd;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack16(frame, &offset);
+    recorder_get_info(&info);
+    uint32_t count = recorder_read(offset, samples, RECORDER_CHUNK);
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_record_dump);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, info.state);
+    pack8(frame_resp, info.channels);
+    pack16(frame_resp, info.decimation);
+    pack8(frame_resp, info.trigger);
+    pack32(frame_resp, (uint32_t) (info.trigger_time_us >> 32));
+    pack32(frame_resp, (uint32_t) info.trigger_time_us);
+    pack16(frame_resp, info.pre_count);
+    pack16(frame_resp, info.num_samples);
+    pack16(frame_resp, offset);
+    pack8(frame_resp, count);
+    /** Big endian samples packed in one go */
+    uint8_t bytes[2 * RECORDER_CHUNK];
+    for (uint32_t i = 0; i < count; i++) {
+        bytes[2 * i] = samples[i] >> 8;
+        bytes[2 * i + 1] = samples[i] & 0xff;
+    }
+    pack_bytes(frame_resp, bytes, 2 * count);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+#endif // CONFIG_ADC_RECORDER
+
+#ifdef CONFIG_TRIP_SNAPSHOT
+/**
+  * @brief Handle a trip snapshot command, sending one chunk of the snapshot
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_trip_snapshot(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    trip_snapshot_t snapshot;
+    uint8_t cmd, offset, flags;
+    uint32_t count = 0;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &offset);
+    unpack8(frame, &flags);
+    if (!hw_get_trip_snapshot(&snapshot)) {
+        memset(&snapshot, 0, sizeof(snapshot));
+    } else if (offset < TRIP_SNAPSHOT_SAMPLES) {
+        count = TRIP_SNAPSHOT_SAMPLES - offset;
+        if (count > TRIP_SNAPSHOT_CHUNK) {
+            count = TRIP_SNAPSHOT_CHUNK;
         }
     }
-    if (success != cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much) {
-        frame_t frame_resp;
-        protocol_create_response(&frame_resp, cmd, success);
-        if (frame_resp.length > 0 && cmd != cmd_response) {
-            send_frame(&frame_resp);
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_trip_snapshot);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, snapshot.trip);
+    pack32(frame_resp, snapshot.time_us);
+    pack16(frame_resp, snapshot.v_dac);
+    pack16(frame_resp, snapshot.i_dac);
+    pack8(frame_resp, TRIP_SNAPSHOT_SAMPLES);
+    pack8(frame_resp, offset);
+    pack8(frame_resp, count);
+    for (uint32_t i = 0; i < count; i++) {
+        pack16(frame_resp, snapshot.samples[offset + i][0]);
+        pack16(frame_resp, snapshot.samples[offset + i][1]);
+        pack16(frame_resp, snapshot.samples[offset + i][2]);
+    }
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    if (flags & TRIP_SNAPSHOT_CLEAR) {
+        hw_clear_trip_snapshot();
+    }
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+#endif // CONFIG_TRIP_SNAPSHOT
+
+#ifdef CONFIG_PERF
+/**
+  * @brief Handle a perf report command, sending one chunk of the probes
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_perf_report(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, offset, flags;
+    uint32_t count = 0;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &offset);
+    unpack8(frame, &flags);
+    if (offset < perf_probe_count) {
+        count = perf_probe_count - offset;
+        if (count > PERF_REPORT_CHUNK) {
+            count = PERF_REPORT_CHUNK;
         }
     }
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_perf_report);
+    pack8(frame_resp, 1);
+    pack32(frame_resp, rcc_ahb_frequency);
+    pack8(frame_resp, perf_probe_count);
+    pack8(frame_resp, offset);
+    pack8(frame_resp, count);
+    for (uint32_t i = 0; i < count; i++) {
+        perf_stats_t stats;
+        perf_get(offset + i, &stats);
+        pack32(frame_resp, stats.count);
+        pack32(frame_resp, stats.min);
+        pack32(frame_resp, stats.max);
+        pack32(frame_resp, stats.count ? (uint32_t) (stats.total / stats.count) : 0);
+    }
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    if (flags & PERF_REPORT_RESET) {
+        perf_reset();
+    }
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
 }
+#endif // CONFIG_PERF
 
 /**
-  * @brief Handle received character
-  * @param c well, the received character
-  * @retval None
+  * @brief Handle an ISR hooks command, sending one chunk of the hook slots
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
   */
-void serial_handle_rx_char(char c)
+static command_status_t handle_isr_hooks(frame_t *frame)
 {
-    uint8_t b = (uint8_t) c;
-    if (b == _SOF) {
-        receiving_frame = true;
-        rx_idx = 0;
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, offset, flags;
+    uint32_t count = 0;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &offset);
+    unpack8(frame, &flags);
+    if (offset < isrhook_count) {
+        count = isrhook_count - offset;
+        if (count > ISR_HOOKS_CHUNK) {
+            count = ISR_HOOKS_CHUNK;
+        }
     }
-    if (receiving_frame) {
-        if (rx_idx < sizeof(frame_buffer)) {
-            frame_buffer[rx_idx++] = b;
-            if (b == _EOF) {
-                handle_frame(frame_buffer, rx_idx);
-                receiving_frame = false;
-            }
-        } else {
-            dbg_printf("Error: RX buffer overflow!\n");
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_isr_hooks);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, isrhook_count);
+    pack8(frame_resp, offset);
+    pack8(frame_resp, count);
+    for (uint32_t i = 0; i < count; i++) {
+        isrhook_stats_t stats;
+        (void) isrhook_get_stats(offset + i, &stats);
+        pack8(frame_resp, stats.enabled);
+        pack16(frame_resp, stats.budget);
+        pack32(frame_resp, stats.runs);
+        pack32(frame_resp, stats.overruns);
+        pack32(frame_resp, stats.max_cycles);
+    }
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    if (flags & ISR_HOOKS_RESET) {
+        isrhook_reset_stats();
+    }
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+#ifdef CONFIG_LOAD_METER
+/**
+  * @brief Handle a load stats command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_load_stats(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    (void) frame;
+    load_stats_t stats;
+    load_get(&stats);
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_load_stats);
+    pack8(frame_resp, 1);
+    pack16(frame_resp, stats.window_ms);
+    pack16(frame_resp, stats.idle_permille);
+    pack16(frame_resp, stats.isr_permille);
+    pack16(frame_resp, stats.isr_max_us);
+    pack32(frame_resp, stats.isr_calls);
+    pack32(frame_resp, stats.overruns);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+#endif // CONFIG_LOAD_METER
+
+#ifdef CONFIG_STACK_MONITOR
+/**
+  * @brief Handle a RAM stats command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_ram_stats(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    (void) frame;
+    ram_stats_t stats;
+    stackmon_get(&stats);
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_ram_stats);
+    pack8(frame_resp, 1);
+    pack16(frame_resp, stats.data_bytes);
+    pack16(frame_resp, stats.bss_bytes);
+    pack16(frame_resp, stats.ramfunc_bytes);
+    pack16(frame_resp, stats.stack_bytes);
+    pack16(frame_resp, stats.stack_peak);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+#endif // CONFIG_STACK_MONITOR
+
+#ifdef CONFIG_ENERGY_METER
+/**
+  * @brief Handle an energy stats command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_energy_stats(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, flags;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    unpack8(frame, &flags);
+    (void) cmd;
+    energy_stats_t stats;
+    energy_get(&stats);
+    if (flags & ENERGY_RESET) {
+        energy_reset();
+    }
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_energy_stats);
+    pack8(frame_resp, 1);
+    pack32(frame_resp, stats.charge_uah);
+    pack32(frame_resp, stats.energy_uwh);
+    pack32(frame_resp, stats.runtime_ms);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+#endif // CONFIG_ENERGY_METER
+
+#ifdef CONFIG_WINDOW_STATS
+/**
+  * @brief Handle a window stats command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_window_stats(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    (void) frame;
+    winstats_t stats;
+    winstats_take(&stats);
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_window_stats);
+    pack8(frame_resp, 1);
+    pack32(frame_resp, stats.samples);
+    pack32(frame_resp, stats.window_ms);
+    for (uint32_t ch = 0; ch < winstats_channels; ch++) {
+        pack16(frame_resp, stats.min[ch]);
+        pack16(frame_resp, stats.max[ch]);
+        pack16(frame_resp, stats.mean[ch]);
+        pack32(frame_resp, stats.mean_sq[ch]);
+    }
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+#endif // CONFIG_WINDOW_STATS
+
+/**
+  * @brief Handle a boot times command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_boot_times(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    (void) frame;
+    const uint32_t *times = opendps_boot_times();
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_boot_times);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, boot_phases);
+    for (uint32_t i = 0; i < boot_phases; i++) {
+        pack32(frame_resp, times[i]);
+    }
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+/**
+  * @brief Handle an event stats command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_event_stats(frame_t *frame)
+{
+    (void) frame;
+    emu_printf("%s\n", __FUNCTION__);
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_event_stats);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, event_src_count);
+    for (uint32_t i = 0; i < event_src_count; i++) {
+        event_stats_t stats;
+        event_get_stats(i, &stats);
+        pack32(frame_resp, stats.drops);
+        pack16(frame_resp, stats.peak);
+        pack16(frame_resp, stats.size);
+    }
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+#ifdef CONFIG_HEADLESS
+/**
+  * @brief Handle a headless command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_headless(frame_t *frame)
+{
+    uint8_t cmd, flags;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    if (frame->length >= 1) {
+        unpack8(frame, &flags);
+        emu_printf("%s %d\n", __FUNCTION__, flags);
+        opendps_set_headless(flags & HEADLESS_ENABLE, flags & HEADLESS_STORE);
+    }
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_headless);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, opendps_headless());
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+#endif // CONFIG_HEADLESS
+
+#ifdef CONFIG_ADC_PROFILES
+/**
+  * @brief Handle an ADC profile command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_adc_profile(frame_t *frame)
+{
+    uint8_t cmd, profile, flags = 0;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    if (frame->length >= 1) {
+        unpack8(frame, &profile);
+        if (frame->length >= 1) {
+            unpack8(frame, &flags);
+        }
+        emu_printf("%s %d %d\n", __FUNCTION__, profile, flags);
+        if (!opendps_set_adc_profile(profile, flags & ADC_PROFILE_STORE)) {
+            return cmd_failed;
+        }
+    }
+    uint32_t rate_hz, decimation;
+    profile = hw_adc_get_profile(&rate_hz, &decimation);
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_adc_profile);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, profile);
+    pack32(frame_resp, rate_hz);
+    pack16(frame_resp, decimation);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+#endif // CONFIG_ADC_PROFILES
+
+/**
+  * @brief Handle a sched stats command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_sched_stats(frame_t *frame)
+{
+    uint8_t cmd, flags = 0;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    if (frame->length >= 1) {
+        unpack8(frame, &flags);
+    }
+    emu_printf("%s %d\n", __FUNCTION__, flags);
+    /** Count the jobs that fit, every byte of them might need escaping */
+    uint32_t count = 0;
+    uint32_t room = (MAX_FRAME_LENGTH - 16) / 2;
+    for (sched_job_t *job = sched_watched(NULL); job; job = sched_watched(job)) {
+        uint32_t size = strlen(job->name) + 1 + 17;
+        if (size > room) {
+            break;
+        }
+        room -= size;
+        count++;
+    }
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_sched_stats);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, count);
+    sched_job_t *job = sched_watched(NULL);
+    for (uint32_t i = 0; i < count; i++, job = sched_watched(job)) {
+        pack_cstr(frame_resp, job->name);
+        pack8(frame_resp, job->critical ? SCHED_JOB_CRITICAL : 0);
+        pack16(frame_resp, job->deadline_ms);
+        pack32(frame_resp, job->runs);
+        pack16(frame_resp, job->misses);
+        pack32(frame_resp, job->late_max_us);
+        pack32(frame_resp, job->run_max_us);
+    }
+    end_frame(frame_resp);
+    if (flags & SCHED_STATS_RESET) {
+        sched_reset_stats();
+    }
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+/**
+  * @brief Handle a link stats command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_link_stats(frame_t *frame)
+{
+    uint8_t cmd, flags = 0;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    if (frame->length >= 1) {
+        unpack8(frame, &flags);
+    }
+    emu_printf("%s %d\n", __FUNCTION__, flags);
+    hw_usart_errors_t errors;
+    hw_usart_get_errors(&errors, flags & LINK_STATS_RESET);
+    uint32_t event_drops = 0;
+    for (uint32_t i = 0; i < event_src_count; i++) {
+        event_stats_t stats;
+        event_get_stats(i, &stats);
+        event_drops += stats.drops;
+    }
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_link_stats);
+    pack8(frame_resp, 1);
+    pack32(frame_resp, link_stats.frames);
+    pack32(frame_resp, link_stats.crc);
+    pack32(frame_resp, link_stats.length);
+    pack32(frame_resp, link_stats.aborted);
+    pack32(frame_resp, link_stats.rejected);
+    pack32(frame_resp, link_stats.tx_dropped);
+    pack32(frame_resp, link_stats.timeouts);
+    pack32(frame_resp, errors.overrun);
+    pack32(frame_resp, errors.noise);
+    pack32(frame_resp, errors.dropped);
+    pack32(frame_resp, event_drops);
+    end_frame(frame_resp);
+    if (flags & LINK_STATS_RESET) {
+        memset(&link_stats, 0, sizeof(link_stats));
+        event_reset_stats();
+    }
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+/**
+  * @brief Switch the serial link to a new baud rate
+  * @param baudrate the new rate
+  * @retval None
+  */
+static void set_baudrate(uint32_t baudrate)
+{
+#ifndef DPS_EMULATOR
+    hw_usart_set_baudrate(baudrate);
+#endif // DPS_EMULATOR
+    cur_baudrate = baudrate;
+    last_rx_frame = get_ticks();
+}
+
+/**
+  * @brief Handle a set baud rate command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_set_baudrate(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint32_t baudrate;
+    if (!protocol_unpack_set_baudrate(frame, &baudrate)) {
+        return cmd_failed;
+    }
+    for (uint32_t i = 0; i < sizeof(supported_baudrates) / sizeof(supported_baudrates[0]); i++) {
+        if (supported_baudrates[i] == baudrate) {
+            /** Acknowledge at the current rate, the host switches once it has the response */
+            frame_t *frame_resp = frame_acquire();
+            if (!frame_resp) {
+                return cmd_failed;
+            }
+            protocol_create_response(frame_resp, cmd_set_baudrate, cmd_success);
+            send_frame(frame_resp);
+            frame_release(frame_resp);
+            set_baudrate(baudrate);
+            return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+        }
+    }
+    return cmd_failed;
+}
+
+/**
+  * @brief Send the collected stream samples
+  * @param v_in current input voltage in millivolt
+  * @retval None
+  */
+static void send_stream_frame(uint16_t v_in)
+{
+    frame_t *frame = frame_acquire();
+    if (!frame) {
+        /** Dropped like a batch the link had no room for */
+        stream.seq++;
+        stream.count = 0;
+        return;
+    }
+    set_frame_header(frame);
+    pack8(frame, cmd_stream_data);
+    pack16(frame, stream.seq++);
+    pack16(frame, stream.interval_ms);
+    pack16(frame, v_in);
+    pack8(frame, stream.count);
+    for (uint32_t i = 0; i < stream.count; i++) {
+        pack16(frame, stream.v_out[i]);
+        pack16(frame, stream.i_out[i]);
+    }
+    end_frame(frame);
+    /** Drop the batch rather than stall the main loop, the host sees the
+      * gap in the sequence number */
+    (void) try_send_frame(frame);
+    frame_release(frame);
+    stream.count = 0;
+}
+
+/**
+  * @brief Collect stream samples and push them to the host when a batch is full
+  * @retval None
+  */
+static void stream_tick(void)
+{
+    if (!stream.enabled) {
+        return;
+    }
+    uint64_t now = get_ticks();
+    if (now - stream.last_sample < stream.interval_ms) {
+        return;
+    }
+    /** Keep the sampling grid even if we were late */
+    stream.last_sample += stream.interval_ms;
+    if (now - stream.last_sample >= stream.interval_ms) {
+        stream.last_sample = now;
+    }
+
+    uint16_t i_out_raw, v_in_raw, v_out_raw;
+    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
+    stream.v_out[stream.count] = pwrctl_calc_vout(v_out_raw);
+    stream.i_out[stream.count] = pwrctl_calc_iout(i_out_raw);
+    if (++stream.count >= stream.batch) {
+        send_stream_frame(pwrctl_calc_vin(v_in_raw));
+    }
+}
+
+/**
+  * @brief Push the result of one calibration point
+  * @param status 1 for a reading, 0 if the sweep was aborted
+  * @param stats the accumulated samples, NULL when aborted
+  * @retval None
+  */
+static void send_cal_frame(uint8_t status, const adc_stats_t *stats)
+{
+    frame_t *frame = frame_acquire();
+    if (!frame) {
+        return;
+    }
+    set_frame_header(frame);
+    pack8(frame, cmd_cal_data);
+    pack8(frame, status);
+    pack8(frame, cal.index);
+    pack16(frame, DAC_DHR12R1(DAC1));
+    pack16(frame, DAC_DHR12R2(DAC1));
+    pack16(frame, stats ? stats->count : 0);
+    if (stats && stats->count) {
+        /** V_out, V_in, I_out from the I_out, V_in, V_out order of the ISR */
+        for (int32_t ch = 2; ch >= 0; ch--) {
+            uint64_t n = stats->count;
+            uint64_t sum = stats->sum[ch];
+            /** n * sum_sq >= sum^2 so the difference cannot wrap */
+            uint64_t var = ((n * stats->sum_sq[ch] - sum * sum) / n << 8) / n;
+            pack32(frame, (uint32_t) ((sum << 16) / n));
+            pack32(frame, (uint32_t) var);
+        }
+    }
+    end_frame(frame);
+    send_frame(frame);
+    frame_release(frame);
+}
+
+/**
+  * @brief Step the calibration sweep and push the readings
+  * @retval None
+  */
+static void cal_tick(void)
+{
+    if (!cal.active) {
+        return;
+    }
+    if (cal.sweep && !pwrctl_vout_enabled()) {
+        hw_adc_stats_start(0);
+        cal.active = false;
+        send_cal_frame(0, NULL);
+        return;
+    }
+    if (!cal.sampling) {
+        if (get_ticks() >= cal.settle_at) {
+            hw_adc_stats_start(cal.samples);
+            cal.sampling = true;
+        }
+        return;
+    }
+    adc_stats_t stats;
+    if (!hw_adc_stats_get(&stats)) {
+        return;
+    }
+    send_cal_frame(1, &stats);
+    if (++cal.index >= cal.points) {
+        cal.active = false;
+    } else {
+        cal.dac += cal.step;
+        cal_set_dac();
+    }
+}
+
+/**
+  * @brief Run time based serial protocol tasks
+  * @retval None
+  */
+#ifdef CONFIG_DEFERRED_LOG
+/**
+  * @brief Push pending debug log entries to the host, one frame per call
+  * @retval None
+  */
+static void log_tick(void)
+{
+    uint32_t words[LOG_MAX_WORDS];
+#if !defined(DPS_EMULATOR) && defined(CONFIG_USART_TX_IRQ)
+    /** Leave the entries in the ring until a whole frame can be queued */
+    if (hw_usart_tx_free() < MAX_FRAME_LENGTH) {
+        return;
+    }
+#endif
+    frame_t *frame = frame_acquire();
+    if (!frame) {
+        return;
+    }
+    uint32_t count = dbglog_read(words, LOG_MAX_WORDS);
+    uint32_t dropped = dbglog_take_dropped();
+    if (count || dropped) {
+        set_frame_header(frame);
+        pack8(frame, cmd_log);
+        pack16(frame, dropped > 0xffff ? 0xffff : dropped);
+        for (uint32_t i = 0; i < count; i++) {
+            pack32(frame, words[i]);
+        }
+        end_frame(frame);
+        (void) try_send_frame(frame);
+    }
+    frame_release(frame);
+}
+#endif // CONFIG_DEFERRED_LOG
+
+#ifdef CONFIG_NOTIFY
+bool serial_notify_wanted(notify_event_t event)
+{
+    return notify_mask & (1 << event);
+}
+
+void serial_notify(notify_event_t event, uint8_t index, int32_t value)
+{
+    if (!serial_notify_wanted(event)) {
+        return;
+    }
+    if (notify_write - notify_read == NOTIFY_QUEUE_SIZE) {
+        /** The gap in the sequence numbers tells the host */
+        notify_seq++;
+        return;
+    }
+    uint32_t slot = notify_write++ % NOTIFY_QUEUE_SIZE;
+    notify_queue[slot].seq = notify_seq++;
+    notify_queue[slot].event = event;
+    notify_queue[slot].index = index;
+    notify_queue[slot].value = value;
+}
+
+/**
+  * @brief Send the queued notifications the link has room for
+  * @retval None
+  */
+static void notify_tick(void)
+{
+    while (notify_read != notify_write) {
+        frame_t *frame = frame_acquire();
+        if (!frame) {
+            return;
+        }
+        uint32_t slot = notify_read % NOTIFY_QUEUE_SIZE;
+        set_frame_header(frame);
+        pack8(frame, cmd_notify);
+        pack8(frame, notify_queue[slot].seq);
+        pack8(frame, notify_queue[slot].event);
+        pack8(frame, notify_queue[slot].index);
+        pack32(frame, (uint32_t) notify_queue[slot].value);
+        end_frame(frame);
+        bool sent = try_send_frame(frame);
+        frame_release(frame);
+        if (!sent) {
+            return; /** Sent once the link has caught up */
+        }
+        notify_read++;
+    }
+}
+
+/**
+  * @brief Handle a subscribe command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_subscribe(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd;
+    uint16_t mask;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack16(frame, &mask);
+    notify_mask = mask & ((1 << notify_events) - 1);
+    /** Nothing queued for the previous subscription is sent */
+    notify_read = notify_write;
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_subscribe);
+    pack8(frame_resp, 1);
+    pack16(frame_resp, notify_mask);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+#endif // CONFIG_NOTIFY
+
+#ifdef CONFIG_PRESETS
+/**
+  * @brief Handle a save preset command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_save_preset(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, slot;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &slot);
+    return opendps_save_preset(slot) ? cmd_success : cmd_failed;
+}
+
+/**
+  * @brief Handle a recall preset command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_recall_preset(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, slot;
+    set_param_status_t status = ps_ok;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &slot);
+    if (!opendps_recall_preset(slot, &status)) {
+        return cmd_failed;
+    }
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_recall_preset);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, status);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+#endif // CONFIG_PRESETS
+
+#ifdef CONFIG_FUNC_STAGING
+/**
+  * @brief Handle a stage parameters command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_stage_parameters(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    set_param_status_t stats[OPENDPS_MAX_PARAMETERS];
+    uint32_t status_index = 0;
+    uint32_t func_index;
+    uint8_t cmd;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    /** Every string has to be terminated within the frame */
+    const char *strings[1 + 2 * OPENDPS_MAX_PARAMETERS];
+    uint32_t num_strings = 0;
+    while (frame->length) {
+        const char *str = (const char*) &frame->buffer[frame->unpack_pos];
+        uint32_t len = 0;
+        while (len < frame->length && str[len]) {
+            len++;
+        }
+        if (len == frame->length || num_strings == sizeof(strings) / sizeof(strings[0])) {
+            return cmd_failed;
+        }
+        strings[num_strings++] = str;
+        frame->unpack_pos += len + 1;
+        frame->length -= len + 1;
+    }
+    if (num_strings % 2 != 1) {
+        return cmd_failed;
+    }
+    bool found = opendps_find_function(strings[0], &func_index);
+    if (found && num_strings == 1) {
+        opendps_unstage(func_index);
+    }
+    for (uint32_t i = 1; found && i < num_strings; i += 2) {
+        stats[status_index++] = opendps_stage_parameter(func_index, strings[i], atoi(strings[i + 1]));
+    }
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_stage_parameters);
+    pack8(frame_resp, found);
+    for (uint32_t i = 0; i < status_index; i++) {
+        pack8(frame_resp, stats[i]);
+    }
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+/**
+  * @brief Handle a switch function command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_switch_function(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, index;
+    set_param_status_t status = ps_ok;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &index);
+    if (!opendps_switch_function(index, &status)) {
+        return cmd_failed;
+    }
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_switch_function);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, status);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+#endif // CONFIG_FUNC_STAGING
+
+#ifdef CONFIG_OCP_BENCH
+/**
+  * @brief Handle an OCP bench command, tripping the OCP and timing it
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_ocp_bench(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, runs;
+    perf_stats_t stats;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &runs);
+    if (runs == 0 || runs > OCP_BENCH_MAX_RUNS || !hw_ocp_bench(runs, &stats)) {
+        return cmd_failed;
+    }
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_ocp_bench);
+    pack8(frame_resp, 1);
+    pack32(frame_resp, rcc_ahb_frequency);
+    pack8(frame_resp, stats.count);
+    pack32(frame_resp, stats.min);
+    pack32(frame_resp, stats.max);
+    pack32(frame_resp, (uint32_t) (stats.total / stats.count));
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+#endif // CONFIG_OCP_BENCH
+
+#ifdef CONFIG_RIPPLE
+/**
+  * @brief Handle a ripple command, analysing a channel of the recording
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_ripple(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, channel, count;
+    uint32_t rate_hz;
+    uint16_t freq_hz[RIPPLE_MAX_BINS];
+    ripple_result_t result;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &channel);
+    unpack32(frame, &rate_hz);
+    unpack8(frame, &count);
+    /** Unpacking consumes the length, what is left are the frequencies */
+    if (count > RIPPLE_MAX_BINS || frame->length != 2 * count) {
+        return cmd_failed;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        unpack16(frame, &freq_hz[i]);
+    }
+    if (!ripple_analyze(channel, rate_hz, freq_hz, count, &result)) {
+        return cmd_failed;
+    }
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_ripple);
+    pack8(frame_resp, 1);
+    pack16(frame_resp, result.num_samples);
+    pack16(frame_resp, result.min);
+    pack16(frame_resp, result.max);
+    pack32(frame_resp, result.mean);
+    pack32(frame_resp, result.rms);
+    pack8(frame_resp, result.dominant);
+    pack8(frame_resp, count);
+    for (uint32_t i = 0; i < count; i++) {
+        pack32(frame_resp, result.amplitude[i]);
+    }
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+#endif // CONFIG_RIPPLE
+
+#ifdef CONFIG_CLONE
+/**
+  * @brief Handle a config export command, sending one chunk of the snapshot
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_config_export(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t data[CONFIG_EXPORT_CHUNK];
+    uint16_t offset;
+    uint32_t total;
+    uint8_t cmd;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack16(frame, &offset);
+    uint32_t count = opendps_config_export(offset, data, sizeof(data), &total);
+    if (total > 0xffff) {
+        return cmd_failed;
+    }
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_config_export);
+    pack8(frame_resp, 1);
+    pack16(frame_resp, total);
+    pack16(frame_resp, offset);
+    pack8(frame_resp, count);
+    pack_bytes(frame_resp, data, count);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+/**
+  * @brief Handle a config import command, restarting once a snapshot is
+  *        committed
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_config_import(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t data[CONFIG_IMPORT_CHUNK];
+    uint8_t cmd, flags, count;
+    uint16_t offset;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &flags);
+    unpack16(frame, &offset);
+    unpack8(frame, &count);
+    /** Unpacking consumes the length, what is left is the data */
+    if (count > CONFIG_IMPORT_CHUNK || frame->length != count) {
+        return cmd_failed;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        unpack8(frame, &data[i]);
+    }
+    bool commit = flags & CONFIG_IMPORT_COMMIT;
+    clone_status_t result = opendps_config_import(offset, data, count, commit);
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_config_import);
+    pack8(frame_resp, result == clone_ok);
+    pack8(frame_resp, result);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    if (commit && result == clone_ok) {
+        /** The functions read their settings from past at boot */
+        opendps_restart();
+    }
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+#endif // CONFIG_CLONE
+
+void serial_tick(void)
+{
+    /** A streaming or sweeping host does not send anything, so do not time it out */
+    if (cur_baudrate != CONFIG_BAUDRATE && !stream.enabled && !cal.active &&
+        get_ticks() - last_rx_frame > SERIAL_BAUD_TIMEOUT_MS) {
+        link_stats.timeouts++;
+        set_baudrate(CONFIG_BAUDRATE);
+    }
+    stream_tick();
+    cal_tick();
+#ifdef CONFIG_NOTIFY
+    notify_tick();
+#endif // CONFIG_NOTIFY
+#ifdef CONFIG_DEFERRED_LOG
+    log_tick();
+#endif // CONFIG_DEFERRED_LOG
+}
+
+static command_status_t handle_command(frame_t *frame);
+static const command_entry_t *find_command(uint8_t cmd);
+
+/**
+  * @brief Handle a batch command, running the sub-commands in order
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_batch(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t status[BATCH_MAX_COMMANDS];
+    uint8_t cmd, count, done;
+    uint32_t pos, left;
+    bool ok = true;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    if (!unpack8(frame, &count) || count == 0 || count > BATCH_MAX_COMMANDS) {
+        return cmd_failed;
+    }
+
+    /** Check every sub-command before running any, a bad batch changes nothing */
+    pos = frame->unpack_pos;
+    left = frame->length;
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t len = left ? frame->buffer[pos] : 0;
+        if (len == 0 || len >= left) {
+            return cmd_failed;
+        }
+        const command_entry_t *entry = find_command(frame->buffer[pos + 1]);
+        if (!entry || entry->flags & CMD_FLAG_NO_BATCH) {
+            return cmd_failed;
+        }
+        pos += 1 + len;
+        left -= 1 + len;
+    }
+    if (left) {
+        return cmd_failed;
+    }
+
+    /** Stop at the first failing sub-command */
+    frame_t *sub = frame_acquire();
+    if (!sub) {
+        return cmd_failed;
+    }
+    pos = frame->unpack_pos;
+    for (done = 0; done < count && ok; done++) {
+        uint8_t len = frame->buffer[pos++];
+        memcpy(sub->buffer, &frame->buffer[pos], len);
+        sub->length = len;
+        sub->unpack_pos = 0;
+        pos += len;
+        status[done] = handle_command(sub) != cmd_failed;
+        ok = status[done];
+    }
+    frame_release(sub);
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_batch);
+    pack8(frame_resp, ok);
+    pack8(frame_resp, done);
+    for (uint32_t i = 0; i < done; i++) {
+        pack8(frame_resp, status[i]);
+    }
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+#ifdef CONFIG_SCHEDULE
+/**
+  * @brief Handle a clock sync command, sending the device time
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_clock_sync(frame_t *frame)
+{
+    (void) frame;
+    /** Read the clock first, building the response must not add to the round trip */
+    uint64_t now = get_time_us();
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_clock_sync);
+    pack8(frame_resp, 1);
+    pack32(frame_resp, (uint32_t) (now >> 32));
+    pack32(frame_resp, (uint32_t) now);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+/**
+  * @brief Run the scheduled commands that are due and rearm the job for
+  *        the next one
+  * @retval None
+  */
+static void schedule_run(void)
+{
+    uint64_t now = get_time_us();
+    uint64_t next = UINT64_MAX;
+    frame_t *sub = NULL;
+    for (uint32_t i = 0; i < SCHEDULE_MAX_COMMANDS; i++) {
+        if (schedule[i].state != schedule_pending) {
+            continue;
+        }
+        if (schedule[i].at_us > now) {
+            next = schedule[i].at_us < next ? schedule[i].at_us : next;
+            continue;
+        }
+        if (!sub && !(sub = frame_acquire())) {
+            /** Try again on the next pass of the main loop */
+            next = now;
+            break;
+        }
+        uint64_t late = now - schedule[i].at_us;
+        schedule[i].late_us = late > UINT32_MAX ? UINT32_MAX : (uint32_t) late;
+        memcpy(sub->buffer, schedule[i].command, schedule[i].length);
+        sub->length = schedule[i].length;
+        sub->unpack_pos = 0;
+        resp_muted = true;
+        schedule[i].state = handle_command(sub) != cmd_failed ? schedule_done : schedule_failed;
+        resp_muted = false;
+        now = get_time_us();
+    }
+    frame_release(sub);
+    if (next != UINT64_MAX) {
+        sched_start_at(&schedule_job, &schedule_run, next, 0);
+    }
+}
+
+/**
+  * @brief Handle a schedule command, storing a command to run later
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_schedule(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd;
+    uint32_t at_hi, at_lo;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack32(frame, &at_hi);
+    unpack32(frame, &at_lo);
+    uint64_t at_us = (uint64_t) at_hi << 32 | at_lo;
+    /** Unpacking consumes the length, what is left is the command */
+    uint32_t length = frame->length;
+    uint8_t *command = &frame->buffer[frame->unpack_pos];
+
+    const command_entry_t *entry = length ? find_command(command[0]) : NULL;
+    if (!entry || (entry->flags & CMD_FLAG_NO_BATCH && entry->cmd != cmd_batch)) {
+        return cmd_failed;
+    }
+    if (length < entry->min_length || length > SCHEDULE_MAX_LENGTH || at_us <= get_time_us()) {
+        return cmd_failed;
+    }
+    uint32_t slot = SCHEDULE_MAX_COMMANDS;
+    for (uint32_t i = 0; i < SCHEDULE_MAX_COMMANDS; i++) {
+        if (schedule[i].state != schedule_pending) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == SCHEDULE_MAX_COMMANDS) {
+        return cmd_failed;
+    }
+    schedule[slot].state = schedule_pending;
+    schedule[slot].length = length;
+    memcpy(schedule[slot].command, command, length);
+    schedule[slot].at_us = at_us;
+    schedule[slot].late_us = 0;
+    if (!sched_active(&schedule_job) || at_us < schedule_job.due) {
+        sched_start_at(&schedule_job, &schedule_run, at_us, 0);
+    }
+
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_schedule);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, slot);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+/**
+  * @brief Handle a schedule status command, listing the used slots
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_schedule_status(frame_t *frame)
+{
+    (void) frame;
+    uint64_t now = get_time_us();
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_schedule_status);
+    pack8(frame_resp, 1);
+    pack32(frame_resp, (uint32_t) (now >> 32));
+    pack32(frame_resp, (uint32_t) now);
+    for (uint32_t i = 0; i < SCHEDULE_MAX_COMMANDS; i++) {
+        if (schedule[i].state) {
+            pack8(frame_resp, i);
+            pack8(frame_resp, schedule[i].state);
+            pack8(frame_resp, schedule[i].command[0]);
+            pack32(frame_resp, (uint32_t) (schedule[i].at_us >> 32));
+            pack32(frame_resp, (uint32_t) schedule[i].at_us);
+            pack32(frame_resp, schedule[i].late_us);
+        }
+    }
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+/**
+  * @brief Handle a schedule cancel command, freeing all slots
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_schedule_cancel(frame_t *frame)
+{
+    (void) frame;
+    emu_printf("%s\n", __FUNCTION__);
+    sched_cancel(&schedule_job);
+    memset(schedule, 0, sizeof(schedule));
+    return cmd_success;
+}
+#endif // CONFIG_SCHEDULE
+
+/**
+  * @brief Handle an acknowledgement of the fragments of a response message
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_fragment_ack(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd, id, next;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &id);
+    unpack8(frame, &next);
+    if (!umsg_ack(&tx_msg, id, next)) {
+        return cmd_failed;
+    }
+    if (next == umsg_fragments(&tx_msg)) {
+        return cmd_success;
+    }
+    send_fragments(next);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+/**
+  * @brief Run a command received as a message
+  * @retval None
+  */
+static void handle_message(void)
+{
+    command_t cmd = rx_msg.length ? rx_msg.buffer[0] : cmd_response;
+    command_status_t success = cmd_failed;
+    rx_msg.active = false;
+    frame_t *sub = frame_acquire();
+    if (sub && cmd != cmd_fragment && cmd != cmd_fragment_ack) {
+        memcpy(sub->buffer, rx_msg.buffer, rx_msg.length);
+        sub->length = rx_msg.length;
+        sub->unpack_pos = 0;
+        success = handle_command(sub);
+    }
+    frame_release(sub);
+    if (success != cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much) {
+        send_response(cmd, success);
+    }
+}
+
+/**
+  * @brief Handle a fragment of a command message
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_fragment(frame_t *frame)
+{
+    emu_printf("%s\n", __FUNCTION__);
+    uint8_t cmd;
+    bool ack = frame->buffer[3] & UFRAME_FRAG_ACK;
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    /** The host is done with any response message */
+    tx_msg.active = false;
+    int32_t status = umsg_receive_fragment(&rx_msg, frame);
+    if (status < 0) {
+        /** Only fragments asking for an ack are answered */
+        return ack ? cmd_failed : cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+    }
+    if (status == UMSG_COMPLETE) {
+        handle_message();
+    } else if (status == UMSG_ACK) {
+        frame_t *frame_resp = frame_acquire();
+        if (!frame_resp) {
+            return cmd_failed;
+        }
+        set_frame_header(frame_resp);
+        pack8(frame_resp, cmd_response | cmd_fragment_ack);
+        pack8(frame_resp, rx_msg.id);
+        pack8(frame_resp, rx_msg.next);
+        end_frame(frame_resp);
+        send_frame(frame_resp);
+        frame_release(frame_resp);
+    }
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+/**
+  * @brief Handle a ping command
+  * @param frame the received frame
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_ping(frame_t *frame)
+{
+    emu_printf("Got pinged\n");
+    uint8_t cmd, version, session_id, flags;
+    if (frame->length == 1) {
+        opendps_handle_ping();
+        return cmd_success;
+    }
+    /** A heartbeat, answered with the status and the changed measurements */
+    if (frame->length != 4) {
+        return cmd_failed;
+    }
+    start_frame_unpacking(frame);
+    unpack8(frame, &cmd);
+    (void) cmd;
+    unpack8(frame, &version);
+    unpack8(frame, &session_id);
+    unpack8(frame, &flags);
+    if (version == 0 || session_id >= QUERY_COMPACT_SESSIONS) {
+        return cmd_failed;
+    }
+
+    uint16_t seq;
+    uint16_t status = opendps_get_status(&seq);
+    frame_t *frame_resp = frame_acquire();
+    if (!frame_resp) {
+        return cmd_failed;
+    }
+    set_frame_header(frame_resp);
+    pack8(frame_resp, cmd_response | cmd_ping);
+    pack8(frame_resp, 1);
+    pack8(frame_resp, PING_VERSION);
+    pack16(frame_resp, status);
+    pack16(frame_resp, seq);
+    /** The version, status and seq take room from the deltas */
+    pack_query_compact(frame_resp, session_id, flags, QUERY_COMPACT_MAX_DELTAS - 5);
+    end_frame(frame_resp);
+    send_frame(frame_resp);
+    frame_release(frame_resp);
+    return cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much;
+}
+
+/** Built in commands, indexed by command id */
+static const command_entry_t command_table[] = {
+    [cmd_ping] = { .cmd = cmd_ping, .min_length = 1, .handler = &handle_ping },
+    [cmd_query] = { .cmd = cmd_query, .min_length = 1, .handler = &handle_query },
+    [cmd_wifi_status] = { .cmd = cmd_wifi_status, .min_length = 2, .handler = &handle_wifi_status },
+    [cmd_lock] = { .cmd = cmd_lock, .min_length = 2, .handler = &handle_lock },
+    [cmd_upgrade_start] = { .cmd = cmd_upgrade_start, .min_length = 5, .flags = CMD_FLAG_NO_BATCH, .handler = &handle_upgrade_start },
+    [cmd_set_function] = { .cmd = cmd_set_function, .min_length = 2, .handler = &handle_set_function },
+    [cmd_enable_output] = { .cmd = cmd_enable_output, .min_length = 2, .handler = &handle_enable_output },
+    [cmd_list_functions] = { .cmd = cmd_list_functions, .min_length = 1, .handler = &handle_list_functions },
+    [cmd_set_parameters] = { .cmd = cmd_set_parameters, .min_length = 2, .handler = &handle_set_parameters },
+    [cmd_list_parameters] = { .cmd = cmd_list_parameters, .min_length = 1, .handler = &handle_list_parameters },
+#ifdef CONFIG_THERMAL_LOCKOUT
+    [cmd_temperature_report] = { .cmd = cmd_temperature_report, .min_length = 5, .handler = &handle_temperature },
+#endif // CONFIG_THERMAL_LOCKOUT
+    [cmd_version] = { .cmd = cmd_version, .min_length = 1, .handler = &handle_version },
+    [cmd_cal_report] = { .cmd = cmd_cal_report, .min_length = 1, .handler = &handle_cal_report },
+    [cmd_cal_sweep] = { .cmd = cmd_cal_sweep, .min_length = 11, .handler = &handle_cal_sweep },
+#ifdef CONFIG_CAL_LUT
+    [cmd_set_cal_lut] = { .cmd = cmd_set_cal_lut, .min_length = 3, .handler = &handle_set_cal_lut },
+#endif // CONFIG_CAL_LUT
+    [cmd_set_calibration] = { .cmd = cmd_set_calibration, .min_length = 2, .handler = &handle_set_calibration },
+    [cmd_clear_calibration] = { .cmd = cmd_clear_calibration, .min_length = 1, .handler = &handle_clear_calibration },
+    [cmd_change_screen] = { .cmd = cmd_change_screen, .min_length = 2, .handler = &handle_change_screen },
+    [cmd_set_brightness] = { .cmd = cmd_set_brightness, .min_length = 2, .handler = &handle_set_brightness },
+    [cmd_stream_start] = { .cmd = cmd_stream_start, .min_length = 4, .handler = &handle_stream_start },
+    [cmd_stream_stop] = { .cmd = cmd_stream_stop, .min_length = 1, .handler = &handle_stream_stop },
+    [cmd_set_baudrate] = { .cmd = cmd_set_baudrate, .min_length = 5, .flags = CMD_FLAG_NO_BATCH, .handler = &handle_set_baudrate },
+    [cmd_batch] = { .cmd = cmd_batch, .min_length = 2, .flags = CMD_FLAG_NO_BATCH, .handler = &handle_batch },
+    [cmd_set_parameters_bin] = { .cmd = cmd_set_parameters_bin, .min_length = 6, .handler = &handle_set_parameters_bin },
+    [cmd_get_parameters_bin] = { .cmd = cmd_get_parameters_bin, .min_length = 1, .handler = &handle_get_parameters_bin },
+    [cmd_query_compact] = { .cmd = cmd_query_compact, .min_length = 3, .handler = &handle_query_compact },
+#ifdef CONFIG_ADC_RECORDER
+    [cmd_record_start] = { .cmd = cmd_record_start, .min_length = 7, .handler = &handle_record_start },
+    [cmd_record_dump] = { .cmd = cmd_record_dump, .min_length = 3, .handler = &handle_record_dump },
+#endif // CONFIG_ADC_RECORDER
+#ifdef CONFIG_TRIP_SNAPSHOT
+    [cmd_trip_snapshot] = { .cmd = cmd_trip_snapshot, .min_length = 3, .handler = &handle_trip_snapshot },
+#endif // CONFIG_TRIP_SNAPSHOT
+    [cmd_event_stats] = { .cmd = cmd_event_stats, .min_length = 1, .handler = &handle_event_stats },
+    [cmd_link_stats] = { .cmd = cmd_link_stats, .min_length = 1, .handler = &handle_link_stats },
+    [cmd_sched_stats] = { .cmd = cmd_sched_stats, .min_length = 1, .handler = &handle_sched_stats },
+#ifdef CONFIG_HEADLESS
+    [cmd_headless] = { .cmd = cmd_headless, .min_length = 1, .handler = &handle_headless },
+#endif // CONFIG_HEADLESS
+#ifdef CONFIG_ADC_PROFILES
+    [cmd_adc_profile] = { .cmd = cmd_adc_profile, .min_length = 1, .handler = &handle_adc_profile },
+#endif // CONFIG_ADC_PROFILES
+    [cmd_isr_hooks] = { .cmd = cmd_isr_hooks, .min_length = 3, .handler = &handle_isr_hooks },
+#ifdef CONFIG_PERF
+    [cmd_perf_report] = { .cmd = cmd_perf_report, .min_length = 3, .handler = &handle_perf_report },
+#endif // CONFIG_PERF
+#ifdef CONFIG_LOAD_METER
+    [cmd_load_stats] = { .cmd = cmd_load_stats, .min_length = 1, .handler = &handle_load_stats },
+#endif // CONFIG_LOAD_METER
+    [cmd_set_setpoint] = { .cmd = cmd_set_setpoint, .min_length = 10, .handler = &handle_set_setpoint },
+#ifdef CONFIG_ENERGY_METER
+    [cmd_energy_stats] = { .cmd = cmd_energy_stats, .min_length = 2, .handler = &handle_energy_stats },
+#endif // CONFIG_ENERGY_METER
+#ifdef CONFIG_WINDOW_STATS
+    [cmd_window_stats] = { .cmd = cmd_window_stats, .min_length = 1, .handler = &handle_window_stats },
+#endif // CONFIG_WINDOW_STATS
+    [cmd_boot_times] = { .cmd = cmd_boot_times, .min_length = 1, .handler = &handle_boot_times },
+    [cmd_fragment] = { .cmd = cmd_fragment, .min_length = 6, .flags = CMD_FLAG_NO_BATCH, .handler = &handle_fragment },
+    [cmd_fragment_ack] = { .cmd = cmd_fragment_ack, .min_length = 3, .flags = CMD_FLAG_NO_BATCH, .handler = &handle_fragment_ack },
+#ifdef CONFIG_STACK_MONITOR
+    [cmd_ram_stats] = { .cmd = cmd_ram_stats, .min_length = 1, .handler = &handle_ram_stats },
+#endif // CONFIG_STACK_MONITOR
+#ifdef CONFIG_SCHEDULE
+    [cmd_clock_sync] = { .cmd = cmd_clock_sync, .min_length = 1, .handler = &handle_clock_sync },
+    [cmd_schedule] = { .cmd = cmd_schedule, .min_length = 10, .flags = CMD_FLAG_NO_BATCH, .handler = &handle_schedule },
+    [cmd_schedule_status] = { .cmd = cmd_schedule_status, .min_length = 1, .handler = &handle_schedule_status },
+    [cmd_schedule_cancel] = { .cmd = cmd_schedule_cancel, .min_length = 1, .handler = &handle_schedule_cancel },
+#endif // CONFIG_SCHEDULE
+    [cmd_capabilities] = { .cmd = cmd_capabilities, .min_length = 1, .handler = &handle_capabilities },
+#ifdef CONFIG_NOTIFY
+    [cmd_subscribe] = { .cmd = cmd_subscribe, .min_length = 3, .handler = &handle_subscribe },
+#endif // CONFIG_NOTIFY
+#ifdef CONFIG_PRESETS
+    [cmd_save_preset] = { .cmd = cmd_save_preset, .min_length = 2, .handler = &handle_save_preset },
+    [cmd_recall_preset] = { .cmd = cmd_recall_preset, .min_length = 2, .handler = &handle_recall_preset },
+#endif // CONFIG_PRESETS
+#ifdef CONFIG_FUNC_STAGING
+    [cmd_stage_parameters] = { .cmd = cmd_stage_parameters, .min_length = 2, .handler = &handle_stage_parameters },
+    [cmd_switch_function] = { .cmd = cmd_switch_function, .min_length = 2, .handler = &handle_switch_function },
+#endif // CONFIG_FUNC_STAGING
+#ifdef CONFIG_OCP_BENCH
+    [cmd_ocp_bench] = { .cmd = cmd_ocp_bench, .min_length = 2, .handler = &handle_ocp_bench },
+#endif // CONFIG_OCP_BENCH
+#ifdef CONFIG_RIPPLE
+    [cmd_ripple] = { .cmd = cmd_ripple, .min_length = 7, .handler = &handle_ripple },
+#endif // CONFIG_RIPPLE
+#ifdef CONFIG_CLONE
+    [cmd_config_export] = { .cmd = cmd_config_export, .min_length = 3, .handler = &handle_config_export },
+    [cmd_config_import] = { .cmd = cmd_config_import, .min_length = 5, .flags = CMD_FLAG_NO_BATCH, .handler = &handle_config_import },
+#endif // CONFIG_CLONE
+};
+
+/** Commands added at init by other modules, see serial_register_command() */
+static const command_entry_t *registered_commands[MAX_REGISTERED_COMMANDS];
+static uint32_t num_registered_commands;
+
+/**
+  * @brief Find the entry of a command
+  * @param cmd the command id
+  * @retval the entry or NULL for unknown commands
+  */
+static const command_entry_t *find_command(uint8_t cmd)
+{
+    if (cmd < sizeof(command_table) / sizeof(command_table[0]) && command_table[cmd].handler) {
+        return &command_table[cmd];
+    }
+    for (uint32_t i = 0; i < num_registered_commands; i++) {
+        if (registered_commands[i]->cmd == cmd) {
+            return registered_commands[i];
+        }
+    }
+    return NULL;
+}
+
+bool serial_register_command(const command_entry_t *entry)
+{
+    if (!entry || !entry->handler || find_command(entry->cmd) || num_registered_commands >= MAX_REGISTERED_COMMANDS) {
+        return false;
+    }
+    registered_commands[num_registered_commands++] = entry;
+    return true;
+}
+
+/**
+  * @brief Run the handler of a command
+  * @param frame the command frame, unescaped
+  * @retval command_status_t failed, success or "I sent my own frame"
+  */
+static command_status_t handle_command(frame_t *frame)
+{
+    uint8_t cmd = frame->buffer[0];
+    const command_entry_t *entry = find_command(cmd);
+    if (!entry) {
+        emu_printf("Got unknown command %d (0x%02x)\n", cmd, cmd);
+        link_stats.rejected++;
+        return cmd_failed;
+    }
+    if (frame->length < entry->min_length) {
+        link_stats.rejected++;
+        return cmd_failed;
+    }
+    TRACE_CMD_BEGIN(cmd);
+    command_status_t status = entry->handler(frame);
+    TRACE_CMD_END(cmd, status);
+    return status;
+}
+
+/**
+  * @brief Handle a receved frame
+  * @param frame the received frame, unescaped by uframe_receive_byte()
+  * @param payload_len payload length or error returned by uframe_receive_byte()
+  * @retval None
+  */
+static void handle_frame(frame_t *frame, int32_t payload_len)
+{
+    PROBE_HIGH(PROBE_FRAME);
+    PERF_BEGIN(perf_handle_frame);
+    command_status_t success = cmd_failed;
+    command_t cmd = cmd_response;
+
+    if (payload_len <= 0) {
+        if (payload_len == -E_CRC) {
+            link_stats.crc++;
+        } else {
+            link_stats.length++;
+        }
+        dbg_printf("Frame error %ld\n", payload_len);
+    } else {
+        link_stats.frames++;
+        cmd = frame->buffer[0];
+        last_rx_frame = get_ticks();
+#ifdef CONFIG_BUS_ADDRESS
+        if (cmd == cmd_addressed && payload_len > 2) {
+            /** Strip the envelope, send_frame() puts it back on the response */
+            resp_bus.active = true;
+            resp_bus.address = frame->buffer[1];
+            resp_bus.rx_us = get_time_us();
+            payload_len -= 2;
+            memmove(frame->buffer, &frame->buffer[2], payload_len);
+            frame->length = payload_len;
+            cmd = frame->buffer[0];
+        }
+#endif // CONFIG_BUS_ADDRESS
+        if (cmd == cmd_tagged && payload_len > 2) {
+            /** Strip the envelope, send_frame() puts it back on the response */
+            resp_tag.active = true;
+            resp_tag.tag = frame->buffer[1];
+            payload_len -= 2;
+            memmove(frame->buffer, &frame->buffer[2], payload_len);
+            frame->length = payload_len;
+            cmd = frame->buffer[0];
+        }
+        success = handle_command(frame);
+    }
+    if (success != cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much) {
+        send_response(cmd, success);
+    }
+    resp_tag.active = false;
+#ifdef CONFIG_BUS_ADDRESS
+    resp_bus.active = false;
+#endif // CONFIG_BUS_ADDRESS
+    PERF_END(perf_handle_frame);
+    PROBE_LOW(PROBE_FRAME);
+}
+
+#ifdef CONFIG_BUS_ADDRESS
+/**
+  * @brief Check the start of a frame being received on the bus
+  * @param frame the frame, unescaped so far
+  * @retval false if it is not a command for this unit
+  */
+static bool bus_frame_wanted(const frame_t *frame)
+{
+    if (frame->length >= 1 && frame->buffer[0] != cmd_addressed) {
+        return false; /** Unaddressed or another unit's response */
+    }
+    if (frame->length >= 2 && frame->buffer[1] != CONFIG_BUS_ADDRESS &&
+        frame->buffer[1] != BUS_ADDRESS_BROADCAST) {
+        return false;
+    }
+    return true;
+}
+#endif // CONFIG_BUS_ADDRESS
+
+/**
+  * @brief Handle received character
+  * @param c well, the received character
+  * @retval None
+  */
+void serial_handle_rx_char(char c)
+{
+    uint8_t b = (uint8_t) c;
+    if (b == _SOF) {
+        if (receiving_frame && (rx_frame.length || rx_frame.escaped)) {
+            link_stats.aborted++;
+        }
+        receiving_frame = true;
+    }
+    if (receiving_frame) {
+        int32_t status = uframe_receive_byte(&rx_frame, b);
+#ifdef CONFIG_BUS_ADDRESS
+        if (status == 0 && !bus_frame_wanted(&rx_frame)) {
+            /** Not for us, skip the rest of it */
+            receiving_frame = false;
+            return;
+        }
+#endif // CONFIG_BUS_ADDRESS
+        if (status != 0) {
+            /** Complete or broken, wait for the next SOF either way */
+            receiving_frame = false;
+            if (status == -E_LEN && b != _EOF) {
+                link_stats.length++;
+                dbg_printf("Error: RX buffer overflow!\n");
+            } else {
+                handle_frame(&rx_frame, status);
+            }
         }
     }
 }
@@ -22,11 +22,22 @@
  * THE SOFTWARE.
  */
 
+#include <stdlib.h>
 #include "pwrctl.h"
 #include "dps-model.h"
+#include "dps-model-fix.h"
 #include "pastunits.h"
+#include "hw.h"
+#include "event.h"
+#include "ramfunc.h"
 #include <gpio.h>
 #include <dac.h>
+#ifdef CONFIG_CAL_LUT
+ #include "cal_lut.h"
+#endif // CONFIG_CAL_LUT
+#ifdef CONFIG_ENERGY_METER
+ #include "energy.h"
+#endif // CONFIG_ENERGY_METER
 
 /** This module handles voltage and current calculations
   * Calculations based on measurements found at
@@ -36,6 +47,46 @@
 static uint32_t i_out, v_out, i_limit, v_limit;
 static bool v_out_enabled;
 
+/** Measurement hysteresis defaults, the resolution the UI shows them in */
+#ifndef CONFIG_VIN_HYSTERESIS_MV
+ #define CONFIG_VIN_HYSTERESIS_MV  (100)
+#endif // CONFIG_VIN_HYSTERESIS_MV
+#ifndef CONFIG_VOUT_HYSTERESIS_MV
+ #define CONFIG_VOUT_HYSTERESIS_MV  (10)
+#endif // CONFIG_VOUT_HYSTERESIS_MV
+#ifndef CONFIG_IOUT_HYSTERESIS_MA
+ #if CURRENT_DECIMALS >= 3
+  #define CONFIG_IOUT_HYSTERESIS_MA  (1)
+ #else
+  #define CONFIG_IOUT_HYSTERESIS_MA  (10)
+ #endif
+#endif // CONFIG_IOUT_HYSTERESIS_MA
+
+/** CV/CC regime hysteresis of pwrctl_calc_cc_regime() */
+#ifndef CONFIG_CC_HYSTERESIS_MV
+ #define CONFIG_CC_HYSTERESIS_MV  (50)
+#endif // CONFIG_CC_HYSTERESIS_MV
+#ifndef CONFIG_CC_HYSTERESIS_MA
+ #define CONFIG_CC_HYSTERESIS_MA  (20)
+#endif // CONFIG_CC_HYSTERESIS_MA
+
+/** Slots of the transition times of event_limit_mode, more than the ADC
+  * event queue holds so a slot is read before it is reused */
+#define LIMIT_MODE_SLOTS  (16)
+
+/** Measurements published by pwrctl_publish() */
+static uint16_t meas_raw[pwrctl_meas_channels];
+static uint32_t meas_value[pwrctl_meas_channels];
+static uint32_t meas_hysteresis[pwrctl_meas_channels] = {
+    [pwrctl_meas_v_in] = CONFIG_VIN_HYSTERESIS_MV,
+    [pwrctl_meas_v_out] = CONFIG_VOUT_HYSTERESIS_MV,
+    [pwrctl_meas_i_out] = CONFIG_IOUT_HYSTERESIS_MA,
+};
+/** Cleared when the conversions change, everything is published again */
+static bool meas_valid;
+static pwrctl_observer_t observers[PWRCTL_MAX_OBSERVERS];
+static uint32_t num_observers;
+
 float a_adc_k_coef = A_ADC_K;
 float a_adc_c_coef = A_ADC_C;
 float a_dac_k_coef = A_DAC_K;
@@ -47,9 +98,312 @@ float v_dac_c_coef = V_DAC_C;
 float vin_adc_k_coef = VIN_ADC_K;
 float vin_adc_c_coef = VIN_ADC_C;
 
-/** not static as it is referred to from hw.c for performance reasons */
-uint32_t pwrctl_i_limit_raw;
-uint32_t pwrctl_v_limit_raw;
+/** Fixed point (Q16.16) copies of the calibration coefficients above. The
+  * STM32F100 has no FPU so all conversions done from the tick functions and
+  * the function generator ISR use these instead of the float versions.
+  * Updated by pwrctl_init whenever the coefficients change. */
+#define CAL_FRAC_BITS  (16)
+static int32_t a_adc_k_fix, a_adc_c_fix;
+static int32_t a_dac_k_fix, a_dac_c_fix;
+static int32_t v_adc_k_fix, v_adc_c_fix;
+static int32_t v_dac_k_fix, v_dac_c_fix;
+static int32_t vin_adc_k_fix, vin_adc_c_fix;
+/** Inverted ADC slopes in Q16.16 for setting to raw conversions and the ADC
+  * slopes in Q24.8 weighing raw errors in pwrctl_calc_cc_mode() */
+static int32_t v_adc_inv_k_fix, a_adc_inv_k_fix;
+static uint32_t v_adc_weight, a_adc_weight;
+/** CONFIG_CC_HYSTERESIS_MV and CONFIG_CC_HYSTERESIS_MA in raw ADC counts */
+static uint32_t cc_hyst_v_raw, cc_hyst_i_raw;
+/** cur_time_us() of the CV/CC transitions, see pwrctl_put_limit_mode() */
+static uint32_t limit_mode_us[LIMIT_MODE_SLOTS];
+static uint8_t limit_mode_slot;
+/** Bit per pwrctl_cal_channel_t set if the channel was calibrated, the others
+  * convert with the model defaults of dps-model-fix.h folded at compile time */
+static uint32_t cal_custom;
+
+#ifdef CONFIG_CAL_LUT
+/** Piecewise linear tables overriding the coefficients above, indexed by
+  * pwrctl_cal_channel_t. A table without points is not used. */
+static cal_lut_t cal_luts[pwrctl_cal_channels];
+#endif // CONFIG_CAL_LUT
+
+#ifdef CONFIG_VOUT_LOOP
+/** Closed loop trim of the V_out DAC from the measured V_out, see
+  * pwrctl_vout_loop(). The gains are in DAC codes per raw ADC code of
+  * averaged error and can be changed with the V_LOOP_KP and V_LOOP_KI
+  * calibration values. Both zero disables the loop. */
+#ifndef VOUT_LOOP_KP
+ #define VOUT_LOOP_KP  (0.0f)
+#endif
+#ifndef VOUT_LOOP_KI
+ #define VOUT_LOOP_KI  (0.05f)
+#endif
+/** The loop runs once every 2^VOUT_LOOP_SHIFT samples, ~330Hz */
+#ifndef VOUT_LOOP_SHIFT
+ #define VOUT_LOOP_SHIFT  (6)
+#endif
+/** Largest correction in DAC codes the loop may apply */
+#ifndef VOUT_LOOP_MAX_TRIM
+ #define VOUT_LOOP_MAX_TRIM  (64)
+#endif
+
+static float v_loop_kp_coef = VOUT_LOOP_KP;
+static float v_loop_ki_coef = VOUT_LOOP_KI;
+static int32_t v_loop_kp_fix, v_loop_ki_fix;
+
+static volatile uint16_t loop_v_dac;  /** Open loop DAC value of the V_out setting */
+static volatile int32_t loop_trim;    /** DAC codes added to loop_v_dac */
+static int32_t loop_integ;            /** Integrator in Q16.16 DAC codes */
+static int32_t loop_err;              /** Error summed over the current window */
+static uint32_t loop_count;
+static bool loop_limited;
+static volatile bool loop_raw_dac;    /** DAC written by pwrctl_set_vout_dac(), keep off it */
+#endif // CONFIG_VOUT_LOOP
+
+#ifdef CONFIG_VOUT_SOFT_START
+/** Slew rate limited V_out enable, see ramp_step(). The rate in mV/ms can be
+  * changed with the V_SLEW calibration value, 0 disables the ramp. */
+#ifndef VOUT_SLEW_MV_PER_MS
+ #define VOUT_SLEW_MV_PER_MS  (50.0f)
+#endif
+/** Ramp update period on the TIM3 time base */
+#define RAMP_STEP_US  (250)
+/** Fractional bits of the ramp position */
+#define RAMP_FRAC_BITS  (8)
+
+static float v_slew_coef = VOUT_SLEW_MV_PER_MS;
+static uint32_t ramp_step;            /** mV per RAMP_STEP_US with RAMP_FRAC_BITS fraction */
+static uint32_t ramp_pos;             /** Current ramp voltage, RAMP_FRAC_BITS fraction */
+static volatile bool ramp_active;     /** pwrctl_set_vout() leaves the DAC to the ramp */
+#endif // CONFIG_VOUT_SOFT_START
+
+/** OCP/OVP trip policy, see the OCP_SAMPLES, OVP_SAMPLES and OCP_I2T
+  * calibration values. OCP_I2T is the time in ms the output may carry twice
+  * the current limit, 0 trips on OCP_SAMPLES consecutive samples instead. */
+static float ocp_samples_coef = OCP_FILTER_COUNT;
+static float ovp_samples_coef = OVP_FILTER_COUNT;
+static float ocp_i2t_coef = 0;
+
+/** The ISR parameters, both copies start out as all zeros */
+static pwrctl_params_t params[2];
+/** not static as it is read from hw.c for performance reasons */
+ctrlblk_t pwrctl_ctrl = CTRLBLK_INIT(&params[0], &params[1]);
+
+/**
+  * @brief Convert a calibration coefficient to fixed point
+  * @param coef the coefficient
+  * @retval coefficient in Q16.16 format
+  */
+static int32_t coef_to_fix(float coef)
+{
+    return coef * (1 << CAL_FRAC_BITS) + (coef < 0 ? -0.5f : 0.5f);
+}
+
+/**
+  * @brief Apply a fixed point calibration, value = k * x + c
+  * @param k slope in Q16.16 format
+  * @param c offset in Q16.16 format
+  * @param x value to convert
+  * @param shift number of fractional bits in x
+  * @retval converted value rounded to nearest integer, may be negative
+  */
+static inline int32_t cal_apply(int32_t k, int32_t c, uint32_t x, uint32_t shift)
+{
+    int64_t value = (((int64_t) k * x) >> shift) + c + (1 << (CAL_FRAC_BITS - 1));
+    return value >> CAL_FRAC_BITS;
+}
+
+/**
+  * @brief Invert a fixed point ADC calibration, raw = (value - c) / k
+  * @param inv_k inverted slope in Q16.16 format
+  * @param c offset in Q16.16 format
+  * @param value physical value to convert
+  * @retval raw ADC value rounded to nearest integer, 0 if negative
+  */
+static uint32_t cal_invert(int32_t inv_k, int32_t c, uint32_t value)
+{
+    int64_t raw = ((((int64_t) value << CAL_FRAC_BITS) - c) * inv_k + (1LL << (2 * CAL_FRAC_BITS - 1))) >> (2 * CAL_FRAC_BITS);
+    return raw < 0 ? 0 : raw;
+}
+
+/**
+  * @brief Convert a value using the calibration of a channel
+  * @param ch the channel, its table is used if it has one
+  * @param k slope in Q16.16 format
+  * @param c offset in Q16.16 format
+  * @param x value to convert
+  * @param shift number of fractional bits in x
+  * @retval converted value rounded to nearest integer, may be negative
+  */
+static inline int32_t cal_convert(pwrctl_cal_channel_t ch, int32_t k, int32_t c, uint32_t x, uint32_t shift)
+{
+#ifdef CONFIG_CAL_LUT
+    if (cal_luts[ch].count) {
+        return cal_lut_apply(&cal_luts[ch], x, shift);
+    }
+#else // CONFIG_CAL_LUT
+    (void) ch;
+#endif // CONFIG_CAL_LUT
+    return cal_apply(k, c, x, shift);
+}
+
+/**
+  * @brief Convert a physical value to raw using the ADC calibration of a channel
+  * @param ch the channel, its table is used if it has one
+  * @param inv_k inverted slope in Q16.16 format
+  * @param c offset in Q16.16 format
+  * @param value physical value to convert
+  * @retval raw ADC value rounded to nearest integer, 0 if negative
+  */
+static uint32_t cal_convert_raw(pwrctl_cal_channel_t ch, int32_t inv_k, int32_t c, uint32_t value)
+{
+#ifdef CONFIG_CAL_LUT
+    if (cal_luts[ch].count) {
+        int32_t raw = cal_lut_invert(&cal_luts[ch], value);
+        return raw < 0 ? 0 : raw;
+    }
+#else // CONFIG_CAL_LUT
+    (void) ch;
+#endif // CONFIG_CAL_LUT
+    return cal_invert(inv_k, c, value);
+}
+
+/**
+  * @brief Convert a value using the calibration of a channel or the model
+  *        defaults, eg. CAL_CONVERT(pwrctl_cal_v_adc, v_adc, V_ADC, raw, 0)
+  */
+#define CAL_CONVERT(ch, coef, COEF, x, shift) \
+    ((cal_custom & (1 << (ch))) ? cal_convert(ch, coef##_k_fix, coef##_c_fix, x, shift) \
+                                : cal_apply(COEF##_K_FIX, COEF##_C_FIX, x, shift))
+
+/**
+  * @brief Convert a physical value to raw using the ADC calibration of a
+  *        channel or the model defaults
+  */
+#define CAL_CONVERT_RAW(ch, coef, COEF, value) \
+    ((cal_custom & (1 << (ch))) ? cal_convert_raw(ch, coef##_inv_k_fix, coef##_c_fix, value) \
+                                : cal_invert(COEF##_K_INV_FIX, COEF##_C_FIX, value))
+
+#ifdef CONFIG_VOUT_LOOP
+/**
+  * @brief Add the loop trim to a V_out DAC value
+  * @param dac open loop DAC value
+  * @param trim correction in DAC codes
+  * @retval corresponding 12 bit DAC value
+  */
+static inline uint16_t loop_dac(uint16_t dac, int32_t trim)
+{
+    int32_t value = dac + trim;
+    if (value <= 0)
+        return 0;
+    else if (value >= 0xfff)
+        return 0xfff; /** 12 bits */
+    else
+        return value;
+}
+
+/**
+  * @brief Clear the loop state, the next window starts from the open loop value
+  * @retval none
+  */
+static void loop_reset(void)
+{
+    loop_trim = 0;
+    loop_integ = 0;
+    loop_err = 0;
+    loop_count = 0;
+    loop_limited = false;
+}
+#endif // CONFIG_VOUT_LOOP
+
+/**
+  * @brief Update the fixed point coefficients from the float coefficients
+  * @retval none
+  */
+static void update_fixed_coefs(void)
+{
+    a_adc_k_fix = coef_to_fix(a_adc_k_coef);
+    a_adc_c_fix = coef_to_fix(a_adc_c_coef);
+    a_dac_k_fix = coef_to_fix(a_dac_k_coef);
+    a_dac_c_fix = coef_to_fix(a_dac_c_coef);
+    v_adc_k_fix = coef_to_fix(v_adc_k_coef);
+    v_adc_c_fix = coef_to_fix(v_adc_c_coef);
+    v_dac_k_fix = coef_to_fix(v_dac_k_coef);
+    v_dac_c_fix = coef_to_fix(v_dac_c_coef);
+    vin_adc_k_fix = coef_to_fix(vin_adc_k_coef);
+    vin_adc_c_fix = coef_to_fix(vin_adc_c_coef);
+    v_adc_inv_k_fix = v_adc_k_coef ? coef_to_fix(1.0f / v_adc_k_coef) : 0;
+    a_adc_inv_k_fix = a_adc_k_coef ? coef_to_fix(1.0f / a_adc_k_coef) : 0;
+    v_adc_weight = abs(v_adc_k_fix) >> (CAL_FRAC_BITS - 8);
+    a_adc_weight = abs(a_adc_k_fix) >> (CAL_FRAC_BITS - 8);
+    cc_hyst_v_raw = ((abs(v_adc_inv_k_fix) * CONFIG_CC_HYSTERESIS_MV) >> CAL_FRAC_BITS) + 1;
+    cc_hyst_i_raw = ((abs(a_adc_inv_k_fix) * CONFIG_CC_HYSTERESIS_MA) >> CAL_FRAC_BITS) + 1;
+#ifdef CONFIG_VOUT_LOOP
+    v_loop_kp_fix = coef_to_fix(v_loop_kp_coef);
+    v_loop_ki_fix = coef_to_fix(v_loop_ki_coef);
+#endif // CONFIG_VOUT_LOOP
+#ifdef CONFIG_VOUT_SOFT_START
+    ramp_step = v_slew_coef <= 0 ? 0 : v_slew_coef * RAMP_STEP_US * (1 << RAMP_FRAC_BITS) / 1000 + 0.5f;
+#endif // CONFIG_VOUT_SOFT_START
+}
+
+/**
+  * @brief Restore a calibration coefficient from past
+  * @param reader the reader, arg points to the coefficient
+  * @param data the stored float
+  * @param length length of the stored data
+  * @retval none
+  */
+static void restore_coef(const past_reader_t *reader, const void *data, uint32_t length)
+{
+    (void) length;
+    *(float*) reader->arg = *(const float*) data;
+}
+
+#ifdef CONFIG_CAL_LUT
+/**
+  * @brief Restore a calibration table from past
+  * @param reader the reader, arg points to the table
+  * @param data the stored points
+  * @param length length of the stored data
+  * @retval none
+  */
+static void restore_lut(const past_reader_t *reader, const void *data, uint32_t length)
+{
+    (void) cal_lut_load((cal_lut_t*) reader->arg, data, length);
+}
+#endif // CONFIG_CAL_LUT
+
+/** Calibration constants restored from past by pwrctl_init in one walk */
+static const past_reader_t coef_readers[] = {
+    { past_A_ADC_K, &restore_coef, &a_adc_k_coef },
+    { past_A_ADC_C, &restore_coef, &a_adc_c_coef },
+    { past_A_DAC_K, &restore_coef, &a_dac_k_coef },
+    { past_A_DAC_C, &restore_coef, &a_dac_c_coef },
+    { past_V_ADC_K, &restore_coef, &v_adc_k_coef },
+    { past_V_ADC_C, &restore_coef, &v_adc_c_coef },
+    { past_V_DAC_K, &restore_coef, &v_dac_k_coef },
+    { past_V_DAC_C, &restore_coef, &v_dac_c_coef },
+    { past_VIN_ADC_K, &restore_coef, &vin_adc_k_coef },
+    { past_VIN_ADC_C, &restore_coef, &vin_adc_c_coef },
+#ifdef CONFIG_VOUT_LOOP
+    { past_V_LOOP_KP, &restore_coef, &v_loop_kp_coef },
+    { past_V_LOOP_KI, &restore_coef, &v_loop_ki_coef },
+#endif // CONFIG_VOUT_LOOP
+#ifdef CONFIG_VOUT_SOFT_START
+    { past_V_SLEW, &restore_coef, &v_slew_coef },
+#endif // CONFIG_VOUT_SOFT_START
+    { past_OCP_SAMPLES, &restore_coef, &ocp_samples_coef },
+    { past_OVP_SAMPLES, &restore_coef, &ovp_samples_coef },
+    { past_OCP_I2T, &restore_coef, &ocp_i2t_coef },
+#ifdef CONFIG_CAL_LUT
+    { past_A_ADC_LUT, &restore_lut, &cal_luts[pwrctl_cal_a_adc] },
+    { past_A_DAC_LUT, &restore_lut, &cal_luts[pwrctl_cal_a_dac] },
+    { past_V_ADC_LUT, &restore_lut, &cal_luts[pwrctl_cal_v_adc] },
+    { past_V_DAC_LUT, &restore_lut, &cal_luts[pwrctl_cal_v_dac] },
+    { past_VIN_ADC_LUT, &restore_lut, &cal_luts[pwrctl_cal_vin_adc] },
+#endif // CONFIG_CAL_LUT
+};
 
 /**
   * @brief Initialize the power control module
@@ -57,9 +411,6 @@ uint32_t pwrctl_v_limit_raw;
   */
 void pwrctl_init(past_t *past)
 {
-    uint32_t length;
-    float *p;
-
     /** Load default calibration constants */
     a_adc_k_coef = A_ADC_K;
     a_adc_c_coef = A_ADC_C;
@@ -71,50 +422,218 @@ void pwrctl_init(past_t *past)
     v_dac_c_coef = V_DAC_C;
     vin_adc_k_coef = VIN_ADC_K;
     vin_adc_c_coef = VIN_ADC_C;
+#ifdef CONFIG_VOUT_LOOP
+    v_loop_kp_coef = VOUT_LOOP_KP;
+    v_loop_ki_coef = VOUT_LOOP_KI;
+#endif // CONFIG_VOUT_LOOP
+#ifdef CONFIG_VOUT_SOFT_START
+    v_slew_coef = VOUT_SLEW_MV_PER_MS;
+#endif // CONFIG_VOUT_SOFT_START
+    ocp_samples_coef = OCP_FILTER_COUNT;
+    ovp_samples_coef = OVP_FILTER_COUNT;
+    ocp_i2t_coef = 0;
 
     /** Load any calibration constants that maybe stored in non-volatile memory (past) */
-    if (past_read_unit(past, past_A_ADC_K, (const void**) &p, &length))
-        a_adc_k_coef = *p;
-    if (past_read_unit(past, past_A_ADC_C, (const void**) &p, &length))
-        a_adc_c_coef = *p;
-    if (past_read_unit(past, past_A_DAC_K, (const void**) &p, &length))
-        a_dac_k_coef = *p;
-    if (past_read_unit(past, past_A_DAC_C, (const void**) &p, &length))
-        a_dac_c_coef = *p;
-    if (past_read_unit(past, past_V_ADC_K, (const void**) &p, &length))
-        v_adc_k_coef = *p;
-    if (past_read_unit(past, past_V_ADC_C, (const void**) &p, &length))
-        v_adc_c_coef = *p;
-    if (past_read_unit(past, past_V_DAC_K, (const void**) &p, &length))
-        v_dac_k_coef = *p;
-    if (past_read_unit(past, past_V_DAC_C, (const void**) &p, &length))
-        v_dac_c_coef = *p;
-    if (past_read_unit(past, past_VIN_ADC_K, (const void**) &p, &length))
-        vin_adc_k_coef = *p;
-    if (past_read_unit(past, past_VIN_ADC_C, (const void**) &p, &length))
-        vin_adc_c_coef = *p;
+#ifdef CONFIG_CAL_LUT
+    for (uint32_t ch = 0; ch < pwrctl_cal_channels; ch++) {
+        cal_luts[ch].count = 0;
+    }
+#endif // CONFIG_CAL_LUT
+    (void) past_read_many(past, coef_readers, sizeof(coef_readers) / sizeof(coef_readers[0]));
+    cal_custom = 0;
+    if (a_adc_k_coef != A_ADC_K || a_adc_c_coef != A_ADC_C)
+        cal_custom |= 1 << pwrctl_cal_a_adc;
+    if (a_dac_k_coef != A_DAC_K || a_dac_c_coef != A_DAC_C)
+        cal_custom |= 1 << pwrctl_cal_a_dac;
+    if (v_adc_k_coef != V_ADC_K || v_adc_c_coef != V_ADC_C)
+        cal_custom |= 1 << pwrctl_cal_v_adc;
+    if (v_dac_k_coef != V_DAC_K || v_dac_c_coef != V_DAC_C)
+        cal_custom |= 1 << pwrctl_cal_v_dac;
+    if (vin_adc_k_coef != VIN_ADC_K || vin_adc_c_coef != VIN_ADC_C)
+        cal_custom |= 1 << pwrctl_cal_vin_adc;
+#ifdef CONFIG_CAL_LUT
+    for (uint32_t ch = 0; ch < pwrctl_cal_channels; ch++) {
+        if (cal_luts[ch].count) {
+            cal_custom |= 1 << ch;
+        }
+    }
+#endif // CONFIG_CAL_LUT
 
+    update_fixed_coefs();
+    meas_valid = false;
+    /** At least one sample, a trip must stay possible */
+    pwrctl_params_t *ctrl = ctrlblk_begin(&pwrctl_ctrl);
+    ctrl->ocp_samples = ocp_samples_coef < 1 ? 1 : (uint32_t) ocp_samples_coef;
+    ctrl->ovp_samples = ovp_samples_coef < 1 ? 1 : (uint32_t) ovp_samples_coef;
+    ctrl->ocp_i2t = ocp_i2t_coef <= 0 ? 0 : (uint32_t) (ocp_i2t_coef * PWRCTL_ADC_SAMPLES_PER_MS + 0.5f);
+    ctrlblk_publish(&pwrctl_ctrl);
     pwrctl_enable_vout(false);
 }
 
+/**
+  * @brief V_out DAC value for the current setting
+  * @retval the DAC value, 0 when the output is disabled
+  */
+static inline uint16_t vout_dac_value(void)
+{
+    if (v_out_enabled) {
+        /** Needed for the DPS5005 "communications version" (the one with BT/USB) */
+#ifdef CONFIG_VOUT_LOOP
+        loop_v_dac = pwrctl_calc_vout_dac(v_out);
+        return loop_dac(loop_v_dac, loop_trim);
+#else // CONFIG_VOUT_LOOP
+        return pwrctl_calc_vout_dac(v_out);
+#endif // CONFIG_VOUT_LOOP
+    } else {
+        return 0;
+    }
+}
+
+/**
+  * @brief I_out DAC value for the current setting
+  * @retval the DAC value, 0 when the output is disabled
+  */
+static inline uint16_t iout_dac_value(void)
+{
+    return v_out_enabled ? pwrctl_calc_iout_dac(i_out) : 0;
+}
+
+/**
+  * @brief Write the V_out DAC for the current setting
+  * @retval none
+  */
+static void write_vout_dac(void)
+{
+    DAC_DHR12R1(DAC1) = vout_dac_value();
+}
+
+#ifdef CONFIG_VOUT_SOFT_START
+/**
+  * @brief Advance the V_out ramp, called from the TIM3 ISR every RAMP_STEP_US
+  * @retval none
+  * @note The setting may change while ramping, the ramp then heads for the
+  *       new value. event_vout_ramped is posted when the setting is reached.
+  */
+static void ramp_step_isr(void)
+{
+    if (!ramp_active) {
+        return;
+    }
+    ramp_pos += ramp_step;
+    if ((ramp_pos >> RAMP_FRAC_BITS) >= v_out) {
+        ramp_active = false;
+        hw_ramp_timer_stop();
+        /** Reads v_out again, a setting made after ramp_active cleared writes the DAC itself */
+        write_vout_dac();
+        (void) event_put(event_vout_ramped, 0);
+    } else {
+        DAC_DHR12R1(DAC1) = pwrctl_calc_vout_dac(ramp_pos >> RAMP_FRAC_BITS);
+    }
+}
+
+/**
+  * @brief Start ramping V_out from 0V towards the setting
+  * @retval none
+  */
+static void ramp_start(void)
+{
+    ramp_pos = 0;
+    ramp_active = true;
+    DAC_DHR12R1(DAC1) = pwrctl_calc_vout_dac(0);
+    hw_ramp_timer_start(RAMP_STEP_US, &ramp_step_isr);
+}
+
+/**
+  * @brief Stop the V_out ramp if it is running
+  * @retval none
+  */
+static void ramp_stop(void)
+{
+    ramp_active = false;
+    hw_ramp_timer_stop();
+}
+
+/**
+  * @brief Check if the V_out ramp is running
+  * @retval true while V_out is heading for the setting
+  */
+bool pwrctl_vout_ramping(void)
+{
+    return ramp_active;
+}
+#endif // CONFIG_VOUT_SOFT_START
+
 /**
   * @brief Set voltage output
   * @param value_mv voltage in milli volt
   * @retval true requested voltage was within specs
   */
-bool pwrctl_set_vout(uint32_t value_mv)
+RAMFUNC_HOOK bool pwrctl_set_vout(uint32_t value_mv)
 {
     /** @todo Check with max Vout, currently filtered by ui.c */
     v_out = value_mv;
-    if (v_out_enabled) {
-        /** Needed for the DPS5005 "communications version" (the one with BT/USB) */
-        DAC_DHR12R1(DAC1) = pwrctl_calc_vout_dac(v_out);
-    } else {
-        DAC_DHR12R1(DAC1) = 0;
+    uint32_t v_set_raw = CAL_CONVERT_RAW(pwrctl_cal_v_adc, v_adc, V_ADC, v_out);
+    pwrctl_params_t *p = ctrlblk_begin(&pwrctl_ctrl);
+    p->v_set_raw = v_set_raw;
+    ctrlblk_publish(&pwrctl_ctrl);
+#ifdef CONFIG_VOUT_LOOP
+    loop_raw_dac = false;
+#endif // CONFIG_VOUT_LOOP
+#ifdef CONFIG_VOUT_SOFT_START
+    if (ramp_active) {
+        return true; /** ramp_step_isr() picks up the new setting */
     }
+#endif // CONFIG_VOUT_SOFT_START
+    write_vout_dac();
     return true;
 }
 
+/**
+  * @brief Write a raw V_out DAC value, used for calibration
+  * @param dac 12 bit DAC value
+  * @retval none
+  * @note Stops any soft start ramp and holds the V_out loop until the next
+  *       pwrctl_set_vout()
+  */
+void pwrctl_set_vout_dac(uint16_t dac)
+{
+#ifdef CONFIG_VOUT_SOFT_START
+    ramp_stop();
+#endif // CONFIG_VOUT_SOFT_START
+#ifdef CONFIG_VOUT_LOOP
+    loop_raw_dac = true;
+#endif // CONFIG_VOUT_LOOP
+    DAC_DHR12R1(DAC1) = dac;
+}
+
+/**
+  * @brief Write the I_out DAC without changing the current setting
+  * @param value_ma current in milli ampere
+  * @retval none
+  * @note Called from the ADC ISR
+  */
+RAMFUNC_HOOK void pwrctl_drive_iout(uint32_t value_ma)
+{
+    if (v_out_enabled) {
+        DAC_DHR12R2(DAC1) = pwrctl_calc_iout_dac(value_ma);
+    }
+}
+
+/**
+  * @brief Calculate the raw ADC thresholds of an I_out setting
+  * @param value_ma current in milli ampere
+  * @param raw the I_out fields are filled in
+  * @retval none
+  */
+static void iout_raw(uint32_t value_ma, pwrctl_params_t *raw)
+{
+    raw->i_set_raw = CAL_CONVERT_RAW(pwrctl_cal_a_adc, a_adc, A_ADC, value_ma);
+#ifdef CONFIG_VOUT_LOOP
+    /** Treat the output as current limited a bit below the setting */
+    raw->i_loop_raw = CAL_CONVERT_RAW(pwrctl_cal_a_adc, a_adc, A_ADC, value_ma - value_ma / 16);
+#endif // CONFIG_VOUT_LOOP
+}
+
 /**
   * @brief Set current output
   * @param current_ma current in milli ampere
@@ -122,12 +641,50 @@ bool pwrctl_set_vout(uint32_t value_mv)
   */
 bool pwrctl_set_iout(uint32_t value_ma)
 {
+    pwrctl_params_t raw;
     i_out = value_ma;
-    if (v_out_enabled) {
-        DAC_DHR12R2(DAC1) = pwrctl_calc_iout_dac(value_ma);
-    } else {
-        DAC_DHR12R2(DAC1) = 0;
+    iout_raw(value_ma, &raw);
+    pwrctl_params_t *p = ctrlblk_begin(&pwrctl_ctrl);
+    p->i_set_raw = raw.i_set_raw;
+#ifdef CONFIG_VOUT_LOOP
+    p->i_loop_raw = raw.i_loop_raw;
+#endif // CONFIG_VOUT_LOOP
+    ctrlblk_publish(&pwrctl_ctrl);
+    DAC_DHR12R2(DAC1) = iout_dac_value();
+    return true;
+}
+
+/**
+  * @brief Set voltage and current output with one write of both DACs
+  * @param value_mv voltage in milli volt
+  * @param value_ma current in milli ampere
+  * @retval true requested settings were within specs
+  */
+bool pwrctl_set_vout_iout(uint32_t value_mv, uint32_t value_ma)
+{
+    pwrctl_params_t raw;
+    v_out = value_mv;
+    i_out = value_ma;
+    raw.v_set_raw = CAL_CONVERT_RAW(pwrctl_cal_v_adc, v_adc, V_ADC, v_out);
+    iout_raw(value_ma, &raw);
+    /** The ISR sees both new settings at once */
+    pwrctl_params_t *p = ctrlblk_begin(&pwrctl_ctrl);
+    p->v_set_raw = raw.v_set_raw;
+    p->i_set_raw = raw.i_set_raw;
+#ifdef CONFIG_VOUT_LOOP
+    p->i_loop_raw = raw.i_loop_raw;
+#endif // CONFIG_VOUT_LOOP
+    ctrlblk_publish(&pwrctl_ctrl);
+#ifdef CONFIG_VOUT_LOOP
+    loop_raw_dac = false;
+#endif // CONFIG_VOUT_LOOP
+#ifdef CONFIG_VOUT_SOFT_START
+    if (ramp_active) {
+        DAC_DHR12R2(DAC1) = iout_dac_value(); /** ramp_step_isr() owns V_out */
+        return true;
     }
+#endif // CONFIG_VOUT_SOFT_START
+    hw_set_dacs(vout_dac_value(), iout_dac_value());
     return true;
 }
 
@@ -158,7 +715,13 @@ bool pwrctl_set_ilimit(uint32_t value_ma)
 {
     /** @todo Check with I_limit, currently filtered by ui.c */
     i_limit = value_ma;
-    pwrctl_i_limit_raw = pwrctl_calc_ilimit_adc(i_limit);
+    uint32_t i_limit_raw = pwrctl_calc_ilimit_adc(i_limit);
+    pwrctl_params_t *p = ctrlblk_begin(&pwrctl_ctrl);
+    p->i_limit_raw = i_limit_raw;
+    ctrlblk_publish(&pwrctl_ctrl);
+#ifdef CONFIG_ADC_AWD
+    hw_update_ocp_watchdog();
+#endif // CONFIG_ADC_AWD
     return true;
 }
 
@@ -171,6 +734,23 @@ uint32_t pwrctl_get_ilimit(void)
     return i_limit;
 }
 
+#ifdef CONFIG_OCP_BENCH
+/**
+  * @brief Publish a raw current limit, leaving the setting alone
+  * @param raw raw I_out limit, 0 disables the OCP
+  * @retval None
+  */
+void pwrctl_set_ilimit_raw(uint32_t raw)
+{
+    pwrctl_params_t *p = ctrlblk_begin(&pwrctl_ctrl);
+    p->i_limit_raw = raw;
+    ctrlblk_publish(&pwrctl_ctrl);
+#ifdef CONFIG_ADC_AWD
+    hw_update_ocp_watchdog();
+#endif // CONFIG_ADC_AWD
+}
+#endif // CONFIG_OCP_BENCH
+
 /**
   * @brief Set voltage limit
   * @param value_mv limit in millivolts
@@ -180,7 +760,10 @@ bool pwrctl_set_vlimit(uint32_t value_mv)
 {
     /** @todo Check with V_limit, currently filtered by ui.c */
     v_limit = value_mv;
-    pwrctl_v_limit_raw = pwrctl_calc_vlimit_adc(v_limit);
+    uint32_t v_limit_raw = pwrctl_calc_vlimit_adc(v_limit);
+    pwrctl_params_t *p = ctrlblk_begin(&pwrctl_ctrl);
+    p->v_limit_raw = v_limit_raw;
+    ctrlblk_publish(&pwrctl_ctrl);
     return true;
 }
 
@@ -200,10 +783,33 @@ uint32_t pwrctl_get_vlimit(void)
   */
 void pwrctl_enable_vout(bool enable)
 {
+#ifdef CONFIG_VOUT_LOOP
+    /** The ADC ISR leaves the loop alone while the output is disabled */
+    if (!v_out_enabled) {
+        loop_reset();
+    }
+#endif // CONFIG_VOUT_LOOP
+#ifdef CONFIG_VOUT_SOFT_START
+    bool start_ramp = enable && !v_out_enabled && ramp_step && v_out;
+    if (!enable) {
+        ramp_stop();
+    }
+#endif // CONFIG_VOUT_SOFT_START
     v_out_enabled = enable;
+#ifdef CONFIG_ENERGY_METER
+    energy_run(enable);
+#endif // CONFIG_ENERGY_METER
     if (v_out_enabled) {
-      (void) pwrctl_set_vout(v_out);
-      (void) pwrctl_set_iout(i_out);
+#ifdef CONFIG_VOUT_SOFT_START
+      if (start_ramp) {
+          ramp_start();
+          (void) pwrctl_set_iout(i_out);
+      } else {
+          (void) pwrctl_set_vout_iout(v_out, i_out);
+      }
+#else // CONFIG_VOUT_SOFT_START
+      (void) pwrctl_set_vout_iout(v_out, i_out);
+#endif // CONFIG_VOUT_SOFT_START
 #if defined(DPS5015) || defined(DPS5020)
         //gpio_clear(GPIOA, GPIO9); // this is power control on '5015
         gpio_set(GPIOB, GPIO11);    // B11 is fan control on '5015
@@ -219,16 +825,18 @@ void pwrctl_enable_vout(bool enable)
 #else
         gpio_set(GPIOB, GPIO11);  // B11 is power control on '5005
 #endif
-      (void) pwrctl_set_vout(v_out);
-      (void) pwrctl_set_iout(i_out);
+      (void) pwrctl_set_vout_iout(v_out, i_out);
     }
+#ifdef CONFIG_ADC_AWD
+    hw_update_ocp_watchdog();
+#endif // CONFIG_ADC_AWD
 }
 
 /**
   * @brief Return power output status
   * @retval true if power output is enabled
   */
-bool pwrctl_vout_enabled(void)
+RAMFUNC_HOOK bool pwrctl_vout_enabled(void)
 {
     return v_out_enabled;
 }
@@ -240,11 +848,11 @@ bool pwrctl_vout_enabled(void)
   */
 uint32_t pwrctl_calc_vin(uint16_t raw)
 {
-    float value = vin_adc_k_coef * raw + vin_adc_c_coef;
+    int32_t value = CAL_CONVERT(pwrctl_cal_vin_adc, vin_adc, VIN_ADC, raw, 0);
     if (value <= 0)
         return 0;
     else
-        return value + 0.5f; /** Add 0.5f to value so it is correctly rounded when it is truncated */
+        return value;
 }
 
 /**
@@ -254,11 +862,11 @@ uint32_t pwrctl_calc_vin(uint16_t raw)
   */
 uint32_t pwrctl_calc_vout(uint16_t raw)
 {
-    float value = v_adc_k_coef * raw + v_adc_c_coef;
+    int32_t value = CAL_CONVERT(pwrctl_cal_v_adc, v_adc, V_ADC, raw, 0);
     if (value <= 0)
         return 0;
     else
-        return value + 0.5f; /** Add 0.5f to value so it is correctly rounded when it is truncated */
+        return value;
 }
 
 /**
@@ -266,15 +874,15 @@ uint32_t pwrctl_calc_vout(uint16_t raw)
   * @param v_out_mv requested output voltage
   * @retval corresponding 12 bit DAC value
   */
-uint16_t pwrctl_calc_vout_dac(uint32_t v_out_mv)
+RAMFUNC_HOOK uint16_t pwrctl_calc_vout_dac(uint32_t v_out_mv)
 {
-    float value = v_dac_k_coef * v_out_mv + v_dac_c_coef;
+    int32_t value = CAL_CONVERT(pwrctl_cal_v_dac, v_dac, V_DAC, v_out_mv, 0);
     if (value <= 0)
         return 0;
     else if (value >= 0xfff)
         return 0xfff; /** 12 bits */
     else
-        return value + 0.5f; /** Add 0.5f to value so correct rounding is done when truncated */
+        return value;
 }
 
 /**
@@ -284,13 +892,57 @@ uint16_t pwrctl_calc_vout_dac(uint32_t v_out_mv)
   */
 uint32_t pwrctl_calc_iout(uint16_t raw)
 {
-    float value = a_adc_k_coef * raw + a_adc_c_coef;
+    int32_t value = CAL_CONVERT(pwrctl_cal_a_adc, a_adc, A_ADC, raw, 0);
+    if (value <= 0)
+        return 0;
+    else
+        return value;
+}
+
+#ifdef CONFIG_ADC_OVERSAMPLE
+/**
+  * @brief Calculate V_in based on decimated ADC measurement
+  * @param raw decimated value from ADC with ADC_OVERSAMPLE_SHIFT fractional bits
+  * @retval corresponding voltage in milli volt
+  */
+uint32_t pwrctl_calc_vin_hires(uint32_t raw)
+{
+    int32_t value = CAL_CONVERT(pwrctl_cal_vin_adc, vin_adc, VIN_ADC, raw, ADC_OVERSAMPLE_SHIFT);
     if (value <= 0)
         return 0;
     else
-        return value + 0.5f; /** Add 0.5f to value so correct rounding is done when truncated */
+        return value;
 }
 
+/**
+  * @brief Calculate V_out based on decimated ADC measurement
+  * @param raw decimated value from ADC with ADC_OVERSAMPLE_SHIFT fractional bits
+  * @retval corresponding voltage in milli volt
+  */
+uint32_t pwrctl_calc_vout_hires(uint32_t raw)
+{
+    int32_t value = CAL_CONVERT(pwrctl_cal_v_adc, v_adc, V_ADC, raw, ADC_OVERSAMPLE_SHIFT);
+    if (value <= 0)
+        return 0;
+    else
+        return value;
+}
+
+/**
+  * @brief Calculate I_out based on decimated ADC measurement
+  * @param raw decimated value from ADC with ADC_OVERSAMPLE_SHIFT fractional bits
+  * @retval corresponding current in milliampere
+  */
+uint32_t pwrctl_calc_iout_hires(uint32_t raw)
+{
+    int32_t value = CAL_CONVERT(pwrctl_cal_a_adc, a_adc, A_ADC, raw, ADC_OVERSAMPLE_SHIFT);
+    if (value <= 0)
+        return 0;
+    else
+        return value;
+}
+#endif // CONFIG_ADC_OVERSAMPLE
+
 /**
   * @brief Calculate expected raw ADC value based on selected I_limit
   * @param i_limit_ma selected I_limit
@@ -298,6 +950,12 @@ uint32_t pwrctl_calc_iout(uint16_t raw)
   */
 uint32_t pwrctl_calc_ilimit_adc(uint16_t i_limit_ma)
 {
+#ifdef CONFIG_CAL_LUT
+    if (cal_luts[pwrctl_cal_a_adc].count) {
+        int32_t raw = cal_lut_invert(&cal_luts[pwrctl_cal_a_adc], i_limit_ma) + 1;
+        return raw <= 0 ? 0 : raw;
+    }
+#endif // CONFIG_CAL_LUT
     float value = (i_limit_ma - a_adc_c_coef) / a_adc_k_coef + 1;
     if (value <= 0)
         return 0;
@@ -312,6 +970,12 @@ uint32_t pwrctl_calc_ilimit_adc(uint16_t i_limit_ma)
   */
 uint32_t pwrctl_calc_vlimit_adc(uint16_t v_limit_mv)
 {
+#ifdef CONFIG_CAL_LUT
+    if (cal_luts[pwrctl_cal_v_adc].count) {
+        int32_t raw = cal_lut_invert(&cal_luts[pwrctl_cal_v_adc], v_limit_mv) + 1;
+        return raw <= 0 ? 0 : raw;
+    }
+#endif // CONFIG_CAL_LUT
     float value = (v_limit_mv - v_adc_c_coef) / v_adc_k_coef + 1;
     if (value <= 0)
         return 0;
@@ -328,11 +992,224 @@ uint32_t pwrctl_calc_vlimit_adc(uint16_t v_limit_mv)
   */
 uint16_t pwrctl_calc_iout_dac(uint32_t i_out_ma)
 {
-    float value = a_dac_k_coef * i_out_ma + a_dac_c_coef;
+    int32_t value = CAL_CONVERT(pwrctl_cal_a_dac, a_dac, A_DAC, i_out_ma, 0);
     if (value <= 0)
         return 0;
     else if (value >= 0xfff)
         return 0xfff; /** 12 bits */
     else
-        return value + 0.5f; /** Add 0.5f to value so correct rounding is done when truncated */
+        return value;
+}
+
+/**
+  * @brief Check if the output is current limited
+  * @param i_raw raw I_out sample, offset corrected
+  * @param v_raw raw V_out sample
+  * @retval true if I_out is closer to its setting than V_out is to its setting
+  * @note Integer only, called from the ADC ISR
+  */
+RAMFUNC_HOOK bool pwrctl_calc_cc_mode(uint32_t i_raw, uint16_t v_raw)
+{
+    const pwrctl_params_t *p = pwrctl_params();
+    uint32_t i_diff = abs((int32_t) p->i_set_raw - (int32_t) i_raw) * a_adc_weight;
+    uint32_t v_diff = abs((int32_t) p->v_set_raw - (int32_t) v_raw) * v_adc_weight;
+    return i_diff < v_diff;
+}
+
+/**
+  * @brief Follow the CV/CC regime of the output with hysteresis
+  * @param i_raw raw I_out sample, offset corrected
+  * @param v_raw raw V_out sample
+  * @param cc true if the output is current limited now
+  * @retval true if the output is current limited after this sample
+  * @note Integer only, called from the ADC ISR
+  */
+RAMFUNC_HOOK bool pwrctl_calc_cc_regime(uint32_t i_raw, uint16_t v_raw, bool cc)
+{
+    const pwrctl_params_t *p = pwrctl_params();
+    /** The output limits at the current setting or trips at the OCP limit */
+    uint32_t i_lim = p->i_set_raw;
+    if (p->i_limit_raw && p->i_limit_raw < i_lim) {
+        i_lim = p->i_limit_raw;
+    }
+    if (cc) {
+        return v_raw + cc_hyst_v_raw / 2 < p->v_set_raw && i_raw + 2 * cc_hyst_i_raw >= i_lim;
+    }
+    return v_raw + cc_hyst_v_raw < p->v_set_raw && i_raw + cc_hyst_i_raw >= i_lim;
+}
+
+/**
+  * @brief Stamp a CV/CC transition and queue its event_limit_mode
+  * @param cc true if the output became current limited
+  * @retval false if the event was dropped
+  * @note Called from the ADC ISR
+  */
+RAMFUNC_HOOK bool pwrctl_put_limit_mode(bool cc)
+{
+    uint8_t slot = limit_mode_slot++ % LIMIT_MODE_SLOTS;
+    limit_mode_us[slot] = cur_time_us();
+    return event_put(event_limit_mode, (slot << 1) | cc);
+}
+
+/**
+  * @brief Get the time of the transition reported by an event_limit_mode
+  * @param data the data of the event
+  * @retval cur_time_us() when the transition was detected
+  */
+uint32_t pwrctl_limit_mode_us(uint8_t data)
+{
+    return limit_mode_us[(data >> 1) % LIMIT_MODE_SLOTS];
+}
+
+#ifdef CONFIG_VOUT_LOOP
+/**
+  * @brief Run the V_out trim loop from the ADC ISR
+  * @param i_raw raw I_out sample, offset corrected
+  * @param v_raw raw V_out sample
+  * @retval none
+  * @note A PI update runs every 2^VOUT_LOOP_SHIFT samples on the averaged
+  *       error. Windows where the output was current limited or set to 0V are
+  *       skipped so the integrator does not wind up while V_out is not ours
+  *       to regulate.
+  */
+RAMFUNC_HOOK void pwrctl_vout_loop(uint32_t i_raw, uint16_t v_raw)
+{
+    if (!v_out_enabled || loop_raw_dac || !(v_loop_kp_fix | v_loop_ki_fix)) {
+        return;
+    }
+#ifdef CONFIG_VOUT_SOFT_START
+    if (ramp_active) {
+        return;
+    }
+#endif // CONFIG_VOUT_SOFT_START
+    const pwrctl_params_t *p = pwrctl_params();
+    if (i_raw >= p->i_loop_raw) {
+        loop_limited = true;
+    }
+    loop_err += (int32_t) p->v_set_raw - v_raw;
+    if (++loop_count < (1 << VOUT_LOOP_SHIFT)) {
+        return;
+    }
+
+    int32_t err = loop_err;
+    bool hold = loop_limited || loop_v_dac == 0;
+    loop_err = 0;
+    loop_count = 0;
+    loop_limited = false;
+    if (hold) {
+        return;
+    }
+
+    int32_t max = VOUT_LOOP_MAX_TRIM << CAL_FRAC_BITS;
+    int32_t integ = loop_integ + (((int64_t) v_loop_ki_fix * err) >> VOUT_LOOP_SHIFT);
+    if (integ > max)
+        integ = max;
+    else if (integ < -max)
+        integ = -max;
+    loop_integ = integ;
+
+    int32_t trim = integ + (((int64_t) v_loop_kp_fix * err) >> VOUT_LOOP_SHIFT);
+    trim = (trim + (1 << (CAL_FRAC_BITS - 1))) >> CAL_FRAC_BITS;
+    if (trim > VOUT_LOOP_MAX_TRIM)
+        trim = VOUT_LOOP_MAX_TRIM;
+    else if (trim < -VOUT_LOOP_MAX_TRIM)
+        trim = -VOUT_LOOP_MAX_TRIM;
+    loop_trim = trim;
+    DAC_DHR12R1(DAC1) = loop_dac(loop_v_dac, trim);
+}
+#endif // CONFIG_VOUT_LOOP
+
+/**
+  * @brief Convert a raw reading of a published measurement
+  * @param meas the measurement
+  * @param raw the raw ADC value
+  * @retval millivolt or milliampere
+  */
+static uint32_t meas_convert(pwrctl_meas_t meas, uint16_t raw)
+{
+    switch (meas) {
+        case pwrctl_meas_v_in:
+            return pwrctl_calc_vin(raw);
+        case pwrctl_meas_v_out:
+            return pwrctl_calc_vout(raw);
+        default:
+            return pwrctl_calc_iout(raw);
+    }
+}
+
+/**
+  * @brief Convert and publish the latest ADC readings
+  * @retval mask of the published measurements
+  */
+uint32_t pwrctl_publish(void)
+{
+    uint16_t raw[pwrctl_meas_channels];
+    uint32_t changed = 0;
+    hw_get_adc_values(&raw[pwrctl_meas_i_out], &raw[pwrctl_meas_v_in], &raw[pwrctl_meas_v_out]);
+    for (uint32_t i = 0; i < pwrctl_meas_channels; i++) {
+        if (meas_valid && raw[i] == meas_raw[i]) {
+            continue;
+        }
+        meas_raw[i] = raw[i];
+        uint32_t value = meas_convert(i, raw[i]);
+        uint32_t diff = value > meas_value[i] ? value - meas_value[i] : meas_value[i] - value;
+        if (!meas_valid || (diff && diff >= meas_hysteresis[i])) {
+            meas_value[i] = value;
+            changed |= 1 << i;
+        }
+    }
+    meas_valid = true;
+    if (changed) {
+        for (uint32_t i = 0; i < num_observers; i++) {
+            observers[i](changed);
+        }
+    }
+    return changed;
+}
+
+/**
+  * @brief Get a published measurement
+  * @param meas the measurement
+  * @retval millivolt or milliampere
+  */
+uint32_t pwrctl_measured(pwrctl_meas_t meas)
+{
+    return meas < pwrctl_meas_channels ? meas_value[meas] : 0;
+}
+
+/**
+  * @brief Get the raw reading seen by the last publish
+  * @param meas the measurement
+  * @retval the raw ADC value
+  */
+uint16_t pwrctl_measured_raw(pwrctl_meas_t meas)
+{
+    return meas < pwrctl_meas_channels ? meas_raw[meas] : 0;
+}
+
+/**
+  * @brief Set the change a measurement needs before it is published
+  * @param meas the measurement
+  * @param hysteresis millivolt or milliampere
+  * @retval none
+  */
+void pwrctl_set_hysteresis(pwrctl_meas_t meas, uint32_t hysteresis)
+{
+    if (meas < pwrctl_meas_channels) {
+        meas_hysteresis[meas] = hysteresis;
+    }
+}
+
+/**
+  * @brief Register an observer of the published measurements
+  * @param observer the observer
+  * @retval true if registered
+  */
+bool pwrctl_subscribe(pwrctl_observer_t observer)
+{
+    if (num_observers >= PWRCTL_MAX_OBSERVERS) {
+        return false;
+    }
+    observers[num_observers++] = observer;
+    return true;
 }
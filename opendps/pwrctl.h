@@ -48,6 +48,11 @@
  * Calibration coefficients are stored in persistent storage (PAST) and
  * can be overridden from the default values in dps-model.h.
  *
+ * With CONFIG_CAL_LUT each channel may instead have a piecewise linear table
+ * (see cal_lut.h) stored in one of the past_*_LUT units. A channel with a
+ * table uses it for all conversions, the K and C coefficients are then only
+ * used to weigh errors in pwrctl_calc_cc_mode().
+ *
  * ## Calibration Procedure
  *
  * To calibrate voltage ADC:
@@ -73,6 +78,19 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "past.h"
+#include "ctrlblk.h"
+
+/**
+ * @brief Calibration channels, in the order of the past_*_LUT units
+ */
+typedef enum {
+    pwrctl_cal_a_adc = 0,   /**< I_out ADC, raw to milliampere */
+    pwrctl_cal_a_dac,       /**< Current limit DAC, milliampere to raw */
+    pwrctl_cal_v_adc,       /**< V_out ADC, raw to millivolt */
+    pwrctl_cal_v_dac,       /**< V_out DAC, millivolt to raw */
+    pwrctl_cal_vin_adc,     /**< V_in ADC, raw to millivolt */
+    pwrctl_cal_channels
+} pwrctl_cal_channel_t;
 
 /**
  * @defgroup Calibration_Coefficients Calibration Coefficients
@@ -93,11 +111,47 @@
  * @{
  */
 
-/** @brief Raw ADC value used for current limit comparison in ISR */
-extern uint32_t pwrctl_i_limit_raw;
+/**
+ * @brief Default number of consecutive samples past a limit that trip OCP
+ *        and OVP, changed with the OCP_SAMPLES and OVP_SAMPLES calibration
+ *        values. A single sample would trip on ADC spikes.
+ */
+#define OCP_FILTER_COUNT (20)
+#define OVP_FILTER_COUNT (20)
 
-/** @brief Raw ADC value used for voltage limit comparison in ISR */
-extern uint32_t pwrctl_v_limit_raw;
+/** @brief Approximate ADC sample sets per millisecond */
+#define PWRCTL_ADC_SAMPLES_PER_MS (21)
+
+/**
+ * @brief The raw ADC values the ADC ISR compares samples with
+ *
+ * Published as a whole through pwrctl_ctrl, so an ISR that fetches the
+ * block once with pwrctl_params() never sees a half updated set.
+ */
+typedef struct {
+    uint32_t i_limit_raw;   /**< Raw I_out above which OCP trips, 0 until set */
+    uint32_t v_limit_raw;   /**< Raw V_out above which OVP trips, 0 until set */
+    uint32_t v_set_raw;     /**< Raw V_out expected at the voltage setting */
+    uint32_t i_set_raw;     /**< Raw I_out expected at the current setting */
+#ifdef CONFIG_VOUT_LOOP
+    uint32_t i_loop_raw;    /**< Raw I_out above which the V_out loop holds */
+#endif // CONFIG_VOUT_LOOP
+    uint32_t ocp_samples;   /**< Consecutive samples above i_limit_raw that trip OCP */
+    uint32_t ovp_samples;   /**< Consecutive samples above v_limit_raw that trip OVP */
+    uint32_t ocp_i2t;       /**< Samples at twice i_limit_raw the I2t integral allows, 0 uses ocp_samples */
+} pwrctl_params_t;
+
+/** @brief Control block holding the pwrctl_params_t, see ctrlblk.h */
+extern ctrlblk_t pwrctl_ctrl;
+
+/**
+ * @brief Get the current ISR parameters
+ * @return The published parameters, do not keep the pointer past the ISR
+ */
+static inline const pwrctl_params_t *pwrctl_params(void)
+{
+    return (const pwrctl_params_t *) ctrlblk_read(&pwrctl_ctrl);
+}
 
 /** @brief Current ADC slope coefficient: I_ma = K * ADC + C */
 extern float a_adc_k_coef;
@@ -161,6 +215,29 @@ void pwrctl_init(past_t *past);
  */
 bool pwrctl_set_vout(uint32_t value_mv);
 
+/**
+ * @brief Write a raw value to the output voltage DAC
+ *
+ * Used by calibration to drive the DAC directly. Stops a soft start ramp
+ * and holds the V_out trim loop until the next pwrctl_set_vout(), so the
+ * raw value stays on the DAC.
+ *
+ * @param[in] dac 12 bit DAC value
+ */
+void pwrctl_set_vout_dac(uint16_t dac);
+
+/**
+ * @brief Drive the output current DAC from the ADC ISR
+ *
+ * Writes the I_out DAC for a current without touching the setting kept by
+ * pwrctl_set_iout() or the limits the ISR compares with. Used by functions
+ * regulating the current from their isrhook_limit hook, the next
+ * pwrctl_set_iout() or output enable writes the setting again.
+ *
+ * @param[in] value_ma Current in milliamps, ignored while the output is off
+ */
+void pwrctl_drive_iout(uint32_t value_ma);
+
 /**
  * @brief Set the output current (for constant current mode)
  *
@@ -176,6 +253,20 @@ bool pwrctl_set_vout(uint32_t value_mv);
  */
 bool pwrctl_set_iout(uint32_t value_ma);
 
+/**
+ * @brief Set the output voltage and current together
+ *
+ * Same as pwrctl_set_vout() followed by pwrctl_set_iout(), but both DACs
+ * are updated in a single write with hw_set_dacs() so the output never runs
+ * with one new and one old setpoint. Used when a function takes over or
+ * releases the output.
+ *
+ * @param[in] value_mv Desired output voltage in millivolts
+ * @param[in] value_ma Desired output current in milliamps
+ * @return true if the requested settings are within the valid range
+ */
+bool pwrctl_set_vout_iout(uint32_t value_mv, uint32_t value_ma);
+
 /**
  * @brief Get the current output current setting
  *
@@ -225,6 +316,18 @@ bool pwrctl_set_ilimit(uint32_t value_ma);
  */
 uint32_t pwrctl_get_ilimit(void);
 
+#ifdef CONFIG_OCP_BENCH
+/**
+ * @brief Publish a raw current limit without changing the setting
+ *
+ * Lets hw_ocp_bench() trip the OCP on purpose, pwrctl_set_ilimit() with
+ * pwrctl_get_ilimit() publishes the setting again.
+ *
+ * @param[in] raw Raw I_out limit, 0 disables the OCP
+ */
+void pwrctl_set_ilimit_raw(uint32_t raw);
+#endif // CONFIG_OCP_BENCH
+
 /**
  * @brief Set the voltage limit for over-voltage protection
  *
@@ -261,6 +364,19 @@ uint32_t pwrctl_get_vlimit(void);
  */
 void pwrctl_enable_vout(bool enable);
 
+#ifdef CONFIG_VOUT_SOFT_START
+/**
+ * @brief Check if V_out is still ramping after the output was enabled
+ *
+ * With soft start, enabling the output slews V_out from 0V to the setting
+ * at the V_SLEW rate (mV/ms) instead of jumping to it. event_vout_ramped is
+ * posted when the setting is reached.
+ *
+ * @return true while the ramp is running
+ */
+bool pwrctl_vout_ramping(void);
+#endif // CONFIG_VOUT_SOFT_START
+
 /**
  * @brief Check if power output is currently enabled
  *
@@ -331,6 +447,38 @@ uint16_t pwrctl_calc_vout_dac(uint32_t v_out_mv);
  */
 uint32_t pwrctl_calc_iout(uint16_t raw);
 
+#ifdef CONFIG_ADC_OVERSAMPLE
+/**
+ * @brief Calculate input voltage from a decimated ADC value
+ *
+ * @param[in] raw Decimated ADC value with ADC_OVERSAMPLE_SHIFT fractional bits
+ * @return Input voltage in millivolts
+ *
+ * @see hw_get_adc_values_hires()
+ */
+uint32_t pwrctl_calc_vin_hires(uint32_t raw);
+
+/**
+ * @brief Calculate output voltage from a decimated ADC value
+ *
+ * @param[in] raw Decimated ADC value with ADC_OVERSAMPLE_SHIFT fractional bits
+ * @return Output voltage in millivolts
+ *
+ * @see hw_get_adc_values_hires()
+ */
+uint32_t pwrctl_calc_vout_hires(uint32_t raw);
+
+/**
+ * @brief Calculate output current from a decimated ADC value
+ *
+ * @param[in] raw Decimated ADC value with ADC_OVERSAMPLE_SHIFT fractional bits
+ * @return Output current in milliamps
+ *
+ * @see hw_get_adc_values_hires()
+ */
+uint32_t pwrctl_calc_iout_hires(uint32_t raw);
+#endif // CONFIG_ADC_OVERSAMPLE
+
 /**
  * @brief Calculate expected ADC value for given current limit
  *
@@ -340,7 +488,7 @@ uint32_t pwrctl_calc_iout(uint16_t raw);
  * @param[in] i_limit_ma Current limit in milliamps
  * @return Expected raw ADC value at that current
  *
- * @note The result is stored in pwrctl_i_limit_raw for ISR use
+ * @note pwrctl_set_ilimit() publishes the result in pwrctl_params() for ISR use
  */
 uint32_t pwrctl_calc_ilimit_adc(uint16_t i_limit_ma);
 
@@ -353,7 +501,7 @@ uint32_t pwrctl_calc_ilimit_adc(uint16_t i_limit_ma);
  * @param[in] v_limit_mv Voltage limit in millivolts
  * @return Expected raw ADC value at that voltage
  *
- * @note The result is stored in pwrctl_v_limit_raw for ISR use
+ * @note pwrctl_set_vlimit() publishes the result in pwrctl_params() for ISR use
  */
 uint32_t pwrctl_calc_vlimit_adc(uint16_t v_limit_mv);
 
@@ -372,4 +520,160 @@ uint32_t pwrctl_calc_vlimit_adc(uint16_t v_limit_mv);
  */
 uint16_t pwrctl_calc_iout_dac(uint32_t i_out_ma);
 
+/**
+ * @brief Check if the output is in constant current mode
+ *
+ * Compares how far I_out and V_out are from their settings, weighted to
+ * physical units, using the raw values precomputed by pwrctl_set_vout() and
+ * pwrctl_set_iout(). The output is current limited when I_out is the closer
+ * one. Integer only so it can run from the ADC ISR on every sample.
+ *
+ * @param[in] i_raw Raw I_out ADC value, offset corrected
+ * @param[in] v_raw Raw V_out ADC value
+ * @return true if the output is current limited
+ *
+ * @see isrhook_limit in isrhook.h
+ */
+bool pwrctl_calc_cc_mode(uint32_t i_raw, uint16_t v_raw);
+
+/**
+ * @brief Follow the CV/CC regime of the output with hysteresis
+ *
+ * The output enters CC when V_out has dropped CONFIG_CC_HYSTERESIS_MV below
+ * its setting while I_out is within CONFIG_CC_HYSTERESIS_MA of its limit,
+ * the lower of the current setting and the OCP limit. It returns to CV once
+ * V_out is back within half of that or I_out falls twice as far below the
+ * limit, so noise around either threshold does not toggle the regime.
+ * Integer only so it can run from the ADC ISR on every sample.
+ *
+ * @param[in] i_raw Raw I_out ADC value, offset corrected
+ * @param[in] v_raw Raw V_out ADC value
+ * @param[in] cc    true if the output is current limited now
+ * @return true if the output is current limited after this sample
+ *
+ * @see isrhook_limit in isrhook.h
+ */
+bool pwrctl_calc_cc_regime(uint32_t i_raw, uint16_t v_raw, bool cc);
+
+/**
+ * @brief Report a CV/CC transition from the ADC ISR
+ *
+ * Stamps the transition with cur_time_us() and queues an event_limit_mode,
+ * bit 0 of its data is 1 when the output became current limited.
+ *
+ * @param[in] cc true if the output became current limited
+ * @return false if the event queue was full and the event was dropped
+ */
+bool pwrctl_put_limit_mode(bool cc);
+
+/**
+ * @brief Get the time of the transition reported by an event_limit_mode
+ *
+ * @param[in] data The data of the event
+ * @return cur_time_us() of the ADC sample the transition was detected in
+ */
+uint32_t pwrctl_limit_mode_us(uint8_t data);
+
+#ifdef CONFIG_VOUT_LOOP
+/**
+ * @brief Trim the V_out DAC from the measured output voltage
+ *
+ * Fixed point PI loop correcting the open loop DAC value set by
+ * pwrctl_set_vout() for load regulation errors. Runs once every
+ * 2^VOUT_LOOP_SHIFT calls on the averaged error, the gains are the
+ * V_LOOP_KP and V_LOOP_KI calibration values.
+ *
+ * @param[in] i_raw Raw I_out ADC value, offset corrected
+ * @param[in] v_raw Raw V_out ADC value
+ *
+ * @note Called from the ADC ISR for each sample set
+ */
+void pwrctl_vout_loop(uint32_t i_raw, uint16_t v_raw);
+#endif // CONFIG_VOUT_LOOP
+
+/**
+ * @brief Measurements published by pwrctl_publish()
+ */
+typedef enum {
+    pwrctl_meas_v_in = 0,   /**< V_in in millivolt */
+    pwrctl_meas_v_out,      /**< V_out in millivolt */
+    pwrctl_meas_i_out,      /**< I_out in milliampere */
+    pwrctl_meas_channels
+} pwrctl_meas_t;
+
+/** @brief Change mask bits passed to pwrctl_observer_t */
+#define PWRCTL_MEAS_V_IN   (1 << pwrctl_meas_v_in)
+#define PWRCTL_MEAS_V_OUT  (1 << pwrctl_meas_v_out)
+#define PWRCTL_MEAS_I_OUT  (1 << pwrctl_meas_i_out)
+
+/**
+ * @brief Maximum number of observers, see pwrctl_subscribe()
+ *
+ * Can be overridden by defining CONFIG_PWRCTL_MAX_OBSERVERS at compile time.
+ */
+#ifdef CONFIG_PWRCTL_MAX_OBSERVERS
+ #define PWRCTL_MAX_OBSERVERS (CONFIG_PWRCTL_MAX_OBSERVERS)
+#else
+ #define PWRCTL_MAX_OBSERVERS (4)
+#endif
+
+/**
+ * @brief Called by pwrctl_publish() when measurements changed
+ *
+ * @param[in] changed PWRCTL_MEAS_* mask of the measurements that changed,
+ *                    read them with pwrctl_measured()
+ */
+typedef void (*pwrctl_observer_t)(uint32_t changed);
+
+/**
+ * @brief Convert and publish the latest ADC readings
+ *
+ * A channel whose raw reading is unchanged is not converted again. A
+ * converted value is only published when it differs from the published
+ * one by at least the hysteresis of the channel, the display resolution
+ * by default, so readings dithering below what is shown cause neither
+ * redraws nor notifications. Observers are called if anything was
+ * published. The first call after pwrctl_init() publishes all channels.
+ *
+ * @return PWRCTL_MEAS_* mask of the published measurements
+ *
+ * @note Called from the main loop once per UI tick
+ */
+uint32_t pwrctl_publish(void);
+
+/**
+ * @brief Get a published measurement
+ *
+ * @param[in] meas The measurement
+ * @return The value last published by pwrctl_publish()
+ */
+uint32_t pwrctl_measured(pwrctl_meas_t meas);
+
+/**
+ * @brief Get the raw ADC reading seen by the last pwrctl_publish()
+ *
+ * Unlike pwrctl_measured() this follows every change of the reading.
+ *
+ * @param[in] meas The measurement
+ * @return The raw ADC value
+ */
+uint16_t pwrctl_measured_raw(pwrctl_meas_t meas);
+
+/**
+ * @brief Set the change a measurement needs before it is published
+ *
+ * @param[in] meas       The measurement
+ * @param[in] hysteresis The change in millivolt or milliampere, 0 or 1
+ *                       publishes every change of the converted value
+ */
+void pwrctl_set_hysteresis(pwrctl_meas_t meas, uint32_t hysteresis);
+
+/**
+ * @brief Register an observer of the published measurements
+ *
+ * @param[in] observer Called by pwrctl_publish() with the changes
+ * @return true if registered, false if PWRCTL_MAX_OBSERVERS are registered
+ */
+bool pwrctl_subscribe(pwrctl_observer_t observer);
+
 #endif // __PWRCTL_H__
@@ -0,0 +1,68 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __RAMFUNC_H__
+#define __RAMFUNC_H__
+
+/**
+ * Functions on the ~21kHz ADC sample path can be linked to the .ramfunc
+ * section, which hw_init() copies from flash to SRAM before any interrupt is
+ * enabled (see stm32f100_app.ld). Running from SRAM gives the ISR a timing
+ * that does not depend on flash accesses, measure it with PERF=1 as code
+ * fetches from SRAM share the system bus with data accesses.
+ *
+ * Set RAMFUNC in the Makefile to choose which functions go there:
+ *   1: RAMFUNC_ISR, the ADC ISRs and the OCP/OVP/AWD handling
+ *   2: RAMFUNC_ISR and RAMFUNC_HOOK, the per sample hooks and the pwrctl
+ *      helpers they call
+ *
+ * Each RAM function costs its size in both flash and RAM, and sits below the
+ * stack. Calls between flash and SRAM are out of range for a BL, callers of
+ * a RAM function need long_call and calls out of RAM go through linker veneers.
+ *
+ * FLASH_RAMFUNC (in the app and dpsboot Makefiles) independently moves
+ * RAMFUNC_FLASH, the flash programming loop, to SRAM so it does not stall on
+ * its own instruction fetches while the flash is busy.
+ */
+#define RAMFUNC_SECTION  __attribute__((section(".ramfunc"), long_call, noinline))
+
+#if defined(CONFIG_RAMFUNC) && CONFIG_RAMFUNC >= 1
+ #define RAMFUNC_ISR  RAMFUNC_SECTION
+#else
+ #define RAMFUNC_ISR
+#endif
+
+#if defined(CONFIG_RAMFUNC) && CONFIG_RAMFUNC >= 2
+ #define RAMFUNC_HOOK  RAMFUNC_SECTION
+#else
+ #define RAMFUNC_HOOK
+#endif
+
+#ifdef CONFIG_FLASH_RAMFUNC
+ #define RAMFUNC_FLASH  RAMFUNC_SECTION
+#else
+ #define RAMFUNC_FLASH
+#endif
+
+#endif // __RAMFUNC_H__
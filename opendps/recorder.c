@@ -0,0 +1,180 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "recorder.h"
+#include "tick.h"
+#ifdef CONFIG_SWD_READOUT
+#include "memdesc.h"
+#endif // CONFIG_SWD_READOUT
+
+static uint16_t buffer[RECORDER_SIZE];
+static volatile recorder_state_t state;
+static uint8_t channels, num_channels, triggers;
+static recorder_trigger_t trigger_source;
+static uint64_t trigger_time_us;
+static uint16_t decimation, decimation_count;
+static uint32_t capacity;       /** Whole sample sets that fit in the buffer */
+static uint32_t write_pos;      /** Set to write next */
+static uint32_t num_sets;       /** Sets in the buffer, saturates at capacity */
+static uint32_t post_count, post_remaining;
+#ifdef CONFIG_SWD_READOUT
+static recorder_layout_t layout;
+static memdesc_entry_t *desc_samples, *desc_layout;
+
+void recorder_memdesc(void)
+{
+    desc_samples = memdesc_add(MEMDESC_ID_REC_SAMPLES, buffer, sizeof(buffer));
+    desc_layout = memdesc_add(MEMDESC_ID_REC_LAYOUT, &layout, sizeof(layout));
+}
+
+/**
+  * @brief Describe the finished recording to an SWD reader
+  * @retval None
+  */
+static void publish_layout(void)
+{
+    layout.oldest = (num_sets < capacity ? 0 : write_pos) * num_channels;
+    layout.ring_samples = capacity * num_channels;
+    layout.num_samples = num_sets * num_channels;
+    layout.pre_count = num_sets - post_count;
+    layout.trigger_time_us = trigger_time_us;
+    layout.decimation = decimation;
+    layout.channels = channels;
+    layout.trigger = trigger_source;
+    memdesc_end(desc_layout);
+    memdesc_end(desc_samples);
+}
+#endif // CONFIG_SWD_READOUT
+
+bool recorder_arm(uint8_t cha, uint16_t decim, uint32_t post, uint8_t trig)
+{
+    uint8_t n = !!(cha & RECORDER_CHA_I_OUT) + !!(cha & RECORDER_CHA_V_IN) + !!(cha & RECORDER_CHA_V_OUT);
+    if (n == 0 || (cha & ~RECORDER_CHA_ALL) || decim == 0 || trig == 0 || trig >= (1 << recorder_trigger_max)) {
+        return false;
+    }
+    if (post == 0 || post > RECORDER_SIZE / n) {
+        return false;
+    }
+    /** The ISR leaves the recorder alone while it is idle */
+    state = recorder_idle;
+#ifdef CONFIG_SWD_READOUT
+    memdesc_begin(desc_samples);
+    memdesc_begin(desc_layout);
+#endif // CONFIG_SWD_READOUT
+    channels = cha;
+    num_channels = n;
+    decimation = decim;
+    decimation_count = 0;
+    capacity = RECORDER_SIZE / n;
+    write_pos = 0;
+    num_sets = 0;
+    post_count = post_remaining = post;
+    triggers = trig;
+    if (trig & (1 << recorder_trigger_now)) {
+        trigger_source = recorder_trigger_now;
+        trigger_time_us = get_time_us();
+        state = recorder_triggered;
+    } else {
+        state = recorder_armed;
+    }
+    return true;
+}
+
+void recorder_trigger(recorder_trigger_t source)
+{
+    if (state == recorder_armed && (triggers & (1 << source))) {
+        trigger_source = source;
+        trigger_time_us = get_time_us();
+        state = recorder_triggered;
+    }
+}
+
+void recorder_sample(uint16_t i_out, uint16_t v_in, uint16_t v_out)
+{
+    if (state != recorder_armed && state != recorder_triggered) {
+        return;
+    }
+    if (++decimation_count < decimation) {
+        return;
+    }
+    decimation_count = 0;
+
+    uint16_t *set = &buffer[write_pos * num_channels];
+    if (channels & RECORDER_CHA_I_OUT) {
+        *set++ = i_out;
+    }
+    if (channels & RECORDER_CHA_V_IN) {
+        *set++ = v_in;
+    }
+    if (channels & RECORDER_CHA_V_OUT) {
+        *set = v_out;
+    }
+    if (++write_pos == capacity) {
+        write_pos = 0;
+    }
+    if (num_sets < capacity) {
+        num_sets++;
+    }
+    if (state == recorder_triggered && --post_remaining == 0) {
+        state = recorder_done;
+#ifdef CONFIG_SWD_READOUT
+        publish_layout();
+#endif // CONFIG_SWD_READOUT
+    }
+}
+
+void recorder_get_info(recorder_info_t *info)
+{
+    info->state = state;
+    info->channels = channels;
+    info->decimation = decimation;
+    info->trigger = trigger_source;
+    info->trigger_time_us = trigger_time_us;
+    info->pre_count = 0;
+    info->num_samples = 0;
+    if (state == recorder_done) {
+        info->pre_count = num_sets - post_count;
+        info->num_samples = num_sets * num_channels;
+    }
+}
+
+uint32_t recorder_read(uint32_t offset, uint16_t *samples, uint32_t count)
+{
+    uint32_t total = num_sets * num_channels;
+    uint32_t read = 0;
+    if (state != recorder_done) {
+        return 0;
+    }
+    /** Until the ring has wrapped the oldest set is at the start */
+    uint32_t oldest = num_sets < capacity ? 0 : write_pos;
+    while (read < count && offset < total) {
+        uint32_t set = (oldest + offset / num_channels) % capacity;
+        samples[read++] = buffer[set * num_channels + offset % num_channels];
+        offset++;
+    }
+    return read;
+}
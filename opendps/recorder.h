@@ -0,0 +1,174 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+/**
+ * @file recorder.h
+ * @brief ADC Sample Recorder
+ *
+ * Records raw ADC samples in a RAM ring from the ADC interrupt, allowing
+ * transients such as inrush currents and load steps to be captured at the
+ * full sample rate (~21kHz) and downloaded afterwards.
+ *
+ * ## Operation
+ *
+ * Once armed, the recorder keeps the most recent sample sets in its ring.
+ * When a trigger fires it records another post_count sets and stops, so the
+ * ring holds the sets leading up to the trigger followed by post_count sets
+ * after it. Every decimation:th sample set is recorded, each set holding the
+ * selected channels in the order I_out, V_in, V_out.
+ *
+ * ```
+ * recorder_arm() -> armed -> trigger -> triggered -> post_count sets -> done
+ * ```
+ *
+ * Samples are raw ADC values, I_out with the offset correction applied.
+ *
+ * @note Enabled by CONFIG_ADC_RECORDER, costs 2 * RECORDER_SIZE bytes of RAM
+ */
+
+#ifndef __RECORDER_H__
+#define __RECORDER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** @brief Number of 16 bit samples in the ring */
+#ifndef RECORDER_SIZE
+ #define RECORDER_SIZE  (512)
+#endif
+
+/** @brief Channel selection bits */
+#define RECORDER_CHA_I_OUT  (1 << 0)
+#define RECORDER_CHA_V_IN   (1 << 1)
+#define RECORDER_CHA_V_OUT  (1 << 2)
+#define RECORDER_CHA_ALL    (RECORDER_CHA_I_OUT | RECORDER_CHA_V_IN | RECORDER_CHA_V_OUT)
+
+/**
+ * @brief Trigger sources, recorder_arm() takes a mask of (1 << source)
+ */
+typedef enum {
+    recorder_trigger_now = 0,   /**< Triggered when armed, post_count sets are recorded */
+    recorder_trigger_ocp,       /**< Over current protection tripped */
+    recorder_trigger_ovp,       /**< Over voltage protection tripped */
+    recorder_trigger_max,
+} recorder_trigger_t;
+
+/**
+ * @brief Recorder states
+ */
+typedef enum {
+    recorder_idle = 0,      /**< Nothing recorded */
+    recorder_armed,         /**< Recording, waiting for a trigger */
+    recorder_triggered,     /**< Recording the sets after the trigger */
+    recorder_done,          /**< Recording complete, ready for download */
+} recorder_state_t;
+
+/**
+ * @brief Description of the recording
+ */
+typedef struct {
+    recorder_state_t state;     /**< Current state */
+    uint8_t channels;           /**< RECORDER_CHA_* bits */
+    uint16_t decimation;        /**< Every decimation:th sample set is recorded */
+    recorder_trigger_t trigger; /**< Source that fired, valid once triggered */
+    uint64_t trigger_time_us;   /**< get_time_us() when the trigger fired, valid once triggered */
+    uint32_t pre_count;         /**< Sets recorded before the trigger, valid when done */
+    uint32_t num_samples;       /**< Samples available, valid when done */
+} recorder_info_t;
+
+/**
+ * @brief Where the samples of the last finished recording are in the ring,
+ * for reading it directly over SWD, see memdesc.h
+ *
+ * Sample k of the recording, oldest first, is at ring[(oldest + k) % ring_samples].
+ */
+typedef struct {
+    uint32_t oldest;            /**< Index of the oldest sample */
+    uint32_t ring_samples;      /**< Samples the ring wraps at, whole sets */
+    uint32_t num_samples;       /**< Samples recorded */
+    uint32_t pre_count;         /**< Sets recorded before the trigger */
+    uint64_t trigger_time_us;   /**< get_time_us() when the trigger fired */
+    uint16_t decimation;        /**< Every decimation:th sample set was recorded */
+    uint8_t channels;           /**< RECORDER_CHA_* bits */
+    uint8_t trigger;            /**< recorder_trigger_t that fired */
+} recorder_layout_t;
+
+/**
+ * @brief Start a new recording
+ *
+ * @param channels    RECORDER_CHA_* bits, at least one
+ * @param decimation  Record every decimation:th sample set, at least 1
+ * @param post_count  Number of sets to record after the trigger
+ * @param triggers    Mask of (1 << recorder_trigger_t) that may fire
+ * @return true if the recorder was armed
+ * @return false if the parameters are invalid or post_count sets do not fit
+ */
+bool recorder_arm(uint8_t channels, uint16_t decimation, uint32_t post_count, uint8_t triggers);
+
+/**
+ * @brief Fire a trigger
+ *
+ * Ignored unless the recorder is armed for source.
+ *
+ * @param source The trigger source
+ * @note Called from interrupt context
+ */
+void recorder_trigger(recorder_trigger_t source);
+
+/**
+ * @brief Record one set of ADC samples
+ *
+ * @param i_out Raw I_out sample
+ * @param v_in  Raw V_in sample
+ * @param v_out Raw V_out sample
+ * @note Called from the ADC interrupt for every sample set
+ */
+void recorder_sample(uint16_t i_out, uint16_t v_in, uint16_t v_out);
+
+/**
+ * @brief Describe the current recording
+ *
+ * @param info Filled in with the recording details
+ */
+void recorder_get_info(recorder_info_t *info);
+
+/**
+ * @brief Read recorded samples, oldest first
+ *
+ * @param offset  Index of the first sample to read
+ * @param samples Buffer for the samples
+ * @param count   Maximum number of samples to read
+ * @return Number of samples read, 0 unless the recording is done
+ */
+uint32_t recorder_read(uint32_t offset, uint16_t *samples, uint32_t count);
+
+#ifdef CONFIG_SWD_READOUT
+/**
+ * @brief Add the sample ring and its recorder_layout_t to the RAM descriptor
+ */
+void recorder_memdesc(void);
+#endif // CONFIG_SWD_READOUT
+
+#endif // __RECORDER_H__
@@ -22,24 +22,57 @@
  * THE SOFTWARE.
  */
 
+#include <string.h>
 #include "ringbuf.h"
 
+/** Orders the element accesses with the counter update that publishes them
+  * to the other side, which may be an ISR or in the emulator a thread */
+#define ring_barrier()  __sync_synchronize()
+
 /**
-  * @brief Initialize the ring buffer
+  * @brief Set up a ring buffer
   * @param ring pointer to ring buffer
   * @param buf buffer to store ring buffer data in
-  * @param size size of buffer
+  * @param size size of buffer in bytes
+  * @param shift log2 of the element size
   * @retval none
   */
-void ringbuf_init(ringbuf_t *ring, uint8_t *buf, uint32_t size)
+static void ring_setup(ringbuf_t *ring, uint8_t *buf, uint32_t size, uint32_t shift)
 {
-	ring->buf = (uint16_t*) buf;
-	ring->size = size/2;
+	uint32_t elements = size >> shift;
+	uint32_t capacity = 1;
+	while (capacity * 2 <= elements) {
+		capacity *= 2;
+	}
+	ring->buf = buf;
+	ring->mask = capacity - 1;
+	ring->shift = shift;
 	ring->read = 0;
 	ring->write = 0;
-#ifdef DPS_EMULATOR
-	pthread_mutex_init(&ring->mutex, NULL);
-#endif // DPS_EMULATOR
+}
+
+/**
+  * @brief Initialize a ring buffer of 16 bit words
+  * @param ring pointer to ring buffer
+  * @param buf buffer to store ring buffer data in
+  * @param size size of buffer in bytes
+  * @retval none
+  */
+void ringbuf_init(ringbuf_t *ring, uint8_t *buf, uint32_t size)
+{
+	ring_setup(ring, buf, size, 1);
+}
+
+/**
+  * @brief Initialize a ring buffer of bytes
+  * @param ring pointer to ring buffer
+  * @param buf buffer to store ring buffer data in
+  * @param size size of buffer in bytes
+  * @retval none
+  */
+void ringbuf_init8(ringbuf_t *ring, uint8_t *buf, uint32_t size)
+{
+	ring_setup(ring, buf, size, 0);
 }
 
 /**
@@ -50,19 +83,14 @@ void ringbuf_init(ringbuf_t *ring, uint8_t *buf, uint32_t size)
   */
 bool ringbuf_put(ringbuf_t *ring, uint16_t word)
 {
-    bool success = false;
-#ifdef DPS_EMULATOR
-	pthread_mutex_lock(&ring->mutex);
-#endif // DPS_EMULATOR
-	if (((ring->write + 1) % ring->size) != ring->read) {
-		ring->buf[ring->write++] = word;
-		ring->write %= ring->size;
-		success = true;
+	uint32_t write = ring->write;
+	if (write - ring->read > ring->mask) {
+		return false;
 	}
-#ifdef DPS_EMULATOR
-	pthread_mutex_unlock(&ring->mutex);
-#endif // DPS_EMULATOR
-	return success;
+	((uint16_t*) ring->buf)[write & ring->mask] = word;
+	ring_barrier();
+	ring->write = write + 1;
+	return true;
 }
 
 /**
@@ -73,17 +101,185 @@ bool ringbuf_put(ringbuf_t *ring, uint16_t word)
   */
 bool ringbuf_get(ringbuf_t *ring, uint16_t *word)
 {
-    bool success = false;
-#ifdef DPS_EMULATOR
-	pthread_mutex_lock(&ring->mutex);
-#endif // DPS_EMULATOR
-	if (ring->read != ring->write) {
-		*word = ring->buf[ring->read++];
-		ring->read %= ring->size;
-		success = true;
+	uint32_t read = ring->read;
+	if (read == ring->write) {
+		return false;
+	}
+	ring_barrier();
+	*word = ((uint16_t*) ring->buf)[read & ring->mask];
+	ring_barrier();
+	ring->read = read + 1;
+	return true;
+}
+
+/**
+  * @brief Put a byte into ring buffer
+  * @param ring pointer to ring buffer
+  * @param byte the data to put into the buffer
+  * @retval true if there was room in the buffer for the data
+  */
+bool ringbuf_put8(ringbuf_t *ring, uint8_t byte)
+{
+	uint32_t write = ring->write;
+	if (write - ring->read > ring->mask) {
+		return false;
+	}
+	ring->buf[write & ring->mask] = byte;
+	ring_barrier();
+	ring->write = write + 1;
+	return true;
+}
+
+/**
+  * @brief Get a byte from ring buffer
+  * @param ring pointer to ring buffer
+  * @param byte the data pulled from the ring bufer
+  * @retval false if the ring buffer was empty
+  */
+bool ringbuf_get8(ringbuf_t *ring, uint8_t *byte)
+{
+	uint32_t read = ring->read;
+	if (read == ring->write) {
+		return false;
+	}
+	ring_barrier();
+	*byte = ring->buf[read & ring->mask];
+	ring_barrier();
+	ring->read = read + 1;
+	return true;
+}
+
+/**
+  * @brief Put a block of elements into ring buffer
+  * @param ring pointer to ring buffer
+  * @param data the elements
+  * @param count number of elements
+  * @retval number of elements that fit in the buffer
+  */
+uint32_t ringbuf_put_n(ringbuf_t *ring, const void *data, uint32_t count)
+{
+	const uint8_t *src = data;
+	uint32_t done = 0;
+	while (done < count) {
+		void *span;
+		uint32_t n = ringbuf_write_span(ring, &span);
+		if (!n) {
+			break;
+		}
+		if (n > count - done) {
+			n = count - done;
+		}
+		memcpy(span, src + (done << ring->shift), n << ring->shift);
+		ringbuf_commit(ring, n);
+		done += n;
+	}
+	return done;
+}
+
+/**
+  * @brief Get a block of elements from ring buffer
+  * @param ring pointer to ring buffer
+  * @param data buffer for the elements
+  * @param count maximum number of elements
+  * @retval number of elements copied
+  */
+uint32_t ringbuf_get_n(ringbuf_t *ring, void *data, uint32_t count)
+{
+	uint8_t *dst = data;
+	uint32_t done = 0;
+	while (done < count) {
+		const void *span;
+		uint32_t n = ringbuf_read_span(ring, &span);
+		if (!n) {
+			break;
+		}
+		if (n > count - done) {
+			n = count - done;
+		}
+		memcpy(dst + (done << ring->shift), span, n << ring->shift);
+		ringbuf_consume(ring, n);
+		done += n;
 	}
-#ifdef DPS_EMULATOR
-	pthread_mutex_unlock(&ring->mutex);
-#endif // DPS_EMULATOR
-	return success;
+	return done;
+}
+
+/**
+  * @brief Get number of free elements in ring buffer
+  * @param ring pointer to ring buffer
+  * @retval number of elements that can be put before the buffer is full
+  */
+uint32_t ringbuf_free(ringbuf_t *ring)
+{
+	uint32_t read = ring->read;
+	uint32_t write = ring->write;
+	return ring->mask + 1 - (write - read);
+}
+
+/**
+  * @brief Get number of elements in ring buffer
+  * @param ring pointer to ring buffer
+  * @retval number of elements that can be read
+  */
+uint32_t ringbuf_used(ringbuf_t *ring)
+{
+	uint32_t write = ring->write;
+	uint32_t read = ring->read;
+	return write - read;
+}
+
+/**
+  * @brief Get the oldest contiguous elements of ring buffer
+  * @param ring pointer to ring buffer
+  * @param data pointer to the oldest element
+  * @retval number of contiguous elements that can be read
+  */
+uint32_t ringbuf_read_span(ringbuf_t *ring, const void **data)
+{
+	uint32_t read = ring->read;
+	uint32_t used = ring->write - read;
+	uint32_t index = read & ring->mask;
+	uint32_t to_end = ring->mask + 1 - index;
+	ring_barrier();
+	*data = ring->buf + (index << ring->shift);
+	return used < to_end ? used : to_end;
+}
+
+/**
+  * @brief Remove elements read from a span of ring buffer
+  * @param ring pointer to ring buffer
+  * @param count number of elements read
+  * @retval none
+  */
+void ringbuf_consume(ringbuf_t *ring, uint32_t count)
+{
+	ring_barrier();
+	ring->read += count;
+}
+
+/**
+  * @brief Get the next free contiguous elements of ring buffer
+  * @param ring pointer to ring buffer
+  * @param data pointer to the next free element
+  * @retval number of contiguous elements that can be written
+  */
+uint32_t ringbuf_write_span(ringbuf_t *ring, void **data)
+{
+	uint32_t write = ring->write;
+	uint32_t free = ring->mask + 1 - (write - ring->read);
+	uint32_t index = write & ring->mask;
+	uint32_t to_end = ring->mask + 1 - index;
+	*data = ring->buf + (index << ring->shift);
+	return free < to_end ? free : to_end;
+}
+
+/**
+  * @brief Add elements written to a span of ring buffer
+  * @param ring pointer to ring buffer
+  * @param count number of elements written
+  * @retval none
+  */
+void ringbuf_commit(ringbuf_t *ring, uint32_t count)
+{
+	ring_barrier();
+	ring->write += count;
 }
@@ -27,14 +27,16 @@
  * @brief Lock-Free Ring Buffer Implementation
  *
  * This module provides a simple circular (ring) buffer for producer-consumer
- * scenarios, particularly for UART receive buffering in OpenDPS.
+ * scenarios, such as the USART receive and transmit paths in OpenDPS.
  *
  * ## Design
  *
- * The ring buffer uses separate read and write indices that wrap around
- * when they reach the end of the buffer. This design allows lock-free
- * operation when there is a single producer (ISR) and single consumer
- * (main loop).
+ * The ring buffer holds a power of two number of elements and uses free
+ * running read and write counters. The element of a counter is found by
+ * masking, and the fill level is the difference of the counters, so no
+ * operation divides and all elements can be used. Each counter is written
+ * by one side only, which allows lock-free operation when there is a single
+ * producer (eg. an ISR) and a single consumer (eg. the main loop).
  *
  * ## Buffer Layout
  *
@@ -43,30 +45,31 @@
  * | 0 | 1 | 2 | 3 | 4 | 5 | 6 | 7 |
  * +---+---+---+---+---+---+---+---+
  *         ^read          ^write
- *         (data available: 3, 4)
+ *         (data available: 2, 3, 4)
  * ```
  *
  * ## Usage
  *
- * The buffer stores 16-bit values (uint16_t) to accommodate UART data
- * with status bits. For 8-bit data, only the lower byte is used.
+ * Elements are bytes (ringbuf_init8()) or 16-bit words (ringbuf_init()),
+ * put and get one at a time with the matching ringbuf_put8()/ringbuf_get8()
+ * or ringbuf_put()/ringbuf_get(). Blocks of elements of either width are
+ * moved with ringbuf_put_n()/ringbuf_get_n(). The span functions give
+ * direct access to the contiguous part of the buffer, eg. for a DMA
+ * transfer, which is committed or consumed when done.
  *
  * ```c
  * ringbuf_t rx_buf;
  * uint8_t buffer[64];
- * ringbuf_init(&rx_buf, buffer, sizeof(buffer));
+ * ringbuf_init8(&rx_buf, buffer, sizeof(buffer));
  *
  * // In UART ISR:
- * ringbuf_put(&rx_buf, received_byte);
+ * ringbuf_put8(&rx_buf, received_byte);
  *
  * // In main loop:
- * uint16_t data;
- * if (ringbuf_get(&rx_buf, &data)) {
- *     process_byte(data & 0xFF);
- * }
+ * uint8_t data[16];
+ * uint32_t count = ringbuf_get_n(&rx_buf, data, sizeof(data));
  * ```
  *
- * @note Uses 16-bit elements; size is specified in bytes but used as half
  * @note Thread-safe for single producer, single consumer scenario
  */
 
@@ -76,49 +79,54 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#ifdef DPS_EMULATOR
- #include <pthread.h>
-#endif // DPS_EMULATOR
-
 /**
  * @brief Ring buffer structure
  *
  * Holds the state of a ring buffer including the data pointer
- * and read/write indices. The buffer is allocated externally.
+ * and read/write counters. The buffer is allocated externally.
  */
 typedef struct {
-    uint16_t *buf;      /**< Pointer to buffer storage (uint16_t array) */
-    uint32_t size;      /**< Size of buffer in elements (not bytes) */
-    uint32_t read;      /**< Read index (next position to read from) */
-    uint32_t write;     /**< Write index (next position to write to) */
-#ifdef DPS_EMULATOR
-    pthread_mutex_t mutex;  /**< Mutex for thread safety in emulator */
-#endif // DPS_EMULATOR
+    uint8_t *buf;             /**< Pointer to buffer storage */
+    uint32_t mask;            /**< Number of elements - 1 */
+    uint32_t shift;           /**< log2 of the element size in bytes */
+    volatile uint32_t read;   /**< Elements read since init, written by the consumer only */
+    volatile uint32_t write;  /**< Elements written since init, written by the producer only */
 } ringbuf_t;
 
 /**
- * @brief Initialize a ring buffer
+ * @brief Initialize a ring buffer of 16-bit words
  *
  * Prepares a ring buffer for use by setting up the data pointer
- * and resetting the read/write indices.
+ * and resetting the read/write counters.
  *
  * @param[out] ring Pointer to ring buffer structure to initialize
- * @param[in]  buf  Pointer to buffer storage (will be cast to uint16_t*)
+ * @param[in]  buf  Pointer to buffer storage, 16-bit aligned
  * @param[in]  size Size of buffer storage in bytes
  *
- * @note The buffer must be large enough for at least 2 elements
- * @note The actual number of elements is size/sizeof(uint16_t)
- * @note One element is always empty to distinguish full from empty
+ * @note The number of elements is size/sizeof(uint16_t) rounded down to
+ *       a power of two, the buffer must hold at least one element
  */
 void ringbuf_init(ringbuf_t *ring, uint8_t *buf, uint32_t size);
 
+/**
+ * @brief Initialize a ring buffer of bytes
+ *
+ * @param[out] ring Pointer to ring buffer structure to initialize
+ * @param[in]  buf  Pointer to buffer storage
+ * @param[in]  size Size of buffer storage in bytes
+ *
+ * @note The number of elements is size rounded down to a power of two, the
+ *       buffer must hold at least one element
+ */
+void ringbuf_init8(ringbuf_t *ring, uint8_t *buf, uint32_t size);
+
 /**
  * @brief Put data into the ring buffer
  *
  * Adds a 16-bit word to the ring buffer. If the buffer is full,
  * the operation fails and the data is discarded.
  *
- * @param[in,out] ring Pointer to the ring buffer
+ * @param[in,out] ring Pointer to a ring buffer of words
  * @param[in]     word Data word to add to the buffer
  * @return true if the data was added successfully
  * @return false if the buffer was full (data discarded)
@@ -134,14 +142,122 @@ bool ringbuf_put(ringbuf_t *ring, uint16_t word);
  * Removes and returns the oldest 16-bit word from the ring buffer.
  * If the buffer is empty, the operation fails.
  *
- * @param[in,out] ring Pointer to the ring buffer
+ * @param[in,out] ring Pointer to a ring buffer of words
  * @param[out]    word Pointer to receive the data word
  * @return true if data was retrieved successfully
  * @return false if the buffer was empty (word unchanged)
  *
- * @note Call from main loop, not from ISRs
  * @note Check return value before using *word
  */
 bool ringbuf_get(ringbuf_t *ring, uint16_t *word);
 
+/**
+ * @brief Put a byte into the ring buffer
+ *
+ * @param[in,out] ring Pointer to a ring buffer of bytes
+ * @param[in]     byte Data byte to add to the buffer
+ * @return true if the data was added successfully
+ * @return false if the buffer was full (data discarded)
+ *
+ * @note Safe to call from ISRs
+ */
+bool ringbuf_put8(ringbuf_t *ring, uint8_t byte);
+
+/**
+ * @brief Get a byte from the ring buffer
+ *
+ * @param[in,out] ring Pointer to a ring buffer of bytes
+ * @param[out]    byte Pointer to receive the data byte
+ * @return true if data was retrieved successfully
+ * @return false if the buffer was empty (byte unchanged)
+ *
+ * @note Safe to call from ISRs
+ */
+bool ringbuf_get8(ringbuf_t *ring, uint8_t *byte);
+
+/**
+ * @brief Put a block of elements into the ring buffer
+ *
+ * Copies as many elements as there is room for, in at most two copies.
+ * Check ringbuf_free() first to queue a block in full or not at all.
+ *
+ * @param[in,out] ring  Pointer to the ring buffer
+ * @param[in]     data  Elements of the width of the ring
+ * @param[in]     count Number of elements
+ * @return Number of elements put
+ */
+uint32_t ringbuf_put_n(ringbuf_t *ring, const void *data, uint32_t count);
+
+/**
+ * @brief Get a block of elements from the ring buffer
+ *
+ * @param[in,out] ring  Pointer to the ring buffer
+ * @param[out]    data  Buffer for elements of the width of the ring
+ * @param[in]     count Maximum number of elements to get
+ * @return Number of elements copied, 0 if the buffer was empty
+ */
+uint32_t ringbuf_get_n(ringbuf_t *ring, void *data, uint32_t count);
+
+/**
+ * @brief Get the number of free elements in the ring buffer
+ *
+ * Lets a producer check for room before putting a block of data so that
+ * the block is either queued in full or not at all.
+ *
+ * @param[in] ring Pointer to the ring buffer
+ * @return Number of elements that can be put before the buffer is full
+ *
+ * @note Safe to call from the producer while the consumer runs in an ISR
+ */
+uint32_t ringbuf_free(ringbuf_t *ring);
+
+/**
+ * @brief Get the number of elements in the ring buffer
+ *
+ * @param[in] ring Pointer to the ring buffer
+ * @return Number of elements that can be read
+ *
+ * @note Safe to call from the consumer while the producer runs in an ISR
+ */
+uint32_t ringbuf_used(ringbuf_t *ring);
+
+/**
+ * @brief Get the contiguous readable part of the ring buffer
+ *
+ * The span is the oldest elements up to the end of the buffer storage.
+ * Call ringbuf_consume() once they have been read, eg. by a DMA transfer.
+ *
+ * @param[in]  ring Pointer to the ring buffer
+ * @param[out] data Receives a pointer to the oldest element
+ * @return Number of elements in the span, 0 if the buffer is empty
+ */
+uint32_t ringbuf_read_span(ringbuf_t *ring, const void **data);
+
+/**
+ * @brief Remove elements read through ringbuf_read_span()
+ *
+ * @param[in,out] ring  Pointer to the ring buffer
+ * @param[in]     count Number of elements, at most the span size
+ */
+void ringbuf_consume(ringbuf_t *ring, uint32_t count);
+
+/**
+ * @brief Get the contiguous writable part of the ring buffer
+ *
+ * Call ringbuf_commit() once elements have been written to the span.
+ *
+ * @param[in]  ring Pointer to the ring buffer
+ * @param[out] data Receives a pointer to the next free element
+ * @return Number of elements in the span, 0 if the buffer is full
+ */
+uint32_t ringbuf_write_span(ringbuf_t *ring, void **data);
+
+/**
+ * @brief Add elements written through ringbuf_write_span()
+ *
+ * @param[in,out] ring  Pointer to the ring buffer
+ * @param[in]     count Number of elements, at most the span size
+ */
+void ringbuf_commit(ringbuf_t *ring, uint32_t count);
+
 #endif // __RINGBUF_H__
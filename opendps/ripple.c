@@ -0,0 +1,183 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ripple.h"
+#include "recorder.h"
+#include "wavegen.h"
+
+/** Fractional bits of the samples fed to the filters */
+#define IN_FRAC_BITS  (4)
+
+/** Fractional bits of the Goertzel coefficients 2cos(w) */
+#define COEF_FRAC_BITS  (14)
+
+/** Sample sets read from the recorder at a time */
+#define CHUNK_SETS  (16)
+
+/** A quarter turn of a wavegen phase, turns a sine into a cosine */
+#define QUARTER_TURN  (0x40000000)
+
+/** Reads the samples of one channel from the recording */
+typedef struct {
+    uint32_t stride;    /** Samples per set */
+    uint32_t index;     /** Index of the channel in a set */
+    uint32_t set;       /** Next set to return */
+    uint32_t pos;       /** Next set in buf */
+    uint32_t count;     /** Sets in buf */
+    uint16_t buf[CHUNK_SETS * 3];
+} reader_t;
+
+/**
+  * @brief Count the channels of a RECORDER_CHA_* mask
+  * @param mask the mask
+  * @retval number of channels
+  */
+static uint32_t count_channels(uint8_t mask)
+{
+    return !!(mask & RECORDER_CHA_I_OUT) + !!(mask & RECORDER_CHA_V_IN) + !!(mask & RECORDER_CHA_V_OUT);
+}
+
+/**
+  * @brief Get the next sample of the channel
+  * @param r the reader
+  * @param sample receives the sample
+  * @retval false at the end of the recording
+  */
+static bool reader_next(reader_t *r, uint16_t *sample)
+{
+    if (r->pos == r->count) {
+        r->count = recorder_read(r->set * r->stride, r->buf, CHUNK_SETS * r->stride) / r->stride;
+        r->pos = 0;
+        if (r->count == 0) {
+            return false;
+        }
+    }
+    *sample = r->buf[r->pos++ * r->stride + r->index];
+    r->set++;
+    return true;
+}
+
+/**
+  * @brief Integer square root
+  * @param value the value
+  * @retval floor(sqrt(value))
+  */
+static uint32_t isqrt64(uint64_t value)
+{
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t) root;
+}
+
+bool ripple_analyze(uint8_t channel, uint32_t rate_hz, const uint16_t *freq_hz, uint32_t num_bins, ripple_result_t *result)
+{
+    recorder_info_t info;
+    reader_t r;
+    int32_t coef[RIPPLE_MAX_BINS];
+    int32_t s1[RIPPLE_MAX_BINS] = { 0 };
+    int32_t s2[RIPPLE_MAX_BINS] = { 0 };
+    uint16_t sample;
+
+    recorder_get_info(&info);
+    if (info.state != recorder_done || count_channels(channel) != 1 || !(info.channels & channel) ||
+        num_bins > RIPPLE_MAX_BINS) {
+        return false;
+    }
+    r.stride = count_channels(info.channels);
+    r.index = count_channels(info.channels & (channel - 1));
+    uint32_t n = info.num_samples / r.stride;
+    if (n < RIPPLE_MIN_SAMPLES) {
+        return false;
+    }
+    rate_hz = (rate_hz ? rate_hz : RIPPLE_SAMPLE_HZ) / info.decimation;
+    for (uint32_t i = 0; i < num_bins; i++) {
+        if (2 * (uint32_t) freq_hz[i] >= rate_hz) {
+            return false;
+        }
+        /** 2cos(w) with COEF_FRAC_BITS is cos(w) with 15 */
+        coef[i] = wavegen_sin_q15(QUARTER_TURN + (uint32_t) (((uint64_t) freq_hz[i] << 32) / rate_hz));
+    }
+
+    /** First pass, the mean is removed before the second */
+    uint32_t sum = 0;
+    result->min = 0xffff;
+    result->max = 0;
+    r.set = r.pos = r.count = 0;
+    while (reader_next(&r, &sample)) {
+        sum += sample;
+        result->min = sample < result->min ? sample : result->min;
+        result->max = sample > result->max ? sample : result->max;
+    }
+    result->num_samples = n;
+    result->mean = (((uint64_t) sum << RIPPLE_FRAC_BITS) + n / 2) / n;
+    int32_t mean = result->mean >> (RIPPLE_FRAC_BITS - IN_FRAC_BITS);
+
+    /** Second pass, every filter is fed the Hann windowed samples */
+    uint64_t sum_squares = 0;
+    uint32_t window_step = (uint32_t) ((1ULL << 32) / n);
+    uint32_t window_phase = 0;
+    r.set = r.pos = r.count = 0;
+    while (reader_next(&r, &sample)) {
+        int32_t x = ((int32_t) sample << IN_FRAC_BITS) - mean;
+        sum_squares += (int64_t) x * x;
+        /** (1 - cos) / 2 with 16 fractional bits */
+        int32_t window = (1 << 15) - wavegen_sin_q15(window_phase + QUARTER_TURN);
+        window_phase += window_step;
+        x = (int32_t) (((int64_t) x * window) >> 16);
+        for (uint32_t i = 0; i < num_bins; i++) {
+            int32_t s = x + (int32_t) (((int64_t) coef[i] * s1[i]) >> COEF_FRAC_BITS) - s2[i];
+            s2[i] = s1[i];
+            s1[i] = s;
+        }
+    }
+    result->rms = isqrt64((sum_squares << (2 * (RIPPLE_FRAC_BITS - IN_FRAC_BITS))) / n);
+
+    /** |X|^2 = s1^2 + s2^2 - 2cos(w) s1 s2, a sine of amplitude A gives
+     *  |X| = A * n / 4 through the Hann window */
+    result->dominant = 0;
+    for (uint32_t i = 0; i < num_bins; i++) {
+        int64_t power = (int64_t) s1[i] * s1[i] + (int64_t) s2[i] * s2[i] -
+                        (((int64_t) coef[i] * s1[i]) >> COEF_FRAC_BITS) * s2[i];
+        uint32_t magnitude = isqrt64(power > 0 ? (uint64_t) power : 0);
+        result->amplitude[i] = ((uint64_t) magnitude << (2 + RIPPLE_FRAC_BITS - IN_FRAC_BITS)) / n;
+        if (result->amplitude[i] > result->amplitude[result->dominant]) {
+            result->dominant = i;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+/**
+ * @file ripple.h
+ * @brief Ripple and noise analysis of ADC recordings
+ *
+ * Analyses one channel of a finished recorder.h recording on the device so
+ * the host gets a handful of numbers instead of the raw samples: the mean,
+ * the extremes, the AC RMS and the peak amplitude at up to RIPPLE_MAX_BINS
+ * frequencies chosen by the host.
+ *
+ * Each frequency is one fixed point Goertzel filter fed with the Hann
+ * windowed samples, all filters run in a single pass over the recording.
+ * Frequency resolution is about 2 * rate / samples, a 512 sample V_out
+ * recording at ~21kHz separates tones some 80Hz apart.
+ *
+ * Amplitudes are raw ADC counts with RIPPLE_FRAC_BITS fractional bits, the
+ * host scales them with the ADC calibration of the channel (V_ADC_K, A_ADC_K).
+ *
+ * @note Enabled by CONFIG_RIPPLE, needs CONFIG_ADC_RECORDER
+ */
+
+#ifndef __RIPPLE_H__
+#define __RIPPLE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** @brief Maximum number of frequencies analysed at a time */
+#define RIPPLE_MAX_BINS  (8)
+
+/** @brief Fractional bits of the mean, RMS and amplitudes */
+#define RIPPLE_FRAC_BITS  (8)
+
+/** @brief Fewest samples worth analysing */
+#define RIPPLE_MIN_SAMPLES  (16)
+
+/**
+ * @brief Nominal ADC sample set rate, the rate of an undecimated recording
+ *
+ * The hardware converts at roughly this rate, a host knowing it better
+ * passes its own to ripple_analyze().
+ */
+#ifndef RIPPLE_SAMPLE_HZ
+ #define RIPPLE_SAMPLE_HZ  (21000)
+#endif
+
+/**
+ * @brief Result of an analysis
+ */
+typedef struct {
+    uint32_t num_samples;   /**< Samples of the channel analysed */
+    uint16_t min;           /**< Lowest raw sample */
+    uint16_t max;           /**< Highest raw sample */
+    uint32_t mean;          /**< Mean, RIPPLE_FRAC_BITS fractional bits */
+    uint32_t rms;           /**< RMS of the samples minus the mean, RIPPLE_FRAC_BITS fractional bits */
+    uint8_t dominant;       /**< Index of the largest amplitude */
+    uint32_t amplitude[RIPPLE_MAX_BINS]; /**< Peak amplitude at each frequency, RIPPLE_FRAC_BITS fractional bits */
+} ripple_result_t;
+
+/**
+ * @brief Analyse one channel of the finished recording
+ *
+ * Runs in the caller's context and takes a few ms for a full recording.
+ *
+ * @param channel   One RECORDER_CHA_* bit, the channel must have been recorded
+ * @param rate_hz   Sample set rate of the ADC, 0 for RIPPLE_SAMPLE_HZ. The
+ *                  recording's decimation is applied
+ * @param freq_hz   Frequencies to measure, below half the recording's rate
+ * @param num_bins  Number of frequencies, at most RIPPLE_MAX_BINS
+ * @param result    Filled in with the analysis
+ * @return true if the analysis was done
+ * @return false if no recording is done, it holds fewer than
+ *         RIPPLE_MIN_SAMPLES of the channel or the parameters are invalid
+ */
+bool ripple_analyze(uint8_t channel, uint32_t rate_hz, const uint16_t *freq_hz, uint32_t num_bins, ripple_result_t *result);
+
+#endif // __RIPPLE_H__
@@ -0,0 +1,195 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "tick.h"
+#include "sched.h"
+
+/** Scheduled jobs, soonest first */
+static sched_job_t *jobs;
+
+/** Watched jobs, in the order they were first watched */
+static sched_job_t *watched;
+
+/**
+  * @brief Remove a job from the list
+  * @param job the job
+  * @retval None
+  */
+static void unlink_job(sched_job_t *job)
+{
+    for (sched_job_t **p = &jobs; *p; p = &(*p)->next) {
+        if (*p == job) {
+            *p = job->next;
+            break;
+        }
+    }
+    job->next = NULL;
+    job->active = false;
+}
+
+/**
+  * @brief Insert a job in due order, after jobs with the same due time
+  * @param job the job
+  * @retval None
+  */
+static void link_job(sched_job_t *job)
+{
+    sched_job_t **p = &jobs;
+    while (*p && (*p)->due <= job->due) {
+        p = &(*p)->next;
+    }
+    job->next = *p;
+    *p = job;
+    job->active = true;
+}
+
+void sched_start(sched_job_t *job, void (*func)(void), uint32_t delay_ms, uint32_t period_ms)
+{
+    sched_start_at(job, func, get_time_us() + (uint64_t) delay_ms * 1000, period_ms);
+}
+
+void sched_start_at(sched_job_t *job, void (*func)(void), uint64_t at_us, uint32_t period_ms)
+{
+    if (job->active) {
+        unlink_job(job);
+    }
+    job->func = func;
+    job->period_ms = period_ms;
+    job->due = at_us;
+    link_job(job);
+}
+
+void sched_cancel(sched_job_t *job)
+{
+    if (job->active) {
+        unlink_job(job);
+    }
+}
+
+bool sched_active(sched_job_t *job)
+{
+    return job->active;
+}
+
+void sched_watch(sched_job_t *job, const char *name, uint16_t deadline_ms, bool critical)
+{
+    if (!job->name) {
+        sched_job_t **p = &watched;
+        while (*p) {
+            p = &(*p)->watch_next;
+        }
+        job->watch_next = NULL;
+        *p = job;
+    }
+    job->name = name;
+    job->deadline_ms = deadline_ms;
+    job->critical = critical;
+}
+
+sched_job_t *sched_watched(sched_job_t *prev)
+{
+    return prev ? prev->watch_next : watched;
+}
+
+void sched_reset_stats(void)
+{
+    for (sched_job_t *job = watched; job; job = job->watch_next) {
+        job->runs = 0;
+        job->misses = 0;
+        job->late_max_us = 0;
+        job->run_max_us = 0;
+    }
+}
+
+bool sched_healthy(void)
+{
+    uint64_t now = get_time_us();
+    for (sched_job_t *job = watched; job; job = job->watch_next) {
+        if (job->critical && (!job->active || now > job->due + (uint64_t) job->deadline_ms * 1000)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+  * @brief Account a run of a watched job
+  * @param job the job
+  * @param late_us time the run started after the job was due
+  * @param run_us time the run took
+  * @retval None
+  */
+static void account_run(sched_job_t *job, uint64_t late_us, uint64_t run_us)
+{
+    job->runs++;
+    if (late_us > (uint64_t) job->deadline_ms * 1000 && job->misses < UINT16_MAX) {
+        job->misses++;
+    }
+    if (late_us > job->late_max_us) {
+        job->late_max_us = late_us > UINT32_MAX ? UINT32_MAX : (uint32_t) late_us;
+    }
+    if (run_us > job->run_max_us) {
+        job->run_max_us = run_us > UINT32_MAX ? UINT32_MAX : (uint32_t) run_us;
+    }
+}
+
+bool sched_run_next(void)
+{
+    uint64_t now = get_time_us();
+    if (!jobs || jobs->due > now) {
+        return false;
+    }
+    sched_job_t *job = jobs;
+    uint64_t late_us = now - job->due;
+    unlink_job(job);
+    if (job->period_ms) {
+        uint64_t period_us = (uint64_t) job->period_ms * 1000;
+        job->due += period_us;
+        if (job->due <= now) {
+            job->due = now + period_us;
+        }
+        link_job(job);
+    }
+    job->func();
+    if (job->name) {
+        account_run(job, late_us, get_time_us() - now);
+    }
+    return true;
+}
+
+uint32_t sched_run(void)
+{
+    while (sched_run_next()) {
+    }
+    if (!jobs) {
+        return UINT32_MAX;
+    }
+    /** Round up so the caller does not wake up just before the job is due */
+    uint64_t now = get_time_us();
+    uint64_t wait = jobs->due > now ? (jobs->due - now + 999) / 1000 : 0;
+    return wait > UINT32_MAX ? UINT32_MAX : (uint32_t) wait;
+}
@@ -0,0 +1,189 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file sched.h
+ * @brief Cooperative Job Scheduler
+ *
+ * Modules register periodic and one-shot jobs that the main loop runs when
+ * they are due. Jobs are kept in a list sorted by due time so the main loop
+ * only has to look at the head to know how long it may sleep.
+ *
+ * Jobs are owned by the caller, typically as a static sched_job_t, and run
+ * from the main loop with interrupts enabled. A job may restart or cancel
+ * itself and other jobs.
+ *
+ * ```c
+ * static sched_job_t blink_job;
+ * static void blink(void) { ... }
+ *
+ * sched_start(&blink_job, &blink, 0, 500);  // Now and every 500ms
+ * sched_watch(&blink_job, "blink", 20, true);
+ * ...
+ * while (1) {
+ *     bool idle = !event_get(&event, &data);
+ *     ...
+ *     (void) sched_run();
+ *     if (sched_healthy()) {
+ *         wdog_kick();
+ *     }
+ *     if (idle) {
+ *         hw_wait_for_interrupt();
+ *     }
+ * }
+ * ```
+ *
+ * ## Supervision
+ *
+ * Watched jobs have a deadline, the time they may start after they were
+ * due. The scheduler counts their runs and missed deadlines and keeps the
+ * worst lateness and run time. Critical jobs also check in with every run,
+ * sched_healthy() fails once one of them has not run in time or was
+ * cancelled. Gating the watchdog with it resets a unit whose loop still
+ * spins but no longer runs the jobs that matter.
+ */
+
+#ifndef __SCHED_H__
+#define __SCHED_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief A scheduled job
+ */
+typedef struct sched_job {
+    void (*func)(void);         /**< Called when the job is due */
+    uint64_t due;               /**< get_time_us() at which the job is due */
+    uint32_t period_ms;         /**< Repeat interval, 0 for one-shot jobs */
+    bool active;                /**< True while the job is in the schedule */
+    struct sched_job *next;     /**< Next job in due order */
+    const char *name;           /**< Name of a watched job, NULL if not watched */
+    uint16_t deadline_ms;       /**< Lateness allowed before a run counts as missed */
+    bool critical;              /**< Must run in time for sched_healthy() */
+    uint16_t misses;            /**< Runs that started after the deadline */
+    uint32_t runs;              /**< Runs since the last sched_reset_stats() */
+    uint32_t late_max_us;       /**< Worst start after the due time */
+    uint32_t run_max_us;        /**< Worst run time */
+    struct sched_job *watch_next; /**< Next watched job */
+} sched_job_t;
+
+/**
+ * @brief Start or restart a job
+ *
+ * A job already in the schedule is moved to its new due time.
+ *
+ * @param job       The job
+ * @param func      Function to call when the job is due
+ * @param delay_ms  Time until the first call
+ * @param period_ms Interval of the following calls, 0 for a one-shot job
+ */
+void sched_start(sched_job_t *job, void (*func)(void), uint32_t delay_ms, uint32_t period_ms);
+
+/**
+ * @brief Start or restart a job at an absolute time
+ *
+ * As sched_start() but the first call is due at a get_time_us() time, for
+ * jobs that must run at a time agreed with someone else. A time already
+ * passed is due right away.
+ *
+ * @param job       The job
+ * @param func      Function to call when the job is due
+ * @param at_us     get_time_us() time of the first call
+ * @param period_ms Interval of the following calls, 0 for a one-shot job
+ */
+void sched_start_at(sched_job_t *job, void (*func)(void), uint64_t at_us, uint32_t period_ms);
+
+/**
+ * @brief Remove a job from the schedule
+ *
+ * @param job The job, nothing happens if it is not scheduled
+ */
+void sched_cancel(sched_job_t *job);
+
+/**
+ * @brief Check if a job is scheduled
+ *
+ * @param job The job
+ * @return true if the job will be run
+ */
+bool sched_active(sched_job_t *job);
+
+/**
+ * @brief Watch a job, count its runs, misses and worst timing
+ *
+ * Watching a job again changes its deadline and criticality. The setting
+ * survives restarts of the job.
+ *
+ * @param job         The job
+ * @param name        Short name of the job in reports
+ * @param deadline_ms Time the job may start after it was due
+ * @param critical    True if sched_healthy() should depend on the job
+ */
+void sched_watch(sched_job_t *job, const char *name, uint16_t deadline_ms, bool critical);
+
+/**
+ * @brief Get the watched jobs
+ *
+ * @param prev NULL to get the first job, else the previous job returned
+ * @return The next watched job, NULL after the last one
+ */
+sched_job_t *sched_watched(sched_job_t *prev);
+
+/**
+ * @brief Clear the counters and worst times of all watched jobs
+ */
+void sched_reset_stats(void);
+
+/**
+ * @brief Check that every critical job checks in
+ *
+ * @return false if a critical job is not scheduled or is past its due time
+ *         plus its deadline
+ */
+bool sched_healthy(void);
+
+/**
+ * @brief Run the job that has been due the longest
+ *
+ * Lets the caller do more urgent work between jobs, sched_run() runs them
+ * all at once.
+ *
+ * @return false if no job was due
+ */
+bool sched_run_next(void);
+
+/**
+ * @brief Run all jobs that are due
+ *
+ * Periodic jobs are rescheduled relative to their previous due time so they
+ * do not drift. A job that fell more than one period behind is not run
+ * repeatedly to catch up.
+ *
+ * @return Number of ms until the next job is due, UINT32_MAX if the schedule
+ *         is empty
+ */
+uint32_t sched_run(void);
+
+#endif // __SCHED_H__
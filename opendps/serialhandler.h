@@ -79,6 +79,11 @@
 #ifndef __SERIALHANDER_H__
 #define __SERIALHANDER_H__
 
+#include <stdint.h>
+#include <stdbool.h>
+#include "uframe.h"
+#include "protocol.h"
+
 /**
  * @brief Handle a received serial character
  *
@@ -99,4 +104,99 @@
  */
 void serial_handle_rx_char(char c);
 
+#ifdef CONFIG_SERIAL_PROTOCOL
+/**
+ * @brief Run time based serial protocol tasks
+ *
+ * When streaming has been started with cmd_stream_start, this samples V_out
+ * and I_out at the requested interval and sends a cmd_stream_data frame each
+ * time a batch is complete. It also reverts a baud rate negotiated with
+ * cmd_set_baudrate to the default once the link has been idle for
+ * SERIAL_BAUD_TIMEOUT_MS and sends queued cmd_notify frames.
+ *
+ * @note Called from the main loop, sampling resolution is one systick (1ms)
+ */
+void serial_tick(void);
+
+/**
+ * @def MAX_REGISTERED_COMMANDS
+ * @brief Maximum number of commands added with serial_register_command()
+ */
+#define MAX_REGISTERED_COMMANDS (4)
+
+/** @brief The command may not be part of a cmd_batch */
+#define CMD_FLAG_NO_BATCH  (1 << 0)
+
+/**
+ * @brief Result of a command handler
+ */
+typedef enum {
+    cmd_failed = 0,     /**< A failure response is sent */
+    cmd_success,        /**< A success response is sent */
+    cmd_success_but_i_actually_sent_my_own_status_thank_you_very_much, /**< The handler sent its own response */
+} command_status_t;
+
+/**
+ * @brief Command handler, called with the unescaped frame starting with the command byte
+ */
+typedef command_status_t (*command_handler_t)(frame_t *frame);
+
+/**
+ * @brief Dispatch table entry of a command
+ */
+typedef struct {
+    uint8_t cmd;                 /**< Command id, see command_t */
+    uint8_t min_length;          /**< Shortest valid payload, command byte included */
+    uint8_t flags;               /**< CMD_FLAG_* */
+    command_handler_t handler;   /**< Called for each valid frame */
+} command_entry_t;
+
+/**
+ * @brief Add a command to the protocol dispatch table
+ *
+ * Lets a module handle a command of its own without touching the protocol
+ * handler. Intended to be called once at init, the entry must stay valid.
+ *
+ * @param[in] entry The command entry
+ * @return true if the command was added
+ * @return false if the command id is taken or the table is full
+ */
+bool serial_register_command(const command_entry_t *entry);
+
+/**
+ * @brief Send a response frame to the host
+ *
+ * For handlers added with serial_register_command() that send their own
+ * response. The frame gets the same envelope as the built in responses,
+ * eg. the tag of a cmd_tagged request.
+ *
+ * @param[in] frame The finished frame, the caller still owns it
+ */
+void serial_send_frame(const frame_t *frame);
+
+#ifdef CONFIG_NOTIFY
+/**
+ * @brief Queue a cmd_notify for the host if it subscribed to the event
+ *
+ * The notification is sent by serial_tick(), so it is safe to call while a
+ * command is being handled.
+ *
+ * @param[in] event The state change
+ * @param[in] index Function, screen or parameter index, see notify_event_t
+ * @param[in] value The new value, see notify_event_t
+ */
+void serial_notify(notify_event_t event, uint8_t index, int32_t value);
+
+/**
+ * @brief Check if the host subscribed to an event
+ *
+ * Lets the caller skip the work of detecting a change nobody waits for.
+ *
+ * @param[in] event The state change
+ * @return true if serial_notify() would send the event
+ */
+bool serial_notify_wanted(notify_event_t event);
+#endif // CONFIG_NOTIFY
+#endif // CONFIG_SERIAL_PROTOCOL
+
 #endif // __SERIALHANDER_H__
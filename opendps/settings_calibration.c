@@ -33,9 +33,13 @@
 #include "uui.h"
 #include "uui_number.h"
 #include "dbg_printf.h"
-#include "mini-printf.h"
+#include "numfmt.h"
 #include "dps-model.h"
 #include "ili9163c.h"
+#ifdef CONFIG_ADC_NOISE
+#include "adcnoise.h"
+#include "tft.h"
+#endif // CONFIG_ADC_NOISE
 
 /*
  * This is the implementation of the CV screen. It has two editable values,
@@ -49,14 +53,33 @@ static void calibration_enable(bool _enable);
 static void v_dac_changed(ui_number_t *item);
 static void a_dac_changed(ui_number_t *item);
 static void calibration_tick(void);
-static void activated(void);
 static void past_save(past_t *past);
 static void past_restore(past_t *past);
-static set_param_status_t set_parameter(char *name, char *value);
-static set_param_status_t get_parameter(char *name, char *value, uint32_t value_len);
+static set_param_status_t set_parameter(const char *name, char *value);
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len);
+#ifdef CONFIG_ADC_NOISE
+static void calibration_activated(void);
+static void calibration_deactivated(void);
+#endif // CONFIG_ADC_NOISE
 
 #define SCREEN_ID  (3)
 
+#ifdef CONFIG_ADC_NOISE
+/** The noise histograms of V_in, V_out and I_out below the readings */
+#define HIST_X       (6)
+#define HIST_Y       (98)
+#define HIST_HEIGHT  (12)
+#define HIST_BAR_W   (2)
+#define HIST_SPACING (42)
+
+/** The standard deviation shown left of each ADC reading, saturates at 9.9 */
+#define NOISE_X      (86)
+#define NOISE_MAX    (9900)
+
+/** Window of adcnoise last drawn */
+static uint32_t noise_windows;
+#endif // CONFIG_ADC_NOISE
+
 /* This is the definition of the voltage ADC item in the UI */
 ui_number_t calibration_v_dac = {
     {
@@ -172,23 +195,112 @@ ui_number_t calibration_a_adc = {
     .changed = NULL,
 };
 
+#ifdef CONFIG_ADC_NOISE
+/* The standard deviations of the ADC readings, in milli codes */
+ui_number_t calibration_vin_noise = {
+    {
+        .type = ui_item_number,
+        .id = 12,
+        .x = NOISE_X,
+        .y = 46,
+        .can_focus = false,
+    },
+    .font_size = FONT_FULL_SMALL,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = WHITE,
+    .value = 0,
+    .min = 0,
+    .max = NOISE_MAX,
+    .si_prefix = si_milli,
+    .num_digits = 1,
+    .num_decimals = 1,
+    .unit = unit_none,
+    .changed = NULL,
+};
+
+ui_number_t calibration_v_noise = {
+    {
+        .type = ui_item_number,
+        .id = 12,
+        .x = NOISE_X,
+        .y = 64,
+        .can_focus = false,
+    },
+    .font_size = FONT_FULL_SMALL,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = WHITE,
+    .value = 0,
+    .min = 0,
+    .max = NOISE_MAX,
+    .si_prefix = si_milli,
+    .num_digits = 1,
+    .num_decimals = 1,
+    .unit = unit_none,
+    .changed = NULL,
+};
+
+ui_number_t calibration_a_noise = {
+    {
+        .type = ui_item_number,
+        .id = 12,
+        .x = NOISE_X,
+        .y = 82,
+        .can_focus = false,
+    },
+    .font_size = FONT_FULL_SMALL,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = WHITE,
+    .value = 0,
+    .min = 0,
+    .max = NOISE_MAX,
+    .si_prefix = si_milli,
+    .num_digits = 1,
+    .num_decimals = 1,
+    .unit = unit_none,
+    .changed = NULL,
+};
+#endif // CONFIG_ADC_NOISE
+
+/* The static graphics of the screen */
+static const ui_label_t calibration_labels[] = {
+    { .text = "Vout DAC:", .x = 6, .y = 22 },
+    { .text = "Iout DAC:", .x = 6, .y = 40 },
+    { .text = "Vin ADC:", .x = 6, .y = 58 },
+    { .text = "Vout ADC:", .x = 6, .y = 76 },
+    { .text = "Iout ADC:", .x = 6, .y = 94 },
+};
+
 /* This is the screen definition */
-ui_screen_t calibration_screen = {
+static const ui_screen_desc_t calibration_screen_desc = {
     .id = SCREEN_ID,
     .name = "calibration",
     .icon_data = (uint8_t *) gfx_crosshair,
     .icon_data_len = sizeof(gfx_crosshair),
     .icon_width = GFX_CROSSHAIR_WIDTH,
     .icon_height = GFX_CROSSHAIR_HEIGHT,
-    .activated = &activated,
+    .labels = calibration_labels,
+    .num_labels = sizeof(calibration_labels) / sizeof(calibration_labels[0]),
+#ifdef CONFIG_ADC_NOISE
+    .activated = &calibration_activated,
+    .deactivated = &calibration_deactivated,
+#else
+    .activated = NULL,
     .deactivated = NULL,
+#endif // CONFIG_ADC_NOISE
     .enable = &calibration_enable,
     .past_save = &past_save,
     .past_restore = &past_restore,
     .tick = &calibration_tick,
     .set_parameter = &set_parameter,
     .get_parameter = &get_parameter,
+#ifdef CONFIG_ADC_NOISE
+    .num_items = 8,
+#else
     .num_items = 5,
+#endif // CONFIG_ADC_NOISE
     .parameters = {
         {
             .name = "V_DAC",
@@ -208,7 +320,17 @@ ui_screen_t calibration_screen = {
                (ui_item_t*) &calibration_a_dac,
                (ui_item_t*) &calibration_vin_adc,
                (ui_item_t*) &calibration_v_adc,
-               (ui_item_t*) &calibration_a_adc }
+               (ui_item_t*) &calibration_a_adc,
+#ifdef CONFIG_ADC_NOISE
+               (ui_item_t*) &calibration_vin_noise,
+               (ui_item_t*) &calibration_v_noise,
+               (ui_item_t*) &calibration_a_noise,
+#endif // CONFIG_ADC_NOISE
+             }
+};
+
+ui_screen_t calibration_screen = {
+    .desc = &calibration_screen_desc,
 };
 
 /**
@@ -219,7 +341,7 @@ ui_screen_t calibration_screen = {
  *
  * @retval     set_param_status_t status code
  */
-static set_param_status_t set_parameter(char *name, char *value)
+static set_param_status_t set_parameter(const char *name, char *value)
 {
     int32_t ivalue = atoi(value);
     if (strcmp("V_DAC", name) == 0) {
@@ -253,13 +375,13 @@ static set_param_status_t set_parameter(char *name, char *value)
  *
  * @retval     set_param_status_t status code
  */
-static set_param_status_t get_parameter(char *name, char *value, uint32_t value_len)
+static set_param_status_t get_parameter(const char *name, char *value, uint32_t value_len)
 {
     if (strcmp("V_DAC", name) == 0) {
-        (void) mini_snprintf(value, value_len, "%d", calibration_v_dac.value);
+        (void) numfmt_int(value, value_len, calibration_v_dac.value);
         return ps_ok;
     } else if (strcmp("A_DAC", name) == 0) {
-        (void) mini_snprintf(value, value_len, "%d", calibration_a_dac.value);
+        (void) numfmt_int(value, value_len, calibration_a_dac.value);
         return ps_ok;
     }
     return ps_unknown_name;
@@ -277,13 +399,90 @@ static void calibration_enable(bool enabled)
         pwrctl_set_vlimit(0xFFFF); /** Set the voltage limit to the maximum to prevent OVP (over voltage protection) firing */
         pwrctl_set_ilimit(0xFFFF); /** Set the current limit to the maximum to prevent OCP (over current protection) firing */
         pwrctl_enable_vout(true);
-        hw_set_voltage_dac(calibration_v_dac.value);
+        pwrctl_set_vout_dac(calibration_v_dac.value);
         hw_set_current_dac(calibration_a_dac.value);
     } else {
         pwrctl_enable_vout(false);
     }
 }
 
+#ifdef CONFIG_ADC_NOISE
+/**
+ * @brief      Start the noise windows while the screen is shown
+ */
+static void calibration_activated(void)
+{
+    noise_windows = 0;
+    adcnoise_enable(ADCNOISE_USER_SCREEN, true);
+}
+
+/**
+ * @brief      Stop the noise windows, unless the host reads them
+ */
+static void calibration_deactivated(void)
+{
+    adcnoise_enable(ADCNOISE_USER_SCREEN, false);
+}
+
+/**
+ * @brief      Draw the histogram of a channel, the fullest bin at full height
+ *
+ * @param[in]  stats  The channel
+ * @param[in]  x      Left edge
+ */
+static void draw_histogram(const adcnoise_stats_t *stats, uint32_t x)
+{
+    uint32_t peak = 1;
+    for (uint32_t i = 0; i < ADCNOISE_BINS; i++) {
+        if (stats->hist[i] > peak) {
+            peak = stats->hist[i];
+        }
+    }
+    for (uint32_t i = 0; i < ADCNOISE_BINS; i++) {
+        uint32_t h = (stats->hist[i] * HIST_HEIGHT + peak - 1) / peak;
+        tft_fill(x + i * HIST_BAR_W, HIST_Y, HIST_BAR_W, HIST_HEIGHT - h, BLACK);
+        tft_fill(x + i * HIST_BAR_W, HIST_Y + HIST_HEIGHT - h, HIST_BAR_W, h, WHITE);
+    }
+}
+
+/**
+ * @brief      Show the standard deviation of a channel
+ *
+ * @param      item    The item
+ * @param[in]  stats   The channel
+ */
+static void show_noise(ui_number_t *item, const adcnoise_stats_t *stats)
+{
+    /** Milli codes from ADCNOISE_FRAC_BITS */
+    int32_t value = (int32_t) ((stats->stddev * 1000 + (1 << (ADCNOISE_FRAC_BITS - 1))) >> ADCNOISE_FRAC_BITS);
+    if (value > NOISE_MAX) {
+        value = NOISE_MAX;
+    }
+    if (value != item->value) {
+        item->value = value;
+        item->ui.draw(&item->ui);
+    }
+}
+
+/**
+ * @brief      Update the noise display when a new window is in
+ */
+static void noise_tick(void)
+{
+    adcnoise_t noise;
+    if (!adcnoise_get(&noise) || noise.windows == noise_windows) {
+        return;
+    }
+    noise_windows = noise.windows;
+    show_noise(&calibration_vin_noise, &noise.ch[adcnoise_v_in]);
+    show_noise(&calibration_v_noise, &noise.ch[adcnoise_v_out]);
+    show_noise(&calibration_a_noise, &noise.ch[adcnoise_i_out]);
+    draw_histogram(&noise.ch[adcnoise_v_in], HIST_X);
+    draw_histogram(&noise.ch[adcnoise_v_out], HIST_X + HIST_SPACING);
+    draw_histogram(&noise.ch[adcnoise_i_out], HIST_X + 2 * HIST_SPACING);
+}
+#endif // CONFIG_ADC_NOISE
+
 /**
  * @brief      Callback for when value of the voltage DAC item is changed
  *
@@ -292,7 +491,7 @@ static void calibration_enable(bool enabled)
 static void v_dac_changed(ui_number_t *item)
 {
     if (calibration_screen.is_enabled)
-        hw_set_voltage_dac(item->value);
+        pwrctl_set_vout_dac(item->value);
 }
 
 /**
@@ -306,18 +505,6 @@ static void a_dac_changed(ui_number_t *item)
         hw_set_current_dac(item->value);
 }
 
-/**
- * @brief      Set up any static graphics when the screen is first drawn
- */
-static void activated(void)
-{
-    tft_puts(FONT_FULL_SMALL, "Vout DAC:", 6, 22, 64, 20, WHITE, false);
-    tft_puts(FONT_FULL_SMALL, "Iout DAC:", 6, 40, 64, 20, WHITE, false);
-    tft_puts(FONT_FULL_SMALL, "Vin ADC:" , 6, 58, 64, 20, WHITE, false);
-    tft_puts(FONT_FULL_SMALL, "Vout ADC:", 6, 76, 64, 20, WHITE, false);
-    tft_puts(FONT_FULL_SMALL, "Iout ADC:", 6, 94, 64, 20, WHITE, false);
-}
-
 /**
  * @brief      Save persistent parameters
  *
@@ -349,8 +536,9 @@ static void past_restore(past_t *past)
 static void calibration_tick(void)
 {
     /** Continously update the ADC displayed values */
-    uint16_t i_out_raw, v_in_raw, v_out_raw;
-    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
+    uint16_t i_out_raw = pwrctl_measured_raw(pwrctl_meas_i_out);
+    uint16_t v_in_raw = pwrctl_measured_raw(pwrctl_meas_v_in);
+    uint16_t v_out_raw = pwrctl_measured_raw(pwrctl_meas_v_out);
 
     if (v_in_raw != calibration_vin_adc.value) {
         calibration_vin_adc.value = v_in_raw;
@@ -366,6 +554,10 @@ static void calibration_tick(void)
         calibration_a_adc.value = i_out_raw;
         calibration_a_adc.ui.draw(&calibration_a_adc.ui);
     }
+
+#ifdef CONFIG_ADC_NOISE
+    noise_tick();
+#endif // CONFIG_ADC_NOISE
 }
 
 /**
@@ -380,6 +572,11 @@ void settings_calibration_init(uui_t *ui)
     number_init(&calibration_vin_adc);
     number_init(&calibration_v_adc);
     number_init(&calibration_a_adc);
+#ifdef CONFIG_ADC_NOISE
+    number_init(&calibration_vin_noise);
+    number_init(&calibration_v_noise);
+    number_init(&calibration_a_noise);
+#endif // CONFIG_ADC_NOISE
 
     uui_add_screen(ui, &calibration_screen);
 }
@@ -0,0 +1,194 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gfx-crosshair.h"
+#include "settings_energy.h"
+#include "energy.h"
+#include "uui.h"
+#include "uui_number.h"
+#include "tft.h"
+#include "ili9163c.h"
+
+/*
+ * This is the implementation of the energy meter screen, a read only screen
+ * showing the charge and energy delivered on the output and the time it was
+ * on since the last reset, see energy.h. The totals keep counting while the
+ * screen is shown and are reset with cmd_energy_stats.
+ */
+
+static void energy_screen_tick(void);
+
+#define SCREEN_ID  (8)
+
+/* Charge in uAh, shown in Ah */
+ui_number_t energy_charge = {
+    {
+        .type = ui_item_number,
+        .id = 10,
+        .x = 121,
+        .y = 10,
+        .can_focus = false,
+    },
+    .font_size = FONT_FULL_SMALL,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = WHITE,
+    .value = 0,
+    .min = 0,
+    .max = 99999999,
+    .si_prefix = si_micro,
+    .num_digits = 2,
+    .num_decimals = 3,
+    .unit = unit_none,
+    .changed = NULL,
+};
+
+/* Energy in uWh, shown in Wh */
+ui_number_t energy_energy = {
+    {
+        .type = ui_item_number,
+        .id = 11,
+        .x = 121,
+        .y = 28,
+        .can_focus = false,
+    },
+    .font_size = FONT_FULL_SMALL,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = WHITE,
+    .value = 0,
+    .min = 0,
+    .max = 99999999,
+    .si_prefix = si_micro,
+    .num_digits = 2,
+    .num_decimals = 3,
+    .unit = unit_none,
+    .changed = NULL,
+};
+
+/* Time the output was on in ms, shown in seconds */
+ui_number_t energy_runtime = {
+    {
+        .type = ui_item_number,
+        .id = 12,
+        .x = 121,
+        .y = 46,
+        .can_focus = false,
+    },
+    .font_size = FONT_FULL_SMALL,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = WHITE,
+    .value = 0,
+    .min = 0,
+    .max = 99999999,
+    .si_prefix = si_milli,
+    .num_digits = 5,
+    .num_decimals = 0,
+    .unit = unit_none,
+    .changed = NULL,
+};
+
+/* The static graphics of the screen */
+static const ui_label_t energy_labels[] = {
+    { .text = "Ah:", .x = 6, .y = 22 },
+    { .text = "Wh:", .x = 6, .y = 40 },
+    { .text = "On s:", .x = 6, .y = 58 },
+};
+
+/* This is the screen definition */
+static const ui_screen_desc_t energy_screen_desc = {
+    .id = SCREEN_ID,
+    .name = "energy",
+    .icon_data = (uint8_t *) gfx_crosshair,
+    .icon_data_len = sizeof(gfx_crosshair),
+    .icon_width = GFX_CROSSHAIR_WIDTH,
+    .icon_height = GFX_CROSSHAIR_HEIGHT,
+    .labels = energy_labels,
+    .num_labels = sizeof(energy_labels) / sizeof(energy_labels[0]),
+    .activated = NULL,
+    .deactivated = NULL,
+    .enable = NULL,
+    .past_save = NULL,
+    .past_restore = NULL,
+    .tick = &energy_screen_tick,
+    .set_parameter = NULL,
+    .get_parameter = NULL,
+    .num_items = 3,
+    .parameters = {
+        {
+            .name = {'\0'} /** Terminator */
+        },
+    },
+    .items = { (ui_item_t*) &energy_charge,
+               (ui_item_t*) &energy_energy,
+               (ui_item_t*) &energy_runtime }
+};
+
+ui_screen_t energy_screen = {
+    .desc = &energy_screen_desc,
+};
+
+/**
+ * @brief      Redraw an item if its value changed
+ *
+ * @param      item   The item
+ * @param[in]  value  The new value, clamped to the item maximum
+ */
+static void update(ui_number_t *item, uint32_t value)
+{
+    int32_t v = value > (uint32_t) item->max ? item->max : (int32_t) value;
+    if (v != item->value) {
+        item->value = v;
+        item->ui.draw(&item->ui);
+    }
+}
+
+/**
+ * @brief      Update the UI with the current totals
+ */
+static void energy_screen_tick(void)
+{
+    energy_stats_t stats;
+    energy_get(&stats);
+    update(&energy_charge, stats.charge_uah);
+    update(&energy_energy, stats.energy_uwh);
+    update(&energy_runtime, stats.runtime_ms);
+}
+
+/**
+ * @brief      Initialise the energy screen and add it to the UI
+ *
+ * @param      ui    The user interface
+ */
+void settings_energy_init(uui_t *ui)
+{
+    number_init(&energy_charge);
+    number_init(&energy_energy);
+    number_init(&energy_runtime);
+
+    uui_add_screen(ui, &energy_screen);
+}
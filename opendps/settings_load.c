@@ -0,0 +1,221 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gfx-crosshair.h"
+#include "settings_load.h"
+#include "load.h"
+#include "uui.h"
+#include "uui_number.h"
+#include "tft.h"
+#include "ili9163c.h"
+
+/*
+ * This is the implementation of the CPU load screen, a read only debug screen
+ * showing the idle time of the main loop, the time spent in the ADC ISR, the
+ * longest ISR run and the number of ISR overruns. The figures are those of
+ * the last LOAD_WINDOW_MS window, see load.h.
+ */
+
+static void load_screen_tick(void);
+
+#define SCREEN_ID  (7)
+
+/* Main loop idle time in 1/1000 of the window, shown in percent */
+ui_number_t load_idle = {
+    {
+        .type = ui_item_number,
+        .id = 10,
+        .x = 121,
+        .y = 10,
+        .can_focus = false,
+    },
+    .font_size = FONT_FULL_SMALL,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = WHITE,
+    .value = 0,
+    .min = 0,
+    .max = 1000,
+    .si_prefix = si_deci,
+    .num_digits = 3,
+    .num_decimals = 1,
+    .unit = unit_none,
+    .changed = NULL,
+};
+
+/* ADC ISR time in 1/1000 of the window, shown in percent */
+ui_number_t load_isr = {
+    {
+        .type = ui_item_number,
+        .id = 11,
+        .x = 121,
+        .y = 28,
+        .can_focus = false,
+    },
+    .font_size = FONT_FULL_SMALL,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = WHITE,
+    .value = 0,
+    .min = 0,
+    .max = 1000,
+    .si_prefix = si_deci,
+    .num_digits = 3,
+    .num_decimals = 1,
+    .unit = unit_none,
+    .changed = NULL,
+};
+
+/* Longest ADC ISR run in microseconds */
+ui_number_t load_isr_max = {
+    {
+        .type = ui_item_number,
+        .id = 12,
+        .x = 121,
+        .y = 46,
+        .can_focus = false,
+    },
+    .font_size = FONT_FULL_SMALL,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = WHITE,
+    .value = 0,
+    .min = 0,
+    .max = 65535,
+    .si_prefix = si_none,
+    .num_digits = 5,
+    .num_decimals = 0,
+    .unit = unit_none,
+    .changed = NULL,
+};
+
+/* ADC ISR overruns since power up */
+ui_number_t load_overruns = {
+    {
+        .type = ui_item_number,
+        .id = 13,
+        .x = 121,
+        .y = 64,
+        .can_focus = false,
+    },
+    .font_size = FONT_FULL_SMALL,
+    .alignment = ui_text_right_aligned,
+    .pad_dot = false,
+    .color = WHITE,
+    .value = 0,
+    .min = 0,
+    .max = 99999,
+    .si_prefix = si_none,
+    .num_digits = 5,
+    .num_decimals = 0,
+    .unit = unit_none,
+    .changed = NULL,
+};
+
+/* The static graphics of the screen */
+static const ui_label_t load_labels[] = {
+    { .text = "Idle %:", .x = 6, .y = 22 },
+    { .text = "ISR %:", .x = 6, .y = 40 },
+    { .text = "ISR us:", .x = 6, .y = 58 },
+    { .text = "Overruns:", .x = 6, .y = 76 },
+};
+
+/* This is the screen definition */
+static const ui_screen_desc_t load_screen_desc = {
+    .id = SCREEN_ID,
+    .name = "load",
+    .icon_data = (uint8_t *) gfx_crosshair,
+    .icon_data_len = sizeof(gfx_crosshair),
+    .icon_width = GFX_CROSSHAIR_WIDTH,
+    .icon_height = GFX_CROSSHAIR_HEIGHT,
+    .labels = load_labels,
+    .num_labels = sizeof(load_labels) / sizeof(load_labels[0]),
+    .activated = NULL,
+    .deactivated = NULL,
+    .enable = NULL,
+    .past_save = NULL,
+    .past_restore = NULL,
+    .tick = &load_screen_tick,
+    .set_parameter = NULL,
+    .get_parameter = NULL,
+    .num_items = 4,
+    .parameters = {
+        {
+            .name = {'\0'} /** Terminator */
+        },
+    },
+    .items = { (ui_item_t*) &load_idle,
+               (ui_item_t*) &load_isr,
+               (ui_item_t*) &load_isr_max,
+               (ui_item_t*) &load_overruns }
+};
+
+ui_screen_t load_screen = {
+    .desc = &load_screen_desc,
+};
+
+/**
+ * @brief      Redraw an item if its value changed
+ *
+ * @param      item   The item
+ * @param[in]  value  The new value, clamped to the item maximum
+ */
+static void update(ui_number_t *item, uint32_t value)
+{
+    int32_t v = value > (uint32_t) item->max ? item->max : (int32_t) value;
+    if (v != item->value) {
+        item->value = v;
+        item->ui.draw(&item->ui);
+    }
+}
+
+/**
+ * @brief      Update the UI with the last closed load window
+ */
+static void load_screen_tick(void)
+{
+    load_stats_t stats;
+    load_get(&stats);
+    update(&load_idle, stats.idle_permille);
+    update(&load_isr, stats.isr_permille);
+    update(&load_isr_max, stats.isr_max_us);
+    update(&load_overruns, stats.overruns);
+}
+
+/**
+ * @brief      Initialise the load screen and add it to the UI
+ *
+ * @param      ui    The user interface
+ */
+void settings_load_init(uui_t *ui)
+{
+    number_init(&load_idle);
+    number_init(&load_isr);
+    number_init(&load_isr_max);
+    number_init(&load_overruns);
+
+    uui_add_screen(ui, &load_screen);
+}
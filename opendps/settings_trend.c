@@ -0,0 +1,208 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Cyril Russo (github.com/X-Ryl669)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gfx-crosshair.h"
+#include "settings_trend.h"
+#include "uui.h"
+#include "uui_graph.h"
+#include "hw.h"
+#include "sched.h"
+#include "pwrctl.h"
+#include "opendps.h"
+#include "dps-model.h"
+#include "tft.h"
+#include "ili9163c.h"
+
+/*
+ * This is the implementation of the trend screen, a read only screen plotting
+ * the history of V_out and I_out over the whole display. The output is
+ * sampled every CONFIG_TREND_SAMPLE_MS whatever screen is shown and
+ * CONFIG_TREND_DECIMATION samples are averaged into one column, so the
+ * history is there when the screen is opened.
+ *
+ * The V axis spans 0 to the input voltage at power up, rounded up to a
+ * whole volt, as the output cannot go above it. The I axis spans 0 to
+ * CONFIG_DPS_MAX_CURRENT.
+ */
+
+static void trend_screen_tick(void);
+static void activated(void);
+static void deactivated(void);
+
+#define SCREEN_ID  (10)
+
+#ifndef CONFIG_TREND_SAMPLE_MS
+ #define CONFIG_TREND_SAMPLE_MS  (50)
+#endif // CONFIG_TREND_SAMPLE_MS
+
+/** With the defaults a column is 250ms and the display shows 32s */
+#ifndef CONFIG_TREND_DECIMATION
+ #define CONFIG_TREND_DECIMATION  (5)
+#endif // CONFIG_TREND_DECIMATION
+
+#define TREND_HEIGHT  (128)
+
+/** Trace order in the graph, V_out is drawn on top */
+#define TRACE_I  (0)
+#define TRACE_V  (1)
+
+static sched_job_t sample_job;
+static uint32_t v_scale; /** mV at the top of the graph, 0 until V_in is known */
+static uint32_t v_sum, i_sum;
+static uint32_t num_samples;
+
+/* The history of I_out and V_out */
+ui_graph_t trend_graph = {
+    {
+        .type = ui_item_graph,
+        .id = 10,
+        .x = 0,
+        .y = 0,
+        .can_focus = false,
+    },
+    .height = TREND_HEIGHT,
+    .bg_color = BLACK,
+    .colors = { CYAN, YELLOW },
+};
+
+/* This is the screen definition */
+static const ui_screen_desc_t trend_screen_desc = {
+    .id = SCREEN_ID,
+    .name = "trend",
+    .icon_data = (uint8_t *) gfx_crosshair,
+    .icon_data_len = sizeof(gfx_crosshair),
+    .icon_width = GFX_CROSSHAIR_WIDTH,
+    .icon_height = GFX_CROSSHAIR_HEIGHT,
+    .activated = &activated,
+    .deactivated = &deactivated,
+    .enable = NULL,
+    .past_save = NULL,
+    .past_restore = NULL,
+    .tick = &trend_screen_tick,
+    .set_parameter = NULL,
+    .get_parameter = NULL,
+    .num_items = 1,
+    .parameters = {
+        {
+            .name = {'\0'} /** Terminator */
+        },
+    },
+    .items = { (ui_item_t*) &trend_graph }
+};
+
+ui_screen_t trend_screen = {
+    .desc = &trend_screen_desc,
+};
+
+/**
+ * @brief      Take over the display, the graph scrolls all of it
+ */
+static void activated(void)
+{
+    opendps_show_status_bar(false);
+    /** The screen icon was drawn into the graph, draw it again */
+    trend_graph.ui.needs_full_redraw = true;
+    trend_graph.ui.draw(&trend_graph.ui);
+    trend_graph.ui.needs_redraw = false;
+}
+
+/**
+ * @brief      Scroll back and give the status bar its place back
+ */
+static void deactivated(void)
+{
+    tft_set_scroll(0);
+    tft_clear();
+    opendps_show_status_bar(true);
+}
+
+/**
+ * @brief      Scroll in the columns recorded since the last tick
+ */
+static void trend_screen_tick(void)
+{
+    /** A temperature lockout shows the status bar again when it ends */
+    opendps_show_status_bar(false);
+    if (trend_graph.ui.needs_redraw) {
+        trend_graph.ui.draw(&trend_graph.ui);
+        trend_graph.ui.needs_redraw = false;
+    }
+}
+
+/**
+ * @brief      Convert a value to a graph level
+ *
+ * @param[in]  value  The value
+ * @param[in]  scale  The value at the top of the graph
+ *
+ * @return     The level, 0 to TREND_HEIGHT-1
+ */
+static uint8_t level(uint32_t value, uint32_t scale)
+{
+    if (value >= scale) {
+        return TREND_HEIGHT - 1;
+    }
+    return value * (TREND_HEIGHT - 1) / scale;
+}
+
+/**
+ * @brief      Sample the output, push a column every CONFIG_TREND_DECIMATION
+ *             samples
+ */
+static void trend_sample(void)
+{
+    uint16_t i_out_raw, v_in_raw, v_out_raw;
+    hw_get_adc_values(&i_out_raw, &v_in_raw, &v_out_raw);
+    if (!v_scale) {
+        v_scale = (pwrctl_calc_vin(v_in_raw) + 999) / 1000 * 1000;
+        if (!v_scale) {
+            return; /** No ADC reading yet */
+        }
+    }
+    v_sum += pwrctl_calc_vout(v_out_raw);
+    i_sum += pwrctl_calc_iout(i_out_raw);
+    if (++num_samples == CONFIG_TREND_DECIMATION) {
+        uint8_t levels[GRAPH_TRACES];
+        levels[TRACE_I] = level(i_sum / CONFIG_TREND_DECIMATION, CONFIG_DPS_MAX_CURRENT);
+        levels[TRACE_V] = level(v_sum / CONFIG_TREND_DECIMATION, v_scale);
+        graph_push(&trend_graph, levels);
+        v_sum = i_sum = 0;
+        num_samples = 0;
+    }
+}
+
+/**
+ * @brief      Initialise the trend screen and add it to the UI
+ *
+ * @param      ui    The user interface
+ */
+void settings_trend_init(uui_t *ui)
+{
+    graph_init(&trend_graph);
+
+    uui_add_screen(ui, &trend_screen);
+    sched_start(&sample_job, &trend_sample, CONFIG_TREND_SAMPLE_MS, CONFIG_TREND_SAMPLE_MS);
+}
@@ -30,6 +30,8 @@
 #include <errno.h>
 #include "spi_driver.h"
 #include "hw.h"
+#include "perf.h"
+#include "probe.h"
 
 /** Used to keep track of the SPI DMA status */
 typedef enum {
@@ -40,6 +42,23 @@ typedef enum {
 
 static volatile spi_status_t dma_status;
 
+/** A queued asynchronous transmission */
+typedef struct {
+    const uint8_t *buf;
+    uint32_t len;
+    spi_callback_t done;
+    void *ctx;
+} spi_transfer_t;
+
+/** Pending asynchronous transmissions, queue[queue_head] is on the wire
+  * while async_running is set */
+static spi_transfer_t queue[SPI_QUEUE_DEPTH];
+static volatile uint32_t queue_head;
+static volatile uint32_t queue_tail;
+static volatile bool async_running;
+
+static void start_tx_dma(const uint8_t *tx_buf, uint32_t tx_len);
+
 /** The DPS5005 has NSS grounded meaning we do not have to toggle it */
 #define SPI_NSS_GROUNDED
 
@@ -50,6 +69,8 @@ static volatile spi_status_t dma_status;
 void spi_init(void)
 {
     dma_status = spi_idle;
+    queue_head = queue_tail = 0;
+    async_running = false;
 
     rcc_periph_clock_enable(RCC_SPI2);
     rcc_periph_clock_enable(RCC_DMA1);
@@ -80,6 +101,10 @@ bool spi_dma_transceive(uint8_t *tx_buf, uint32_t tx_len, uint8_t *rx_buf, uint3
     if (!rx_len && !tx_len) {
         return false;
     }
+    PERF_BEGIN(perf_spi_dma);
+    PROBE_HIGH(PROBE_SPI);
+
+    spi_dma_fence();
 
     dma_channel_reset(DMA1, DMA_CHANNEL4);
     dma_channel_reset(DMA1, DMA_CHANNEL5);
@@ -149,9 +174,196 @@ bool spi_dma_transceive(uint8_t *tx_buf, uint32_t tx_len, uint8_t *rx_buf, uint3
     gpio_set(GPIOB, GPIO12);
 #endif // SPI_NSS_GROUNDED
 
+    PROBE_LOW(PROBE_SPI);
+    PERF_END(perf_spi_dma);
+    return true;
+}
+
+/**
+  * @brief Send a few bytes on the SPI bus without DMA
+  * @param tx_buf transmit buffer
+  * @param tx_len transmit buffer size
+  * @retval true if operation succeeded
+  *         false if parameter error
+  */
+bool spi_write_polled(const uint8_t *tx_buf, uint32_t tx_len)
+{
+    if (!tx_buf || !tx_len) {
+        return false;
+    }
+
+    spi_dma_fence();
+
+#ifdef TFT_CSN_PORT
+    gpio_clear(TFT_CSN_PORT, TFT_CSN_PIN);
+#endif
+#ifndef SPI_NSS_GROUNDED
+    gpio_clear(GPIOB, GPIO12);
+#endif // SPI_NSS_GROUNDED
+
+    while (tx_len--) {
+        while (!(SPI_SR(SPI2) & SPI_SR_TXE)) ;
+        SPI_DR(SPI2) = *tx_buf++;
+    }
+    while (!(SPI_SR(SPI2) & SPI_SR_TXE)) ;
+    while (SPI_SR(SPI2) & SPI_SR_BSY) ;
+
+#ifdef TFT_CSN_PORT
+    gpio_set(TFT_CSN_PORT, TFT_CSN_PIN);
+#endif
+#ifndef SPI_NSS_GROUNDED
+    gpio_set(GPIOB, GPIO12);
+#endif // SPI_NSS_GROUNDED
+
+    return true;
+}
+
+/**
+  * @brief Send the same 16 bit word repeatedly on the SPI bus
+  * @param value the word to send, MSB first
+  * @param count number of times to send it
+  * @retval true if operation succeeded
+  *         false if parameter error
+  */
+bool spi_dma_fill16(uint16_t value, uint32_t count)
+{
+    uint16_t fill = value;
+
+    if (!count) {
+        return false;
+    }
+
+    spi_dma_fence();
+
+    volatile uint8_t temp __attribute__ ((unused));
+    while (SPI_SR(SPI2) & (SPI_SR_RXNE | SPI_SR_OVR)) {
+        temp = SPI_DR(SPI2);
+    }
+
+#ifdef TFT_CSN_PORT
+    gpio_clear(TFT_CSN_PORT, TFT_CSN_PIN);
+#endif
+
+    /** A 16 bit frame lets the DMA resend one word without incrementing */
+    spi_disable(SPI2);
+    spi_set_dff_16bit(SPI2);
+    spi_enable(SPI2);
+
+    while (count) {
+        uint32_t len = count > 0xffff ? 0xffff : count;
+        dma_channel_reset(DMA1, DMA_CHANNEL5);
+        dma_status = spi_tx_running;
+        dma_set_peripheral_address(DMA1, DMA_CHANNEL5, (uint32_t)&SPI2_DR);
+        dma_set_memory_address(DMA1, DMA_CHANNEL5, (uint32_t)&fill);
+        dma_set_number_of_data(DMA1, DMA_CHANNEL5, len);
+        dma_set_read_from_memory(DMA1, DMA_CHANNEL5);
+        dma_disable_memory_increment_mode(DMA1, DMA_CHANNEL5);
+        dma_set_peripheral_size(DMA1, DMA_CHANNEL5, DMA_CCR_PSIZE_16BIT);
+        dma_set_memory_size(DMA1, DMA_CHANNEL5, DMA_CCR_MSIZE_16BIT);
+        dma_set_priority(DMA1, DMA_CHANNEL5, DMA_CCR_PL_HIGH);
+        dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL5);
+        dma_enable_channel(DMA1, DMA_CHANNEL5);
+        spi_enable_tx_dma(SPI2);
+        /** @todo Add timeout for SPI transmission */
+        while (dma_status != spi_idle) ;
+        count -= len;
+    }
+
+    while (!(SPI_SR(SPI2) & SPI_SR_TXE)) ;
+    while (SPI_SR(SPI2) & SPI_SR_BSY) ;
+    spi_disable(SPI2);
+    spi_set_dff_8bit(SPI2);
+    spi_enable(SPI2);
+
+#ifdef TFT_CSN_PORT
+    gpio_set(TFT_CSN_PORT, TFT_CSN_PIN);
+#endif
+
     return true;
 }
 
+/**
+  * @brief Start a TX only DMA transfer of the data at the queue head
+  * @param tx_buf transmit buffer
+  * @param tx_len transmit buffer size
+  * @retval None
+  */
+static void start_tx_dma(const uint8_t *tx_buf, uint32_t tx_len)
+{
+    dma_channel_reset(DMA1, DMA_CHANNEL5);
+    dma_status = spi_tx_running;
+    dma_set_peripheral_address(DMA1, DMA_CHANNEL5, (uint32_t)&SPI2_DR);
+    dma_set_memory_address(DMA1, DMA_CHANNEL5, (uint32_t)tx_buf);
+    dma_set_number_of_data(DMA1, DMA_CHANNEL5, tx_len);
+    dma_set_read_from_memory(DMA1, DMA_CHANNEL5);
+    dma_enable_memory_increment_mode(DMA1, DMA_CHANNEL5);
+    dma_set_peripheral_size(DMA1, DMA_CHANNEL5, DMA_CCR_PSIZE_8BIT);
+    dma_set_memory_size(DMA1, DMA_CHANNEL5, DMA_CCR_MSIZE_8BIT);
+    dma_set_priority(DMA1, DMA_CHANNEL5, DMA_CCR_PL_HIGH);
+    dma_enable_transfer_complete_interrupt(DMA1, DMA_CHANNEL5);
+    dma_enable_channel(DMA1, DMA_CHANNEL5);
+    spi_enable_tx_dma(SPI2);
+}
+
+/**
+  * @brief Queue data for transmission on the SPI bus
+  * @param tx_buf transmit buffer, must stay valid until done is called
+  * @param tx_len transmit buffer size
+  * @param done completion callback (may be NULL), called from the DMA ISR
+  * @param ctx argument passed to done
+  * @retval true if the transfer was queued
+  *         false if parameter error
+  */
+bool spi_dma_transmit_async(const uint8_t *tx_buf, uint32_t tx_len, spi_callback_t done, void *ctx)
+{
+    if (!tx_buf || !tx_len) {
+        return false;
+    }
+
+    uint32_t next = (queue_tail + 1) % SPI_QUEUE_DEPTH;
+    /** Queue full, wait for the ISR to retire the transfer on the wire */
+    while (next == queue_head) ;
+
+    nvic_disable_irq(NVIC_DMA1_CHANNEL5_IRQ);
+    queue[queue_tail].buf = tx_buf;
+    queue[queue_tail].len = tx_len;
+    queue[queue_tail].done = done;
+    queue[queue_tail].ctx = ctx;
+    queue_tail = next;
+    if (!async_running) {
+        async_running = true;
+        volatile uint8_t temp __attribute__ ((unused));
+        while (SPI_SR(SPI2) & (SPI_SR_RXNE | SPI_SR_OVR)) {
+            temp = SPI_DR(SPI2);
+        }
+#ifdef TFT_CSN_PORT
+        gpio_clear(TFT_CSN_PORT, TFT_CSN_PIN);
+#endif
+        start_tx_dma(queue[queue_head].buf, queue[queue_head].len);
+    }
+    nvic_enable_irq(NVIC_DMA1_CHANNEL5_IRQ);
+    return true;
+}
+
+/**
+  * @brief Check if asynchronous transfers are pending
+  * @retval true if the queue is not yet drained
+  */
+bool spi_dma_busy(void)
+{
+    return async_running;
+}
+
+/**
+  * @brief Wait for all queued transfers to complete
+  * @retval None
+  */
+void spi_dma_fence(void)
+{
+    /** @todo Add timeout for SPI transmission */
+    while (async_running) ;
+}
+
 /**
   * @brief SPI RX DMA handler
   * @retval None
@@ -180,4 +392,24 @@ void dma1_channel5_isr(void)
     spi_disable_tx_dma(SPI2);
     dma_disable_channel(DMA1, DMA_CHANNEL5);
     dma_status &= ~spi_tx_running;
+
+    if (async_running) {
+        spi_callback_t done = queue[queue_head].done;
+        void *ctx = queue[queue_head].ctx;
+        queue_head = (queue_head + 1) % SPI_QUEUE_DEPTH;
+        if (queue_head != queue_tail) {
+            /** Queued transfers are all pixel data, start the next one right away */
+            start_tx_dma(queue[queue_head].buf, queue[queue_head].len);
+        } else {
+            while (!(SPI_SR(SPI2) & SPI_SR_TXE)) ;
+            while (SPI_SR(SPI2) & SPI_SR_BSY) ;
+#ifdef TFT_CSN_PORT
+            gpio_set(TFT_CSN_PORT, TFT_CSN_PIN);
+#endif
+            async_running = false;
+        }
+        if (done) {
+            done(ctx);
+        }
+    }
 }
@@ -122,8 +122,87 @@ void spi_init(void);
  *
  * @note tx_len and rx_len must be equal for full-duplex operation
  * @note Function blocks until DMA transfer completes
+ * @note Waits for pending asynchronous transfers first
  * @note Caller must manage chip select (CS) pin
  */
 bool spi_dma_transceive(uint8_t *tx_buf, uint32_t tx_len, uint8_t *rx_buf, uint32_t rx_len);
 
+/**
+ * @brief Send one 16 bit word repeatedly using a single DMA transfer
+ *
+ * Switches the SPI to 16 bit frames and lets the DMA resend the same
+ * memory location without incrementing, so a solid fill of any size costs
+ * one DMA setup per 65535 words instead of one per small buffer. Blocks
+ * until the transfer is complete.
+ *
+ * @param[in] value Word to send, MSB first (e.g. a bgr565 pixel)
+ * @param[in] count Number of words to send
+ * @return true  Transfer completed
+ * @return false count was 0
+ */
+bool spi_dma_fill16(uint16_t value, uint32_t count);
+
+/**
+ * @brief Number of asynchronous transfers that can be pending
+ */
+#define SPI_QUEUE_DEPTH  (4)
+
+/**
+ * @brief Send a few bytes without DMA
+ *
+ * For TFT commands and their parameters, where setting up a DMA transfer
+ * takes longer than clocking out the bytes. Waits for queued transfers
+ * first and returns when the last byte is on the wire. Received bytes are
+ * dropped, the next DMA transfer flushes them.
+ *
+ * @param[in] tx_buf Transmit buffer
+ * @param[in] tx_len Number of bytes to transmit
+ * @return true  Transfer completed
+ * @return false Invalid parameters
+ */
+bool spi_write_polled(const uint8_t *tx_buf, uint32_t tx_len);
+
+/**
+ * @brief Completion callback for asynchronous transfers
+ *
+ * @param ctx The context pointer given to spi_dma_transmit_async()
+ *
+ * @note Called from the SPI TX DMA interrupt, keep it short
+ */
+typedef void (*spi_callback_t)(void *ctx);
+
+/**
+ * @brief Queue data for transmission without waiting for it to be sent
+ *
+ * Transfers are sent back to back in the order they were queued. If the
+ * queue is full this waits for a slot to become free. Only suitable for
+ * display data: the TFT A0 (data/command) line must not change until
+ * spi_dma_fence() has returned.
+ *
+ * @param[in] tx_buf Transmit buffer, must stay valid until the transfer completes
+ * @param[in] tx_len Number of bytes to transmit
+ * @param[in] done   Completion callback (may be NULL)
+ * @param[in] ctx    Argument passed to done
+ * @return true  Transfer was queued
+ * @return false Invalid parameters
+ */
+bool spi_dma_transmit_async(const uint8_t *tx_buf, uint32_t tx_len, spi_callback_t done, void *ctx);
+
+/**
+ * @brief Check for pending asynchronous transfers
+ *
+ * @return true if transfers queued with spi_dma_transmit_async() are still
+ *         being sent
+ */
+bool spi_dma_busy(void);
+
+/**
+ * @brief Wait until all queued asynchronous transfers have completed
+ *
+ * spi_dma_transceive() calls this itself. Callers must fence before
+ * touching any signal that affects the transfer, such as the TFT A0 line,
+ * or before reusing a buffer that was queued.
+ */
+void spi_dma_fence(void);
+
 #endif // __SPI_DRIVER_H__
@@ -0,0 +1,66 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include "stackmon.h"
+
+/** Provided by cortex-m-generic.ld and stm32f100_app.ld */
+extern uint32_t _data, _edata, _ebss, _stack;
+extern uint32_t _ramfunc_start, _ramfunc_end;
+
+/**
+  * @brief Lowest address the stack may grow down to, after all static data
+  * @retval pointer to the bottom of the stack area
+  */
+static uint32_t *stack_bottom(void)
+{
+    /** .ramfunc is placed after .bss but do not count on it */
+    return &_ramfunc_end > &_ebss ? &_ramfunc_end : &_ebss;
+}
+
+void stackmon_paint(void)
+{
+    volatile uint32_t here;
+    uint32_t *top = (uint32_t*) ((uintptr_t) &here & ~3) - STACKMON_MARGIN / sizeof(uint32_t);
+    if (top > &_stack) {
+        top = &_stack;
+    }
+    for (uint32_t *p = stack_bottom(); p < top; p++) {
+        *p = STACKMON_PAINT;
+    }
+}
+
+void stackmon_get(ram_stats_t *stats)
+{
+    uint32_t *bottom = stack_bottom();
+    const volatile uint32_t *p = bottom;
+    while (p < &_stack && *p == STACKMON_PAINT) {
+        p++;
+    }
+    stats->data_bytes = (uint16_t) ((uintptr_t) &_edata - (uintptr_t) &_data);
+    stats->bss_bytes = (uint16_t) ((uintptr_t) &_ebss - (uintptr_t) &_edata);
+    stats->ramfunc_bytes = (uint16_t) ((uintptr_t) &_ramfunc_end - (uintptr_t) &_ramfunc_start);
+    stats->stack_bytes = (uint16_t) ((uintptr_t) &_stack - (uintptr_t) bottom);
+    stats->stack_peak = (uint16_t) ((uintptr_t) &_stack - (uintptr_t) p);
+}
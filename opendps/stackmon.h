@@ -0,0 +1,81 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file stackmon.h
+ * @brief Stack high water mark and RAM usage
+ *
+ * Available with CONFIG_STACK_MONITOR. The firmware has no heap, the 8K of
+ * SRAM holds .data, .bss, the functions copied by hw_init() (.ramfunc) and
+ * the stack growing down from the top of RAM towards them.
+ *
+ * stackmon_paint() is the first thing main() calls. It fills the RAM
+ * between the end of the static data and a little below its own stack
+ * frame with STACKMON_PAINT. stackmon_get() finds the high water mark by
+ * counting the painted words left from the bottom up, so the peak covers
+ * everything run since boot, interrupt handlers included as they share the
+ * main stack. The scan reads at most the whole gap, some 6K, and is only
+ * done on request, over cmd_ram_stats or the ram command of the command
+ * line.
+ *
+ * A peak within a few words of stack_bytes means the stack has reached the
+ * static data and likely overwritten some of it.
+ */
+
+#ifndef __STACKMON_H__
+#define __STACKMON_H__
+
+#include <stdint.h>
+
+/** @brief Fill pattern of the unused stack */
+#define STACKMON_PAINT (0x57a0c5e5)
+
+/** @brief Stack not painted by stackmon_paint(), its frame and its caller's */
+#define STACKMON_MARGIN (64)
+
+/**
+ * @brief RAM usage in bytes
+ */
+typedef struct {
+    uint16_t data_bytes;     /** Initialised static data, .data */
+    uint16_t bss_bytes;      /** Zeroed static data, .bss */
+    uint16_t ramfunc_bytes;  /** Functions run from SRAM, .ramfunc */
+    uint16_t stack_bytes;    /** Room for the stack above the static data */
+    uint16_t stack_peak;     /** Most stack used since boot */
+} ram_stats_t;
+
+/**
+ * @brief Paint the stack area, call first thing in main() with interrupts
+ *        disabled
+ */
+void stackmon_paint(void);
+
+/**
+ * @brief Get the RAM section sizes and scan for the stack high water mark
+ *
+ * @param[out] stats Filled in with the sizes
+ */
+void stackmon_get(ram_stats_t *stats);
+
+#endif // __STACKMON_H__
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "adcnoise.h"
+#include "isrhook.h"
+
+uint32_t g_num_fail, g_num_pass;
+bool g_irq_masked;
+
+uint32_t isrhook_clock(void)
+{
+    return 0;
+}
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+/** Within a 1/64 code of the expected value with ADCNOISE_FRAC_BITS */
+#define NEAR(value, expected) \
+    (fabs((value) / (double) (1 << ADCNOISE_FRAC_BITS) - (expected)) <= 1.0 / 64)
+
+/**
+ * Run one window through the ISR hooks, V_out alternates between
+ * v_out - 1 and v_out + 1, V_in is constant and I_out has a tail
+ */
+static void run_window(uint16_t v_out)
+{
+    for (uint32_t i = 0; i < ADCNOISE_WINDOW; i++) {
+        uint32_t i_out = (i % 256) == 0 ? 600 : 100;
+        isrhook_run(i_out, 3000, v_out + ((i & 1) ? 1 : -1));
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    adcnoise_t noise;
+
+    /** Nothing before enabling */
+    CHECK(!adcnoise_enabled() && !isrhook_enabled(isrhook_adcnoise));
+    CHECK(!adcnoise_get(&noise) && noise.windows == 0 && noise.samples == 0);
+
+    adcnoise_enable(ADCNOISE_USER_SCREEN, true);
+    CHECK(adcnoise_enabled() && isrhook_is(isrhook_adcnoise, &adcnoise_sample));
+    /** Nothing until a window is full */
+    isrhook_run(100, 3000, 2000);
+    CHECK(!adcnoise_get(&noise));
+    for (uint32_t i = 1; i < ADCNOISE_WINDOW - 1; i++) {
+        isrhook_run(100, 3000, 2000);
+    }
+    CHECK(!adcnoise_get(&noise));
+    isrhook_run(100, 3000, 2000);
+    CHECK(!g_irq_masked);
+    CHECK(adcnoise_get(&noise) && noise.windows == 1 && noise.samples == ADCNOISE_WINDOW);
+    CHECK(noise.ch[adcnoise_v_out].center == 2000 && noise.ch[adcnoise_v_out].stddev == 0);
+    CHECK(noise.ch[adcnoise_v_out].mean == 2000 << 16);
+    CHECK(noise.ch[adcnoise_v_in].hist[ADCNOISE_BINS / 2] == ADCNOISE_WINDOW);
+
+    /** The first window centered on 2000, V_out is +-1 around 2001 */
+    run_window(2001);
+    CHECK(adcnoise_get(&noise) && noise.windows == 2);
+    adcnoise_stats_t *v = &noise.ch[adcnoise_v_out];
+    CHECK(v->center == 2000 && v->min == 2000 && v->max == 2002);
+    CHECK(v->mean == 2001 << 16);
+    CHECK(NEAR(v->stddev, 1.0));
+    CHECK(v->hist[ADCNOISE_BINS / 2] == ADCNOISE_WINDOW / 2);
+    CHECK(v->hist[ADCNOISE_BINS / 2 + 2] == ADCNOISE_WINDOW / 2);
+    /** I_out spikes land in the last bin */
+    adcnoise_stats_t *a = &noise.ch[adcnoise_i_out];
+    CHECK(a->min == 100 && a->max == 600);
+    CHECK(a->hist[ADCNOISE_BINS - 1] == ADCNOISE_WINDOW / 256);
+    CHECK(a->hist[ADCNOISE_BINS / 2] == ADCNOISE_WINDOW - ADCNOISE_WINDOW / 256);
+    double mean = 100 + 500.0 / 256;
+    CHECK(fabs(a->mean / 65536.0 - mean) < 0.001);
+    CHECK(NEAR(a->stddev, sqrt((500.0 * 500.0 / 256) - (500.0 / 256) * (500.0 / 256))));
+
+    /** The next window follows the mean of the last */
+    run_window(2001);
+    CHECK(adcnoise_get(&noise) && noise.windows == 3);
+    CHECK(noise.ch[adcnoise_v_out].center == 2001);
+    CHECK(noise.ch[adcnoise_v_out].hist[ADCNOISE_BINS / 2 - 1] == ADCNOISE_WINDOW / 2);
+    CHECK(noise.ch[adcnoise_i_out].center == 102);
+
+    /** The hook runs while any user collects */
+    adcnoise_enable(ADCNOISE_USER_HOST, true);
+    adcnoise_enable(ADCNOISE_USER_SCREEN, false);
+    CHECK(adcnoise_enabled() && isrhook_enabled(isrhook_adcnoise));
+    CHECK(adcnoise_get(&noise) && noise.windows == 3);
+    adcnoise_enable(ADCNOISE_USER_HOST, false);
+    CHECK(!adcnoise_enabled() && !isrhook_enabled(isrhook_adcnoise));
+    adcnoise_enable(ADCNOISE_USER_HOST, false);
+    CHECK(!adcnoise_enabled());
+
+    /** Starting again drops the old windows and centers on the first sample */
+    adcnoise_enable(ADCNOISE_USER_HOST, true);
+    CHECK(!adcnoise_get(&noise));
+    run_window(1000);
+    CHECK(adcnoise_get(&noise) && noise.windows == 1);
+    CHECK(noise.ch[adcnoise_v_out].center == 999 && noise.ch[adcnoise_v_out].max == 1001);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
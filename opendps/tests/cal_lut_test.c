@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "cal_lut.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+static cal_lut_t lut;
+
+int main(int argc, char const *argv[])
+{
+    /** Raw I_out ADC to mA, steeper below 100 raw */
+    uint16_t points[] = { 10, 0, 100, 200, 1000, 1100, 4000, 4100 };
+    CHECK(cal_lut_load(&lut, points, sizeof(points)));
+    CHECK(lut.count == 4);
+
+    /** At and between the points */
+    CHECK(cal_lut_apply(&lut, 10, 0) == 0);
+    CHECK(cal_lut_apply(&lut, 55, 0) == 100);
+    CHECK(cal_lut_apply(&lut, 100, 0) == 200);
+    CHECK(cal_lut_apply(&lut, 101, 0) == 201);
+    CHECK(cal_lut_apply(&lut, 999, 0) == 1099);
+    CHECK(cal_lut_apply(&lut, 1000, 0) == 1100);
+    CHECK(cal_lut_apply(&lut, 2500, 0) == 2600);
+    CHECK(cal_lut_apply(&lut, 4000, 0) == 4100);
+
+    /** Rounding to nearest */
+    CHECK(cal_lut_apply(&lut, 11, 0) == 2);
+    CHECK(cal_lut_apply(&lut, 12, 0) == 4);
+
+    /** Extrapolated from the end segments */
+    CHECK(cal_lut_apply(&lut, 0, 0) == -22);
+    CHECK(cal_lut_apply(&lut, 4095, 0) == 4195);
+
+    /** Fractional bits, 55.5 raw */
+    CHECK(cal_lut_apply(&lut, (55 << 6) + 32, 6) == 101);
+    CHECK(cal_lut_apply(&lut, 2500 << 6, 6) == 2600);
+    CHECK(cal_lut_apply(&lut, 4095 << 6, 6) == 4195);
+
+    /** Inverse */
+    CHECK(cal_lut_invert(&lut, 0) == 10);
+    CHECK(cal_lut_invert(&lut, 100) == 55);
+    CHECK(cal_lut_invert(&lut, 200) == 100);
+    CHECK(cal_lut_invert(&lut, 2600) == 2500);
+    CHECK(cal_lut_invert(&lut, 5000) == 4900);
+    bool ok = true;
+    for (uint32_t x = 10; x <= 4000; x++) {
+        ok &= cal_lut_invert(&lut, cal_lut_apply(&lut, x, 0)) == (int32_t) x;
+    }
+    CHECK(ok);
+
+    /** Two points are a linear model, large spans do not overflow */
+    uint16_t line[] = { 0, 0, 65535, 4095 };
+    CHECK(cal_lut_load(&lut, line, sizeof(line)));
+    CHECK(cal_lut_apply(&lut, 65535, 0) == 4095);
+    CHECK(cal_lut_apply(&lut, 32768, 0) == 2048);
+    CHECK(cal_lut_invert(&lut, 4095) == 65535);
+
+    /** Invalid tables leave the table empty */
+    uint16_t one[] = { 0, 0 };
+    CHECK(!cal_lut_load(&lut, one, sizeof(one)));
+    CHECK(lut.count == 0);
+    uint16_t x_down[] = { 100, 0, 50, 10 };
+    CHECK(!cal_lut_load(&lut, x_down, sizeof(x_down)));
+    uint16_t y_flat[] = { 0, 10, 50, 10 };
+    CHECK(!cal_lut_load(&lut, y_flat, sizeof(y_flat)));
+    CHECK(!cal_lut_load(&lut, points, sizeof(points) - 2));
+    uint16_t many[2 * (CAL_LUT_MAX_POINTS + 1)];
+    for (uint32_t i = 0; i < CAL_LUT_MAX_POINTS + 1; i++) {
+        many[2 * i] = many[2 * i + 1] = 10 * i;
+    }
+    CHECK(!cal_lut_load(&lut, many, sizeof(many)));
+    CHECK(cal_lut_load(&lut, many, sizeof(many) - CAL_LUT_POINT_SIZE));
+    CHECK(lut.count == CAL_LUT_MAX_POINTS);
+    CHECK(cal_lut_apply(&lut, 105, 0) == 105);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
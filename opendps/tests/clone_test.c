@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "past.h"
+#include "pastunits.h"
+#include "flash.h"
+#include "clone.h"
+#include "crc16.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+/** Chunk size of the protocol, an odd one splits unit headers */
+#define CHUNK  (48)
+
+uint8_t src_blocks[PAST_NUM_BLOCKS][PAST_BLOCK_SIZE];
+uint8_t dst_blocks[PAST_NUM_BLOCKS][PAST_BLOCK_SIZE];
+
+past_t src, dst;
+
+void lock_flash(void) {}
+void unlock_flash(void) {}
+
+void flash_erase_page(uint32_t address)
+{
+    memset((char*) address, 0xff, PAST_BLOCK_SIZE);
+}
+
+void flash_program_word(uint32_t address, uint32_t data)
+{
+    *((uint32_t*) address) = data;
+}
+
+void flash_program_half_word(uint32_t address, uint16_t data)
+{
+    *((uint16_t*) address) = data;
+}
+
+bool flash_program_block(uint32_t address, const void *data, uint32_t length)
+{
+    memcpy((void*) address, data, length);
+    return true;
+}
+
+uint32_t flash_get_status_flags(void)
+{
+    return FLASH_SR_EOP;
+}
+
+static bool write_u32(past_t *past, past_id_t id, uint32_t value)
+{
+    return past_write_unit(past, id, (void*) &value, sizeof(value));
+}
+
+static bool read_u32(past_t *past, past_id_t id, uint32_t *value)
+{
+    const uint32_t *p;
+    uint32_t length;
+    if (!past_read_unit(past, id, (const void**) &p, &length) || length != 4) {
+        return false;
+    }
+    *value = *p;
+    return true;
+}
+
+static void init(past_t *past, uint8_t blocks[PAST_NUM_BLOCKS][PAST_BLOCK_SIZE])
+{
+    memset((void*) blocks, 0xff, PAST_NUM_BLOCKS * PAST_BLOCK_SIZE);
+    for (uint32_t i = 0; i < PAST_NUM_BLOCKS; i++) {
+        past->blocks[i] = (uint32_t) blocks[i];
+    }
+    CHECK(past_init(past));
+}
+
+/** Import a blob in CHUNK sized pieces, the status of the first failure */
+static clone_status_t import_all(const uint8_t *blob, uint32_t total, uint32_t chunk)
+{
+    for (uint32_t offset = 0; offset < total; offset += chunk) {
+        uint32_t count = total - offset < chunk ? total - offset : chunk;
+        clone_status_t status = clone_import(&dst, offset, blob + offset, count, offset + count == total);
+        if (status != clone_ok) {
+            return status;
+        }
+    }
+    return clone_ok;
+}
+
+int main(int argc, char const *argv[])
+{
+    uint8_t blob[1024];
+    uint8_t table[200];
+    uint32_t total, value, length;
+    const uint8_t *p;
+
+    for (uint32_t i = 0; i < sizeof(table); i++) {
+        table[i] = i;
+    }
+
+    /** Scope */
+    CHECK(clone_unit_in_scope(past_power));
+    CHECK(clone_unit_in_scope(past_tft_brightness));
+    CHECK(clone_unit_in_scope(past_preset_0 + 3));
+    CHECK(clone_unit_in_scope((1 << 24) | 1));
+    CHECK(!clone_unit_in_scope(past_A_ADC_K));
+    CHECK(!clone_unit_in_scope(past_app_git_hash));
+    CHECK(!clone_unit_in_scope(0xff));
+    CHECK(!clone_unit_in_scope((1 << 24) | 1 | PAST_STAGED_BIT));
+
+    init(&src, src_blocks);
+    CHECK(write_u32(&src, past_power, 0x01f40bb8));
+    CHECK(write_u32(&src, past_tft_brightness, 40));
+    CHECK(write_u32(&src, past_A_ADC_K, 1234));
+    CHECK(write_u32(&src, past_preset_0, 0x00020001));
+    CHECK(write_u32(&src, (1 << 24) | 1, 5000));
+    CHECK(past_write_unit(&src, (5 << 24) | 3, (void*) table, sizeof(table)));
+
+    /** Export in windows, the last one short */
+    uint32_t pos = 0, copied;
+    while ((copied = clone_export(&src, pos, blob + pos, CHUNK, &total)) > 0) {
+        pos += copied;
+    }
+    CHECK(pos == total);
+    CHECK(total == 2 + 4 * (6 + 4) + 6 + sizeof(table) + 2);
+    CHECK(blob[0] == CLONE_VERSION && blob[1] == 5);
+    CHECK(crc16(blob, total - 2) == (blob[total - 2] << 8 | blob[total - 1]));
+    CHECK(clone_export(&src, total, blob + total, CHUNK, &total) == 0);
+
+    /** The target has its own calibration and a setting the source lacks */
+    init(&dst, dst_blocks);
+    CHECK(write_u32(&dst, past_power, 0x00640064));
+    CHECK(write_u32(&dst, past_A_ADC_K, 5678));
+    CHECK(write_u32(&dst, (2 << 24) | 1, 42));
+
+    /** A bad CRC changes nothing */
+    blob[total - 1] ^= 1;
+    CHECK(import_all(blob, total, CHUNK) == clone_err_crc);
+    blob[total - 1] ^= 1;
+    CHECK(read_u32(&dst, past_power, &value) && value == 0x00640064);
+    CHECK(!past_read_unit(&dst, past_tft_brightness, (const void**) &p, &length));
+    CHECK(!past_read_unit(&dst, past_tft_brightness | PAST_STAGED_BIT, (const void**) &p, &length));
+
+    /** Nor does a missing end */
+    CHECK(clone_import(&dst, 0, blob, CHUNK, false) == clone_ok);
+    CHECK(clone_import(&dst, CHUNK, blob + CHUNK, CHUNK, true) == clone_err_crc);
+    CHECK(read_u32(&dst, past_power, &value) && value == 0x00640064);
+
+    /** A chunk out of order is ignored */
+    CHECK(clone_import(&dst, 0, blob, CHUNK, false) == clone_ok);
+    CHECK(clone_import(&dst, 2 * CHUNK, blob + 2 * CHUNK, CHUNK, false) == clone_err_offset);
+    CHECK(clone_import(&dst, 0 + 1, blob + 1, CHUNK, false) == clone_err_offset);
+
+    /** The whole blob, byte by byte */
+    CHECK(import_all(blob, total, 1) == clone_ok);
+    CHECK(read_u32(&dst, past_power, &value) && value == 0x01f40bb8);
+    CHECK(read_u32(&dst, past_tft_brightness, &value) && value == 40);
+    CHECK(read_u32(&dst, past_preset_0, &value) && value == 0x00020001);
+    CHECK(read_u32(&dst, (1 << 24) | 1, &value) && value == 5000);
+    CHECK(past_read_unit(&dst, (5 << 24) | 3, (const void**) &p, &length) && length == sizeof(table) &&
+          memcmp(p, table, sizeof(table)) == 0);
+    CHECK(read_u32(&dst, past_A_ADC_K, &value) && value == 5678);
+    CHECK(!past_read_unit(&dst, (2 << 24) | 1, (const void**) &p, &length));
+
+    /** A clone of the clone is the same */
+    uint8_t again[sizeof(blob)];
+    uint32_t total_again;
+    CHECK(clone_export(&dst, 0, again, sizeof(again), &total_again) == total);
+    CHECK(total_again == total);
+
+    /** Units out of scope are refused */
+    uint8_t bad[] = { CLONE_VERSION, 1, 0, 0, 0, past_A_ADC_K, 0, 4, 1, 2, 3, 4, 0, 0 };
+    uint16_t crc = crc16(bad, sizeof(bad) - 2);
+    bad[sizeof(bad) - 2] = crc >> 8;
+    bad[sizeof(bad) - 1] = crc;
+    CHECK(import_all(bad, sizeof(bad), CHUNK) == clone_err_unit);
+    bad[0] = CLONE_VERSION + 1;
+    CHECK(import_all(bad, sizeof(bad), CHUNK) == clone_err_format);
+    CHECK(read_u32(&dst, past_A_ADC_K, &value) && value == 5678);
+
+    /** An empty snapshot clears the settings */
+    uint8_t empty[] = { CLONE_VERSION, 0, 0, 0 };
+    crc = crc16(empty, 2);
+    empty[2] = crc >> 8;
+    empty[3] = crc;
+    CHECK(import_all(empty, sizeof(empty), CHUNK) == clone_ok);
+    CHECK(!past_read_unit(&dst, past_power, (const void**) &p, &length));
+    CHECK(!past_read_unit(&dst, (5 << 24) | 3, (const void**) &p, &length));
+    CHECK(read_u32(&dst, past_A_ADC_K, &value) && value == 5678);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
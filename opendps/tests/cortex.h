@@ -0,0 +1,15 @@
+#ifndef __CORTEX_H__
+#define __CORTEX_H__
+
+#include <stdbool.h>
+
+extern bool g_irq_masked;
+
+static inline bool cm_mask_interrupts(bool mask)
+{
+    bool old = g_irq_masked;
+    g_irq_masked = mask;
+    return old;
+}
+
+#endif // __CORTEX_H__
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "crc16.h"
+
+#ifndef CONFIG_CRC16_TABLE
+ #define CONFIG_CRC16_TABLE (0)
+#endif
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+#define BENCH_SIZE   (1024)
+#define BENCH_ROUNDS (2000)
+
+static uint8_t data[BENCH_SIZE];
+
+/** Bit by bit CRC-CCITT used as reference */
+static uint16_t crc_reference(const uint8_t *buf, uint32_t length)
+{
+    uint16_t crc = 0;
+    while (length--) {
+        crc ^= (uint16_t) (*buf++ << 8);
+        for (uint32_t i = 0; i < 8; i++) {
+            crc = crc & 0x8000 ? (uint16_t) (crc << 1) ^ 0x1021 : (uint16_t) (crc << 1);
+        }
+    }
+    return crc;
+}
+
+/** The shift and XOR routine crc16.c uses without a table */
+static uint16_t crc_shift_xor(const uint8_t *buf, uint32_t length)
+{
+    uint16_t crc = 0;
+    while (length--) {
+        uint8_t x = crc >> 8 ^ *buf++;
+        x ^= x >> 4;
+        crc = (crc << 8) ^ ((uint16_t)(x << 12)) ^ ((uint16_t)(x << 5)) ^ ((uint16_t)x);
+    }
+    return crc;
+}
+
+/** Microseconds spent calculating the CRC of data BENCH_ROUNDS times */
+static double bench(uint16_t (*fn)(const uint8_t*, uint32_t), volatile uint16_t *sink)
+{
+    clock_t start = clock();
+    for (uint32_t i = 0; i < BENCH_ROUNDS; i++) {
+        *sink ^= fn(data, sizeof(data));
+    }
+    return (double) (clock() - start) * 1000000 / CLOCKS_PER_SEC;
+}
+
+static uint16_t crc_block(const uint8_t *buf, uint32_t length)
+{
+    return crc16((uint8_t*) buf, length);
+}
+
+int main(int argc, char const *argv[])
+{
+    uint8_t check[] = "123456789";
+    volatile uint16_t sink = 0;
+
+    CHECK(crc16(check, 9) == 0x31c3); /** CRC-16/XMODEM check value */
+    CHECK(crc16(check, 0) == 0);
+    CHECK(crc16(0, 9) == 0);
+
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < sizeof(data); i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 16;
+    }
+
+    /** Block and streaming calculation agree with the reference */
+    bool ok = true;
+    for (uint32_t len = 0; len <= sizeof(data); len += 61) {
+        uint16_t crc = 0;
+        for (uint32_t i = 0; i < len; i++) {
+            crc = crc16_add(crc, data[i]);
+        }
+        ok &= crc == crc_reference(data, len);
+        ok &= crc16(data, len) == crc;
+        ok &= crc16_add_bytes(crc16_add_bytes(0, data, len / 3), &data[len / 3], len - len / 3) == crc;
+        ok &= crc_shift_xor(data, len) == crc;
+    }
+    CHECK(ok);
+
+    double t_ref = bench(crc_reference, &sink);
+    double t_xor = bench(crc_shift_xor, &sink);
+    double t_crc = bench(crc_block, &sink);
+    printf("CRC of %d bytes with CONFIG_CRC16_TABLE=%d: %.2f us, shift/xor %.2f us, bitwise %.2f us\n",
+           BENCH_SIZE, CONFIG_CRC16_TABLE, t_crc / BENCH_ROUNDS, t_xor / BENCH_ROUNDS, t_ref / BENCH_ROUNDS);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
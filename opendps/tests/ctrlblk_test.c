@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "ctrlblk.h"
+
+uint32_t g_num_fail, g_num_pass;
+bool g_irq_masked;
+
+typedef struct {
+    uint32_t limit;
+    uint32_t setpoint;
+} params_t;
+
+static params_t params[2] = { { 10, 20 } };
+static ctrlblk_t ctrl;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+int main(int argc, char const *argv[])
+{
+    ctrlblk_init(&ctrl, &params[0], &params[1], sizeof(params_t));
+    const params_t *p = ctrlblk_read(&ctrl);
+    CHECK(p == &params[0] && p->limit == 10 && p->setpoint == 20);
+    CHECK(ctrlblk_version(&ctrl) == 0);
+
+    /** Readers keep seeing the old values until the publish */
+    params_t *w = ctrlblk_begin(&ctrl);
+    CHECK(g_irq_masked);
+    CHECK(w == &params[1] && w->limit == 10 && w->setpoint == 20);
+    w->limit = 11;
+    w->setpoint = 21;
+    p = ctrlblk_read(&ctrl);
+    CHECK(p->limit == 10 && p->setpoint == 20);
+    ctrlblk_publish(&ctrl);
+    CHECK(!g_irq_masked);
+    p = ctrlblk_read(&ctrl);
+    CHECK(p == &params[1] && p->limit == 11 && p->setpoint == 21);
+    CHECK(ctrlblk_version(&ctrl) == 1);
+
+    /** The next change starts from the published values in the other copy */
+    w = ctrlblk_begin(&ctrl);
+    CHECK(w == &params[0] && w->limit == 11 && w->setpoint == 21);
+    w->setpoint = 22;
+    ctrlblk_publish(&ctrl);
+    p = ctrlblk_read(&ctrl);
+    CHECK(p == &params[0] && p->limit == 11 && p->setpoint == 22);
+    CHECK(ctrlblk_version(&ctrl) == 2);
+
+    /** A writer that already had interrupts masked keeps them masked */
+    g_irq_masked = true;
+    (void) ctrlblk_begin(&ctrl);
+    ctrlblk_publish(&ctrl);
+    CHECK(g_irq_masked);
+    g_irq_masked = false;
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
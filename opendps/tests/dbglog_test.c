@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "dbglog.h"
+
+uint32_t g_num_fail, g_num_pass;
+bool g_irq_masked;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+static const char fmt_none[] = "Boot\n";
+static const char fmt_two[] = "V=%d I=%d\n";
+
+/** The header word dbglog_write stores for fmt */
+static uint32_t header(const char *fmt, uint32_t nargs)
+{
+    return ((uint32_t) (uintptr_t) fmt & DBGLOG_ADDR_MASK) | (nargs << DBGLOG_NARGS_SHIFT);
+}
+
+int main(int argc, char const *argv[])
+{
+    uint32_t words[CONFIG_DBGLOG_WORDS];
+
+    CHECK(DBGLOG_NARGS() == 0);
+    CHECK(DBGLOG_NARGS(a) == 1);
+    CHECK(DBGLOG_NARGS(a, b, c, d, e, f, g) == 7);
+
+    CHECK(dbglog_read(words, CONFIG_DBGLOG_WORDS) == 0);
+
+    /** Entries come out in order with their arguments */
+    dbglog_write(fmt_none, 0);
+    dbglog_write(fmt_two, 2, 5000, -1);
+    CHECK(!g_irq_masked);
+    CHECK(dbglog_read(words, CONFIG_DBGLOG_WORDS) == 4);
+    CHECK(words[0] == header(fmt_none, 0));
+    CHECK(words[1] == header(fmt_two, 2));
+    CHECK(words[2] == 5000);
+    CHECK(words[3] == 0xffffffff);
+    CHECK(dbglog_read(words, CONFIG_DBGLOG_WORDS) == 0);
+
+    /** Only whole entries are read */
+    dbglog_write(fmt_two, 2, 1, 2);
+    dbglog_write(fmt_two, 2, 3, 4);
+    CHECK(dbglog_read(words, 5) == 3);
+    CHECK(words[1] == 1 && words[2] == 2);
+    CHECK(dbglog_read(words, 2) == 0);
+    CHECK(dbglog_read(words, 3) == 3);
+    CHECK(words[1] == 3 && words[2] == 4);
+
+    /** A full ring drops whole entries and counts them */
+    for (uint32_t i = 0; i < CONFIG_DBGLOG_WORDS / 3; i++) {
+        dbglog_write(fmt_two, 2, i, i);
+    }
+    CHECK(dbglog_take_dropped() == 0);
+    dbglog_write(fmt_two, 2, 7, 7);
+    dbglog_write(fmt_two, 2, 8, 8);
+    CHECK(dbglog_take_dropped() == 2);
+    CHECK(dbglog_take_dropped() == 0);
+    /** A smaller entry still fits in the words left */
+    dbglog_write(fmt_none, 0);
+    CHECK(dbglog_take_dropped() == 0);
+    CHECK(dbglog_read(words, CONFIG_DBGLOG_WORDS) == 3 * (CONFIG_DBGLOG_WORDS / 3) + 1);
+    CHECK(words[3 * (CONFIG_DBGLOG_WORDS / 3) - 2] == CONFIG_DBGLOG_WORDS / 3 - 1);
+    CHECK(words[3 * (CONFIG_DBGLOG_WORDS / 3)] == header(fmt_none, 0));
+
+    printf("dbglog test: %d passed, %d failed\n", g_num_pass, g_num_fail);
+    return g_num_fail > 0 ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "energy.h"
+
+uint32_t g_num_fail, g_num_pass;
+bool g_irq_masked;
+
+/** Calibration and time base normally provided by pwrctl and tick */
+float a_adc_k_coef = 1, a_adc_c_coef = 0;
+float v_adc_k_coef = 1, v_adc_c_coef = 0;
+static uint64_t ticks;
+
+uint64_t get_ticks(void)
+{
+    return ticks;
+}
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+int main(int argc, char const *argv[])
+{
+    energy_stats_t stats;
+    energy_reset();
+    energy_get(&stats);
+    CHECK(stats.charge_uah == 0 && stats.energy_uwh == 0 && stats.runtime_ms == 0);
+
+    /** 100 mA at 5 V for an hour */
+    energy_run(true);
+    for (uint32_t i = 0; i < 1000; i++) {
+        energy_sample(100, 5000);
+    }
+    ticks += 3600000;
+    energy_get(&stats);
+    CHECK(!g_irq_masked);
+    CHECK(stats.runtime_ms == 3600000);
+    CHECK(stats.charge_uah == 100000);
+    CHECK(stats.energy_uwh == 500000);
+
+    /** Time with the output off does not count */
+    energy_run(false);
+    ticks += 1000;
+    energy_get(&stats);
+    CHECK(stats.runtime_ms == 3600000);
+
+    /** The mean of V * I, not the product of the means, is integrated */
+    energy_reset();
+    energy_run(true);
+    energy_sample(200, 1000);
+    energy_sample(0, 3000);
+    ticks += 3600;
+    energy_get(&stats);
+    CHECK(stats.charge_uah == 100);
+    CHECK(stats.energy_uwh == 100);
+
+    /** Offsets are applied to the means */
+    a_adc_c_coef = 10;
+    v_adc_c_coef = 100;
+    energy_get(&stats);
+    CHECK(stats.charge_uah == 110);
+    /** mean(V * I) = 100000 + 10 * 2000 + 100 * 100 + 100 * 10 */
+    CHECK(stats.energy_uwh == 131);
+
+    /** Negative means clamp to zero */
+    a_adc_c_coef = -1000;
+    energy_get(&stats);
+    CHECK(stats.charge_uah == 0);
+    a_adc_c_coef = 0;
+    v_adc_c_coef = 0;
+
+    energy_reset();
+    energy_get(&stats);
+    CHECK(stats.charge_uah == 0 && stats.energy_uwh == 0 && stats.runtime_ms == 0);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
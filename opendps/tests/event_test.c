@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "event.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+int main(int argc, char const *argv[])
+{
+    event_t event;
+    uint8_t data;
+    event_stats_t stats;
+    event_init();
+
+    CHECK(!event_get(&event, &data) && event == event_none);
+
+    /** Every slot of a queue can be used, the next put is dropped and counted */
+    event_get_stats(event_src_adc, &stats);
+    uint32_t size = stats.size;
+    CHECK(size > 0 && stats.drops == 0 && stats.peak == 0);
+    for (uint32_t i = 0; i < size; i++) {
+        CHECK(event_put(event_ocp, i));
+    }
+    CHECK(!event_put(event_ovp, 0));
+    CHECK(!event_put(event_limit_mode, 1));
+    event_get_stats(event_src_adc, &stats);
+    CHECK(stats.drops == 2 && stats.peak == size);
+
+    /** Other sources are not affected by a full queue */
+    CHECK(event_put(event_rot_left, 1));
+    CHECK(event_put(event_uart_rx, 'x'));
+    CHECK(event_put_from(event_src_main, event_button_enable, press_long));
+    event_get_stats(event_src_buttons, &stats);
+    CHECK(stats.drops == 0 && stats.peak == 1);
+
+    /** A reset restarts the counters, the peak from what is still queued */
+    event_reset_stats();
+    event_get_stats(event_src_adc, &stats);
+    CHECK(stats.drops == 0 && stats.peak == size);
+    CHECK(!event_put(event_ovp, 0));
+    event_get_stats(event_src_adc, &stats);
+    CHECK(stats.drops == 1);
+
+    /** Safety first, then protocol and UI: ADC, UART, buttons and main */
+    for (uint32_t i = 0; i < size; i++) {
+        CHECK(event_get(&event, &data) && event == event_ocp && data == i);
+    }
+    CHECK(event_get(&event, &data) && event == event_uart_rx && data == 'x');
+    CHECK(event_get(&event, &data) && event == event_rot_left && data == 1);
+    CHECK(event_get(&event, &data) && event == event_button_enable && data == press_long);
+    event_reset_stats();
+    event_get_stats(event_src_adc, &stats);
+    CHECK(stats.drops == 0 && stats.peak == 0);
+    CHECK(!event_get(&event, &data));
+
+    /** Less urgent classes stay queued */
+    CHECK(event_put(event_rot_press, press_short));
+    CHECK(event_put(event_uart_rx, 'y'));
+    CHECK(event_put(event_ovp, 7));
+    CHECK(event_get_class(event_class_safety, &event, &data) && event == event_ovp && data == 7);
+    CHECK(!event_get_class(event_class_safety, &event, &data) && event == event_none);
+    CHECK(event_get_class(event_class_protocol, &event, &data) && event == event_uart_rx && data == 'y');
+    CHECK(!event_get_class(event_class_protocol, &event, &data));
+    CHECK(event_get(&event, &data) && event == event_rot_press);
+    CHECK(!event_get(&event, &data));
+
+    /** The TIM3 ramp has a queue of its own, drained with the UI */
+    CHECK(event_put(event_vout_ramped, 0));
+    event_get_stats(event_src_timer, &stats);
+    CHECK(stats.drops == 0 && stats.peak == 1);
+    CHECK(!event_get_class(event_class_protocol, &event, &data));
+    CHECK(event_get(&event, &data) && event == event_vout_ramped);
+    CHECK(!event_get(&event, &data));
+
+    /** Runs of rotations merge into the net step count, other events split runs */
+    CHECK(event_put(event_rot_right, 1));
+    CHECK(event_put(event_rot_right, 5));
+    CHECK(event_put(event_rot_left, 2));
+    CHECK(event_put(event_rot_press, press_short));
+    CHECK(event_put(event_rot_left, 1));
+    CHECK(event_put(event_rot_left, 2));
+    CHECK(event_put(event_rot_right_set, press_short));
+    CHECK(event_put(event_rot_left, 3));
+    CHECK(event_put(event_rot_right, 3));
+    CHECK(event_put(event_button_sel, press_short));
+    CHECK(event_get(&event, &data) && event == event_rot_right && data == 4);
+    CHECK(event_get(&event, &data) && event == event_rot_press && data == press_short);
+    CHECK(event_get(&event, &data) && event == event_rot_left && data == 3);
+    CHECK(event_get(&event, &data) && event == event_rot_right_set);
+    /** A run that cancels out produces no event */
+    CHECK(event_get(&event, &data) && event == event_button_sel);
+    CHECK(!event_get(&event, &data));
+
+    /** The step count saturates */
+    for (uint32_t i = 0; i < 3; i++) {
+        CHECK(event_put(event_rot_left, 100));
+    }
+    CHECK(event_get(&event, &data) && event == event_rot_left && data == 0xff);
+    CHECK(!event_get(&event, &data));
+
+    /** Wrap the free running indices many times */
+    bool ok = true;
+    for (uint32_t i = 0; i < 100000; i++) {
+        ok &= event_put(event_uart_rx, i);
+        ok &= event_put(event_uart_rx, i + 1);
+        ok &= event_get(&event, &data) && data == (uint8_t) i;
+        ok &= event_get(&event, &data) && data == (uint8_t) (i + 1);
+    }
+    CHECK(ok);
+    event_get_stats(event_src_uart, &stats);
+    CHECK(stats.drops == 0 && stats.peak == 2);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
@@ -5,6 +5,7 @@
 
 void flash_erase_page(uint32_t address);
 void flash_program_word(uint32_t address, uint32_t data);
+void flash_program_half_word(uint32_t address, uint16_t data);
 uint32_t flash_get_status_flags(void);
 
 #endif // __FLASH_H__
@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "framepool.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+int main(int argc, char const *argv[])
+{
+    frame_t *frames[CONFIG_FRAME_POOL_SIZE];
+
+    CHECK(frame_pool_free() == CONFIG_FRAME_POOL_SIZE);
+    CHECK(frame_pool_low_water() == CONFIG_FRAME_POOL_SIZE);
+
+    /** Every frame can be taken, and they are distinct */
+    for (uint32_t i = 0; i < CONFIG_FRAME_POOL_SIZE; i++) {
+        frames[i] = frame_acquire();
+        CHECK(frames[i] != NULL);
+        for (uint32_t j = 0; j < i; j++) {
+            CHECK(frames[i] != frames[j]);
+        }
+    }
+    CHECK(frame_pool_free() == 0);
+    CHECK(frame_acquire() == NULL);
+    CHECK(frame_pool_low_water() == 0);
+
+    /** A released frame is handed out again, cleared */
+    set_frame_header(frames[1]);
+    pack8(frames[1], 0x42);
+    CHECK(frames[1]->length > 0);
+    frame_release(frames[1]);
+    CHECK(frame_pool_free() == 1);
+    frame_t *again = frame_acquire();
+    CHECK(again == frames[1]);
+    CHECK(again->length == 0 && again->unpack_pos == 0);
+
+    /** NULL and foreign frames are ignored */
+    frame_t foreign;
+    frame_release(NULL);
+    frame_release(&foreign);
+    CHECK(frame_pool_free() == 0);
+
+    for (uint32_t i = 0; i < CONFIG_FRAME_POOL_SIZE; i++) {
+        frame_release(frames[i]);
+    }
+    CHECK(frame_pool_free() == CONFIG_FRAME_POOL_SIZE);
+    /** The low water mark sticks */
+    CHECK(frame_pool_low_water() == 0);
+
+    printf("framepool test: %d passed, %d failed\n", g_num_pass, g_num_fail);
+    return g_num_fail > 0 ? 1 : 0;
+}
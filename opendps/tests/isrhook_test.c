@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "isrhook.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+/** Every hook advances the clock by its own cost */
+static uint32_t clock_now;
+static uint32_t limit_cost, loop_cost, lockin_cost;
+static char order[16];
+static uint32_t order_len;
+static uint32_t last_i;
+static uint16_t last_v_in, last_v_out;
+
+uint32_t isrhook_clock(void)
+{
+    return clock_now;
+}
+
+static void limit(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw)
+{
+    last_i = i_raw;
+    last_v_in = v_in_raw;
+    last_v_out = v_out_raw;
+    clock_now += limit_cost;
+    order[order_len++] = 'l';
+}
+
+static void loop(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw)
+{
+    (void) i_raw;
+    (void) v_in_raw;
+    (void) v_out_raw;
+    clock_now += loop_cost;
+    order[order_len++] = 'v';
+}
+
+static void lockin(uint32_t i_raw, uint16_t v_in_raw, uint16_t v_out_raw)
+{
+    (void) i_raw;
+    (void) v_in_raw;
+    (void) v_out_raw;
+    clock_now += lockin_cost;
+    order[order_len++] = 'k';
+}
+
+static void run(void)
+{
+    order_len = 0;
+    isrhook_run(1234, 20000, 5000);
+    order[order_len] = 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    isrhook_stats_t stats;
+
+    /** Nothing set, nothing runs */
+    run();
+    CHECK(order_len == 0);
+    CHECK(!isrhook_enabled(isrhook_limit));
+    CHECK(isrhook_get_stats(isrhook_limit, &stats) && !stats.enabled && stats.runs == 0);
+    CHECK(!isrhook_get_stats(isrhook_count, &stats));
+
+    /** Slot order decides the run order, not the order they were set in */
+    isrhook_set(isrhook_lockin, &lockin, 50);
+    isrhook_set(isrhook_vout_loop, &loop, 100);
+    isrhook_set(isrhook_limit, &limit, 20);
+    CHECK(isrhook_enabled(isrhook_limit) && isrhook_enabled(isrhook_lockin) && !isrhook_enabled(isrhook_funcgen));
+    CHECK(isrhook_is(isrhook_limit, &limit) && !isrhook_is(isrhook_limit, &loop) && !isrhook_is(isrhook_funcgen, NULL));
+    limit_cost = 10;
+    loop_cost = 100;
+    lockin_cost = 60;
+    run();
+    CHECK(order[0] == 'l' && order[1] == 'v' && order[2] == 'k' && order_len == 3);
+    CHECK(last_i == 1234 && last_v_in == 20000 && last_v_out == 5000);
+
+    /** Each hook is charged with its own cycles, a run at the budget is no overrun */
+    CHECK(isrhook_get_stats(isrhook_limit, &stats) && stats.enabled && stats.budget == 20);
+    CHECK(stats.runs == 1 && stats.overruns == 0 && stats.max_cycles == 10);
+    CHECK(isrhook_get_stats(isrhook_vout_loop, &stats) && stats.runs == 1 && stats.overruns == 0 && stats.max_cycles == 100);
+    CHECK(isrhook_get_stats(isrhook_lockin, &stats) && stats.runs == 1 && stats.overruns == 1 && stats.max_cycles == 60);
+
+    /** The longest run is kept, overruns keep counting */
+    limit_cost = 30;
+    run();
+    limit_cost = 5;
+    run();
+    CHECK(isrhook_get_stats(isrhook_limit, &stats) && stats.runs == 3 && stats.overruns == 1 && stats.max_cycles == 30);
+    CHECK(isrhook_get_stats(isrhook_lockin, &stats) && stats.runs == 3 && stats.overruns == 3);
+
+    /** The clock wraps */
+    clock_now = 0xfffffff0;
+    limit_cost = 40;
+    run();
+    CHECK(isrhook_get_stats(isrhook_limit, &stats) && stats.overruns == 2 && stats.max_cycles == 40);
+
+    /** A disabled slot is skipped and keeps its accounting */
+    isrhook_set(isrhook_vout_loop, NULL, 0);
+    run();
+    CHECK(order[0] == 'l' && order[1] == 'k' && order_len == 2);
+    CHECK(isrhook_get_stats(isrhook_vout_loop, &stats) && !stats.enabled && stats.runs == 4);
+
+    /** The reset takes effect with the next sample set */
+    isrhook_reset_stats();
+    CHECK(isrhook_get_stats(isrhook_limit, &stats) && stats.runs == 5);
+    limit_cost = 1;
+    run();
+    CHECK(isrhook_get_stats(isrhook_limit, &stats) && stats.runs == 1 && stats.overruns == 0 && stats.max_cycles == 1);
+    CHECK(isrhook_get_stats(isrhook_vout_loop, &stats) && stats.runs == 0 && stats.max_cycles == 0);
+
+    /** Out of range slots are ignored */
+    isrhook_set(isrhook_count, &limit, 10);
+    CHECK(!isrhook_enabled(isrhook_count) && !isrhook_is(isrhook_count, &limit));
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "lockin.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+/** Within 1% of the expected raw value, results carry LOCKIN_FRAC_BITS */
+#define NEAR(value, expected) \
+    (fabs((value) / (double) (1 << LOCKIN_FRAC_BITS) - (expected)) <= 0.01 * fabs(expected) + 0.1)
+
+/** Sample sets per generator period, not a whole number */
+#define SETS_PER_PERIOD  (97.3)
+
+static uint32_t phase;
+static uint32_t phase_step = (uint32_t) (4294967296.0 / SETS_PER_PERIOD);
+
+/**
+ * Feed sample sets where I_out and V_out are sines with a DC level, the
+ * phase runs on from the last call like the generator's
+ */
+static uint32_t feed(uint32_t sets, double i_amp, double i_phase, double v_amp, double v_phase)
+{
+    for (uint32_t n = 0; n < sets; n++) {
+        double w = 2 * M_PI * phase / 4294967296.0;
+        uint16_t i_out = (uint16_t) lround(500 + i_amp * sin(w + i_phase));
+        uint16_t v_out = (uint16_t) lround(2000 + v_amp * sin(w + v_phase));
+        lockin_sample(phase, i_out, v_out);
+        phase += phase_step;
+    }
+    return sets;
+}
+
+int main(int argc, char const *argv[])
+{
+    lockin_result_t result;
+
+    /** Nothing measured */
+    lockin_get(&result);
+    CHECK(result.state == lockin_idle && result.samples == 0);
+    CHECK(!lockin_start(1, 0));
+
+    /** Settles for two periods, then runs for four */
+    CHECK(lockin_start(2, 4));
+    lockin_get(&result);
+    CHECK(result.state == lockin_waiting);
+    feed(2 * 98 + 50, 100, -M_PI / 4, 400, 0.5);
+    lockin_get(&result);
+    CHECK(result.state == lockin_waiting);
+    feed(2 * 98, 100, -M_PI / 4, 400, 0.5);
+    lockin_get(&result);
+    CHECK(result.state == lockin_running);
+    feed(4 * 98, 100, -M_PI / 4, 400, 0.5);
+    lockin_get(&result);
+    CHECK(result.state == lockin_done);
+    /** Whole periods only */
+    CHECK(result.samples >= 4 * 97 && result.samples <= 4 * 98);
+    CHECK(NEAR(result.i_dc, 500));
+    CHECK(NEAR(result.v_dc, 2000));
+    CHECK(NEAR(result.i_re, 100 * cos(-M_PI / 4)));
+    CHECK(NEAR(result.i_im, 100 * sin(-M_PI / 4)));
+    CHECK(NEAR(result.v_re, 400 * cos(0.5)));
+    CHECK(NEAR(result.v_im, 400 * sin(0.5)));
+
+    /** Done stays done */
+    uint32_t samples = result.samples;
+    feed(500, 0, 0, 0, 0);
+    lockin_get(&result);
+    CHECK(result.state == lockin_done && result.samples == samples);
+
+    /** A restart drops the result, no settling, in phase */
+    CHECK(lockin_start(0, 10));
+    lockin_get(&result);
+    CHECK(result.state == lockin_waiting && result.samples == 0);
+    feed(12 * 98, 50, 0, 200, 0);
+    lockin_get(&result);
+    CHECK(result.state == lockin_done);
+    CHECK(NEAR(result.i_re, 50));
+    CHECK(NEAR(result.i_im, 0));
+    CHECK(NEAR(result.v_re, 200));
+    CHECK(NEAR(result.v_im, 0));
+
+    /** No AC, a fast phase with few samples per period */
+    phase_step = 0x30000000;
+    CHECK(lockin_start(0, 20));
+    feed(200, 0, 0, 0, 0);
+    lockin_get(&result);
+    CHECK(result.state == lockin_done);
+    CHECK(result.i_dc == 500 << LOCKIN_FRAC_BITS && result.v_dc == 2000 << LOCKIN_FRAC_BITS);
+    CHECK(result.i_re == 0 && result.i_im == 0 && result.v_re == 0 && result.v_im == 0);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "memdesc.h"
+#include "recorder.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+uint64_t get_time_us(void)
+{
+    return 1234;
+}
+
+static memdesc_entry_t *find(uint32_t id)
+{
+    for (uint32_t i = 0; i < memdesc.count; i++) {
+        if (memdesc.entries[i].id == id) {
+            return &memdesc.entries[i];
+        }
+    }
+    return NULL;
+}
+
+/** Entry addresses are 32 bits as on the DPS, put back the upper half of
+  * the host address of our static data */
+static const void *entry_ptr(const memdesc_entry_t *entry)
+{
+    return (const void *) (((uintptr_t) &memdesc & ~(uintptr_t) 0xffffffff) | entry->address);
+}
+
+int main(int argc, char const *argv[])
+{
+    uint16_t expected[RECORDER_SIZE];
+
+    CHECK(sizeof(memdesc_t) == 72);
+    memdesc_init();
+    CHECK(memdesc.magic == MEMDESC_MAGIC);
+    CHECK(memdesc.version == MEMDESC_VERSION);
+    CHECK(memdesc.count == 2);
+    memdesc_entry_t *samples = find(MEMDESC_ID_REC_SAMPLES);
+    memdesc_entry_t *layout_entry = find(MEMDESC_ID_REC_LAYOUT);
+    CHECK(samples && samples->length == RECORDER_SIZE * sizeof(uint16_t));
+    CHECK(layout_entry && layout_entry->length == sizeof(recorder_layout_t));
+    CHECK(samples->seq == 0 && layout_entry->seq == 0);
+
+    /** Odd while recording, even again once done */
+    CHECK(recorder_arm(RECORDER_CHA_I_OUT | RECORDER_CHA_V_OUT, 1, 10, 1 << recorder_trigger_ocp));
+    CHECK(samples->seq == 1 && layout_entry->seq == 1);
+    /** Re-arming keeps it odd */
+    CHECK(recorder_arm(RECORDER_CHA_I_OUT | RECORDER_CHA_V_OUT, 1, 10, 1 << recorder_trigger_ocp));
+    CHECK(samples->seq == 1);
+    for (uint16_t i = 0; i < 1000; i++) {
+        if (i == 900) {
+            recorder_trigger(recorder_trigger_ocp);
+        }
+        recorder_sample(i, 0, i + 1);
+    }
+    CHECK(samples->seq == 2 && layout_entry->seq == 2);
+
+    /** The ring read through the layout matches recorder_read() */
+    const recorder_layout_t *layout = (const recorder_layout_t *) entry_ptr(layout_entry);
+    const uint16_t *ring = (const uint16_t *) entry_ptr(samples);
+    recorder_info_t info;
+    recorder_get_info(&info);
+    CHECK(layout->num_samples == info.num_samples);
+    CHECK(layout->pre_count == info.pre_count);
+    CHECK(layout->channels == (RECORDER_CHA_I_OUT | RECORDER_CHA_V_OUT));
+    CHECK(layout->trigger == recorder_trigger_ocp);
+    CHECK(layout->trigger_time_us == 1234);
+    CHECK(layout->ring_samples == RECORDER_SIZE);
+    CHECK(recorder_read(0, expected, RECORDER_SIZE) == layout->num_samples);
+    bool same = true;
+    for (uint32_t k = 0; k < layout->num_samples; k++) {
+        same &= ring[(layout->oldest + k) % layout->ring_samples] == expected[k];
+    }
+    CHECK(same);
+
+    /** The descriptor does not overflow */
+    CHECK(memdesc_add(1, NULL, 0) != NULL);
+    CHECK(memdesc_add(2, NULL, 0) != NULL);
+    CHECK(memdesc_add(3, NULL, 0) == NULL);
+    memdesc_begin(NULL);
+    memdesc_end(NULL);
+
+    printf("memdesc test: %d passed, %d failed\n", g_num_pass, g_num_fail);
+    return g_num_fail > 0 ? 1 : 0;
+}
@@ -0,0 +1,497 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "past.h"
+#include "flash.h"
+#include "uframe.h"
+#include "crc16.h"
+#include "wavegen.h"
+#include "gfx_lookup.h"
+
+/*
+ * Microbenchmarks of the hot paths that can run on the host: past, uframe,
+ * crc16, the function generator waveforms and the glyph decoding of tft.c. Each result is the mean cost of
+ * one operation, in TSC cycles on x86 and nanoseconds elsewhere, so only
+ * compare results from the same machine.
+ *
+ *   micro_bench                    print the results
+ *   micro_bench <baseline>         also print the change against a baseline
+ *   micro_bench -w <baseline>      save the results as the new baseline
+ */
+
+#define MAX_RESULTS  (32)
+#define PAST_ROUNDS  (200)
+#define CODEC_ROUNDS (20000)
+#define CRC_SIZE     (1024)
+#define CRC_ROUNDS   (2000)
+#define WAVE_ROUNDS  (200000)
+#define GLYPH_BYTES  (1024)
+#define GLYPH_ROUNDS (2000)
+
+#if defined(__x86_64__) || defined(__i386__)
+ #include <x86intrin.h>
+ #define UNIT "cycles"
+ static uint64_t now(void) { return __rdtsc(); }
+#else
+ #define UNIT "ns"
+ static uint64_t now(void)
+ {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+ }
+#endif
+
+typedef struct {
+    char name[32];
+    double cost;
+} result_t;
+
+static result_t results[MAX_RESULTS];
+static uint32_t num_results;
+
+static void result(const char *name, uint64_t total, uint32_t ops)
+{
+    if (num_results < MAX_RESULTS) {
+        strncpy(results[num_results].name, name, sizeof(results[0].name) - 1);
+        results[num_results].cost = (double) total / ops;
+        num_results++;
+    }
+}
+
+/*
+ * past on a RAM flash, like past_test.c
+ */
+
+uint8_t past_blocks[PAST_NUM_BLOCKS][PAST_BLOCK_SIZE];
+static uint8_t saved_blocks[PAST_NUM_BLOCKS][PAST_BLOCK_SIZE];
+static past_t past, saved_past;
+
+void lock_flash(void) {}
+void unlock_flash(void) {}
+
+void flash_erase_page(uint32_t address)
+{
+    memset((char*) address, 0xff, PAST_BLOCK_SIZE);
+}
+
+void flash_program_word(uint32_t address, uint32_t data)
+{
+    *((uint32_t*) address) = data;
+}
+
+void flash_program_half_word(uint32_t address, uint16_t data)
+{
+    *((uint16_t*) address) = data;
+}
+
+bool flash_program_block(uint32_t address, const void *data, uint32_t length)
+{
+    memcpy((void*) address, data, length);
+    return true;
+}
+
+uint32_t flash_get_status_flags(void)
+{
+    return FLASH_SR_EOP;
+}
+
+static void past_save(void)
+{
+    memcpy(saved_blocks, past_blocks, sizeof(past_blocks));
+    saved_past = past;
+}
+
+static void past_restore(void)
+{
+    memcpy(past_blocks, saved_blocks, sizeof(past_blocks));
+    past = saved_past;
+}
+
+/** Format past and store <live> units of 8 bytes with ids 100 and up */
+static bool past_fill(uint32_t live)
+{
+    memset(past_blocks, 0xff, sizeof(past_blocks));
+    for (uint32_t i = 0; i < PAST_NUM_BLOCKS; i++) {
+        past.blocks[i] = (uint32_t) past_blocks[i];
+    }
+    if (!past_init(&past) || !past_format(&past)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < live; i++) {
+        uint32_t data[2] = { i, ~i };
+        if (!past_write_unit(&past, 100 + i, data, sizeof(data))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Cost of writing, reading and garbage collecting with <live> units stored */
+static bool bench_past(uint32_t live)
+{
+    char name[32];
+    uint64_t total;
+    uint32_t data[2] = { 0, 0 };
+    const void *p;
+    uint32_t length;
+
+    if (!past_fill(live)) {
+        return false;
+    }
+    past_save();
+
+    /** Overwrite a unit, restoring the fill level each time */
+    total = 0;
+    for (uint32_t i = 0; i < PAST_ROUNDS; i++) {
+        past_restore();
+        data[0] = i;
+        uint64_t start = now();
+        bool ok = past_write_unit(&past, 1, data, sizeof(data));
+        total += now() - start;
+        if (!ok) {
+            return false;
+        }
+    }
+    snprintf(name, sizeof(name), "past_write/%u", live);
+    result(name, total, PAST_ROUNDS);
+
+    /** Read the unit stored last, the worst case for a scan */
+    past_restore();
+    total = 0;
+    for (uint32_t i = 0; i < PAST_ROUNDS; i++) {
+        uint64_t start = now();
+        bool ok = past_read_unit(&past, live ? 100 + live - 1 : 1, &p, &length);
+        total += now() - start;
+        if (live && !ok) {
+            return false;
+        }
+    }
+    snprintf(name, sizeof(name), "past_read/%u", live);
+    result(name, total, PAST_ROUNDS);
+
+    /** Fill up with rewrites until the next write starts a GC, then time that
+        write and running the GC to completion */
+    past_restore();
+    uint32_t block = past._cur_block;
+    for (uint32_t i = 0; !past_gc_busy(&past) && past._cur_block == block; i++) {
+        past_save();
+        data[0]++;
+        if (i == PAST_BLOCK_SIZE || !past_write_unit(&past, 1, data, sizeof(data))) {
+            return false;
+        }
+    }
+    total = 0;
+    for (uint32_t i = 0; i < PAST_ROUNDS; i++) {
+        past_restore();
+        data[0]++;
+        uint64_t start = now();
+        bool ok = past_write_unit(&past, 1, data, sizeof(data));
+        while (ok && past_gc_busy(&past)) {
+            ok = past_gc_step(&past);
+        }
+        total += now() - start;
+        if (!ok) {
+            return false;
+        }
+    }
+    snprintf(name, sizeof(name), "past_gc/%u", live);
+    result(name, total, PAST_ROUNDS);
+    return true;
+}
+
+/*
+ * uframe
+ */
+
+static void pack_status(frame_t *frame)
+{
+    set_frame_header(frame);
+    pack8(frame, 0x84);
+    pack8(frame, 1);
+    pack16(frame, 12345);
+    pack16(frame, 5000);
+    pack16(frame, 1234);
+    pack8(frame, 1);
+    pack16(frame, 0x7e7d); /** Needs escaping */
+    pack32(frame, 0xdeadbeef);
+    pack_cstr(frame, "cv");
+    end_frame(frame);
+}
+
+static bool bench_uframe(void)
+{
+    frame_t frame, rx;
+    uint8_t raw[MAX_FRAME_LENGTH];
+    uint64_t total;
+    volatile uint32_t sink = 0;
+
+    total = 0;
+    for (uint32_t i = 0; i < CODEC_ROUNDS; i++) {
+        uint64_t start = now();
+        pack_status(&frame);
+        total += now() - start;
+    }
+    result("uframe_pack", total, CODEC_ROUNDS);
+
+    /** Extraction unescapes in place, work on a fresh copy each round */
+    total = 0;
+    for (uint32_t i = 0; i < CODEC_ROUNDS; i++) {
+        memcpy(raw, frame.buffer, frame.length);
+        uint64_t start = now();
+        int32_t len = uframe_extract_payload(&rx, raw, frame.length);
+        total += now() - start;
+        if (len <= 0) {
+            return false;
+        }
+    }
+    result("uframe_extract", total, CODEC_ROUNDS);
+
+    total = 0;
+    for (uint32_t i = 0; i < CODEC_ROUNDS; i++) {
+        uint64_t start = now();
+        uframe_start_receive(&rx);
+        int32_t len = 0;
+        for (uint32_t j = 0; j < frame.length && len == 0; j++) {
+            len = uframe_receive_byte(&rx, frame.buffer[j]);
+        }
+        total += now() - start;
+        if (len <= 0) {
+            return false;
+        }
+    }
+    result("uframe_receive", total, CODEC_ROUNDS);
+
+    memcpy(raw, frame.buffer, frame.length);
+    (void) uframe_extract_payload(&rx, raw, frame.length);
+    total = 0;
+    for (uint32_t i = 0; i < CODEC_ROUNDS; i++) {
+        uint8_t u8;
+        uint16_t u16;
+        uint32_t u32;
+        uint64_t start = now();
+        start_frame_unpacking(&rx);
+        unpack8(&rx, &u8);
+        unpack8(&rx, &u8);
+        unpack16(&rx, &u16);
+        unpack16(&rx, &u16);
+        unpack16(&rx, &u16);
+        unpack8(&rx, &u8);
+        unpack16(&rx, &u16);
+        unpack32(&rx, &u32);
+        total += now() - start;
+        sink ^= u8 ^ u16 ^ u32;
+    }
+    result("uframe_unpack", total, CODEC_ROUNDS);
+    (void) sink;
+    return true;
+}
+
+/*
+ * crc16
+ */
+
+static void bench_crc16(void)
+{
+    static uint8_t data[CRC_SIZE];
+    volatile uint16_t sink = 0;
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < sizeof(data); i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 16;
+    }
+    uint64_t start = now();
+    for (uint32_t i = 0; i < CRC_ROUNDS; i++) {
+        sink ^= crc16(data, sizeof(data));
+    }
+    /** Per byte, the cost of a frame is this times its length */
+    result("crc16/byte", now() - start, CRC_ROUNDS * CRC_SIZE);
+    (void) sink;
+}
+
+/*
+ * Waveforms, called from the ADC ISR at ~21kHz
+ */
+
+static uint16_t arb_table[128];
+
+static int32_t arb_gen(uint32_t phase, int32_t max)
+{
+    return wavegen_table(phase, max, arb_table, sizeof(arb_table) / sizeof(arb_table[0]));
+}
+
+static void bench_wave(const char *name, int32_t (*gen)(uint32_t, int32_t))
+{
+    volatile int32_t sink = 0;
+    uint32_t phase = 0;
+    uint64_t start = now();
+    for (uint32_t i = 0; i < WAVE_ROUNDS; i++) {
+        sink += gen(phase, 20000);
+        phase += 0x01234567;
+    }
+    result(name, now() - start, WAVE_ROUNDS);
+    (void) sink;
+}
+
+/*
+ * Glyph decoding, the kernels of decode_glyph() in tft.c with and without
+ * CONFIG_TFT_WIDE_GLYPH
+ */
+
+/** A meter color in display byte order, as ILI9163C_COLOR_TO_BITMASK() makes it */
+#define GLYPH_COLOR  (0x1FF8)
+
+static const uint64_t color_lookup4[256] = MONO2BPP_LOOKUP4(0x0001000100010001ULL * GLYPH_COLOR);
+static uint8_t glyph_data[GLYPH_BYTES];
+static uint32_t glyph_pixels[2 * GLYPH_BYTES];
+static uint32_t glyph_check[2 * GLYPH_BYTES];
+
+static void decode2(uint32_t *target32, uint32_t color_mask)
+{
+    for (size_t i = 0; i < GLYPH_BYTES; ++i) {
+        *target32++ = mono2bpp_lookup[glyph_data[i] & 0xF] & color_mask;
+        *target32++ = mono2bpp_lookup[glyph_data[i] >> 4] & color_mask;
+    }
+}
+
+static void decode4(uint32_t *target32, const uint64_t *lookup)
+{
+    for (size_t i = 0; i < GLYPH_BYTES; ++i) {
+        uint64_t pixels = lookup[glyph_data[i]];
+        *target32++ = (uint32_t) pixels;
+        *target32++ = (uint32_t) (pixels >> 32);
+    }
+}
+
+static void decode4_masked(uint32_t *target32, uint64_t and_mask)
+{
+    for (size_t i = 0; i < GLYPH_BYTES; ++i) {
+        uint64_t pixels = mono2bpp_lookup4[glyph_data[i]] & and_mask;
+        *target32++ = (uint32_t) pixels;
+        *target32++ = (uint32_t) (pixels >> 32);
+    }
+}
+
+static bool bench_glyph(void)
+{
+    uint32_t color_mask = ((uint32_t) GLYPH_COLOR << 16) | GLYPH_COLOR;
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < sizeof(glyph_data); i++) {
+        seed = seed * 1103515245 + 12345;
+        glyph_data[i] = seed >> 16;
+    }
+
+    /** Per glyph byte, four pixels */
+    uint64_t start = now();
+    for (uint32_t i = 0; i < GLYPH_ROUNDS; i++) {
+        decode2(glyph_pixels, 0xffffffff);
+    }
+    result("glyph2_white/byte", now() - start, GLYPH_ROUNDS * GLYPH_BYTES);
+    start = now();
+    for (uint32_t i = 0; i < GLYPH_ROUNDS; i++) {
+        decode2(glyph_pixels, color_mask);
+    }
+    result("glyph2_color/byte", now() - start, GLYPH_ROUNDS * GLYPH_BYTES);
+    memcpy(glyph_check, glyph_pixels, sizeof(glyph_check));
+
+    start = now();
+    for (uint32_t i = 0; i < GLYPH_ROUNDS; i++) {
+        decode4(glyph_pixels, mono2bpp_lookup4);
+    }
+    result("glyph4_white/byte", now() - start, GLYPH_ROUNDS * GLYPH_BYTES);
+    start = now();
+    for (uint32_t i = 0; i < GLYPH_ROUNDS; i++) {
+        decode4(glyph_pixels, color_lookup4);
+    }
+    result("glyph4_color/byte", now() - start, GLYPH_ROUNDS * GLYPH_BYTES);
+    bool ok = memcmp(glyph_check, glyph_pixels, sizeof(glyph_check)) == 0;
+    start = now();
+    for (uint32_t i = 0; i < GLYPH_ROUNDS; i++) {
+        decode4_masked(glyph_pixels, 0x0001000100010001ULL * GLYPH_COLOR);
+    }
+    result("glyph4_masked/byte", now() - start, GLYPH_ROUNDS * GLYPH_BYTES);
+    return ok && memcmp(glyph_check, glyph_pixels, sizeof(glyph_check)) == 0;
+}
+
+/*
+ * Baseline handling
+ */
+
+static bool save_baseline(const char *file_name)
+{
+    FILE *f = fopen(file_name, "w");
+    if (!f) {
+        return false;
+    }
+    for (uint32_t i = 0; i < num_results; i++) {
+        fprintf(f, "%s %.2f\n", results[i].name, results[i].cost);
+    }
+    fclose(f);
+    return true;
+}
+
+/** Cost of <name> in the baseline, negative if missing */
+static double baseline_cost(FILE *f, const char *name)
+{
+    char line[64], n[32];
+    double cost;
+    rewind(f);
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%31s %lf", n, &cost) == 2 && strcmp(n, name) == 0) {
+            return cost;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char const *argv[])
+{
+    const char *save_name = NULL;
+    FILE *baseline = NULL;
+    if (argc == 3 && strcmp(argv[1], "-w") == 0) {
+        save_name = argv[2];
+    } else if (argc == 2) {
+        baseline = fopen(argv[1], "r");
+        if (!baseline) {
+            printf("No baseline %s, save one with -w\n", argv[1]);
+        }
+    }
+
+    bool ok = true;
+    ok &= bench_past(1);
+    ok &= bench_past(24);
+    ok &= bench_past(48);
+    ok &= bench_uframe();
+    bench_crc16();
+    bench_wave("wave_square", wavegen_square);
+    bench_wave("wave_saw", wavegen_saw);
+    bench_wave("wave_sin", wavegen_sin);
+    bench_wave("wave_arb", arb_gen);
+    ok &= bench_glyph();
+    if (!ok) {
+        printf("Error: benchmark operation failed\n");
+        return 1;
+    }
+
+    printf("%-24s %12s %10s\n", "operation", UNIT "/op", "change");
+    for (uint32_t i = 0; i < num_results; i++) {
+        double old = baseline ? baseline_cost(baseline, results[i].name) : -1;
+        if (old > 0) {
+            printf("%-24s %12.2f %+9.1f%%\n", results[i].name, results[i].cost, 100 * (results[i].cost - old) / old);
+        } else {
+            printf("%-24s %12.2f\n", results[i].name, results[i].cost);
+        }
+    }
+    if (baseline) {
+        fclose(baseline);
+    }
+    if (save_name && !save_baseline(save_name)) {
+        printf("Error: could not write %s\n", save_name);
+        return 1;
+    }
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "dps-model.h"
+#include "dps-model-fix.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+/** Same conversion as pwrctl.c, the generated header must match it */
+static int32_t coef_to_fix(float coef)
+{
+    return coef * (1 << 16) + (coef < 0 ? -0.5f : 0.5f);
+}
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+int main(int argc, char const *argv[])
+{
+    /** Run make model if these fail after changing dps-model.h */
+    CHECK(A_ADC_K_FIX == coef_to_fix(A_ADC_K));
+    CHECK(A_ADC_C_FIX == coef_to_fix(A_ADC_C));
+    CHECK(A_DAC_K_FIX == coef_to_fix(A_DAC_K));
+    CHECK(A_DAC_C_FIX == coef_to_fix(A_DAC_C));
+    CHECK(V_ADC_K_FIX == coef_to_fix(V_ADC_K));
+    CHECK(V_ADC_C_FIX == coef_to_fix(V_ADC_C));
+    CHECK(V_DAC_K_FIX == coef_to_fix(V_DAC_K));
+    CHECK(V_DAC_C_FIX == coef_to_fix(V_DAC_C));
+    CHECK(VIN_ADC_K_FIX == coef_to_fix(VIN_ADC_K));
+    CHECK(VIN_ADC_C_FIX == coef_to_fix(VIN_ADC_C));
+    CHECK(A_ADC_K_INV_FIX == coef_to_fix(1.0f / A_ADC_K));
+    CHECK(V_ADC_K_INV_FIX == coef_to_fix(1.0f / V_ADC_K));
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "numfmt.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+/** Compare numfmt_int with snprintf */
+static bool int_matches(int32_t value)
+{
+    char buf[12], ref[12];
+    uint32_t len = numfmt_int(buf, sizeof(buf), value);
+    snprintf(ref, sizeof(ref), "%d", value);
+    return len == strlen(ref) && strcmp(buf, ref) == 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    uint8_t d[NUMFMT_MAX_DIGITS];
+    char buf[12];
+
+    for (uint32_t i = 0, p = 1; i < NUMFMT_MAX_DIGITS; i++, p *= 10) {
+        CHECK(numfmt_pow10(i) == p);
+    }
+    CHECK(numfmt_pow10(NUMFMT_MAX_DIGITS) == 0);
+
+    /** Fixed width with leading zeros */
+    numfmt_digits(1234, 0, 6, d);
+    CHECK(d[0] == 0 && d[1] == 0 && d[2] == 1 && d[3] == 2 && d[4] == 3 && d[5] == 4);
+
+    /** Digits from the middle of the value, as for a 2.2 item in mV */
+    numfmt_digits(12345, 1, 4, d);
+    CHECK(d[0] == 1 && d[1] == 2 && d[2] == 3 && d[3] == 4);
+    /** Digits above the wanted ones are dropped */
+    numfmt_digits(12345, 1, 3, d);
+    CHECK(d[0] == 2 && d[1] == 3 && d[2] == 4);
+
+    numfmt_digits(4294967295u, 0, 10, d);
+    CHECK(d[0] == 4 && d[1] == 2 && d[2] == 9 && d[9] == 5);
+    numfmt_digits(4294967295u, 8, 2, d);
+    CHECK(d[0] == 4 && d[1] == 2);
+
+    /** Against snprintf */
+    int32_t values[] = { 0, 1, -1, 9, 10, 99, 100, 5000, -5000, 65535, 999999999, 1000000000, 2147483647, -2147483647 - 1 };
+    for (uint32_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        CHECK(int_matches(values[i]));
+    }
+    bool ok = true;
+    for (int32_t v = -100000; v <= 100000; v += 7) {
+        ok &= int_matches(v);
+    }
+    CHECK(ok);
+
+    /** Too small buffers are left empty */
+    CHECK(numfmt_int(buf, 4, 999) == 3 && strcmp(buf, "999") == 0);
+    CHECK(numfmt_int(buf, 4, 1000) == 0 && buf[0] == 0);
+    CHECK(numfmt_int(buf, 4, -100) == 0 && buf[0] == 0);
+    CHECK(numfmt_int(buf, 0, 1) == 0);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "recorder.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+static uint16_t samples[RECORDER_SIZE];
+static uint64_t now_us;
+
+uint64_t get_time_us(void)
+{
+    return now_us;
+}
+
+int main(int argc, char const *argv[])
+{
+    recorder_info_t info;
+    bool ok;
+
+    /** Invalid configurations */
+    CHECK(!recorder_arm(0, 1, 10, 1 << recorder_trigger_now));
+    CHECK(!recorder_arm(RECORDER_CHA_I_OUT, 0, 10, 1 << recorder_trigger_now));
+    CHECK(!recorder_arm(RECORDER_CHA_I_OUT, 1, 0, 1 << recorder_trigger_now));
+    CHECK(!recorder_arm(RECORDER_CHA_I_OUT, 1, 10, 0));
+    CHECK(!recorder_arm(RECORDER_CHA_ALL, 1, RECORDER_SIZE / 3 + 1, 1 << recorder_trigger_now));
+
+    /** Immediate trigger, all channels */
+    now_us = 0x100000000ULL + 5;
+    CHECK(recorder_arm(RECORDER_CHA_ALL, 1, 4, 1 << recorder_trigger_now));
+    recorder_get_info(&info);
+    CHECK(info.state == recorder_triggered);
+    CHECK(info.trigger_time_us == 0x100000000ULL + 5);
+    CHECK(recorder_read(0, samples, RECORDER_SIZE) == 0);
+    for (uint16_t i = 0; i < 10; i++) {
+        recorder_sample(i, 100 + i, 200 + i);
+    }
+    recorder_get_info(&info);
+    CHECK(info.state == recorder_done);
+    CHECK(info.pre_count == 0);
+    CHECK(info.num_samples == 12);
+    CHECK(recorder_read(0, samples, RECORDER_SIZE) == 12);
+    CHECK(samples[0] == 0 && samples[1] == 100 && samples[2] == 200);
+    CHECK(samples[9] == 3 && samples[10] == 103 && samples[11] == 203);
+    /** Chunked reads */
+    CHECK(recorder_read(5, samples, 2) == 2 && samples[0] == 201 && samples[1] == 2);
+    CHECK(recorder_read(11, samples, 5) == 1 && samples[0] == 203);
+    CHECK(recorder_read(12, samples, 5) == 0);
+
+    /** Triggers that are not armed are ignored */
+    CHECK(recorder_arm(RECORDER_CHA_V_OUT, 1, 3, 1 << recorder_trigger_ocp));
+    recorder_sample(0, 0, 1);
+    recorder_trigger(recorder_trigger_ovp);
+    recorder_get_info(&info);
+    CHECK(info.state == recorder_armed);
+    recorder_sample(0, 0, 2);
+    now_us = 1234;
+    recorder_trigger(recorder_trigger_ocp);
+    now_us = 5678;
+    recorder_get_info(&info);
+    CHECK(info.state == recorder_triggered && info.trigger == recorder_trigger_ocp);
+    CHECK(info.trigger_time_us == 1234);
+    for (uint16_t i = 3; i < 10; i++) {
+        recorder_sample(0, 0, i);
+    }
+    recorder_get_info(&info);
+    CHECK(info.state == recorder_done);
+    CHECK(info.pre_count == 2);
+    CHECK(info.num_samples == 5);
+    CHECK(recorder_read(0, samples, RECORDER_SIZE) == 5);
+    ok = true;
+    for (uint16_t i = 0; i < 5; i++) {
+        ok &= samples[i] == i + 1;
+    }
+    CHECK(ok);
+
+    /** Pre trigger history wraps, decimation keeps every third set */
+    CHECK(recorder_arm(RECORDER_CHA_I_OUT | RECORDER_CHA_V_IN, 3, 10, 1 << recorder_trigger_ovp));
+    uint16_t seq = 0;
+    for (uint32_t i = 0; i < 3 * RECORDER_SIZE; i++) {
+        seq++;
+        recorder_sample(seq, seq, 0);
+    }
+    recorder_trigger(recorder_trigger_ovp);
+    for (uint32_t i = 0; i < 3 * 20; i++) {
+        seq++;
+        recorder_sample(seq, seq, 0);
+    }
+    recorder_get_info(&info);
+    CHECK(info.state == recorder_done);
+    CHECK(info.pre_count == RECORDER_SIZE / 2 - 10);
+    CHECK(info.num_samples == RECORDER_SIZE);
+    CHECK(recorder_read(0, samples, RECORDER_SIZE) == RECORDER_SIZE);
+    /** The last set is the 10th after the trigger */
+    CHECK(samples[RECORDER_SIZE - 1] == 3 * RECORDER_SIZE + 30);
+    ok = true;
+    for (uint32_t i = 0; i < RECORDER_SIZE; i += 2) {
+        ok &= samples[i] == samples[i + 1];
+        ok &= i == 0 || samples[i] == samples[i - 2] + 3;
+    }
+    CHECK(ok);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
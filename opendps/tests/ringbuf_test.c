@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "ringbuf.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define RING_SIZE  (8)
+
+static uint16_t ring_buffer[RING_SIZE];
+static ringbuf_t ring;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+int main(int argc, char const *argv[])
+{
+    uint16_t word;
+    ringbuf_init(&ring, (uint8_t*) ring_buffer, sizeof(ring_buffer));
+
+    /** All elements can be used */
+    CHECK(ringbuf_free(&ring) == RING_SIZE);
+    CHECK(ringbuf_used(&ring) == 0);
+    CHECK(!ringbuf_get(&ring, &word));
+
+    for (uint16_t i = 0; i < RING_SIZE; i++) {
+        CHECK(ringbuf_put(&ring, i));
+    }
+    CHECK(ringbuf_free(&ring) == 0);
+    CHECK(ringbuf_used(&ring) == RING_SIZE);
+    CHECK(!ringbuf_put(&ring, 0xffff));
+
+    CHECK(ringbuf_get(&ring, &word) && word == 0);
+    CHECK(ringbuf_get(&ring, &word) && word == 1);
+    CHECK(ringbuf_free(&ring) == 2);
+
+    /** Wrap around the end of the buffer */
+    CHECK(ringbuf_put(&ring, 100));
+    CHECK(ringbuf_put(&ring, 101));
+    CHECK(ringbuf_free(&ring) == 0);
+    for (uint16_t i = 2; i < RING_SIZE; i++) {
+        CHECK(ringbuf_get(&ring, &word) && word == i);
+    }
+    CHECK(ringbuf_get(&ring, &word) && word == 100);
+    CHECK(ringbuf_get(&ring, &word) && word == 101);
+    CHECK(!ringbuf_get(&ring, &word));
+    CHECK(ringbuf_free(&ring) == RING_SIZE);
+
+    /** Interleaved put/get over many laps */
+    bool ok = true;
+    for (uint32_t i = 0; i < 10 * RING_SIZE; i++) {
+        ok &= ringbuf_put(&ring, i);
+        ok &= ringbuf_put(&ring, i + 1);
+        ok &= ringbuf_get(&ring, &word) && word == (uint16_t) i;
+        ok &= ringbuf_get(&ring, &word) && word == (uint16_t) (i + 1);
+        ok &= ringbuf_free(&ring) == RING_SIZE;
+    }
+    CHECK(ok);
+
+    /** Storage that is not a power of two elements is rounded down */
+    ringbuf_init(&ring, (uint8_t*) ring_buffer, sizeof(ring_buffer) - 2);
+    CHECK(ringbuf_free(&ring) == RING_SIZE / 2);
+
+    /** Bulk transfers wrap in two copies and stop when full or empty */
+    uint8_t bytes[RING_SIZE * 2];
+    uint8_t out[RING_SIZE * 2];
+    for (uint32_t i = 0; i < sizeof(bytes); i++) {
+        bytes[i] = 0x40 + i;
+    }
+    ringbuf_init8(&ring, (uint8_t*) ring_buffer, sizeof(ring_buffer));
+    CHECK(ringbuf_free(&ring) == 2 * RING_SIZE);
+    CHECK(ringbuf_put_n(&ring, bytes, 5) == 5);
+    CHECK(ringbuf_get_n(&ring, out, 3) == 3 && out[0] == 0x40 && out[2] == 0x42);
+    CHECK(ringbuf_put_n(&ring, bytes, sizeof(bytes)) == 2 * RING_SIZE - 2);
+    CHECK(ringbuf_free(&ring) == 0);
+    CHECK(ringbuf_get_n(&ring, out, sizeof(out)) == 2 * RING_SIZE);
+    CHECK(out[0] == 0x43 && out[1] == 0x44 && out[2] == 0x40 && out[2 * RING_SIZE - 1] == 0x40 + 2 * RING_SIZE - 3);
+    CHECK(ringbuf_get_n(&ring, out, sizeof(out)) == 0);
+
+    /** Single bytes and words share the counters with the bulk functions */
+    uint8_t byte;
+    CHECK(ringbuf_put8(&ring, 0x5a) && ringbuf_get8(&ring, &byte) && byte == 0x5a);
+    CHECK(!ringbuf_get8(&ring, &byte));
+    uint16_t words[3] = {0x1234, 0x5678, 0x9abc};
+    uint16_t words_out[3] = {0, 0, 0};
+    ringbuf_init(&ring, (uint8_t*) ring_buffer, sizeof(ring_buffer));
+    CHECK(ringbuf_put_n(&ring, words, 3) == 3 && ringbuf_get(&ring, &word) && word == 0x1234);
+    CHECK(ringbuf_get_n(&ring, words_out, 3) == 2 && words_out[0] == 0x5678 && words_out[1] == 0x9abc);
+
+    /** Spans end at the end of the storage */
+    const void *rspan;
+    void *wspan;
+    ringbuf_init8(&ring, (uint8_t*) ring_buffer, sizeof(ring_buffer));
+    CHECK(ringbuf_put_n(&ring, bytes, 2 * RING_SIZE - 2) == 2 * RING_SIZE - 2);
+    CHECK(ringbuf_get_n(&ring, out, 2 * RING_SIZE - 4) == 2 * RING_SIZE - 4);
+    CHECK(ringbuf_write_span(&ring, &wspan) == 2 && wspan == (uint8_t*) ring_buffer + 2 * RING_SIZE - 2);
+    ((uint8_t*) wspan)[0] = 0xa0;
+    ((uint8_t*) wspan)[1] = 0xa1;
+    ringbuf_commit(&ring, 2);
+    CHECK(ringbuf_write_span(&ring, &wspan) == 2 * RING_SIZE - 4 && wspan == (uint8_t*) ring_buffer);
+    CHECK(ringbuf_read_span(&ring, &rspan) == 4 && rspan == (uint8_t*) ring_buffer + 2 * RING_SIZE - 4);
+    CHECK(((const uint8_t*) rspan)[2] == 0xa0);
+    ringbuf_consume(&ring, 4);
+    CHECK(ringbuf_read_span(&ring, &rspan) == 0 && ringbuf_free(&ring) == 2 * RING_SIZE);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "recorder.h"
+#include "ripple.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+/** Within 3% of the expected raw value, amplitudes carry RIPPLE_FRAC_BITS */
+#define NEAR(value, expected) \
+    (fabs((value) / (double) (1 << RIPPLE_FRAC_BITS) - (expected)) <= 0.03 * (expected) + 0.05)
+
+uint64_t get_time_us(void)
+{
+    return 0;
+}
+
+/**
+ * Record sets whose V_out is a DC level with two tones, I_out and V_in
+ * carry other values
+ */
+static void record(uint8_t channels, uint16_t decimation, uint32_t rate_hz)
+{
+    uint32_t stride = !!(channels & RECORDER_CHA_I_OUT) + !!(channels & RECORDER_CHA_V_IN) + !!(channels & RECORDER_CHA_V_OUT);
+    uint32_t sets = RECORDER_SIZE / stride;
+    recorder_arm(channels, decimation, sets, 1 << recorder_trigger_now);
+    for (uint32_t i = 0; i < sets * decimation; i++) {
+        double t = (double) i / rate_hz;
+        double v_out = 2000 + 10 * sin(2 * M_PI * 1000 * t) + 3 * sin(2 * M_PI * 3150 * t + 1);
+        recorder_sample(100, 3000, (uint16_t) lround(v_out));
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    ripple_result_t result;
+    uint16_t freqs[] = { 1000, 3150, 6000, 100 };
+
+    /** Nothing recorded */
+    CHECK(!ripple_analyze(RECORDER_CHA_V_OUT, 0, freqs, 4, &result));
+
+    record(RECORDER_CHA_ALL, 1, RIPPLE_SAMPLE_HZ);
+    /** Invalid parameters */
+    CHECK(!ripple_analyze(0, 0, freqs, 4, &result));
+    CHECK(!ripple_analyze(RECORDER_CHA_V_OUT | RECORDER_CHA_I_OUT, 0, freqs, 4, &result));
+    CHECK(!ripple_analyze(RECORDER_CHA_V_OUT, 0, freqs, RIPPLE_MAX_BINS + 1, &result));
+    uint16_t nyquist = RIPPLE_SAMPLE_HZ / 2;
+    CHECK(!ripple_analyze(RECORDER_CHA_V_OUT, 0, &nyquist, 1, &result));
+
+    /** V_out is the last channel of a set */
+    CHECK(ripple_analyze(RECORDER_CHA_V_OUT, 0, freqs, 4, &result));
+    CHECK(result.num_samples == RECORDER_SIZE / 3);
+    CHECK(result.min >= 1987 && result.min <= 1990 && result.max >= 2010 && result.max <= 2013);
+    CHECK(NEAR(result.mean, 2000));
+    CHECK(NEAR(result.rms, sqrt((10 * 10 + 3 * 3) / 2.0)));
+    CHECK(NEAR(result.amplitude[0], 10));
+    CHECK(NEAR(result.amplitude[1], 3));
+    CHECK(result.amplitude[2] < (1 << RIPPLE_FRAC_BITS) / 4);
+    CHECK(result.amplitude[3] < (1 << RIPPLE_FRAC_BITS) / 4);
+    CHECK(result.dominant == 0);
+
+    /** Other channels hold constants */
+    CHECK(ripple_analyze(RECORDER_CHA_V_IN, 0, freqs, 1, &result));
+    CHECK(result.min == 3000 && result.max == 3000 && result.rms == 0 && result.amplitude[0] == 0);
+    CHECK(result.mean == 3000 << RIPPLE_FRAC_BITS);
+
+    /** A single channel, decimated, at a rate given by the host */
+    record(RECORDER_CHA_V_OUT, 2, 40000);
+    CHECK(ripple_analyze(RECORDER_CHA_V_OUT, 40000, freqs, 2, &result));
+    CHECK(result.num_samples == RECORDER_SIZE);
+    CHECK(NEAR(result.amplitude[0], 10));
+    CHECK(NEAR(result.amplitude[1], 3));
+    /** The wrong rate misses the tones */
+    CHECK(ripple_analyze(RECORDER_CHA_V_OUT, 0, freqs, 2, &result));
+    CHECK(result.amplitude[0] < 5 << RIPPLE_FRAC_BITS);
+    /** Not recorded */
+    CHECK(!ripple_analyze(RECORDER_CHA_I_OUT, 40000, freqs, 2, &result));
+
+    /** No bins, just the statistics */
+    CHECK(ripple_analyze(RECORDER_CHA_V_OUT, 40000, freqs, 0, &result));
+    CHECK(NEAR(result.rms, sqrt((10 * 10 + 3 * 3) / 2.0)));
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sched.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+static uint64_t now, now_us;
+static uint32_t a_count, b_count, c_count;
+static sched_job_t a_job, b_job, c_job;
+static char order[16];
+static uint32_t order_len;
+
+/** The tests count in ms, the scheduler runs on the us time base */
+uint64_t get_time_us(void)
+{
+    return now * 1000 + now_us;
+}
+
+static void a(void)
+{
+    a_count++;
+    order[order_len++] = 'a';
+}
+
+static void b(void)
+{
+    b_count++;
+    order[order_len++] = 'b';
+}
+
+/** Restarts job a from within the scheduler */
+static void c(void)
+{
+    c_count++;
+    order[order_len++] = 'c';
+    sched_start(&a_job, &a, 5, 0);
+}
+
+int main(int argc, char const *argv[])
+{
+    CHECK(sched_run() == UINT32_MAX);
+
+    /** Periodic job, due now */
+    sched_start(&a_job, &a, 0, 10);
+    CHECK(sched_active(&a_job));
+    CHECK(sched_run() == 10 && a_count == 1);
+    now = 9;
+    CHECK(sched_run() == 1 && a_count == 1);
+    now = 10;
+    CHECK(sched_run() == 10 && a_count == 2);
+
+    /** Late runs keep the grid, runs more than a period behind are skipped */
+    now = 25;
+    CHECK(sched_run() == 5 && a_count == 3);
+    now = 100;
+    CHECK(sched_run() == 10 && a_count == 4);
+
+    /** One-shot jobs run once and run in due order */
+    order_len = 0;
+    sched_start(&b_job, &b, 3, 0);
+    CHECK(sched_run() == 3);
+    now = 110;
+    CHECK(sched_run() == 10 && b_count == 1 && a_count == 5);
+    CHECK(order_len == 2 && order[0] == 'b' && order[1] == 'a');
+    CHECK(!sched_active(&b_job));
+
+    /** Restarting moves a job, cancelling removes it */
+    sched_start(&a_job, &a, 50, 0);
+    CHECK(sched_run() == 50);
+    sched_cancel(&a_job);
+    sched_cancel(&a_job);
+    CHECK(!sched_active(&a_job));
+    CHECK(sched_run() == UINT32_MAX);
+    now = 200;
+    CHECK(sched_run() == UINT32_MAX && a_count == 5);
+
+    /** Jobs may start other jobs */
+    sched_start(&c_job, &c, 0, 0);
+    CHECK(sched_run() == 5 && c_count == 1 && sched_active(&a_job));
+    now = 205;
+    CHECK(sched_run() == UINT32_MAX && a_count == 6);
+
+    /** Part of a ms left is reported as a whole ms */
+    sched_start(&a_job, &a, 2, 0);
+    now_us = 1500;
+    CHECK(sched_run() == 1 && a_count == 6);
+    now_us = 1999;
+    CHECK(sched_run() == 1 && a_count == 6);
+    now_us = 2000;
+    CHECK(sched_run() == UINT32_MAX && a_count == 7);
+
+    /** Absolute due times, a passed one is due right away */
+    now_us = 0;
+    sched_start_at(&a_job, &a, 300500, 0);
+    CHECK(sched_run() == 96 && a_count == 7);
+    now = 300;
+    now_us = 500;
+    CHECK(sched_run() == UINT32_MAX && a_count == 8);
+    sched_start_at(&a_job, &a, 1000, 0);
+    CHECK(sched_run() == UINT32_MAX && a_count == 9);
+
+    /** One job at a time, the one due the longest first */
+    order_len = 0;
+    sched_start(&a_job, &a, 2, 0);
+    sched_start(&b_job, &b, 1, 0);
+    CHECK(!sched_run_next());
+    now = 302;
+    CHECK(sched_run_next() && order_len == 1 && order[0] == 'b');
+    CHECK(sched_run_next() && order_len == 2 && order[1] == 'a');
+    CHECK(!sched_run_next() && sched_run() == UINT32_MAX);
+
+    /** Nothing watched is healthy */
+    CHECK(sched_watched(NULL) == NULL && sched_healthy());
+
+    /** Watched jobs count runs, misses and worst timing */
+    now = 1000;
+    sched_start(&a_job, &a, 0, 10);
+    sched_start(&b_job, &b, 0, 100);
+    sched_watch(&a_job, "a", 2, true);
+    sched_watch(&b_job, "b", 0, false);
+    CHECK(sched_watched(NULL) == &a_job && sched_watched(&a_job) == &b_job && sched_watched(&b_job) == NULL);
+    (void) sched_run();
+    CHECK(a_job.runs == 1 && a_job.misses == 0 && b_job.runs == 1 && b_job.misses == 0);
+    now = 1012;
+    CHECK(sched_healthy());
+    (void) sched_run();
+    CHECK(a_job.runs == 2 && a_job.misses == 0 && a_job.late_max_us == 2000);
+    now = 1023;
+    CHECK(!sched_healthy());
+    (void) sched_run();
+    CHECK(sched_healthy());
+    CHECK(a_job.runs == 3 && a_job.misses == 1 && a_job.late_max_us == 3000);
+    CHECK(b_job.runs == 1);
+
+    /** Watching again changes the settings but keeps the order */
+    sched_watch(&a_job, "a", 5, true);
+    CHECK(sched_watched(NULL) == &a_job && sched_watched(&b_job) == NULL && a_job.deadline_ms == 5);
+
+    /** A cancelled critical job fails the check, others do not */
+    sched_cancel(&b_job);
+    CHECK(sched_healthy());
+    sched_cancel(&a_job);
+    CHECK(!sched_healthy());
+    sched_watch(&a_job, "a", 5, false);
+    CHECK(sched_healthy());
+
+    sched_reset_stats();
+    CHECK(a_job.runs == 0 && a_job.misses == 0 && a_job.late_max_us == 0 && b_job.runs == 0);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
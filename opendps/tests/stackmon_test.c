@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "stackmon.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+/**
+ * The RAM the linker symbols point into, set with --defsym in the Makefile:
+ * .data and .bss 104 bytes, .ramfunc 16 and the stack the remaining 904.
+ * The host linker defines _edata itself, the .data/.bss split is not tested.
+ */
+uint32_t fake_ram[256];
+#define STACK_BOTTOM (fake_ram + 30)
+#define STACK_WORDS  (256 - 30)
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+int main(int argc, char const *argv[])
+{
+    ram_stats_t stats;
+    for (uint32_t i = 0; i < 256; i++) {
+        fake_ram[i] = i;
+    }
+    stackmon_paint();
+    /** The static data is left alone, the stack above it is painted */
+    CHECK(fake_ram[29] == 29);
+    CHECK(STACK_BOTTOM[0] == STACKMON_PAINT && fake_ram[255] == STACKMON_PAINT);
+
+    stackmon_get(&stats);
+    CHECK((uint16_t) (stats.data_bytes + stats.bss_bytes) == 104);
+    CHECK(stats.ramfunc_bytes == 16);
+    CHECK(stats.stack_bytes == STACK_WORDS * 4);
+    CHECK(stats.stack_peak == 0);
+
+    /** The deepest word written counts, not the current one */
+    fake_ram[255] = 0;
+    fake_ram[200] = 0;
+    stackmon_get(&stats);
+    CHECK(stats.stack_peak == (256 - 200) * 4);
+    fake_ram[200] = STACKMON_PAINT; // A pushed word equal to the paint is missed
+    stackmon_get(&stats);
+    CHECK(stats.stack_peak == 4);
+
+    /** An overflow into the static data shows as a full stack */
+    STACK_BOTTOM[0] = 0;
+    stackmon_get(&stats);
+    CHECK(stats.stack_peak == stats.stack_bytes);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
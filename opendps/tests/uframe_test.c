@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "uframe.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+/** Feed a frame to uframe_receive_byte() and return the final status */
+static int32_t receive(frame_t *rx, const uint8_t *data, uint32_t length)
+{
+    int32_t status = 0;
+    uframe_start_receive(rx);
+    for (uint32_t i = 0; i < length && status == 0; i++) {
+        status = uframe_receive_byte(rx, data[i]);
+    }
+    return status;
+}
+
+/** Build fragment index of msg into a frame and return it as received */
+static void fragment(frame_t *rx, const umsg_t *msg, uint32_t index, uint8_t flags)
+{
+    frame_t tx;
+    set_frame_header(&tx);
+    pack8(&tx, 0x42); /** The protocol's command byte */
+    umsg_pack_fragment(&tx, msg, index, flags);
+    end_frame(&tx);
+    receive(rx, tx.buffer, tx.length);
+    uint8_t cmd;
+    start_frame_unpacking(rx);
+    unpack8(rx, &cmd);
+}
+
+int main(int argc, char const *argv[])
+{
+    frame_t tx, rx;
+    uint8_t payload[] = {0x01, _SOF, 0x02, _DLE, _EOF, 0x03};
+
+    set_frame_header(&tx);
+    for (uint32_t i = 0; i < sizeof(payload); i++) {
+        pack8(&tx, payload[i]);
+    }
+    end_frame(&tx);
+
+    /** Escaped bytes are restored and the CRC is dropped */
+    CHECK(receive(&rx, tx.buffer, tx.length) == sizeof(payload));
+    CHECK(rx.length == sizeof(payload) && memcmp(rx.buffer, payload, sizeof(payload)) == 0);
+
+    uint8_t u8;
+    start_frame_unpacking(&rx);
+    CHECK(unpack8(&rx, &u8) == 1 && u8 == 0x01);
+    CHECK(unpack8(&rx, &u8) == 1 && u8 == _SOF);
+
+    /** Same result as extracting the buffered frame */
+    uint8_t raw[MAX_FRAME_LENGTH];
+    frame_t extracted;
+    memcpy(raw, tx.buffer, tx.length);
+    CHECK(uframe_extract_payload(&extracted, raw, tx.length) == sizeof(payload));
+    CHECK(memcmp(extracted.buffer, payload, sizeof(payload)) == 0);
+
+    /** A corrupted byte fails the CRC */
+    memcpy(raw, tx.buffer, tx.length);
+    raw[1] ^= 0x40;
+    CHECK(receive(&rx, raw, tx.length) == -E_CRC);
+
+    /** A SOF restarts the frame */
+    raw[0] = _SOF;
+    raw[1] = 0x55;
+    memcpy(&raw[2], tx.buffer, tx.length);
+    CHECK(receive(&rx, raw, tx.length + 2) == sizeof(payload));
+
+    /** Frames without payload or larger than the buffer are rejected */
+    uint8_t empty[] = {_SOF, 0x00, 0x00, _EOF};
+    CHECK(receive(&rx, empty, sizeof(empty)) == -E_LEN);
+    uint8_t big[MAX_FRAME_LENGTH + 8];
+    memset(big, 0x11, sizeof(big));
+    big[0] = _SOF;
+    CHECK(receive(&rx, big, sizeof(big)) == -E_LEN);
+
+    /** A message is split and put back together */
+    uint8_t tx_buf[300], rx_buf[300];
+    umsg_t out, in;
+    umsg_init(&out, tx_buf, sizeof(tx_buf));
+    umsg_init(&in, rx_buf, sizeof(rx_buf));
+    umsg_start(&out, 7);
+    for (uint32_t i = 0; i < 120; i++) {
+        umsg_pack8(&out, i == 5 ? _SOF : (uint8_t) i);
+    }
+    umsg_pack16(&out, 0x1234);
+    umsg_pack32(&out, 0xdeadbeef);
+    umsg_pack_cstr(&out, "ok");
+    CHECK(!out.overflow && out.length == 129);
+    CHECK(umsg_fragments(&out) == 3);
+
+    fragment(&rx, &out, 0, 0);
+    CHECK(umsg_receive_fragment(&in, &rx) == 0);
+    CHECK(in.active && in.id == 7 && in.length == 129 && in.next == 1);
+    /** A lost fragment, the next one is dropped and the ack asks for it */
+    fragment(&rx, &out, 2, UFRAME_FRAG_ACK);
+    CHECK(umsg_receive_fragment(&in, &rx) == UMSG_ACK && in.next == 1);
+    CHECK(umsg_ack(&out, 7, in.next) && out.next == 1);
+    CHECK(!umsg_ack(&out, 8, 1));
+    CHECK(!umsg_ack(&out, 7, 4));
+    fragment(&rx, &out, 1, 0);
+    CHECK(umsg_receive_fragment(&in, &rx) == 0 && in.next == 2);
+    fragment(&rx, &out, 1, UFRAME_FRAG_ACK);
+    CHECK(umsg_receive_fragment(&in, &rx) == UMSG_ACK && in.next == 2);
+    fragment(&rx, &out, 2, UFRAME_FRAG_ACK);
+    CHECK(umsg_receive_fragment(&in, &rx) == UMSG_COMPLETE);
+    CHECK(in.length == out.length && memcmp(rx_buf, tx_buf, out.length) == 0);
+    /** The escaped frame of a fragment fits in a tagged envelope */
+    CHECK(uframe_escaped_length(tx_buf, UFRAME_FRAGMENT_DATA) == UFRAME_FRAGMENT_DATA + 1);
+    CHECK(FRAME_OVERHEAD(6 + 2 + UFRAME_FRAGMENT_DATA) <= MAX_FRAME_LENGTH);
+
+    /** Fragment 0 of another id starts over, a message too large fails */
+    umsg_start(&out, 8);
+    umsg_pack8(&out, 0x99);
+    fragment(&rx, &out, 0, UFRAME_FRAG_ACK);
+    CHECK(umsg_receive_fragment(&in, &rx) == UMSG_COMPLETE && in.length == 1 && rx_buf[0] == 0x99);
+    umsg_init(&in, rx_buf, 16);
+    umsg_start(&out, 9);
+    for (uint32_t i = 0; i < 17; i++) {
+        umsg_pack8(&out, i);
+    }
+    fragment(&rx, &out, 0, UFRAME_FRAG_ACK);
+    CHECK(umsg_receive_fragment(&in, &rx) == -E_LEN && !in.active);
+    umsg_init(&out, tx_buf, 2);
+    umsg_start(&out, 10);
+    umsg_pack16(&out, 1);
+    CHECK(!out.overflow);
+    umsg_pack8(&out, 1);
+    CHECK(out.overflow && out.length == 2);
+
+    /** pack_bytes and pack_cstr build the same frame as pack8 */
+    frame_t bulk;
+    uint8_t block[MAX_FRAME_LENGTH];
+    for (uint32_t i = 0; i < sizeof(block); i++) {
+        block[i] = i % 7 == 3 ? _SOF + i % 3 : i; /** Runs broken up by _SOF, _DLE and _EOF */
+    }
+    for (uint32_t len = 0; len <= sizeof(block); len += 11) {
+        set_frame_header(&tx);
+        pack8(&tx, 0x42);
+        for (uint32_t i = 0; i < len; i++) {
+            pack8(&tx, block[i]);
+        }
+        end_frame(&tx);
+        set_frame_header(&bulk);
+        pack8(&bulk, 0x42);
+        pack_bytes(&bulk, block, len);
+        end_frame(&bulk);
+        CHECK(bulk.length == tx.length && memcmp(bulk.buffer, tx.buffer, tx.length) == 0);
+    }
+    set_frame_header(&tx);
+    for (const char *c = "p}~\x7f"; *c; c++) {
+        pack8(&tx, *c);
+    }
+    pack8(&tx, 0);
+    set_frame_header(&bulk);
+    pack_cstr(&bulk, "p}~\x7f");
+    CHECK(bulk.length == tx.length && bulk.crc == tx.crc && memcmp(bulk.buffer, tx.buffer, tx.length) == 0);
+
+    /** unpack_bytes reads on from unpack8 and zero fills past the end */
+    uint8_t bytes[8];
+    set_frame_header(&tx);
+    pack_bytes(&tx, payload, sizeof(payload));
+    end_frame(&tx);
+    CHECK(receive(&rx, tx.buffer, tx.length) == sizeof(payload));
+    start_frame_unpacking(&rx);
+    CHECK(unpack8(&rx, &u8) == 1 && u8 == 0x01);
+    CHECK(unpack_bytes(&rx, bytes, 3) == 3 && memcmp(bytes, &payload[1], 3) == 0);
+    memset(bytes, 0xff, sizeof(bytes));
+    CHECK(unpack_bytes(&rx, bytes, 4) == 2 && bytes[0] == _EOF && bytes[1] == 0x03 && bytes[2] == 0 && bytes[3] == 0);
+    CHECK(rx.length == 0);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
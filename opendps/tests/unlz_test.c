@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "unlz.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+#define OUT_SIZE (64)
+
+static uint8_t out[OUT_SIZE];
+static uint32_t out_len;
+
+static bool put(void *ctx, uint8_t byte)
+{
+    if (out_len >= OUT_SIZE) {
+        return false;
+    }
+    out[out_len++] = byte;
+    return true;
+}
+
+static uint8_t peek(void *ctx, uint16_t distance)
+{
+    return out[out_len - distance];
+}
+
+/** Decode stream fed in pieces of step bytes */
+static bool decode(unlz_t *lz, const uint8_t *data, uint32_t length, uint32_t step)
+{
+    bool ok = true;
+    out_len = 0;
+    unlz_init(lz, put, peek, 0);
+    for (uint32_t i = 0; i < length && ok; i += step) {
+        ok = unlz_feed(lz, &data[i], length - i < step ? length - i : step);
+    }
+    return ok;
+}
+
+int main(int argc, char const *argv[])
+{
+    unlz_t lz;
+    /** "abcabcabcX" as 3 literals, a 6 byte match 3 back and a literal */
+    uint8_t stream[] = {0x02, 'a', 'b', 'c', 0x80 | 3, 0x00, 0x03, 0x00, 'X'};
+    const char *expect = "abcabcabcX";
+
+    CHECK(decode(&lz, stream, sizeof(stream), sizeof(stream)));
+    CHECK(unlz_done(&lz));
+    CHECK(out_len == strlen(expect) && memcmp(out, expect, out_len) == 0);
+
+    /** Token boundaries may fall anywhere */
+    CHECK(decode(&lz, stream, sizeof(stream), 1));
+    CHECK(unlz_done(&lz));
+    CHECK(out_len == strlen(expect) && memcmp(out, expect, out_len) == 0);
+
+    /** Distance 1 repeats the last byte */
+    uint8_t rle[] = {0x00, 0xff, 0x80 | 7, 0x00, 0x01};
+    CHECK(decode(&lz, rle, sizeof(rle), 2));
+    CHECK(out_len == 11);
+    bool ok = true;
+    for (uint32_t i = 0; i < out_len; i++) {
+        ok &= out[i] == 0xff;
+    }
+    CHECK(ok);
+
+    /** Stream cut in the middle of a token */
+    CHECK(decode(&lz, stream, sizeof(stream) - 4, 4));
+    CHECK(!unlz_done(&lz));
+
+    /** References before the start of the output are rejected */
+    uint8_t bad[] = {0x00, 'a', 0x80, 0x00, 0x02};
+    CHECK(!decode(&lz, bad, sizeof(bad), sizeof(bad)));
+    uint8_t zero[] = {0x00, 'a', 0x80, 0x00, 0x00};
+    CHECK(!decode(&lz, zero, sizeof(zero), sizeof(zero)));
+
+    /** Output failures abort decoding */
+    uint8_t big[] = {0x00, 'a', 0xff, 0x00, 0x01};
+    CHECK(!decode(&lz, big, sizeof(big), sizeof(big)));
+    CHECK(out_len == OUT_SIZE);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "uframe.h"
+#include "protocol.h"
+
+uint32_t g_num_fail, g_num_pass;
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+/** Send a frame through uframe_receive_byte() as the device would get it */
+static bool receive(frame_t *rx, const frame_t *tx)
+{
+    int32_t status = 0;
+    uframe_start_receive(rx);
+    for (uint32_t i = 0; i < tx->length && status == 0; i++) {
+        status = uframe_receive_byte(rx, tx->buffer[i]);
+    }
+    return status > 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    frame_t tx, rx;
+    uint16_t samples[WAVE_UPLOAD_CHUNK + 1];
+    uint16_t out[WAVE_UPLOAD_CHUNK];
+    uint8_t flags, offset, count;
+
+    /** Samples with bytes that need escaping */
+    for (uint32_t i = 0; i < WAVE_UPLOAD_CHUNK + 1; i++) {
+        samples[i] = (i & 1) ? (_SOF << 8 | _EOF) : (uint16_t) (i * 0x0911);
+    }
+
+    /** A full chunk makes the round trip */
+    protocol_create_wave_upload(&tx, WAVE_UPLOAD_COMMIT, 100, WAVE_UPLOAD_CHUNK, samples);
+    CHECK(tx.length <= MAX_FRAME_LENGTH);
+    /** Also with every byte escaped in a tagged and addressed envelope */
+    CHECK(FRAME_OVERHEAD(4 + 2 * WAVE_UPLOAD_CHUNK + 2 * ENVELOPE_LENGTH) <= MAX_FRAME_LENGTH);
+    CHECK(receive(&rx, &tx));
+    memset(out, 0, sizeof(out));
+    CHECK(protocol_unpack_wave_upload(&rx, &flags, &offset, &count, out));
+    CHECK(flags == WAVE_UPLOAD_COMMIT && offset == 100 && count == WAVE_UPLOAD_CHUNK);
+    CHECK(memcmp(out, samples, sizeof(out)) == 0);
+
+    /** So do a few samples and none */
+    protocol_create_wave_upload(&tx, 0, 0, 4, samples);
+    CHECK(receive(&rx, &tx));
+    CHECK(protocol_unpack_wave_upload(&rx, &flags, &offset, &count, out));
+    CHECK(flags == 0 && offset == 0 && count == 4 && memcmp(out, samples, 8) == 0);
+    protocol_create_wave_upload(&tx, WAVE_UPLOAD_COMMIT, 4, 0, samples);
+    CHECK(receive(&rx, &tx));
+    CHECK(protocol_unpack_wave_upload(&rx, &flags, &offset, &count, out) && count == 0);
+
+    /** More samples than a chunk holds */
+    set_frame_header(&tx);
+    pack8(&tx, cmd_wave_upload);
+    pack8(&tx, 0);
+    pack8(&tx, 0);
+    pack8(&tx, WAVE_UPLOAD_CHUNK + 1);
+    for (uint32_t i = 0; i < WAVE_UPLOAD_CHUNK + 1; i++) {
+        pack16(&tx, 0x1234);
+    }
+    end_frame(&tx);
+    CHECK(receive(&rx, &tx));
+    CHECK(!protocol_unpack_wave_upload(&rx, &flags, &offset, &count, out));
+
+    /** A count that does not match the samples sent */
+    set_frame_header(&tx);
+    pack8(&tx, cmd_wave_upload);
+    pack8(&tx, 0);
+    pack8(&tx, 0);
+    pack8(&tx, 3);
+    pack16(&tx, 1);
+    pack16(&tx, 2);
+    end_frame(&tx);
+    CHECK(receive(&rx, &tx));
+    CHECK(!protocol_unpack_wave_upload(&rx, &flags, &offset, &count, out));
+
+    /** Another command */
+    protocol_create_ping(&tx);
+    CHECK(receive(&rx, &tx));
+    CHECK(!protocol_unpack_wave_upload(&rx, &flags, &offset, &count, out));
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
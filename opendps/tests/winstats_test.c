@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "winstats.h"
+
+uint32_t g_num_fail, g_num_pass;
+bool g_irq_masked;
+
+/** Calibration and time base normally provided by pwrctl and tick */
+float a_adc_k_coef = 1, a_adc_c_coef = 0;
+float v_adc_k_coef = 2, v_adc_c_coef = 10;
+static uint64_t ticks = 5000;
+
+uint64_t get_ticks(void)
+{
+    return ticks;
+}
+
+#define CHECK(x) \
+    (x) ? (g_num_pass++) : (printf(" " #x " failed (line %d)\n", __LINE__), g_num_fail++);
+
+int main(int argc, char const *argv[])
+{
+    winstats_t stats;
+    winstats_init();
+    ticks += 100;
+    winstats_take(&stats);
+    CHECK(!g_irq_masked);
+    CHECK(stats.samples == 0 && stats.window_ms == 100);
+    CHECK(stats.min[winstats_i_out] == 0 && stats.max[winstats_i_out] == 0);
+
+    /** A single spike shows in the maximum */
+    for (uint32_t i = 0; i < 999; i++) {
+        winstats_sample(100, 1000);
+    }
+    winstats_sample(1100, 1000);
+    ticks += 250;
+    winstats_take(&stats);
+    CHECK(stats.samples == 1000 && stats.window_ms == 250);
+    CHECK(stats.min[winstats_i_out] == 100);
+    CHECK(stats.max[winstats_i_out] == 1100);
+    CHECK(stats.mean[winstats_i_out] == 101);
+    /** (999 * 100^2 + 1100^2) / 1000 */
+    CHECK(stats.mean_sq[winstats_i_out] == 11200);
+    /** V is 2 * raw + 10 */
+    CHECK(stats.min[winstats_v_out] == 2010 && stats.max[winstats_v_out] == 2010);
+    CHECK(stats.mean[winstats_v_out] == 2010);
+    CHECK(stats.mean_sq[winstats_v_out] == 2010 * 2010);
+
+    /** Reading starts a new window */
+    winstats_sample(300, 0);
+    winstats_sample(500, 0);
+    winstats_take(&stats);
+    CHECK(stats.samples == 2 && stats.window_ms == 0);
+    CHECK(stats.min[winstats_i_out] == 300 && stats.max[winstats_i_out] == 500);
+    CHECK(stats.mean[winstats_i_out] == 400);
+    CHECK(stats.mean_sq[winstats_i_out] == 170000);
+    CHECK(stats.min[winstats_v_out] == 10);
+
+    if (g_num_fail == 0) {
+        printf("All tests passed\n");
+    } else if (g_num_pass == 0) {
+        printf("All tests failed!\n");
+    } else {
+        printf ("%d/%d test failed\n", g_num_fail, g_num_pass);
+    }
+    printf("\n");
+
+    return g_num_fail ? 1 : 0;
+}
@@ -45,6 +45,15 @@
 #include "gfx_lookup.h"
 
 static bool is_inverted;
+/** Drawing is skipped while set, see tft_suspend() */
+static bool is_suspended;
+/** Last tft_set_scroll() offset, applied when drawing resumes */
+static uint32_t scroll_offset;
+/** Bumped every time the display is cleared, see tft_clear_count() */
+static uint32_t clear_count;
+
+/** Width of the display in the rotation used, scrolled by tft_set_scroll() */
+#define TFT_SCROLL_COLUMNS  (128)
 
 #define ILI9163C_COLORSPACE_TWIDDLE(color) \
         (((COLORSPACE) == 0) \
@@ -55,9 +64,176 @@ static bool is_inverted;
     ((ILI9163C_COLORSPACE_TWIDDLE(color) & 0xFF) << 8) | \
     ((ILI9163C_COLORSPACE_TWIDDLE(color) >> 8) & 0xFF) )
 
+#ifdef CONFIG_TFT_WIDE_GLYPH
+/** A color as a mask of four pixels of a mono2bpp_lookup4 entry */
+#define GLYPH_MASK4(color) (0x0001000100010001ULL * ILI9163C_COLOR_TO_BITMASK(color))
+
+/** Tables with the meter colors applied, the white one is mono2bpp_lookup4 */
+#if COLOR_VOLTAGE != WHITE
+static const uint64_t voltage_lookup4[256] = MONO2BPP_LOOKUP4(GLYPH_MASK4(COLOR_VOLTAGE));
+#endif
+#if COLOR_AMPERAGE != WHITE && COLOR_AMPERAGE != COLOR_VOLTAGE
+static const uint64_t amperage_lookup4[256] = MONO2BPP_LOOKUP4(GLYPH_MASK4(COLOR_AMPERAGE));
+#endif
+#if COLOR_INPUT != WHITE && COLOR_INPUT != COLOR_VOLTAGE && COLOR_INPUT != COLOR_AMPERAGE
+static const uint64_t input_lookup4[256] = MONO2BPP_LOOKUP4(GLYPH_MASK4(COLOR_INPUT));
+#endif
+#endif // CONFIG_TFT_WIDE_GLYPH
+
 /** Buffers for speeding up drawing */
 
-static uint16_t blit_buffer[((4*FONT_METER_LARGE_MAX_GLYPH_WIDTH*FONT_METER_LARGE_MAX_GLYPH_HEIGHT)+3)/4]; // Alignment for being able to lay down uint64_t in one go, without dealing with padding
+/** Pixels of the largest glyph */
+#define GLYPH_PIXELS  (((4*FONT_METER_LARGE_MAX_GLYPH_WIDTH*FONT_METER_LARGE_MAX_GLYPH_HEIGHT)+3)/4) // Alignment for being able to lay down uint64_t in one go, without dealing with padding
+
+#ifdef CONFIG_TFT_STRIPE
+#ifndef TFT_STRIPE_ROWS
+ #define TFT_STRIPE_ROWS  (8)
+#endif // TFT_STRIPE_ROWS
+/** Glyphs are decoded a stripe at a time, stripe N+1 while stripe N is sent
+  * by DMA. A stripe is a whole number of font bytes (4 pixels) so the next
+  * one starts on a byte of the glyph data. */
+ #define BLIT_BUFFERS        (2)
+ #define BLIT_BUFFER_PIXELS  (((FONT_METER_LARGE_MAX_GLYPH_WIDTH*TFT_STRIPE_ROWS)/4)*4)
+#else
+#ifdef CONFIG_TFT_DOUBLE_BUFFER
+/** Ping-pong buffers, glyph N+1 is decoded while glyph N is sent by DMA */
+ #define BLIT_BUFFERS  (2)
+#else
+ #define BLIT_BUFFERS  (1)
+#endif // CONFIG_TFT_DOUBLE_BUFFER
+ #define BLIT_BUFFER_PIXELS  GLYPH_PIXELS
+#endif // CONFIG_TFT_STRIPE
+
+static uint16_t blit_buffer[BLIT_BUFFERS][BLIT_BUFFER_PIXELS];
+/** Set while a blit buffer is queued for DMA, cleared from the SPI DMA ISR */
+static volatile bool blit_busy[BLIT_BUFFERS];
+/** The blit buffer the next glyph is decoded into */
+static uint32_t cur_blit;
+
+#ifdef CONFIG_TFT_GLYPH_CACHE
+#ifndef TFT_GLYPH_CACHE_SLOTS
+ #define TFT_GLYPH_CACHE_SLOTS  (2)
+#endif // TFT_GLYPH_CACHE_SLOTS
+
+/** A decoded digit glyph, sent to the TFT straight from the cache */
+typedef struct {
+    uint16_t pixels[GLYPH_PIXELS];
+    uint16_t color;
+    tft_font_size_t size;
+    char ch;            /** 0 if the slot has not been used */
+    bool invert;
+    bool is_inverted;
+    uint32_t last_used; /** For evicting the least recently used slot */
+    volatile bool busy; /** Set while the slot is queued for DMA */
+} glyph_cache_slot_t;
+
+static glyph_cache_slot_t glyph_cache[TFT_GLYPH_CACHE_SLOTS];
+static uint32_t glyph_cache_clock;
+#endif // CONFIG_TFT_GLYPH_CACHE
+
+/** The glyph prepared for blit_glyph() and the busy flag of its buffer */
+static uint16_t *glyph_buffer;
+static volatile bool *glyph_busy;
+
+#ifdef CONFIG_TFT_STRIPE
+/** The glyph data not yet decoded into a stripe */
+static struct {
+    const uint8_t *pixdata;
+    uint32_t nbytes;
+    bool invert;
+    uint16_t color;
+} stripe_glyph;
+
+static void decode_glyph(uint16_t *target, size_t target_size, const uint8_t *pixdata, size_t nbytes, bool invert, uint16_t color);
+#endif // CONFIG_TFT_STRIPE
+
+/**
+  * @brief SPI completion callback clearing the busy flag of a blit buffer
+  * @param ctx pointer to the blit_busy entry
+  * @retval none
+  */
+static void blit_done(void *ctx)
+{
+    *((volatile bool*) ctx) = false;
+}
+
+/**
+  * @brief Queue the current blit buffer for DMA and switch buffers
+  * @param num_pixels number of pixels in the buffer
+  * @retval none
+  */
+static void send_blit_buffer(uint32_t num_pixels)
+{
+    blit_busy[cur_blit] = true;
+    (void) spi_dma_transmit_async((uint8_t*) blit_buffer[cur_blit], sizeof(uint16_t) * num_pixels, blit_done, (void*) &blit_busy[cur_blit]);
+    cur_blit = (cur_blit + 1) % BLIT_BUFFERS;
+}
+
+#ifdef CONFIG_TFT_STRIPE
+/**
+  * @brief Decode the next stripe of stripe_glyph into the current blit buffer
+  * @param num_pixels number of pixels in the stripe
+  * @retval none
+  */
+static void decode_stripe(uint32_t num_pixels)
+{
+    uint32_t nbytes = (num_pixels + 3) / 4;
+    if (nbytes > stripe_glyph.nbytes) {
+        nbytes = stripe_glyph.nbytes;
+    }
+    /** Wait for the last transfer from this buffer to complete */
+    while (blit_busy[cur_blit]) ;
+    decode_glyph(blit_buffer[cur_blit], sizeof(blit_buffer[cur_blit]), stripe_glyph.pixdata, nbytes, stripe_glyph.invert, stripe_glyph.color);
+    stripe_glyph.pixdata += nbytes;
+    stripe_glyph.nbytes -= nbytes;
+}
+
+/**
+  * @brief Send a glyph whose first stripe prepare_glyph() decoded, decoding
+  *        each following stripe while the one before is on the wire
+  * @param num_pixels number of pixels in the glyph
+  * @retval none
+  */
+static void send_stripes(uint32_t num_pixels)
+{
+    uint32_t stripe = num_pixels < BLIT_BUFFER_PIXELS ? num_pixels : BLIT_BUFFER_PIXELS;
+    while (1) {
+        send_blit_buffer(stripe);
+        num_pixels -= stripe;
+        if (!num_pixels) {
+            break;
+        }
+        stripe = num_pixels < BLIT_BUFFER_PIXELS ? num_pixels : BLIT_BUFFER_PIXELS;
+        decode_stripe(stripe);
+    }
+}
+#endif // CONFIG_TFT_STRIPE
+
+/**
+  * @brief Send the glyph set up by prepare_glyph(), switching blit buffers
+  *        if it was decoded into one
+  * @param xpos x position
+  * @param ypos y position
+  * @param glyph_width width of the glyph
+  * @param glyph_height height of the glyph
+  * @retval none
+  */
+static void blit_glyph(uint32_t xpos, uint32_t ypos, uint32_t glyph_width, uint32_t glyph_height)
+{
+    ili9163c_set_window(xpos, ypos, xpos + glyph_width-1, ypos + glyph_height-1);
+    gpio_set(TFT_A0_PORT, TFT_A0_PIN);
+#ifdef CONFIG_TFT_STRIPE
+    if (glyph_buffer == blit_buffer[cur_blit]) {
+        send_stripes(glyph_width * glyph_height);
+        return;
+    }
+#endif // CONFIG_TFT_STRIPE
+    *glyph_busy = true;
+    (void) spi_dma_transmit_async((uint8_t*) glyph_buffer, sizeof(uint16_t) * glyph_width * glyph_height, blit_done, (void*) glyph_busy);
+    if (glyph_buffer == blit_buffer[cur_blit]) {
+        cur_blit = (cur_blit + 1) % BLIT_BUFFERS;
+    }
+}
 
 /**
   * @brief Initialize the TFT module
@@ -76,25 +252,103 @@ void tft_init(void)
   */
 void tft_clear(void)
 {
+    if (is_suspended) {
+        return;
+    }
     ili9163c_fill_screen(BLACK);
+    clear_count++;
 }
 
 /**
-  * @brief Decode 2bpp glyph to TFT-native bgr565 format into the tft's blit_buffer
+  * @brief Get the number of times the display has been cleared
+  * @retval clear count
+  */
+uint32_t tft_clear_count(void)
+{
+    return clear_count;
+}
+
+#ifdef CONFIG_TFT_WIDE_GLYPH
+/**
+  * @brief Get the table with a color applied
+  * @param color the color
+  * @retval the table, NULL if the color has none
+  */
+static const uint64_t *glyph_lookup4(uint16_t color)
+{
+    if (color == WHITE)
+        return mono2bpp_lookup4;
+#if COLOR_VOLTAGE != WHITE
+    if (color == COLOR_VOLTAGE)
+        return voltage_lookup4;
+#endif
+#if COLOR_AMPERAGE != WHITE && COLOR_AMPERAGE != COLOR_VOLTAGE
+    if (color == COLOR_AMPERAGE)
+        return amperage_lookup4;
+#endif
+#if COLOR_INPUT != WHITE && COLOR_INPUT != COLOR_VOLTAGE && COLOR_INPUT != COLOR_AMPERAGE
+    if (color == COLOR_INPUT)
+        return input_lookup4;
+#endif
+    return NULL;
+}
+
+/**
+  * @brief Decode 2bpp glyph four pixels per lookup, see decode_glyph()
+  * @param target32 the buffer to decode into
+  * @param pixdata the input bytes from the font definition
+  * @param nbytes number of bytes in the source glyph array, not 0
+  * @param invert whether to invert the glyph
+  * @param color color mask to use when decoding
+  * @retval none
+  */
+static void decode_glyph_wide(uint32_t *target32, const uint8_t *pixdata, size_t nbytes, bool invert, uint16_t color)
+{
+    /** Colored text on an inverted display and colors without a table of
+      * their own are masked as they are decoded */
+    const uint64_t *lookup = invert || is_inverted ? NULL : glyph_lookup4(color);
+    if(lookup) {
+        for(size_t i = 0; i < nbytes; ++i) {
+            uint64_t pixels = lookup[pixdata[i]];
+            *target32++ = (uint32_t) pixels;
+            *target32++ = (uint32_t) (pixels >> 32);
+        }
+        return;
+    }
+    uint64_t xor_mask = 0, and_mask = ~0ULL;
+    if(invert)
+        xor_mask = ~0ULL;
+    else if(color != WHITE)
+        and_mask = is_inverted ? ~GLYPH_MASK4(color) : GLYPH_MASK4(color);
+    for(size_t i = 0; i < nbytes; ++i) {
+        uint64_t pixels = (mono2bpp_lookup4[pixdata[i]] ^ xor_mask) & and_mask;
+        *target32++ = (uint32_t) pixels;
+        *target32++ = (uint32_t) (pixels >> 32);
+    }
+}
+#endif // CONFIG_TFT_WIDE_GLYPH
+
+/**
+  * @brief Decode 2bpp glyph to TFT-native bgr565 format
+  * @param target the buffer to decode into
+  * @param target_size size of the target buffer in bytes
   * @param pixdata the input bytes from the font definition
   * @param nbytes number of bytes in the source glyph array
   * @param invert whether to invert the glyph
   * @param color color mask to use when decoding
   * @retval none
   */
-void tft_decode_glyph(const uint8_t *pixdata, size_t nbytes, bool invert, uint16_t color)
+static void decode_glyph(uint16_t *target, size_t target_size, const uint8_t *pixdata, size_t nbytes, bool invert, uint16_t color)
 {
     if(nbytes == 0) { /* we're attempting to draw a space */
         /** Wipe out the target buffer if we're drawing a space */
-        memset(blit_buffer, (invert ? WHITE : BLACK) & 0xFF, sizeof(blit_buffer));
+        memset(target, (invert ? WHITE : BLACK) & 0xFF, target_size);
     }
     else {
-        uint32_t *target32 = (uint32_t*)blit_buffer;
+        uint32_t *target32 = (uint32_t*)target;
+#ifdef CONFIG_TFT_WIDE_GLYPH
+        decode_glyph_wide(target32, pixdata, nbytes, invert, color);
+#else
         if(invert) {
             for(size_t i = 0; i < nbytes; ++i) {
                 *target32++ = ~mono2bpp_lookup[pixdata[i] & 0xF];
@@ -120,7 +374,105 @@ void tft_decode_glyph(const uint8_t *pixdata, size_t nbytes, bool invert, uint16
                 *target32++ = mono2bpp_lookup[pixdata[i] >> 4];
             }
         }
+#endif // CONFIG_TFT_WIDE_GLYPH
+    }
+}
+
+/**
+  * @brief Decode 2bpp glyph to TFT-native bgr565 format into the tft's blit_buffer
+  * @param pixdata the input bytes from the font definition
+  * @param nbytes number of bytes in the source glyph array
+  * @param invert whether to invert the glyph
+  * @param color color mask to use when decoding
+  * @retval none
+  */
+void tft_decode_glyph(const uint8_t *pixdata, size_t nbytes, bool invert, uint16_t color)
+{
+    /** A stripe buffer only takes the start of a large glyph */
+    if (nbytes > BLIT_BUFFER_PIXELS / 4) {
+        nbytes = BLIT_BUFFER_PIXELS / 4;
+    }
+    /** Wait for the last transfer from this buffer to complete */
+    while (blit_busy[cur_blit]) ;
+    decode_glyph(blit_buffer[cur_blit], sizeof(blit_buffer[cur_blit]), pixdata, nbytes, invert, color);
+}
+
+#ifdef CONFIG_TFT_GLYPH_CACHE
+/**
+  * @brief Find a decoded glyph in the cache, decoding it into the least
+  *        recently used slot if it is not there
+  * @param size font size
+  * @param ch the character
+  * @param invert whether to invert the glyph
+  * @param color color of the glyph
+  * @retval the cache slot holding the glyph
+  */
+static glyph_cache_slot_t *glyph_cache_get(tft_font_size_t size, char ch, bool invert, uint16_t color)
+{
+    glyph_cache_slot_t *lru = &glyph_cache[0];
+    for (uint32_t i = 0; i < TFT_GLYPH_CACHE_SLOTS; i++) {
+        glyph_cache_slot_t *slot = &glyph_cache[i];
+        if (slot->ch == ch && slot->size == size && slot->color == color &&
+            slot->invert == invert && slot->is_inverted == is_inverted) {
+            /** The busy flag tracks a single transfer */
+            while (slot->busy) ;
+            slot->last_used = ++glyph_cache_clock;
+            return slot;
+        }
+        if (slot->last_used < lru->last_used) {
+            lru = slot;
+        }
+    }
+
+    const uint8_t *glyph_pixdata;
+    uint32_t glyph_size;
+    while (lru->busy) ;
+    tft_get_glyph_pixdata(size, ch, &glyph_pixdata, &glyph_size);
+    decode_glyph(lru->pixels, sizeof(lru->pixels), glyph_pixdata, glyph_size, invert, color);
+    lru->ch = ch;
+    lru->size = size;
+    lru->color = color;
+    lru->invert = invert;
+    lru->is_inverted = is_inverted;
+    lru->last_used = ++glyph_cache_clock;
+    return lru;
+}
+#endif // CONFIG_TFT_GLYPH_CACHE
+
+/**
+  * @brief Get a glyph in TFT-native format ready for blit_glyph(), digits
+  *        come from the glyph cache if enabled
+  * @param size font size
+  * @param ch the character (must be a supported character)
+  * @param invert whether to invert the glyph
+  * @param color color of the glyph
+  * @retval none
+  */
+static void prepare_glyph(tft_font_size_t size, char ch, bool invert, uint16_t color)
+{
+#ifdef CONFIG_TFT_GLYPH_CACHE
+    if ((ch >= '0' && ch <= '9') || ch == '.') {
+        glyph_cache_slot_t *slot = glyph_cache_get(size, ch, invert, color);
+        glyph_buffer = slot->pixels;
+        glyph_busy = &slot->busy;
+        return;
     }
+#endif // CONFIG_TFT_GLYPH_CACHE
+    const uint8_t *glyph_pixdata;
+    uint32_t glyph_size;
+    tft_get_glyph_pixdata(size, ch, &glyph_pixdata, &glyph_size);
+#ifdef CONFIG_TFT_STRIPE
+    /** Only the first stripe, blit_glyph() decodes the rest */
+    stripe_glyph.pixdata = glyph_pixdata;
+    stripe_glyph.nbytes = glyph_size;
+    stripe_glyph.invert = invert;
+    stripe_glyph.color = color;
+    decode_stripe(BLIT_BUFFER_PIXELS);
+#else
+    tft_decode_glyph(glyph_pixdata, glyph_size, invert, color);
+#endif // CONFIG_TFT_STRIPE
+    glyph_buffer = blit_buffer[cur_blit];
+    glyph_busy = &blit_busy[cur_blit];
 }
 
 /**
@@ -134,9 +486,66 @@ void tft_decode_glyph(const uint8_t *pixdata, size_t nbytes, bool invert, uint16
   */
 void tft_blit(uint16_t *bits, uint32_t width, uint32_t height, uint32_t x, uint32_t y)
 {
+    if (is_suspended) {
+        return;
+    }
+    ili9163c_set_window(x, y, x + width-1, y + height-1);
+    gpio_set(TFT_A0_PORT, TFT_A0_PIN);
+    /** Icons live in flash, no need to wait for the transfer */
+    (void) spi_dma_transmit_async((uint8_t*) bits, 2*width*height, NULL, NULL);
+}
+
+/**
+  * @brief Blit RLE compressed graphics on TFT
+  * @param data graphics compressed by `gen_lookup.py -r`
+  * @param width width of data
+  * @param height of data
+  * @param x x position
+  * @param y y position
+  * @retval none
+  */
+void tft_blit_compressed(const uint8_t *data, uint32_t width, uint32_t height, uint32_t x, uint32_t y)
+{
+    uint32_t max_lines = (sizeof(blit_buffer[0]) / sizeof(uint16_t)) / width;
+    uint32_t count = 0; /** Pixels left in the current packet */
+    bool is_run = false;
+    const uint8_t *pixel = data;
+
+    if (is_suspended || !width || !height || !max_lines) {
+        return;
+    }
+
     ili9163c_set_window(x, y, x + width-1, y + height-1);
     gpio_set(TFT_A0_PORT, TFT_A0_PIN);
-    (void) spi_dma_transceive((uint8_t*) bits, 2*width*height, 0, 0);
+    /** Decode as many lines as fit in a blit buffer while the DMA sends the
+      * lines in the other buffer */
+    while (height) {
+        uint32_t lines = height < max_lines ? height : max_lines;
+        uint32_t num_pixels = lines * width;
+        while (blit_busy[cur_blit]) ;
+        uint8_t *dst = (uint8_t*) blit_buffer[cur_blit];
+        for (uint32_t i = 0; i < num_pixels; i++) {
+            if (!count) {
+                uint8_t ctrl = *data++;
+                count = (ctrl & 0x7f) + 1;
+                is_run = ctrl & 0x80;
+                pixel = data;
+                if (is_run) {
+                    data += 2;
+                }
+            }
+            /** Pixels are stored in the byte order they are sent in */
+            *dst++ = pixel[0];
+            *dst++ = pixel[1];
+            if (!is_run) {
+                pixel += 2;
+                data += 2;
+            }
+            count--;
+        }
+        send_blit_buffer(num_pixels);
+        height -= lines;
+    }
 }
 
 /**
@@ -242,9 +651,12 @@ void tft_get_glyph_pixdata(tft_font_size_t size, char ch, const uint8_t **glyph_
   */
 uint8_t tft_putch(tft_font_size_t size, char ch, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint16_t color, bool invert)
 {
-    uint32_t glyph_width, glyph_height, glyph_size;
+    uint32_t glyph_width, glyph_height;
     uint32_t xpos, ypos;
-    const uint8_t *glyph_pixdata;
+
+    if (is_suspended) {
+        return 0;
+    }
 
     /** Get the glyph metrics */
     tft_get_glyph_metrics(size, ch, &glyph_width, &glyph_height);
@@ -255,18 +667,15 @@ uint8_t tft_putch(tft_font_size_t size, char ch, uint32_t x, uint32_t y, uint32_
         return 0;
     }
 
-    /** Get the glyph data and decode it to the native TFT format */
-    tft_get_glyph_pixdata(size, ch, &glyph_pixdata, &glyph_size);
-    tft_decode_glyph(glyph_pixdata, glyph_size, invert, color);
+    /** Get the glyph in the native TFT format */
+    prepare_glyph(size, ch, invert, color);
 
     /** Position glyph in center of region */
     xpos = x+(w-glyph_width)/2;
     ypos = y+(h-glyph_height)/2;
 
     /** Draw the glyph */
-    ili9163c_set_window(xpos, ypos, xpos + glyph_width-1, ypos + glyph_height-1);
-    gpio_set(TFT_A0_PORT, TFT_A0_PIN);
-    (void) spi_dma_transceive((uint8_t*) blit_buffer, sizeof(uint16_t) * glyph_width * glyph_height, 0, 0);
+    blit_glyph(xpos, ypos, glyph_width, glyph_height);
 
     /** If our glyph hasn't filled the entire region fill the remainder in with black or white depending on if we're inverting */
     uint16_t fill_color = invert ? WHITE : BLACK;
@@ -313,6 +722,104 @@ void tft_get_string_metrics(tft_font_size_t size, const char *str, uint32_t *str
     *string_height = h;
 }
 
+#ifdef CONFIG_TFT_TEXT_BLIT
+/**
+  * @brief Decode a glyph into a line of text composed in a blit buffer
+  * @param target top left pixel of the glyph in the line
+  * @param stride width of the line in pixels
+  * @param pixdata the input bytes from the font definition
+  * @param nbytes number of bytes in the source glyph array, 0 for a space
+  * @param width width of the glyph
+  * @param height height of the glyph
+  * @param invert whether to invert the glyph
+  * @param color color mask to use when decoding
+  * @retval none
+  */
+static void compose_glyph(uint16_t *target, uint32_t stride, const uint8_t *pixdata, size_t nbytes, uint32_t width, uint32_t height, bool invert, uint16_t color)
+{
+    uint32_t color_mask = 0xffffffff;
+    if (!invert && color != WHITE) {
+        color_mask = ((uint32_t)ILI9163C_COLOR_TO_BITMASK(color) << 16) | ILI9163C_COLOR_TO_BITMASK(color);
+        if (is_inverted)
+            color_mask = ~color_mask;
+    }
+    /** Glyph rows are not byte aligned, two pixels are decoded at a time
+      * and placed one by one */
+    uint32_t pair = 0, x = 0;
+    for (uint32_t p = 0; p < width * height; p++) {
+        if (!(p & 1)) {
+            uint8_t byte = (p >> 2) < nbytes ? pixdata[p >> 2] : 0;
+            pair = mono2bpp_lookup[(p & 2) ? byte >> 4 : byte & 0xF];
+            pair = invert ? ~pair : pair & color_mask;
+        }
+        target[x] = (p & 1) ? pair >> 16 : pair & 0xFFFF;
+        if (++x == width) {
+            x = 0;
+            target += stride;
+        }
+    }
+}
+
+/**
+  * @brief Draw a string as a single blit, the glyphs and the spacing between
+  *        them composed in a blit buffer. Replaces a window for each glyph
+  *        and each spacing with one window for the line.
+  * @param size size of character
+  * @param str the string
+  * @param x x position (left-side of string)
+  * @param ypos top of the string
+  * @param max_width width available for the string
+  * @param color color of the string
+  * @param invert if true, the string will be inverted
+  * @retval the width of the string drawn, 0 if it does not fit a blit
+  *         buffer or the width available, leaving it to tft_puts()
+  */
+static uint32_t blit_line(tft_font_size_t size, const char *str, uint32_t x, uint32_t ypos, uint32_t max_width, uint16_t color, bool invert)
+{
+    uint32_t spacing = tft_get_glyph_spacing(size);
+    uint32_t width = 0, height = 0;
+    for (const char *ch = str; *ch; ch++) {
+        uint32_t glyph_width, glyph_height;
+        tft_get_glyph_metrics(size, *ch, &glyph_width, &glyph_height);
+        if (glyph_width == 0 || glyph_height == 0) {
+            return 0;
+        }
+        width += (ch == str ? 0 : spacing) + glyph_width;
+        height = glyph_height;
+    }
+    if (!width || width > max_width || width * height > BLIT_BUFFER_PIXELS) {
+        return 0;
+    }
+
+    /** Wait for the last transfer from this buffer to complete */
+    while (blit_busy[cur_blit]) ;
+    uint16_t *line = blit_buffer[cur_blit];
+    uint16_t fill_color = invert ? WHITE : BLACK;
+    uint32_t xpos = 0;
+    for (const char *ch = str; *ch; ch++) {
+        const uint8_t *glyph_pixdata;
+        uint32_t glyph_size, glyph_width, glyph_height;
+        if (ch != str) {
+            for (uint32_t row = 0; row < height; row++) {
+                for (uint32_t i = 0; i < spacing; i++) {
+                    line[row * width + xpos + i] = fill_color;
+                }
+            }
+            xpos += spacing;
+        }
+        tft_get_glyph_metrics(size, *ch, &glyph_width, &glyph_height);
+        tft_get_glyph_pixdata(size, *ch, &glyph_pixdata, &glyph_size);
+        compose_glyph(&line[xpos], width, glyph_pixdata, glyph_size, glyph_width, height, invert, color);
+        xpos += glyph_width;
+    }
+
+    ili9163c_set_window(x, ypos, x + width-1, ypos + height-1);
+    gpio_set(TFT_A0_PORT, TFT_A0_PIN);
+    send_blit_buffer(width * height);
+    return width;
+}
+#endif // CONFIG_TFT_TEXT_BLIT
+
 /**
   * @brief Blit string on TFT, anchored to bottom-left
   * @param size size of character
@@ -334,19 +841,25 @@ uint16_t tft_puts(tft_font_size_t size, const char *str, uint32_t x, uint32_t y,
     uint8_t spacing = tft_get_glyph_spacing(size);
     bool first = true;
 
+    if (is_suspended) {
+        return 0;
+    }
     ili9163c_get_geometry(&screen_w, &screen_h);
     tft_get_glyph_metrics(size, ' ', &space_width, &font_height);
     xpos = x;
     ypos = y - font_height;
 
-    while(str && *str) {
-        uint32_t glyph_width, glyph_height, glyph_size;
-        const uint8_t *glyph_pixdata;
-
-        if(!first) {
-            tft_fill(xpos, ypos, spacing, h, invert ? WHITE : BLACK);
-            xpos += spacing;
+#ifdef CONFIG_TFT_TEXT_BLIT
+    if (str && x < screen_w) {
+        uint32_t width = blit_line(size, str, x, ypos, w < screen_w - x ? w : screen_w - x, color, invert);
+        if (width) {
+            return width;
         }
+    }
+#endif // CONFIG_TFT_TEXT_BLIT
+
+    while(str && *str) {
+        uint32_t glyph_width, glyph_height;
 
         /** Get the glyph metadata */
         tft_get_glyph_metrics(size, *str, &glyph_width, &glyph_height);
@@ -354,27 +867,36 @@ uint16_t tft_puts(tft_font_size_t size, const char *str, uint32_t x, uint32_t y,
         /** Skip drawing if there's no character available */
         if(glyph_width == 0 || glyph_height == 0) {
             dbg_printf("Glyph 0x%02X does not exist in font size %d\n", (int) *str, (int) size);
+            ++str;
             continue;
         }
 
         /** Check if this character would exceed the supplied width or screen width, blank the rest and drop out if so */
-        width_remainder = w - (xpos - x);
-        screen_remainder = screen_w - (xpos - x);
+        uint32_t next_xpos = first ? xpos : xpos + spacing;
+        width_remainder = w - (next_xpos - x);
+        screen_remainder = screen_w - (next_xpos - x);
         draw_remainder = width_remainder < screen_remainder ? width_remainder : screen_remainder;
         if(glyph_width > draw_remainder) {
+            if(!first) {
+                tft_fill(xpos, ypos, spacing, h, invert ? WHITE : BLACK);
+                xpos += spacing;
+            }
             tft_fill(xpos, ypos, draw_remainder, glyph_height, invert ? WHITE : BLACK);
             xpos += draw_remainder;
             return xpos - x;
         }
 
-        /** Get the glyph data and decode it to the native TFT format */
-        tft_get_glyph_pixdata(size, *str, &glyph_pixdata, &glyph_size);
-        tft_decode_glyph(glyph_pixdata, glyph_size, invert, color);
+        /** Decode to the native TFT format while the previous glyph is still
+          * on the wire, the spacing fill below waits for it to complete */
+        prepare_glyph(size, *str, invert, color);
+
+        if(!first) {
+            tft_fill(xpos, ypos, spacing, h, invert ? WHITE : BLACK);
+            xpos += spacing;
+        }
 
         /** Draw the glyph */
-        ili9163c_set_window(xpos, ypos, xpos + glyph_width-1, ypos + glyph_height-1);
-        gpio_set(TFT_A0_PORT, TFT_A0_PIN);
-        (void) spi_dma_transceive((uint8_t*) blit_buffer, sizeof(uint16_t) * glyph_width * glyph_height, 0, 0);
+        blit_glyph(xpos, ypos, glyph_width, glyph_height);
 
         xpos += glyph_width;
 
@@ -396,6 +918,9 @@ uint16_t tft_puts(tft_font_size_t size, const char *str, uint32_t x, uint32_t y,
 void tft_fill_pattern(uint32_t x1, uint32_t y1, uint32_t x2, uint32_t y2, uint8_t *fill, uint32_t fill_size)
 {
     uint32_t count = 2*(x2-x1+1)*(y2-y1+1);
+    if (is_suspended) {
+        return;
+    }
     ili9163c_set_window(x1, y1, x2, y2);
     gpio_set(TFT_A0_PORT, TFT_A0_PIN);
     while(count) {
@@ -415,17 +940,12 @@ void tft_fill_pattern(uint32_t x1, uint32_t y1, uint32_t x2, uint32_t y2, uint8_
   */
 void tft_fill(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint16_t color)
 {
-    uint8_t hi = color >> 8;
-    uint8_t lo = color & 0xff;
-    int32_t count = 2 * w * h;
-    uint8_t fill[] = {hi, lo, hi, lo, hi, lo, hi, lo, hi, lo, hi, lo, hi, lo, hi, lo, hi, lo, hi, lo, hi, lo, hi, lo, hi, lo, hi, lo, hi, lo, hi, lo};
+    if (is_suspended || !w || !h) {
+        return;
+    }
     ili9163c_set_window(x, y, x+w-1, y+h-1);
     gpio_set(TFT_A0_PORT, TFT_A0_PIN);
-    while (count > 0) {
-        uint32_t len = (uint32_t) count > sizeof(fill) ? sizeof(fill) : (uint32_t) count;
-        (void) spi_dma_transceive((uint8_t*) fill, len, 0, 0);
-        count -= len;
-    }
+    (void) spi_dma_fill16(color, w * h);
 }
 
 /**
@@ -438,12 +958,31 @@ void tft_fill(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint16_t color)
   */
 void tft_rect(uint32_t xpos, uint32_t ypos, uint32_t width, uint32_t height, uint16_t color)
 {
+    if (is_suspended) {
+        return;
+    }
     ili9163c_draw_hline(xpos, ypos, width, color);
     ili9163c_draw_hline(xpos, ypos + height, width, color);
     ili9163c_draw_vline(xpos, ypos, height, color);
     ili9163c_draw_vline(xpos + width, ypos, height, color);
 }
 
+/**
+  * @brief Scroll the display horizontally
+  * @param offset columns to scroll left
+  * @retval none
+  */
+void tft_set_scroll(uint32_t offset)
+{
+    /** The row order is mirrored in rotation 3, so a scroll start line of
+        N moves the picture N columns to the right */
+    offset %= TFT_SCROLL_COLUMNS;
+    scroll_offset = offset;
+    if (!is_suspended) {
+        ili9163c_set_scroll(offset ? TFT_SCROLL_COLUMNS - offset : 0);
+    }
+}
+
 /**
   * @brief Invert display
   * @param invert true to invert, false to restore
@@ -451,7 +990,9 @@ void tft_rect(uint32_t xpos, uint32_t ypos, uint32_t width, uint32_t height, uin
   */
 void tft_invert(bool invert)
 {
-    ili9163c_invert_display(invert);
+    if (!is_suspended) {
+        ili9163c_invert_display(invert);
+    }
     is_inverted = invert;
 }
 
@@ -463,3 +1004,21 @@ bool tft_is_inverted(void)
 {
     return is_inverted;
 }
+
+/**
+  * @brief Suspend or resume all drawing
+  * @param suspend true to suspend, false to resume
+  * @retval none
+  */
+void tft_suspend(bool suspend)
+{
+    if (suspend == is_suspended) {
+        return;
+    }
+    is_suspended = suspend;
+    if (!suspend) {
+        ili9163c_invert_display(is_inverted);
+        tft_set_scroll(scroll_offset);
+    }
+    ili9163c_display(!suspend);
+}
@@ -114,6 +114,17 @@ void tft_init(void);
  */
 void tft_clear(void);
 
+/**
+ * @brief Get the number of times the display has been cleared
+ *
+ * UI items that only redraw what changed since their last draw compare
+ * this against the value seen during that draw, everything they put on
+ * the display is gone if it differs.
+ *
+ * @return Number of tft_clear() calls so far
+ */
+uint32_t tft_clear_count(void);
+
 /**
  * @brief Get the horizontal spacing between glyphs
  *
@@ -177,6 +188,8 @@ void tft_get_glyph_pixdata(tft_font_size_t size, char ch, const uint8_t **glyph_
  * @param[in] color   Foreground color in BGR565 format
  *
  * @note Result is placed in internal blit_buffer, not returned
+ * @note With CONFIG_TFT_STRIPE the buffer holds TFT_STRIPE_ROWS rows of the
+ *       largest font, data beyond that is not decoded
  */
 void tft_decode_glyph(const uint8_t *pixdata, size_t nbytes, bool invert, uint16_t color);
 
@@ -194,9 +207,30 @@ void tft_decode_glyph(const uint8_t *pixdata, size_t nbytes, bool invert, uint16
  *
  * @note Data must be in BGR565 format (2 bytes per pixel)
  * @note No bounds checking is performed; ensure coordinates are valid
+ * @note The transfer runs in the background, bits must not be modified
+ *       until the next TFT operation (or spi_dma_fence()) returns
  */
 void tft_blit(uint16_t *bits, uint32_t width, uint32_t height, uint32_t x, uint32_t y);
 
+/**
+ * @brief Blit RLE compressed graphics to the display
+ *
+ * Draws graphics generated with `gen_lookup.py -r`. The data is decoded
+ * a number of lines at a time into the blit buffers, one buffer is
+ * decoded while DMA sends the other.
+ *
+ * The data is a sequence of packets, each starting with a control byte.
+ * If bit 7 is set the following BGR565 pixel is repeated (bits 0-6) + 1
+ * times, otherwise (bits 0-6) + 1 literal pixels follow.
+ *
+ * @param[in] data   Pointer to the compressed pixel data
+ * @param[in] width  Width of the image in pixels
+ * @param[in] height Height of the image in pixels
+ * @param[in] x      X coordinate of top-left corner on display (0-127)
+ * @param[in] y      Y coordinate of top-left corner on display (0-159)
+ */
+void tft_blit_compressed(const uint8_t *data, uint32_t width, uint32_t height, uint32_t x, uint32_t y);
+
 /**
  * @brief Draw a single character to the display
  *
@@ -295,6 +329,20 @@ void tft_fill(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint16_t color);
  */
 void tft_rect(uint32_t xpos, uint32_t ypos, uint32_t width, uint32_t height, uint16_t color);
 
+/**
+ * @brief Scroll the display horizontally
+ *
+ * Uses the vertical scroll of the panel, which runs along the x axis in the
+ * rotation used by OpenDPS. The frame memory is not touched, the display
+ * shows the column drawn at x + offset (modulo TFT_WIDTH) at position x.
+ * Everything drawn while scrolled lands offset on the display, so only a
+ * screen owning the whole display should scroll.
+ *
+ * @param[in] offset Columns to scroll left, 0 to TFT_WIDTH-1. 0 is the
+ *                   normal, unscrolled display.
+ */
+void tft_set_scroll(uint32_t offset);
+
 /**
  * @brief Enable or disable display color inversion
  *
@@ -319,6 +367,18 @@ void tft_invert(bool invert);
  */
 bool tft_is_inverted(void);
 
+/**
+ * @brief Suspend or resume all drawing
+ *
+ * While suspended the drawing functions return without touching the
+ * display, which is switched off. Inversion changes are applied when
+ * drawing resumes. The screen content is undefined after resuming, the
+ * caller clears and redraws it.
+ *
+ * @param[in] suspend true to suspend, false to resume
+ */
+void tft_suspend(bool suspend);
+
 #ifdef DPS_EMULATOR
 /**
  * @brief Update the emulator display window
@@ -331,6 +391,44 @@ bool tft_is_inverted(void);
  * @note On real hardware, display updates happen during blit operations
  */
 void emul_tft_draw(void);
+
+/**
+ * @brief Get the number of bytes the display driver would have sent
+ *
+ * Counts two bytes per pixel drawn, used by the emulator benchmark mode.
+ *
+ * @return Byte count since start
+ */
+uint32_t emul_tft_bytes(void);
+
+/**
+ * @brief End the current frame of the emulator frame buffer
+ *
+ * Everything drawn since the previous call makes up one frame, the byte
+ * count and dirty region of the last frame are reported by "fb stats".
+ * Called by the emulator when the main loop goes idle.
+ */
+void emul_tft_end_frame(void);
+
+/**
+ * @brief Dump the emulator frame buffer
+ *
+ * @param buffer Receives the RGB565 pixels, big endian, line by line
+ * @param size Size of the buffer, 2 * 128 * 128 for the whole display
+ * @return Number of bytes written
+ */
+uint32_t emul_tft_raw(uint8_t *buffer, uint32_t size);
+
+/**
+ * @brief Handle a frame buffer command received on the event port
+ *
+ * "fb stats" prints the frame statistics, "fb png <file>" and
+ * "fb raw <file>" save the display.
+ *
+ * @param cmd The command
+ * @return true if the command was a frame buffer command
+ */
+bool emul_tft_command(const char *cmd);
 #endif // DPS_EMULATOR
 
 #endif // __TFT_H__
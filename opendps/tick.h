@@ -39,6 +39,11 @@
  * The SysTick timer is configured to generate an interrupt every 1ms.
  * The ISR increments a 64-bit counter that can be read via get_ticks().
  *
+ * A microsecond time base is kept by hw.c on TIM3, a 16-bit counter at
+ * 1MHz extended to 64 bits by its wrap interrupt. get_time_us() reads it
+ * without disabling interrupts, using a sequence count to detect a wrap
+ * being counted meanwhile, and is safe to call from any ISR.
+ *
  * ## Usage Example
  *
  * ```c
@@ -102,4 +107,17 @@ void delay_ms(uint32_t delay);
  */
 uint64_t get_ticks(void);
 
+/**
+ * @brief Get the current time in microseconds
+ *
+ * Returns the number of microseconds since the time base was started in
+ * hw_init(). The value never goes backwards and does not wrap in practice.
+ *
+ * @return Number of microseconds since startup
+ *
+ * @note Safe to call from ISRs of any priority
+ * @note Implemented in hw.c
+ */
+uint64_t get_time_us(void);
+
 #endif // __TICK_H__
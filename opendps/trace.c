@@ -0,0 +1,58 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <rcc.h>
+#include <scb.h>
+#include <dwt.h>
+#include <tpiu.h>
+#include <dbgmcu.h>
+#include "trace.h"
+
+/** Unlocks the ITM registers for writing */
+#ifndef ITM_LAR
+ #define ITM_LAR MMIO32(ITM_BASE + 0xfb0)
+#endif // ITM_LAR
+#define CORESIGHT_UNLOCK (0xc5acce55)
+
+/** Trace bus id of the ITM, any non zero value */
+#define ITM_TRACE_BUS_ID (1 << 16)
+
+void trace_init(void)
+{
+    SCB_DEMCR |= SCB_DEMCR_TRCENA;
+    DBGMCU_CR |= DBGMCU_CR_TRACE_IOEN | DBGMCU_CR_TRACE_MODE_ASYNC;
+
+    /** Plain NRZ (UART) encoding without the formatter */
+    TPIU_SPPR = TPIU_SPPR_ASYNC_NRZ;
+    TPIU_ACPR = rcc_ahb_frequency / CONFIG_TRACE_SWO_BAUD - 1;
+    TPIU_FFCR &= ~TPIU_FFCR_ENFCONT;
+
+    ITM_LAR = CORESIGHT_UNLOCK;
+    ITM_TCR = ITM_TRACE_BUS_ID | ITM_TCR_TSENA | ITM_TCR_DWTENA | ITM_TCR_ITMENA;
+    ITM_TER[0] = (1 << trace_port_count) - 1;
+
+    /** ISR entry and exit packets, timed like the stimulus port writes */
+    DWT_CTRL |= DWT_CTRL_EXCTRCENA;
+}
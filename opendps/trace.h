@@ -0,0 +1,151 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file trace.h
+ * @brief Real time trace on the SWO pin
+ *
+ * Available with CONFIG_TRACE. The ITM of the Cortex-M3 timestamps writes
+ * to its stimulus ports and sends them out of TRACESWO (PB3) as the
+ * asynchronous SWO stream, together with the DWT exception trace that
+ * marks the entry and exit of every ISR without any code in the ISRs. A
+ * write takes a few cycles unless the ITM FIFO is full, so unlike
+ * dbg_printf() the trace can be left on while the event pipeline is under
+ * load. `ocd-client.py swo` has OpenOCD capture the stream and prints it as
+ * a timeline.
+ *
+ * Stimulus ports:
+ *  0  reserved for text
+ *  1  events, 32 bits [kind:8] [0:8] [event:8] [data:8], kind from trace_event_kind_t
+ *  2  commands, 8 bits [cmd] when a command starts and 16 bits
+ *     [status:8] [cmd:8] when its handler returns
+ *
+ * PB3 is also wired to R11 on the DPS5005 board, trace is meant for the
+ * bench. Without CONFIG_TRACE the macros expand to nothing.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+
+/**
+ * @brief ITM stimulus ports
+ */
+typedef enum {
+    trace_port_text = 0,
+    trace_port_event,
+    trace_port_cmd,
+    trace_port_count
+} trace_port_t;
+
+/**
+ * @brief What happened to an event
+ */
+typedef enum {
+    /** @brief Queued by event_put() */
+    trace_event_put = 0,
+    /** @brief Dropped by event_put(), the queue was full */
+    trace_event_drop,
+    /** @brief Taken by the main loop with event_get() */
+    trace_event_get
+} trace_event_kind_t;
+
+#ifdef CONFIG_TRACE
+
+#include <itm.h>
+
+/** @brief SWO bit rate, the core clock must be a multiple of it */
+#ifndef CONFIG_TRACE_SWO_BAUD
+ #define CONFIG_TRACE_SWO_BAUD (2000000)
+#endif // CONFIG_TRACE_SWO_BAUD
+
+/**
+ * @brief Set up the TPIU for asynchronous SWO and enable the ITM, its
+ * timestamps and the exception trace
+ */
+void trace_init(void);
+
+/**
+ * @brief Write 8 bits to a stimulus port, waits if the ITM FIFO is full
+ *
+ * @param[in] port  The stimulus port
+ * @param[in] value Value to write
+ */
+static inline void trace_write8(trace_port_t port, uint8_t value)
+{
+    if ((ITM_TCR & ITM_TCR_ITMENA) && (ITM_TER[0] & (1 << port))) {
+        while (!(ITM_STIM8(port) & ITM_STIM_FIFOREADY)) ;
+        ITM_STIM8(port) = value;
+    }
+}
+
+/**
+ * @brief Write 16 bits to a stimulus port, waits if the ITM FIFO is full
+ *
+ * @param[in] port  The stimulus port
+ * @param[in] value Value to write
+ */
+static inline void trace_write16(trace_port_t port, uint16_t value)
+{
+    if ((ITM_TCR & ITM_TCR_ITMENA) && (ITM_TER[0] & (1 << port))) {
+        while (!(ITM_STIM16(port) & ITM_STIM_FIFOREADY)) ;
+        ITM_STIM16(port) = value;
+    }
+}
+
+/**
+ * @brief Write 32 bits to a stimulus port, waits if the ITM FIFO is full
+ *
+ * @param[in] port  The stimulus port
+ * @param[in] value Value to write
+ */
+static inline void trace_write32(trace_port_t port, uint32_t value)
+{
+    if ((ITM_TCR & ITM_TCR_ITMENA) && (ITM_TER[0] & (1 << port))) {
+        while (!(ITM_STIM32(port) & ITM_STIM_FIFOREADY)) ;
+        ITM_STIM32(port) = value;
+    }
+}
+
+/** @brief Trace event <e> with <data>, <kind> is a trace_event_kind_t */
+#define TRACE_EVENT(kind, e, data) \
+    trace_write32(trace_port_event, (uint32_t) (kind) << 24 | (uint32_t) (e) << 8 | (uint8_t) (data))
+
+/** @brief Trace the start of command <cmd> */
+#define TRACE_CMD_BEGIN(cmd) trace_write8(trace_port_cmd, (cmd))
+
+/** @brief Trace the status a command handler returned */
+#define TRACE_CMD_END(cmd, status) \
+    trace_write16(trace_port_cmd, (uint16_t) ((status) << 8 | (uint8_t) (cmd)))
+
+#else // CONFIG_TRACE
+
+#define TRACE_EVENT(kind, e, data)
+#define TRACE_CMD_BEGIN(cmd)
+#define TRACE_CMD_END(cmd, status)
+
+#endif // CONFIG_TRACE
+
+#endif // __TRACE_H__
@@ -112,14 +112,48 @@ void pack_float(frame_t *frame, float data)
     pack32(frame, overlay.u32);
 }
 
+/** Pack bytes with stuffing and crc updating, the runs between bytes that
+    need stuffing are copied as they are */
+void pack_bytes(frame_t *frame, const uint8_t *data, uint32_t length)
+{
+    const uint8_t *end = data + length;
+    while (data < end) {
+        const uint8_t *run = data;
+        while (data < end && *data != _SOF && *data != _DLE && *data != _EOF) {
+            data++;
+        }
+        uint32_t count = data - run;
+        /** Like pack8, the last byte of the buffer is left for the EOF */
+        uint32_t room = frame->length + 1 < MAX_FRAME_LENGTH ? MAX_FRAME_LENGTH - 1 - frame->length : 0;
+        bool overflow = count > room;
+        if (overflow) {
+            count = room;
+        }
+        memcpy(&frame->buffer[frame->length], run, count);
+        frame->length += count;
+        frame->crc = crc16_add_bytes(frame->crc, run, count);
+        if (overflow)
+            goto overflow;
+        if (data < end) {
+            if (frame->length + 2 >= MAX_FRAME_LENGTH)
+                goto overflow;
+            frame->buffer[frame->length++] = _DLE;
+            frame->buffer[frame->length++] = *data ^ _XOR;
+            frame->crc = crc16_add(frame->crc, *data);
+            data++;
+        }
+    }
+
+    return;
+
+overflow:
+    dbg_printf("uFrame overflow at %s:%d\n", __FILE__, __LINE__);
+}
+
 /** Pack a c string with null terminator */
 void pack_cstr(frame_t *frame, const char *data)
 {
-    while(*data) {
-        pack8(frame, *data);
-        data++;
-    }
-    pack8(frame, '\0');
+    pack_bytes(frame, (const uint8_t*) data, strlen(data) + 1);
 }
 
 /** Finish frame. Store crc and EOF */
@@ -145,6 +179,19 @@ uint32_t unpack8(frame_t *frame, uint8_t *data)
     return 0;
 }
 
+uint32_t unpack_bytes(frame_t *frame, uint8_t *data, uint32_t length)
+{
+    uint32_t count = length < frame->length ? length : frame->length;
+    memcpy(data, &frame->buffer[frame->unpack_pos], count);
+    frame->unpack_pos += count;
+    frame->length -= count;
+    if (count < length) {
+        dbg_printf("uFrame underflow at %s:%d\n", __FILE__, __LINE__);
+        memset(&data[count], 0, length - count);
+    }
+    return count;
+}
+
 uint32_t unpack16(frame_t *frame, uint16_t *data)
 {
     uint32_t bytes_read;
@@ -244,3 +291,182 @@ void uframe_from_extracted_payload(frame_t *frame, const uint8_t *data, uint32_t
     memcpy(frame->buffer, data, length);
     frame->length = length;
 }
+
+void uframe_start_receive(frame_t *frame)
+{
+    frame->length = 0;
+    frame->crc = 0;
+    frame->unpack_pos = 0;
+    frame->escaped = false;
+}
+
+int32_t uframe_receive_byte(frame_t *frame, uint8_t data)
+{
+    if (data == _SOF) {
+        uframe_start_receive(frame);
+        return 0;
+    } else if (data == _EOF) {
+        if (frame->length <= 2) { // CRC16 only is no usable frame
+            return -E_LEN;
+        }
+        // The CRC over the payload followed by its CRC is zero
+        if (frame->crc) {
+            return -E_CRC;
+        }
+        frame->length -= 2; // omit crc from returned length
+        return (int32_t) frame->length;
+    } else if (frame->escaped) {
+        frame->escaped = false;
+        data ^= _XOR;
+    } else if (data == _DLE) {
+        frame->escaped = true;
+        return 0;
+    }
+    if (frame->length >= MAX_FRAME_LENGTH) {
+        return -E_LEN;
+    }
+    frame->buffer[frame->length++] = data;
+    frame->crc = crc16_add(frame->crc, data);
+    return 0;
+}
+
+uint32_t uframe_escaped_length(const uint8_t *data, uint32_t length)
+{
+    uint32_t escaped = length;
+    for (uint32_t i = 0; i < length; i++) {
+        if (data[i] == _SOF || data[i] == _DLE || data[i] == _EOF) {
+            escaped++;
+        }
+    }
+    return escaped;
+}
+
+void umsg_init(umsg_t *msg, uint8_t *buffer, uint32_t size)
+{
+    msg->buffer = buffer;
+    msg->size = size;
+    msg->length = 0;
+    msg->id = 0;
+    msg->next = 0;
+    msg->active = false;
+    msg->overflow = false;
+}
+
+void umsg_start(umsg_t *msg, uint8_t id)
+{
+    msg->id = id;
+    msg->length = 0;
+    msg->next = 0;
+    msg->active = true;
+    msg->overflow = false;
+}
+
+void umsg_pack8(umsg_t *msg, uint8_t data)
+{
+    if (msg->length < msg->size) {
+        msg->buffer[msg->length++] = data;
+    } else {
+        msg->overflow = true;
+    }
+}
+
+void umsg_pack16(umsg_t *msg, uint16_t data)
+{
+    umsg_pack8(msg, (data >> 8) & 0xFF);
+    umsg_pack8(msg, data & 0xFF);
+}
+
+void umsg_pack32(umsg_t *msg, uint32_t data)
+{
+    umsg_pack16(msg, (data >> 16) & 0xFFFF);
+    umsg_pack16(msg, data & 0xFFFF);
+}
+
+void umsg_pack_cstr(umsg_t *msg, const char *data)
+{
+    while(*data) {
+        umsg_pack8(msg, *data);
+        data++;
+    }
+    umsg_pack8(msg, '\0');
+}
+
+uint32_t umsg_fragments(const umsg_t *msg)
+{
+    if (msg->length == 0) {
+        return 1;
+    }
+    return (msg->length + UFRAME_FRAGMENT_DATA - 1) / UFRAME_FRAGMENT_DATA;
+}
+
+void umsg_pack_fragment(frame_t *frame, const umsg_t *msg, uint32_t index, uint8_t flags)
+{
+    uint32_t offset = index * UFRAME_FRAGMENT_DATA;
+    uint32_t count = msg->length > offset ? msg->length - offset : 0;
+    if (count > UFRAME_FRAGMENT_DATA) {
+        count = UFRAME_FRAGMENT_DATA;
+    }
+    pack8(frame, msg->id);
+    pack8(frame, index);
+    pack8(frame, flags);
+    pack16(frame, msg->length);
+    pack_bytes(frame, &msg->buffer[offset], count);
+}
+
+bool umsg_ack(umsg_t *msg, uint8_t id, uint8_t next)
+{
+    if (!msg->active || id != msg->id || next > umsg_fragments(msg)) {
+        return false;
+    }
+    msg->next = next;
+    return true;
+}
+
+int32_t umsg_receive_fragment(umsg_t *msg, frame_t *frame)
+{
+    uint8_t id, index, flags;
+    uint16_t total;
+    if (!unpack8(frame, &id) || !unpack8(frame, &index) || !unpack8(frame, &flags) ||
+        unpack16(frame, &total) != 2) {
+        return -E_LEN;
+    }
+    bool receiving = msg->active && id == msg->id &&
+                     msg->next > 0 && msg->next < umsg_fragments(msg);
+    if (index == 0 && !receiving) {
+        /** A new message, or its first fragment sent again */
+        if (total > msg->size) {
+            msg->active = false;
+            return -E_LEN;
+        }
+        msg->id = id;
+        msg->length = total;
+        msg->next = 0;
+        msg->active = true;
+        msg->overflow = false;
+    }
+    if (!msg->active || id != msg->id) {
+        return -E_LEN;
+    }
+
+    uint32_t offset = index * UFRAME_FRAGMENT_DATA;
+    /** Unpacking counts frame->length down to the bytes left */
+    uint32_t count = frame->length;
+    if (index == msg->next && index < umsg_fragments(msg)) {
+        uint32_t expected = msg->length - offset;
+        if (expected > UFRAME_FRAGMENT_DATA) {
+            expected = UFRAME_FRAGMENT_DATA;
+        }
+        if (count != expected || total != msg->length) {
+            return -E_LEN;
+        }
+        memcpy(&msg->buffer[offset], &frame->buffer[frame->unpack_pos], count);
+        frame->unpack_pos += count;
+        frame->length = 0;
+        msg->next++;
+        if (msg->next >= umsg_fragments(msg)) {
+            return UMSG_COMPLETE;
+        }
+    }
+    /** Duplicates and fragments after a lost one only trigger an ack */
+    return flags & UFRAME_FRAG_ACK ? UMSG_ACK : 0;
+}
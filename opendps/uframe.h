@@ -54,7 +54,7 @@
  * ## Frame Building
  *
  * 1. Call set_frame_header() to initialize frame
- * 2. Use pack8/pack16/pack32/pack_cstr to add payload
+ * 2. Use pack8/pack16/pack32/pack_cstr/pack_bytes to add payload
  * 3. Call end_frame() to finalize (adds CRC and EOF)
  * 4. Transmit frame->buffer[0..frame->length-1]
  *
@@ -62,7 +62,30 @@
  *
  * 1. Receive bytes until EOF is seen
  * 2. Call uframe_extract_payload() to validate and extract payload
- * 3. Use unpack8/unpack16/unpack32 to read payload fields
+ * 3. Use unpack8/unpack16/unpack32/unpack_bytes to read payload fields
+ *
+ * Alternatively feed each received byte to uframe_receive_byte(), which
+ * unescapes it into a frame_t and checks the CRC as the frame arrives.
+ *
+ * ## Messages
+ *
+ * A payload too large for one frame is sent as a message of fragments, each
+ * in a frame of its own following a command byte chosen by the protocol:
+ *
+ * ```
+ * +--------+-------+-------+-----------+--------------------------------+
+ * | msg_id | index | flags | total(16) | data (UFRAME_FRAGMENT_DATA)    |
+ * +--------+-------+-------+-----------+--------------------------------+
+ * ```
+ *
+ * Fragment <index> holds bytes index * UFRAME_FRAGMENT_DATA and onwards of
+ * the <total> byte message, the last one may be shorter. The sender sends a
+ * window of fragments and sets UFRAME_FRAG_ACK in the last one, the receiver
+ * answers it with the index of the first fragment it is missing and the
+ * sender carries on from there. A fragment out of order is dropped and sent
+ * again from the acknowledged index, so a lost frame costs one window.
+ * Building and reassembly are done by the umsg_*() functions below, the ack
+ * frame and the window size are up to the protocol.
  *
  * ## CRC Protection
  *
@@ -77,6 +100,8 @@
 #ifndef __UFRAME_H__
 #define __UFRAME_H__
 
+#include <stdint.h>
+#include <stdbool.h>
 #include "dbg_printf.h"
 
 /**
@@ -131,11 +156,20 @@
  * @def MAX_FRAME_LENGTH
  * @brief Maximum size of a frame buffer
  *
- * This limits the maximum payload size. Larger frames would require
- * fragmentation at the application level.
+ * This limits the maximum payload size. Larger payloads are sent as
+ * messages split over several frames, see umsg_t.
  */
 #define MAX_FRAME_LENGTH (128)
 
+/**
+ * @def MAX_PAYLOAD_LENGTH
+ * @brief Largest payload that fits in MAX_FRAME_LENGTH with every byte escaped
+ *
+ * (128 - 6) / 2 = 61 bytes. Chunked commands and responses are sized
+ * against this, see ENVELOPE_LENGTH in protocol.h.
+ */
+#define MAX_PAYLOAD_LENGTH ((MAX_FRAME_LENGTH - FRAME_OVERHEAD(0)) / 2)
+
 /**
  * @brief Frame structure for building and parsing frames
  *
@@ -148,6 +182,7 @@ typedef struct
     uint32_t length;                    /**< Current length of data in buffer */
     uint16_t crc;                       /**< Running CRC value during building */
     uint32_t unpack_pos;                /**< Current read position for unpacking */
+    bool escaped;                       /**< Last received byte was a DLE */
 } frame_t;
 
 /**
@@ -238,11 +273,24 @@ void pack32(frame_t *frame, uint32_t data);
  */
 void pack_float(frame_t *frame, float data);
 
+/**
+ * @brief Pack a block of bytes into the frame
+ *
+ * Same result as pack8() for each byte, but the runs of bytes that need no
+ * escaping are copied and added to the CRC in one go. Packing stops at the
+ * first byte that does not fit.
+ *
+ * @param[in,out] frame  Frame to add data to
+ * @param[in]     data   Bytes to add
+ * @param[in]     length Number of bytes
+ */
+void pack_bytes(frame_t *frame, const uint8_t *data, uint32_t length);
+
 /**
  * @brief Pack a null-terminated string into the frame
  *
  * Adds a C string to the frame including the null terminator.
- * Each byte is escaped if necessary.
+ * Each byte is escaped if necessary, see pack_bytes().
  *
  * @param[in,out] frame Frame to add data to
  * @param[in]     data  Null-terminated string to add
@@ -261,6 +309,19 @@ void pack_cstr(frame_t *frame, const char *data);
  */
 uint32_t unpack8(frame_t *frame, uint8_t *data);
 
+/**
+ * @brief Unpack a block of bytes from the frame
+ *
+ * Copies the next length bytes of the payload and advances the read
+ * position. Bytes beyond the end of the payload are returned as 0.
+ *
+ * @param[in,out] frame  Frame to read from
+ * @param[out]    data   Buffer receiving the bytes
+ * @param[in]     length Number of bytes to read
+ * @return Number of bytes read from the frame
+ */
+uint32_t unpack_bytes(frame_t *frame, uint8_t *data, uint32_t length);
+
 /**
  * @brief Unpack a 16-bit value from the frame (big-endian)
  *
@@ -358,4 +419,147 @@ int32_t uframe_extract_payload_inplace(uint8_t *data, uint32_t length);
  */
 void uframe_from_extracted_payload(frame_t *frame, const uint8_t *data, uint32_t length);
 
+/**
+ * @brief Prepare a frame for receiving with uframe_receive_byte()
+ *
+ * @param[out] frame Frame structure to receive into
+ */
+void uframe_start_receive(frame_t *frame);
+
+/**
+ * @brief Add a received byte to a frame
+ *
+ * Unescapes the byte directly into frame->buffer and updates the CRC, so
+ * the frame is validated once its EOF arrives without a second pass over
+ * the data. A SOF restarts the frame.
+ *
+ * @param[in,out] frame Frame prepared by uframe_start_receive()
+ * @param[in]     data  Received byte
+ * @return 0 while the frame is incomplete
+ * @return Payload length when a valid frame is complete, the frame is then
+ *         ready for unpacking
+ * @return -E_LEN if the frame is empty or does not fit in frame->buffer
+ * @return -E_CRC if CRC verification failed
+ */
+int32_t uframe_receive_byte(frame_t *frame, uint8_t data);
+
+/**
+ * @defgroup Frame_Messages Multi-frame messages
+ * @brief Messages larger than a frame, see "Messages" above
+ * @{
+ */
+
+/** @brief Message bytes per fragment, a tagged fragment fits a frame escaped */
+#define UFRAME_FRAGMENT_DATA (48)
+
+/** @brief Fragment flag, the receiver is to acknowledge this fragment */
+#define UFRAME_FRAG_ACK (1 << 0)
+
+/** @brief umsg_receive_fragment() result, acknowledge with msg->next */
+#define UMSG_ACK (1)
+
+/** @brief umsg_receive_fragment() result, the message is complete */
+#define UMSG_COMPLETE (2)
+
+/**
+ * @brief A message being built for sending or being reassembled
+ */
+typedef struct
+{
+    uint8_t *buffer;                    /**< Unescaped message */
+    uint32_t size;                      /**< Size of buffer */
+    uint32_t length;                    /**< Bytes packed, or announced by the sender */
+    uint8_t id;                         /**< Message id */
+    uint8_t next;                       /**< First fragment not acknowledged/received */
+    bool active;                        /**< The buffer holds this message */
+    bool overflow;                      /**< Packing ran out of buffer */
+} umsg_t;
+
+/**
+ * @brief Set up a message on a buffer
+ *
+ * @param[out] msg    Message to set up
+ * @param[in]  buffer Buffer for the unescaped message
+ * @param[in]  size   Size of buffer in bytes
+ */
+void umsg_init(umsg_t *msg, uint8_t *buffer, uint32_t size);
+
+/**
+ * @brief Start building a message to send
+ *
+ * @param[in,out] msg Message set up by umsg_init()
+ * @param[in]     id  Message id, should differ from the previous message
+ */
+void umsg_start(umsg_t *msg, uint8_t id);
+
+/** @brief Pack a byte into a message, sets msg->overflow when full */
+void umsg_pack8(umsg_t *msg, uint8_t data);
+
+/** @brief Pack a 16-bit value into a message (big-endian) */
+void umsg_pack16(umsg_t *msg, uint16_t data);
+
+/** @brief Pack a 32-bit value into a message (big-endian) */
+void umsg_pack32(umsg_t *msg, uint32_t data);
+
+/** @brief Pack a null-terminated string into a message */
+void umsg_pack_cstr(umsg_t *msg, const char *data);
+
+/**
+ * @brief Number of fragments a message is sent in
+ *
+ * @param[in] msg The message
+ * @return Fragment count, an empty message takes one fragment
+ */
+uint32_t umsg_fragments(const umsg_t *msg);
+
+/**
+ * @brief Pack a fragment of a message into a frame
+ *
+ * The frame is to be started with set_frame_header() and the command byte,
+ * and ended with end_frame() by the caller.
+ *
+ * @param[in,out] frame Frame to pack into
+ * @param[in]     msg   The message
+ * @param[in]     index Fragment index, below umsg_fragments()
+ * @param[in]     flags UFRAME_FRAG_ACK to ask for an acknowledgement
+ */
+void umsg_pack_fragment(frame_t *frame, const umsg_t *msg, uint32_t index, uint8_t flags);
+
+/**
+ * @brief Apply an acknowledgement to a message being sent
+ *
+ * @param[in,out] msg  The message
+ * @param[in]     id   Message id of the acknowledgement
+ * @param[in]     next First fragment the receiver is missing
+ * @return true if the acknowledgement is for this message, msg->next is
+ *         then the fragment to send next
+ */
+bool umsg_ack(umsg_t *msg, uint8_t id, uint8_t next);
+
+/**
+ * @brief Add a received fragment to a message
+ *
+ * Fragment 0 of a message id other than the current one starts a new
+ * message.
+ *
+ * @param[in,out] msg   Message set up by umsg_init()
+ * @param[in,out] frame Received fragment, unpacked up to the fragment header
+ * @return 0 if there is nothing to do
+ * @return UMSG_ACK if the sender waits for msg->next
+ * @return UMSG_COMPLETE when all msg->length bytes have arrived
+ * @return -E_LEN if the message does not fit or the fragment is malformed
+ */
+int32_t umsg_receive_fragment(umsg_t *msg, frame_t *frame);
+
+/**
+ * @brief Length of a payload once escaped
+ *
+ * @param[in] data   Unescaped payload
+ * @param[in] length Length of payload
+ * @return Escaped length, without SOF, CRC and EOF
+ */
+uint32_t uframe_escaped_length(const uint8_t *data, uint32_t length);
+
+/** @} */ // end of Frame_Messages
+
 #endif // __UFRAME_H__
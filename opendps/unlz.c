@@ -0,0 +1,110 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "unlz.h"
+
+/** Decoder states */
+enum {
+    st_ctrl = 0,
+    st_literal,
+    st_distance_hi,
+    st_distance_lo,
+};
+
+void unlz_init(unlz_t *lz, unlz_put_t put, unlz_peek_t peek, void *ctx)
+{
+    lz->put = put;
+    lz->peek = peek;
+    lz->ctx = ctx;
+    lz->state = st_ctrl;
+    lz->count = 0;
+    lz->distance = 0;
+    lz->length = 0;
+}
+
+/**
+ * @brief      Copy the match just read to the output
+ *
+ * @param      lz    The decoder
+ *
+ * @return     false if the match is invalid or put failed
+ */
+static bool copy_match(unlz_t *lz)
+{
+    if (lz->distance == 0 || lz->distance > lz->length) {
+        return false;
+    }
+    for (uint32_t i = 0; i < lz->count; i++) {
+        /** Output grows as we go, an overlapping match repeats itself */
+        if (!lz->put(lz->ctx, lz->peek(lz->ctx, lz->distance))) {
+            return false;
+        }
+        lz->length++;
+    }
+    return true;
+}
+
+bool unlz_feed(unlz_t *lz, const uint8_t *data, uint32_t length)
+{
+    for (uint32_t i = 0; i < length; i++) {
+        uint8_t b = data[i];
+        switch (lz->state) {
+            case st_ctrl:
+                if (b & 0x80) {
+                    lz->count = (b & 0x7f) + UNLZ_MIN_MATCH;
+                    lz->state = st_distance_hi;
+                } else {
+                    lz->count = b + 1;
+                    lz->state = st_literal;
+                }
+                break;
+            case st_literal:
+                if (!lz->put(lz->ctx, b)) {
+                    return false;
+                }
+                lz->length++;
+                if (--lz->count == 0) {
+                    lz->state = st_ctrl;
+                }
+                break;
+            case st_distance_hi:
+                lz->distance = b << 8;
+                lz->state = st_distance_lo;
+                break;
+            case st_distance_lo:
+                lz->distance |= b;
+                lz->state = st_ctrl;
+                if (!copy_match(lz)) {
+                    return false;
+                }
+                break;
+        }
+    }
+    return true;
+}
+
+bool unlz_done(const unlz_t *lz)
+{
+    return lz->state == st_ctrl;
+}
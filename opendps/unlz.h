@@ -0,0 +1,106 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file unlz.h
+ * @brief Streaming LZ Decompressor
+ *
+ * Decodes the LZ77 style format dpsctl compresses firmware images with,
+ * one input byte at a time so a stream can be split at any point, e.g.
+ * across upgrade chunks. The stream is a sequence of tokens:
+ *
+ *   [ctrl < 0x80] [literal]{ctrl + 1}
+ *   [ctrl >= 0x80] [distance:16]      copy (ctrl & 0x7f) + UNLZ_MIN_MATCH
+ *                                     bytes from distance bytes back
+ *
+ * Distance is big endian, 1..65535, and a match may overlap its own output.
+ * The decoder keeps no window of its own, back references are read through
+ * the peek callback so the history can live wherever the output went, flash
+ * in the case of the bootloader.
+ */
+
+#ifndef __UNLZ_H__
+#define __UNLZ_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** @brief Shortest match the format encodes */
+#define UNLZ_MIN_MATCH  (3)
+
+/**
+ * @brief Output callback
+ * @param ctx  Caller context
+ * @param byte Next decoded byte
+ * @return false to abort decoding
+ */
+typedef bool (*unlz_put_t)(void *ctx, uint8_t byte);
+
+/**
+ * @brief History callback
+ * @param ctx      Caller context
+ * @param distance 1..number of bytes output so far
+ * @return The byte output distance bytes ago
+ */
+typedef uint8_t (*unlz_peek_t)(void *ctx, uint16_t distance);
+
+typedef struct {
+    unlz_put_t put;
+    unlz_peek_t peek;
+    void *ctx;
+    uint8_t state;      /**< Which part of a token comes next */
+    uint8_t count;      /**< Literals left or match length */
+    uint16_t distance;  /**< Distance of the match being read */
+    uint32_t length;    /**< Number of bytes output */
+} unlz_t;
+
+/**
+ * @brief Start decoding a new stream
+ *
+ * @param lz   The decoder
+ * @param put  Called with every decoded byte
+ * @param peek Called to read back earlier output
+ * @param ctx  Passed to the callbacks
+ */
+void unlz_init(unlz_t *lz, unlz_put_t put, unlz_peek_t peek, void *ctx);
+
+/**
+ * @brief Decode the next part of the stream
+ *
+ * @param lz     The decoder
+ * @param data   Compressed data
+ * @param length Length of data
+ * @return false if put failed or the stream refers to data before its start
+ */
+bool unlz_feed(unlz_t *lz, const uint8_t *data, uint32_t length);
+
+/**
+ * @brief Check the stream did not end in the middle of a token
+ *
+ * @param lz The decoder
+ * @return true if all data fed so far decoded to complete tokens
+ */
+bool unlz_done(const unlz_t *lz);
+
+#endif // __UNLZ_H__
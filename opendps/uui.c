@@ -27,8 +27,13 @@
 #include "my_assert.h"
 #include "uui.h"
 #include "tft.h"
+#include "ili9163c.h"
 #include "opendps.h"
+#include "perf.h"
 
+/** Bounding box of a label */
+#define LABEL_WIDTH   (64)
+#define LABEL_HEIGHT  (20)
 
 /**
  * @brief      Callback for got focus because of M1/M2 presses
@@ -62,64 +67,144 @@ void uui_init(uui_t *ui, past_t *past)
     ui->past = past;
     ui->num_screens = ui->cur_screen = 0;
     ui->is_visible = true;
+    ui->needs_activation = false;
+    ui->needs_clear = false;
 }
 
 void uui_add_screen(uui_t *ui, ui_screen_t *screen)
 {
     assert(ui);
     assert(screen);
-    if (screen->past_restore) {
-        screen->past_restore(ui->past);
+    if (screen->desc->past_restore) {
+        screen->desc->past_restore(ui->past);
     }
     if (ui->num_screens < MAX_SCREENS) {
         ui->screens[ui->num_screens++] = screen;
         screen->cur_item = 0;
         screen->is_enabled = false;
-        for (uint8_t i = 0; i < screen->num_items; i++) {
-            screen->items[i]->screen = screen;
-            screen->items[i]->needs_redraw = true;
+        for (uint8_t i = 0; i < screen->desc->num_items; i++) {
+            screen->desc->items[i]->screen = screen;
+            screen->desc->items[i]->needs_redraw = true;
+            screen->desc->items[i]->needs_full_redraw = true;
         }
     }
 }
 
+/** The UUI_REGISTER_FUNCTION() table, sorted by the linker */
+extern const ui_function_t _ui_functions_start[], _ui_functions_end[];
+
+void uui_init_functions(uui_t *ui)
+{
+    for (const ui_function_t *f = _ui_functions_start; f < _ui_functions_end; f++) {
+        f->init(ui);
+    }
+}
+
+/**
+ * @brief      Draw the screen icon unless it is already on the display
+ *
+ * @param      screen  The screen
+ * @param[in]  force   Draw even if the icon is present
+ */
+static void draw_icon(ui_screen_t *screen, bool force)
+{
+    if (force || !screen->icon_drawn || screen->icon_clear_count != tft_clear_count()) {
+        tft_blit_compressed(screen->desc->icon_data, screen->desc->icon_width, screen->desc->icon_height, XPOS_ICON, 128-screen->desc->icon_height);
+        screen->icon_drawn = true;
+        screen->icon_clear_count = tft_clear_count();
+    }
+}
+
+/**
+ * @brief      Draw the labels of a screen unless they are on the display
+ *             already, items are drawn on top of them
+ *
+ * @param      screen  The screen
+ */
+static void draw_labels(ui_screen_t *screen)
+{
+    if (screen->labels_drawn && screen->labels_clear_count == tft_clear_count()) {
+        return;
+    }
+    for (uint32_t i = 0; i < screen->desc->num_labels; i++) {
+        const ui_label_t *label = &screen->desc->labels[i];
+        tft_puts(FONT_FULL_SMALL, label->text, label->x, label->y, LABEL_WIDTH, LABEL_HEIGHT, WHITE, false);
+    }
+    screen->labels_drawn = true;
+    screen->labels_clear_count = tft_clear_count();
+}
+
 void uui_refresh(uui_t *ui, bool force)
 {
     assert(ui);
+    PERF_BEGIN(perf_uui_refresh);
     ui_screen_t *screen = ui->screens[ui->cur_screen];
     assert(screen);
-    for (uint8_t i = 0; i < screen->num_items; i++) {
-        ui_item_t *item = screen->items[i];
+    draw_labels(screen);
+    for (uint8_t i = 0; i < screen->desc->num_items; i++) {
+        ui_item_t *item = screen->desc->items[i];
         if (force || item->needs_redraw) {
             assert(item->draw);
+            if (force) {
+                item->needs_full_redraw = true;
+            }
             item->draw(item);
             item->needs_redraw = false;
         }
     }
-    tft_blit((uint16_t*) screen->icon_data, screen->icon_width, screen->icon_height, XPOS_ICON, 128-screen->icon_height);
+    draw_icon(screen, force);
+    PERF_END(perf_uui_refresh);
+}
+
+void uui_invalidate_icon(ui_screen_t *screen)
+{
+    assert(screen);
+    screen->icon_drawn = false;
 }
 
 void uui_activate(uui_t *ui)
+{
+    uui_activate_deferred(ui);
+    (void) uui_flush(ui);
+}
+
+void uui_activate_deferred(uui_t *ui)
 {
     assert(ui);
     assert(ui->num_screens);
     if (ui->num_screens > 0) {
         ui_screen_t *screen = ui->screens[ui->cur_screen];
         /** Find the first focusable item */
-        for (uint32_t i = 0; i < screen->num_items; i++) {
-            if (screen->items[i]->can_focus) {
+        for (uint32_t i = 0; i < screen->desc->num_items; i++) {
+            if (screen->desc->items[i]->can_focus) {
                 screen->cur_item = i;
                 break;
             }
         }
-        /** @todo: add activation callback for each screen allowing for updating of U/I settings */
-        uui_refresh(ui, true);
-        tft_blit((uint16_t*) screen->icon_data, screen->icon_width, screen->icon_height, XPOS_ICON, 128-screen->icon_height);
-        if (screen->activated) {
-            screen->activated();
-        }
+        ui->needs_activation = true;
     }
 }
 
+bool uui_flush(uui_t *ui)
+{
+    assert(ui);
+    if (!ui->needs_activation) {
+        return false;
+    }
+    ui->needs_activation = false;
+    ui_screen_t *screen = ui->screens[ui->cur_screen];
+    if (ui->needs_clear) {
+        ui->needs_clear = false;
+        tft_clear();
+    }
+    /** @todo: add activation callback for each screen allowing for updating of U/I settings */
+    uui_refresh(ui, true); /** Draws the screen icon */
+    if (screen->desc->activated) {
+        screen->desc->activated();
+    }
+    return true;
+}
+
 static void focus_switch(ui_item_t *item)
 {
     if (item->has_focus) {
@@ -129,12 +214,12 @@ static void focus_switch(ui_item_t *item)
     }
 }
 
-void uui_handle_screen_event(uui_t *ui, event_t event)
+void uui_handle_screen_event(uui_t *ui, event_t event, uint8_t data)
 {
     assert(ui);
     ui_screen_t *screen = ui->screens[ui->cur_screen];
     assert(screen);
-    ui_item_t *item = screen->items[screen->cur_item];
+    ui_item_t *item = screen->desc->items[screen->cur_item];
     assert(item);
 
     if (!ui->is_visible) {
@@ -154,7 +239,7 @@ void uui_handle_screen_event(uui_t *ui, event_t event)
         case event_rot_right:
         case event_rot_press:
             if (item->has_focus) {
-                MCALL(item, got_event, event);
+                MCALL(item, got_event, event, data);
             }
             break;
 
@@ -168,9 +253,9 @@ void uui_handle_screen_event(uui_t *ui, event_t event)
             if (item->has_focus) {
                 ui_item_t *old_item = item;
                 do {
-                    screen->cur_item = screen->cur_item ? screen->cur_item - 1 : screen->num_items - 1;
-                } while(!screen->items[screen->cur_item]->can_focus);
-                ui_item_t *new_item = screen->items[screen->cur_item];
+                    screen->cur_item = screen->cur_item ? screen->cur_item - 1 : screen->desc->num_items - 1;
+                } while(!screen->desc->items[screen->cur_item]->can_focus);
+                ui_item_t *new_item = screen->desc->items[screen->cur_item];
                 if (old_item != new_item) {
                     focus_switch(old_item);
                     focus_switch(new_item);
@@ -182,9 +267,9 @@ void uui_handle_screen_event(uui_t *ui, event_t event)
             if (item->has_focus) {
                 ui_item_t *old_item = item;
                 do {
-                    screen->cur_item = (screen->cur_item + 1) % screen->num_items;
-                } while(!screen->items[screen->cur_item]->can_focus);
-                ui_item_t *new_item = screen->items[screen->cur_item];
+                    screen->cur_item = (screen->cur_item + 1) % screen->desc->num_items;
+                } while(!screen->desc->items[screen->cur_item]->can_focus);
+                ui_item_t *new_item = screen->desc->items[screen->cur_item];
                 if (old_item != new_item) {
                     focus_switch(old_item);
                     focus_switch(new_item);
@@ -196,12 +281,12 @@ void uui_handle_screen_event(uui_t *ui, event_t event)
         case event_ocp:
         case event_ovp:
             /** If current screen can be enabled */
-            if (screen->enable) {
+            if (screen->desc->enable) {
                 screen->is_enabled = !screen->is_enabled;
-                if (screen->is_enabled && screen->past_save) {
-                    screen->past_save(ui->past);
+                if (screen->is_enabled && screen->desc->past_save) {
+                    screen->desc->past_save(ui->past);
                 }
-                screen->enable(screen->is_enabled);
+                screen->desc->enable(screen->is_enabled);
                 opendps_update_power_status(screen->is_enabled); /** @todo: move */
             }
             break;
@@ -215,8 +300,8 @@ void uui_next_screen(uui_t *ui)
 {
     uint32_t new_screen = (ui->cur_screen + 1) % ui->num_screens;
     if (ui->num_screens > 1) {
-        if (ui->screens[ui->cur_screen]->deactivated) {
-            ui->screens[ui->cur_screen]->deactivated();
+        if (ui->screens[ui->cur_screen]->desc->deactivated) {
+            ui->screens[ui->cur_screen]->desc->deactivated();
         }
         uui_set_screen(ui, new_screen);
     }
@@ -226,38 +311,64 @@ void uui_prev_screen(uui_t *ui)
 {
     uint32_t new_screen = ui->cur_screen ? ui->cur_screen -1 : ui->num_screens - 1;
     if (ui->num_screens > 1) {
-        if (ui->screens[ui->cur_screen]->deactivated) {
-            ui->screens[ui->cur_screen]->deactivated();
+        if (ui->screens[ui->cur_screen]->desc->deactivated) {
+            ui->screens[ui->cur_screen]->desc->deactivated();
         }
         uui_set_screen(ui, new_screen);
     }
 }
 
-void uui_set_screen(uui_t *ui, uint32_t screen_idx)
+/**
+ * @brief      Switch screen, disabling the old one
+ *
+ * @param      ui          The ui
+ * @param[in]  screen_idx  The new screen
+ * @param[in]  defer       Leave drawing the new screen to uui_flush()
+ */
+static void set_screen(uui_t *ui, uint32_t screen_idx, bool defer)
 {
     assert(screen_idx < ui->num_screens);
     ui_screen_t *cur_screen = ui->screens[ui->cur_screen];
     assert(cur_screen);
-    ui_item_t *item = cur_screen->items[cur_screen->cur_item];
+    ui_item_t *item = cur_screen->desc->items[cur_screen->cur_item];
     assert(item);
     ui->cur_screen = screen_idx;
     ui_screen_t *new_screen = ui->screens[ui->cur_screen];
     assert(new_screen);
     if (new_screen != cur_screen) {
-//        cur_screen->enable(false); /** Alway disable current function when switching */
+//        cur_screen->desc->enable(false); /** Alway disable current function when switching */
         opendps_update_power_status(false); /** @todo: move */
         if (cur_screen->is_enabled) {
             /** Disable the old screen as it will no longer be in control of power out */
-            cur_screen->enable(false);
+            cur_screen->desc->enable(false);
             cur_screen->is_enabled = false;
         }
         if (item->has_focus) {
             MCALL(item, lost_focus);
         }
-        uui_activate(ui);
+        if (cur_screen->desc->labels != new_screen->desc->labels) {
+            /** The layouts differ, clear the display before drawing */
+            ui->needs_clear = true;
+            cur_screen->labels_drawn = false;
+        }
+        if (defer) {
+            uui_activate_deferred(ui);
+        } else {
+            uui_activate(ui);
+        }
     }
 }
 
+void uui_set_screen(uui_t *ui, uint32_t screen_idx)
+{
+    set_screen(ui, screen_idx, false);
+}
+
+void uui_set_screen_deferred(uui_t *ui, uint32_t screen_idx)
+{
+    set_screen(ui, screen_idx, true);
+}
+
 void ui_item_init(ui_item_t *item)
 {
     item->has_focus = false;
@@ -267,7 +378,7 @@ void ui_item_init(ui_item_t *item)
 
 void uui_tick(uui_t *ui)
 {
-    ui->screens[ui->cur_screen]->tick();
+    ui->screens[ui->cur_screen]->desc->tick();
 }
 
 void uui_show(uui_t *ui, bool show)
@@ -278,8 +389,8 @@ void uui_show(uui_t *ui, bool show)
 void uui_disable_cur_screen(uui_t *ui)
 {
     ui_screen_t *screen = ui->screens[ui->cur_screen];
-    if (screen->enable && screen->is_enabled) {
+    if (screen->desc->enable && screen->is_enabled) {
         screen->is_enabled = false;
-        screen->enable(screen->is_enabled);
+        screen->desc->enable(screen->is_enabled);
     }
 }
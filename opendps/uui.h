@@ -34,7 +34,9 @@
  *
  * The UI is organized hierarchically:
  * - **uui_t**: The top-level UI container holding multiple screens
- * - **ui_screen_t**: A screen representing an operating function
+ * - **ui_screen_t**: A screen representing an operating function, its
+ *   constant parts (name, icon, parameters, callbacks, items) live in a const
+ *   ui_screen_desc_t in flash
  * - **ui_item_t**: A UI element on a screen (number input, icon, etc.)
  *
  * ```
@@ -54,6 +56,7 @@
  *
  * - **ui_item_number**: Editable numeric value (see uui_number.h)
  * - **ui_item_icon**: Static or animated icon (see uui_icon.h)
+ * - **ui_item_graph**: Scrolling strip chart (see uui_graph.h)
  *
  * ## Focus System
  *
@@ -102,7 +105,7 @@
 #ifdef CONFIG_UI_MAX_SCREENS
  #define MAX_SCREENS (CONFIG_UI_MAX_SCREENS)
 #else
- #define MAX_SCREENS (6)
+ #define MAX_SCREENS (8)
 #endif
 
 /**
@@ -146,7 +149,7 @@ typedef enum {
     unit_none = 0,    /**< No unit (dimensionless) */
     unit_ampere,      /**< Current in amperes (A) */
     unit_volt,        /**< Voltage in volts (V) */
-    unit_watt,        /**< Power in watts (W) */
+    unit_watt,        /**< Power in watts (W), drawn in FONT_FULL_SMALL */
     unit_second,      /**< Time in seconds (s) */
     unit_hertz,       /**< Frequency in hertz (Hz) */
     unit_furlong,     /**< Length in furlongs (for testing) */
@@ -182,6 +185,8 @@ typedef enum {
     ui_item_number,
     /** @brief Icon display control (ui_icon_t) */
     ui_item_icon,
+    /** @brief Scrolling strip chart (ui_graph_t) */
+    ui_item_graph,
     /** @brief Sentinel value for iteration */
     ui_item_last = 0xff
 } ui_item_type_t;
@@ -208,6 +213,10 @@ typedef enum {
     ps_flash_error,     /**< Error writing to persistent storage */
 } set_param_status_t;
 
+/** @brief Mask bits for the set_setpoint screen callback */
+#define SETPOINT_VOLTAGE  (1 << 0)
+#define SETPOINT_CURRENT  (1 << 1)
+
 /**
  * @brief Parameter descriptor structure
  *
@@ -243,6 +252,7 @@ typedef struct ui_item_t {
     bool can_focus;             /**< True if item can receive focus for editing */
     bool has_focus;             /**< True if item currently has input focus */
     bool needs_redraw;          /**< True if item needs to be redrawn */
+    bool needs_full_redraw;     /**< True if the item must not rely on what it drew last time */
     uint16_t x, y;              /**< Position on screen (top-left corner) */
     ui_screen_t *screen;        /**< Parent screen containing this item */
 
@@ -251,7 +261,7 @@ typedef struct ui_item_t {
     /** @brief Called when item loses input focus */
     void (*lost_focus)(struct ui_item_t *item);
     /** @brief Called to process a user input event */
-    void (*got_event)(struct ui_item_t *item, event_t event);
+    void (*got_event)(struct ui_item_t *item, event_t event, uint8_t data);
     /** @brief Returns the item's current value (type-specific interpretation) */
     uint32_t (*get_value)(struct ui_item_t *item);
     /** @brief Renders the item on the TFT display */
@@ -273,25 +283,36 @@ typedef struct ui_item_t {
 #define MCALL(item, operation, ...) ((ui_item_t*) (item))->operation((ui_item_t*) item, ##__VA_ARGS__)
 
 /**
- * @brief Screen structure representing an operating function
+ * @brief Static text label, part of the background of a screen
  *
- * A screen corresponds to an operating function like CV (Constant Voltage),
- * CC (Constant Current), etc. Each screen has its own UI items, parameters,
- * and callback functions.
+ * Labels are drawn in FONT_FULL_SMALL white by uui_refresh() when the
+ * display has been cleared since they were last drawn, not on every
+ * activation of the screen.
+ */
+typedef struct {
+    const char *text;               /**< Label text */
+    uint8_t x;                      /**< Left side of the label */
+    uint8_t y;                      /**< Bottom of the label */
+} ui_label_t;
+
+/**
+ * @brief Constant part of a screen, placed in flash
  *
- * Screens are registered with the UI using uui_add_screen() and can be
- * switched using uui_next_screen(), uui_prev_screen(), or uui_set_screen().
+ * A screen corresponds to an operating function like CV (Constant Voltage),
+ * CC (Constant Current), etc. Its name, icon, parameters, callbacks and items
+ * never change and are described by a const ui_screen_desc_t, leaving only
+ * the few fields below in the RAM resident ui_screen_t.
  */
-struct ui_screen {
+typedef struct {
     uint8_t id;                     /**< Unique screen ID (must be unique across all screens) */
-    char *name;                     /**< Screen name (e.g., "cv", "cc") for remote control */
-    uint8_t *icon_data;             /**< Pointer to icon bitmap data */
+    const char *name;               /**< Screen name (e.g., "cv", "cc") for remote control */
+    const uint8_t *icon_data;       /**< Pointer to RLE compressed icon bitmap data */
     uint32_t icon_data_len;         /**< Length of icon data in bytes */
     uint32_t icon_width;            /**< Icon width in pixels */
     uint32_t icon_height;           /**< Icon height in pixels */
-    bool is_enabled;                /**< True if power output is enabled for this screen */
     uint8_t num_items;              /**< Number of UI items on this screen */
-    uint8_t cur_item;               /**< Index of currently focused item */
+    const ui_label_t *labels;       /**< Static labels, a screen with labels has a layout of its own */
+    uint8_t num_labels;             /**< Number of labels */
     ui_parameter_t parameters[MAX_PARAMETERS];  /**< Parameter descriptors */
 
     /** @brief Called when the screen becomes active (switched to) */
@@ -307,11 +328,31 @@ struct ui_screen {
     /** @brief Called to restore screen state from persistent storage */
     void (*past_restore)(past_t *past);
     /** @brief Called to set a parameter value by name */
-    set_param_status_t (*set_parameter)(char *name, char *value);
+    set_param_status_t (*set_parameter)(const char *name, char *value);
     /** @brief Called to get a parameter value by name */
-    set_param_status_t (*get_parameter)(char *name, char *value, uint32_t value_len);
+    set_param_status_t (*get_parameter)(const char *name, char *value, uint32_t value_len);
+    /** @brief Called to set the voltage and/or current setting from binary values, optional */
+    set_param_status_t (*set_setpoint)(uint8_t mask, int32_t mv, int32_t ma);
     /** @brief Flexible array of UI items on this screen */
-    ui_item_t *items[];
+    ui_item_t *const items[];
+} ui_screen_desc_t;
+
+/**
+ * @brief Screen structure representing an operating function
+ *
+ * Holds the state of a screen, everything else is found in its descriptor.
+ *
+ * Screens are registered with the UI using uui_add_screen() and can be
+ * switched using uui_next_screen(), uui_prev_screen(), or uui_set_screen().
+ */
+struct ui_screen {
+    const ui_screen_desc_t *desc;   /**< Constant part of the screen */
+    bool icon_drawn;                /**< True if the icon is known to be on the display */
+    bool is_enabled;                /**< True if power output is enabled for this screen */
+    uint8_t cur_item;               /**< Index of currently focused item */
+    uint32_t icon_clear_count;      /**< tft_clear_count() when the icon was drawn */
+    bool labels_drawn;              /**< True if the labels are known to be on the display */
+    uint32_t labels_clear_count;    /**< tft_clear_count() when the labels were drawn */
 };
 
 /**
@@ -324,6 +365,8 @@ typedef struct {
     uint8_t num_screens;            /**< Number of registered screens */
     uint8_t cur_screen;             /**< Index of currently active screen */
     bool is_visible;                /**< True if UI is visible (not hidden) */
+    bool needs_activation;          /**< Activation drawing left to uui_flush() */
+    bool needs_clear;               /**< Switched between screens of different layouts */
     ui_screen_t *screens[MAX_SCREENS];  /**< Array of registered screens */
     past_t *past;                   /**< Persistent storage for settings */
 } uui_t;
@@ -347,9 +390,22 @@ void uui_init(uui_t *ui, past_t *past);
  *
  * @param[in] ui    Pointer to the UI structure
  * @param[in] force If true, redraws all items regardless of needs_redraw flag
+ *                  and discards whatever the items know about their previous
+ *                  draw (see ui_item_t::needs_full_redraw)
  */
 void uui_refresh(uui_t *ui, bool force);
 
+/**
+ * @brief Mark the screen icon as overwritten
+ *
+ * The screen icon is only blitted by uui_refresh() when it is not known to
+ * be on the display already. Screens drawing over the icon area must call
+ * this to have the icon restored on the next refresh.
+ *
+ * @param[in] screen The screen whose icon was overwritten
+ */
+void uui_invalidate_icon(ui_screen_t *screen);
+
 /**
  * @brief Activate the current screen
  *
@@ -360,6 +416,28 @@ void uui_refresh(uui_t *ui, bool force);
  */
 void uui_activate(uui_t *ui);
 
+/**
+ * @brief Activate the current screen without drawing it
+ *
+ * Like uui_activate() but the drawing and the activated() callback are
+ * left to the next uui_flush(). Used where the caller, eg. a remote
+ * control command, should not wait for the display.
+ *
+ * @param[in] ui Pointer to the UI structure
+ */
+void uui_activate_deferred(uui_t *ui);
+
+/**
+ * @brief Finish a deferred activation
+ *
+ * Draws the current screen and calls its activated() callback if
+ * uui_activate_deferred() left that to be done.
+ *
+ * @param[in] ui Pointer to the UI structure
+ * @return true if the screen was drawn
+ */
+bool uui_flush(uui_t *ui);
+
 /**
  * @brief Add a screen to the UI
  *
@@ -373,6 +451,37 @@ void uui_activate(uui_t *ui);
  */
 void uui_add_screen(uui_t *ui, ui_screen_t *screen);
 
+/**
+ * @brief Function registration, placed in flash by UUI_REGISTER_FUNCTION()
+ */
+typedef struct {
+    void (*init)(uui_t *ui);        /**< Sets up the function and calls uui_add_screen() */
+} ui_function_t;
+
+/**
+ * @brief Register a function with the function screen
+ *
+ * Places a constant registration in the .ui_functions section, which the
+ * linker sorts by the two digit order into the table walked by
+ * uui_init_functions(). A function is thereby on the function screen as
+ * soon as it is linked in, with no code in opendps.c. The order decides the
+ * screen index remembered in past and presets, do not renumber existing
+ * functions.
+ *
+ * @param order   Two digit position in the function screen
+ * @param init_fn The init function of the function
+ */
+#define UUI_REGISTER_FUNCTION(order, init_fn) \
+    static const ui_function_t ui_function_##init_fn \
+        __attribute__((section(".ui_functions." #order), used)) = { .init = &init_fn }
+
+/**
+ * @brief Initialize all functions registered with UUI_REGISTER_FUNCTION()
+ *
+ * @param[in,out] ui Pointer to the function UI, after uui_init()
+ */
+void uui_init_functions(uui_t *ui);
+
 /**
  * @brief Process a user input event
  *
@@ -381,10 +490,11 @@ void uui_add_screen(uui_t *ui, ui_screen_t *screen);
  *
  * @param[in] ui    Pointer to the UI structure
  * @param[in] event The event to process
+ * @param[in] data  The event data, the step count of rotation events
  *
  * @see event_t for available event types
  */
-void uui_handle_screen_event(uui_t *ui, event_t event);
+void uui_handle_screen_event(uui_t *ui, event_t event, uint8_t data);
 
 /**
  * @brief Switch to the next screen
@@ -417,6 +527,17 @@ void uui_prev_screen(uui_t *ui);
  */
 void uui_set_screen(uui_t *ui, uint32_t screen_idx);
 
+/**
+ * @brief Switch to a specific screen by index without drawing it
+ *
+ * As uui_set_screen() but the new screen is activated with
+ * uui_activate_deferred().
+ *
+ * @param[in,out] ui         Pointer to the UI structure
+ * @param[in]     screen_idx Index of the screen to activate (0-based)
+ */
+void uui_set_screen_deferred(uui_t *ui, uint32_t screen_idx);
+
 /**
  * @brief Initialize a UI item
  *
@@ -0,0 +1,109 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Cyril Russo (github.com/X-Ryl669)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "my_assert.h"
+#include "uui_graph.h"
+#include "tft.h"
+
+/**
+ * @brief      Draw one column of the graph
+ *
+ * @param      item    The item
+ * @param[in]  column  The column number
+ * @param[in]  join    Draw the steps from the previous column
+ */
+static void draw_column(ui_graph_t *item, uint32_t column, bool join)
+{
+    uint32_t x = column % GRAPH_COLUMNS;
+    uint32_t bottom = item->ui.y + item->height - 1;
+    const uint8_t *cur = item->levels[x];
+    const uint8_t *prev = join ? item->levels[(column - 1) % GRAPH_COLUMNS] : cur;
+    tft_fill(x, item->ui.y, 1, item->height, item->bg_color);
+    for (uint32_t t = 0; t < GRAPH_TRACES; t++) {
+        uint32_t lo = cur[t] < prev[t] ? cur[t] : prev[t];
+        uint32_t hi = cur[t] < prev[t] ? prev[t] : cur[t];
+        tft_fill(x, bottom - hi, 1, hi - lo + 1, item->colors[t]);
+    }
+}
+
+/**
+ * @brief      Draw the columns pushed since the last draw and scroll them in
+ *
+ * @param      _item  The item
+ */
+static void graph_draw(ui_item_t *_item)
+{
+    assert(_item);
+    ui_graph_t *item = (ui_graph_t*) _item;
+    uint32_t first = item->drawn_columns;
+    bool full_redraw = _item->needs_full_redraw ||
+                       item->drawn_clear_count != tft_clear_count() ||
+                       item->num_columns - item->drawn_columns > GRAPH_COLUMNS;
+    if (full_redraw) {
+        /** Older columns have been overwritten in the ring */
+        first = item->num_columns > GRAPH_COLUMNS ? item->num_columns - GRAPH_COLUMNS : 0;
+        if (item->num_columns < GRAPH_COLUMNS) {
+            tft_fill(0, _item->y, GRAPH_COLUMNS, item->height, item->bg_color);
+        }
+    }
+    for (uint32_t column = first; column < item->num_columns; column++) {
+        draw_column(item, column, column > 0 && (column > first || !full_redraw));
+    }
+    if (full_redraw || first != item->num_columns) {
+        /** The newest column goes to the right edge */
+        tft_set_scroll(item->num_columns % GRAPH_COLUMNS);
+    }
+    item->drawn_columns = item->num_columns;
+    item->drawn_clear_count = tft_clear_count();
+    _item->needs_full_redraw = false;
+}
+
+void graph_push(ui_graph_t *item, const uint8_t *levels)
+{
+    assert(item);
+    uint8_t *column = item->levels[item->num_columns % GRAPH_COLUMNS];
+    for (uint32_t t = 0; t < GRAPH_TRACES; t++) {
+        column[t] = levels[t] < item->height ? levels[t] : item->height - 1;
+    }
+    item->num_columns++;
+    item->ui.needs_redraw = true;
+}
+
+/**
+ * @brief      Initialize graph item
+ *
+ * @param      item  The item
+ */
+void graph_init(ui_graph_t *item)
+{
+    assert(item);
+    ui_item_init(&item->ui);
+    item->ui.draw = &graph_draw;
+    item->ui.needs_redraw = true;
+    item->ui.needs_full_redraw = true;
+    item->num_columns = 0;
+    item->drawn_columns = 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Cyril Russo (github.com/X-Ryl669)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file uui_graph.h
+ * @brief Scrolling Strip Chart UI Widget
+ *
+ * This module provides a read only strip chart for the OpenDPS user
+ * interface. Each column of the chart holds one level per trace, new
+ * columns enter on the right and the chart moves left by one column.
+ *
+ * ## Drawing
+ *
+ * The chart spans the width of the display and moves by scrolling the
+ * panel (see tft_set_scroll()) rather than by redrawing it. A new column
+ * costs one background fill and one short fill per trace no matter how many
+ * columns are shown. Steps between two columns are drawn as vertical lines
+ * so the traces stay connected.
+ *
+ * A full redraw, on activation or after the display was cleared, draws the
+ * columns still in the ring.
+ *
+ * ## Usage Example
+ *
+ * ```c
+ * static ui_graph_t trend = {
+ *     .ui = {
+ *         .type = ui_item_graph,
+ *         .x = 0,
+ *         .y = 0,
+ *         .can_focus = false,
+ *     },
+ *     .height = 128,
+ *     .bg_color = BLACK,
+ *     .colors = { CYAN, YELLOW },
+ * };
+ * graph_init(&trend);
+ * ...
+ * uint8_t levels[GRAPH_TRACES] = { i_level, v_level };
+ * graph_push(&trend, levels);
+ * ```
+ *
+ * @note The panel can only scroll the whole display, a screen showing a
+ *       graph must hide the status bar, see opendps_show_status_bar(), and
+ *       scroll back with tft_set_scroll(0) when it is left.
+ *
+ * @see uui.h for the UI framework
+ */
+
+#ifndef __UUI_GRAPH_H__
+#define __UUI_GRAPH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tft.h"
+#include "uui.h"
+
+/** @brief Columns of a graph, the width of the display */
+#define GRAPH_COLUMNS  (128)
+
+/** @brief Traces of a graph */
+#define GRAPH_TRACES   (2)
+
+/**
+ * @brief Strip chart UI item structure
+ *
+ * @note Initialize with graph_init() before use
+ * @note ui.x must be 0, the graph scrolls the whole display
+ */
+typedef struct ui_graph_t {
+    /** @brief Base UI item (must be first for polymorphism) */
+    ui_item_t ui;
+    /** @brief Height in pixels from ui.y, level 0 is the bottom row */
+    uint16_t height;
+    /** @brief Background color in BGR565 format */
+    uint16_t bg_color;
+    /** @brief Trace colors in BGR565 format, the last trace is drawn on top */
+    uint16_t colors[GRAPH_TRACES];
+    /** @brief Columns pushed since graph_init() */
+    uint32_t num_columns;
+    /** @brief Columns on the display */
+    uint32_t drawn_columns;
+    /** @brief tft_clear_count() when the graph was last drawn */
+    uint32_t drawn_clear_count;
+    /** @brief Ring of trace levels, column N is at N % GRAPH_COLUMNS */
+    uint8_t levels[GRAPH_COLUMNS][GRAPH_TRACES];
+} ui_graph_t;
+
+/**
+ * @brief Initialize a graph UI item
+ *
+ * Sets up the draw callback and empties the graph.
+ *
+ * @param[in,out] item The graph item to initialize
+ */
+void graph_init(ui_graph_t *item);
+
+/**
+ * @brief Add a column to the graph
+ *
+ * Only stores the column, it is drawn with the next redraw of the item.
+ *
+ * @param[in,out] item   The graph item
+ * @param[in]     levels One level per trace, clamped to height-1
+ */
+void graph_push(ui_graph_t *item, const uint8_t *levels);
+
+#endif // __UUI_GRAPH_H__
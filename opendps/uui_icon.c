@@ -34,29 +34,23 @@
  *
  * @param      _item  The item
  * @param[in]  event  The event
+ * @param[in]  data   The step count for rotation events
  */
-static void icon_got_event(ui_item_t *_item, event_t event)
+static void icon_got_event(ui_item_t *_item, event_t event, uint8_t data)
 {
     assert(_item);
     ui_icon_t *item = (ui_icon_t*) _item;
     bool value_changed = false;
     switch(event) {
         case event_rot_left: {
-            if (item->value == 0) {
-                item->value = item->num_icons - 1;
-            } else {
-                --item->value;
-            }
+            uint32_t steps = data % item->num_icons;
+            item->value = (item->value + item->num_icons - steps) % item->num_icons;
             _item->needs_redraw = true;
             value_changed = true;
             break;
         }
         case event_rot_right: {
-            if (item->value == item->num_icons - 1) {
-                item->value = 0;
-            } else {
-                ++item->value;
-            }
+            item->value = (item->value + data) % item->num_icons;
             _item->needs_redraw = true;
             value_changed = true;
             break;
@@ -90,7 +84,7 @@ static void icon_draw(ui_item_t *_item)
     assert(item->value < item->num_icons);
     /* Frame the icon */
     tft_rect(_item->x-1, _item->y-1, item->icons_width+2, item->icons_height+2, _item->has_focus ? WHITE : BLACK);
-    tft_blit((uint16_t*) item->icons[item->value], item->icons_width, item->icons_height, _item->x, _item->y);
+    tft_blit_compressed(item->icons[item->value], item->icons_width, item->icons_height, _item->x, _item->y);
 }
 
 /**
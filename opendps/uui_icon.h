@@ -136,7 +136,7 @@ typedef struct ui_icon_t {
      * Use this to apply the new selection (e.g., change waveform type).
      */
     void (*changed)(struct ui_icon_t *item);
-    /** @brief Array of pointers to icon bitmap data (flexible array) */
+    /** @brief Array of pointers to RLE compressed icon bitmap data (flexible array) */
     const uint8_t *icons[];
 } ui_icon_t;
 
@@ -24,8 +24,10 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include "my_assert.h"
 #include "uui_number.h"
+#include "numfmt.h"
 #include "tft.h"
 #include "ili9163c.h"
 #include "font-full_small.h"
@@ -35,43 +37,39 @@
 
 #define MAX(a,b) (((a)>(b))?(a):(b))
 
-/** @todo: why is pow missing from my -lm ? */
-static uint32_t my_pow(uint32_t a, uint32_t b)
-{
-    uint32_t r = 1;
-    while(b--) {
-        r *= a;
-    }
-    return r;
-}
+/** Set in ui_number_t::drawn for digits drawn highlighted */
+#define DRAWN_HIGHLIGHT  (0x80)
 
 /**
  * @brief      Handle event and update our state and value accordingly
  *
  * @param      _item  The item
  * @param[in]  event  The event
+ * @param[in]  data   The step count for rotation events
  */
-static void number_got_event(ui_item_t *_item, event_t event)
+static void number_got_event(ui_item_t *_item, event_t event, uint8_t data)
 {
     assert(_item);
     ui_number_t *item = (ui_number_t*) _item;
     bool value_changed = false;
     switch(event) {
         case event_rot_left: {
-            uint32_t diff = my_pow(10, (item->si_prefix * -1) - item->num_decimals + item->cur_digit);
-            item->value -= diff;
-            if (item->value < item->min) {
+            int64_t diff = (int64_t) numfmt_pow10((item->si_prefix * -1) - item->num_decimals + item->cur_digit) * data;
+            if (item->value - diff < item->min) {
                 item->value = item->min;
+            } else {
+                item->value -= diff;
             }
             _item->needs_redraw = true;
             value_changed = true;
             break;
         }
         case event_rot_right: {
-            uint32_t diff = my_pow(10, (item->si_prefix * -1) - item->num_decimals + item->cur_digit);
-            item->value += diff;
-            if (item->value > item->max) {
+            int64_t diff = (int64_t) numfmt_pow10((item->si_prefix * -1) - item->num_decimals + item->cur_digit) * data;
+            if (item->value + diff > item->max) {
                 item->value = item->max;
+            } else {
+                item->value += diff;
             }
             _item->needs_redraw = true;
             value_changed = true;
@@ -165,6 +163,10 @@ static uint32_t number_draw_width(ui_item_t *_item)
         case unit_hertz:
             total_width += 2*FONT_FULL_SMALL_MAX_GLYPH_WIDTH;
             break;
+        case unit_watt:
+            /** The meter fonts have no W */
+            total_width += FONT_FULL_SMALL_MAX_GLYPH_WIDTH;
+            break;
         default:
             assert(0);
     }
@@ -228,11 +230,25 @@ static void number_draw(ui_item_t *_item)
     uint32_t xpos = _item->x;
     uint16_t color = item->color;
     uint32_t cur_digit = item->num_digits + item->num_decimals - 1; /** Which digit are we currently drawing? 0 is the right most digit */
+    uint32_t glyph = 0; /** Index into item->drawn */
+
+    /** Only the digits that changed since the last draw are redrawn, unless
+      * the display was cleared or a full redraw was requested */
+    bool full_redraw = _item->needs_full_redraw || item->drawn_clear_count != tft_clear_count();
+    if (full_redraw) {
+        memset(item->drawn, 0, sizeof(item->drawn));
+    }
 
     /** Adjust drawing position if right aligned */
     if (item->alignment == ui_text_right_aligned)
         xpos -= number_draw_width(_item);
 
+    /** All digits shown, most significant first */
+    uint8_t digits[NUMFMT_MAX_DIGITS];
+    uint32_t value = item->value > 0 ? item->value : 0;
+    assert(item->num_digits + item->num_decimals <= NUMFMT_MAX_DIGITS);
+    numfmt_digits(value, (item->si_prefix * -1) - item->num_decimals, item->num_digits + item->num_decimals, digits);
+
     /** Start printing from left to right */
     for (uint8_t place = item->num_digits; place > 0; place--) {
         /* Example value of 1000 with 5,2:
@@ -245,32 +261,42 @@ static void number_draw(ui_item_t *_item)
         cur_digit = place + item->num_decimals - 1;
 
         // this place value (1 = 1, 2 = 10, 3 = 100, etc., for si_prefix = 0)
-        int32_t power = my_pow(10, (item->si_prefix * -1) + (place - 1));
+        uint32_t power = numfmt_pow10((item->si_prefix * -1) + (place - 1));
 
-        uint8_t digit = (item->value / power) % 10;
+        uint8_t digit = digits[item->num_digits - place];
 
         // digit selected
         bool highlight = _item->has_focus && item->cur_digit == cur_digit;
 
-        // Draw background either black, or a highlighted box
-        if (spacing > 1) {
-            if (highlight) {
-                tft_rect(xpos-1, _item->y-1, digit_w+1, h+1, WHITE);
-            } else {
-                tft_rect(xpos-1, _item->y-1, digit_w+1, h+1, BLACK);
-            }
-        }
-
         // Draw the digit, Only if:
         //   value >= this place's min value (ie. digit's power)
         //   in one's place (ensuring 0.xxx has leading 0)
         //   or item has focus (ensures all digits are drawn when focused)
-        if (item->value >= power || place == 1 || _item->has_focus) {
-            // ASCII '0' plus digit value for digit ascii offset
-            tft_putch(item->font_size, '0' + digit, xpos, _item->y, digit_w, h, color, highlight);
-        } else {
-            tft_fill(xpos, _item->y, digit_w, h, BLACK);
+        bool visible = value >= power || place == 1 || _item->has_focus;
+        uint8_t state = (visible ? '0' + digit : ' ') | (highlight ? DRAWN_HIGHLIGHT : 0);
+
+        if (glyph >= NUMBER_MAX_GLYPHS || item->drawn[glyph] != state) {
+            // Draw background either black, or a highlighted box
+            if (spacing > 1) {
+                if (highlight) {
+                    tft_rect(xpos-1, _item->y-1, digit_w+1, h+1, WHITE);
+                } else {
+                    tft_rect(xpos-1, _item->y-1, digit_w+1, h+1, BLACK);
+                }
+            }
+
+            if (visible) {
+                // ASCII '0' plus digit value for digit ascii offset
+                tft_putch(item->font_size, '0' + digit, xpos, _item->y, digit_w, h, color, highlight);
+            } else {
+                tft_fill(xpos, _item->y, digit_w, h, BLACK);
+            }
+
+            if (glyph < NUMBER_MAX_GLYPHS) {
+                item->drawn[glyph] = state;
+            }
         }
+        glyph++;
 
         // next digit position
         xpos += digit_w + spacing;
@@ -278,7 +304,9 @@ static void number_draw(ui_item_t *_item)
 
     /** Draw the decimal point if there are decimal places */
     if (item->num_decimals) {
-        tft_putch(item->font_size, '.', xpos, _item->y, dot_width, h, color, false);
+        if (full_redraw) {
+            tft_putch(item->font_size, '.', xpos, _item->y, dot_width, h, color, false);
+        }
         xpos += dot_width + spacing;
     }
 
@@ -286,19 +314,33 @@ static void number_draw(ui_item_t *_item)
     cur_digit = item->num_decimals - 1;
     for (uint32_t i = 0; i < item->num_decimals; ++i) {
         bool highlight = _item->has_focus && item->cur_digit == cur_digit;
-        uint8_t digit = item->value / my_pow(10, (item->si_prefix * -1) -1 - i) % 10;
-        if (spacing > 1) /** Dont frame tiny fonts */
-        {
-            if (highlight) /** Draw an extra pixel wide border around the highlighted item */
-                tft_rect(xpos-1, _item->y-1, digit_w+1, h+1, WHITE);
-            else
-                tft_rect(xpos-1, _item->y-1, digit_w+1, h+1, BLACK);
+        uint8_t digit = digits[item->num_digits + i];
+        uint8_t state = ('0' + digit) | (highlight ? DRAWN_HIGHLIGHT : 0);
+        if (glyph >= NUMBER_MAX_GLYPHS || item->drawn[glyph] != state) {
+            if (spacing > 1) /** Dont frame tiny fonts */
+            {
+                if (highlight) /** Draw an extra pixel wide border around the highlighted item */
+                    tft_rect(xpos-1, _item->y-1, digit_w+1, h+1, WHITE);
+                else
+                    tft_rect(xpos-1, _item->y-1, digit_w+1, h+1, BLACK);
+            }
+            tft_putch(item->font_size, '0' + digit, xpos, _item->y, digit_w, h, color, highlight);
+            if (glyph < NUMBER_MAX_GLYPHS) {
+                item->drawn[glyph] = state;
+            }
         }
-        tft_putch(item->font_size, '0' + digit, xpos, _item->y, digit_w, h, color, highlight);
+        glyph++;
         cur_digit--;
         xpos += digit_w + spacing;
     }
 
+    item->drawn_clear_count = tft_clear_count();
+    _item->needs_full_redraw = false;
+    if (!full_redraw) {
+        /** The unit never changes */
+        return;
+    }
+
     /** The unit */
     switch(item->unit) {
         case unit_none:
@@ -312,6 +354,9 @@ static void number_draw(ui_item_t *_item)
         case unit_hertz:
             tft_puts(FONT_FULL_SMALL, "Hz", xpos, _item->y + h, FONT_FULL_SMALL_MAX_GLYPH_WIDTH * 2, FONT_FULL_SMALL_MAX_GLYPH_HEIGHT, color, false);
             break;
+        case unit_watt:
+            tft_puts(FONT_FULL_SMALL, "W", xpos, _item->y + h, FONT_FULL_SMALL_MAX_GLYPH_WIDTH, FONT_FULL_SMALL_MAX_GLYPH_HEIGHT, color, false);
+            break;
         default:
             assert(0);
     }
@@ -331,4 +376,5 @@ void number_init(ui_number_t *item)
     item->ui.draw = &number_draw;
     item->cur_digit = item->num_digits + item->num_decimals - 1; /** Most signinficant digit */
     item->ui.needs_redraw = true;
+    item->ui.needs_full_redraw = true;
 }
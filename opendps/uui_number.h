@@ -94,6 +94,10 @@
 #include "tft.h"
 #include "uui.h"
 
+/** Number of digit glyphs whose last drawn state is cached, digits beyond
+  * this are always redrawn */
+#define NUMBER_MAX_GLYPHS  (8)
+
 /**
  * @brief Editable number UI item structure
  *
@@ -152,6 +156,16 @@ typedef struct ui_number_t {
      * Use this to apply the new value (e.g., set DAC output).
      */
     void (*changed)(struct ui_number_t *item);
+    /**
+     * @brief Digits as last drawn, left to right
+     *
+     * Holds the ASCII digit, ' ' for a blanked leading digit or 0 if the
+     * position has not been drawn. Bit 7 is set if the digit was framed
+     * as highlighted. Positions that are unchanged are not redrawn.
+     */
+    uint8_t drawn[NUMBER_MAX_GLYPHS];
+    /** @brief tft_clear_count() at the time of the last draw */
+    uint32_t drawn_clear_count;
 } ui_number_t;
 
 /**
@@ -0,0 +1,131 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include "wavegen.h"
+#include "ramfunc.h"
+
+RAMFUNC_HOOK int32_t wavegen_square(uint32_t phase, int32_t max)
+{
+    /** High for the first half of the period */
+    return phase < 0x80000000 ? max : 0;
+}
+
+RAMFUNC_HOOK int32_t wavegen_pulse(uint32_t phase, int32_t max, uint32_t duty)
+{
+    return phase < duty ? max : 0;
+}
+
+RAMFUNC_HOOK int32_t wavegen_saw(uint32_t phase, int32_t max)
+{
+    /* The production is max*phase/2^32, the top 16 bits of the phase are plenty for a 12 bit DAC */
+    return (int32_t)(((phase >> 16) * (uint32_t) max) >> 16);
+}
+
+/*
+ * The number of bits of our data type: here 16 (sizeof operator returns bytes).
+ */
+#define INT16_BITS  (8 * sizeof(int16_t))
+#ifndef INT16_MAX
+#define INT16_MAX   ((1<<(INT16_BITS-1))-1)
+#endif
+ 
+/*
+ * "5 bit" large table = 32 values. The mask: all bit belonging to the table
+ * are 1, the all above 0.
+ */
+#define TABLE_BITS  (5)
+#define TABLE_SIZE  (1<<TABLE_BITS)
+#define TABLE_MASK  (TABLE_SIZE-1)
+ 
+/*
+ * The lookup table is to 90DEG, the input can be -360 to 360 DEG, where negative
+ * values are transformed to positive before further processing. We need two
+ * additional bits (*4) to represent 360 DEG:
+ */
+#define LOOKUP_BITS (TABLE_BITS+2)
+#define LOOKUP_MASK ((1<<LOOKUP_BITS)-1)
+#define FLIP_BIT    (1<<TABLE_BITS)
+#define NEGATE_BIT  (1<<(TABLE_BITS+1))
+#define INTERP_BITS (INT16_BITS-1-LOOKUP_BITS)
+#define INTERP_MASK ((1<<INTERP_BITS)-1)
+ 
+/**
+ * "5 bit" lookup table for the offsets. These are the sines for exactly
+ * at 0deg, 11.25deg, 22.5deg etc. The values are from -1 to 1 in Q15.
+ */
+static int16_t sin90[TABLE_SIZE+1] = {
+  0x0000,0x0647,0x0c8b,0x12c7,0x18f8,0x1f19,0x2527,0x2b1e,
+  0x30fb,0x36b9,0x3c56,0x41cd,0x471c,0x4c3f,0x5133,0x55f4,
+  0x5a81,0x5ed6,0x62f1,0x66ce,0x6a6c,0x6dc9,0x70e1,0x73b5,
+  0x7640,0x7883,0x7a7c,0x7c29,0x7d89,0x7e9c,0x7f61,0x7fd7,
+  0x7fff
+};
+ 
+/**
+ * Sine calculation using interpolated table lookup.
+ * Instead of radiants or degrees we use "turns" here. Means this
+ * sine does NOT return one phase for 0 to 2*PI, but for 0 to 1.
+ * Input: -1 to 1 as int16 Q15  == -32768 to 32767.
+ * Output: -1 to 1 as int16 Q15 == -32768 to 32767.
+ *
+ * See the full description at www.AtWillys.de for the detailed
+ * explanation.
+ *
+ * @param int16_t angle Q15
+ * @return int16_t Q15
+ */
+RAMFUNC_HOOK static int16_t sin1(int16_t angle)
+{
+  int16_t v0, v1;
+  if(angle < 0) { angle += INT16_MAX; angle += 1; }
+  v0 = (angle >> INTERP_BITS);
+  if(v0 & FLIP_BIT) { v0 = ~v0; v1 = ~angle; } else { v1 = angle; }
+  v0 &= TABLE_MASK;
+  v1 = sin90[v0] + (int16_t) (((int32_t) (sin90[v0+1]-sin90[v0]) * (v1 & INTERP_MASK)) >> INTERP_BITS);
+  if((angle >> INTERP_BITS) & NEGATE_BIT) v1 = -v1;
+  return v1;
+}
+
+
+RAMFUNC_HOOK int32_t wavegen_sin(uint32_t phase, int32_t max)
+{
+    /** The production is (max/2) * sin(phase/2^32*2*PI) + (max/2), the top 15 bits
+        of the phase are a Q15 turn for the wavetable lookup in sin1().
+        There's a small error in amplitude here to avoid dividing by 32767 */
+    return ((max/2) * sin1((int16_t)(phase >> 17))) / 32768 + max/2;
+}
+
+RAMFUNC_HOOK int32_t wavegen_sin_q15(uint32_t phase)
+{
+    return sin1((int16_t)(phase >> 17));
+}
+
+RAMFUNC_HOOK int32_t wavegen_table(uint32_t phase, int32_t max, const uint16_t *table, uint32_t len)
+{
+    /** The table index is phase*len/2^32 which needs no division. Samples are
+        held until the next one, making the table length the number of steps */
+    uint32_t i = ((phase >> 16) * len) >> 16;
+    return (int32_t)(((uint32_t) table[i] * (uint32_t) max) >> 16);
+}
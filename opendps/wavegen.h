@@ -0,0 +1,103 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file wavegen.h
+ * @brief Waveform generators of the function generator
+ *
+ * Each generator returns the output for a position in the period given as a
+ * 32 bit phase, 0 to 2^32 for one period, scaled to <max>. They run in the
+ * ADC ISR of func_gen.c and only use shifts and multiplications.
+ */
+
+#ifndef __WAVEGEN_H__
+#define __WAVEGEN_H__
+
+#include <stdint.h>
+
+/**
+ * @brief      Square wave, <max> for the first half of the period and 0 for
+ *             the second
+ *
+ * @param[in]  phase  position in the period, 0 to 2^32
+ * @param[in]  max    the amplitude
+ *
+ * @retval     int32_t the output
+ */
+int32_t wavegen_square(uint32_t phase, int32_t max);
+
+/**
+ * @brief      Pulse wave, <max> until <duty> and 0 for the rest of the period
+ *
+ * @param[in]  phase  position in the period, 0 to 2^32
+ * @param[in]  max    the amplitude
+ * @param[in]  duty   phase where the output falls, 2^31 is a square
+ *
+ * @retval     int32_t the output
+ */
+int32_t wavegen_pulse(uint32_t phase, int32_t max, uint32_t duty);
+
+/**
+ * @brief      Saw tooth rising from 0 to <max> over the period
+ *
+ * @param[in]  phase  position in the period, 0 to 2^32
+ * @param[in]  max    the amplitude
+ *
+ * @retval     int32_t the output
+ */
+int32_t wavegen_saw(uint32_t phase, int32_t max);
+
+/**
+ * @brief      Sine between 0 and <max>, starting at <max>/2
+ *
+ * @param[in]  phase  position in the period, 0 to 2^32
+ * @param[in]  max    the amplitude
+ *
+ * @retval     int32_t the output
+ */
+int32_t wavegen_sin(uint32_t phase, int32_t max);
+
+/**
+ * @brief      Sine in fixed point, for the correlations of ripple.c and
+ *             lockin.c
+ *
+ * @param[in]  phase  position in the period, 0 to 2^32, add 2^30 for a cosine
+ *
+ * @retval     int32_t the sine with 15 fractional bits
+ */
+int32_t wavegen_sin_q15(uint32_t phase);
+
+/**
+ * @brief      Arbitrary waveform from a table of samples, 0xffff is <max>
+ *
+ * @param[in]  phase  position in the period, 0 to 2^32
+ * @param[in]  max    the amplitude
+ * @param[in]  table  one period of samples
+ * @param[in]  len    number of samples, at least 1
+ *
+ * @retval     int32_t the output
+ */
+int32_t wavegen_table(uint32_t phase, int32_t max, const uint16_t *table, uint32_t len);
+
+#endif // __WAVEGEN_H__
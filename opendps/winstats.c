@@ -0,0 +1,114 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <cortex.h>
+#include "winstats.h"
+#include "pwrctl.h"
+#include "tick.h"
+
+volatile winstats_acc_t winstats_acc;
+
+/** When the current window was opened */
+static uint64_t window_start;
+
+/**
+  * @brief Start an empty window, interrupts must be masked
+  * @retval none
+  */
+static void open_window(void)
+{
+    memset((void*) &winstats_acc, 0, sizeof(winstats_acc));
+    for (uint32_t ch = 0; ch < winstats_channels; ch++) {
+        winstats_acc.min[ch] = UINT16_MAX;
+    }
+    window_start = get_ticks();
+}
+
+/**
+  * @brief Convert a calibrated value to the 16 bit response format
+  * @param value the value
+  * @retval value clamped to 0..UINT16_MAX
+  */
+static uint16_t clamp16(float value)
+{
+    if (value <= 0) {
+        return 0;
+    } else if (value >= (float) UINT16_MAX) {
+        return UINT16_MAX;
+    }
+    return (uint16_t) value;
+}
+
+/**
+  * @brief Convert one channel of a window with raw * k + c
+  * @param stats the window
+  * @param acc the raw samples
+  * @param ch the channel
+  * @param k calibration slope
+  * @param c calibration offset
+  * @retval none
+  */
+static void convert(winstats_t *stats, const winstats_acc_t *acc, winstats_channel_t ch, float k, float c)
+{
+    float n = (float) acc->n;
+    float mean = (float) acc->sum[ch] / n;
+    float mean_sq = (float) acc->sum_sq[ch] / n;
+    /** The calibration slope is positive, min and max map onto min and max */
+    stats->min[ch] = clamp16(k * acc->min[ch] + c);
+    stats->max[ch] = clamp16(k * acc->max[ch] + c);
+    stats->mean[ch] = clamp16(k * mean + c);
+    /** E[(k * x + c)^2] = k^2 * E[x^2] + 2 * k * c * E[x] + c^2 */
+    float sq = k * k * mean_sq + 2 * k * c * mean + c * c;
+    stats->mean_sq[ch] = sq <= 0 ? 0 : (uint32_t) sq;
+}
+
+void winstats_init(void)
+{
+    bool masked = cm_mask_interrupts(true);
+    open_window();
+    (void) cm_mask_interrupts(masked);
+}
+
+void winstats_take(winstats_t *stats)
+{
+    winstats_acc_t acc;
+    uint64_t now = get_ticks();
+    /** The ADC ISR may preempt us, but not the other way round */
+    bool masked = cm_mask_interrupts(true);
+    acc = winstats_acc;
+    uint64_t start = window_start;
+    open_window();
+    (void) cm_mask_interrupts(masked);
+
+    memset(stats, 0, sizeof(*stats));
+    stats->window_ms = (uint32_t) (now - start);
+    if (!acc.n) {
+        return;
+    }
+    stats->samples = acc.n;
+    convert(stats, &acc, winstats_i_out, a_adc_k_coef, a_adc_c_coef);
+    convert(stats, &acc, winstats_v_out, v_adc_k_coef, v_adc_c_coef);
+}
@@ -0,0 +1,118 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Johan Kanflo (github.com/kanflo)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file winstats.h
+ * @brief Per window minimum, maximum, mean and mean square of I_out and V_out
+ *
+ * Available with CONFIG_WINDOW_STATS. The ADC ISR folds every raw I_out and
+ * V_out sample into the current window through winstats_sample(), so a
+ * transient between two host polls still shows in the window minimum and
+ * maximum. winstats_take() returns the window and opens the next one, a low
+ * rate poller thereby sees every sample exactly once. Read over
+ * cmd_window_stats.
+ */
+
+#ifndef __WINSTATS_H__
+#define __WINSTATS_H__
+
+#include <stdint.h>
+
+/** @brief Channels of a window, in the order of cmd_window_stats */
+typedef enum {
+    winstats_i_out = 0,
+    winstats_v_out,
+    winstats_channels
+} winstats_channel_t;
+
+/**
+ * @brief Raw samples of one window, written by the ADC ISR only
+ */
+typedef struct {
+    uint32_t n;                             /** Samples */
+    uint16_t min[winstats_channels];        /** Smallest raw sample */
+    uint16_t max[winstats_channels];        /** Largest raw sample */
+    uint64_t sum[winstats_channels];        /** Sum of the raw samples */
+    uint64_t sum_sq[winstats_channels];     /** Sum of the squared raw samples */
+} winstats_acc_t;
+
+/**
+ * @brief One closed window in mA and mV
+ */
+typedef struct {
+    uint32_t samples;                       /** Samples in the window */
+    uint32_t window_ms;                     /** Length of the window */
+    uint16_t min[winstats_channels];        /** Smallest value */
+    uint16_t max[winstats_channels];        /** Largest value */
+    uint16_t mean[winstats_channels];       /** Mean value */
+    uint32_t mean_sq[winstats_channels];    /** Mean of the squares, sqrt gives the RMS */
+} winstats_t;
+
+extern volatile winstats_acc_t winstats_acc;
+
+/**
+ * @brief Fold one value into a channel of the window
+ *
+ * @param[in] ch Channel
+ * @param[in] raw Raw sample
+ */
+static inline void winstats_add(winstats_channel_t ch, uint16_t raw)
+{
+    if (raw < winstats_acc.min[ch]) {
+        winstats_acc.min[ch] = raw;
+    }
+    if (raw > winstats_acc.max[ch]) {
+        winstats_acc.max[ch] = raw;
+    }
+    winstats_acc.sum[ch] += raw;
+    winstats_acc.sum_sq[ch] += (uint32_t) raw * raw;
+}
+
+/**
+ * @brief Add one sample set, called from the ADC ISR
+ *
+ * @param[in] i_raw Raw I_out, offset corrected
+ * @param[in] v_raw Raw V_out
+ */
+static inline void winstats_sample(uint16_t i_raw, uint16_t v_raw)
+{
+    winstats_acc.n++;
+    winstats_add(winstats_i_out, i_raw);
+    winstats_add(winstats_v_out, v_raw);
+}
+
+/**
+ * @brief Open the first window
+ */
+void winstats_init(void);
+
+/**
+ * @brief Close the current window and open the next one
+ *
+ * @param[out] stats The closed window, converted with the ADC calibration.
+ *                   All but window_ms are 0 when it holds no samples.
+ */
+void winstats_take(winstats_t *stats);
+
+#endif // __WINSTATS_H__